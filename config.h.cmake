@@ -8,6 +8,7 @@
 #cmakedefine HAVE_LIBEXECINFO
 #cmakedefine HAVE_CXXABI_H
 #cmakedefine HAVE_NICE
+#cmakedefine HAVE_EPOLL_CREATE1
 #cmakedefine HAVE_EDITLINE
 #cmakedefine HAVE_SYSTEMD
 
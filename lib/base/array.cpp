@@ -35,7 +35,7 @@ Array::Array(std::initializer_list<Value> init)
  */
 Value Array::Get(SizeType index) const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(LockUnlessFrozen());
 
 	return m_Data.at(index);
 }
@@ -93,13 +93,13 @@ void Array::Add(Value value, bool overrideFrozen)
 /**
  * Returns an iterator to the beginning of the array.
  *
- * Note: Caller must hold the object lock while using the iterator.
+ * Note: Caller must hold the object lock while using the iterator (unless the array is frozen).
  *
  * @returns An iterator.
  */
 Array::Iterator Array::Begin()
 {
-	ASSERT(OwnsLock());
+	ASSERT(IsFrozen() || OwnsLock());
 
 	return m_Data.begin();
 }
@@ -107,13 +107,13 @@ Array::Iterator Array::Begin()
 /**
  * Returns an iterator to the end of the array.
  *
- * Note: Caller must hold the object lock while using the iterator.
+ * Note: Caller must hold the object lock while using the iterator (unless the array is frozen).
  *
  * @returns An iterator.
  */
 Array::Iterator Array::End()
 {
-	ASSERT(OwnsLock());
+	ASSERT(IsFrozen() || OwnsLock());
 
 	return m_Data.end();
 }
@@ -125,7 +125,7 @@ Array::Iterator Array::End()
  */
 size_t Array::GetLength() const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(LockUnlessFrozen());
 
 	return m_Data.size();
 }
@@ -138,7 +138,7 @@ size_t Array::GetLength() const
  */
 bool Array::Contains(const Value& value) const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(LockUnlessFrozen());
 
 	return (std::find(m_Data.begin(), m_Data.end(), value) != m_Data.end());
 }
@@ -229,7 +229,7 @@ void Array::Reserve(SizeType newSize, bool overrideFrozen)
 
 void Array::CopyTo(const Array::Ptr& dest) const
 {
-	ObjectLock olock(this);
+	ObjectLock olock(LockUnlessFrozen());
 	ObjectLock xlock(dest);
 
 	if (dest->m_Frozen)
@@ -260,7 +260,7 @@ Object::Ptr Array::Clone() const
 {
 	ArrayData arr;
 
-	ObjectLock olock(this);
+	ObjectLock olock(LockUnlessFrozen());
 	for (const Value& val : m_Data) {
 		arr.push_back(val.Clone());
 	}
@@ -272,7 +272,7 @@ Array::Ptr Array::Reverse() const
 {
 	Array::Ptr result = new Array();
 
-	ObjectLock olock(this);
+	ObjectLock olock(LockUnlessFrozen());
 	ObjectLock xlock(result);
 
 	std::copy(m_Data.rbegin(), m_Data.rend(), std::back_inserter(result->m_Data));
@@ -302,7 +302,7 @@ Value Array::Join(const Value& separator) const
 	Value result;
 	bool first = true;
 
-	ObjectLock olock(this);
+	ObjectLock olock(LockUnlessFrozen());
 
 	for (const Value& item : m_Data) {
 		if (first) {
@@ -321,7 +321,7 @@ Array::Ptr Array::Unique() const
 {
 	std::set<Value> result;
 
-	ObjectLock olock(this);
+	ObjectLock olock(LockUnlessFrozen());
 
 	for (const Value& item : m_Data) {
 		result.insert(item);
@@ -330,10 +330,43 @@ Array::Ptr Array::Unique() const
 	return Array::FromSet(result);
 }
 
+/**
+ * Prevents any further modification (except with overrideFrozen, which mustn't be used on
+ * frozen arrays anymore once they're shared with other threads as those don't lock them).
+ */
 void Array::Freeze()
 {
 	ObjectLock olock(this);
-	m_Frozen = true;
+	m_Frozen.store(true, std::memory_order_release);
+}
+
+bool Array::IsFrozen() const
+{
+	return m_Frozen.load(std::memory_order_acquire);
+}
+
+/**
+ * Returns an array with the current elements which won't change anymore.
+ * That's this array itself if it's frozen, otherwise a frozen shallow copy of it.
+ *
+ * @returns A frozen array.
+ */
+Array::Ptr Array::Snapshot() const
+{
+	if (IsFrozen())
+		return const_cast<Array *>(this);
+
+	Array::Ptr snapshot = ShallowClone();
+	snapshot->Freeze();
+	return snapshot;
+}
+
+/**
+ * Returns what ObjectLock has to lock for reading our data: nothing once we're frozen.
+ */
+const Array *Array::LockUnlessFrozen() const
+{
+	return IsFrozen() ? nullptr : this;
 }
 
 Value Array::GetFieldByName(const String& field, bool sandboxed, const DebugInfo& debugInfo) const
@@ -5,6 +5,7 @@
 
 #include "base/i2-base.hpp"
 #include "base/objectlock.hpp"
+#include "base/objectpool.hpp"
 #include "base/value.hpp"
 #include <boost/range/iterator.hpp>
 #include <vector>
@@ -18,12 +19,17 @@ typedef std::vector<Value> ArrayData;
 /**
  * An array of Value items.
  *
+ * A frozen array can't be modified anymore, so it's read without any locking
+ * (including iterating over it) and shared instead of being copied by Snapshot().
+ * Clone() still returns an unfrozen deep copy.
+ *
  * @ingroup base
  */
 class Array final : public Object
 {
 public:
 	DECLARE_OBJECT(Array);
+	DECLARE_POOLED_ALLOCATION();
 
 	/**
 	 * An iterator that can be used to iterate over array elements.
@@ -74,7 +80,7 @@ public:
 	template<typename T>
 	std::set<T> ToSet()
 	{
-		ObjectLock olock(this);
+		ObjectLock olock(LockUnlessFrozen());
 		return std::set<T>(Begin(), End());
 	}
 
@@ -98,13 +104,17 @@ public:
 
 	Array::Ptr Unique() const;
 	void Freeze();
+	bool IsFrozen() const;
+	Array::Ptr Snapshot() const;
 
 	Value GetFieldByName(const String& field, bool sandboxed, const DebugInfo& debugInfo) const override;
 	void SetFieldByName(const String& field, const Value& value, bool overrideFrozen, const DebugInfo& debugInfo) override;
 
 private:
 	std::vector<Value> m_Data; /**< The data for the array. */
-	bool m_Frozen{false};
+	std::atomic<bool> m_Frozen{false};
+
+	const Array *LockUnlessFrozen() const;
 };
 
 Array::Iterator begin(const Array::Ptr& x);
@@ -3,6 +3,8 @@
 #include "base/atomic-file.hpp"
 #include "base/exception.hpp"
 #include "base/utility.hpp"
+#include <cstdio>
+#include <set>
 #include <utility>
 
 #ifdef _WIN32
@@ -10,9 +12,15 @@
 #	include <windows.h>
 #else /* _WIN32 */
 #	include <errno.h>
+#	include <fcntl.h>
+#	include <sys/stat.h>
 #	include <unistd.h>
 #endif /* _WIN32 */
 
+#ifdef __linux__
+#	include <sys/utsname.h>
+#endif /* __linux__ */
+
 using namespace icinga;
 
 void AtomicFile::Write(String path, int mode, const String& content)
@@ -89,6 +97,12 @@ AtomicFile::~AtomicFile()
 }
 
 void AtomicFile::Commit()
+{
+	Sync();
+	Rename();
+}
+
+void AtomicFile::Sync()
 {
 	flush();
 
@@ -113,11 +127,157 @@ void AtomicFile::Commit()
 			<< boost::errinfo_file_name(m_TempFilename));
 	}
 #endif /* _WIN32 */
+}
+
+void AtomicFile::Rename()
+{
+	CloseFd();
 
+	Utility::RenameFile(m_TempFilename, m_Path);
+	m_TempFilename = "";
+}
+
+void AtomicFile::CloseFd()
+{
 	close();
 	(void)::close(m_Fd);
 	m_Fd = -1;
+}
 
-	Utility::RenameFile(m_TempFilename, m_Path);
-	m_TempFilename = "";
+AtomicFileGroup::~AtomicFileGroup()
+{
+	for (auto& file : m_Files) {
+		if (!file.TempFilename.IsEmpty()) {
+			(void)unlink(file.TempFilename.CStr());
+		}
+	}
+}
+
+/**
+ * Writes the content to a temporary file which replaces the given one on Commit().
+ *
+ * The temporary file is closed afterwards, unless syncfs(2) is used it's synced before.
+ */
+void AtomicFileGroup::Add(String path, int mode, const String& content)
+{
+	AtomicFile file (std::move(path), mode);
+
+	file << content;
+
+	if (SyncFileSystems()) {
+		file.flush();
+	} else {
+		file.Sync();
+	}
+
+	/* Only the file names are kept, thousands of open files would exceed the limit of file descriptors. */
+	file.CloseFd();
+
+	m_Files.push_back({ file.m_Path, file.m_TempFilename });
+	file.m_TempFilename = "";
+}
+
+/**
+ * Writes all files to disk, then replaces the original ones with them.
+ *
+ * On Linux 5.8 and newer that takes one syncfs(2) per file system and one fsync(2) per directory.
+ * Older kernels' syncfs(2) doesn't report errors writing back the data, so there and on other
+ * platforms Add() already did one fsync(2) per file like AtomicFile::Commit().
+ * If this throws, none of the remaining files is replaced.
+ */
+void AtomicFileGroup::Commit()
+{
+#ifdef __linux__
+	if (SyncFileSystems()) {
+		std::set<dev_t> devices;
+
+		for (auto& file : m_Files) {
+			struct stat st;
+
+			if (stat(file.TempFilename.CStr(), &st)) {
+				auto err (errno);
+
+				BOOST_THROW_EXCEPTION(posix_error()
+					<< boost::errinfo_api_function("stat")
+					<< boost::errinfo_errno(err)
+					<< boost::errinfo_file_name(file.TempFilename));
+			}
+
+			if (!devices.insert(st.st_dev).second) {
+				continue;
+			}
+
+			/* Any file of the file system will do, only one of them is open at a time. */
+			int fd = open(file.TempFilename.CStr(), O_RDONLY | O_CLOEXEC);
+
+			if (fd < 0) {
+				auto err (errno);
+
+				BOOST_THROW_EXCEPTION(posix_error()
+					<< boost::errinfo_api_function("open")
+					<< boost::errinfo_errno(err)
+					<< boost::errinfo_file_name(file.TempFilename));
+			}
+
+			if (syncfs(fd)) {
+				auto err (errno);
+				(void)::close(fd);
+
+				BOOST_THROW_EXCEPTION(posix_error()
+					<< boost::errinfo_api_function("syncfs")
+					<< boost::errinfo_errno(err)
+					<< boost::errinfo_file_name(file.TempFilename));
+			}
+
+			(void)::close(fd);
+		}
+	}
+#endif /* __linux__ */
+
+	std::set<String> dirs;
+
+	for (auto& file : m_Files) {
+		dirs.insert(Utility::DirName(file.Path));
+
+		Utility::RenameFile(file.TempFilename, file.Path);
+		file.TempFilename = "";
+	}
+
+	m_Files.clear();
+
+#ifndef _WIN32
+	/* Persist the renames, otherwise a crash could bring back the old files (but never half-written ones). */
+	for (auto& dir : dirs) {
+		int fd = open(dir.CStr(), O_RDONLY | O_DIRECTORY);
+
+		if (fd >= 0) {
+			(void)fsync(fd);
+			(void)::close(fd);
+		}
+	}
+#endif /* _WIN32 */
+}
+
+/**
+ * Returns whether Commit() can sync whole file systems instead of every file on its own,
+ * i.e. whether syncfs(2) is available and reports writeback errors (Linux 5.8 and newer).
+ */
+bool AtomicFileGroup::SyncFileSystems()
+{
+#ifdef __linux__
+	static const bool supported = []() {
+		struct utsname name;
+		unsigned int major = 0, minor = 0;
+
+		if (uname(&name) || sscanf(name.release, "%u.%u", &major, &minor) != 2) {
+			return false;
+		}
+
+		return major > 5 || (major == 5 && minor >= 8);
+	}();
+
+	return supported;
+#else /* __linux__ */
+	return false;
+#endif /* __linux__ */
 }
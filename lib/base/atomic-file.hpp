@@ -6,6 +6,7 @@
 #include "base/string.hpp"
 #include <boost/iostreams/device/file_descriptor.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <vector>
 
 namespace icinga
 {
@@ -31,9 +32,52 @@ public:
 	void Commit();
 
 private:
+	friend class AtomicFileGroup;
+
 	String m_Path;
 	String m_TempFilename;
 	int m_Fd;
+
+	void Sync();
+	void Rename();
+	void CloseFd();
+};
+
+/**
+ * Atomically replaces the content of many files with one sync of the file system instead of one per file.
+ *
+ * Every file is replaced only after all of them were written to disk, but not all at once. The temporary
+ * files are closed after writing them, so a group doesn't hold a file descriptor per file.
+ *
+ * @ingroup base
+ */
+class AtomicFileGroup
+{
+public:
+	AtomicFileGroup() = default;
+	AtomicFileGroup(const AtomicFileGroup&) = delete;
+	AtomicFileGroup& operator=(const AtomicFileGroup&) = delete;
+	~AtomicFileGroup();
+
+	void Add(String path, int mode, const String& content);
+
+	inline size_t GetLength() const noexcept
+	{
+		return m_Files.size();
+	}
+
+	void Commit();
+
+private:
+	struct File
+	{
+		String Path;
+		String TempFilename;
+	};
+
+	std::vector<File> m_Files;
+
+	static bool SyncFileSystems();
 };
 
 }
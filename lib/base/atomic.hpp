@@ -62,9 +62,13 @@ public:
 
 	inline void store(T desired)
 	{
-		std::unique_lock<std::mutex> lock(m_Mutex);
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+
+			std::swap(m_Value, desired);
+		}
 
-		m_Value = std::move(desired);
+		/* Now desired is the old value, e.g. the previous check result, which is released without blocking load(). */
 	}
 
 private:
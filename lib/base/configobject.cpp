@@ -7,6 +7,7 @@
 #include "base/serializer.hpp"
 #include "base/netstring.hpp"
 #include "base/json.hpp"
+#include "base/object-packer.hpp"
 #include "base/stdiostream.hpp"
 #include "base/debug.hpp"
 #include "base/objectlock.hpp"
@@ -14,19 +15,29 @@
 #include "base/exception.hpp"
 #include "base/function.hpp"
 #include "base/initialize.hpp"
-#include "base/workqueue.hpp"
+#include "base/taskgroup.hpp"
 #include "base/context.hpp"
 #include "base/application.hpp"
+#include "base/utility.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <mutex>
+#include <unordered_map>
 #include <boost/exception/errinfo_api_function.hpp>
 #include <boost/exception/errinfo_errno.hpp>
 #include <boost/exception/errinfo_file_name.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 using namespace icinga;
 
 REGISTER_TYPE_WITH_PROTOTYPE(ConfigObject, ConfigObject::GetPrototype());
 
-boost::signals2::signal<void (const ConfigObject::Ptr&)> ConfigObject::OnStateChanged;
+Signal<void (const ConfigObject::Ptr&)> ConfigObject::OnStateChanged;
+
+static std::atomic<uint_least64_t> l_ChangeCount (0);
 
 bool ConfigObject::IsActive() const
 {
@@ -38,6 +49,34 @@ bool ConfigObject::IsPaused() const
 	return GetPaused();
 }
 
+/**
+ * Utility::SDBM() of the name, e.g. for distributing the objects between HA endpoints.
+ * Computed once as the name doesn't change.
+ */
+unsigned long ConfigObject::GetNameHash() const
+{
+	auto hash (m_NameHash.load(std::memory_order_relaxed));
+
+	if (!hash) {
+		hash = Utility::SDBM(GetName());
+		m_NameHash.store(hash, std::memory_order_relaxed);
+	}
+
+	return hash;
+}
+
+/**
+ * The index of this object among the registered objects of its type, see ConfigType#GetTypeIndexCount().
+ * Indexes of unregistered objects are reused, so they stay dense. Side tables like ConfigObjectTable use
+ * it instead of looking up the object's pointer in a map.
+ *
+ * @returns The index, or -1 if the object isn't registered
+ */
+size_t ConfigObject::GetTypeIndex() const
+{
+	return m_TypeIndex.load(std::memory_order_relaxed);
+}
+
 void ConfigObject::SetExtension(const String& key, const Value& value)
 {
 	Dictionary::Ptr extensions = GetExtensions();
@@ -90,6 +129,8 @@ public:
 
 void ConfigObject::ModifyAttribute(const String& attr, const Value& value, bool updateVersion)
 {
+	l_ChangeCount.fetch_add(1);
+
 	Dictionary::Ptr original_attributes = GetOriginalAttributes();
 	bool updated_original_attributes = false;
 
@@ -116,13 +157,18 @@ void ConfigObject::ModifyAttribute(const String& attr, const Value& value, bool
 	Value newValue;
 
 	if (tokens.size() > 1) {
-		newValue = oldValue.Clone();
-		Value current = newValue;
+		/* Copy only the dictionaries along the path, the others are shared with the old value
+		 * (which readers may still hold, e.g. as a frozen snapshot). */
+		Value current;
 
-		if (current.IsEmpty()) {
+		if (oldValue.IsEmpty())
 			current = new Dictionary();
-			newValue = current;
-		}
+		else if (oldValue.IsObjectType<Dictionary>())
+			current = static_cast<Dictionary::Ptr>(oldValue)->ShallowClone();
+		else
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Value must be a dictionary."));
+
+		newValue = current;
 
 		String prefix = tokens[0];
 
@@ -137,8 +183,11 @@ void ConfigObject::ModifyAttribute(const String& attr, const Value& value, bool
 
 			if (!dict->Get(key, &current)) {
 				current = new Dictionary();
-				dict->Set(key, current);
+			} else if (current.IsObjectType<Dictionary>()) {
+				current = static_cast<Dictionary::Ptr>(current)->ShallowClone();
 			}
+
+			dict->Set(key, current);
 		}
 
 		if (!current.IsObjectType<Dictionary>())
@@ -204,6 +253,8 @@ void ConfigObject::ModifyAttribute(const String& attr, const Value& value, bool
 
 void ConfigObject::RestoreAttribute(const String& attr, bool updateVersion)
 {
+	l_ChangeCount.fetch_add(1);
+
 	Type::Ptr type = GetReflectionType();
 
 	std::vector<String> tokens = attr.Split(".");
@@ -373,6 +424,8 @@ void ConfigObject::Activate(bool runtimeCreated, const Value& cookie)
 			SetAuthority(true);
 	}
 
+	l_ChangeCount.fetch_add(1);
+
 	NotifyActive(cookie);
 }
 
@@ -404,6 +457,8 @@ void ConfigObject::Deactivate(bool runtimeRemoved, const Value& cookie)
 
 	ASSERT(GetStopCalled());
 
+	l_ChangeCount.fetch_add(1);
+
 	NotifyActive(cookie);
 }
 
@@ -458,19 +513,276 @@ void ConfigObject::SetAuthority(bool authority)
 	}
 }
 
-void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
+/* Packed state files start with this, JSON ones with a netstring length. */
+static const char l_StateFileMagic[8] = { 'I', '2', 'S', 'T', 'A', 'T', 'E', '\1' };
+
+/**
+ * Each record of a packed state file consists of its kind, its payload
+ * length (big-endian uint64) and the payload. A snapshot record holds the
+ * unique ID of the state file, journals start with the snapshot record of
+ * the state file they extend. A type record holds the name of the type all
+ * following object records belong to. An object record holds the object's
+ * name (length-prefixed) followed by its PackObject()ed state.
+ */
+enum StateRecordKind : char
 {
-	Log(LogInformation, "ConfigObject")
-		<< "Dumping program state to file '" << filename << "'";
+	StateRecordSnapshot = 'S',
+	StateRecordType = 'T',
+	StateRecordDefaults = 'D',
+	StateRecordObject = 'O'
+};
+
+/* Serializes writing the state file and its journal. */
+static std::mutex l_StateFileMutex;
+
+/* The ID of the current state file, empty if the next dump has to write a new one. */
+static String l_StateSnapshotId;
+static uint_least64_t l_StateSnapshotSize = 0;
+
+/* The size of the journal for the current state file, 0 if it hasn't been started yet. */
+static uint_least64_t l_StateJournalSize = 0;
+
+/* The state file and how much of its journal the last RestoreObjects() call restored. */
+static String l_RestoredSnapshotId;
+static uint_least64_t l_RestoredJournalSize = 0;
+
+static std::mutex l_DirtyObjectsMutex;
+static std::vector<ConfigObject::Ptr> l_DirtyObjects;
+
+static void AppendUInt64BE(std::string& buf, uint_least64_t value)
+{
+	for (int shift = 56; shift >= 0; shift -= 8)
+		buf += static_cast<char>((value >> shift) & 0xff);
+}
+
+static uint_least64_t ReadUInt64BE(const char *pos)
+{
+	uint_least64_t value = 0;
+
+	for (int i = 0; i < 8; i++)
+		value = (value << 8) | static_cast<unsigned char>(pos[i]);
+
+	return value;
+}
+
+static uint_least64_t WriteStateRecord(std::ostream& fp, StateRecordKind kind, const std::string& payload)
+{
+	std::string header (1, kind);
+	AppendUInt64BE(header, payload.size());
+
+	fp.write(header.data(), header.size());
+	fp.write(payload.data(), payload.size());
+
+	return header.size() + payload.size();
+}
+
+static bool IsDefaultValue(const Value& value, const Value& defaultValue)
+{
+	return !value.IsObject() && value.GetType() == defaultValue.GetType() && value == defaultValue;
+}
+
+/**
+ * Returns the default values of the attributes of a type which a state file
+ * may omit. They're written to the state file as well: some defaults aren't
+ * constant, e.g. Application::GetStartTime() for the last state change of a
+ * checkable, so the ones of the restoring process may be different.
+ */
+static Dictionary::Ptr GetStateDefaults(const Type::Ptr& type, int attributeTypes)
+{
+	Object::Ptr instance = type->Instantiate(std::vector<Value>());
+	DictionaryData defaults;
+
+	for (int i = 0; i < type->GetFieldCount(); i++) {
+		Field field = type->GetFieldInfo(i);
+
+		if (attributeTypes != 0 && (field.Attributes & attributeTypes) == 0)
+			continue;
+
+		if (strcmp(field.Name, "type") == 0)
+			continue;
+
+		Value value = instance->GetField(i);
+
+		if (!value.IsObject())
+			defaults.emplace_back(field.Name, std::move(value));
+	}
+
+	Dictionary::Ptr result = new Dictionary(std::move(defaults));
+	result->Freeze();
+	return result;
+}
+
+/**
+ * Resets the attributes which a state file record omitted because they had
+ * the default values written to the state file, in case they were changed
+ * before the restore.
+ */
+static void ResetDefaultFields(const ConfigObject::Ptr& object, const Dictionary::Ptr& update, const Dictionary::Ptr& defaults, int attributeTypes)
+{
+	Type::Ptr type = object->GetReflectionType();
+
+	/* The defaults are frozen, all objects of the type are restored in parallel without locking them. */
+	for (const Dictionary::Pair& kv : defaults) {
+		if (update->Contains(kv.first))
+			continue;
+
+		int fid = type->GetFieldId(kv.first);
+
+		/* The attribute was removed since the state file was written. */
+		if (fid < 0)
+			continue;
+
+		if ((type->GetFieldInfo(fid).Attributes & attributeTypes) == 0)
+			continue;
+
+		if (!IsDefaultValue(object->GetField(fid), kv.second))
+			object->SetField(fid, kv.second, true);
+	}
+}
+
+/**
+ * Writes the state of an object, preceded by a type record unless the
+ * previous object had the same type.
+ *
+ * @param defaults The default values of the object's type (see GetStateDefaults()), attributes with the same values are omitted
+ * @returns The number of bytes written
+ */
+static uint_least64_t WriteObjectState(std::ostream& fp, const ConfigObject::Ptr& object, int attributeTypes, Type*& currentType,
+	const Dictionary::Ptr& defaults = nullptr)
+{
+	Dictionary::Ptr update = Serialize(object, attributeTypes);
+
+	if (!update)
+		return 0;
+
+	uint_least64_t written = 0;
+	Type *type = object->GetReflectionType().get();
+
+	if (defaults) {
+		for (const Dictionary::Pair& kv : defaults) {
+			Value value;
+
+			if (update->Get(kv.first, &value) && IsDefaultValue(value, kv.second))
+				update->Remove(kv.first);
+		}
+	}
+
+	if (type != currentType) {
+		written += WriteStateRecord(fp, StateRecordType, type->GetName().GetData());
+		currentType = type;
+
+		/* The restoring process needs the same defaults for the omitted attributes. */
+		if (defaults)
+			written += WriteStateRecord(fp, StateRecordDefaults, PackObject(defaults).GetData());
+	}
+
+	const String& name = object->GetName();
+
+	std::string record;
+	AppendUInt64BE(record, name.GetLength());
+	record += name.GetData();
+	record += PackObject(update).GetData();
+
+	return written + WriteStateRecord(fp, StateRecordObject, record);
+}
+
+/**
+ * Splits the data of a state file or journal into records and passes them
+ * to the callback until it returns false.
+ *
+ * @returns false if the data ends in the middle of a record
+ */
+static bool ReadStateRecords(const char *pos, const char *end, const std::function<bool (char, const char *, const char *)>& callback)
+{
+	while (pos < end) {
+		if (end - pos < 9)
+			return false;
+
+		char kind = *pos;
+		uint_least64_t length = ReadUInt64BE(pos + 1);
+		pos += 9;
+
+		if (uint_least64_t(end - pos) < length)
+			return false;
+
+		if (!callback(kind, pos, pos + length))
+			break;
+
+		pos += length;
+	}
+
+	return true;
+}
+
+/**
+ * Remembers that a state attribute of this object changed, so that the next
+ * DumpDirtyObjects() call persists it. Inactive objects aren't tracked, their
+ * state is either restored or derived from the config.
+ */
+void ConfigObject::MarkStateDirty()
+{
+	if (!IsActive())
+		return;
+
+	l_ChangeCount.fetch_add(1, std::memory_order_relaxed);
+
+	if (m_StateDirty.exchange(true))
+		return;
+
+	std::unique_lock<std::mutex> lock (l_DirtyObjectsMutex);
+	l_DirtyObjects.emplace_back(this);
+}
+
+/**
+ * Returns a counter which increases whenever the state or the configuration
+ * of an active object changes, or an object is (de-)activated.
+ *
+ * @returns The number of changes so far.
+ */
+uint_least64_t ConfigObject::GetChangeCount()
+{
+	return l_ChangeCount.load();
+}
+
+std::vector<ConfigObject::Ptr> ConfigObject::TakeDirtyObjects()
+{
+	std::vector<ConfigObject::Ptr> objects;
+
+	{
+		std::unique_lock<std::mutex> lock (l_DirtyObjectsMutex);
+		objects.swap(l_DirtyObjects);
+	}
+
+	/* Changes from now on mark the objects dirty again, the caller serializes them afterwards. */
+	for (const ConfigObject::Ptr& object : objects)
+		object->m_StateDirty.store(false);
 
+	return objects;
+}
+
+String ConfigObject::GetStateJournalPath(const String& filename)
+{
+	return filename + ".journal";
+}
+
+void ConfigObject::WriteSnapshot(const String& filename, int attributeTypes)
+{
 	try {
 		Utility::Glob(filename + ".tmp.*", &Utility::Remove, GlobFile);
 	} catch (const std::exception& ex) {
 		Log(LogWarning, "ConfigObject") << DiagnosticInformation(ex);
 	}
 
+	/* All objects are written anyway. */
+	TakeDirtyObjects();
+
+	String snapshotId = Utility::NewUniqueID();
+
 	AtomicFile fp (filename, 0600);
-	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+	fp.write(l_StateFileMagic, sizeof(l_StateFileMagic));
+
+	uint_least64_t size = sizeof(l_StateFileMagic) + WriteStateRecord(fp, StateRecordSnapshot, snapshotId.GetData());
+	Type *currentType = nullptr;
 
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
 		auto *dtype = dynamic_cast<ConfigType *>(type.get());
@@ -478,26 +790,126 @@ void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
 		if (!dtype)
 			continue;
 
-		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
-			Dictionary::Ptr update = Serialize(object, attributeTypes);
-
-			if (!update)
-				continue;
+		std::vector<ConfigObject::Ptr> objects = dtype->GetObjects();
 
-			Dictionary::Ptr persistentObject = new Dictionary({
-				{ "type", type->GetName() },
-				{ "name", object->GetName() },
-				{ "update", update }
-			});
+		if (objects.empty())
+			continue;
 
-			String json = JsonEncode(persistentObject);
+		/* Most state attributes of most objects still have their default values, they don't need to be restored. */
+		Dictionary::Ptr defaults = GetStateDefaults(type, attributeTypes);
 
-			NetString::WriteStringToStream(sfp, json);
-		}
+		for (const ConfigObject::Ptr& object : objects)
+			size += WriteObjectState(fp, object, attributeTypes, currentType, defaults);
 	}
 
-	sfp->Close();
 	fp.Commit();
+
+	l_StateSnapshotId = snapshotId;
+	l_StateSnapshotSize = size;
+	l_StateJournalSize = 0;
+
+	/* A left over journal doesn't match the new snapshot ID and would be ignored anyway. */
+	String journalPath = GetStateJournalPath(filename);
+
+	try {
+		if (Utility::PathExists(journalPath))
+			Utility::Remove(journalPath);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ConfigObject") << DiagnosticInformation(ex);
+	}
+}
+
+void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
+{
+	Log(LogInformation, "ConfigObject")
+		<< "Dumping program state to file '" << filename << "'";
+
+	std::unique_lock<std::mutex> lock (l_StateFileMutex);
+	WriteSnapshot(filename, attributeTypes);
+}
+
+/**
+ * Appends the state of all objects whose state attributes changed since the
+ * last dump to the journal of the state file. A new state file is written
+ * instead if there's none to extend or the journal outgrew the state file.
+ *
+ * @param filename The state file
+ */
+void ConfigObject::DumpDirtyObjects(const String& filename)
+{
+	std::unique_lock<std::mutex> lock (l_StateFileMutex);
+
+	if (l_StateSnapshotId.IsEmpty() || l_StateJournalSize >= l_StateSnapshotSize) {
+		Log(LogInformation, "ConfigObject")
+			<< "Dumping program state to file '" << filename << "'";
+
+		WriteSnapshot(filename, FAState);
+		return;
+	}
+
+	std::vector<ConfigObject::Ptr> objects = TakeDirtyObjects();
+
+	if (objects.empty())
+		return;
+
+	std::sort(objects.begin(), objects.end(), [](const ConfigObject::Ptr& a, const ConfigObject::Ptr& b) {
+		return a->GetReflectionType().get() < b->GetReflectionType().get();
+	});
+
+	String journalPath = GetStateJournalPath(filename);
+	std::ofstream fp;
+
+	if (l_StateJournalSize == 0)
+		fp.open(journalPath.CStr(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+	else
+		fp.open(journalPath.CStr(), std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+
+	if (!fp) {
+		/* The changes taken above are only in the next state file. */
+		l_StateSnapshotId = String();
+
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("open")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(journalPath));
+	}
+
+	uint_least64_t written = 0;
+
+	if (l_StateJournalSize == 0) {
+#ifndef _WIN32
+		(void)chmod(journalPath.CStr(), 0600);
+#endif /* _WIN32 */
+
+		fp.write(l_StateFileMagic, sizeof(l_StateFileMagic));
+		written += sizeof(l_StateFileMagic) + WriteStateRecord(fp, StateRecordSnapshot, l_StateSnapshotId.GetData());
+	}
+
+	Type *currentType = nullptr;
+	size_t count = 0;
+
+	for (const ConfigObject::Ptr& object : objects) {
+		/* Deleted objects don't need to be restored. Objects deactivated on shutdown are still registered. */
+		if (GetObject(object->GetReflectionType()->GetName(), object->GetName()) != object)
+			continue;
+
+		written += WriteObjectState(fp, object, FAState, currentType);
+		count++;
+	}
+
+	fp.close();
+
+	if (fp.fail()) {
+		/* Records appended after an incomplete one would be ignored. */
+		l_StateSnapshotId = String();
+
+		BOOST_THROW_EXCEPTION(std::runtime_error("Failed to write state journal '" + journalPath + "'."));
+	}
+
+	l_StateJournalSize += written;
+
+	Log(LogNotice, "ConfigObject")
+		<< "Appended the state of " << count << " changed objects to '" << journalPath << "'.";
 }
 
 void ConfigObject::RestoreObject(const String& message, int attributeTypes)
@@ -512,17 +924,283 @@ void ConfigObject::RestoreObject(const String& message, int attributeTypes)
 	if (!object)
 		return;
 
+	RestoreObject(object, persistentObject->Get("update"), attributeTypes);
+}
+
+void ConfigObject::RestoreObject(const ConfigObject::Ptr& object, const Dictionary::Ptr& update, int attributeTypes)
+{
 #ifdef I2_DEBUG
 	Log(LogDebug, "ConfigObject")
-		<< "Restoring object '" << name << "' of type '" << type << "'.";
+		<< "Restoring object '" << object->GetName() << "' of type '" << object->GetReflectionType()->GetName() << "'.";
 #endif /* I2_DEBUG */
-	Dictionary::Ptr update = persistentObject->Get("update");
 	Deserialize(object, update, false, attributeTypes);
 	object->OnStateLoaded();
 	object->SetStateLoaded(true);
 }
 
-void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
+/**
+ * Restores the objects from a packed state file and its journal. The files
+ * are mapped into memory and only split into records here, looking up the
+ * objects and decoding their records is done in parallel. Journal records
+ * replace the state file records of the same object, so every object is
+ * decoded only once.
+ *
+ * An incremental restore of the same state file as last time only replays
+ * the journal records which were appended since then.
+ *
+ * @param filename The state file
+ * @param attributeTypes The attributes to restore
+ * @param incremental Whether to skip what the last call restored already
+ * @return The number of restored objects
+ */
+unsigned long ConfigObject::RestorePackedObjects(const String& filename, int attributeTypes, bool incremental)
+{
+	namespace bip = boost::interprocess;
+
+	struct PackedObject
+	{
+		ConfigType *CType;
+		const char *Name;
+		size_t NameLength;
+		const char *Begin;
+		const char *End;
+		/* The values of the attributes which the record omitted, journal records don't omit any. */
+		Dictionary *Defaults;
+		/* Looked up in parallel, see below. */
+		mutable ConfigObject::Ptr Object;
+	};
+
+	std::vector<PackedObject> objects;
+	std::vector<Dictionary::Ptr> defaults;
+	ConfigType *ctype = nullptr;
+	Dictionary *typeDefaults = nullptr;
+
+	auto readRecord = [&objects, &defaults, &ctype, &typeDefaults](char kind, const char *begin, const char *end) {
+		switch (kind) {
+			case StateRecordType:
+				/* Objects of types which don't exist anymore are skipped. */
+				ctype = dynamic_cast<ConfigType *>(Type::GetByName(String(begin, end)).get());
+				typeDefaults = nullptr;
+				break;
+			case StateRecordDefaults: {
+				if (!ctype)
+					break;
+
+				Value values = UnpackObject(begin, end);
+
+				if (!values.IsObjectType<Dictionary>())
+					BOOST_THROW_EXCEPTION(std::runtime_error("Defaults record is invalid."));
+
+				Dictionary::Ptr dict = values;
+				dict->Freeze();
+
+				defaults.emplace_back(std::move(dict));
+				typeDefaults = defaults.back().get();
+				break;
+			}
+			case StateRecordObject: {
+				if (!ctype)
+					break;
+
+				if (end - begin < 8)
+					BOOST_THROW_EXCEPTION(std::runtime_error("Object record is truncated."));
+
+				uint_least64_t nameLength = ReadUInt64BE(begin);
+				const char *name = begin + 8;
+
+				if (uint_least64_t(end - name) < nameLength)
+					BOOST_THROW_EXCEPTION(std::runtime_error("Object record is truncated."));
+
+				objects.push_back({ ctype, name, static_cast<size_t>(nameLength), name + nameLength, end, typeDefaults, nullptr });
+				break;
+			}
+			default:
+				BOOST_THROW_EXCEPTION(std::runtime_error("Invalid record."));
+		}
+	};
+
+	bip::file_mapping mapping (filename.CStr(), bip::read_only);
+	bip::mapped_region region (mapping, bip::read_only);
+
+	const char *begin = static_cast<const char *>(region.get_address());
+	const char *end = begin + region.get_size();
+
+	String snapshotId;
+	bool skipped = false;
+
+	bool complete = ReadStateRecords(begin + sizeof(l_StateFileMagic), end, [&snapshotId, &skipped, &readRecord, &filename, incremental](char kind, const char *rbegin, const char *rend) {
+		if (kind == StateRecordSnapshot) {
+			snapshotId = String(rbegin, rend);
+
+			/* The state of the objects is still the one which was restored from this file. */
+			if (incremental && !snapshotId.IsEmpty() && snapshotId == l_RestoredSnapshotId) {
+				skipped = true;
+				return false;
+			}
+		} else {
+			try {
+				readRecord(kind, rbegin, rend);
+			} catch (const std::runtime_error& ex) {
+				BOOST_THROW_EXCEPTION(std::runtime_error("State file '" + filename + "' is invalid: " + ex.what()));
+			}
+		}
+
+		return true;
+	});
+
+	if (!complete)
+		BOOST_THROW_EXCEPTION(std::runtime_error("State file '" + filename + "' is truncated."));
+
+	String journalPath = GetStateJournalPath(filename);
+	bip::mapped_region journalRegion;
+	uint_least64_t journalSize = 0;
+	uint_least64_t journalRead = 0;
+	uint_least64_t journalSkip = skipped ? l_RestoredJournalSize : 0;
+	String restoredId = snapshotId;
+
+	if (!snapshotId.IsEmpty() && Utility::PathExists(journalPath)) {
+		bool valid = false;
+		ctype = nullptr;
+		typeDefaults = nullptr;
+
+		try {
+			bip::file_mapping journalMapping (journalPath.CStr(), bip::read_only);
+			journalRegion = bip::mapped_region(journalMapping, bip::read_only);
+
+			const char *jbegin = static_cast<const char *>(journalRegion.get_address());
+			const char *jend = jbegin + journalRegion.get_size();
+
+			if (jend - jbegin >= static_cast<ptrdiff_t>(sizeof(l_StateFileMagic)) && memcmp(jbegin, l_StateFileMagic, sizeof(l_StateFileMagic)) == 0) {
+				complete = ReadStateRecords(jbegin + sizeof(l_StateFileMagic), jend, [&valid, &snapshotId, &readRecord, &journalRead, journalSkip, jbegin](char kind, const char *rbegin, const char *rend) {
+					if (kind == StateRecordSnapshot) {
+						valid = String(rbegin, rend) == snapshotId;
+						return valid;
+					}
+
+					/* Records of a journal for another state file must not be replayed. */
+					if (!valid)
+						return false;
+
+					journalRead = rend - jbegin;
+
+					/* The type records are needed for the object records which follow them. */
+					if (journalRead > journalSkip || kind == StateRecordType)
+						readRecord(kind, rbegin, rend);
+
+					return true;
+				});
+			}
+
+			if (!valid) {
+				Log(LogNotice, "ConfigObject")
+					<< "Ignoring state journal '" << journalPath << "' which doesn't belong to the state file.";
+			} else if (!complete) {
+				Log(LogWarning, "ConfigObject")
+					<< "State journal '" << journalPath << "' is truncated, ignoring its last record.";
+			} else {
+				journalSize = journalRegion.get_size();
+			}
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "ConfigObject")
+				<< "Failed to replay state journal '" << journalPath << "': " << DiagnosticInformation(ex, false);
+
+			complete = false;
+		}
+
+		/* Appending to a damaged journal would lose the records after the damage, so a new state file is written instead. */
+		if (valid && !complete)
+			snapshotId = String();
+
+		/* While another process is still appending to the journal, a truncated last record is expected. */
+		if (!valid)
+			journalRead = 0;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock (l_StateFileMutex);
+		l_StateSnapshotId = snapshotId;
+		l_StateSnapshotSize = region.get_size();
+		l_StateJournalSize = journalSize;
+		l_RestoredSnapshotId = restoredId;
+		l_RestoredJournalSize = journalRead;
+	}
+
+	TaskGroup upq ("ConfigObject::RestoreObjects");
+
+	/* The records are split evenly among the threads regardless of their type,
+	 * the services alone usually outnumber all other objects together.
+	 */
+	upq.ParallelFor(objects, [](const PackedObject& packed) {
+		packed.Object = packed.CType->GetObject(std::string_view(packed.Name, packed.NameLength));
+	});
+
+	upq.Join();
+
+	/* Only the last record of an object is decoded. */
+	static const size_t noRecord = -1;
+	std::unordered_map<ConfigType *, std::vector<size_t>> lastRecords;
+	ConfigType *lastType = nullptr;
+	std::vector<size_t> *last = nullptr;
+	unsigned long restored = 0;
+
+	for (size_t i = 0; i < objects.size(); i++) {
+		const PackedObject& packed (objects[i]);
+
+		if (!packed.Object)
+			continue;
+
+		if (packed.CType != lastType) {
+			lastType = packed.CType;
+			last = &lastRecords[lastType];
+
+			if (last->empty())
+				last->resize(lastType->GetTypeIndexCount(), noRecord);
+		}
+
+		size_t index = packed.Object->GetTypeIndex();
+
+		if (index >= last->size())
+			last->resize(index + 1u, noRecord);
+
+		size_t& previous ((*last)[index]);
+
+		if (previous == noRecord)
+			restored++;
+		else
+			objects[previous].Object = nullptr;
+
+		previous = i;
+	}
+
+	upq.ParallelFor(objects, [attributeTypes](const PackedObject& packed) {
+		if (!packed.Object)
+			return;
+
+		Dictionary::Ptr update = UnpackObject(packed.Begin, packed.End);
+
+		if (packed.Defaults)
+			ResetDefaultFields(packed.Object, update, packed.Defaults, attributeTypes);
+
+		RestoreObject(packed.Object, update, attributeTypes);
+	});
+
+	upq.Join();
+
+	if (upq.HasExceptions())
+		upq.ReportExceptions("ConfigObject");
+
+	return restored;
+}
+
+/**
+ * Restores the state of the objects from a state file.
+ *
+ * @param filename The state file
+ * @param attributeTypes The attributes to restore
+ * @param incremental Only replay the newer journal records if the state file
+ *        is still the one which the last call restored
+ */
+void ConfigObject::RestoreObjects(const String& filename, int attributeTypes, bool incremental)
 {
 	if (!Utility::PathExists(filename))
 		return;
@@ -531,33 +1209,45 @@ void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
 		<< "Restoring program state from file '" << filename << "'";
 
 	std::fstream fp;
-	fp.open(filename.CStr(), std::ios_base::in);
+	fp.open(filename.CStr(), std::ios_base::in | std::ios_base::binary);
 
-	StdioStream::Ptr sfp = new StdioStream (&fp, false);
+	char magic[sizeof(l_StateFileMagic)];
+	bool packed = fp.read(magic, sizeof(magic)) && memcmp(magic, l_StateFileMagic, sizeof(magic)) == 0;
 
 	unsigned long restored = 0;
 
-	WorkQueue upq(25000, Configuration::Concurrency);
-	upq.SetName("ConfigObject::RestoreObjects");
+	if (packed) {
+		fp.close();
 
-	String message;
-	StreamReadContext src;
-	for (;;) {
-		StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+		restored = RestorePackedObjects(filename, attributeTypes, incremental);
+	} else {
+		/* State files written by older versions are JSON encoded. */
+		fp.clear();
+		fp.seekg(0);
 
-		if (srs == StatusEof)
-			break;
+		StdioStream::Ptr sfp = new StdioStream (&fp, false);
 
-		if (srs != StatusNewItem)
-			continue;
+		TaskGroup upq ("ConfigObject::RestoreObjects", 25000);
 
-		upq.Enqueue([message, attributeTypes]() { RestoreObject(message, attributeTypes); });
-		restored++;
-	}
+		String message;
+		StreamReadContext src;
+		for (;;) {
+			StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
 
-	sfp->Close();
+			if (srs == StatusEof)
+				break;
 
-	upq.Join();
+			if (srs != StatusNewItem)
+				continue;
+
+			upq.Enqueue([message, attributeTypes]() { RestoreObject(message, attributeTypes); });
+			restored++;
+		}
+
+		sfp->Close();
+
+		upq.Join();
+	}
 
 	unsigned long no_state = 0;
 
@@ -8,7 +8,11 @@
 #include "base/object.hpp"
 #include "base/type.hpp"
 #include "base/dictionary.hpp"
+#include "base/signal.hpp"
 #include <boost/signals2.hpp>
+#include <atomic>
+#include <cstdint>
+#include <vector>
 
 namespace icinga
 {
@@ -25,10 +29,12 @@ class ConfigObject : public ObjectImpl<ConfigObject>
 public:
 	DECLARE_OBJECT(ConfigObject);
 
-	static boost::signals2::signal<void (const ConfigObject::Ptr&)> OnStateChanged;
+	static Signal<void (const ConfigObject::Ptr&)> OnStateChanged;
 
 	bool IsActive() const;
 	bool IsPaused() const;
+	unsigned long GetNameHash() const;
+	size_t GetTypeIndex() const;
 
 	void SetExtension(const String& key, const Value& value);
 	Value GetExtension(const String& key);
@@ -61,6 +67,8 @@ public:
 
 	Dictionary::Ptr GetSourceLocation() const override;
 
+	void MarkStateDirty() override;
+
 	template<typename T>
 	static intrusive_ptr<T> GetObject(const String& name)
 	{
@@ -72,7 +80,10 @@ public:
 	static ConfigObject::Ptr GetObject(const String& type, const String& name);
 
 	static void DumpObjects(const String& filename, int attributeTypes = FAState);
-	static void RestoreObjects(const String& filename, int attributeTypes = FAState);
+	static void DumpDirtyObjects(const String& filename);
+	static void RestoreObjects(const String& filename, int attributeTypes = FAState, bool incremental = false);
+	static String GetStateJournalPath(const String& filename);
+	static uint_least64_t GetChangeCount();
 	static void StopObjects();
 
 	static void DumpModifiedAttributes(const std::function<void(const ConfigObject::Ptr&, const String&, const Value&)>& callback);
@@ -81,8 +92,18 @@ public:
 
 private:
 	ConfigObject::Ptr m_Zone;
+	std::atomic<bool> m_StateDirty { false };
+	mutable std::atomic<unsigned long> m_NameHash { 0 };
+	std::atomic<size_t> m_TypeIndex { static_cast<size_t>(-1) };
+
+	friend class ConfigType;
+
+	static std::vector<ConfigObject::Ptr> TakeDirtyObjects();
+	static void WriteSnapshot(const String& filename, int attributeTypes);
 
 	static void RestoreObject(const String& message, int attributeTypes);
+	static void RestoreObject(const ConfigObject::Ptr& object, const Dictionary::Ptr& update, int attributeTypes);
+	static unsigned long RestorePackedObjects(const String& filename, int attributeTypes, bool incremental);
 };
 
 #define DECLARE_OBJECTNAME(klass)						\
@@ -0,0 +1,98 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef CONFIGOBJECTTABLE_H
+#define CONFIGOBJECTTABLE_H
+
+#include "base/i2-base.hpp"
+#include "base/configobject.hpp"
+#include "base/exception.hpp"
+#include <stdexcept>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A side table with a T for every registered object of one config type, indexed by
+ * ConfigObject#GetTypeIndex(). Unlike a std::map<Checkable::Ptr, T> a lookup is an array access and
+ * the table doesn't keep the objects alive. ConfigObjectTable<bool> is a bitmap. Values of unregistered
+ * objects are not reset automatically, their index may be reused by the next registered object.
+ *
+ * Not thread-safe, just like the std::map it replaces.
+ *
+ * @ingroup base
+ */
+template<typename T>
+class ConfigObjectTable
+{
+public:
+	typedef typename std::vector<T>::reference Reference;
+	typedef typename std::vector<T>::const_reference ConstReference;
+
+	ConfigObjectTable(T defaultValue = T())
+		: m_Default(std::move(defaultValue))
+	{ }
+
+	/**
+	 * Returns the object's value, growing the table if necessary.
+	 */
+	Reference operator[](const ConfigObject *object)
+	{
+		auto index (GetIndex(object));
+
+		if (index >= m_Values.size())
+			m_Values.resize(index + 1u, m_Default);
+
+		return m_Values[index];
+	}
+
+	/**
+	 * Returns the object's value, or the default value if it was never set.
+	 */
+	ConstReference Get(const ConfigObject *object) const
+	{
+		auto index (GetIndex(object));
+
+		return index < m_Values.size() ? m_Values[index] : m_Default;
+	}
+
+	void Reset(const ConfigObject *object)
+	{
+		auto index (GetIndex(object));
+
+		if (index < m_Values.size())
+			m_Values[index] = m_Default;
+	}
+
+	void Clear()
+	{
+		m_Values.clear();
+	}
+
+	/**
+	 * Pre-allocates the table for all objects of a type, see ConfigType#GetTypeIndexCount().
+	 */
+	void Reserve(size_t count)
+	{
+		if (count > m_Values.size())
+			m_Values.resize(count, m_Default);
+	}
+
+private:
+	std::vector<T> m_Values;
+	T m_Default;
+
+	static size_t GetIndex(const ConfigObject *object)
+	{
+		auto index (object->GetTypeIndex());
+
+		if (index == static_cast<size_t>(-1))
+			BOOST_THROW_EXCEPTION(std::invalid_argument(("Object '" + object->GetName() + "' isn't registered.").GetData()));
+
+		return index;
+	}
+};
+
+}
+
+#endif /* CONFIGOBJECTTABLE_H */
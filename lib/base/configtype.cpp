@@ -10,6 +10,11 @@ ConfigType::~ConfigType()
 { }
 
 ConfigObject::Ptr ConfigType::GetObject(const String& name) const
+{
+	return GetObject(std::string_view(name.GetData()));
+}
+
+ConfigObject::Ptr ConfigType::GetObject(std::string_view name) const
 {
 	std::shared_lock<decltype(m_Mutex)> lock (m_Mutex);
 
@@ -18,31 +23,43 @@ ConfigObject::Ptr ConfigType::GetObject(const String& name) const
 	if (nt == m_ObjectMap.end())
 		return nullptr;
 
-	return nt->second;
+	return nt->second.Object;
 }
 
 void ConfigType::RegisterObject(const ConfigObject::Ptr& object)
 {
-	String name = object->GetName();
+	auto name (std::make_unique<const String>(object->GetName()));
 
 	{
 		std::unique_lock<decltype(m_Mutex)> lock (m_Mutex);
 
-		auto it = m_ObjectMap.find(name);
+		auto it = m_ObjectMap.find(name->GetData());
 
 		if (it != m_ObjectMap.end()) {
-			if (it->second == object)
+			if (it->second.Object == object)
 				return;
 
 			auto *type = dynamic_cast<Type *>(this);
 
-			BOOST_THROW_EXCEPTION(ScriptError("An object with type '" + type->GetName() + "' and name '" + name + "' already exists (" +
-				Convert::ToString(it->second->GetDebugInfo()) + "), new declaration: " + Convert::ToString(object->GetDebugInfo()),
+			BOOST_THROW_EXCEPTION(ScriptError("An object with type '" + type->GetName() + "' and name '" + *name + "' already exists (" +
+				Convert::ToString(it->second.Object->GetDebugInfo()) + "), new declaration: " + Convert::ToString(object->GetDebugInfo()),
 				object->GetDebugInfo()));
 		}
 
-		m_ObjectMap[name] = object;
+		std::string_view key (name->GetData());
+		m_ObjectMap.emplace(key, ObjectEntry{std::move(name), object});
 		m_ObjectVector.push_back(object);
+
+		size_t index;
+
+		if (m_FreeTypeIndexes.empty()) {
+			index = m_TypeIndexCount++;
+		} else {
+			index = m_FreeTypeIndexes.back();
+			m_FreeTypeIndexes.pop_back();
+		}
+
+		object->m_TypeIndex.store(index, std::memory_order_relaxed);
 	}
 }
 
@@ -53,8 +70,16 @@ void ConfigType::UnregisterObject(const ConfigObject::Ptr& object)
 	{
 		std::unique_lock<decltype(m_Mutex)> lock (m_Mutex);
 
-		m_ObjectMap.erase(name);
+		auto it = m_ObjectMap.find(name.GetData());
+
+		if (it != m_ObjectMap.end() && it->second.Object == object)
+			m_ObjectMap.erase(it);
 		m_ObjectVector.erase(std::remove(m_ObjectVector.begin(), m_ObjectVector.end(), object), m_ObjectVector.end());
+
+		size_t index = object->m_TypeIndex.exchange(-1, std::memory_order_relaxed);
+
+		if (index != static_cast<size_t>(-1))
+			m_FreeTypeIndexes.push_back(index);
 	}
 }
 
@@ -74,3 +99,12 @@ int ConfigType::GetObjectCount() const
 	std::shared_lock<decltype(m_Mutex)> lock (m_Mutex);
 	return m_ObjectVector.size();
 }
+
+/**
+ * All registered objects' ConfigObject#GetTypeIndex() are lower than this.
+ */
+size_t ConfigType::GetTypeIndexCount() const
+{
+	std::shared_lock<decltype(m_Mutex)> lock (m_Mutex);
+	return m_TypeIndexCount;
+}
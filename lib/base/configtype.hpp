@@ -7,7 +7,9 @@
 #include "base/object.hpp"
 #include "base/type.hpp"
 #include "base/dictionary.hpp"
+#include <memory>
 #include <shared_mutex>
+#include <string_view>
 #include <unordered_map>
 
 namespace icinga
@@ -21,6 +23,12 @@ public:
 	virtual ~ConfigType();
 
 	intrusive_ptr<ConfigObject> GetObject(const String& name) const;
+	intrusive_ptr<ConfigObject> GetObject(std::string_view name) const;
+
+	intrusive_ptr<ConfigObject> GetObject(const char *name) const
+	{
+		return GetObject(std::string_view(name));
+	}
 
 	void RegisterObject(const intrusive_ptr<ConfigObject>& object);
 	void UnregisterObject(const intrusive_ptr<ConfigObject>& object);
@@ -47,14 +55,24 @@ for (const auto& object : objects) {
 	}
 
 	int GetObjectCount() const;
+	size_t GetTypeIndexCount() const;
 
 private:
-	typedef std::unordered_map<String, intrusive_ptr<ConfigObject> > ObjectMap;
+	struct ObjectEntry
+	{
+		std::unique_ptr<const String> Name; /**< What the key points to */
+		intrusive_ptr<ConfigObject> Object;
+	};
+
+	/* Keyed by views, so that looking up e.g. a name in a buffer doesn't need a temporary String. */
+	typedef std::unordered_map<std::string_view, ObjectEntry> ObjectMap;
 	typedef std::vector<intrusive_ptr<ConfigObject> > ObjectVector;
 
 	mutable std::shared_timed_mutex m_Mutex;
 	ObjectMap m_ObjectMap;
 	ObjectVector m_ObjectVector;
+	std::vector<size_t> m_FreeTypeIndexes;
+	size_t m_TypeIndexCount{0};
 
 	static std::vector<intrusive_ptr<ConfigObject> > GetObjectsHelper(Type *type);
 };
@@ -3,6 +3,7 @@
 #include "base/configuration.hpp"
 #include "base/configuration-ti.cpp"
 #include "base/exception.hpp"
+#include "base/signalprofiler.hpp"
 
 using namespace icinga;
 
@@ -32,16 +33,19 @@ String Configuration::DataDir;
 String Configuration::EventEngine;
 String Configuration::IncludeConfDir;
 String Configuration::InitRunDir;
+String Configuration::IoEnginePlacement{"shared"};
 String Configuration::LogDir;
 String Configuration::ModAttrPath;
 String Configuration::ObjectsPath;
 String Configuration::PidPath;
 String Configuration::PkgDataDir;
 String Configuration::PrefixDir;
+bool Configuration::ProfileSignalHandlers{false};
 String Configuration::ProgramData;
 int Configuration::RLimitFiles;
 int Configuration::RLimitProcesses;
 int Configuration::RLimitStack;
+bool Configuration::ReleaseObjectConfig{false};
 String Configuration::RunAsGroup;
 String Configuration::RunAsUser;
 String Configuration::SpoolDir;
@@ -168,6 +172,16 @@ void Configuration::SetInitRunDir(const String& val, bool suppress_events, const
 	HandleUserWrite("InitRunDir", &Configuration::InitRunDir, val, m_ReadOnly);
 }
 
+String Configuration::GetIoEnginePlacement() const
+{
+	return Configuration::IoEnginePlacement;
+}
+
+void Configuration::SetIoEnginePlacement(const String& val, bool suppress_events, const Value& cookie)
+{
+	HandleUserWrite("IoEnginePlacement", &Configuration::IoEnginePlacement, val, m_ReadOnly);
+}
+
 String Configuration::GetLogDir() const
 {
 	return Configuration::LogDir;
@@ -228,6 +242,17 @@ void Configuration::SetPrefixDir(const String& val, bool suppress_events, const
 	HandleUserWrite("PrefixDir", &Configuration::PrefixDir, val, m_ReadOnly);
 }
 
+bool Configuration::GetProfileSignalHandlers() const
+{
+	return Configuration::ProfileSignalHandlers;
+}
+
+void Configuration::SetProfileSignalHandlers(bool val, bool suppress_events, const Value& cookie)
+{
+	HandleUserWrite("ProfileSignalHandlers", &Configuration::ProfileSignalHandlers, val, m_ReadOnly);
+	SignalProfiler::SetEnabled(Configuration::ProfileSignalHandlers);
+}
+
 String Configuration::GetProgramData() const
 {
 	return Configuration::ProgramData;
@@ -268,6 +293,16 @@ void Configuration::SetRLimitStack(int val, bool suppress_events, const Value& c
 	HandleUserWrite("RLimitStack", &Configuration::RLimitStack, val, m_ReadOnly);
 }
 
+bool Configuration::GetReleaseObjectConfig() const
+{
+	return Configuration::ReleaseObjectConfig;
+}
+
+void Configuration::SetReleaseObjectConfig(bool val, bool suppress_events, const Value& cookie)
+{
+	HandleUserWrite("ReleaseObjectConfig", &Configuration::ReleaseObjectConfig, val, m_ReadOnly);
+}
+
 String Configuration::GetRunAsGroup() const
 {
 	return Configuration::RunAsGroup;
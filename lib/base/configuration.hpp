@@ -49,6 +49,9 @@ public:
 	String GetInitRunDir() const override;
 	void SetInitRunDir(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
+	String GetIoEnginePlacement() const override;
+	void SetIoEnginePlacement(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
+
 	String GetLogDir() const override;
 	void SetLogDir(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
@@ -67,6 +70,9 @@ public:
 	String GetPrefixDir() const override;
 	void SetPrefixDir(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
+	bool GetProfileSignalHandlers() const override;
+	void SetProfileSignalHandlers(bool value, bool suppress_events = false, const Value& cookie = Empty) override;
+
 	String GetProgramData() const override;
 	void SetProgramData(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
@@ -79,6 +85,9 @@ public:
 	int GetRLimitStack() const override;
 	void SetRLimitStack(int value, bool suppress_events = false, const Value& cookie = Empty) override;
 
+	bool GetReleaseObjectConfig() const override;
+	void SetReleaseObjectConfig(bool value, bool suppress_events = false, const Value& cookie = Empty) override;
+
 	String GetRunAsGroup() const override;
 	void SetRunAsGroup(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
 
@@ -124,16 +133,19 @@ public:
 	static String EventEngine;
 	static String IncludeConfDir;
 	static String InitRunDir;
+	static String IoEnginePlacement;
 	static String LogDir;
 	static String ModAttrPath;
 	static String ObjectsPath;
 	static String PidPath;
 	static String PkgDataDir;
 	static String PrefixDir;
+	static bool ProfileSignalHandlers;
 	static String ProgramData;
 	static int RLimitFiles;
 	static int RLimitProcesses;
 	static int RLimitStack;
+	static bool ReleaseObjectConfig;
 	static String RunAsGroup;
 	static String RunAsUser;
 	static String SpoolDir;
@@ -0,0 +1,100 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef DEADLINEQUEUE_H
+#define DEADLINEQUEUE_H
+
+#include "base/i2-base.hpp"
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A thread-safe set of items ordered by a point in time, e.g. when they expire.
+ *
+ * Timer handlers take only the items which are due from it instead of scanning all objects.
+ * Every item is in the queue at most once, setting its deadline again moves it.
+ *
+ * @ingroup base
+ */
+template<typename T, typename Hash = std::hash<T>>
+class DeadlineQueue
+{
+public:
+	DeadlineQueue() = default;
+
+	DeadlineQueue(const DeadlineQueue&) = delete;
+	DeadlineQueue& operator=(const DeadlineQueue&) = delete;
+
+	/**
+	 * Adds the item or moves it to the new deadline.
+	 */
+	void Set(const T& item, double deadline)
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		auto it (m_Items.find(item));
+
+		if (it != m_Items.end()) {
+			m_ByDeadline.erase(it->second);
+			it->second = m_ByDeadline.emplace(deadline, item);
+		} else {
+			m_Items.emplace(item, m_ByDeadline.emplace(deadline, item));
+		}
+	}
+
+	void Remove(const T& item)
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		auto it (m_Items.find(item));
+
+		if (it != m_Items.end()) {
+			m_ByDeadline.erase(it->second);
+			m_Items.erase(it);
+		}
+	}
+
+	/**
+	 * Removes and returns the items with a deadline before now, the earliest first.
+	 */
+	std::vector<T> PopDue(double now)
+	{
+		std::vector<T> due;
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		while (!m_ByDeadline.empty() && m_ByDeadline.begin()->first < now) {
+			auto first (m_ByDeadline.begin());
+
+			due.emplace_back(std::move(first->second));
+			m_Items.erase(due.back());
+			m_ByDeadline.erase(first);
+		}
+
+		return due;
+	}
+
+	size_t GetLength() const
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		return m_Items.size();
+	}
+
+private:
+	typedef std::multimap<double, T> DeadlineMap;
+
+	mutable std::mutex m_Mutex;
+	DeadlineMap m_ByDeadline;
+	std::unordered_map<T, typename DeadlineMap::iterator, Hash> m_Items;
+};
+
+}
+
+#endif /* DEADLINEQUEUE_H */
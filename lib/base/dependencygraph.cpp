@@ -1,24 +1,47 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "base/dependencygraph.hpp"
+#include <algorithm>
+#include <cstdint>
 
 using namespace icinga;
 
-std::mutex DependencyGraph::m_Mutex;
-std::map<Object *, std::map<Object *, int> > DependencyGraph::m_Dependencies;
+DependencyGraph::Shard DependencyGraph::m_Shards[64];
+
+DependencyGraph::Shard& DependencyGraph::GetShard(Object *child)
+{
+	/* The lowest bits are the same for all objects due to their alignment. */
+	auto address (reinterpret_cast<uintptr_t>(child));
+
+	return m_Shards[((address >> 4u) ^ (address >> 10u)) % (sizeof(m_Shards) / sizeof(m_Shards[0]))];
+}
 
 void DependencyGraph::AddDependency(Object *parent, Object *child)
 {
-	std::unique_lock<std::mutex> lock(m_Mutex);
-	m_Dependencies[child][parent]++;
+	auto& shard (GetShard(child));
+	std::unique_lock<std::mutex> lock(shard.Mutex);
+
+	auto& refs = shard.Dependencies[child];
+	auto it = std::find_if(refs.begin(), refs.end(), [parent](const std::pair<Object *, int>& ref) { return ref.first == parent; });
+
+	if (it == refs.end())
+		refs.emplace_back(parent, 1);
+	else
+		it->second++;
 }
 
 void DependencyGraph::RemoveDependency(Object *parent, Object *child)
 {
-	std::unique_lock<std::mutex> lock(m_Mutex);
+	auto& shard (GetShard(child));
+	std::unique_lock<std::mutex> lock(shard.Mutex);
+
+	auto refsIt = shard.Dependencies.find(child);
 
-	auto& refs = m_Dependencies[child];
-	auto it = refs.find(parent);
+	if (refsIt == shard.Dependencies.end())
+		return;
+
+	auto& refs = refsIt->second;
+	auto it = std::find_if(refs.begin(), refs.end(), [parent](const std::pair<Object *, int>& ref) { return ref.first == parent; });
 
 	if (it == refs.end())
 		return;
@@ -29,19 +52,21 @@ void DependencyGraph::RemoveDependency(Object *parent, Object *child)
 		refs.erase(it);
 
 	if (refs.empty())
-		m_Dependencies.erase(child);
+		shard.Dependencies.erase(refsIt);
 }
 
 std::vector<Object::Ptr> DependencyGraph::GetParents(const Object::Ptr& child)
 {
 	std::vector<Object::Ptr> objects;
 
-	std::unique_lock<std::mutex> lock(m_Mutex);
-	auto it = m_Dependencies.find(child.get());
+	auto& shard (GetShard(child.get()));
+	std::unique_lock<std::mutex> lock(shard.Mutex);
+	auto it = shard.Dependencies.find(child.get());
+
+	if (it != shard.Dependencies.end()) {
+		objects.reserve(it->second.size());
 
-	if (it != m_Dependencies.end()) {
-		typedef std::pair<Object *, int> kv_pair;
-		for (const kv_pair& kv : it->second) {
+		for (auto& kv : it->second) {
 			objects.emplace_back(kv.first);
 		}
 	}
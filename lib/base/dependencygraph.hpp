@@ -5,8 +5,10 @@
 
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
-#include <map>
 #include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace icinga {
 
@@ -25,8 +27,21 @@ public:
 private:
 	DependencyGraph();
 
-	static std::mutex m_Mutex;
-	static std::map<Object *, std::map<Object *, int> > m_Dependencies;
+	/**
+	 * A part of the graph with its own lock, so that objects being created or removed concurrently
+	 * rarely wait for each other. Every child with its parents belongs to exactly one of them.
+	 */
+	struct Shard
+	{
+		std::mutex Mutex;
+
+		/* By child, its parents and how often each of them refers to it */
+		std::unordered_map<Object *, std::vector<std::pair<Object *, int>>> Dependencies;
+	};
+
+	static Shard m_Shards[64];
+
+	static Shard& GetShard(Object *child);
 };
 
 }
@@ -5,6 +5,7 @@
 #include "base/debug.hpp"
 #include "base/primitivetype.hpp"
 #include "base/configwriter.hpp"
+#include <algorithm>
 #include <sstream>
 
 using namespace icinga;
@@ -13,21 +14,180 @@ template class std::map<String, Value>;
 
 REGISTER_PRIMITIVE_TYPE(Dictionary, Object, Dictionary::GetPrototype());
 
+static inline bool FlatKeyLess(const Dictionary::Pair& kv, const String& key)
+{
+	return kv.first < key;
+}
+
 Dictionary::Dictionary(const DictionaryData& other)
 {
-	for (const auto& kv : other)
-		m_Data.insert(kv);
+	InitData(DictionaryData(other));
 }
 
 Dictionary::Dictionary(DictionaryData&& other)
 {
-	for (auto& kv : other)
-		m_Data.insert(std::move(kv));
+	InitData(std::move(other));
 }
 
 Dictionary::Dictionary(std::initializer_list<Dictionary::Pair> init)
-	: m_Data(init)
-{ }
+{
+	InitData(DictionaryData(init.begin(), init.end()));
+}
+
+/**
+ * Fills a new dictionary. Like with std::map#insert() the first occurrence of a key wins.
+ *
+ * @param data The key-value pairs.
+ */
+void Dictionary::InitData(DictionaryData&& data)
+{
+	if (data.size() > FlatThreshold) {
+		m_MapData.reset(new std::map<String, Value>());
+
+		for (auto& kv : data)
+			m_MapData->insert(std::move(kv));
+
+		return;
+	}
+
+	std::stable_sort(data.begin(), data.end(), [](const DictionaryData::value_type& a, const DictionaryData::value_type& b) {
+		return a.first < b.first;
+	});
+
+	m_FlatData.reserve(data.size());
+
+	for (auto& kv : data) {
+		if (m_FlatData.empty() || m_FlatData.back().first != kv.first)
+			m_FlatData.emplace_back(std::move(kv.first), std::move(kv.second));
+	}
+}
+
+/**
+ * Looks up a key. m_DataMutex must be locked.
+ *
+ * @param key The key.
+ * @returns The value's address or nullptr if the key was not found.
+ */
+const Value *Dictionary::FindUnlocked(const String& key) const
+{
+	if (m_MapData) {
+		auto it (m_MapData->find(key));
+
+		return it == m_MapData->end() ? nullptr : &it->second;
+	}
+
+	auto it (std::lower_bound(m_FlatData.begin(), m_FlatData.end(), key, FlatKeyLess));
+
+	return it == m_FlatData.end() || it->first != key ? nullptr : &it->second;
+}
+
+/**
+ * Sets a value. m_DataMutex must be locked exclusively.
+ *
+ * @param key The key.
+ * @param value The value.
+ */
+void Dictionary::SetUnlocked(const String& key, Value&& value)
+{
+	if (m_MapData) {
+		(*m_MapData)[key] = std::move(value);
+		return;
+	}
+
+	auto it (std::lower_bound(m_FlatData.begin(), m_FlatData.end(), key, FlatKeyLess));
+
+	if (it != m_FlatData.end() && it->first == key) {
+		it->second = std::move(value);
+		return;
+	}
+
+	if (m_FlatData.size() >= FlatThreshold) {
+		m_MapData.reset(new std::map<String, Value>());
+
+		for (auto& kv : m_FlatData)
+			m_MapData->emplace_hint(m_MapData->end(), std::move(kv));
+
+		std::vector<Pair>().swap(m_FlatData);
+
+		m_MapData->emplace(key, std::move(value));
+		return;
+	}
+
+	InsertFlatUnlocked(it - m_FlatData.begin(), key, std::move(value));
+}
+
+/**
+ * Inserts a new element into m_FlatData. m_DataMutex must be locked exclusively.
+ *
+ * @param pos The element's position according to the sort order.
+ * @param key The key.
+ * @param value The value.
+ */
+void Dictionary::InsertFlatUnlocked(SizeType pos, const String& key, Value&& value)
+{
+	SizeType size = m_FlatData.size();
+
+	if (pos == size && size < m_FlatData.capacity()) {
+		m_FlatData.emplace_back(key, std::move(value));
+		return;
+	}
+
+	/* The keys are const, so the elements can't be shifted; move them into a new vector instead. */
+	std::vector<Pair> data;
+	data.reserve(std::max(m_FlatData.capacity(), std::min(FlatThreshold, size * 2 + 1)));
+
+	for (SizeType i = 0; i < pos; i++)
+		data.emplace_back(std::move(m_FlatData[i]));
+
+	data.emplace_back(key, std::move(value));
+
+	for (SizeType i = pos; i < size; i++)
+		data.emplace_back(std::move(m_FlatData[i]));
+
+	m_FlatData.swap(data);
+}
+
+/**
+ * Removes an element from m_FlatData. m_DataMutex must be locked exclusively.
+ *
+ * @param pos The element's position.
+ */
+void Dictionary::EraseFlatUnlocked(SizeType pos)
+{
+	SizeType size = m_FlatData.size();
+
+	if (pos + 1 == size) {
+		m_FlatData.pop_back();
+		return;
+	}
+
+	std::vector<Pair> data;
+	data.reserve(m_FlatData.capacity());
+
+	for (SizeType i = 0; i < size; i++) {
+		if (i != pos)
+			data.emplace_back(std::move(m_FlatData[i]));
+	}
+
+	m_FlatData.swap(data);
+}
+
+/**
+ * Calls the specified function for every element in key order. m_DataMutex must be locked.
+ *
+ * @param func The function.
+ */
+template<typename F>
+void Dictionary::ForEachUnlocked(const F& func) const
+{
+	if (m_MapData) {
+		for (const Pair& kv : *m_MapData)
+			func(kv);
+	} else {
+		for (const Pair& kv : m_FlatData)
+			func(kv);
+	}
+}
 
 /**
  * Retrieves a value from a dictionary.
@@ -37,14 +197,14 @@ Dictionary::Dictionary(std::initializer_list<Dictionary::Pair> init)
  */
 Value Dictionary::Get(const String& key) const
 {
-	std::shared_lock<std::shared_timed_mutex> lock (m_DataMutex);
+	auto lock (ReadLockUnlessFrozen());
 
-	auto it = m_Data.find(key);
+	auto value (FindUnlocked(key));
 
-	if (it == m_Data.end())
+	if (!value)
 		return Empty;
 
-	return it->second;
+	return *value;
 }
 
 /**
@@ -56,14 +216,14 @@ Value Dictionary::Get(const String& key) const
  */
 bool Dictionary::Get(const String& key, Value *result) const
 {
-	std::shared_lock<std::shared_timed_mutex> lock (m_DataMutex);
+	auto lock (ReadLockUnlessFrozen());
 
-	auto it = m_Data.find(key);
+	auto value (FindUnlocked(key));
 
-	if (it == m_Data.end())
+	if (!value)
 		return false;
 
-	*result = it->second;
+	*result = *value;
 	return true;
 }
 
@@ -75,10 +235,9 @@ bool Dictionary::Get(const String& key, Value *result) const
  */
 const Value * Dictionary::GetRef(const String& key) const
 {
-	std::shared_lock<std::shared_timed_mutex> lock (m_DataMutex);
-	auto it (m_Data.find(key));
+	auto lock (ReadLockUnlessFrozen());
 
-	return it == m_Data.end() ? nullptr : &it->second;
+	return FindUnlocked(key);
 }
 
 /**
@@ -91,12 +250,12 @@ const Value * Dictionary::GetRef(const String& key) const
 void Dictionary::Set(const String& key, Value value, bool overrideFrozen)
 {
 	ObjectLock olock(this);
-	std::unique_lock<std::shared_timed_mutex> lock (m_DataMutex);
+	std::unique_lock<std::shared_mutex> lock (m_DataMutex);
 
 	if (m_Frozen && !overrideFrozen)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Value in dictionary must not be modified."));
 
-	m_Data[key] = std::move(value);
+	SetUnlocked(key, std::move(value));
 }
 
 /**
@@ -106,9 +265,9 @@ void Dictionary::Set(const String& key, Value value, bool overrideFrozen)
  */
 size_t Dictionary::GetLength() const
 {
-	std::shared_lock<std::shared_timed_mutex> lock (m_DataMutex);
+	auto lock (ReadLockUnlessFrozen());
 
-	return m_Data.size();
+	return m_MapData ? m_MapData->size() : m_FlatData.size();
 }
 
 /**
@@ -119,37 +278,43 @@ size_t Dictionary::GetLength() const
  */
 bool Dictionary::Contains(const String& key) const
 {
-	std::shared_lock<std::shared_timed_mutex> lock (m_DataMutex);
+	auto lock (ReadLockUnlessFrozen());
 
-	return (m_Data.find(key) != m_Data.end());
+	return FindUnlocked(key);
 }
 
 /**
  * Returns an iterator to the beginning of the dictionary.
  *
- * Note: Caller must hold the object lock while using the iterator.
+ * Note: Caller must hold the object lock while using the iterator (unless the dictionary is frozen).
  *
  * @returns An iterator.
  */
 Dictionary::Iterator Dictionary::Begin()
 {
-	ASSERT(OwnsLock());
+	ASSERT(IsFrozen() || OwnsLock());
+
+	if (m_MapData)
+		return Iterator(m_MapData->begin());
 
-	return m_Data.begin();
+	return Iterator(m_FlatData.data());
 }
 
 /**
  * Returns an iterator to the end of the dictionary.
  *
- * Note: Caller must hold the object lock while using the iterator.
+ * Note: Caller must hold the object lock while using the iterator (unless the dictionary is frozen).
  *
  * @returns An iterator.
  */
 Dictionary::Iterator Dictionary::End()
 {
-	ASSERT(OwnsLock());
+	ASSERT(IsFrozen() || OwnsLock());
+
+	if (m_MapData)
+		return Iterator(m_MapData->end());
 
-	return m_Data.end();
+	return Iterator(m_FlatData.data() + m_FlatData.size());
 }
 
 /**
@@ -160,12 +325,15 @@ Dictionary::Iterator Dictionary::End()
 void Dictionary::Remove(Dictionary::Iterator it)
 {
 	ASSERT(OwnsLock());
-	std::unique_lock<std::shared_timed_mutex> lock (m_DataMutex);
+	std::unique_lock<std::shared_mutex> lock (m_DataMutex);
 
 	if (m_Frozen)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
 
-	m_Data.erase(it);
+	if (m_MapData)
+		m_MapData->erase(it.m_MapIt);
+	else
+		EraseFlatUnlocked(it.m_FlatIt - m_FlatData.data());
 }
 
 /**
@@ -176,18 +344,22 @@ void Dictionary::Remove(Dictionary::Iterator it)
 void Dictionary::Remove(const String& key)
 {
 	ObjectLock olock(this);
-	std::unique_lock<std::shared_timed_mutex> lock (m_DataMutex);
+	std::unique_lock<std::shared_mutex> lock (m_DataMutex);
 
 	if (m_Frozen)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
 
-	Dictionary::Iterator it;
-	it = m_Data.find(key);
+	if (m_MapData) {
+		m_MapData->erase(key);
+		return;
+	}
+
+	auto it (std::lower_bound(m_FlatData.begin(), m_FlatData.end(), key, FlatKeyLess));
 
-	if (it == m_Data.end())
+	if (it == m_FlatData.end() || it->first != key)
 		return;
 
-	m_Data.erase(it);
+	EraseFlatUnlocked(it - m_FlatData.begin());
 }
 
 /**
@@ -196,21 +368,22 @@ void Dictionary::Remove(const String& key)
 void Dictionary::Clear()
 {
 	ObjectLock olock(this);
-	std::unique_lock<std::shared_timed_mutex> lock (m_DataMutex);
+	std::unique_lock<std::shared_mutex> lock (m_DataMutex);
 
 	if (m_Frozen)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
 
-	m_Data.clear();
+	m_FlatData.clear();
+	m_MapData.reset();
 }
 
 void Dictionary::CopyTo(const Dictionary::Ptr& dest) const
 {
-	std::shared_lock<std::shared_timed_mutex> lock (m_DataMutex);
+	auto lock (ReadLockUnlessFrozen());
 
-	for (const Dictionary::Pair& kv : m_Data) {
+	ForEachUnlocked([&dest](const Pair& kv) {
 		dest->Set(kv.first, kv.second);
-	}
+	});
 }
 
 /**
@@ -236,13 +409,13 @@ Object::Ptr Dictionary::Clone() const
 	DictionaryData dict;
 
 	{
-		std::shared_lock<std::shared_timed_mutex> lock (m_DataMutex);
+		auto lock (ReadLockUnlessFrozen());
 
 		dict.reserve(GetLength());
 
-		for (const Dictionary::Pair& kv : m_Data) {
+		ForEachUnlocked([&dict](const Pair& kv) {
 			dict.emplace_back(kv.first, kv.second.Clone());
-		}
+		});
 	}
 
 	return new Dictionary(std::move(dict));
@@ -256,13 +429,13 @@ Object::Ptr Dictionary::Clone() const
  */
 std::vector<String> Dictionary::GetKeys() const
 {
-	std::shared_lock<std::shared_timed_mutex> lock (m_DataMutex);
+	auto lock (ReadLockUnlessFrozen());
 
 	std::vector<String> keys;
 
-	for (const Dictionary::Pair& kv : m_Data) {
+	ForEachUnlocked([&keys](const Pair& kv) {
 		keys.push_back(kv.first);
-	}
+	});
 
 	return keys;
 }
@@ -274,10 +447,48 @@ String Dictionary::ToString() const
 	return msgbuf.str();
 }
 
+/**
+ * Prevents any further modification (except with overrideFrozen, which mustn't be used on
+ * frozen dictionaries anymore once they're shared with other threads as those don't lock them).
+ */
 void Dictionary::Freeze()
 {
 	ObjectLock olock(this);
-	m_Frozen = true;
+	std::unique_lock<std::shared_mutex> lock (m_DataMutex);
+
+	m_Frozen.store(true, std::memory_order_release);
+}
+
+bool Dictionary::IsFrozen() const
+{
+	return m_Frozen.load(std::memory_order_acquire);
+}
+
+/**
+ * Returns a dictionary with the current elements which won't change anymore.
+ * That's this dictionary itself if it's frozen, otherwise a frozen shallow copy of it.
+ *
+ * @returns A frozen dictionary.
+ */
+Dictionary::Ptr Dictionary::Snapshot() const
+{
+	if (IsFrozen())
+		return const_cast<Dictionary *>(this);
+
+	Dictionary::Ptr snapshot = ShallowClone();
+	snapshot->Freeze();
+	return snapshot;
+}
+
+/**
+ * Locks m_DataMutex for reading, unless we're frozen.
+ */
+std::shared_lock<std::shared_mutex> Dictionary::ReadLockUnlessFrozen() const
+{
+	if (IsFrozen())
+		return std::shared_lock<std::shared_mutex>();
+
+	return std::shared_lock<std::shared_mutex>(m_DataMutex);
 }
 
 Value Dictionary::GetFieldByName(const String& field, bool, const DebugInfo& debugInfo) const
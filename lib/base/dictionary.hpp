@@ -5,9 +5,12 @@
 
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
+#include "base/objectpool.hpp"
 #include "base/value.hpp"
 #include <boost/range/iterator.hpp>
+#include <iterator>
 #include <map>
+#include <memory>
 #include <shared_mutex>
 #include <vector>
 
@@ -19,22 +22,115 @@ typedef std::vector<std::pair<String, Value> > DictionaryData;
 /**
  * A container that holds key-value pairs.
  *
+ * Small dictionaries keep their elements in a sorted vector, they switch over to
+ * a std::map once they grow beyond FlatThreshold elements. Either way elements are
+ * iterated over in key order. Adding or removing keys invalidates all iterators.
+ *
+ * A frozen dictionary can't be modified anymore, so it's read without any locking
+ * (including iterating over it) and shared instead of being copied by Snapshot().
+ * Clone() still returns an unfrozen deep copy.
+ *
  * @ingroup base
  */
 class Dictionary final : public Object
 {
 public:
 	DECLARE_OBJECT(Dictionary);
-
-	/**
-	 * An iterator that can be used to iterate over dictionary elements.
-	 */
-	typedef std::map<String, Value>::iterator Iterator;
+	DECLARE_POOLED_ALLOCATION();
 
 	typedef std::map<String, Value>::size_type SizeType;
 
 	typedef std::map<String, Value>::value_type Pair;
 
+	/**
+	 * The maximum number of elements which are kept in the sorted vector.
+	 */
+	static constexpr SizeType FlatThreshold = 16;
+
+	/**
+	 * An iterator that can be used to iterate over dictionary elements.
+	 */
+	class Iterator
+	{
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef Pair value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef Pair *pointer;
+		typedef Pair& reference;
+
+		Iterator() = default;
+
+		reference operator*() const
+		{
+			return m_Flat ? *m_FlatIt : *m_MapIt;
+		}
+
+		pointer operator->() const
+		{
+			return &**this;
+		}
+
+		Iterator& operator++()
+		{
+			if (m_Flat)
+				++m_FlatIt;
+			else
+				++m_MapIt;
+
+			return *this;
+		}
+
+		Iterator operator++(int)
+		{
+			Iterator it (*this);
+			++*this;
+			return it;
+		}
+
+		Iterator& operator--()
+		{
+			if (m_Flat)
+				--m_FlatIt;
+			else
+				--m_MapIt;
+
+			return *this;
+		}
+
+		Iterator operator--(int)
+		{
+			Iterator it (*this);
+			--*this;
+			return it;
+		}
+
+		bool operator==(const Iterator& other) const
+		{
+			return m_Flat ? m_FlatIt == other.m_FlatIt : m_MapIt == other.m_MapIt;
+		}
+
+		bool operator!=(const Iterator& other) const
+		{
+			return !(*this == other);
+		}
+
+	private:
+		bool m_Flat{true};
+		Pair *m_FlatIt{nullptr};
+		std::map<String, Value>::iterator m_MapIt;
+
+		Iterator(Pair *it)
+			: m_FlatIt(it)
+		{ }
+
+		Iterator(std::map<String, Value>::iterator it)
+			: m_Flat(false), m_MapIt(it)
+		{ }
+
+		friend class Dictionary;
+	};
+
 	Dictionary() = default;
 	Dictionary(const DictionaryData& other);
 	Dictionary(DictionaryData&& other);
@@ -69,6 +165,8 @@ public:
 	String ToString() const override;
 
 	void Freeze();
+	bool IsFrozen() const;
+	Dictionary::Ptr Snapshot() const;
 
 	Value GetFieldByName(const String& field, bool sandboxed, const DebugInfo& debugInfo) const override;
 	void SetFieldByName(const String& field, const Value& value, bool overrideFrozen, const DebugInfo& debugInfo) override;
@@ -76,9 +174,20 @@ public:
 	bool GetOwnField(const String& field, Value *result) const override;
 
 private:
-	std::map<String, Value> m_Data; /**< The data for the dictionary. */
-	mutable std::shared_timed_mutex m_DataMutex;
-	bool m_Frozen{false};
+	std::vector<Pair> m_FlatData; /**< The sorted data for the dictionary unless m_MapData is set. */
+	std::unique_ptr<std::map<String, Value>> m_MapData; /**< The data for large dictionaries. */
+	mutable std::shared_mutex m_DataMutex;
+	std::atomic<bool> m_Frozen{false};
+
+	std::shared_lock<std::shared_mutex> ReadLockUnlessFrozen() const;
+	void InitData(DictionaryData&& data);
+	const Value *FindUnlocked(const String& key) const;
+	void SetUnlocked(const String& key, Value&& value);
+	void InsertFlatUnlocked(SizeType pos, const String& key, Value&& value);
+	void EraseFlatUnlocked(SizeType pos);
+
+	template<typename F>
+	void ForEachUnlocked(const F& func) const;
 };
 
 Dictionary::Iterator begin(const Dictionary::Ptr& x);
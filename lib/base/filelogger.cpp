@@ -5,6 +5,7 @@
 #include "base/configtype.hpp"
 #include "base/statsfunction.hpp"
 #include "base/application.hpp"
+#include "base/perfdatavalue.hpp"
 #include <fstream>
 
 using namespace icinga;
@@ -13,12 +14,15 @@ REGISTER_TYPE(FileLogger);
 
 REGISTER_STATSFUNCTION(FileLogger, &FileLogger::StatsFunc);
 
-void FileLogger::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+void FileLogger::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
 	for (const FileLogger::Ptr& filelogger : ConfigType::GetObjectsByType<FileLogger>()) {
 		nodes.emplace_back(filelogger->GetName(), 1); //add more stats
+
+		if (filelogger->GetAsync())
+			perfdata->Add(new PerfdataValue("filelogger_" + filelogger->GetName() + "_dropped_debug_entries", filelogger->GetDroppedEntries()));
 	}
 
 	status->Set("filelogger", new Dictionary(std::move(nodes)));
@@ -0,0 +1,92 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/histogram.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace icinga;
+
+void Histogram::Record(ValueType value) noexcept
+{
+	m_Buckets[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+	m_Count.fetch_add(1, std::memory_order_relaxed);
+	m_Sum.fetch_add(value, std::memory_order_relaxed);
+
+	auto max (m_Max.load(std::memory_order_relaxed));
+
+	while (value > max && !m_Max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+	}
+}
+
+uint_fast64_t Histogram::GetCount() const noexcept
+{
+	return m_Count.load(std::memory_order_relaxed);
+}
+
+Histogram::ValueType Histogram::GetMax() const noexcept
+{
+	return m_Max.load(std::memory_order_relaxed);
+}
+
+double Histogram::GetMean() const noexcept
+{
+	auto count (GetCount());
+
+	return count ? (double)m_Sum.load(std::memory_order_relaxed) / count : 0;
+}
+
+/**
+ * @param percentile Between 0 and 100
+ *
+ * @return The upper bound of the bucket containing the given percentile (but at most the largest value recorded)
+ */
+Histogram::ValueType Histogram::GetPercentile(double percentile) const noexcept
+{
+	auto count (GetCount());
+
+	if (!count) {
+		return 0;
+	}
+
+	auto rank (std::max<uint_fast64_t>(1, std::ceil(std::min(std::max(percentile, 0.0), 100.0) / 100.0 * count)));
+	uint_fast64_t seen = 0;
+
+	for (size_t i = 0; i < BucketCount; ++i) {
+		seen += m_Buckets[i].load(std::memory_order_relaxed);
+
+		if (seen >= rank) {
+			return i + 1u < BucketCount ? std::min(GetBucketUpperBound(i), GetMax()) : GetMax();
+		}
+	}
+
+	// Concurrent Record() calls have counted values not yet in their buckets.
+	return GetMax();
+}
+
+size_t Histogram::GetBucket(ValueType value) noexcept
+{
+	if (value < SubBuckets) {
+		return value;
+	}
+
+	unsigned magnitude = SubBucketBits;
+
+	while (magnitude < 63u && (value >> (magnitude + 1u))) {
+		++magnitude;
+	}
+
+	unsigned shift = magnitude - SubBucketBits;
+
+	return std::min<size_t>((shift + 1u) * SubBuckets + ((value >> shift) - SubBuckets), BucketCount - 1u);
+}
+
+Histogram::ValueType Histogram::GetBucketUpperBound(size_t bucket) noexcept
+{
+	if (bucket < SubBuckets) {
+		return bucket;
+	}
+
+	unsigned shift = bucket / SubBuckets - 1u;
+
+	return ((SubBuckets + bucket % SubBuckets) << shift) + (ValueType(1) << shift) - 1u;
+}
@@ -0,0 +1,54 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "base/i2-base.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace icinga
+{
+
+/**
+ * Counts non-negative integers (e.g. latencies in microseconds) in logarithmic buckets, each power of two divided into
+ * 8 linear sub-buckets. That's an error of at most 12.5% at a constant memory footprint (like HDR histograms).
+ *
+ * Recording is lock-free and can happen concurrently to anything else.
+ *
+ * @ingroup base
+ */
+class Histogram final
+{
+public:
+	typedef uint_fast64_t ValueType;
+
+	void Record(ValueType value) noexcept;
+
+	uint_fast64_t GetCount() const noexcept;
+	ValueType GetMax() const noexcept;
+	double GetMean() const noexcept;
+	ValueType GetPercentile(double percentile) const noexcept;
+
+private:
+	static constexpr unsigned SubBucketBits = 3;
+	static constexpr ValueType SubBuckets = ValueType(1) << SubBucketBits;
+
+	// Values up to 2^48 (almost nine years in microseconds) get their own bucket, the last one takes all larger ones.
+	static constexpr unsigned MaxMagnitude = 48;
+	static constexpr size_t BucketCount = (MaxMagnitude - SubBucketBits + 1u) * SubBuckets;
+
+	static size_t GetBucket(ValueType value) noexcept;
+	static ValueType GetBucketUpperBound(size_t bucket) noexcept;
+
+	std::array<std::atomic<uint_fast64_t>, BucketCount> m_Buckets {};
+	std::atomic<uint_fast64_t> m_Count {0};
+	std::atomic<uint_fast64_t> m_Sum {0};
+	std::atomic<ValueType> m_Max {0};
+};
+
+}
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,105 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/internedstring.hpp"
+#include "base/string.hpp"
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_set>
+
+using namespace icinga;
+
+namespace
+{
+
+/**
+ * One part of the symbol table. The table is split by hash so that threads interning
+ * different strings rarely contend for the same lock.
+ */
+struct SymbolShard
+{
+	std::shared_mutex Mutex;
+	std::unordered_set<String> Symbols; /* a node-based container, the addresses of elements are stable */
+};
+
+}
+
+static constexpr size_t l_SymbolShardCount = 16;
+
+static SymbolShard *GetSymbolShards()
+{
+	/* Intentionally leaked, handles may be used during static destruction. */
+	static SymbolShard *shards = new SymbolShard[l_SymbolShardCount];
+
+	return shards;
+}
+
+static const String *Intern(const String& str)
+{
+	size_t hash = std::hash<String>{}(str);
+	SymbolShard& shard (GetSymbolShards()[hash % l_SymbolShardCount]);
+
+	{
+		std::shared_lock<std::shared_mutex> lock (shard.Mutex);
+		auto it (shard.Symbols.find(str));
+
+		if (it != shard.Symbols.end())
+			return &*it;
+	}
+
+	std::unique_lock<std::shared_mutex> lock (shard.Mutex);
+
+	return &*shard.Symbols.insert(str).first;
+}
+
+InternedString::InternedString()
+	: InternedString(String())
+{ }
+
+InternedString::InternedString(const char *str)
+	: InternedString(String(str))
+{ }
+
+InternedString::InternedString(const String& str)
+	: m_Symbol(Intern(str))
+{ }
+
+const String& InternedString::GetString() const
+{
+	return *m_Symbol;
+}
+
+InternedString::operator const String&() const
+{
+	return *m_Symbol;
+}
+
+const char *InternedString::CStr() const
+{
+	return m_Symbol->CStr();
+}
+
+/**
+ * Orders by the string values (not by address), so the order is stable across runs.
+ */
+bool InternedString::operator<(const InternedString& other) const
+{
+	return m_Symbol != other.m_Symbol && *m_Symbol < *other.m_Symbol;
+}
+
+/**
+ * Returns the number of distinct strings in the symbol table.
+ *
+ * @returns The number of symbols.
+ */
+size_t InternedString::GetSymbolCount()
+{
+	size_t count = 0;
+	SymbolShard *shards = GetSymbolShards();
+
+	for (size_t i = 0; i < l_SymbolShardCount; i++) {
+		std::shared_lock<std::shared_mutex> lock (shards[i].Mutex);
+		count += shards[i].Symbols.size();
+	}
+
+	return count;
+}
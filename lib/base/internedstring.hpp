@@ -0,0 +1,66 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef INTERNEDSTRING_H
+#define INTERNEDSTRING_H
+
+#include "base/i2-base.hpp"
+#include <cstddef>
+#include <functional>
+
+namespace icinga
+{
+
+class String;
+
+/**
+ * A handle to an immutable string in the global symbol table.
+ *
+ * All handles for equal strings share one copy of it, so they're cheap to copy and
+ * compare by pointer. Symbols are never freed, hence only intern a bounded set of
+ * strings like attribute, type and object names.
+ *
+ * @ingroup base
+ */
+class InternedString
+{
+public:
+	InternedString();
+	InternedString(const char *str);
+	InternedString(const String& str);
+
+	const String& GetString() const;
+	operator const String&() const;
+	const char *CStr() const;
+
+	bool operator==(const InternedString& other) const
+	{
+		return m_Symbol == other.m_Symbol;
+	}
+
+	bool operator!=(const InternedString& other) const
+	{
+		return m_Symbol != other.m_Symbol;
+	}
+
+	bool operator<(const InternedString& other) const;
+
+	static size_t GetSymbolCount();
+
+private:
+	const String *m_Symbol;
+
+	friend struct std::hash<InternedString>;
+};
+
+}
+
+template<>
+struct std::hash<icinga::InternedString>
+{
+	std::size_t operator()(const icinga::InternedString& s) const noexcept
+	{
+		return std::hash<const icinga::String *>{}(s.m_Symbol);
+	}
+};
+
+#endif /* INTERNEDSTRING_H */
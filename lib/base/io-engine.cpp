@@ -1,19 +1,30 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "base/configuration.hpp"
+#include "base/convert.hpp"
 #include "base/exception.hpp"
 #include "base/io-engine.hpp"
 #include "base/lazy-init.hpp"
 #include "base/logger.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
 #include <exception>
+#include <fstream>
 #include <memory>
 #include <thread>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/spawn.hpp>
 #include <boost/asio/post.hpp>
 #include <boost/date_time/posix_time/ptime.hpp>
 #include <boost/system/error_code.hpp>
 
+#ifdef __linux__
+#	include <pthread.h>
+#	include <sched.h>
+#endif /* __linux__ */
+
 using namespace icinga;
 
 CpuBoundWork::CpuBoundWork(boost::asio::yield_context yc)
@@ -80,39 +91,253 @@ IoEngine& IoEngine::Get()
 	return *m_Instance.Get();
 }
 
+/**
+ * Returns the main io_context, used for everything not bound to a particular connection.
+ */
 boost::asio::io_context& IoEngine::GetIoContext()
 {
-	return m_IoContext;
+	return m_Contexts[0]->IoContext;
+}
+
+/**
+ * Picks the owning io_context of a new connection (round-robin), i.e. the one all of its I/O objects shall use.
+ */
+boost::asio::io_context& IoEngine::GetConnectionIoContext()
+{
+	auto& context (*m_Contexts[m_NextConnectionContext.fetch_add(1) % m_Contexts.size()]);
+
+	context.Connections.fetch_add(1);
+
+	return context.IoContext;
+}
+
+/**
+ * Returns threads, CPUs, assigned connections and timer latency of every io_context.
+ */
+Array::Ptr IoEngine::GetIoContextsStatus() const
+{
+	ArrayData contexts;
+
+	for (auto& context : m_Contexts) {
+		ArrayData cpus (context->Cpus.begin(), context->Cpus.end());
+
+		contexts.emplace_back(new Dictionary({
+			{ "threads", context->Threads.size() },
+			{ "cpus", new Array(std::move(cpus)) },
+			{ "connections", context->Connections.load() },
+			{ "latency", context->Latency.load() }
+		}));
+	}
+
+	return new Array(std::move(contexts));
+}
+
+IoEngine::Context::Context()
+	: KeepAlive(boost::asio::make_work_guard(IoContext)), Latency(0), Connections(0)
+{
 }
 
-IoEngine::IoEngine() : m_IoContext(), m_KeepAlive(boost::asio::make_work_guard(m_IoContext)), m_Threads(decltype(m_Threads)::size_type(Configuration::Concurrency * 2u)), m_AlreadyExpiredTimer(m_IoContext)
+IoEngine::IoEngine() : m_NextConnectionContext(0)
 {
-	m_AlreadyExpiredTimer.expires_at(boost::posix_time::neg_infin);
+	size_t threads = Configuration::Concurrency * 2u;
+	auto groups (GetCpuGroups(Configuration::IoEnginePlacement));
+
+	if (groups.empty()) {
+		m_Contexts.emplace_back(new Context());
+	} else {
+		for (auto& cpus : groups) {
+			m_Contexts.emplace_back(new Context());
+			m_Contexts.back()->Cpus = std::move(cpus);
+		}
+	}
+
+	m_AlreadyExpiredTimer.reset(new boost::asio::deadline_timer(GetIoContext()));
+	m_AlreadyExpiredTimer->expires_at(boost::posix_time::neg_infin);
 	m_CpuBoundSemaphore.store(Configuration::Concurrency * 3u / 2u);
 
-	for (auto& thread : m_Threads) {
-		thread = std::thread(&IoEngine::RunEventLoop, this);
+	for (auto& context : m_Contexts) {
+		/* Like the shared io_context, i.e. two threads per CPU. */
+		StartContext(*context, context->Cpus.empty() ? threads : context->Cpus.size() * 2u);
+	}
+
+	if (m_Contexts.size() > 1) {
+		Log(LogInformation, "IoEngine")
+			<< "Running " << m_Contexts.size() << " I/O contexts pinned to their CPUs ('"
+			<< Configuration::IoEnginePlacement << "' placement).";
 	}
 }
 
 IoEngine::~IoEngine()
 {
-	for (auto& thread : m_Threads) {
-		boost::asio::post(m_IoContext, []() {
-			throw TerminateIoThread();
-		});
+	for (auto& context : m_Contexts) {
+		for (size_t i = 0; i < context->Threads.size(); i++) {
+			boost::asio::post(context->IoContext, []() {
+				throw TerminateIoThread();
+			});
+		}
+	}
+
+	for (auto& context : m_Contexts) {
+		for (auto& thread : context->Threads) {
+			thread.join();
+		}
 	}
+}
+
+void IoEngine::StartContext(Context& context, size_t threads)
+{
+	context.Threads.resize(std::max<size_t>(threads, 1));
+
+	for (auto& thread : context.Threads) {
+		thread = std::thread(&IoEngine::RunEventLoop, this, std::ref(context));
 
-	for (auto& thread : m_Threads) {
-		thread.join();
+#ifdef __linux__
+		if (!context.Cpus.empty()) {
+			cpu_set_t cpus;
+
+			CPU_ZERO(&cpus);
+
+			for (auto cpu : context.Cpus) {
+				CPU_SET(cpu, &cpus);
+			}
+
+			int rc = pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+
+			if (rc) {
+				Log(LogWarning, "IoEngine")
+					<< "Can't pin I/O thread to its CPUs: " << Utility::FormatErrorNumber(rc);
+			}
+		}
+#endif /* __linux__ */
 	}
+
+	IoEngine::SpawnCoroutine(context.IoContext, [&context](boost::asio::yield_context yc) {
+		MeasureLatency(context, yc);
+	});
+}
+
+/**
+ * Periodically measures how late a timer fires, i.e. how busy the io_context's threads are.
+ */
+void IoEngine::MeasureLatency(Context& context, boost::asio::yield_context yc)
+{
+	boost::asio::deadline_timer timer (context.IoContext);
+
+	for (;;) {
+		timer.expires_from_now(boost::posix_time::seconds(1));
+
+		double expected = Utility::GetTime() + 1;
+		boost::system::error_code ec;
+
+		timer.async_wait(yc[ec]);
+
+		if (ec) {
+			continue;
+		}
+
+		double latency = std::max(0.0, Utility::GetTime() - expected);
+
+		context.Latency.store(context.Latency.load() * 0.8 + latency * 0.2);
+	}
+}
+
+/**
+ * Splits the CPUs we may run on by NUMA node or core.
+ *
+ * @param placement "node", "core" or "shared"
+ *
+ * @returns One group of CPUs per io_context (none = just one shared io_context)
+ */
+std::vector<std::vector<unsigned int>> IoEngine::GetCpuGroups(const String& placement)
+{
+	std::vector<std::vector<unsigned int>> groups;
+
+	if (placement.IsEmpty() || placement == "shared") {
+		return groups;
+	}
+
+	if (placement != "node" && placement != "core") {
+		Log(LogWarning, "IoEngine")
+			<< "Unknown IoEnginePlacement '" << placement << "', using one shared I/O context.";
+		return groups;
+	}
+
+#ifdef __linux__
+	cpu_set_t allowed;
+
+	CPU_ZERO(&allowed);
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		Log(LogWarning, "IoEngine")
+			<< "sched_getaffinity() failed: " << Utility::FormatErrorNumber(errno) << ", using one shared I/O context.";
+		return groups;
+	}
+
+	if (placement == "core") {
+		for (unsigned int cpu = 0; cpu < CPU_SETSIZE && groups.size() < (size_t)std::max(Configuration::Concurrency, 1); cpu++) {
+			if (CPU_ISSET(cpu, &allowed)) {
+				groups.push_back({ cpu });
+			}
+		}
+
+		return groups;
+	}
+
+	Utility::Glob("/sys/devices/system/node/node*", [&groups, &allowed](const String& path) {
+		std::ifstream fp (path + "/cpulist");
+		std::string line;
+
+		if (!std::getline(fp, line)) {
+			return;
+		}
+
+		/* e.g. "0-5,12-17" */
+		std::vector<std::string> ranges;
+		std::vector<unsigned int> cpus;
+
+		boost::algorithm::split(ranges, line, boost::is_any_of(","));
+
+		for (auto& range : ranges) {
+			std::vector<std::string> bounds;
+
+			boost::algorithm::split(bounds, range, boost::is_any_of("-"));
+
+			try {
+				unsigned int first = Convert::ToLong(bounds.front());
+				unsigned int last = Convert::ToLong(bounds.back());
+
+				for (unsigned int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+					if (CPU_ISSET(cpu, &allowed)) {
+						cpus.push_back(cpu);
+					}
+				}
+			} catch (const std::exception&) {
+				/* empty node */
+			}
+		}
+
+		if (!cpus.empty()) {
+			groups.emplace_back(std::move(cpus));
+		}
+	}, GlobDirectory);
+
+	if (groups.size() < 2) {
+		/* Nothing to gain from pinning all threads to all CPUs of the only node. */
+		groups.clear();
+	}
+#else /* __linux__ */
+	Log(LogWarning, "IoEngine")
+		<< "IoEnginePlacement '" << placement << "' is only supported on Linux, using one shared I/O context.";
+#endif /* __linux__ */
+
+	return groups;
 }
 
-void IoEngine::RunEventLoop()
+void IoEngine::RunEventLoop(Context& context)
 {
 	for (;;) {
 		try {
-			m_IoContext.run();
+			context.IoContext.run();
 
 			break;
 		} catch (const TerminateIoThread&) {
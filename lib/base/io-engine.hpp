@@ -3,6 +3,7 @@
 #ifndef IO_ENGINE_H
 #define IO_ENGINE_H
 
+#include "base/array.hpp"
 #include "base/exception.hpp"
 #include "base/lazy-init.hpp"
 #include "base/logger.hpp"
@@ -65,6 +66,10 @@ private:
 /**
  * Async I/O engine
  *
+ * By default all I/O threads run one shared io_context. With IoEnginePlacement set to "node" or "core"
+ * there's one io_context per NUMA node or CPU core instead, each with its own threads pinned to their CPUs.
+ * Connections get one of them as their owning context from GetConnectionIoContext().
+ *
  * @ingroup base
  */
 class IoEngine
@@ -82,6 +87,8 @@ public:
 	static IoEngine& Get();
 
 	boost::asio::io_context& GetIoContext();
+	boost::asio::io_context& GetConnectionIoContext();
+	Array::Ptr GetIoContextsStatus() const;
 
 	static inline size_t GetCoroutineStackSize() {
 #ifdef _WIN32
@@ -121,20 +128,38 @@ public:
 	static inline
 	void YieldCurrentCoroutine(boost::asio::yield_context yc)
 	{
-		Get().m_AlreadyExpiredTimer.async_wait(yc);
+		Get().m_AlreadyExpiredTimer->async_wait(yc);
 	}
 
 private:
+	/**
+	 * An io_context with the threads running it
+	 */
+	struct Context
+	{
+		boost::asio::io_context IoContext;
+		boost::asio::executor_work_guard<boost::asio::io_context::executor_type> KeepAlive;
+		std::vector<std::thread> Threads;
+		std::vector<unsigned int> Cpus; /**< The threads are pinned to them (empty = not pinned) */
+		std::atomic<double> Latency; /**< How late its timers fire (seconds, moving average) */
+		std::atomic<uint_fast64_t> Connections; /**< How often it has been returned by GetConnectionIoContext() */
+
+		Context();
+	};
+
 	IoEngine();
 
-	void RunEventLoop();
+	void StartContext(Context& context, size_t threads);
+	void RunEventLoop(Context& context);
+	static void MeasureLatency(Context& context, boost::asio::yield_context yc);
+
+	static std::vector<std::vector<unsigned int>> GetCpuGroups(const String& placement);
 
 	static LazyInit<std::unique_ptr<IoEngine>> m_Instance;
 
-	boost::asio::io_context m_IoContext;
-	boost::asio::executor_work_guard<boost::asio::io_context::executor_type> m_KeepAlive;
-	std::vector<std::thread> m_Threads;
-	boost::asio::deadline_timer m_AlreadyExpiredTimer;
+	std::vector<std::unique_ptr<Context>> m_Contexts;
+	std::atomic<uint_fast32_t> m_NextConnectionContext;
+	std::unique_ptr<boost::asio::deadline_timer> m_AlreadyExpiredTimer;
 	std::atomic_int_fast32_t m_CpuBoundSemaphore;
 };
 
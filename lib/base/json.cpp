@@ -8,11 +8,17 @@
 #include "base/objectlock.hpp"
 #include "base/convert.hpp"
 #include "base/utility.hpp"
+#include <algorithm>
 #include <bitset>
 #include <boost/exception_ptr.hpp>
+#include <charconv>
+#include <cmath>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <json.hpp>
 #include <stack>
+#include <utf8.h>
 #include <utility>
 #include <vector>
 
@@ -45,22 +51,67 @@ private:
 	void FillCurrentTarget(Value value);
 };
 
+/**
+ * Decodes valid JSON directly into Values, i.e. without nlohmann's SAX machinery and an upfront
+ * UTF-8 sanitization copy of the whole input. Strings are scanned 8 bytes at a time and objects
+ * are collected in a vector which is sorted once, not inserted into a Dictionary key by key.
+ *
+ * Rejects anything else, so that JsonDecode() can fall back to nlohmann for the error message.
+ */
+class JsonDecoder
+{
+public:
+	JsonDecoder(const char *begin, const char *end)
+		: m_Pos(begin), m_End(end)
+	{ }
+
+	bool Decode(Value& result);
+
+private:
+	struct Frame
+	{
+		bool IsObject;
+		DictionaryData Object;
+		ArrayData Array;
+		String Key;
+	};
+
+	const char *m_Pos;
+	const char *m_End;
+	std::vector<Frame> m_Stack;
+
+	void SkipWhitespace();
+	bool Expect(char c);
+	bool DecodeString(String& result);
+	bool DecodeEscape(std::string& result);
+	bool DecodeHex4(unsigned int& result);
+	bool DecodeNumber(double& result);
+	bool DecodeLiteral(const char *literal, size_t length);
+	bool DecodeKey(Frame& frame);
+};
+
 const char l_Null[] = "null";
 const char l_False[] = "false";
 const char l_True[] = "true";
 const char l_Indent[] = "    ";
 
-// https://github.com/nlohmann/json/issues/1512
+/**
+ * Writes JSON directly into a string, formatted like nlohmann's serializer with ensure_ascii.
+ *
+ * https://github.com/nlohmann/json/issues/1512
+ */
 template<bool prettyPrint>
 class JsonEncoder
 {
 public:
+	JsonEncoder();
+
 	void Null();
 	void Boolean(bool value);
 	void NumberFloat(double value);
-	void Strng(String value);
+	void Strng(const String& value);
 	void StartObject();
-	void Key(String value);
+	void Key(const String& value);
 	void EndObject();
 	void StartArray();
 	void EndArray();
@@ -68,22 +119,32 @@ public:
 	String GetResult();
 
 private:
-	std::vector<char> m_Result;
-	String m_CurrentKey;
-	std::stack<std::bitset<2>> m_CurrentSubtree;
+	static thread_local size_t m_SizeHint;
+
+	std::string m_Result;
+	const String *m_CurrentKey{nullptr}; /**< Only valid until the next item */
+	std::vector<std::bitset<2>> m_CurrentSubtree;
 
 	void AppendChar(char c);
 
 	template<class Iterator>
 	void AppendChars(Iterator begin, Iterator end);
 
-	void AppendJson(nlohmann::json json);
+	void AppendString(const String& value);
+	void AppendEscaped(const char *pos, const char *end);
+	void AppendUnicodeEscape(unsigned int codepoint);
 
 	void BeforeItem();
 
 	void FinishContainer(char terminator);
 };
 
+/**
+ * The size of the last result (up to 1 MiB), new results are likely to be similar.
+ */
+template<bool prettyPrint>
+thread_local size_t JsonEncoder<prettyPrint>::m_SizeHint = 0;
+
 template<bool prettyPrint>
 void Encode(JsonEncoder<prettyPrint>& stateMachine, const Value& value);
 
@@ -95,7 +156,7 @@ void EncodeNamespace(JsonEncoder<prettyPrint>& stateMachine, const Namespace::Pt
 
 	ObjectLock olock(ns);
 	for (const Namespace::Pair& kv : ns) {
-		stateMachine.Key(Utility::ValidateUTF8(kv.first));
+		stateMachine.Key(kv.first);
 		Encode(stateMachine, kv.second.Val);
 	}
 
@@ -110,7 +171,7 @@ void EncodeDictionary(JsonEncoder<prettyPrint>& stateMachine, const Dictionary::
 
 	ObjectLock olock(dict);
 	for (const Dictionary::Pair& kv : dict) {
-		stateMachine.Key(Utility::ValidateUTF8(kv.first));
+		stateMachine.Key(kv.first);
 		Encode(stateMachine, kv.second);
 	}
 
@@ -144,7 +205,7 @@ void Encode(JsonEncoder<prettyPrint>& stateMachine, const Value& value)
 			break;
 
 		case ValueString:
-			stateMachine.Strng(Utility::ValidateUTF8(value.Get<String>()));
+			stateMachine.Strng(value.Get<String>());
 			break;
 
 		case ValueObject:
@@ -208,6 +269,13 @@ String icinga::JsonEncode(const Value& value, bool pretty_print)
 
 Value icinga::JsonDecode(const String& data)
 {
+	{
+		Value result;
+
+		if (JsonDecoder(data.CStr(), data.CStr() + data.GetLength()).Decode(result))
+			return result;
+	}
+
 	String sanitized (Utility::ValidateUTF8(data));
 
 	JsonSax stateMachine;
@@ -350,6 +418,422 @@ void JsonSax::FillCurrentTarget(Value value)
 	}
 }
 
+bool JsonDecoder::Decode(Value& result)
+{
+	Value value;
+
+	for (;;) {
+		SkipWhitespace();
+
+		if (m_Pos == m_End)
+			return false;
+
+		switch (*m_Pos) {
+			case '{':
+				m_Pos++;
+				SkipWhitespace();
+
+				if (m_Pos != m_End && *m_Pos == '}') {
+					m_Pos++;
+					value = new Dictionary();
+					break;
+				}
+
+				m_Stack.emplace_back();
+				m_Stack.back().IsObject = true;
+
+				if (!DecodeKey(m_Stack.back()))
+					return false;
+
+				continue;
+			case '[':
+				m_Pos++;
+				SkipWhitespace();
+
+				if (m_Pos != m_End && *m_Pos == ']') {
+					m_Pos++;
+					value = new Array();
+					break;
+				}
+
+				m_Stack.emplace_back();
+				m_Stack.back().IsObject = false;
+
+				continue;
+			case '"': {
+				String string;
+
+				if (!DecodeString(string))
+					return false;
+
+				value = std::move(string);
+				break;
+			}
+			case 't':
+				if (!DecodeLiteral(l_True, 4))
+					return false;
+
+				value = true;
+				break;
+			case 'f':
+				if (!DecodeLiteral(l_False, 5))
+					return false;
+
+				value = false;
+				break;
+			case 'n':
+				if (!DecodeLiteral(l_Null, 4))
+					return false;
+
+				value = Empty;
+				break;
+			default: {
+				double number;
+
+				if (!DecodeNumber(number))
+					return false;
+
+				value = number;
+			}
+		}
+
+		/* Add the value to its parents, completing those which end here. */
+		for (;;) {
+			if (m_Stack.empty()) {
+				SkipWhitespace();
+
+				if (m_Pos != m_End)
+					return false;
+
+				result = std::move(value);
+				return true;
+			}
+
+			auto& frame (m_Stack.back());
+
+			if (frame.IsObject)
+				frame.Object.emplace_back(std::move(frame.Key), std::move(value));
+			else
+				frame.Array.emplace_back(std::move(value));
+
+			SkipWhitespace();
+
+			if (m_Pos == m_End)
+				return false;
+
+			if (*m_Pos == ',') {
+				m_Pos++;
+
+				if (frame.IsObject && !DecodeKey(frame))
+					return false;
+
+				break;
+			}
+
+			if (*m_Pos != (frame.IsObject ? '}' : ']'))
+				return false;
+
+			m_Pos++;
+
+			if (frame.IsObject) {
+				/* Like Dictionary#Set() the last duplicate key wins, the constructor keeps the first one. */
+				std::reverse(frame.Object.begin(), frame.Object.end());
+				value = new Dictionary(std::move(frame.Object));
+			} else {
+				value = new Array(std::move(frame.Array));
+			}
+
+			m_Stack.pop_back();
+		}
+	}
+}
+
+void JsonDecoder::SkipWhitespace()
+{
+	while (m_Pos != m_End && (*m_Pos == ' ' || *m_Pos == '\n' || *m_Pos == '\r' || *m_Pos == '\t'))
+		m_Pos++;
+}
+
+bool JsonDecoder::Expect(char c)
+{
+	SkipWhitespace();
+
+	if (m_Pos == m_End || *m_Pos != c)
+		return false;
+
+	m_Pos++;
+	return true;
+}
+
+/**
+ * Decodes an object's next key and the colon after it.
+ */
+bool JsonDecoder::DecodeKey(Frame& frame)
+{
+	SkipWhitespace();
+
+	if (m_Pos == m_End || *m_Pos != '"')
+		return false;
+
+	return DecodeString(frame.Key) && Expect(':');
+}
+
+bool JsonDecoder::DecodeLiteral(const char *literal, size_t length)
+{
+	if ((size_t)(m_End - m_Pos) < length || memcmp(m_Pos, literal, length))
+		return false;
+
+	m_Pos += length;
+	return true;
+}
+
+/**
+ * Decodes the string at m_Pos (a '"'). Invalid UTF-8 is replaced like Utility::ValidateUTF8() does.
+ */
+bool JsonDecoder::DecodeString(String& result)
+{
+	static constexpr uint_fast64_t ones = 0x0101010101010101u, highs = 0x8080808080808080u;
+
+	std::string decoded;
+	bool nonAscii = false;
+
+	m_Pos++;
+
+	for (;;) {
+		auto run (m_Pos);
+
+		/* Skip 8 bytes at once until one of them is a '"', '\\' or control character. */
+		for (; m_End - m_Pos >= 8; m_Pos += 8) {
+			uint_fast64_t word;
+			memcpy(&word, m_Pos, 8);
+
+			uint_fast64_t quotes = word ^ (ones * '"');
+			uint_fast64_t backslashes = word ^ (ones * '\\');
+			uint_fast64_t special = ((quotes - ones) & ~quotes) | ((backslashes - ones) & ~backslashes) | ((word - ones * 0x20) & ~word);
+
+			if (special & highs)
+				break;
+
+			nonAscii = nonAscii || (word & highs);
+		}
+
+		for (; m_Pos != m_End; m_Pos++) {
+			auto c ((unsigned char)*m_Pos);
+
+			if (c == '"' || c == '\\' || c < 0x20)
+				break;
+
+			nonAscii = nonAscii || c >= 0x80;
+		}
+
+		decoded.append(run, m_Pos);
+
+		if (m_Pos == m_End || (unsigned char)*m_Pos < 0x20)
+			return false;
+
+		if (*m_Pos == '"') {
+			m_Pos++;
+			break;
+		}
+
+		m_Pos++;
+
+		if (!DecodeEscape(decoded))
+			return false;
+	}
+
+	if (nonAscii && !utf8::is_valid(decoded.begin(), decoded.end()))
+		result = Utility::ValidateUTF8(decoded);
+	else
+		result = String(std::move(decoded));
+
+	return true;
+}
+
+/**
+ * Decodes the escape sequence after a '\\' and appends its character.
+ */
+bool JsonDecoder::DecodeEscape(std::string& result)
+{
+	if (m_Pos == m_End)
+		return false;
+
+	switch (*m_Pos++) {
+		case '"':
+			result += '"';
+			return true;
+		case '\\':
+			result += '\\';
+			return true;
+		case '/':
+			result += '/';
+			return true;
+		case 'b':
+			result += '\b';
+			return true;
+		case 'f':
+			result += '\f';
+			return true;
+		case 'n':
+			result += '\n';
+			return true;
+		case 'r':
+			result += '\r';
+			return true;
+		case 't':
+			result += '\t';
+			return true;
+		case 'u':
+			break;
+		default:
+			return false;
+	}
+
+	unsigned int codepoint;
+
+	if (!DecodeHex4(codepoint) || (codepoint >= 0xDC00 && codepoint <= 0xDFFF))
+		return false;
+
+	if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+		unsigned int low;
+
+		if (m_End - m_Pos < 2 || m_Pos[0] != '\\' || m_Pos[1] != 'u')
+			return false;
+
+		m_Pos += 2;
+
+		if (!DecodeHex4(low) || low < 0xDC00 || low > 0xDFFF)
+			return false;
+
+		codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+	}
+
+	utf8::append(codepoint, std::back_inserter(result));
+
+	return true;
+}
+
+bool JsonDecoder::DecodeHex4(unsigned int& result)
+{
+	if (m_End - m_Pos < 4)
+		return false;
+
+	result = 0;
+
+	for (auto end (m_Pos + 4); m_Pos != end; m_Pos++) {
+		char c = *m_Pos;
+
+		result <<= 4;
+
+		if (c >= '0' && c <= '9')
+			result |= c - '0';
+		else if (c >= 'a' && c <= 'f')
+			result |= c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			result |= c - 'A' + 10;
+		else
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Decodes a number, exactly like nlohmann's number_integer()/number_float() followed by a cast to double.
+ */
+bool JsonDecoder::DecodeNumber(double& result)
+{
+	static const double powersOf10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	auto begin (m_Pos);
+	bool negative = false, integer = true;
+	uint_fast64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+
+	auto isDigit ([this]() { return m_Pos != m_End && *m_Pos >= '0' && *m_Pos <= '9'; });
+
+	if (*m_Pos == '-') {
+		negative = true;
+		m_Pos++;
+	}
+
+	if (!isDigit())
+		return false;
+
+	if (*m_Pos == '0') {
+		m_Pos++;
+	} else {
+		for (; isDigit(); m_Pos++, digits++)
+			mantissa = mantissa * 10u + (*m_Pos - '0');
+	}
+
+	if (m_Pos != m_End && *m_Pos == '.') {
+		integer = false;
+		m_Pos++;
+
+		if (!isDigit())
+			return false;
+
+		for (; isDigit(); m_Pos++, digits++, exponent--)
+			mantissa = mantissa * 10u + (*m_Pos - '0');
+	}
+
+	if (m_Pos != m_End && (*m_Pos == 'e' || *m_Pos == 'E')) {
+		integer = false;
+		m_Pos++;
+
+		bool negativeExponent = false;
+
+		if (m_Pos != m_End && (*m_Pos == '+' || *m_Pos == '-')) {
+			negativeExponent = *m_Pos == '-';
+			m_Pos++;
+		}
+
+		if (!isDigit())
+			return false;
+
+		int explicitExponent = 0;
+
+		for (; isDigit(); m_Pos++) {
+			if (explicitExponent < 10000)
+				explicitExponent = explicitExponent * 10 + (*m_Pos - '0');
+		}
+
+		exponent += negativeExponent ? -explicitExponent : explicitExponent;
+	}
+
+	/* With up to 15 digits and 10^22 both operands are exact and the result is correctly rounded, like strtod()'s. */
+	if (digits <= 15 && exponent >= -22 && exponent <= 22) {
+		if (integer) {
+			/* The integer -0 is 0. */
+			result = negative ? (double)-(int_fast64_t)mantissa : (double)mantissa;
+			return true;
+		}
+
+		result = exponent < 0 ? mantissa / powersOf10[-exponent] : mantissa * powersOf10[exponent];
+
+		if (negative)
+			result = -result;
+
+		return true;
+	}
+
+	result = std::strtod(std::string(begin, m_Pos).c_str(), nullptr);
+
+	/* nlohmann rejects overflows */
+	return std::isfinite(result);
+}
+
+template<bool prettyPrint>
+inline
+JsonEncoder<prettyPrint>::JsonEncoder()
+{
+	m_Result.reserve(m_SizeHint);
+}
+
 template<bool prettyPrint>
 inline
 void JsonEncoder<prettyPrint>::Null()
@@ -377,32 +861,38 @@ void JsonEncoder<prettyPrint>::NumberFloat(double value)
 {
 	BeforeItem();
 
+	if (!std::isfinite(value)) {
+		AppendChars((const char*)l_Null, (const char*)l_Null + 4);
+		return;
+	}
+
+	char buffer[64];
+	char *end;
+
 	// Make sure 0.0 is serialized as 0, so e.g. Icinga DB can parse it as int.
 	if (value < 0) {
-		long long i = value;
-
-		if (i == value) {
-			AppendJson(i);
+		if (value >= -9223372036854775808.0 && (long long)value == value) {
+			end = std::to_chars(buffer, buffer + sizeof(buffer), (long long)value).ptr;
 		} else {
-			AppendJson(value);
+			end = nlohmann::detail::to_chars(buffer, buffer + sizeof(buffer), value);
 		}
 	} else {
-		unsigned long long i = value;
-
-		if (i == value) {
-			AppendJson(i);
+		if (value < 18446744073709551616.0 && (unsigned long long)value == value) {
+			end = std::to_chars(buffer, buffer + sizeof(buffer), (unsigned long long)value).ptr;
 		} else {
-			AppendJson(value);
+			end = nlohmann::detail::to_chars(buffer, buffer + sizeof(buffer), value);
 		}
 	}
+
+	AppendChars((const char*)buffer, (const char*)end);
 }
 
 template<bool prettyPrint>
 inline
-void JsonEncoder<prettyPrint>::Strng(String value)
+void JsonEncoder<prettyPrint>::Strng(const String& value)
 {
 	BeforeItem();
-	AppendJson(std::move(value));
+	AppendString(value);
 }
 
 template<bool prettyPrint>
@@ -412,14 +902,14 @@ void JsonEncoder<prettyPrint>::StartObject()
 	BeforeItem();
 	AppendChar('{');
 
-	m_CurrentSubtree.push(2);
+	m_CurrentSubtree.emplace_back(2);
 }
 
 template<bool prettyPrint>
 inline
-void JsonEncoder<prettyPrint>::Key(String value)
+void JsonEncoder<prettyPrint>::Key(const String& value)
 {
-	m_CurrentKey = std::move(value);
+	m_CurrentKey = &value;
 }
 
 template<bool prettyPrint>
@@ -436,7 +926,7 @@ void JsonEncoder<prettyPrint>::StartArray()
 	BeforeItem();
 	AppendChar('[');
 
-	m_CurrentSubtree.push(0);
+	m_CurrentSubtree.emplace_back(0);
 }
 
 template<bool prettyPrint>
@@ -450,14 +940,16 @@ template<bool prettyPrint>
 inline
 String JsonEncoder<prettyPrint>::GetResult()
 {
-	return String(m_Result.begin(), m_Result.end());
+	m_SizeHint = std::min(m_Result.size(), (size_t)1024u * 1024u);
+
+	return String(std::move(m_Result));
 }
 
 template<bool prettyPrint>
 inline
 void JsonEncoder<prettyPrint>::AppendChar(char c)
 {
-	m_Result.emplace_back(c);
+	m_Result += c;
 }
 
 template<bool prettyPrint>
@@ -465,14 +957,124 @@ template<class Iterator>
 inline
 void JsonEncoder<prettyPrint>::AppendChars(Iterator begin, Iterator end)
 {
-	m_Result.insert(m_Result.end(), begin, end);
+	m_Result.append(begin, end);
 }
 
 template<bool prettyPrint>
 inline
-void JsonEncoder<prettyPrint>::AppendJson(nlohmann::json json)
+void JsonEncoder<prettyPrint>::AppendString(const String& value)
 {
-	nlohmann::detail::serializer<nlohmann::json>(nlohmann::detail::output_adapter<char>(m_Result), ' ').dump(std::move(json), prettyPrint, true, 0);
+	AppendChar('"');
+	AppendEscaped(value.CStr(), value.CStr() + value.GetLength());
+	AppendChar('"');
+}
+
+/**
+ * Appends the characters escaped like nlohmann's serializer with ensure_ascii does.
+ * Invalid UTF-8 is replaced like Utility::ValidateUTF8() does.
+ */
+template<bool prettyPrint>
+void JsonEncoder<prettyPrint>::AppendEscaped(const char *pos, const char *end)
+{
+	static constexpr uint_fast64_t ones = 0x0101010101010101u, highs = 0x8080808080808080u;
+
+	bool validated = false;
+
+	while (pos != end) {
+		auto run (pos);
+
+		/* Skip 8 bytes at once until one of them is a '"', '\\', DEL, control or non-ASCII character. */
+		for (; end - pos >= 8; pos += 8) {
+			uint_fast64_t word;
+			memcpy(&word, pos, 8);
+
+			uint_fast64_t quotes = word ^ (ones * '"');
+			uint_fast64_t backslashes = word ^ (ones * '\\');
+			uint_fast64_t dels = word ^ (ones * 0x7F);
+			uint_fast64_t special = ((quotes - ones) & ~quotes) | ((backslashes - ones) & ~backslashes)
+				| ((dels - ones) & ~dels) | (word - ones * 0x20) | word;
+
+			if (special & highs)
+				break;
+		}
+
+		for (; pos != end; pos++) {
+			auto c ((unsigned char)*pos);
+
+			if (c == '"' || c == '\\' || c < 0x20 || c >= 0x7F)
+				break;
+		}
+
+		AppendChars(run, pos);
+
+		if (pos == end)
+			break;
+
+		auto c ((unsigned char)*pos);
+
+		switch (c) {
+			case '"':
+				AppendChars("\\\"", "\\\"" + 2);
+				break;
+			case '\\':
+				AppendChars("\\\\", "\\\\" + 2);
+				break;
+			case '\b':
+				AppendChars("\\b", "\\b" + 2);
+				break;
+			case '\t':
+				AppendChars("\\t", "\\t" + 2);
+				break;
+			case '\n':
+				AppendChars("\\n", "\\n" + 2);
+				break;
+			case '\f':
+				AppendChars("\\f", "\\f" + 2);
+				break;
+			case '\r':
+				AppendChars("\\r", "\\r" + 2);
+				break;
+			default:
+				if (c < 0x80) {
+					AppendUnicodeEscape(c);
+					break;
+				}
+
+				/* All bytes before are ASCII, so the rest starts at a character boundary. */
+				if (!validated) {
+					if (!utf8::is_valid(pos, end)) {
+						String valid (Utility::ValidateUTF8(String(pos, end)));
+
+						AppendEscaped(valid.CStr(), valid.CStr() + valid.GetLength());
+						return;
+					}
+
+					validated = true;
+				}
+
+				AppendUnicodeEscape(utf8::unchecked::next(pos));
+				continue;
+		}
+
+		pos++;
+	}
+}
+
+template<bool prettyPrint>
+inline
+void JsonEncoder<prettyPrint>::AppendUnicodeEscape(unsigned int codepoint)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	if (codepoint > 0xFFFF) {
+		AppendUnicodeEscape(0xD7C0u + (codepoint >> 10u));
+		AppendUnicodeEscape(0xDC00u + (codepoint & 0x3FFu));
+		return;
+	}
+
+	char escape[] = { '\\', 'u', hex[codepoint >> 12u], hex[(codepoint >> 8u) & 0xFu], hex[(codepoint >> 4u) & 0xFu], hex[codepoint & 0xFu] };
+
+	AppendChars((const char*)escape, (const char*)escape + sizeof(escape));
 }
 
 template<bool prettyPrint>
@@ -480,7 +1082,7 @@ inline
 void JsonEncoder<prettyPrint>::BeforeItem()
 {
 	if (!m_CurrentSubtree.empty()) {
-		auto& node (m_CurrentSubtree.top());
+		auto& node (m_CurrentSubtree.back());
 
 		if (node[0]) {
 			AppendChar(',');
@@ -497,7 +1099,7 @@ void JsonEncoder<prettyPrint>::BeforeItem()
 		}
 
 		if (node[1]) {
-			AppendJson(std::move(m_CurrentKey));
+			AppendString(*m_CurrentKey);
 			AppendChar(':');
 
 			if (prettyPrint) {
@@ -511,7 +1113,7 @@ template<bool prettyPrint>
 inline
 void JsonEncoder<prettyPrint>::FinishContainer(char terminator)
 {
-	if (prettyPrint && m_CurrentSubtree.top()[0]) {
+	if (prettyPrint && m_CurrentSubtree.back()[0]) {
 		AppendChar('\n');
 
 		for (auto i (m_CurrentSubtree.size() - 1u); i; --i) {
@@ -521,5 +1123,5 @@ void JsonEncoder<prettyPrint>::FinishContainer(char terminator)
 
 	AppendChar(terminator);
 
-	m_CurrentSubtree.pop();
+	m_CurrentSubtree.pop_back();
 }
@@ -287,13 +287,15 @@ Log::~Log()
 	}
 
 	for (const Logger::Ptr& logger : Logger::GetLoggers()) {
+		if (entry.Severity < logger->GetMinSeverity() || logger->EnqueueLogEntry(entry))
+			continue;
+
 		ObjectLock llock(logger);
 
 		if (!logger->IsActive())
 			continue;
 
-		if (entry.Severity >= logger->GetMinSeverity())
-			logger->ProcessLogEntry(entry);
+		logger->ProcessLogEntry(entry);
 
 #ifdef I2_DEBUG /* I2_DEBUG */
 		/* Always flush, don't depend on the timer. Enable this for development sprints on Linux/macOS only. Windows crashes. */
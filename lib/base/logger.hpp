@@ -64,6 +64,17 @@ public:
 	 */
 	virtual void ProcessLogEntry(const LogEntry& entry) = 0;
 
+	/**
+	 * Hands the log entry over to a background writer, without locking this object.
+	 *
+	 * @param entry The log entry that is to be processed.
+	 * @returns Whether it has been handed over, otherwise ProcessLogEntry() is called.
+	 */
+	virtual bool EnqueueLogEntry(const LogEntry&)
+	{
+		return false;
+	}
+
 	virtual void Flush() = 0;
 
 	static std::set<Logger::Ptr> GetLoggers();
@@ -121,7 +132,10 @@ public:
 	template<typename T>
 	Log& operator<<(const T& val)
 	{
-		m_Buffer << val;
+		if (!m_IsNoOp) {
+			m_Buffer << val;
+		}
+
 		return *this;
 	}
 
@@ -0,0 +1,127 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef LRUCACHE_H
+#define LRUCACHE_H
+
+#include "base/i2-base.hpp"
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace icinga
+{
+
+/**
+ * A thread-safe map which drops the least recently used entries beyond its capacity.
+ *
+ * Meant for values which are expensive to compute, but cheap to copy, e.g. smart pointers to
+ * immutable objects. Values are computed without holding the lock.
+ *
+ * @ingroup base
+ */
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache
+{
+public:
+	explicit LruCache(size_t capacity)
+		: m_Capacity(capacity)
+	{ }
+
+	LruCache(const LruCache&) = delete;
+	LruCache& operator=(const LruCache&) = delete;
+
+	/**
+	 * Returns the cached value for the key or computes and adds it. If compute() throws,
+	 * nothing is added.
+	 */
+	template<typename F>
+	Value Get(const Key& key, F&& compute)
+	{
+		{
+			std::unique_lock<std::mutex> lock (m_Mutex);
+			Value value;
+
+			if (Find(key, value))
+				return value;
+		}
+
+		Value value (compute());
+
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		/* Another thread may have been faster, keep its value so that all of them share one. */
+		Value existing;
+
+		if (Find(key, existing))
+			return existing;
+
+		m_Entries.emplace_front(key, value);
+		m_Index.emplace(key, m_Entries.begin());
+
+		if (m_Entries.size() > m_Capacity) {
+			m_Index.erase(m_Entries.back().first);
+			m_Entries.pop_back();
+		}
+
+		return value;
+	}
+
+	size_t GetSize() const
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+		return m_Entries.size();
+	}
+
+	size_t GetCapacity() const
+	{
+		return m_Capacity;
+	}
+
+	void Remove(const Key& key)
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		auto pos (m_Index.find(key));
+
+		if (pos != m_Index.end()) {
+			m_Entries.erase(pos->second);
+			m_Index.erase(pos);
+		}
+	}
+
+	void Clear()
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		m_Index.clear();
+		m_Entries.clear();
+	}
+
+private:
+	typedef std::list<std::pair<Key, Value>> EntryList;
+
+	mutable std::mutex m_Mutex;
+	size_t m_Capacity;
+	EntryList m_Entries; /**< Most recently used first */
+	std::unordered_map<Key, typename EntryList::iterator, Hash> m_Index;
+
+	bool Find(const Key& key, Value& value)
+	{
+		auto pos (m_Index.find(key));
+
+		if (pos == m_Index.end())
+			return false;
+
+		m_Entries.splice(m_Entries.begin(), m_Entries, pos->second);
+		value = pos->second->second;
+
+		return true;
+	}
+};
+
+}
+
+#endif /* LRUCACHE_H */
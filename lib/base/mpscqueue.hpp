@@ -0,0 +1,95 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+namespace icinga
+{
+
+/**
+ * An unbounded multi-producer/single-consumer FIFO queue.
+ *
+ * Push() may be called by any thread and never blocks, it's just one atomic exchange.
+ * Pop() must only ever be called by one (the same) consumer thread.
+ *
+ * @ingroup base
+ */
+template<typename T>
+class MpscQueue
+{
+public:
+	MpscQueue()
+		: m_Head(new Node()), m_Tail(m_Head.load())
+	{ }
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	~MpscQueue()
+	{
+		T value;
+
+		while (Pop(value))
+			;
+
+		delete m_Tail;
+	}
+
+	void Push(T value)
+	{
+		Node *node = new Node(std::move(value));
+		Node *prev = m_Head.exchange(node, std::memory_order_acq_rel);
+
+		prev->Next.store(node, std::memory_order_release);
+	}
+
+	/**
+	 * Takes the oldest item from the queue.
+	 *
+	 * As producers link their items right after the exchange in Push(), this may briefly
+	 * return false even though another thread has already started to push an item.
+	 *
+	 * @param value Receives the item.
+	 * @returns Whether there was an item.
+	 */
+	bool Pop(T& value)
+	{
+		Node *tail = m_Tail;
+		Node *next = tail->Next.load(std::memory_order_acquire);
+
+		if (!next)
+			return false;
+
+		/* The current tail is a dummy node, its successor holds the item and becomes the new dummy. */
+		value = std::move(next->Value);
+		next->Value = T();
+		m_Tail = next;
+
+		delete tail;
+
+		return true;
+	}
+
+private:
+	struct Node
+	{
+		std::atomic<Node *> Next{nullptr};
+		T Value;
+
+		Node() = default;
+
+		Node(T value)
+			: Value(std::move(value))
+		{ }
+	};
+
+	std::atomic<Node *> m_Head;
+	Node *m_Tail;
+};
+
+}
+
+#endif /* MPSCQUEUE_H */
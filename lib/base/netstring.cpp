@@ -119,28 +119,39 @@ size_t NetString::WriteStringToStream(const Stream::Ptr& stream, const String& s
 }
 
 /**
- * Reads data from a stream in netstring format.
- *
- * @param stream The stream to read from.
- * @returns The String that has been read from the IOQueue.
- * @exception invalid_argument The input stream is invalid.
- * @see https://github.com/PeterScott/netstring-c/blob/master/netstring.c
+ * Reads exactly size bytes. They're copied from the stream's read buffer, which is refilled
+ * by fill() only once it runs empty. So netstrings which have been received along with
+ * the previous one don't cost any I/O operation, unlike async_read() which would even
+ * suspend the coroutine for every single byte of the length prefix.
  */
-String NetString::ReadStringFromStream(const Shared<AsioTlsStream>::Ptr& stream,
-	ssize_t maxMessageLength)
+template<class Fill>
+static void ReadBuffered(AsioTlsStream& stream, char *data, size_t size, const Fill& fill)
 {
 	namespace asio = boost::asio;
 
+	while (size) {
+		if (!stream.in_avail()) {
+			fill();
+		}
+
+		// Doesn't do any I/O as long as there's something in the buffer.
+		size_t read = stream.read_some(asio::mutable_buffer(data, size));
+
+		data += read;
+		size -= read;
+	}
+}
+
+template<class Fill>
+static String ReadNetString(AsioTlsStream& stream, ssize_t maxMessageLength, const Fill& fill)
+{
 	size_t len = 0;
 	bool leadingZero = false;
 
 	for (uint_fast8_t readBytes = 0;; ++readBytes) {
 		char byte = 0;
 
-		{
-			asio::mutable_buffer byteBuf (&byte, 1);
-			asio::read(*stream, byteBuf);
-		}
+		ReadBuffered(stream, &byte, 1, fill);
 
 		if (isdigit(byte)) {
 			if (readBytes == 9) {
@@ -179,16 +190,12 @@ String NetString::ReadStringFromStream(const Shared<AsioTlsStream>::Ptr& stream,
 	if (len) {
 		payload.Append(len, 0);
 
-		asio::mutable_buffer payloadBuf (&*payload.Begin(), payload.GetLength());
-		asio::read(*stream, payloadBuf);
+		ReadBuffered(stream, &*payload.Begin(), payload.GetLength(), fill);
 	}
 
 	char trailer = 0;
 
-	{
-		asio::mutable_buffer trailerBuf (&trailer, 1);
-		asio::read(*stream, trailerBuf);
-	}
+	ReadBuffered(stream, &trailer, 1, fill);
 
 	if (trailer != ',') {
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (missing ,)"));
@@ -206,74 +213,23 @@ String NetString::ReadStringFromStream(const Shared<AsioTlsStream>::Ptr& stream,
  * @see https://github.com/PeterScott/netstring-c/blob/master/netstring.c
  */
 String NetString::ReadStringFromStream(const Shared<AsioTlsStream>::Ptr& stream,
-	boost::asio::yield_context yc, ssize_t maxMessageLength)
+	ssize_t maxMessageLength)
 {
-	namespace asio = boost::asio;
-
-	size_t len = 0;
-	bool leadingZero = false;
-
-	for (uint_fast8_t readBytes = 0;; ++readBytes) {
-		char byte = 0;
-
-		{
-			asio::mutable_buffer byteBuf (&byte, 1);
-			asio::async_read(*stream, byteBuf, yc);
-		}
-
-		if (isdigit(byte)) {
-			if (readBytes == 9) {
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Length specifier must not exceed 9 characters"));
-			}
-
-			if (leadingZero) {
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (leading zero)"));
-			}
-
-			len = len * 10u + size_t(byte - '0');
-
-			if (!readBytes && byte == '0') {
-				leadingZero = true;
-			}
-		} else if (byte == ':') {
-			if (!readBytes) {
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (no length specifier)"));
-			}
-
-			break;
-		} else {
-			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (missing :)"));
-		}
-	}
-
-	if (maxMessageLength >= 0 && len > maxMessageLength) {
-		std::stringstream errorMessage;
-		errorMessage << "Max data length exceeded: " << (maxMessageLength / 1024) << " KB";
-
-		BOOST_THROW_EXCEPTION(std::invalid_argument(errorMessage.str()));
-	}
-
-	String payload;
-
-	if (len) {
-		payload.Append(len, 0);
-
-		asio::mutable_buffer payloadBuf (&*payload.Begin(), payload.GetLength());
-		asio::async_read(*stream, payloadBuf, yc);
-	}
-
-	char trailer = 0;
-
-	{
-		asio::mutable_buffer trailerBuf (&trailer, 1);
-		asio::async_read(*stream, trailerBuf, yc);
-	}
-
-	if (trailer != ',') {
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (missing ,)"));
-	}
+	return ReadNetString(*stream, maxMessageLength, [&stream]() { stream->fill(); });
+}
 
-	return payload;
+/**
+ * Reads data from a stream in netstring format.
+ *
+ * @param stream The stream to read from.
+ * @returns The String that has been read from the IOQueue.
+ * @exception invalid_argument The input stream is invalid.
+ * @see https://github.com/PeterScott/netstring-c/blob/master/netstring.c
+ */
+String NetString::ReadStringFromStream(const Shared<AsioTlsStream>::Ptr& stream,
+	boost::asio::yield_context yc, ssize_t maxMessageLength)
+{
+	return ReadNetString(*stream, maxMessageLength, [&stream, &yc]() { stream->async_fill(yc); });
 }
 
 /**
@@ -7,8 +7,10 @@
 #include "base/objectlock.hpp"
 #include <algorithm>
 #include <climits>
+#include <cstring>
 #include <cstdint>
 #include <string>
+#include <stdexcept>
 #include <utility>
 
 using namespace icinga;
@@ -29,7 +31,8 @@ static const EndiannessDetector l_EndiannessDetector;
 // Assumption: The compiler will optimize (away) if/else statements using this.
 #define MACHINE_LITTLE_ENDIAN (l_EndiannessDetector.buf[0])
 
-static void PackAny(const Value& value, std::string& builder);
+template<class Builder>
+static void PackAny(const Value& value, Builder& builder);
 
 /**
  * std::swap() seems not to work
@@ -72,7 +75,8 @@ static inline char UIntToByte(unsigned i)
 /**
  * Append the given int as big-endian 64-bit unsigned int
  */
-static inline void PackUInt64BE(uint_least64_t i, std::string& builder)
+template<class Builder>
+static inline void PackUInt64BE(uint_least64_t i, Builder& builder)
 {
 	char buf[8] = {
 		UIntToByte(i >> 56u),
@@ -109,7 +113,8 @@ union Double2BytesConverter
 /**
  * Append the given double as big-endian IEEE 754 binary64
  */
-static inline void PackFloat64BE(double f, std::string& builder)
+template<class Builder>
+static inline void PackFloat64BE(double f, Builder& builder)
 {
 	Double2BytesConverter converter;
 
@@ -128,16 +133,18 @@ static inline void PackFloat64BE(double f, std::string& builder)
 /**
  * Append the given string's length (BE uint64) and the string itself
  */
-static inline void PackString(const String& string, std::string& builder)
+template<class Builder>
+static inline void PackString(const String& string, Builder& builder)
 {
 	PackUInt64BE(string.GetLength(), builder);
-	builder += string.GetData();
+	builder.append(string.CStr(), string.GetLength());
 }
 
 /**
  * Append the given array
  */
-static inline void PackArray(const Array::Ptr& arr, std::string& builder)
+template<class Builder>
+static inline void PackArray(const Array::Ptr& arr, Builder& builder)
 {
 	ObjectLock olock(arr);
 
@@ -152,7 +159,8 @@ static inline void PackArray(const Array::Ptr& arr, std::string& builder)
 /**
  * Append the given dictionary
  */
-static inline void PackDictionary(const Dictionary::Ptr& dict, std::string& builder)
+template<class Builder>
+static inline void PackDictionary(const Dictionary::Ptr& dict, Builder& builder)
 {
 	ObjectLock olock(dict);
 
@@ -168,7 +176,8 @@ static inline void PackDictionary(const Dictionary::Ptr& dict, std::string& buil
 /**
  * Append any JSON-encodable value
  */
-static void PackAny(const Value& value, std::string& builder)
+template<class Builder>
+static void PackAny(const Value& value, Builder& builder)
 {
 	switch (value.GetType()) {
 		case ValueString:
@@ -244,3 +253,249 @@ String icinga::PackObject(const Value& value)
 
 	return std::move(builder);
 }
+
+/**
+ * Collects the output of PackAny() in a buffer of fixed size which is passed to a PackObjectSink when full
+ */
+class PackObjectSinkBuilder
+{
+public:
+	inline PackObjectSinkBuilder(PackObjectSink& sink) : m_Sink(sink), m_Length(0)
+	{
+	}
+
+	PackObjectSinkBuilder(const PackObjectSinkBuilder&) = delete;
+	PackObjectSinkBuilder& operator=(const PackObjectSinkBuilder&) = delete;
+
+	inline void append(const char *data, size_t length)
+	{
+		if (m_Length + length > sizeof(m_Buffer)) {
+			Flush();
+
+			if (length > sizeof(m_Buffer)) {
+				m_Sink.Write(data, length);
+				return;
+			}
+		}
+
+		memcpy(m_Buffer + m_Length, data, length);
+		m_Length += length;
+	}
+
+	inline PackObjectSinkBuilder& operator+=(char c)
+	{
+		if (m_Length == sizeof(m_Buffer)) {
+			Flush();
+		}
+
+		m_Buffer[m_Length++] = c;
+		return *this;
+	}
+
+	inline void Flush()
+	{
+		if (m_Length) {
+			m_Sink.Write(m_Buffer, m_Length);
+			m_Length = 0;
+		}
+	}
+
+private:
+	PackObjectSink& m_Sink;
+	char m_Buffer[4096];
+	size_t m_Length;
+};
+
+/**
+ * Pack any JSON-encodable value like PackObject() without storing the whole result
+ *
+ * @param value The value to pack
+ * @param sink Receives the packed value in consecutive pieces
+ */
+void icinga::PackObject(const Value& value, PackObjectSink& sink)
+{
+	PackObjectSinkBuilder builder (sink);
+	PackAny(value, builder);
+	builder.Flush();
+}
+
+/**
+ * A read position within the packed input of UnpackObject()
+ */
+struct UnpackCursor
+{
+	const char *Pos;
+	const char *End;
+
+	inline void Require(uint_least64_t length) const
+	{
+		if (uint_least64_t(End - Pos) < length) {
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Packed object is truncated."));
+		}
+	}
+};
+
+static Value UnpackAny(UnpackCursor& cursor, unsigned depth);
+
+/**
+ * Read a big-endian 64-bit unsigned int
+ */
+static inline uint_least64_t UnpackUInt64BE(UnpackCursor& cursor)
+{
+	cursor.Require(8);
+
+	uint_least64_t i = 0;
+
+	for (int j = 0; j < 8; j++) {
+		i = (i << 8u) | (unsigned char)cursor.Pos[j];
+	}
+
+	cursor.Pos += 8;
+
+	return i;
+}
+
+/**
+ * Read a big-endian IEEE 754 binary64
+ */
+static inline double UnpackFloat64BE(UnpackCursor& cursor)
+{
+	cursor.Require(8);
+
+	Double2BytesConverter converter;
+
+	memcpy(converter.buf, cursor.Pos, 8);
+	cursor.Pos += 8;
+
+	if (MACHINE_LITTLE_ENDIAN) {
+		SwapBytes(converter.buf[0], converter.buf[7]);
+		SwapBytes(converter.buf[1], converter.buf[6]);
+		SwapBytes(converter.buf[2], converter.buf[5]);
+		SwapBytes(converter.buf[3], converter.buf[4]);
+	}
+
+	return converter.f;
+}
+
+/**
+ * Read a string's length (BE uint64) and the string itself
+ */
+static inline String UnpackString(UnpackCursor& cursor)
+{
+	auto length (UnpackUInt64BE(cursor));
+
+	cursor.Require(length);
+
+	String string (cursor.Pos, cursor.Pos + length);
+	cursor.Pos += length;
+
+	return string;
+}
+
+/**
+ * Read an element count and make sure the input has at least one byte left per element
+ */
+static inline uint_least64_t UnpackLength(UnpackCursor& cursor)
+{
+	auto length (UnpackUInt64BE(cursor));
+
+	cursor.Require(length);
+
+	return length;
+}
+
+/**
+ * Read any value written by PackAny()
+ */
+static Value UnpackAny(UnpackCursor& cursor, unsigned depth)
+{
+	/* Deeper structures aren't produced by us and would only exhaust the stack. */
+	if (depth > 128) {
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Packed object is nested too deeply."));
+	}
+
+	cursor.Require(1);
+
+	switch (*cursor.Pos++) {
+		case '\0':
+			return Empty;
+
+		case '\1':
+			return false;
+
+		case '\2':
+			return true;
+
+		case '\3':
+			return UnpackFloat64BE(cursor);
+
+		case '\4':
+			return UnpackString(cursor);
+
+		case '\5':
+			{
+				auto length (UnpackLength(cursor));
+				ArrayData values;
+
+				values.reserve(length);
+
+				for (uint_least64_t i = 0; i < length; i++) {
+					values.emplace_back(UnpackAny(cursor, depth + 1));
+				}
+
+				return new Array(std::move(values));
+			}
+
+		case '\6':
+			{
+				auto length (UnpackLength(cursor));
+				DictionaryData values;
+
+				values.reserve(length);
+
+				for (uint_least64_t i = 0; i < length; i++) {
+					auto key (UnpackString(cursor));
+					values.emplace_back(std::move(key), UnpackAny(cursor, depth + 1));
+				}
+
+				return new Dictionary(std::move(values));
+			}
+
+		default:
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Packed object contains an invalid type."));
+	}
+}
+
+/**
+ * Unpack a value packed by PackObject()
+ *
+ * Non-container objects were packed as null, so they come back as null.
+ *
+ * @param packed The packed value.
+ *
+ * @return The value.
+ */
+Value icinga::UnpackObject(const String& packed)
+{
+	return UnpackObject(packed.CStr(), packed.CStr() + packed.GetLength());
+}
+
+/**
+ * Unpack a value packed by PackObject() from a memory range, e.g. a mapped file
+ *
+ * @param begin The start of the packed value.
+ * @param end The end of the packed value.
+ *
+ * @return The value.
+ */
+Value icinga::UnpackObject(const char *begin, const char *end)
+{
+	UnpackCursor cursor { begin, end };
+	Value value = UnpackAny(cursor, 0);
+
+	if (cursor.Pos != cursor.End) {
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Packed object is followed by garbage."));
+	}
+
+	return value;
+}
@@ -11,7 +11,24 @@ namespace icinga
 class String;
 class Value;
 
+/**
+ * Receives the output of PackObject() in pieces, e.g. to hash it without storing it.
+ *
+ * @ingroup base
+ */
+class PackObjectSink
+{
+public:
+	virtual void Write(const char *data, size_t length) = 0;
+
+protected:
+	~PackObjectSink() = default;
+};
+
 String PackObject(const Value& value);
+void PackObject(const Value& value, PackObjectSink& sink);
+Value UnpackObject(const String& packed);
+Value UnpackObject(const char *begin, const char *end);
 
 }
 
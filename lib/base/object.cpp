@@ -8,8 +8,8 @@
 #include "base/timer.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
+#include "base/profiler.hpp"
 #include <boost/lexical_cast.hpp>
-#include <boost/thread/recursive_mutex.hpp>
 #include <thread>
 
 using namespace icinga;
@@ -49,6 +49,15 @@ String Object::ToString() const
 	return "Object of type '" + GetReflectionType()->GetName() + "'";
 }
 
+/**
+ * Returns whether more than one smart pointer references this object, i.e. whether it may be
+ * used by someone else. Otherwise the caller holds the only reference and may reuse the object.
+ */
+bool Object::IsShared() const
+{
+	return m_References.load() > 1u;
+}
+
 #ifdef I2_DEBUG
 /**
  * Checks if the calling thread owns the lock on this object.
@@ -165,6 +174,14 @@ void Object::NotifyField(int id, const Value& cookie)
 	BOOST_THROW_EXCEPTION(std::runtime_error("Invalid field ID."));
 }
 
+/**
+ * Called by the generated setters whenever a state attribute changes.
+ */
+void Object::MarkStateDirty()
+{
+	/* Nothing to do here. */
+}
+
 Object::Ptr Object::NavigateField(int id) const
 {
 	BOOST_THROW_EXCEPTION(std::runtime_error("Invalid field ID."));
@@ -241,12 +258,16 @@ INITIALIZE_ONCE([]() {
 
 void icinga::intrusive_ptr_add_ref(Object *object)
 {
+	auto previous (object->m_References.fetch_add(1));
+
+	if (previous == 0u) {
 #ifdef I2_LEAK_DEBUG
-	if (object->m_References.fetch_add(1) == 0u)
 		TypeAddObject(object);
-#else /* I2_LEAK_DEBUG */
-	object->m_References.fetch_add(1);
 #endif /* I2_LEAK_DEBUG */
+
+		if (Profiler::IsEnabled())
+			Profiler::RecordAllocation(typeid(*object));
+	}
 }
 
 void icinga::intrusive_ptr_release(Object *object)
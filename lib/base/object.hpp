@@ -5,6 +5,7 @@
 
 #include "base/i2-base.hpp"
 #include "base/debug.hpp"
+#include "base/objectmutex.hpp"
 #include <boost/smart_ptr/intrusive_ptr.hpp>
 #include <atomic>
 #include <cstddef>
@@ -175,6 +176,7 @@ public:
 	virtual bool GetOwnField(const String& field, Value *result) const;
 	virtual void ValidateField(int id, const Lazy<Value>& lvalue, const ValidationUtils& utils);
 	virtual void NotifyField(int id, const Value& cookie = Empty);
+	virtual void MarkStateDirty();
 	virtual Object::Ptr NavigateField(int id) const;
 
 #ifdef I2_DEBUG
@@ -185,6 +187,8 @@ public:
 
 	virtual Object::Ptr Clone() const;
 
+	bool IsShared() const;
+
 	static intrusive_ptr<Type> TypeInstance;
 
 private:
@@ -192,7 +196,7 @@ private:
 	Object& operator=(const Object& rhs) = delete;
 
 	std::atomic<uint_fast64_t> m_References;
-	mutable std::recursive_mutex m_Mutex;
+	mutable ObjectMutex m_Mutex;
 
 #ifdef I2_DEBUG
 	mutable std::atomic<std::thread::id> m_LockOwner;
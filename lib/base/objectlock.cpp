@@ -1,6 +1,8 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "base/objectlock.hpp"
+#include "base/profiler.hpp"
+#include <chrono>
 #include <thread>
 
 using namespace icinga;
@@ -14,12 +16,14 @@ ObjectLock::~ObjectLock()
 }
 
 ObjectLock::ObjectLock(const Object::Ptr& object)
-	: ObjectLock(object.get())
+	: m_Object(object.get()), m_CallSite(I2_RETURN_ADDRESS()), m_Locked(false)
 {
+	if (m_Object)
+		Lock();
 }
 
 ObjectLock::ObjectLock(const Object *object)
-	: m_Object(object), m_Locked(false)
+	: m_Object(object), m_CallSite(I2_RETURN_ADDRESS()), m_Locked(false)
 {
 	if (m_Object)
 		Lock();
@@ -29,7 +33,16 @@ void ObjectLock::Lock()
 {
 	ASSERT(!m_Locked && m_Object);
 
-	m_Object->m_Mutex.lock();
+	if (!Profiler::IsEnabled()) {
+		m_Object->m_Mutex.lock();
+	} else if (!m_Object->m_Mutex.try_lock()) {
+		auto start (std::chrono::steady_clock::now());
+
+		m_Object->m_Mutex.lock();
+
+		Profiler::RecordLockWait(m_Object, m_CallSite,
+			std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
 
 	m_Locked = true;
 
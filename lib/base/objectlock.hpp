@@ -27,6 +27,7 @@ public:
 
 private:
 	const Object *m_Object{nullptr};
+	const void *m_CallSite{nullptr}; /**< For the Profiler */
 	bool m_Locked{false};
 };
 
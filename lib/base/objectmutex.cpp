@@ -0,0 +1,102 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/objectmutex.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#	include <immintrin.h>
+#endif
+
+using namespace icinga;
+
+/**
+ * Where threads wait for any of the ObjectMutexes hashed to it.
+ */
+struct ObjectMutexWaitList
+{
+	std::mutex Mutex;
+	std::condition_variable CV;
+};
+
+static ObjectMutexWaitList l_WaitLists[64];
+
+static ObjectMutexWaitList& GetWaitList(const ObjectMutex *mutex)
+{
+	return l_WaitLists[std::hash<const ObjectMutex*>()(mutex) / alignof(std::max_align_t) % (sizeof(l_WaitLists) / sizeof(l_WaitLists[0]))];
+}
+
+static std::atomic<uint32_t> l_NextThreadId (1);
+
+uint32_t ObjectMutex::GetThreadId()
+{
+	/* Even and non-zero, the lowest bit is HasWaiters. */
+	static thread_local const uint32_t id = l_NextThreadId.fetch_add(1) << 1u;
+
+	return id;
+}
+
+static inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	_mm_pause();
+#else /* x86 */
+	std::this_thread::yield();
+#endif /* x86 */
+}
+
+void ObjectMutex::LockSlow()
+{
+	auto me (GetThreadId());
+
+	/* Most critical sections are over after a few hundred cycles. */
+	for (int i = 0; i < 100; i++) {
+		CpuRelax();
+
+		uint32_t expected = 0;
+
+		if (m_State.load(std::memory_order_relaxed) == 0
+			&& m_State.compare_exchange_weak(expected, me, std::memory_order_acquire, std::memory_order_relaxed)) {
+			m_Depth = 1;
+			return;
+		}
+	}
+
+	auto& waitList (GetWaitList(this));
+	std::unique_lock<std::mutex> lock (waitList.Mutex);
+
+	for (;;) {
+		auto state (m_State.load(std::memory_order_relaxed));
+
+		if (state == 0) {
+			/* Other threads may still be waiting, so the next unlock() has to wake them. */
+			if (m_State.compare_exchange_weak(state, me | HasWaiters, std::memory_order_acquire, std::memory_order_relaxed))
+				break;
+
+			continue;
+		}
+
+		if (!(state & HasWaiters) && !m_State.compare_exchange_weak(state, state | HasWaiters, std::memory_order_relaxed))
+			continue;
+
+		/* unlock() takes the wait list's mutex before notifying, so the wakeup can't get lost. */
+		waitList.CV.wait(lock);
+	}
+
+	m_Depth = 1;
+}
+
+void ObjectMutex::WakeWaiters()
+{
+	auto& waitList (GetWaitList(this));
+
+	{
+		std::unique_lock<std::mutex> lock (waitList.Mutex);
+	}
+
+	/* The wait list is shared with other mutexes, their waiters just check again. */
+	waitList.CV.notify_all();
+}
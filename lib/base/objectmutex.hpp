@@ -0,0 +1,80 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef OBJECTMUTEX_H
+#define OBJECTMUTEX_H
+
+#include "base/i2-base.hpp"
+#include <atomic>
+#include <cstdint>
+
+namespace icinga
+{
+
+/**
+ * The recursive mutex of every Object, locked via ObjectLock.
+ *
+ * Locking an unlocked mutex or one already held by the calling thread is a single atomic operation.
+ * On contention it spins for a short while first, as most critical sections are short. Only then it
+ * parks the thread in one of a few shared wait lists, so that every Object only needs eight bytes
+ * instead of a std::recursive_mutex.
+ *
+ * @ingroup base
+ */
+class ObjectMutex final
+{
+public:
+	ObjectMutex() = default;
+
+	ObjectMutex(const ObjectMutex&) = delete;
+	ObjectMutex& operator=(const ObjectMutex&) = delete;
+
+	inline bool try_lock()
+	{
+		auto me (GetThreadId());
+		auto state (m_State.load(std::memory_order_relaxed));
+
+		/* Only this thread itself could have stored its ID. */
+		if ((state & ~HasWaiters) == me) {
+			m_Depth++;
+			return true;
+		}
+
+		if (state == 0 && m_State.compare_exchange_strong(state, me, std::memory_order_acquire, std::memory_order_relaxed)) {
+			m_Depth = 1;
+			return true;
+		}
+
+		return false;
+	}
+
+	inline void lock()
+	{
+		if (!try_lock())
+			LockSlow();
+	}
+
+	inline void unlock()
+	{
+		if (--m_Depth)
+			return;
+
+		if (m_State.exchange(0, std::memory_order_release) & HasWaiters)
+			WakeWaiters();
+	}
+
+private:
+	/* The owning thread's ID (an even number, or 0 if unlocked) plus whether any thread is waiting for it */
+	std::atomic<uint32_t> m_State {0};
+	uint32_t m_Depth {0}; /**< Recursion depth, only accessed by the owner */
+
+	static constexpr uint32_t HasWaiters = 1;
+
+	static uint32_t GetThreadId();
+
+	void LockSlow();
+	void WakeWaiters();
+};
+
+}
+
+#endif /* OBJECTMUTEX_H */
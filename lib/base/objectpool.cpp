@@ -0,0 +1,204 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/objectpool.hpp"
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <set>
+
+using namespace icinga;
+
+static constexpr size_t l_PoolGranularity = 16;
+static constexpr size_t l_PoolClasses = ObjectPool::MaxBlockSize / l_PoolGranularity;
+
+namespace
+{
+
+struct FreeBlock
+{
+	FreeBlock *Next;
+};
+
+struct ThreadCache;
+
+/**
+ * Counters of all threads, so that the stats can be summed up without touching shared
+ * cache lines on every allocation.
+ */
+struct PoolStats
+{
+	std::mutex Mutex;
+	std::set<ThreadCache *> Caches;
+	uint_fast64_t RetiredAllocations{0};
+	uint_fast64_t RetiredHits{0};
+};
+
+PoolStats& GetPoolStats()
+{
+	/* Intentionally leaked, threads may exit during static destruction. */
+	static auto stats (new PoolStats());
+
+	return *stats;
+}
+
+struct ThreadCache
+{
+	FreeBlock *Blocks[l_PoolClasses]{};
+	size_t Counts[l_PoolClasses]{};
+	std::atomic<uint_fast64_t> Allocations{0};
+	std::atomic<uint_fast64_t> Hits{0};
+	std::atomic<uint_fast64_t> CachedBytes{0};
+
+	ThreadCache()
+	{
+		auto& stats (GetPoolStats());
+		std::unique_lock<std::mutex> lock (stats.Mutex);
+
+		stats.Caches.insert(this);
+	}
+
+	~ThreadCache();
+};
+
+thread_local bool l_ThreadCacheGone = false;
+thread_local ThreadCache l_ThreadCache;
+
+ThreadCache::~ThreadCache()
+{
+	for (size_t i = 0; i < l_PoolClasses; i++) {
+		while (Blocks[i]) {
+			FreeBlock *block = Blocks[i];
+			Blocks[i] = block->Next;
+			::operator delete(block);
+		}
+	}
+
+	auto& stats (GetPoolStats());
+	std::unique_lock<std::mutex> lock (stats.Mutex);
+
+	stats.Caches.erase(this);
+	stats.RetiredAllocations += Allocations.load(std::memory_order_relaxed);
+	stats.RetiredHits += Hits.load(std::memory_order_relaxed);
+
+	l_ThreadCacheGone = true;
+}
+
+}
+
+static inline size_t GetPoolClass(size_t size)
+{
+	return (size + l_PoolGranularity - 1) / l_PoolGranularity - 1;
+}
+
+/**
+ * Allocates a memory block.
+ *
+ * @param size The block size.
+ * @returns The block.
+ */
+void *ObjectPool::Allocate(size_t size)
+{
+	if (size == 0 || size > MaxBlockSize || l_ThreadCacheGone)
+		return ::operator new(size);
+
+	size_t cls = GetPoolClass(size);
+	ThreadCache& cache (l_ThreadCache);
+
+	/* Only this thread writes its counters. */
+	cache.Allocations.store(cache.Allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	FreeBlock *block = cache.Blocks[cls];
+
+	if (!block)
+		return ::operator new((cls + 1) * l_PoolGranularity);
+
+	cache.Blocks[cls] = block->Next;
+	cache.Counts[cls]--;
+	cache.Hits.store(cache.Hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	cache.CachedBytes.store(cache.CachedBytes.load(std::memory_order_relaxed) - (cls + 1) * l_PoolGranularity, std::memory_order_relaxed);
+
+	return block;
+}
+
+/**
+ * Frees a memory block allocated by Allocate(). It may have been allocated by any thread.
+ *
+ * @param ptr The block.
+ * @param size The block size, must be the same as passed to Allocate().
+ */
+void ObjectPool::Free(void *ptr, size_t size) noexcept
+{
+	if (!ptr)
+		return;
+
+	if (size == 0 || size > MaxBlockSize || l_ThreadCacheGone) {
+		::operator delete(ptr);
+		return;
+	}
+
+	size_t cls = GetPoolClass(size);
+	ThreadCache& cache (l_ThreadCache);
+
+	if (cache.Counts[cls] >= MaxCachedBlocks) {
+		::operator delete(ptr);
+		return;
+	}
+
+	auto block (static_cast<FreeBlock *>(ptr));
+
+	block->Next = cache.Blocks[cls];
+	cache.Blocks[cls] = block;
+	cache.Counts[cls]++;
+	cache.CachedBytes.store(cache.CachedBytes.load(std::memory_order_relaxed) + (cls + 1) * l_PoolGranularity, std::memory_order_relaxed);
+}
+
+/**
+ * Returns the number of allocations served by the pool since the program started.
+ *
+ * @returns The number of allocations.
+ */
+uint_fast64_t ObjectPool::GetAllocations()
+{
+	auto& stats (GetPoolStats());
+	std::unique_lock<std::mutex> lock (stats.Mutex);
+	uint_fast64_t allocations = stats.RetiredAllocations;
+
+	for (auto cache : stats.Caches)
+		allocations += cache->Allocations.load(std::memory_order_relaxed);
+
+	return allocations;
+}
+
+/**
+ * Returns the number of allocations which didn't need to call into the heap.
+ *
+ * @returns The number of allocations.
+ */
+uint_fast64_t ObjectPool::GetHits()
+{
+	auto& stats (GetPoolStats());
+	std::unique_lock<std::mutex> lock (stats.Mutex);
+	uint_fast64_t hits = stats.RetiredHits;
+
+	for (auto cache : stats.Caches)
+		hits += cache->Hits.load(std::memory_order_relaxed);
+
+	return hits;
+}
+
+/**
+ * Returns the total size of all blocks currently kept in the threads' free lists.
+ *
+ * @returns The size in bytes.
+ */
+uint_fast64_t ObjectPool::GetCachedBytes()
+{
+	auto& stats (GetPoolStats());
+	std::unique_lock<std::mutex> lock (stats.Mutex);
+	uint_fast64_t bytes = 0;
+
+	for (auto cache : stats.Caches)
+		bytes += cache->CachedBytes.load(std::memory_order_relaxed);
+
+	return bytes;
+}
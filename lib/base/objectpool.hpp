@@ -0,0 +1,54 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include "base/i2-base.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace icinga
+{
+
+/**
+ * Thread-local caches of fixed-size memory blocks for small, short-lived objects.
+ *
+ * Freed blocks are kept on a per-thread free list of their size class and handed out
+ * again by the next allocation of that size on the same thread, so bursts of temporary
+ * objects (e.g. the dictionaries built while processing a check result) mostly don't
+ * hit malloc. Each free list is bounded, surplus blocks go back to the heap.
+ *
+ * @ingroup base
+ */
+class ObjectPool
+{
+public:
+	static constexpr size_t MaxBlockSize = 512;
+	static constexpr size_t MaxCachedBlocks = 512;
+
+	static void *Allocate(size_t size);
+	static void Free(void *ptr, size_t size) noexcept;
+
+	static uint_fast64_t GetAllocations();
+	static uint_fast64_t GetHits();
+	static uint_fast64_t GetCachedBytes();
+};
+
+/**
+ * Makes a class allocate its instances via the ObjectPool.
+ * Use it only in final classes, so that the size passed to operator delete is right.
+ */
+#define DECLARE_POOLED_ALLOCATION() \
+	static void *operator new(size_t size) \
+	{ \
+		return icinga::ObjectPool::Allocate(size); \
+	} \
+	\
+	static void operator delete(void *ptr, size_t size) noexcept \
+	{ \
+		icinga::ObjectPool::Free(ptr, size); \
+	}
+
+}
+
+#endif /* OBJECTPOOL_H */
@@ -227,53 +227,105 @@ PerfdataValue::PerfdataValue(const String& label, double value, bool counter,
 
 PerfdataValue::Ptr PerfdataValue::Parse(const String& perfdata)
 {
-	size_t eqp = perfdata.FindLastOf('=');
+	Fields fields;
 
-	if (eqp == String::NPos)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data value: " + perfdata));
+	ParseRaw(boost::string_view(perfdata.CStr(), perfdata.GetLength()), fields);
 
-	String label = perfdata.SubStr(0, eqp);
+	return new PerfdataValue(fields.Label, fields.Value, fields.Counter, fields.Unit,
+		fields.Warn, fields.Crit, fields.Min, fields.Max);
+}
+
+/**
+ * Like Parse(), but doesn't create any object. Writers shall prefer this.
+ *
+ * @param perfdata Either an unparsed string or a PerfdataValue
+ */
+void PerfdataValue::ParseFields(const Value& perfdata, Fields& fields)
+{
+	if (perfdata.IsObjectType<PerfdataValue>()) {
+		PerfdataValue::Ptr pdv = perfdata;
+
+		fields.Label = pdv->GetLabel();
+		fields.Value = pdv->GetValue();
+		fields.Counter = pdv->GetCounter();
+		fields.Unit = pdv->GetUnit();
+		fields.Warn = pdv->GetWarn();
+		fields.Crit = pdv->GetCrit();
+		fields.Min = pdv->GetMin();
+		fields.Max = pdv->GetMax();
+	} else if (perfdata.IsString()) {
+		auto& str (perfdata.Get<String>());
+
+		ParseRaw(boost::string_view(str.CStr(), str.GetLength()), fields);
+	} else {
+		String str = perfdata;
+
+		ParseRaw(boost::string_view(str.CStr(), str.GetLength()), fields);
+	}
+}
+
+void PerfdataValue::ParseRaw(boost::string_view perfdata, Fields& fields)
+{
+	size_t eqp = perfdata.rfind('=');
+
+	if (eqp == perfdata.npos)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data value: " + perfdata.to_string()));
+
+	auto label (perfdata.substr(0, eqp));
+
+	if (label.size() > 2 && label.front() == '\'' && label.back() == '\'')
+		label = label.substr(1, label.size() - 2);
 
-	if (label.GetLength() > 2 && label[0] == '\'' && label[label.GetLength() - 1] == '\'')
-		label = label.SubStr(1, label.GetLength() - 2);
+	size_t spq = perfdata.find(' ', eqp);
 
-	size_t spq = perfdata.FindFirstOf(' ', eqp);
+	if (spq == perfdata.npos)
+		spq = perfdata.size();
 
-	if (spq == String::NPos)
-		spq = perfdata.GetLength();
+	auto valueStr (perfdata.substr(eqp + 1, spq - eqp - 1));
 
-	String valueStr = perfdata.SubStr(eqp + 1, spq - eqp - 1);
-	std::vector<String> tokens = valueStr.Split(";");
+	if (valueStr.find(',') != valueStr.npos)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data value: " + perfdata.to_string()));
 
-	if (valueStr.FindFirstOf(',') != String::NPos || tokens.empty()) {
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data value: " + perfdata));
+	// Value[UOM];[warn];[crit];[min];[max], anything after that is ignored.
+	boost::string_view tokens[5];
+	size_t tokenCount = 0;
+
+	for (size_t begin = 0;;) {
+		size_t end = valueStr.find(';', begin);
+
+		if (tokenCount < sizeof(tokens) / sizeof(tokens[0]))
+			tokens[tokenCount++] = valueStr.substr(begin, end == valueStr.npos ? valueStr.npos : end - begin);
+
+		if (end == valueStr.npos)
+			break;
+
+		begin = end + 1;
 	}
 
 	// Find the position where to split value and unit. Possible values of tokens[0] include:
 	// "1000", "1.0", "1.", "-.1", "+1", "1e10", "1GB", "1e10GB", "1e10EB", "1E10EB", "1.5GB", "1.GB", "+1.E-1EW"
 	// Consider everything up to and including the last digit or decimal point as part of the value.
-	size_t pos = tokens[0].FindLastOf("0123456789.");
-	if (pos != String::NPos) {
+	size_t pos = tokens[0].find_last_of("0123456789.");
+	if (pos != tokens[0].npos) {
 		pos++;
 	}
 
-	double value = Convert::ToDouble(tokens[0].SubStr(0, pos));
+	double value = Convert::ToDouble(tokens[0].substr(0, pos));
 
 	bool counter = false;
-	String unit;
-	Value warn, crit, min, max;
+	std::string unit;
 
-	if (pos != String::NPos)
-		unit = tokens[0].SubStr(pos, String::NPos);
+	if (pos != tokens[0].npos)
+		unit = tokens[0].substr(pos).to_string();
 
 	double base;
 
 	{
-		auto uom (l_CsUoMs.find(unit.GetData()));
+		auto uom (l_CsUoMs.find(unit));
 
 		if (uom == l_CsUoMs.end()) {
-			auto ciUnit (unit.ToLower());
-			auto uom (l_CiUoMs.find(ciUnit.GetData()));
+			auto ciUnit (boost::algorithm::to_lower_copy(unit));
+			auto uom (l_CiUoMs.find(ciUnit));
 
 			if (uom == l_CiUoMs.end()) {
 				Log(LogDebug, "PerfdataValue")
@@ -295,26 +347,19 @@ PerfdataValue::Ptr PerfdataValue::Parse(const String& perfdata)
 		counter = true;
 	}
 
-	warn = ParseWarnCritMinMaxToken(tokens, 1, "warning");
-	crit = ParseWarnCritMinMaxToken(tokens, 2, "critical");
-	min = ParseWarnCritMinMaxToken(tokens, 3, "minimum");
-	max = ParseWarnCritMinMaxToken(tokens, 4, "maximum");
-
-	value = value * base;
-
-	if (!warn.IsEmpty())
-		warn = warn * base;
-
-	if (!crit.IsEmpty())
-		crit = crit * base;
-
-	if (!min.IsEmpty())
-		min = min * base;
-
-	if (!max.IsEmpty())
-		max = max * base;
-
-	return new PerfdataValue(label, value, counter, unit, warn, crit, min, max);
+	fields.Label = String(label.begin(), label.end());
+	fields.Value = value * base;
+	fields.Counter = counter;
+	fields.Unit = std::move(unit);
+	fields.Warn = ParseWarnCritMinMaxToken(tokens[1], tokenCount > 1, "warning");
+	fields.Crit = ParseWarnCritMinMaxToken(tokens[2], tokenCount > 2, "critical");
+	fields.Min = ParseWarnCritMinMaxToken(tokens[3], tokenCount > 3, "minimum");
+	fields.Max = ParseWarnCritMinMaxToken(tokens[4], tokenCount > 4, "maximum");
+
+	for (auto threshold : {&fields.Warn, &fields.Crit, &fields.Min, &fields.Max}) {
+		if (!threshold->IsEmpty())
+			*threshold = *threshold * base;
+	}
 }
 
 static const std::unordered_map<std::string, const char*> l_FormatUoMs ({
@@ -382,14 +427,14 @@ String PerfdataValue::Format() const
 	return result.str();
 }
 
-Value PerfdataValue::ParseWarnCritMinMaxToken(const std::vector<String>& tokens, std::vector<String>::size_type index, const String& description)
+Value PerfdataValue::ParseWarnCritMinMaxToken(boost::string_view token, bool present, const char* description)
 {
-	if (tokens.size() > index && tokens[index] != "U" && tokens[index] != "" && tokens[index].FindFirstNotOf("+-0123456789.eE") == String::NPos)
-		return Convert::ToDouble(tokens[index]);
+	if (present && token != "U" && token != "" && token.find_first_not_of("+-0123456789.eE") == token.npos)
+		return Convert::ToDouble(token);
 	else {
-		if (tokens.size() > index && tokens[index] != "")
+		if (present && token != "")
 			Log(LogDebug, "PerfdataValue")
-				<< "Ignoring unsupported perfdata " << description << " range, value: '" << tokens[index] << "'.";
+				<< "Ignoring unsupported perfdata " << description << " range, value: '" << token << "'.";
 		return Empty;
 	}
 }
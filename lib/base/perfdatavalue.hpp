@@ -5,6 +5,7 @@
 
 #include "base/i2-base.hpp"
 #include "base/perfdatavalue-ti.hpp"
+#include <boost/utility/string_view.hpp>
 
 namespace icinga
 {
@@ -19,6 +20,21 @@ class PerfdataValue final : public ObjectImpl<PerfdataValue>
 public:
 	DECLARE_OBJECT(PerfdataValue);
 
+	/**
+	 * The same as a PerfdataValue, but without the overhead of an object.
+	 */
+	struct Fields
+	{
+		String Label;
+		double Value;
+		bool Counter;
+		String Unit;
+		icinga::Value Warn;
+		icinga::Value Crit;
+		icinga::Value Min;
+		icinga::Value Max;
+	};
+
 	PerfdataValue() = default;
 
 	PerfdataValue(const String& label, double value, bool counter = false, const String& unit = "",
@@ -26,11 +42,12 @@ public:
 		const Value& min = Empty, const Value& max = Empty);
 
 	static PerfdataValue::Ptr Parse(const String& perfdata);
+	static void ParseFields(const Value& perfdata, Fields& fields);
 	String Format() const;
 
 private:
-	static Value ParseWarnCritMinMaxToken(const std::vector<String>& tokens,
-		std::vector<String>::size_type index, const String& description);
+	static void ParseRaw(boost::string_view perfdata, Fields& fields);
+	static Value ParseWarnCritMinMaxToken(boost::string_view token, bool present, const char* description);
 };
 
 }
@@ -13,6 +13,10 @@
 #include "base/json.hpp"
 #include <boost/algorithm/string/join.hpp>
 #include <boost/thread/once.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
 #include <thread>
 #include <iostream>
 
@@ -22,6 +26,10 @@
 #	include <signal.h>
 #	include <string.h>
 
+#	ifdef HAVE_EPOLL_CREATE1
+#		include <sys/epoll.h>
+#	endif /* HAVE_EPOLL_CREATE1 */
+
 #	ifndef __APPLE__
 extern char **environ;
 #	else /* __APPLE__ */
@@ -41,10 +49,18 @@ static HANDLE l_Events[IOTHREADS];
 #else /* _WIN32 */
 static int l_EventFDs[IOTHREADS][2];
 static std::map<Process::ConsoleHandle, Process::ProcessHandle> l_FDs[IOTHREADS];
-
-static std::mutex l_ProcessControlMutex;
-static int l_ProcessControlFD = -1;
-static pid_t l_ProcessControlPID;
+#	ifdef HAVE_EPOLL_CREATE1
+static int l_EpollFDs[IOTHREADS];
+#	endif /* HAVE_EPOLL_CREATE1 */
+
+/* Each I/O thread's processes are spawned, killed and reaped by their own spawn helper. */
+static std::mutex l_ProcessControlMutex[IOTHREADS];
+static std::array<int, IOTHREADS> l_ProcessControlFD = []() {
+	std::array<int, IOTHREADS> fds;
+	fds.fill(-1);
+	return fds;
+}();
+static pid_t l_ProcessControlPID[IOTHREADS];
 #endif /* _WIN32 */
 static boost::once_flag l_ProcessOnceFlag = BOOST_ONCE_INIT;
 static boost::once_flag l_SpawnHelperOnceFlag = BOOST_ONCE_INIT;
@@ -55,7 +71,7 @@ Process::Process(Process::Arguments arguments, Dictionary::Ptr extraEnvironment)
 #ifdef _WIN32
 	, m_ReadPending(false), m_ReadFailed(false), m_Overlapped()
 #else /* _WIN32 */
-	, m_SentSigterm(false)
+	, m_SentSigterm(false), m_Stdin(STDIN_FILENO)
 #endif /* _WIN32 */
 	, m_AdjustPriority(false), m_ResultAvailable(false)
 {
@@ -72,44 +88,145 @@ Process::~Process()
 }
 
 #ifndef _WIN32
-static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& request)
+/**
+ * Requests to and responses from the spawn helpers. Both ends are the same binary,
+ * so integers are transferred as they are laid out in memory.
+ */
+class SpawnHelperMessage
+{
+public:
+	SpawnHelperMessage() = default;
+
+	SpawnHelperMessage(std::string buffer) : m_Buffer(std::move(buffer))
+	{
+	}
+
+	template<class T>
+	void Write(T value)
+	{
+		m_Buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+	}
+
+	void WriteString(const String& value)
+	{
+		Write<uint32_t>(value.GetLength());
+		m_Buffer.append(value.CStr(), value.GetLength() + 1u);
+	}
+
+	template<class T>
+	bool Read(T& value)
+	{
+		if (m_Buffer.size() - m_Offset < sizeof(value))
+			return false;
+
+		memcpy(&value, m_Buffer.data() + m_Offset, sizeof(value));
+		m_Offset += sizeof(value);
+		return true;
+	}
+
+	/* Returns a pointer into the message, the string is NUL-terminated in place. */
+	char *ReadString()
+	{
+		uint32_t length;
+
+		if (!Read(length) || m_Buffer.size() - m_Offset < length + 1u)
+			return nullptr;
+
+		char *value = &m_Buffer[m_Offset];
+		m_Offset += length + 1u;
+		return value;
+	}
+
+	const std::string& GetBuffer() const
+	{
+		return m_Buffer;
+	}
+
+private:
+	std::string m_Buffer;
+	size_t m_Offset = 0;
+};
+
+struct SpawnResponse
+{
+	pid_t Rc;
+	int Errno;
+};
+
+struct WaitPIDResponse
+{
+	int Status;
+	pid_t Rc;
+};
+
+/* Only async-signal-safe functions may be used after vfork(). */
+static void ChildError(const char *what)
+{
+	const char *error = strerror(errno);
+
+	(void)!write(STDERR_FILENO, what, strlen(what));
+	(void)!write(STDERR_FILENO, ": ", 2);
+	(void)!write(STDERR_FILENO, error, strlen(error));
+	(void)!write(STDERR_FILENO, "\n", 1);
+}
+
+static SpawnResponse ProcessSpawnImpl(struct msghdr *msgh, SpawnHelperMessage& request, int controlFD)
 {
 	struct cmsghdr *cmsg = CMSG_FIRSTHDR(msgh);
 
 	if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * 3)) {
 		std::cerr << "Invalid 'spawn' request: FDs missing" << std::endl;
-		return Empty;
+		return { -1, EINVAL };
 	}
 
 	auto *fds = (int *)CMSG_DATA(cmsg);
 
-	Array::Ptr arguments = request->Get("arguments");
-	Dictionary::Ptr extraEnvironment = request->Get("extraEnvironment");
-	bool adjustPriority = request->Get("adjustPriority");
+	bool adjustPriority;
+	uint32_t argc, extraEnvc;
 
-	// build argv
-	auto **argv = new char *[arguments->GetLength() + 1];
+	std::vector<char *> argv;
+	std::vector<char *> envp;
 
-	for (unsigned int i = 0; i < arguments->GetLength(); i++) {
-		String arg = arguments->Get(i);
-		argv[i] = strdup(arg.CStr());
+	auto closeFDs ([fds]() {
+		(void)close(fds[0]);
+		(void)close(fds[1]);
+		(void)close(fds[2]);
+	});
+
+	if (!request.Read(adjustPriority) || !request.Read(argc)) {
+		std::cerr << "Invalid 'spawn' request: truncated" << std::endl;
+		closeFDs();
+		return { -1, EINVAL };
 	}
 
-	argv[arguments->GetLength()] = nullptr;
+	// build argv, pointing into the request
+	argv.reserve(argc + 1u);
 
-	// build envp
-	int envc = 0;
+	for (uint32_t i = 0; i < argc; i++) {
+		char *arg = request.ReadString();
+
+		if (!arg) {
+			std::cerr << "Invalid 'spawn' request: truncated" << std::endl;
+			closeFDs();
+			return { -1, EINVAL };
+		}
+
+		argv.emplace_back(arg);
+	}
+
+	argv.emplace_back(nullptr);
 
-	/* count existing environment variables */
-	while (environ[envc])
-		envc++;
+	if (argc == 0 || !request.Read(extraEnvc)) {
+		std::cerr << "Invalid 'spawn' request: no arguments" << std::endl;
+		closeFDs();
+		return { -1, EINVAL };
+	}
 
-	auto **envp = new char *[envc + (extraEnvironment ? extraEnvironment->GetLength() : 0) + 2];
+	// build envp
 	const char* lcnumeric = "LC_NUMERIC=";
 	const char* notifySocket = "NOTIFY_SOCKET=";
-	int j = 0;
 
-	for (int i = 0; i < envc; i++) {
+	for (int i = 0; environ[i]; i++) {
 		if (strncmp(environ[i], lcnumeric, strlen(lcnumeric)) == 0) {
 			continue;
 		}
@@ -118,26 +235,30 @@ static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& reques
 			continue;
 		}
 
-		envp[j] = strdup(environ[i]);
-		++j;
+		envp.emplace_back(environ[i]);
 	}
 
-	if (extraEnvironment) {
-		ObjectLock olock(extraEnvironment);
+	for (uint32_t i = 0; i < extraEnvc; i++) {
+		char *kv = request.ReadString();
 
-		for (const Dictionary::Pair& kv : extraEnvironment) {
-			String skv = kv.first + "=" + Convert::ToString(kv.second);
-			envp[j] = strdup(skv.CStr());
-			j++;
+		if (!kv) {
+			std::cerr << "Invalid 'spawn' request: truncated" << std::endl;
+			closeFDs();
+			return { -1, EINVAL };
 		}
-	}
 
-	envp[j] = strdup("LC_NUMERIC=C");
-	envp[j + 1] = nullptr;
+		envp.emplace_back(kv);
+	}
 
-	extraEnvironment.reset();
+	envp.emplace_back(const_cast<char *>("LC_NUMERIC=C"));
+	envp.emplace_back(nullptr);
 
+	/* The child only execs another program, so it's not worth copying the page tables of this process. */
+#ifdef HAVE_VFORK
+	pid_t pid = vfork();
+#else /* HAVE_VFORK */
 	pid_t pid = fork();
+#endif /* HAVE_VFORK */
 
 	int errorCode = 0;
 
@@ -147,15 +268,15 @@ static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& reques
 	if (pid == 0) {
 		// child process
 
-		(void)close(l_ProcessControlFD);
+		(void)close(controlFD);
 
 		if (setsid() < 0) {
-			perror("setsid() failed");
+			ChildError("setsid() failed");
 			_exit(128);
 		}
 
 		if (dup2(fds[0], STDIN_FILENO) < 0 || dup2(fds[1], STDOUT_FILENO) < 0 || dup2(fds[2], STDERR_FILENO) < 0) {
-			perror("dup2() failed");
+			ChildError("dup2() failed");
 			_exit(128);
 		}
 
@@ -186,80 +307,56 @@ static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& reques
 		sigemptyset(&mask);
 		sigprocmask(SIG_SETMASK, &mask, nullptr);
 
-		if (icinga2_execvpe(argv[0], argv, envp) < 0) {
+		if (icinga2_execvpe(argv[0], argv.data(), envp.data()) < 0) {
 			char errmsg[512];
 			strcpy(errmsg, "execvpe(");
 			strncat(errmsg, argv[0], sizeof(errmsg) - strlen(errmsg) - 1);
 			strncat(errmsg, ") failed", sizeof(errmsg) - strlen(errmsg) - 1);
 			errmsg[sizeof(errmsg) - 1] = '\0';
-			perror(errmsg);
+			ChildError(errmsg);
 		}
 
 		_exit(128);
 	}
 
-	(void)close(fds[0]);
-	(void)close(fds[1]);
-	(void)close(fds[2]);
-
-	// free arguments
-	for (int i = 0; argv[i]; i++)
-		free(argv[i]);
-
-	delete[] argv;
-
-	// free environment
-	for (int i = 0; envp[i]; i++)
-		free(envp[i]);
-
-	delete[] envp;
+	closeFDs();
 
-	Dictionary::Ptr response = new Dictionary({
-		{ "rc", pid },
-		{ "errno", errorCode }
-	});
-
-	return response;
+	return { pid, errorCode };
 }
 
-static Value ProcessKillImpl(struct msghdr *msgh, const Dictionary::Ptr& request)
+static int ProcessKillImpl(SpawnHelperMessage& request)
 {
-	pid_t pid = request->Get("pid");
-	int signum = request->Get("signum");
+	pid_t pid;
+	int signum;
+
+	if (!request.Read(pid) || !request.Read(signum))
+		return EINVAL;
 
 	errno = 0;
 	kill(pid, signum);
-	int error = errno;
-
-	Dictionary::Ptr response = new Dictionary({
-		{ "errno", error }
-	});
-
-	return response;
+	return errno;
 }
 
-static Value ProcessWaitPIDImpl(struct msghdr *msgh, const Dictionary::Ptr& request)
+static WaitPIDResponse ProcessWaitPIDImpl(SpawnHelperMessage& request)
 {
-	pid_t pid = request->Get("pid");
+	pid_t pid;
+
+	if (!request.Read(pid))
+		return { 0, -1 };
 
 	int status;
 	int rc = waitpid(pid, &status, 0);
 
-	Dictionary::Ptr response = new Dictionary({
-		{ "status", status },
-		{ "rc", rc }
-	});
-
-	return response;
+	return { status, rc };
 }
 
-static void ProcessHandler()
+static void ProcessHandler(int controlFD)
 {
 	sigset_t mask;
 	sigfillset(&mask);
 	sigprocmask(SIG_SETMASK, &mask, nullptr);
 
-	Utility::CloseAllFDs({0, 1, 2, l_ProcessControlFD});
+	Utility::CloseAllFDs({0, 1, 2, controlFD});
 
 	for (;;) {
 		size_t length;
@@ -278,7 +375,7 @@ static void ProcessHandler()
 		msg.msg_control = cbuf;
 		msg.msg_controllen = sizeof(cbuf);
 
-		int rc = recvmsg(l_ProcessControlFD, &msg, 0);
+		int rc = recvmsg(controlFD, &msg, 0);
 
 		if (rc <= 0) {
 			if (rc < 0 && (errno == EINTR || errno == EAGAIN))
@@ -287,49 +384,54 @@ static void ProcessHandler()
 			break;
 		}
 
-		auto *mbuf = new char[length];
+		std::string mbuf (length, '\0');
 
 		size_t count = 0;
 		while (count < length) {
-			rc = recv(l_ProcessControlFD, mbuf + count, length - count, 0);
+			rc = recv(controlFD, &mbuf[count], length - count, 0);
 
 			if (rc <= 0) {
 				if (rc < 0 && (errno == EINTR || errno == EAGAIN))
 					continue;
 
-				delete [] mbuf;
-
 				_exit(0);
 			}
 
 			count += rc;
-
-			if (rc == 0)
-				break;
 		}
 
-		String jrequest = String(mbuf, mbuf + count);
-
-		delete [] mbuf;
-
-		Dictionary::Ptr request = JsonDecode(jrequest);
+		SpawnHelperMessage request (std::move(mbuf));
+		char command = 0;
 
-		String command = request->Get("command");
+		(void)request.Read(command);
 
-		Value response;
+		std::string response;
 
-		if (command == "spawn")
-			response = ProcessSpawnImpl(&msg, request);
-		else if (command == "waitpid")
-			response = ProcessWaitPIDImpl(&msg, request);
-		else if (command == "kill")
-			response = ProcessKillImpl(&msg, request);
-		else
-			response = Empty;
-
-		String jresponse = JsonEncode(response);
+		switch (command) {
+			case 's':
+				{
+					auto result (ProcessSpawnImpl(&msg, request, controlFD));
+					response.assign(reinterpret_cast<const char *>(&result), sizeof(result));
+				}
+				break;
+			case 'w':
+				{
+					auto result (ProcessWaitPIDImpl(request));
+					response.assign(reinterpret_cast<const char *>(&result), sizeof(result));
+				}
+				break;
+			case 'k':
+				{
+					auto result (ProcessKillImpl(request));
+					response.assign(reinterpret_cast<const char *>(&result), sizeof(result));
+				}
+				break;
+			default:
+				std::cerr << "Invalid request to the spawn helper: unknown command" << std::endl;
+				_exit(1);
+		}
 
-		if (send(l_ProcessControlFD, jresponse.CStr(), jresponse.GetLength(), 0) < 0) {
+		if (send(controlFD, response.data(), response.size(), 0) < 0) {
 			BOOST_THROW_EXCEPTION(posix_error()
 				<< boost::errinfo_api_function("send")
 				<< boost::errinfo_errno(errno));
@@ -339,13 +441,13 @@ static void ProcessHandler()
 	_exit(0);
 }
 
-static void StartSpawnProcessHelper()
+static void StartSpawnProcessHelper(int helper)
 {
-	if (l_ProcessControlFD != -1) {
-		(void)close(l_ProcessControlFD);
+	if (l_ProcessControlFD[helper] != -1) {
+		(void)close(l_ProcessControlFD[helper]);
 
 		int status;
-		(void)waitpid(l_ProcessControlPID, &status, 0);
+		(void)waitpid(l_ProcessControlPID[helper], &status, 0);
 	}
 
 	int controlFDs[2];
@@ -366,32 +468,40 @@ static void StartSpawnProcessHelper()
 	if (pid == 0) {
 		(void)close(controlFDs[1]);
 
-		l_ProcessControlFD = controlFDs[0];
-
-		ProcessHandler();
+		ProcessHandler(controlFDs[0]);
 
 		_exit(1);
 	}
 
 	(void)close(controlFDs[0]);
 
-	l_ProcessControlFD = controlFDs[1];
-	l_ProcessControlPID = pid;
+	l_ProcessControlFD[helper] = controlFDs[1];
+	l_ProcessControlPID[helper] = pid;
 }
 
-static pid_t ProcessSpawn(const std::vector<String>& arguments, const Dictionary::Ptr& extraEnvironment, bool adjustPriority, int fds[3])
+/**
+ * Sends a request to a spawn helper and receives its fixed-size response
+ *
+ * @param helper Which spawn helper
+ * @param request The request
+ * @param response Receives the response
+ * @param fds Three FDs to pass to the helper or nullptr
+ * @param acquired Receives the time the helper was free for this request or nullptr
+ *
+ * @return Whether a response was received
+ */
+template<class Response>
+static bool CallSpawnHelper(int helper, const SpawnHelperMessage& request, Response& response, const int *fds = nullptr,
+	double *acquired = nullptr)
 {
-	Dictionary::Ptr request = new Dictionary({
-		{ "command", "spawn" },
-		{ "arguments", Array::FromVector(arguments) },
-		{ "extraEnvironment", extraEnvironment },
-		{ "adjustPriority", adjustPriority }
-	});
+	auto& payload (request.GetBuffer());
+	size_t length = payload.size();
 
-	String jrequest = JsonEncode(request);
-	size_t length = jrequest.GetLength();
+	std::unique_lock<std::mutex> lock(l_ProcessControlMutex[helper]);
 
-	std::unique_lock<std::mutex> lock(l_ProcessControlMutex);
+	if (acquired) {
+		*acquired = Utility::GetTime();
+	}
 
 	struct msghdr msg;
 	memset(&msg, 0, sizeof(msg));
@@ -404,109 +514,119 @@ static pid_t ProcessSpawn(const std::vector<String>& arguments, const Dictionary
 	msg.msg_iovlen = 1;
 
 	char cbuf[CMSG_SPACE(sizeof(int) * 3)];
-	msg.msg_control = cbuf;
-	msg.msg_controllen = sizeof(cbuf);
 
-	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-	cmsg->cmsg_level = SOL_SOCKET;
-	cmsg->cmsg_type = SCM_RIGHTS;
-	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * 3);
+	if (fds) {
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
 
-	memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * 3);
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * 3);
 
-	msg.msg_controllen = cmsg->cmsg_len;
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * 3);
+
+		msg.msg_controllen = cmsg->cmsg_len;
+	}
 
 	do {
-		while (sendmsg(l_ProcessControlFD, &msg, 0) < 0) {
-			StartSpawnProcessHelper();
+		while (sendmsg(l_ProcessControlFD[helper], &msg, 0) < 0) {
+			StartSpawnProcessHelper(helper);
 		}
-	} while (send(l_ProcessControlFD, jrequest.CStr(), jrequest.GetLength(), 0) < 0);
-
-	char buf[4096];
+	} while (send(l_ProcessControlFD[helper], payload.data(), payload.size(), 0) < 0);
 
-	ssize_t rc = recv(l_ProcessControlFD, buf, sizeof(buf), 0);
+	size_t count = 0;
 
-	if (rc <= 0)
-		return -1;
+	while (count < sizeof(response)) {
+		ssize_t rc = recv(l_ProcessControlFD[helper], reinterpret_cast<char *>(&response) + count, sizeof(response) - count, 0);
 
-	String jresponse = String(buf, buf + rc);
+		if (rc <= 0) {
+			if (rc < 0 && errno == EINTR)
+				continue;
 
-	Dictionary::Ptr response = JsonDecode(jresponse);
+			return false;
+		}
 
-	if (response->Get("rc") == -1)
-		errno = response->Get("errno");
+		count += rc;
+	}
 
-	return response->Get("rc");
+	return true;
 }
 
-static int ProcessKill(pid_t pid, int signum)
+static pid_t ProcessSpawn(int helper, const std::vector<String>& arguments, const Dictionary::Ptr& extraEnvironment,
+	bool adjustPriority, int fds[3], double& acquired)
 {
-	Dictionary::Ptr request = new Dictionary({
-		{ "command", "kill" },
-		{ "pid", pid },
-		{ "signum", signum }
-	});
+	SpawnHelperMessage request;
 
-	String jrequest = JsonEncode(request);
-	size_t length = jrequest.GetLength();
+	request.Write('s');
+	request.Write(adjustPriority);
+	request.Write<uint32_t>(arguments.size());
 
-	std::unique_lock<std::mutex> lock(l_ProcessControlMutex);
+	for (auto& arg : arguments) {
+		request.WriteString(arg);
+	}
 
-	do {
-		while (send(l_ProcessControlFD, &length, sizeof(length), 0) < 0) {
-			StartSpawnProcessHelper();
-		}
-	} while (send(l_ProcessControlFD, jrequest.CStr(), jrequest.GetLength(), 0) < 0);
+	if (extraEnvironment) {
+		ObjectLock olock(extraEnvironment);
 
-	char buf[4096];
+		request.Write<uint32_t>(extraEnvironment->GetLength());
 
-	ssize_t rc = recv(l_ProcessControlFD, buf, sizeof(buf), 0);
+		for (const Dictionary::Pair& kv : extraEnvironment) {
+			request.WriteString(kv.first + "=" + Convert::ToString(kv.second));
+		}
+	} else {
+		request.Write<uint32_t>(0);
+	}
 
-	if (rc <= 0)
+	SpawnResponse response;
+
+	if (!CallSpawnHelper(helper, request, response, fds, &acquired))
 		return -1;
 
-	String jresponse = String(buf, buf + rc);
+	if (response.Rc == -1)
+		errno = response.Errno;
 
-	Dictionary::Ptr response = JsonDecode(jresponse);
-	return response->Get("errno");
+	return response.Rc;
 }
 
-static int ProcessWaitPID(pid_t pid, int *status)
+static int ProcessKill(int helper, pid_t pid, int signum)
 {
-	Dictionary::Ptr request = new Dictionary({
-		{ "command", "waitpid" },
-		{ "pid", pid }
-	});
+	SpawnHelperMessage request;
 
-	String jrequest = JsonEncode(request);
-	size_t length = jrequest.GetLength();
+	request.Write('k');
+	request.Write(pid);
+	request.Write(signum);
 
-	std::unique_lock<std::mutex> lock(l_ProcessControlMutex);
+	int error;
 
-	do {
-		while (send(l_ProcessControlFD, &length, sizeof(length), 0) < 0) {
-			StartSpawnProcessHelper();
-		}
-	} while (send(l_ProcessControlFD, jrequest.CStr(), jrequest.GetLength(), 0) < 0);
+	if (!CallSpawnHelper(helper, request, error))
+		return -1;
 
-	char buf[4096];
+	return error;
+}
 
-	ssize_t rc = recv(l_ProcessControlFD, buf, sizeof(buf), 0);
+static int ProcessWaitPID(int helper, pid_t pid, int *status)
+{
+	SpawnHelperMessage request;
 
-	if (rc <= 0)
-		return -1;
+	request.Write('w');
+	request.Write(pid);
 
-	String jresponse = String(buf, buf + rc);
+	WaitPIDResponse response;
 
-	Dictionary::Ptr response = JsonDecode(jresponse);
-	*status = response->Get("status");
-	return response->Get("rc");
+	if (!CallSpawnHelper(helper, request, response))
+		return -1;
+
+	*status = response.Status;
+	return response.Rc;
 }
 
 void Process::InitializeSpawnHelper()
 {
-	if (l_ProcessControlFD == -1)
-		StartSpawnProcessHelper();
+	for (int helper = 0; helper < IOTHREADS; helper++) {
+		if (l_ProcessControlFD[helper] == -1)
+			StartSpawnProcessHelper(helper);
+	}
 }
 #endif /* _WIN32 */
 
@@ -539,6 +659,28 @@ static void InitializeProcess()
 		}
 #	endif /* HAVE_PIPE2 */
 	}
+
+#	ifdef HAVE_EPOLL_CREATE1
+	for (int tid = 0; tid < IOTHREADS; tid++) {
+		l_EpollFDs[tid] = epoll_create1(EPOLL_CLOEXEC);
+
+		if (l_EpollFDs[tid] < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("epoll_create1")
+				<< boost::errinfo_errno(errno));
+		}
+
+		epoll_event event {};
+		event.events = EPOLLIN;
+		event.data.fd = l_EventFDs[tid][0];
+
+		if (epoll_ctl(l_EpollFDs[tid], EPOLL_CTL_ADD, l_EventFDs[tid][0], &event) < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("epoll_ctl")
+				<< boost::errinfo_errno(errno));
+		}
+	}
+#	endif /* HAVE_EPOLL_CREATE1 */
 #endif /* _WIN32 */
 }
 
@@ -606,6 +748,118 @@ bool Process::GetAdjustPriority() const
 	return m_AdjustPriority;
 }
 
+#ifndef _WIN32
+/**
+ * Let the process read from fd instead of our stdin
+ *
+ * @param fd Stays open, the caller may close it once Run() returned
+ */
+void Process::SetStdin(int fd)
+{
+	m_Stdin = fd;
+}
+#endif /* _WIN32 */
+
+#if !defined(_WIN32) && defined(HAVE_EPOLL_CREATE1)
+/**
+ * Handles the processes of one I/O thread via epoll
+ *
+ * Unlike with poll(), the pipes stay registered for the whole lifetime of their processes and only the ones
+ * with new output are reported. Timeouts are only checked again at the earliest deadline or once a process
+ * has been added and the control pipe signals that.
+ */
+void Process::IOThreadProc(int tid)
+{
+	std::vector<epoll_event> events (64);
+	double nextDeadline = -1;
+	bool checkTimeouts = true;
+
+	Utility::SetThreadName("ProcessIO");
+
+	/* l_ProcessMutex[tid] must be locked. */
+	auto handle ([tid](std::map<ProcessHandle, Process::Ptr>::iterator it) {
+		if (!it->second->DoEvents()) {
+			/* Closing the FD also removes it from the epoll set. */
+			l_FDs[tid].erase(it->second->m_FD);
+			(void)close(it->second->m_FD);
+			l_Processes[tid].erase(it);
+		}
+	});
+
+	for (;;) {
+		double now = Utility::GetTime();
+
+		if (checkTimeouts || (nextDeadline >= 0 && nextDeadline <= now)) {
+			std::unique_lock<std::mutex> lock(l_ProcessMutex[tid]);
+
+			checkTimeouts = false;
+			nextDeadline = -1;
+
+			for (auto it (l_Processes[tid].begin()); it != l_Processes[tid].end();) {
+				auto current (it++);
+				const Process::Ptr& process = current->second;
+
+				if (process->m_Timeout == 0)
+					continue;
+
+				double deadline = process->m_Result.ExecutionStart + process->GetNextTimeout();
+
+				if (deadline < now) {
+					handle(current);
+
+					/* A terminated but not yet exited process gets a new deadline, so look again. */
+					checkTimeouts = true;
+				} else if (nextDeadline < 0 || deadline < nextDeadline) {
+					nextDeadline = deadline;
+				}
+			}
+		}
+
+		int timeout = -1;
+
+		if (checkTimeouts) {
+			timeout = 0;
+		} else if (nextDeadline >= 0) {
+			timeout = static_cast<int>(std::min(std::max(10.0, (nextDeadline - now) * 1000 + 1), 60000.0));
+		}
+
+		int rc = epoll_wait(l_EpollFDs[tid], events.data(), events.size(), timeout);
+
+		if (rc < 0)
+			continue;
+
+		std::unique_lock<std::mutex> lock(l_ProcessMutex[tid]);
+
+		for (int i = 0; i < rc; i++) {
+			int fd = events[i].data.fd;
+
+			if (fd == l_EventFDs[tid][0]) {
+				char buffer[512];
+				if (read(fd, buffer, sizeof(buffer)) < 0)
+					Log(LogCritical, "base", "Read from event FD failed.");
+
+				checkTimeouts = true;
+				continue;
+			}
+
+			auto it2 = l_FDs[tid].find(fd);
+
+			if (it2 == l_FDs[tid].end())
+				continue; /* This should never happen. */
+
+			auto it = l_Processes[tid].find(it2->second);
+
+			if (it == l_Processes[tid].end())
+				continue; /* This should never happen. */
+
+			handle(it);
+		}
+
+		if (rc == (int)events.size())
+			events.resize(events.size() * 2);
+	}
+}
+#else /* !_WIN32 && HAVE_EPOLL_CREATE1 */
 void Process::IOThreadProc(int tid)
 {
 #ifdef _WIN32
@@ -751,6 +1005,7 @@ void Process::IOThreadProc(int tid)
 		}
 	}
 }
+#endif /* !_WIN32 && HAVE_EPOLL_CREATE1 */
 
 String Process::PrettyPrintArguments(const Process::Arguments& arguments)
 {
@@ -959,6 +1214,7 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 	m_Process = pi.hProcess;
 	m_FD = outReadPipe;
 	m_PID = pi.dwProcessId;
+	m_Result.Spawned = Utility::GetTime();
 
 	Log(LogNotice, "Process")
 		<< "Running command " << PrettyPrintArguments(m_Arguments) << ": PID " << m_PID;
@@ -988,12 +1244,13 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 #endif /* HAVE_PIPE2 */
 
 	int fds[3];
-	fds[0] = STDIN_FILENO;
+	fds[0] = m_Stdin;
 	fds[1] = outfds[1];
 	fds[2] = outfds[1];
 
-	m_Process = ProcessSpawn(m_Arguments, m_ExtraEnvironment, m_AdjustPriority, fds);
+	m_Process = ProcessSpawn(GetTID(), m_Arguments, m_ExtraEnvironment, m_AdjustPriority, fds, m_Result.SpawnHelperAcquired);
 	m_PID = m_Process;
+	m_Result.Spawned = Utility::GetTime();
 
 	if (m_PID == -1) {
 		m_OutputStream << "Fork failed with error code " << errno << " (" << Utility::FormatErrorNumber(errno) << ")";
@@ -1019,6 +1276,16 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 		l_Processes[tid][m_Process] = this;
 #ifndef _WIN32
 		l_FDs[tid][m_FD] = m_Process;
+
+#	ifdef HAVE_EPOLL_CREATE1
+		/* DoEvents() reads until EAGAIN, so edge-triggered notifications are enough. */
+		epoll_event event {};
+		event.events = EPOLLIN | EPOLLET;
+		event.data.fd = m_FD;
+
+		if (epoll_ctl(l_EpollFDs[tid], EPOLL_CTL_ADD, m_FD, &event) < 0)
+			Log(LogCritical, "base", "Adding process FD to epoll set failed.");
+#	endif /* HAVE_EPOLL_CREATE1 */
 #endif /* _WIN32 */
 	}
 
@@ -1058,7 +1325,7 @@ bool Process::DoEvents()
 
 				m_OutputStream << "<Timeout exceeded.>";
 
-				int error = ProcessKill(m_Process, SIGTERM);
+				int error = ProcessKill(GetTID(), m_Process, SIGTERM);
 				if (error) {
 					Log(LogWarning, "Process")
 						<< "Couldn't terminate the process " << m_PID << " (" << PrettyPrintArguments(m_Arguments)
@@ -1082,7 +1349,7 @@ bool Process::DoEvents()
 			m_OutputStream << "<Timeout exceeded.>";
 			TerminateProcess(m_Process, 3);
 #else /* _WIN32 */
-			int error = ProcessKill(-m_Process, SIGKILL);
+			int error = ProcessKill(GetTID(), -m_Process, SIGKILL);
 			if (error) {
 				Log(LogWarning, "Process")
 					<< "Couldn't kill the process group " << m_PID << " (" << PrettyPrintArguments(m_Arguments)
@@ -1105,7 +1372,7 @@ bool Process::DoEvents()
 			return true;
 		}
 #else /* _WIN32 */
-		char buffer[512];
+		char buffer[4096];
 		for (;;) {
 			int rc = read(m_FD, buffer, sizeof(buffer));
 
@@ -1120,6 +1387,8 @@ bool Process::DoEvents()
 			break;
 		}
 #endif /* _WIN32 */
+
+		m_Result.OutputClosed = Utility::GetTime();
 	}
 
 	String output = m_OutputStream.str();
@@ -1136,7 +1405,7 @@ bool Process::DoEvents()
 	int status, exitcode;
 	if (could_not_kill || m_PID == -1) {
 		exitcode = 128;
-	} else if (ProcessWaitPID(m_Process, &status) != m_Process) {
+	} else if (ProcessWaitPID(GetTID(), m_Process, &status) != m_Process) {
 		exitcode = 128;
 
 		Log(LogWarning, "Process")
@@ -27,6 +27,11 @@ struct ProcessResult
 	double ExecutionEnd;
 	long ExitStatus;
 	String Output;
+
+	/* Stages in between ExecutionStart and ExecutionEnd, 0 if not reached or not measured on this platform. */
+	double SpawnHelperAcquired = 0; // Got hold of the spawn helper.
+	double Spawned = 0; // The process has been started.
+	double OutputClosed = 0; // The process closed its stdout/stderr (usually by exiting).
 };
 
 /**
@@ -61,6 +66,10 @@ public:
 	void SetAdjustPriority(bool adjust);
 	bool GetAdjustPriority() const;
 
+#ifndef _WIN32
+	void SetStdin(int fd);
+#endif /* _WIN32 */
+
 	void Run(const std::function<void (const ProcessResult&)>& callback = std::function<void (const ProcessResult&)>());
 
 	const ProcessResult& WaitForResult();
@@ -84,6 +93,7 @@ private:
 	double m_Timeout;
 #ifndef _WIN32
 	bool m_SentSigterm;
+	int m_Stdin;
 #endif /* _WIN32 */
 
 	bool m_AdjustPriority;
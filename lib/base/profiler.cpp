@@ -0,0 +1,192 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/profiler.hpp"
+#include "base/function.hpp"
+#include "base/statsfunction.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <typeindex>
+#include <unordered_map>
+#include <boost/stacktrace.hpp>
+
+using namespace icinga;
+
+REGISTER_STATSFUNCTION(Profiler, &Profiler::StatsFunc);
+
+REGISTER_FUNCTION(Internal, set_profiler_enabled, &Profiler::SetEnabled, "enabled");
+
+std::atomic<bool> Profiler::m_Enabled (false);
+
+namespace {
+
+struct WaitStats
+{
+	uint_fast64_t Count{0};
+	double Wait{0};
+	double MaxWait{0};
+
+	void Add(double wait)
+	{
+		Count++;
+		Wait += wait;
+		MaxWait = std::max(MaxWait, wait);
+	}
+
+	void Add(const WaitStats& other)
+	{
+		Count += other.Count;
+		Wait += other.Wait;
+		MaxWait = std::max(MaxWait, other.MaxWait);
+	}
+
+	Dictionary::Ptr ToDictionary(const char *countName) const
+	{
+		return new Dictionary({
+			{ countName, Count },
+			{ "wait", Wait },
+			{ "max_wait", MaxWait }
+		});
+	}
+};
+
+}
+
+static std::mutex l_ProfilerMutex;
+static double l_ProfilerSince = 0;
+static std::unordered_map<std::type_index, WaitStats> l_LockWaitsByType;
+static std::unordered_map<const void *, WaitStats> l_LockWaitsByCallSite;
+static std::unordered_map<String, WaitStats> l_WorkQueueWaits;
+static std::unordered_map<std::type_index, uint_fast64_t> l_Allocations;
+
+/**
+ * Turns the profiler on (resetting all previous results) or off (keeping them).
+ */
+void Profiler::SetEnabled(bool enabled)
+{
+	std::unique_lock<std::mutex> lock (l_ProfilerMutex);
+
+	if (enabled && !m_Enabled.load()) {
+		l_ProfilerSince = Utility::GetTime();
+		l_LockWaitsByType.clear();
+		l_LockWaitsByCallSite.clear();
+		l_WorkQueueWaits.clear();
+		l_Allocations.clear();
+	}
+
+	m_Enabled.store(enabled);
+}
+
+/**
+ * Records that a thread had to wait for the lock of an object.
+ *
+ * @param callSite Return address of the ObjectLock constructor
+ * @param wait Seconds
+ */
+void Profiler::RecordLockWait(const Object *object, const void *callSite, double wait)
+{
+	std::type_index type (typeid(*object));
+	std::unique_lock<std::mutex> lock (l_ProfilerMutex);
+
+	l_LockWaitsByType[type].Add(wait);
+	l_LockWaitsByCallSite[callSite].Add(wait);
+}
+
+/**
+ * Records how long a task has been waiting in a work queue until it was started.
+ *
+ * @param wait Seconds
+ */
+void Profiler::RecordWorkQueueWait(const String& queue, double wait)
+{
+	std::unique_lock<std::mutex> lock (l_ProfilerMutex);
+
+	l_WorkQueueWaits[queue].Add(wait);
+}
+
+/**
+ * Records a new object (i.e. its first reference).
+ */
+void Profiler::RecordAllocation(const std::type_info& type)
+{
+	std::unique_lock<std::mutex> lock (l_ProfilerMutex);
+
+	l_Allocations[std::type_index(type)]++;
+}
+
+/**
+ * Resolves a return address to the function it belongs to.
+ */
+static String GetCallSiteName(const void *callSite)
+{
+	if (!callSite)
+		return "unknown";
+
+	String name = boost::stacktrace::frame(callSite).name();
+
+	if (name.IsEmpty()) {
+		std::ostringstream msgbuf;
+		msgbuf << callSite;
+		return msgbuf.str();
+	}
+
+	return name;
+}
+
+void Profiler::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+{
+	std::map<String, WaitStats> lockTypes, callSites, workQueues;
+	std::map<String, uint_fast64_t> allocations;
+	std::unordered_map<const void *, WaitStats> rawCallSites;
+	double since;
+
+	{
+		std::unique_lock<std::mutex> lock (l_ProfilerMutex);
+
+		since = l_ProfilerSince;
+
+		for (auto& kv : l_LockWaitsByType)
+			lockTypes[Utility::DemangleSymbolName(kv.first.name())].Add(kv.second);
+
+		for (auto& kv : l_WorkQueueWaits)
+			workQueues[kv.first].Add(kv.second);
+
+		for (auto& kv : l_Allocations)
+			allocations[Utility::DemangleSymbolName(kv.first.name())] += kv.second;
+
+		rawCallSites = l_LockWaitsByCallSite;
+	}
+
+	/* Resolving the symbols is slow, so it's done without holding the lock. Several call sites may be in one function. */
+	for (auto& kv : rawCallSites)
+		callSites[GetCallSiteName(kv.first)].Add(kv.second);
+
+	Dictionary::Ptr locks = new Dictionary();
+	Dictionary::Ptr lockCallSites = new Dictionary();
+	Dictionary::Ptr queues = new Dictionary();
+	Dictionary::Ptr objects = new Dictionary();
+
+	for (auto& kv : lockTypes)
+		locks->Set(kv.first, kv.second.ToDictionary("contended"));
+
+	for (auto& kv : callSites)
+		lockCallSites->Set(kv.first, kv.second.ToDictionary("contended"));
+
+	for (auto& kv : workQueues)
+		queues->Set(kv.first, kv.second.ToDictionary("tasks"));
+
+	for (auto& kv : allocations)
+		objects->Set(kv.first, kv.second);
+
+	status->Set("profiler", new Dictionary({
+		{ "enabled", IsEnabled() },
+		{ "since", since },
+		{ "locks", locks },
+		{ "lock_call_sites", lockCallSites },
+		{ "work_queues", queues },
+		{ "allocations", objects }
+	}));
+}
@@ -0,0 +1,53 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "base/i2-base.hpp"
+#include "base/array.hpp"
+#include "base/dictionary.hpp"
+#include <atomic>
+#include <typeinfo>
+
+#ifdef __GNUC__
+#	define I2_RETURN_ADDRESS() __builtin_return_address(0)
+#else /* __GNUC__ */
+#	define I2_RETURN_ADDRESS() nullptr
+#endif /* __GNUC__ */
+
+namespace icinga
+{
+
+/**
+ * Optional instrumentation of contended object locks, work queue wait times and allocations per type.
+ * It's disabled by default (which costs one relaxed load per lock and enqueued task) and can be turned on
+ * briefly at runtime with Internal.set_profiler_enabled(true), e.g. via the API console.
+ * The results are shown in the "profiler" status (/v1/status/Profiler).
+ *
+ * @ingroup base
+ */
+class Profiler
+{
+public:
+	static inline bool IsEnabled()
+	{
+		return m_Enabled.load(std::memory_order_relaxed);
+	}
+
+	static void SetEnabled(bool enabled);
+
+	static void RecordLockWait(const Object *object, const void *callSite, double wait);
+	static void RecordWorkQueueWait(const String& queue, double wait);
+	static void RecordAllocation(const std::type_info& type);
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+private:
+	Profiler();
+
+	static std::atomic<bool> m_Enabled;
+};
+
+}
+
+#endif /* PROFILER_H */
@@ -0,0 +1,29 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/regexcache.hpp"
+
+using namespace icinga;
+
+LruCache<RegexCache::Key, RegexCache::Ptr, RegexCache::KeyHash> RegexCache::m_Cache (RegexCache::Capacity);
+
+/**
+ * Returns the compiled expression, compiling it if necessary.
+ *
+ * Invalid patterns aren't cached, i.e. boost::regex_error is thrown on every call.
+ */
+RegexCache::Ptr RegexCache::Get(const String& pattern, boost::regex::flag_type flags)
+{
+	return m_Cache.Get(Key{pattern, flags}, [&pattern, flags]() {
+		return std::make_shared<const boost::regex>(pattern.GetData(), flags);
+	});
+}
+
+size_t RegexCache::GetSize()
+{
+	return m_Cache.GetSize();
+}
+
+void RegexCache::Clear()
+{
+	m_Cache.Clear();
+}
@@ -0,0 +1,61 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef REGEXCACHE_H
+#define REGEXCACHE_H
+
+#include "base/i2-base.hpp"
+#include "base/lrucache.hpp"
+#include "base/string.hpp"
+#include <boost/regex.hpp>
+#include <cstddef>
+#include <memory>
+
+namespace icinga
+{
+
+/**
+ * Compiled regular expressions by pattern and flags.
+ *
+ * Apply rules and filters usually evaluate the same few patterns for every object, so compiling them
+ * once is what matters. The least recently used expressions are dropped beyond the capacity.
+ *
+ * @ingroup base
+ */
+class RegexCache final
+{
+public:
+	typedef std::shared_ptr<const boost::regex> Ptr;
+
+	static constexpr size_t Capacity = 1024;
+
+	static Ptr Get(const String& pattern, boost::regex::flag_type flags = boost::regex::perl);
+
+	static size_t GetSize();
+	static void Clear();
+
+private:
+	struct Key
+	{
+		String Pattern;
+		boost::regex::flag_type Flags;
+
+		bool operator==(const Key& other) const
+		{
+			return Flags == other.Flags && Pattern == other.Pattern;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const
+		{
+			return std::hash<String>()(key.Pattern) ^ static_cast<size_t>(key.Flags);
+		}
+	};
+
+	static LruCache<Key, Ptr, KeyHash> m_Cache;
+};
+
+}
+
+#endif /* REGEXCACHE_H */
@@ -89,3 +89,79 @@ double RingBuffer::CalculateRate(RingBuffer::SizeType tv, RingBuffer::SizeType s
 	int sum = UpdateAndGetValuesUnlocked(tv, span);
 	return sum / static_cast<double>(std::min(span, m_InsertedValues));
 }
+
+/* Spreads the threads evenly across the shards of all ShardedRingBuffers. */
+static std::atomic<size_t> l_NextShard (0);
+static thread_local const size_t l_ShardIndex = l_NextShard.fetch_add(1);
+
+ShardedRingBuffer::ShardedRingBuffer(ShardedRingBuffer::SizeType slots)
+	: m_Slots(slots)
+{ }
+
+ShardedRingBuffer::~ShardedRingBuffer()
+{
+	for (auto& shard : m_Shards) {
+		delete shard.Buffer.load();
+	}
+}
+
+ShardedRingBuffer::SizeType ShardedRingBuffer::GetLength() const
+{
+	return m_Slots;
+}
+
+void ShardedRingBuffer::InsertValue(ShardedRingBuffer::SizeType tv, int num)
+{
+	auto& shard (m_Shards[l_ShardIndex % (sizeof(m_Shards) / sizeof(m_Shards[0]))]);
+	auto buffer (shard.Buffer.load(std::memory_order_acquire));
+
+	if (!buffer) {
+		RingBuffer *expected = nullptr;
+		buffer = new RingBuffer(m_Slots);
+
+		if (!shard.Buffer.compare_exchange_strong(expected, buffer, std::memory_order_acq_rel)) {
+			delete buffer;
+			buffer = expected;
+		}
+	}
+
+	buffer->InsertValue(tv, num);
+}
+
+int ShardedRingBuffer::UpdateAndGetValues(ShardedRingBuffer::SizeType tv, ShardedRingBuffer::SizeType span)
+{
+	int sum = 0;
+
+	for (auto& shard : m_Shards) {
+		auto buffer (shard.Buffer.load(std::memory_order_acquire));
+
+		if (buffer)
+			sum += buffer->UpdateAndGetValues(tv, span);
+	}
+
+	return sum;
+}
+
+double ShardedRingBuffer::CalculateRate(ShardedRingBuffer::SizeType tv, ShardedRingBuffer::SizeType span)
+{
+	int sum = 0;
+
+	/* The shard used first has seen as many time values as a single RingBuffer would have. */
+	SizeType insertedValues = 0;
+
+	for (auto& shard : m_Shards) {
+		auto buffer (shard.Buffer.load(std::memory_order_acquire));
+
+		if (buffer) {
+			std::unique_lock<std::mutex> lock(buffer->m_Mutex);
+
+			sum += buffer->UpdateAndGetValuesUnlocked(tv, span);
+			insertedValues = std::max(insertedValues, buffer->m_InsertedValues);
+		}
+	}
+
+	if (!insertedValues)
+		return 0;
+
+	return sum / static_cast<double>(std::min(span, insertedValues));
+}
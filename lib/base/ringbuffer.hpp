@@ -5,6 +5,7 @@
 
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
+#include <atomic>
 #include <vector>
 #include <mutex>
 
@@ -38,6 +39,43 @@ private:
 
 	void InsertValueUnlocked(SizeType tv, int num);
 	int UpdateAndGetValuesUnlocked(SizeType tv, SizeType span);
+
+	friend class ShardedRingBuffer;
+};
+
+/**
+ * Like RingBuffer, but for values inserted by many threads at once, e.g. once per message or task.
+ *
+ * Every thread inserts into one of a few RingBuffers, so that they rarely wait for each other's lock.
+ * Reading sums up all of them. The RingBuffers are only allocated once a thread inserts into them.
+ *
+ * @ingroup base
+ */
+class ShardedRingBuffer final
+{
+public:
+	typedef RingBuffer::SizeType SizeType;
+
+	ShardedRingBuffer(SizeType slots);
+	~ShardedRingBuffer();
+
+	ShardedRingBuffer(const ShardedRingBuffer&) = delete;
+	ShardedRingBuffer& operator=(const ShardedRingBuffer&) = delete;
+
+	SizeType GetLength() const;
+	void InsertValue(SizeType tv, int num);
+	int UpdateAndGetValues(SizeType tv, SizeType span);
+	double CalculateRate(SizeType tv, SizeType span);
+
+private:
+	/* On its own cache line, so that the threads don't contend for that either. */
+	struct alignas(64) Shard
+	{
+		std::atomic<RingBuffer*> Buffer {nullptr};
+	};
+
+	SizeType m_Slots;
+	Shard m_Shards[8];
 };
 
 }
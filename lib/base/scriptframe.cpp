@@ -11,6 +11,10 @@ using namespace icinga;
 
 boost::thread_specific_ptr<std::stack<ScriptFrame *> > ScriptFrame::m_ScriptFrames;
 
+/* Cleared locals of this thread's destroyed frames, see AllocateLocals(). */
+static thread_local std::vector<Dictionary::Ptr> l_LocalsPool;
+static const size_t l_MaxPooledLocals = 32;
+
 static Namespace::Ptr l_SystemNS, l_StatsNS;
 
 /* Ensure that this gets called with highest priority
@@ -45,13 +49,13 @@ INITIALIZE_ONCE_WITH_PRIORITY([]() {
 }, InitializePriority::FreezeNamespaces);
 
 ScriptFrame::ScriptFrame(bool allocLocals)
-	: Locals(allocLocals ? new Dictionary() : nullptr), Self(ScriptGlobal::GetGlobals()), Sandboxed(false), Depth(0)
+	: Locals(allocLocals ? AllocateLocals() : nullptr), Self(ScriptGlobal::GetGlobals()), Sandboxed(false), SafeCallsOnly(false), Depth(0), Deadline(0)
 {
 	InitializeFrame();
 }
 
 ScriptFrame::ScriptFrame(bool allocLocals, Value self)
-	: Locals(allocLocals ? new Dictionary() : nullptr), Self(std::move(self)), Sandboxed(false), Depth(0)
+	: Locals(allocLocals ? AllocateLocals() : nullptr), Self(std::move(self)), Sandboxed(false), SafeCallsOnly(false), Depth(0), Deadline(0)
 {
 	InitializeFrame();
 }
@@ -64,6 +68,8 @@ void ScriptFrame::InitializeFrame()
 		ScriptFrame *frame = frames->top();
 
 		Sandboxed = frame->Sandboxed;
+		SafeCallsOnly = frame->SafeCallsOnly;
+		Deadline = frame->Deadline;
 	}
 
 	PushFrame(this);
@@ -77,6 +83,38 @@ ScriptFrame::~ScriptFrame()
 #ifndef I2_DEBUG
 	(void)frame;
 #endif /* I2_DEBUG */
+
+	ReleaseLocals(Locals);
+}
+
+/**
+ * Returns an empty dictionary for the locals of a frame. Unlike a new one, a dictionary reused from
+ * a previous frame of this thread already has room for the variables (e.g. "host" and the ones of
+ * an apply rule's scope), so that setting them doesn't allocate again.
+ */
+Dictionary::Ptr ScriptFrame::AllocateLocals()
+{
+	if (l_LocalsPool.empty())
+		return new Dictionary();
+
+	Dictionary::Ptr locals (std::move(l_LocalsPool.back()));
+	l_LocalsPool.pop_back();
+
+	return locals;
+}
+
+/**
+ * Puts the locals of a destroyed frame into the pool unless they are still referenced elsewhere,
+ * e.g. by a variable assigned "locals".
+ */
+void ScriptFrame::ReleaseLocals(Dictionary::Ptr& locals)
+{
+	if (!locals || locals->IsShared() || locals->IsFrozen() || l_LocalsPool.size() >= l_MaxPooledLocals
+		|| locals->GetLength() > Dictionary::FlatThreshold)
+		return;
+
+	locals->Clear();
+	l_LocalsPool.emplace_back(std::move(locals));
 }
 
 void ScriptFrame::IncreaseStackDepth()
@@ -84,6 +122,9 @@ void ScriptFrame::IncreaseStackDepth()
 	if (Depth + 1 > 300)
 		BOOST_THROW_EXCEPTION(ScriptError("Stack overflow while evaluating expression: Recursion level too deep."));
 
+	if (Deadline > 0 && Utility::GetTime() > Deadline)
+		BOOST_THROW_EXCEPTION(ScriptError("Timeout while evaluating expression: Execution took too long."));
+
 	Depth++;
 }
 
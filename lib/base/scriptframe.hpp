@@ -17,7 +17,9 @@ struct ScriptFrame
 	Dictionary::Ptr Locals;
 	Value Self;
 	bool Sandboxed;
+	bool SafeCallsOnly; /* Like Sandboxed, but only for function calls, inherited by nested frames */
 	int Depth;
+	double Deadline; /* 0 = none, inherited by nested frames */
 
 	ScriptFrame(bool allocLocals);
 	ScriptFrame(bool allocLocals, Value self);
@@ -28,6 +30,8 @@ struct ScriptFrame
 
 	static ScriptFrame *GetCurrentFrame();
 
+	static Dictionary::Ptr AllocateLocals();
+
 private:
 	static boost::thread_specific_ptr<std::stack<ScriptFrame *> > m_ScriptFrames;
 
@@ -35,6 +39,8 @@ private:
 	static ScriptFrame *PopFrame();
 
 	void InitializeFrame();
+
+	static void ReleaseLocals(Dictionary::Ptr& locals);
 };
 
 }
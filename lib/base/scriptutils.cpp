@@ -14,6 +14,7 @@
 #include "base/dependencygraph.hpp"
 #include "base/initialize.hpp"
 #include "base/namespace.hpp"
+#include "base/regexcache.hpp"
 #include "config/configitem.hpp"
 #include <boost/regex.hpp>
 #include <algorithm>
@@ -111,7 +112,8 @@ bool ScriptUtils::Regex(const std::vector<Value>& args)
 	else
 		mode = MatchAll;
 
-	boost::regex expr(pattern.GetData());
+	RegexCache::Ptr compiled = RegexCache::Get(pattern);
+	const boost::regex& expr = *compiled;
 
 	Array::Ptr texts;
 
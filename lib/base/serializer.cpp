@@ -15,8 +15,14 @@ using namespace icinga;
 
 struct SerializeStackEntry
 {
-	String Name;
+	const String *Name; /* nullptr for array elements */
+	ArrayData::size_type Index;
 	Value Val;
+
+	String GetName() const
+	{
+		return Name ? *Name : Convert::ToString(Index);
+	}
 };
 
 CircularReferenceError::CircularReferenceError(String message, std::vector<String> path)
@@ -37,26 +43,40 @@ struct SerializeStack
 {
 	std::deque<SerializeStackEntry> Entries;
 
+	/**
+	 * Pushes an entry. The name isn't copied, it must stay valid until the entry is popped.
+	 */
 	inline void Push(const String& name, const Value& val)
+	{
+		Push({ &name, 0, val });
+	}
+
+	inline void Push(ArrayData::size_type index, const Value& val)
+	{
+		Push({ nullptr, index, val });
+	}
+
+	inline void Push(SerializeStackEntry&& next)
 	{
 		Object::Ptr obj;
 
-		if (val.IsObject())
-			obj = val;
+		if (next.Val.IsObject())
+			obj = next.Val;
 
 		if (obj) {
 			for (const auto& entry : Entries) {
 				if (entry.Val == obj) {
 					std::vector<String> path;
 					for (const auto& entry : Entries)
-						path.push_back(entry.Name);
-					path.push_back(name);
+						path.push_back(entry.GetName());
+					path.push_back(next.GetName());
 					BOOST_THROW_EXCEPTION(CircularReferenceError("Cannot serialize object which recursively refers to itself. Attribute path which leads to the cycle: " + boost::algorithm::join(path, " -> "), path));
 				}
 			}
 		}
 
-		Entries.push_back({ name, obj });
+		next.Val = obj;
+		Entries.push_back(std::move(next));
 	}
 
 	inline void Pop()
@@ -71,16 +91,17 @@ static Array::Ptr SerializeArray(const Array::Ptr& input, int attributeTypes, Se
 {
 	ArrayData result;
 
+	/* Don't hold the lock while serializing the elements, and don't lock at all if it's frozen. */
+	Array::Ptr snapshot = input->Snapshot();
+
 	if (!dryRun) {
-		result.reserve(input->GetLength());
+		result.reserve(snapshot->GetLength());
 	}
 
-	ObjectLock olock(input);
+	ArrayData::size_type index = 0;
 
-	int index = 0;
-
-	for (const Value& value : input) {
-		stack.Push(Convert::ToString(index), value);
+	for (const Value& value : snapshot) {
+		stack.Push(index, value);
 
 		auto serialized (SerializeInternal(value, attributeTypes, stack, dryRun));
 
@@ -99,13 +120,14 @@ static Dictionary::Ptr SerializeDictionary(const Dictionary::Ptr& input, int att
 {
 	DictionaryData result;
 
+	/* Don't hold the lock while serializing the elements, and don't lock at all if it's frozen. */
+	Dictionary::Ptr snapshot = input->Snapshot();
+
 	if (!dryRun) {
-		result.reserve(input->GetLength());
+		result.reserve(snapshot->GetLength());
 	}
 
-	ObjectLock olock(input);
-
-	for (const Dictionary::Pair& kv : input) {
+	for (const Dictionary::Pair& kv : snapshot) {
 		stack.Push(kv.first, kv.second);
 
 		auto serialized (SerializeInternal(kv.second, attributeTypes, stack, dryRun));
@@ -170,13 +192,16 @@ static Object::Ptr SerializeObject(const Object::Ptr& input, int attributeTypes,
 		if (strcmp(field.Name, "type") == 0)
 			continue;
 
+		/* Interned, so it outlives the stack entry. */
+		const String& name (type->GetFieldName(i));
+
 		Value value = input->GetField(i);
-		stack.Push(field.Name, value);
+		stack.Push(name, value);
 
 		auto serialized (SerializeInternal(value, attributeTypes, stack, dryRun));
 
 		if (!dryRun) {
-			fields.emplace_back(field.Name, std::move(serialized));
+			fields.emplace_back(name, std::move(serialized));
 		}
 
 		stack.Pop();
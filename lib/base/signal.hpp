@@ -0,0 +1,178 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef SIGNAL_H
+#define SIGNAL_H
+
+#include "base/signalprofiler.hpp"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A slot connected to a Signal. Like boost::signals2::connection it can be
+ * copied around and disconnected later.
+ *
+ * @ingroup base
+ */
+class SignalConnection
+{
+public:
+	SignalConnection() = default;
+
+	explicit SignalConnection(std::shared_ptr<std::atomic<bool>> connected)
+		: m_Connected(std::move(connected))
+	{ }
+
+	void disconnect() const
+	{
+		if (m_Connected)
+			m_Connected->store(false, std::memory_order_release);
+	}
+
+	bool connected() const
+	{
+		return m_Connected && m_Connected->load(std::memory_order_acquire);
+	}
+
+private:
+	std::shared_ptr<std::atomic<bool>> m_Connected;
+};
+
+template<typename Signature>
+class Signal;
+
+/**
+ * An observer list for the signals which are emitted for every check result or attribute change.
+ *
+ * The slots are kept in an immutable list which is replaced by connect() (copy-on-write). Emitting
+ * the signal only loads the current list, i.e. it neither takes the mutex of the signal nor allocates
+ * like boost::signals2::signal does. The member functions are named like the subset of
+ * boost::signals2::signal's interface used in this code base, so that both are interchangeable.
+ *
+ * Disconnected slots are skipped right away and removed from the list by the next connect().
+ *
+ * The handlers of a signal constructed with a name are timed by SignalProfiler if enabled. Their time is
+ * attributed to the owner passed to connect(), e.g. the name of the feature.
+ *
+ * @ingroup base
+ */
+template<typename... Args>
+class Signal<void (Args...)>
+{
+public:
+	typedef std::function<void (Args...)> SlotType;
+
+	Signal()
+		: m_Slots(std::make_shared<const SlotList>())
+	{ }
+
+	explicit Signal(const char *name)
+		: m_Name(name), m_Slots(std::make_shared<const SlotList>())
+	{ }
+
+	Signal(const Signal&) = delete;
+	Signal& operator=(const Signal&) = delete;
+
+	template<typename F>
+	SignalConnection connect(F&& slot)
+	{
+		return connect("other", std::forward<F>(slot));
+	}
+
+	template<typename F>
+	SignalConnection connect(const std::string& owner, F&& slot)
+	{
+		auto connected (std::make_shared<std::atomic<bool>>(true));
+		std::shared_ptr<SignalSlotStats> stats;
+
+		if (m_Name)
+			stats = SignalProfiler::GetSlotStats(m_Name, owner);
+
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		auto current (std::atomic_load(&m_Slots));
+		auto slots (std::make_shared<SlotList>());
+
+		slots->reserve(current->size() + 1u);
+
+		for (auto& existing : *current) {
+			if (existing.Connected->load(std::memory_order_relaxed))
+				slots->emplace_back(existing);
+		}
+
+		slots->emplace_back(Slot{SlotType(std::forward<F>(slot)), connected, std::move(stats)});
+
+		std::atomic_store(&m_Slots, std::shared_ptr<const SlotList>(std::move(slots)));
+
+		return SignalConnection(std::move(connected));
+	}
+
+	void disconnect_all_slots()
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		for (auto& slot : *std::atomic_load(&m_Slots))
+			slot.Connected->store(false, std::memory_order_release);
+
+		std::atomic_store(&m_Slots, std::make_shared<const SlotList>());
+	}
+
+	bool empty() const
+	{
+		return num_slots() == 0;
+	}
+
+	size_t num_slots() const
+	{
+		size_t count = 0;
+
+		for (auto& slot : *std::atomic_load(&m_Slots))
+			count += slot.Connected->load(std::memory_order_relaxed);
+
+		return count;
+	}
+
+	void operator()(Args... args) const
+	{
+		/* Keeps the list alive even if a slot connects another one. */
+		auto slots (std::atomic_load(&m_Slots));
+
+		for (auto& slot : *slots) {
+			if (!slot.Connected->load(std::memory_order_acquire))
+				continue;
+
+			if (slot.Stats && SignalProfiler::IsEnabled()) {
+				auto begin (SignalProfiler::Begin());
+				slot.Function(args...);
+				SignalProfiler::End(*slot.Stats, begin);
+			} else {
+				slot.Function(args...);
+			}
+		}
+	}
+
+private:
+	struct Slot
+	{
+		SlotType Function;
+		std::shared_ptr<std::atomic<bool>> Connected;
+		std::shared_ptr<SignalSlotStats> Stats;
+	};
+
+	typedef std::vector<Slot> SlotList;
+
+	const char *m_Name{nullptr};
+	std::shared_ptr<const SlotList> m_Slots;
+	std::mutex m_Mutex;
+};
+
+}
+
+#endif /* SIGNAL_H */
@@ -0,0 +1,137 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/signalprofiler.hpp"
+#include "base/dictionary.hpp"
+#include "base/ringbuffer.hpp"
+#include "base/utility.hpp"
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <utility>
+
+using namespace icinga;
+
+namespace icinga
+{
+
+/**
+ * The statistics of all handlers one feature connected to one signal.
+ */
+struct SignalSlotStats
+{
+	std::atomic<uint_fast64_t> Calls{0};
+	std::atomic<uint_fast64_t> WallNs{0};
+	std::atomic<uint_fast64_t> CpuNs{0};
+	ShardedRingBuffer RecentCalls{60};
+};
+
+}
+
+std::atomic<bool> SignalProfiler::m_Enabled{false};
+
+static std::mutex l_SlotStatsMutex;
+static std::map<std::pair<std::string, std::string>, std::shared_ptr<SignalSlotStats>> l_SlotStats;
+
+void SignalProfiler::SetEnabled(bool enabled)
+{
+	m_Enabled.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * Returns the statistics for the handlers of a signal connected by owner. All handlers of the same owner share
+ * them, e.g. those of multiple objects of the same type.
+ */
+std::shared_ptr<SignalSlotStats> SignalProfiler::GetSlotStats(const char *signal, const std::string& owner)
+{
+	std::unique_lock<std::mutex> lock (l_SlotStatsMutex);
+
+	auto& stats (l_SlotStats[std::make_pair(std::string(signal), owner)]);
+
+	if (!stats)
+		stats = std::make_shared<SignalSlotStats>();
+
+	return stats;
+}
+
+static uint_fast64_t GetThreadCpuNs()
+{
+#ifdef _WIN32
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+
+	if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+		return 0;
+
+	auto ticks = [](const FILETIME& ft) {
+		return (uint_fast64_t)ft.dwHighDateTime << 32u | ft.dwLowDateTime;
+	};
+
+	/* 100ns ticks */
+	return (ticks(kernelTime) + ticks(userTime)) * 100u;
+#else /* _WIN32 */
+	timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+		return 0;
+
+	return (uint_fast64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif /* _WIN32 */
+}
+
+static uint_fast64_t GetWallNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SignalProfiler::Sample SignalProfiler::Begin()
+{
+	return Sample{GetWallNs(), GetThreadCpuNs()};
+}
+
+void SignalProfiler::End(SignalSlotStats& stats, const Sample& begin)
+{
+	uint_fast64_t cpu = GetThreadCpuNs();
+	uint_fast64_t wall = GetWallNs();
+
+	stats.Calls.fetch_add(1, std::memory_order_relaxed);
+	stats.WallNs.fetch_add(wall - begin.WallNs, std::memory_order_relaxed);
+	stats.CpuNs.fetch_add(cpu > begin.CpuNs ? cpu - begin.CpuNs : 0, std::memory_order_relaxed);
+	stats.RecentCalls.InsertValue(Utility::GetTime(), 1);
+}
+
+/**
+ * Returns the statistics of all profiled signals, by signal and owner.
+ * wall_time and cpu_time are the total seconds, calls_per_second is the rate of the last minute.
+ */
+Dictionary::Ptr SignalProfiler::GetStats()
+{
+	Dictionary::Ptr result = new Dictionary();
+	double now = Utility::GetTime();
+
+	std::unique_lock<std::mutex> lock (l_SlotStatsMutex);
+
+	for (auto& kv : l_SlotStats) {
+		auto& stats (*kv.second);
+		Dictionary::Ptr signal = result->Get(kv.first.first);
+
+		if (!signal) {
+			signal = new Dictionary();
+			result->Set(kv.first.first, signal);
+		}
+
+		auto calls (stats.Calls.load(std::memory_order_relaxed));
+		double wall = stats.WallNs.load(std::memory_order_relaxed) / 1e9;
+		double cpu = stats.CpuNs.load(std::memory_order_relaxed) / 1e9;
+
+		signal->Set(kv.first.second, new Dictionary({
+			{ "calls", calls },
+			{ "calls_per_second", stats.RecentCalls.CalculateRate(now, 60) },
+			{ "wall_time", wall },
+			{ "cpu_time", cpu },
+			{ "avg_wall_time", calls ? wall / calls : 0 },
+			{ "avg_cpu_time", calls ? cpu / calls : 0 }
+		}));
+	}
+
+	return result;
+}
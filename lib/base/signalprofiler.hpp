@@ -0,0 +1,60 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef SIGNALPROFILER_H
+#define SIGNALPROFILER_H
+
+#include "base/i2-base.hpp"
+#include "base/object.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace icinga
+{
+
+class Dictionary;
+
+struct SignalSlotStats;
+
+/**
+ * Measures how long the handlers of named Signals take, per signal and the feature which connected them.
+ *
+ * Only used for signals which have been given a name, and only while enabled (see the ProfileSignalHandlers
+ * constant), otherwise emitting a signal doesn't even read the clocks.
+ *
+ * @ingroup base
+ */
+class SignalProfiler
+{
+public:
+	/**
+	 * The clocks when a handler was called.
+	 */
+	struct Sample
+	{
+		uint_fast64_t WallNs;
+		uint_fast64_t CpuNs;
+	};
+
+	static bool IsEnabled()
+	{
+		return m_Enabled.load(std::memory_order_relaxed);
+	}
+
+	static void SetEnabled(bool enabled);
+
+	static std::shared_ptr<SignalSlotStats> GetSlotStats(const char *signal, const std::string& owner);
+
+	static Sample Begin();
+	static void End(SignalSlotStats& stats, const Sample& begin);
+
+	static intrusive_ptr<Dictionary> GetStats();
+
+private:
+	static std::atomic<bool> m_Enabled;
+};
+
+}
+
+#endif /* SIGNALPROFILER_H */
@@ -0,0 +1,115 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/startupprofile.hpp"
+#include "base/atomic-file.hpp"
+#include "base/json.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+using namespace icinga;
+
+static std::mutex l_StartupProfileMutex;
+static ArrayData l_StartupPhases;
+static double l_StartupStarted = Utility::GetTime();
+static double l_StartupFinished = 0;
+
+/**
+ * Adds a phase to the report unless the startup already finished.
+ *
+ * @param name The phase name, e.g. "config.commit"
+ * @param start When the phase started
+ * @param end When the phase ended
+ * @param details Additional figures of the phase, e.g. the number of objects
+ */
+void StartupProfile::AddPhase(const String& name, double start, double end, const Dictionary::Ptr& details)
+{
+	Dictionary::Ptr phase = new Dictionary({
+		{ "name", name },
+		{ "start", start },
+		{ "duration", end - start }
+	});
+
+	if (details)
+		details->CopyTo(phase);
+
+	std::unique_lock<std::mutex> lock (l_StartupProfileMutex);
+
+	if (l_StartupFinished == 0)
+		l_StartupPhases.emplace_back(std::move(phase));
+}
+
+/**
+ * Starts a new report, e.g. in a freshly forked worker process.
+ */
+void StartupProfile::Start()
+{
+	std::unique_lock<std::mutex> lock (l_StartupProfileMutex);
+
+	l_StartupPhases.clear();
+	l_StartupStarted = Utility::GetTime();
+	l_StartupFinished = 0;
+}
+
+void StartupProfile::Finish()
+{
+	std::unique_lock<std::mutex> lock (l_StartupProfileMutex);
+
+	if (l_StartupFinished == 0)
+		l_StartupFinished = Utility::GetTime();
+}
+
+bool StartupProfile::IsFinished()
+{
+	std::unique_lock<std::mutex> lock (l_StartupProfileMutex);
+
+	return l_StartupFinished != 0;
+}
+
+/**
+ * Returns the startup report. While the startup is still in progress,
+ * "finished" and "duration" are null.
+ *
+ * @returns A dictionary with the start time, the total duration and the phases ordered by their start
+ */
+Dictionary::Ptr StartupProfile::GetReport()
+{
+	double start, finished;
+	ArrayData phases;
+
+	{
+		std::unique_lock<std::mutex> lock (l_StartupProfileMutex);
+		start = l_StartupStarted;
+		finished = l_StartupFinished;
+		phases = l_StartupPhases;
+	}
+
+	/* Phases are added when they end, so enclosing phases come after the ones they contain. */
+	std::stable_sort(phases.begin(), phases.end(), [](const Value& a, const Value& b) {
+		return static_cast<Dictionary::Ptr>(a)->Get("start") < static_cast<Dictionary::Ptr>(b)->Get("start");
+	});
+
+	return new Dictionary({
+		{ "start", start },
+		{ "finished", finished != 0 ? Value(finished) : Empty },
+		{ "duration", finished != 0 ? Value(finished - start) : Empty },
+		{ "phases", new Array(std::move(phases)) }
+	});
+}
+
+void StartupProfile::WriteReport(const String& path)
+{
+	AtomicFile fp (path, 0644);
+	fp << JsonEncode(GetReport(), true);
+	fp.Commit();
+}
+
+StartupPhase::StartupPhase(String name)
+	: m_Name(std::move(name)), m_Start(Utility::GetTime())
+{ }
+
+StartupPhase::~StartupPhase()
+{
+	StartupProfile::AddPhase(m_Name, m_Start, Utility::GetTime());
+}
@@ -0,0 +1,56 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef STARTUPPROFILE_H
+#define STARTUPPROFILE_H
+
+#include "base/i2-base.hpp"
+#include "base/array.hpp"
+#include "base/dictionary.hpp"
+
+namespace icinga
+{
+
+/**
+ * Records how long the phases of the startup took, e.g. compiling the config
+ * or activating the objects of a type. Phases are only recorded until
+ * Finish() is called, so runtime reloads don't grow the report.
+ *
+ * @ingroup base
+ */
+class StartupProfile
+{
+public:
+	static void AddPhase(const String& name, double start, double end, const Dictionary::Ptr& details = nullptr);
+	static void Start();
+	static void Finish();
+	static bool IsFinished();
+
+	static Dictionary::Ptr GetReport();
+	static void WriteReport(const String& path);
+
+private:
+	StartupProfile();
+};
+
+/**
+ * Records the lifetime of the scope as a startup phase.
+ *
+ * @ingroup base
+ */
+class StartupPhase
+{
+public:
+	StartupPhase(String name);
+	~StartupPhase();
+
+	StartupPhase(const StartupPhase&) = delete;
+	StartupPhase& operator=(const StartupPhase&) = delete;
+
+private:
+	String m_Name;
+	double m_Start;
+};
+
+}
+
+#endif /* STARTUPPROFILE_H */
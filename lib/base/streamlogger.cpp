@@ -5,7 +5,10 @@
 #include "base/utility.hpp"
 #include "base/objectlock.hpp"
 #include "base/console.hpp"
+#include "base/timestampformatter.hpp"
+#include <chrono>
 #include <iostream>
+#include <sstream>
 
 using namespace icinga;
 
@@ -13,10 +16,25 @@ REGISTER_TYPE(StreamLogger);
 
 std::mutex StreamLogger::m_Mutex;
 
+static TimestampFormatter l_TimestampFormatter ("%Y-%m-%d %H:%M:%S %z");
+
+void StreamLogger::Start(bool runtimeCreated)
+{
+	if (GetAsync() && !m_Writer.joinable()) {
+		m_WriterStopped.store(false);
+		m_Writer = std::thread([this]() { WriterThreadProc(); });
+		m_AsyncRunning.store(true);
+	}
+
+	ObjectImpl<StreamLogger>::Start(runtimeCreated);
+}
+
 void StreamLogger::Stop(bool runtimeRemoved)
 {
 	ObjectImpl<StreamLogger>::Stop(runtimeRemoved);
 
+	StopWriter();
+
 	// make sure we flush the log data on shutdown, even if we don't call the destructor
 	if (m_Stream)
 		m_Stream->flush();
@@ -27,6 +45,8 @@ void StreamLogger::Stop(bool runtimeRemoved)
  */
 StreamLogger::~StreamLogger()
 {
+	StopWriter();
+
 	if (m_FlushLogTimer)
 		m_FlushLogTimer->Stop(true);
 
@@ -73,10 +93,15 @@ void StreamLogger::BindStream(std::ostream *stream, bool ownsStream)
  */
 void StreamLogger::ProcessLogEntry(std::ostream& stream, const LogEntry& entry)
 {
-	String timestamp = Utility::FormatDateTime("%Y-%m-%d %H:%M:%S %z", entry.Timestamp);
+	String timestamp = l_TimestampFormatter.Format(entry.Timestamp);
 
 	std::unique_lock<std::mutex> lock(m_Mutex);
 
+	WriteLogEntry(stream, entry, timestamp);
+}
+
+void StreamLogger::WriteLogEntry(std::ostream& stream, const LogEntry& entry, const String& timestamp)
+{
 	if (Logger::IsTimestampEnabled())
 		stream << "[" << timestamp << "] ";
 
@@ -117,3 +142,113 @@ void StreamLogger::ProcessLogEntry(const LogEntry& entry)
 {
 	ProcessLogEntry(*m_Stream, entry);
 }
+
+/**
+ * Queues the log entry for the writer thread, if there's one. Doesn't lock anything but the writer's mutex if it's idle.
+ *
+ * @return Whether the entry has been taken care of (including dropped)
+ */
+bool StreamLogger::EnqueueLogEntry(const LogEntry& entry)
+{
+	if (!m_AsyncRunning.load())
+		return false;
+
+	if (entry.Severity == LogDebug && m_Queued.load() >= (size_t)GetAsyncQueueSize()) {
+		m_Dropped.fetch_add(1);
+		return true;
+	}
+
+	m_Queued.fetch_add(1);
+	m_Queue.Push(entry);
+
+	/* Together with the writer checking m_Queued after setting m_WriterWaiting no wakeup gets lost. */
+	if (m_WriterWaiting.load()) {
+		std::unique_lock<std::mutex> lock (m_WriterMutex);
+		m_WriterCV.notify_one();
+	}
+
+	return true;
+}
+
+/**
+ * @return The number of debug entries dropped because the async queue was full
+ */
+uint_fast64_t StreamLogger::GetDroppedEntries() const
+{
+	return m_Dropped.load();
+}
+
+void StreamLogger::WriterThreadProc()
+{
+	Utility::SetThreadName("Log Writer");
+
+	std::ostringstream batch;
+	bool unflushed = false;
+
+	for (;;) {
+		LogEntry entry;
+		size_t count = 0;
+
+		while (count < 1000 && m_Queue.Pop(entry)) {
+			WriteLogEntry(batch, entry, l_TimestampFormatter.Format(entry.Timestamp));
+			count++;
+		}
+
+		if (count) {
+			m_Queued.fetch_sub(count);
+
+			{
+				ObjectLock olock (this);
+
+				if (m_Stream)
+					*m_Stream << batch.str();
+			}
+
+			batch.str("");
+			unflushed = true;
+			continue;
+		}
+
+		if (unflushed) {
+			Flush();
+			unflushed = false;
+		}
+
+		/* A producer may have counted, but not yet linked its entry. */
+		if (m_Queued.load()) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		if (m_WriterStopped.load())
+			break;
+
+		std::unique_lock<std::mutex> lock (m_WriterMutex);
+
+		m_WriterWaiting.store(true);
+
+		if (!m_Queued.load() && !m_WriterStopped.load())
+			m_WriterCV.wait_for(lock, std::chrono::milliseconds(500));
+
+		m_WriterWaiting.store(false);
+	}
+}
+
+/**
+ * Writes the pending entries and stops the writer thread. Entries queued later are processed synchronously.
+ */
+void StreamLogger::StopWriter()
+{
+	if (!m_Writer.joinable())
+		return;
+
+	m_AsyncRunning.store(false);
+
+	{
+		std::unique_lock<std::mutex> lock (m_WriterMutex);
+		m_WriterStopped.store(true);
+		m_WriterCV.notify_one();
+	}
+
+	m_Writer.join();
+}
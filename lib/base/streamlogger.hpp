@@ -5,8 +5,13 @@
 
 #include "base/i2-base.hpp"
 #include "base/streamlogger-ti.hpp"
+#include "base/mpscqueue.hpp"
 #include "base/timer.hpp"
+#include <atomic>
+#include <condition_variable>
 #include <iosfwd>
+#include <mutex>
+#include <thread>
 
 namespace icinga
 {
@@ -14,6 +19,10 @@ namespace icinga
 /**
  * A logger that logs to an iostream.
  *
+ * With async enabled the logging threads only queue their entries and a writer thread
+ * formats and writes them in batches. Once async_queue_size entries are pending, new
+ * debug entries are dropped (and counted), others are still queued.
+ *
  * @ingroup base
  */
 class StreamLogger : public ObjectImpl<StreamLogger>
@@ -21,6 +30,7 @@ class StreamLogger : public ObjectImpl<StreamLogger>
 public:
 	DECLARE_OBJECT(StreamLogger);
 
+	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 	~StreamLogger() override;
 
@@ -28,6 +38,9 @@ public:
 
 	static void ProcessLogEntry(std::ostream& stream, const LogEntry& entry);
 
+	bool EnqueueLogEntry(const LogEntry& entry) override;
+	uint_fast64_t GetDroppedEntries() const;
+
 protected:
 	void ProcessLogEntry(const LogEntry& entry) final;
 	void Flush() final;
@@ -39,7 +52,22 @@ private:
 
 	Timer::Ptr m_FlushLogTimer;
 
+	/* async writer */
+	std::atomic<bool> m_AsyncRunning{false};
+	MpscQueue<LogEntry> m_Queue;
+	std::atomic<size_t> m_Queued{0};
+	std::atomic<uint_fast64_t> m_Dropped{0};
+	std::thread m_Writer;
+	std::mutex m_WriterMutex;
+	std::condition_variable m_WriterCV;
+	std::atomic<bool> m_WriterWaiting{false};
+	std::atomic<bool> m_WriterStopped{false};
+
+	static void WriteLogEntry(std::ostream& stream, const LogEntry& entry, const String& timestamp);
+
 	void FlushLogTimerHandler();
+	void WriterThreadProc();
+	void StopWriter();
 };
 
 }
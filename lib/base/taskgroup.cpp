@@ -0,0 +1,197 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/taskgroup.hpp"
+#include "base/application.hpp"
+#include "base/exception.hpp"
+#include "base/threadpool.hpp"
+#include "base/utility.hpp"
+#include <utility>
+
+using namespace icinga;
+
+/**
+ * @param name The name to use in log messages
+ * @param maxPending If not 0, Enqueue() runs a task itself instead of letting more tasks wait for a thread
+ */
+TaskGroup::TaskGroup(String name, size_t maxPending)
+	: m_State(std::make_shared<State>())
+{
+	m_State->Name = std::move(name);
+	m_State->MaxPending = maxPending;
+	m_State->Started = Utility::GetTime();
+}
+
+TaskGroup::~TaskGroup()
+{
+	Join();
+
+	std::unique_lock<std::mutex> lock (m_State->Mutex);
+
+	Log(LogDebug, "TaskGroup")
+		<< "Task group '" << m_State->Name << "' ran " << m_State->Tasks << " tasks (" << m_State->TasksJoined
+		<< " of them while joining) in " << Utility::GetTime() - m_State->Started << "s, "
+		<< m_State->BusyTime << "s of work" << (m_State->Cancelled.load() ? ", cancelled" : "") << ".";
+}
+
+const String& TaskGroup::GetName() const
+{
+	return m_State->Name;
+}
+
+void TaskGroup::Enqueue(TaskFunction function)
+{
+	{
+		std::unique_lock<std::mutex> lock (m_State->Mutex);
+
+		m_State->Pending.emplace_back(std::move(function));
+
+		if (m_State->MaxPending && m_State->Pending.size() > m_State->MaxPending) {
+			lock.unlock();
+
+			/* The threads can't keep up, so help them instead of queueing even more. */
+			RunPendingTask(*m_State, false);
+			return;
+		}
+	}
+
+	auto state (m_State);
+
+	/* The pool's threads each pick one task, if any is left. If there's no pool, Join() will run it. */
+	Application::GetTP().Post([state]() { RunPendingTask(*state, false); }, DefaultScheduler);
+}
+
+/**
+ * Runs the next task which didn't start yet.
+ *
+ * @param join Whether Join() runs it on the waiting thread
+ *
+ * @return Whether there was any
+ */
+bool TaskGroup::RunPendingTask(State& state, bool join)
+{
+	TaskFunction task;
+
+	{
+		std::unique_lock<std::mutex> lock (state.Mutex);
+
+		if (state.Pending.empty())
+			return false;
+
+		task = std::move(state.Pending.front());
+		state.Pending.pop_front();
+		state.Running++;
+	}
+
+	double start = Utility::GetTime();
+
+	if (!state.Cancelled.load(std::memory_order_relaxed)) {
+		try {
+			task();
+		} catch (const std::exception&) {
+			std::unique_lock<std::mutex> lock (state.Mutex);
+			state.Exceptions.emplace_back(boost::current_exception());
+		}
+	}
+
+	/* Release whatever the task holds before the joining thread continues. */
+	task = nullptr;
+
+	double end = Utility::GetTime();
+
+	std::unique_lock<std::mutex> lock (state.Mutex);
+
+	state.Tasks++;
+	state.TasksJoined += join;
+	state.BusyTime += end - start;
+
+	if (!--state.Running)
+		state.CVDone.notify_all();
+
+	return true;
+}
+
+/**
+ * Waits until all tasks enqueued so far are done and runs those which didn't start yet on the calling thread.
+ */
+void TaskGroup::Join()
+{
+	for (;;) {
+		while (RunPendingTask(*m_State, true))
+			;
+
+		std::unique_lock<std::mutex> lock (m_State->Mutex);
+
+		/* Running tasks may enqueue more tasks. */
+		m_State->CVDone.wait(lock, [this]() { return !m_State->Running || !m_State->Pending.empty(); });
+
+		if (!m_State->Running && m_State->Pending.empty())
+			return;
+	}
+}
+
+/**
+ * Skips all tasks which didn't start yet, ParallelFor() also skips the remaining items of running tasks.
+ */
+void TaskGroup::Cancel()
+{
+	m_State->Cancelled.store(true);
+}
+
+bool TaskGroup::IsCancelled() const
+{
+	return m_State->Cancelled.load(std::memory_order_relaxed);
+}
+
+void TaskGroup::AddException(boost::exception_ptr eptr)
+{
+	std::unique_lock<std::mutex> lock (m_State->Mutex);
+
+	m_State->Exceptions.emplace_back(std::move(eptr));
+}
+
+bool TaskGroup::HasExceptions() const
+{
+	std::unique_lock<std::mutex> lock (m_State->Mutex);
+
+	return !m_State->Exceptions.empty();
+}
+
+std::vector<boost::exception_ptr> TaskGroup::GetExceptions() const
+{
+	std::unique_lock<std::mutex> lock (m_State->Mutex);
+
+	return m_State->Exceptions;
+}
+
+void TaskGroup::ReportExceptions(const String& facility, bool verbose) const
+{
+	std::vector<boost::exception_ptr> exceptions = GetExceptions();
+
+	for (const auto& eptr : exceptions) {
+		Log(LogCritical, facility)
+			<< DiagnosticInformation(eptr, verbose);
+	}
+
+	Log(LogCritical, facility)
+		<< exceptions.size() << " error" << (exceptions.size() != 1 ? "s" : "");
+}
+
+/**
+ * Returns the number of tasks done so far. A ParallelFor() chunk counts as one task.
+ */
+size_t TaskGroup::GetTaskCount() const
+{
+	std::unique_lock<std::mutex> lock (m_State->Mutex);
+
+	return m_State->Tasks;
+}
+
+/**
+ * Returns how long all tasks done so far took in total, in seconds.
+ */
+double TaskGroup::GetBusyTime() const
+{
+	std::unique_lock<std::mutex> lock (m_State->Mutex);
+
+	return m_State->BusyTime;
+}
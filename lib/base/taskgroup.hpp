@@ -0,0 +1,134 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef TASKGROUP_H
+#define TASKGROUP_H
+
+#include "base/i2-base.hpp"
+#include "base/configuration.hpp"
+#include "base/logger.hpp"
+#include "base/string.hpp"
+#include <boost/exception_ptr.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A group of tasks which run on the process-wide thread pool (Application::GetTP()).
+ *
+ * Unlike a WorkQueue with its own threads, creating a task group is cheap and all groups together never use
+ * more threads than the pool has, even if a task creates and joins a group itself. Join() doesn't just wait,
+ * it runs the group's tasks which didn't start yet on the calling thread. So joining a group from within a
+ * task of another one can't run out of threads, and a group with no thread pool available at all still
+ * completes, just on the calling thread.
+ *
+ * The interface is the subset of WorkQueue's one used for parallel loops: exceptions thrown by tasks are
+ * collected and don't stop the other tasks.
+ *
+ * @ingroup base
+ */
+class TaskGroup
+{
+public:
+	typedef std::function<void ()> TaskFunction;
+
+	TaskGroup(String name, size_t maxPending = 0);
+	~TaskGroup();
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	const String& GetName() const;
+
+	void Enqueue(TaskFunction function);
+	void Join();
+
+	template<typename VectorType, typename FuncType>
+	void ParallelFor(const VectorType& items, const FuncType& func)
+	{
+		ParallelFor(items, true, func);
+	}
+
+	/**
+	 * Calls func for every item, in Configuration::Concurrency chunks of consecutive items if preChunk is set
+	 * or one task per item. The items have to stay valid until Join() returned.
+	 */
+	template<typename VectorType, typename FuncType>
+	void ParallelFor(const VectorType& items, bool preChunk, const FuncType& func)
+	{
+		using SizeType = decltype(items.size());
+
+		SizeType totalCount = items.size();
+		SizeType chunks = preChunk ? std::max<SizeType>(Configuration::Concurrency, 1) : totalCount;
+		SizeType offset = 0;
+
+		for (SizeType i = 0; i < chunks; i++) {
+			SizeType count = totalCount / chunks;
+			if (i < totalCount % chunks)
+				count++;
+
+			if (count) {
+				Enqueue([this, &items, func, offset, count]() {
+					for (SizeType j = offset; j < offset + count && !IsCancelled(); j++) {
+						try {
+							func(items[j]);
+						} catch (const std::exception&) {
+							AddException(boost::current_exception());
+						}
+					}
+				});
+			}
+
+			offset += count;
+		}
+	}
+
+	void Cancel();
+	bool IsCancelled() const;
+
+	bool HasExceptions() const;
+	std::vector<boost::exception_ptr> GetExceptions() const;
+	void ReportExceptions(const String& facility, bool verbose = false) const;
+
+	size_t GetTaskCount() const;
+	double GetBusyTime() const;
+
+private:
+	struct State
+	{
+		String Name;
+		size_t MaxPending;
+
+		mutable std::mutex Mutex;
+		std::condition_variable CVDone;
+		std::deque<TaskFunction> Pending;
+		size_t Running{0};
+		std::vector<boost::exception_ptr> Exceptions;
+
+		std::atomic<bool> Cancelled{false};
+
+		/* Statistics */
+		size_t Tasks{0};
+		size_t TasksJoined{0};
+		double BusyTime{0};
+		double Started{0};
+	};
+
+	std::shared_ptr<State> m_State;
+
+	void AddException(boost::exception_ptr eptr);
+
+	static bool RunPendingTask(State& state, bool join);
+};
+
+}
+
+#endif /* TASKGROUP_H */
@@ -1,11 +1,38 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "base/threadpool.hpp"
+#include "base/workstealingdeque.hpp"
 #include <boost/thread/locks.hpp>
+#include <deque>
 
 using namespace icinga;
 
-ThreadPool::ThreadPool() : m_Pending(0)
+/**
+ * A worker thread of a ThreadPool and its work items.
+ *
+ * @ingroup base
+ */
+class ThreadPool::Worker
+{
+public:
+	ThreadPool *Pool;
+	std::thread Thread;
+
+	/* Work items posted by this worker itself, see WorkStealingDeque. */
+	WorkStealingDeque<WorkFunction> Tasks;
+
+	/* Work items posted by other threads. */
+	std::mutex InboxMutex;
+	std::deque<WorkFunction *> Inbox;
+
+	Worker(ThreadPool *pool)
+		: Pool(pool)
+	{ }
+};
+
+thread_local ThreadPool::Worker *ThreadPool::m_CurrentWorker = nullptr;
+
+ThreadPool::ThreadPool() : m_Pending(0), m_Steals(0), m_IdleWorkers(0), m_NextWorker(0)
 {
 	Start();
 }
@@ -19,23 +46,50 @@ void ThreadPool::Start()
 {
 	boost::unique_lock<decltype(m_Mutex)> lock (m_Mutex);
 
-	if (!m_Pool) {
+	if (m_Workers.empty()) {
 		InitializePool();
 	}
 }
 
 void ThreadPool::InitializePool()
 {
-	m_Pool = decltype(m_Pool)(new boost::asio::thread_pool(Configuration::Concurrency * 2u));
+	m_Stopping = false;
+
+	for (auto i (Configuration::Concurrency * 2u); i; --i) {
+		m_Workers.emplace_back(new Worker(this));
+	}
+
+	for (auto& worker : m_Workers) {
+		Worker& w (*worker);
+
+		worker->Thread = std::thread([this, &w]() { WorkerThreadProc(w); });
+	}
+}
+
+/**
+ * Waits until all posted work items have been processed and stops all workers.
+ */
+void ThreadPool::JoinPool()
+{
+	{
+		std::unique_lock<std::mutex> lock (m_IdleMutex);
+		m_Stopping = true;
+		m_IdleCV.notify_all();
+	}
+
+	for (auto& worker : m_Workers) {
+		worker->Thread.join();
+	}
+
+	m_Workers.clear();
 }
 
 void ThreadPool::Stop()
 {
 	boost::unique_lock<decltype(m_Mutex)> lock (m_Mutex);
 
-	if (m_Pool) {
-		m_Pool->join();
-		m_Pool = nullptr;
+	if (!m_Workers.empty()) {
+		JoinPool();
 	}
 }
 
@@ -43,9 +97,135 @@ void ThreadPool::Restart()
 {
 	boost::unique_lock<decltype(m_Mutex)> lock (m_Mutex);
 
-	if (m_Pool) {
-		m_Pool->join();
+	if (!m_Workers.empty()) {
+		JoinPool();
 	}
 
 	InitializePool();
 }
+
+/**
+ * Hands a work item over to one of the workers. m_Mutex must be shared-locked.
+ *
+ * @param task The work item, the worker takes ownership of it.
+ */
+void ThreadPool::Enqueue(WorkFunction *task)
+{
+	Worker *worker = m_CurrentWorker;
+
+	if (worker && worker->Pool == this) {
+		worker->Tasks.Push(task);
+	} else {
+		worker = m_Workers[m_NextWorker.fetch_add(1) % m_Workers.size()].get();
+
+		std::unique_lock<std::mutex> lock (worker->InboxMutex);
+		worker->Inbox.push_back(task);
+	}
+
+	if (m_IdleWorkers.load()) {
+		std::unique_lock<std::mutex> lock (m_IdleMutex);
+		m_IdleCV.notify_one();
+	}
+}
+
+/**
+ * Picks the next work item for the specified worker: from its own deque first,
+ * then from its inbox and finally from the other workers.
+ *
+ * @param worker The worker.
+ * @returns The work item or nullptr if there is none.
+ */
+ThreadPool::WorkFunction *ThreadPool::GetTask(Worker& worker)
+{
+	WorkFunction *task = worker.Tasks.Pop();
+
+	if (task) {
+		return task;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock (worker.InboxMutex);
+
+		if (!worker.Inbox.empty()) {
+			task = worker.Inbox.front();
+			worker.Inbox.pop_front();
+
+			/* Make the remaining items available for stealing. */
+			for (auto item : worker.Inbox) {
+				worker.Tasks.Push(item);
+			}
+
+			worker.Inbox.clear();
+
+			return task;
+		}
+	}
+
+	auto count (m_Workers.size());
+
+	for (decltype(count) i = 0; i < count; i++) {
+		Worker& victim (*m_Workers[(m_NextWorker.load() + i) % count]);
+
+		if (&victim == &worker) {
+			continue;
+		}
+
+		task = victim.Tasks.Steal();
+
+		if (!task) {
+			std::unique_lock<std::mutex> lock (victim.InboxMutex, std::try_to_lock);
+
+			if (lock && !victim.Inbox.empty()) {
+				task = victim.Inbox.front();
+				victim.Inbox.pop_front();
+			}
+		}
+
+		if (task) {
+			m_Steals.fetch_add(1);
+			return task;
+		}
+	}
+
+	return nullptr;
+}
+
+void ThreadPool::WorkerThreadProc(Worker& worker)
+{
+	m_CurrentWorker = &worker;
+
+	for (;;) {
+		WorkFunction *task = GetTask(worker);
+
+		if (task) {
+			m_Pending.fetch_sub(1);
+
+			(*task)();
+			delete task;
+
+			continue;
+		}
+
+		if (m_Pending.load()) {
+			/* A work item is just being posted or another worker raced us for it. */
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock (m_IdleMutex);
+
+		m_IdleWorkers.fetch_add(1);
+
+		while (!m_Pending.load() && !m_Stopping) {
+			m_IdleCV.wait(lock);
+		}
+
+		m_IdleWorkers.fetch_sub(1);
+
+		if (m_Stopping && !m_Pending.load()) {
+			break;
+		}
+	}
+
+	m_CurrentWorker = nullptr;
+}
@@ -7,13 +7,14 @@
 #include "base/configuration.hpp"
 #include "base/exception.hpp"
 #include "base/logger.hpp"
+#include <condition_variable>
 #include <cstddef>
 #include <exception>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <thread>
-#include <boost/asio/post.hpp>
-#include <boost/asio/thread_pool.hpp>
+#include <vector>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <cstdint>
@@ -28,7 +29,12 @@ enum SchedulerPolicy
 };
 
 /**
- * A thread pool.
+ * A work-stealing thread pool.
+ *
+ * Every worker thread has its own deque. Work items posted by a worker are pushed
+ * onto its own deque and processed in LIFO order, work items posted by any other
+ * thread are distributed round-robin to the workers. Idle workers steal work items
+ * from the other workers.
  *
  * @ingroup base
  */
@@ -45,7 +51,8 @@ public:
 	void Restart();
 
 	/**
-	 * Appends a work item to the work queue. Work items will be processed in FIFO order.
+	 * Appends a work item to the work queue. There are no guarantees about the order
+	 * in which work items are processed.
 	 *
 	 * @param callback The callback function for the work item.
 	 * @returns true if the item was queued, false otherwise.
@@ -55,27 +62,25 @@ public:
 	{
 		boost::shared_lock<decltype(m_Mutex)> lock (m_Mutex);
 
-		if (m_Pool) {
-			m_Pending.fetch_add(1);
-
-			boost::asio::post(*m_Pool, [this, callback]() {
-				m_Pending.fetch_sub(1);
-
-				try {
-					callback();
-				} catch (const std::exception& ex) {
-					Log(LogCritical, "ThreadPool")
-						<< "Exception thrown in event handler:\n"
-						<< DiagnosticInformation(ex);
-				} catch (...) {
-					Log(LogCritical, "ThreadPool", "Exception of unknown type thrown in event handler.");
-				}
-			});
-
-			return true;
-		} else {
+		if (m_Workers.empty()) {
 			return false;
 		}
+
+		m_Pending.fetch_add(1);
+
+		Enqueue(new WorkFunction([callback]() {
+			try {
+				callback();
+			} catch (const std::exception& ex) {
+				Log(LogCritical, "ThreadPool")
+					<< "Exception thrown in event handler:\n"
+					<< DiagnosticInformation(ex);
+			} catch (...) {
+				Log(LogCritical, "ThreadPool", "Exception of unknown type thrown in event handler.");
+			}
+		}));
+
+		return true;
 	}
 
 	/**
@@ -88,12 +93,39 @@ public:
 		return m_Pending.load();
 	}
 
+	/**
+	 * Returns how many tasks idle workers took from other workers so far.
+	 *
+	 * @returns amount of stolen tasks.
+	 */
+	inline uint_fast64_t GetSteals()
+	{
+		return m_Steals.load();
+	}
+
 private:
+	class Worker;
+
+	static thread_local Worker *m_CurrentWorker;
+
 	boost::shared_mutex m_Mutex;
-	std::unique_ptr<boost::asio::thread_pool> m_Pool;
+	std::vector<std::unique_ptr<Worker>> m_Workers;
+
+	std::mutex m_IdleMutex;
+	std::condition_variable m_IdleCV;
+	bool m_Stopping{false};
+
 	Atomic<uint_fast64_t> m_Pending;
+	Atomic<uint_fast64_t> m_Steals;
+	Atomic<unsigned int> m_IdleWorkers;
+	Atomic<unsigned int> m_NextWorker;
 
 	void InitializePool();
+	void JoinPool();
+
+	void Enqueue(WorkFunction *task);
+	WorkFunction *GetTask(Worker& worker);
+	void WorkerThreadProc(Worker& worker);
 };
 
 }
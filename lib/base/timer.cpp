@@ -5,59 +5,266 @@
 #include "base/debug.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/key_extractors.hpp>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <limits>
 #include <mutex>
 #include <thread>
 #include <utility>
+#include <vector>
 
 using namespace icinga;
 
 namespace icinga {
 
-class TimerHolder {
+/**
+ * A hierarchical timing wheel which keeps track of all started timers.
+ *
+ * Level 0 has one slot per tick, every slot on a higher level covers the whole
+ * range of the level below it. Timers are moved down one level ("cascaded") as
+ * soon as the wheel reaches their slot. Inserting and removing a timer is O(1),
+ * timers which are due at the same tick are expired as one batch.
+ *
+ * All members must be accessed with l_TimerMutex held.
+ *
+ * @ingroup base
+ */
+class TimingWheel
+{
 public:
-	TimerHolder(Timer *timer)
-		: m_Timer(timer)
-	{ }
+	static constexpr double TickLength = 0.01;
+
+	static uint_fast64_t ToTick(double ts)
+	{
+		return ts > 0 ? static_cast<uint_fast64_t>(ts / TickLength) : 0;
+	}
+
+	static double FromTick(uint_fast64_t tick)
+	{
+		return tick * TickLength;
+	}
+
+	bool IsEmpty() const
+	{
+		return m_Size == 0;
+	}
 
-	inline Timer *GetObject() const
+	/**
+	 * Sets the tick which is processed next. The wheel must be empty.
+	 */
+	void Reset(uint_fast64_t tick)
 	{
-		return m_Timer;
+		VERIFY(m_Size == 0);
+
+		m_Tick = tick;
 	}
 
-	inline double GetNextUnlocked() const
+	void Insert(Timer *timer)
 	{
-		return m_Timer->m_Next;
+		Link(timer);
+		m_Size++;
 	}
 
-	operator Timer *() const
+	void Remove(Timer *timer)
 	{
-		return m_Timer;
+		if (!timer->m_WheelSlot)
+			return;
+
+		Unlink(timer);
+		m_Size--;
+	}
+
+	/**
+	 * Removes all timers from the wheel.
+	 *
+	 * @param timers Receives the removed timers.
+	 */
+	void TakeAll(std::vector<Timer *>& timers)
+	{
+		for (auto& level : m_Slots) {
+			for (auto& slot : level) {
+				TakeSlot(slot, timers);
+			}
+		}
+
+		m_Size = 0;
+	}
+
+	/**
+	 * Processes all ticks up to and including the specified one.
+	 *
+	 * @param tick The current tick.
+	 * @param expired Receives the timers which are due, they're removed from the wheel.
+	 */
+	void Advance(uint_fast64_t tick, std::vector<Timer *>& expired)
+	{
+		if (m_Size == 0) {
+			m_Tick = tick + 1;
+			return;
+		}
+
+		if (tick + 1 < m_Tick || (tick >= m_Tick && tick - m_Tick >= SlotsPerLevel)) {
+			/* The clock jumped backwards or we're way behind, rebuilding the wheel
+			 * is cheaper than stepping through every single tick. */
+			std::vector<Timer *> timers;
+			TakeAll(timers);
+
+			m_Tick = tick + 1;
+
+			for (Timer *timer : timers) {
+				if (timer->m_WheelTick <= tick) {
+					expired.push_back(timer);
+				} else {
+					Link(timer);
+					m_Size++;
+				}
+			}
+
+			return;
+		}
+
+		while (m_Tick <= tick) {
+			auto index (m_Tick & SlotMask);
+
+			if (index == 0) {
+				for (int level = 1; level < Levels && Cascade(level) == 0; level++)
+					;
+			}
+
+			m_Tick++;
+
+			auto before (expired.size());
+			TakeSlot(m_Slots[0][index], expired);
+			m_Size -= expired.size() - before;
+		}
+	}
+
+	/**
+	 * Determines the tick at which the wheel has to be advanced next.
+	 *
+	 * @param tick Receives the tick.
+	 * @returns false if the wheel is empty.
+	 */
+	bool GetNextTick(uint_fast64_t& tick) const
+	{
+		if (m_Size == 0)
+			return false;
+
+		for (tick = m_Tick; !m_Slots[0][tick & SlotMask]; tick++) {
+			/* The timers on the higher levels have to be cascaded at the next wrap-around. */
+			if (((tick + 1) & SlotMask) == 0) {
+				tick++;
+				break;
+			}
+		}
+
+		return true;
 	}
 
 private:
-	Timer *m_Timer;
+	static constexpr int LevelBits = 8;
+	static constexpr int Levels = 4;
+	static constexpr uint_fast64_t SlotsPerLevel = uint_fast64_t(1) << LevelBits;
+	static constexpr uint_fast64_t SlotMask = SlotsPerLevel - 1;
+
+	Timer *m_Slots[Levels][SlotsPerLevel] {};
+	uint_fast64_t m_Tick{0}; /**< The tick which is processed next. */
+	size_t m_Size{0};
+
+	void Link(Timer *timer)
+	{
+		uint_fast64_t expires = timer->m_WheelTick;
+
+		/* Overdue timers are processed with the next tick. */
+		if (expires < m_Tick)
+			expires = m_Tick;
+
+		uint_fast64_t delta = expires - m_Tick;
+		int level = 0;
+
+		while (level < Levels - 1 && delta >= uint_fast64_t(1) << ((level + 1) * LevelBits))
+			level++;
+
+		/* Timers beyond the range of the wheel are put into the last slot
+		 * and re-linked when that one is cascaded. */
+		uint_fast64_t range = uint_fast64_t(1) << (Levels * LevelBits);
+
+		if (delta >= range)
+			expires = m_Tick + range - 1;
+
+		Timer **slot = &m_Slots[level][(expires >> (level * LevelBits)) & SlotMask];
+
+		timer->m_WheelSlot = slot;
+		timer->m_WheelPrev = nullptr;
+		timer->m_WheelNext = *slot;
+
+		if (*slot)
+			(*slot)->m_WheelPrev = timer;
+
+		*slot = timer;
+	}
+
+	void Unlink(Timer *timer)
+	{
+		if (timer->m_WheelPrev)
+			timer->m_WheelPrev->m_WheelNext = timer->m_WheelNext;
+		else
+			*timer->m_WheelSlot = timer->m_WheelNext;
+
+		if (timer->m_WheelNext)
+			timer->m_WheelNext->m_WheelPrev = timer->m_WheelPrev;
+
+		timer->m_WheelSlot = nullptr;
+		timer->m_WheelPrev = nullptr;
+		timer->m_WheelNext = nullptr;
+	}
+
+	static void TakeSlot(Timer *& slot, std::vector<Timer *>& timers)
+	{
+		Timer *timer = slot;
+
+		slot = nullptr;
+
+		while (timer) {
+			Timer *next = timer->m_WheelNext;
+
+			timer->m_WheelSlot = nullptr;
+			timer->m_WheelPrev = nullptr;
+			timer->m_WheelNext = nullptr;
+
+			timers.push_back(timer);
+			timer = next;
+		}
+	}
+
+	/**
+	 * Moves the timers of the current slot on the specified level to the lower levels.
+	 *
+	 * @returns The index of the cascaded slot.
+	 */
+	uint_fast64_t Cascade(int level)
+	{
+		auto index ((m_Tick >> (level * LevelBits)) & SlotMask);
+		std::vector<Timer *> timers;
+
+		TakeSlot(m_Slots[level][index], timers);
+
+		for (Timer *timer : timers)
+			Link(timer);
+
+		return index;
+	}
 };
 
 }
 
-typedef boost::multi_index_container<
-	TimerHolder,
-	boost::multi_index::indexed_by<
-		boost::multi_index::ordered_unique<boost::multi_index::const_mem_fun<TimerHolder, Timer *, &TimerHolder::GetObject> >,
-		boost::multi_index::ordered_non_unique<boost::multi_index::const_mem_fun<TimerHolder, double, &TimerHolder::GetNextUnlocked> >
-	>
-> TimerSet;
-
 static std::mutex l_TimerMutex;
 static std::condition_variable l_TimerCV;
 static std::thread l_TimerThread;
 static bool l_StopTimerThread;
-static TimerSet l_Timers;
+static TimingWheel l_TimerWheel;
+static uint_fast64_t l_TimerWakeTick = std::numeric_limits<uint_fast64_t>::max();
 static int l_AliveTimers = 0;
 
 static Defer l_ShutdownTimersCleanlyOnExit (&Timer::Uninitialize);
@@ -187,10 +394,7 @@ void Timer::Stop(bool wait)
 	}
 
 	m_Started = false;
-	l_Timers.erase(this);
-
-	/* Notify the worker thread that we've disabled a timer. */
-	l_TimerCV.notify_all();
+	l_TimerWheel.Remove(this);
 
 	while (wait && m_Running)
 		l_TimerCV.wait(lock);
@@ -217,9 +421,14 @@ void Timer::InternalReschedule(bool completed, double next)
  */
 void Timer::InternalRescheduleUnlocked(bool completed, double next)
 {
-	if (completed)
+	if (completed) {
 		m_Running = false;
 
+		/* Wake up Stop() calls which are waiting for the callback to finish. */
+		if (!m_Started)
+			l_TimerCV.notify_all();
+	}
+
 	if (next < 0) {
 		/* Don't schedule the next call if this is not a periodic timer. */
 		if (m_Interval <= 0)
@@ -231,12 +440,17 @@ void Timer::InternalRescheduleUnlocked(bool completed, double next)
 	m_Next = next;
 
 	if (m_Started && !m_Running) {
-		/* Remove and re-add the timer to update the index. */
-		l_Timers.erase(this);
-		l_Timers.insert(this);
+		l_TimerWheel.Remove(this);
 
-		/* Notify the worker that we've rescheduled a timer. */
-		l_TimerCV.notify_all();
+		if (l_TimerWheel.IsEmpty())
+			l_TimerWheel.Reset(TimingWheel::ToTick(Utility::GetTime()));
+
+		m_WheelTick = TimingWheel::ToTick(m_Next);
+		l_TimerWheel.Insert(this);
+
+		/* Notify the worker if the timer is due before it would wake up anyway. */
+		if (m_WheelTick < l_TimerWakeTick)
+			l_TimerCV.notify_all();
 	}
 }
 
@@ -263,27 +477,19 @@ void Timer::AdjustTimers(double adjustment)
 
 	double now = Utility::GetTime();
 
-	typedef boost::multi_index::nth_index<TimerSet, 1>::type TimerView;
-	TimerView& idx = boost::get<1>(l_Timers);
-
 	std::vector<Timer *> timers;
+	l_TimerWheel.TakeAll(timers);
+	l_TimerWheel.Reset(TimingWheel::ToTick(now));
 
-	for (Timer *timer : idx) {
+	for (Timer *timer : timers) {
 		/* Don't schedule the next call if this is not a periodic timer. */
-		if (timer->m_Interval <= 0) {
-			continue;
-		}
-
-		if (std::fabs(now - (timer->m_Next + adjustment)) <
+		if (timer->m_Interval > 0 && std::fabs(now - (timer->m_Next + adjustment)) <
 			std::fabs(now - timer->m_Next)) {
 			timer->m_Next += adjustment;
-			timers.push_back(timer);
+			timer->m_WheelTick = TimingWheel::ToTick(timer->m_Next);
 		}
-	}
 
-	for (Timer *timer : timers) {
-		l_Timers.erase(timer);
-		l_Timers.insert(timer);
+		l_TimerWheel.Insert(timer);
 	}
 
 	/* Notify the worker that we've rescheduled some timers. */
@@ -303,51 +509,65 @@ void Timer::TimerThreadProc()
 
 	std::unique_lock<std::mutex> lock (l_TimerMutex);
 
-	for (;;) {
-		typedef boost::multi_index::nth_index<TimerSet, 1>::type NextTimerView;
-		NextTimerView& idx = boost::get<1>(l_Timers);
+	std::vector<Timer *> expired;
+	std::vector<Timer::Ptr> batch;
 
+	for (;;) {
 		/* Wait until there is at least one timer. */
-		while (idx.empty() && !l_StopTimerThread)
+		while (l_TimerWheel.IsEmpty() && !l_StopTimerThread) {
+			l_TimerWakeTick = std::numeric_limits<uint_fast64_t>::max();
 			l_TimerCV.wait(lock);
+		}
 
 		if (l_StopTimerThread)
 			break;
 
-		auto it = idx.begin();
+		/* Timers which are due within the next tick are considered to be due now. */
+		l_TimerWheel.Advance(TimingWheel::ToTick(Utility::GetTime() + TimingWheel::TickLength), expired);
+
+		if (expired.empty()) {
+			uint_fast64_t tick;
 
-		// timer->~Timer() may be called at any moment (if the last
-		// smart pointer gets destroyed) or even already waiting for
-		// l_TimerMutex (before doing anything else) which we have
-		// locked at the moment. Until our unlock using *timer is safe.
-		Timer *timer = *it;
+			if (!l_TimerWheel.GetNextTick(tick))
+				continue;
 
-		ch::time_point<ch::system_clock, ch::duration<double>> next (ch::duration<double>(timer->m_Next));
+			l_TimerWakeTick = tick;
 
-		if (next - ch::system_clock::now() > ch::duration<double>(0.01)) {
 			/* Wait for the next timer. */
+			ch::time_point<ch::system_clock, ch::duration<double>> next (ch::duration<double>(TimingWheel::FromTick(tick - 1)));
 			l_TimerCV.wait_until(lock, next);
 
 			continue;
 		}
 
-		/* Remove the timer from the list so it doesn't get called again
-		 * until the current call is completed. */
-		l_Timers.erase(timer);
+		l_TimerWakeTick = 0;
 
-		auto keepAlive (timer->m_Self.lock());
+		for (Timer *timer : expired) {
+			// timer->~Timer() may be called at any moment (if the last
+			// smart pointer gets destroyed) or even already waiting for
+			// l_TimerMutex (before doing anything else) which we have
+			// locked at the moment. Until our unlock using *timer is safe.
+			auto keepAlive (timer->m_Self.lock());
 
-		if (!keepAlive) {
-			// The last std::shared_ptr is gone, let ~Timer() proceed
-			continue;
+			if (!keepAlive) {
+				// The last std::shared_ptr is gone, let ~Timer() proceed
+				continue;
+			}
+
+			timer->m_Running = true;
+			batch.emplace_back(std::move(keepAlive));
 		}
 
-		timer->m_Running = true;
+		expired.clear();
 
 		lock.unlock();
 
-		/* Asynchronously call the timer. */
-		Utility::QueueAsyncCallback([timer=std::move(keepAlive)]() { timer->Call(); });
+		/* Asynchronously call the timers. */
+		for (auto& timer : batch) {
+			Utility::QueueAsyncCallback([timer=std::move(timer)]() { timer->Call(); });
+		}
+
+		batch.clear();
 
 		lock.lock();
 	}
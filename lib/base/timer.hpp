@@ -5,11 +5,12 @@
 
 #include "base/i2-base.hpp"
 #include <boost/signals2.hpp>
+#include <cstdint>
 #include <memory>
 
 namespace icinga {
 
-class TimerHolder;
+class TimingWheel;
 
 /**
  * A timer that periodically triggers an event.
@@ -50,6 +51,11 @@ private:
 	bool m_Running{false}; /**< Whether the timer proc is currently running. */
 	std::weak_ptr<Timer> m_Self;
 
+	Timer *m_WheelPrev{nullptr}; /**< The previous timer in the same timing wheel slot. */
+	Timer *m_WheelNext{nullptr}; /**< The next timer in the same timing wheel slot. */
+	Timer **m_WheelSlot{nullptr}; /**< The timing wheel slot this timer is linked into, if any. */
+	uint_fast64_t m_WheelTick{0}; /**< The timing wheel tick at which the timer is due. */
+
 	Timer() = default;
 	void Call();
 	void InternalReschedule(bool completed, double next = -1);
@@ -57,7 +63,7 @@ private:
 
 	static void TimerThreadProc();
 
-	friend class TimerHolder;
+	friend class TimingWheel;
 };
 
 }
@@ -0,0 +1,126 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/timestampformatter.hpp"
+#include "base/exception.hpp"
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+using namespace icinga;
+
+TimestampFormatter::TimestampFormatter(const char *format)
+{
+	String fmt (format);
+
+	/* Look for the first %f which isn't an escaped "%%f". */
+	for (size_t i = 0; i + 1 < fmt.GetLength(); i++) {
+		if (fmt[i] != '%')
+			continue;
+
+		size_t end = i + 1;
+		unsigned int digits = 3;
+
+		if (fmt[end] >= '1' && fmt[end] <= '9' && end + 1 < fmt.GetLength()) {
+			digits = fmt[end] - '0';
+			end++;
+		}
+
+		if (fmt[end] == 'f') {
+			m_Head = fmt.SubStr(0, i);
+			m_Tail = fmt.SubStr(end + 1);
+			m_FractionDigits = digits;
+			m_HasFraction = true;
+			return;
+		}
+
+		/* Skip the conversion, e.g. the second % of "%%". */
+		i++;
+	}
+
+	m_Head = std::move(fmt);
+}
+
+/**
+ * Formats the timestamp, the seconds part is cached until a timestamp of another second is formatted.
+ *
+ * @param ts The timestamp, sub-second parts are only used by %f
+ * @returns The formatted timestamp
+ */
+String TimestampFormatter::Format(double ts) const
+{
+	double second = std::floor(ts);
+	auto tempts = (time_t)second;
+	std::string result;
+
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	if (!m_Cached || m_CachedSecond != tempts) {
+		tm tmthen;
+
+#ifdef _MSC_VER
+		tm *temp = localtime(&tempts);
+
+		if (!temp) {
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("localtime")
+				<< boost::errinfo_errno(errno));
+		}
+
+		tmthen = *temp;
+#else /* _MSC_VER */
+		if (!localtime_r(&tempts, &tmthen)) {
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("localtime_r")
+				<< boost::errinfo_errno(errno));
+		}
+#endif /* _MSC_VER */
+
+		m_CachedHead = FormatPart(m_Head, tmthen);
+		m_CachedTail = FormatPart(m_Tail, tmthen);
+		m_CachedSecond = tempts;
+		m_Cached = true;
+	}
+
+	result.reserve(m_CachedHead.GetLength() + m_FractionDigits + m_CachedTail.GetLength());
+	result += m_CachedHead.GetData();
+
+	if (m_HasFraction) {
+		uint64_t scale = 1;
+
+		for (unsigned int i = 0; i < m_FractionDigits; i++)
+			scale *= 10u;
+
+		auto fraction = (uint64_t)((ts - second) * scale);
+
+		/* Rounding errors of ts - second must not result in an extra digit. */
+		if (fraction >= scale)
+			fraction = scale - 1u;
+
+		char digits[9];
+
+		for (unsigned int i = m_FractionDigits; i-- > 0;) {
+			digits[i] = '0' + fraction % 10u;
+			fraction /= 10u;
+		}
+
+		result.append(digits, m_FractionDigits);
+	}
+
+	result += m_CachedTail.GetData();
+
+	return String(std::move(result));
+}
+
+String TimestampFormatter::FormatPart(const String& format, const tm& tmthen)
+{
+	if (format.IsEmpty())
+		return String();
+
+	char timestamp[128];
+
+	if (!strftime(timestamp, sizeof(timestamp), format.CStr(), &tmthen))
+		return String();
+
+	return timestamp;
+}
@@ -0,0 +1,52 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef TIMESTAMPFORMATTER_H
+#define TIMESTAMPFORMATTER_H
+
+#include "base/i2-base.hpp"
+#include "base/string.hpp"
+#include <ctime>
+#include <mutex>
+
+namespace icinga
+{
+
+/**
+ * Formats timestamps in the local time zone like Utility::FormatDateTime() for the code which does so for
+ * every log entry or event.
+ *
+ * The timestamps of consecutive calls are mostly within the same second, so the time zone conversion and
+ * strftime() run only once per second and their result is reused until the next one. In addition to the
+ * strftime() conversions, the format may contain one %f (%1f to %9f) for the fraction of the second with
+ * as many digits (default: 3, i.e. milliseconds), e.g. "%Y-%m-%dT%H:%M:%S.%f%z".
+ *
+ * @ingroup base
+ */
+class TimestampFormatter
+{
+public:
+	explicit TimestampFormatter(const char *format);
+
+	TimestampFormatter(const TimestampFormatter&) = delete;
+	TimestampFormatter& operator=(const TimestampFormatter&) = delete;
+
+	String Format(double ts) const;
+
+private:
+	String m_Head;
+	String m_Tail;
+	unsigned int m_FractionDigits{0};
+	bool m_HasFraction{false};
+
+	mutable std::mutex m_Mutex;
+	mutable bool m_Cached{false};
+	mutable time_t m_CachedSecond{0};
+	mutable String m_CachedHead;
+	mutable String m_CachedTail;
+
+	static String FormatPart(const String& format, const tm& tmthen);
+};
+
+}
+
+#endif /* TIMESTAMPFORMATTER_H */
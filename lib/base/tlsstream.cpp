@@ -18,13 +18,28 @@
 
 using namespace icinga;
 
-bool UnbufferedAsioTlsStream::IsVerifyOK() const
+bool UnbufferedAsioTlsStream::IsVerifyOK()
 {
+	// The verify callback doesn't run for resumed sessions, they carry the result of their original verification.
+	if (SSL_session_reused(native_handle())) {
+		return SSL_get_verify_result(native_handle()) == X509_V_OK;
+	}
+
 	return m_VerifyOK;
 }
 
-String UnbufferedAsioTlsStream::GetVerifyError() const
+String UnbufferedAsioTlsStream::GetVerifyError()
 {
+	if (SSL_session_reused(native_handle())) {
+		auto err (SSL_get_verify_result(native_handle()));
+
+		if (err != X509_V_OK) {
+			std::ostringstream msgbuf;
+			msgbuf << "code " << err << ": " << X509_verify_cert_error_string(err);
+			return msgbuf.str();
+		}
+	}
+
 	return m_VerifyError;
 }
 
@@ -66,6 +81,14 @@ void UnbufferedAsioTlsStream::BeforeHandshake(handshake_type type)
 			serverName += ":" + environmentName;
 
 		SSL_set_tlsext_host_name(native_handle(), serverName.CStr());
+
+		if (SSL_CTX_get_session_cache_mode(SSL_get_SSL_CTX(native_handle())) & SSL_SESS_CACHE_CLIENT) {
+			auto session (GetTlsClientSession(serverName));
+
+			if (session) {
+				SSL_set_session(native_handle(), session.get());
+			}
+		}
 	}
 #endif /* SSL_CTRL_SET_TLSEXT_HOSTNAME */
 }
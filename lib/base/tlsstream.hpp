@@ -74,8 +74,8 @@ public:
 	{
 	}
 
-	bool IsVerifyOK() const;
-	String GetVerifyError() const;
+	bool IsVerifyOK();
+	String GetVerifyError();
 	std::shared_ptr<X509> GetPeerCertificate();
 
 	template<class... Args>
@@ -114,9 +114,15 @@ public:
 	}
 
 private:
+	/**
+	 * Large enough for a whole TLS record, so that a single SSL_read() fills the buffer
+	 * with all messages of a record instead of only the first KiB (the default).
+	 */
+	static constexpr std::size_t ReadBufferSize = 16 * 1024;
+
 	inline
 	AsioTlsStream(UnbufferedAsioTlsStreamParams init)
-		: buffered_stream(init)
+		: buffered_stream(init, ReadBufferSize, boost::asio::buffered_write_stream<UnbufferedAsioTlsStream>::default_buffer_size)
 	{
 	}
 };
@@ -14,6 +14,7 @@
 #include <openssl/ssl.h>
 #include <openssl/ssl3.h>
 #include <fstream>
+#include <unordered_map>
 
 namespace icinga
 {
@@ -21,6 +22,8 @@ namespace icinga
 static bool l_SSLInitialized = false;
 static std::mutex *l_Mutexes;
 static std::mutex l_RandomMutex;
+static std::mutex l_ClientSessionsMutex;
+static std::unordered_map<String, std::shared_ptr<SSL_SESSION>> l_ClientSessions;
 
 String GetOpenSSLVersion()
 {
@@ -349,6 +352,77 @@ void SetTlsProtocolminToSSLContext(const Shared<boost::asio::ssl::context>::Ptr&
 #endif /* OPENSSL_VERSION_NUMBER >= 0x10100000L */
 }
 
+/**
+ * Configures the resumption of TLS sessions (session IDs for TLS 1.2, PSKs for TLS 1.3) for both sides
+ * of connections made with the specified SSL context. As a client, the latest session per SNI name
+ * is kept and offered by the next handshake of UnbufferedAsioTlsStream with the same name.
+ * This forgets the client sessions of previously configured contexts.
+ *
+ * @param context The SSL context.
+ * @param enable Whether to resume sessions at all.
+ * @param tickets Whether the server may hand out stateless session tickets instead of caching the sessions itself.
+ * @param timeout For how many seconds a session may be resumed.
+ */
+void SetSessionResumptionToSSLContext(const Shared<boost::asio::ssl::context>::Ptr& context, bool enable, bool tickets, double timeout)
+{
+	SSL_CTX *sslContext = context->native_handle();
+
+	{
+		std::unique_lock<std::mutex> lock (l_ClientSessionsMutex);
+		l_ClientSessions.clear();
+	}
+
+	if (!enable) {
+		SSL_CTX_set_session_cache_mode(sslContext, SSL_SESS_CACHE_OFF);
+		SSL_CTX_set_options(sslContext, SSL_OP_NO_TICKET);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+		SSL_CTX_set_num_tickets(sslContext, 0);
+#endif /* OPENSSL_VERSION_NUMBER >= 0x10101000L */
+
+		return;
+	}
+
+	SSL_CTX_set_session_cache_mode(sslContext, SSL_SESS_CACHE_BOTH);
+	SSL_CTX_set_timeout(sslContext, timeout);
+
+	if (!tickets) {
+		// Without stateless tickets, TLS 1.3 PSKs are looked up in the server's session cache as well.
+		SSL_CTX_set_options(sslContext, SSL_OP_NO_TICKET);
+	}
+
+	SSL_CTX_sess_set_new_cb(sslContext, [](SSL *ssl, SSL_SESSION *session) -> int {
+		const char *serverName = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+
+		if (SSL_is_server(ssl) || !serverName) {
+			return 0;
+		}
+
+		std::unique_lock<std::mutex> lock (l_ClientSessionsMutex);
+		l_ClientSessions[serverName] = std::shared_ptr<SSL_SESSION>(session, SSL_SESSION_free);
+
+		// We've taken over OpenSSL's reference.
+		return 1;
+	});
+}
+
+/**
+ * Returns the latest session negotiated as a client with the specified SNI name (if any).
+ *
+ * @param serverName The SNI name.
+ */
+std::shared_ptr<SSL_SESSION> GetTlsClientSession(const String& serverName)
+{
+	std::unique_lock<std::mutex> lock (l_ClientSessionsMutex);
+	auto session (l_ClientSessions.find(serverName));
+
+	if (session == l_ClientSessions.end()) {
+		return nullptr;
+	}
+
+	return session->second;
+}
+
 /**
  * Loads a CRL and appends its certificates to the specified Boost SSL context.
  *
@@ -47,6 +47,8 @@ void AddCRLToSSLContext(const Shared<boost::asio::ssl::context>::Ptr& context, c
 void AddCRLToSSLContext(X509_STORE *x509_store, const String& crlPath);
 void SetCipherListToSSLContext(const Shared<boost::asio::ssl::context>::Ptr& context, const String& cipherList);
 void SetTlsProtocolminToSSLContext(const Shared<boost::asio::ssl::context>::Ptr& context, const String& tlsProtocolmin);
+void SetSessionResumptionToSSLContext(const Shared<boost::asio::ssl::context>::Ptr& context, bool enable, bool tickets, double timeout);
+std::shared_ptr<SSL_SESSION> GetTlsClientSession(const String& serverName);
 int ResolveTlsProtocolVersion(const std::string& version);
 
 Shared<boost::asio::ssl::context>::Ptr SetupSslContext(String certPath, String keyPath,
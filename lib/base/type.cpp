@@ -83,6 +83,55 @@ String Type::GetPluralName() const
 		return name + "s";
 }
 
+/**
+ * Returns the name of a field. Unlike GetFieldInfo(id).Name this is an interned
+ * String which lives as long as the process, so it can be copied and stored cheaply.
+ *
+ * @param id The field ID.
+ * @returns The field name.
+ */
+const String& Type::GetFieldName(int id) const
+{
+	std::call_once(m_FieldNamesOnce, [this]() {
+		int count = GetFieldCount();
+
+		m_FieldNames.reserve(count);
+
+		for (int i = 0; i < count; i++)
+			m_FieldNames.emplace_back(GetFieldInfo(i).Name);
+	});
+
+	return m_FieldNames.at(id);
+}
+
+/**
+ * Looks up a field ID in a table of all fields including the inherited ones,
+ * which is built on first use. That way a lookup costs one hash lookup instead
+ * of comparing the name against the fields of every base type.
+ *
+ * @param name The field name.
+ * @returns The field ID or -1 if there's no such field.
+ */
+int Type::LookupFieldId(const String& name) const
+{
+	std::call_once(m_FieldIdsOnce, [this]() {
+		int count = GetFieldCount();
+
+		m_FieldIds.reserve(count);
+
+		/* Fields of derived types shadow inherited fields with the same name. */
+		for (int i = 0; i < count; i++)
+			m_FieldIds[GetFieldInfo(i).Name] = i;
+	});
+
+	auto it (m_FieldIds.find(name.GetData()));
+
+	if (it == m_FieldIds.end())
+		return -1;
+
+	return it->second;
+}
+
 Object::Ptr Type::Instantiate(const std::vector<Value>& args) const
 {
 	ObjectFactory factory = GetFactory();
@@ -7,6 +7,9 @@
 #include "base/string.hpp"
 #include "base/object.hpp"
 #include "base/initialize.hpp"
+#include "base/internedstring.hpp"
+#include <mutex>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -38,7 +41,7 @@ struct Field
 	int Attributes;
 	int ArrayRank;
 
-	Field(int id, const char *type, const char *name, const char *navigationName, const char *reftype, int attributes, int arrayRank)
+	constexpr Field(int id, const char *type, const char *name, const char *navigationName, const char *reftype, int attributes, int arrayRank)
 		: ID(id), TypeName(type), Name(name), NavigationName(navigationName), RefTypeName(reftype), Attributes(attributes), ArrayRank(arrayRank)
 	{ }
 };
@@ -70,6 +73,8 @@ public:
 
 	String GetPluralName() const;
 
+	const String& GetFieldName(int id) const;
+
 	Object::Ptr Instantiate(const std::vector<Value>& args) const;
 
 	bool IsAssignableFrom(const Type::Ptr& other) const;
@@ -95,8 +100,16 @@ public:
 protected:
 	virtual ObjectFactory GetFactory() const = 0;
 
+	int LookupFieldId(const String& name) const;
+
 private:
 	Object::Ptr m_Prototype;
+
+	mutable std::once_flag m_FieldNamesOnce;
+	mutable std::vector<InternedString> m_FieldNames;
+
+	mutable std::once_flag m_FieldIdsOnce;
+	mutable std::unordered_map<std::string, int> m_FieldIds;
 };
 
 class TypeType final : public Type
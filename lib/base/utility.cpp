@@ -1493,7 +1493,12 @@ String Utility::EscapeString(const String& s, const String& chars, const bool il
 
 String Utility::UnescapeString(const String& s)
 {
-	std::ostringstream result;
+	/* Most URL parts don't contain any escape sequences. */
+	if (s.Find("%") == String::NPos)
+		return s;
+
+	std::string result;
+	result.reserve(s.GetLength());
 
 	for (String::SizeType i = 0; i < s.GetLength(); i++) {
 		if (s[i] == '%') {
@@ -1501,14 +1506,14 @@ String Utility::UnescapeString(const String& s)
 				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid escape sequence."));
 
 			char ch = HexDecode(s[i + 1]) * 16 + HexDecode(s[i + 2]);
-			result << ch;
+			result += ch;
 
 			i += 2;
 		} else
-			result << s[i];
+			result += s[i];
 	}
 
-	return result.str();
+	return std::move(result);
 }
 
 #ifndef _WIN32
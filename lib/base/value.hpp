@@ -5,9 +5,10 @@
 
 #include "base/object.hpp"
 #include "base/string.hpp"
-#include <boost/variant/variant.hpp>
-#include <boost/variant/get.hpp>
 #include <boost/throw_exception.hpp>
+#include <atomic>
+#include <new>
+#include <typeinfo>
 
 namespace icinga
 {
@@ -31,12 +32,19 @@ enum ValueType
 /**
  * A type that can hold an arbitrary value.
  *
+ * Values are 16 bytes large on 64-bit platforms: the payload is either stored inline
+ * (numbers, booleans and object pointers) or, for strings, points to an immutable
+ * reference-counted String shared by all copies. So copying a string Value doesn't copy the string.
+ *
  * @ingroup base
  */
 class Value
 {
 public:
-	Value() = default;
+	Value() noexcept
+		: m_Number(0), m_Type(ValueEmpty)
+	{ }
+
 	Value(std::nullptr_t);
 	Value(int value);
 	Value(unsigned int value);
@@ -61,6 +69,11 @@ public:
 		static_assert(!std::is_same<T, Object>::value, "T must not be Object");
 	}
 
+	~Value()
+	{
+		Release();
+	}
+
 	bool ToBool() const;
 
 	operator double() const;
@@ -96,7 +109,7 @@ public:
 		if (!IsObject())
 			BOOST_THROW_EXCEPTION(std::runtime_error("Cannot convert value of type '" + GetTypeName() + "' to an object."));
 
-		const auto& object = Get<Object::Ptr>();
+		const auto& object = m_Object;
 
 		ASSERT(object);
 
@@ -110,10 +123,46 @@ public:
 
 	bool IsEmpty() const;
 	bool IsScalar() const;
-	bool IsNumber() const;
-	bool IsBoolean() const;
-	bool IsString() const;
-	bool IsObject() const;
+
+	/**
+	 * Checks whether the variant is a number.
+	 *
+	 * @returns true if the variant is a number.
+	 */
+	bool IsNumber() const
+	{
+		return m_Type == ValueNumber;
+	}
+
+	/**
+	 * Checks whether the variant is a boolean.
+	 *
+	 * @returns true if the variant is a boolean.
+	 */
+	bool IsBoolean() const
+	{
+		return m_Type == ValueBoolean;
+	}
+
+	/**
+	 * Checks whether the variant is a string.
+	 *
+	 * @returns true if the variant is a string.
+	 */
+	bool IsString() const
+	{
+		return m_Type == ValueString;
+	}
+
+	/**
+	 * Checks whether the variant is a non-null object.
+	 *
+	 * @returns true if the variant is a non-null object, false otherwise.
+	 */
+	bool IsObject() const
+	{
+		return m_Type == ValueObject;
+	}
 
 	template<typename T>
 	bool IsObjectType() const
@@ -121,12 +170,20 @@ public:
 		if (!IsObject())
 			return false;
 
-		return dynamic_cast<T *>(Get<Object::Ptr>().get());
+		return dynamic_cast<T *>(m_Object.get());
 	}
 
-	ValueType GetType() const;
+	/**
+	 * Returns the type of the value.
+	 *
+	 * @returns The type.
+	 */
+	ValueType GetType() const
+	{
+		return m_Type;
+	}
 
-	void Swap(Value& other);
+	void Swap(Value& other) noexcept;
 
 	String GetTypeName() const;
 
@@ -134,20 +191,143 @@ public:
 
 	Value Clone() const;
 
+	/**
+	 * Returns the payload of a double, bool, String or Object::Ptr value.
+	 * Throws std::bad_cast if the value is of another type.
+	 */
 	template<typename T>
-	const T& Get() const
+	const T& Get() const;
+
+private:
+	/**
+	 * The payload of a string value, freed by the last Value referring to it.
+	 */
+	struct SharedString
+	{
+		SharedString(const String& data)
+			: Data(data)
+		{ }
+
+		SharedString(String&& data)
+			: Data(std::move(data))
+		{ }
+
+		String Data;
+		std::atomic<uint_fast32_t> References{1};
+	};
+
+	typedef Object::Ptr ObjectPtr;
+
+	union {
+		double m_Number;
+		bool m_Boolean;
+		SharedString *m_String;
+		ObjectPtr m_Object;
+	};
+
+	ValueType m_Type;
+
+	void CheckType(ValueType type) const
 	{
-		return boost::get<T>(m_Value);
+		if (m_Type != type)
+			BOOST_THROW_EXCEPTION(std::bad_cast());
 	}
 
-private:
-	boost::variant<boost::blank, double, bool, String, Object::Ptr> m_Value;
+	void CopyFrom(const Value& other) noexcept
+	{
+		switch (other.m_Type) {
+			case ValueNumber:
+				m_Number = other.m_Number;
+				break;
+			case ValueBoolean:
+				m_Boolean = other.m_Boolean;
+				break;
+			case ValueString:
+				m_String = other.m_String;
+				m_String->References.fetch_add(1, std::memory_order_relaxed);
+				break;
+			case ValueObject:
+				new (&m_Object) ObjectPtr(other.m_Object);
+				break;
+			default:
+				m_Number = 0;
+		}
+
+		m_Type = other.m_Type;
+	}
+
+	void MoveFrom(Value& other) noexcept
+	{
+		switch (other.m_Type) {
+			case ValueNumber:
+				m_Number = other.m_Number;
+				break;
+			case ValueBoolean:
+				m_Boolean = other.m_Boolean;
+				break;
+			case ValueString:
+				m_String = other.m_String;
+				break;
+			case ValueObject:
+				new (&m_Object) ObjectPtr(std::move(other.m_Object));
+				other.m_Object.~ObjectPtr();
+				break;
+			default:
+				m_Number = 0;
+		}
+
+		m_Type = other.m_Type;
+
+		other.m_Number = 0;
+		other.m_Type = ValueEmpty;
+	}
+
+	void Release() noexcept
+	{
+		switch (m_Type) {
+			case ValueString:
+				if (m_String->References.fetch_sub(1, std::memory_order_acq_rel) == 1u)
+					delete m_String;
+				break;
+			case ValueObject:
+				m_Object.~ObjectPtr();
+				break;
+			default:
+				break;
+		}
+
+		m_Number = 0;
+		m_Type = ValueEmpty;
+	}
 };
 
-extern template const double& Value::Get<double>() const;
-extern template const bool& Value::Get<bool>() const;
-extern template const String& Value::Get<String>() const;
-extern template const Object::Ptr& Value::Get<Object::Ptr>() const;
+template<>
+inline const double& Value::Get<double>() const
+{
+	CheckType(ValueNumber);
+	return m_Number;
+}
+
+template<>
+inline const bool& Value::Get<bool>() const
+{
+	CheckType(ValueBoolean);
+	return m_Boolean;
+}
+
+template<>
+inline const String& Value::Get<String>() const
+{
+	CheckType(ValueString);
+	return m_String->Data;
+}
+
+template<>
+inline const Object::Ptr& Value::Get<Object::Ptr>() const
+{
+	CheckType(ValueObject);
+	return m_Object;
+}
 
 extern Value Empty;
 
@@ -246,6 +426,4 @@ std::istream& operator>>(std::istream& stream, Value& value);
 
 }
 
-extern template class boost::variant<boost::blank, double, bool, icinga::String, icinga::Object::Ptr>;
-
 #endif /* VALUE_H */
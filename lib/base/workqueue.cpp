@@ -6,8 +6,11 @@
 #include "base/convert.hpp"
 #include "base/application.hpp"
 #include "base/exception.hpp"
+#include "base/profiler.hpp"
 #include <boost/thread/tss.hpp>
 #include <math.h>
+#include <thread>
+#include <vector>
 
 using namespace icinga;
 
@@ -16,7 +19,7 @@ boost::thread_specific_ptr<WorkQueue *> l_ThreadWorkQueue;
 
 WorkQueue::WorkQueue(size_t maxItems, int threadCount, LogSeverity statsLogLevel)
 	: m_ID(m_NextID++), m_ThreadCount(threadCount), m_MaxItems(maxItems),
-	m_TaskStats(15 * 60), m_StatsLogLevel(statsLogLevel)
+	m_LockFree(threadCount == 1), m_TaskStats(15 * 60), m_StatsLogLevel(statsLogLevel)
 {
 	/* Initialize logger. */
 	m_StatusTimerTimeout = Utility::GetTime();
@@ -49,23 +52,43 @@ std::unique_lock<std::mutex> WorkQueue::AcquireLock()
 	return std::unique_lock<std::mutex>(m_Mutex);
 }
 
+/**
+ * Spawns the worker threads unless that's already been done. m_Mutex must be locked.
+ */
+void WorkQueue::SpawnThreadsUnlocked()
+{
+	if (m_Spawned)
+		return;
+
+	Log(LogNotice, "WorkQueue")
+		<< "Spawning WorkQueue threads for '" << m_Name << "'";
+
+	for (int i = 0; i < m_ThreadCount; i++) {
+		if (m_LockFree)
+			m_Threads.create_thread([this]() { LockFreeWorkerThreadProc(); });
+		else
+			m_Threads.create_thread([this]() { WorkerThreadProc(); });
+	}
+
+	m_Spawned = true;
+}
+
 /**
  * Enqueues a task. Tasks are guaranteed to be executed in the order
  * they were enqueued in except if there is more than one worker thread.
  */
 void WorkQueue::EnqueueUnlocked(std::unique_lock<std::mutex>& lock, std::function<void ()>&& function, WorkQueuePriority priority)
 {
-	if (!m_Spawned) {
-		Log(LogNotice, "WorkQueue")
-			<< "Spawning WorkQueue threads for '" << m_Name << "'";
-
-		for (int i = 0; i < m_ThreadCount; i++) {
-			m_Threads.create_thread([this]() { WorkerThreadProc(); });
-		}
+	if (Profiler::IsEnabled())
+		ProfileTask(function);
 
-		m_Spawned = true;
+	if (m_LockFree) {
+		EnqueueLockFree(&lock, std::move(function), priority);
+		return;
 	}
 
+	SpawnThreadsUnlocked();
+
 	bool wq_thread = IsWorkerThread();
 
 	if (!wq_thread) {
@@ -95,10 +118,87 @@ void WorkQueue::Enqueue(std::function<void ()>&& function, WorkQueuePriority pri
 		return;
 	}
 
+	if (m_LockFree) {
+		if (Profiler::IsEnabled())
+			ProfileTask(function);
+
+		EnqueueLockFree(nullptr, std::move(function), priority);
+		return;
+	}
+
 	auto lock = AcquireLock();
 	EnqueueUnlocked(lock, std::move(function), priority);
 }
 
+/**
+ * Makes the task report its wait time to the Profiler once it's started.
+ */
+void WorkQueue::ProfileTask(TaskFunction& function)
+{
+	function = [this, inner = std::move(function), queued = Utility::GetTime()]() {
+		Profiler::RecordWorkQueueWait(m_Name.IsEmpty() ? "WorkQueue #" + Convert::ToString(m_ID) : m_Name, Utility::GetTime() - queued);
+
+		inner();
+	};
+}
+
+static inline int GetLockFreeQueueIndex(WorkQueuePriority priority)
+{
+	switch (priority) {
+		case PriorityLow:
+			return 0;
+		case PriorityNormal:
+			return 1;
+		case PriorityHigh:
+			return 2;
+		default:
+			return 3;
+	}
+}
+
+/**
+ * Enqueues a task into the lock-free queue for the specified priority.
+ *
+ * @param lock The already acquired lock for m_Mutex, if any. m_Mutex is only locked
+ *             if the queue is full or the worker thread has to be woken up.
+ */
+void WorkQueue::EnqueueLockFree(std::unique_lock<std::mutex> *lock, TaskFunction&& function, WorkQueuePriority priority)
+{
+	std::unique_lock<std::mutex> ownLock;
+
+	auto ensureLock ([this, &lock, &ownLock]() {
+		if (!lock) {
+			ownLock = std::unique_lock<std::mutex>(m_Mutex);
+			lock = &ownLock;
+		}
+	});
+
+	if (!m_Spawned.load()) {
+		ensureLock();
+		SpawnThreadsUnlocked();
+	}
+
+	if (m_MaxItems != 0 && m_LockFreeLength.load() >= m_MaxItems && !IsWorkerThread()) {
+		ensureLock();
+
+		m_LockFreeFullWaiters.fetch_add(1);
+
+		while (m_LockFreeLength.load() >= m_MaxItems)
+			m_CVFull.wait(*lock);
+
+		m_LockFreeFullWaiters.fetch_sub(1);
+	}
+
+	/* Count the task before it becomes visible, so the worker never takes uncounted tasks. */
+	m_LockFreeLength.fetch_add(1);
+	m_LockFreeTasks[GetLockFreeQueueIndex(priority)].Push(std::move(function));
+
+	if (m_LockFreeIdle.load()) {
+		ensureLock();
+		m_CVEmpty.notify_one();
+	}
+}
+
 /**
  * Waits until all currently enqueued tasks have completed. This only works reliably
  * when no other thread is enqueuing new tasks when this method is called.
@@ -109,7 +209,7 @@ void WorkQueue::Join(bool stop)
 {
 	std::unique_lock<std::mutex> lock(m_Mutex);
 
-	while (m_Processing || !m_Tasks.empty())
+	while (m_Processing || !m_Tasks.empty() || m_LockFreeLength.load())
 		m_CVStarved.wait(lock);
 
 	if (stop) {
@@ -184,6 +284,9 @@ void WorkQueue::ReportExceptions(const String& facility, bool verbose) const
 
 size_t WorkQueue::GetLength() const
 {
+	if (m_LockFree)
+		return m_LockFreeLength.load();
+
 	std::unique_lock<std::mutex> lock(m_Mutex);
 
 	return m_Tasks.size();
@@ -195,7 +298,7 @@ void WorkQueue::StatusTimerHandler()
 
 	ASSERT(!m_Name.IsEmpty());
 
-	size_t pending = m_Tasks.size();
+	size_t pending = m_LockFree ? m_LockFreeLength.load() : m_Tasks.size();
 
 	double now = Utility::GetTime();
 	double gradient = (pending - m_PendingTasks) / (now - m_PendingTasksTimestamp);
@@ -292,6 +395,83 @@ void WorkQueue::WorkerThreadProc()
 	}
 }
 
+void WorkQueue::LockFreeWorkerThreadProc()
+{
+	/* Upper limit for the number of tasks which are taken from the queues at once. */
+	const size_t batchSize = 64;
+
+	std::ostringstream idbuf;
+	idbuf << "WQ #" << m_ID;
+	Utility::SetThreadName(idbuf.str());
+
+	l_ThreadWorkQueue.reset(new WorkQueue *(this));
+
+	std::vector<TaskFunction> batch;
+	batch.reserve(batchSize);
+
+	for (;;) {
+		TaskFunction function;
+
+		/* Higher priorities first. */
+		for (int i = 3; i >= 0; i--) {
+			while (batch.size() < batchSize && m_LockFreeTasks[i].Pop(function))
+				batch.emplace_back(std::move(function));
+		}
+
+		if (batch.empty()) {
+			std::unique_lock<std::mutex> lock(m_Mutex);
+
+			if (m_Stopped)
+				break;
+
+			if (m_LockFreeLength.load()) {
+				/* A producer is still linking its task into the queue. */
+				lock.unlock();
+				std::this_thread::yield();
+				continue;
+			}
+
+			m_LockFreeIdle.store(true);
+
+			while (!m_LockFreeLength.load() && !m_Stopped)
+				m_CVEmpty.wait(lock);
+
+			m_LockFreeIdle.store(false);
+
+			if (m_Stopped)
+				break;
+
+			continue;
+		}
+
+		/* Account for the tasks as being processed before they vanish from the length, Join() relies on that. */
+		m_Processing.fetch_add(batch.size());
+		m_LockFreeLength.fetch_sub(batch.size());
+
+		if (m_LockFreeFullWaiters.load()) {
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_CVFull.notify_all();
+		}
+
+		for (auto& task : batch) {
+			RunTaskFunction(task);
+
+			/* clear the task so whatever other resources it holds are released as soon as possible */
+			task = nullptr;
+		}
+
+		m_TaskStats.InsertValue(Utility::GetTime(), batch.size());
+		m_Processing.fetch_sub(batch.size());
+
+		batch.clear();
+
+		if (!m_LockFreeLength.load()) {
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_CVStarved.notify_all();
+		}
+	}
+}
+
 void WorkQueue::IncreaseTaskCount()
 {
 	m_TaskStats.InsertValue(Utility::GetTime(), 1);
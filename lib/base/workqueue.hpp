@@ -7,6 +7,7 @@
 #include "base/timer.hpp"
 #include "base/ringbuffer.hpp"
 #include "base/logger.hpp"
+#include "base/mpscqueue.hpp"
 #include <boost/thread/thread.hpp>
 #include <boost/exception_ptr.hpp>
 #include <condition_variable>
@@ -46,6 +47,10 @@ bool operator<(const Task& a, const Task& b);
 /**
  * A workqueue.
  *
+ * Work queues with a single worker thread use lock-free queues (one per priority)
+ * which are drained in batches; enqueueing a task doesn't take the mutex then
+ * unless the queue is full or the worker thread is idle.
+ *
  * @ingroup base
  */
 class WorkQueue
@@ -124,7 +129,7 @@ private:
 	String m_Name;
 	static std::atomic<int> m_NextID;
 	int m_ThreadCount;
-	bool m_Spawned{false};
+	std::atomic<bool> m_Spawned{false};
 
 	mutable std::mutex m_Mutex;
 	std::condition_variable m_CVEmpty;
@@ -133,8 +138,14 @@ private:
 	boost::thread_group m_Threads;
 	size_t m_MaxItems;
 	bool m_Stopped{false};
-	int m_Processing{0};
+	std::atomic<int> m_Processing{0};
 	std::priority_queue<Task, std::deque<Task> > m_Tasks;
+
+	bool m_LockFree;
+	MpscQueue<TaskFunction> m_LockFreeTasks[4];
+	std::atomic<size_t> m_LockFreeLength{0};
+	std::atomic<bool> m_LockFreeIdle{false};
+	std::atomic<int> m_LockFreeFullWaiters{0};
 	int m_NextTaskID{0};
 	ExceptionCallback m_ExceptionCallback;
 	std::vector<boost::exception_ptr> m_Exceptions;
@@ -142,11 +153,16 @@ private:
 	double m_StatusTimerTimeout;
 	LogSeverity m_StatsLogLevel;
 
-	RingBuffer m_TaskStats;
+	ShardedRingBuffer m_TaskStats;
 	size_t m_PendingTasks{0};
 	double m_PendingTasksTimestamp{0};
 
+	void SpawnThreadsUnlocked();
+	void EnqueueLockFree(std::unique_lock<std::mutex> *lock, TaskFunction&& function, WorkQueuePriority priority);
+	void ProfileTask(TaskFunction& function);
+
 	void WorkerThreadProc();
+	void LockFreeWorkerThreadProc();
 	void StatusTimerHandler();
 
 	void RunTaskFunction(const TaskFunction& func);
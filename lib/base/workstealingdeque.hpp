@@ -0,0 +1,161 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef WORKSTEALINGDEQUE_H
+#define WORKSTEALINGDEQUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A lock-free Chase-Lev work-stealing deque of pointers.
+ *
+ * Only the owning thread may call Push() and Pop() which operate on the bottom end (LIFO),
+ * any other thread may call Steal() which takes items from the top end (FIFO).
+ *
+ * @ingroup base
+ */
+template<typename T>
+class WorkStealingDeque
+{
+public:
+	WorkStealingDeque(int64_t capacity = 1024)
+		: m_Top(0), m_Bottom(0)
+	{
+		m_Buffers.emplace_back(new Buffer(capacity));
+		m_Buffer.store(m_Buffers.back().get(), std::memory_order_relaxed);
+	}
+
+	WorkStealingDeque(const WorkStealingDeque&) = delete;
+	WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+	/**
+	 * Adds an item to the bottom of the deque. May only be called by the owner.
+	 *
+	 * @param item The item.
+	 */
+	void Push(T *item)
+	{
+		int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+		int64_t top = m_Top.load(std::memory_order_acquire);
+		Buffer *buffer = m_Buffer.load(std::memory_order_relaxed);
+
+		if (bottom - top > buffer->Capacity - 1) {
+			/* Thieves may still read from the old buffer, so it's retired only on destruction. */
+			m_Buffers.emplace_back(buffer->Grow(bottom, top));
+			buffer = m_Buffers.back().get();
+			m_Buffer.store(buffer, std::memory_order_release);
+		}
+
+		buffer->Put(bottom, item);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Takes the most recently pushed item from the bottom of the deque. May only be called by the owner.
+	 *
+	 * @returns The item or nullptr if the deque is empty.
+	 */
+	T *Pop()
+	{
+		int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+		Buffer *buffer = m_Buffer.load(std::memory_order_relaxed);
+
+		m_Bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		int64_t top = m_Top.load(std::memory_order_relaxed);
+
+		if (top > bottom) {
+			m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		T *item = buffer->Get(bottom);
+
+		if (top == bottom) {
+			/* Last item, race against thieves. */
+			if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				item = nullptr;
+
+			m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+
+		return item;
+	}
+
+	/**
+	 * Takes the oldest item from the top of the deque. May be called by any thread.
+	 *
+	 * @returns The item or nullptr if the deque is empty or another thread won the race for it.
+	 */
+	T *Steal()
+	{
+		int64_t top = m_Top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+
+		if (top >= bottom)
+			return nullptr;
+
+		T *item = m_Buffer.load(std::memory_order_acquire)->Get(top);
+
+		if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+
+		return item;
+	}
+
+	/**
+	 * Returns whether the deque looks empty. The result may be outdated immediately.
+	 */
+	bool IsEmpty() const
+	{
+		return m_Bottom.load(std::memory_order_relaxed) <= m_Top.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Buffer
+	{
+		int64_t Capacity;
+		std::unique_ptr<std::atomic<T *>[]> Items;
+
+		Buffer(int64_t capacity)
+			: Capacity(capacity), Items(new std::atomic<T *>[capacity])
+		{ }
+
+		T *Get(int64_t index) const
+		{
+			return Items[index & (Capacity - 1)].load(std::memory_order_relaxed);
+		}
+
+		void Put(int64_t index, T *item)
+		{
+			Items[index & (Capacity - 1)].store(item, std::memory_order_relaxed);
+		}
+
+		Buffer *Grow(int64_t bottom, int64_t top) const
+		{
+			auto buffer (new Buffer(Capacity * 2));
+
+			for (int64_t i = top; i < bottom; i++)
+				buffer->Put(i, Get(i));
+
+			return buffer;
+		}
+	};
+
+	std::atomic<int64_t> m_Top;
+	std::atomic<int64_t> m_Bottom;
+	std::atomic<Buffer *> m_Buffer;
+	std::vector<std::unique_ptr<Buffer>> m_Buffers;
+};
+
+}
+
+#endif /* WORKSTEALINGDEQUE_H */
@@ -14,7 +14,10 @@
 #include "base/exception.hpp"
 #include "base/convert.hpp"
 #include "base/statsfunction.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
+#include <thread>
 
 using namespace icinga;
 
@@ -30,14 +33,24 @@ void CheckerComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr
 		unsigned long idle = checker->GetIdleCheckables();
 		unsigned long pending = checker->GetPendingCheckables();
 
+		int concurrencyLimit = checker->GetConcurrencyLimit();
+		unsigned long increases = checker->m_Concurrency.Increases.load();
+		unsigned long decreases = checker->m_Concurrency.Decreases.load();
+
 		nodes.emplace_back(checker->GetName(), new Dictionary({
 			{ "idle", idle },
-			{ "pending", pending }
+			{ "pending", pending },
+			{ "concurrency_limit", concurrencyLimit },
+			{ "concurrency_increases", increases },
+			{ "concurrency_decreases", decreases }
 		}));
 
 		String perfdata_prefix = "checkercomponent_" + checker->GetName() + "_";
 		perfdata->Add(new PerfdataValue(perfdata_prefix + "idle", Convert::ToDouble(idle)));
 		perfdata->Add(new PerfdataValue(perfdata_prefix + "pending", Convert::ToDouble(pending)));
+		perfdata->Add(new PerfdataValue(perfdata_prefix + "concurrency_limit", concurrencyLimit));
+		perfdata->Add(new PerfdataValue(perfdata_prefix + "concurrency_increases", Convert::ToDouble(increases), true));
+		perfdata->Add(new PerfdataValue(perfdata_prefix + "concurrency_decreases", Convert::ToDouble(decreases), true));
 	}
 
 	status->Set("checkercomponent", new Dictionary(std::move(nodes)));
@@ -45,6 +58,15 @@ void CheckerComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr
 
 void CheckerComponent::OnConfigLoaded()
 {
+	int shards = GetSchedulerShards();
+
+	for (int i = 0; i < shards; i++)
+		m_Shards.emplace_back(new Shard());
+
+	/* Before the checkables are activated, so that their first checks are spread as well. */
+	if (GetSpreadChecks())
+		Checkable::SetSpreadChecks(true);
+
 	ConfigObject::OnActiveChanged.connect([this](const ConfigObject::Ptr& object, const Value&) {
 		ObjectHandler(object);
 	});
@@ -55,6 +77,12 @@ void CheckerComponent::OnConfigLoaded()
 	Checkable::OnNextCheckChanged.connect([this](const Checkable::Ptr& checkable, const Value&) {
 		NextCheckChangedHandler(checkable);
 	});
+
+	if (GetAdaptiveConcurrency()) {
+		Checkable::OnNewCheckResult.connect(GetReflectionType()->GetName().GetData(), [this](const Checkable::Ptr&, const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
+			CheckResultHandler(cr);
+		});
+	}
 }
 
 void CheckerComponent::Start(bool runtimeCreated)
@@ -65,24 +93,44 @@ void CheckerComponent::Start(bool runtimeCreated)
 		<< "'" << GetName() << "' started.";
 
 
-	m_Thread = std::thread([this]() { CheckThreadProc(); });
+	for (size_t i = 0; i < m_Shards.size(); i++) {
+		Shard& shard = *m_Shards[i];
+		shard.Thread = std::thread([this, &shard, i]() { CheckThreadProc(shard, i); });
+	}
 
 	m_ResultTimer = Timer::Create();
 	m_ResultTimer->SetInterval(5);
 	m_ResultTimer->OnTimerExpired.connect([this](const Timer * const&) { ResultTimerHandler(); });
 	m_ResultTimer->Start();
+
+	if (GetAdaptiveConcurrency()) {
+		int limit = IcingaApplication::GetInstance()->GetMaxConcurrentChecks();
+
+		m_Concurrency.Limit.store(std::min(std::max(limit, GetAdaptiveConcurrencyMin()), GetAdaptiveConcurrencyMax()));
+
+		m_Concurrency.Timer = Timer::Create();
+		m_Concurrency.Timer->SetInterval(10);
+		m_Concurrency.Timer->OnTimerExpired.connect([this](const Timer * const&) { AdjustConcurrency(); });
+		m_Concurrency.Timer->Start();
+	}
 }
 
 void CheckerComponent::Stop(bool runtimeRemoved)
 {
-	{
-		std::unique_lock<std::mutex> lock(m_Mutex);
-		m_Stopped = true;
-		m_CV.notify_all();
+	for (auto& shard : m_Shards) {
+		std::unique_lock<std::mutex> lock(shard->Mutex);
+		shard->Stopped = true;
+		shard->CV.notify_all();
 	}
 
 	m_ResultTimer->Stop(true);
-	m_Thread.join();
+
+	if (m_Concurrency.Timer) {
+		m_Concurrency.Timer->Stop(true);
+	}
+
+	for (auto& shard : m_Shards)
+		shard->Thread.join();
 
 	Log(LogInformation, "CheckerComponent")
 		<< "'" << GetName() << "' stopped.";
@@ -90,21 +138,25 @@ void CheckerComponent::Stop(bool runtimeRemoved)
 	ObjectImpl<CheckerComponent>::Stop(runtimeRemoved);
 }
 
-void CheckerComponent::CheckThreadProc()
+void CheckerComponent::CheckThreadProc(Shard& shard, size_t index)
 {
-	Utility::SetThreadName("Check Scheduler");
+	if (m_Shards.size() > 1)
+		Utility::SetThreadName("Check Sched " + Convert::ToString(index));
+	else
+		Utility::SetThreadName("Check Scheduler");
+
 	IcingaApplication::Ptr icingaApp = IcingaApplication::GetInstance();
 
-	std::unique_lock<std::mutex> lock(m_Mutex);
+	std::unique_lock<std::mutex> lock(shard.Mutex);
 
 	for (;;) {
 		typedef boost::multi_index::nth_index<CheckableSet, 1>::type CheckTimeView;
-		CheckTimeView& idx = boost::get<1>(m_IdleCheckables);
+		CheckTimeView& idx = boost::get<1>(shard.IdleCheckables);
 
-		while (idx.begin() == idx.end() && !m_Stopped)
-			m_CV.wait(lock);
+		while (idx.begin() == idx.end() && !shard.Stopped)
+			shard.CV.wait(lock);
 
-		if (m_Stopped)
+		if (shard.Stopped)
 			break;
 
 		auto it = idx.begin();
@@ -118,19 +170,23 @@ void CheckerComponent::CheckThreadProc()
 //			<< " vs. max concurrent checks " << icingaApp->GetMaxConcurrentChecks() << ".";
 //#endif /* I2_DEBUG */
 
-		if (Checkable::GetPendingChecks() >= icingaApp->GetMaxConcurrentChecks())
+		if (Checkable::GetPendingChecks() >= GetConcurrencyLimit()) {
+			if (wait <= 0)
+				m_Concurrency.Saturated.store(true);
+
 			wait = 0.5;
+		}
 
 		if (wait > 0) {
 			/* Wait for the next check. */
-			m_CV.wait_for(lock, std::chrono::duration<double>(wait));
+			shard.CV.wait_for(lock, std::chrono::duration<double>(wait));
 
 			continue;
 		}
 
 		Checkable::Ptr checkable = csi.Object;
 
-		m_IdleCheckables.erase(checkable);
+		shard.IdleCheckables.erase(checkable);
 
 		bool forced = checkable->GetForceNextCheck();
 		bool check = true;
@@ -174,7 +230,7 @@ void CheckerComponent::CheckThreadProc()
 
 		/* reschedule the checkable if checks are disabled */
 		if (!check) {
-			m_IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
+			shard.IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
 			lock.unlock();
 
 			Log(LogDebug, "CheckerComponent")
@@ -201,7 +257,7 @@ void CheckerComponent::CheckThreadProc()
 			<< csi.Object->GetName() << "', Next Check: "
 			<< Utility::FormatDateTime("%Y-%m-%d %H:%M:%S %z", csi.NextCheck) << "(" << csi.NextCheck << ").";
 
-		m_PendingCheckables.insert(csi);
+		shard.PendingCheckables.insert(csi);
 
 		lock.unlock();
 
@@ -213,6 +269,12 @@ void CheckerComponent::CheckThreadProc()
 		Log(LogDebug, "CheckerComponent")
 			<< "Executing check for '" << checkable->GetName() << "'";
 
+		++m_Concurrency.Started;
+
+		/* The scheduler itself may be a bit late, so only count what's noticeable. */
+		if (Utility::GetTime() - csi.NextCheck > 1)
+			++m_Concurrency.Late;
+
 		Checkable::IncreasePendingChecks();
 
 		/*
@@ -221,13 +283,13 @@ void CheckerComponent::CheckThreadProc()
 		 */
 		CheckerComponent::Ptr checkComponent(this);
 
-		Utility::QueueAsyncCallback([this, checkComponent, checkable]() { ExecuteCheckHelper(checkable); });
+		Utility::QueueAsyncCallback([this, checkComponent, &shard, checkable]() { ExecuteCheckHelper(shard, checkable); });
 
 		lock.lock();
 	}
 }
 
-void CheckerComponent::ExecuteCheckHelper(const Checkable::Ptr& checkable)
+void CheckerComponent::ExecuteCheckHelper(Shard& shard, const Checkable::Ptr& checkable)
 {
 	try {
 		checkable->ExecuteCheck();
@@ -252,20 +314,20 @@ void CheckerComponent::ExecuteCheckHelper(const Checkable::Ptr& checkable)
 	Checkable::DecreasePendingChecks();
 
 	{
-		std::unique_lock<std::mutex> lock(m_Mutex);
+		std::unique_lock<std::mutex> lock(shard.Mutex);
 
 		/* remove the object from the list of pending objects; if it's not in the
 		 * list this was a manual (i.e. forced) check and we must not re-add the
 		 * object to the list because it's already there. */
-		auto it = m_PendingCheckables.find(checkable);
+		auto it = shard.PendingCheckables.find(checkable);
 
-		if (it != m_PendingCheckables.end()) {
-			m_PendingCheckables.erase(it);
+		if (it != shard.PendingCheckables.end()) {
+			shard.PendingCheckables.erase(it);
 
 			if (checkable->IsActive())
-				m_IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
+				shard.IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
 
-			m_CV.notify_all();
+			shard.CV.notify_all();
 		}
 	}
 
@@ -277,14 +339,90 @@ void CheckerComponent::ResultTimerHandler()
 {
 	std::ostringstream msgbuf;
 
+	msgbuf << "Pending checkables: " << GetPendingCheckables() << "; Idle checkables: " << GetIdleCheckables() << "; Checks/s: "
+		<< (CIB::GetActiveHostChecksStatistics(60) + CIB::GetActiveServiceChecksStatistics(60)) / 60.0;
+
+	Log(LogNotice, "CheckerComponent", msgbuf.str());
+}
+
+/**
+ * @return How many checks may run concurrently
+ */
+int CheckerComponent::GetConcurrencyLimit()
+{
+	if (GetAdaptiveConcurrency())
+		return m_Concurrency.Limit.load();
+
+	return IcingaApplication::GetInstance()->GetMaxConcurrentChecks();
+}
+
+void CheckerComponent::CheckResultHandler(const CheckResult::Ptr& cr)
+{
+	if (!cr->GetActive())
+		return;
+
+	/* Time spent between scheduling and starting the plugin and between its exit and processing the result,
+	 * i.e. including the spawn time. Grows if the system can't keep up. */
+	double latency = cr->CalculateLatency();
+
+	std::unique_lock<std::mutex> lock(m_Concurrency.Mutex);
+	m_Concurrency.LatencySum += latency;
+	++m_Concurrency.Results;
+}
+
+/**
+ * Adapts the concurrency limit like TCP congestion control (AIMD): If the system is overloaded, i.e.
+ * the load per CPU or the check latency is too high, multiplicatively decrease it. Otherwise, if checks
+ * are noticeably late because they had to wait for a free slot, additively increase it.
+ */
+void CheckerComponent::AdjustConcurrency()
+{
+	uint_fast64_t started = m_Concurrency.Started.exchange(0);
+	uint_fast64_t late = m_Concurrency.Late.exchange(0);
+	bool saturated = m_Concurrency.Saturated.exchange(false);
+	double latency = 0;
+
 	{
-		std::unique_lock<std::mutex> lock(m_Mutex);
+		std::unique_lock<std::mutex> lock(m_Concurrency.Mutex);
+
+		if (m_Concurrency.Results)
+			latency = m_Concurrency.LatencySum / m_Concurrency.Results;
 
-		msgbuf << "Pending checkables: " << m_PendingCheckables.size() << "; Idle checkables: " << m_IdleCheckables.size() << "; Checks/s: "
-			<< (CIB::GetActiveHostChecksStatistics(60) + CIB::GetActiveServiceChecksStatistics(60)) / 60.0;
+		m_Concurrency.LatencySum = 0;
+		m_Concurrency.Results = 0;
 	}
 
-	Log(LogNotice, "CheckerComponent", msgbuf.str());
+	double loadPerCPU = 0;
+
+#ifndef _WIN32
+	double loadavg[1];
+
+	if (getloadavg(loadavg, 1) == 1)
+		loadPerCPU = loadavg[0] / std::max(1u, std::thread::hardware_concurrency());
+#endif /* _WIN32 */
+
+	int limit = m_Concurrency.Limit.load();
+	int newLimit = limit;
+
+	if (loadPerCPU > 2 || latency > 2) {
+		newLimit = std::max(limit * 3 / 4, GetAdaptiveConcurrencyMin());
+	} else if (saturated && started && late * 20 > started) {
+		newLimit = std::min(limit + 32, GetAdaptiveConcurrencyMax());
+	}
+
+	if (newLimit == limit)
+		return;
+
+	m_Concurrency.Limit.store(newLimit);
+
+	if (newLimit < limit)
+		++m_Concurrency.Decreases;
+	else
+		++m_Concurrency.Increases;
+
+	Log(LogNotice, "CheckerComponent")
+		<< "Changed the concurrent checks limit from " << limit << " to " << newLimit << " (load per CPU: " << loadPerCPU
+		<< ", average check latency: " << latency << "s, late checks: " << late << "/" << started << ").";
 }
 
 void CheckerComponent::ObjectHandler(const ConfigObject::Ptr& object)
@@ -298,19 +436,20 @@ void CheckerComponent::ObjectHandler(const ConfigObject::Ptr& object)
 	bool same_zone = (!zone || Zone::GetLocalZone() == zone);
 
 	{
-		std::unique_lock<std::mutex> lock(m_Mutex);
+		Shard& shard = GetShard(checkable);
+		std::unique_lock<std::mutex> lock(shard.Mutex);
 
 		if (object->IsActive() && !object->IsPaused() && same_zone) {
-			if (m_PendingCheckables.find(checkable) != m_PendingCheckables.end())
+			if (shard.PendingCheckables.find(checkable) != shard.PendingCheckables.end())
 				return;
 
-			m_IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
+			shard.IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
 		} else {
-			m_IdleCheckables.erase(checkable);
-			m_PendingCheckables.erase(checkable);
+			shard.IdleCheckables.erase(checkable);
+			shard.PendingCheckables.erase(checkable);
 		}
 
-		m_CV.notify_all();
+		shard.CV.notify_all();
 	}
 }
 
@@ -322,13 +461,22 @@ CheckableScheduleInfo CheckerComponent::GetCheckableScheduleInfo(const Checkable
 	return csi;
 }
 
+CheckerComponent::Shard& CheckerComponent::GetShard(const Checkable::Ptr& checkable)
+{
+	if (m_Shards.size() == 1)
+		return *m_Shards[0];
+
+	return *m_Shards[std::hash<String>()(checkable->GetName()) % m_Shards.size()];
+}
+
 void CheckerComponent::NextCheckChangedHandler(const Checkable::Ptr& checkable)
 {
-	std::unique_lock<std::mutex> lock(m_Mutex);
+	Shard& shard = GetShard(checkable);
+	std::unique_lock<std::mutex> lock(shard.Mutex);
 
 	/* remove and re-insert the object from the set in order to force an index update */
 	typedef boost::multi_index::nth_index<CheckableSet, 0>::type CheckableView;
-	CheckableView& idx = boost::get<0>(m_IdleCheckables);
+	CheckableView& idx = boost::get<0>(shard.IdleCheckables);
 
 	auto it = idx.find(checkable);
 
@@ -340,19 +488,51 @@ void CheckerComponent::NextCheckChangedHandler(const Checkable::Ptr& checkable)
 	CheckableScheduleInfo csi = GetCheckableScheduleInfo(checkable);
 	idx.insert(csi);
 
-	m_CV.notify_all();
+	shard.CV.notify_all();
 }
 
 unsigned long CheckerComponent::GetIdleCheckables()
 {
-	std::unique_lock<std::mutex> lock(m_Mutex);
+	unsigned long count = 0;
+
+	for (auto& shard : m_Shards) {
+		std::unique_lock<std::mutex> lock(shard->Mutex);
+		count += shard->IdleCheckables.size();
+	}
 
-	return m_IdleCheckables.size();
+	return count;
 }
 
 unsigned long CheckerComponent::GetPendingCheckables()
 {
-	std::unique_lock<std::mutex> lock(m_Mutex);
+	unsigned long count = 0;
+
+	for (auto& shard : m_Shards) {
+		std::unique_lock<std::mutex> lock(shard->Mutex);
+		count += shard->PendingCheckables.size();
+	}
+
+	return count;
+}
+
+void CheckerComponent::Validate(int types, const ValidationUtils& utils)
+{
+	ObjectImpl<CheckerComponent>::Validate(types, utils);
+
+	if (!(types & FAConfig))
+		return;
+
+	if (GetAdaptiveConcurrencyMin() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "adaptive_concurrency_min" }, "Value must be at least 1."));
+
+	if (GetAdaptiveConcurrencyMax() < GetAdaptiveConcurrencyMin())
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "adaptive_concurrency_max" }, "Value must not be less than adaptive_concurrency_min."));
+}
+
+void CheckerComponent::ValidateSchedulerShards(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<CheckerComponent>::ValidateSchedulerShards(lvalue, utils);
 
-	return m_PendingCheckables.size();
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "scheduler_shards" }, "Value must be at least 1."));
 }
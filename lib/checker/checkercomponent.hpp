@@ -5,6 +5,7 @@
 
 #include "checker/checkercomponent-ti.hpp"
 #include "icinga/service.hpp"
+#include "base/atomic.hpp"
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
 #include "base/utility.hpp"
@@ -12,8 +13,11 @@
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/key_extractors.hpp>
 #include <condition_variable>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 namespace icinga
 {
@@ -67,22 +71,58 @@ public:
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 	unsigned long GetIdleCheckables();
 	unsigned long GetPendingCheckables();
+	int GetConcurrencyLimit();
+
+	void Validate(int types, const ValidationUtils& utils) override;
+	void ValidateSchedulerShards(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
 
 private:
-	std::mutex m_Mutex;
-	std::condition_variable m_CV;
-	bool m_Stopped{false};
-	std::thread m_Thread;
+	/**
+	 * An independent part of the check schedule with its own lock and scheduler thread.
+	 * Each checkable is always assigned to the same shard.
+	 */
+	struct Shard
+	{
+		std::mutex Mutex;
+		std::condition_variable CV;
+		bool Stopped{false};
+		std::thread Thread;
+
+		CheckableSet IdleCheckables;
+		CheckableSet PendingCheckables;
+	};
 
-	CheckableSet m_IdleCheckables;
-	CheckableSet m_PendingCheckables;
+	std::vector<std::unique_ptr<Shard>> m_Shards;
 
 	Timer::Ptr m_ResultTimer;
 
-	void CheckThreadProc();
+	/**
+	 * What adaptive_concurrency bases its decisions on, collected since the last adjustment.
+	 */
+	struct {
+		Atomic<int> Limit {0};
+		Timer::Ptr Timer;
+
+		Atomic<uint_fast64_t> Started {0}, Late {0};
+		// Whether checks had to wait for a free slot
+		Atomic<bool> Saturated {false};
+
+		std::mutex Mutex;
+		double LatencySum = 0;
+		uint_fast64_t Results = 0;
+
+		// Monotonic counters of the adjustments for stats
+		Atomic<uint_fast64_t> Increases {0}, Decreases {0};
+	} m_Concurrency;
+
+	Shard& GetShard(const Checkable::Ptr& checkable);
+
+	void CheckThreadProc(Shard& shard, size_t index);
 	void ResultTimerHandler();
+	void AdjustConcurrency();
+	void CheckResultHandler(const CheckResult::Ptr& cr);
 
-	void ExecuteCheckHelper(const Checkable::Ptr& checkable);
+	void ExecuteCheckHelper(Shard& shard, const Checkable::Ptr& checkable);
 
 	void AdjustCheckTimer();
 
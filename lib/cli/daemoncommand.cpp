@@ -3,6 +3,7 @@
 #include "cli/daemoncommand.hpp"
 #include "cli/daemonutility.hpp"
 #include "remote/apilistener.hpp"
+#include "remote/configdeltautility.hpp"
 #include "remote/configobjectslock.hpp"
 #include "remote/configobjectutility.hpp"
 #include "config/configcompiler.hpp"
@@ -18,6 +19,7 @@
 #include "base/exception.hpp"
 #include "base/convert.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/startupprofile.hpp"
 #include "base/context.hpp"
 #include "config.h"
 #include <cstdint>
@@ -179,16 +181,18 @@ void DaemonCommand::InitParameters(boost::program_options::options_description&
 		("validate,C", "exit after validating the configuration")
 		("dump-objects", "write icinga2.debug cache file for icinga2 object list")
 		("errorlog,e", po::value<std::string>(), "log fatal errors to the specified log file (only works in combination with --daemonize or --close-stdio)")
+		("profile-startup", po::value<std::string>(), "write a JSON report about the duration of the startup phases to the specified file")
 #ifndef _WIN32
 		("daemonize,d", "detach from the controlling terminal")
 		("close-stdio", "do not log to stdout (or stderr) after startup")
+		("delta-reload", "on reload, only apply the changed objects to the running process")
 #endif /* _WIN32 */
 	;
 }
 
 std::vector<String> DaemonCommand::GetArgumentSuggestions(const String& argument, const String& word) const
 {
-	if (argument == "config" || argument == "errorlog")
+	if (argument == "config" || argument == "errorlog" || argument == "profile-startup")
 		return GetBashCompletionSuggestions("file", word);
 	else
 		return CLICommand::GetArgumentSuggestions(argument, word);
@@ -200,6 +204,43 @@ pid_t l_UmbrellaPid = 0;
 
 // Whether the umbrella process allowed us to continue working beyond config validation
 static Atomic<bool> l_AllowedToWork (false);
+
+// Whether reloads should only apply the changed objects to the current worker
+static bool l_DeltaReload = false;
+
+// Whether the umbrella process requested us to apply the changed objects (and we didn't handle that request, yet)
+static Atomic<bool> l_RequestedDeltaReload (false);
+
+/**
+ * Where the config validation for a delta reload dumps its objects and variables.
+ */
+static String GetDeltaObjectsPath()
+{
+	return Configuration::ObjectsPath + ".new";
+}
+
+static String GetDeltaVarsPath()
+{
+	return Configuration::VarsPath + ".new";
+}
+
+/**
+ * Applies the changed objects once the umbrella process validated the new config.
+ * Falls back to a full reload if the changes can't be applied at runtime.
+ */
+static void DeltaReloadTimerHandler()
+{
+	if (!l_RequestedDeltaReload.exchange(false))
+		return;
+
+	Log(LogInformation, "cli", "Got delta reload command: Applying changed objects.");
+
+	if (!ConfigDeltaUtility::ReloadObjects(Configuration::ObjectsPath, GetDeltaObjectsPath(), Configuration::VarsPath, GetDeltaVarsPath())) {
+		Log(LogInformation, "cli", "Delta reload not possible, requesting a full reload.");
+
+		Application::RequestRestart();
+	}
+}
 #endif /* _WIN32 */
 
 #ifdef I2_DEBUG
@@ -222,6 +263,27 @@ static double GetDebugWorkerDelay()
 
 static String l_ObjectsPath;
 
+// Where to write the startup profile to, if at all
+static String l_StartupProfilePath;
+
+/**
+ * Stops recording startup phases and writes the report if requested.
+ */
+static void FinishStartupProfile()
+{
+	StartupProfile::Finish();
+
+	if (l_StartupProfilePath.IsEmpty())
+		return;
+
+	try {
+		StartupProfile::WriteReport(l_StartupProfilePath);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "cli")
+			<< "Cannot write startup profile to '" << l_StartupProfilePath << "': " << DiagnosticInformation(ex, false);
+	}
+}
+
 /**
  * Do the actual work (config loading, ...)
  *
@@ -246,6 +308,8 @@ int RunWorker(const std::vector<std::string>& configs, bool closeConsoleLog = fa
 	}
 #endif /* I2_DEBUG */
 
+	StartupProfile::Start();
+
 	Log(LogInformation, "cli", "Loading configuration file(s).");
 	NotifyStatus("Loading configuration file(s)...");
 
@@ -258,6 +322,21 @@ int RunWorker(const std::vector<std::string>& configs, bool closeConsoleLog = fa
 			return EXIT_FAILURE;
 		}
 
+		NotifyStatus("Restoring the previous program state...");
+
+		/* Restore what the current worker (if any) persisted so far while it keeps running the checks. */
+		try {
+			StartupPhase phase ("state.restore");
+			ConfigObject::RestoreObjects(Configuration::StatePath);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "cli")
+				<< "Failed to restore state file: " << DiagnosticInformation(ex);
+
+			NotifyStatus("Failed to restore state file.");
+
+			return EXIT_FAILURE;
+		}
+
 #ifndef _WIN32
 		Log(LogNotice, "cli")
 			<< "Notifying umbrella process (PID " << l_UmbrellaPid << ") about the config loading success";
@@ -280,13 +359,13 @@ int RunWorker(const std::vector<std::string>& configs, bool closeConsoleLog = fa
 
 		Log(LogNotice, "cli")
 			<< "The umbrella process let us continuing";
-#endif /* _WIN32 */
 
-		NotifyStatus("Restoring the previous program state...");
+		NotifyStatus("Catching up on the previous program state...");
 
-		/* restore the previous program state */
+		/* The previous worker appended its last changes to the state journal before it exited. */
 		try {
-			ConfigObject::RestoreObjects(Configuration::StatePath);
+			StartupPhase phase ("state.catchup");
+			ConfigObject::RestoreObjects(Configuration::StatePath, FAState, true);
 		} catch (const std::exception& ex) {
 			Log(LogCritical, "cli")
 				<< "Failed to restore state file: " << DiagnosticInformation(ex);
@@ -295,11 +374,19 @@ int RunWorker(const std::vector<std::string>& configs, bool closeConsoleLog = fa
 
 			return EXIT_FAILURE;
 		}
+#endif /* _WIN32 */
 
 		NotifyStatus("Activating config objects...");
 
+		bool activated;
+
 		// activate config only after daemonization: it starts threads and that is not compatible with fork()
-		if (!ConfigItem::ActivateItems(newItems, false, true, true)) {
+		{
+			StartupPhase phase ("config.activate");
+			activated = ConfigItem::ActivateItems(newItems, false, true, true);
+		}
+
+		if (!activated) {
 			Log(LogCritical, "cli", "Error activating configuration.");
 
 			NotifyStatus("Error activating configuration.");
@@ -322,6 +409,19 @@ int RunWorker(const std::vector<std::string>& configs, bool closeConsoleLog = fa
 
 	ApiListener::UpdateObjectAuthority();
 
+#ifndef _WIN32
+	Timer::Ptr deltaReloadTimer;
+
+	if (l_DeltaReload) {
+		deltaReloadTimer = Timer::Create();
+		deltaReloadTimer->SetInterval(1);
+		deltaReloadTimer->OnTimerExpired.connect([](const Timer * const&) { DeltaReloadTimerHandler(); });
+		deltaReloadTimer->Start();
+	}
+#endif /* _WIN32 */
+
+	FinishStartupProfile();
+
 	NotifyStatus("Startup finished.");
 
 	return Application::GetInstance()->Run();
@@ -354,6 +454,12 @@ static Atomic<int> l_TermSignal (-1);
 // Whether someone requested to re-load config (and we didn't handle that request, yet)
 static Atomic<bool> l_RequestedReload (false);
 
+// Whether the current seamless worker requested a full reload (and we didn't handle that request, yet)
+static Atomic<bool> l_RequestedFullReload (false);
+
+// The PID of the current seamless worker
+static Atomic<pid_t> l_CurrentUnixWorkerPid (-1);
+
 // Whether someone requested to re-open logs (and we didn't handle that request, yet)
 static Atomic<bool> l_RequestedReopenLogs (false);
 
@@ -391,6 +497,11 @@ static void UmbrellaSignalHandler(int num, siginfo_t *info, void*)
 			break;
 		case SIGHUP:
 			// Someone requested to re-load config
+			if (info->si_pid != 0 && info->si_pid == l_CurrentUnixWorkerPid.load()) {
+				// The current seamless worker couldn't apply a delta reload or was asked to restart
+				l_RequestedFullReload.store(true);
+			}
+
 			l_RequestedReload.store(true);
 			break;
 		default:
@@ -422,6 +533,12 @@ static void WorkerSignalHandler(int num, siginfo_t *info, void*)
 				Application::RequestShutdown();
 			}
 			break;
+		case SIGHUP:
+			if (info->si_pid == 0 || info->si_pid == l_UmbrellaPid) {
+				// The umbrella process validated the new config for a delta reload
+				l_RequestedDeltaReload.store(true);
+			}
+			break;
 		default:
 			// Programming error (or someone has broken the userspace)
 			VERIFY(!"Caught unexpected signal");
@@ -502,7 +619,7 @@ static pid_t StartUnixWorker(const std::vector<std::string>& configs, bool close
 					(void)sigaction(SIGUSR1, &sa, nullptr);
 				}
 
-				{
+				if (!l_DeltaReload) {
 					struct sigaction sa;
 					memset(&sa, 0, sizeof(sa));
 
@@ -522,6 +639,9 @@ static pid_t StartUnixWorker(const std::vector<std::string>& configs, bool close
 					(void)sigaction(SIGUSR2, &sa, nullptr);
 					(void)sigaction(SIGINT, &sa, nullptr);
 					(void)sigaction(SIGTERM, &sa, nullptr);
+
+					if (l_DeltaReload)
+						(void)sigaction(SIGHUP, &sa, nullptr);
 				}
 
 				(void)sigprocmask(SIG_UNBLOCK, &l_UnixWorkerSignals, nullptr);
@@ -596,6 +716,90 @@ static pid_t StartUnixWorker(const std::vector<std::string>& configs, bool close
 	return pid;
 }
 
+/**
+ * Validates the config in a child process which dumps its objects and
+ * variables for the current seamless worker to apply the changes.
+ *
+ * @param configs Files to read config from
+ *
+ * @return Whether the config is valid
+ */
+static bool ValidateUnixDeltaConfig(const std::vector<std::string>& configs)
+{
+	Log(LogNotice, "cli")
+		<< "Spawning process validating the config for a delta reload";
+
+	try {
+		Application::UninitializeBase();
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "cli")
+			<< "Failed to stop thread pool before forking, unexpected error: " << DiagnosticInformation(ex);
+		exit(EXIT_FAILURE);
+	}
+
+	(void)sigprocmask(SIG_BLOCK, &l_UnixWorkerSignals, nullptr);
+
+	pid_t pid = fork();
+
+	if (pid == 0) {
+		try {
+			{
+				struct sigaction sa;
+				memset(&sa, 0, sizeof(sa));
+
+				sa.sa_handler = SIG_DFL;
+
+				(void)sigaction(SIGUSR1, &sa, nullptr);
+				(void)sigaction(SIGUSR2, &sa, nullptr);
+				(void)sigaction(SIGINT, &sa, nullptr);
+				(void)sigaction(SIGTERM, &sa, nullptr);
+				(void)sigaction(SIGHUP, &sa, nullptr);
+			}
+
+			(void)sigprocmask(SIG_UNBLOCK, &l_UnixWorkerSignals, nullptr);
+
+			Application::InitializeBase();
+
+			std::vector<ConfigItem::Ptr> newItems;
+
+			_exit(DaemonUtility::LoadConfigFiles(configs, newItems, GetDeltaObjectsPath(), GetDeltaVarsPath()) ? EXIT_SUCCESS : EXIT_FAILURE);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "cli") << "Exception while validating the config: " << DiagnosticInformation(ex);
+			_exit(EXIT_FAILURE);
+		} catch (...) {
+			_exit(EXIT_FAILURE);
+		}
+	}
+
+	(void)sigprocmask(SIG_UNBLOCK, &l_UnixWorkerSignals, nullptr);
+
+	try {
+		Application::InitializeBase();
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "cli")
+			<< "Failed to re-initialize thread pool after forking (parent): " << DiagnosticInformation(ex);
+		exit(EXIT_FAILURE);
+	}
+
+	if (pid == -1) {
+		Log(LogCritical, "cli")
+			<< "fork() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		return false;
+	}
+
+	int status;
+
+	while (waitpid(pid, &status, WNOHANG) == 0) {
+#ifdef HAVE_SYSTEMD
+		NotifyWatchdog();
+#endif /* HAVE_SYSTEMD */
+
+		Utility::Sleep(0.2);
+	}
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
 /**
  * Workaround to instantiate Application (which is abstract) in DaemonCommand#Run()
  */
@@ -638,6 +842,9 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 		configs.push_back(configDir + "/icinga2.conf");
 	}
 
+	if (vm.count("profile-startup"))
+		l_StartupProfilePath = vm["profile-startup"].as<std::string>();
+
 	if (vm.count("dump-objects")) {
 		if (!vm.count("validate")) {
 			Log(LogCritical, "cli", "--dump-objects is not allowed without -C");
@@ -657,6 +864,8 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 			return EXIT_FAILURE;
 		}
 
+		FinishStartupProfile();
+
 		Log(LogInformation, "cli", "Finished validating the configuration file(s).");
 		return EXIT_SUCCESS;
 	}
@@ -722,6 +931,13 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 	l_UmbrellaPid = getpid();
 	Application::SetUmbrellaProcess(l_UmbrellaPid);
 
+	if (vm.count("delta-reload")) {
+		l_DeltaReload = true;
+
+		// The objects of the running config are compared against the ones of the new config on reload.
+		l_ObjectsPath = Configuration::ObjectsPath;
+	}
+
 	{
 		struct sigaction sa;
 		memset(&sa, 0, sizeof(sa));
@@ -749,6 +965,8 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 		return EXIT_FAILURE;
 	}
 
+	l_CurrentUnixWorkerPid.store(currentWorker);
+
 	if (closeConsoleLog) {
 		// After disabling the console log, any further errors will go to the configured log only.
 		// Let's try to make this clear and say good bye.
@@ -794,7 +1012,37 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 			}
 		}
 
+		if (l_DeltaReload && !l_RequestedFullReload.load() && l_RequestedReload.exchange(false)) {
+			Log(LogInformation, "Application")
+				<< "Got reload command: Validating config for a delta reload.";
+
+#ifdef HAVE_SYSTEMD
+			sd_notify(0, "RELOADING=1");
+#endif /* HAVE_SYSTEMD */
+
+			{
+				ConfigObjectsExclusiveLock lock;
+
+				if (ValidateUnixDeltaConfig(configs)) {
+					Log(LogInformation, "Application")
+						<< "Config validated, forwarding the delta reload to seamless worker (PID " << currentWorker << ")";
+
+					Application::SetLastReloadFailed(0);
+					(void)kill(currentWorker, SIGHUP);
+				} else {
+					Log(LogCritical, "Application", "Found error in config: reloading aborted");
+					Application::SetLastReloadFailed(Utility::GetTime());
+				}
+			}
+
+#ifdef HAVE_SYSTEMD
+			sd_notify(0, "READY=1");
+#endif /* HAVE_SYSTEMD */
+		}
+
 		if (l_RequestedReload.exchange(false)) {
+			l_RequestedFullReload.store(false);
+
 			Log(LogInformation, "Application")
 				<< "Got reload command: Starting new instance.";
 
@@ -843,6 +1091,7 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 					NotifyStatus("Shut down old instance.");
 
 					currentWorker = nextWorker;
+					l_CurrentUnixWorkerPid.store(currentWorker);
 			}
 
 #ifdef HAVE_SYSTEMD
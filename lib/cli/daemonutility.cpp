@@ -7,8 +7,10 @@
 #include "base/logger.hpp"
 #include "base/application.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/startupprofile.hpp"
 #include "config/configcompiler.hpp"
 #include "config/configcompilercontext.hpp"
+#include "config/expressioncache.hpp"
 #include "config/configitembuilder.hpp"
 #include "icinga/dependency.hpp"
 #include <set>
@@ -45,11 +47,14 @@ static bool IncludeZoneDirRecursive(const String& path, const String& package, b
 	/* register this zone path for cluster config sync */
 	ConfigCompiler::RegisterZoneDir("_etc", path, zoneName);
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::GlobRecursive(path, "*.conf", [&expressions, zoneName, package](const String& file) {
-		ConfigCompiler::CollectIncludes(expressions, file, zoneName, package);
+	std::vector<IncludedFile> files;
+	Utility::GlobRecursive(path, "*.conf", [&files, zoneName](const String& file) {
+		files.push_back({ file, zoneName });
 	}, GlobFile);
 
+	std::vector<std::unique_ptr<Expression> > expressions;
+	ConfigCompiler::CollectIncludes(expressions, files, package);
+
 	DictExpression expr(std::move(expressions));
 	if (!ExecuteExpression(&expr))
 		success = false;
@@ -80,11 +85,14 @@ static bool IncludeNonLocalZone(const String& zonePath, const String& package, b
 		return true;
 	}
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::GlobRecursive(zonePath, "*.conf", [&expressions, zoneName, package](const String& file) {
-		ConfigCompiler::CollectIncludes(expressions, file, zoneName, package);
+	std::vector<IncludedFile> files;
+	Utility::GlobRecursive(zonePath, "*.conf", [&files, zoneName](const String& file) {
+		files.push_back({ file, zoneName });
 	}, GlobFile);
 
+	std::vector<std::unique_ptr<Expression> > expressions;
+	ConfigCompiler::CollectIncludes(expressions, files, package);
+
 	DictExpression expr(std::move(expressions));
 	if (!ExecuteExpression(&expr))
 		success = false;
@@ -242,20 +250,42 @@ bool DaemonUtility::LoadConfigFiles(const std::vector<std::string>& configs,
 {
 	ActivationScope ascope;
 
+	double start = Utility::GetTime();
+	size_t compiledFiles = ConfigCompiler::GetIncludedFileCount();
+	double compileTime = ConfigCompiler::GetIncludedFileCompileTime();
+	auto cacheHits (ExpressionCache::GetHits());
+
 	if (!DaemonUtility::ValidateConfigFiles(configs, objectsFile)) {
 		ConfigCompilerContext::GetInstance()->CancelObjectsFile();
 		return false;
 	}
 
+	double evaluated = Utility::GetTime();
+
+	compiledFiles = ConfigCompiler::GetIncludedFileCount() - compiledFiles;
+	compileTime = ConfigCompiler::GetIncludedFileCompileTime() - compileTime;
+	cacheHits = ExpressionCache::GetHits() - cacheHits;
+
+	/* All config files have been compiled by now, the other entries are stale. */
+	if (ExpressionCache::IsEnabled()) {
+		size_t removed = ExpressionCache::RemoveUnusedEntries();
+
+		if (removed) {
+			Log(LogNotice, "config")
+				<< "Removed " << removed << " unused entries from the config cache.";
+		}
+	}
+
 	// After evaluating the top-level statements of the config files (happening in ValidateConfigFiles() above),
 	// prevent further modification of the global scope. This allows for a faster execution of the following steps
 	// as Freeze() disables locking as it's not necessary on a read-only data structure anymore.
 	ScriptGlobal::GetGlobals()->Freeze();
 
-	WorkQueue upq(25000, Configuration::Concurrency);
-	upq.SetName("DaemonUtility::LoadConfigFiles");
+	TaskGroup upq ("DaemonUtility::LoadConfigFiles");
 	bool result = ConfigItem::CommitItems(ascope.GetContext(), upq, newItems);
 
+	double committed = Utility::GetTime();
+
 	if (result) {
 		try {
 			Dependency::AssertNoCycles();
@@ -267,6 +297,23 @@ bool DaemonUtility::LoadConfigFiles(const std::vector<std::string>& configs,
 		}
 	}
 
+	double checked = Utility::GetTime();
+
+	Log(LogInformation, "config")
+		<< "Config phases: compiled " << compiledFiles << " included files (" << cacheHits << " from cache) in " << compileTime
+		<< "s, evaluated the config files in " << evaluated - start - compileTime
+		<< "s (excluding compilation), committed the items in " << committed - evaluated
+		<< "s, checked dependencies for cycles in " << checked - committed << "s.";
+
+	/* Compilation happens while evaluating the includes, it's reported as if it happened first. */
+	StartupProfile::AddPhase("config.compile", start, start + compileTime, new Dictionary({
+		{ "files", compiledFiles },
+		{ "cache_hits", cacheHits }
+	}));
+	StartupProfile::AddPhase("config.evaluate", start + compileTime, evaluated);
+	StartupProfile::AddPhase("config.commit", evaluated, committed, new Dictionary({ { "items", newItems.size() } }));
+	StartupProfile::AddPhase("config.check_dependency_cycles", committed, checked);
+
 	if (!result) {
 		ConfigCompilerContext::GetInstance()->CancelObjectsFile();
 		return false;
@@ -0,0 +1,294 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "cli/internalloadtestcommand.hpp"
+#include "cli/daemonutility.hpp"
+#include "icinga/checkable.hpp"
+#include "icinga/checkresult.hpp"
+#include "icinga/cib.hpp"
+#include "remote/apilistener.hpp"
+#include "config/configitem.hpp"
+#include "base/application.hpp"
+#include "base/configuration.hpp"
+#include "base/defer.hpp"
+#include "base/exception.hpp"
+#include "base/function.hpp"
+#include "base/histogram.hpp"
+#include "base/logger.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/timer.hpp"
+#include "base/utility.hpp"
+#include <boost/filesystem.hpp>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+using namespace icinga;
+namespace po = boost::program_options;
+
+REGISTER_CLICOMMAND("internal/loadtest", InternalLoadtestCommand);
+
+static bool l_RandomStates = false;
+static std::atomic<uint_fast64_t> l_CheckResults (0);
+
+/* In microseconds */
+static Histogram l_Lateness;
+static Histogram l_Processing;
+
+/**
+ * Like RandomCheck or NullCheck, but measures how late the checker started the check and how long
+ * Checkable::ProcessCheckResult() took (including the synchronous handlers of the enabled features).
+ */
+static void LoadtestCheck(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr,
+	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros)
+{
+	REQUIRE_NOT_NULL(checkable);
+	REQUIRE_NOT_NULL(cr);
+
+	if (resolvedMacros && !useResolvedMacros)
+		return;
+
+	auto lateness ((cr->GetExecutionStart() - cr->GetScheduleStart()) * 1000000.0);
+	l_Lateness.Record(lateness > 0 ? (Histogram::ValueType)lateness : 0);
+
+	double now = Utility::GetTime();
+
+	cr->SetOutput("Load test check result");
+	cr->SetCommand("loadtest");
+
+	if (l_RandomStates) {
+		double random = Utility::Random() % 1000;
+
+		cr->SetState(static_cast<ServiceState>(Utility::Random() % 4));
+		cr->SetPerformanceData(new Array({
+			new PerfdataValue("time", now),
+			new PerfdataValue("value", random),
+			new PerfdataValue("value_1m", random * 0.9),
+			new PerfdataValue("value_5m", random * 0.8)
+		}));
+	} else {
+		cr->SetState(ServiceOK);
+		cr->SetPerformanceData(new Array({ new PerfdataValue("time", now) }));
+	}
+
+	checkable->ProcessCheckResult(cr);
+
+	auto processing ((Utility::GetTime() - now) * 1000000.0);
+	l_Processing.Record(processing > 0 ? (Histogram::ValueType)processing : 0);
+
+	l_CheckResults.fetch_add(1, std::memory_order_relaxed);
+}
+
+static String FormatPercentiles(const Histogram& histogram)
+{
+	std::ostringstream msgbuf;
+
+	msgbuf << "p50 " << histogram.GetPercentile(50) / 1000.0 << "ms, p90 " << histogram.GetPercentile(90) / 1000.0
+		<< "ms, p99 " << histogram.GetPercentile(99) / 1000.0 << "ms, max " << histogram.GetMax() / 1000.0 << "ms";
+
+	return msgbuf.str();
+}
+
+/**
+ * Logs the check result rate since the last report and the percentiles since the start.
+ */
+static void ReportProgress(double expectedRate)
+{
+	static std::mutex mutex;
+	static uint_fast64_t lastResults = 0;
+	static double lastReport = Application::GetStartTime();
+
+	std::unique_lock<std::mutex> lock (mutex);
+
+	double now = Utility::GetTime();
+	uint_fast64_t results = l_CheckResults.load(std::memory_order_relaxed);
+	double rate = now > lastReport ? (results - lastResults) / (now - lastReport) : 0;
+
+	lastResults = results;
+	lastReport = now;
+
+	Log(LogInformation, "cli")
+		<< "Load test: " << rate << " check results/s (expected: " << expectedRate << "/s), checker lateness "
+		<< FormatPercentiles(l_Lateness) << ", ProcessCheckResult() " << FormatPercentiles(l_Processing);
+}
+
+/**
+ * Prints the totals and what the StatsFunctions of the enabled features report, e.g. their queue sizes and rates.
+ */
+static void ReportSummary(double expectedRate)
+{
+	double duration = Utility::GetTime() - Application::GetStartTime();
+	uint_fast64_t results = l_CheckResults.load(std::memory_order_relaxed);
+
+	std::cout << "Check results: " << results << " in " << duration << "s (" << (duration > 0 ? results / duration : 0)
+		<< "/s sustained, expected: " << expectedRate << "/s)\n"
+		<< "Checker lateness: " << FormatPercentiles(l_Lateness) << "\n"
+		<< "ProcessCheckResult(): mean " << l_Processing.GetMean() / 1000.0 << "ms, " << FormatPercentiles(l_Processing) << "\n"
+		<< "Feature stats:\n";
+
+	Array::Ptr perfdata = CIB::GetFeatureStats().second;
+	ObjectLock olock (perfdata);
+
+	for (const Value& item : perfdata) {
+		if (item.IsObjectType<PerfdataValue>()) {
+			PerfdataValue::Ptr pdv = item;
+			std::cout << "  " << pdv->GetLabel() << ": " << pdv->GetValue() << pdv->GetUnit() << "\n";
+		}
+	}
+}
+
+String InternalLoadtestCommand::GetDescription() const
+{
+	return "Runs the check pipeline with synthetic hosts and services and reports its throughput and latency.";
+}
+
+String InternalLoadtestCommand::GetShortDescription() const
+{
+	return "run a check pipeline load test";
+}
+
+bool InternalLoadtestCommand::IsHidden() const
+{
+	return true;
+}
+
+void InternalLoadtestCommand::InitParameters(boost::program_options::options_description& visibleDesc,
+	boost::program_options::options_description& hiddenDesc) const
+{
+	visibleDesc.add_options()
+		("hosts", po::value<int>()->default_value(1000), "Number of hosts")
+		("services", po::value<int>()->default_value(10), "Number of services per host")
+		("check-interval", po::value<double>()->default_value(60), "Check interval of all hosts and services in seconds")
+		("random", "Return random states and more performance data like RandomCheck, instead of OK like NullCheck")
+		("duration", po::value<double>()->default_value(300), "Run for this many seconds")
+		("report-interval", po::value<double>()->default_value(10), "Log the progress every this many seconds")
+		("include", po::value<std::vector<std::string> >(), "Also load this config file, e.g. a feature to measure")
+	;
+}
+
+/**
+ * The entry point for the "internal loadtest" CLI command.
+ *
+ * @returns An exit status.
+ */
+int InternalLoadtestCommand::Run(const boost::program_options::variables_map& vm, const std::vector<std::string>& ap) const
+{
+	namespace fs = boost::filesystem;
+
+	Logger::EnableTimestamp();
+
+	int hosts = vm["hosts"].as<int>();
+	int services = vm["services"].as<int>();
+	double checkInterval = vm["check-interval"].as<double>();
+	double duration = vm["duration"].as<double>();
+	double reportInterval = vm["report-interval"].as<double>();
+
+	if (hosts < 1 || services < 0 || checkInterval <= 0 || duration <= 0 || reportInterval <= 0) {
+		Log(LogCritical, "cli", "Invalid load test parameters.");
+		return EXIT_FAILURE;
+	}
+
+	l_RandomStates = vm.count("random");
+
+	double expectedRate = hosts * (services + 1.0) / checkInterval;
+
+	/* Don't touch the state and modified attributes of a real instance. */
+	String dir = (fs::temp_directory_path() / fs::unique_path("icinga2-loadtest-%%%%-%%%%")).string();
+	fs::create_directories(dir.GetData());
+
+	Defer removeDir ([&dir]() {
+		boost::system::error_code ec;
+		fs::remove_all(dir.GetData(), ec);
+	});
+
+	Configuration::StatePath = dir + "/icinga2.state";
+	Configuration::ModAttrPath = dir + "/modified-attributes.conf";
+
+	String configPath = dir + "/loadtest.conf";
+
+	{
+		std::ofstream fp (configPath.CStr());
+
+		fp << "object CheckCommand \"loadtest\" {\n"
+			<< "  execute = LoadtestCheck\n"
+			<< "}\n\n"
+			<< "object CheckerComponent \"loadtest\" { }\n\n"
+			<< "template Host \"loadtest\" {\n"
+			<< "  check_command = \"loadtest\"\n"
+			<< "  check_interval = " << checkInterval << "\n"
+			<< "  retry_interval = " << checkInterval << "\n"
+			<< "  enable_notifications = false\n"
+			<< "  enable_event_handler = false\n"
+			<< "  vars.loadtest = true\n"
+			<< "}\n\n"
+			<< "apply Service \"loadtest-\" for (i in range(" << services << ")) {\n"
+			<< "  check_command = \"loadtest\"\n"
+			<< "  check_interval = " << checkInterval << "\n"
+			<< "  retry_interval = " << checkInterval << "\n"
+			<< "  enable_notifications = false\n"
+			<< "  enable_event_handler = false\n"
+			<< "  assign where host.vars.loadtest\n"
+			<< "}\n\n"
+			<< "for (i in range(" << hosts << ")) {\n"
+			<< "  object Host \"loadtest-\" + i {\n"
+			<< "    import \"loadtest\"\n"
+			<< "  }\n"
+			<< "}\n";
+
+		if (!fp) {
+			Log(LogCritical, "cli")
+				<< "Cannot write load test config to '" << configPath << "'.";
+			return EXIT_FAILURE;
+		}
+	}
+
+	ScriptGlobal::Set("LoadtestCheck", new Function("LoadtestCheck", &LoadtestCheck,
+		{ "checkable", "cr", "resolvedMacros", "useResolvedMacros" }, false));
+
+	std::vector<std::string> configs;
+
+	if (vm.count("include"))
+		configs = vm["include"].as<std::vector<std::string> >();
+
+	configs.emplace_back(configPath.GetData());
+
+	Log(LogInformation, "cli")
+		<< "Preparing " << hosts << " hosts with " << services << " services each.";
+
+	{
+		std::vector<ConfigItem::Ptr> newItems;
+
+		if (!DaemonUtility::LoadConfigFiles(configs, newItems, String(), dir + "/icinga2.vars")) {
+			Log(LogCritical, "cli", "Config validation failed.");
+			return EXIT_FAILURE;
+		}
+
+		if (!ConfigItem::ActivateItems(newItems, false, true, true)) {
+			Log(LogCritical, "cli", "Error activating configuration.");
+			return EXIT_FAILURE;
+		}
+	}
+
+	ApiListener::UpdateObjectAuthority();
+
+	Timer::Ptr reportTimer = Timer::Create();
+	reportTimer->SetInterval(reportInterval);
+	reportTimer->OnTimerExpired.connect([expectedRate](const Timer * const&) { ReportProgress(expectedRate); });
+	reportTimer->Start();
+
+	Timer::Ptr stopTimer = Timer::Create();
+	stopTimer->OnTimerExpired.connect([expectedRate, &reportTimer](const Timer * const&) {
+		reportTimer->Stop();
+		ReportSummary(expectedRate);
+		Application::RequestShutdown();
+	});
+	stopTimer->Reschedule(Utility::GetTime() + duration);
+	stopTimer->Start();
+
+	Log(LogInformation, "cli")
+		<< "Running the load test for " << duration << " seconds.";
+
+	return Application::GetInstance()->Run();
+}
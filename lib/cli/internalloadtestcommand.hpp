@@ -0,0 +1,32 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef INTERNALLOADTESTCOMMAND_H
+#define INTERNALLOADTESTCOMMAND_H
+
+#include "cli/clicommand.hpp"
+
+namespace icinga
+{
+
+/**
+ * The "internal loadtest" command.
+ *
+ * @ingroup cli
+ */
+class InternalLoadtestCommand final : public CLICommand
+{
+public:
+	DECLARE_PTR_TYPEDEFS(InternalLoadtestCommand);
+
+	String GetDescription() const override;
+	String GetShortDescription() const override;
+	bool IsHidden() const override;
+	void InitParameters(boost::program_options::options_description& visibleDesc,
+		boost::program_options::options_description& hiddenDesc) const override;
+	int Run(const boost::program_options::variables_map& vm, const std::vector<std::string>& ap) const override;
+
+};
+
+}
+
+#endif /* INTERNALLOADTESTCOMMAND_H */
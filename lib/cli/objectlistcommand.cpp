@@ -7,12 +7,15 @@
 #include "base/convert.hpp"
 #include "base/configobject.hpp"
 #include "base/configtype.hpp"
+#include "base/configuration.hpp"
 #include "base/json.hpp"
 #include "base/netstring.hpp"
 #include "base/stdiostream.hpp"
 #include "base/debug.hpp"
 #include "base/objectlock.hpp"
 #include "base/console.hpp"
+#include "base/taskgroup.hpp"
+#include "config/configcompilercontext.hpp"
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <fstream>
@@ -88,20 +91,31 @@ int ObjectListCommand::Run(const boost::program_options::variables_map& vm, cons
 		type_filter = vm["type"].as<std::string>();
 
 	bool first = true;
+	std::vector<ObjectsIndexEntry> index;
 
-	String message;
-	StreamReadContext src;
-	for (;;) {
-		StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+	/* Filtered lookups only read the matching objects. */
+	if ((!name_filter.IsEmpty() || !type_filter.IsEmpty()) && ConfigCompilerContext::ReadObjectsIndex(objectfile, index)) {
+		String message;
+
+		for (auto& entry : index) {
+			/* Like ObjectListUtility::PrintObject() */
+			if (!name_filter.IsEmpty() && !Utility::Match(name_filter, entry.Name) && !Utility::Match(name_filter, entry.FullName))
+				continue;
+			if (!type_filter.IsEmpty() && !Utility::Match(type_filter, entry.Type))
+				continue;
+
+			fp.clear();
+			fp.seekg(entry.Offset);
 
-		if (srs == StatusEof)
-			break;
+			StreamReadContext src;
 
-		if (srs != StatusNewItem)
-			continue;
+			if (NetString::ReadStringFromStream(sfp, &message, src) == StatusNewItem)
+				ObjectListUtility::PrintObject(std::cout, first, message, type_count, name_filter, type_filter);
+		}
 
-		ObjectListUtility::PrintObject(std::cout, first, message, type_count, name_filter, type_filter);
-		objects_count++;
+		objects_count = index.size();
+	} else if (!ReadObjects(sfp, first, objects_count, type_count, name_filter, type_filter)) {
+		return 1;
 	}
 
 	sfp->Close();
@@ -130,6 +144,67 @@ int ObjectListCommand::Run(const boost::program_options::variables_map& vm, cons
 	return 0;
 }
 
+/**
+ * Object of the objects file, decoded in parallel and printed in order.
+ */
+struct ObjectsFileItem
+{
+	String Message;
+	mutable Dictionary::Ptr Object;
+};
+
+/**
+ * Reads all objects and prints the matching ones. The JSON of up to 1024 objects at a time is decoded in parallel.
+ *
+ * @return Whether the objects file could be decoded
+ */
+bool ObjectListCommand::ReadObjects(const StdioStream::Ptr& sfp, bool& first, unsigned long& objects_count,
+	std::map<String, int>& type_count, const String& name_filter, const String& type_filter)
+{
+	TaskGroup upq ("ObjectListCommand");
+
+	std::vector<ObjectsFileItem> items;
+	String message;
+	StreamReadContext src;
+	bool eof = false;
+
+	while (!eof) {
+		items.clear();
+
+		while (items.size() < 1024u) {
+			StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+			if (srs == StatusEof) {
+				eof = true;
+				break;
+			}
+
+			if (srs != StatusNewItem)
+				continue;
+
+			items.emplace_back(ObjectsFileItem{std::move(message), nullptr});
+		}
+
+		upq.ParallelFor(items, [](const ObjectsFileItem& item) {
+			item.Object = JsonDecode(item.Message);
+		});
+
+		upq.Join();
+
+		if (upq.HasExceptions()) {
+			upq.ReportExceptions("cli");
+			return false;
+		}
+
+		for (auto& item : items) {
+			ObjectListUtility::PrintObject(std::cout, first, item.Object, type_count, name_filter, type_filter);
+			objects_count++;
+		}
+	}
+
+	return true;
+}
+
 void ObjectListCommand::PrintTypeCounts(std::ostream& fp, const std::map<String, int>& type_count)
 {
 	typedef std::map<String, int>::value_type TypeCount;
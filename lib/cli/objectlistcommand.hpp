@@ -5,7 +5,9 @@
 
 #include "base/dictionary.hpp"
 #include "base/array.hpp"
+#include "base/stdiostream.hpp"
 #include "cli/clicommand.hpp"
+#include <map>
 #include <ostream>
 
 namespace icinga
@@ -28,6 +30,8 @@ public:
 	int Run(const boost::program_options::variables_map& vm, const std::vector<std::string>& ap) const override;
 
 private:
+	static bool ReadObjects(const StdioStream::Ptr& sfp, bool& first, unsigned long& objects_count,
+		std::map<String, int>& type_count, const String& name_filter, const String& type_filter);
 	static void PrintTypeCounts(std::ostream& fp, const std::map<String, int>& type_count);
 };
 
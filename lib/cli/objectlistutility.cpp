@@ -13,8 +13,11 @@ using namespace icinga;
 
 bool ObjectListUtility::PrintObject(std::ostream& fp, bool& first, const String& message, std::map<String, int>& type_count, const String& name_filter, const String& type_filter)
 {
-	Dictionary::Ptr object = JsonDecode(message);
+	return PrintObject(fp, first, Dictionary::Ptr(JsonDecode(message)), type_count, name_filter, type_filter);
+}
 
+bool ObjectListUtility::PrintObject(std::ostream& fp, bool& first, const Dictionary::Ptr& object, std::map<String, int>& type_count, const String& name_filter, const String& type_filter)
+{
 	Dictionary::Ptr properties = object->Get("properties");
 
 	String internal_name = properties->Get("__name");
@@ -20,6 +20,7 @@ class ObjectListUtility
 {
 public:
 	static bool PrintObject(std::ostream& fp, bool& first, const String& message, std::map<String, int>& type_count, const String& name_filter, const String& type_filter);
+	static bool PrintObject(std::ostream& fp, bool& first, const Dictionary::Ptr& object, std::map<String, int>& type_count, const String& name_filter, const String& type_filter);
 
 private:
 	static void PrintProperties(std::ostream& fp, const Dictionary::Ptr& props, const Dictionary::Ptr& debug_hints, int indent);
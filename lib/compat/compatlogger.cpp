@@ -49,7 +49,7 @@ void CompatLogger::Start(bool runtimeCreated)
 	Log(LogWarning, "CompatLogger")
 		<< "This feature is DEPRECATED and may be removed in future releases. Check the roadmap at https://github.com/Icinga/icinga2/milestones";
 
-	Checkable::OnNewCheckResult.connect([this](const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
+	Checkable::OnNewCheckResult.connect(GetReflectionType()->GetName().GetData(), [this](const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
 		CheckResultHandler(checkable, cr);
 	});
 	Checkable::OnNotificationSentToUser.connect([this](const Notification::Ptr& notification, const Checkable::Ptr& checkable,
@@ -75,6 +75,16 @@ void CompatLogger::Start(bool runtimeCreated)
 
 	ReopenFile(false);
 	ScheduleNextRotation();
+
+	if (GetFlushInterval() > 0) {
+		m_FlushTimer = Timer::Create();
+		m_FlushTimer->SetInterval(GetFlushInterval());
+		m_FlushTimer->OnTimerExpired.connect([this](const Timer * const&) {
+			ObjectLock olock(this);
+			Flush(true);
+		});
+		m_FlushTimer->Start();
+	}
 }
 
 /**
@@ -84,6 +94,14 @@ void CompatLogger::Stop(bool runtimeRemoved)
 {
 	m_RotationTimer->Stop(true);
 
+	if (m_FlushTimer)
+		m_FlushTimer->Stop(true);
+
+	{
+		ObjectLock olock(this);
+		Flush(true);
+	}
+
 	Log(LogInformation, "CompatLogger")
 		<< "'" << GetName() << "' stopped.";
 
@@ -450,10 +468,18 @@ void CompatLogger::WriteLine(const String& line)
 	m_OutputFile << "[" << (long)Utility::GetTime() << "] " << line << "\n";
 }
 
-void CompatLogger::Flush()
+/**
+ * Flushes the log file if flush_interval is 0, otherwise the flush timer does that.
+ *
+ * @param force Whether to flush regardless of flush_interval
+ */
+void CompatLogger::Flush(bool force)
 {
 	ASSERT(OwnsLock());
 
+	if (!force && GetFlushInterval() > 0)
+		return;
+
 	if (!m_OutputFile.good())
 		return;
 
@@ -465,34 +491,8 @@ void CompatLogger::Flush()
  */
 void CompatLogger::ReopenFile(bool rotate)
 {
-	ObjectLock olock(this);
-
-	String tempFile = GetLogDir() + "/icinga.log";
-
-	if (m_OutputFile) {
-		m_OutputFile.close();
-
-		if (rotate) {
-			String archiveFile = GetLogDir() + "/archives/icinga-" + Utility::FormatDateTime("%m-%d-%Y-%H", Utility::GetTime()) + ".log";
-
-			Log(LogNotice, "CompatLogger")
-				<< "Rotating compat log file '" << tempFile << "' -> '" << archiveFile << "'";
-
-			(void) rename(tempFile.CStr(), archiveFile.CStr());
-		}
-	}
-
-	m_OutputFile.open(tempFile.CStr(), std::ofstream::app);
-
-	if (!m_OutputFile) {
-		Log(LogWarning, "CompatLogger")
-			<< "Could not open compat log file '" << tempFile << "' for writing. Log output will be lost.";
-
-		return;
-	}
-
-	WriteLine("LOG ROTATION: " + GetRotationMethod());
-	WriteLine("LOG VERSION: 2.0");
+	/* Collect the current states before taking the lock, the event handlers would have to wait for that otherwise. */
+	std::vector<String> states;
 
 	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
 		String output;
@@ -509,7 +509,7 @@ void CompatLogger::ReopenFile(bool rotate)
 			<< host->GetCheckAttempt() << ";"
 			<< output << "";
 
-		WriteLine(msgbuf.str());
+		states.emplace_back(msgbuf.str());
 	}
 
 	for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>()) {
@@ -530,10 +530,42 @@ void CompatLogger::ReopenFile(bool rotate)
 			<< service->GetCheckAttempt() << ";"
 			<< output << "";
 
-		WriteLine(msgbuf.str());
+		states.emplace_back(msgbuf.str());
 	}
 
-	Flush();
+	ObjectLock olock(this);
+
+	String tempFile = GetLogDir() + "/icinga.log";
+
+	if (m_OutputFile) {
+		m_OutputFile.close();
+
+		if (rotate) {
+			String archiveFile = GetLogDir() + "/archives/icinga-" + Utility::FormatDateTime("%m-%d-%Y-%H", Utility::GetTime()) + ".log";
+
+			Log(LogNotice, "CompatLogger")
+				<< "Rotating compat log file '" << tempFile << "' -> '" << archiveFile << "'";
+
+			(void) rename(tempFile.CStr(), archiveFile.CStr());
+		}
+	}
+
+	m_OutputFile.open(tempFile.CStr(), std::ofstream::app);
+
+	if (!m_OutputFile) {
+		Log(LogWarning, "CompatLogger")
+			<< "Could not open compat log file '" << tempFile << "' for writing. Log output will be lost.";
+
+		return;
+	}
+
+	WriteLine("LOG ROTATION: " + GetRotationMethod());
+	WriteLine("LOG VERSION: 2.0");
+
+	for (const String& state : states)
+		WriteLine(state);
+
+	Flush(true);
 }
 
 void CompatLogger::ScheduleNextRotation()
@@ -612,3 +644,11 @@ void CompatLogger::ValidateRotationMethod(const Lazy<String>& lvalue, const Vali
 		BOOST_THROW_EXCEPTION(ValidationError(this, { "rotation_method" }, "Rotation method '" + lvalue() + "' is invalid."));
 	}
 }
+
+void CompatLogger::ValidateFlushInterval(const Lazy<double>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<CompatLogger>::ValidateFlushInterval(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "flush_interval" }, "Flush interval must not be negative."));
+}
@@ -25,6 +25,7 @@ public:
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
 	void ValidateRotationMethod(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+	void ValidateFlushInterval(const Lazy<double>& lvalue, const ValidationUtils& utils) override;
 
 protected:
 	void Start(bool runtimeCreated) override;
@@ -32,7 +33,7 @@ protected:
 
 private:
 	void WriteLine(const String& line);
-	void Flush();
+	void Flush(bool force = false);
 
 	void CheckResultHandler(const Checkable::Ptr& service, const CheckResult::Ptr& cr);
 	void NotificationSentHandler(const Notification::Ptr& notification, const Checkable::Ptr& service,
@@ -51,6 +52,8 @@ private:
 	void RotationTimerHandler();
 	void ScheduleNextRotation();
 
+	Timer::Ptr m_FlushTimer;
+
 	std::ofstream m_OutputFile;
 	void ReopenFile(bool rotate);
 };
@@ -4,10 +4,14 @@
 #include "compat/externalcommandlistener-ti.cpp"
 #include "icinga/externalcommandprocessor.hpp"
 #include "base/configtype.hpp"
+#include "base/configuration.hpp"
+#include "base/convert.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
 #include "base/application.hpp"
 #include "base/statsfunction.hpp"
+#include <algorithm>
+#include <functional>
 
 using namespace icinga;
 
@@ -88,6 +92,14 @@ void ExternalCommandListener::CommandPipeThread(const String& commandPath)
 		return;
 	}
 
+	/* Check results are processed in parallel, but those of one host are always processed in order by the same queue. */
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+
+	for (int i = 0; i < std::max(1, Configuration::Concurrency); i++) {
+		queues.emplace_back(new WorkQueue(25000, 1, LogNotice));
+		queues.back()->SetName("ExternalCommandListener, #" + Convert::ToString(i));
+	}
+
 	for (;;) {
 		int fd = open(commandPath.CStr(), O_RDWR | O_NONBLOCK);
 
@@ -97,18 +109,21 @@ void ExternalCommandListener::CommandPipeThread(const String& commandPath)
 			return;
 		}
 
-		FIFO::Ptr fifo = new FIFO();
 		Socket::Ptr sock = new Socket(fd);
-		StreamReadContext src;
+		std::vector<char> buffer (64 * 1024);
+		size_t length = 0;
 
 		for (;;) {
 			sock->Poll(true, false);
 
-			char buffer[8192];
+			if (length == buffer.size()) {
+				buffer.resize(buffer.size() * 2);
+			}
+
 			size_t rc;
 
 			try {
-				rc = sock->Read(buffer, sizeof(buffer));
+				rc = sock->Read(buffer.data() + length, buffer.size() - length);
 			} catch (const std::exception& ex) {
 				/* We have read all data. */
 				if (errno == EAGAIN)
@@ -123,28 +138,69 @@ void ExternalCommandListener::CommandPipeThread(const String& commandPath)
 			if (rc == 0)
 				continue;
 
-			fifo->Write(buffer, rc);
+			auto begin (buffer.data());
+			auto end (buffer.data() + length + rc);
+			auto newline (std::find(buffer.data() + length, end, '\n'));
 
-			for (;;) {
-				String command;
-				StreamReadStatus srs = fifo->ReadLine(&command, src);
+			for (; newline != end; begin = newline + 1, newline = std::find(begin, end, '\n')) {
+				auto lineEnd (newline);
 
-				if (srs != StatusNewItem)
-					break;
+				if (lineEnd != begin && lineEnd[-1] == '\r')
+					lineEnd--;
 
-				try {
-					Log(LogInformation, "ExternalCommandListener")
-						<< "Executing external command: " << command;
-
-					ExternalCommandProcessor::Execute(command);
-				} catch (const std::exception& ex) {
-					Log(LogWarning, "ExternalCommandListener")
-						<< "External command failed: " << DiagnosticInformation(ex, false);
-					Log(LogNotice, "ExternalCommandListener")
-						<< "External command failed: " << DiagnosticInformation(ex, true);
-				}
+				if (lineEnd != begin)
+					DispatchCommand(String(begin, lineEnd), queues);
 			}
+
+			length = end - begin;
+			std::copy(begin, end, buffer.data());
 		}
 	}
 }
+
+/**
+ * Executes a command read from the pipe, passive check results on the queue of their host, anything else after the
+ * queues ran empty.
+ */
+void ExternalCommandListener::DispatchCommand(const String& line, const std::vector<std::unique_ptr<WorkQueue>>& queues)
+{
+	double ts;
+	String command;
+	std::vector<String> arguments;
+
+	try {
+		ExternalCommandProcessor::ParseLine(line, ts, command, arguments);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ExternalCommandListener")
+			<< "External command failed: " << DiagnosticInformation(ex, false);
+		Log(LogNotice, "ExternalCommandListener")
+			<< "External command failed: " << DiagnosticInformation(ex, true);
+		return;
+	}
+
+	auto execute ([line, ts, command, arguments]() {
+		try {
+			Log(LogInformation, "ExternalCommandListener")
+				<< "Executing external command: " << line;
+
+			ExternalCommandProcessor::Execute(ts, command, arguments);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "ExternalCommandListener")
+				<< "External command failed: " << DiagnosticInformation(ex, false);
+			Log(LogNotice, "ExternalCommandListener")
+				<< "External command failed: " << DiagnosticInformation(ex, true);
+		}
+	});
+
+	if ((command == "PROCESS_SERVICE_CHECK_RESULT" || command == "PROCESS_HOST_CHECK_RESULT") && !arguments.empty()) {
+		queues[std::hash<String>()(arguments[0]) % queues.size()]->Enqueue(std::move(execute));
+	} else {
+		/* Any other command may affect many objects, so let previous check results be processed first. */
+		for (auto& queue : queues) {
+			queue->Join();
+		}
+
+		execute();
+	}
+}
 #endif /* _WIN32 */
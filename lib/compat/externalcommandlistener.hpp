@@ -7,8 +7,11 @@
 #include "base/objectlock.hpp"
 #include "base/timer.hpp"
 #include "base/utility.hpp"
-#include <thread>
+#include "base/workqueue.hpp"
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
 
 namespace icinga
 {
@@ -33,6 +36,7 @@ private:
 	std::thread m_CommandThread;
 
 	void CommandPipeThread(const String& commandPath);
+	static void DispatchCommand(const String& line, const std::vector<std::unique_ptr<WorkQueue>>& queues);
 #endif /* _WIN32 */
 };
 
@@ -0,0 +1,93 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef STATUSSNAPSHOT_H
+#define STATUSSNAPSHOT_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace icinga
+{
+
+/**
+ * The layout of the file StatusSnapshotWriter maps into memory. It only depends on the C++ standard library,
+ * so that local readers can include it and map the file read-only.
+ *
+ * The file starts with a StatusSnapshotHeader and contains a StatusSnapshotRecord for every possible host and
+ * service index (see ConfigObject#GetTypeIndex()), followed by their names. Records without
+ * StatusSnapshotExists are unused. All offsets are in bytes from the start of the file.
+ *
+ * The writer updates the file in place, so readers have to use the Sequence like a seqlock:
+ *
+ * 1. Load the Sequence (acquire). If it's odd, the writer is busy, try again.
+ * 2. If the Size is larger than the mapped region, map the file again.
+ * 3. Copy the needed data.
+ * 4. Load the Sequence again (after an acquire fence). If it has changed, throw the copy away and try again.
+ *
+ * @ingroup compat
+ */
+struct StatusSnapshotHeader
+{
+	char Magic[8];
+	uint32_t Version;
+	uint32_t RecordSize;
+	std::atomic<uint64_t> Sequence;
+	uint64_t Size;
+	double Timestamp;
+	uint64_t HostsOffset;
+	uint64_t HostCount;
+	uint64_t ServicesOffset;
+	uint64_t ServiceCount;
+	uint64_t NamesOffset;
+	uint64_t NamesSize;
+};
+
+static constexpr char StatusSnapshotMagic[8] = { 'I', '2', 'S', 'T', 'A', 'T', 'U', 'S' };
+static constexpr uint32_t StatusSnapshotVersion = 1;
+
+enum StatusSnapshotFlag : uint32_t
+{
+	StatusSnapshotExists = 1u << 0u,
+	StatusSnapshotActiveChecks = 1u << 1u,
+	StatusSnapshotNotifications = 1u << 2u,
+	StatusSnapshotAcknowledged = 1u << 3u,
+	StatusSnapshotInDowntime = 1u << 4u,
+	StatusSnapshotFlapping = 1u << 5u,
+	StatusSnapshotReachable = 1u << 6u,
+	StatusSnapshotProblem = 1u << 7u,
+	StatusSnapshotHandled = 1u << 8u,
+	StatusSnapshotHasBeenChecked = 1u << 9u
+};
+
+/**
+ * The state of a host or service. Hosts use the HostState values, services the ServiceState ones.
+ *
+ * @ingroup compat
+ */
+struct StatusSnapshotRecord
+{
+	/* The full name (e.g. "host!service"), not NUL-terminated, in the names after NamesOffset. */
+	uint32_t NameOffset;
+	uint32_t NameLength;
+	/* For services the index of their host's record. */
+	uint32_t HostIndex;
+	uint32_t Flags;
+	uint8_t State;
+	uint8_t LastHardState;
+	uint8_t StateType;
+	uint8_t Reserved;
+	uint32_t CheckAttempt;
+	double LastCheck;
+	double NextCheck;
+	double LastStateChange;
+	double LastHardStateChange;
+	double ExecutionTime;
+	double Latency;
+};
+
+static_assert(sizeof(StatusSnapshotRecord) == 72, "StatusSnapshotRecord layout must not change without a new version");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The Sequence must be usable across processes");
+
+}
+
+#endif /* STATUSSNAPSHOT_H */
@@ -0,0 +1,249 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "compat/statussnapshotwriter.hpp"
+#include "compat/statussnapshotwriter-ti.cpp"
+#include "icinga/host.hpp"
+#include "icinga/service.hpp"
+#include "base/configtype.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/statsfunction.hpp"
+#include "base/utility.hpp"
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <cstring>
+#include <fstream>
+#include <new>
+
+using namespace icinga;
+
+REGISTER_TYPE(StatusSnapshotWriter);
+
+REGISTER_STATSFUNCTION(StatusSnapshotWriter, &StatusSnapshotWriter::StatsFunc);
+
+void StatusSnapshotWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+{
+	DictionaryData nodes;
+
+	for (const StatusSnapshotWriter::Ptr& writer : ConfigType::GetObjectsByType<StatusSnapshotWriter>()) {
+		nodes.emplace_back(writer->GetName(), 1); // add more stats
+	}
+
+	status->Set("statussnapshotwriter", new Dictionary(std::move(nodes)));
+}
+
+void StatusSnapshotWriter::Start(bool runtimeCreated)
+{
+	ObjectImpl<StatusSnapshotWriter>::Start(runtimeCreated);
+
+	Log(LogInformation, "StatusSnapshotWriter")
+		<< "'" << GetName() << "' started.";
+
+	m_UpdateTimer = Timer::Create();
+	m_UpdateTimer->SetInterval(GetUpdateInterval());
+	m_UpdateTimer->OnTimerExpired.connect([this](const Timer * const&) { UpdateSnapshot(); });
+	m_UpdateTimer->Start();
+	m_UpdateTimer->Reschedule(0);
+}
+
+void StatusSnapshotWriter::Stop(bool runtimeRemoved)
+{
+	m_UpdateTimer->Stop(true);
+
+	/* The file is kept, so that readers can keep their mapping across reloads. */
+	m_Region = boost::interprocess::mapped_region();
+
+	Log(LogInformation, "StatusSnapshotWriter")
+		<< "'" << GetName() << "' stopped.";
+
+	ObjectImpl<StatusSnapshotWriter>::Stop(runtimeRemoved);
+}
+
+void StatusSnapshotWriter::UpdateSnapshot()
+{
+	double start = Utility::GetTime();
+
+	/* Objects registered after this get into the next snapshot. */
+	m_Hosts.assign(ConfigType::Get<Host>()->GetTypeIndexCount(), StatusSnapshotRecord());
+	m_Services.assign(ConfigType::Get<Service>()->GetTypeIndexCount(), StatusSnapshotRecord());
+	m_Names.clear();
+
+	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
+		size_t index = host->GetTypeIndex();
+
+		if (index >= m_Hosts.size())
+			continue;
+
+		auto& record (m_Hosts[index]);
+
+		FillRecord(record, host);
+		record.HostIndex = index;
+		record.State = host->GetState();
+		record.LastHardState = host->GetLastHardState();
+	}
+
+	for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>()) {
+		size_t index = service->GetTypeIndex();
+
+		if (index >= m_Services.size())
+			continue;
+
+		auto& record (m_Services[index]);
+
+		FillRecord(record, service);
+		record.HostIndex = service->GetHost()->GetTypeIndex();
+		record.State = service->GetState();
+		record.LastHardState = service->GetLastHardState();
+	}
+
+	uint64_t hostsOffset = (sizeof(StatusSnapshotHeader) + 63u) / 64u * 64u;
+	uint64_t servicesOffset = hostsOffset + m_Hosts.size() * sizeof(StatusSnapshotRecord);
+	uint64_t namesOffset = servicesOffset + m_Services.size() * sizeof(StatusSnapshotRecord);
+
+	StatusSnapshotHeader *header;
+
+	try {
+		header = MapFile(namesOffset + m_Names.size());
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "StatusSnapshotWriter")
+			<< "Cannot map status snapshot file '" << GetPath() << "': " << DiagnosticInformation(ex, false);
+		return;
+	}
+
+	auto base (static_cast<char *>(m_Region.get_address()));
+
+	/* An odd sequence is left over if the previous process died while writing. */
+	auto sequence (header->Sequence.load(std::memory_order_relaxed));
+	sequence += sequence & 1u;
+
+	header->Sequence.store(sequence + 1u, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	header->Size = m_Region.get_size();
+	header->Timestamp = Utility::GetTime();
+	header->HostsOffset = hostsOffset;
+	header->HostCount = m_Hosts.size();
+	header->ServicesOffset = servicesOffset;
+	header->ServiceCount = m_Services.size();
+	header->NamesOffset = namesOffset;
+	header->NamesSize = m_Names.size();
+
+	if (!m_Hosts.empty())
+		memcpy(base + hostsOffset, m_Hosts.data(), m_Hosts.size() * sizeof(StatusSnapshotRecord));
+
+	if (!m_Services.empty())
+		memcpy(base + servicesOffset, m_Services.data(), m_Services.size() * sizeof(StatusSnapshotRecord));
+
+	if (!m_Names.empty())
+		memcpy(base + namesOffset, m_Names.data(), m_Names.size());
+
+	header->Sequence.store(sequence + 2u, std::memory_order_release);
+
+	Log(LogDebug, "StatusSnapshotWriter")
+		<< "Wrote status snapshot with " << m_Hosts.size() << " host and " << m_Services.size()
+		<< " service records in " << Utility::GetTime() - start << " seconds.";
+}
+
+void StatusSnapshotWriter::FillRecord(StatusSnapshotRecord& record, const Checkable::Ptr& checkable)
+{
+	String name = checkable->GetName();
+
+	record.NameOffset = m_Names.size();
+	record.NameLength = name.GetLength();
+	m_Names.append(name.GetData());
+
+	uint32_t flags = StatusSnapshotExists;
+
+	if (checkable->GetEnableActiveChecks())
+		flags |= StatusSnapshotActiveChecks;
+
+	if (checkable->GetEnableNotifications())
+		flags |= StatusSnapshotNotifications;
+
+	if (checkable->IsAcknowledged())
+		flags |= StatusSnapshotAcknowledged;
+
+	if (checkable->IsInDowntime())
+		flags |= StatusSnapshotInDowntime;
+
+	if (checkable->IsFlapping())
+		flags |= StatusSnapshotFlapping;
+
+	if (checkable->IsReachable())
+		flags |= StatusSnapshotReachable;
+
+	if (checkable->GetProblem())
+		flags |= StatusSnapshotProblem;
+
+	if (checkable->GetHandled())
+		flags |= StatusSnapshotHandled;
+
+	CheckResult::Ptr cr = checkable->GetLastCheckResult();
+
+	if (cr) {
+		flags |= StatusSnapshotHasBeenChecked;
+		record.ExecutionTime = cr->CalculateExecutionTime();
+		record.Latency = cr->CalculateLatency();
+	}
+
+	record.Flags = flags;
+	record.StateType = checkable->GetStateType();
+	record.CheckAttempt = checkable->GetCheckAttempt();
+	record.LastCheck = checkable->GetLastCheck();
+	record.NextCheck = checkable->GetNextCheck();
+	record.LastStateChange = checkable->GetLastStateChange();
+	record.LastHardStateChange = checkable->GetLastHardStateChange();
+}
+
+/**
+ * Makes sure that the file is at least this large and mapped, and that it starts with a header.
+ */
+StatusSnapshotHeader *StatusSnapshotWriter::MapFile(uint64_t size)
+{
+	namespace bip = boost::interprocess;
+	namespace fs = boost::filesystem;
+
+	if (m_Region.get_address() && m_Region.get_size() >= size)
+		return static_cast<StatusSnapshotHeader *>(m_Region.get_address());
+
+	/* Unmap before resizing the file, Windows doesn't allow resizing mapped files. */
+	m_Region = bip::mapped_region();
+
+	String path = GetPath();
+
+	if (!fs::exists(path.GetData())) {
+		std::ofstream fp (path.CStr(), std::ofstream::binary);
+
+		if (!fp)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Cannot create file"));
+	}
+
+	if (fs::file_size(path.GetData()) < size) {
+		/* Leave some room for new objects, so that readers don't have to map the file again all the time. */
+		fs::resize_file(path.GetData(), (size + size / 4u + 4095u) / 4096u * 4096u);
+	}
+
+	bip::file_mapping file (path.CStr(), bip::read_write);
+	bip::mapped_region(file, bip::read_write).swap(m_Region);
+
+	auto header (static_cast<StatusSnapshotHeader *>(m_Region.get_address()));
+
+	if (memcmp(header->Magic, StatusSnapshotMagic, sizeof(header->Magic)) || header->Version != StatusSnapshotVersion
+		|| header->RecordSize != sizeof(StatusSnapshotRecord)) {
+		new (header) StatusSnapshotHeader();
+
+		memcpy(header->Magic, StatusSnapshotMagic, sizeof(header->Magic));
+		header->Version = StatusSnapshotVersion;
+		header->RecordSize = sizeof(StatusSnapshotRecord);
+	}
+
+	return header;
+}
+
+void StatusSnapshotWriter::ValidateUpdateInterval(const Lazy<double>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<StatusSnapshotWriter>::ValidateUpdateInterval(lvalue, utils);
+
+	if (lvalue() <= 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "update_interval" }, "Interval must be greater than 0."));
+}
@@ -0,0 +1,53 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef STATUSSNAPSHOTWRITER_H
+#define STATUSSNAPSHOTWRITER_H
+
+#include "compat/statussnapshotwriter-ti.hpp"
+#include "compat/statussnapshot.hpp"
+#include "icinga/checkable.hpp"
+#include "base/timer.hpp"
+#include <boost/interprocess/mapped_region.hpp>
+#include <string>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * Publishes the state of all hosts and services in a memory-mapped file (see StatusSnapshotHeader),
+ * so that local tools can read it without asking the daemon.
+ *
+ * @ingroup compat
+ */
+class StatusSnapshotWriter final : public ObjectImpl<StatusSnapshotWriter>
+{
+public:
+	DECLARE_OBJECT(StatusSnapshotWriter);
+	DECLARE_OBJECTNAME(StatusSnapshotWriter);
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+	void ValidateUpdateInterval(const Lazy<double>& lvalue, const ValidationUtils& utils) override;
+
+protected:
+	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
+
+private:
+	Timer::Ptr m_UpdateTimer;
+	boost::interprocess::mapped_region m_Region;
+
+	/* Reused by every update */
+	std::vector<StatusSnapshotRecord> m_Hosts;
+	std::vector<StatusSnapshotRecord> m_Services;
+	std::string m_Names;
+
+	void UpdateSnapshot();
+	void FillRecord(StatusSnapshotRecord& record, const Checkable::Ptr& checkable);
+	StatusSnapshotHeader *MapFile(uint64_t size);
+};
+
+}
+
+#endif /* STATUSSNAPSHOTWRITER_H */
@@ -1,12 +1,40 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "config/activationcontext.hpp"
+#include "config/configitem.hpp"
 #include "base/exception.hpp"
 
 using namespace icinga;
 
 boost::thread_specific_ptr<std::stack<ActivationContext::Ptr> > ActivationContext::m_ActivationStack;
 
+ActivationContext::ActivationContext()
+	: m_Scratch(false)
+{
+}
+
+/**
+ * Creates a scratch context, see ConfigItem::ValidateScratchItems().
+ *
+ * @param replacedPackage The package whose objects the items in this context replace
+ */
+ActivationContext::ActivationContext(String replacedPackage)
+	: m_Scratch(true), m_ReplacedPackage(std::move(replacedPackage))
+{
+}
+
+ActivationContext::~ActivationContext() = default;
+
+bool ActivationContext::IsScratch() const
+{
+	return m_Scratch;
+}
+
+const String& ActivationContext::GetReplacedPackage() const
+{
+	return m_ReplacedPackage;
+}
+
 std::stack<ActivationContext::Ptr>& ActivationContext::GetActivationStack()
 {
 	std::stack<ActivationContext::Ptr> *actx = m_ActivationStack.get();
@@ -40,6 +68,19 @@ ActivationContext::Ptr ActivationContext::GetCurrentContext()
 	return astack.top();
 }
 
+/**
+ * Returns the current context if it's a scratch one, nullptr otherwise.
+ */
+ActivationContext::Ptr ActivationContext::GetScratchContext()
+{
+	std::stack<ActivationContext::Ptr>& astack = GetActivationStack();
+
+	if (astack.empty() || !astack.top()->m_Scratch)
+		return nullptr;
+
+	return astack.top();
+}
+
 ActivationScope::ActivationScope(ActivationContext::Ptr context)
 	: m_Context(std::move(context))
 {
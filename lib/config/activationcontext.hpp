@@ -5,20 +5,42 @@
 
 #include "config/i2-config.hpp"
 #include "base/object.hpp"
+#include "base/string.hpp"
+#include "base/type.hpp"
 #include <boost/thread/tss.hpp>
+#include <map>
 #include <stack>
+#include <vector>
 
 namespace icinga
 {
 
+class ConfigItem;
+
 class ActivationContext final : public Object
 {
 public:
 	DECLARE_PTR_TYPEDEFS(ActivationContext);
 
+	ActivationContext();
+	explicit ActivationContext(String replacedPackage);
+	~ActivationContext() override;
+
+	bool IsScratch() const;
+	const String& GetReplacedPackage() const;
+
 	static ActivationContext::Ptr GetCurrentContext();
+	static ActivationContext::Ptr GetScratchContext();
 
 private:
+	/* A scratch context keeps its items to itself instead of registering them globally,
+	 * so that they can be validated against the running config without affecting it.
+	 */
+	bool m_Scratch;
+	String m_ReplacedPackage;
+	std::map<Type::Ptr, std::map<String, intrusive_ptr<ConfigItem>>> m_ScratchItems;
+	std::vector<intrusive_ptr<ConfigItem>> m_ScratchUnnamedItems;
+
 	static void PushContext(const ActivationContext::Ptr& context);
 	static void PopContext();
 
@@ -27,6 +49,7 @@ private:
 	static boost::thread_specific_ptr<std::stack<ActivationContext::Ptr> > m_ActivationStack;
 
 	friend class ActivationScope;
+	friend class ConfigItem;
 };
 
 class ActivationScope
@@ -3,6 +3,7 @@
 #include "base/string.hpp"
 #include "config/applyrule.hpp"
 #include "config/expression.hpp"
+#include <cctype>
 #include <utility>
 #include <vector>
 
@@ -50,6 +51,99 @@ const std::set<ApplyRule::Ptr>& ApplyRule::GetTargetedServiceRules(const Type::P
 	return noRules;
 }
 
+/**
+ * mmatch(), which match() is based on, compares characters case-insensitively.
+ */
+String ApplyRule::MatchLower(const String& text)
+{
+	String result (text);
+
+	for (auto& ch : result) {
+		ch = std::tolower(static_cast<unsigned char>(ch));
+	}
+
+	return result;
+}
+
+/**
+ * @returns All ApplyRules for the given target type whose filter can only be true for the given (parent) host
+ * and which are indexed by one of its properties. (See AddIndexedRule().)
+ */
+std::set<ApplyRule::Ptr> ApplyRule::GetIndexedRules(const Type::Ptr& sourceType, const Type::Ptr& targetType,
+	const String& host, const Array::Ptr& groups, const Dictionary::Ptr& vars)
+{
+	std::set<ApplyRule::Ptr> result;
+	auto perSourceType (m_Rules.find(sourceType.get()));
+
+	if (perSourceType == m_Rules.end()) {
+		return result;
+	}
+
+	auto perTargetType (perSourceType->second.Indexed.find(targetType.get()));
+
+	if (perTargetType == perSourceType->second.Indexed.end()) {
+		return result;
+	}
+
+	auto& index (perTargetType->second);
+
+	auto add ([&result](const std::set<ApplyRule::Ptr>& rules) {
+		result.insert(rules.begin(), rules.end());
+	});
+
+	auto byName (index.ByName.find(host));
+
+	if (byName != index.ByName.end()) {
+		add(byName->second);
+	}
+
+	if (!index.ByNamePrefix.empty()) {
+		String lowerHost (MatchLower(host));
+
+		for (String::SizeType i = 0; i <= lowerHost.GetLength(); i++) {
+			auto byPrefix (index.ByNamePrefix.find(lowerHost.SubStr(0, i)));
+
+			if (byPrefix != index.ByNamePrefix.end()) {
+				add(byPrefix->second);
+			}
+		}
+	}
+
+	if (groups && !index.ByGroup.empty()) {
+		ObjectLock oLock (groups);
+
+		for (auto& group : groups) {
+			if (group.IsString()) {
+				auto byGroup (index.ByGroup.find(group.Get<String>()));
+
+				if (byGroup != index.ByGroup.end()) {
+					add(byGroup->second);
+				}
+			}
+		}
+	}
+
+	if (vars && !index.ByVar.empty()) {
+		ObjectLock oLock (vars);
+
+		for (auto& kv : vars) {
+			if (kv.second.IsString()) {
+				auto byVar (index.ByVar.find(kv.first));
+
+				if (byVar != index.ByVar.end()) {
+					auto byValue (byVar->second.find(kv.second.Get<String>()));
+
+					if (byValue != byVar->second.end()) {
+						add(byValue->second);
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
 /**
  * If the given ApplyRule targets only specific parent objects, add it to the respective "index".
  *
@@ -87,6 +181,184 @@ bool ApplyRule::AddTargetedRule(const ApplyRule::Ptr& rule, const String& target
 	return false;
 }
 
+/**
+ * If the given ApplyRule's filter can only be true for hosts with specific properties, add it to the host index.
+ *
+ * A filter is indexable if it is one of the following or combines them via || (all operands indexable)
+ * or && (any operand indexable):
+ *
+ * - host.name == "H"
+ * - match("P*", host.name)
+ * - "G" in host.groups
+ * - host.vars.K == "V"
+ *
+ * The filter is still evaluated in full for every host found in the index.
+ *
+ * @returns Whether the rule has been added to the index.
+ */
+bool ApplyRule::AddIndexedRule(const ApplyRule::Ptr& rule, const String& targetType, ApplyRule::PerSourceType& rules)
+{
+	if (targetType != "Host" && targetType != "Service") {
+		return false;
+	}
+
+	/* The index is about the host the filter sees as "host". */
+	if (rule->m_FKVar == "host" || rule->m_FVVar == "host") {
+		return false;
+	}
+
+	bool allowMatch = rule->m_FKVar != "match" && rule->m_FVVar != "match" && !(rule->m_Scope && rule->m_Scope->Contains("match"));
+	IndexKeys keys;
+
+	if (!GetIndexKeys(rule->m_Filter.get(), keys, allowMatch)) {
+		return false;
+	}
+
+	auto& index (rules.Indexed[Type::GetByName(targetType).get()]);
+
+	for (auto name : keys.Names) {
+		index.ByName[*name].emplace(rule);
+	}
+
+	for (auto& prefix : keys.NamePrefixes) {
+		index.ByNamePrefix[prefix].emplace(rule);
+	}
+
+	for (auto group : keys.Groups) {
+		index.ByGroup[*group].emplace(rule);
+	}
+
+	for (auto& var : keys.Vars) {
+		index.ByVar[*var.first][*var.second].emplace(rule);
+	}
+
+	return true;
+}
+
+/**
+ * Collects the host properties the given assign filter requires into keys. (See AddIndexedRule().)
+ *
+ * @returns Whether the given assign filter is indexable.
+ */
+bool ApplyRule::GetIndexKeys(Expression* assignFilter, ApplyRule::IndexKeys& keys, bool allowMatch)
+{
+	auto lor (dynamic_cast<LogicalOrExpression*>(assignFilter));
+
+	if (lor) {
+		return GetIndexKeys(lor->GetOperand1().get(), keys, allowMatch)
+			&& GetIndexKeys(lor->GetOperand2().get(), keys, allowMatch);
+	}
+
+	auto land (dynamic_cast<LogicalAndExpression*>(assignFilter));
+
+	if (land) {
+		for (auto op : { land->GetOperand1().get(), land->GetOperand2().get() }) {
+			IndexKeys opKeys;
+
+			if (GetIndexKeys(op, opKeys, allowMatch)) {
+				keys.Names.insert(keys.Names.end(), opKeys.Names.begin(), opKeys.Names.end());
+				keys.NamePrefixes.insert(keys.NamePrefixes.end(), opKeys.NamePrefixes.begin(), opKeys.NamePrefixes.end());
+				keys.Groups.insert(keys.Groups.end(), opKeys.Groups.begin(), opKeys.Groups.end());
+				keys.Vars.insert(keys.Vars.end(), opKeys.Vars.begin(), opKeys.Vars.end());
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	auto name (GetComparedName(assignFilter, "host", nullptr));
+
+	if (name) {
+		keys.Names.emplace_back(name);
+		return true;
+	}
+
+	auto in (dynamic_cast<InExpression*>(assignFilter));
+
+	if (in) {
+		auto group (GetConstString(in->GetOperand1().get(), nullptr));
+
+		if (group && !group->IsEmpty() && IsHostIndexer(in->GetOperand2().get(), "groups")) {
+			keys.Groups.emplace_back(group);
+			return true;
+		}
+
+		return false;
+	}
+
+	auto eq (dynamic_cast<EqualExpression*>(assignFilter));
+
+	if (eq) {
+		auto op1 (eq->GetOperand1().get());
+		auto op2 (eq->GetOperand2().get());
+		auto value (GetConstString(op2, nullptr));
+
+		if (!value) {
+			std::swap(op1, op2);
+			value = GetConstString(op2, nullptr);
+		}
+
+		/* An empty string also equals a missing custom var. */
+		if (!value || value->IsEmpty()) {
+			return false;
+		}
+
+		auto ixr (dynamic_cast<IndexerExpression*>(op1));
+
+		if (ixr && IsHostIndexer(ixr->GetOperand1().get(), "vars")) {
+			auto var (GetConstString(ixr->GetOperand2().get(), nullptr));
+
+			if (var) {
+				keys.Vars.emplace_back(var, value);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	auto call (dynamic_cast<FunctionCallExpression*>(assignFilter));
+
+	if (call && allowMatch && call->m_Args.size() == 2u) {
+		auto func (dynamic_cast<VariableExpression*>(call->m_FName.get()));
+		auto pattern (GetConstString(call->m_Args[0].get(), nullptr));
+
+		if (func && func->GetVariable() == "match" && pattern && !pattern->IsEmpty() && IsHostIndexer(call->m_Args[1].get(), "name")) {
+			auto wildcard (pattern->FindFirstOf("*?\\"));
+
+			if (wildcard == pattern->GetLength() - 1u && (*pattern)[wildcard] == '*') {
+				keys.NamePrefixes.emplace_back(MatchLower(pattern->SubStr(0, wildcard)));
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @returns Whether the given expression is like host.$field$.
+ */
+bool ApplyRule::IsHostIndexer(Expression* exp, const char * field)
+{
+	auto ixr (dynamic_cast<IndexerExpression*>(exp));
+
+	if (!ixr) {
+		return false;
+	}
+
+	auto var (dynamic_cast<VariableExpression*>(ixr->GetOperand1().get()));
+
+	if (!var || var->GetVariable() != "host") {
+		return false;
+	}
+
+	auto val (GetConstString(ixr->GetOperand2().get(), nullptr));
+
+	return val && *val == field;
+}
+
 /**
  * If the given assign filter is like the following, extract the host names ("H", "h", ...) into the vector:
  *
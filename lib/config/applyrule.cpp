@@ -1,6 +1,8 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "config/applyrule.hpp"
+#include "config/activationcontext.hpp"
+#include "config/bytecode.hpp"
 #include "base/logger.hpp"
 #include <set>
 #include <unordered_set>
@@ -15,7 +17,10 @@ ApplyRule::ApplyRule(String name, Expression::Ptr expression,
 	bool ignoreOnError, DebugInfo di, Dictionary::Ptr scope)
 	: m_Name(std::move(name)), m_Expression(std::move(expression)), m_Filter(std::move(filter)), m_Package(std::move(package)), m_FKVar(std::move(fkvar)),
 	m_FVVar(std::move(fvvar)), m_FTerm(std::move(fterm)), m_IgnoreOnError(ignoreOnError), m_DebugInfo(std::move(di)), m_Scope(std::move(scope)), m_HasMatches(false)
-{ }
+{
+	/* m_Filter is kept as is for the targeted rule detection. */
+	m_CompiledFilter = BytecodeExpression::Compile(m_Filter);
+}
 
 String ApplyRule::GetName() const
 {
@@ -61,6 +66,10 @@ void ApplyRule::AddRule(const String& sourceType, const String& targetType, cons
 	const Expression::Ptr& expression, const Expression::Ptr& filter, const String& package, const String& fkvar,
 	const String& fvvar, const Expression::Ptr& fterm, bool ignoreOnError, const DebugInfo& di, const Dictionary::Ptr& scope)
 {
+	/* The rules of a scratch context would apply to the running config, see ConfigItem::ValidateScratchItems(). */
+	if (ActivationContext::GetScratchContext())
+		return;
+
 	auto actualTargetType (&targetType);
 
 	if (*actualTargetType == "") {
@@ -74,14 +83,14 @@ void ApplyRule::AddRule(const String& sourceType, const String& targetType, cons
 	ApplyRule::Ptr rule = new ApplyRule(name, expression, filter, package, fkvar, fvvar, fterm, ignoreOnError, di, scope);
 	auto& rules (m_Rules[Type::GetByName(sourceType).get()]);
 
-	if (!AddTargetedRule(rule, *actualTargetType, rules)) {
+	if (!AddTargetedRule(rule, *actualTargetType, rules) && !AddIndexedRule(rule, *actualTargetType, rules)) {
 		rules.Regular[Type::GetByName(*actualTargetType).get()].emplace_back(std::move(rule));
 	}
 }
 
 bool ApplyRule::EvaluateFilter(ScriptFrame& frame) const
 {
-	return Convert::ToBool(m_Filter->Evaluate(frame));
+	return Convert::ToBool(m_CompiledFilter->Evaluate(frame));
 }
 
 void ApplyRule::RegisterType(const String& sourceType, const std::vector<String>& targetTypes)
@@ -173,6 +182,26 @@ void ApplyRule::CheckMatches(bool silent)
 			}
 		}
 
+		for (auto& perTargetType : perSourceType.second.Indexed) {
+			auto& index (perTargetType.second);
+
+			for (auto perKey : { &index.ByName, &index.ByNamePrefix, &index.ByGroup }) {
+				for (auto& rules : *perKey) {
+					for (auto& rule : rules.second) {
+						targeted.emplace(rule.get());
+					}
+				}
+			}
+
+			for (auto& perVar : index.ByVar) {
+				for (auto& perValue : perVar.second) {
+					for (auto& rule : perValue.second) {
+						targeted.emplace(rule.get());
+					}
+				}
+			}
+		}
+
 		for (auto rule : targeted) {
 			CheckMatches(rule, perSourceType.first, silent);
 		}
@@ -28,10 +28,19 @@ public:
 		std::unordered_map<String /* service */, std::set<ApplyRule::Ptr>> ForServices;
 	};
 
+	struct HostIndex
+	{
+		std::unordered_map<String /* host */, std::set<ApplyRule::Ptr>> ByName;
+		std::unordered_map<String /* lower case host name prefix */, std::set<ApplyRule::Ptr>> ByNamePrefix;
+		std::unordered_map<String /* host group */, std::set<ApplyRule::Ptr>> ByGroup;
+		std::unordered_map<String /* custom var */, std::unordered_map<String /* value */, std::set<ApplyRule::Ptr>>> ByVar;
+	};
+
 	struct PerSourceType
 	{
 		std::unordered_map<Type* /* target type */, std::vector<ApplyRule::Ptr>> Regular;
 		std::unordered_map<String /* host */, PerHost> Targeted;
+		std::unordered_map<Type* /* target type */, HostIndex> Indexed;
 	};
 
 	/*
@@ -45,6 +54,13 @@ public:
 	 * which target only specific services on specific hosts,
 	 * e.g. via assign where host.name == "H" && service.name == "S".
 	 *
+	 * m_Rules[T::TypeInstance.get()].Indexed[C::TypeInstance.get()]
+	 * contains all apply rules like apply T "x" to C { ... } whose
+	 * filter requires the (parent) host to have a specific name, name
+	 * prefix, group or custom var value, e.g. via
+	 * assign where "linux" in host.groups && host.vars.env == "prod".
+	 * These are only evaluated for hosts found in the index.
+	 *
 	 * m_Rules[T::TypeInstance.get()].Regular[C::TypeInstance.get()]
 	 * contains all other apply rules like apply T "x" to C { ... }.
 	 */
@@ -82,6 +98,8 @@ public:
 	static const std::vector<ApplyRule::Ptr>& GetRules(const Type::Ptr& sourceType, const Type::Ptr& targetType);
 	static const std::set<ApplyRule::Ptr>& GetTargetedHostRules(const Type::Ptr& sourceType, const String& host);
 	static const std::set<ApplyRule::Ptr>& GetTargetedServiceRules(const Type::Ptr& sourceType, const String& host, const String& service);
+	static std::set<ApplyRule::Ptr> GetIndexedRules(const Type::Ptr& sourceType, const Type::Ptr& targetType,
+		const String& host, const Array::Ptr& groups, const Dictionary::Ptr& vars);
 	static bool GetTargetHosts(Expression* assignFilter, std::vector<const String *>& hosts, const Dictionary::Ptr& constants = nullptr);
 	static bool GetTargetServices(Expression* assignFilter, std::vector<std::pair<const String *, const String *>>& services, const Dictionary::Ptr& constants = nullptr);
 
@@ -93,10 +111,22 @@ public:
 	static void CheckMatches(bool silent);
 	static void CheckMatches(const ApplyRule::Ptr& rule, Type* sourceType, bool silent);
 
+	struct IndexKeys
+	{
+		std::vector<const String *> Names;
+		std::vector<String> NamePrefixes;
+		std::vector<const String *> Groups;
+		std::vector<std::pair<const String *, const String *>> Vars;
+	};
+
+	static bool GetIndexKeys(Expression* assignFilter, IndexKeys& keys, bool allowMatch);
+	static String MatchLower(const String& text);
+
 private:
 	String m_Name;
 	Expression::Ptr m_Expression;
 	Expression::Ptr m_Filter;
+	Expression::Ptr m_CompiledFilter;
 	String m_Package;
 	String m_FKVar;
 	String m_FVVar;
@@ -110,6 +140,8 @@ private:
 	static RuleMap m_Rules;
 
 	static bool AddTargetedRule(const ApplyRule::Ptr& rule, const String& targetType, PerSourceType& rules);
+	static bool AddIndexedRule(const ApplyRule::Ptr& rule, const String& targetType, PerSourceType& rules);
+	static bool IsHostIndexer(Expression* exp, const char * field);
 	static std::pair<const String *, const String *> GetTargetService(Expression* assignFilter, const Dictionary::Ptr& constants);
 	static const String * GetComparedName(Expression* assignFilter, const char * lcType, const Dictionary::Ptr& constants);
 	static bool IsNameIndexer(Expression* exp, const char * lcType, const Dictionary::Ptr& constants);
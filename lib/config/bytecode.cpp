@@ -0,0 +1,707 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "config/bytecode.hpp"
+#include "config/vmops.hpp"
+#include "base/json.hpp"
+#include "base/scriptglobal.hpp"
+#include <boost/exception_ptr.hpp>
+#include <boost/exception/errinfo_nested_exception.hpp>
+#include <map>
+#include <typeindex>
+#include <unordered_map>
+
+using namespace icinga;
+
+static const std::unordered_map<std::type_index, BytecodeOp> l_BinaryOps {
+	{ typeid(AddExpression), OpAdd },
+	{ typeid(SubtractExpression), OpSubtract },
+	{ typeid(MultiplyExpression), OpMultiply },
+	{ typeid(DivideExpression), OpDivide },
+	{ typeid(ModuloExpression), OpModulo },
+	{ typeid(XorExpression), OpXor },
+	{ typeid(BinaryAndExpression), OpBinaryAnd },
+	{ typeid(BinaryOrExpression), OpBinaryOr },
+	{ typeid(ShiftLeftExpression), OpShiftLeft },
+	{ typeid(ShiftRightExpression), OpShiftRight },
+	{ typeid(EqualExpression), OpEqual },
+	{ typeid(NotEqualExpression), OpNotEqual },
+	{ typeid(LessThanExpression), OpLessThan },
+	{ typeid(GreaterThanExpression), OpGreaterThan },
+	{ typeid(LessThanOrEqualExpression), OpLessThanOrEqual },
+	{ typeid(GreaterThanOrEqualExpression), OpGreaterThanOrEqual }
+};
+
+/* Registers up to this count live on the stack during an evaluation. */
+static const int l_InlineRegisters = 16;
+
+/* Number of variable slots whose loaded state fits into the slot mask. */
+static const size_t l_MaxSlots = 64;
+
+struct BytecodeExpression::Compiler
+{
+	/* Variable name -> (register, bit in the slot mask) */
+	std::map<String, std::pair<int, int> > Slots;
+	size_t Evals{0};
+};
+
+static inline Value ApplyUnary(BytecodeOp op, const Value& operand)
+{
+	if (op == OpNegate)
+		return ~(long)operand;
+	else
+		return !operand.ToBool();
+}
+
+static inline Value ApplyBinary(BytecodeOp op, const Value& operand1, const Value& operand2)
+{
+	switch (op) {
+		case OpAdd:
+			return operand1 + operand2;
+		case OpSubtract:
+			return operand1 - operand2;
+		case OpMultiply:
+			return operand1 * operand2;
+		case OpDivide:
+			return operand1 / operand2;
+		case OpModulo:
+			return operand1 % operand2;
+		case OpXor:
+			return operand1 ^ operand2;
+		case OpBinaryAnd:
+			return operand1 & operand2;
+		case OpBinaryOr:
+			return operand1 | operand2;
+		case OpShiftLeft:
+			return operand1 << operand2;
+		case OpShiftRight:
+			return operand1 >> operand2;
+		case OpEqual:
+			return operand1 == operand2;
+		case OpNotEqual:
+			return operand1 != operand2;
+		case OpLessThan:
+			return operand1 < operand2;
+		case OpGreaterThan:
+			return operand1 > operand2;
+		case OpLessThanOrEqual:
+			return operand1 <= operand2;
+		case OpGreaterThanOrEqual:
+			return operand1 >= operand2;
+		default:
+			VERIFY(!"Invalid binary operator.");
+	}
+}
+
+/**
+ * Compiles an expression. Returns the original expression if the compiler
+ * doesn't support enough of it for the bytecode to be of any use.
+ *
+ * @param expression The expression
+ * @returns The compiled expression, or the original one
+ */
+Expression::Ptr BytecodeExpression::Compile(Expression::Ptr expression)
+{
+	if (!expression)
+		return expression;
+
+	auto *program (new BytecodeExpression());
+	Expression::Ptr compiled (program);
+
+	if (!program->CompileProgram(expression.get()))
+		return expression;
+
+	program->m_Expression = std::move(expression);
+	return compiled;
+}
+
+std::unique_ptr<Expression> BytecodeExpression::Compile(std::unique_ptr<Expression> expression)
+{
+	if (!expression)
+		return expression;
+
+	std::unique_ptr<BytecodeExpression> program (new BytecodeExpression());
+
+	if (!program->CompileProgram(expression.get()))
+		return expression;
+
+	program->m_Expression = expression.release();
+	return std::move(program);
+}
+
+const Expression::Ptr& BytecodeExpression::GetExpression() const
+{
+	return m_Expression;
+}
+
+size_t BytecodeExpression::GetInstructionCount() const
+{
+	return m_Code.size();
+}
+
+const DebugInfo& BytecodeExpression::GetDebugInfo() const
+{
+	return m_Expression->GetDebugInfo();
+}
+
+bool BytecodeExpression::GetReference(ScriptFrame& frame, bool init_dict, Value *parent, String *index, DebugHint **dhint) const
+{
+	return m_Expression->GetReference(frame, init_dict, parent, index, dhint);
+}
+
+bool BytecodeExpression::CompileProgram(const Expression *root)
+{
+	Compiler compiler;
+
+	m_Result = CompileNode(compiler, root);
+
+	/* A program which consists of nothing but fallbacks is just a slower AST. */
+	return compiler.Evals == 0 || compiler.Evals < m_Code.size();
+}
+
+int BytecodeExpression::CompileNode(Compiler& compiler, const Expression *expression)
+{
+	const std::type_info& type (typeid(*expression));
+
+	auto binaryOp (l_BinaryOps.find(type));
+
+	if (binaryOp != l_BinaryOps.end()) {
+		auto binary (static_cast<const BinaryExpression *>(expression));
+
+		int operand1 = CompileNode(compiler, binary->GetOperand1().get());
+		int operand2 = CompileNode(compiler, binary->GetOperand2().get());
+		const Value *constant1 = GetConstant(operand1);
+		const Value *constant2 = GetConstant(operand2);
+
+		if (constant1 && constant2 && !constant1->IsObject() && !constant2->IsObject()) {
+			try {
+				return AddConstant(ApplyBinary(binaryOp->second, *constant1, *constant2));
+			} catch (const std::exception&) {
+				/* Leave the error to the evaluation. */
+			}
+		}
+
+		int dst = AddRegister();
+		Emit(binaryOp->second, dst, operand1, operand2, 0, 0, expression);
+		return dst;
+	}
+
+	if (type == typeid(LiteralExpression))
+		return AddConstant(static_cast<const LiteralExpression *>(expression)->GetValue());
+
+	if (type == typeid(VariableExpression)) {
+		auto variable (static_cast<const VariableExpression *>(expression));
+		auto slot (compiler.Slots.find(variable->GetVariable()));
+
+		if (slot == compiler.Slots.end()) {
+			if (compiler.Slots.size() >= l_MaxSlots) {
+				int dst = AddRegister();
+				Emit(OpLoadVar, dst, -1, 0, 0, 0, expression);
+				return dst;
+			}
+
+			int bit = compiler.Slots.size();
+			slot = compiler.Slots.emplace(variable->GetVariable(), std::make_pair(AddRegister(), bit)).first;
+		}
+
+		Emit(OpLoadVar, slot->second.first, slot->second.second, 0, 0, 0, expression);
+		return slot->second.first;
+	}
+
+	if (type == typeid(NegateExpression) || type == typeid(LogicalNegateExpression)) {
+		BytecodeOp op = type == typeid(NegateExpression) ? OpNegate : OpLogicalNegate;
+		int operand = CompileNode(compiler, static_cast<const UnaryExpression *>(expression)->GetOperand().get());
+		const Value *constant = GetConstant(operand);
+
+		if (constant && !constant->IsObject()) {
+			try {
+				return AddConstant(ApplyUnary(op, *constant));
+			} catch (const std::exception&) {
+				/* Leave the error to the evaluation. */
+			}
+		}
+
+		int dst = AddRegister();
+		Emit(op, dst, operand, 0, 0, 0, expression);
+		return dst;
+	}
+
+	if (type == typeid(IndexerExpression)) {
+		auto indexer (static_cast<const IndexerExpression *>(expression));
+
+		int operand1 = CompileNode(compiler, indexer->GetOperand1().get());
+		int operand2 = CompileNode(compiler, indexer->GetOperand2().get());
+
+		int dst = AddRegister();
+		Emit(OpGetField, dst, operand1, operand2, 0, 0, expression);
+		return dst;
+	}
+
+	if (type == typeid(GetScopeExpression)) {
+		int dst = AddRegister();
+		Emit(OpGetScope, dst, static_cast<const GetScopeExpression *>(expression)->m_ScopeSpec, 0, 0, 0, expression);
+		return dst;
+	}
+
+	if (type == typeid(InExpression) || type == typeid(NotInExpression))
+		return CompileIn(compiler, static_cast<const BinaryExpression *>(expression), type == typeid(NotInExpression));
+
+	if (type == typeid(LogicalAndExpression) || type == typeid(LogicalOrExpression))
+		return CompileLogical(compiler, static_cast<const BinaryExpression *>(expression), type == typeid(LogicalOrExpression));
+
+	if (type == typeid(ConditionalExpression))
+		return CompileConditional(compiler, static_cast<const ConditionalExpression *>(expression));
+
+	if (type == typeid(ArrayExpression))
+		return CompileArray(compiler, static_cast<const ArrayExpression *>(expression), false);
+
+	if (type == typeid(FunctionCallExpression))
+		return CompileCall(compiler, static_cast<const FunctionCallExpression *>(expression));
+
+	if (type == typeid(DictExpression)) {
+		auto dict (static_cast<const DictExpression *>(expression));
+
+		if (dict->m_Inline) {
+			int result = AddConstant(Empty);
+
+			for (auto& aexpr : dict->m_Expressions)
+				result = CompileNode(compiler, aexpr.get());
+
+			return result;
+		}
+	}
+
+	return CompileEval(compiler, expression);
+}
+
+/**
+ * Resolves a variable the way VariableExpression::GetReference() does,
+ * i.e. the way function names and method call receivers are looked up.
+ */
+int BytecodeExpression::CompileReference(Compiler&, const Expression *expression, int *parent)
+{
+	int dst = AddRegister();
+	*parent = AddRegister();
+	Emit(OpLoadReference, dst, *parent, 0, 0, 0, expression);
+	return dst;
+}
+
+/**
+ * Compiles the receiver of a method call. Mirrors the parent lookup in
+ * IndexerExpression::GetReference(), which reports field lookups with the
+ * debug info of the enclosing indexer.
+ */
+int BytecodeExpression::CompileReceiver(Compiler& compiler, const Expression *expression, const Expression *outer)
+{
+	const std::type_info& type (typeid(*expression));
+
+	if (type == typeid(VariableExpression)) {
+		int parent;
+		return CompileReference(compiler, expression, &parent);
+	}
+
+	if (type == typeid(IndexerExpression)) {
+		auto indexer (static_cast<const IndexerExpression *>(expression));
+
+		int operand1 = CompileReceiver(compiler, indexer->GetOperand1().get(), expression);
+		int operand2 = CompileNode(compiler, indexer->GetOperand2().get());
+
+		int dst = AddRegister();
+		Emit(OpGetField, dst, operand1, operand2, 0, 0, outer);
+		return dst;
+	}
+
+	return CompileNode(compiler, expression);
+}
+
+int BytecodeExpression::CompileArray(Compiler& compiler, const ArrayExpression *expression, bool fold)
+{
+	std::vector<int> elements;
+	elements.reserve(expression->m_Expressions.size());
+
+	bool constant = fold;
+
+	for (auto& aexpr : expression->m_Expressions) {
+		int element = CompileNode(compiler, aexpr.get());
+		elements.push_back(element);
+
+		if (!GetConstant(element))
+			constant = false;
+	}
+
+	/* Only done for operands which never escape, array literals produce a new array each time. */
+	if (constant) {
+		ArrayData values;
+		values.reserve(elements.size());
+
+		for (int element : elements)
+			values.push_back(*GetConstant(element));
+
+		return AddConstant(new Array(std::move(values)));
+	}
+
+	int start = m_Operands.size();
+	m_Operands.insert(m_Operands.end(), elements.begin(), elements.end());
+
+	int dst = AddRegister();
+	Emit(OpMakeArray, dst, start, elements.size(), 0, 0, expression);
+	return dst;
+}
+
+int BytecodeExpression::CompileIn(Compiler& compiler, const BinaryExpression *expression, bool notIn)
+{
+	const Expression *rhs = expression->GetOperand2().get();
+	int operand2;
+
+	if (typeid(*rhs) == typeid(ArrayExpression))
+		operand2 = CompileArray(compiler, static_cast<const ArrayExpression *>(rhs), true);
+	else
+		operand2 = CompileNode(compiler, rhs);
+
+	const Value *constant2 = GetConstant(operand2);
+
+	if (constant2 && constant2->IsEmpty())
+		return AddConstant(notIn);
+
+	BytecodeOp op = notIn ? OpNotIn : OpIn;
+	int dst = AddRegister();
+
+	if (constant2 && constant2->IsObjectType<Array>()) {
+		int operand1 = CompileNode(compiler, expression->GetOperand1().get());
+		const Value *constant1 = GetConstant(operand1);
+
+		if (constant1) {
+			Array::Ptr arr = *constant2;
+			return AddConstant(arr->Contains(*constant1) != notIn);
+		}
+
+		Emit(op, dst, operand1, operand2, 0, 0, expression);
+		return dst;
+	}
+
+	size_t check = Emit(OpCheckIn, dst, operand2, 0, notIn, 0, expression);
+	int operand1 = CompileNode(compiler, expression->GetOperand1().get());
+	Emit(op, dst, operand1, operand2, 0, 0, expression);
+	m_Code[check].B = m_Code.size();
+	return dst;
+}
+
+int BytecodeExpression::CompileLogical(Compiler& compiler, const BinaryExpression *expression, bool isOr)
+{
+	int operand1 = CompileNode(compiler, expression->GetOperand1().get());
+	const Value *constant1 = GetConstant(operand1);
+
+	if (constant1) {
+		if (constant1->ToBool() == isOr)
+			return operand1;
+
+		return CompileNode(compiler, expression->GetOperand2().get());
+	}
+
+	int dst = AddRegister();
+	Emit(OpMove, dst, operand1, 0, 0, 0, expression);
+	size_t jump = Emit(isOr ? OpJumpIfTrue : OpJumpIfFalse, 0, dst, 0, 0, 0, expression);
+
+	int operand2 = CompileNode(compiler, expression->GetOperand2().get());
+	Emit(OpMove, dst, operand2, 0, 0, 0, expression);
+	m_Code[jump].B = m_Code.size();
+	return dst;
+}
+
+int BytecodeExpression::CompileConditional(Compiler& compiler, const ConditionalExpression *expression)
+{
+	int condition = CompileNode(compiler, expression->m_Condition.get());
+	const Value *constant = GetConstant(condition);
+
+	if (constant) {
+		if (constant->ToBool())
+			return CompileNode(compiler, expression->m_TrueBranch.get());
+		else if (expression->m_FalseBranch)
+			return CompileNode(compiler, expression->m_FalseBranch.get());
+		else
+			return AddConstant(Empty);
+	}
+
+	int dst = AddRegister();
+	size_t skipTrue = Emit(OpJumpIfFalse, 0, condition, 0, 0, 0, expression);
+
+	int result = CompileNode(compiler, expression->m_TrueBranch.get());
+	Emit(OpMove, dst, result, 0, 0, 0, expression);
+	size_t skipFalse = Emit(OpJump, 0, 0, 0, 0, 0, expression);
+	m_Code[skipTrue].B = m_Code.size();
+
+	result = expression->m_FalseBranch ? CompileNode(compiler, expression->m_FalseBranch.get()) : AddConstant(Empty);
+	Emit(OpMove, dst, result, 0, 0, 0, expression);
+	m_Code[skipFalse].B = m_Code.size();
+	return dst;
+}
+
+int BytecodeExpression::CompileCall(Compiler& compiler, const FunctionCallExpression *expression)
+{
+	const Expression *fname = expression->m_FName.get();
+	const std::type_info& type (typeid(*fname));
+	int func, self;
+
+	if (type == typeid(VariableExpression)) {
+		func = CompileReference(compiler, fname, &self);
+	} else if (type == typeid(IndexerExpression)) {
+		auto indexer (static_cast<const IndexerExpression *>(fname));
+
+		self = CompileReceiver(compiler, indexer->GetOperand1().get(), indexer);
+		int index = CompileNode(compiler, indexer->GetOperand2().get());
+
+		func = AddRegister();
+		Emit(OpGetField, func, self, index, 0, 0, expression);
+	} else if (type == typeid(DerefExpression)) {
+		return CompileEval(compiler, expression);
+	} else {
+		func = CompileNode(compiler, fname);
+		self = AddConstant(Empty);
+	}
+
+	Emit(OpCheckCallable, 0, func, 0, 0, 0, expression);
+
+	std::vector<int> args;
+	args.reserve(expression->m_Args.size());
+
+	for (auto& arg : expression->m_Args)
+		args.push_back(CompileNode(compiler, arg.get()));
+
+	int start = m_Operands.size();
+	m_Operands.insert(m_Operands.end(), args.begin(), args.end());
+
+	int dst = AddRegister();
+	Emit(OpCall, dst, func, self, start, args.size(), expression);
+	return dst;
+}
+
+int BytecodeExpression::CompileEval(Compiler& compiler, const Expression *expression)
+{
+	compiler.Evals++;
+
+	int dst = AddRegister();
+	Emit(OpEval, dst, 0, 0, 0, 0, expression);
+	return dst;
+}
+
+size_t BytecodeExpression::Emit(BytecodeOp op, int dst, int a, int b, int c, int d, const Expression *node)
+{
+	m_Code.push_back({ op, dst, a, b, c, d, node });
+	return m_Code.size() - 1;
+}
+
+int BytecodeExpression::AddRegister()
+{
+	return m_Registers++;
+}
+
+int BytecodeExpression::AddConstant(Value value)
+{
+	m_Constants.emplace_back(std::move(value));
+	return ~static_cast<int>(m_Constants.size() - 1);
+}
+
+const Value *BytecodeExpression::GetConstant(int operand) const
+{
+	if (operand >= 0)
+		return nullptr;
+
+	return &m_Constants[~operand];
+}
+
+ExpressionResult BytecodeExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
+{
+	/* Debug hints are only tracked by the tree-walking evaluator. */
+	if (dhint)
+		return m_Expression->DoEvaluate(frame, dhint);
+
+	Value inlineRegisters[l_InlineRegisters];
+	std::vector<Value> heapRegisters;
+	Value *regs = inlineRegisters;
+
+	if (m_Registers > l_InlineRegisters) {
+		heapRegisters.resize(m_Registers);
+		regs = heapRegisters.data();
+	}
+
+	auto fetch ([this, regs](int operand) -> const Value& {
+		return operand >= 0 ? regs[operand] : m_Constants[~operand];
+	});
+
+	/* Bit n is set while the variable in slot n holds its current value. */
+	uint_fast64_t loaded = 0;
+	size_t pc = 0;
+
+	try {
+		while (pc < m_Code.size()) {
+			const BytecodeInstruction& ins (m_Code[pc]);
+
+			switch (ins.Op) {
+				case OpLoadVar: {
+					if (ins.A >= 0 && (loaded & (uint_fast64_t(1) << ins.A)))
+						break;
+
+					auto variable (static_cast<const VariableExpression *>(ins.Node));
+
+					if (!frame.Locals || !frame.Locals->Get(variable->GetVariable(), &regs[ins.Dst]))
+						regs[ins.Dst] = ins.Node->DoEvaluate(frame, nullptr).GetValue();
+
+					if (ins.A >= 0)
+						loaded |= uint_fast64_t(1) << ins.A;
+
+					break;
+				}
+
+				case OpLoadReference: {
+					Value parent;
+					String index;
+
+					ins.Node->GetReference(frame, false, &parent, &index);
+					regs[ins.Dst] = VMOps::GetField(parent, index, frame.Sandboxed, ins.Node->GetDebugInfo());
+					regs[ins.A] = std::move(parent);
+					break;
+				}
+
+				case OpGetScope:
+					if (ins.A == ScopeLocal)
+						regs[ins.Dst] = frame.Locals;
+					else if (ins.A == ScopeThis)
+						regs[ins.Dst] = frame.Self;
+					else
+						regs[ins.Dst] = ScriptGlobal::GetGlobals();
+
+					break;
+
+				case OpGetField:
+					regs[ins.Dst] = VMOps::GetField(fetch(ins.A), fetch(ins.B), frame.Sandboxed, ins.Node->GetDebugInfo());
+					break;
+
+				case OpMove:
+					regs[ins.Dst] = fetch(ins.A);
+					break;
+
+				case OpNegate:
+				case OpLogicalNegate:
+					regs[ins.Dst] = ApplyUnary(ins.Op, fetch(ins.A));
+					break;
+
+				case OpAdd:
+				case OpSubtract:
+				case OpMultiply:
+				case OpDivide:
+				case OpModulo:
+				case OpXor:
+				case OpBinaryAnd:
+				case OpBinaryOr:
+				case OpShiftLeft:
+				case OpShiftRight:
+				case OpEqual:
+				case OpNotEqual:
+				case OpLessThan:
+				case OpGreaterThan:
+				case OpLessThanOrEqual:
+				case OpGreaterThanOrEqual:
+					regs[ins.Dst] = ApplyBinary(ins.Op, fetch(ins.A), fetch(ins.B));
+					break;
+
+				case OpCheckIn: {
+					const Value& rhs (fetch(ins.A));
+
+					if (rhs.IsEmpty()) {
+						regs[ins.Dst] = static_cast<bool>(ins.C);
+						pc = ins.B;
+						continue;
+					} else if (!rhs.IsObjectType<Array>())
+						BOOST_THROW_EXCEPTION(ScriptError("Invalid right side argument for 'in' operator: " + JsonEncode(rhs), ins.Node->GetDebugInfo()));
+
+					break;
+				}
+
+				case OpIn:
+				case OpNotIn: {
+					Array::Ptr arr = fetch(ins.B);
+					regs[ins.Dst] = arr->Contains(fetch(ins.A)) != (ins.Op == OpNotIn);
+					break;
+				}
+
+				case OpJump:
+					pc = ins.B;
+					continue;
+
+				case OpJumpIfFalse:
+				case OpJumpIfTrue:
+					if (fetch(ins.A).ToBool() == (ins.Op == OpJumpIfTrue)) {
+						pc = ins.B;
+						continue;
+					}
+
+					break;
+
+				case OpMakeArray: {
+					ArrayData result;
+					result.reserve(ins.B);
+
+					for (int i = ins.A; i < ins.A + ins.B; i++)
+						result.push_back(fetch(m_Operands[i]));
+
+					regs[ins.Dst] = new Array(std::move(result));
+					break;
+				}
+
+				case OpCheckCallable: {
+					const Value& vfunc (fetch(ins.A));
+
+					if (vfunc.IsObjectType<Type>())
+						break;
+
+					if (!vfunc.IsObjectType<Function>())
+						BOOST_THROW_EXCEPTION(ScriptError("Argument is not a callable object.", ins.Node->GetDebugInfo()));
+
+					Function::Ptr func = vfunc;
+
+					if (!func->IsSideEffectFree() && (frame.Sandboxed || frame.SafeCallsOnly))
+						BOOST_THROW_EXCEPTION(ScriptError("Function is not marked as safe for sandbox mode.", ins.Node->GetDebugInfo()));
+
+					break;
+				}
+
+				case OpCall: {
+					std::vector<Value> arguments;
+					arguments.reserve(ins.D);
+
+					for (int i = ins.C; i < ins.C + ins.D; i++)
+						arguments.push_back(fetch(m_Operands[i]));
+
+					const Value& vfunc (fetch(ins.A));
+
+					if (vfunc.IsObjectType<Type>())
+						regs[ins.Dst] = VMOps::ConstructorCall(vfunc, arguments, ins.Node->GetDebugInfo());
+					else
+						regs[ins.Dst] = VMOps::FunctionCall(frame, fetch(ins.B), vfunc, arguments);
+
+					loaded = 0;
+					break;
+				}
+
+				case OpEval: {
+					ExpressionResult result = ins.Node->Evaluate(frame);
+
+					if (result.GetCode() != ResultOK)
+						return result;
+
+					regs[ins.Dst] = result.GetValue();
+					loaded = 0;
+					break;
+				}
+			}
+
+			pc++;
+		}
+	} catch (const ScriptError&) {
+		throw;
+	} catch (const std::exception& ex) {
+		BOOST_THROW_EXCEPTION(ScriptError("Error while evaluating expression: " + String(ex.what()), m_Code[pc].Node->GetDebugInfo())
+			<< boost::errinfo_nested_exception(boost::current_exception()));
+	}
+
+	return fetch(m_Result);
+}
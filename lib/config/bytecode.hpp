@@ -0,0 +1,130 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "config/i2-config.hpp"
+#include "config/expression.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * @ingroup config
+ */
+enum BytecodeOp : uint8_t
+{
+	OpLoadVar,
+	OpLoadReference,
+	OpGetScope,
+	OpGetField,
+	OpMove,
+	OpNegate,
+	OpLogicalNegate,
+	OpAdd,
+	OpSubtract,
+	OpMultiply,
+	OpDivide,
+	OpModulo,
+	OpXor,
+	OpBinaryAnd,
+	OpBinaryOr,
+	OpShiftLeft,
+	OpShiftRight,
+	OpEqual,
+	OpNotEqual,
+	OpLessThan,
+	OpGreaterThan,
+	OpLessThanOrEqual,
+	OpGreaterThanOrEqual,
+	OpCheckIn,
+	OpIn,
+	OpNotIn,
+	OpJump,
+	OpJumpIfFalse,
+	OpJumpIfTrue,
+	OpMakeArray,
+	OpCheckCallable,
+	OpCall,
+	OpEval
+};
+
+/**
+ * A single instruction. Operands which refer to values are encoded as
+ * register numbers (>= 0) or as one's complement indices into the
+ * constant table (< 0).
+ *
+ * @ingroup config
+ */
+struct BytecodeInstruction
+{
+	BytecodeOp Op;
+	int Dst;
+	int A;
+	int B;
+	int C;
+	int D;
+	const Expression *Node;
+};
+
+/**
+ * Register-based compiled form of an expression.
+ *
+ * The compiler covers the expression subset used by filters and lambdas
+ * (variables, indexers, operators, arrays and function calls) and folds
+ * constant sub-expressions. Each distinct variable name gets a register
+ * slot which is loaded at most once per evaluation, until a call or any
+ * other node with possible side effects runs. Everything else is left to
+ * the tree-walking evaluator of the original expression, which also stays
+ * in charge whenever debug hints are requested.
+ *
+ * @ingroup config
+ */
+class BytecodeExpression final : public Expression
+{
+public:
+	static Expression::Ptr Compile(Expression::Ptr expression);
+	static std::unique_ptr<Expression> Compile(std::unique_ptr<Expression> expression);
+
+	const Expression::Ptr& GetExpression() const;
+	size_t GetInstructionCount() const;
+
+	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
+	bool GetReference(ScriptFrame& frame, bool init_dict, Value *parent, String *index, DebugHint **dhint = nullptr) const override;
+	const DebugInfo& GetDebugInfo() const override;
+
+private:
+	struct Compiler;
+
+	Expression::Ptr m_Expression;
+	std::vector<BytecodeInstruction> m_Code;
+	std::vector<Value> m_Constants;
+	std::vector<int> m_Operands;
+	int m_Registers{0};
+	int m_Result{0};
+
+	BytecodeExpression() = default;
+
+	bool CompileProgram(const Expression *root);
+	int CompileNode(Compiler& compiler, const Expression *expression);
+	int CompileReference(Compiler& compiler, const Expression *expression, int *parent);
+	int CompileReceiver(Compiler& compiler, const Expression *expression, const Expression *outer);
+	int CompileArray(Compiler& compiler, const ArrayExpression *expression, bool fold);
+	int CompileIn(Compiler& compiler, const BinaryExpression *expression, bool notIn);
+	int CompileLogical(Compiler& compiler, const BinaryExpression *expression, bool isOr);
+	int CompileConditional(Compiler& compiler, const ConditionalExpression *expression);
+	int CompileCall(Compiler& compiler, const FunctionCallExpression *expression);
+	int CompileEval(Compiler& compiler, const Expression *expression);
+
+	size_t Emit(BytecodeOp op, int dst, int a = 0, int b = 0, int c = 0, int d = 0, const Expression *node = nullptr);
+	int AddRegister();
+	int AddConstant(Value value);
+	const Value *GetConstant(int operand) const;
+};
+
+}
+
+#endif /* BYTECODE_H */
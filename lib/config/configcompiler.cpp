@@ -2,16 +2,24 @@
 
 #include "config/configcompiler.hpp"
 #include "config/configitem.hpp"
+#include "config/expressioncache.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include "base/loader.hpp"
 #include "base/context.hpp"
 #include "base/exception.hpp"
+#include "base/configuration.hpp"
+#include "base/taskgroup.hpp"
+#include <algorithm>
 #include <fstream>
+#include <numeric>
+#include <sstream>
 
 using namespace icinga;
 
 std::vector<String> ConfigCompiler::m_IncludeSearchDirs;
+std::atomic<size_t> ConfigCompiler::m_IncludedFileCount (0);
+std::atomic<double> ConfigCompiler::m_IncludedFileCompileTime (0);
 std::mutex ConfigCompiler::m_ZoneDirsMutex;
 std::map<String, std::vector<ZoneFragment> > ConfigCompiler::m_ZoneDirs;
 
@@ -95,13 +103,90 @@ String ConfigCompiler::GetPackage() const
 void ConfigCompiler::CollectIncludes(std::vector<std::unique_ptr<Expression> >& expressions,
 	const String& file, const String& zone, const String& package)
 {
-	try {
-		expressions.emplace_back(CompileFile(file, zone, package));
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "ConfigCompiler")
-			<< "Cannot compile file '"
-			<< file << "': " << DiagnosticInformation(ex);
+	CollectIncludes(expressions, { { file, zone } }, package);
+}
+
+/**
+ * Compiles the given files, up to Configuration::Concurrency ones at a time.
+ *
+ * The expressions are appended and errors are logged in the order of the files,
+ * regardless of the order in which they have been compiled.
+ *
+ * @param expressions The vector to append the files' expressions to.
+ * @param files The files.
+ * @param package The package the files belong to.
+ */
+void ConfigCompiler::CollectIncludes(std::vector<std::unique_ptr<Expression> >& expressions,
+	const std::vector<IncludedFile>& files, const String& package)
+{
+	if (files.empty())
+		return;
+
+	double start = Utility::GetTime();
+
+	std::vector<std::unique_ptr<Expression> > compiled (files.size());
+	std::vector<String> errors (files.size());
+
+	auto compile ([&files, &package, &compiled, &errors](size_t i) {
+		try {
+			compiled[i] = CompileFile(files[i].Path, files[i].Zone, package);
+		} catch (const std::exception& ex) {
+			errors[i] = DiagnosticInformation(ex);
+		}
+	});
+
+	int concurrency = std::min<size_t>(files.size(), std::max(Configuration::Concurrency, 1));
+
+	if (concurrency > 1) {
+		std::vector<size_t> indices (files.size());
+		std::iota(indices.begin(), indices.end(), 0);
+
+		TaskGroup upq ("ConfigCompiler::CollectIncludes");
+		upq.ParallelFor(indices, false, compile);
+		upq.Join();
+	} else {
+		for (size_t i = 0; i < files.size(); i++)
+			compile(i);
 	}
+
+	for (size_t i = 0; i < files.size(); i++) {
+		if (compiled[i]) {
+			expressions.emplace_back(std::move(compiled[i]));
+		} else {
+			Log(LogWarning, "ConfigCompiler")
+				<< "Cannot compile file '"
+				<< files[i].Path << "': " << errors[i];
+		}
+	}
+
+	m_IncludedFileCount.fetch_add(files.size());
+
+	/* There's no fetch_add() for floating point atomics before C++20. */
+	double elapsed = Utility::GetTime() - start;
+	double total = m_IncludedFileCompileTime.load();
+
+	while (!m_IncludedFileCompileTime.compare_exchange_weak(total, total + elapsed))
+		;
+}
+
+/**
+ * Returns the number of files compiled by CollectIncludes() so far.
+ *
+ * @returns The number of files.
+ */
+size_t ConfigCompiler::GetIncludedFileCount()
+{
+	return m_IncludedFileCount.load();
+}
+
+/**
+ * Returns the wall clock time CollectIncludes() took so far.
+ *
+ * @returns The time in seconds.
+ */
+double ConfigCompiler::GetIncludedFileCompileTime()
+{
+	return m_IncludedFileCompileTime.load();
 }
 
 /**
@@ -135,8 +220,8 @@ std::unique_ptr<Expression> ConfigCompiler::HandleInclude(const String& relative
 		}
 	}
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	auto funcCallback = [&expressions, zone, package](const String& file) { CollectIncludes(expressions, file, zone, package); };
+	std::vector<IncludedFile> files;
+	auto funcCallback = [&files, zone](const String& file) { files.push_back({ file, zone }); };
 
 	if (!Utility::Glob(includePath, funcCallback, GlobFile) && includePath.FindFirstOf("*?") == String::NPos) {
 		std::ostringstream msgbuf;
@@ -144,6 +229,9 @@ std::unique_ptr<Expression> ConfigCompiler::HandleInclude(const String& relative
 		BOOST_THROW_EXCEPTION(ScriptError(msgbuf.str(), debuginfo));
 	}
 
+	std::vector<std::unique_ptr<Expression> > expressions;
+	CollectIncludes(expressions, files, package);
+
 	std::unique_ptr<DictExpression> expr{new DictExpression(std::move(expressions))};
 	expr->MakeInline();
 	return std::move(expr);
@@ -167,17 +255,20 @@ std::unique_ptr<Expression> ConfigCompiler::HandleIncludeRecursive(const String&
 	else
 		ppath = relativeBase + "/" + path;
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::GlobRecursive(ppath, pattern, [&expressions, zone, package](const String& file) {
-		CollectIncludes(expressions, file, zone, package);
+	std::vector<IncludedFile> files;
+	Utility::GlobRecursive(ppath, pattern, [&files, zone](const String& file) {
+		files.push_back({ file, zone });
 	}, GlobFile);
 
+	std::vector<std::unique_ptr<Expression> > expressions;
+	CollectIncludes(expressions, files, package);
+
 	std::unique_ptr<DictExpression> dict{new DictExpression(std::move(expressions))};
 	dict->MakeInline();
 	return std::move(dict);
 }
 
-void ConfigCompiler::HandleIncludeZone(const String& relativeBase, const String& tag, const String& path, const String& pattern, const String& package, std::vector<std::unique_ptr<Expression> >& expressions)
+void ConfigCompiler::HandleIncludeZone(const String& relativeBase, const String& tag, const String& path, const String& pattern, std::vector<IncludedFile>& files)
 {
 	String zoneName = Utility::BaseName(path);
 
@@ -190,8 +281,8 @@ void ConfigCompiler::HandleIncludeZone(const String& relativeBase, const String&
 
 	RegisterZoneDir(tag, ppath, zoneName);
 
-	Utility::GlobRecursive(ppath, pattern, [&expressions, zoneName, package](const String& file) {
-		CollectIncludes(expressions, file, zoneName, package);
+	Utility::GlobRecursive(ppath, pattern, [&files, zoneName](const String& file) {
+		files.push_back({ file, zoneName });
 	}, GlobFile);
 }
 
@@ -217,11 +308,15 @@ std::unique_ptr<Expression> ConfigCompiler::HandleIncludeZones(const String& rel
 		newRelativeBase = ".";
 	}
 
-	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::Glob(ppath + "/*", [newRelativeBase, tag, pattern, package, &expressions](const String& path) {
-		HandleIncludeZone(newRelativeBase, tag, path, pattern, package, expressions);
+	/* Collect the files of all zones first, so that they can be compiled concurrently. */
+	std::vector<IncludedFile> files;
+	Utility::Glob(ppath + "/*", [newRelativeBase, tag, pattern, &files](const String& path) {
+		HandleIncludeZone(newRelativeBase, tag, path, pattern, files);
 	}, GlobDirectory);
 
+	std::vector<std::unique_ptr<Expression> > expressions;
+	CollectIncludes(expressions, files, package);
+
 	return std::unique_ptr<Expression>(new DictExpression(std::move(expressions)));
 }
 
@@ -269,10 +364,35 @@ std::unique_ptr<Expression> ConfigCompiler::CompileFile(const String& path, cons
 			<< boost::errinfo_errno(errno)
 			<< boost::errinfo_file_name(path));
 
+	if (!ExpressionCache::IsEnabled()) {
+		Log(LogNotice, "ConfigCompiler")
+			<< "Compiling config file: " << path;
+
+		return CompileStream(path, &stream, zone, package);
+	}
+
+	ExpressionCache cache (path, zone, package);
+
+	std::unique_ptr<Expression> expression = cache.Lookup(stream);
+
+	if (expression) {
+		Log(LogNotice, "ConfigCompiler")
+			<< "Using cached config file: " << path;
+
+		return expression;
+	}
+
 	Log(LogNotice, "ConfigCompiler")
 		<< "Compiling config file: " << path;
 
-	return CompileStream(path, &stream, zone, package);
+	std::istringstream content (cache.GetContent());
+	expression = CompileStream(path, &content, zone, package);
+
+	/* Syntax errors are returned as a ThrowExpression, don't cache those. */
+	if (!dynamic_cast<ThrowExpression *>(expression.get()))
+		cache.Store(expression.get());
+
+	return expression;
 }
 
 /**
@@ -10,6 +10,7 @@
 #include "base/initialize.hpp"
 #include "base/singleton.hpp"
 #include "base/string.hpp"
+#include <atomic>
 #include <future>
 #include <iostream>
 #include <stack>
@@ -55,6 +56,15 @@ enum FlowControlType
 	FlowControlBreak = 4
 };
 
+/**
+ * A config file to be compiled by ConfigCompiler::CollectIncludes().
+ */
+struct IncludedFile
+{
+	String Path;
+	String Zone;
+};
+
 struct ZoneFragment
 {
 	String Tag;
@@ -98,6 +108,11 @@ public:
 
 	static void CollectIncludes(std::vector<std::unique_ptr<Expression> >& expressions,
 		const String& file, const String& zone, const String& package);
+	static void CollectIncludes(std::vector<std::unique_ptr<Expression> >& expressions,
+		const std::vector<IncludedFile>& files, const String& package);
+
+	static size_t GetIncludedFileCount();
+	static double GetIncludedFileCompileTime();
 
 	static std::unique_ptr<Expression> HandleInclude(const String& relativeBase, const String& path, bool search,
 		const String& zone, const String& package, const DebugInfo& debuginfo = DebugInfo());
@@ -126,13 +141,15 @@ private:
 	void *m_Scanner;
 
 	static std::vector<String> m_IncludeSearchDirs;
+	static std::atomic<size_t> m_IncludedFileCount;
+	static std::atomic<double> m_IncludedFileCompileTime;
 	static std::mutex m_ZoneDirsMutex;
 	static std::map<String, std::vector<ZoneFragment> > m_ZoneDirs;
 
 	void InitializeScanner();
 	void DestroyScanner();
 
-	static void HandleIncludeZone(const String& relativeBase, const String& tag, const String& path, const String& pattern, const String& package, std::vector<std::unique_ptr<Expression> >& expressions);
+	static void HandleIncludeZone(const String& relativeBase, const String& tag, const String& path, const String& pattern, std::vector<IncludedFile>& files);
 
 	static bool IsAbsolutePath(const String& path);
 
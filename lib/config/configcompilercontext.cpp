@@ -7,6 +7,9 @@
 #include "base/exception.hpp"
 #include "base/application.hpp"
 #include "base/utility.hpp"
+#include "base/stdiostream.hpp"
+#include "base/convert.hpp"
+#include <boost/filesystem.hpp>
 
 using namespace icinga;
 
@@ -15,10 +18,82 @@ ConfigCompilerContext *ConfigCompilerContext::GetInstance()
 	return Singleton<ConfigCompilerContext>::GetInstance();
 }
 
+/**
+ * The index of the objects file, which holds the type, name, full name and offset of every object
+ * (as netstring-framed JSON arrays) followed by the objects file's size.
+ */
+String ConfigCompilerContext::GetObjectsIndexPath(const String& objectsPath)
+{
+	return objectsPath + ".idx";
+}
+
+/**
+ * Reads the index of the objects file, so single objects can be read without parsing all others.
+ *
+ * @return Whether the index exists and belongs to the current objects file
+ */
+bool ConfigCompilerContext::ReadObjectsIndex(const String& objectsPath, std::vector<ObjectsIndexEntry>& entries)
+{
+	std::fstream fp;
+	fp.open(GetObjectsIndexPath(objectsPath).CStr(), std::ios_base::in);
+
+	if (!fp)
+		return false;
+
+	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+	String message;
+	StreamReadContext src;
+	bool complete = false;
+	uint_fast64_t size = 0;
+
+	entries.clear();
+
+	try {
+		for (;;) {
+			StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+			if (srs == StatusEof)
+				break;
+
+			if (srs != StatusNewItem)
+				continue;
+
+			Value entry = JsonDecode(message);
+
+			if (entry.IsObjectType<Array>()) {
+				Array::Ptr fields = entry;
+
+				entries.emplace_back(ObjectsIndexEntry{fields->Get(0), fields->Get(1), fields->Get(2),
+					static_cast<uint_fast64_t>((double)fields->Get(3))});
+			} else {
+				size = static_cast<uint_fast64_t>((double)entry);
+				complete = true;
+			}
+		}
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ConfigCompilerContext")
+			<< "Ignoring broken objects file index: " << DiagnosticInformation(ex, false);
+		return false;
+	}
+
+	sfp->Close();
+
+	if (!complete)
+		return false;
+
+	/* Stale if the objects file has been replaced without it, e.g. by an older version. */
+	boost::system::error_code ec;
+	auto objectsSize (boost::filesystem::file_size(objectsPath.GetData(), ec));
+
+	return !ec && objectsSize == size;
+}
+
 void ConfigCompilerContext::OpenObjectsFile(const String& filename)
 {
 	try {
 		m_ObjectsFP = std::make_unique<AtomicFile>(filename, 0600);
+		m_IndexFP = std::make_unique<AtomicFile>(GetObjectsIndexPath(filename), 0600);
+		m_ObjectsSize = 0;
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "cli", "Could not create temporary objects file: " + DiagnosticInformation(ex, false));
 		Application::Exit(1);
@@ -31,10 +106,23 @@ void ConfigCompilerContext::WriteObject(const Dictionary::Ptr& object)
 		return;
 
 	String json = JsonEncode(object);
+	Dictionary::Ptr properties = object->Get("properties");
 
 	{
 		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		String entry = JsonEncode(new Array({
+			object->Get("type"),
+			object->Get("name"),
+			properties ? properties->Get("__name") : Empty,
+			(double)m_ObjectsSize
+		}));
+
 		NetString::WriteStringToStream(*m_ObjectsFP, json);
+		NetString::WriteStringToStream(*m_IndexFP, entry);
+
+		/* Like NetString::WriteStringToStream() */
+		m_ObjectsSize += Convert::ToString(json.GetLength()).GetLength() + 1 + json.GetLength() + 1;
 	}
 }
 
@@ -44,6 +132,7 @@ void ConfigCompilerContext::CancelObjectsFile()
 		return;
 
 	m_ObjectsFP.reset(nullptr);
+	m_IndexFP.reset(nullptr);
 }
 
 void ConfigCompilerContext::FinishObjectsFile()
@@ -51,6 +140,12 @@ void ConfigCompilerContext::FinishObjectsFile()
 	if (!m_ObjectsFP)
 		return;
 
+	NetString::WriteStringToStream(*m_IndexFP, Convert::ToString(m_ObjectsSize));
+
+	/* The index first, it's ignored anyway if the objects file doesn't match. */
+	m_IndexFP->Commit();
+	m_IndexFP.reset(nullptr);
+
 	m_ObjectsFP->Commit();
 	m_ObjectsFP.reset(nullptr);
 }
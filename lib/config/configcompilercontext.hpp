@@ -6,19 +6,37 @@
 #include "config/i2-config.hpp"
 #include "base/atomic-file.hpp"
 #include "base/dictionary.hpp"
+#include <cstdint>
 #include <fstream>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 namespace icinga
 {
 
+/**
+ * An object in the objects file, see ConfigCompilerContext::ReadObjectsIndex().
+ *
+ * @ingroup config
+ */
+struct ObjectsIndexEntry
+{
+	String Type;
+	String Name;
+	String FullName;
+	uint_fast64_t Offset;
+};
+
 /*
  * @ingroup config
  */
 class ConfigCompilerContext
 {
 public:
+	static String GetObjectsIndexPath(const String& objectsPath);
+	static bool ReadObjectsIndex(const String& objectsPath, std::vector<ObjectsIndexEntry>& entries);
+
 	void OpenObjectsFile(const String& filename);
 	void WriteObject(const Dictionary::Ptr& object);
 	void CancelObjectsFile();
@@ -33,6 +51,8 @@ public:
 
 private:
 	std::unique_ptr<AtomicFile> m_ObjectsFP;
+	std::unique_ptr<AtomicFile> m_IndexFP;
+	uint_fast64_t m_ObjectsSize;
 
 	mutable std::mutex m_Mutex;
 };
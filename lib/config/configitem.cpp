@@ -11,11 +11,12 @@
 #include "base/convert.hpp"
 #include "base/logger.hpp"
 #include "base/debug.hpp"
-#include "base/workqueue.hpp"
+#include "base/taskgroup.hpp"
 #include "base/exception.hpp"
 #include "base/stdiostream.hpp"
 #include "base/netstring.hpp"
 #include "base/serializer.hpp"
+#include "base/startupprofile.hpp"
 #include "base/json.hpp"
 #include "base/exception.hpp"
 #include "base/function.hpp"
@@ -25,7 +26,10 @@
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <map>
+#include <numeric>
 #include <random>
+#include <set>
 #include <unordered_map>
 
 using namespace icinga;
@@ -34,6 +38,7 @@ std::mutex ConfigItem::m_Mutex;
 ConfigItem::TypeMap ConfigItem::m_Items;
 ConfigItem::TypeMap ConfigItem::m_DefaultTemplates;
 ConfigItem::ItemList ConfigItem::m_UnnamedItems;
+thread_local ConfigItem::DeferredRegistration *ConfigItem::DeferredRegistration::m_Current = nullptr;
 ConfigItem::IgnoredItemList ConfigItem::m_IgnoredItems;
 
 REGISTER_FUNCTION(Internal, run_with_activation_context, &ConfigItem::RunWithActivationContext, "func");
@@ -113,6 +118,13 @@ DebugInfo ConfigItem::GetDebugInfo() const
 
 Dictionary::Ptr ConfigItem::GetScope() const
 {
+	/* Neither is ever released by ReleaseConfig(). Templates and group assign rules are
+	 * evaluated for many objects in parallel, so they shouldn't contend for the lock.
+	 */
+	if (m_Abstract || m_Filter)
+		return m_Scope;
+
+	ObjectLock olock(this);
 	return m_Scope;
 }
 
@@ -128,6 +140,11 @@ ConfigObject::Ptr ConfigItem::GetObject() const
  */
 Expression::Ptr ConfigItem::GetExpression() const
 {
+	/* See GetScope() */
+	if (m_Abstract)
+		return m_Expression;
+
+	ObjectLock olock(this);
 	return m_Expression;
 }
 
@@ -141,6 +158,21 @@ Expression::Ptr ConfigItem::GetFilter() const
 	return m_Filter;
 }
 
+/**
+ * Drops the expression and (unless it has a filter) the scope of an activated object, see
+ * Configuration::ReleaseObjectConfig. Afterwards the object can't be imported anymore.
+ */
+void ConfigItem::ReleaseConfig()
+{
+	ObjectLock olock(this);
+
+	m_Expression.reset();
+
+	/* Group assign rules are evaluated again for objects created later on. */
+	if (!m_Filter)
+		m_Scope.reset();
+}
+
 class DefaultValidationUtils final : public ValidationUtils
 {
 public:
@@ -210,33 +242,7 @@ ConfigObject::Ptr ConfigItem::Commit(bool discard)
 	if (discard)
 		m_Expression.reset();
 
-	String item_name;
-	String short_name = dobj->GetShortName();
-
-	if (!short_name.IsEmpty()) {
-		item_name = short_name;
-		dobj->SetName(short_name);
-	} else
-		item_name = m_Name;
-
-	String name = item_name;
-
-	auto *nc = dynamic_cast<NameComposer *>(type.get());
-
-	if (nc) {
-		if (name.IsEmpty())
-			BOOST_THROW_EXCEPTION(ScriptError("Object name must not be empty.", m_DebugInfo));
-
-		name = nc->MakeName(name, dobj);
-
-		if (name.IsEmpty())
-			BOOST_THROW_EXCEPTION(std::runtime_error("Could not determine name for object"));
-	}
-
-	if (name != item_name)
-		dobj->SetShortName(item_name);
-
-	dobj->SetName(name);
+	ComposeName(dobj);
 
 	Dictionary::Ptr dhint = debugHints.ToDictionary();
 
@@ -317,21 +323,100 @@ ConfigObject::Ptr ConfigItem::Commit(bool discard)
 	return dobj;
 }
 
+/**
+ * Sets the object's full name after its expression has been evaluated.
+ */
+void ConfigItem::ComposeName(const ConfigObject::Ptr& dobj) const
+{
+	String item_name;
+	String short_name = dobj->GetShortName();
+
+	if (!short_name.IsEmpty()) {
+		item_name = short_name;
+		dobj->SetName(short_name);
+	} else
+		item_name = m_Name;
+
+	String name = item_name;
+
+	auto *nc = dynamic_cast<NameComposer *>(m_Type.get());
+
+	if (nc) {
+		if (name.IsEmpty())
+			BOOST_THROW_EXCEPTION(ScriptError("Object name must not be empty.", m_DebugInfo));
+
+		name = nc->MakeName(name, dobj);
+
+		if (name.IsEmpty())
+			BOOST_THROW_EXCEPTION(std::runtime_error("Could not determine name for object"));
+	}
+
+	if (name != item_name)
+		dobj->SetShortName(item_name);
+
+	dobj->SetName(name);
+}
+
+/**
+ * Evaluates the item like Commit() does, but neither registers the object nor calls OnConfigLoaded().
+ *
+ * The item may not have been validated yet, so only functions which are safe for sandbox mode may be called.
+ *
+ * @param deadline When to abort the evaluation, 0 for never
+ */
+ConfigObject::Ptr ConfigItem::EvaluateScratch(double deadline) const
+{
+	Type::Ptr type = GetType();
+
+	if (!type || !ConfigObject::TypeInstance->IsAssignableFrom(type))
+		BOOST_THROW_EXCEPTION(ScriptError("Type '" + type->GetName() + "' does not exist.", m_DebugInfo));
+
+	ConfigObject::Ptr dobj = static_pointer_cast<ConfigObject>(type->Instantiate(std::vector<Value>()));
+
+	dobj->SetDebugInfo(m_DebugInfo);
+	dobj->SetZoneName(m_Zone);
+	dobj->SetPackage(m_Package);
+	dobj->SetName(m_Name);
+
+	ScriptFrame frame(true, dobj);
+	frame.SafeCallsOnly = true;
+	frame.Deadline = deadline;
+
+	if (m_Scope)
+		m_Scope->CopyTo(frame.Locals);
+
+	m_Expression->Evaluate(frame);
+
+	ComposeName(dobj);
+
+	return dobj;
+}
+
 /**
  * Registers the configuration item.
  */
 void ConfigItem::Register()
 {
-	m_ActivationContext = ActivationContext::GetCurrentContext();
+	auto context (ActivationContext::GetCurrentContext());
+	bool scratch = context->IsScratch();
+
+	/* Scratch items are kept by their context, which must not be referenced back. */
+	if (!scratch)
+		m_ActivationContext = context;
+
+	if (!scratch && DeferredRegistration::m_Current && !m_Abstract && dynamic_cast<NameComposer *>(m_Type.get())) {
+		DeferredRegistration::m_Current->m_Items.emplace_back(this);
+		return;
+	}
 
 	std::unique_lock<std::mutex> lock(m_Mutex);
 
 	/* If this is a non-abstract object with a composite name
 	 * we register it in m_UnnamedItems instead of m_Items. */
 	if (!m_Abstract && dynamic_cast<NameComposer *>(m_Type.get()))
-		m_UnnamedItems.emplace_back(this);
+		(scratch ? context->m_ScratchUnnamedItems : m_UnnamedItems).emplace_back(this);
 	else {
-		auto& items = m_Items[m_Type];
+		auto& items = (scratch ? context->m_ScratchItems : m_Items)[m_Type];
 
 		auto it = items.find(m_Name);
 
@@ -343,13 +428,30 @@ void ConfigItem::Register()
 			BOOST_THROW_EXCEPTION(ScriptError(msgbuf.str()));
 		}
 
-		m_Items[m_Type][m_Name] = this;
+		items[m_Name] = this;
 
-		if (m_DefaultTmpl)
+		if (m_DefaultTmpl && !scratch)
 			m_DefaultTemplates[m_Type][m_Name] = this;
 	}
 }
 
+ConfigItem::DeferredRegistration::DeferredRegistration()
+	: m_Previous(m_Current)
+{
+	m_Current = this;
+}
+
+ConfigItem::DeferredRegistration::~DeferredRegistration()
+{
+	m_Current = m_Previous;
+
+	if (m_Items.empty())
+		return;
+
+	std::unique_lock<std::mutex> lock(ConfigItem::m_Mutex);
+	m_UnnamedItems.insert(m_UnnamedItems.end(), m_Items.begin(), m_Items.end());
+}
+
 /**
  * Unregisters the configuration item.
  */
@@ -375,8 +477,22 @@ void ConfigItem::Unregister()
  */
 ConfigItem::Ptr ConfigItem::GetByTypeAndName(const Type::Ptr& type, const String& name)
 {
+	auto scratch (ActivationContext::GetScratchContext());
+
 	std::unique_lock<std::mutex> lock(m_Mutex);
 
+	/* Within a scratch context its own items replace the ones of the replaced package. */
+	if (scratch) {
+		auto it = scratch->m_ScratchItems.find(type);
+
+		if (it != scratch->m_ScratchItems.end()) {
+			auto it2 = it->second.find(name);
+
+			if (it2 != it->second.end())
+				return it2->second;
+		}
+	}
+
 	auto it = m_Items.find(type);
 
 	if (it == m_Items.end())
@@ -387,10 +503,13 @@ ConfigItem::Ptr ConfigItem::GetByTypeAndName(const Type::Ptr& type, const String
 	if (it2 == it->second.end())
 		return nullptr;
 
+	if (scratch && it2->second->m_Package == scratch->GetReplacedPackage())
+		return nullptr;
+
 	return it2->second;
 }
 
-bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems)
+bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, TaskGroup& upq, std::vector<ConfigItem::Ptr>& newItems)
 {
 	typedef std::pair<ConfigItem::Ptr, bool> ItemPair;
 	std::unordered_map<Type*, std::vector<ItemPair>> itemsByType;
@@ -484,6 +603,8 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 				auto items (itemsByType.find(type.get()));
 
 				if (items != itemsByType.end()) {
+					double start = Utility::GetTime();
+
 					upq.ParallelFor(items->second, [&committed_items, &newItems, &newItemsMutex](const ItemPair& ip) {
 						const ConfigItem::Ptr& item = ip.first;
 
@@ -502,6 +623,9 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 					});
 
 					upq.Join();
+
+					StartupProfile::AddPhase("config.commit." + type->GetName(), start, Utility::GetTime(),
+						new Dictionary({ { "items", committed_items.load() } }));
 				}
 			}
 
@@ -551,6 +675,8 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 				auto items (itemsByType.find(type.get()));
 
 				if (items != itemsByType.end()) {
+					double start = Utility::GetTime();
+
 					upq.ParallelFor(items->second, [&notified_items](const ItemPair& ip) {
 						const ConfigItem::Ptr& item = ip.first;
 
@@ -577,6 +703,9 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 					});
 
 					upq.Join();
+
+					StartupProfile::AddPhase("config.all_config_loaded." + type->GetName(), start, Utility::GetTime(),
+						new Dictionary({ { "items", notified_items.load() } }));
 				}
 			}
 
@@ -592,6 +721,8 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 				return false;
 
 			notified_items = 0;
+			double applyStart = Utility::GetTime();
+
 			for (auto loadDep : type->GetLoadDependencies()) {
 				auto items (itemsByType.find(loadDep));
 
@@ -603,6 +734,9 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 							return;
 
 						ActivationScope ascope(item->m_ActivationContext);
+
+						/* The apply rules create lots of services etc. for every parent concurrently. */
+						DeferredRegistration deferred;
 						item->m_Object->CreateChildObjects(type);
 						notified_items++;
 					});
@@ -611,6 +745,12 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 
 			upq.Join();
 
+			/* That's where the apply rules for this type are evaluated. */
+			if (notified_items > 0) {
+				StartupProfile::AddPhase("config.apply." + type->GetName(), applyStart, Utility::GetTime(),
+					new Dictionary({ { "parents", notified_items.load() } }));
+			}
+
 #ifdef I2_DEBUG
 			if (notified_items > 0)
 				Log(LogDebug, "configitem")
@@ -629,7 +769,7 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 	return true;
 }
 
-bool ConfigItem::CommitItems(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems, bool silent)
+bool ConfigItem::CommitItems(const ActivationContext::Ptr& context, TaskGroup& upq, std::vector<ConfigItem::Ptr>& newItems, bool silent)
 {
 	if (!silent)
 		Log(LogInformation, "ConfigItem", "Committing config item(s).");
@@ -666,6 +806,146 @@ bool ConfigItem::CommitItems(const ActivationContext::Ptr& context, WorkQueue& u
 	return true;
 }
 
+class ScratchValidationUtils final : public ValidationUtils
+{
+public:
+	ScratchValidationUtils(const String& replacedPackage, const std::map<String, std::set<String>>& names)
+		: m_ReplacedPackage(replacedPackage), m_Names(names)
+	{ }
+
+	bool ValidateName(const String& type, const String& name) const override
+	{
+		auto names (m_Names.find(type));
+
+		if (names != m_Names.end() && names->second.find(name) != names->second.end())
+			return true;
+
+		Type::Ptr ptype = Type::GetByName(type);
+		auto *dtype = dynamic_cast<ConfigType *>(ptype.get());
+
+		if (!dtype)
+			return false;
+
+		ConfigObject::Ptr object = dtype->GetObject(name);
+
+		return object && object->GetPackage() != m_ReplacedPackage;
+	}
+
+private:
+	const String& m_ReplacedPackage;
+	const std::map<String, std::set<String>>& m_Names;
+};
+
+/**
+ * Validates the items of a scratch context against the running config without committing them.
+ *
+ * The objects of the context's replaced package are treated as if they didn't exist anymore.
+ * Apply rules aren't evaluated and the objects' OnConfigLoaded() and OnAllConfigLoaded() aren't called.
+ *
+ * @param context The scratch context
+ * @param upq The task group to evaluate the items in
+ * @param errors The items' errors
+ * @param deadline When to abort evaluating the items, 0 for never
+ * @return Whether all items are valid
+ */
+bool ConfigItem::ValidateScratchItems(const ActivationContext::Ptr& context, TaskGroup& upq, std::vector<String>& errors,
+	double deadline)
+{
+	ASSERT(context->IsScratch());
+
+	std::vector<ConfigItem::Ptr> items;
+
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		for (auto& kv : context->m_ScratchItems) {
+			for (auto& kv2 : kv.second) {
+				if (!kv2.second->m_Abstract)
+					items.emplace_back(kv2.second);
+			}
+		}
+
+		for (auto& item : context->m_ScratchUnnamedItems) {
+			if (!item->m_Abstract)
+				items.emplace_back(item);
+		}
+	}
+
+	std::vector<ConfigObject::Ptr> objects (items.size());
+	std::vector<size_t> indices (items.size());
+	std::map<String, std::set<String>> names;
+	std::mutex mutex;
+
+	std::iota(indices.begin(), indices.end(), 0);
+
+	auto addError ([&errors, &mutex](const String& error) {
+		std::unique_lock<std::mutex> lock(mutex);
+		errors.emplace_back(error);
+	});
+
+	upq.ParallelFor(indices, [&context, &items, &objects, &names, &mutex, &addError, deadline](size_t i) {
+		auto& item (items[i]);
+		ConfigObject::Ptr dobj;
+
+		ActivationScope ascope(context);
+
+		try {
+			dobj = item->EvaluateScratch(deadline);
+		} catch (const std::exception& ex) {
+			if (!item->m_IgnoreOnError)
+				addError(DiagnosticInformation(ex, false));
+
+			return;
+		}
+
+		Type::Ptr type = dobj->GetReflectionType();
+		String name = dobj->GetName();
+		auto *dtype = dynamic_cast<ConfigType *>(type.get());
+		ConfigObject::Ptr existing = dtype ? dtype->GetObject(name) : nullptr;
+		bool duplicate = existing && existing->GetPackage() != context->GetReplacedPackage();
+
+		if (!duplicate) {
+			std::unique_lock<std::mutex> lock(mutex);
+			duplicate = !names[type->GetName()].insert(name).second;
+		}
+
+		if (duplicate) {
+			std::ostringstream msgbuf;
+			msgbuf << "Object '" << name << "' of type '" << type->GetName() << "' re-defined: " << item->m_DebugInfo;
+
+			if (existing && existing->GetPackage() != context->GetReplacedPackage())
+				msgbuf << "; previous definition: " << existing->GetDebugInfo();
+
+			addError(msgbuf.str());
+			return;
+		}
+
+		objects[i] = std::move(dobj);
+	});
+
+	upq.Join();
+
+	ScratchValidationUtils utils (context->GetReplacedPackage(), names);
+
+	upq.ParallelFor(indices, [&items, &objects, &utils, &addError](size_t i) {
+		auto& dobj (objects[i]);
+
+		if (!dobj)
+			return;
+
+		try {
+			dobj->Validate(FAConfig, utils);
+		} catch (const ValidationError& ex) {
+			if (!items[i]->m_IgnoreOnError)
+				addError(DiagnosticInformation(ex, false));
+		}
+	});
+
+	upq.Join();
+
+	return errors.empty();
+}
+
 /**
  * ActivateItems activates new config items.
  *
@@ -698,22 +978,37 @@ bool ConfigItem::ActivateItems(const std::vector<ConfigItem::Ptr>& newItems, boo
 		}
 	}
 
+	/* Group the objects by type once instead of scanning all items for each type. */
+	std::unordered_map<Type *, std::vector<ConfigObject::Ptr>> objectsByType;
+	std::vector<ConfigObject::Ptr> inactiveObjects;
+
 	for (const ConfigItem::Ptr& item : newItems) {
 		if (!item->m_Object)
 			continue;
 
 		ConfigObject::Ptr object = item->m_Object;
 
-		if (object->IsActive())
-			continue;
+		objectsByType[object->GetReflectionType().get()].push_back(object);
+
+		if (!object->IsActive())
+			inactiveObjects.push_back(object);
+	}
 
+	TaskGroup upq ("ConfigItem::ActivateItems");
+
+	upq.ParallelFor(inactiveObjects, [](const ConfigObject::Ptr& object) {
 #ifdef I2_DEBUG
 		Log(LogDebug, "ConfigItem")
 			<< "Setting 'active' to true for object '" << object->GetName() << "' of type '" << object->GetReflectionType()->GetName() << "'";
 #endif /* I2_DEBUG */
 
 		object->PreActivate();
-	}
+	});
+
+	upq.Join();
+
+	if (upq.HasExceptions())
+		boost::rethrow_exception(upq.GetExceptions().front());
 
 	if (mainConfigActivation)
 		Log(LogInformation, "ConfigItem", "Triggering Start signal for config items");
@@ -736,24 +1031,46 @@ bool ConfigItem::ActivateItems(const std::vector<ConfigItem::Ptr>& newItems, boo
 	}
 
 	for (const Type::Ptr& type : types) {
-		for (const ConfigItem::Ptr& item : newItems) {
-			if (!item->m_Object)
-				continue;
+		auto it = objectsByType.find(type.get());
 
-			ConfigObject::Ptr object = item->m_Object;
-			Type::Ptr objectType = object->GetReflectionType();
-
-			if (objectType != type)
-				continue;
+		if (it != objectsByType.end()) {
+			double start = Utility::GetTime();
 
+			/* Objects within a level don't reference each other and are started in parallel. */
+			for (const std::vector<ConfigObject::Ptr>& level : GetActivationLevels(type, it->second)) {
+				auto activate = [&type, runtimeCreated, &cookie](const ConfigObject::Ptr& object) {
 #ifdef I2_DEBUG
-			Log(LogDebug, "ConfigItem")
-				<< "Activating object '" << object->GetName() << "' of type '"
-				<< objectType->GetName() << "' with priority "
-				<< objectType->GetActivationPriority();
+					Log(LogDebug, "ConfigItem")
+						<< "Activating object '" << object->GetName() << "' of type '"
+						<< type->GetName() << "' with priority "
+						<< type->GetActivationPriority();
 #endif /* I2_DEBUG */
 
-			object->Activate(runtimeCreated, cookie);
+					object->Activate(runtimeCreated, cookie);
+				};
+
+				if (level.size() == 1) {
+					activate(level.front());
+					continue;
+				}
+
+				upq.ParallelFor(level, activate);
+				upq.Join();
+
+				if (upq.HasExceptions())
+					boost::rethrow_exception(upq.GetExceptions().front());
+			}
+
+			if (mainConfigActivation) {
+				double end = Utility::GetTime();
+
+				Log(LogInformation, "ConfigItem")
+					<< "Activated " << it->second.size() << " object(s) of type '" << type->GetName()
+					<< "' in " << end - start << "s.";
+
+				StartupProfile::AddPhase("activate." + type->GetName(), start, end,
+					new Dictionary({ { "objects", it->second.size() } }));
+			}
 		}
 
 		if (mainConfigActivation && type == lastLoggerType) {
@@ -765,9 +1082,121 @@ bool ConfigItem::ActivateItems(const std::vector<ConfigItem::Ptr>& newItems, boo
 	if (mainConfigActivation)
 		Log(LogInformation, "ConfigItem", "Activated all objects.");
 
+	/* Only templates need their expressions later on, for the objects created at runtime. */
+	if (Configuration::ReleaseObjectConfig) {
+		for (const ConfigItem::Ptr& item : newItems) {
+			if (item->m_Object && !item->m_Abstract)
+				item->ReleaseConfig();
+		}
+	}
+
 	return true;
 }
 
+/**
+ * Splits objects of the same type into levels which can be activated one
+ * after another. An object is placed in a later level than all objects it
+ * references by name through fields of its own type (e.g. parent zones or
+ * excluded time periods), so the objects of a single level are independent
+ * of each other. Objects which are part of a reference cycle are placed in
+ * levels of their own at the end.
+ *
+ * @param type The type of the objects
+ * @param objects The objects to be activated
+ * @return The activation levels
+ */
+std::vector<std::vector<ConfigObject::Ptr>> ConfigItem::GetActivationLevels(const Type::Ptr& type,
+	const std::vector<ConfigObject::Ptr>& objects)
+{
+	std::vector<int> refFields;
+
+	for (int i = 0; i < type->GetFieldCount(); i++) {
+		Field field = type->GetFieldInfo(i);
+
+		if (field.RefTypeName && field.ArrayRank <= 1 && type->GetName() == field.RefTypeName)
+			refFields.push_back(i);
+	}
+
+	if (refFields.empty() || objects.size() < 2)
+		return { objects };
+
+	std::unordered_map<String, size_t> indices;
+
+	for (size_t i = 0; i < objects.size(); i++)
+		indices.emplace(objects[i]->GetName(), i);
+
+	std::vector<size_t> pending (objects.size(), 0);
+	std::vector<std::vector<size_t>> dependents (objects.size());
+
+	for (size_t i = 0; i < objects.size(); i++) {
+		std::set<size_t> deps;
+
+		auto addDependency = [&indices, &deps, i](const Value& ref) {
+			if (!ref.IsString())
+				return;
+
+			auto it = indices.find(ref);
+
+			if (it != indices.end() && it->second != i)
+				deps.insert(it->second);
+		};
+
+		for (int fid : refFields) {
+			Value value = objects[i]->GetField(fid);
+
+			if (value.IsObjectType<Array>()) {
+				Array::Ptr refs = value;
+				ObjectLock olock(refs);
+
+				for (const Value& ref : refs)
+					addDependency(ref);
+			} else {
+				addDependency(value);
+			}
+		}
+
+		pending[i] = deps.size();
+
+		for (size_t dep : deps)
+			dependents[dep].push_back(i);
+	}
+
+	std::vector<std::vector<ConfigObject::Ptr>> levels;
+	std::vector<size_t> current;
+	std::vector<bool> done (objects.size(), false);
+
+	for (size_t i = 0; i < objects.size(); i++) {
+		if (pending[i] == 0)
+			current.push_back(i);
+	}
+
+	while (!current.empty()) {
+		std::vector<size_t> next;
+		std::vector<ConfigObject::Ptr> level;
+
+		for (size_t i : current) {
+			level.push_back(objects[i]);
+			done[i] = true;
+
+			for (size_t dependent : dependents[i]) {
+				if (--pending[dependent] == 0)
+					next.push_back(dependent);
+			}
+		}
+
+		levels.emplace_back(std::move(level));
+		current = std::move(next);
+	}
+
+	/* Whatever is left is part of (or depends on) a reference cycle. */
+	for (size_t i = 0; i < objects.size(); i++) {
+		if (!done[i])
+			levels.push_back({ objects[i] });
+	}
+
+	return levels;
+}
+
 bool ConfigItem::RunWithActivationContext(const Function::Ptr& function)
 {
 	ActivationScope scope;
@@ -777,8 +1206,7 @@ bool ConfigItem::RunWithActivationContext(const Function::Ptr& function)
 
 	function->Invoke();
 
-	WorkQueue upq(25000, Configuration::Concurrency);
-	upq.SetName("ConfigItem::RunWithActivationContext");
+	TaskGroup upq ("ConfigItem::RunWithActivationContext");
 
 	std::vector<ConfigItem::Ptr> newItems;
 
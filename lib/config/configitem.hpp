@@ -7,7 +7,7 @@
 #include "config/expression.hpp"
 #include "config/activationcontext.hpp"
 #include "base/configobject.hpp"
-#include "base/workqueue.hpp"
+#include "base/taskgroup.hpp"
 
 namespace icinga
 {
@@ -43,6 +43,7 @@ public:
 
 	void Register();
 	void Unregister();
+	void ReleaseConfig();
 
 	DebugInfo GetDebugInfo() const;
 	Dictionary::Ptr GetScope() const;
@@ -52,9 +53,14 @@ public:
 	static ConfigItem::Ptr GetByTypeAndName(const Type::Ptr& type,
 		const String& name);
 
-	static bool CommitItems(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems, bool silent = false);
+	static bool CommitItems(const ActivationContext::Ptr& context, TaskGroup& upq, std::vector<ConfigItem::Ptr>& newItems, bool silent = false);
 	static bool ActivateItems(const std::vector<ConfigItem::Ptr>& newItems, bool runtimeCreated = false,
 		bool mainConfigActivation = false, bool withModAttrs = false, const Value& cookie = Empty);
+	static std::vector<std::vector<ConfigObject::Ptr>> GetActivationLevels(const Type::Ptr& type,
+		const std::vector<ConfigObject::Ptr>& objects);
+
+	static bool ValidateScratchItems(const ActivationContext::Ptr& context, TaskGroup& upq, std::vector<String>& errors,
+		double deadline = 0);
 
 	static bool RunWithActivationContext(const Function::Ptr& function);
 
@@ -63,6 +69,31 @@ public:
 
 	static void RemoveIgnoredItems(const String& allowedConfigPath);
 
+	/**
+	 * While an instance exists, the unnamed items (e.g. the services created by apply rules) which the
+	 * current thread registers are collected locally and added to the other ones all at once by its
+	 * destructor, instead of taking m_Mutex for each of them.
+	 *
+	 * Named items are still registered right away so that duplicates are detected as before.
+	 */
+	class DeferredRegistration
+	{
+	public:
+		DeferredRegistration();
+		~DeferredRegistration();
+
+		DeferredRegistration(const DeferredRegistration&) = delete;
+		DeferredRegistration& operator=(const DeferredRegistration&) = delete;
+
+	private:
+		std::vector<ConfigItem::Ptr> m_Items;
+		DeferredRegistration *m_Previous;
+
+		static thread_local DeferredRegistration *m_Current;
+
+		friend class ConfigItem;
+	};
+
 private:
 	Type::Ptr m_Type; /**< The object type. */
 	String m_Name; /**< The name. */
@@ -97,8 +128,10 @@ private:
 		const String& name);
 
 	ConfigObject::Ptr Commit(bool discard = true);
+	ConfigObject::Ptr EvaluateScratch(double deadline) const;
+	void ComposeName(const ConfigObject::Ptr& dobj) const;
 
-	static bool CommitNewItems(const ActivationContext::Ptr& context, WorkQueue& upq, std::vector<ConfigItem::Ptr>& newItems);
+	static bool CommitNewItems(const ActivationContext::Ptr& context, TaskGroup& upq, std::vector<ConfigItem::Ptr>& newItems);
 };
 
 }
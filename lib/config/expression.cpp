@@ -1,6 +1,7 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "config/expression.hpp"
+#include "config/bytecode.hpp"
 #include "config/configitem.hpp"
 #include "config/configcompiler.hpp"
 #include "config/vmops.hpp"
@@ -478,7 +479,7 @@ ExpressionResult FunctionCallExpression::DoEvaluate(ScriptFrame& frame, DebugHin
 
 	Function::Ptr func = vfunc;
 
-	if (!func->IsSideEffectFree() && frame.Sandboxed)
+	if (!func->IsSideEffectFree() && (frame.Sandboxed || frame.SafeCallsOnly))
 		BOOST_THROW_EXCEPTION(ScriptError("Function is not marked as safe for sandbox mode.", m_DebugInfo));
 
 	std::vector<Value> arguments;
@@ -870,12 +871,17 @@ ExpressionResult ImportExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhi
 	if (!item)
 		BOOST_THROW_EXCEPTION(ScriptError("Import references unknown template: '" + name + "'", m_DebugInfo));
 
+	Expression::Ptr expression = item->GetExpression();
+
+	if (!expression)
+		BOOST_THROW_EXCEPTION(ScriptError("Import references object '" + name + "' whose config was released after its activation (ReleaseObjectConfig).", m_DebugInfo));
+
 	Dictionary::Ptr scope = item->GetScope();
 
 	if (scope)
 		scope->CopyTo(frame.Locals);
 
-	ExpressionResult result = item->GetExpression()->Evaluate(frame, dhint);
+	ExpressionResult result = expression->Evaluate(frame, dhint);
 	CHECK_RESULT(result);
 
 	return Empty;
@@ -902,9 +908,16 @@ ExpressionResult ImportDefaultTemplatesExpression::DoEvaluate(ScriptFrame& frame
 	return Empty;
 }
 
+FunctionExpression::FunctionExpression(String name, std::vector<String> args,
+	std::map<String, std::unique_ptr<Expression> >&& closedVars, std::unique_ptr<Expression> expression, const DebugInfo& debugInfo)
+	: DebuggableExpression(debugInfo), m_Name(std::move(name)), m_Args(std::move(args)), m_ClosedVars(std::move(closedVars)), m_Expression(expression.release())
+{
+	m_CompiledExpression = BytecodeExpression::Compile(m_Expression);
+}
+
 ExpressionResult FunctionExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
 {
-	return VMOps::NewFunction(frame, m_Name, m_Args, m_ClosedVars, m_Expression);
+	return VMOps::NewFunction(frame, m_Name, m_Args, m_ClosedVars, m_CompiledExpression);
 }
 
 ExpressionResult ApplyExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
@@ -930,6 +943,16 @@ ExpressionResult NamespaceExpression::DoEvaluate(ScriptFrame& frame, DebugHint *
 	return ns;
 }
 
+/**
+ * Returns whether evaluating this only registers the object or template, i.e. its type is a variable, its name
+ * a literal and it neither has a filter nor captures variables. The body is only evaluated with the item.
+ */
+bool ObjectExpression::IsPlainDefinition() const
+{
+	return dynamic_cast<VariableExpression *>(m_Type.get()) && (!m_Name || dynamic_cast<LiteralExpression *>(m_Name.get()))
+		&& !m_Filter && m_ClosedVars.empty();
+}
+
 ExpressionResult ObjectExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
 {
 	if (frame.Sandboxed)
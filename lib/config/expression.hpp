@@ -17,6 +17,9 @@
 namespace icinga
 {
 
+class BytecodeExpression;
+class ExpressionCache;
+
 struct DebugHint
 {
 public:
@@ -223,6 +226,8 @@ protected:
 
 private:
 	Expression::Ptr m_Expression;
+
+	friend class ExpressionCache;
 };
 
 class LiteralExpression final : public Expression
@@ -272,6 +277,11 @@ public:
 		: DebuggableExpression(debugInfo), m_Operand(std::move(operand))
 	{ }
 
+	inline const std::unique_ptr<Expression>& GetOperand() const noexcept
+	{
+		return m_Operand;
+	}
+
 protected:
 	std::unique_ptr<Expression> m_Operand;
 };
@@ -316,6 +326,7 @@ private:
 	String m_Variable;
 	std::vector<Expression::Ptr> m_Imports;
 
+	friend class ExpressionCache;
 	friend void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
 };
 
@@ -611,6 +622,9 @@ protected:
 
 private:
 	std::vector<std::unique_ptr<Expression> > m_Expressions;
+
+	friend class BytecodeExpression;
+	friend class ExpressionCache;
 };
 
 class DictExpression final : public DebuggableExpression
@@ -634,6 +648,8 @@ private:
 	std::vector<std::unique_ptr<Expression> > m_Expressions;
 	bool m_Inline{false};
 
+	friend class BytecodeExpression;
+	friend class ExpressionCache;
 	friend void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
 };
 
@@ -648,6 +664,8 @@ protected:
 	String m_Name;
 
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
+
+	friend class ExpressionCache;
 };
 
 class SetExpression final : public BinaryExpression
@@ -666,6 +684,7 @@ private:
 	CombinedSetOp m_Op;
 	bool m_OverrideFrozen{false};
 
+	friend class ExpressionCache;
 	friend void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
 };
 
@@ -683,6 +702,9 @@ private:
 	std::unique_ptr<Expression> m_Condition;
 	std::unique_ptr<Expression> m_TrueBranch;
 	std::unique_ptr<Expression> m_FalseBranch;
+
+	friend class BytecodeExpression;
+	friend class ExpressionCache;
 };
 
 class WhileExpression final : public DebuggableExpression
@@ -698,6 +720,8 @@ protected:
 private:
 	std::unique_ptr<Expression> m_Condition;
 	std::unique_ptr<Expression> m_LoopBody;
+
+	friend class ExpressionCache;
 };
 
 
@@ -746,6 +770,9 @@ protected:
 
 private:
 	ScopeSpecifier m_ScopeSpec;
+
+	friend class BytecodeExpression;
+	friend class ExpressionCache;
 };
 
 class IndexerExpression final : public BinaryExpression
@@ -763,6 +790,7 @@ protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 	bool GetReference(ScriptFrame& frame, bool init_dict, Value *parent, String *index, DebugHint **dhint) const override;
 
+	friend class ExpressionCache;
 	friend void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
 };
 
@@ -781,6 +809,8 @@ protected:
 private:
 	std::unique_ptr<Expression> m_Message;
 	bool m_IncompleteExpr;
+
+	friend class ExpressionCache;
 };
 
 class ImportExpression final : public DebuggableExpression
@@ -795,6 +825,8 @@ protected:
 
 private:
 	std::unique_ptr<Expression> m_Name;
+
+	friend class ExpressionCache;
 };
 
 class ImportDefaultTemplatesExpression final : public DebuggableExpression
@@ -812,9 +844,7 @@ class FunctionExpression final : public DebuggableExpression
 {
 public:
 	FunctionExpression(String name, std::vector<String> args,
-		std::map<String, std::unique_ptr<Expression> >&& closedVars, std::unique_ptr<Expression> expression, const DebugInfo& debugInfo = DebugInfo())
-		: DebuggableExpression(debugInfo), m_Name(std::move(name)), m_Args(std::move(args)), m_ClosedVars(std::move(closedVars)), m_Expression(expression.release())
-	{ }
+		std::map<String, std::unique_ptr<Expression> >&& closedVars, std::unique_ptr<Expression> expression, const DebugInfo& debugInfo = DebugInfo());
 
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
@@ -824,6 +854,9 @@ private:
 	std::vector<String> m_Args;
 	std::map<String, std::unique_ptr<Expression> > m_ClosedVars;
 	Expression::Ptr m_Expression;
+	Expression::Ptr m_CompiledExpression;
+
+	friend class ExpressionCache;
 };
 
 class ApplyExpression final : public DebuggableExpression
@@ -854,6 +887,8 @@ private:
 	bool m_IgnoreOnError;
 	std::map<String, std::unique_ptr<Expression> > m_ClosedVars;
 	Expression::Ptr m_Expression;
+
+	friend class ExpressionCache;
 };
 
 class NamespaceExpression final : public DebuggableExpression
@@ -868,6 +903,8 @@ protected:
 
 private:
 	Expression::Ptr m_Expression;
+
+	friend class ExpressionCache;
 };
 
 class ObjectExpression final : public DebuggableExpression
@@ -881,6 +918,8 @@ public:
 		m_IgnoreOnError(ignoreOnError), m_ClosedVars(std::move(closedVars)), m_Expression(expression.release())
 	{ }
 
+	bool IsPlainDefinition() const;
+
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 
@@ -895,6 +934,8 @@ private:
 	bool m_IgnoreOnError;
 	std::map<String, std::unique_ptr<Expression> > m_ClosedVars;
 	Expression::Ptr m_Expression;
+
+	friend class ExpressionCache;
 };
 
 class ForExpression final : public DebuggableExpression
@@ -912,6 +953,8 @@ private:
 	String m_FVVar;
 	std::unique_ptr<Expression> m_Value;
 	std::unique_ptr<Expression> m_Expression;
+
+	friend class ExpressionCache;
 };
 
 class LibraryExpression final : public UnaryExpression
@@ -953,6 +996,8 @@ private:
 	bool m_SearchIncludes;
 	String m_Zone;
 	String m_Package;
+
+	friend class ExpressionCache;
 };
 
 class BreakpointExpression final : public DebuggableExpression
@@ -979,6 +1024,8 @@ protected:
 private:
 	std::unique_ptr<Expression> m_TryBody;
 	std::unique_ptr<Expression> m_ExceptBody;
+
+	friend class ExpressionCache;
 };
 
 }
@@ -0,0 +1,1117 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "config/expressioncache.hpp"
+#include "base/application.hpp"
+#include "base/atomic-file.hpp"
+#include "base/configuration.hpp"
+#include "base/logger.hpp"
+#include "base/object-packer.hpp"
+#include "base/tlsutility.hpp"
+#include "base/utility.hpp"
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <typeindex>
+#include <unordered_map>
+
+using namespace icinga;
+
+std::atomic<uint_fast64_t> ExpressionCache::m_Hits (0);
+std::atomic<uint_fast64_t> ExpressionCache::m_Misses (0);
+std::mutex ExpressionCache::m_UsedMutex;
+std::unordered_set<String> ExpressionCache::m_Used;
+
+/* Bump this whenever the serialized form of any expression changes. */
+static const uint_fast64_t l_FormatVersion = 1;
+static const char l_Magic[] = "I2XC";
+
+enum ExpressionTag : uint8_t
+{
+	TagNull,
+	TagOwned,
+	TagLiteral,
+	TagVariable,
+	TagDeref,
+	TagRef,
+	TagNegate,
+	TagLogicalNegate,
+	TagAdd,
+	TagSubtract,
+	TagMultiply,
+	TagDivide,
+	TagModulo,
+	TagXor,
+	TagBinaryAnd,
+	TagBinaryOr,
+	TagShiftLeft,
+	TagShiftRight,
+	TagEqual,
+	TagNotEqual,
+	TagLessThan,
+	TagGreaterThan,
+	TagLessThanOrEqual,
+	TagGreaterThanOrEqual,
+	TagIn,
+	TagNotIn,
+	TagLogicalAnd,
+	TagLogicalOr,
+	TagFunctionCall,
+	TagArray,
+	TagDict,
+	TagSetConst,
+	TagSet,
+	TagConditional,
+	TagWhile,
+	TagReturn,
+	TagBreak,
+	TagContinue,
+	TagGetScope,
+	TagIndexer,
+	TagThrow,
+	TagImport,
+	TagImportDefaultTemplates,
+	TagFunction,
+	TagApply,
+	TagNamespace,
+	TagObject,
+	TagFor,
+	TagLibrary,
+	TagInclude,
+	TagBreakpoint,
+	TagTryExcept
+};
+
+static const std::unordered_map<std::type_index, ExpressionTag> l_ExpressionTags {
+	{ typeid(OwnedExpression), TagOwned },
+	{ typeid(LiteralExpression), TagLiteral },
+	{ typeid(VariableExpression), TagVariable },
+	{ typeid(DerefExpression), TagDeref },
+	{ typeid(RefExpression), TagRef },
+	{ typeid(NegateExpression), TagNegate },
+	{ typeid(LogicalNegateExpression), TagLogicalNegate },
+	{ typeid(AddExpression), TagAdd },
+	{ typeid(SubtractExpression), TagSubtract },
+	{ typeid(MultiplyExpression), TagMultiply },
+	{ typeid(DivideExpression), TagDivide },
+	{ typeid(ModuloExpression), TagModulo },
+	{ typeid(XorExpression), TagXor },
+	{ typeid(BinaryAndExpression), TagBinaryAnd },
+	{ typeid(BinaryOrExpression), TagBinaryOr },
+	{ typeid(ShiftLeftExpression), TagShiftLeft },
+	{ typeid(ShiftRightExpression), TagShiftRight },
+	{ typeid(EqualExpression), TagEqual },
+	{ typeid(NotEqualExpression), TagNotEqual },
+	{ typeid(LessThanExpression), TagLessThan },
+	{ typeid(GreaterThanExpression), TagGreaterThan },
+	{ typeid(LessThanOrEqualExpression), TagLessThanOrEqual },
+	{ typeid(GreaterThanOrEqualExpression), TagGreaterThanOrEqual },
+	{ typeid(InExpression), TagIn },
+	{ typeid(NotInExpression), TagNotIn },
+	{ typeid(LogicalAndExpression), TagLogicalAnd },
+	{ typeid(LogicalOrExpression), TagLogicalOr },
+	{ typeid(FunctionCallExpression), TagFunctionCall },
+	{ typeid(ArrayExpression), TagArray },
+	{ typeid(DictExpression), TagDict },
+	{ typeid(SetConstExpression), TagSetConst },
+	{ typeid(SetExpression), TagSet },
+	{ typeid(ConditionalExpression), TagConditional },
+	{ typeid(WhileExpression), TagWhile },
+	{ typeid(ReturnExpression), TagReturn },
+	{ typeid(BreakExpression), TagBreak },
+	{ typeid(ContinueExpression), TagContinue },
+	{ typeid(GetScopeExpression), TagGetScope },
+	{ typeid(IndexerExpression), TagIndexer },
+	{ typeid(ThrowExpression), TagThrow },
+	{ typeid(ImportExpression), TagImport },
+	{ typeid(ImportDefaultTemplatesExpression), TagImportDefaultTemplates },
+	{ typeid(FunctionExpression), TagFunction },
+	{ typeid(ApplyExpression), TagApply },
+	{ typeid(NamespaceExpression), TagNamespace },
+	{ typeid(ObjectExpression), TagObject },
+	{ typeid(ForExpression), TagFor },
+	{ typeid(LibraryExpression), TagLibrary },
+	{ typeid(IncludeExpression), TagInclude },
+	{ typeid(BreakpointExpression), TagBreakpoint },
+	{ typeid(TryExceptExpression), TagTryExcept }
+};
+
+/* VariableExpression's constructor always appends these, they're not serialized. */
+static const size_t l_DefaultImports = 4;
+
+enum LiteralType : uint8_t
+{
+	LiteralEmpty,
+	LiteralNumber,
+	LiteralBoolean,
+	LiteralString,
+	LiteralPacked
+};
+
+/**
+ * Encodes primitives into a byte buffer. Strings are interned: the first
+ * occurrence is written inline, later ones just refer to it.
+ */
+struct ExpressionCache::Writer
+{
+	std::string Buffer;
+	std::unordered_map<String, uint_fast64_t> Strings;
+
+	void WriteByte(uint8_t value)
+	{
+		Buffer.push_back(static_cast<char>(value));
+	}
+
+	void WriteBool(bool value)
+	{
+		WriteByte(value ? 1 : 0);
+	}
+
+	void WriteVarint(uint_fast64_t value)
+	{
+		while (value >= 0x80u) {
+			WriteByte(static_cast<uint8_t>(value | 0x80u));
+			value >>= 7u;
+		}
+
+		WriteByte(static_cast<uint8_t>(value));
+	}
+
+	void WriteInt(int64_t value)
+	{
+		WriteVarint((static_cast<uint64_t>(value) << 1u) ^ static_cast<uint64_t>(value >> 63));
+	}
+
+	void WriteDouble(double value)
+	{
+		char buf[sizeof(value)];
+		memcpy(buf, &value, sizeof(buf));
+		Buffer.append(buf, sizeof(buf));
+	}
+
+	void WriteRawString(const String& value)
+	{
+		WriteVarint(value.GetLength());
+		Buffer.append(value.GetData());
+	}
+
+	void WriteString(const String& value)
+	{
+		auto it (Strings.find(value));
+
+		if (it != Strings.end()) {
+			WriteVarint(it->second);
+			return;
+		}
+
+		auto index (Strings.size());
+		Strings.emplace(value, index);
+		WriteVarint(index);
+		WriteRawString(value);
+	}
+
+	void WriteDebugInfo(const DebugInfo& di)
+	{
+		WriteString(di.Path);
+		WriteInt(di.FirstLine);
+		WriteInt(di.FirstColumn);
+		WriteInt(di.LastLine);
+		WriteInt(di.LastColumn);
+	}
+
+	void WriteValue(const Value& value)
+	{
+		switch (value.GetType()) {
+			case ValueEmpty:
+				WriteByte(LiteralEmpty);
+				break;
+			case ValueNumber:
+				WriteByte(LiteralNumber);
+				WriteDouble(value.Get<double>());
+				break;
+			case ValueBoolean:
+				WriteByte(LiteralBoolean);
+				WriteBool(value.Get<bool>());
+				break;
+			case ValueString:
+				WriteByte(LiteralString);
+				WriteString(value.Get<String>());
+				break;
+			case ValueObject:
+				if (!value.IsObjectType<Array>() && !value.IsObjectType<Dictionary>())
+					throw std::invalid_argument("Literals of type '" + value.GetTypeName() + "' can't be cached.");
+
+				WriteByte(LiteralPacked);
+				WriteRawString(PackObject(value));
+				break;
+			default:
+				VERIFY(!"Invalid variant type.");
+		}
+	}
+};
+
+/**
+ * Counterpart of ExpressionCache::Writer, throws std::invalid_argument on malformed input.
+ */
+struct ExpressionCache::Reader
+{
+	const String& Buffer;
+	size_t Offset{0};
+	std::vector<String> Strings;
+
+	Reader(const String& buffer)
+		: Buffer(buffer)
+	{ }
+
+	void Require(size_t length)
+	{
+		if (Buffer.GetLength() - Offset < length)
+			throw std::invalid_argument("Unexpected end of cached expression");
+	}
+
+	uint8_t ReadByte()
+	{
+		Require(1);
+		return static_cast<uint8_t>(Buffer[Offset++]);
+	}
+
+	bool ReadBool()
+	{
+		return ReadByte() != 0;
+	}
+
+	uint_fast64_t ReadVarint()
+	{
+		uint_fast64_t value = 0;
+
+		for (unsigned int shift = 0; shift < 64; shift += 7) {
+			uint8_t byte = ReadByte();
+
+			value |= static_cast<uint_fast64_t>(byte & 0x7fu) << shift;
+
+			if (!(byte & 0x80u))
+				return value;
+		}
+
+		throw std::invalid_argument("Invalid varint in cached expression");
+	}
+
+	int64_t ReadInt()
+	{
+		auto value (ReadVarint());
+		return static_cast<int64_t>(value >> 1u) ^ -static_cast<int64_t>(value & 1u);
+	}
+
+	int ReadInt32()
+	{
+		return static_cast<int>(ReadInt());
+	}
+
+	double ReadDouble()
+	{
+		double value;
+		Require(sizeof(value));
+		memcpy(&value, Buffer.CStr() + Offset, sizeof(value));
+		Offset += sizeof(value);
+		return value;
+	}
+
+	String ReadRawString()
+	{
+		auto length (ReadVarint());
+		Require(length);
+
+		String value (Buffer.GetData().substr(Offset, length));
+		Offset += length;
+		return value;
+	}
+
+	const String& ReadString()
+	{
+		auto index (ReadVarint());
+
+		if (index == Strings.size())
+			Strings.emplace_back(ReadRawString());
+		else if (index > Strings.size())
+			throw std::invalid_argument("Invalid string reference in cached expression");
+
+		return Strings[index];
+	}
+
+	DebugInfo ReadDebugInfo()
+	{
+		DebugInfo di;
+		di.Path = ReadString();
+		di.FirstLine = ReadInt32();
+		di.FirstColumn = ReadInt32();
+		di.LastLine = ReadInt32();
+		di.LastColumn = ReadInt32();
+		return di;
+	}
+
+	Value ReadValue()
+	{
+		switch (ReadByte()) {
+			case LiteralEmpty:
+				return Empty;
+			case LiteralNumber:
+				return ReadDouble();
+			case LiteralBoolean:
+				return ReadBool();
+			case LiteralString:
+				return ReadString();
+			case LiteralPacked:
+				return UnpackObject(ReadRawString());
+			default:
+				throw std::invalid_argument("Invalid literal type in cached expression");
+		}
+	}
+};
+
+static std::unique_ptr<Expression> MakeUnary(ExpressionTag tag, std::unique_ptr<Expression> operand, const DebugInfo& di)
+{
+	switch (tag) {
+		case TagDeref:
+			return std::unique_ptr<Expression>(new DerefExpression(std::move(operand), di));
+		case TagRef:
+			return std::unique_ptr<Expression>(new RefExpression(std::move(operand), di));
+		case TagNegate:
+			return std::unique_ptr<Expression>(new NegateExpression(std::move(operand), di));
+		case TagLogicalNegate:
+			return std::unique_ptr<Expression>(new LogicalNegateExpression(std::move(operand), di));
+		case TagReturn:
+			return std::unique_ptr<Expression>(new ReturnExpression(std::move(operand), di));
+		case TagLibrary:
+			return std::unique_ptr<Expression>(new LibraryExpression(std::move(operand), di));
+		default:
+			throw std::invalid_argument("Invalid unary expression tag");
+	}
+}
+
+static std::unique_ptr<Expression> MakeBinary(ExpressionTag tag, std::unique_ptr<Expression> op1, std::unique_ptr<Expression> op2, const DebugInfo& di)
+{
+	switch (tag) {
+		case TagAdd:
+			return std::unique_ptr<Expression>(new AddExpression(std::move(op1), std::move(op2), di));
+		case TagSubtract:
+			return std::unique_ptr<Expression>(new SubtractExpression(std::move(op1), std::move(op2), di));
+		case TagMultiply:
+			return std::unique_ptr<Expression>(new MultiplyExpression(std::move(op1), std::move(op2), di));
+		case TagDivide:
+			return std::unique_ptr<Expression>(new DivideExpression(std::move(op1), std::move(op2), di));
+		case TagModulo:
+			return std::unique_ptr<Expression>(new ModuloExpression(std::move(op1), std::move(op2), di));
+		case TagXor:
+			return std::unique_ptr<Expression>(new XorExpression(std::move(op1), std::move(op2), di));
+		case TagBinaryAnd:
+			return std::unique_ptr<Expression>(new BinaryAndExpression(std::move(op1), std::move(op2), di));
+		case TagBinaryOr:
+			return std::unique_ptr<Expression>(new BinaryOrExpression(std::move(op1), std::move(op2), di));
+		case TagShiftLeft:
+			return std::unique_ptr<Expression>(new ShiftLeftExpression(std::move(op1), std::move(op2), di));
+		case TagShiftRight:
+			return std::unique_ptr<Expression>(new ShiftRightExpression(std::move(op1), std::move(op2), di));
+		case TagEqual:
+			return std::unique_ptr<Expression>(new EqualExpression(std::move(op1), std::move(op2), di));
+		case TagNotEqual:
+			return std::unique_ptr<Expression>(new NotEqualExpression(std::move(op1), std::move(op2), di));
+		case TagLessThan:
+			return std::unique_ptr<Expression>(new LessThanExpression(std::move(op1), std::move(op2), di));
+		case TagGreaterThan:
+			return std::unique_ptr<Expression>(new GreaterThanExpression(std::move(op1), std::move(op2), di));
+		case TagLessThanOrEqual:
+			return std::unique_ptr<Expression>(new LessThanOrEqualExpression(std::move(op1), std::move(op2), di));
+		case TagGreaterThanOrEqual:
+			return std::unique_ptr<Expression>(new GreaterThanOrEqualExpression(std::move(op1), std::move(op2), di));
+		case TagIn:
+			return std::unique_ptr<Expression>(new InExpression(std::move(op1), std::move(op2), di));
+		case TagNotIn:
+			return std::unique_ptr<Expression>(new NotInExpression(std::move(op1), std::move(op2), di));
+		case TagLogicalAnd:
+			return std::unique_ptr<Expression>(new LogicalAndExpression(std::move(op1), std::move(op2), di));
+		case TagLogicalOr:
+			return std::unique_ptr<Expression>(new LogicalOrExpression(std::move(op1), std::move(op2), di));
+		default:
+			throw std::invalid_argument("Invalid binary expression tag");
+	}
+}
+
+ExpressionCache::ExpressionCache(String path, String zone, String package)
+	: m_Path(std::move(path)), m_Zone(std::move(zone)), m_Package(std::move(package))
+{
+	namespace fs = boost::filesystem;
+
+	m_CacheFile = GetCacheDir() + "/" + SHA256(m_Path + "\n" + m_Zone + "\n" + m_Package) + ".cache";
+
+	{
+		std::unique_lock<std::mutex> lock (m_UsedMutex);
+		m_Used.emplace(m_CacheFile);
+	}
+
+	boost::system::error_code ec;
+	fs::path fpath (m_Path.GetData());
+
+	auto mtime (fs::last_write_time(fpath, ec));
+
+	if (ec)
+		return;
+
+	auto size (fs::file_size(fpath, ec));
+
+	if (ec)
+		return;
+
+	m_Mtime = mtime;
+	m_Size = size;
+}
+
+/**
+ * Looks up the cached expression tree for the file.
+ *
+ * If this returns nullptr, the file's content has been read from the
+ * stream and is available via GetContent().
+ *
+ * @param stream The opened config file.
+ * @returns The cached expression or nullptr if there's no usable entry.
+ */
+std::unique_ptr<Expression> ExpressionCache::Lookup(std::istream& stream)
+{
+	String data;
+
+	{
+		std::ifstream fp (m_CacheFile.CStr(), std::ifstream::in | std::ifstream::binary);
+
+		if (fp)
+			data = String(std::string(std::istreambuf_iterator<char>(fp), std::istreambuf_iterator<char>()));
+	}
+
+	/* Headers are written with WriteRawString() so that the payload's string table stands alone. */
+	Reader reader (data);
+	bool valid = false;
+	int64_t mtime = -1, size = -1;
+	String hash;
+
+	try {
+		valid = !data.IsEmpty()
+			&& reader.ReadRawString() == l_Magic
+			&& reader.ReadVarint() == l_FormatVersion
+			&& reader.ReadRawString() == Application::GetAppVersion()
+			&& reader.ReadRawString() == m_Path
+			&& reader.ReadRawString() == m_Zone
+			&& reader.ReadRawString() == m_Package;
+
+		if (valid) {
+			mtime = reader.ReadInt();
+			size = reader.ReadInt();
+			hash = reader.ReadRawString();
+		}
+	} catch (const std::invalid_argument&) {
+		valid = false;
+	}
+
+	bool unchanged = valid && m_Mtime >= 0 && mtime == m_Mtime && size == m_Size;
+
+	if (!unchanged) {
+		m_Content = String(std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()));
+		m_Hash = SHA256(m_Content);
+	}
+
+	if (valid && (unchanged || hash == m_Hash)) {
+		String payload (data.GetData().substr(reader.Offset));
+
+		try {
+			std::unique_ptr<Expression> expression = Deserialize(payload);
+
+			m_Hits++;
+
+			/* Only the mtime changed: refresh the header so the next lookup can skip hashing. */
+			if (!unchanged)
+				WriteEntry(payload);
+
+			return expression;
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "ExpressionCache")
+				<< "Ignoring corrupt cache entry for '" << m_Path << "': " << ex.what();
+		}
+
+		if (unchanged) {
+			m_Content = String(std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()));
+			m_Hash = SHA256(m_Content);
+		}
+	}
+
+	m_Misses++;
+
+	return nullptr;
+}
+
+/**
+ * Stores the compiled expression tree for the file. Must only be called
+ * after a failed Lookup().
+ *
+ * @param expression The expression compiled from GetContent().
+ */
+void ExpressionCache::Store(const Expression *expression)
+{
+	String payload;
+
+	try {
+		payload = Serialize(expression);
+	} catch (const std::invalid_argument& ex) {
+		Log(LogNotice, "ExpressionCache")
+			<< "Not caching '" << m_Path << "': " << ex.what();
+		return;
+	}
+
+	WriteEntry(payload);
+}
+
+void ExpressionCache::WriteEntry(const String& payload)
+{
+	Writer writer;
+	writer.WriteRawString(l_Magic);
+	writer.WriteVarint(l_FormatVersion);
+	writer.WriteRawString(Application::GetAppVersion());
+	writer.WriteRawString(m_Path);
+	writer.WriteRawString(m_Zone);
+	writer.WriteRawString(m_Package);
+
+	/* A file modified within the mtime's resolution might change again without
+	 * its mtime changing. Make the next lookup fall back to the content hash.
+	 */
+	writer.WriteInt(m_Mtime >= 0 && m_Mtime < Utility::GetTime() - 1 ? m_Mtime : -1);
+	writer.WriteInt(m_Size);
+	writer.WriteRawString(m_Hash);
+	writer.Buffer.append(payload.GetData());
+
+	try {
+		Utility::MkDirP(GetCacheDir(), 0750);
+		AtomicFile::Write(m_CacheFile, 0600, writer.Buffer);
+	} catch (const std::exception& ex) {
+		Log(LogNotice, "ExpressionCache")
+			<< "Cannot write cache entry for '" << m_Path << "': " << DiagnosticInformation(ex, false);
+	}
+}
+
+const String& ExpressionCache::GetContent() const
+{
+	return m_Content;
+}
+
+bool ExpressionCache::IsEnabled()
+{
+	return !Configuration::CacheDir.IsEmpty();
+}
+
+String ExpressionCache::GetCacheDir()
+{
+	return Configuration::CacheDir + "/config";
+}
+
+String ExpressionCache::Serialize(const Expression *expression)
+{
+	Writer writer;
+	WriteExpression(writer, expression);
+	return std::move(writer.Buffer);
+}
+
+std::unique_ptr<Expression> ExpressionCache::Deserialize(const String& data)
+{
+	Reader reader (data);
+	std::unique_ptr<Expression> expression = ReadExpression(reader);
+
+	if (reader.Offset != data.GetLength())
+		throw std::invalid_argument("Trailing data after cached expression");
+
+	return expression;
+}
+
+uint_fast64_t ExpressionCache::GetHits()
+{
+	return m_Hits.load();
+}
+
+uint_fast64_t ExpressionCache::GetMisses()
+{
+	return m_Misses.load();
+}
+
+/**
+ * Removes the entries of all files which haven't been compiled by this process,
+ * e.g. of deleted files or old config package stages. Must only be called after
+ * the whole config has been loaded.
+ *
+ * @returns The number of removed entries.
+ */
+size_t ExpressionCache::RemoveUnusedEntries()
+{
+	std::vector<String> unused;
+
+	{
+		std::unique_lock<std::mutex> lock (m_UsedMutex);
+
+		Utility::Glob(GetCacheDir() + "/*.cache", [&unused](const String& file) {
+			if (m_Used.find(file) == m_Used.end())
+				unused.emplace_back(file);
+		}, GlobFile);
+	}
+
+	size_t removed = 0;
+
+	for (auto& file : unused) {
+		boost::system::error_code ec;
+
+		if (boost::filesystem::remove(file.GetData(), ec)) {
+			removed++;
+		} else if (ec) {
+			Log(LogNotice, "ExpressionCache")
+				<< "Cannot remove unused cache entry '" << file << "': " << ec.message();
+		}
+	}
+
+	return removed;
+}
+
+void ExpressionCache::WriteClosedVars(Writer& writer, const std::map<String, std::unique_ptr<Expression> >& closedVars)
+{
+	writer.WriteVarint(closedVars.size());
+
+	for (auto& kv : closedVars) {
+		writer.WriteString(kv.first);
+		WriteExpression(writer, kv.second.get());
+	}
+}
+
+std::map<String, std::unique_ptr<Expression> > ExpressionCache::ReadClosedVars(Reader& reader)
+{
+	std::map<String, std::unique_ptr<Expression> > closedVars;
+
+	for (auto count (reader.ReadVarint()); count; count--) {
+		String name = reader.ReadString();
+		closedVars.emplace(std::move(name), ReadExpression(reader));
+	}
+
+	return closedVars;
+}
+
+void ExpressionCache::WriteExpression(Writer& writer, const Expression *expression)
+{
+	if (!expression) {
+		writer.WriteByte(TagNull);
+		return;
+	}
+
+	auto it (l_ExpressionTags.find(typeid(*expression)));
+
+	if (it == l_ExpressionTags.end())
+		throw std::invalid_argument(String("Expressions of type '") + typeid(*expression).name() + "' can't be cached.");
+
+	auto tag (it->second);
+	writer.WriteByte(tag);
+
+	switch (tag) {
+		case TagOwned:
+			WriteExpression(writer, static_cast<const OwnedExpression *>(expression)->m_Expression.get());
+			return;
+		case TagLiteral:
+			writer.WriteValue(static_cast<const LiteralExpression *>(expression)->GetValue());
+			return;
+		case TagGetScope:
+			writer.WriteByte(static_cast<const GetScopeExpression *>(expression)->m_ScopeSpec);
+			return;
+		default:
+			break;
+	}
+
+	/* All remaining expressions are DebuggableExpressions. */
+	writer.WriteDebugInfo(expression->GetDebugInfo());
+
+	switch (tag) {
+		case TagVariable: {
+			auto expr (static_cast<const VariableExpression *>(expression));
+			writer.WriteString(expr->m_Variable);
+
+			VERIFY(expr->m_Imports.size() >= l_DefaultImports);
+			auto imports (expr->m_Imports.size() - l_DefaultImports);
+
+			writer.WriteVarint(imports);
+
+			for (size_t i = 0; i < imports; i++)
+				WriteExpression(writer, expr->m_Imports[i].get());
+
+			break;
+		}
+		case TagDeref:
+		case TagRef:
+		case TagNegate:
+		case TagLogicalNegate:
+		case TagReturn:
+		case TagLibrary:
+			WriteExpression(writer, static_cast<const UnaryExpression *>(expression)->GetOperand().get());
+			break;
+		case TagSetConst: {
+			auto expr (static_cast<const SetConstExpression *>(expression));
+			writer.WriteString(expr->m_Name);
+			WriteExpression(writer, expr->GetOperand().get());
+			break;
+		}
+		case TagSet: {
+			auto expr (static_cast<const SetExpression *>(expression));
+			writer.WriteByte(expr->m_Op);
+			writer.WriteBool(expr->m_OverrideFrozen);
+			WriteExpression(writer, expr->GetOperand1().get());
+			WriteExpression(writer, expr->GetOperand2().get());
+			break;
+		}
+		case TagIndexer: {
+			auto expr (static_cast<const IndexerExpression *>(expression));
+			writer.WriteBool(expr->m_OverrideFrozen);
+			WriteExpression(writer, expr->GetOperand1().get());
+			WriteExpression(writer, expr->GetOperand2().get());
+			break;
+		}
+		case TagFunctionCall: {
+			auto expr (static_cast<const FunctionCallExpression *>(expression));
+			WriteExpression(writer, expr->m_FName.get());
+			writer.WriteVarint(expr->m_Args.size());
+
+			for (auto& arg : expr->m_Args)
+				WriteExpression(writer, arg.get());
+
+			break;
+		}
+		case TagArray: {
+			auto expr (static_cast<const ArrayExpression *>(expression));
+			writer.WriteVarint(expr->m_Expressions.size());
+
+			for (auto& item : expr->m_Expressions)
+				WriteExpression(writer, item.get());
+
+			break;
+		}
+		case TagDict: {
+			auto expr (static_cast<const DictExpression *>(expression));
+			writer.WriteBool(expr->m_Inline);
+			writer.WriteVarint(expr->m_Expressions.size());
+
+			for (auto& item : expr->m_Expressions)
+				WriteExpression(writer, item.get());
+
+			break;
+		}
+		case TagConditional: {
+			auto expr (static_cast<const ConditionalExpression *>(expression));
+			WriteExpression(writer, expr->m_Condition.get());
+			WriteExpression(writer, expr->m_TrueBranch.get());
+			WriteExpression(writer, expr->m_FalseBranch.get());
+			break;
+		}
+		case TagWhile: {
+			auto expr (static_cast<const WhileExpression *>(expression));
+			WriteExpression(writer, expr->m_Condition.get());
+			WriteExpression(writer, expr->m_LoopBody.get());
+			break;
+		}
+		case TagBreak:
+		case TagContinue:
+		case TagImportDefaultTemplates:
+		case TagBreakpoint:
+			break;
+		case TagThrow: {
+			auto expr (static_cast<const ThrowExpression *>(expression));
+			writer.WriteBool(expr->m_IncompleteExpr);
+			WriteExpression(writer, expr->m_Message.get());
+			break;
+		}
+		case TagImport:
+			WriteExpression(writer, static_cast<const ImportExpression *>(expression)->m_Name.get());
+			break;
+		case TagFunction: {
+			auto expr (static_cast<const FunctionExpression *>(expression));
+			writer.WriteString(expr->m_Name);
+			writer.WriteVarint(expr->m_Args.size());
+
+			for (auto& arg : expr->m_Args)
+				writer.WriteString(arg);
+
+			WriteClosedVars(writer, expr->m_ClosedVars);
+			WriteExpression(writer, expr->m_Expression.get());
+			break;
+		}
+		case TagApply: {
+			auto expr (static_cast<const ApplyExpression *>(expression));
+			writer.WriteString(expr->m_Type);
+			writer.WriteString(expr->m_Target);
+			writer.WriteString(expr->m_Package);
+			writer.WriteString(expr->m_FKVar);
+			writer.WriteString(expr->m_FVVar);
+			writer.WriteBool(expr->m_IgnoreOnError);
+			WriteExpression(writer, expr->m_Name.get());
+			WriteExpression(writer, expr->m_Filter.get());
+			WriteExpression(writer, expr->m_FTerm.get());
+			WriteClosedVars(writer, expr->m_ClosedVars);
+			WriteExpression(writer, expr->m_Expression.get());
+			break;
+		}
+		case TagNamespace:
+			WriteExpression(writer, static_cast<const NamespaceExpression *>(expression)->m_Expression.get());
+			break;
+		case TagObject: {
+			auto expr (static_cast<const ObjectExpression *>(expression));
+			writer.WriteBool(expr->m_Abstract);
+			writer.WriteString(expr->m_Zone);
+			writer.WriteString(expr->m_Package);
+			writer.WriteBool(expr->m_DefaultTmpl);
+			writer.WriteBool(expr->m_IgnoreOnError);
+			WriteExpression(writer, expr->m_Type.get());
+			WriteExpression(writer, expr->m_Name.get());
+			WriteExpression(writer, expr->m_Filter.get());
+			WriteClosedVars(writer, expr->m_ClosedVars);
+			WriteExpression(writer, expr->m_Expression.get());
+			break;
+		}
+		case TagFor: {
+			auto expr (static_cast<const ForExpression *>(expression));
+			writer.WriteString(expr->m_FKVar);
+			writer.WriteString(expr->m_FVVar);
+			WriteExpression(writer, expr->m_Value.get());
+			WriteExpression(writer, expr->m_Expression.get());
+			break;
+		}
+		case TagInclude: {
+			auto expr (static_cast<const IncludeExpression *>(expression));
+			writer.WriteString(expr->m_RelativeBase);
+			writer.WriteByte(expr->m_Type);
+			writer.WriteBool(expr->m_SearchIncludes);
+			writer.WriteString(expr->m_Zone);
+			writer.WriteString(expr->m_Package);
+			WriteExpression(writer, expr->m_Path.get());
+			WriteExpression(writer, expr->m_Pattern.get());
+			WriteExpression(writer, expr->m_Name.get());
+			break;
+		}
+		case TagTryExcept: {
+			auto expr (static_cast<const TryExceptExpression *>(expression));
+			WriteExpression(writer, expr->m_TryBody.get());
+			WriteExpression(writer, expr->m_ExceptBody.get());
+			break;
+		}
+		default:
+			WriteExpression(writer, static_cast<const BinaryExpression *>(expression)->GetOperand1().get());
+			WriteExpression(writer, static_cast<const BinaryExpression *>(expression)->GetOperand2().get());
+	}
+}
+
+std::unique_ptr<Expression> ExpressionCache::ReadExpression(Reader& reader)
+{
+	auto tag (reader.ReadByte());
+
+	if (tag > TagTryExcept)
+		throw std::invalid_argument("Invalid expression tag in cached expression");
+
+	switch (tag) {
+		case TagNull:
+			return nullptr;
+		case TagOwned: {
+			std::unique_ptr<Expression> inner = ReadExpression(reader);
+			return std::unique_ptr<Expression>(new OwnedExpression(inner.release()));
+		}
+		case TagLiteral:
+			return MakeLiteral(reader.ReadValue());
+		case TagGetScope:
+			return std::unique_ptr<Expression>(new GetScopeExpression(static_cast<ScopeSpecifier>(reader.ReadByte())));
+		default:
+			break;
+	}
+
+	/* Operands are read into locals first to keep the stream order independent of argument evaluation order. */
+	DebugInfo di = reader.ReadDebugInfo();
+
+	switch (tag) {
+		case TagVariable: {
+			String variable = reader.ReadString();
+			std::vector<Expression::Ptr> imports;
+
+			for (auto count (reader.ReadVarint()); count; count--)
+				imports.emplace_back(ReadExpression(reader).release());
+
+			return std::unique_ptr<Expression>(new VariableExpression(std::move(variable), std::move(imports), di));
+		}
+		case TagDeref:
+		case TagRef:
+		case TagNegate:
+		case TagLogicalNegate:
+		case TagReturn:
+		case TagLibrary: {
+			std::unique_ptr<Expression> operand = ReadExpression(reader);
+			return MakeUnary(static_cast<ExpressionTag>(tag), std::move(operand), di);
+		}
+		case TagSetConst: {
+			String name = reader.ReadString();
+			std::unique_ptr<Expression> operand = ReadExpression(reader);
+			return std::unique_ptr<Expression>(new SetConstExpression(name, std::move(operand), di));
+		}
+		case TagSet: {
+			auto op (static_cast<CombinedSetOp>(reader.ReadByte()));
+			bool overrideFrozen = reader.ReadBool();
+			std::unique_ptr<Expression> op1 = ReadExpression(reader);
+			std::unique_ptr<Expression> op2 = ReadExpression(reader);
+
+			std::unique_ptr<SetExpression> expr {new SetExpression(std::move(op1), op, std::move(op2), di)};
+
+			if (overrideFrozen)
+				expr->SetOverrideFrozen();
+
+			return std::move(expr);
+		}
+		case TagIndexer: {
+			bool overrideFrozen = reader.ReadBool();
+			std::unique_ptr<Expression> op1 = ReadExpression(reader);
+			std::unique_ptr<Expression> op2 = ReadExpression(reader);
+
+			std::unique_ptr<IndexerExpression> expr {new IndexerExpression(std::move(op1), std::move(op2), di)};
+
+			if (overrideFrozen)
+				expr->SetOverrideFrozen();
+
+			return std::move(expr);
+		}
+		case TagFunctionCall: {
+			std::unique_ptr<Expression> fname = ReadExpression(reader);
+			std::vector<std::unique_ptr<Expression> > args;
+
+			for (auto count (reader.ReadVarint()); count; count--)
+				args.emplace_back(ReadExpression(reader));
+
+			return std::unique_ptr<Expression>(new FunctionCallExpression(std::move(fname), std::move(args), di));
+		}
+		case TagArray: {
+			std::vector<std::unique_ptr<Expression> > items;
+
+			for (auto count (reader.ReadVarint()); count; count--)
+				items.emplace_back(ReadExpression(reader));
+
+			return std::unique_ptr<Expression>(new ArrayExpression(std::move(items), di));
+		}
+		case TagDict: {
+			bool isInline = reader.ReadBool();
+			std::vector<std::unique_ptr<Expression> > items;
+
+			for (auto count (reader.ReadVarint()); count; count--)
+				items.emplace_back(ReadExpression(reader));
+
+			std::unique_ptr<DictExpression> expr {new DictExpression(std::move(items), di)};
+
+			if (isInline)
+				expr->MakeInline();
+
+			return std::move(expr);
+		}
+		case TagConditional: {
+			std::unique_ptr<Expression> condition = ReadExpression(reader);
+			std::unique_ptr<Expression> trueBranch = ReadExpression(reader);
+			std::unique_ptr<Expression> falseBranch = ReadExpression(reader);
+			return std::unique_ptr<Expression>(new ConditionalExpression(std::move(condition), std::move(trueBranch), std::move(falseBranch), di));
+		}
+		case TagWhile: {
+			std::unique_ptr<Expression> condition = ReadExpression(reader);
+			std::unique_ptr<Expression> loopBody = ReadExpression(reader);
+			return std::unique_ptr<Expression>(new WhileExpression(std::move(condition), std::move(loopBody), di));
+		}
+		case TagBreak:
+			return std::unique_ptr<Expression>(new BreakExpression(di));
+		case TagContinue:
+			return std::unique_ptr<Expression>(new ContinueExpression(di));
+		case TagImportDefaultTemplates:
+			return std::unique_ptr<Expression>(new ImportDefaultTemplatesExpression(di));
+		case TagBreakpoint:
+			return std::unique_ptr<Expression>(new BreakpointExpression(di));
+		case TagThrow: {
+			bool incompleteExpr = reader.ReadBool();
+			std::unique_ptr<Expression> message = ReadExpression(reader);
+			return std::unique_ptr<Expression>(new ThrowExpression(std::move(message), incompleteExpr, di));
+		}
+		case TagImport: {
+			std::unique_ptr<Expression> name = ReadExpression(reader);
+			return std::unique_ptr<Expression>(new ImportExpression(std::move(name), di));
+		}
+		case TagFunction: {
+			String name = reader.ReadString();
+			std::vector<String> args;
+
+			for (auto count (reader.ReadVarint()); count; count--)
+				args.emplace_back(reader.ReadString());
+
+			std::map<String, std::unique_ptr<Expression> > closedVars = ReadClosedVars(reader);
+			std::unique_ptr<Expression> body = ReadExpression(reader);
+
+			return std::unique_ptr<Expression>(new FunctionExpression(std::move(name), std::move(args), std::move(closedVars), std::move(body), di));
+		}
+		case TagApply: {
+			String type = reader.ReadString();
+			String target = reader.ReadString();
+			String package = reader.ReadString();
+			String fkvar = reader.ReadString();
+			String fvvar = reader.ReadString();
+			bool ignoreOnError = reader.ReadBool();
+			std::unique_ptr<Expression> name = ReadExpression(reader);
+			std::unique_ptr<Expression> filter = ReadExpression(reader);
+			std::unique_ptr<Expression> fterm = ReadExpression(reader);
+			std::map<String, std::unique_ptr<Expression> > closedVars = ReadClosedVars(reader);
+			std::unique_ptr<Expression> body = ReadExpression(reader);
+
+			return std::unique_ptr<Expression>(new ApplyExpression(std::move(type), std::move(target), std::move(name), std::move(filter),
+				std::move(package), std::move(fkvar), std::move(fvvar), std::move(fterm), std::move(closedVars), ignoreOnError, std::move(body), di));
+		}
+		case TagNamespace: {
+			std::unique_ptr<Expression> body = ReadExpression(reader);
+			return std::unique_ptr<Expression>(new NamespaceExpression(std::move(body), di));
+		}
+		case TagObject: {
+			bool abstract = reader.ReadBool();
+			String zone = reader.ReadString();
+			String package = reader.ReadString();
+			bool defaultTmpl = reader.ReadBool();
+			bool ignoreOnError = reader.ReadBool();
+			std::unique_ptr<Expression> type = ReadExpression(reader);
+			std::unique_ptr<Expression> name = ReadExpression(reader);
+			std::unique_ptr<Expression> filter = ReadExpression(reader);
+			std::map<String, std::unique_ptr<Expression> > closedVars = ReadClosedVars(reader);
+			std::unique_ptr<Expression> body = ReadExpression(reader);
+
+			return std::unique_ptr<Expression>(new ObjectExpression(abstract, std::move(type), std::move(name), std::move(filter),
+				std::move(zone), std::move(package), std::move(closedVars), defaultTmpl, ignoreOnError, std::move(body), di));
+		}
+		case TagFor: {
+			String fkvar = reader.ReadString();
+			String fvvar = reader.ReadString();
+			std::unique_ptr<Expression> value = ReadExpression(reader);
+			std::unique_ptr<Expression> body = ReadExpression(reader);
+			return std::unique_ptr<Expression>(new ForExpression(std::move(fkvar), std::move(fvvar), std::move(value), std::move(body), di));
+		}
+		case TagInclude: {
+			String relativeBase = reader.ReadString();
+			auto type (static_cast<IncludeType>(reader.ReadByte()));
+			bool searchIncludes = reader.ReadBool();
+			String zone = reader.ReadString();
+			String package = reader.ReadString();
+			std::unique_ptr<Expression> path = ReadExpression(reader);
+			std::unique_ptr<Expression> pattern = ReadExpression(reader);
+			std::unique_ptr<Expression> name = ReadExpression(reader);
+
+			return std::unique_ptr<Expression>(new IncludeExpression(std::move(relativeBase), std::move(path), std::move(pattern), std::move(name),
+				type, searchIncludes, std::move(zone), std::move(package), di));
+		}
+		case TagTryExcept: {
+			std::unique_ptr<Expression> tryBody = ReadExpression(reader);
+			std::unique_ptr<Expression> exceptBody = ReadExpression(reader);
+			return std::unique_ptr<Expression>(new TryExceptExpression(std::move(tryBody), std::move(exceptBody), di));
+		}
+		default: {
+			std::unique_ptr<Expression> op1 = ReadExpression(reader);
+			std::unique_ptr<Expression> op2 = ReadExpression(reader);
+			return MakeBinary(static_cast<ExpressionTag>(tag), std::move(op1), std::move(op2), di);
+		}
+	}
+}
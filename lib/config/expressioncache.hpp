@@ -0,0 +1,80 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef EXPRESSIONCACHE_H
+#define EXPRESSIONCACHE_H
+
+#include "config/i2-config.hpp"
+#include "config/expression.hpp"
+#include "base/string.hpp"
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+namespace icinga
+{
+
+/**
+ * On-disk cache for compiled config files.
+ *
+ * Each entry holds the serialized expression tree of one file and is keyed
+ * by the file's path, zone and package. An entry is reused if the file's
+ * mtime and size are unchanged or, failing that, if its content hash still
+ * matches.
+ *
+ * @ingroup config
+ */
+class ExpressionCache
+{
+public:
+	ExpressionCache(String path, String zone, String package);
+
+	std::unique_ptr<Expression> Lookup(std::istream& stream);
+	void Store(const Expression *expression);
+
+	const String& GetContent() const;
+
+	static bool IsEnabled();
+	static String GetCacheDir();
+
+	static String Serialize(const Expression *expression);
+	static std::unique_ptr<Expression> Deserialize(const String& data);
+
+	static uint_fast64_t GetHits();
+	static uint_fast64_t GetMisses();
+
+	static size_t RemoveUnusedEntries();
+
+private:
+	struct Writer;
+	struct Reader;
+
+	String m_Path;
+	String m_Zone;
+	String m_Package;
+	String m_CacheFile;
+	int64_t m_Mtime{-1};
+	int64_t m_Size{-1};
+	String m_Content;
+	String m_Hash;
+
+	static std::atomic<uint_fast64_t> m_Hits;
+	static std::atomic<uint_fast64_t> m_Misses;
+
+	static std::mutex m_UsedMutex;
+	static std::unordered_set<String> m_Used; /**< The cache files of all files compiled by this process */
+
+	void WriteEntry(const String& payload);
+
+	static void WriteExpression(Writer& writer, const Expression *expression);
+	static std::unique_ptr<Expression> ReadExpression(Reader& reader);
+
+	static void WriteClosedVars(Writer& writer, const std::map<String, std::unique_ptr<Expression> >& closedVars);
+	static std::map<String, std::unique_ptr<Expression> > ReadClosedVars(Reader& reader);
+};
+
+}
+
+#endif /* EXPRESSIONCACHE_H */
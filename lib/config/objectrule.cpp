@@ -1,11 +1,15 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "config/objectrule.hpp"
+#include "config/applyrule.hpp"
+#include "base/objectlock.hpp"
 #include <set>
 
 using namespace icinga;
 
 ObjectRule::TypeSet ObjectRule::m_Types;
+std::mutex ObjectRule::m_GroupIndexesMutex;
+std::unordered_map<Type*, std::shared_ptr<ObjectRule::GroupIndex>> ObjectRule::m_GroupIndexes;
 
 void ObjectRule::RegisterType(const String& sourceType)
 {
@@ -16,3 +20,148 @@ bool ObjectRule::IsValidSourceType(const String& sourceType)
 {
 	return m_Types.find(sourceType) != m_Types.end();
 }
+
+/**
+ * Calls evaluate for the assign rules of all groups of the given type, which may match the given host, in item order.
+ * Rules which can't match the host due to its name, groups or custom vars are skipped.
+ *
+ * @param groupType E.g. HostGroup or ServiceGroup
+ * @param host The host the rules see as "host", i.e. the service's one for ServiceGroup
+ * @param addsHostGroups Whether evaluate adds the names of matching groups to hostGroups (HostGroup)
+ * @param evaluate Evaluates the rule of the given group item, returns whether it matched
+ */
+void ObjectRule::EvaluateGroupRules(const Type::Ptr& groupType, const String& host, const Array::Ptr& hostGroups,
+	const Dictionary::Ptr& vars, bool addsHostGroups, const std::function<bool (const ConfigItem::Ptr&)>& evaluate)
+{
+	auto index (GetGroupIndex(groupType));
+	std::vector<bool> candidates (index->Items.size());
+
+	auto add ([&candidates](const std::vector<size_t>& items) {
+		for (auto item : items) {
+			candidates[item] = true;
+		}
+	});
+
+	auto addGroup ([&index, &add](const String& group) {
+		auto byGroup (index->ByGroup.find(group));
+
+		if (byGroup != index->ByGroup.end()) {
+			add(byGroup->second);
+		}
+	});
+
+	auto byName (index->ByName.find(host));
+
+	if (byName != index->ByName.end()) {
+		add(byName->second);
+	}
+
+	if (!index->ByNamePrefix.empty()) {
+		String lowerHost (ApplyRule::MatchLower(host));
+
+		for (String::SizeType i = 0; i <= lowerHost.GetLength(); i++) {
+			auto byPrefix (index->ByNamePrefix.find(lowerHost.SubStr(0, i)));
+
+			if (byPrefix != index->ByNamePrefix.end()) {
+				add(byPrefix->second);
+			}
+		}
+	}
+
+	if (hostGroups && !index->ByGroup.empty()) {
+		ObjectLock oLock (hostGroups);
+
+		for (auto& group : hostGroups) {
+			if (group.IsString()) {
+				addGroup(group.Get<String>());
+			}
+		}
+	}
+
+	if (vars && !index->ByVar.empty()) {
+		ObjectLock oLock (vars);
+
+		for (auto& kv : vars) {
+			if (kv.second.IsString()) {
+				auto byVar (index->ByVar.find(kv.first));
+
+				if (byVar != index->ByVar.end()) {
+					auto byValue (byVar->second.find(kv.second.Get<String>()));
+
+					if (byValue != byVar->second.end()) {
+						add(byValue->second);
+					}
+				}
+			}
+		}
+	}
+
+	for (size_t i = 0; i < index->Items.size(); i++) {
+		if (index->Indexed[i] && !candidates[i]) {
+			continue;
+		}
+
+		auto& item (index->Items[i]);
+
+		/* Later rules may require the group just assigned, earlier ones didn't see it before either. */
+		if (evaluate(item) && addsHostGroups) {
+			addGroup(item->GetName());
+		}
+	}
+}
+
+/**
+ * @returns The index of the current group items of the given type, rebuilt if they've changed.
+ */
+std::shared_ptr<ObjectRule::GroupIndex> ObjectRule::GetGroupIndex(const Type::Ptr& groupType)
+{
+	std::vector<ConfigItem::Ptr> items;
+
+	for (auto& item : ConfigItem::GetItems(groupType)) {
+		if (item->GetFilter()) {
+			items.emplace_back(item);
+		}
+	}
+
+	std::unique_lock<std::mutex> lock (m_GroupIndexesMutex);
+	auto& index (m_GroupIndexes[groupType.get()]);
+
+	if (index && index->Items == items) {
+		return index;
+	}
+
+	index = std::make_shared<GroupIndex>();
+	index->Items = std::move(items);
+	index->Indexed.resize(index->Items.size());
+
+	for (size_t i = 0; i < index->Items.size(); i++) {
+		auto& item (index->Items[i]);
+		auto scope (item->GetScope());
+		ApplyRule::IndexKeys keys;
+
+		/* The rules always see the actual host as "host", but the scope may shadow match(). */
+		if (!ApplyRule::GetIndexKeys(item->GetFilter().get(), keys, !(scope && scope->Contains("match")))) {
+			continue;
+		}
+
+		index->Indexed[i] = true;
+
+		for (auto name : keys.Names) {
+			index->ByName[*name].emplace_back(i);
+		}
+
+		for (auto& prefix : keys.NamePrefixes) {
+			index->ByNamePrefix[prefix].emplace_back(i);
+		}
+
+		for (auto group : keys.Groups) {
+			index->ByGroup[*group].emplace_back(i);
+		}
+
+		for (auto& var : keys.Vars) {
+			index->ByVar[*var.first][*var.second].emplace_back(i);
+		}
+	}
+
+	return index;
+}
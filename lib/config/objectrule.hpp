@@ -5,8 +5,14 @@
 
 #include "config/i2-config.hpp"
 #include "config/expression.hpp"
+#include "config/configitem.hpp"
 #include "base/debuginfo.hpp"
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <unordered_map>
+#include <vector>
 
 namespace icinga
 {
@@ -22,10 +28,33 @@ public:
 	static void RegisterType(const String& sourceType);
 	static bool IsValidSourceType(const String& sourceType);
 
+	static void EvaluateGroupRules(const Type::Ptr& groupType, const String& host, const Array::Ptr& hostGroups,
+		const Dictionary::Ptr& vars, bool addsHostGroups, const std::function<bool (const ConfigItem::Ptr&)>& evaluate);
+
 private:
 	ObjectRule();
 
+	/**
+	 * The group items of one type with an assign filter, in ConfigItem::GetItems() order.
+	 *
+	 * Like ApplyRule::HostIndex, filters requiring specific host properties are indexed by them.
+	 */
+	struct GroupIndex
+	{
+		std::vector<ConfigItem::Ptr> Items;
+		std::vector<bool> Indexed;
+		std::unordered_map<String /* host */, std::vector<size_t>> ByName;
+		std::unordered_map<String /* lower case host name prefix */, std::vector<size_t>> ByNamePrefix;
+		std::unordered_map<String /* host group */, std::vector<size_t>> ByGroup;
+		std::unordered_map<String /* custom var */, std::unordered_map<String /* value */, std::vector<size_t>>> ByVar;
+	};
+
 	static TypeSet m_Types;
+
+	static std::mutex m_GroupIndexesMutex;
+	static std::unordered_map<Type*, std::shared_ptr<GroupIndex>> m_GroupIndexes;
+
+	static std::shared_ptr<GroupIndex> GetGroupIndex(const Type::Ptr& groupType);
 };
 
 }
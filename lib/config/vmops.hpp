@@ -101,7 +101,7 @@ public:
 
 			ScriptFrame *frame = ScriptFrame::GetCurrentFrame();
 
-			frame->Locals = new Dictionary();
+			frame->Locals = ScriptFrame::AllocateLocals();
 
 			if (evaluatedClosedVars)
 				evaluatedClosedVars->CopyTo(frame->Locals);
@@ -12,6 +12,7 @@
 #include "base/utility.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
+#include <iomanip>
 
 using namespace icinga;
 
@@ -45,10 +46,33 @@ void DbConnection::Start(bool runtimeCreated)
 	Log(LogInformation, "DbConnection")
 		<< "'" << GetName() << "' started.";
 
-	auto onQuery = [this](const DbQuery& query) { ExecuteQuery(query); };
+	auto onQuery = [this](const DbQuery& query) {
+		if (IsCoalescableQuery(query)) {
+			CoalesceQuery(query);
+			return;
+		}
+
+		DbQuery reserved (query);
+
+		if (ReserveQueryMemory(reserved))
+			ExecuteQuery(reserved);
+	};
 	DbObject::OnQuery.connect(onQuery);
 
-	auto onMultipleQueries = [this](const std::vector<DbQuery>& multiQueries) { ExecuteMultipleQueries(multiQueries); };
+	auto onMultipleQueries = [this](const std::vector<DbQuery>& multiQueries) {
+		std::vector<DbQuery> reserved;
+		reserved.reserve(multiQueries.size());
+
+		for (auto& query : multiQueries) {
+			reserved.emplace_back(query);
+
+			if (!ReserveQueryMemory(reserved.back()))
+				reserved.pop_back();
+		}
+
+		if (!reserved.empty())
+			ExecuteMultipleQueries(reserved);
+	};
 	DbObject::OnMultipleQueries.connect(onMultipleQueries);
 
 	DbObject::QueryCallbacks queryCallbacks;
@@ -268,6 +292,16 @@ void DbConnection::CleanUpHandler()
 
 void DbConnection::LogStatsHandler()
 {
+	auto dropped (m_DroppedStatusUpdates.load());
+
+	if (dropped != m_LoggedDroppedStatusUpdates) {
+		Log(LogWarning, GetReflectionType()->GetName())
+			<< "Dropped " << (dropped - m_LoggedDroppedStatusUpdates) << " status updates as the queued queries exceed"
+			<< " max_queued_query_memory (" << GetMaxQueuedQueryMemory() << " MiB) of '" << GetName() << "'.";
+
+		m_LoggedDroppedStatusUpdates = dropped;
+	}
+
 	if (!GetConnected() || IsPaused())
 		return;
 
@@ -298,6 +332,160 @@ void DbConnection::LogStatsHandler()
 	}
 }
 
+/**
+ * Whether the query updates a status row of an object and may be merged with other such updates.
+ */
+bool DbConnection::IsCoalescableQuery(const DbQuery& query)
+{
+	return query.StatusUpdate && query.Object && query.Category == DbCatState
+		&& (query.Type & DbQueryUpdate) && !(query.Type & DbQueryDelete)
+		&& query.Fields && query.WhereCriteria && !query.NotificationInsertID;
+}
+
+/**
+ * Holds a status update back until the work queue gets to it. Further updates of the same row
+ * arriving meanwhile (next check, flapping, enable_* flags, the full status) are merged into it,
+ * so the row is written once with the latest values.
+ */
+void DbConnection::CoalesceQuery(const DbQuery& query)
+{
+	auto key (std::make_pair(query.Table, query.Object));
+
+	m_CoalescableQueries.fetch_add(1);
+
+	{
+		std::unique_lock<std::mutex> lock (m_CoalescedUpdatesMutex);
+		auto pending (m_CoalescedUpdates.find(key));
+
+		if (pending != m_CoalescedUpdates.end()) {
+			auto& merged (pending->second);
+
+			/* Both identify the same row, prefer the (simpler) upsert criteria. */
+			if ((query.Type & DbQueryInsert) && !(merged.Type & DbQueryInsert))
+				merged.WhereCriteria = query.WhereCriteria;
+
+			merged.Type |= query.Type;
+			query.Fields->CopyTo(merged.Fields);
+
+			m_MergedQueries.fetch_add(1);
+			return;
+		}
+
+		DbQuery copy (query);
+
+		/* The query is shared with other connections. */
+		copy.Fields = query.Fields->ShallowClone();
+
+		if (!ReserveQueryMemory(copy))
+			return;
+
+		m_CoalescedUpdates.emplace(key, std::move(copy));
+	}
+
+	m_QueryQueue.Enqueue([this, key]() {
+		DbQuery merged;
+
+		{
+			std::unique_lock<std::mutex> lock (m_CoalescedUpdatesMutex);
+			auto pending (m_CoalescedUpdates.find(key));
+
+			merged = std::move(pending->second);
+			m_CoalescedUpdates.erase(pending);
+		}
+
+		ExecuteQuery(merged);
+	}, query.Priority);
+}
+
+/**
+ * @return The share of status updates merged into other ones (0 to 1)
+ */
+double DbConnection::GetStatusUpdateMergeRatio() const
+{
+	auto coalescable (m_CoalescableQueries.load());
+
+	if (!coalescable)
+		return 0;
+
+	return static_cast<double>(m_MergedQueries.load()) / coalescable;
+}
+
+/**
+ * Roughly estimates the heap memory a queued copy of the query occupies.
+ */
+size_t DbConnection::EstimateQueryMemory(const DbQuery& query)
+{
+	size_t bytes = sizeof(DbQuery) + query.Table.GetLength() + query.IdColumn.GetLength();
+
+	for (auto& dict : { query.Fields, query.WhereCriteria }) {
+		if (!dict)
+			continue;
+
+		ObjectLock olock (dict);
+
+		bytes += sizeof(Dictionary);
+
+		for (auto& kv : dict) {
+			/* Map node, key and value */
+			bytes += 32 + sizeof(String) + kv.first.GetLength() + sizeof(Value);
+
+			if (kv.second.IsString())
+				bytes += kv.second.Get<String>().GetLength();
+			else if (kv.second.IsObjectType<DbValue>())
+				bytes += sizeof(DbValue);
+		}
+	}
+
+	return bytes;
+}
+
+/**
+ * Accounts the query's memory to the connection until it's executed. Beyond max_queued_query_memory
+ * status updates are rejected as the next one of the same object supersedes them anyway.
+ * Everything else is still queued not to lose history.
+ *
+ * @return Whether to queue the query
+ */
+bool DbConnection::ReserveQueryMemory(DbQuery& query)
+{
+	auto bytes (EstimateQueryMemory(query));
+	auto limit (static_cast<size_t>(GetMaxQueuedQueryMemory()) * 1024u * 1024u);
+
+	if (limit && query.StatusUpdate && m_QueuedQueryMemory.load() + bytes > limit) {
+		m_DroppedStatusUpdates.fetch_add(1);
+		return false;
+	}
+
+	m_QueuedQueryMemory.fetch_add(bytes);
+	query.QueueMemory = std::make_shared<Defer>([this, bytes]() { m_QueuedQueryMemory.fetch_sub(bytes); });
+
+	return true;
+}
+
+/**
+ * @return The estimated memory of the queries queued for execution (in bytes)
+ */
+size_t DbConnection::GetQueuedQueryMemory() const
+{
+	return m_QueuedQueryMemory.load();
+}
+
+uint_fast64_t DbConnection::GetDroppedStatusUpdates() const
+{
+	return m_DroppedStatusUpdates.load();
+}
+
+/**
+ * Decides whether to delete another chunk of old history rows (chunked and partitions cleanup modes).
+ * It yields to the regular queries, the rest is deleted during the next cleanup.
+ *
+ * @param deletedRows The number of rows the last chunk deleted
+ */
+bool DbConnection::ShouldContinueCleanUp(int deletedRows)
+{
+	return deletedRows >= GetCleanupChunkSize() && !IsPaused() && GetPendingQueryCount() < 1000;
+}
+
 void DbConnection::CleanUpExecuteQuery(const String&, const String&, double)
 {
 	/* Default handler does nothing. */
@@ -440,7 +628,10 @@ bool DbConnection::GetStatusUpdate(const DbObject::Ptr& dbobj) const
 	return (m_StatusUpdates.find(dbobj) != m_StatusUpdates.end());
 }
 
-void DbConnection::UpdateObject(const ConfigObject::Ptr& object)
+/**
+ * @return Whether the object's config has been (re-)sent as it changed
+ */
+bool DbConnection::UpdateObject(const ConfigObject::Ptr& object)
 {
 	bool isShuttingDown = Application::IsShuttingDown();
 	bool isRestarting = Application::IsRestarting();
@@ -455,14 +646,14 @@ void DbConnection::UpdateObject(const ConfigObject::Ptr& object)
 
 	/* Wait until a database connection is established on reconnect. */
 	if (!GetConnected())
-		return;
+		return false;
 
 	/* Don't update inactive objects during shutdown/reload/restart.
 	 * They would be marked as deleted. This gets triggered with ConfigObject::StopObjects().
 	 * During startup/reconnect this is fine, the handler is not active there.
 	 */
 	if (isShuttingDown || isRestarting)
-		return;
+		return false;
 
 	DbObject::Ptr dbobj = DbObject::GetOrCreateByObject(object);
 
@@ -484,6 +675,7 @@ void DbConnection::UpdateObject(const ConfigObject::Ptr& object)
 			if (cachedHash != configHash) {
 				dbobj->SendConfigUpdateHeavy(configFields);
 				dbobj->SendStatusUpdate();
+				return true;
 			} else {
 				dbobj->SendConfigUpdateLight();
 			}
@@ -497,10 +689,18 @@ void DbConnection::UpdateObject(const ConfigObject::Ptr& object)
 			DeactivateObject(dbobj);
 		}
 	}
+
+	return false;
 }
 
 void DbConnection::UpdateAllObjects()
 {
+	m_DumpTotal = 0;
+	m_DumpDone = 0;
+	m_DumpChanged = 0;
+	m_DumpStart = Utility::GetTime();
+	m_DumpLastProgress = m_DumpStart;
+
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
 		auto *dtype = dynamic_cast<ConfigType *>(type.get());
 
@@ -508,11 +708,38 @@ void DbConnection::UpdateAllObjects()
 			continue;
 
 		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
-			m_QueryQueue.Enqueue([this, object](){ UpdateObject(object); }, PriorityHigh);
+			m_DumpTotal++;
+			m_QueryQueue.Enqueue([this, object](){ DumpObject(object); }, PriorityHigh);
 		}
 	}
 }
 
+/**
+ * Updates an object as part of the config dump (on m_QueryQueue) and logs the dump's progress.
+ */
+void DbConnection::DumpObject(const ConfigObject::Ptr& object)
+{
+	if (UpdateObject(object))
+		m_DumpChanged++;
+
+	m_DumpDone++;
+
+	double now = Utility::GetTime();
+
+	if (m_DumpDone == m_DumpTotal) {
+		Log(LogInformation, "DbConnection")
+			<< "Finished config dump of '" << GetName() << "': " << m_DumpChanged << " of " << m_DumpTotal
+			<< " objects changed, took " << std::fixed << std::setprecision(2) << now - m_DumpStart << " second(s).";
+	} else if (now - m_DumpLastProgress >= 10) {
+		m_DumpLastProgress = now;
+
+		Log(LogInformation, "DbConnection")
+			<< "Config dump of '" << GetName() << "': " << m_DumpDone << " of " << m_DumpTotal << " objects ("
+			<< std::fixed << std::setprecision(1) << 100.0 * m_DumpDone / m_DumpTotal << "%) done, "
+			<< m_DumpChanged << " changed.";
+	}
+}
+
 void DbConnection::PrepareDatabase()
 {
 	for (const DbType::Ptr& type : DbType::GetAllTypes()) {
@@ -528,6 +755,30 @@ void DbConnection::ValidateFailoverTimeout(const Lazy<double>& lvalue, const Val
 		BOOST_THROW_EXCEPTION(ValidationError(this, { "failover_timeout" }, "Failover timeout minimum is 30s."));
 }
 
+void DbConnection::ValidateCleanupMode(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<DbConnection>::ValidateCleanupMode(lvalue, utils);
+
+	if (lvalue() != "delete" && lvalue() != "chunked" && lvalue() != "partitions")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "cleanup_mode" }, "Cleanup mode must be one of 'delete', 'chunked' and 'partitions'."));
+}
+
+void DbConnection::ValidateCleanupChunkSize(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<DbConnection>::ValidateCleanupChunkSize(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "cleanup_chunk_size" }, "Cleanup chunk size must be at least 1."));
+}
+
+void DbConnection::ValidateMaxQueuedQueryMemory(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<DbConnection>::ValidateMaxQueuedQueryMemory(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "max_queued_query_memory" }, "Maximum queued query memory must not be negative."));
+}
+
 void DbConnection::ValidateCategories(const Lazy<Array::Ptr>& lvalue, const ValidationUtils& utils)
 {
 	ObjectImpl<DbConnection>::ValidateCategories(lvalue, utils);
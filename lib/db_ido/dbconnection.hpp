@@ -56,8 +56,14 @@ public:
 
 	int GetQueryCount(RingBuffer::SizeType span);
 	virtual int GetPendingQueryCount() const = 0;
+	double GetStatusUpdateMergeRatio() const;
+	size_t GetQueuedQueryMemory() const;
+	uint_fast64_t GetDroppedStatusUpdates() const;
 
 	void ValidateFailoverTimeout(const Lazy<double>& lvalue, const ValidationUtils& utils) final;
+	void ValidateCleanupMode(const Lazy<String>& lvalue, const ValidationUtils& utils) final;
+	void ValidateCleanupChunkSize(const Lazy<int>& lvalue, const ValidationUtils& utils) final;
+	void ValidateMaxQueuedQueryMemory(const Lazy<int>& lvalue, const ValidationUtils& utils) final;
 	void ValidateCategories(const Lazy<Array::Ptr>& lvalue, const ValidationUtils& utils) final;
 
 protected:
@@ -73,11 +79,12 @@ protected:
 	virtual void DeactivateObject(const DbObject::Ptr& dbobj) = 0;
 
 	virtual void CleanUpExecuteQuery(const String& table, const String& time_column, double max_age);
+	bool ShouldContinueCleanUp(int deletedRows);
 	virtual void FillIDCache(const DbType::Ptr& type) = 0;
 	virtual void NewTransaction() = 0;
 	virtual void Disconnect() = 0;
 
-	void UpdateObject(const ConfigObject::Ptr& object);
+	bool UpdateObject(const ConfigObject::Ptr& object);
 	void UpdateAllObjects();
 
 	void PrepareDatabase();
@@ -114,6 +121,14 @@ private:
 	void CleanUpHandler();
 	void LogStatsHandler();
 
+	void DumpObject(const ConfigObject::Ptr& object);
+
+	static bool IsCoalescableQuery(const DbQuery& query);
+	void CoalesceQuery(const DbQuery& query);
+
+	static size_t EstimateQueryMemory(const DbQuery& query);
+	bool ReserveQueryMemory(DbQuery& query);
+
 	static Timer::Ptr m_ProgramStatusTimer;
 	static boost::once_flag m_OnceFlag;
 
@@ -126,6 +141,22 @@ private:
 	RingBuffer m_InputQueries{10};
 	RingBuffer m_OutputQueries{10};
 	Atomic<uint_fast64_t> m_PendingQueries{0};
+
+	// The config dump's progress, only accessed on m_QueryQueue.
+	size_t m_DumpTotal{0};
+	size_t m_DumpDone{0};
+	size_t m_DumpChanged{0};
+	double m_DumpStart{0};
+	double m_DumpLastProgress{0};
+
+	std::mutex m_CoalescedUpdatesMutex;
+	std::map<std::pair<String, intrusive_ptr<DbObject>>, DbQuery> m_CoalescedUpdates;
+	Atomic<uint_fast64_t> m_CoalescableQueries{0};
+	Atomic<uint_fast64_t> m_MergedQueries{0};
+
+	Atomic<size_t> m_QueuedQueryMemory{0};
+	Atomic<uint_fast64_t> m_DroppedStatusUpdates{0};
+	uint_fast64_t m_LoggedDroppedStatusUpdates{0};
 };
 
 struct database_error : virtual std::exception, virtual boost::exception { };
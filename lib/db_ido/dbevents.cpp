@@ -87,7 +87,7 @@ void DbEvents::StaticInitialize()
 		DbEvents::AddStateChangeHistory(checkable, cr, type);
 	});
 
-	Checkable::OnNewCheckResult.connect([](const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
+	Checkable::OnNewCheckResult.connect("DbEvents", [](const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
 		DbEvents::AddCheckResultLogHistory(checkable, cr);
 	});
 	Checkable::OnNotificationSentToUser.connect([](const Notification::Ptr& notification, const Checkable::Ptr& checkable,
@@ -106,7 +106,7 @@ void DbEvents::StaticInitialize()
 
 	Checkable::OnFlappingChanged.connect([](const Checkable::Ptr& checkable, const Value&) { DbEvents::AddFlappingChangedHistory(checkable); });
 	Checkable::OnEnableFlappingChanged.connect([](const Checkable::Ptr& checkable, const Value&) { DbEvents::AddEnableFlappingChangedHistory(checkable); });
-	Checkable::OnNewCheckResult.connect([](const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
+	Checkable::OnNewCheckResult.connect("DbEvents", [](const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
 		DbEvents::AddCheckableCheckHistory(checkable, cr);
 	});
 
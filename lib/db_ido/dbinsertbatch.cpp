@@ -0,0 +1,120 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "db_ido/dbinsertbatch.hpp"
+#include <utility>
+
+using namespace icinga;
+
+/**
+ * @return Whether the query is an INSERT nobody waits for the insert ID of
+ */
+bool DbInsertBatch::IsBatchableInsert(const DbQuery& query, int type)
+{
+	return type == DbQueryInsert && !query.ConfigUpdate && !query.StatusUpdate && !query.NotificationInsertID;
+}
+
+/**
+ * @return Whether the query is a status update of a table with a unique key on the only WHERE column
+ */
+bool DbInsertBatch::IsBatchableUpsert(const DbQuery& query, int type)
+{
+	return type == (DbQueryInsert | DbQueryUpdate) && query.StatusUpdate && query.Object && query.Fields
+		&& query.WhereCriteria && query.WhereCriteria->GetLength() == 1 && IsStatusTable(query.Table);
+}
+
+/**
+ * @return Whether the table has one row per object, keyed by its object ID
+ */
+bool DbInsertBatch::IsStatusTable(const String& table)
+{
+	static const std::set<String> tables {
+		"hoststatus", "servicestatus", "contactstatus", "endpointstatus", "zonestatus"
+	};
+
+	return tables.find(table) != tables.end();
+}
+
+bool DbInsertBatch::IsEmpty() const
+{
+	return m_RowCount == 0;
+}
+
+size_t DbInsertBatch::GetRowCount() const
+{
+	return m_RowCount;
+}
+
+/**
+ * Checks whether a row may be added without sending the current batch first.
+ *
+ * @param head The statement up to (excluding) VALUES, e.g. "INSERT INTO t (a, b)"
+ * @param tail The statement after the rows, e.g. " ON DUPLICATE KEY UPDATE ..."
+ * @param key Identifies the row's target (upserts can't update one twice in one statement), empty if irrelevant
+ * @param rowLength The length of the row, e.g. "(1, 2)"
+ * @param maxLength The length the statement must not exceed (unless it's just one row)
+ */
+bool DbInsertBatch::Accepts(const String& head, const String& tail, const String& key, size_t rowLength, size_t maxLength) const
+{
+	if (IsEmpty()) {
+		return true;
+	}
+
+	if (head != m_Head || tail != m_Tail) {
+		return false;
+	}
+
+	if (!key.IsEmpty() && m_Keys.find(key) != m_Keys.end()) {
+		return false;
+	}
+
+	return m_Head.GetLength() + sizeof(" VALUES ") + m_Rows.size() + sizeof(", ") + rowLength + m_Tail.GetLength() <= maxLength;
+}
+
+/**
+ * Adds a row, Accepts() must have been checked before.
+ *
+ * @param callback Called once the statement has been executed
+ */
+void DbInsertBatch::Add(const String& head, const String& tail, const String& key, const String& row, Callback callback)
+{
+	if (IsEmpty()) {
+		m_Head = head;
+		m_Tail = tail;
+	} else {
+		m_Rows += ", ";
+	}
+
+	if (!key.IsEmpty()) {
+		m_Keys.emplace(key);
+	}
+
+	m_Rows += row.GetData();
+	m_RowCount++;
+
+	if (callback) {
+		m_Callbacks.emplace_back(std::move(callback));
+	}
+}
+
+/**
+ * Empties the batch.
+ *
+ * @param callbacks Receives the callbacks of all rows
+ *
+ * @return The statement to execute
+ */
+String DbInsertBatch::Take(std::vector<Callback>& callbacks)
+{
+	String query = m_Head + " VALUES " + m_Rows + m_Tail;
+
+	callbacks.swap(m_Callbacks);
+
+	m_Head = String();
+	m_Tail = String();
+	m_Keys.clear();
+	m_Rows.clear();
+	m_RowCount = 0;
+	m_Callbacks.clear();
+
+	return query;
+}
@@ -0,0 +1,51 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef DBINSERTBATCH_H
+#define DBINSERTBATCH_H
+
+#include "db_ido/i2-db_ido.hpp"
+#include "db_ido/dbquery.hpp"
+#include "base/string.hpp"
+#include <cstddef>
+#include <functional>
+#include <set>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * Consecutive INSERTs (or upserts) into the same table with the same columns, sent as one multi-row statement:
+ *
+ * <head> VALUES <row>, <row>, ... <tail>
+ *
+ * @ingroup ido
+ */
+class DbInsertBatch
+{
+public:
+	typedef std::function<void ()> Callback;
+
+	static bool IsBatchableInsert(const DbQuery& query, int type);
+	static bool IsBatchableUpsert(const DbQuery& query, int type);
+	static bool IsStatusTable(const String& table);
+
+	bool IsEmpty() const;
+	size_t GetRowCount() const;
+
+	bool Accepts(const String& head, const String& tail, const String& key, size_t rowLength, size_t maxLength) const;
+	void Add(const String& head, const String& tail, const String& key, const String& row, Callback callback = nullptr);
+	String Take(std::vector<Callback>& callbacks);
+
+private:
+	String m_Head;
+	String m_Tail;
+	std::set<String> m_Keys;
+	std::string m_Rows;
+	size_t m_RowCount = 0;
+	std::vector<Callback> m_Callbacks;
+};
+
+}
+
+#endif /* DBINSERTBATCH_H */
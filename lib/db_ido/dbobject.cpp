@@ -20,6 +20,8 @@
 #include "base/utility.hpp"
 #include "base/initialize.hpp"
 #include "base/logger.hpp"
+#include <algorithm>
+#include <iterator>
 
 using namespace icinga;
 
@@ -108,10 +110,10 @@ String DbObject::HashValue(const Value& value)
 	return SHA256(JsonEncode(temp));
 }
 
-void DbObject::SendConfigUpdateHeavy(const Dictionary::Ptr& configFields)
+void DbObject::SendConfigUpdateHeavy(const Dictionary::Ptr& configFields, bool incrementalVars)
 {
 	/* update custom var config and status */
-	SendVarsConfigUpdateHeavy();
+	SendVarsConfigUpdateHeavy(incrementalVars);
 
 	/* config attributes */
 	if (!configFields)
@@ -185,89 +187,76 @@ void DbObject::SendStatusUpdate()
 	OnStatusUpdate();
 }
 
-void DbObject::SendVarsConfigUpdateHeavy()
+/**
+ * Encodes custom vars like they're stored in the customvariable(status) tables.
+ *
+ * @return varname => (varvalue, is_json)
+ */
+std::map<String, std::pair<String, int>> DbObject::EncodeVars(const Dictionary::Ptr& vars)
 {
-	ConfigObject::Ptr obj = GetObject();
+	std::map<String, std::pair<String, int>> encoded;
 
-	CustomVarObject::Ptr custom_var_object = dynamic_pointer_cast<CustomVarObject>(obj);
+	if (!vars)
+		return encoded;
 
-	if (!custom_var_object)
-		return;
+	ObjectLock olock (vars);
 
-	std::vector<DbQuery> queries;
+	for (const Dictionary::Pair& kv : vars) {
+		if (kv.first.IsEmpty())
+			continue;
 
-	DbQuery query1;
-	query1.Table = "customvariables";
-	query1.Type = DbQueryDelete;
-	query1.Category = DbCatConfig;
-	query1.WhereCriteria = new Dictionary({
-		{ "object_id", obj }
-	});
-	queries.emplace_back(std::move(query1));
-
-	DbQuery query2;
-	query2.Table = "customvariablestatus";
-	query2.Type = DbQueryDelete;
-	query2.Category = DbCatConfig;
-	query2.WhereCriteria = new Dictionary({
-		{ "object_id", obj }
-	});
-	queries.emplace_back(std::move(query2));
-
-	Dictionary::Ptr vars = custom_var_object->GetVars();
-
-	if (vars) {
-		ObjectLock olock (vars);
-
-		for (const Dictionary::Pair& kv : vars) {
-			if (kv.first.IsEmpty())
-				continue;
-
-			String value;
-			int is_json = 0;
-
-			if (kv.second.IsObjectType<Array>() || kv.second.IsObjectType<Dictionary>()) {
-				value = JsonEncode(kv.second);
-				is_json = 1;
-			} else
-				value = kv.second;
-
-			DbQuery query3;
-			query3.Table = "customvariables";
-			query3.Type = DbQueryInsert;
-			query3.Category = DbCatConfig;
-			query3.Fields = new Dictionary({
-				{ "varname", kv.first },
-				{ "varvalue", value },
-				{ "is_json", is_json },
-				{ "config_type", 1 },
-				{ "object_id", obj },
-				{ "instance_id", 0 } /* DbConnection class fills in real ID */
-			});
-			queries.emplace_back(std::move(query3));
-
-			DbQuery query4;
-			query4.Table = "customvariablestatus";
-			query4.Type = DbQueryInsert;
-			query4.Category = DbCatState;
-
-			query4.Fields = new Dictionary({
-				{ "varname", kv.first },
-				{ "varvalue", value },
-				{ "is_json", is_json },
-				{ "status_update_time", DbValue::FromTimestamp(Utility::GetTime()) },
-				{ "object_id", obj },
-				{ "instance_id", 0 } /* DbConnection class fills in real ID */
-			});
+		if (kv.second.IsObjectType<Array>() || kv.second.IsObjectType<Dictionary>())
+			encoded.emplace(kv.first, std::make_pair(JsonEncode(kv.second), 1));
+		else
+			encoded.emplace(kv.first, std::make_pair(String(kv.second), 0));
+	}
+
+	return encoded;
+}
+
+/**
+ * Remembers the encoded vars as written and yields which of them changed since the last call.
+ * Hashes are kept instead of copies of the values not to double the memory of large vars.
+ *
+ * @param synced The vars written last time, nullptr if unknown (all vars are changed then)
+ * @param changed The new or modified vars
+ * @param removed The vars not present anymore
+ */
+void DbObject::DiffVars(const std::map<String, std::pair<String, int>>& vars, std::unique_ptr<VarHashes>& synced,
+	std::vector<String>& changed, std::vector<String>& removed)
+{
+	std::unique_ptr<VarHashes> hashes (new VarHashes());
 
-			queries.emplace_back(std::move(query4));
+	for (auto& kv : vars)
+		hashes->emplace(kv.first, std::hash<String>()(kv.second.first) ^ kv.second.second);
+
+	if (synced) {
+		for (auto& kv : *hashes) {
+			auto old (synced->find(kv.first));
+
+			if (old == synced->end() || old->second != kv.second)
+				changed.emplace_back(kv.first);
+		}
+
+		for (auto& kv : *synced) {
+			if (hashes->find(kv.first) == hashes->end())
+				removed.emplace_back(kv.first);
 		}
+	} else {
+		for (auto& kv : *hashes)
+			changed.emplace_back(kv.first);
 	}
 
-	OnMultipleQueries(queries);
+	synced = std::move(hashes);
 }
 
-void DbObject::SendVarsStatusUpdate()
+/**
+ * Writes the custom vars to the customvariables and customvariablestatus tables.
+ *
+ * @param incremental Only write the vars changed since the last call (runtime updates), otherwise
+ *                    replace all rows of the object (the config dump which can't rely on what's in the database)
+ */
+void DbObject::SendVarsConfigUpdateHeavy(bool incremental)
 {
 	ConfigObject::Ptr obj = GetObject();
 
@@ -276,49 +265,176 @@ void DbObject::SendVarsStatusUpdate()
 	if (!custom_var_object)
 		return;
 
-	Dictionary::Ptr vars = custom_var_object->GetVars();
+	auto vars (EncodeVars(custom_var_object->GetVars()));
+	std::vector<String> changed, removed;
+
+	{
+		std::unique_lock<std::mutex> lock (m_VarsMutex);
+
+		if (!incremental)
+			m_ConfigVars.reset();
 
-	if (vars) {
-		std::vector<DbQuery> queries;
-		ObjectLock olock (vars);
+		DiffVars(vars, m_ConfigVars, changed, removed);
 
-		for (const Dictionary::Pair& kv : vars) {
-			if (kv.first.IsEmpty())
-				continue;
+		/* Both tables are written below. */
+		m_StatusVars.reset(new VarHashes(*m_ConfigVars));
+	}
 
-			String value;
-			int is_json = 0;
+	std::vector<DbQuery> queries;
 
-			if (kv.second.IsObjectType<Array>() || kv.second.IsObjectType<Dictionary>()) {
-				value = JsonEncode(kv.second);
-				is_json = 1;
-			} else
-				value = kv.second;
+	if (!incremental) {
+		DbQuery query1;
+		query1.Table = "customvariables";
+		query1.Type = DbQueryDelete;
+		query1.Category = DbCatConfig;
+		query1.WhereCriteria = new Dictionary({
+			{ "object_id", obj }
+		});
+		queries.emplace_back(std::move(query1));
+
+		DbQuery query2;
+		query2.Table = "customvariablestatus";
+		query2.Type = DbQueryDelete;
+		query2.Category = DbCatConfig;
+		query2.WhereCriteria = new Dictionary({
+			{ "object_id", obj }
+		});
+		queries.emplace_back(std::move(query2));
+	}
 
+	for (auto& varname : removed) {
+		for (auto table : { "customvariables", "customvariablestatus" }) {
 			DbQuery query;
-			query.Table = "customvariablestatus";
-			query.Type = DbQueryInsert | DbQueryUpdate;
-			query.Category = DbCatState;
-
-			query.Fields = new Dictionary({
-				{ "varname", kv.first },
-				{ "varvalue", value },
-				{ "is_json", is_json },
-				{ "status_update_time", DbValue::FromTimestamp(Utility::GetTime()) },
+			query.Table = table;
+			query.Type = DbQueryDelete;
+			query.Category = DbCatConfig;
+			query.WhereCriteria = new Dictionary({
 				{ "object_id", obj },
-				{ "instance_id", 0 } /* DbConnection class fills in real ID */
+				{ "varname", varname }
 			});
+			queries.emplace_back(std::move(query));
+		}
+	}
 
-			query.WhereCriteria = new Dictionary({
+	/* Consecutive inserts into the same table are sent as one statement. */
+	std::vector<DbQuery> statusQueries;
+
+	for (auto& varname : changed) {
+		auto& var (vars[varname]);
+
+		DbQuery query3;
+		query3.Table = "customvariables";
+		query3.Type = incremental ? DbQueryInsert | DbQueryUpdate : DbQueryInsert;
+		query3.Category = DbCatConfig;
+		query3.Fields = new Dictionary({
+			{ "varname", varname },
+			{ "varvalue", var.first },
+			{ "is_json", var.second },
+			{ "config_type", 1 },
+			{ "object_id", obj },
+			{ "instance_id", 0 } /* DbConnection class fills in real ID */
+		});
+
+		if (incremental) {
+			query3.WhereCriteria = new Dictionary({
 				{ "object_id", obj },
-				{ "varname", kv.first }
+				{ "varname", varname }
 			});
+		}
 
-			queries.emplace_back(std::move(query));
+		queries.emplace_back(std::move(query3));
+
+		DbQuery query4;
+		query4.Table = "customvariablestatus";
+		query4.Type = incremental ? DbQueryInsert | DbQueryUpdate : DbQueryInsert;
+		query4.Category = DbCatState;
+
+		query4.Fields = new Dictionary({
+			{ "varname", varname },
+			{ "varvalue", var.first },
+			{ "is_json", var.second },
+			{ "status_update_time", DbValue::FromTimestamp(Utility::GetTime()) },
+			{ "object_id", obj },
+			{ "instance_id", 0 } /* DbConnection class fills in real ID */
+		});
+
+		if (incremental) {
+			query4.WhereCriteria = new Dictionary({
+				{ "object_id", obj },
+				{ "varname", varname }
+			});
 		}
 
+		statusQueries.emplace_back(std::move(query4));
+	}
+
+	std::move(statusQueries.begin(), statusQueries.end(), std::back_inserter(queries));
+
+	if (!queries.empty())
 		OnMultipleQueries(queries);
+}
+
+/**
+ * Updates the customvariablestatus rows of the vars changed since the last update.
+ */
+void DbObject::SendVarsStatusUpdate()
+{
+	ConfigObject::Ptr obj = GetObject();
+
+	CustomVarObject::Ptr custom_var_object = dynamic_pointer_cast<CustomVarObject>(obj);
+
+	if (!custom_var_object)
+		return;
+
+	auto vars (EncodeVars(custom_var_object->GetVars()));
+	std::vector<String> changed, removed;
+
+	{
+		std::unique_lock<std::mutex> lock (m_VarsMutex);
+		DiffVars(vars, m_StatusVars, changed, removed);
 	}
+
+	std::vector<DbQuery> queries;
+
+	for (auto& varname : removed) {
+		DbQuery query;
+		query.Table = "customvariablestatus";
+		query.Type = DbQueryDelete;
+		query.Category = DbCatState;
+		query.WhereCriteria = new Dictionary({
+			{ "object_id", obj },
+			{ "varname", varname }
+		});
+		queries.emplace_back(std::move(query));
+	}
+
+	for (auto& varname : changed) {
+		auto& var (vars[varname]);
+
+		DbQuery query;
+		query.Table = "customvariablestatus";
+		query.Type = DbQueryInsert | DbQueryUpdate;
+		query.Category = DbCatState;
+
+		query.Fields = new Dictionary({
+			{ "varname", varname },
+			{ "varvalue", var.first },
+			{ "is_json", var.second },
+			{ "status_update_time", DbValue::FromTimestamp(Utility::GetTime()) },
+			{ "object_id", obj },
+			{ "instance_id", 0 } /* DbConnection class fills in real ID */
+		});
+
+		query.WhereCriteria = new Dictionary({
+			{ "object_id", obj },
+			{ "varname", varname }
+		});
+
+		queries.emplace_back(std::move(query));
+	}
+
+	if (!queries.empty())
+		OnMultipleQueries(queries);
 }
 
 double DbObject::GetLastConfigUpdate() const
@@ -418,7 +534,8 @@ void DbObject::VersionChangedHandler(const ConfigObject::Ptr& object)
 		String configHash = dbobj->CalculateConfigHash(configFields);
 		configFields->Set("config_hash", configHash);
 
-		dbobj->SendConfigUpdateHeavy(configFields);
+		/* Runtime update, the vars (rows) not modified are still in the database. */
+		dbobj->SendConfigUpdateHeavy(configFields, true);
 		dbobj->SendStatusUpdate();
 	}
 }
@@ -9,6 +9,11 @@
 #include "db_ido/dbtype.hpp"
 #include "icinga/customvarobject.hpp"
 #include "base/configobject.hpp"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 namespace icinga
 {
@@ -70,10 +75,10 @@ public:
 	static boost::signals2::signal<void (const std::vector<DbQuery>&)> OnMultipleQueries;
 	static boost::signals2::signal<void (const std::function<void (const QueryCallbacks&)>&)> OnMakeQueries;
 
-	void SendConfigUpdateHeavy(const Dictionary::Ptr& configFields);
+	void SendConfigUpdateHeavy(const Dictionary::Ptr& configFields, bool incrementalVars = false);
 	void SendConfigUpdateLight();
 	void SendStatusUpdate();
-	void SendVarsConfigUpdateHeavy();
+	void SendVarsConfigUpdateHeavy(bool incremental = false);
 	void SendVarsStatusUpdate();
 
 	double GetLastConfigUpdate() const;
@@ -98,6 +103,16 @@ private:
 	double m_LastConfigUpdate;
 	double m_LastStatusUpdate;
 
+	typedef std::map<String, size_t> VarHashes;
+
+	std::mutex m_VarsMutex;
+	std::unique_ptr<VarHashes> m_ConfigVars;
+	std::unique_ptr<VarHashes> m_StatusVars;
+
+	static std::map<String, std::pair<String, int>> EncodeVars(const Dictionary::Ptr& vars);
+	static void DiffVars(const std::map<String, std::pair<String, int>>& vars, std::unique_ptr<VarHashes>& synced,
+		std::vector<String>& changed, std::vector<String>& removed);
+
 	static void StateChangedHandler(const ConfigObject::Ptr& object);
 	static void VarsChangedHandler(const CustomVarObject::Ptr& object);
 	static void VersionChangedHandler(const ConfigObject::Ptr& object);
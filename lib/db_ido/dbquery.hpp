@@ -8,6 +8,8 @@
 #include "icinga/customvarobject.hpp"
 #include "base/dictionary.hpp"
 #include "base/configobject.hpp"
+#include "base/defer.hpp"
+#include <memory>
 
 namespace icinga
 {
@@ -56,6 +58,7 @@ struct DbQuery
 	bool ConfigUpdate{false};
 	bool StatusUpdate{false};
 	WorkQueuePriority Priority{PriorityNormal};
+	std::shared_ptr<Defer> QueueMemory; /**< Gives the query's memory back to the connection's quota once all copies are gone */
 
 	static void StaticInitialize();
 
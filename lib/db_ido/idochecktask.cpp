@@ -185,12 +185,17 @@ void IdoCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckResult
 		}
 	}
 
+	double mergeRatio = conn->GetStatusUpdateMergeRatio();
+
+	msgbuf << " Merged status updates: " << std::fixed << std::setprecision(1) << mergeRatio * 100 << "%.";
+
 	cr->SetPerformanceData(new Array({
 		{ new PerfdataValue("queries", qps, false, "", queriesWarning, queriesCritical) },
 		{ new PerfdataValue("queries_1min", conn->GetQueryCount(60)) },
 		{ new PerfdataValue("queries_5mins", conn->GetQueryCount(5 * 60)) },
 		{ new PerfdataValue("queries_15mins", conn->GetQueryCount(15 * 60)) },
-		{ new PerfdataValue("pending_queries", pendingQueries, false, "", pendingQueriesWarning, pendingQueriesCritical) }
+		{ new PerfdataValue("pending_queries", pendingQueries, false, "", pendingQueriesWarning, pendingQueriesCritical) },
+		{ new PerfdataValue("merged_status_updates", mergeRatio * 100, false, "percent", Empty, Empty, 0, 100) }
 	}));
 
 	ReportIdoCheck(checkable, commandObj, cr, msgbuf.str(), state);
@@ -14,6 +14,7 @@
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
 #include "base/defer.hpp"
+#include <boost/algorithm/string/join.hpp>
 #include <utility>
 
 using namespace icinga;
@@ -37,6 +38,16 @@ void IdoMysqlConnection::OnConfigLoaded()
 
 	m_QueryQueue.SetName("IdoMysqlConnection, " + GetName());
 
+	for (int i = 0; i < GetWriterConnections(); i++) {
+		auto writer (std::make_unique<IdoMysqlWriter>());
+		auto ptr (writer.get());
+
+		writer->Queue.SetName("IdoMysqlConnection, " + GetName() + ", writer #" + Convert::ToString(i + 1));
+		writer->Queue.SetExceptionCallback([this, ptr](boost::exception_ptr exp) { WriterExceptionHandler(*ptr, std::move(exp)); });
+
+		m_Writers.emplace_back(std::move(writer));
+	}
+
 	Library shimLibrary{"mysql_shim"};
 
 	auto create_mysql_shim = shimLibrary.GetSymbolAddress<create_mysql_shim_ptr>("create_mysql_shim");
@@ -59,7 +70,9 @@ void IdoMysqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 			{ "instance_name", idomysqlconnection->GetInstanceName() },
 			{ "connected", idomysqlconnection->GetConnected() },
 			{ "query_queue_items", queryQueueItems },
-			{ "query_queue_item_rate", queryQueueItemRate }
+			{ "query_queue_item_rate", queryQueueItemRate },
+			{ "query_queue_memory", idomysqlconnection->GetQueuedQueryMemory() },
+			{ "dropped_status_updates", idomysqlconnection->GetDroppedStatusUpdates() }
 		}));
 
 		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_queries_rate", idomysqlconnection->GetQueryCount(60) / 60.0));
@@ -68,6 +81,8 @@ void IdoMysqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_queries_15mins", idomysqlconnection->GetQueryCount(15 * 60)));
 		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_query_queue_items", queryQueueItems));
 		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_query_queue_item_rate", queryQueueItemRate));
+		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_query_queue_memory", idomysqlconnection->GetQueuedQueryMemory()));
+		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_dropped_status_updates", idomysqlconnection->GetDroppedStatusUpdates()));
 	}
 
 	status->Set("idomysqlconnection", new Dictionary(std::move(nodes)));
@@ -111,6 +126,10 @@ void IdoMysqlConnection::Pause()
 	m_ReconnectTimer->Stop(true);
 	m_TxTimer->Stop(true);
 
+	for (auto& writer : m_Writers) {
+		writer->Queue.Join();
+	}
+
 #ifdef I2_DEBUG /* I2_DEBUG */
 	Log(LogDebug, "IdoMysqlConnection")
 		<< "Rescheduling disconnect task.";
@@ -128,6 +147,8 @@ void IdoMysqlConnection::ExceptionHandler(boost::exception_ptr exp)
 	Log(LogDebug, "IdoMysqlConnection")
 		<< "Exception during database operation: " << DiagnosticInformation(std::move(exp));
 
+	DiscardInsertBatch();
+
 	if (GetConnected()) {
 		m_Mysql->close(&m_Connection);
 
@@ -152,6 +173,8 @@ void IdoMysqlConnection::Disconnect()
 
 	SetConnected(false);
 
+	DisconnectWriters();
+
 	Log(LogInformation, "IdoMysqlConnection")
 		<< "Disconnected from '" << GetName() << "' database '" << GetDatabase() << "'.";
 }
@@ -195,37 +218,11 @@ void IdoMysqlConnection::ReconnectTimerHandler()
 	m_QueryQueue.Enqueue([this]() { Reconnect(); }, PriorityImmediate);
 }
 
-void IdoMysqlConnection::Reconnect()
+/**
+ * Connects (the uninitialized) connection to the configured database.
+ */
+void IdoMysqlConnection::Connect(MYSQL *connection)
 {
-	AssertOnWorkQueue();
-
-	if (!IsActive())
-		return;
-
-	CONTEXT("Reconnecting to MySQL IDO database '" << GetName() << "'");
-
-	double startTime = Utility::GetTime();
-
-	SetShouldConnect(true);
-
-	bool reconnect = false;
-
-	/* Ensure to close old connections first. */
-	if (GetConnected()) {
-		/* Check if we're really still connected */
-		if (m_Mysql->ping(&m_Connection) == 0)
-			return;
-
-		m_Mysql->close(&m_Connection);
-		SetConnected(false);
-		reconnect = true;
-	}
-
-	Log(LogDebug, "IdoMysqlConnection")
-		<< "Reconnect: Clearing ID cache.";
-
-	ClearIDCache();
-
 	String ihost, isocket_path, iuser, ipasswd, idb;
 	String isslKey, isslCert, isslCa, isslCaPath, isslCipher;
 	const char *host, *socket_path, *user , *passwd, *db;
@@ -260,7 +257,7 @@ void IdoMysqlConnection::Reconnect()
 	sslCipher = (!isslCipher.IsEmpty()) ? isslCipher.CStr() : nullptr;
 
 	/* connection */
-	if (!m_Mysql->init(&m_Connection)) {
+	if (!m_Mysql->init(connection)) {
 		Log(LogCritical, "IdoMysqlConnection")
 			<< "mysql_init() failed: out of memory";
 
@@ -270,19 +267,53 @@ void IdoMysqlConnection::Reconnect()
 	/* Read "latin1" (here, in the schema and in Icinga Web) as "bytes".
 	   Icinga 2 and Icinga Web use byte-strings everywhere and every byte-string is a valid latin1 string.
 	   This way the (actually mostly UTF-8) bytes are transferred end-to-end as-is. */
-	m_Mysql->options(&m_Connection, MYSQL_SET_CHARSET_NAME, "latin1");
+	m_Mysql->options(connection, MYSQL_SET_CHARSET_NAME, "latin1");
 
 	if (enableSsl)
-		m_Mysql->ssl_set(&m_Connection, sslKey, sslCert, sslCa, sslCaPath, sslCipher);
+		m_Mysql->ssl_set(connection, sslKey, sslCert, sslCa, sslCaPath, sslCipher);
 
-	if (!m_Mysql->real_connect(&m_Connection, host, user, passwd, db, port, socket_path, CLIENT_FOUND_ROWS | CLIENT_MULTI_STATEMENTS)) {
+	if (!m_Mysql->real_connect(connection, host, user, passwd, db, port, socket_path, CLIENT_FOUND_ROWS | CLIENT_MULTI_STATEMENTS)) {
 		Log(LogCritical, "IdoMysqlConnection")
 			<< "Connection to database '" << db << "' with user '" << user << "' on '" << host << ":" << port
-			<< "' " << (enableSsl ? "(SSL enabled) " : "") << "failed: \"" << m_Mysql->error(&m_Connection) << "\"";
+			<< "' " << (enableSsl ? "(SSL enabled) " : "") << "failed: \"" << m_Mysql->error(connection) << "\"";
+
+		BOOST_THROW_EXCEPTION(std::runtime_error(m_Mysql->error(connection)));
+	}
+}
+
+void IdoMysqlConnection::Reconnect()
+{
+	AssertOnWorkQueue();
+
+	if (!IsActive())
+		return;
 
-		BOOST_THROW_EXCEPTION(std::runtime_error(m_Mysql->error(&m_Connection)));
+	CONTEXT("Reconnecting to MySQL IDO database '" << GetName() << "'");
+
+	double startTime = Utility::GetTime();
+
+	SetShouldConnect(true);
+
+	bool reconnect = false;
+
+	/* Ensure to close old connections first. */
+	if (GetConnected()) {
+		/* Check if we're really still connected */
+		if (m_Mysql->ping(&m_Connection) == 0)
+			return;
+
+		m_Mysql->close(&m_Connection);
+		SetConnected(false);
+		reconnect = true;
 	}
 
+	Log(LogDebug, "IdoMysqlConnection")
+		<< "Reconnect: Clearing ID cache.";
+
+	ClearIDCache();
+
+	Connect(&m_Connection);
+
 	Log(LogNotice, "IdoMysqlConnection")
 		<< "Reconnect: '" << GetName() << "' is now connected to database '" << GetDatabase() << "'.";
 
@@ -513,6 +544,9 @@ void IdoMysqlConnection::AsyncQuery(const String& query, const std::function<voi
 {
 	AssertOnWorkQueue();
 
+	/* Keep the order of the queries. */
+	FlushInsertBatch();
+
 	IdoAsyncQuery aq;
 	aq.Query = query;
 	/* XXX: Important: The callback must not immediately execute a query, but enqueue it!
@@ -524,9 +558,31 @@ void IdoMysqlConnection::AsyncQuery(const String& query, const std::function<voi
 
 void IdoMysqlConnection::FinishAsyncQueries()
 {
+	FlushInsertBatch();
+
 	std::vector<IdoAsyncQuery> queries;
 	m_AsyncQueries.swap(queries);
 
+	SendQueries(&m_Connection, m_MaxPacketSize, queries, &m_AffectedRows);
+
+	m_UncommittedAsyncQueries += queries.size();
+
+	if (m_UncommittedAsyncQueries > 25000) {
+		m_UncommittedAsyncQueries = 0;
+
+		Query("COMMIT");
+		Query("BEGIN");
+	}
+}
+
+/**
+ * Sends queries via connection as multi-statement packets and calls each one's callback back with its result.
+ *
+ * @param affectedRows Receives each query's affected rows before its callback is called (if not nullptr)
+ */
+void IdoMysqlConnection::SendQueries(MYSQL *connection, unsigned int maxPacketSize,
+	const std::vector<IdoAsyncQuery>& queries, int *affectedRows)
+{
 	std::vector<IdoAsyncQuery>::size_type offset = 0;
 
 	// This will be executed if there is a problem with executing the queries,
@@ -549,7 +605,6 @@ void IdoMysqlConnection::FinishAsyncQueries()
 		Defer decreaseQueries ([this, &offset, &count]() {
 			offset += count;
 			DecreasePendingQueries(count);
-			m_UncommittedAsyncQueries += count;
 		});
 
 		for (std::vector<IdoAsyncQuery>::size_type i = offset; i < queries.size(); i++) {
@@ -558,7 +613,7 @@ void IdoMysqlConnection::FinishAsyncQueries()
 			size_t size_query = aq.Query.GetLength() + 1;
 
 			if (count > 0) {
-				if (num_bytes + size_query > m_MaxPacketSize - 512)
+				if (num_bytes + size_query > maxPacketSize - 512)
 					break;
 
 				querybuf << ";";
@@ -576,15 +631,15 @@ void IdoMysqlConnection::FinishAsyncQueries()
 
 		String query = querybuf.str();
 
-		if (m_Mysql->query(&m_Connection, query.CStr()) != 0) {
+		if (m_Mysql->query(connection, query.CStr()) != 0) {
 			std::ostringstream msgbuf;
-			String message = m_Mysql->error(&m_Connection);
+			String message = m_Mysql->error(connection);
 			msgbuf << "Error \"" << message << "\" when executing query \"" << query << "\"";
 			Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 			BOOST_THROW_EXCEPTION(
 				database_error()
-				<< errinfo_message(m_Mysql->error(&m_Connection))
+				<< errinfo_message(m_Mysql->error(connection))
 				<< errinfo_database_query(query)
 			);
 		}
@@ -592,22 +647,23 @@ void IdoMysqlConnection::FinishAsyncQueries()
 		for (std::vector<IdoAsyncQuery>::size_type i = offset; i < offset + count; i++) {
 			const IdoAsyncQuery& aq = queries[i];
 
-			MYSQL_RES *result = m_Mysql->store_result(&m_Connection);
+			MYSQL_RES *result = m_Mysql->store_result(connection);
 
-			m_AffectedRows = m_Mysql->affected_rows(&m_Connection);
+			if (affectedRows)
+				*affectedRows = m_Mysql->affected_rows(connection);
 
 			IdoMysqlResult iresult;
 
 			if (!result) {
-				if (m_Mysql->field_count(&m_Connection) > 0) {
+				if (m_Mysql->field_count(connection) > 0) {
 					std::ostringstream msgbuf;
-					String message = m_Mysql->error(&m_Connection);
+					String message = m_Mysql->error(connection);
 					msgbuf << "Error \"" << message << "\" when executing query \"" << aq.Query << "\"";
 					Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 					BOOST_THROW_EXCEPTION(
 						database_error()
-						<< errinfo_message(m_Mysql->error(&m_Connection))
+						<< errinfo_message(m_Mysql->error(connection))
 						<< errinfo_database_query(query)
 					);
 				}
@@ -617,27 +673,20 @@ void IdoMysqlConnection::FinishAsyncQueries()
 			if (aq.Callback)
 				aq.Callback(iresult);
 
-			if (m_Mysql->next_result(&m_Connection) > 0) {
+			if (m_Mysql->next_result(connection) > 0) {
 				std::ostringstream msgbuf;
-				String message = m_Mysql->error(&m_Connection);
+				String message = m_Mysql->error(connection);
 				msgbuf << "Error \"" << message << "\" when executing query \"" << query << "\"";
 				Log(LogCritical, "IdoMysqlConnection", msgbuf.str());
 
 				BOOST_THROW_EXCEPTION(
 					database_error()
-					<< errinfo_message(m_Mysql->error(&m_Connection))
+					<< errinfo_message(m_Mysql->error(connection))
 					<< errinfo_database_query(query)
 				);
 			}
 		}
 	}
-
-	if (m_UncommittedAsyncQueries > 25000) {
-		m_UncommittedAsyncQueries = 0;
-
-		Query("COMMIT");
-		Query("BEGIN");
-	}
 }
 
 IdoMysqlResult IdoMysqlConnection::Query(const String& query)
@@ -1094,6 +1143,16 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 
 	type = (typeOverride != -1) ? typeOverride : query.Type;
 
+	if (DbInsertBatch::IsBatchableInsert(query, type)) {
+		BatchInsertQuery(query, String(), false);
+		return;
+	}
+
+	if (DbInsertBatch::IsBatchableUpsert(query, type)) {
+		BatchInsertQuery(query, where.str(), true);
+		return;
+	}
+
 	bool upsert = false;
 
 	if ((type & DbQueryInsert) && (type & DbQueryUpdate)) {
@@ -1185,9 +1244,273 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	if (type != DbQueryInsert)
 		qbuf << where.str();
 
+	if (!m_Writers.empty() && type == DbQueryUpdate && !upsert && query.StatusUpdate && query.Object
+		&& DbInsertBatch::IsStatusTable(query.Table)) {
+		auto& writer (GetWriter(query.Object));
+
+		/* Keep the order of the object's status updates. */
+		FlushInsertBatch(writer.Upserts, &writer);
+		WriterQuery(writer, qbuf.str());
+		return;
+	}
+
 	AsyncQuery(qbuf.str(), [this, query, type, upsert](const IdoMysqlResult&) { FinishExecuteQuery(query, type, upsert); });
 }
 
+/**
+ * Adds an INSERT (or an INSERT ... ON DUPLICATE KEY UPDATE) to m_InsertBatch instead of sending it on its own.
+ *
+ * @param key The WHERE clause of an upsert, to not update a row twice in one statement
+ */
+void IdoMysqlConnection::BatchInsertQuery(const DbQuery& query, const String& key, bool upsert)
+{
+	std::ostringstream head, row, tail;
+
+	head << "INSERT INTO " << GetTablePrefix() << query.Table << " (";
+	row << "(";
+
+	if (upsert)
+		tail << " ON DUPLICATE KEY UPDATE ";
+
+	{
+		ObjectLock olock(query.Fields);
+
+		bool first = true;
+		for (const Dictionary::Pair& kv : query.Fields) {
+			Value value;
+
+			if (!FieldToEscapedString(kv.first, kv.second, &value)) {
+				m_QueryQueue.Enqueue([this, query]() { InternalExecuteQuery(query, -1); }, query.Priority);
+				return;
+			}
+
+			if (!first) {
+				head << ", ";
+				row << ", ";
+
+				if (upsert)
+					tail << ", ";
+			}
+
+			head << kv.first;
+			row << value;
+
+			if (upsert)
+				tail << kv.first << " = VALUES(" << kv.first << ")";
+
+			first = false;
+		}
+	}
+
+	head << ")";
+	row << ")";
+
+	String sHead = head.str(), sTail = tail.str(), sRow = row.str();
+	DbInsertBatch::Callback callback;
+
+	if (upsert) {
+		DbObject::Ptr object = query.Object;
+		callback = [this, object]() { SetStatusUpdate(object, true); };
+	}
+
+	IdoMysqlWriter *writer = nullptr;
+
+	/* Status rows are partitioned by object, so their order is kept. */
+	if (upsert && !m_Writers.empty())
+		writer = &GetWriter(query.Object);
+
+	auto& batch (writer ? writer->Upserts : m_InsertBatch);
+
+	if (!batch.Accepts(sHead, sTail, key, sRow.GetLength(), m_MaxPacketSize - 512))
+		FlushInsertBatch(batch, writer);
+
+	batch.Add(sHead, sTail, key, sRow, std::move(callback));
+}
+
+/**
+ * Queues all batches, history inserts go to the writer connections round-robin.
+ */
+void IdoMysqlConnection::FlushInsertBatch()
+{
+	for (auto& writer : m_Writers) {
+		FlushInsertBatch(writer->Upserts, writer.get());
+	}
+
+	if (!m_InsertBatch.IsEmpty()) {
+		IdoMysqlWriter *writer = nullptr;
+
+		if (!m_Writers.empty())
+			writer = m_Writers[m_NextWriter++ % m_Writers.size()].get();
+
+		FlushInsertBatch(m_InsertBatch, writer);
+	}
+}
+
+/**
+ * Queues batch as one query, via writer if not nullptr.
+ */
+void IdoMysqlConnection::FlushInsertBatch(DbInsertBatch& batch, IdoMysqlWriter *writer)
+{
+	if (batch.IsEmpty())
+		return;
+
+	auto rows (batch.GetRowCount());
+	std::vector<DbInsertBatch::Callback> callbacks;
+	String query = batch.Take(callbacks);
+
+	/* Every row has been counted as a pending query, but they're one now. */
+	DecreasePendingQueries(rows - 1);
+
+	std::function<void ()> callback = [callbacks]() {
+		for (auto& callback : callbacks)
+			callback();
+	};
+
+	if (writer)
+		WriterQuery(*writer, query, callback);
+	else
+		AsyncQuery(query, [callback](const IdoMysqlResult&) { callback(); });
+}
+
+void IdoMysqlConnection::DiscardInsertBatch()
+{
+	auto discard ([this](DbInsertBatch& batch) {
+		if (batch.IsEmpty())
+			return;
+
+		std::vector<DbInsertBatch::Callback> callbacks;
+
+		DecreasePendingQueries(batch.GetRowCount());
+		batch.Take(callbacks);
+	});
+
+	discard(m_InsertBatch);
+
+	for (auto& writer : m_Writers) {
+		discard(writer->Upserts);
+	}
+}
+
+IdoMysqlWriter& IdoMysqlConnection::GetWriter(const DbObject::Ptr& object)
+{
+	return *m_Writers[std::hash<DbObject *>()(object.get()) % m_Writers.size()];
+}
+
+/**
+ * Queues a query for writer (on the work queue).
+ *
+ * @param callback Called on the work queue once the query succeeded
+ */
+void IdoMysqlConnection::WriterQuery(IdoMysqlWriter& writer, const String& query, const std::function<void ()>& callback)
+{
+	AssertOnWorkQueue();
+
+	IdoAsyncQuery aq;
+	aq.Query = query;
+
+	if (callback) {
+		aq.Callback = [this, callback](const IdoMysqlResult&) {
+			m_QueryQueue.Enqueue(std::function<void ()>(callback), PriorityHigh);
+		};
+	}
+
+	bool flush;
+
+	{
+		std::unique_lock<std::mutex> lock (writer.QueriesMutex);
+
+		flush = writer.Queries.empty();
+		writer.Queries.emplace_back(std::move(aq));
+		writer.MaxPacketSize = m_MaxPacketSize;
+	}
+
+	/* The queries queued until the writer gets to it are sent together. */
+	if (flush)
+		writer.Queue.Enqueue([this, &writer]() { FlushWriter(writer); });
+}
+
+/**
+ * Sends the queries queued for writer in one transaction (on its queue).
+ */
+void IdoMysqlConnection::FlushWriter(IdoMysqlWriter& writer)
+{
+	ASSERT(writer.Queue.IsWorkerThread());
+
+	std::vector<IdoAsyncQuery> queries;
+	unsigned int maxPacketSize;
+
+	{
+		std::unique_lock<std::mutex> lock (writer.QueriesMutex);
+
+		writer.Queries.swap(queries);
+		maxPacketSize = writer.MaxPacketSize;
+	}
+
+	if (queries.empty())
+		return;
+
+	if (!writer.Connected) {
+		try {
+			Connect(&writer.Connection);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "IdoMysqlConnection")
+				<< "Dropping " << queries.size() << " queries of a writer connection of '" << GetName()
+				<< "' which failed to connect: " << DiagnosticInformation(ex, false);
+
+			DecreasePendingQueries(queries.size());
+			return;
+		}
+
+		writer.Connected = true;
+
+		IncreasePendingQueries(2);
+
+		SendQueries(&writer.Connection, maxPacketSize, {
+			{ "SET SESSION TIME_ZONE='+00:00'", nullptr },
+			{ "SET SESSION SQL_MODE='NO_AUTO_VALUE_ON_ZERO'", nullptr }
+		}, nullptr);
+	}
+
+	IncreasePendingQueries(2);
+
+	queries.insert(queries.begin(), IdoAsyncQuery{"BEGIN", nullptr});
+	queries.push_back(IdoAsyncQuery{"COMMIT", nullptr});
+
+	SendQueries(&writer.Connection, maxPacketSize, queries, nullptr);
+}
+
+/**
+ * Closes the writer connections once they've sent their queued queries (on the work queue).
+ */
+void IdoMysqlConnection::DisconnectWriters()
+{
+	for (auto& writer : m_Writers) {
+		auto ptr (writer.get());
+
+		writer->Queue.Enqueue([this, ptr]() {
+			if (ptr->Connected) {
+				m_Mysql->close(&ptr->Connection);
+				ptr->Connected = false;
+			}
+		}, PriorityLow);
+	}
+}
+
+void IdoMysqlConnection::WriterExceptionHandler(IdoMysqlWriter& writer, boost::exception_ptr exp)
+{
+	Log(LogCritical, "IdoMysqlConnection")
+		<< "Exception during database operation of a writer connection of '" << GetName()
+		<< "': Verify that your database is operational!";
+
+	Log(LogDebug, "IdoMysqlConnection")
+		<< "Exception during database operation: " << DiagnosticInformation(std::move(exp));
+
+	if (writer.Connected) {
+		m_Mysql->close(&writer.Connection);
+		writer.Connected = false;
+	}
+}
+
 void IdoMysqlConnection::FinishExecuteQuery(const DbQuery& query, int type, bool upsert)
 {
 	if (upsert && GetAffectedRows() == 0) {
@@ -1244,9 +1567,76 @@ void IdoMysqlConnection::InternalCleanUpExecuteQuery(const String& table, const
 		return;
 	}
 
-	AsyncQuery("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
+	String mode = GetCleanupMode();
+
+	if (mode == "delete") {
+		AsyncQuery("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
+			Convert::ToString(static_cast<long>(m_InstanceID)) + " AND " + time_column +
+			" < FROM_UNIXTIME(" + Convert::ToString(static_cast<long>(max_age)) + ")");
+		return;
+	}
+
+	DecreasePendingQueries(1);
+
+	if (mode == "partitions")
+		DropPartitions(table, max_age);
+
+	/* Rows in partitions not entirely too old yet (or all of them if not partitioned). */
+	CleanUpChunk(table, time_column, max_age);
+}
+
+/**
+ * Deletes up to cleanup_chunk_size old rows and schedules the next chunk (at low priority).
+ */
+void IdoMysqlConnection::CleanUpChunk(const String& table, const String& time_column, double max_age)
+{
+	AssertOnWorkQueue();
+
+	if (IsPaused() || !GetConnected())
+		return;
+
+	Query("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
 		Convert::ToString(static_cast<long>(m_InstanceID)) + " AND " + time_column +
-		" < FROM_UNIXTIME(" + Convert::ToString(static_cast<long>(max_age)) + ")");
+		" < FROM_UNIXTIME(" + Convert::ToString(static_cast<long>(max_age)) + ") LIMIT " +
+		Convert::ToString(GetCleanupChunkSize()));
+
+	if (ShouldContinueCleanUp(GetAffectedRows())) {
+		m_QueryQueue.Enqueue([this, table, time_column, max_age]() { CleanUpChunk(table, time_column, max_age); }, PriorityLow);
+	}
+}
+
+/**
+ * Drops the partitions of a table partitioned by RANGE (UNIX_TIMESTAMP(<time column>)) which only contain rows older
+ * than max_age, i.e. whose upper bound is not newer. Note that this doesn't filter by instance.
+ */
+void IdoMysqlConnection::DropPartitions(const String& table, double max_age)
+{
+	AssertOnWorkQueue();
+
+	String fullTable = GetTablePrefix() + table;
+
+	IdoMysqlResult result = Query("SELECT PARTITION_NAME AS name FROM information_schema.PARTITIONS "
+		"WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = '" + Escape(fullTable) + "' AND PARTITION_METHOD = 'RANGE' "
+		"AND PARTITION_DESCRIPTION REGEXP '^[0-9]+$' AND CAST(PARTITION_DESCRIPTION AS UNSIGNED) <= "
+		+ Convert::ToString(static_cast<long>(max_age)));
+
+	std::vector<String> partitions;
+	Dictionary::Ptr row;
+
+	while ((row = FetchRow(result))) {
+		partitions.emplace_back("`" + static_cast<String>(row->Get("name")) + "`");
+	}
+
+	if (partitions.empty())
+		return;
+
+	Log(LogNotice, "IdoMysqlConnection")
+		<< "Cleanup (" << table << "): Dropping " << partitions.size() << " partition(s).";
+
+	Query("ALTER TABLE " + fullTable + " DROP PARTITION " + boost::algorithm::join(partitions, ", "));
+
+	/* DDL statements commit the current transaction implicitly. */
+	Query("BEGIN");
 }
 
 void IdoMysqlConnection::FillIDCache(const DbType::Ptr& type)
@@ -1265,5 +1655,13 @@ void IdoMysqlConnection::FillIDCache(const DbType::Ptr& type)
 
 int IdoMysqlConnection::GetPendingQueryCount() const
 {
-	return m_QueryQueue.GetLength();
+	size_t length = m_QueryQueue.GetLength();
+
+	for (auto& writer : m_Writers) {
+		std::unique_lock<std::mutex> lock (writer->QueriesMutex);
+
+		length += writer->Queries.size();
+	}
+
+	return length;
 }
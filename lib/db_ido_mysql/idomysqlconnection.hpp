@@ -5,11 +5,15 @@
 
 #include "db_ido_mysql/idomysqlconnection-ti.hpp"
 #include "mysql_shim/mysqlinterface.hpp"
+#include "db_ido/dbinsertbatch.hpp"
 #include "base/array.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
 #include "base/library.hpp"
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace icinga
 {
@@ -24,6 +28,27 @@ struct IdoAsyncQuery
 	IdoAsyncCallback Callback;
 };
 
+/**
+ * An additional connection of an IdoMysqlConnection, sending already built statements on its own thread.
+ *
+ * @ingroup ido
+ */
+struct IdoMysqlWriter
+{
+	WorkQueue Queue{10000000, 1, LogNotice};
+
+	// Only accessed on Queue.
+	MYSQL Connection;
+	bool Connected = false;
+
+	std::mutex QueriesMutex;
+	std::vector<IdoAsyncQuery> Queries;
+	unsigned int MaxPacketSize = 64 * 1024;
+
+	// Only accessed on the IdoMysqlConnection's work queue.
+	DbInsertBatch Upserts;
+};
+
 /**
  * An IDO MySQL database connection.
  *
@@ -67,8 +92,12 @@ private:
 	unsigned int m_MaxPacketSize;
 
 	std::vector<IdoAsyncQuery> m_AsyncQueries;
+	DbInsertBatch m_InsertBatch;
 	uint_fast32_t m_UncommittedAsyncQueries = 0;
 
+	std::vector<std::unique_ptr<IdoMysqlWriter>> m_Writers;
+	size_t m_NextWriter = 0;
+
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_TxTimer;
 
@@ -81,11 +110,24 @@ private:
 
 	void AsyncQuery(const String& query, const IdoAsyncCallback& callback = IdoAsyncCallback());
 	void FinishAsyncQueries();
+	void SendQueries(MYSQL *connection, unsigned int maxPacketSize, const std::vector<IdoAsyncQuery>& queries, int *affectedRows);
+
+	void BatchInsertQuery(const DbQuery& query, const String& key, bool upsert);
+	void FlushInsertBatch();
+	void FlushInsertBatch(DbInsertBatch& batch, IdoMysqlWriter *writer);
+	void DiscardInsertBatch();
+
+	IdoMysqlWriter& GetWriter(const DbObject::Ptr& object);
+	void WriterQuery(IdoMysqlWriter& writer, const String& query, const std::function<void ()>& callback = nullptr);
+	void FlushWriter(IdoMysqlWriter& writer);
+	void DisconnectWriters();
+	void WriterExceptionHandler(IdoMysqlWriter& writer, boost::exception_ptr exp);
 
 	bool FieldToEscapedString(const String& key, const Value& value, Value *result);
 	void InternalActivateObject(const DbObject::Ptr& dbobj);
 	void InternalDeactivateObject(const DbObject::Ptr& dbobj);
 
+	void Connect(MYSQL *connection);
 	void Reconnect();
 
 	void AssertOnWorkQueue();
@@ -99,6 +141,8 @@ private:
 
 	void FinishExecuteQuery(const DbQuery& query, int type, bool upsert);
 	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value);
+	void CleanUpChunk(const String& table, const String& time_column, double max_age);
+	void DropPartitions(const String& table, double max_age);
 	void InternalNewTransaction();
 
 	void ClearTableBySession(const String& table);
@@ -66,7 +66,9 @@ void IdoPgsqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 			{ "instance_name", idopgsqlconnection->GetInstanceName() },
 			{ "connected", idopgsqlconnection->GetConnected() },
 			{ "query_queue_items", queryQueueItems },
-			{ "query_queue_item_rate", queryQueueItemRate }
+			{ "query_queue_item_rate", queryQueueItemRate },
+			{ "query_queue_memory", idopgsqlconnection->GetQueuedQueryMemory() },
+			{ "dropped_status_updates", idopgsqlconnection->GetDroppedStatusUpdates() }
 		}));
 
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_queries_rate", idopgsqlconnection->GetQueryCount(60) / 60.0));
@@ -75,6 +77,8 @@ void IdoPgsqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_queries_15mins", idopgsqlconnection->GetQueryCount(15 * 60)));
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_query_queue_items", queryQueueItems));
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_query_queue_item_rate", queryQueueItemRate));
+		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_query_queue_memory", idopgsqlconnection->GetQueuedQueryMemory()));
+		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_dropped_status_updates", idopgsqlconnection->GetDroppedStatusUpdates()));
 	}
 
 	status->Set("idopgsqlconnection", new Dictionary(std::move(nodes)));
@@ -126,6 +130,10 @@ void IdoPgsqlConnection::ExceptionHandler(boost::exception_ptr exp)
 	Log(LogDebug, "IdoPgsqlConnection")
 		<< "Exception during database operation: " << DiagnosticInformation(std::move(exp));
 
+	DiscardInsertBatch();
+	m_PipelinedQueries.clear();
+	m_InPipeline = false;
+
 	if (GetConnected()) {
 		m_Pgsql->finish(m_Connection);
 		SetConnected(false);
@@ -242,6 +250,10 @@ void IdoPgsqlConnection::Reconnect()
 
 	/* connection */
 	m_Connection = m_Pgsql->connectdb(conninfo.CStr());
+	m_PreparedStatements.clear();
+	m_PipelinedQueries.clear();
+	m_InPipeline = false;
+	m_PipelineSupported = true;
 
 	if (!m_Connection)
 		return;
@@ -472,8 +484,13 @@ IdoPgsqlResult IdoPgsqlConnection::Query(const String& query)
 {
 	AssertOnWorkQueue();
 
+	/* Keep the order of the queries. */
+	FlushInsertBatch();
+
 	Defer decreaseQueries ([this]() { DecreasePendingQueries(1); });
 
+	FinishPipeline();
+
 	Log(LogDebug, "IdoPgsqlConnection")
 		<< "Query: " << query;
 
@@ -668,37 +685,12 @@ bool IdoPgsqlConnection::FieldToEscapedString(const String& key, const Value& va
 	if (rawvalue.GetType() == ValueEmpty) {
 		*result = "NULL";
 	} else if (rawvalue.IsObjectType<ConfigObject>()) {
-		DbObject::Ptr dbobjcol = DbObject::GetOrCreateByObject(rawvalue);
-
-		if (!dbobjcol) {
-			*result = 0;
-			return true;
-		}
+		long id;
 
-		if (!IsIDCacheValid())
+		if (!ObjectFieldToID(value, rawvalue, &id))
 			return false;
 
-		DbReference dbrefcol;
-
-		if (DbValue::IsObjectInsertID(value)) {
-			dbrefcol = GetInsertID(dbobjcol);
-
-			if (!dbrefcol.IsValid())
-				return false;
-		} else {
-			dbrefcol = GetObjectID(dbobjcol);
-
-			if (!dbrefcol.IsValid()) {
-				InternalActivateObject(dbobjcol);
-
-				dbrefcol = GetObjectID(dbobjcol);
-
-				if (!dbrefcol.IsValid())
-					return false;
-			}
-		}
-
-		*result = static_cast<long>(dbrefcol);
+		*result = id;
 	} else if (DbValue::IsTimestamp(value)) {
 		long ts = rawvalue;
 		std::ostringstream msgbuf;
@@ -726,6 +718,95 @@ bool IdoPgsqlConnection::FieldToEscapedString(const String& key, const Value& va
 	return true;
 }
 
+/**
+ * Like FieldToEscapedString(), but for a query parameter.
+ *
+ * @param expression Receives the SQL expression taking the parameter, "?" being its placeholder
+ * @param parameter Receives the parameter as text, Empty for NULL
+ */
+bool IdoPgsqlConnection::FieldToParameter(const String& key, const Value& value, String *expression, Value *parameter)
+{
+	*expression = "?";
+
+	if (key == "instance_id") {
+		*parameter = static_cast<long>(m_InstanceID);
+		return true;
+	} else if (key == "session_token") {
+		*parameter = GetSessionToken();
+		return true;
+	}
+
+	Value rawvalue = DbValue::ExtractValue(value);
+
+	if (rawvalue.GetType() == ValueEmpty) {
+		*parameter = Empty;
+	} else if (rawvalue.IsObjectType<ConfigObject>()) {
+		long id;
+
+		if (!ObjectFieldToID(value, rawvalue, &id))
+			return false;
+
+		*parameter = id;
+	} else if (DbValue::IsTimestamp(value)) {
+		*expression = "TO_TIMESTAMP(?) AT TIME ZONE 'UTC'";
+		*parameter = static_cast<long>(rawvalue);
+	} else if (DbValue::IsObjectInsertID(value)) {
+		auto id = static_cast<long>(rawvalue);
+
+		if (id <= 0)
+			return false;
+
+		*parameter = id;
+	} else if (rawvalue.IsBoolean()) {
+		*parameter = Convert::ToLong(rawvalue);
+	} else {
+		*parameter = Convert::ToString(rawvalue);
+	}
+
+	return true;
+}
+
+/**
+ * Resolves a field referring to a config object to the object's (or insert) ID.
+ *
+ * @return Whether the ID is known (yet)
+ */
+bool IdoPgsqlConnection::ObjectFieldToID(const Value& value, const Value& rawvalue, long *result)
+{
+	DbObject::Ptr dbobjcol = DbObject::GetOrCreateByObject(rawvalue);
+
+	if (!dbobjcol) {
+		*result = 0;
+		return true;
+	}
+
+	if (!IsIDCacheValid())
+		return false;
+
+	DbReference dbrefcol;
+
+	if (DbValue::IsObjectInsertID(value)) {
+		dbrefcol = GetInsertID(dbobjcol);
+
+		if (!dbrefcol.IsValid())
+			return false;
+	} else {
+		dbrefcol = GetObjectID(dbobjcol);
+
+		if (!dbrefcol.IsValid()) {
+			InternalActivateObject(dbobjcol);
+
+			dbrefcol = GetObjectID(dbobjcol);
+
+			if (!dbrefcol.IsValid())
+				return false;
+		}
+	}
+
+	*result = static_cast<long>(dbrefcol);
+	return true;
+}
+
 void IdoPgsqlConnection::ExecuteQuery(const DbQuery& query)
 {
 	if (IsPaused() && GetPauseCalled())
@@ -871,6 +952,17 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 
 	type = (typeOverride != -1) ? typeOverride : query.Type;
 
+	if (DbInsertBatch::IsBatchableInsert(query, type)) {
+		BatchInsertQuery(query, String(), String());
+		return;
+	}
+
+	/* INSERT ... ON CONFLICT requires PostgreSQL 9.5. */
+	if (DbInsertBatch::IsBatchableUpsert(query, type) && m_Pgsql->serverVersion(m_Connection) >= 90500) {
+		BatchInsertQuery(query, where.str(), query.WhereCriteria->GetKeys().at(0));
+		return;
+	}
+
 	bool upsert = false;
 
 	if ((type & DbQueryInsert) && (type & DbQueryUpdate)) {
@@ -983,6 +1075,316 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	}
 }
 
+/**
+ * Adds an INSERT (or an INSERT ... ON CONFLICT DO UPDATE) to m_InsertBatch instead of executing it on its own.
+ *
+ * @param key The WHERE clause of an upsert, to not update a row twice in one statement
+ * @param conflictColumn The unique column of an upsert, empty for a plain INSERT
+ */
+void IdoPgsqlConnection::BatchInsertQuery(const DbQuery& query, const String& key, const String& conflictColumn)
+{
+	std::ostringstream head, row, tail;
+	bool upsert = !conflictColumn.IsEmpty();
+
+	head << "INSERT INTO " << GetTablePrefix() << query.Table << " (";
+	row << "(";
+
+	if (upsert)
+		tail << " ON CONFLICT (" << conflictColumn << ") DO UPDATE SET ";
+
+	std::vector<Value> parameters;
+
+	{
+		ObjectLock olock(query.Fields);
+
+		String expression;
+		Value parameter;
+		bool first = true;
+		for (const Dictionary::Pair& kv : query.Fields) {
+			if (!FieldToParameter(kv.first, kv.second, &expression, &parameter)) {
+				m_QueryQueue.Enqueue([this, query]() { InternalExecuteQuery(query, -1); }, query.Priority);
+				return;
+			}
+
+			if (!first) {
+				head << ", ";
+				row << ", ";
+
+				if (upsert)
+					tail << ", ";
+			}
+
+			head << kv.first;
+			row << expression;
+			parameters.emplace_back(std::move(parameter));
+
+			if (upsert)
+				tail << kv.first << " = EXCLUDED." << kv.first;
+
+			first = false;
+		}
+	}
+
+	head << ")";
+	row << ")";
+
+	String sHead = head.str(), sTail = tail.str(), sRow = row.str();
+	DbInsertBatch::Callback callback;
+
+	if (upsert) {
+		DbObject::Ptr object = query.Object;
+		callback = [this, object]() { SetStatusUpdate(object, true); };
+	}
+
+	/* Statements aren't limited in size, but don't let them grow without bounds either. */
+	if (!m_InsertBatch.Accepts(sHead, sTail, key, sRow.GetLength(), 1024 * 1024))
+		FlushInsertBatch();
+
+	if (m_InsertBatch.IsEmpty()) {
+		/* Executes the batch once nothing more urgent is left to do, unless sent meanwhile. */
+		m_QueryQueue.Enqueue([this]() { FlushInsertBatch(); }, PriorityLow);
+	}
+
+	m_InsertBatch.Add(sHead, sTail, key, sRow, std::move(callback));
+	m_InsertBatchParameters.insert(m_InsertBatchParameters.end(), parameters.begin(), parameters.end());
+}
+
+/**
+ * Executes m_InsertBatch as one query.
+ */
+void IdoPgsqlConnection::FlushInsertBatch()
+{
+	AssertOnWorkQueue();
+
+	if (m_InsertBatch.IsEmpty())
+		return;
+
+	if (!GetConnected()) {
+		DiscardInsertBatch();
+		return;
+	}
+
+	auto rows (m_InsertBatch.GetRowCount());
+	std::vector<DbInsertBatch::Callback> callbacks;
+	std::vector<Value> parameters;
+	String query = m_InsertBatch.Take(callbacks);
+
+	parameters.swap(m_InsertBatchParameters);
+
+	{
+		/* The rows only contain placeholders, no literals. */
+		std::string numbered;
+		size_t number = 0;
+
+		numbered.reserve(query.GetLength() + parameters.size() * 4u);
+
+		for (char c : query.GetData()) {
+			if (c == '?')
+				numbered += "$" + std::to_string(++number);
+			else
+				numbered += c;
+		}
+
+		query = std::move(numbered);
+	}
+
+	Defer decreaseQueries ([this, rows]() { DecreasePendingQueries(rows); });
+
+	ExecuteParameterized(query, parameters);
+
+	for (auto& callback : callbacks)
+		callback();
+}
+
+/**
+ * Executes a statement without result rows and with text parameters (no escaping needed). Statements executed
+ * repeatedly are prepared on the server, so it parses and plans them only once per connection.
+ *
+ * @param parameters Values to be read via $1, $2, ... (Empty for NULL)
+ */
+void IdoPgsqlConnection::ExecuteParameterized(const String& query, const std::vector<Value>& parameters)
+{
+	AssertOnWorkQueue();
+
+	Log(LogDebug, "IdoPgsqlConnection")
+		<< "Query: " << query;
+
+	IncreaseQueryCount();
+
+	std::vector<String> texts;
+	std::vector<const char *> values;
+
+	texts.reserve(parameters.size());
+	values.reserve(parameters.size());
+
+	for (auto& parameter : parameters) {
+		if (parameter.GetType() == ValueEmpty) {
+			values.emplace_back(nullptr);
+		} else {
+			texts.emplace_back(Convert::ToString(parameter));
+			values.emplace_back(texts.back().CStr());
+		}
+	}
+
+	auto throwError ([this, &query](const String& message) {
+		Log(LogCritical, "IdoPgsqlConnection")
+			<< "Error \"" << message << "\" when executing query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+			database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	});
+
+	auto check ([this, &throwError](PGresult *result) {
+		if (!result)
+			throwError(m_Pgsql->errorMessage(m_Connection));
+
+		Defer clear ([this, result]() { m_Pgsql->clear(result); });
+
+		if (m_Pgsql->resultStatus(result) != PGRES_COMMAND_OK)
+			throwError(m_Pgsql->resultErrorMessage(result));
+	});
+
+	auto& statement (m_PreparedStatements[query]);
+	bool prepare = false;
+
+	/* Preparing costs a round trip (unless pipelined), so do it only for the second execution. */
+	if (statement.Name.IsEmpty() && ++statement.Executions >= 2) {
+		if (m_PreparedStatements.size() > 256) {
+			FinishPipeline();
+
+			m_PreparedStatements.clear();
+			check(m_Pgsql->exec(m_Connection, "DEALLOCATE ALL"));
+
+			ExecuteParameterized(query, parameters);
+			return;
+		}
+
+		statement.Name = "icinga_" + Convert::ToString(++m_LastPreparedStatement);
+		prepare = true;
+	}
+
+	if (!m_InPipeline && m_PipelineSupported) {
+		m_InPipeline = m_Pgsql->enterPipelineMode(m_Connection);
+
+		if (!m_InPipeline) {
+			m_PipelineSupported = false;
+
+			Log(LogNotice, "IdoPgsqlConnection")
+				<< "Pipeline mode is not available, executing queries one by one.";
+		}
+	}
+
+	if (m_InPipeline) {
+		/* Don't wait for the results, FinishPipeline() checks them. */
+		auto send ([this, &query, &throwError](int sent) {
+			if (!sent || m_Pgsql->flush(m_Connection) != 0)
+				throwError(m_Pgsql->errorMessage(m_Connection));
+
+			m_PipelinedQueries.emplace_back(query);
+		});
+
+		if (statement.Name.IsEmpty()) {
+			send(m_Pgsql->sendQueryParams(m_Connection, query.CStr(), values.size(), nullptr, values.data(), nullptr, nullptr, 0));
+		} else {
+			if (prepare)
+				send(m_Pgsql->sendPrepare(m_Connection, statement.Name.CStr(), query.CStr(), values.size(), nullptr));
+
+			send(m_Pgsql->sendQueryPrepared(m_Connection, statement.Name.CStr(), values.size(), values.data(), nullptr, nullptr, 0));
+		}
+
+		/* Don't let the results pile up. */
+		if (m_PipelinedQueries.size() >= 256)
+			FinishPipeline();
+
+		return;
+	}
+
+	if (statement.Name.IsEmpty()) {
+		check(m_Pgsql->execParams(m_Connection, query.CStr(), values.size(), nullptr, values.data(), nullptr, nullptr, 0));
+		return;
+	}
+
+	if (prepare)
+		check(m_Pgsql->prepare(m_Connection, statement.Name.CStr(), query.CStr(), values.size(), nullptr));
+
+	check(m_Pgsql->execPrepared(m_Connection, statement.Name.CStr(), values.size(), values.data(), nullptr, nullptr, 0));
+}
+
+/**
+ * Waits for the results of the statements ExecuteParameterized() sent in pipeline mode and leaves that mode,
+ * so that the connection can be used synchronously again.
+ */
+void IdoPgsqlConnection::FinishPipeline()
+{
+	if (!m_InPipeline)
+		return;
+
+	std::vector<String> queries;
+	m_PipelinedQueries.swap(queries);
+
+	auto throwError ([](const String& message, const String& query) {
+		Log(LogCritical, "IdoPgsqlConnection")
+			<< "Error \"" << message << "\" when executing query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+			database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	});
+
+	if (!m_Pgsql->pipelineSync(m_Connection))
+		throwError(m_Pgsql->errorMessage(m_Connection), "<pipeline sync>");
+
+	for (auto& query : queries) {
+		PGresult *result = m_Pgsql->getResult(m_Connection);
+
+		if (!result)
+			throwError(m_Pgsql->errorMessage(m_Connection), query);
+
+		{
+			Defer clear ([this, result]() { m_Pgsql->clear(result); });
+
+			if (m_Pgsql->resultStatus(result) != PGRES_COMMAND_OK)
+				throwError(m_Pgsql->resultErrorMessage(result), query);
+		}
+
+		/* Terminates the statement's results. */
+		result = m_Pgsql->getResult(m_Connection);
+
+		if (result) {
+			m_Pgsql->clear(result);
+			throwError("Unexpected result", query);
+		}
+	}
+
+	/* The sync point */
+	PGresult *result = m_Pgsql->getResult(m_Connection);
+
+	if (result)
+		m_Pgsql->clear(result);
+
+	if (!m_Pgsql->exitPipelineMode(m_Connection))
+		throwError(m_Pgsql->errorMessage(m_Connection), "<pipeline end>");
+
+	m_InPipeline = false;
+}
+
+void IdoPgsqlConnection::DiscardInsertBatch()
+{
+	if (m_InsertBatch.IsEmpty())
+		return;
+
+	std::vector<DbInsertBatch::Callback> callbacks;
+
+	DecreasePendingQueries(m_InsertBatch.GetRowCount());
+	m_InsertBatch.Take(callbacks);
+	m_InsertBatchParameters.clear();
+}
+
 void IdoPgsqlConnection::CleanUpExecuteQuery(const String& table, const String& time_column, double max_age)
 {
 	if (IsPaused())
@@ -1001,9 +1403,85 @@ void IdoPgsqlConnection::InternalCleanUpExecuteQuery(const String& table, const
 		return;
 	}
 
-	Query("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
+	String mode = GetCleanupMode();
+
+	if (mode == "delete") {
+		Query("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
+			Convert::ToString(static_cast<long>(m_InstanceID)) + " AND " + time_column +
+			" < TO_TIMESTAMP(" + Convert::ToString(static_cast<long>(max_age)) + ") AT TIME ZONE 'UTC'");
+		return;
+	}
+
+	DecreasePendingQueries(1);
+
+	if (mode == "partitions")
+		DropPartitions(table, max_age);
+
+	/* Rows in partitions not entirely too old yet (or all of them if not partitioned). */
+	CleanUpChunk(table, time_column, max_age);
+}
+
+/**
+ * Deletes up to cleanup_chunk_size old rows and schedules the next chunk (at low priority).
+ */
+void IdoPgsqlConnection::CleanUpChunk(const String& table, const String& time_column, double max_age)
+{
+	AssertOnWorkQueue();
+
+	if (IsPaused() || !GetConnected())
+		return;
+
+	String fullTable = GetTablePrefix() + table;
+
+	IncreasePendingQueries(1);
+	Query("DELETE FROM " + fullTable + " WHERE ctid = ANY(ARRAY(SELECT ctid FROM " + fullTable + " WHERE instance_id = " +
 		Convert::ToString(static_cast<long>(m_InstanceID)) + " AND " + time_column +
-		" < TO_TIMESTAMP(" + Convert::ToString(static_cast<long>(max_age)) + ") AT TIME ZONE 'UTC'");
+		" < TO_TIMESTAMP(" + Convert::ToString(static_cast<long>(max_age)) + ") AT TIME ZONE 'UTC' LIMIT " +
+		Convert::ToString(GetCleanupChunkSize()) + "))");
+
+	if (ShouldContinueCleanUp(GetAffectedRows())) {
+		m_QueryQueue.Enqueue([this, table, time_column, max_age]() { CleanUpChunk(table, time_column, max_age); }, PriorityLow);
+	}
+}
+
+/**
+ * Drops the partitions of a table partitioned by RANGE (<time column>) whose upper bound is not newer than max_age,
+ * i.e. which only contain too old rows. Note that this doesn't filter by instance.
+ */
+void IdoPgsqlConnection::DropPartitions(const String& table, double max_age)
+{
+	AssertOnWorkQueue();
+
+	/* Declarative partitioning */
+	if (m_Pgsql->serverVersion(m_Connection) < 100000) {
+		Log(LogWarning, "IdoPgsqlConnection")
+			<< "Cleanup (" << table << "): Partitions require PostgreSQL 10 or newer, deleting rows only.";
+		return;
+	}
+
+	IncreasePendingQueries(1);
+	IdoPgsqlResult result = Query("SELECT c.relname AS name FROM pg_inherits i JOIN pg_class c ON c.oid = i.inhrelid "
+		"WHERE i.inhparent = '" + Escape(GetTablePrefix() + table) + "'::regclass "
+		"AND SUBSTRING(pg_get_expr(c.relpartbound, c.oid) FROM 'TO \\(''([^'']+)''\\)')::timestamp <= TO_TIMESTAMP("
+		+ Convert::ToString(static_cast<long>(max_age)) + ") AT TIME ZONE 'UTC'");
+
+	std::vector<String> partitions;
+	Dictionary::Ptr row;
+
+	for (int index = 0; (row = FetchRow(result, index)); index++) {
+		partitions.emplace_back(row->Get("name"));
+	}
+
+	if (partitions.empty())
+		return;
+
+	Log(LogNotice, "IdoPgsqlConnection")
+		<< "Cleanup (" << table << "): Dropping " << partitions.size() << " partition(s).";
+
+	for (auto& partition : partitions) {
+		IncreasePendingQueries(1);
+		Query("DROP TABLE \"" + partition + "\"");
+	}
 }
 
 void IdoPgsqlConnection::FillIDCache(const DbType::Ptr& type)
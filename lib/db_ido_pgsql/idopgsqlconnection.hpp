@@ -5,10 +5,14 @@
 
 #include "db_ido_pgsql/idopgsqlconnection-ti.hpp"
 #include "pgsql_shim/pgsqlinterface.hpp"
+#include "db_ido/dbinsertbatch.hpp"
 #include "base/array.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
 #include "base/library.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
 
 namespace icinga
 {
@@ -58,16 +62,41 @@ private:
 	PGconn *m_Connection;
 	int m_AffectedRows;
 
+	DbInsertBatch m_InsertBatch;
+	std::vector<Value> m_InsertBatchParameters;
+
+	struct PreparedStatement
+	{
+		String Name;
+		unsigned Executions = 0;
+	};
+
+	std::unordered_map<String, PreparedStatement> m_PreparedStatements;
+	uint_fast64_t m_LastPreparedStatement = 0;
+
+	bool m_PipelineSupported = true;
+	bool m_InPipeline = false;
+	std::vector<String> m_PipelinedQueries;
+
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_TxTimer;
 
 	IdoPgsqlResult Query(const String& query);
+
+	void ExecuteParameterized(const String& query, const std::vector<Value>& parameters);
+	void FinishPipeline();
+
+	void BatchInsertQuery(const DbQuery& query, const String& key, const String& conflictColumn);
+	void FlushInsertBatch();
+	void DiscardInsertBatch();
 	DbReference GetSequenceValue(const String& table, const String& column);
 	int GetAffectedRows();
 	String Escape(const String& s);
 	Dictionary::Ptr FetchRow(const IdoPgsqlResult& result, int row);
 
 	bool FieldToEscapedString(const String& key, const Value& value, Value *result);
+	bool FieldToParameter(const String& key, const Value& value, String *expression, Value *parameter);
+	bool ObjectFieldToID(const Value& value, const Value& rawvalue, long *result);
 	void InternalActivateObject(const DbObject::Ptr& dbobj);
 	void InternalDeactivateObject(const DbObject::Ptr& dbobj);
 
@@ -85,6 +114,8 @@ private:
 	void InternalExecuteQuery(const DbQuery& query, int typeOverride = -1);
 	void InternalExecuteMultipleQueries(const std::vector<DbQuery>& queries);
 	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value);
+	void CleanUpChunk(const String& table, const String& time_column, double max_age);
+	void DropPartitions(const String& table, double max_age);
 
 	void ClearTableBySession(const String& table);
 	void ClearTablesBySession();
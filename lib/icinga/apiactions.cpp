@@ -434,24 +434,20 @@ Dictionary::Ptr ApiActions::ScheduleDowntime(const ConfigObject::Ptr& object,
 	if (params->Contains("all_services"))
 		allServices = HttpUtility::GetLastParameter(params, "all_services");
 
-	if (allServices && !service) {
-		ArrayData serviceDowntimes;
+	/* All further downtimes are created together, the indices refer to them. */
+	std::vector<NewConfigObject> downtimes;
+	std::vector<size_t> serviceDowntimes;
+	std::vector<std::pair<size_t, std::vector<size_t>>> childDowntimes;
 
+	if (allServices && !service) {
 		for (const Service::Ptr& hostService : host->GetServices()) {
 			Log(LogNotice, "ApiActions")
 				<< "Creating downtime for service " << hostService->GetName() << " on host " << host->GetName();
 
-			Downtime::Ptr serviceDowntime = Downtime::AddDowntime(hostService, author, comment, startTime, endTime,
-				fixed, triggerName, duration, String(), String(), downtimeName);
-			String serviceDowntimeName = serviceDowntime->GetName();
-
-			serviceDowntimes.push_back(new Dictionary({
-				{ "name", serviceDowntimeName },
-				{ "legacy_id", serviceDowntime->GetLegacyId() }
-			}));
+			serviceDowntimes.emplace_back(downtimes.size());
+			downtimes.emplace_back(Downtime::MakeDowntime(hostService, author, comment, startTime, endTime,
+				fixed, triggerName, duration, String(), String(), downtimeName));
 		}
-
-		additional->Set("service_downtimes", new Array(std::move(serviceDowntimes)));
 	}
 
 	/* Schedule downtime for all child objects. */
@@ -465,8 +461,6 @@ Dictionary::Ptr ApiActions::ScheduleDowntime(const ConfigObject::Ptr& object,
 		Log(LogNotice, "ApiActions")
 			<< "Processing child options " << childOptions << " for downtime " << downtimeName;
 
-		ArrayData childDowntimes;
-
 		std::set<Checkable::Ptr> allChildren = checkable->GetAllChildren();
 		for (const Checkable::Ptr& child : allChildren) {
 			Host::Ptr childHost;
@@ -485,43 +479,68 @@ Dictionary::Ptr ApiActions::ScheduleDowntime(const ConfigObject::Ptr& object,
 			Log(LogNotice, "ApiActions")
 				<< "Scheduling downtime for child object " << child->GetName();
 
-			Downtime::Ptr childDowntime = Downtime::AddDowntime(child, author, comment, startTime, endTime,
-				fixed, triggerName, duration);
-			String childDowntimeName = childDowntime->GetName();
-
-			Log(LogNotice, "ApiActions")
-				<< "Add child downtime '" << childDowntimeName << "'.";
+			NewConfigObject childDowntime (Downtime::MakeDowntime(child, author, comment, startTime, endTime,
+				fixed, triggerName, duration));
+			String childDowntimeName = childDowntime.Name;
 
-			Dictionary::Ptr childAdditional = new Dictionary({
-				{ "name", childDowntimeName },
-				{ "legacy_id", childDowntime->GetLegacyId() }
-			});
+			childDowntimes.emplace_back(downtimes.size(), std::vector<size_t>());
+			downtimes.emplace_back(std::move(childDowntime));
 
 			/* For a host, also schedule all service downtimes if requested. */
 			if (allServices && !childService) {
-				ArrayData childServiceDowntimes;
-
 				for (const Service::Ptr& childService : childHost->GetServices()) {
 					Log(LogNotice, "ApiActions")
 						<< "Creating downtime for service " << childService->GetName() << " on child host " << childHost->GetName();
 
-					Downtime::Ptr serviceDowntime = Downtime::AddDowntime(childService, author, comment, startTime, endTime,
-						fixed, triggerName, duration, String(), String(), childDowntimeName);
-					String serviceDowntimeName = serviceDowntime->GetName();
-
-					childServiceDowntimes.push_back(new Dictionary({
-						{ "name", serviceDowntimeName },
-						{ "legacy_id", serviceDowntime->GetLegacyId() }
-					}));
+					childDowntimes.back().second.emplace_back(downtimes.size());
+					downtimes.emplace_back(Downtime::MakeDowntime(childService, author, comment, startTime, endTime,
+						fixed, triggerName, duration, String(), String(), childDowntimeName));
 				}
+			}
+		}
+	}
+
+	std::vector<Downtime::Ptr> created = Downtime::AddDowntimes(downtimes);
+
+	auto getResult ([&created](size_t i) -> Dictionary::Ptr {
+		return new Dictionary({
+			{ "name", created[i]->GetName() },
+			{ "legacy_id", created[i]->GetLegacyId() }
+		});
+	});
+
+	if (allServices && !service) {
+		ArrayData serviceResults;
+
+		for (size_t i : serviceDowntimes)
+			serviceResults.push_back(getResult(i));
+
+		additional->Set("service_downtimes", new Array(std::move(serviceResults)));
+	}
+
+	if (childOptions != DowntimeNoChildren) {
+		ArrayData childResults;
+
+		for (auto& child : childDowntimes) {
+			Dictionary::Ptr childAdditional = getResult(child.first);
+
+			Log(LogNotice, "ApiActions")
+				<< "Add child downtime '" << created[child.first]->GetName() << "'.";
+
+			/* For a host, also the service downtimes if requested. */
+			if (allServices && created[child.first]->GetServiceName().IsEmpty()) {
+				ArrayData childServiceResults;
+
+				for (size_t i : child.second)
+					childServiceResults.push_back(getResult(i));
 
-				childAdditional->Set("service_downtimes", new Array(std::move(childServiceDowntimes)));
+				childAdditional->Set("service_downtimes", new Array(std::move(childServiceResults)));
 			}
 
-			childDowntimes.push_back(childAdditional);
+			childResults.push_back(childAdditional);
 		}
 
-		additional->Set("child_downtimes", new Array(std::move(childDowntimes)));
+		additional->Set("child_downtimes", new Array(std::move(childResults)));
 	}
 
 	return ApiActions::CreateResult(200, "Successfully scheduled downtime '" +
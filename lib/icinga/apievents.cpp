@@ -13,7 +13,7 @@ INITIALIZE_ONCE(&ApiEvents::StaticInitialize);
 
 void ApiEvents::StaticInitialize()
 {
-	Checkable::OnNewCheckResult.connect(&ApiEvents::CheckResultHandler);
+	Checkable::OnNewCheckResult.connect("ApiEvents", &ApiEvents::CheckResultHandler);
 	Checkable::OnStateChange.connect(&ApiEvents::StateChangeHandler);
 	Checkable::OnNotificationSentToAllUsers.connect(&ApiEvents::NotificationSentToAllUsersHandler);
 
@@ -9,17 +9,23 @@
 #include "icinga/clusterevents.hpp"
 #include "remote/messageorigin.hpp"
 #include "remote/apilistener.hpp"
+#include "remote/endpointbatch.hpp"
 #include "base/objectlock.hpp"
 #include "base/logger.hpp"
 #include "base/convert.hpp"
 #include "base/utility.hpp"
 #include "base/context.hpp"
+#include "base/json.hpp"
+#include <cmath>
+#include <functional>
+#include <string>
 
 using namespace icinga;
 
-boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, const MessageOrigin::Ptr&)> Checkable::OnNewCheckResult;
-boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, StateType, const MessageOrigin::Ptr&)> Checkable::OnStateChange;
-boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, std::set<Checkable::Ptr>, const MessageOrigin::Ptr&)> Checkable::OnReachabilityChanged;
+Signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, const MessageOrigin::Ptr&)> Checkable::OnNewCheckResult ("Checkable::OnNewCheckResult");
+Signal<void (const std::vector<Checkable::NewCheckResult>&)> Checkable::OnNewCheckResults ("Checkable::OnNewCheckResults");
+Signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, StateType, const MessageOrigin::Ptr&)> Checkable::OnStateChange;
+Signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, std::set<Checkable::Ptr>, const MessageOrigin::Ptr&)> Checkable::OnReachabilityChanged;
 boost::signals2::signal<void (const Checkable::Ptr&, NotificationType, const CheckResult::Ptr&, const String&, const String&, const MessageOrigin::Ptr&)> Checkable::OnNotificationsRequested;
 boost::signals2::signal<void (const Checkable::Ptr&)> Checkable::OnNextCheckUpdated;
 
@@ -29,6 +35,23 @@ std::mutex Checkable::m_StatsMutex;
 int Checkable::m_PendingChecks = 0;
 std::condition_variable Checkable::m_PendingChecksCV;
 
+std::mutex Checkable::m_NewCheckResultsMutex;
+std::vector<Checkable::NewCheckResult> Checkable::m_NewCheckResults;
+
+/* Number of check results after which OnNewCheckResults is emitted without waiting for the timer. */
+static const size_t l_NewCheckResultsBatchSize = 512;
+
+std::atomic<bool> Checkable::m_SpreadChecks (false);
+
+/**
+ * The number of checks planned for each second of the next hour, see Checkable::SpreadNextCheck().
+ */
+static struct {
+	std::mutex Mutex;
+	std::array<uint_fast32_t, 3600> Seconds {};
+	long long Oldest = 0; // The second Seconds[Oldest % 3600] currently refers to
+} l_CheckSlots;
+
 CheckCommand::Ptr Checkable::GetCheckCommand() const
 {
 	return dynamic_pointer_cast<CheckCommand>(NavigateCheckCommandRaw());
@@ -49,15 +72,69 @@ long Checkable::GetSchedulingOffset()
 	return m_SchedulingOffset;
 }
 
-void Checkable::UpdateNextCheck(const MessageOrigin::Ptr& origin)
+/**
+ * Enables the CheckerComponent's spread_checks mode.
+ */
+void Checkable::SetSpreadChecks(bool spread)
 {
-	double interval;
+	m_SpreadChecks.store(spread, std::memory_order_relaxed);
+}
+
+/**
+ * Picks the second between earliest and latest for which the fewest checks are planned yet
+ * and counts the check for that second. Prefers later seconds, i.e. latest itself if possible.
+ *
+ * @returns The time within the picked second, with the sub-second part of latest
+ */
+double Checkable::SpreadNextCheck(double earliest, double latest)
+{
+	auto now (static_cast<long long>(Utility::GetTime()));
+	auto first (static_cast<long long>(std::ceil(earliest)));
+	auto last (static_cast<long long>(latest));
+	auto size (static_cast<long long>(l_CheckSlots.Seconds.size()));
+
+	std::unique_lock<std::mutex> lock (l_CheckSlots.Mutex);
+
+	if (l_CheckSlots.Oldest < now) {
+		/* The seconds which have passed can be reused for the next hour. */
+		for (auto second (std::max(l_CheckSlots.Oldest, now - size)); second < now; second++)
+			l_CheckSlots.Seconds[second % size] = 0;
+
+		l_CheckSlots.Oldest = now;
+	}
+
+	if (first < now)
+		first = now;
+
+	if (last >= now + size || first > last)
+		return latest;
+
+	auto best (last);
+
+	for (auto second (last - 1); second >= first; second--) {
+		if (l_CheckSlots.Seconds[second % size] < l_CheckSlots.Seconds[best % size])
+			best = second;
+	}
+
+	l_CheckSlots.Seconds[best % size]++;
 
+	return latest - (last - best);
+}
+
+/**
+ * The retry_interval while in a soft state, otherwise the check_interval.
+ */
+double Checkable::GetEffectiveCheckInterval() const
+{
 	if (GetStateType() == StateTypeSoft && GetLastCheckResult() != nullptr)
-		interval = GetRetryInterval();
+		return GetRetryInterval();
 	else
-		interval = GetCheckInterval();
+		return GetCheckInterval();
+}
 
+void Checkable::UpdateNextCheck(const MessageOrigin::Ptr& origin)
+{
+	double interval = GetEffectiveCheckInterval();
 	double now = Utility::GetTime();
 	double adj = 0;
 
@@ -68,6 +145,15 @@ void Checkable::UpdateNextCheck(const MessageOrigin::Ptr& origin)
 		adj = std::min(0.5 + fmod(GetSchedulingOffset(), interval * 5) / 100.0, adj);
 
 	double nextCheck = now - adj + interval;
+
+	if (m_SpreadChecks.load(std::memory_order_relaxed)) {
+		/* Only ever earlier, so that the interval between checks isn't exceeded. */
+		double window = std::min(interval / 10.0, 60.0);
+
+		if (window >= 1)
+			nextCheck = SpreadNextCheck(nextCheck - window, nextCheck);
+	}
+
 	double lastCheck = GetLastCheck();
 
 	Log(LogDebug, "Checkable")
@@ -139,9 +225,9 @@ Checkable::ProcessingResult Checkable::ProcessCheckResult(const CheckResult::Ptr
 		ApiListener::Ptr listener = ApiListener::GetInstance();
 
 		if (listener) {
-			/* send message back to its origin */
+			/* send message back to its origin, together with the other results of the same scheduling window */
 			Dictionary::Ptr message = ClusterEvents::MakeCheckResultMessage(this, cr);
-			listener->SyncSendMessage(command_endpoint, message);
+			EndpointBatch::Send(command_endpoint, message);
 		}
 
 		return Result::Ok;
@@ -330,6 +416,14 @@ Checkable::ProcessingResult Checkable::ProcessCheckResult(const CheckResult::Ptr
 		{ "reachable", reachable }
 	});
 
+	{
+		/* Set by the check task (see CheckStagesInVarsAfter). */
+		Dictionary::Ptr task_vars_after = cr->GetVarsAfter();
+
+		if (task_vars_after && task_vars_after->Contains("check_stages"))
+			vars_after->Set("check_stages", task_vars_after->Get("check_stages"));
+	}
+
 	if (old_cr)
 		cr->SetVarsBefore(old_cr->GetVarsAfter());
 
@@ -344,7 +438,8 @@ Checkable::ProcessingResult Checkable::ProcessCheckResult(const CheckResult::Ptr
 
 		SetLastCheckResult(cr);
 
-		if (GetProblem() != wasProblem) {
+		/* Only IcingaDB listens to this, don't collect the services for nothing. */
+		if (GetProblem() != wasProblem && !Service::OnHostProblemChanged.empty()) {
 			auto services = host->GetServices();
 			olock.Unlock();
 			for (auto& service : services) {
@@ -379,6 +474,35 @@ Checkable::ProcessingResult Checkable::ProcessCheckResult(const CheckResult::Ptr
 
 	olock.Unlock();
 
+	if (cr->GetActive()) {
+		Endpoint::Ptr delegatedTo;
+		double delegatedInterval;
+		size_t delegatedHash;
+
+		{
+			std::unique_lock<std::mutex> lock (m_CheckableMutex);
+			delegatedTo = m_DelegatedCheckEndpoint;
+			delegatedInterval = m_DelegatedCheckInterval;
+			delegatedHash = m_DelegatedCheckHash;
+		}
+
+		if (delegatedTo) {
+			if (delegatedTo != command_endpoint || !IsCheckDelegated() || !CanRunDelegatedCheck()) {
+				/* The checker takes over again, e.g. outside of the check_period. */
+				UnscheduleRemoteCheck();
+			} else if (delegatedInterval != GetEffectiveCheckInterval()) {
+				/* Let the checker send the new interval, e.g. the retry_interval after a soft problem state. */
+				SetNextCheck(Utility::GetTime(), false, origin);
+			} else if (HasDelegatedCheckChanged(delegatedHash)) {
+				/* Let the checker send the new command or vars, e.g. after they have been modified at runtime. */
+				SetNextCheck(Utility::GetTime(), false, origin);
+			} else {
+				/* The command endpoint schedules the check, the checker only re-sends the schedule if the results stop. */
+				SetNextCheck(Utility::GetTime() + delegatedInterval * 2 + GetCheckCommand()->GetTimeout() + 30, false, origin);
+			}
+		}
+	}
+
 #ifdef I2_DEBUG /* I2_DEBUG */
 	Log(LogDebug, "Checkable")
 		<< "Flapping: Checkable " << GetName()
@@ -419,23 +543,31 @@ Checkable::ProcessingResult Checkable::ProcessCheckResult(const CheckResult::Ptr
 		}
 	}
 
-	OnNewCheckResult(this, cr, origin);
+	if (!OnNewCheckResult.empty())
+		OnNewCheckResult(this, cr, origin);
+
+	QueueNewCheckResult(this, cr, origin);
 
 	/* signal status updates to for example db_ido */
-	OnStateChanged(this);
+	if (!OnStateChanged.empty())
+		OnStateChanged(this);
 
 	String old_state_str = (service ? Service::StateToString(old_state) : Host::StateToString(Host::CalculateState(old_state)));
 	String new_state_str = (service ? Service::StateToString(new_state) : Host::StateToString(Host::CalculateState(new_state)));
 
 	/* Whether a hard state change or a volatile state change except OK -> OK happened. */
 	if (hardChange || (is_volatile && !(IsStateOK(old_state) && IsStateOK(new_state)))) {
-		OnStateChange(this, cr, StateTypeHard, origin);
+		if (!OnStateChange.empty())
+			OnStateChange(this, cr, StateTypeHard, origin);
+
 		Log(LogNotice, "Checkable")
 			<< "State Change: Checkable '" << GetName() << "' hard state change from " << old_state_str << " to " << new_state_str << " detected." << (is_volatile ? " Checkable is volatile." : "");
 	}
 	/* Whether a state change happened or the state type is SOFT (must be logged too). */
 	else if (stateChange || GetStateType() == StateTypeSoft) {
-		OnStateChange(this, cr, StateTypeSoft, origin);
+		if (!OnStateChange.empty())
+			OnStateChange(this, cr, StateTypeSoft, origin);
+
 		Log(LogNotice, "Checkable")
 			<< "State Change: Checkable '" << GetName() << "' soft state change from " << old_state_str << " to " << new_state_str << " detected.";
 	}
@@ -526,12 +658,59 @@ Checkable::ProcessingResult Checkable::ProcessCheckResult(const CheckResult::Ptr
 	}
 
 	/* update reachability for child objects */
-	if ((stateChange || hardChange) && !children.empty())
+	if ((stateChange || hardChange) && !children.empty() && !OnReachabilityChanged.empty())
 		OnReachabilityChanged(this, cr, children, origin);
 
 	return Result::Ok;
 }
 
+/**
+ * Adds a check result to the next OnNewCheckResults batch and emits it once full.
+ */
+void Checkable::QueueNewCheckResult(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin)
+{
+	if (OnNewCheckResults.empty()) {
+		return;
+	}
+
+	std::vector<NewCheckResult> batch;
+
+	{
+		std::unique_lock<std::mutex> lock (m_NewCheckResultsMutex);
+
+		m_NewCheckResults.emplace_back(NewCheckResult{checkable, cr, origin});
+
+		if (m_NewCheckResults.size() < l_NewCheckResultsBatchSize) {
+			return;
+		}
+
+		batch.reserve(l_NewCheckResultsBatchSize);
+		batch.swap(m_NewCheckResults);
+	}
+
+	OnNewCheckResults(batch);
+}
+
+/**
+ * Emits OnNewCheckResults for the check results which didn't fill a whole batch.
+ */
+void Checkable::FlushNewCheckResultsTimer(const Timer * const&)
+{
+	std::vector<NewCheckResult> batch;
+
+	{
+		std::unique_lock<std::mutex> lock (m_NewCheckResultsMutex);
+
+		if (m_NewCheckResults.empty()) {
+			return;
+		}
+
+		batch.swap(m_NewCheckResults);
+	}
+
+	OnNewCheckResults(batch);
+}
+
 void Checkable::ExecuteRemoteCheck(const Dictionary::Ptr& resolvedMacros)
 {
 	CONTEXT("Executing remote check for object '" << GetName() << "'");
@@ -546,6 +725,149 @@ void Checkable::ExecuteRemoteCheck(const Dictionary::Ptr& resolvedMacros)
 	GetCheckCommand()->Execute(this, cr, resolvedMacros, true);
 }
 
+/**
+ * Whether the command endpoint schedules the check itself, see the Endpoint's schedule_checks attribute.
+ */
+bool Checkable::IsCheckDelegated() const
+{
+	Endpoint::Ptr endpoint = GetCommandEndpoint();
+
+	return endpoint && endpoint != Endpoint::GetLocalEndpoint() && endpoint->GetScheduleChecks()
+		&& (endpoint->GetCapabilities() & (uint_fast64_t)ApiCapabilities::ScheduledChecks);
+}
+
+/**
+ * Whether the checker would run the check, see CheckerComponent::CheckThreadProc().
+ */
+bool Checkable::CanRunDelegatedCheck()
+{
+	if (!GetEnableActiveChecks() || !IsReachable(DependencyCheckExecution))
+		return false;
+
+	auto icingaApp (IcingaApplication::GetInstance());
+
+	if (!(dynamic_cast<Host*>(this) ? icingaApp->GetEnableHostChecks() : icingaApp->GetEnableServiceChecks()))
+		return false;
+
+	TimePeriod::Ptr tp = GetCheckPeriod();
+
+	return !tp || tp->IsInside(Utility::GetTime());
+}
+
+/**
+ * Returns the event::ExecuteCommand params of the check with the macros resolved on this node.
+ */
+Dictionary::Ptr Checkable::MakeRemoteCheckParams(const CheckResult::Ptr& cr)
+{
+	Dictionary::Ptr macros = new Dictionary();
+	GetCheckCommand()->Execute(this, cr, macros, false);
+
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(this);
+
+	Dictionary::Ptr params = new Dictionary({
+		{ "command_type", "check_command" },
+		{ "command", GetCheckCommand()->GetName() },
+		{ "host", host->GetName() },
+		{ "macros", macros }
+	});
+
+	if (service)
+		params->Set("service", service->GetShortName());
+
+	/*
+	 * If the host/service object specifies the 'check_timeout' attribute,
+	 * forward this to the remote endpoint to limit the command execution time.
+	 */
+	if (!GetCheckTimeout().IsEmpty())
+		params->Set("check_timeout", GetCheckTimeout());
+
+	return params;
+}
+
+/**
+ * Identifies the definition of the check a command endpoint got with its event::ScheduleCheck, to tell whether
+ * e.g. the vars changed since then.
+ *
+ * The macros are hashed unresolved as runtime state like $service.output$ or $icinga.timet$ changes with every
+ * check result. Apart from the vars and addresses, the attributes they may refer to only change with a config reload.
+ */
+size_t Checkable::HashRemoteCheckDefinition()
+{
+	CheckCommand::Ptr command = GetCheckCommand();
+
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(this);
+
+	Dictionary::Ptr definition = new Dictionary({
+		{ "command", command->GetName() },
+		{ "command_line", command->GetCommandLine() },
+		{ "arguments", command->GetArguments() },
+		{ "env", command->GetEnv() },
+		{ "command_vars", command->GetVars() },
+		{ "host_vars", host->GetVars() },
+		{ "host_address", host->GetAddress() },
+		{ "host_address6", host->GetAddress6() },
+		{ "icinga_vars", IcingaApplication::GetInstance()->GetVars() },
+		{ "check_timeout", GetCheckTimeout() }
+	});
+
+	if (service)
+		definition->Set("service_vars", service->GetVars());
+
+	return std::hash<std::string>()(JsonEncode(definition).GetData());
+}
+
+/**
+ * Whether the command endpoint would get another check than the one it got with its event::ScheduleCheck.
+ */
+bool Checkable::HasDelegatedCheckChanged(size_t hash)
+{
+	return HashRemoteCheckDefinition() != hash;
+}
+
+Dictionary::Ptr Checkable::MakeScheduleCheckMessage(double interval)
+{
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(this);
+
+	Dictionary::Ptr params = new Dictionary({
+		{ "command_type", "check_command" },
+		{ "command", GetCheckCommand()->GetName() },
+		{ "host", host->GetName() },
+		{ "check_interval", interval }
+	});
+
+	if (service)
+		params->Set("service", service->GetShortName());
+
+	return new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "event::ScheduleCheck" },
+		{ "params", params }
+	});
+}
+
+/**
+ * Tells the command endpoint to stop running the check on its own.
+ */
+void Checkable::UnscheduleRemoteCheck()
+{
+	Endpoint::Ptr endpoint;
+
+	{
+		std::unique_lock<std::mutex> lock (m_CheckableMutex);
+		std::swap(endpoint, m_DelegatedCheckEndpoint);
+		m_DelegatedCheckInterval = 0;
+	}
+
+	if (endpoint)
+		EndpointBatch::Send(endpoint, MakeScheduleCheckMessage(0));
+}
+
 void Checkable::ExecuteCheck()
 {
 	CONTEXT("Executing check for object '" << GetName() << "'");
@@ -586,50 +908,59 @@ void Checkable::ExecuteCheck()
 	Endpoint::Ptr endpoint = GetCommandEndpoint();
 	bool local = !endpoint || endpoint == Endpoint::GetLocalEndpoint();
 
+	bool delegate = !local && IsCheckDelegated();
+
+	if (!delegate)
+		UnscheduleRemoteCheck();
+
 	if (local) {
 		GetCheckCommand()->Execute(this, cr, nullptr, false);
 	} else {
-		Dictionary::Ptr macros = new Dictionary();
-		GetCheckCommand()->Execute(this, cr, macros, false);
+		Dictionary::Ptr params = MakeRemoteCheckParams(cr);
 
 		if (endpoint->GetConnected()) {
 			/* perform check on remote endpoint */
 			Dictionary::Ptr message = new Dictionary();
 			message->Set("jsonrpc", "2.0");
 			message->Set("method", "event::ExecuteCommand");
-
-			Host::Ptr host;
-			Service::Ptr service;
-			tie(host, service) = GetHostService(this);
-
-			Dictionary::Ptr params = new Dictionary();
 			message->Set("params", params);
-			params->Set("command_type", "check_command");
-			params->Set("command", GetCheckCommand()->GetName());
-			params->Set("host", host->GetName());
 
-			if (service)
-				params->Set("service", service->GetShortName());
+			double interval = GetEffectiveCheckInterval();
+			size_t hash = delegate ? HashRemoteCheckDefinition() : 0;
 
 			/*
-			 * If the host/service object specifies the 'check_timeout' attribute,
-			 * forward this to the remote endpoint to limit the command execution time.
+			 * Let the command endpoint run the check every interval on its own until told otherwise,
+			 * instead of sending it every time. It runs the check once right away.
 			 */
-			if (!GetCheckTimeout().IsEmpty())
-				params->Set("check_timeout", GetCheckTimeout());
+			if (delegate) {
+				message->Set("method", "event::ScheduleCheck");
+				params->Set("check_interval", interval);
+			}
 
-			params->Set("macros", macros);
+			/* Checks of the same agent which are due at about the same time are sent in one event::Batch. */
+			EndpointBatch::Send(endpoint, message);
 
-			ApiListener::Ptr listener = ApiListener::GetInstance();
+			if (delegate) {
+				Endpoint::Ptr previous;
 
-			if (listener)
-				listener->SyncSendMessage(endpoint, message);
+				{
+					std::unique_lock<std::mutex> lock (m_CheckableMutex);
+					previous = m_DelegatedCheckEndpoint;
+					m_DelegatedCheckEndpoint = endpoint;
+					m_DelegatedCheckInterval = interval;
+					m_DelegatedCheckHash = hash;
+				}
+
+				/* The command_endpoint has been changed. */
+				if (previous && previous != endpoint)
+					EndpointBatch::Send(previous, MakeScheduleCheckMessage(0));
+			}
 
 			/* Re-schedule the check so we don't run it again until after we've received
 			 * a check result from the remote instance. The check will be re-scheduled
 			 * using the proper check interval once we've received a check result.
 			 */
-			SetNextCheck(Utility::GetTime() + GetCheckCommand()->GetTimeout() + 30);
+			SetNextCheck(Utility::GetTime() + (delegate ? interval * 2 : 0) + GetCheckCommand()->GetTimeout() + 30);
 
 		/*
 		 * Let the user know that there was a problem with the check if
@@ -651,6 +982,9 @@ void Checkable::ExecuteCheck()
 
 			cr->SetOutput(output);
 
+			/* It forgets about the checks it scheduled itself while disconnected. */
+			UnscheduleRemoteCheck();
+
 			ProcessCheckResult(cr);
 		}
 
@@ -2,21 +2,33 @@
 
 #include "icinga/service.hpp"
 #include "icinga/dependency.hpp"
+#include "icinga/cib.hpp"
 #include "base/logger.hpp"
+#include <algorithm>
 #include <unordered_map>
 
 using namespace icinga;
 
 void Checkable::AddDependency(const Dependency::Ptr& dep)
 {
-	std::unique_lock<std::mutex> lock(m_DependencyMutex);
-	m_Dependencies.insert(dep);
+	{
+		std::unique_lock<std::mutex> lock(m_DependencyMutex);
+		m_Dependencies.insert(dep);
+		m_DependencyIndex = nullptr;
+	}
+
+	InvalidateReachability();
 }
 
 void Checkable::RemoveDependency(const Dependency::Ptr& dep)
 {
-	std::unique_lock<std::mutex> lock(m_DependencyMutex);
-	m_Dependencies.erase(dep);
+	{
+		std::unique_lock<std::mutex> lock(m_DependencyMutex);
+		m_Dependencies.erase(dep);
+		m_DependencyIndex = nullptr;
+	}
+
+	InvalidateReachability();
 }
 
 std::vector<Dependency::Ptr> Checkable::GetDependencies() const
@@ -43,7 +55,140 @@ std::vector<Dependency::Ptr> Checkable::GetReverseDependencies() const
 	return std::vector<Dependency::Ptr>(m_ReverseDependencies.begin(), m_ReverseDependencies.end());
 }
 
+/**
+ * Returns the dependencies' parents and their redundancy groups as arrays, so that
+ * evaluating e.g. hundreds of thousands of applied dependencies doesn't have to
+ * look them up and compare the group names again every time.
+ */
+std::shared_ptr<const Checkable::DependencyIndex> Checkable::GetDependencyIndex() const
+{
+	std::unique_lock<std::mutex> lock(m_DependencyMutex);
+
+	if (m_DependencyIndex)
+		return m_DependencyIndex;
+
+	auto index (std::make_shared<DependencyIndex>());
+	std::unordered_map<String, size_t> groups;
+
+	index->Entries.reserve(m_Dependencies.size());
+
+	for (const Dependency::Ptr& dep : m_Dependencies) {
+		String group = dep->GetRedundancyGroup();
+		size_t groupIndex = DependencyIndex::NoGroup;
+
+		if (!group.IsEmpty()) {
+			auto it (groups.emplace(group, index->Groups.size()));
+
+			if (it.second)
+				index->Groups.emplace_back(std::move(group));
+
+			groupIndex = it.first->second;
+		}
+
+		Checkable::Ptr parent = dep->GetParent();
+
+		index->Entries.push_back({ dep, parent, groupIndex, !dep->GetPeriodRaw().IsEmpty() });
+
+		if (parent && parent.get() != this)
+			index->Parents.emplace_back(std::move(parent));
+	}
+
+	/* NoGroup + 1 wraps to 0, i.e. the non-redundant dependencies come first, they fail the check on their own. */
+	std::stable_sort(index->Entries.begin(), index->Entries.end(), [](const DependencyIndex::Entry& a, const DependencyIndex::Entry& b) {
+		return a.Group + 1u < b.Group + 1u;
+	});
+
+	std::sort(index->Parents.begin(), index->Parents.end());
+	index->Parents.erase(std::unique(index->Parents.begin(), index->Parents.end()), index->Parents.end());
+
+	m_DependencyIndex = index;
+
+	return index;
+}
+
+/**
+ * Drops the dependency index after a dependency's redundancy group or time period changed.
+ */
+void Checkable::InvalidateDependencyIndex()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_DependencyMutex);
+		m_DependencyIndex = nullptr;
+	}
+
+	InvalidateReachability();
+}
+
+/**
+ * Whether the parents (recursively) allow the given type of dependency.
+ *
+ * The results are cached until InvalidateReachability() is called for this checkable,
+ * which happens if the state of a parent (or the service's host) changes, along the
+ * reverse dependencies.
+ */
 bool Checkable::IsReachable(DependencyType dt, Dependency::Ptr *failedDependency, int rstack) const
+{
+	Dependency::Ptr failed;
+	bool cacheable;
+	bool reachable = IsReachableCached(dt, failed, rstack, cacheable);
+
+	if (failedDependency)
+		*failedDependency = failed;
+
+	return reachable;
+}
+
+/**
+ * @param cacheable Set to whether the result stays valid until InvalidateReachability() is called for this checkable
+ */
+bool Checkable::IsReachable(DependencyType dt, bool& cacheable) const
+{
+	Dependency::Ptr failed;
+
+	return IsReachableCached(dt, failed, 0, cacheable);
+}
+
+/**
+ * @param cacheable Set to whether the result is cached, i.e. whether the callers may cache theirs, too
+ */
+bool Checkable::IsReachableCached(DependencyType dt, Dependency::Ptr& failedDependency, int rstack, bool& cacheable) const
+{
+	auto& cached (m_Reachability[dt]);
+	uint_fast64_t epoch;
+
+	{
+		std::unique_lock<std::mutex> lock (m_ReachabilityMutex);
+
+		if (cached.Valid) {
+			failedDependency = cached.FailedDependency;
+			cacheable = true;
+			return cached.Reachable;
+		}
+
+		epoch = m_ReachabilityEpoch;
+	}
+
+	cacheable = true;
+
+	bool reachable = EvaluateReachability(dt, failedDependency, rstack, cacheable);
+
+	if (cacheable) {
+		std::unique_lock<std::mutex> lock (m_ReachabilityMutex);
+
+		/* Invalidated while evaluating, the result may be based on outdated states. */
+		if (epoch == m_ReachabilityEpoch) {
+			cached.Valid = true;
+			cached.Reachable = reachable;
+			cached.FailedDependency = failedDependency;
+		} else {
+			cacheable = false;
+		}
+	}
+
+	return reachable;
+}
+
+bool Checkable::EvaluateReachability(DependencyType dt, Dependency::Ptr& failedDependency, int rstack, bool& cacheable) const
 {
 	/* Anything greater than 256 causes recursion bus errors. */
 	int limit = 256;
@@ -52,11 +197,19 @@ bool Checkable::IsReachable(DependencyType dt, Dependency::Ptr *failedDependency
 		Log(LogWarning, "Checkable")
 			<< "Too many nested dependencies (>" << limit << ") for checkable '" << GetName() << "': Dependency failed.";
 
+		cacheable = false;
 		return false;
 	}
 
-	for (const Checkable::Ptr& checkable : GetParents()) {
-		if (!checkable->IsReachable(dt, failedDependency, rstack + 1))
+	auto index (GetDependencyIndex());
+
+	for (const Checkable::Ptr& checkable : index->Parents) {
+		bool parentCacheable;
+		bool parentReachable = checkable->IsReachableCached(dt, failedDependency, rstack + 1, parentCacheable);
+
+		cacheable = cacheable && parentCacheable;
+
+		if (!parentReachable)
 			return false;
 	}
 
@@ -65,58 +218,132 @@ bool Checkable::IsReachable(DependencyType dt, Dependency::Ptr *failedDependency
 	if (service && (dt == DependencyState || dt == DependencyNotification)) {
 		Host::Ptr host = service->GetHost();
 
+		/* Inactive objects don't notify about state changes. */
+		if (host && !host->IsActive())
+			cacheable = false;
+
 		if (host && host->GetState() != HostUp && host->GetStateType() == StateTypeHard) {
-			if (failedDependency)
-				*failedDependency = nullptr;
+			failedDependency = nullptr;
 
 			return false;
 		}
 	}
 
-	auto deps = GetDependencies();
+	auto& entries (index->Entries);
+	size_t i = 0;
 
-	std::unordered_map<std::string, Dependency::Ptr> violated; // key: redundancy group, value: nullptr if satisfied, violating dependency otherwise
+	/* Time periods change without notice, inactive objects don't notify about changes either. */
+	auto updateCacheable ([&cacheable](const DependencyIndex::Entry& entry) {
+		if (entry.HasPeriod || !entry.Dep->IsActive() || (entry.Parent && !entry.Parent->IsActive()))
+			cacheable = false;
+	});
 
-	for (const Dependency::Ptr& dep : deps) {
-		std::string redundancy_group = dep->GetRedundancyGroup();
+	for (; i < entries.size() && entries[i].Group == DependencyIndex::NoGroup; i++) {
+		auto& entry (entries[i]);
 
-		if (!dep->IsAvailable(dt)) {
-			if (redundancy_group.empty()) {
-				Log(LogDebug, "Checkable")
-					<< "Non-redundant dependency '" << dep->GetName() << "' failed for checkable '" << GetName() << "': Marking as unreachable.";
+		updateCacheable(entry);
 
-				if (failedDependency)
-					*failedDependency = dep;
+		if (!entry.Dep->IsAvailable(dt)) {
+			Log(LogDebug, "Checkable")
+				<< "Non-redundant dependency '" << entry.Dep->GetName() << "' failed for checkable '" << GetName() << "': Marking as unreachable.";
 
-				return false;
-			}
+			failedDependency = entry.Dep;
 
-			// tentatively mark this dependency group as failed unless it is already marked;
-			//  so it either passed before (don't overwrite) or already failed (so don't care)
-			// note that std::unordered_map::insert() will not overwrite an existing entry
-			violated.insert(std::make_pair(redundancy_group, dep));
-		} else if (!redundancy_group.empty()) {
-			violated[redundancy_group] = nullptr;
+			return false;
 		}
 	}
 
-	auto violator = std::find_if(violated.begin(), violated.end(), [](auto& v) { return v.second != nullptr; });
-	if (violator != violated.end()) {
-		Log(LogDebug, "Checkable")
-			<< "All dependencies in redundancy group '" << violator->first << "' have failed for checkable '" << GetName() << "': Marking as unreachable.";
+	/* A redundancy group fails only if all of its dependencies fail. */
+	while (i < entries.size()) {
+		size_t group = entries[i].Group;
+		Dependency::Ptr violator;
+		bool satisfied = false;
 
-		if (failedDependency)
-			*failedDependency = violator->second;
+		for (; i < entries.size() && entries[i].Group == group; i++) {
+			auto& entry (entries[i]);
 
-		return false;
+			updateCacheable(entry);
+
+			if (satisfied)
+				continue;
+
+			if (entry.Dep->IsAvailable(dt))
+				satisfied = true;
+			else if (!violator)
+				violator = entry.Dep;
+		}
+
+		if (!satisfied) {
+			Log(LogDebug, "Checkable")
+				<< "All dependencies in redundancy group '" << index->Groups[group] << "' have failed for checkable '" << GetName() << "': Marking as unreachable.";
+
+			failedDependency = violator;
+
+			return false;
+		}
 	}
 
-	if (failedDependency)
-		*failedDependency = nullptr;
+	failedDependency = nullptr;
 
 	return true;
 }
 
+/**
+ * Drops the cached reachability of this checkable and, if there was any, of its children (recursively).
+ *
+ * Children without a cached reachability can't have descendants with one based on theirs.
+ */
+void Checkable::InvalidateReachability()
+{
+	bool wasCached = false;
+
+	{
+		std::unique_lock<std::mutex> lock (m_ReachabilityMutex);
+
+		m_ReachabilityEpoch++;
+
+		for (auto& cached : m_Reachability) {
+			wasCached = wasCached || cached.Valid;
+			cached = CachedReachability();
+		}
+	}
+
+	CIB::InvalidateCheckableStats(this);
+
+	if (wasCached) {
+		for (const Checkable::Ptr& child : GetChildren())
+			child->InvalidateReachability();
+	}
+}
+
+/**
+ * Invalidates the children's reachability if anything Dependency#IsAvailable() checks about this parent has changed.
+ */
+void Checkable::UpdateReachabilityInputs()
+{
+	int inputs = (GetLastCheckResult() ? 1 : 0) | (GetStateType() << 1) | (GetStateRaw() << 2);
+
+	{
+		std::unique_lock<std::mutex> lock (m_ReachabilityMutex);
+
+		if (inputs == m_ReachabilityInputs)
+			return;
+
+		m_ReachabilityInputs = inputs;
+	}
+
+	for (const Checkable::Ptr& child : GetChildren())
+		child->InvalidateReachability();
+
+	/* implicit dependency of the services on their host */
+	auto host (dynamic_cast<Host*>(this));
+
+	if (host) {
+		for (const Service::Ptr& service : host->GetServices())
+			service->InvalidateReachability();
+	}
+}
+
 std::set<Checkable::Ptr> Checkable::GetParents() const
 {
 	std::set<Checkable::Ptr> parents;
@@ -6,40 +6,58 @@
 
 using namespace icinga;
 
-template<typename T>
-struct Bitset
+/**
+ * Popcount and sum of the set bit positions for every byte, so weighing the 20 state changes
+ * takes three table lookups instead of one loop iteration per change.
+ */
+struct FlappingWeights
 {
-public:
-	Bitset(T value)
-		: m_Data(value)
-	{ }
+	unsigned char Count[256];
+	unsigned short PositionSum[256];
 
-	void Modify(int index, bool bit)
+	constexpr FlappingWeights()
+		: Count(), PositionSum()
 	{
-		if (bit)
-			m_Data |= 1 << index;
-		else
-			m_Data &= ~(1 << index);
+		for (int byte = 0; byte < 256; byte++) {
+			for (int bit = 0; bit < 8; bit++) {
+				if (byte & (1 << bit)) {
+					Count[byte]++;
+					PositionSum[byte] += bit;
+				}
+			}
+		}
 	}
+};
 
-	bool Get(int index) const
-	{
-		return m_Data & (1 << index);
-	}
+static constexpr FlappingWeights l_FlappingWeights;
 
-	T GetValue() const
-	{
-		return m_Data;
+/**
+ * The state change at position i (0 = oldest) weighs 0.8 + 0.02 * i of 20 changes, i.e. (40 + i) / 10 percent.
+ *
+ * @param changes The state changes, starting with the oldest one at bit 0
+ *
+ * @return The weighted percentage of state changes
+ */
+static double GetFlappingPercentage(unsigned long changes)
+{
+	unsigned int count = 0, positionSum = 0;
+
+	for (unsigned int offset = 0; offset < 24; offset += 8) {
+		auto byte ((changes >> offset) & 0xFF);
+
+		count += l_FlappingWeights.Count[byte];
+		positionSum += l_FlappingWeights.PositionSum[byte] + offset * l_FlappingWeights.Count[byte];
 	}
 
-private:
-	T m_Data{0};
-};
+	return (40.0 * count + positionSum) / 10.0;
+}
 
 void Checkable::UpdateFlappingStatus(ServiceState newState)
 {
-	Bitset<unsigned long> stateChangeBuf = GetFlappingBuffer();
-	int oldestIndex = GetFlappingIndex();
+	static const unsigned long bufferMask = (1ul << 20u) - 1u;
+
+	unsigned long stateChangeBuf = GetFlappingBuffer();
+	unsigned long oldestIndex = GetFlappingIndex() % 20;
 
 	ServiceState lastState = GetFlappingLastState();
 	bool stateChange = false;
@@ -49,21 +67,22 @@ void Checkable::UpdateFlappingStatus(ServiceState newState)
 	/* Only count as state change if no state filter is set or the new state isn't filtered out */
 	if (stateFilter == -1 || !(ServiceStateToFlappingFilter(newState) & stateFilter)) {
 		stateChange = newState != lastState;
-		SetFlappingLastState(newState);
-	}
 
-	stateChangeBuf.Modify(oldestIndex, stateChange);
-	oldestIndex = (oldestIndex + 1) % 20;
+		if (stateChange)
+			SetFlappingLastState(newState, true);
+	}
 
-	double stateChanges = 0;
+	if (stateChange)
+		stateChangeBuf |= 1ul << oldestIndex;
+	else
+		stateChangeBuf &= ~(1ul << oldestIndex);
 
-	/* Iterate over our state array and compute a weighted total */
-	for (int i = 0; i < 20; i++) {
-		if (stateChangeBuf.Get((oldestIndex + i) % 20))
-			stateChanges += 0.8 + (0.02 * i);
-	}
+	oldestIndex = (oldestIndex + 1) % 20;
 
-	double flappingValue = 100.0 * stateChanges / 20.0;
+	/* Rotate the ring buffer, so that the oldest state change is at bit 0 */
+	double flappingValue = GetFlappingPercentage(
+		((stateChangeBuf >> oldestIndex) | (stateChangeBuf << (20 - oldestIndex))) & bufferMask
+	);
 
 	bool flapping;
 
@@ -72,9 +91,16 @@ void Checkable::UpdateFlappingStatus(ServiceState newState)
 	else
 		flapping = flappingValue > GetFlappingThresholdHigh();
 
-	SetFlappingBuffer(stateChangeBuf.GetValue());
-	SetFlappingIndex(oldestIndex);
-	SetFlappingCurrent(flappingValue);
+	/* The buffer and index are internal, nobody needs to be notified of them. Most checkables
+	 * don't change their state at all, so their buffer and percentage stay the same.
+	 */
+	if (stateChangeBuf != static_cast<unsigned long>(GetFlappingBuffer()))
+		SetFlappingBuffer(stateChangeBuf, true);
+
+	SetFlappingIndex(oldestIndex, true);
+
+	if (flappingValue != GetFlappingCurrent())
+		SetFlappingCurrent(flappingValue);
 
 	if (flapping != GetFlapping()) {
 		SetFlapping(flapping, true);
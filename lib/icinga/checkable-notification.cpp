@@ -4,6 +4,7 @@
 #include "icinga/host.hpp"
 #include "icinga/icingaapplication.hpp"
 #include "icinga/service.hpp"
+#include "base/deadlinequeue.hpp"
 #include "base/dictionary.hpp"
 #include "base/objectlock.hpp"
 #include "base/logger.hpp"
@@ -12,9 +13,13 @@
 #include "base/convert.hpp"
 #include "base/lazy-init.hpp"
 #include "remote/apilistener.hpp"
+#include <boost/functional/hash.hpp>
 
 using namespace icinga;
 
+/* The checkables with suppressed notifications, see FireSuppressedNotificationsTimer(). */
+static DeadlineQueue<Checkable::Ptr, boost::hash<Checkable::Ptr>> l_SuppressedNotifications;
+
 boost::signals2::signal<void (const Notification::Ptr&, const Checkable::Ptr&, const std::set<User::Ptr>&,
 	const NotificationType&, const CheckResult::Ptr&, const String&, const String&,
 	const MessageOrigin::Ptr&)> Checkable::OnNotificationSentToAllUsers;
@@ -107,6 +112,9 @@ void Checkable::SendNotifications(NotificationType type, const CheckResult::Ptr&
 				{"author", author},
 				{"text", text}
 			}));
+
+			/* Modified in place, let the NotificationComponent know. */
+			notification->NotifyStashedNotifications();
 		}
 	}
 }
@@ -239,17 +247,31 @@ void Checkable::FireSuppressedNotifications()
 	}
 }
 
+/**
+ * Queues the checkable for FireSuppressedNotificationsTimer() while it has suppressed notifications.
+ * Once it is stopped, the next FireSuppressedNotificationsTimer() drops it.
+ */
+void Checkable::UpdateSuppressedNotificationsDeadline()
+{
+	if (GetSuppressedNotifications())
+		l_SuppressedNotifications.Set(this, Utility::GetTime());
+	else
+		l_SuppressedNotifications.Remove(this);
+}
+
 /**
  * Re-sends all notifications previously suppressed by e.g. downtimes if the notification reason still applies.
  */
 void Checkable::FireSuppressedNotificationsTimer(const Timer * const&)
 {
-	for (auto& host : ConfigType::GetObjectsByType<Host>()) {
-		host->FireSuppressedNotifications();
-	}
+	double now = Utility::GetTime();
+
+	for (auto& checkable : l_SuppressedNotifications.PopDue(now)) {
+		checkable->FireSuppressedNotifications();
 
-	for (auto& service : ConfigType::GetObjectsByType<Service>()) {
-		service->FireSuppressedNotifications();
+		/* Whether they may be sent depends on e.g. the next check, so try again until they're gone. */
+		if (checkable->IsActive() && checkable->GetSuppressedNotifications())
+			l_SuppressedNotifications.Set(checkable, now);
 	}
 }
 
@@ -2,12 +2,16 @@
 
 #include "icinga/checkable.hpp"
 #include "icinga/checkable-ti.cpp"
+#include "icinga/dependency.hpp"
 #include "icinga/host.hpp"
 #include "icinga/service.hpp"
+#include "remote/filterindex.hpp"
 #include "base/objectlock.hpp"
 #include "base/utility.hpp"
 #include "base/exception.hpp"
+#include "base/deadlinequeue.hpp"
 #include "base/timer.hpp"
+#include <boost/functional/hash.hpp>
 #include <boost/thread/once.hpp>
 
 using namespace icinga;
@@ -28,8 +32,12 @@ boost::signals2::signal<void (const Checkable::Ptr&, const String&, const String
 boost::signals2::signal<void (const Checkable::Ptr&, const String&, double, const MessageOrigin::Ptr&)> Checkable::OnAcknowledgementCleared;
 boost::signals2::signal<void (const Checkable::Ptr&, double)> Checkable::OnFlappingChange;
 
-static Timer::Ptr l_CheckablesFireSuppressedNotifications;
-static Timer::Ptr l_CleanDeadlinedExecutions;
+static Timer::Ptr l_CheckablesDeadlines;
+static Timer::Ptr l_FlushNewCheckResults;
+
+/* See ExpireAcknowledgements() and CleanDeadlinedExecutions(). */
+static DeadlineQueue<Checkable::Ptr, boost::hash<Checkable::Ptr>> l_AcknowledgementsExpiry;
+static DeadlineQueue<Checkable::Ptr, boost::hash<Checkable::Ptr>> l_ExecutionsDeadlines;
 
 thread_local std::function<void(const Value& commandLine, const ProcessResult&)> Checkable::ExecuteCommandProcessFinishedHandler;
 
@@ -41,6 +49,49 @@ void Checkable::StaticInitialize()
 	Downtime::OnDowntimeTriggered.connect([](const Downtime::Ptr& downtime) { Checkable::NotifyFlexibleDowntimeStart(downtime); });
 	/* fixed/flexible downtime end */
 	Downtime::OnDowntimeRemoved.connect([](const Downtime::Ptr& downtime) { Checkable::NotifyDowntimeEnd(downtime); });
+
+	Checkable::OnSuppressedNotificationsChanged.connect([](const Checkable::Ptr& checkable, const Value&) {
+		checkable->UpdateSuppressedNotificationsDeadline();
+	});
+
+	Checkable::OnExecutionsChanged.connect([](const Checkable::Ptr& checkable, const Value&) {
+		checkable->UpdateExecutionsDeadline();
+	});
+
+	/* attributes API filters commonly compare against */
+	for (const Type::Ptr& type : { Host::TypeInstance, Service::TypeInstance }) {
+		FilterIndex::Register(type, "state", { "state_raw" });
+		FilterIndex::Register(type, "state_type");
+		FilterIndex::Register(type, "acknowledgement");
+		FilterIndex::Register(type, "groups");
+	}
+
+	FilterIndex::Register(Service::TypeInstance, "host_name", {}, "host");
+
+	/* reachability cache */
+	for (auto changed : { &Checkable::OnStateRawChanged, &Checkable::OnStateTypeChanged, &Checkable::OnLastCheckResultChanged }) {
+		changed->connect([](const Checkable::Ptr& checkable, const Value&) { checkable->UpdateReachabilityInputs(); });
+	}
+
+	for (auto changed : { &Dependency::OnStateFilterChanged, &Dependency::OnIgnoreSoftStatesChanged,
+		&Dependency::OnDisableChecksChanged, &Dependency::OnDisableNotificationsChanged }) {
+		changed->connect([](const Dependency::Ptr& dependency, const Value&) {
+			Checkable::Ptr child = dependency->GetChild();
+
+			if (child)
+				child->InvalidateReachability();
+		});
+	}
+
+	/* dependency index */
+	for (auto changed : { &Dependency::OnPeriodRawChanged, &Dependency::OnRedundancyGroupChanged }) {
+		changed->connect([](const Dependency::Ptr& dependency, const Value&) {
+			Checkable::Ptr child = dependency->GetChild();
+
+			if (child)
+				child->InvalidateDependencyIndex();
+		});
+	}
 }
 
 Checkable::Checkable()
@@ -92,8 +143,13 @@ void Checkable::Start(bool runtimeCreated)
 
 	if (GetNextCheck() < now + 60) {
 		double delta = std::min(GetCheckInterval(), 60.0);
-		delta *= (double)std::rand() / RAND_MAX;
-		SetNextCheck(now + delta);
+
+		if (m_SpreadChecks.load(std::memory_order_relaxed)) {
+			SetNextCheck(SpreadNextCheck(now, now + delta));
+		} else {
+			delta *= (double)std::rand() / RAND_MAX;
+			SetNextCheck(now + delta);
+		}
 	}
 
 	ObjectImpl<Checkable>::Start(runtimeCreated);
@@ -101,16 +157,35 @@ void Checkable::Start(bool runtimeCreated)
 	static boost::once_flag once = BOOST_ONCE_INIT;
 
 	boost::call_once(once, []() {
-		l_CheckablesFireSuppressedNotifications = Timer::Create();
-		l_CheckablesFireSuppressedNotifications->SetInterval(5);
-		l_CheckablesFireSuppressedNotifications->OnTimerExpired.connect(&Checkable::FireSuppressedNotificationsTimer);
-		l_CheckablesFireSuppressedNotifications->Start();
-
-		l_CleanDeadlinedExecutions = Timer::Create();
-		l_CleanDeadlinedExecutions->SetInterval(300);
-		l_CleanDeadlinedExecutions->OnTimerExpired.connect(&Checkable::CleanDeadlinedExecutions);
-		l_CleanDeadlinedExecutions->Start();
+		/* Each of these only takes the checkables from its DeadlineQueue which are due. */
+		l_CheckablesDeadlines = Timer::Create();
+		l_CheckablesDeadlines->SetInterval(5);
+		l_CheckablesDeadlines->OnTimerExpired.connect(&Checkable::FireSuppressedNotificationsTimer);
+		l_CheckablesDeadlines->OnTimerExpired.connect(&Checkable::ExpireAcknowledgements);
+		l_CheckablesDeadlines->OnTimerExpired.connect(&Checkable::CleanDeadlinedExecutions);
+		l_CheckablesDeadlines->Start();
+
+		l_FlushNewCheckResults = Timer::Create();
+		l_FlushNewCheckResults->SetInterval(0.5);
+		l_FlushNewCheckResults->OnTimerExpired.connect(&Checkable::FlushNewCheckResultsTimer);
+		l_FlushNewCheckResults->Start();
 	});
+
+	/* e.g. restored from the state file */
+	UpdateSuppressedNotificationsDeadline();
+	UpdateAcknowledgementDeadline();
+	UpdateExecutionsDeadline();
+}
+
+void Checkable::Stop(bool runtimeRemoved)
+{
+	/* Stop the command endpoint from running the check on its own. */
+	UnscheduleRemoteCheck();
+
+	l_AcknowledgementsExpiry.Remove(this);
+	l_ExecutionsDeadlines.Remove(this);
+
+	ObjectImpl<Checkable>::Stop(runtimeRemoved);
 }
 
 void Checkable::AddGroup(const String& name)
@@ -159,6 +234,7 @@ void Checkable::AcknowledgeProblem(const String& author, const String& comment,
 {
 	SetAcknowledgementRaw(type);
 	SetAcknowledgementExpiry(expiry);
+	UpdateAcknowledgementDeadline();
 
 	if (notify && !IsPaused())
 		OnNotificationsRequested(this, NotificationAcknowledgement, GetLastCheckResult(), author, comment, nullptr);
@@ -179,6 +255,7 @@ void Checkable::ClearAcknowledgement(const String& removedBy, double changeTime,
 
 	SetAcknowledgementRaw(AcknowledgementNone);
 	SetAcknowledgementExpiry(0);
+	UpdateAcknowledgementDeadline();
 
 	Log(LogInformation, "Checkable")
 		<< "Acknowledgement cleared for checkable '" << GetName() << "'.";
@@ -290,33 +367,79 @@ void Checkable::ValidateMaxCheckAttempts(const Lazy<int>& lvalue, const Validati
 		BOOST_THROW_EXCEPTION(ValidationError(this, { "max_check_attempts" }, "Value must be greater than 0."));
 }
 
-void Checkable::CleanDeadlinedExecutions(const Timer * const&)
+/**
+ * Queues the checkable for ExpireAcknowledgements() if its acknowledgement expires.
+ */
+void Checkable::UpdateAcknowledgementDeadline()
 {
-	double now = Utility::GetTime();
-	Dictionary::Ptr executions;
-	Dictionary::Ptr execution;
+	double expiry = GetAcknowledgementExpiry();
 
-	for (auto& host : ConfigType::GetObjectsByType<Host>()) {
-		executions = host->GetExecutions();
-		if (executions) {
-			for (const String& key : executions->GetKeys()) {
-				execution = executions->Get(key);
-				if (execution->Contains("deadline") && now > execution->Get("deadline")) {
-					executions->Remove(key);
-				}
+	if (GetAcknowledgementRaw() != AcknowledgementNone && expiry != 0)
+		l_AcknowledgementsExpiry.Set(this, expiry);
+	else
+		l_AcknowledgementsExpiry.Remove(this);
+}
+
+/**
+ * Clears the acknowledgements which have expired, instead of waiting for the next GetAcknowledgement().
+ */
+void Checkable::ExpireAcknowledgements(const Timer * const&)
+{
+	for (auto& checkable : l_AcknowledgementsExpiry.PopDue(Utility::GetTime())) {
+		if (checkable->GetAcknowledgement() != AcknowledgementNone)
+			checkable->UpdateAcknowledgementDeadline();
+	}
+}
+
+/**
+ * Queues the checkable for CleanDeadlinedExecutions() at the earliest deadline of its executions.
+ */
+void Checkable::UpdateExecutionsDeadline()
+{
+	Dictionary::Ptr executions = GetExecutions();
+	double deadline = 0;
+
+	if (executions) {
+		ObjectLock olock (executions);
+
+		for (auto& kv : executions) {
+			if (!kv.second.IsObjectType<Dictionary>())
+				continue;
+
+			Value executionDeadline;
+
+			if (static_cast<Dictionary::Ptr>(kv.second)->Get("deadline", &executionDeadline)) {
+				double value = executionDeadline;
+
+				if (deadline == 0 || value < deadline)
+					deadline = value;
 			}
 		}
 	}
 
-	for (auto& service : ConfigType::GetObjectsByType<Service>()) {
-		executions = service->GetExecutions();
+	if (deadline != 0)
+		l_ExecutionsDeadlines.Set(this, deadline);
+	else
+		l_ExecutionsDeadlines.Remove(this);
+}
+
+void Checkable::CleanDeadlinedExecutions(const Timer * const&)
+{
+	double now = Utility::GetTime();
+
+	for (auto& checkable : l_ExecutionsDeadlines.PopDue(now)) {
+		Dictionary::Ptr executions = checkable->GetExecutions();
+
 		if (executions) {
 			for (const String& key : executions->GetKeys()) {
-				execution = executions->Get(key);
+				Dictionary::Ptr execution = executions->Get(key);
+
 				if (execution->Contains("deadline") && now > execution->Get("deadline")) {
 					executions->Remove(key);
 				}
 			}
 		}
+
+		checkable->UpdateExecutionsDeadline();
 	}
 }
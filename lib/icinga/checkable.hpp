@@ -6,6 +6,7 @@
 #include "base/atomic.hpp"
 #include "base/timer.hpp"
 #include "base/process.hpp"
+#include "base/signal.hpp"
 #include "icinga/i2-icinga.hpp"
 #include "icinga/checkable-ti.hpp"
 #include "icinga/timeperiod.hpp"
@@ -14,10 +15,14 @@
 #include "icinga/downtime.hpp"
 #include "remote/endpoint.hpp"
 #include "remote/messageorigin.hpp"
+#include <array>
+#include <atomic>
 #include <condition_variable>
 #include <cstdint>
 #include <functional>
 #include <limits>
+#include <memory>
+#include <vector>
 
 namespace icinga
 {
@@ -81,6 +86,8 @@ public:
 	void AddGroup(const String& name);
 
 	bool IsReachable(DependencyType dt = DependencyState, intrusive_ptr<Dependency> *failedDependency = nullptr, int rstack = 0) const;
+	bool IsReachable(DependencyType dt, bool& cacheable) const;
+	void InvalidateReachability();
 
 	AcknowledgementType GetAcknowledgement();
 
@@ -99,6 +106,8 @@ public:
 	long GetSchedulingOffset();
 	void SetSchedulingOffset(long offset);
 
+	static void SetSpreadChecks(bool spread);
+
 	void UpdateNextCheck(const MessageOrigin::Ptr& origin = nullptr);
 
 	bool HasBeenChecked() const;
@@ -112,6 +121,7 @@ public:
 
 	void ExecuteRemoteCheck(const Dictionary::Ptr& resolvedMacros = nullptr);
 	void ExecuteCheck();
+	bool IsCheckDelegated() const;
 	enum class ProcessingResult
 	{
 		Ok,
@@ -121,11 +131,22 @@ public:
 	};
 	ProcessingResult ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin = nullptr);
 
+	/**
+	 * An entry of OnNewCheckResults.
+	 */
+	struct NewCheckResult
+	{
+		Checkable::Ptr Target;
+		CheckResult::Ptr Result;
+		MessageOrigin::Ptr Origin;
+	};
+
 	Endpoint::Ptr GetCommandEndpoint() const;
 
-	static boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, const MessageOrigin::Ptr&)> OnNewCheckResult;
-	static boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, StateType, const MessageOrigin::Ptr&)> OnStateChange;
-	static boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, std::set<Checkable::Ptr>, const MessageOrigin::Ptr&)> OnReachabilityChanged;
+	static Signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, const MessageOrigin::Ptr&)> OnNewCheckResult;
+	static Signal<void (const std::vector<NewCheckResult>&)> OnNewCheckResults;
+	static Signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, StateType, const MessageOrigin::Ptr&)> OnStateChange;
+	static Signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, std::set<Checkable::Ptr>, const MessageOrigin::Ptr&)> OnReachabilityChanged;
 	static boost::signals2::signal<void (const Checkable::Ptr&, NotificationType, const CheckResult::Ptr&,
 		const String&, const String&, const MessageOrigin::Ptr&)> OnNotificationsRequested;
 	static boost::signals2::signal<void (const Notification::Ptr&, const Checkable::Ptr&, const User::Ptr&,
@@ -210,6 +231,7 @@ public:
 
 protected:
 	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
 	void OnConfigLoaded() override;
 	void OnAllConfigLoaded() override;
 
@@ -218,10 +240,32 @@ private:
 	bool m_CheckRunning{false};
 	long m_SchedulingOffset;
 
+	static std::atomic<bool> m_SpreadChecks;
+
+	static double SpreadNextCheck(double earliest, double latest);
+
+	/* The command endpoint which schedules the check itself, see ExecuteCheck(). Protected by m_CheckableMutex. */
+	Endpoint::Ptr m_DelegatedCheckEndpoint;
+	double m_DelegatedCheckInterval{0};
+	size_t m_DelegatedCheckHash{0}; /* of HashRemoteCheckDefinition() */
+
+	double GetEffectiveCheckInterval() const;
+	bool CanRunDelegatedCheck();
+	Dictionary::Ptr MakeRemoteCheckParams(const CheckResult::Ptr& cr);
+	size_t HashRemoteCheckDefinition();
+	bool HasDelegatedCheckChanged(size_t hash);
+	Dictionary::Ptr MakeScheduleCheckMessage(double interval);
+	void UnscheduleRemoteCheck();
+
 	static std::mutex m_StatsMutex;
 	static int m_PendingChecks;
 	static std::condition_variable m_PendingChecksCV;
 
+	static std::mutex m_NewCheckResultsMutex;
+	static std::vector<NewCheckResult> m_NewCheckResults;
+
+	static void QueueNewCheckResult(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin);
+
 	/* Downtimes */
 	std::set<Downtime::Ptr> m_Downtimes;
 	mutable std::mutex m_DowntimeMutex;
@@ -232,8 +276,14 @@ private:
 
 	static void NotifyDowntimeEnd(const Downtime::Ptr& downtime);
 
+	void UpdateSuppressedNotificationsDeadline();
+	void UpdateAcknowledgementDeadline();
+	void UpdateExecutionsDeadline();
+
 	static void FireSuppressedNotificationsTimer(const Timer * const&);
+	static void ExpireAcknowledgements(const Timer * const&);
 	static void CleanDeadlinedExecutions(const Timer * const&);
+	static void FlushNewCheckResultsTimer(const Timer * const&);
 
 	/* Comments */
 	std::set<Comment::Ptr> m_Comments;
@@ -248,8 +298,48 @@ private:
 	std::set<intrusive_ptr<Dependency> > m_Dependencies;
 	std::set<intrusive_ptr<Dependency> > m_ReverseDependencies;
 
+	/* What EvaluateReachability() needs to know about the dependencies, built on demand */
+	struct DependencyIndex
+	{
+		struct Entry
+		{
+			intrusive_ptr<Dependency> Dep;
+			Checkable::Ptr Parent;
+			size_t Group; /**< Index into Groups, NoGroup for non-redundant dependencies */
+			bool HasPeriod;
+		};
+
+		static constexpr size_t NoGroup = -1;
+
+		std::vector<Entry> Entries; /**< The non-redundant ones first, then grouped by redundancy group */
+		std::vector<String> Groups;
+		std::vector<Checkable::Ptr> Parents; /**< Like GetParents() */
+	};
+
+	mutable std::shared_ptr<const DependencyIndex> m_DependencyIndex; /**< Protected by m_DependencyMutex */
+
+	std::shared_ptr<const DependencyIndex> GetDependencyIndex() const;
+	void InvalidateDependencyIndex();
+
 	void GetAllChildrenInternal(std::set<Checkable::Ptr>& children, int level = 0) const;
 
+	/* Reachability cache */
+	struct CachedReachability
+	{
+		bool Valid{false};
+		bool Reachable{false};
+		intrusive_ptr<Dependency> FailedDependency;
+	};
+
+	mutable std::mutex m_ReachabilityMutex;
+	mutable std::array<CachedReachability, 3> m_Reachability; /**< Indexed by DependencyType */
+	uint_fast64_t m_ReachabilityEpoch{0}; /**< Incremented by every invalidation */
+	int m_ReachabilityInputs{-1}; /**< What the children's reachability depends on, see UpdateReachabilityInputs() */
+
+	bool IsReachableCached(DependencyType dt, intrusive_ptr<Dependency>& failedDependency, int rstack, bool& cacheable) const;
+	bool EvaluateReachability(DependencyType dt, intrusive_ptr<Dependency>& failedDependency, int rstack, bool& cacheable) const;
+	void UpdateReachabilityInputs();
+
 	/* Flapping */
 	static const std::map<String, int> m_FlappingStateFilterMap;
 
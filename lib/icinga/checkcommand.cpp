@@ -3,6 +3,7 @@
 #include "icinga/checkcommand.hpp"
 #include "icinga/checkcommand-ti.cpp"
 #include "base/configtype.hpp"
+#include "base/exception.hpp"
 
 using namespace icinga;
 
@@ -20,3 +21,11 @@ void CheckCommand::Execute(const Checkable::Ptr& checkable, const CheckResult::P
 		useResolvedMacros
 	});
 }
+
+void CheckCommand::ValidateMaxOutputLength(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<CheckCommand>::ValidateMaxOutputLength(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "max_output_length" }, "Must not be negative."));
+}
@@ -25,6 +25,8 @@ public:
 	void Execute(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr,
 		const Dictionary::Ptr& resolvedMacros = nullptr,
 		bool useResolvedMacros = false);
+
+	void ValidateMaxOutputLength(const Lazy<int>& lvalue, const ValidationUtils& utils) final;
 };
 
 }
@@ -5,6 +5,7 @@
 
 #include "icinga/i2-icinga.hpp"
 #include "icinga/checkresult-ti.hpp"
+#include "base/objectpool.hpp"
 
 namespace icinga
 {
@@ -18,6 +19,7 @@ class CheckResult final : public ObjectImpl<CheckResult>
 {
 public:
 	DECLARE_OBJECT(CheckResult);
+	DECLARE_POOLED_ALLOCATION();
 
 	double CalculateExecutionTime() const;
 	double CalculateLatency() const;
@@ -4,19 +4,29 @@
 #include "icinga/host.hpp"
 #include "icinga/service.hpp"
 #include "icinga/clusterevents.hpp"
+#include "icinga/downtime.hpp"
+#include "icinga/icingaapplication.hpp"
 #include "base/application.hpp"
 #include "base/objectlock.hpp"
+#include "base/objectpool.hpp"
 #include "base/utility.hpp"
 #include "base/perfdatavalue.hpp"
+#include "base/signalprofiler.hpp"
 #include "base/configtype.hpp"
 #include "base/statsfunction.hpp"
+#include "base/initialize.hpp"
+#include <bitset>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace icinga;
 
-RingBuffer CIB::m_ActiveHostChecksStatistics(15 * 60);
-RingBuffer CIB::m_ActiveServiceChecksStatistics(15 * 60);
-RingBuffer CIB::m_PassiveHostChecksStatistics(15 * 60);
-RingBuffer CIB::m_PassiveServiceChecksStatistics(15 * 60);
+ShardedRingBuffer CIB::m_ActiveHostChecksStatistics(15 * 60);
+ShardedRingBuffer CIB::m_ActiveServiceChecksStatistics(15 * 60);
+ShardedRingBuffer CIB::m_PassiveHostChecksStatistics(15 * 60);
+ShardedRingBuffer CIB::m_PassiveServiceChecksStatistics(15 * 60);
+std::array<Histogram, (size_t)CheckStage::Count> CIB::m_CheckStages;
 
 void CIB::UpdateActiveHostChecksStatistics(long tv, int num)
 {
@@ -58,198 +68,357 @@ int CIB::GetPassiveServiceChecksStatistics(long timespan)
 	return m_PassiveServiceChecksStatistics.UpdateAndGetValues(Utility::GetTime(), timespan);
 }
 
-CheckableCheckStatistics CIB::CalculateHostCheckStats()
+/**
+ * The statistics counters a checkable can contribute to. The first ones are indexed by state.
+ */
+enum CheckableStatsCounter
+{
+	CheckableStatsOk = 0, /**< Up for hosts (which are counted by state only if reachable) */
+	CheckableStatsWarning = 1, /**< Down for hosts */
+	CheckableStatsCritical = 2,
+	CheckableStatsUnknown = 3,
+	CheckableStatsPending,
+	CheckableStatsUnreachable,
+	CheckableStatsFlapping,
+	CheckableStatsInDowntime,
+	CheckableStatsAcknowledged,
+	CheckableStatsHandled,
+	CheckableStatsProblem,
+	CheckableStatsCount
+};
+
+/**
+ * What a checkable currently contributes to the statistics of its type.
+ */
+struct CheckableStatsEntry
+{
+	Checkable::Ptr Object;
+	std::bitset<CheckableStatsCount> Counters;
+	bool HasCheckResult{false};
+	double Latency{0};
+	double ExecutionTime{0};
+	bool Volatile{false}; /**< May change without any signal, e.g. by a downtime's end time passing */
+};
+
+/**
+ * The sums of all entries of hosts respectively services.
+ */
+struct CheckableStatsTotals
 {
-	double min_latency = -1, max_latency = 0, sum_latency = 0;
-	int count_latency = 0;
-	double min_execution_time = -1, max_execution_time = 0, sum_execution_time = 0;
-	int count_execution_time = 0;
-	bool checkresult = false;
+	std::array<double, CheckableStatsCount> Counters{};
+	int CheckResults{0};
+	double LatencySum{0};
+	double ExecutionTimeSum{0};
+	std::multiset<double> Latencies;
+	std::multiset<double> ExecutionTimes;
+
+	void Add(const CheckableStatsEntry& entry)
+	{
+		for (size_t i = 0; i < CheckableStatsCount; i++) {
+			if (entry.Counters[i])
+				Counters[i]++;
+		}
+
+		if (entry.HasCheckResult) {
+			CheckResults++;
+			LatencySum += entry.Latency;
+			ExecutionTimeSum += entry.ExecutionTime;
+			Latencies.insert(entry.Latency);
+			ExecutionTimes.insert(entry.ExecutionTime);
+		}
+	}
 
-	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
-		ObjectLock olock(host);
+	void Remove(const CheckableStatsEntry& entry)
+	{
+		for (size_t i = 0; i < CheckableStatsCount; i++) {
+			if (entry.Counters[i])
+				Counters[i]--;
+		}
+
+		if (entry.HasCheckResult) {
+			CheckResults--;
+			LatencySum -= entry.Latency;
+			ExecutionTimeSum -= entry.ExecutionTime;
+			Latencies.erase(Latencies.find(entry.Latency));
+			ExecutionTimes.erase(ExecutionTimes.find(entry.ExecutionTime));
+		}
+	}
+};
 
-		CheckResult::Ptr cr = host->GetLastCheckResult();
+/* Only the dirty checkables are locked by the signal handlers, which may run while the statistics are being refreshed. */
+static std::mutex l_DirtyCheckablesMutex;
+static std::unordered_map<Checkable*, Checkable::Ptr> l_DirtyCheckables;
+static bool l_AllCheckablesDirty = true;
 
-		if (!cr)
-			continue;
+static std::mutex l_CheckableStatsMutex;
+static std::unordered_map<Checkable*, CheckableStatsEntry> l_CheckableStats;
+static std::unordered_set<Checkable*> l_VolatileCheckables;
+static CheckableStatsTotals l_HostStatsTotals;
+static CheckableStatsTotals l_ServiceStatsTotals;
 
-		/* set to true, we have a checkresult */
-		checkresult = true;
+static void InvalidateAllCheckableStats()
+{
+	std::unique_lock<std::mutex> lock (l_DirtyCheckablesMutex);
+	l_AllCheckablesDirty = true;
+}
 
-		/* latency */
-		double latency = cr->CalculateLatency();
+INITIALIZE_ONCE([]() {
+	for (auto changed : { &Checkable::OnStateRawChanged, &Checkable::OnLastCheckResultChanged, &Checkable::OnAcknowledgementRawChanged,
+		&Checkable::OnAcknowledgementExpiryChanged, &Checkable::OnEnableFlappingChanged }) {
+		changed->connect([](const Checkable::Ptr& checkable, const Value&) { CIB::InvalidateCheckableStats(checkable); });
+	}
+
+	/* SetFlapping() doesn't notify */
+	Checkable::OnFlappingChange.connect([](const Checkable::Ptr& checkable, double) { CIB::InvalidateCheckableStats(checkable); });
+
+	for (auto changed : { &Downtime::OnDowntimeAdded, &Downtime::OnDowntimeRemoved, &Downtime::OnDowntimeStarted, &Downtime::OnDowntimeTriggered }) {
+		changed->connect([](const Downtime::Ptr& downtime) {
+			Checkable::Ptr checkable = downtime->GetCheckable();
+
+			if (checkable)
+				CIB::InvalidateCheckableStats(checkable);
+		});
+	}
 
-		if (min_latency == -1 || latency < min_latency)
-			min_latency = latency;
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+		auto checkable (dynamic_pointer_cast<Checkable>(object));
+
+		if (checkable)
+			CIB::InvalidateCheckableStats(checkable);
+	});
+
+	IcingaApplication::OnEnableFlappingChanged.connect([](const IcingaApplication::Ptr&, const Value&) { InvalidateAllCheckableStats(); });
+});
+
+/**
+ * Makes the next statistics query re-evaluate what the checkable contributes.
+ */
+void CIB::InvalidateCheckableStats(const Checkable::Ptr& checkable)
+{
+	std::unique_lock<std::mutex> lock (l_DirtyCheckablesMutex);
 
-		if (latency > max_latency)
-			max_latency = latency;
+	if (!l_AllCheckablesDirty)
+		l_DirtyCheckables.emplace(checkable.get(), checkable);
+}
 
-		sum_latency += latency;
-		count_latency++;
+static CheckableStatsEntry GetCheckableStatsEntry(const Checkable::Ptr& checkable)
+{
+	CheckableStatsEntry entry;
+	bool reachabilityCacheable;
+	bool reachable = checkable->IsReachable(DependencyState, reachabilityCacheable);
+	CheckResult::Ptr cr = checkable->GetLastCheckResult();
 
-		/* execution_time */
-		double execution_time = cr->CalculateExecutionTime();
+	entry.Object = checkable;
 
-		if (min_execution_time == -1 || execution_time < min_execution_time)
-			min_execution_time = execution_time;
+	auto host (dynamic_cast<Host*>(checkable.get()));
 
-		if (execution_time > max_execution_time)
-			max_execution_time = execution_time;
+	if (host) {
+		if (reachable)
+			entry.Counters.set(host->GetState());
+		else
+			entry.Counters.set(CheckableStatsUnreachable);
+	} else {
+		entry.Counters.set(static_cast<Service*>(checkable.get())->GetState());
 
-		sum_execution_time += execution_time;
-		count_execution_time++;
+		if (!reachable)
+			entry.Counters.set(CheckableStatsUnreachable);
 	}
 
-	if (!checkresult) {
-		min_latency = 0;
-		min_execution_time = 0;
+	if (cr) {
+		entry.HasCheckResult = true;
+		entry.Latency = cr->CalculateLatency();
+		entry.ExecutionTime = cr->CalculateExecutionTime();
+	} else {
+		entry.Counters.set(CheckableStatsPending);
 	}
 
-	CheckableCheckStatistics ccs;
+	bool inDowntime = checkable->IsInDowntime();
 
-	ccs.min_latency = min_latency;
-	ccs.max_latency = max_latency;
-	ccs.avg_latency = sum_latency / count_latency;
-	ccs.min_execution_time = min_execution_time;
-	ccs.max_execution_time = max_execution_time;
-	ccs.avg_execution_time = sum_execution_time / count_execution_time;
+	entry.Counters.set(CheckableStatsFlapping, checkable->IsFlapping());
+	entry.Counters.set(CheckableStatsInDowntime, inDowntime);
+	entry.Counters.set(CheckableStatsAcknowledged, checkable->IsAcknowledged());
+	entry.Counters.set(CheckableStatsHandled, checkable->GetHandled());
+	entry.Counters.set(CheckableStatsProblem, checkable->GetProblem());
 
-	return ccs;
+	/* Downtimes start and end, acknowledgements expire and dependency periods change over time. */
+	entry.Volatile = !reachabilityCacheable || inDowntime || !checkable->GetDowntimes().empty()
+		|| (checkable->GetAcknowledgementRaw() != AcknowledgementNone && checkable->GetAcknowledgementExpiry() != 0);
+
+	return entry;
 }
 
-CheckableCheckStatistics CIB::CalculateServiceCheckStats()
+/**
+ * Re-evaluates a checkable's contribution.
+ *
+ * @return Whether the problem counter has changed
+ */
+static bool UpdateCheckableStatsEntry(Checkable* key, const Checkable::Ptr& checkable)
 {
-	double min_latency = -1, max_latency = 0, sum_latency = 0;
-	int count_latency = 0;
-	double min_execution_time = -1, max_execution_time = 0, sum_execution_time = 0;
-	int count_execution_time = 0;
-	bool checkresult = false;
+	auto& totals (dynamic_cast<Host*>(key) ? l_HostStatsTotals : l_ServiceStatsTotals);
+	auto current (l_CheckableStats.find(key));
+	bool wasProblem = false;
 
-	for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>()) {
-		ObjectLock olock(service);
+	if (current != l_CheckableStats.end()) {
+		wasProblem = current->second.Counters[CheckableStatsProblem];
 
-		CheckResult::Ptr cr = service->GetLastCheckResult();
+		totals.Remove(current->second);
+		l_VolatileCheckables.erase(key);
+		l_CheckableStats.erase(current);
+	}
 
-		if (!cr)
-			continue;
+	if (!checkable->IsActive())
+		return wasProblem;
 
-		/* set to true, we have a checkresult */
-		checkresult = true;
+	auto entry (GetCheckableStatsEntry(checkable));
+	bool isProblem = entry.Counters[CheckableStatsProblem];
 
-		/* latency */
-		double latency = cr->CalculateLatency();
+	totals.Add(entry);
 
-		if (min_latency == -1 || latency < min_latency)
-			min_latency = latency;
+	if (entry.Volatile)
+		l_VolatileCheckables.emplace(key);
 
-		if (latency > max_latency)
-			max_latency = latency;
+	l_CheckableStats.emplace(key, std::move(entry));
 
-		sum_latency += latency;
-		count_latency++;
+	return isProblem != wasProblem;
+}
 
-		/* execution_time */
-		double execution_time = cr->CalculateExecutionTime();
+/**
+ * Brings the totals up to date with the checkables changed since the last call, see InvalidateCheckableStats().
+ *
+ * l_CheckableStatsMutex must be held.
+ */
+static void RefreshCheckableStats()
+{
+	std::unordered_map<Checkable*, Checkable::Ptr> dirty;
+	bool all;
+
+	{
+		std::unique_lock<std::mutex> lock (l_DirtyCheckablesMutex);
 
-		if (min_execution_time == -1 || execution_time < min_execution_time)
-			min_execution_time = execution_time;
+		dirty.swap(l_DirtyCheckables);
+		all = l_AllCheckablesDirty;
+		l_AllCheckablesDirty = false;
+	}
 
-		if (execution_time > max_execution_time)
-			max_execution_time = execution_time;
+	if (all) {
+		for (auto& entry : l_CheckableStats)
+			dirty.emplace(entry.first, entry.second.Object);
 
-		sum_execution_time += execution_time;
-		count_execution_time++;
+		for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>())
+			dirty.emplace(host.get(), host);
+
+		for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>())
+			dirty.emplace(service.get(), service);
 	}
 
-	if (!checkresult) {
-		min_latency = 0;
-		min_execution_time = 0;
+	for (auto checkable : l_VolatileCheckables)
+		dirty.emplace(checkable, l_CheckableStats[checkable].Object);
+
+	/* The services count as handled while their host has a problem, so the hosts go first. */
+	std::vector<std::pair<Checkable*, Checkable::Ptr>> services;
+
+	for (auto& checkable : dirty) {
+		auto host (dynamic_cast<Host*>(checkable.first));
+
+		if (!host) {
+			services.emplace_back(checkable);
+			continue;
+		}
+
+		if (UpdateCheckableStatsEntry(checkable.first, checkable.second)) {
+			for (const Service::Ptr& service : host->GetServices()) {
+				if (!dirty.count(service.get()))
+					services.emplace_back(service.get(), service);
+			}
+		}
 	}
 
+	for (auto& checkable : services)
+		UpdateCheckableStatsEntry(checkable.first, checkable.second);
+}
+
+static CheckableCheckStatistics GetCheckStats(const CheckableStatsTotals& totals)
+{
 	CheckableCheckStatistics ccs;
 
-	ccs.min_latency = min_latency;
-	ccs.max_latency = max_latency;
-	ccs.avg_latency = sum_latency / count_latency;
-	ccs.min_execution_time = min_execution_time;
-	ccs.max_execution_time = max_execution_time;
-	ccs.avg_execution_time = sum_execution_time / count_execution_time;
+	if (totals.CheckResults) {
+		ccs.min_latency = *totals.Latencies.begin();
+		ccs.max_latency = *totals.Latencies.rbegin();
+		ccs.min_execution_time = *totals.ExecutionTimes.begin();
+		ccs.max_execution_time = *totals.ExecutionTimes.rbegin();
+	} else {
+		ccs.min_latency = 0;
+		ccs.max_latency = 0;
+		ccs.min_execution_time = 0;
+		ccs.max_execution_time = 0;
+	}
+
+	ccs.avg_latency = totals.LatencySum / totals.CheckResults;
+	ccs.avg_execution_time = totals.ExecutionTimeSum / totals.CheckResults;
 
 	return ccs;
 }
 
+CheckableCheckStatistics CIB::CalculateHostCheckStats()
+{
+	std::unique_lock<std::mutex> lock (l_CheckableStatsMutex);
+
+	RefreshCheckableStats();
+
+	return GetCheckStats(l_HostStatsTotals);
+}
+
+CheckableCheckStatistics CIB::CalculateServiceCheckStats()
+{
+	std::unique_lock<std::mutex> lock (l_CheckableStatsMutex);
+
+	RefreshCheckableStats();
+
+	return GetCheckStats(l_ServiceStatsTotals);
+}
+
 ServiceStatistics CIB::CalculateServiceStats()
 {
-	ServiceStatistics ss = {};
-
-	for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>()) {
-		ObjectLock olock(service);
-
-		if (service->GetState() == ServiceOK)
-			ss.services_ok++;
-		if (service->GetState() == ServiceWarning)
-			ss.services_warning++;
-		if (service->GetState() == ServiceCritical)
-			ss.services_critical++;
-		if (service->GetState() == ServiceUnknown)
-			ss.services_unknown++;
-
-		CheckResult::Ptr cr = service->GetLastCheckResult();
-
-		if (!cr)
-			ss.services_pending++;
-
-		if (!service->IsReachable())
-			ss.services_unreachable++;
-
-		if (service->IsFlapping())
-			ss.services_flapping++;
-		if (service->IsInDowntime())
-			ss.services_in_downtime++;
-		if (service->IsAcknowledged())
-			ss.services_acknowledged++;
-
-		if (service->GetHandled())
-			ss.services_handled++;
-		if (service->GetProblem())
-			ss.services_problem++;
-	}
+	std::unique_lock<std::mutex> lock (l_CheckableStatsMutex);
+
+	RefreshCheckableStats();
+
+	auto& counters (l_ServiceStatsTotals.Counters);
+	ServiceStatistics ss;
+
+	ss.services_ok = counters[CheckableStatsOk];
+	ss.services_warning = counters[CheckableStatsWarning];
+	ss.services_critical = counters[CheckableStatsCritical];
+	ss.services_unknown = counters[CheckableStatsUnknown];
+	ss.services_pending = counters[CheckableStatsPending];
+	ss.services_unreachable = counters[CheckableStatsUnreachable];
+	ss.services_flapping = counters[CheckableStatsFlapping];
+	ss.services_in_downtime = counters[CheckableStatsInDowntime];
+	ss.services_acknowledged = counters[CheckableStatsAcknowledged];
+	ss.services_handled = counters[CheckableStatsHandled];
+	ss.services_problem = counters[CheckableStatsProblem];
 
 	return ss;
 }
 
 HostStatistics CIB::CalculateHostStats()
 {
-	HostStatistics hs = {};
-
-	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
-		ObjectLock olock(host);
-
-		if (host->IsReachable()) {
-			if (host->GetState() == HostUp)
-				hs.hosts_up++;
-			if (host->GetState() == HostDown)
-				hs.hosts_down++;
-		} else
-			hs.hosts_unreachable++;
-
-		if (!host->GetLastCheckResult())
-			hs.hosts_pending++;
-
-		if (host->IsFlapping())
-			hs.hosts_flapping++;
-		if (host->IsInDowntime())
-			hs.hosts_in_downtime++;
-		if (host->IsAcknowledged())
-			hs.hosts_acknowledged++;
-
-		if (host->GetHandled())
-			hs.hosts_handled++;
-		if (host->GetProblem())
-			hs.hosts_problem++;
-	}
+	std::unique_lock<std::mutex> lock (l_CheckableStatsMutex);
+
+	RefreshCheckableStats();
+
+	auto& counters (l_HostStatsTotals.Counters);
+	HostStatistics hs;
+
+	hs.hosts_up = counters[CheckableStatsOk];
+	hs.hosts_down = counters[CheckableStatsWarning];
+	hs.hosts_unreachable = counters[CheckableStatsUnreachable];
+	hs.hosts_pending = counters[CheckableStatsPending];
+	hs.hosts_flapping = counters[CheckableStatsFlapping];
+	hs.hosts_in_downtime = counters[CheckableStatsInDowntime];
+	hs.hosts_acknowledged = counters[CheckableStatsAcknowledged];
+	hs.hosts_handled = counters[CheckableStatsHandled];
+	hs.hosts_problem = counters[CheckableStatsProblem];
 
 	return hs;
 }
@@ -275,6 +444,61 @@ std::pair<Dictionary::Ptr, Array::Ptr> CIB::GetFeatureStats()
 	return std::make_pair(status, perfdata);
 }
 
+/**
+ * Adds the duration of a plugin check stage to its histogram.
+ */
+void CIB::RecordCheckStage(CheckStage stage, double seconds)
+{
+	auto us (seconds * 1000000.0);
+
+	m_CheckStages[(size_t)stage].Record(us > 0 ? (Histogram::ValueType)us : 0);
+}
+
+const char *CIB::GetCheckStageName(CheckStage stage)
+{
+	switch (stage) {
+		case CheckStage::Prepare:
+			return "prepare";
+		case CheckStage::SpawnQueue:
+			return "spawn_queue";
+		case CheckStage::Spawn:
+			return "spawn";
+		case CheckStage::Plugin:
+			return "plugin";
+		case CheckStage::Reap:
+			return "reap";
+		case CheckStage::CallbackQueue:
+			return "callback_queue";
+		case CheckStage::Processing:
+			return "processing";
+		default:
+			VERIFY(!"Invalid check stage.");
+	}
+}
+
+/**
+ * @return Count, mean, percentiles and maximum (in seconds) per plugin check stage
+ */
+Dictionary::Ptr CIB::GetCheckStageStats()
+{
+	Dictionary::Ptr stats = new Dictionary();
+
+	for (size_t i = 0; i < (size_t)CheckStage::Count; i++) {
+		auto& histogram (m_CheckStages[i]);
+
+		stats->Set(GetCheckStageName((CheckStage)i), new Dictionary({
+			{ "count", histogram.GetCount() },
+			{ "mean", histogram.GetMean() / 1000000.0 },
+			{ "p50", histogram.GetPercentile(50) / 1000000.0 },
+			{ "p90", histogram.GetPercentile(90) / 1000000.0 },
+			{ "p99", histogram.GetPercentile(99) / 1000000.0 },
+			{ "max", histogram.GetMax() / 1000000.0 }
+		}));
+	}
+
+	return stats;
+}
+
 REGISTER_STATSFUNCTION(CIB, &CIB::StatsFunc);
 
 void CIB::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata) {
@@ -304,8 +528,18 @@ void CIB::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata) {
 	// Checker related stats
 	status->Set("remote_check_queue", ClusterEvents::GetCheckRequestQueueSize());
 	status->Set("current_pending_callbacks", Application::GetTP().GetPending());
+	status->Set("stolen_callbacks", Application::GetTP().GetSteals());
 	status->Set("current_concurrent_checks", Checkable::CurrentConcurrentChecks.load());
 
+	// Allocator related stats
+	status->Set("object_pool_allocations", ObjectPool::GetAllocations());
+	status->Set("object_pool_hits", ObjectPool::GetHits());
+	status->Set("object_pool_cached_bytes", ObjectPool::GetCachedBytes());
+
+	// Signal handler profiling (ProfileSignalHandlers)
+	if (SignalProfiler::IsEnabled())
+		status->Set("signal_handlers", SignalProfiler::GetStats());
+
 	CheckableCheckStatistics scs = CalculateServiceCheckStats();
 
 	status->Set("min_latency", scs.min_latency);
@@ -315,6 +549,8 @@ void CIB::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata) {
 	status->Set("max_execution_time", scs.max_execution_time);
 	status->Set("avg_execution_time", scs.avg_execution_time);
 
+	status->Set("check_stages", GetCheckStageStats());
+
 	ServiceStatistics ss = CalculateServiceStats();
 
 	status->Set("num_services_ok", ss.services_ok);
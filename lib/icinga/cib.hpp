@@ -7,10 +7,13 @@
 #include "base/ringbuffer.hpp"
 #include "base/dictionary.hpp"
 #include "base/array.hpp"
+#include "base/histogram.hpp"
 
 namespace icinga
 {
 
+class Checkable;
+
 struct CheckableCheckStatistics {
 	double min_latency;
 	double max_latency;
@@ -46,6 +49,21 @@ struct HostStatistics {
 	double hosts_problem;
 };
 
+/**
+ * Stages of a plugin check, see CIB::RecordCheckStage().
+ */
+enum class CheckStage
+{
+	Prepare, // Check started until the process is started, mostly macro resolution.
+	SpawnQueue, // Waiting for the spawn helper.
+	Spawn, // Fork and exec by the spawn helper.
+	Plugin, // Process started until it closed its output.
+	Reap, // Output closed until the process was waited for.
+	CallbackQueue, // Waiting for the result handler to be run by the thread pool.
+	Processing, // Checkable::ProcessCheckResult().
+	Count
+};
+
 /**
  * Common Information Base class. Holds some statistics (and will likely be
  * removed/refactored).
@@ -71,19 +89,25 @@ public:
 	static CheckableCheckStatistics CalculateServiceCheckStats();
 	static HostStatistics CalculateHostStats();
 	static ServiceStatistics CalculateServiceStats();
+	static void InvalidateCheckableStats(const intrusive_ptr<Checkable>& checkable);
 
 	static std::pair<Dictionary::Ptr, Array::Ptr> GetFeatureStats();
 
+	static void RecordCheckStage(CheckStage stage, double seconds);
+	static const char *GetCheckStageName(CheckStage stage);
+	static Dictionary::Ptr GetCheckStageStats();
+
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
 private:
 	CIB();
 
 	static std::mutex m_Mutex;
-	static RingBuffer m_ActiveHostChecksStatistics;
-	static RingBuffer m_PassiveHostChecksStatistics;
-	static RingBuffer m_ActiveServiceChecksStatistics;
-	static RingBuffer m_PassiveServiceChecksStatistics;
+	static ShardedRingBuffer m_ActiveHostChecksStatistics;
+	static ShardedRingBuffer m_PassiveHostChecksStatistics;
+	static ShardedRingBuffer m_ActiveServiceChecksStatistics;
+	static ShardedRingBuffer m_PassiveServiceChecksStatistics;
+	static std::array<Histogram, (size_t)CheckStage::Count> m_CheckStages;
 };
 
 }
@@ -3,21 +3,34 @@
 #include "icinga/clusterevents.hpp"
 #include "icinga/icingaapplication.hpp"
 #include "remote/apilistener.hpp"
+#include "remote/endpointbatch.hpp"
 #include "base/configuration.hpp"
 #include "base/defer.hpp"
 #include "base/serializer.hpp"
 #include "base/exception.hpp"
 #include <boost/thread/once.hpp>
+#include <algorithm>
+#include <limits>
 #include <thread>
+#include <utility>
+#include <vector>
 
 using namespace icinga;
 
 std::mutex ClusterEvents::m_Mutex;
-std::deque<std::function<void ()>> ClusterEvents::m_CheckRequestQueue;
-bool ClusterEvents::m_CheckSchedulerRunning;
+std::map<String, std::deque<ClusterEvents::RemoteCheckRequest>> ClusterEvents::m_CheckRequestQueues;
+std::deque<String> ClusterEvents::m_CheckRequestOrigins;
+size_t ClusterEvents::m_CheckRequestQueueSize = 0;
+int ClusterEvents::m_CheckSchedulerThreads = 0;
 int ClusterEvents::m_ChecksExecutedDuringInterval;
 int ClusterEvents::m_ChecksDroppedDuringInterval;
+int ClusterEvents::m_ChecksExpiredDuringInterval;
 Timer::Ptr ClusterEvents::m_LogTimer;
+std::mutex ClusterEvents::m_ScheduledChecksMutex;
+std::map<String, ClusterEvents::ScheduledCheck> ClusterEvents::m_ScheduledChecks;
+Timer::Ptr ClusterEvents::m_ScheduledChecksTimer;
+
+static const size_t l_MaxCheckRequestQueueSize = 25000;
 
 void ClusterEvents::RemoteCheckThreadProc()
 {
@@ -25,28 +38,67 @@ void ClusterEvents::RemoteCheckThreadProc()
 
 	int maxConcurrentChecks = IcingaApplication::GetInstance()->GetMaxConcurrentChecks();
 
-	std::unique_lock<std::mutex> lock(m_Mutex);
+	for (;;) {
+		Checkable::AquirePendingCheckSlot(maxConcurrentChecks);
+
+		RemoteCheckRequest request;
 
-	for(;;) {
-		if (m_CheckRequestQueue.empty())
+		if (!DequeueCheck(request)) {
+			Checkable::DecreasePendingChecks();
 			break;
+		}
 
-		lock.unlock();
-		Checkable::AquirePendingCheckSlot(maxConcurrentChecks);
-		lock.lock();
+		ExecuteCheckFromQueue(request.Origin, request.Params);
+		Checkable::DecreasePendingChecks();
+	}
+}
 
-		auto callback = m_CheckRequestQueue.front();
-		m_CheckRequestQueue.pop_front();
-		m_ChecksExecutedDuringInterval++;
-		lock.unlock();
+/**
+ * Takes the next request from the queue of the next origin endpoint (round-robin), so that
+ * a single parent endpoint flooding this one doesn't delay the checks of the others.
+ * Check requests which were queued for so long that the parent has already re-scheduled
+ * them are discarded.
+ *
+ * @param request Set to the next request
+ * @returns false if the queue is empty, in which case the calling worker thread stops
+ */
+bool ClusterEvents::DequeueCheck(RemoteCheckRequest& request)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	double now = Utility::GetTime();
 
-		callback();
-		Checkable::DecreasePendingChecks();
+	while (!m_CheckRequestOrigins.empty()) {
+		String originName = std::move(m_CheckRequestOrigins.front());
+		m_CheckRequestOrigins.pop_front();
 
-		lock.lock();
+		auto queue (m_CheckRequestQueues.find(originName));
+
+		if (queue->second.empty()) {
+			/* EnqueueCheck() dropped its last request. */
+			m_CheckRequestQueues.erase(queue);
+			continue;
+		}
+
+		request = std::move(queue->second.front());
+		queue->second.pop_front();
+		m_CheckRequestQueueSize--;
+
+		if (queue->second.empty())
+			m_CheckRequestQueues.erase(queue);
+		else
+			m_CheckRequestOrigins.emplace_back(std::move(originName));
+
+		if (request.Expires < now) {
+			m_ChecksExpiredDuringInterval++;
+			continue;
+		}
+
+		m_ChecksExecutedDuringInterval++;
+		return true;
 	}
 
-	m_CheckSchedulerRunning = false;
+	m_CheckSchedulerThreads--;
+	return false;
 }
 
 void ClusterEvents::EnqueueCheck(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
@@ -60,19 +112,73 @@ void ClusterEvents::EnqueueCheck(const MessageOrigin::Ptr& origin, const Diction
 		m_LogTimer->Start();
 	});
 
+	String originName;
+
+	if (origin->FromClient) {
+		Endpoint::Ptr endpoint = origin->FromClient->GetEndpoint();
+
+		if (endpoint)
+			originName = endpoint->GetName();
+	}
+
+	/*
+	 * The parent re-schedules a check it has sent to a command endpoint after the
+	 * command's timeout plus 30 seconds (Checkable::ExecuteCheck()), so executing the
+	 * request any later than that doesn't help anyone. Event commands aren't repeated.
+	 */
+	double expires = std::numeric_limits<double>::infinity();
+
+	if (params->Get("command_type") == "check_command") {
+		double timeout = 60;
+
+		if (params->Contains("check_timeout")) {
+			timeout = params->Get("check_timeout");
+		} else {
+			CheckCommand::Ptr command = CheckCommand::GetByName(params->Get("command"));
+
+			if (command)
+				timeout = command->GetTimeout();
+		}
+
+		expires = Utility::GetTime() + timeout + 30;
+	}
+
 	std::unique_lock<std::mutex> lock(m_Mutex);
 
-	if (m_CheckRequestQueue.size() >= 25000) {
+	if (m_CheckRequestQueueSize >= l_MaxCheckRequestQueueSize) {
+		/* Make room by dropping the oldest request of the endpoint which sent the most. */
+		auto largest (std::max_element(m_CheckRequestQueues.begin(), m_CheckRequestQueues.end(),
+			[](const decltype(m_CheckRequestQueues)::value_type& a, const decltype(m_CheckRequestQueues)::value_type& b) {
+				return a.second.size() < b.second.size();
+			}));
+
+		auto own (m_CheckRequestQueues.find(originName));
+
+		/* Prefer the sender of this request if it already is one of the largest. */
+		if (own != m_CheckRequestQueues.end() && own->second.size() >= largest->second.size())
+			largest = own;
+
+		/* An emptied queue stays in m_CheckRequestOrigins until DequeueCheck() gets to it. */
+		largest->second.pop_front();
+		m_CheckRequestQueueSize--;
 		m_ChecksDroppedDuringInterval++;
-		return;
 	}
 
-	m_CheckRequestQueue.emplace_back([origin, params]() { ExecuteCheckFromQueue(origin, params); });
+	auto queue (m_CheckRequestQueues.find(originName));
+
+	if (queue == m_CheckRequestQueues.end()) {
+		queue = m_CheckRequestQueues.emplace(originName, std::deque<RemoteCheckRequest>()).first;
+		m_CheckRequestOrigins.emplace_back(originName);
+	}
+
+	queue->second.emplace_back(RemoteCheckRequest{origin, params, expires});
+	m_CheckRequestQueueSize++;
 
-	if (!m_CheckSchedulerRunning) {
+	/* Start another worker as long as there are more requests than workers. */
+	if (m_CheckSchedulerThreads < Configuration::Concurrency && m_CheckRequestQueueSize > (size_t)m_CheckSchedulerThreads) {
 		std::thread t(ClusterEvents::RemoteCheckThreadProc);
 		t.detach();
-		m_CheckSchedulerRunning = true;
+		m_CheckSchedulerThreads++;
 	}
 }
 
@@ -195,7 +301,7 @@ void ClusterEvents::ExecuteCheckFromQueue(const MessageOrigin::Ptr& origin, cons
 			cr->SetOutput(output);
 
 			Dictionary::Ptr message = MakeCheckResultMessage(host, cr);
-			listener->SyncSendMessage(sourceEndpoint, message);
+			EndpointBatch::Send(sourceEndpoint, message);
 		}
 
 		return;
@@ -237,7 +343,7 @@ void ClusterEvents::ExecuteCheckFromQueue(const MessageOrigin::Ptr& origin, cons
 				cr->SetState(state);
 				cr->SetOutput(output);
 				Dictionary::Ptr message = MakeCheckResultMessage(host, cr);
-				listener->SyncSendMessage(sourceEndpoint, message);
+				EndpointBatch::Send(sourceEndpoint, message);
 			}
 
 			return;
@@ -297,7 +403,7 @@ void ClusterEvents::ExecuteCheckFromQueue(const MessageOrigin::Ptr& origin, cons
 				cr->SetExecutionEnd(now);
 
 				Dictionary::Ptr message = MakeCheckResultMessage(host, cr);
-				listener->SyncSendMessage(sourceEndpoint, message);
+				EndpointBatch::Send(sourceEndpoint, message);
 			}
 
 			Log(LogCritical, "checker", output);
@@ -352,12 +458,138 @@ void ClusterEvents::ExecuteCheckFromQueue(const MessageOrigin::Ptr& origin, cons
 	}
 }
 
+/**
+ * Handles event::ScheduleCheck from a parent endpoint which lets this one schedule a command endpoint check
+ * on its own (see the Endpoint's schedule_checks attribute). The params are the ones of event::ExecuteCommand
+ * plus the check_interval, 0 stops running the check.
+ */
+Value ClusterEvents::ScheduleCheckAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	Endpoint::Ptr endpoint = origin->FromClient ? origin->FromClient->GetEndpoint() : nullptr;
+
+	if (!endpoint) {
+		Log(LogNotice, "ClusterEvents")
+			<< "Discarding 'schedule check' message from '" << (origin->FromClient ? origin->FromClient->GetIdentity() : "")
+			<< "': Invalid endpoint origin (client not allowed).";
+		return Empty;
+	}
+
+	if (params->Get("command_type") != "check_command")
+		return Empty;
+
+	String checkableName = params->Get("host");
+
+	if (params->Contains("service"))
+		checkableName += "!" + params->Get("service");
+
+	double interval = params->Get("check_interval");
+	double now = Utility::GetTime();
+
+	static boost::once_flag once = BOOST_ONCE_INIT;
+
+	boost::call_once(once, []() {
+		Endpoint::OnDisconnected.connect([](const Endpoint::Ptr& endpoint, const intrusive_ptr<JsonRpcConnection>&) {
+			EndpointDisconnectedHandler(endpoint);
+		});
+
+		m_ScheduledChecksTimer = Timer::Create();
+		m_ScheduledChecksTimer->SetInterval(1);
+		m_ScheduledChecksTimer->OnTimerExpired.connect([](const Timer * const&) { RunScheduledChecks(); });
+		m_ScheduledChecksTimer->Start();
+	});
+
+	std::unique_lock<std::mutex> lock(m_ScheduledChecksMutex);
+
+	if (interval <= 0) {
+		m_ScheduledChecks.erase(checkableName);
+		return Empty;
+	}
+
+	auto check (m_ScheduledChecks.find(checkableName));
+
+	/*
+	 * The parent sends it when the check is due. It re-sends it if the interval, command or macros change,
+	 * or (e.g. after an HA failover) from another endpoint of the parent zone which takes over.
+	 */
+	if (check == m_ScheduledChecks.end()) {
+		m_ScheduledChecks.emplace(checkableName, ScheduledCheck{origin, endpoint, params, interval, now});
+	} else {
+		check->second.Origin = origin;
+		check->second.From = endpoint;
+		check->second.Params = params;
+		check->second.Interval = interval;
+		check->second.Next = std::min(check->second.Next, now + interval);
+	}
+
+	return Empty;
+}
+
+/**
+ * Enqueues the checks which the parents let this endpoint schedule and which are due.
+ */
+void ClusterEvents::RunScheduledChecks()
+{
+	std::vector<std::pair<MessageOrigin::Ptr, Dictionary::Ptr>> due;
+
+	{
+		std::unique_lock<std::mutex> lock(m_ScheduledChecksMutex);
+		double now = Utility::GetTime();
+
+		for (auto& kv : m_ScheduledChecks) {
+			auto& check (kv.second);
+
+			if (check.Next > now)
+				continue;
+
+			due.emplace_back(check.Origin, check.Params);
+
+			/* Keep the phase of the schedule unless this endpoint fell behind. */
+			check.Next += check.Interval;
+
+			if (check.Next <= now)
+				check.Next = now + check.Interval;
+		}
+	}
+
+	for (auto& check : due)
+		EnqueueCheck(check.first, check.second);
+}
+
+/**
+ * Forgets the checks scheduled by an endpoint which isn't connected anymore. It sends them again.
+ */
+void ClusterEvents::EndpointDisconnectedHandler(const Endpoint::Ptr& endpoint)
+{
+	if (endpoint->GetConnected())
+		return;
+
+	std::unique_lock<std::mutex> lock(m_ScheduledChecksMutex);
+
+	for (auto it (m_ScheduledChecks.begin()); it != m_ScheduledChecks.end();) {
+		if (it->second.From == endpoint)
+			it = m_ScheduledChecks.erase(it);
+		else
+			++it;
+	}
+}
+
 int ClusterEvents::GetCheckRequestQueueSize()
 {
-	return m_CheckRequestQueue.size();
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	return m_CheckRequestQueueSize;
 }
 
 void ClusterEvents::LogRemoteCheckQueueInformation() {
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	if (m_ChecksExpiredDuringInterval > 0) {
+		Log(LogWarning, "ClusterEvents")
+			<< "Remote check queue is too slow. "
+			<< m_ChecksExpiredDuringInterval << " checks discarded because they were queued for too long.";
+		m_ChecksExpiredDuringInterval = 0;
+	}
+
 	if (m_ChecksDroppedDuringInterval > 0) {
 		Log(LogCritical, "ClusterEvents")
 			<< "Remote check queue ran out of slots. "
@@ -368,8 +600,18 @@ void ClusterEvents::LogRemoteCheckQueueInformation() {
 	if (m_ChecksExecutedDuringInterval == 0)
 		return;
 
+	size_t scheduled;
+
+	{
+		std::unique_lock<std::mutex> scheduledLock(m_ScheduledChecksMutex);
+		scheduled = m_ScheduledChecks.size();
+	}
+
 	Log(LogInformation, "RemoteCheckQueue")
-		<< "items: " << m_CheckRequestQueue.size()
+		<< "items: " << m_CheckRequestQueueSize
+		<< ", origins: " << m_CheckRequestQueues.size()
+		<< ", workers: " << m_CheckSchedulerThreads
+		<< ", scheduled checks: " << scheduled
 		<< ", rate: " << m_ChecksExecutedDuringInterval / 10 << "/s "
 		<< "(" << m_ChecksExecutedDuringInterval * 6 << "/min "
 		<< m_ChecksExecutedDuringInterval * 6 * 5 << "/5min "
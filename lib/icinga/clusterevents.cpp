@@ -17,6 +17,7 @@
 #include "base/serializer.hpp"
 #include "base/json.hpp"
 #include <fstream>
+#include <mutex>
 
 using namespace icinga;
 
@@ -36,6 +37,7 @@ REGISTER_APIFUNCTION(SetForceNextNotification, event, &ClusterEvents::ForceNextN
 REGISTER_APIFUNCTION(SetAcknowledgement, event, &ClusterEvents::AcknowledgementSetAPIHandler);
 REGISTER_APIFUNCTION(ClearAcknowledgement, event, &ClusterEvents::AcknowledgementClearedAPIHandler);
 REGISTER_APIFUNCTION(ExecuteCommand, event, &ClusterEvents::ExecuteCommandAPIHandler);
+REGISTER_APIFUNCTION(ScheduleCheck, event, &ClusterEvents::ScheduleCheckAPIHandler);
 REGISTER_APIFUNCTION(SendNotifications, event, &ClusterEvents::SendNotificationsAPIHandler);
 REGISTER_APIFUNCTION(NotificationSentUser, event, &ClusterEvents::NotificationSentUserAPIHandler);
 REGISTER_APIFUNCTION(NotificationSentToAllUsers, event, &ClusterEvents::NotificationSentToAllUsersAPIHandler);
@@ -43,9 +45,13 @@ REGISTER_APIFUNCTION(ExecutedCommand, event, &ClusterEvents::ExecutedCommandAPIH
 REGISTER_APIFUNCTION(UpdateExecutions, event, &ClusterEvents::UpdateExecutionsAPIHandler);
 REGISTER_APIFUNCTION(SetRemovalInfo, event, &ClusterEvents::SetRemovalInfoAPIHandler);
 
+std::mutex ClusterEvents::m_NextCheckMutex;
+std::map<Checkable::Ptr, MessageOrigin::Ptr> ClusterEvents::m_PendingNextChecks;
+Timer::Ptr ClusterEvents::m_NextCheckTimer;
+
 void ClusterEvents::StaticInitialize()
 {
-	Checkable::OnNewCheckResult.connect(&ClusterEvents::CheckResultHandler);
+	Checkable::OnNewCheckResult.connect("ClusterEvents", &ClusterEvents::CheckResultHandler);
 	Checkable::OnNextCheckChanged.connect(&ClusterEvents::NextCheckChangedHandler);
 	Checkable::OnLastCheckStartedChanged.connect(&ClusterEvents::LastCheckStartedChangedHandler);
 	Checkable::OnStateBeforeSuppressionChanged.connect(&ClusterEvents::StateBeforeSuppressionChangedHandler);
@@ -89,6 +95,10 @@ Dictionary::Ptr ClusterEvents::MakeCheckResultMessage(const Checkable::Ptr& chec
 	}
 	params->Set("cr", Serialize(cr));
 
+	/* Older endpoints ignore this and keep relying on event::SetNextCheck. */
+	if (CoalesceNextChecks())
+		params->Set("next_check", checkable->GetNextCheck());
+
 	message->Set("params", params);
 
 	return message;
@@ -102,6 +112,16 @@ void ClusterEvents::CheckResultHandler(const Checkable::Ptr& checkable, const Ch
 		return;
 
 	Dictionary::Ptr message = MakeCheckResultMessage(checkable, cr);
+
+	if (CoalesceNextChecks()) {
+		/* ProcessCheckResult() has already updated next_check with the same origin, that's in the message now. */
+		std::unique_lock<std::mutex> lock (m_NextCheckMutex);
+		auto pending (m_PendingNextChecks.find(checkable));
+
+		if (pending != m_PendingNextChecks.end() && pending->second == origin)
+			m_PendingNextChecks.erase(pending);
+	}
+
 	listener->RelayMessage(origin, checkable, message, true);
 }
 
@@ -175,15 +195,69 @@ Value ClusterEvents::CheckResultAPIHandler(const MessageOrigin::Ptr& origin, con
 		return Empty;
 	}
 
-	if (!checkable->IsPaused() && Zone::GetLocalZone() == checkable->GetZone() && endpoint == checkable->GetCommandEndpoint())
+	if (!checkable->IsPaused() && Zone::GetLocalZone() == checkable->GetZone() && endpoint == checkable->GetCommandEndpoint()) {
 		checkable->ProcessCheckResult(cr);
-	else
+	} else {
 		checkable->ProcessCheckResult(cr, origin);
 
+		/* The sender has coalesced its event::SetNextCheck into this message. */
+		if (params->Contains("next_check")) {
+			double nextCheck = params->Get("next_check");
+
+			if (nextCheck >= Application::GetStartTime() + 60 && nextCheck != checkable->GetNextCheck())
+				checkable->SetNextCheck(nextCheck, false, origin);
+		}
+	}
+
 	return Empty;
 }
 
+/**
+ * Whether next_check changes are sent along with check results and otherwise at most once per second and checkable.
+ */
+bool ClusterEvents::CoalesceNextChecks()
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	return listener && listener->GetCoalesceNextCheck();
+}
+
 void ClusterEvents::NextCheckChangedHandler(const Checkable::Ptr& checkable, const MessageOrigin::Ptr& origin)
+{
+	if (!CoalesceNextChecks()) {
+		RelayNextCheck(checkable, origin);
+		return;
+	}
+
+	static std::once_flag timerOnce;
+
+	std::call_once(timerOnce, []() {
+		m_NextCheckTimer = Timer::Create();
+		m_NextCheckTimer->SetInterval(1);
+		m_NextCheckTimer->OnTimerExpired.connect([](const Timer * const&) { FlushNextChecksTimerHandler(); });
+		m_NextCheckTimer->Start();
+	});
+
+	std::unique_lock<std::mutex> lock (m_NextCheckMutex);
+
+	/* Only the latest origin matters, the timer sends the then current next_check. */
+	m_PendingNextChecks[checkable] = origin;
+}
+
+void ClusterEvents::FlushNextChecksTimerHandler()
+{
+	std::map<Checkable::Ptr, MessageOrigin::Ptr> pending;
+
+	{
+		std::unique_lock<std::mutex> lock (m_NextCheckMutex);
+		std::swap(pending, m_PendingNextChecks);
+	}
+
+	for (auto& kv : pending)
+		RelayNextCheck(kv.first, kv.second);
+}
+
+void ClusterEvents::RelayNextCheck(const Checkable::Ptr& checkable, const MessageOrigin::Ptr& origin)
 {
 	ApiListener::Ptr listener = ApiListener::GetInstance();
 
@@ -8,6 +8,9 @@
 #include "icinga/checkcommand.hpp"
 #include "icinga/eventcommand.hpp"
 #include "icinga/notificationcommand.hpp"
+#include <deque>
+#include <map>
+#include <mutex>
 
 namespace icinga
 {
@@ -61,6 +64,7 @@ public:
 	static Value AcknowledgementClearedAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 
 	static Value ExecuteCommandAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value ScheduleCheckAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 
 	static Dictionary::Ptr MakeCheckResultMessage(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 
@@ -85,16 +89,50 @@ public:
 	static void LogRemoteCheckQueueInformation();
 
 private:
+	struct RemoteCheckRequest
+	{
+		MessageOrigin::Ptr Origin;
+		Dictionary::Ptr Params;
+		double Expires;
+	};
+
 	static std::mutex m_Mutex;
-	static std::deque<std::function<void ()>> m_CheckRequestQueue;
-	static bool m_CheckSchedulerRunning;
+	static std::map<String, std::deque<RemoteCheckRequest>> m_CheckRequestQueues;
+	static std::deque<String> m_CheckRequestOrigins;
+	static size_t m_CheckRequestQueueSize;
+	static int m_CheckSchedulerThreads;
 	static int m_ChecksExecutedDuringInterval;
 	static int m_ChecksDroppedDuringInterval;
+	static int m_ChecksExpiredDuringInterval;
 	static Timer::Ptr m_LogTimer;
 
+	struct ScheduledCheck
+	{
+		MessageOrigin::Ptr Origin;
+		Endpoint::Ptr From;
+		Dictionary::Ptr Params;
+		double Interval;
+		double Next;
+	};
+
+	static std::mutex m_ScheduledChecksMutex;
+	static std::map<String, ScheduledCheck> m_ScheduledChecks;
+	static Timer::Ptr m_ScheduledChecksTimer;
+
+	static std::mutex m_NextCheckMutex;
+	static std::map<Checkable::Ptr, MessageOrigin::Ptr> m_PendingNextChecks;
+	static Timer::Ptr m_NextCheckTimer;
+
 	static void RemoteCheckThreadProc();
+	static bool DequeueCheck(RemoteCheckRequest& request);
 	static void EnqueueCheck(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 	static void ExecuteCheckFromQueue(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static void RunScheduledChecks();
+	static void EndpointDisconnectedHandler(const Endpoint::Ptr& endpoint);
+
+	static bool CoalesceNextChecks();
+	static void RelayNextCheck(const Checkable::Ptr& checkable, const MessageOrigin::Ptr& origin);
+	static void FlushNextChecksTimerHandler();
 };
 
 }
@@ -6,6 +6,7 @@
 #include "remote/configobjectutility.hpp"
 #include "base/utility.hpp"
 #include "base/configtype.hpp"
+#include "base/deadlinequeue.hpp"
 #include "base/timer.hpp"
 #include <boost/thread/once.hpp>
 
@@ -16,6 +17,9 @@ static std::mutex l_CommentMutex;
 static std::map<int, String> l_LegacyCommentsCache;
 static Timer::Ptr l_CommentsExpireTimer;
 
+/* The names of the comments which expire, see CommentsExpireTimerHandler(). */
+static DeadlineQueue<String> l_CommentsExpiry;
+
 boost::signals2::signal<void (const Comment::Ptr&)> Comment::OnCommentAdded;
 boost::signals2::signal<void (const Comment::Ptr&)> Comment::OnCommentRemoved;
 boost::signals2::signal<void (const Comment::Ptr&, const String&, double, const MessageOrigin::Ptr&)> Comment::OnRemovalInfoChanged;
@@ -85,8 +89,15 @@ void Comment::Start(bool runtimeCreated)
 		l_CommentsExpireTimer->SetInterval(60);
 		l_CommentsExpireTimer->OnTimerExpired.connect([](const Timer * const&) { CommentsExpireTimerHandler(); });
 		l_CommentsExpireTimer->Start();
+
+		Comment::OnExpireTimeChanged.connect([](const Comment::Ptr& comment, const Value&) {
+			if (comment->IsActive())
+				comment->UpdateExpiry();
+		});
 	});
 
+	UpdateExpiry();
+
 	{
 		std::unique_lock<std::mutex> lock(l_CommentMutex);
 
@@ -103,6 +114,8 @@ void Comment::Start(bool runtimeCreated)
 
 void Comment::Stop(bool runtimeRemoved)
 {
+	l_CommentsExpiry.Remove(GetName());
+
 	GetCheckable()->UnregisterComment(this);
 
 	if (runtimeRemoved)
@@ -123,6 +136,20 @@ bool Comment::IsExpired() const
 	return (expire_time != 0 && expire_time < Utility::GetTime());
 }
 
+/**
+ * Queues the comment for CommentsExpireTimerHandler() if it expires and may be removed by it.
+ */
+void Comment::UpdateExpiry()
+{
+	double expireTime = GetExpireTime();
+
+	/* Do not remove persistent comments from an acknowledgement */
+	if (expireTime == 0 || (GetEntryType() == CommentAcknowledgement && GetPersistent()))
+		l_CommentsExpiry.Remove(GetName());
+	else
+		l_CommentsExpiry.Set(GetName(), expireTime);
+}
+
 int Comment::GetNextCommentID()
 {
 	std::unique_lock<std::mutex> lock(l_CommentMutex);
@@ -239,20 +266,21 @@ String Comment::GetCommentIDFromLegacyID(int id)
 
 void Comment::CommentsExpireTimerHandler()
 {
-	std::vector<Comment::Ptr> comments;
+	for (const String& name : l_CommentsExpiry.PopDue(Utility::GetTime())) {
+		Comment::Ptr comment = Comment::GetByName(name);
 
-	for (const Comment::Ptr& comment : ConfigType::GetObjectsByType<Comment>()) {
-		comments.push_back(comment);
-	}
+		if (!comment)
+			continue;
 
-	for (const Comment::Ptr& comment : comments) {
 		/* Only remove comments which are activated after daemon start. */
-		if (comment->IsActive() && comment->IsExpired()) {
-			/* Do not remove persistent comments from an acknowledgement */
-			if (comment->GetEntryType() == CommentAcknowledgement && comment->GetPersistent())
-				continue;
-
-			RemoveComment(comment->GetName());
+		if (!comment->IsActive()) {
+			comment->UpdateExpiry();
+			continue;
 		}
+
+		if (comment->IsExpired())
+			RemoveComment(name);
+		else
+			comment->UpdateExpiry();
 	}
 }
@@ -51,6 +51,8 @@ protected:
 private:
 	ObjectImpl<Checkable>::Ptr m_Checkable;
 
+	void UpdateExpiry();
+
 	static void CommentsExpireTimerHandler();
 };
 
@@ -143,6 +143,11 @@ void Dependency::EvaluateApplyRules(const Host::Ptr& host)
 		if (EvaluateApplyRule(host, *rule, true))
 			rule->AddMatch();
 	}
+
+	for (auto& rule : ApplyRule::GetIndexedRules(Dependency::TypeInstance, Host::TypeInstance, host->GetName(), host->GetGroups(), host->GetVars())) {
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
+	}
 }
 
 void Dependency::EvaluateApplyRules(const Service::Ptr& service)
@@ -158,4 +163,11 @@ void Dependency::EvaluateApplyRules(const Service::Ptr& service)
 		if (EvaluateApplyRule(service, *rule, true))
 			rule->AddMatch();
 	}
+
+	Host::Ptr host = service->GetHost();
+
+	for (auto& rule : ApplyRule::GetIndexedRules(Dependency::TypeInstance, Service::TypeInstance, host->GetName(), host->GetGroups(), host->GetVars())) {
+		if (EvaluateApplyRule(service, *rule))
+			rule->AddMatch();
+	}
 }
@@ -10,6 +10,8 @@
 #include "base/timer.hpp"
 #include <boost/thread/once.hpp>
 #include <cmath>
+#include <map>
+#include <set>
 #include <utility>
 
 using namespace icinga;
@@ -20,6 +22,11 @@ static std::map<int, String> l_LegacyDowntimesCache;
 static Timer::Ptr l_DowntimesOrphanedTimer;
 static Timer::Ptr l_DowntimesStartTimer;
 
+static std::mutex l_DowntimesScheduleMutex;
+static std::multimap<double, Downtime::Ptr> l_PendingDowntimeStarts; /**< Fixed downtimes which haven't started yet, by start time */
+static std::set<Downtime::Ptr> l_UncheckedConfigOwners; /**< Downtimes whose ScheduledDowntime hasn't been checked yet */
+static bool l_CheckAllConfigOwners = false; /**< Set if a ScheduledDowntime has been removed */
+
 boost::signals2::signal<void (const Downtime::Ptr&)> Downtime::OnDowntimeAdded;
 boost::signals2::signal<void (const Downtime::Ptr&)> Downtime::OnDowntimeRemoved;
 boost::signals2::signal<void (const Downtime::Ptr&)> Downtime::OnDowntimeStarted;
@@ -35,6 +42,14 @@ void Downtime::StaticInitialize()
 	ScriptGlobal::Set("Icinga.DowntimeNoChildren", "DowntimeNoChildren");
 	ScriptGlobal::Set("Icinga.DowntimeTriggeredChildren", "DowntimeTriggeredChildren");
 	ScriptGlobal::Set("Icinga.DowntimeNonTriggeredChildren", "DowntimeNonTriggeredChildren");
+
+	/* Its downtimes may be orphaned now, see DowntimesOrphanedTimerHandler(). */
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+		if (!object->IsActive() && dynamic_pointer_cast<ScheduledDowntime>(object)) {
+			std::unique_lock<std::mutex> lock (l_DowntimesScheduleMutex);
+			l_CheckAllConfigOwners = true;
+		}
+	});
 }
 
 String DowntimeNameComposer::MakeName(const String& shortName, const Object::Ptr& context) const
@@ -122,6 +137,17 @@ void Downtime::Start(bool runtimeCreated)
 	if (parent)
 		parent->RegisterChild(this);
 
+	{
+		std::unique_lock<std::mutex> lock (l_DowntimesScheduleMutex);
+
+		/* Started by DowntimesStartTimerHandler(), otherwise immediately below. */
+		if (GetFixed() && GetStartTime() > Utility::GetTime())
+			l_PendingDowntimeStarts.emplace(GetStartTime(), this);
+
+		if (!GetConfigOwner().IsEmpty())
+			l_UncheckedConfigOwners.emplace(this);
+	}
+
 	if (runtimeCreated)
 		OnDowntimeAdded(this);
 
@@ -155,9 +181,30 @@ void Downtime::Stop(bool runtimeRemoved)
 	if (parent)
 		parent->UnregisterChild(this);
 
-	if (runtimeRemoved)
+	{
+		std::unique_lock<std::mutex> lock (l_DowntimesScheduleMutex);
+		auto range (l_PendingDowntimeStarts.equal_range(GetStartTime()));
+
+		for (auto it (range.first); it != range.second; ++it) {
+			if (it->second == this) {
+				l_PendingDowntimeStarts.erase(it);
+				break;
+			}
+		}
+
+		l_UncheckedConfigOwners.erase(this);
+	}
+
+	if (runtimeRemoved) {
 		OnDowntimeRemoved(this);
 
+		/* Don't wait for the start of the removed downtime to create the next one. */
+		auto sd (ScheduledDowntime::GetByName(GetConfigOwner()));
+
+		if (sd && sd->IsActive())
+			sd->ScheduleEvaluation();
+	}
+
 	ObjectImpl<Downtime>::Stop(runtimeRemoved);
 }
 
@@ -248,6 +295,54 @@ Downtime::Ptr Downtime::AddDowntime(const Checkable::Ptr& checkable, const Strin
 	const String& triggeredBy, double duration,
 	const String& scheduledDowntime, const String& scheduledBy, const String& parent,
 	const String& id, const MessageOrigin::Ptr& origin)
+{
+	NewConfigObject object (MakeDowntime(checkable, author, comment, startTime, endTime, fixed,
+		triggeredBy, duration, scheduledDowntime, scheduledBy, parent, id));
+	const String& fullName (object.Name);
+
+	Array::Ptr errors = new Array();
+
+	if (!ConfigObjectUtility::CreateObject(Downtime::TypeInstance, fullName, object.Config, errors, nullptr)) {
+		ObjectLock olock(errors);
+		for (const String& error : errors) {
+			Log(LogCritical, "Downtime", error);
+		}
+
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not create downtime."));
+	}
+
+	if (!triggeredBy.IsEmpty()) {
+		Downtime::Ptr parentDowntime = Downtime::GetByName(triggeredBy);
+		Array::Ptr triggers = parentDowntime->GetTriggers();
+
+		ObjectLock olock(triggers);
+		if (!triggers->Contains(fullName))
+			triggers->Add(fullName);
+	}
+
+	Downtime::Ptr downtime = Downtime::GetByName(fullName);
+
+	if (!downtime)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not create downtime object."));
+
+	Log(LogInformation, "Downtime")
+		<< "Added downtime '" << downtime->GetName()
+		<< "' between '" << Utility::FormatDateTime("%Y-%m-%d %H:%M:%S", startTime)
+		<< "' and '" << Utility::FormatDateTime("%Y-%m-%d %H:%M:%S", endTime) << "', author: '"
+		<< author << "', " << (fixed ? "fixed" : "flexible with " + Convert::ToString(duration) + "s duration");
+
+	return downtime;
+}
+
+/**
+ * Prepares a downtime for AddDowntimes(), the parameters are the ones of AddDowntime().
+ *
+ * @return The downtime's name and config
+ */
+NewConfigObject Downtime::MakeDowntime(const Checkable::Ptr& checkable, const String& author,
+	const String& comment, double startTime, double endTime, bool fixed,
+	const String& triggeredBy, double duration,
+	const String& scheduledDowntime, const String& scheduledBy, const String& parent, const String& id)
 {
 	String fullName;
 
@@ -313,40 +408,80 @@ Downtime::Ptr Downtime::AddDowntime(const Checkable::Ptr& checkable, const Strin
 	if (!zone.IsEmpty())
 		attrs->Set("zone", zone);
 
-	String config = ConfigObjectUtility::CreateObjectConfig(Downtime::TypeInstance, fullName, true, nullptr, attrs);
+	return NewConfigObject{
+		Downtime::TypeInstance, fullName,
+		ConfigObjectUtility::CreateObjectConfig(Downtime::TypeInstance, fullName, true, nullptr, attrs)
+	};
+}
+
+/**
+ * Creates many downtimes at once, e.g. those of all children of a host, like AddDowntime() for each of them.
+ * They're committed, activated, written to disk and relayed to the cluster together, see
+ * ConfigObjectUtility::CreateObjects(). Unlike with AddDowntime(), they may reference each other as parent.
+ *
+ * @param downtimes The downtimes from MakeDowntime()
+ *
+ * @return The new downtimes in the same order
+ */
+std::vector<Downtime::Ptr> Downtime::AddDowntimes(const std::vector<NewConfigObject>& downtimes)
+{
+	std::vector<Downtime::Ptr> result;
+
+	if (downtimes.empty())
+		return result;
 
 	Array::Ptr errors = new Array();
 
-	if (!ConfigObjectUtility::CreateObject(Downtime::TypeInstance, fullName, config, errors, nullptr)) {
+	if (!ConfigObjectUtility::CreateObjects(downtimes, errors, nullptr)) {
 		ObjectLock olock(errors);
 		for (const String& error : errors) {
 			Log(LogCritical, "Downtime", error);
 		}
 
-		BOOST_THROW_EXCEPTION(std::runtime_error("Could not create downtime."));
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not create downtimes."));
 	}
 
-	if (!triggeredBy.IsEmpty()) {
-		Downtime::Ptr parentDowntime = Downtime::GetByName(triggeredBy);
-		Array::Ptr triggers = parentDowntime->GetTriggers();
+	result.reserve(downtimes.size());
 
-		ObjectLock olock(triggers);
-		if (!triggers->Contains(fullName))
-			triggers->Add(fullName);
+	/* One lock per triggering downtime (usually there's just one) instead of one per downtime */
+	std::map<String, std::vector<String>> triggeredBy;
+
+	for (auto& object : downtimes) {
+		Downtime::Ptr downtime = Downtime::GetByName(object.Name);
+
+		if (!downtime)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Could not create downtime object."));
+
+		if (!downtime->GetTriggeredBy().IsEmpty())
+			triggeredBy[downtime->GetTriggeredBy()].emplace_back(downtime->GetName());
+
+		result.emplace_back(std::move(downtime));
 	}
 
-	Downtime::Ptr downtime = Downtime::GetByName(fullName);
+	for (auto& kv : triggeredBy) {
+		Downtime::Ptr parentDowntime = Downtime::GetByName(kv.first);
 
-	if (!downtime)
-		BOOST_THROW_EXCEPTION(std::runtime_error("Could not create downtime object."));
+		if (!parentDowntime)
+			continue;
+
+		Array::Ptr triggers = parentDowntime->GetTriggers();
+		ObjectLock olock(triggers);
+
+		for (auto& name : kv.second) {
+			if (!triggers->Contains(name))
+				triggers->Add(name);
+		}
+	}
+
+	auto& first (result.front());
 
 	Log(LogInformation, "Downtime")
-		<< "Added downtime '" << downtime->GetName()
-		<< "' between '" << Utility::FormatDateTime("%Y-%m-%d %H:%M:%S", startTime)
-		<< "' and '" << Utility::FormatDateTime("%Y-%m-%d %H:%M:%S", endTime) << "', author: '"
-		<< author << "', " << (fixed ? "fixed" : "flexible with " + Convert::ToString(duration) + "s duration");
+		<< "Added " << result.size() << " downtime(s) like '" << first->GetName() << "' between '"
+		<< Utility::FormatDateTime("%Y-%m-%d %H:%M:%S", first->GetStartTime()) << "' and '"
+		<< Utility::FormatDateTime("%Y-%m-%d %H:%M:%S", first->GetEndTime()) << "', author: '" << first->GetAuthor() << "', "
+		<< (first->GetFixed() ? "fixed" : "flexible with " + Convert::ToString(first->GetDuration()) + "s duration");
 
-	return downtime;
+	return result;
 }
 
 void Downtime::RemoveDowntime(const String& id, bool includeChildren, bool cancelled, bool expired,
@@ -527,8 +662,20 @@ String Downtime::GetDowntimeIDFromLegacyID(int id)
 
 void Downtime::DowntimesStartTimerHandler()
 {
+	std::vector<Downtime::Ptr> due;
+
+	{
+		std::unique_lock<std::mutex> lock (l_DowntimesScheduleMutex);
+		auto end (l_PendingDowntimeStarts.upper_bound(Utility::GetTime()));
+
+		for (auto it (l_PendingDowntimeStarts.begin()); it != end; ++it)
+			due.emplace_back(it->second);
+
+		l_PendingDowntimeStarts.erase(l_PendingDowntimeStarts.begin(), end);
+	}
+
 	/* Start fixed downtimes. Flexible downtimes will be triggered on-demand. */
-	for (const Downtime::Ptr& downtime : ConfigType::GetObjectsByType<Downtime>()) {
+	for (const Downtime::Ptr& downtime : due) {
 		if (downtime->IsActive() &&
 			downtime->CanBeTriggered() &&
 			downtime->GetFixed()) {
@@ -541,9 +688,34 @@ void Downtime::DowntimesStartTimerHandler()
 	}
 }
 
+/**
+ * Removes downtimes whose ScheduledDowntime doesn't exist (anymore).
+ *
+ * Only looks at the ones added since the last run, unless a ScheduledDowntime has been removed meanwhile.
+ */
 void Downtime::DowntimesOrphanedTimerHandler()
 {
-	for (const Downtime::Ptr& downtime : ConfigType::GetObjectsByType<Downtime>()) {
+	/* HasValidConfigOwner() can't tell yet. */
+	if (!ScheduledDowntime::AllConfigIsLoaded())
+		return;
+
+	std::vector<Downtime::Ptr> downtimes;
+	bool checkAll;
+
+	{
+		std::unique_lock<std::mutex> lock (l_DowntimesScheduleMutex);
+
+		checkAll = l_CheckAllConfigOwners;
+		l_CheckAllConfigOwners = false;
+
+		downtimes.assign(l_UncheckedConfigOwners.begin(), l_UncheckedConfigOwners.end());
+		l_UncheckedConfigOwners.clear();
+	}
+
+	if (checkAll)
+		downtimes = ConfigType::GetObjectsByType<Downtime>();
+
+	for (const Downtime::Ptr& downtime : downtimes) {
 		/* Only remove downtimes which are activated after daemon start. */
 		if (downtime->IsActive() && !downtime->HasValidConfigOwner())
 			RemoveDowntime(downtime->GetName(), false, false, true);
@@ -6,7 +6,9 @@
 #include "icinga/i2-icinga.hpp"
 #include "icinga/downtime-ti.hpp"
 #include "icinga/checkable-ti.hpp"
+#include "remote/configobjectutility.hpp"
 #include "remote/messageorigin.hpp"
+#include <vector>
 
 namespace icinga
 {
@@ -52,6 +54,12 @@ public:
 		const String& scheduledBy = String(), const String& parent = String(), const String& id = String(),
 		const MessageOrigin::Ptr& origin = nullptr);
 
+	static NewConfigObject MakeDowntime(const intrusive_ptr<Checkable>& checkable, const String& author,
+		const String& comment, double startTime, double endTime, bool fixed,
+		const String& triggeredBy, double duration, const String& scheduledDowntime = String(),
+		const String& scheduledBy = String(), const String& parent = String(), const String& id = String());
+	static std::vector<Ptr> AddDowntimes(const std::vector<NewConfigObject>& downtimes);
+
 	static void RemoveDowntime(const String& id, bool includeChildren, bool cancelled, bool expired = false,
 		const String& removedBy = "", const MessageOrigin::Ptr& origin = nullptr);
 
@@ -20,6 +20,7 @@
 #include "base/application.hpp"
 #include "base/utility.hpp"
 #include "base/exception.hpp"
+#include <algorithm>
 #include <fstream>
 #include <boost/thread/once.hpp>
 
@@ -32,7 +33,20 @@ void ExternalCommandProcessor::Execute(const String& line)
 	if (line.IsEmpty())
 		return;
 
-	if (line[0] != '[')
+	double ts;
+	String command;
+	std::vector<String> arguments;
+
+	ParseLine(line, ts, command, arguments);
+	Execute(ts, command, arguments);
+}
+
+/**
+ * Splits a "[<timestamp>] <command>;<argument>;..." line into its parts (without copying it as a whole).
+ */
+void ExternalCommandProcessor::ParseLine(const String& line, double& time, String& command, std::vector<String>& arguments)
+{
+	if (line.IsEmpty() || line[0] != '[')
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing timestamp in command: " + line));
 
 	size_t pos = line.FindFirstOf("]");
@@ -40,21 +54,24 @@ void ExternalCommandProcessor::Execute(const String& line)
 	if (pos == String::NPos)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing timestamp in command: " + line));
 
-	String timestamp = line.SubStr(1, pos - 1);
-	String args = line.SubStr(pos + 2, String::NPos);
-
-	double ts = Convert::ToDouble(timestamp);
+	time = Convert::ToDouble(line.SubStr(1, pos - 1));
 
-	if (ts == 0)
+	if (time == 0)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid timestamp in command: " + line));
 
-	std::vector<String> argv = args.Split(";");
+	auto begin (line.CStr() + std::min(pos + 2u, line.GetLength()));
+	auto end (line.CStr() + line.GetLength());
+	auto separator (std::find(begin, end, ';'));
 
-	if (argv.empty())
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing arguments in command: " + line));
+	command = String(begin, separator);
+	arguments.clear();
 
-	std::vector<String> argvExtra(argv.begin() + 1, argv.end());
-	Execute(ts, argv[0], argvExtra);
+	while (separator != end) {
+		begin = separator + 1;
+		separator = std::find(begin, end, ';');
+
+		arguments.emplace_back(begin, separator);
+	}
 }
 
 void ExternalCommandProcessor::Execute(double time, const String& command, const std::vector<String>& arguments)
@@ -1037,6 +1054,8 @@ void ExternalCommandProcessor::ScheduleAndPropagateHostDowntime(double, const st
 		Convert::ToBool(is_fixed), triggeredBy, Convert::ToDouble(arguments[5]));
 
 	/* Schedule downtime for all child hosts */
+	std::vector<NewConfigObject> childDowntimes;
+
 	for (const Checkable::Ptr& child : host->GetAllChildren()) {
 		Host::Ptr host;
 		Service::Ptr service;
@@ -1046,10 +1065,12 @@ void ExternalCommandProcessor::ScheduleAndPropagateHostDowntime(double, const st
 		if (service)
 			continue;
 
-		(void) Downtime::AddDowntime(child, arguments[6], arguments[7],
+		childDowntimes.emplace_back(Downtime::MakeDowntime(child, arguments[6], arguments[7],
 			Convert::ToDouble(arguments[1]), Convert::ToDouble(arguments[2]),
-			Convert::ToBool(is_fixed), triggeredBy, Convert::ToDouble(arguments[5]));
+			Convert::ToBool(is_fixed), triggeredBy, Convert::ToDouble(arguments[5])));
 	}
+
+	(void) Downtime::AddDowntimes(childDowntimes);
 }
 
 void ExternalCommandProcessor::ScheduleAndPropagateTriggeredHostDowntime(double, const std::vector<String>& arguments)
@@ -1073,6 +1094,8 @@ void ExternalCommandProcessor::ScheduleAndPropagateTriggeredHostDowntime(double,
 		Convert::ToBool(is_fixed), triggeredBy, Convert::ToDouble(arguments[5]));
 
 	/* Schedule downtime for all child hosts and explicitely trigger them through the parent host's downtime */
+	std::vector<NewConfigObject> childDowntimes;
+
 	for (const Checkable::Ptr& child : host->GetAllChildren()) {
 		Host::Ptr host;
 		Service::Ptr service;
@@ -1082,10 +1105,12 @@ void ExternalCommandProcessor::ScheduleAndPropagateTriggeredHostDowntime(double,
 		if (service)
 			continue;
 
-		(void) Downtime::AddDowntime(child, arguments[6], arguments[7],
+		childDowntimes.emplace_back(Downtime::MakeDowntime(child, arguments[6], arguments[7],
 			Convert::ToDouble(arguments[1]), Convert::ToDouble(arguments[2]),
-			Convert::ToBool(is_fixed), parentDowntime->GetName(), Convert::ToDouble(arguments[5]));
+			Convert::ToBool(is_fixed), parentDowntime->GetName(), Convert::ToDouble(arguments[5])));
 	}
+
+	(void) Downtime::AddDowntimes(childDowntimes);
 }
 
 void ExternalCommandProcessor::DelHostDowntime(double, const std::vector<String>& arguments)
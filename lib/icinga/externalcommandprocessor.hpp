@@ -24,6 +24,7 @@ struct ExternalCommandInfo
 class ExternalCommandProcessor {
 public:
 	static void Execute(const String& line);
+	static void ParseLine(const String& line, double& time, String& command, std::vector<String>& arguments);
 	static void Execute(double time, const String& command, const std::vector<String>& arguments);
 
 	static boost::signals2::signal<void(double, const String&, const std::vector<String>&)> OnNewExternalCommand;
@@ -117,17 +117,10 @@ int Host::GetTotalServices() const
 
 Service::Ptr Host::GetServiceByShortName(const Value& name)
 {
-	if (name.IsScalar()) {
-		{
-			std::unique_lock<std::mutex> lock(m_ServicesMutex);
-
-			auto it = m_Services.find(name);
-
-			if (it != m_Services.end())
-				return it->second;
-		}
-
-		return nullptr;
+	if (name.IsString()) {
+		return GetServiceByShortName(name.Get<String>());
+	} else if (name.IsScalar()) {
+		return GetServiceByShortName(static_cast<String>(name));
 	} else if (name.IsObjectType<Dictionary>()) {
 		Dictionary::Ptr dict = name;
 		String short_name;
@@ -138,6 +131,21 @@ Service::Ptr Host::GetServiceByShortName(const Value& name)
 	}
 }
 
+/**
+ * Like GetServiceByShortName(const Value&), but doesn't copy the name into a Value first.
+ */
+Service::Ptr Host::GetServiceByShortName(const String& name)
+{
+	std::unique_lock<std::mutex> lock(m_ServicesMutex);
+
+	auto it = m_Services.find(name);
+
+	if (it != m_Services.end())
+		return it->second;
+
+	return nullptr;
+}
+
 HostState Host::CalculateState(ServiceState state)
 {
 	switch (state) {
@@ -25,6 +25,7 @@ public:
 	DECLARE_OBJECTNAME(Host);
 
 	intrusive_ptr<Service> GetServiceByShortName(const Value& name);
+	intrusive_ptr<Service> GetServiceByShortName(const String& name);
 
 	std::vector<intrusive_ptr<Service> > GetServices() const;
 	void AddService(const intrusive_ptr<Service>& service);
@@ -47,13 +47,8 @@ void HostGroup::EvaluateObjectRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating group memberships for host '" << host->GetName() << "'");
 
-	for (const ConfigItem::Ptr& group : ConfigItem::GetItems(HostGroup::TypeInstance))
-	{
-		if (!group->GetFilter())
-			continue;
-
-		EvaluateObjectRule(host, group);
-	}
+	ObjectRule::EvaluateGroupRules(HostGroup::TypeInstance, host->GetName(), host->GetGroups(), host->GetVars(), true,
+		[&host](const ConfigItem::Ptr& group) { return EvaluateObjectRule(host, group); });
 }
 
 std::set<Host::Ptr> HostGroup::GetMembers() const
@@ -16,6 +16,7 @@
 #include "base/utility.hpp"
 #include "base/timer.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/startupprofile.hpp"
 #include "base/initialize.hpp"
 #include "base/statsfunction.hpp"
 #include "base/loader.hpp"
@@ -24,6 +25,7 @@
 using namespace icinga;
 
 static Timer::Ptr l_RetentionTimer;
+static int l_RetentionRuns = 0;
 
 REGISTER_TYPE(IcingaApplication);
 /* Ensure that the priority is lower than the basic System namespace initialization in scriptframe.cpp. */
@@ -50,6 +52,7 @@ void IcingaApplication::StaticInitialize()
 
 	ScriptGlobal::Set("ReloadTimeout", 300);
 	ScriptGlobal::Set("MaxConcurrentChecks", 512);
+	ScriptGlobal::Set("CheckStagesInVarsAfter", false);
 
 	Namespace::Ptr systemNS = ScriptGlobal::Get("System");
 	/* Ensure that the System namespace is already initialized. Otherwise this is a programming error. */
@@ -87,7 +90,8 @@ void IcingaApplication::StatsFunc(const Dictionary::Ptr& status, const Array::Pt
 			{ "environment", icingaapplication->GetEnvironment() },
 			{ "pid", Utility::GetPid() },
 			{ "program_start", Application::GetStartTime() },
-			{ "version", Application::GetAppVersion() }
+			{ "version", Application::GetAppVersion() },
+			{ "startup", StartupProfile::GetReport() }
 		}));
 	}
 
@@ -106,7 +110,10 @@ int IcingaApplication::Main()
 	/* periodically dump the program state */
 	l_RetentionTimer = Timer::Create();
 	l_RetentionTimer->SetInterval(300);
-	l_RetentionTimer->OnTimerExpired.connect([this](const Timer * const&) { DumpProgramState(); });
+	l_RetentionTimer->OnTimerExpired.connect([this](const Timer * const&) {
+		/* Only journal the changed objects, but write the whole state file once an hour. */
+		DumpProgramState(++l_RetentionRuns % 12 == 0);
+	});
 	l_RetentionTimer->Start();
 
 	RunEventLoop();
@@ -123,7 +130,10 @@ void IcingaApplication::OnShutdown()
 		l_RetentionTimer->Stop();
 	}
 
-	DumpProgramState();
+	/* Only append the changes since the last retention run, so that a new worker
+	 * which already restored the state file just has to catch up on them.
+	 */
+	DumpProgramState(false);
 }
 
 static void PersistModAttrHelper(AtomicFile& fp, ConfigObject::Ptr& previousObject, const ConfigObject::Ptr& object, const String& attr, const Value& value)
@@ -159,9 +169,13 @@ static void PersistModAttrHelper(AtomicFile& fp, ConfigObject::Ptr& previousObje
 	previousObject = object;
 }
 
-void IcingaApplication::DumpProgramState()
+void IcingaApplication::DumpProgramState(bool full)
 {
-	ConfigObject::DumpObjects(Configuration::StatePath);
+	if (full)
+		ConfigObject::DumpObjects(Configuration::StatePath);
+	else
+		ConfigObject::DumpDirtyObjects(Configuration::StatePath);
+
 	DumpModifiedAttributes();
 }
 
@@ -305,6 +319,11 @@ int IcingaApplication::GetMaxConcurrentChecks() const
 	return ScriptGlobal::Get("MaxConcurrentChecks");
 }
 
+bool IcingaApplication::GetCheckStagesInVarsAfter() const
+{
+	return ScriptGlobal::Get("CheckStagesInVarsAfter");
+}
+
 String IcingaApplication::GetEnvironment() const
 {
 	return Application::GetAppEnvironment();
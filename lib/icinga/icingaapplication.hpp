@@ -34,6 +34,7 @@ public:
 	String GetNodeName() const;
 
 	int GetMaxConcurrentChecks() const;
+	bool GetCheckStagesInVarsAfter() const;
 
 	String GetEnvironment() const override;
 	void SetEnvironment(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
@@ -41,7 +42,7 @@ public:
 	void ValidateVars(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils) override;
 
 private:
-	void DumpProgramState();
+	void DumpProgramState(bool full);
 	void DumpModifiedAttributes();
 
 	void OnShutdown() override;
@@ -8,11 +8,20 @@
 #include "base/logger.hpp"
 #include "base/debug.hpp"
 #include "base/utility.hpp"
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 using namespace icinga;
 
 REGISTER_FUNCTION_NONCONST(Internal, LegacyTimePeriod, &LegacyTimePeriod::ScriptFunc, "tp:begin:end");
 
+/* ScriptFunc() results per midnight of a day and range key/value, shared by all time periods */
+static std::mutex l_DayCacheMutex;
+static std::map<std::pair<time_t, String>, bool> l_DayDefinitionCache;
+static std::map<std::pair<time_t, String>, std::vector<std::pair<double, double>>> l_DaySegmentsCache;
+
 /**
  * Returns the same as mktime() but does not modify its argument and takes a const pointer.
  *
@@ -579,6 +588,85 @@ Dictionary::Ptr LegacyTimePeriod::FindNextSegment(const String& daydef, const St
 	return nullptr;
 }
 
+/**
+ * Like IsInDayDefinition(), but remembers the result for the day given by reference.
+ *
+ * @param midnight mktime() of reference, which has to be midnight
+ */
+static bool IsInDayDefinitionCached(const String& daydef, const tm *reference, time_t midnight)
+{
+	std::pair<time_t, String> key (midnight, daydef);
+
+	{
+		std::unique_lock<std::mutex> lock (l_DayCacheMutex);
+		auto cached (l_DayDefinitionCache.find(key));
+
+		if (cached != l_DayDefinitionCache.end())
+			return cached->second;
+	}
+
+	bool result = LegacyTimePeriod::IsInDayDefinition(daydef, reference);
+
+	std::unique_lock<std::mutex> lock (l_DayCacheMutex);
+	l_DayDefinitionCache.emplace(std::move(key), result);
+
+	return result;
+}
+
+/**
+ * Like ProcessTimeRanges(), but remembers the segments for the day given by reference.
+ *
+ * @param midnight mktime() of reference, which has to be midnight
+ */
+static void ProcessTimeRangesCached(const String& timeranges, const tm *reference, time_t midnight, const Array::Ptr& result)
+{
+	std::pair<time_t, String> key (midnight, timeranges);
+	std::vector<std::pair<double, double>> segments;
+	bool found = false;
+
+	{
+		std::unique_lock<std::mutex> lock (l_DayCacheMutex);
+		auto cached (l_DaySegmentsCache.find(key));
+
+		if (cached != l_DaySegmentsCache.end()) {
+			segments = cached->second;
+			found = true;
+		}
+	}
+
+	if (!found) {
+		Array::Ptr processed = new Array();
+
+		LegacyTimePeriod::ProcessTimeRanges(timeranges, reference, processed);
+
+		ObjectLock olock(processed);
+		for (const Dictionary::Ptr& segment : processed)
+			segments.emplace_back(segment->Get("begin"), segment->Get("end"));
+
+		std::unique_lock<std::mutex> lock (l_DayCacheMutex);
+		l_DaySegmentsCache.emplace(std::move(key), segments);
+	}
+
+	for (auto& segment : segments) {
+		result->Add(new Dictionary({
+			{ "begin", segment.first },
+			{ "end", segment.second }
+		}));
+	}
+}
+
+/**
+ * Forgets the cached days older than midnight, some days before the one currently being updated.
+ */
+static void PurgeDayCache(time_t midnight)
+{
+	std::unique_lock<std::mutex> lock (l_DayCacheMutex);
+	std::pair<time_t, String> key (midnight, String());
+
+	l_DayDefinitionCache.erase(l_DayDefinitionCache.begin(), l_DayDefinitionCache.lower_bound(key));
+	l_DaySegmentsCache.erase(l_DaySegmentsCache.begin(), l_DaySegmentsCache.lower_bound(key));
+}
+
 Array::Ptr LegacyTimePeriod::ScriptFunc(const TimePeriod::Ptr& tp, double begin, double end)
 {
 	Array::Ptr segments = new Array();
@@ -610,16 +698,19 @@ Array::Ptr LegacyTimePeriod::ScriptFunc(const TimePeriod::Ptr& tp, double begin,
 			t->tm_isdst = -1;
 		};
 
+		PurgeDayCache(mktime_const(&tm_begin) - 3 * 24 * 60 * 60);
+
 		for (tm reference = tm_begin; mktime_const(&reference) <= end; advance_to_next_day(&reference)) {
+			time_t midnight = mktime_const(&reference);
 
 #ifdef I2_DEBUG
 			Log(LogDebug, "LegacyTimePeriod")
-				<< "Checking reference time " << mktime_const(&reference);
+				<< "Checking reference time " << midnight;
 #endif /* I2_DEBUG */
 
 			ObjectLock olock(ranges);
 			for (const Dictionary::Pair& kv : ranges) {
-				if (!IsInDayDefinition(kv.first, &reference)) {
+				if (!IsInDayDefinitionCached(kv.first, &reference, midnight)) {
 #ifdef I2_DEBUG
 					Log(LogDebug, "LegacyTimePeriod")
 						<< "Not in day definition '" << kv.first << "'.";
@@ -632,7 +723,7 @@ Array::Ptr LegacyTimePeriod::ScriptFunc(const TimePeriod::Ptr& tp, double begin,
 					<< "In day definition '" << kv.first << "'.";
 #endif /* I2_DEBUG */
 
-				ProcessTimeRanges(kv.second, &reference, segments);
+				ProcessTimeRangesCached(kv.second, &reference, midnight, segments);
 			}
 		}
 	}
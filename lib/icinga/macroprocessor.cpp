@@ -14,11 +14,40 @@
 #include "base/convert.hpp"
 #include "base/exception.hpp"
 #include <boost/algorithm/string/join.hpp>
+#include <unordered_map>
 
 using namespace icinga;
 
 thread_local Dictionary::Ptr MacroResolver::OverrideMacros;
 
+/**
+ * A macro name, pre-split for ResolveMacro()
+ */
+struct MacroProcessor::MacroName
+{
+	String Name;
+	String ObjName;
+	std::vector<String> Tokens;
+	String Path;
+};
+
+/**
+ * A format string split into literal parts and macros
+ */
+struct MacroProcessor::MacroTemplate
+{
+	struct Part
+	{
+		String Literal;
+		std::unique_ptr<MacroName> Macro;
+	};
+
+	std::vector<Part> Parts;
+
+	// Whether the last $ hasn't been closed
+	bool Unterminated = false;
+};
+
 Value MacroProcessor::ResolveMacros(const Value& str, const ResolverList& resolvers,
 	const CheckResult::Ptr& cr, String *missingMacro,
 	const MacroProcessor::EscapeCallback& escapeFn, const Dictionary::Ptr& resolvedMacros,
@@ -37,9 +66,9 @@ Value MacroProcessor::ResolveMacros(const Value& str, const ResolverList& resolv
 			resolvedMacros, useResolvedMacros, recursionLevel + 1);
 	} else if (str.IsObjectType<Array>()) {
 		ArrayData resultArr;
-		Array::Ptr arr = str;
 
-		ObjectLock olock(arr);
+		/* Resolving the elements may run functions, so don't hold the lock meanwhile. */
+		Array::Ptr arr = static_cast<Array::Ptr>(str)->Snapshot();
 
 		for (const Value& arg : arr) {
 			/* Note: don't escape macros here. */
@@ -55,9 +84,7 @@ Value MacroProcessor::ResolveMacros(const Value& str, const ResolverList& resolv
 		result = new Array(std::move(resultArr));
 	} else if (str.IsObjectType<Dictionary>()) {
 		Dictionary::Ptr resultDict = new Dictionary();
-		Dictionary::Ptr dict = str;
-
-		ObjectLock olock(dict);
+		Dictionary::Ptr dict = static_cast<Dictionary::Ptr>(str)->Snapshot();
 
 		for (const Dictionary::Pair& kv : dict) {
 			/* Note: don't escape macros here. */
@@ -85,21 +112,78 @@ static MacroProcessor::ResolverList GetDefaultResolvers()
 	};
 }
 
-bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resolvers,
-	const CheckResult::Ptr& cr, Value *result, bool *recursive_macro)
+/**
+ * Parses a format string once and returns the cached result for subsequent calls.
+ *
+ * The cache is per thread, so it doesn't need any locking. Its entries never become invalid
+ * as they're keyed by the format string itself, but obsolete once e.g. a command has been modified.
+ * So the cache just gets cleared once it's grown too large.
+ */
+std::shared_ptr<const MacroProcessor::MacroTemplate> MacroProcessor::CompileMacros(const String& str)
 {
-	CONTEXT("Resolving macro '" << macro << "'");
+	static thread_local std::unordered_map<String, std::shared_ptr<const MacroTemplate>> cache;
 
-	*recursive_macro = false;
+	auto cached (cache.find(str));
+
+	if (cached != cache.end()) {
+		return cached->second;
+	}
+
+	auto tmpl (std::make_shared<MacroTemplate>());
+	size_t offset = 0, pos_first, pos_second;
+
+	while ((pos_first = str.FindFirstOf("$", offset)) != String::NPos) {
+		if (pos_first > offset) {
+			tmpl->Parts.emplace_back(MacroTemplate::Part{str.SubStr(offset, pos_first - offset), nullptr});
+		}
+
+		pos_second = str.FindFirstOf("$", pos_first + 1);
+
+		if (pos_second == String::NPos) {
+			tmpl->Unterminated = true;
+			break;
+		}
+
+		std::unique_ptr<MacroName> macro (new MacroName());
 
-	std::vector<String> tokens = macro.Split(".");
+		macro->Name = str.SubStr(pos_first + 1, pos_second - pos_first - 1);
+		macro->Tokens = macro->Name.Split(".");
+
+		if (macro->Tokens.size() > 1) {
+			macro->ObjName = macro->Tokens[0];
+			macro->Tokens.erase(macro->Tokens.begin());
+		}
+
+		macro->Path = boost::algorithm::join(macro->Tokens, ".");
+
+		tmpl->Parts.emplace_back(MacroTemplate::Part{String(), std::move(macro)});
+		offset = pos_second + 1;
+	}
+
+	if (!tmpl->Unterminated && offset < str.GetLength()) {
+		tmpl->Parts.emplace_back(MacroTemplate::Part{str.SubStr(offset), nullptr});
+	}
 
-	String objName;
-	if (tokens.size() > 1) {
-		objName = tokens[0];
-		tokens.erase(tokens.begin());
+	if (cache.size() >= 4096u) {
+		cache.clear();
 	}
 
+	cache.emplace(str, tmpl);
+
+	return tmpl;
+}
+
+bool MacroProcessor::ResolveMacro(const MacroName& macroName, const ResolverList& resolvers,
+	const CheckResult::Ptr& cr, Value *result, bool *recursive_macro)
+{
+	auto& macro (macroName.Name);
+	auto& objName (macroName.ObjName);
+	auto& tokens (macroName.Tokens);
+
+	CONTEXT("Resolving macro '" << macro << "'");
+
+	*recursive_macro = false;
+
 	const auto defaultResolvers (GetDefaultResolvers());
 
 	for (auto resolverList : {&resolvers, &defaultResolvers}) {
@@ -133,7 +217,7 @@ bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resol
 
 			auto *mresolver = dynamic_cast<MacroResolver *>(resolver.Obj.get());
 
-			if (mresolver && mresolver->ResolveMacro(boost::algorithm::join(tokens, "."), cr, result))
+			if (mresolver && mresolver->ResolveMacro(macroName.Path, cr, result))
 				return true;
 
 			Value ref = resolver.Obj;
@@ -239,38 +323,38 @@ Value MacroProcessor::InternalResolveMacros(const String& str, const ResolverLis
 	if (recursionLevel > 15)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Infinite recursion detected while resolving macros"));
 
-	size_t offset, pos_first, pos_second;
-	offset = 0;
+	auto tmpl (CompileMacros(str));
 
-	Dictionary::Ptr resolvers_this;
+	if (tmpl->Parts.empty() && !tmpl->Unterminated)
+		return str;
 
-	String result = str;
-	while ((pos_first = result.FindFirstOf("$", offset)) != String::NPos) {
-		pos_second = result.FindFirstOf("$", pos_first + 1);
+	/* we're done if this is the only macro and there are no other non-macro parts in the string */
+	bool onlyMacro = tmpl->Parts.size() == 1u && tmpl->Parts[0].Macro && !tmpl->Unterminated;
+	String result;
 
-		if (pos_second == String::NPos)
-			BOOST_THROW_EXCEPTION(std::runtime_error("Closing $ not found in macro format string."));
+	for (auto& part : tmpl->Parts) {
+		if (!part.Macro) {
+			result += part.Literal;
+			continue;
+		}
 
-		String name = result.SubStr(pos_first + 1, pos_second - pos_first - 1);
+		auto& name (part.Macro->Name);
 
 		Value resolved_macro;
-		bool recursive_macro;
+		bool recursive_macro = false;
 		bool found;
 
-		if (useResolvedMacros) {
-			recursive_macro = false;
+		/* $$ is an escape sequence for $. */
+		if (name.IsEmpty()) {
+			resolved_macro = "$";
+			found = true;
+		} else if (useResolvedMacros) {
 			found = resolvedMacros->Contains(name);
 
 			if (found)
 				resolved_macro = resolvedMacros->Get(name);
 		} else
-			found = ResolveMacro(name, resolvers, cr, &resolved_macro, &recursive_macro);
-
-		/* $$ is an escape sequence for $. */
-		if (name.IsEmpty()) {
-			resolved_macro = "$";
-			found = true;
-		}
+			found = ResolveMacro(*part.Macro, resolvers, cr, &resolved_macro, &recursive_macro);
 
 		if (resolved_macro.IsObjectType<Function>()) {
 			resolved_macro = EvaluateFunction(resolved_macro, resolvers, cr, escapeFn,
@@ -288,10 +372,9 @@ Value MacroProcessor::InternalResolveMacros(const String& str, const ResolverLis
 		/* recursively resolve macros in the macro if it was a user macro */
 		if (recursive_macro) {
 			if (resolved_macro.IsObjectType<Array>()) {
-				Array::Ptr arr = resolved_macro;
+				Array::Ptr arr = static_cast<Array::Ptr>(resolved_macro)->Snapshot();
 				ArrayData resolved_arr;
 
-				ObjectLock olock(arr);
 				for (const Value& value : arr) {
 					if (value.IsScalar()) {
 						resolved_arr.push_back(InternalResolveMacros(value,
@@ -315,26 +398,19 @@ Value MacroProcessor::InternalResolveMacros(const String& str, const ResolverLis
 		if (escapeFn)
 			resolved_macro = escapeFn(resolved_macro);
 
-		/* we're done if this is the only macro and there are no other non-macro parts in the string */
-		if (pos_first == 0 && pos_second == str.GetLength() - 1)
+		if (onlyMacro)
 			return resolved_macro;
-		else if (resolved_macro.IsObjectType<Array>())
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
-
-		if (resolved_macro.IsObjectType<Array>()) {
-			/* don't allow mixing strings and arrays in macro strings */
-			if (pos_first != 0 || pos_second != str.GetLength() - 1)
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
 
-			return resolved_macro;
-		}
+		/* don't allow mixing strings and arrays in macro strings */
+		if (resolved_macro.IsObjectType<Array>())
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
 
-		String resolved_macro_str = resolved_macro;
-
-		result.Replace(pos_first, pos_second - pos_first + 1, resolved_macro_str);
-		offset = pos_first + resolved_macro_str.GetLength();
+		result += static_cast<String>(resolved_macro);
 	}
 
+	if (tmpl->Unterminated)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Closing $ not found in macro format string."));
+
 	return result;
 }
 
@@ -472,8 +548,10 @@ Value MacroProcessor::ResolveArguments(const Value& command, const Dictionary::P
 	if (arguments) {
 		std::vector<CommandArgument> args;
 
-		ObjectLock olock(arguments);
-		for (const Dictionary::Pair& kv : arguments) {
+		/* The arguments' macros may run functions, so don't hold the lock meanwhile. */
+		Dictionary::Ptr argumentsSnapshot = arguments->Snapshot();
+
+		for (const Dictionary::Pair& kv : argumentsSnapshot) {
 			const Value& arginfo = kv.second;
 
 			CommandArgument arg;
@@ -6,6 +6,7 @@
 #include "icinga/i2-icinga.hpp"
 #include "icinga/checkable.hpp"
 #include "base/value.hpp"
+#include <memory>
 #include <vector>
 #include <utility>
 
@@ -53,7 +54,11 @@ public:
 private:
 	MacroProcessor();
 
-	static bool ResolveMacro(const String& macro, const ResolverList& resolvers,
+	struct MacroName;
+	struct MacroTemplate;
+
+	static std::shared_ptr<const MacroTemplate> CompileMacros(const String& str);
+	static bool ResolveMacro(const MacroName& macro, const ResolverList& resolvers,
 		const CheckResult::Ptr& cr, Value *result, bool *recursive_macro);
 	static Value InternalResolveMacros(const String& str,
 		const ResolverList& resolvers, const CheckResult::Ptr& cr,
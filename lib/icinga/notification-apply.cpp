@@ -143,6 +143,11 @@ void Notification::EvaluateApplyRules(const Host::Ptr& host)
 		if (EvaluateApplyRule(host, *rule, true))
 			rule->AddMatch();
 	}
+
+	for (auto& rule : ApplyRule::GetIndexedRules(Notification::TypeInstance, Host::TypeInstance, host->GetName(), host->GetGroups(), host->GetVars())) {
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
+	}
 }
 
 void Notification::EvaluateApplyRules(const Service::Ptr& service)
@@ -158,4 +163,11 @@ void Notification::EvaluateApplyRules(const Service::Ptr& service)
 		if (EvaluateApplyRule(service, *rule, true))
 			rule->AddMatch();
 	}
+
+	Host::Ptr host = service->GetHost();
+
+	for (auto& rule : ApplyRule::GetIndexedRules(Notification::TypeInstance, Service::TypeInstance, host->GetName(), host->GetGroups(), host->GetVars())) {
+		if (EvaluateApplyRule(service, *rule))
+			rule->AddMatch();
+	}
 }
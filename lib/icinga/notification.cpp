@@ -13,6 +13,7 @@
 #include "base/initialize.hpp"
 #include "base/scriptglobal.hpp"
 #include <algorithm>
+#include <unordered_set>
 
 using namespace icinga;
 
@@ -22,6 +23,8 @@ INITIALIZE_ONCE(&Notification::StaticInitialize);
 std::map<String, int> Notification::m_StateFilterMap;
 std::map<String, int> Notification::m_TypeFilterMap;
 
+std::atomic<uint_fast64_t> Notification::m_RecipientsEpochCounter (1);
+
 boost::signals2::signal<void (const Notification::Ptr&, const MessageOrigin::Ptr&)> Notification::OnNextNotificationChanged;
 boost::signals2::signal<void (const Notification::Ptr&, const String&, uint_fast8_t, const MessageOrigin::Ptr&)> Notification::OnLastNotifiedStatePerUserUpdated;
 boost::signals2::signal<void (const Notification::Ptr&, const MessageOrigin::Ptr&)> Notification::OnLastNotifiedStatePerUserCleared;
@@ -98,6 +101,15 @@ void Notification::StaticInitialize()
 	m_TypeFilterMap["Recovery"] = NotificationRecovery;
 	m_TypeFilterMap["FlappingStart"] = NotificationFlappingStart;
 	m_TypeFilterMap["FlappingEnd"] = NotificationFlappingEnd;
+
+	Notification::OnUsersRawChanged.connect([](const Notification::Ptr&, const Value&) { InvalidateRecipients(); });
+	Notification::OnUserGroupsRawChanged.connect([](const Notification::Ptr&, const Value&) { InvalidateRecipients(); });
+
+	/* Users referenced by name may be created or deleted at runtime. */
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+		if (dynamic_cast<User *>(object.get()))
+			InvalidateRecipients();
+	});
 }
 
 void Notification::OnConfigLoaded()
@@ -208,6 +220,46 @@ std::set<UserGroup::Ptr> Notification::GetUserGroups() const
 	return result;
 }
 
+/**
+ * Returns the users and the members of the user groups, i.e. the users BeginExecuteNotification() considers.
+ *
+ * The list is cached until InvalidateRecipients() is called, which happens whenever the users or user groups
+ * of a notification or the members of a user group change.
+ */
+std::shared_ptr<const std::vector<User::Ptr>> Notification::GetRecipients() const
+{
+	auto epoch (m_RecipientsEpochCounter.load());
+
+	{
+		std::unique_lock<std::mutex> lock (m_RecipientsMutex);
+
+		if (m_Recipients && m_RecipientsEpoch == epoch)
+			return m_Recipients;
+	}
+
+	std::set<User::Ptr> allUsers = GetUsers();
+
+	for (const UserGroup::Ptr& ug : GetUserGroups()) {
+		std::set<User::Ptr> members = ug->GetMembers();
+		allUsers.insert(members.begin(), members.end());
+	}
+
+	auto recipients (std::make_shared<const std::vector<User::Ptr>>(allUsers.begin(), allUsers.end()));
+
+	std::unique_lock<std::mutex> lock (m_RecipientsMutex);
+
+	/* If something changed meanwhile, the next call builds the list again. */
+	m_Recipients = recipients;
+	m_RecipientsEpoch = epoch;
+
+	return recipients;
+}
+
+void Notification::InvalidateRecipients()
+{
+	m_RecipientsEpochCounter.fetch_add(1);
+}
+
 TimePeriod::Ptr Notification::GetPeriod() const
 {
 	return TimePeriod::GetByName(GetPeriodRaw());
@@ -399,20 +451,37 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 			SetLastProblemNotification(now);
 	}
 
-	std::set<User::Ptr> allUsers;
+	auto recipients (GetRecipients());
 
-	std::set<User::Ptr> users = GetUsers();
-	std::copy(users.begin(), users.end(), std::inserter(allUsers, allUsers.begin()));
+	UserFilterContext filterContext;
+	filterContext.Now = Utility::GetTime();
 
-	for (const UserGroup::Ptr& ug : GetUserGroups()) {
-		std::set<User::Ptr> members = ug->GetMembers();
-		std::copy(members.begin(), members.end(), std::inserter(allUsers, allUsers.begin()));
+	{
+		auto [host, service] = GetHostService(checkable);
+
+		if (service) {
+			filterContext.StateFilter = ServiceStateToFilter(service->GetState());
+			filterContext.StateName = NotificationServiceStateToString(service->GetState());
+		} else {
+			filterContext.StateFilter = HostStateToFilter(host->GetState());
+			filterContext.StateName = NotificationHostStateToString(host->GetState());
+		}
 	}
 
 	std::set<User::Ptr> allNotifiedUsers;
 	Array::Ptr notifiedProblemUsers = GetNotifiedProblemUsers();
 
-	for (const User::Ptr& user : allUsers) {
+	/* Array::Contains() is a linear search, so look up users notified for a problem in a set instead. */
+	std::unordered_set<String> notifiedProblemUserNames;
+
+	if (type == NotificationRecovery || type == NotificationAcknowledgement || type == NotificationProblem) {
+		ObjectLock olock (notifiedProblemUsers);
+
+		for (const String& name : notifiedProblemUsers)
+			notifiedProblemUserNames.emplace(name);
+	}
+
+	for (const User::Ptr& user : *recipients) {
 		String userName = user->GetName();
 
 		if (!user->GetEnableNotifications()) {
@@ -422,7 +491,7 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 			continue;
 		}
 
-		if (!CheckNotificationUserFilters(type, user, force, reminder)) {
+		if (!CheckNotificationUserFilters(type, user, force, reminder, filterContext)) {
 			Log(LogNotice, "Notification")
 				<< "Notification object '" << notificationName << "': Filters for user '" << userName << "' not matched. Not sending notification.";
 			continue;
@@ -430,7 +499,7 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 
 		/* on recovery, check if user was notified before */
 		if (type == NotificationRecovery) {
-			if (!notifiedProblemUsers->Contains(userName) && (NotificationProblem & user->GetTypeFilter())) {
+			if (!notifiedProblemUserNames.count(userName) && (NotificationProblem & user->GetTypeFilter())) {
 				Log(LogNotice, "Notification")
 					<< "Notification object '" << notificationName << "': We did not notify user '" << userName
 					<< "' (Problem types enabled) for a problem before. Not sending Recovery notification.";
@@ -440,7 +509,7 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 
 		/* on acknowledgement, check if user was notified before */
 		if (type == NotificationAcknowledgement) {
-			if (!notifiedProblemUsers->Contains(userName) && (NotificationProblem & user->GetTypeFilter())) {
+			if (!notifiedProblemUserNames.count(userName) && (NotificationProblem & user->GetTypeFilter())) {
 				Log(LogNotice, "Notification")
 					<< "Notification object '" << notificationName << "': We did not notify user '" << userName
 					<< "' (Problem types enabled) for a problem before. Not sending acknowledgement notification.";
@@ -488,7 +557,7 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 		}
 
 		/* store all notified users for later recovery checks */
-		if (type == NotificationProblem && !notifiedProblemUsers->Contains(userName))
+		if (type == NotificationProblem && notifiedProblemUserNames.emplace(userName).second)
 			notifiedProblemUsers->Add(userName);
 	}
 
@@ -500,7 +569,8 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 	Service::OnNotificationSentToAllUsers(this, checkable, allNotifiedUsers, type, cr, author, text, nullptr);
 }
 
-bool Notification::CheckNotificationUserFilters(NotificationType type, const User::Ptr& user, bool force, bool reminder)
+bool Notification::CheckNotificationUserFilters(NotificationType type, const User::Ptr& user, bool force, bool reminder,
+	UserFilterContext& context)
 {
 	String notificationName = GetName();
 	String userName = user->GetName();
@@ -508,12 +578,20 @@ bool Notification::CheckNotificationUserFilters(NotificationType type, const Use
 	if (!force) {
 		TimePeriod::Ptr tp = user->GetPeriod();
 
-		if (tp && !tp->IsInside(Utility::GetTime())) {
-			Log(LogNotice, "Notification")
-				<< "Not sending " << (reminder ? "reminder " : "") << "notifications for notification object '"
-				<< notificationName << " and user '" << userName
-				<< "': user period not in timeperiod '" << tp->GetName() << "'";
-			return false;
+		if (tp) {
+			/* Many users usually share a few time periods. */
+			auto period (context.Periods.find(tp.get()));
+
+			if (period == context.Periods.end())
+				period = context.Periods.emplace(tp.get(), tp->IsInside(context.Now)).first;
+
+			if (!period->second) {
+				Log(LogNotice, "Notification")
+					<< "Not sending " << (reminder ? "reminder " : "") << "notifications for notification object '"
+					<< notificationName << " and user '" << userName
+					<< "': user period not in timeperiod '" << tp->GetName() << "'";
+				return false;
+			}
 		}
 
 		unsigned long ftype = type;
@@ -536,21 +614,8 @@ bool Notification::CheckNotificationUserFilters(NotificationType type, const Use
 
 		/* check state filters it this is not a recovery notification */
 		if (type != NotificationRecovery) {
-			Checkable::Ptr checkable = GetCheckable();
-			Host::Ptr host;
-			Service::Ptr service;
-			tie(host, service) = GetHostService(checkable);
-
-			unsigned long fstate;
-			String stateStr;
-
-			if (service) {
-				fstate = ServiceStateToFilter(service->GetState());
-				stateStr = NotificationServiceStateToString(service->GetState());
-			} else {
-				fstate = HostStateToFilter(host->GetState());
-				stateStr = NotificationHostStateToString(host->GetState());
-			}
+			unsigned long fstate = context.StateFilter;
+			const String& stateStr = context.StateName;
 
 			Log(LogDebug, "Notification")
 				<< "User '" << userName << "' notification '" << notificationName
@@ -13,7 +13,12 @@
 #include "remote/endpoint.hpp"
 #include "remote/messageorigin.hpp"
 #include "base/array.hpp"
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace icinga
 {
@@ -74,6 +79,9 @@ public:
 	TimePeriod::Ptr GetPeriod() const;
 	std::set<User::Ptr> GetUsers() const;
 	std::set<UserGroup::Ptr> GetUserGroups() const;
+	std::shared_ptr<const std::vector<User::Ptr>> GetRecipients() const;
+
+	static void InvalidateRecipients();
 
 	void UpdateNotificationNumber();
 	void ResetNotificationNumber();
@@ -116,7 +124,26 @@ public:
 private:
 	ObjectImpl<Checkable>::Ptr m_Checkable;
 
-	bool CheckNotificationUserFilters(NotificationType type, const User::Ptr& user, bool force, bool reminder);
+	/**
+	 * What CheckNotificationUserFilters() needs to know about the checkable and the time periods, computed once
+	 * per BeginExecuteNotification() instead of once per user.
+	 */
+	struct UserFilterContext
+	{
+		double Now;
+		unsigned long StateFilter;
+		String StateName;
+		std::unordered_map<TimePeriod *, bool> Periods;
+	};
+
+	mutable std::mutex m_RecipientsMutex;
+	mutable std::shared_ptr<const std::vector<User::Ptr>> m_Recipients;
+	mutable uint_fast64_t m_RecipientsEpoch = 0;
+
+	static std::atomic<uint_fast64_t> m_RecipientsEpochCounter;
+
+	bool CheckNotificationUserFilters(NotificationType type, const User::Ptr& user, bool force, bool reminder,
+		UserFilterContext& context);
 
 	void ExecuteNotificationHelper(NotificationType type, const User::Ptr& user, const CheckResult::Ptr& cr, bool force, const String& author = "", const String& text = "");
 
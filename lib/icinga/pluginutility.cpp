@@ -10,13 +10,15 @@
 #include "base/objectlock.hpp"
 #include "base/exception.hpp"
 #include <boost/algorithm/string/trim.hpp>
+#include <boost/utility/string_view.hpp>
+#include <cctype>
 
 using namespace icinga;
 
 void PluginUtility::ExecuteCommand(const Command::Ptr& commandObj, const Checkable::Ptr& checkable,
 	const CheckResult::Ptr& cr, const MacroProcessor::ResolverList& macroResolvers,
 	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int timeout,
-	const std::function<void(const Value& commandLine, const ProcessResult&)>& callback)
+	const std::function<void(const Value& commandLine, const ProcessResult&)>& callback, const Executor& executor)
 {
 	Value raw_command = commandObj->GetCommandLine();
 	Dictionary::Ptr raw_arguments = commandObj->GetArguments();
@@ -74,6 +76,11 @@ void PluginUtility::ExecuteCommand(const Command::Ptr& commandObj, const Checkab
 	if (resolvedMacros && !useResolvedMacros)
 		return;
 
+	if (executor) {
+		executor(Process::PrepareCommand(command), envMacros, timeout, [callback, command](const ProcessResult& pr) { callback(command, pr); });
+		return;
+	}
+
 	Process::Ptr process = new Process(Process::PrepareCommand(command), envMacros);
 
 	process->SetTimeout(timeout);
@@ -126,50 +133,89 @@ std::pair<String, String> PluginUtility::ParseCheckOutput(const String& output)
 	return std::make_pair(text, perfdata);
 }
 
+/**
+ * Cuts the output (and long output) of a plugin after maxLength bytes, but not within a UTF-8 sequence,
+ * and marks it as truncated.
+ *
+ * @param output The output without the performance data
+ * @param maxLength The maximum length in bytes, 0 for no limit
+ * @return The output, truncated if it was longer than maxLength
+ */
+String PluginUtility::TruncateOutput(const String& output, size_t maxLength)
+{
+	if (!maxLength || output.GetLength() <= maxLength)
+		return output;
+
+	size_t length = maxLength;
+
+	/* Don't cut a multi-byte character apart, the continuation bytes are 10xxxxxx. */
+	while (length > 0 && (static_cast<unsigned char>(output[length]) & 0xC0u) == 0x80u)
+		length--;
+
+	return output.SubStr(0, length) + "\n... (output truncated)";
+}
+
 Array::Ptr PluginUtility::SplitPerfdata(const String& perfdata)
 {
 	ArrayData result;
 
+	/* Scan the output in place and allocate just the resulting strings. */
+	boost::string_view input (perfdata.CStr(), perfdata.GetLength());
 	size_t begin = 0;
 	String multi_prefix;
 
 	for (;;) {
-		size_t eqp = perfdata.FindFirstOf('=', begin);
+		size_t eqp = input.find('=', begin);
 
-		if (eqp == String::NPos)
+		if (eqp == input.npos)
 			break;
 
-		String label = perfdata.SubStr(begin, eqp - begin);
-		boost::algorithm::trim_left(label);
+		auto label (input.substr(begin, eqp - begin));
 
-		if (label.GetLength() > 2 && label[0] == '\'' && label[label.GetLength() - 1] == '\'')
-			label = label.SubStr(1, label.GetLength() - 2);
+		while (!label.empty() && std::isspace((unsigned char)label.front()))
+			label.remove_prefix(1);
 
-		size_t multi_index = label.RFind("::");
+		if (label.size() > 2 && label.front() == '\'' && label.back() == '\'')
+			label = label.substr(1, label.size() - 2);
 
-		if (multi_index != String::NPos)
-			multi_prefix = "";
+		size_t multi_index = label.rfind("::");
 
-		size_t spq = perfdata.FindFirstOf(' ', eqp);
+		if (multi_index != label.npos)
+			multi_prefix = "";
 
-		if (spq == String::NPos)
-			spq = perfdata.GetLength();
+		size_t spq = input.find(' ', eqp);
 
-		String value = perfdata.SubStr(eqp + 1, spq - eqp - 1);
+		if (spq == input.npos)
+			spq = input.size();
 
-		if (!multi_prefix.IsEmpty())
-			label = multi_prefix + "::" + label;
+		auto value (input.substr(eqp + 1, spq - eqp - 1));
 
 		String pdv;
-		if (label.FindFirstOf(" ") != String::NPos)
-			pdv = "'" + label + "'=" + value;
-		else
-			pdv = label + "=" + value;
+		auto& out (pdv.GetData());
+		bool quote = label.find(' ') != label.npos || multi_prefix.FindFirstOf(" ") != String::NPos;
+
+		out.reserve(multi_prefix.GetLength() + label.size() + value.size() + 5u);
+
+		if (quote)
+			out += '\'';
+
+		if (!multi_prefix.IsEmpty()) {
+			out += multi_prefix.GetData();
+			out += "::";
+		}
+
+		out.append(label.data(), label.size());
+
+		if (quote)
+			out += '\'';
+
+		out += '=';
+		out.append(value.data(), value.size());
 
 		result.emplace_back(std::move(pdv));
 
-		if (multi_index != String::NPos)
-			multi_prefix = label.SubStr(0, multi_index);
+		if (multi_index != label.npos)
+			multi_prefix = String(label.begin(), label.begin() + multi_index);
 
 		begin = spq + 1;
 	}
@@ -7,13 +7,12 @@
 #include "icinga/checkable.hpp"
 #include "icinga/checkcommand.hpp"
 #include "icinga/macroprocessor.hpp"
+#include "base/process.hpp"
 #include <vector>
 
 namespace icinga
 {
 
-struct ProcessResult;
-
 /**
  * Utility functions for plugin-based checks.
  *
@@ -22,13 +21,21 @@ struct ProcessResult;
 class PluginUtility
 {
 public:
+	/**
+	 * Runs a resolved command line with the resolved environment and calls back with the result.
+	 */
+	typedef std::function<void(const Process::Arguments& arguments, const Dictionary::Ptr& env, int timeout,
+		const std::function<void(const ProcessResult&)>& callback)> Executor;
+
 	static void ExecuteCommand(const Command::Ptr& commandObj, const Checkable::Ptr& checkable,
 		const CheckResult::Ptr& cr, const MacroProcessor::ResolverList& macroResolvers,
 		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int timeout,
-		const std::function<void(const Value& commandLine, const ProcessResult&)>& callback = std::function<void(const Value& commandLine, const ProcessResult&)>());
+		const std::function<void(const Value& commandLine, const ProcessResult&)>& callback = std::function<void(const Value& commandLine, const ProcessResult&)>(),
+		const Executor& executor = Executor());
 
 	static ServiceState ExitStatusToState(int exitStatus);
 	static std::pair<String, String> ParseCheckOutput(const String& output);
+	static String TruncateOutput(const String& output, size_t maxLength);
 
 	static Array::Ptr SplitPerfdata(const String& perfdata);
 	static String FormatPerfdata(const Array::Ptr& perfdata, bool normalize = false);
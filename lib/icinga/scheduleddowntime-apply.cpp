@@ -141,6 +141,11 @@ void ScheduledDowntime::EvaluateApplyRules(const Host::Ptr& host)
 		if (EvaluateApplyRule(host, *rule, true))
 			rule->AddMatch();
 	}
+
+	for (auto& rule : ApplyRule::GetIndexedRules(ScheduledDowntime::TypeInstance, Host::TypeInstance, host->GetName(), host->GetGroups(), host->GetVars())) {
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
+	}
 }
 
 void ScheduledDowntime::EvaluateApplyRules(const Service::Ptr& service)
@@ -156,4 +161,11 @@ void ScheduledDowntime::EvaluateApplyRules(const Service::Ptr& service)
 		if (EvaluateApplyRule(service, *rule, true))
 			rule->AddMatch();
 	}
+
+	Host::Ptr host = service->GetHost();
+
+	for (auto& rule : ApplyRule::GetIndexedRules(ScheduledDowntime::TypeInstance, Service::TypeInstance, host->GetName(), host->GetGroups(), host->GetVars())) {
+		if (EvaluateApplyRule(service, *rule))
+			rule->AddMatch();
+	}
 }
@@ -16,7 +16,9 @@
 #include "base/logger.hpp"
 #include "base/exception.hpp"
 #include <boost/thread/once.hpp>
+#include <mutex>
 #include <set>
+#include <vector>
 
 using namespace icinga;
 
@@ -24,6 +26,9 @@ REGISTER_TYPE(ScheduledDowntime);
 
 static Timer::Ptr l_Timer;
 
+static std::mutex l_EvaluationsMutex;
+static std::set<std::pair<double, ScheduledDowntime::Ptr>> l_Evaluations; /**< Active objects, by when TimerProc() has to look at them */
+
 String ScheduledDowntimeNameComposer::MakeName(const String& shortName, const Object::Ptr& context) const
 {
 	ScheduledDowntime::Ptr downtime = dynamic_pointer_cast<ScheduledDowntime>(context);
@@ -86,18 +91,85 @@ void ScheduledDowntime::Start(bool runtimeCreated)
 
 	if (!IsPaused())
 		Utility::QueueAsyncCallback([this]() { CreateNextDowntime(); });
+
+	ScheduleEvaluation();
+}
+
+void ScheduledDowntime::Stop(bool runtimeRemoved)
+{
+	UnscheduleEvaluation();
+
+	ObjectImpl<ScheduledDowntime>::Stop(runtimeRemoved);
+}
+
+void ScheduledDowntime::Resume()
+{
+	ObjectImpl<ScheduledDowntime>::Resume();
+
+	/* TimerProc() drops paused objects. */
+	ScheduleEvaluation();
 }
 
+/**
+ * Lets TimerProc() check for the next downtime to create and obsolete ones to remove.
+ *
+ * @param when Not before this time, 0 for the next run
+ */
+void ScheduledDowntime::ScheduleEvaluation(double when)
+{
+	std::unique_lock<std::mutex> lock (l_EvaluationsMutex);
+
+	if (m_EvaluationScheduled)
+		l_Evaluations.erase({ m_NextEvaluation, this });
+
+	m_EvaluationScheduled = true;
+	m_NextEvaluation = when;
+	l_Evaluations.emplace(when, this);
+}
+
+void ScheduledDowntime::UnscheduleEvaluation()
+{
+	std::unique_lock<std::mutex> lock (l_EvaluationsMutex);
+
+	if (m_EvaluationScheduled) {
+		l_Evaluations.erase({ m_NextEvaluation, this });
+		m_EvaluationScheduled = false;
+	}
+}
+
+/**
+ * Evaluates the objects whose next downtime has started, i.e. which need a new one.
+ */
 void ScheduledDowntime::TimerProc()
 {
-	for (const ScheduledDowntime::Ptr& sd : ConfigType::GetObjectsByType<ScheduledDowntime>()) {
+	std::vector<ScheduledDowntime::Ptr> due;
+
+	{
+		std::unique_lock<std::mutex> lock (l_EvaluationsMutex);
+		auto now (Utility::GetTime());
+
+		while (!l_Evaluations.empty() && l_Evaluations.begin()->first <= now) {
+			auto& sd (l_Evaluations.begin()->second);
+
+			sd->m_EvaluationScheduled = false;
+			due.emplace_back(sd);
+
+			l_Evaluations.erase(l_Evaluations.begin());
+		}
+	}
+
+	for (const ScheduledDowntime::Ptr& sd : due) {
 		if (sd->IsActive() && !sd->IsPaused()) {
+			double next;
+
 			try {
-				sd->CreateNextDowntime();
+				next = sd->CreateNextDowntime();
 			} catch (const std::exception& ex) {
 				Log(LogCritical, "ScheduledDowntime")
 					<< "Exception occurred during creation of next downtime for scheduled downtime '"
 					<< sd->GetName() << "': " << DiagnosticInformation(ex, false);
+
+				sd->ScheduleEvaluation();
 				continue;
 			}
 
@@ -108,6 +180,8 @@ void ScheduledDowntime::TimerProc()
 					<< "Exception occurred during removal of obsolete downtime for scheduled downtime '"
 					<< sd->GetName() << "': " << DiagnosticInformation(ex, false);
 			}
+
+			sd->ScheduleEvaluation(next);
 		}
 	}
 }
@@ -239,13 +313,18 @@ std::pair<double, double> ScheduledDowntime::FindNextSegment()
 	return std::make_pair(0, 0);
 }
 
-void ScheduledDowntime::CreateNextDowntime()
+/**
+ * Creates the next downtime unless there's an owned one which hasn't started yet.
+ *
+ * @return The start time of the owned downtime which hasn't started yet, 0 if there's none
+ */
+double ScheduledDowntime::CreateNextDowntime()
 {
 	/* HA enabled zones. */
 	if (IsActive() && IsPaused()) {
 		Log(LogNotice, "Checkable")
 			<< "Skipping downtime creation for HA-paused Scheduled Downtime object '" << GetName() << "'";
-		return;
+		return 0;
 	}
 
 	double minEnd = 0;
@@ -267,7 +346,7 @@ void ScheduledDowntime::CreateNextDowntime()
 			continue;
 
 		/* We've found a downtime that is owned by us and that hasn't started yet - we're done. */
-		return;
+		return downtime->GetStartTime();
 	}
 
 	Log(LogDebug, "ScheduledDowntime")
@@ -277,7 +356,7 @@ void ScheduledDowntime::CreateNextDowntime()
 	if (segment.first == 0 && segment.second == 0) {
 		segment = FindNextSegment();
 		if (segment.first == 0 && segment.second == 0)
-			return;
+			return 0;
 	}
 
 	Downtime::Ptr downtime = Downtime::AddDowntime(GetCheckable(), GetAuthor(), GetComment(),
@@ -297,17 +376,23 @@ void ScheduledDowntime::CreateNextDowntime()
 		Log(LogNotice, "ScheduledDowntime")
 				<< "Processing child options " << childOptions << " for downtime " << downtimeName;
 
+		std::vector<NewConfigObject> childDowntimes;
+
 		for (const Checkable::Ptr& child : GetCheckable()->GetAllChildren()) {
 			Log(LogNotice, "ScheduledDowntime")
 				<< "Scheduling downtime for child object " << child->GetName();
 
-			Downtime::Ptr childDowntime = Downtime::AddDowntime(child, GetAuthor(), GetComment(),
-				segment.first, segment.second, GetFixed(), triggerName, GetDuration(), GetName(), GetName());
+			childDowntimes.emplace_back(Downtime::MakeDowntime(child, GetAuthor(), GetComment(),
+				segment.first, segment.second, GetFixed(), triggerName, GetDuration(), GetName(), GetName()));
+		}
 
+		for (const Downtime::Ptr& childDowntime : Downtime::AddDowntimes(childDowntimes)) {
 			Log(LogNotice, "ScheduledDowntime")
 				<< "Add child downtime '" << childDowntime->GetName() << "'.";
 		}
 	}
+
+	return segment.first < Utility::GetTime() ? 0 : segment.first;
 }
 
 void ScheduledDowntime::RemoveObsoleteDowntimes()
@@ -37,16 +37,26 @@ public:
 	void ValidateChildOptions(const Lazy<Value>& lvalue, const ValidationUtils& utils) override;
 	String HashDowntimeOptions();
 
+	void ScheduleEvaluation(double when = 0);
+
 protected:
 	void OnAllConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
+	void Resume() override;
 
 private:
+	/* Protected by the evaluations mutex, see ScheduleEvaluation() */
+	bool m_EvaluationScheduled{false};
+	double m_NextEvaluation{0};
+
 	static void TimerProc();
 
+	void UnscheduleEvaluation();
+
 	std::pair<double, double> FindRunningSegment(double minEnd = 0);
 	std::pair<double, double> FindNextSegment();
-	void CreateNextDowntime();
+	double CreateNextDowntime();
 	void RemoveObsoleteDowntimes();
 
 	static std::atomic<bool> m_AllConfigLoaded;
@@ -130,4 +130,9 @@ void Service::EvaluateApplyRules(const Host::Ptr& host)
 		if (EvaluateApplyRule(host, *rule, true))
 			rule->AddMatch();
 	}
+
+	for (auto& rule : ApplyRule::GetIndexedRules(Service::TypeInstance, Host::TypeInstance, host->GetName(), host->GetGroups(), host->GetVars())) {
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
+	}
 }
@@ -50,13 +50,19 @@ void ServiceGroup::EvaluateObjectRules(const Service::Ptr& service)
 {
 	CONTEXT("Evaluating group membership for service '" << service->GetName() << "'");
 
-	for (const ConfigItem::Ptr& group : ConfigItem::GetItems(ServiceGroup::TypeInstance))
-	{
-		if (!group->GetFilter())
-			continue;
-
-		EvaluateObjectRule(service, group);
+	Host::Ptr host = service->GetHost();
+	String hostName;
+	Array::Ptr hostGroups;
+	Dictionary::Ptr hostVars;
+
+	if (host) {
+		hostName = host->GetName();
+		hostGroups = host->GetGroups();
+		hostVars = host->GetVars();
 	}
+
+	ObjectRule::EvaluateGroupRules(ServiceGroup::TypeInstance, hostName, hostGroups, hostVars, false,
+		[&service](const ConfigItem::Ptr& group) { return EvaluateObjectRule(service, group); });
 }
 
 std::set<Service::Ptr> ServiceGroup::GetMembers() const
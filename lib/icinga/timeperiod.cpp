@@ -10,6 +10,7 @@
 #include "base/timer.hpp"
 #include "base/utility.hpp"
 #include <boost/thread/once.hpp>
+#include <algorithm>
 
 using namespace icinga;
 
@@ -38,6 +39,9 @@ void TimePeriod::Start(bool runtimeCreated)
 #endif /* _DEBUG */
 }
 
+/**
+ * Adds a segment, merging it with all segments it overlaps or touches.
+ */
 void TimePeriod::AddSegment(double begin, double end)
 {
 	ASSERT(OwnsLock());
@@ -52,46 +56,27 @@ void TimePeriod::AddSegment(double begin, double end)
 	if (GetValidEnd().IsEmpty() || end > GetValidEnd())
 		SetValidEnd(end);
 
-	Array::Ptr segments = GetSegments();
-
-	if (segments) {
-		/* Try to merge the new segment into an existing segment. */
-		ObjectLock dlock(segments);
-		for (const Dictionary::Ptr& segment : segments) {
-			if (segment->Get("begin") <= begin && segment->Get("end") >= end)
-				return; /* New segment is fully contained in this segment. */
-
-			if (segment->Get("begin") >= begin && segment->Get("end") <= end) {
-				segment->Set("begin", begin);
-				segment->Set("end", end); /* Extend an existing segment to both sides */
-				return;
-			}
-
-			if (segment->Get("end") >= begin && segment->Get("end") <= end) {
-				segment->Set("end", end); /* Extend an existing segment to right. */
-				return;
-			}
+	if (begin >= end)
+		return;
 
-			if (segment->Get("begin") >= begin && segment->Get("begin") <= end) {
-				segment->Set("begin", begin); /* Extend an existing segment to left. */
-				return;
-			}
+	/* The first segment which doesn't end before the new one begins. */
+	auto first (std::lower_bound(m_Segments.begin(), m_Segments.end(), begin,
+		[](const Segment& segment, double begin) { return segment.second < begin; }));
+	auto last (first);
 
-		}
+	for (; last != m_Segments.end() && last->first <= end; ++last) {
+		begin = std::min(begin, last->first);
+		end = std::max(end, last->second);
 	}
 
-	/* Create new segment if we weren't able to merge this into an existing segment. */
-	Dictionary::Ptr segment = new Dictionary({
-		{ "begin", begin },
-		{ "end", end }
-	});
-
-	if (!segments) {
-		segments = new Array();
-		SetSegments(segments);
+	if (first == last) {
+		m_Segments.emplace(first, begin, end);
+	} else {
+		*first = Segment(begin, end);
+		m_Segments.erase(first + 1, last);
 	}
 
-	segments->Add(segment);
+	MarkStateDirty();
 }
 
 void TimePeriod::AddSegment(const Dictionary::Ptr& segment)
@@ -99,6 +84,9 @@ void TimePeriod::AddSegment(const Dictionary::Ptr& segment)
 	AddSegment(segment->Get("begin"), segment->Get("end"));
 }
 
+/**
+ * Removes the range from all segments, splitting those which contain it.
+ */
 void TimePeriod::RemoveSegment(double begin, double end)
 {
 	ASSERT(OwnsLock());
@@ -113,53 +101,30 @@ void TimePeriod::RemoveSegment(double begin, double end)
 	if (GetValidEnd().IsEmpty() || end > GetValidEnd())
 		SetValidEnd(end);
 
-	Array::Ptr segments = GetSegments();
-
-	if (!segments)
+	if (begin >= end)
 		return;
 
-	Array::Ptr newSegments = new Array();
+	/* The first segment which ends after the range begins. */
+	auto first (std::lower_bound(m_Segments.begin(), m_Segments.end(), begin,
+		[](const Segment& segment, double begin) { return segment.second <= begin; }));
+	auto last (first);
+	std::vector<Segment> remainders;
 
-	/* Try to split or adjust an existing segment. */
-	ObjectLock dlock(segments);
-	for (const Dictionary::Ptr& segment : segments) {
-		/* Fully contained in the specified range? */
-		if (segment->Get("begin") >= begin && segment->Get("end") <= end)
-			// Don't add the old segment, because the segment is fully contained into our range
-			continue;
+	for (; last != m_Segments.end() && last->first < end; ++last) {
+		if (last->first < begin)
+			remainders.emplace_back(last->first, begin);
 
-		/* Not overlapping at all? */
-		if (segment->Get("end") < begin || segment->Get("begin") > end) {
-			newSegments->Add(segment);
-			continue;
-		}
-
-		/* Cut between */
-		if (segment->Get("begin") < begin && segment->Get("end") > end) {
-			newSegments->Add(new Dictionary({
-				{ "begin", segment->Get("begin") },
-				{ "end", begin }
-			}));
-
-			newSegments->Add(new Dictionary({
-				{ "begin", end },
-				{ "end", segment->Get("end") }
-			}));
-			// Don't add the old segment, because we have now two new segments and a gap between
-			continue;
-		}
-
-		/* Adjust the begin/end timestamps so as to not overlap with the specified range. */
-		if (segment->Get("begin") > begin && segment->Get("begin") < end)
-			segment->Set("begin", end);
+		if (last->second > end)
+			remainders.emplace_back(end, last->second);
+	}
 
-		if (segment->Get("end") > begin && segment->Get("end") < end)
-			segment->Set("end", begin);
+	if (first == last)
+		return;
 
-		newSegments->Add(segment);
-	}
+	first = m_Segments.erase(first, last);
+	m_Segments.insert(first, remainders.begin(), remainders.end());
 
-	SetSegments(newSegments);
+	MarkStateDirty();
 
 #ifdef _DEBUG
 	Dump();
@@ -184,21 +149,14 @@ void TimePeriod::PurgeSegments(double end)
 
 	SetValidBegin(end);
 
-	Array::Ptr segments = GetSegments();
-
-	if (!segments)
-		return;
-
-	Array::Ptr newSegments = new Array();
-
 	/* Remove old segments. */
-	ObjectLock dlock(segments);
-	for (const Dictionary::Ptr& segment : segments) {
-		if (segment->Get("end") >= end)
-			newSegments->Add(segment);
-	}
+	auto last (std::lower_bound(m_Segments.begin(), m_Segments.end(), end,
+		[](const Segment& segment, double end) { return segment.second < end; }));
 
-	SetSegments(newSegments);
+	if (last != m_Segments.begin()) {
+		m_Segments.erase(m_Segments.begin(), last);
+		MarkStateDirty();
+	}
 }
 
 void TimePeriod::Merge(const TimePeriod::Ptr& timeperiod, bool include)
@@ -207,14 +165,16 @@ void TimePeriod::Merge(const TimePeriod::Ptr& timeperiod, bool include)
 		<< "Merge TimePeriod '" << GetName() << "' with '" << timeperiod->GetName() << "' "
 		<< "Method: " << (include ? "include" : "exclude");
 
-	Array::Ptr segments = timeperiod->GetSegments();
+	std::vector<Segment> segments;
 
-	if (segments) {
-		ObjectLock dlock(segments);
-		ObjectLock ilock(this);
-		for (const Dictionary::Ptr& segment : segments) {
-			include ? AddSegment(segment) : RemoveSegment(segment);
-		}
+	{
+		ObjectLock olock(timeperiod);
+		segments = timeperiod->m_Segments;
+	}
+
+	ObjectLock olock(this);
+	for (auto& segment : segments) {
+		include ? AddSegment(segment.first, segment.second) : RemoveSegment(segment.first, segment.second);
 	}
 }
 
@@ -222,7 +182,8 @@ void TimePeriod::UpdateRegion(double begin, double end, bool clearExisting)
 {
 	if (clearExisting) {
 		ObjectLock olock(this);
-		SetSegments(new Array());
+		m_Segments.clear();
+		MarkStateDirty();
 	} else {
 		if (begin < GetValidEnd())
 			begin = GetValidEnd();
@@ -286,39 +247,80 @@ bool TimePeriod::IsInside(double ts) const
 	if (GetValidBegin().IsEmpty() || ts < GetValidBegin() || GetValidEnd().IsEmpty() || ts > GetValidEnd())
 		return true; /* Assume that all invalid regions are "inside". */
 
-	Array::Ptr segments = GetSegments();
+	/* The last segment beginning before ts is the only one which can contain it. */
+	auto next (std::upper_bound(m_Segments.begin(), m_Segments.end(), ts,
+		[](double ts, const Segment& segment) { return ts <= segment.first; }));
 
-	if (segments) {
-		ObjectLock dlock(segments);
-		for (const Dictionary::Ptr& segment : segments) {
-			if (ts > segment->Get("begin") && ts < segment->Get("end"))
-				return true;
-		}
-	}
-
-	return false;
+	return next != m_Segments.begin() && ts < (next - 1)->second;
 }
 
 double TimePeriod::FindNextTransition(double begin)
 {
 	ObjectLock olock(this);
 
-	Array::Ptr segments = GetSegments();
+	/* The segments don't overlap, so their boundaries are sorted as well. */
+	auto next (std::upper_bound(m_Segments.begin(), m_Segments.end(), begin,
+		[](double begin, const Segment& segment) { return begin < segment.second; }));
 
-	double closestTransition = -1;
+	if (next == m_Segments.end())
+		return -1;
 
-	if (segments) {
-		ObjectLock dlock(segments);
-		for (const Dictionary::Ptr& segment : segments) {
-			if (segment->Get("begin") > begin && (segment->Get("begin") < closestTransition || closestTransition == -1))
-				closestTransition = segment->Get("begin");
+	return next->first > begin ? next->first : next->second;
+}
 
-			if (segment->Get("end") > begin && (segment->Get("end") < closestTransition || closestTransition == -1))
-				closestTransition = segment->Get("end");
+Array::Ptr TimePeriod::GetSegments() const
+{
+	ObjectLock olock(this);
+	ArrayData segments;
+
+	segments.reserve(m_Segments.size());
+
+	for (auto& segment : m_Segments) {
+		segments.emplace_back(new Dictionary({
+			{ "begin", segment.first },
+			{ "end", segment.second }
+		}));
+	}
+
+	return new Array(std::move(segments));
+}
+
+/**
+ * Replaces the segments, e.g. when restoring them from the state file.
+ */
+void TimePeriod::SetSegments(const Array::Ptr& value, bool suppress_events, const Value& cookie)
+{
+	std::vector<Segment> segments;
+
+	if (value) {
+		ObjectLock olock(value);
+		for (const Dictionary::Ptr& segment : value) {
+			double begin = segment->Get("begin");
+			double end = segment->Get("end");
+
+			if (begin < end)
+				segments.emplace_back(begin, end);
+		}
+	}
+
+	std::sort(segments.begin(), segments.end());
+
+	{
+		ObjectLock olock(this);
+		m_Segments.clear();
+
+		for (auto& segment : segments) {
+			if (!m_Segments.empty() && segment.first <= m_Segments.back().second)
+				m_Segments.back().second = std::max(m_Segments.back().second, segment.second);
+			else
+				m_Segments.emplace_back(segment);
 		}
 	}
 
-	return closestTransition;
+	MarkStateDirty();
+
+	if (!suppress_events)
+		NotifySegments(cookie);
 }
 
 void TimePeriod::UpdateTimerHandler()
@@ -349,8 +351,6 @@ void TimePeriod::Dump()
 {
 	ObjectLock olock(this);
 
-	Array::Ptr segments = GetSegments();
-
 	Log(LogDebug, "TimePeriod")
 		<< "Dumping TimePeriod '" << GetName() << "'";
 
@@ -358,13 +358,10 @@ void TimePeriod::Dump()
 		<< "Valid from '" << Utility::FormatDateTime("%c", GetValidBegin())
 		<< "' until '" << Utility::FormatDateTime("%c", GetValidEnd());
 
-	if (segments) {
-		ObjectLock dlock(segments);
-		for (const Dictionary::Ptr& segment : segments) {
-			Log(LogDebug, "TimePeriod")
-				<< "Segment: " << Utility::FormatDateTime("%c", segment->Get("begin")) << " <-> "
-				<< Utility::FormatDateTime("%c", segment->Get("end"));
-		}
+	for (auto& segment : m_Segments) {
+		Log(LogDebug, "TimePeriod")
+			<< "Segment: " << Utility::FormatDateTime("%c", segment.first) << " <-> "
+			<< Utility::FormatDateTime("%c", segment.second);
 	}
 
 	Log(LogDebug, "TimePeriod", "---");
@@ -5,6 +5,8 @@
 
 #include "icinga/i2-icinga.hpp"
 #include "icinga/timeperiod-ti.hpp"
+#include <utility>
+#include <vector>
 
 namespace icinga
 {
@@ -29,9 +31,17 @@ public:
 	bool IsInside(double ts) const;
 	double FindNextTransition(double begin);
 
+	Array::Ptr GetSegments() const override;
+	void SetSegments(const Array::Ptr& value, bool suppress_events = false, const Value& cookie = Empty) override;
+
 	void ValidateRanges(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils) override;
 
 private:
+	typedef std::pair<double, double> Segment;
+
+	/* Sorted, neither overlapping nor touching each other, protected by the object lock */
+	std::vector<Segment> m_Segments;
+
 	void AddSegment(double s, double end);
 	void AddSegment(const Dictionary::Ptr& segment);
 	void RemoveSegment(double begin, double end);
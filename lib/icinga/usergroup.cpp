@@ -67,14 +67,22 @@ void UserGroup::AddMember(const User::Ptr& user)
 {
 	user->AddGroup(GetName());
 
-	std::unique_lock<std::mutex> lock(m_UserGroupMutex);
-	m_Members.insert(user);
+	{
+		std::unique_lock<std::mutex> lock(m_UserGroupMutex);
+		m_Members.insert(user);
+	}
+
+	Notification::InvalidateRecipients();
 }
 
 void UserGroup::RemoveMember(const User::Ptr& user)
 {
-	std::unique_lock<std::mutex> lock(m_UserGroupMutex);
-	m_Members.erase(user);
+	{
+		std::unique_lock<std::mutex> lock(m_UserGroupMutex);
+		m_Members.erase(user);
+	}
+
+	Notification::InvalidateRecipients();
 }
 
 std::set<Notification::Ptr> UserGroup::GetNotifications() const
@@ -0,0 +1,255 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "icingadb/historyspool.hpp"
+#include "base/convert.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace icinga;
+
+HistorySpool::HistorySpool(SizeType bulkSize, Bulker<Query>::Duration threshold, SizeType memoryLimit)
+	: m_Memory(bulkSize, threshold), m_MemoryLimit(memoryLimit)
+{
+}
+
+/**
+ * Enable spilling to segment files in dir and pick up the ones left over there
+ *
+ * @param dir Directory for the segment files, created if necessary
+ */
+void HistorySpool::Open(const String& dir)
+{
+	std::unique_lock<std::mutex> lock (m_Mutex);
+	std::vector<uint_fast64_t> ids;
+
+	Utility::MkDirP(dir, 0700);
+	m_Dir = dir;
+
+	Utility::Glob(m_Dir + "/*.seg", [&ids](const String& path) {
+		String name = Utility::BaseName(path);
+
+		try {
+			ids.emplace_back(boost::lexical_cast<uint_fast64_t>(name.SubStr(0, name.GetLength() - 4u)));
+		} catch (const boost::bad_lexical_cast&) {
+			Log(LogWarning, "IcingaDB")
+				<< "Ignoring unexpected file '" << path << "' in history spool.";
+		}
+	}, GlobFile);
+
+	std::sort(ids.begin(), ids.end());
+
+	for (auto id : ids) {
+		Segment segment {id, 0, 0};
+		std::ifstream reader (GetSegmentPath(id).CStr(), std::ios::binary);
+		uint32_t args, length;
+
+		// Only the lengths are read to count the queries, the remainder is skipped.
+		while (reader.read((char*)&args, sizeof(args))) {
+			segment.Bytes += sizeof(args);
+
+			for (; args; --args) {
+				if (!reader.read((char*)&length, sizeof(length)) || !reader.seekg(length, std::ios::cur)) {
+					break;
+				}
+
+				segment.Bytes += sizeof(length) + length;
+			}
+
+			if (args) {
+				break;
+			}
+
+			++segment.Queries;
+		}
+
+		m_Segments.emplace_back(segment);
+		m_SpilledQueries += segment.Queries;
+		m_SpilledBytes += segment.Bytes;
+		m_NextSegmentId = id + 1u;
+	}
+
+	if (!m_Segments.empty()) {
+		Log(LogInformation, "IcingaDB")
+			<< "Replaying " << m_SpilledQueries.load() << " history queries spooled to '" << m_Dir << "' before.";
+	}
+}
+
+/**
+ * Queue query in memory or, if the memory limit was reached or older queries are on disk, append it to disk
+ *
+ * @param query Redis query
+ */
+void HistorySpool::ProduceOne(Query query)
+{
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	if (!m_Dir.IsEmpty() && (!m_Segments.empty() || m_Memory.Size() >= m_MemoryLimit)) {
+		try {
+			Spill(query);
+			return;
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "IcingaDB")
+				<< "Can't spool history query to '" << m_Dir << "', keeping it in memory: " << ex.what();
+		}
+	}
+
+	m_Memory.ProduceOne(std::move(query));
+}
+
+/**
+ * Append query to the newest segment
+ *
+ * m_Mutex must be locked.
+ *
+ * @param query Redis query
+ */
+void HistorySpool::Spill(const Query& query)
+{
+	if (!m_Writer.is_open()) {
+		Segment segment {m_NextSegmentId, 0, 0};
+		String path = GetSegmentPath(segment.Id);
+
+		m_Writer.open(path.CStr(), std::ios::binary | std::ios::trunc);
+
+		if (!m_Writer) {
+			m_Writer.close();
+			BOOST_THROW_EXCEPTION(std::runtime_error("Can't open '" + path + "' for writing"));
+		}
+
+		++m_NextSegmentId;
+		m_Segments.emplace_back(segment);
+	}
+
+	auto& segment (m_Segments.back());
+	uint32_t args = query.size();
+	uint_fast64_t bytes = sizeof(args);
+
+	m_Writer.write((const char*)&args, sizeof(args));
+
+	for (auto& arg : query) {
+		uint32_t length = arg.GetLength();
+
+		m_Writer.write((const char*)&length, sizeof(length));
+		m_Writer.write(arg.CStr(), length);
+
+		bytes += sizeof(length) + length;
+	}
+
+	m_Writer.flush();
+
+	if (!m_Writer) {
+		BOOST_THROW_EXCEPTION(std::runtime_error("Can't write to '" + GetSegmentPath(segment.Id) + "'"));
+	}
+
+	++segment.Queries;
+	segment.Bytes += bytes;
+	++m_SpilledQueries;
+	m_SpilledBytes += bytes;
+
+	if (segment.Queries >= m_Memory.GetBulkSize()) {
+		m_Writer.close();
+	}
+}
+
+/**
+ * Like Bulker#ConsumeMany(), but once the in-memory queries were consumed, consumes the oldest segment on disk
+ *
+ * @param fromDisk Whether to consume a segment at all, otherwise leave them for later
+ *
+ * @return The next queries, in order
+ */
+HistorySpool::Container HistorySpool::ConsumeMany(bool fromDisk)
+{
+	if (fromDisk) {
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		if (!m_Segments.empty() && !m_Memory.Size()) {
+			auto segment (m_Segments.front());
+
+			if (m_Segments.size() == 1u) {
+				m_Writer.close();
+			}
+
+			m_Segments.pop_front();
+			lock.unlock();
+
+			// Reading the segment doesn't block producers, they append to newer segments or, if none left, to memory.
+			return ReadSegment(segment);
+		}
+	}
+
+	return m_Memory.ConsumeMany();
+}
+
+/**
+ * Read a whole segment which has already been removed from m_Segments and delete its file
+ *
+ * @param segment The segment
+ *
+ * @return Its queries
+ */
+HistorySpool::Container HistorySpool::ReadSegment(const HistorySpool::Segment& segment)
+{
+	String path = GetSegmentPath(segment.Id);
+	Container queries;
+	std::ifstream reader (path.CStr(), std::ios::binary);
+	uint32_t args, length;
+
+	queries.reserve(segment.Queries);
+
+	while (reader.read((char*)&args, sizeof(args))) {
+		Query query;
+
+		query.reserve(args);
+
+		for (; args; --args) {
+			if (!reader.read((char*)&length, sizeof(length))) {
+				break;
+			}
+
+			std::string arg (length, '\0');
+
+			if (!reader.read(&arg[0], length)) {
+				break;
+			}
+
+			query.emplace_back(std::move(arg));
+		}
+
+		if (args) {
+			Log(LogWarning, "IcingaDB")
+				<< "Discarding truncated history query at the end of '" << path << "'.";
+			break;
+		}
+
+		queries.emplace_back(std::move(query));
+	}
+
+	reader.close();
+	Utility::Remove(path);
+
+	m_SpilledQueries -= segment.Queries;
+	m_SpilledBytes -= segment.Bytes;
+
+	return queries;
+}
+
+/**
+ * @return The amount of queries in memory and on disk
+ */
+HistorySpool::SizeType HistorySpool::Size()
+{
+	return m_Memory.Size() + m_SpilledQueries.load();
+}
+
+String HistorySpool::GetSegmentPath(uint_fast64_t id) const
+{
+	return m_Dir + "/" + Convert::ToString(id) + ".seg";
+}
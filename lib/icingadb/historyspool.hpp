@@ -0,0 +1,89 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef HISTORYSPOOL_H
+#define HISTORYSPOOL_H
+
+#include "icingadb/redisconnection.hpp"
+#include "base/bulker.hpp"
+#include "base/string.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+
+namespace icinga
+{
+
+/**
+ * Like Bulker<RedisConnection::Query>, but keeps at most a defined amount of queries in memory
+ * and appends the excess to segment files on disk. Queries are consumed in the order they were produced.
+ *
+ * Segments left over on disk (e.g. because Redis was down while shutting down) are consumed after the next start.
+ *
+ * @ingroup icingadb
+ */
+class HistorySpool
+{
+public:
+	typedef RedisConnection::Query Query;
+	typedef Bulker<Query>::Container Container;
+	typedef Bulker<Query>::SizeType SizeType;
+
+	HistorySpool(SizeType bulkSize, Bulker<Query>::Duration threshold, SizeType memoryLimit);
+
+	void Open(const String& dir);
+	void ProduceOne(Query query);
+	Container ConsumeMany(bool fromDisk = true);
+	SizeType Size();
+
+	inline SizeType GetBulkSize() const noexcept
+	{
+		return m_Memory.GetBulkSize();
+	}
+
+	inline SizeType GetMemoryQueries()
+	{
+		return m_Memory.Size();
+	}
+
+	inline SizeType GetSpilledQueries() const noexcept
+	{
+		return m_SpilledQueries.load();
+	}
+
+	inline uint_fast64_t GetSpilledBytes() const noexcept
+	{
+		return m_SpilledBytes.load();
+	}
+
+private:
+	struct Segment
+	{
+		uint_fast64_t Id;
+		SizeType Queries;
+		uint_fast64_t Bytes;
+	};
+
+	String GetSegmentPath(uint_fast64_t id) const;
+	void Spill(const Query& query);
+	Container ReadSegment(const Segment& segment);
+
+	Bulker<Query> m_Memory;
+	const SizeType m_MemoryLimit;
+
+	String m_Dir;
+	std::mutex m_Mutex;
+	// Oldest first, the last one is the one m_Writer appends to (if open)
+	std::deque<Segment> m_Segments;
+	std::ofstream m_Writer;
+	uint_fast64_t m_NextSegmentId = 0;
+
+	std::atomic<SizeType> m_SpilledQueries {0};
+	std::atomic<uint_fast64_t> m_SpilledBytes {0};
+};
+
+}
+
+#endif /* HISTORYSPOOL_H */
@@ -0,0 +1,176 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "icingadb/icingadb.hpp"
+#include "base/application.hpp"
+#include "base/configuration.hpp"
+#include "base/defer.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/objectlock.hpp"
+#include "base/serializer.hpp"
+#include "base/utility.hpp"
+#include "icinga/checkcommand.hpp"
+#include "icinga/eventcommand.hpp"
+#include "icinga/host.hpp"
+#include "icinga/hostgroup.hpp"
+#include "icinga/notificationcommand.hpp"
+#include "icinga/service.hpp"
+#include "icinga/servicegroup.hpp"
+#include "icinga/timeperiod.hpp"
+#include "icinga/user.hpp"
+#include "icinga/usergroup.hpp"
+
+using namespace icinga;
+
+/* Bump this whenever the Redis representation of objects changes within the same Icinga 2 version. */
+#define DUMP_CHECKSUMS_VERSION 1
+
+String IcingaDB::GetDumpChecksumsPath() const
+{
+	return Configuration::DataDir + "/icingadb-" + GetName() + ".checksums";
+}
+
+/**
+ * Whether the Redis representation of the objects of the given type only depends on the objects' config and so
+ * unchanged objects can be skipped in a config dump. Notably not the case for zones (depth is derived from the
+ * parents), endpoints (zone), notifications (users through user groups), downtimes and comments (runtime state).
+ */
+bool IcingaDB::IsIncrementallyDumpable(const Type::Ptr& type)
+{
+	return type == Host::TypeInstance || type == Service::TypeInstance || type == User::TypeInstance
+		|| type == HostGroup::TypeInstance || type == ServiceGroup::TypeInstance || type == UserGroup::TypeInstance
+		|| type == TimePeriod::TypeInstance || type == CheckCommand::TypeInstance
+		|| type == NotificationCommand::TypeInstance || type == EventCommand::TypeInstance;
+}
+
+/**
+ * Hashes everything the Redis representation of an object of an incrementally dumpable type is derived from.
+ * This is a lot cheaper than serializing the object and its relations for Redis.
+ */
+String IcingaDB::GetDumpFingerprint(const ConfigObject::Ptr& object)
+{
+	Array::Ptr input = new Array({ Serialize(object, FAConfig), object->GetOriginalAttributes() });
+
+	auto checkable (dynamic_pointer_cast<Checkable>(object));
+
+	if (checkable) {
+		// check_timeout falls back to the command's one.
+		input->Add(checkable->GetCheckCommand()->GetTimeout());
+	}
+
+	return HashValue(input);
+}
+
+/**
+ * Loads the checksums persisted by the last config dump and removes them from disk, so that they can't be trusted
+ * anymore if this dump is interrupted. Incompatible or unreadable checksums are ignored.
+ *
+ * @param dump Receives the objects per lower case type name
+ */
+void IcingaDB::LoadDumpChecksums(DumpedTypes& dump)
+{
+	String path = GetDumpChecksumsPath();
+
+	if (!Utility::PathExists(path)) {
+		return;
+	}
+
+	Defer removeChecksums ([&path]() { (void)unlink(path.CStr()); });
+
+	try {
+		Dictionary::Ptr content = Utility::LoadJsonFile(path);
+
+		if (content->Get("version") != DUMP_CHECKSUMS_VERSION || content->Get("icinga_version") != Application::GetAppVersion()
+			|| content->Get("environment_id") != m_EnvironmentId) {
+			Log(LogInformation, "IcingaDB")
+				<< "Ignoring config dump checksums from '" << path << "' written by another version or environment.";
+			return;
+		}
+
+		Dictionary::Ptr types = content->Get("types");
+		ObjectLock typesLock (types);
+
+		for (auto& type : types) {
+			Dictionary::Ptr typeContent = type.second;
+			auto& dumpedType (dump[type.first]);
+
+			dumpedType.CheckSums = typeContent->Get("checksums");
+
+			Dictionary::Ptr objects = typeContent->Get("objects");
+			ObjectLock objectsLock (objects);
+
+			for (auto& object : objects) {
+				Dictionary::Ptr objectContent = object.second;
+				auto& dumpedObject (dumpedType.Objects[object.first]);
+
+				dumpedObject.Fingerprint = objectContent->Get("fingerprint");
+
+				Dictionary::Ptr fields = objectContent->Get("fields");
+				ObjectLock fieldsLock (fields);
+
+				for (auto& key : fields) {
+					Array::Ptr keyFields = key.second;
+					ObjectLock keyFieldsLock (keyFields);
+					auto& dumpedFields (dumpedObject.Fields[key.first]);
+
+					dumpedFields.reserve(keyFields->GetLength());
+
+					for (auto& field : keyFields) {
+						dumpedFields.emplace_back(field);
+					}
+				}
+			}
+		}
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "IcingaDB")
+			<< "Ignoring unreadable config dump checksums from '" << path << "': " << DiagnosticInformation(ex, false);
+
+		dump.clear();
+	}
+}
+
+/**
+ * Persists the checksums of a completed config dump for the next one.
+ *
+ * @param dump The objects per lower case type name
+ */
+void IcingaDB::SaveDumpChecksums(const DumpedTypes& dump)
+{
+	Dictionary::Ptr types = new Dictionary();
+
+	for (auto& type : dump) {
+		Dictionary::Ptr objects = new Dictionary();
+
+		for (auto& object : type.second.Objects) {
+			Dictionary::Ptr fields = new Dictionary();
+
+			for (auto& key : object.second.Fields) {
+				fields->Set(key.first, Array::FromVector(key.second));
+			}
+
+			objects->Set(object.first, new Dictionary({
+				{ "fingerprint", object.second.Fingerprint },
+				{ "fields", fields }
+			}));
+		}
+
+		types->Set(type.first, new Dictionary({
+			{ "checksums", type.second.CheckSums },
+			{ "objects", objects }
+		}));
+	}
+
+	String path = GetDumpChecksumsPath();
+
+	try {
+		Utility::SaveJsonFile(path, 0600, new Dictionary({
+			{ "version", DUMP_CHECKSUMS_VERSION },
+			{ "icinga_version", Application::GetAppVersion() },
+			{ "environment_id", m_EnvironmentId },
+			{ "types", types }
+		}));
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "IcingaDB")
+			<< "Failed to persist config dump checksums to '" << path << "': " << DiagnosticInformation(ex, false);
+	}
+}
@@ -9,6 +9,7 @@
 #include "base/logger.hpp"
 #include "base/serializer.hpp"
 #include "base/shared.hpp"
+#include "base/taskgroup.hpp"
 #include "base/tlsutility.hpp"
 #include "base/initialize.hpp"
 #include "base/convert.hpp"
@@ -124,7 +125,7 @@ void IcingaDB::ConfigStaticInitialize()
 
 	Checkable::OnFlappingChange.connect(&IcingaDB::FlappingChangeHandler);
 
-	Checkable::OnNewCheckResult.connect([](const Checkable::Ptr& checkable, const CheckResult::Ptr&, const MessageOrigin::Ptr&) {
+	Checkable::OnNewCheckResult.connect("IcingaDB", [](const Checkable::Ptr& checkable, const CheckResult::Ptr&, const MessageOrigin::Ptr&) {
 		IcingaDB::NewCheckResultHandler(checkable);
 	});
 
@@ -185,9 +186,8 @@ void IcingaDB::UpdateAllConfigObjects()
 		SetOngoingDumpStart(0);
 	});
 
-	// Use a Workqueue to pack objects in parallel
-	WorkQueue upq(25000, Configuration::Concurrency, LogNotice);
-	upq.SetName("IcingaDB:ConfigDump");
+	// Pack the objects of all types in parallel, the tasks of the per-type groups share the same threads
+	TaskGroup upq ("IcingaDB:ConfigDump");
 
 	std::vector<Type::Ptr> types = GetTypes();
 
@@ -199,6 +199,40 @@ void IcingaDB::UpdateAllConfigObjects()
 		m_Rcon->UnsuppressQueryKind(Prio::CheckResult);
 	});
 
+	// What the previous dump wrote for the incrementally dumpable types and what this one writes.
+	DumpedTypes previousDump, dump;
+	LoadDumpChecksums(previousDump);
+
+	// Types whose previous dump is still in Redis, so only their changed objects have to be written.
+	std::set<Type*> incrementalTypes;
+
+	for (auto& type : types) {
+		auto ctype (dynamic_cast<ConfigType*>(type.get()));
+
+		if (!ctype || !IsIncrementallyDumpable(type)) {
+			continue;
+		}
+
+		String lcType = type->GetName().ToLower();
+
+		// Created upfront as the types are dumped in parallel.
+		dump[lcType];
+
+		auto previous (previousDump.find(lcType));
+
+		// An empty type is cheap to dump and would prevent the global keys from being cleaned up below.
+		if (previous == previousDump.end() || !previous->second.CheckSums) {
+			continue;
+		}
+
+		// Catches Redis having been flushed or restarted without persistence in the meantime.
+		double checkSums = m_Rcons.at(ctype)->GetResultOfQuery({"HLEN", m_PrefixConfigCheckSum + lcType}, Prio::Config);
+
+		if (checkSums == previous->second.CheckSums) {
+			incrementalTypes.emplace(type.get());
+		}
+	}
+
 	// Add a new type=* state=wip entry to the stream and remove all previous entries (MAXLEN 1).
 	m_Rcon->FireAndForgetQuery({"XADD", "icinga:dump", "MAXLEN", "1", "*", "key", "*", "state", "wip"}, Prio::Config);
 
@@ -208,7 +242,12 @@ void IcingaDB::UpdateAllConfigObjects()
 			m_PrefixConfigObject + "notes:url",
 			m_PrefixConfigObject + "icon:image",
 	};
-	DeleteKeys(m_Rcon, globalKeys, Prio::Config);
+
+	// Objects skipped by an incremental dump don't rewrite their global entries, so these have to stay.
+	if (incrementalTypes.empty()) {
+		DeleteKeys(m_Rcon, globalKeys, Prio::Config);
+	}
+
 	DeleteKeys(m_Rcon, {"icinga:nextupdate:host", "icinga:nextupdate:service"}, Prio::Config);
 	m_Rcon->Sync();
 
@@ -219,45 +258,54 @@ void IcingaDB::UpdateAllConfigObjects()
 		m_DumpedGlobals.IconImage.Reset();
 	});
 
-	upq.ParallelFor(types, false, [this](const Type::Ptr& type) {
+	upq.ParallelFor(types, false, [this, &globalKeys, &incrementalTypes, &previousDump, &dump](const Type::Ptr& type) {
 		String lcType = type->GetName().ToLower();
 		ConfigType *ctype = dynamic_cast<ConfigType *>(type.get());
 		if (!ctype)
 			return;
 
+		auto typeStartTime (Utility::GetTime());
 		auto& rcon (m_Rcons.at(ctype));
 
-		std::vector<String> keys = GetTypeOverwriteKeys(lcType);
-		DeleteKeys(rcon, keys, Prio::Config);
+		auto dumpedType (dump.find(lcType));
+		DumpedType* recordTo = dumpedType == dump.end() ? nullptr : &dumpedType->second;
+		DumpedType* previous = incrementalTypes.find(type.get()) == incrementalTypes.end() ? nullptr : &previousDump.at(lcType);
 
-		WorkQueue upqObjectType(25000, Configuration::Concurrency, LogNotice);
-		upqObjectType.SetName("IcingaDB:ConfigDump:" + lcType);
+		if (!previous) {
+			std::vector<String> keys = GetTypeOverwriteKeys(lcType);
+			DeleteKeys(rcon, keys, Prio::Config);
+		}
+
+		TaskGroup upqObjectType ("IcingaDB:ConfigDump:" + lcType);
 
 		std::map<String, String> redisCheckSums;
 		String configCheckSum = m_PrefixConfigCheckSum + lcType;
 
-		upqObjectType.Enqueue([&rcon, &configCheckSum, &redisCheckSums]() {
-			String cursor = "0";
+		// The checksums in Redis are only compared to ours if we don't already know which objects changed.
+		if (!previous) {
+			upqObjectType.Enqueue([&rcon, &configCheckSum, &redisCheckSums]() {
+				String cursor = "0";
 
-			do {
-				Array::Ptr res = rcon->GetResultOfQuery({
-					"HSCAN", configCheckSum, cursor, "COUNT", "1000"
-				}, Prio::Config);
+				do {
+					Array::Ptr res = rcon->GetResultOfQuery({
+						"HSCAN", configCheckSum, cursor, "COUNT", "1000"
+					}, Prio::Config);
 
-				AddKvsToMap(res->Get(1), redisCheckSums);
+					AddKvsToMap(res->Get(1), redisCheckSums);
 
-				cursor = res->Get(0);
-			} while (cursor != "0");
-		});
+					cursor = res->Get(0);
+				} while (cursor != "0");
+			});
+		}
 
 		auto objectChunks (ChunkObjects(ctype->GetObjects(), 500));
 		String configObject = m_PrefixConfigObject + lcType;
 
-		// Skimmed away attributes and checksums HMSETs' keys and values by Redis key.
-		std::map<String, std::vector<std::vector<String>>> ourContentRaw {{configCheckSum, {}}, {configObject, {}}};
-		std::mutex ourContentMutex;
+		// Skimmed away attributes and checksums HMSETs' keys and values by Redis key, per chunk not to share a lock.
+		std::vector<std::map<String, std::vector<std::vector<String>>>> ourContentRaw (objectChunks.size());
 
 		upqObjectType.ParallelFor(objectChunks, [&](decltype(objectChunks)::const_reference chunk) {
+			auto& ourChunkContentRaw (ourContentRaw[&chunk - objectChunks.data()]);
 			std::map<String, std::vector<String>> hMSets;
 			// Two values are appended per object: Object ID (Hash encoded) and Object State (IcingaDB::SerializeState() -> JSON encoded)
 			std::vector<String> states = {"HMSET", m_PrefixConfigObject + lcType + ":state"};
@@ -265,29 +313,103 @@ void IcingaDB::UpdateAllConfigObjects()
 			std::vector<String> statesChksms = {"HMSET", m_PrefixConfigCheckSum + lcType + ":state"};
 			std::vector<std::vector<String> > transaction = {{"MULTI"}};
 			std::vector<String> hostZAdds = {"ZADD", "icinga:nextupdate:host"}, serviceZAdds = {"ZADD", "icinga:nextupdate:service"};
+			// Fields the previous dump wrote for changed objects which they don't have anymore, by Redis key.
+			std::map<String, std::vector<String>> hDels;
+			std::vector<std::pair<String, DumpedObject>> dumpedObjects;
 
 			auto skimObjects ([&]() {
-				std::lock_guard<std::mutex> l (ourContentMutex);
-
-				for (auto& kv : ourContentRaw) {
-					auto pos (hMSets.find(kv.first));
+				for (auto key : {&configCheckSum, &configObject}) {
+					auto pos (hMSets.find(*key));
 
 					if (pos != hMSets.end()) {
-						kv.second.emplace_back(std::move(pos->second));
+						ourChunkContentRaw[*key].emplace_back(std::move(pos->second));
 						hMSets.erase(pos);
 					}
 				}
 			});
 
+			auto addHDels ([&]() {
+				for (auto& kv : hDels) {
+					if (!kv.second.empty()) {
+						kv.second.insert(kv.second.begin(), {"HDEL", kv.first});
+						transaction.emplace_back(std::move(kv.second));
+					}
+				}
+
+				hDels = decltype(hDels)();
+			});
+
 			bool dumpState = (lcType == "host" || lcType == "service");
 
-			size_t bulkCounter = 0;
+			size_t bulkCounter = 0, unchangedCounter = 0;
 			for (const ConfigObject::Ptr& object : chunk) {
 				if (lcType != GetLowerCaseTypeNameDB(object))
 					continue;
 
-				std::vector<Dictionary::Ptr> runtimeUpdates;
-				CreateConfigUpdate(object, lcType, hMSets, runtimeUpdates, false);
+				DumpedObject dumpedObject;
+				DumpedObject* previousObject = nullptr;
+
+				if (recordTo) {
+					dumpedObject.Fingerprint = GetDumpFingerprint(object);
+				}
+
+				if (previous) {
+					auto pos (previous->Objects.find(object->GetName()));
+
+					if (pos != previous->Objects.end()) {
+						// Each object is looked up by only one chunk, so it can be moved from below.
+						previousObject = &pos->second;
+					}
+				}
+
+				if (previousObject && previousObject->Fingerprint == dumpedObject.Fingerprint) {
+					dumpedObject.Fields = std::move(previousObject->Fields);
+					unchangedCounter++;
+				} else {
+					std::map<String, std::vector<String>> objectHMSets;
+					std::vector<Dictionary::Ptr> runtimeUpdates;
+					CreateConfigUpdate(object, lcType, recordTo ? objectHMSets : hMSets, runtimeUpdates, false);
+
+					for (auto& kv : objectHMSets) {
+						if (kv.second.empty()) {
+							continue;
+						}
+
+						if (std::find(globalKeys.begin(), globalKeys.end(), kv.first) == globalKeys.end()) {
+							auto& fields (dumpedObject.Fields[kv.first]);
+
+							for (decltype(kv.second.size()) i = 0; i < kv.second.size(); i += 2u) {
+								fields.emplace_back(kv.second[i]);
+							}
+						}
+
+						auto& dest (hMSets[kv.first]);
+						dest.insert(dest.end(), std::make_move_iterator(kv.second.begin()), std::make_move_iterator(kv.second.end()));
+					}
+
+					if (recordTo && dumpState) {
+						String objectKey = GetObjectIdentifier(object);
+
+						dumpedObject.Fields[m_PrefixConfigObject + lcType + ":state"].emplace_back(objectKey);
+						dumpedObject.Fields[m_PrefixConfigCheckSum + lcType + ":state"].emplace_back(objectKey);
+					}
+
+					if (previousObject) {
+						for (auto& kv : previousObject->Fields) {
+							auto current (dumpedObject.Fields.find(kv.first));
+
+							for (auto& field : kv.second) {
+								if (current == dumpedObject.Fields.end() || std::find(current->second.begin(), current->second.end(), field) == current->second.end()) {
+									hDels[kv.first].emplace_back(field);
+								}
+							}
+						}
+					}
+				}
+
+				if (recordTo) {
+					dumpedObjects.emplace_back(object->GetName(), std::move(dumpedObject));
+				}
 
 				// Write out inital state for checkables
 				if (dumpState) {
@@ -303,7 +425,12 @@ void IcingaDB::UpdateAllConfigObjects()
 
 				bulkCounter++;
 				if (!(bulkCounter % 100)) {
-					skimObjects();
+					// The checksums and objects of changed objects are written right away in an incremental dump.
+					if (!previous) {
+						skimObjects();
+					}
+
+					addHDels();
 
 					for (auto& kv : hMSets) {
 						if (!kv.second.empty()) {
@@ -346,7 +473,11 @@ void IcingaDB::UpdateAllConfigObjects()
 				}
 			}
 
-			skimObjects();
+			if (!previous) {
+				skimObjects();
+			}
+
+			addHDels();
 
 			for (auto& kv : hMSets) {
 				if (!kv.second.empty()) {
@@ -360,6 +491,14 @@ void IcingaDB::UpdateAllConfigObjects()
 				transaction.emplace_back(std::move(statesChksms));
 			}
 
+			if (recordTo) {
+				std::lock_guard<std::mutex> lock (recordTo->Mutex);
+
+				for (auto& dumpedObject : dumpedObjects) {
+					recordTo->Objects.emplace(std::move(dumpedObject));
+				}
+			}
+
 			if (transaction.size() > 1) {
 				transaction.push_back({"EXEC"});
 				rcon->FireAndForgetQueries(std::move(transaction), Prio::Config);
@@ -372,7 +511,7 @@ void IcingaDB::UpdateAllConfigObjects()
 			}
 
 			Log(LogNotice, "IcingaDB")
-					<< "Dumped " << bulkCounter << " objects of type " << lcType;
+					<< "Dumped " << bulkCounter << " objects of type " << lcType << " (" << unchangedCounter << " unchanged)";
 		});
 
 		upqObjectType.Join();
@@ -387,19 +526,28 @@ void IcingaDB::UpdateAllConfigObjects()
 
 		std::map<String, std::map<String, String>> ourContent;
 
-		for (auto& source : ourContentRaw) {
-			auto& dest (ourContent[source.first]);
+		for (auto key : {&configCheckSum, &configObject}) {
+			auto& dest (ourContent[*key]);
 
-			upqObjectType.Enqueue([&]() {
-				for (auto& hMSet : source.second) {
-					for (decltype(hMSet.size()) i = 0, stop = hMSet.size() - 1u; i < stop; i += 2u) {
-						dest.emplace(std::move(hMSet[i]), std::move(hMSet[i + 1u]));
+			// Each task only touches its own key's entries of the per-chunk maps.
+			upqObjectType.Enqueue([&ourContentRaw, &dest, key]() {
+				for (auto& chunkContentRaw : ourContentRaw) {
+					auto source (chunkContentRaw.find(*key));
+
+					if (source == chunkContentRaw.end()) {
+						continue;
 					}
 
-					hMSet.clear();
-				}
+					for (auto& hMSet : source->second) {
+						for (decltype(hMSet.size()) i = 0, stop = hMSet.size() - 1u; i < stop; i += 2u) {
+							dest.emplace(std::move(hMSet[i]), std::move(hMSet[i + 1u]));
+						}
+
+						hMSet.clear();
+					}
 
-				source.second.clear();
+					source->second.clear();
+				}
 			});
 		}
 
@@ -510,10 +658,62 @@ void IcingaDB::UpdateAllConfigObjects()
 			flushSets();
 		}
 
+		if (previous) {
+			std::map<String, std::vector<String>> removedFields;
+			size_t removed = 0;
+
+			auto flushRemoved ([&]() {
+				std::vector<std::vector<String>> transaction = {{"MULTI"}};
+
+				for (auto& kv : removedFields) {
+					kv.second.insert(kv.second.begin(), {"HDEL", kv.first});
+					transaction.emplace_back(std::move(kv.second));
+				}
+
+				transaction.emplace_back(std::vector<String>{"EXEC"});
+				removedFields.clear();
+
+				rcon->FireAndForgetQueries(std::move(transaction), Prio::Config, {removed});
+				removed = 0;
+			});
+
+			for (auto& object : previous->Objects) {
+				if (recordTo->Objects.find(object.first) != recordTo->Objects.end()) {
+					continue;
+				}
+
+				for (auto& kv : object.second.Fields) {
+					auto& fields (removedFields[kv.first]);
+					fields.insert(fields.end(), kv.second.begin(), kv.second.end());
+				}
+
+				if (++removed == 100u) {
+					flushRemoved();
+				}
+			}
+
+			if (removed) {
+				flushRemoved();
+			}
+		}
+
+		if (recordTo) {
+			for (auto& object : recordTo->Objects) {
+				if (object.second.Fields.find(configCheckSum) != object.second.Fields.end()) {
+					recordTo->CheckSums++;
+				}
+			}
+		}
+
 		for (auto& key : GetTypeDumpSignalKeys(type)) {
 			rcon->FireAndForgetQuery({"XADD", "icinga:dump", "*", "key", key, "state", "done"}, Prio::Config);
 		}
 		rcon->Sync();
+
+		auto typeTook (Utility::GetTime() - typeStartTime);
+		std::unique_lock<std::mutex> lock (m_ConfigDumpDurations.Mutex);
+
+		m_ConfigDumpDurations.Durations[lcType] = typeTook;
 	});
 
 	upq.Join();
@@ -542,6 +742,11 @@ void IcingaDB::UpdateAllConfigObjects()
 	m_Rcon->EnqueueCallback([&p](boost::asio::yield_context& yc) { p.set_value(); }, Prio::Config);
 	p.get_future().wait();
 
+	// Only a complete dump can be continued incrementally.
+	if (!upq.HasExceptions()) {
+		SaveDumpChecksums(dump);
+	}
+
 	auto endTime (Utility::GetTime());
 	auto took (endTime - startTime);
 
@@ -1112,6 +1317,54 @@ void IcingaDB::InsertObjectDependencies(const ConfigObject::Ptr& object, const S
 	}
 }
 
+/**
+ * Schedule an update of the state information of a checkable in Redis.
+ *
+ * Updates of the same checkable until the next FlushStateUpdates() are coalesced into one which writes the state
+ * as of then, e.g. all updates caused by the same check result or many ones during a flapping storm.
+ *
+ * @param checkable State of this checkable is updated in Redis
+ * @param mode Mode of operation, see WriteStateUpdate()
+ */
+void IcingaDB::UpdateState(const Checkable::Ptr& checkable, StateUpdate mode)
+{
+	if (!m_Rcon || !m_Rcon->IsConnected())
+		return;
+
+	std::unique_lock<std::mutex> lock (m_PendingStateUpdates.Mutex);
+	auto& pending (m_PendingStateUpdates.Checkables[checkable.get()]);
+
+	if (pending.first) {
+		++m_PendingStateUpdates.Coalesced;
+	} else {
+		pending.first = checkable;
+	}
+
+	pending.second |= mode;
+}
+
+/**
+ * Write the state updates scheduled by UpdateState() to Redis.
+ */
+void IcingaDB::FlushStateUpdates()
+{
+	decltype(m_PendingStateUpdates.Checkables) checkables;
+
+	{
+		std::unique_lock<std::mutex> lock (m_PendingStateUpdates.Mutex);
+		std::swap(checkables, m_PendingStateUpdates.Checkables);
+	}
+
+	for (auto& kv : checkables) {
+		auto& checkable (kv.second.first);
+
+		// Deleted in the meantime, don't resurrect its state.
+		if (checkable->IsActive()) {
+			WriteStateUpdate(checkable, (StateUpdate)kv.second.second);
+		}
+	}
+}
+
 /**
  * Update the state information of a checkable in Redis.
  *
@@ -1128,7 +1381,7 @@ void IcingaDB::InsertObjectDependencies(const ConfigObject::Ptr& object, const S
  * @param checkable State of this checkable is updated in Redis
  * @param mode Mode of operation (StateUpdate::Volatile, StateUpdate::RuntimeOnly, or StateUpdate::Full)
  */
-void IcingaDB::UpdateState(const Checkable::Ptr& checkable, StateUpdate mode)
+void IcingaDB::WriteStateUpdate(const Checkable::Ptr& checkable, StateUpdate mode)
 {
 	if (!m_Rcon || !m_Rcon->IsConnected())
 		return;
@@ -1755,7 +2008,7 @@ void IcingaDB::SendStateChange(const ConfigObject::Ptr& object, const CheckResul
 		xAdd.emplace_back(GetObjectIdentifier(endpoint));
 	}
 
-	m_HistoryBulker.ProduceOne(std::move(xAdd));
+	m_HistorySpool.ProduceOne(std::move(xAdd));
 }
 
 void IcingaDB::SendSentNotification(
@@ -1828,7 +2081,7 @@ void IcingaDB::SendSentNotification(
 		xAdd.emplace_back(JsonEncode(users_notified));
 	}
 
-	m_HistoryBulker.ProduceOne(std::move(xAdd));
+	m_HistorySpool.ProduceOne(std::move(xAdd));
 }
 
 void IcingaDB::SendStartedDowntime(const Downtime::Ptr& downtime)
@@ -1916,7 +2169,7 @@ void IcingaDB::SendStartedDowntime(const Downtime::Ptr& downtime)
 		xAdd.emplace_back(scheduledBy);
 	}
 
-	m_HistoryBulker.ProduceOne(std::move(xAdd));
+	m_HistorySpool.ProduceOne(std::move(xAdd));
 }
 
 void IcingaDB::SendRemovedDowntime(const Downtime::Ptr& downtime)
@@ -2007,7 +2260,7 @@ void IcingaDB::SendRemovedDowntime(const Downtime::Ptr& downtime)
 		xAdd.emplace_back(scheduledBy);
 	}
 
-	m_HistoryBulker.ProduceOne(std::move(xAdd));
+	m_HistorySpool.ProduceOne(std::move(xAdd));
 }
 
 void IcingaDB::SendAddedComment(const Comment::Ptr& comment)
@@ -2062,7 +2315,7 @@ void IcingaDB::SendAddedComment(const Comment::Ptr& comment)
 		}
 	}
 
-	m_HistoryBulker.ProduceOne(std::move(xAdd));
+	m_HistorySpool.ProduceOne(std::move(xAdd));
 	UpdateState(checkable, StateUpdate::Full);
 }
 
@@ -2142,7 +2395,7 @@ void IcingaDB::SendRemovedComment(const Comment::Ptr& comment)
 		xAdd.emplace_back(Convert::ToString(TimestampToMilliseconds(expireTime)));
 	}
 
-	m_HistoryBulker.ProduceOne(std::move(xAdd));
+	m_HistorySpool.ProduceOne(std::move(xAdd));
 	UpdateState(checkable, StateUpdate::Full);
 }
 
@@ -2208,7 +2461,7 @@ void IcingaDB::SendFlappingChange(const Checkable::Ptr& checkable, double change
 	xAdd.emplace_back("id");
 	xAdd.emplace_back(HashValue(new Array({m_EnvironmentId, checkable->GetName(), startTime})));
 
-	m_HistoryBulker.ProduceOne(std::move(xAdd));
+	m_HistorySpool.ProduceOne(std::move(xAdd));
 }
 
 void IcingaDB::SendNextUpdate(const Checkable::Ptr& checkable)
@@ -2293,7 +2546,7 @@ void IcingaDB::SendAcknowledgementSet(const Checkable::Ptr& checkable, const Str
 	xAdd.emplace_back("id");
 	xAdd.emplace_back(HashValue(new Array({m_EnvironmentId, checkable->GetName(), setTime})));
 
-	m_HistoryBulker.ProduceOne(std::move(xAdd));
+	m_HistorySpool.ProduceOne(std::move(xAdd));
 }
 
 void IcingaDB::SendAcknowledgementCleared(const Checkable::Ptr& checkable, const String& removedBy, double changeTime, double ackLastChange)
@@ -2348,7 +2601,7 @@ void IcingaDB::SendAcknowledgementCleared(const Checkable::Ptr& checkable, const
 		xAdd.emplace_back(removedBy);
 	}
 
-	m_HistoryBulker.ProduceOne(std::move(xAdd));
+	m_HistorySpool.ProduceOne(std::move(xAdd));
 }
 
 void IcingaDB::ForwardHistoryEntries()
@@ -2362,9 +2615,9 @@ void IcingaDB::ForwardHistoryEntries()
 		if (clock::now() > nextLog) {
 			nextLog += logInterval;
 
-			auto size (m_HistoryBulker.Size());
+			auto size (m_HistorySpool.Size());
 
-			Log(size > m_HistoryBulker.GetBulkSize() ? LogInformation : LogNotice, "IcingaDB")
+			Log(size > m_HistorySpool.GetBulkSize() ? LogInformation : LogNotice, "IcingaDB")
 				<< "Pending history queries: " << size;
 		}
 	});
@@ -2372,7 +2625,8 @@ void IcingaDB::ForwardHistoryEntries()
 	for (;;) {
 		logPeriodically();
 
-		auto haystack (m_HistoryBulker.ConsumeMany());
+		// While shutting down, leave what's on disk there for the next start.
+		auto haystack (m_HistorySpool.ConsumeMany(GetActive()));
 
 		if (haystack.empty()) {
 			if (!GetActive()) {
@@ -2397,9 +2651,9 @@ void IcingaDB::ForwardHistoryEntries()
 		for (;;) {
 			logPeriodically();
 
-			if (m_Rcon && m_Rcon->IsConnected()) {
+			if (m_HistoryRcon && m_HistoryRcon->IsConnected()) {
 				try {
-					m_Rcon->GetResultsOfQueries(haystack, Prio::History, {0, 0, haystack.size()});
+					m_HistoryRcon->GetResultsOfQueries(haystack, Prio::History, {0, 0, haystack.size()});
 					break;
 				} catch (const std::exception& ex) {
 					logFailure(ex.what());
@@ -2413,7 +2667,7 @@ void IcingaDB::ForwardHistoryEntries()
 			if (!GetActive()) {
 				Log(LogCritical, "IcingaDB") << "history: " << haystack.size() << " queries failed (attempt #" << attempts
 					<< ") while we're about to shut down. Giving up and discarding additional "
-					<< m_HistoryBulker.Size() << " queued history queries.";
+					<< m_HistorySpool.GetMemoryQueries() << " queued history queries.";
 
 				return;
 			}
@@ -2559,10 +2813,7 @@ void IcingaDB::SendCustomVarsChanged(const ConfigObject::Ptr& object, const Dict
 		return;
 	}
 
-	Dictionary::Ptr oldVars = SerializeVars(oldValues);
-	Dictionary::Ptr newVars = SerializeVars(newValues);
-
-	std::vector<String> deletedVars = GetDictionaryDeletedKeys(oldVars, newVars);
+	std::vector<String> deletedVars = GetCustomVarsDeletedIds(oldValues, newValues);
 	String typeName = GetLowerCaseTypeNameDB(object);
 
 	for (const auto& varId : deletedVars) {
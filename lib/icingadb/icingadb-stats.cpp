@@ -4,12 +4,70 @@
 #include "base/application.hpp"
 #include "base/json.hpp"
 #include "base/logger.hpp"
+#include "base/objectlock.hpp"
+#include "base/perfdatavalue.hpp"
 #include "base/serializer.hpp"
 #include "base/statsfunction.hpp"
 #include "base/convert.hpp"
+#include <mutex>
 
 using namespace icinga;
 
+/**
+ * Feature stats interface
+ *
+ * @param status Key value pairs for feature stats
+ * @param perfdata Array of PerfdataValue objects
+ */
+void IcingaDB::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	DictionaryData nodes;
+
+	for (const IcingaDB::Ptr& icingadb : ConfigType::GetObjectsByType<IcingaDB>()) {
+		String prefix = "icingadb_" + icingadb->GetName() + "_";
+		Dictionary::Ptr configDumpDuration = new Dictionary();
+
+		{
+			std::unique_lock<std::mutex> lock (icingadb->m_ConfigDumpDurations.Mutex);
+
+			for (auto& kv : icingadb->m_ConfigDumpDurations.Durations) {
+				configDumpDuration->Set(kv.first, kv.second);
+				perfdata->Add(new PerfdataValue(prefix + "config_dump_duration_" + kv.first, kv.second, false, "seconds"));
+			}
+		}
+
+		auto rcon (icingadb->GetConnection());
+
+		Dictionary::Ptr node = new Dictionary({
+			{ "connected", rcon && rcon->GetConnected() },
+			{ "config_dump_duration", configDumpDuration }
+		});
+
+		if (rcon) {
+			Dictionary::Ptr latencies = rcon->GetLatencyStats();
+
+			node->Set("latencies", latencies);
+
+			ObjectLock olock (latencies);
+
+			for (auto& kind : latencies) {
+				Dictionary::Ptr values = kind.second;
+				ObjectLock olock (values);
+
+				for (auto& kv : values) {
+					Dictionary::Ptr summary = kv.second;
+
+					perfdata->Add(new PerfdataValue(prefix + kind.first + "_" + kv.first + "_p99", summary->Get("p99"), false, "seconds"));
+				}
+			}
+		}
+
+		nodes.emplace_back(icingadb->GetName(), node);
+	}
+
+	status->Set("icingadb", new Dictionary(std::move(nodes)));
+}
+
 Dictionary::Ptr IcingaDB::GetStats()
 {
 	Dictionary::Ptr stats = new Dictionary();
@@ -49,5 +107,29 @@ Dictionary::Ptr IcingaDB::GetStats()
 		app->Set("endpoint_id", GetObjectIdentifier(localEndpoint));
 	}
 
+	stats->Set("history_queue", new Dictionary({
+		{ "queries", m_HistorySpool.Size() },
+		{ "spilled_queries", m_HistorySpool.GetSpilledQueries() },
+		{ "spilled_bytes", m_HistorySpool.GetSpilledBytes() }
+	}));
+
+	stats->Set("state_updates_coalesced", m_PendingStateUpdates.Coalesced.load());
+
+	if (m_Rcon) {
+		typedef RedisConnection::WriteFlushReason Reason;
+
+		stats->Set("redis_write_batches", new Dictionary({
+			{ "batches", m_Rcon->GetWriteBatches() },
+			{ "queries", m_Rcon->GetWriteBatchQueries() },
+			{ "bytes", m_Rcon->GetWriteBatchBytes() },
+			{ "flushes", new Dictionary({
+				{ "size", m_Rcon->GetWriteFlushes(Reason::Size) },
+				{ "latency", m_Rcon->GetWriteFlushes(Reason::Latency) },
+				{ "idle", m_Rcon->GetWriteFlushes(Reason::Idle) },
+				{ "callback", m_Rcon->GetWriteFlushes(Reason::Callback) }
+			}) }
+		}));
+	}
+
 	return stats;
 }
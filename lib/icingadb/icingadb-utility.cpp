@@ -2,6 +2,7 @@
 
 #include "icingadb/icingadb.hpp"
 #include "base/configtype.hpp"
+#include "base/exception.hpp"
 #include "base/object-packer.hpp"
 #include "base/logger.hpp"
 #include "base/serializer.hpp"
@@ -18,12 +19,66 @@
 #include "icinga/eventcommand.hpp"
 #include "icinga/host.hpp"
 #include <boost/algorithm/string.hpp>
+#include <cmath>
 #include <map>
 #include <utility>
 #include <vector>
 
 using namespace icinga;
 
+/**
+ * Hashes the output of PackObject() with SHA1 while it's produced instead of packing into a string first
+ */
+class SHA1PackObjectSink final : public PackObjectSink
+{
+public:
+	SHA1PackObjectSink()
+	{
+		if (!SHA1_Init(&m_Context)) {
+			BOOST_THROW_EXCEPTION(openssl_error()
+				<< boost::errinfo_api_function("SHA1_Init")
+				<< errinfo_openssl_error(ERR_peek_error()));
+		}
+	}
+
+	void Write(const char *data, size_t length) override
+	{
+		if (!SHA1_Update(&m_Context, data, length)) {
+			BOOST_THROW_EXCEPTION(openssl_error()
+				<< boost::errinfo_api_function("SHA1_Update")
+				<< errinfo_openssl_error(ERR_peek_error()));
+		}
+	}
+
+	String GetHexDigest()
+	{
+		unsigned char digest[SHA_DIGEST_LENGTH];
+
+		if (!SHA1_Final(digest, &m_Context)) {
+			BOOST_THROW_EXCEPTION(openssl_error()
+				<< boost::errinfo_api_function("SHA1_Final")
+				<< errinfo_openssl_error(ERR_peek_error()));
+		}
+
+		return BinaryToHex(digest, SHA_DIGEST_LENGTH);
+	}
+
+private:
+	SHA_CTX m_Context;
+};
+
+/**
+ * Same as SHA1(PackObject(value))
+ */
+static String SHA1PackObject(const Value& value)
+{
+	SHA1PackObjectSink sink;
+
+	PackObject(value, sink);
+
+	return sink.GetHexDigest();
+}
+
 String IcingaDB::FormatCheckSumBinary(const String& str)
 {
 	char output[20*2+1];
@@ -145,7 +200,7 @@ Dictionary::Ptr IcingaDB::SerializeVars(const Dictionary::Ptr& vars)
 
 	for (auto& kv : vars) {
 		res->Set(
-			SHA1(PackObject((Array::Ptr)new Array({m_EnvironmentId, kv.first, kv.second}))),
+			SHA1PackObject((Array::Ptr)new Array({m_EnvironmentId, kv.first, kv.second})),
 			(Dictionary::Ptr)new Dictionary({
 				{"environment_id", m_EnvironmentId},
 				{"name_checksum", SHA1(kv.first)},
@@ -236,7 +291,7 @@ String IcingaDB::HashValue(const Value& value, const std::set<String>& propertie
 		}
 	}
 
-	return SHA1(PackObject(temp));
+	return SHA1PackObject(temp);
 }
 
 String IcingaDB::GetLowerCaseTypeNameDB(const ConfigObject::Ptr& obj)
@@ -305,15 +360,94 @@ std::vector<String> IcingaDB::GetDictionaryDeletedKeys(const Dictionary::Ptr& di
 		return deletedKeys;
 	}
 
-	std::vector<String> oldKeys = dictOld->GetKeys();
-
 	if (!dictNew) {
-		return oldKeys;
+		return dictOld->GetKeys();
 	}
 
-	std::vector<String> newKeys = dictNew->GetKeys();
+	ObjectLock oldLock (dictOld);
+	ObjectLock newLock (dictNew);
+
+	// Both are sorted by key, so merge them instead of copying their keys first.
+	auto newCurrent (dictNew->Begin());
+	auto newEnd (dictNew->End());
+
+	for (auto& kv : dictOld) {
+		while (newCurrent != newEnd && newCurrent->first < kv.first) {
+			++newCurrent;
+		}
 
-	std::set_difference(oldKeys.begin(), oldKeys.end(), newKeys.begin(), newKeys.end(), std::back_inserter(deletedKeys));
+		if (newCurrent == newEnd || kv.first < newCurrent->first) {
+			deletedKeys.emplace_back(kv.first);
+		}
+	}
 
 	return deletedKeys;
 }
+
+/**
+ * Whether a and b are certainly serialized alike, i.e. they're the same scalar of the same type or the same object.
+ * Cheaper than comparing their serializations, but may report distinct, but equal objects as different.
+ */
+static bool IsSameValue(const Value& a, const Value& b)
+{
+	if (a.GetType() != b.GetType()) {
+		return false;
+	}
+
+	switch (a.GetType()) {
+		case ValueEmpty:
+			return true;
+		case ValueNumber:
+			return a.Get<double>() == b.Get<double>() && std::signbit(a.Get<double>()) == std::signbit(b.Get<double>());
+		case ValueBoolean:
+			return a.Get<bool>() == b.Get<bool>();
+		case ValueString:
+			return a.Get<String>() == b.Get<String>();
+		case ValueObject:
+			return a.Get<Object::Ptr>() == b.Get<Object::Ptr>();
+		default:
+			return false;
+	}
+}
+
+/**
+ * Computes the IDs of the custom variables which exist in "varsOld" but not in "varsNew".
+ *
+ * In contrast to diffing SerializeVars() of both, only the variables which were removed or changed are hashed.
+ */
+std::vector<String> IcingaDB::GetCustomVarsDeletedIds(const Dictionary::Ptr& varsOld, const Dictionary::Ptr& varsNew)
+{
+	if (!varsOld) {
+		return {};
+	}
+
+	if (!varsNew) {
+		return SerializeVars(varsOld)->GetKeys();
+	}
+
+	Dictionary::Ptr changedOld = new Dictionary(), changedNew = new Dictionary();
+
+	{
+		ObjectLock oldLock (varsOld);
+		ObjectLock newLock (varsNew);
+
+		auto newCurrent (varsNew->Begin());
+		auto newEnd (varsNew->End());
+
+		for (auto& kv : varsOld) {
+			while (newCurrent != newEnd && newCurrent->first < kv.first) {
+				++newCurrent;
+			}
+
+			if (newCurrent == newEnd || kv.first < newCurrent->first) {
+				changedOld->Set(kv.first, kv.second);
+			} else if (!IsSameValue(kv.second, newCurrent->second)) {
+				// The new value's ID may still be the same if it's equal after all.
+				changedOld->Set(kv.first, kv.second);
+				changedNew->Set(newCurrent->first, newCurrent->second);
+			}
+		}
+	}
+
+	return GetDictionaryDeletedKeys(SerializeVars(changedOld), SerializeVars(changedNew));
+}
@@ -15,6 +15,7 @@
 #include "icinga/host.hpp"
 #include <boost/algorithm/string.hpp>
 #include <fstream>
+#include <functional>
 #include <memory>
 #include <utility>
 
@@ -29,6 +30,8 @@ std::mutex IcingaDB::m_EnvironmentIdInitMutex;
 
 REGISTER_TYPE(IcingaDB);
 
+REGISTER_STATSFUNCTION(IcingaDB, &IcingaDB::StatsFunc);
+
 IcingaDB::IcingaDB()
 	: m_Rcon(nullptr)
 {
@@ -106,12 +109,33 @@ void IcingaDB::Start(bool runtimeCreated)
 
 	m_PendingRcons = m_Rcons.size();
 
+	if (GetEnableConnectionPool()) {
+		m_HeartbeatRcon = new RedisConnection(GetHost(), GetPort(), GetPath(), GetPassword(), GetDbIndex(),
+			GetEnableTls(), GetInsecureNoverify(), GetCertPath(), GetKeyPath(), GetCaPath(), GetCrlPath(),
+			GetTlsProtocolmin(), GetCipherList(), GetConnectTimeout(), GetDebugInfo(), m_Rcon);
+
+		m_HistoryRcon = new RedisConnection(GetHost(), GetPort(), GetPath(), GetPassword(), GetDbIndex(),
+			GetEnableTls(), GetInsecureNoverify(), GetCertPath(), GetKeyPath(), GetCaPath(), GetCrlPath(),
+			GetTlsProtocolmin(), GetCipherList(), GetConnectTimeout(), GetDebugInfo(), m_Rcon);
+	} else {
+		m_HeartbeatRcon = m_Rcon;
+		m_HistoryRcon = m_Rcon;
+	}
+
 	m_Rcon->SetConnectedCallback([this](boost::asio::yield_context& yc) {
 		m_Rcon->SetConnectedCallback(nullptr);
 
 		for (auto& kv : m_Rcons) {
 			kv.second->Start();
 		}
+
+		if (m_HeartbeatRcon != m_Rcon) {
+			m_HeartbeatRcon->Start();
+		}
+
+		if (m_HistoryRcon != m_Rcon) {
+			m_HistoryRcon->Start();
+		}
 	});
 	m_Rcon->Start();
 
@@ -120,11 +144,23 @@ void IcingaDB::Start(bool runtimeCreated)
 	m_StatsTimer->OnTimerExpired.connect([this](const Timer * const&) { PublishStatsTimerHandler(); });
 	m_StatsTimer->Start();
 
+	m_StateUpdatesTimer = Timer::Create();
+	m_StateUpdatesTimer->SetInterval(0.1);
+	m_StateUpdatesTimer->OnTimerExpired.connect([this](const Timer * const&) { FlushStateUpdates(); });
+	m_StateUpdatesTimer->Start();
+
 	m_WorkQueue.SetName("IcingaDB");
 
 	m_Rcon->SuppressQueryKind(Prio::CheckResult);
 	m_Rcon->SuppressQueryKind(Prio::RuntimeStateSync);
 
+	try {
+		m_HistorySpool.Open(Configuration::DataDir + "/icingadb-" + GetName() + "-history");
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "IcingaDB")
+			<< "Can't spool history queries to disk, keeping all of them in memory: " << DiagnosticInformation(ex, false);
+	}
+
 	Ptr keepAlive (this);
 
 	m_HistoryThread = std::async(std::launch::async, [this, keepAlive]() { ForwardHistoryEntries(); });
@@ -163,7 +199,7 @@ void IcingaDB::PublishStatsTimerHandler(void)
 
 void IcingaDB::PublishStats()
 {
-	if (!m_Rcon || !m_Rcon->IsConnected())
+	if (!m_HeartbeatRcon || !m_HeartbeatRcon->IsConnected())
 		return;
 
 	Dictionary::Ptr status = GetStats();
@@ -181,7 +217,7 @@ void IcingaDB::PublishStats()
 		}
 	}
 
-	m_Rcon->FireAndForgetQuery(std::move(query), Prio::Heartbeat);
+	m_HeartbeatRcon->FireAndForgetQuery(std::move(query), Prio::Heartbeat);
 }
 
 void IcingaDB::Stop(bool runtimeRemoved)
@@ -192,10 +228,12 @@ void IcingaDB::Stop(bool runtimeRemoved)
 	if (m_HistoryThread.wait_for(std::chrono::minutes(1)) == std::future_status::timeout) {
 		Log(LogCritical, "IcingaDB")
 			<< "Flushing takes more than one minute (while we're about to shut down). Giving up and discarding "
-			<< m_HistoryBulker.Size() << " queued history queries.";
+			<< m_HistorySpool.GetMemoryQueries() << " queued history queries.";
 	}
 
 	m_StatsTimer->Stop(true);
+	m_StateUpdatesTimer->Stop(true);
+	FlushStateUpdates();
 
 	Log(LogInformation, "IcingaDB")
 		<< "'" << GetName() << "' stopped.";
@@ -230,8 +268,10 @@ void IcingaDB::AssertOnWorkQueue()
 
 void IcingaDB::DumpedGlobals::Reset()
 {
-	std::lock_guard<std::mutex> l (m_Mutex);
-	m_Ids.clear();
+	for (auto& shard : m_Shards) {
+		std::lock_guard<std::mutex> l (shard.Mutex);
+		shard.Ids.clear();
+	}
 }
 
 String IcingaDB::GetEnvironmentId() const {
@@ -240,8 +280,10 @@ String IcingaDB::GetEnvironmentId() const {
 
 bool IcingaDB::DumpedGlobals::IsNew(const String& id)
 {
-	std::lock_guard<std::mutex> l (m_Mutex);
-	return m_Ids.emplace(id).second;
+	auto& shard (m_Shards[std::hash<std::string>()(id.GetData()) % m_Shards.size()]);
+
+	std::lock_guard<std::mutex> l (shard.Mutex);
+	return shard.Ids.emplace(id).second;
 }
 
 /**
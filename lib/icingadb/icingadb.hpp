@@ -4,6 +4,7 @@
 #define ICINGADB_H
 
 #include "icingadb/icingadb-ti.hpp"
+#include "icingadb/historyspool.hpp"
 #include "icingadb/redisconnection.hpp"
 #include "base/atomic.hpp"
 #include "base/bulker.hpp"
@@ -14,15 +15,18 @@
 #include "icinga/service.hpp"
 #include "icinga/downtime.hpp"
 #include "remote/messageorigin.hpp"
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <future>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 namespace icinga
 {
@@ -46,6 +50,8 @@ public:
 
 	String GetEnvironmentId() const override;
 
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
 	inline RedisConnection::Ptr GetConnection()
 	{
 		return m_RconLocked.load();
@@ -79,10 +85,34 @@ private:
 		bool IsNew(const String& id);
 
 	private:
-		std::set<String> m_Ids;
-		std::mutex m_Mutex;
+		// Sharded by hash, so that the config dump's workers rarely wait for each other
+		struct Shard
+		{
+			std::set<String> Ids;
+			std::mutex Mutex;
+		};
+
+		std::array<Shard, 64> m_Shards;
+	};
+
+	/**
+	 * What a config dump wrote to Redis for one object, persisted to skip unchanged objects in the next dump.
+	 */
+	struct DumpedObject
+	{
+		String Fingerprint;
+		std::map<String, std::vector<String>> Fields; // Redis hash fields by Redis key, excluding global keys
+	};
+
+	struct DumpedType
+	{
+		size_t CheckSums = 0; // HLEN of the type's checksum key after the dump
+		std::map<String, DumpedObject> Objects;
+		std::mutex Mutex;
 	};
 
+	typedef std::map<String, DumpedType> DumpedTypes;
+
 	enum StateUpdate
 	{
 		Volatile    = 1ull << 0,
@@ -101,9 +131,16 @@ private:
 	void DeleteKeys(const RedisConnection::Ptr& conn, const std::vector<String>& keys, RedisConnection::QueryPriority priority);
 	std::vector<String> GetTypeOverwriteKeys(const String& type);
 	std::vector<String> GetTypeDumpSignalKeys(const Type::Ptr& type);
+	String GetDumpChecksumsPath() const;
+	void LoadDumpChecksums(DumpedTypes& dump);
+	void SaveDumpChecksums(const DumpedTypes& dump);
+	String GetDumpFingerprint(const ConfigObject::Ptr& object);
+	static bool IsIncrementallyDumpable(const Type::Ptr& type);
 	void InsertObjectDependencies(const ConfigObject::Ptr& object, const String typeName, std::map<String, std::vector<String>>& hMSets,
 			std::vector<Dictionary::Ptr>& runtimeUpdates, bool runtimeUpdate);
 	void UpdateState(const Checkable::Ptr& checkable, StateUpdate mode);
+	void WriteStateUpdate(const Checkable::Ptr& checkable, StateUpdate mode);
+	void FlushStateUpdates();
 	void SendConfigUpdate(const ConfigObject::Ptr& object, bool runtimeUpdate);
 	void CreateConfigUpdate(const ConfigObject::Ptr& object, const String type, std::map<String, std::vector<String>>& hMSets,
 			std::vector<Dictionary::Ptr>& runtimeUpdates, bool runtimeUpdate);
@@ -152,6 +189,7 @@ private:
 	static String IcingaToStreamValue(const Value& value);
 	static std::vector<Value> GetArrayDeletedValues(const Array::Ptr& arrayOld, const Array::Ptr& arrayNew);
 	static std::vector<String> GetDictionaryDeletedKeys(const Dictionary::Ptr& dictOld, const Dictionary::Ptr& dictNew);
+	static std::vector<String> GetCustomVarsDeletedIds(const Dictionary::Ptr& varsOld, const Dictionary::Ptr& varsNew);
 
 	static String GetObjectIdentifier(const ConfigObject::Ptr& object);
 	static String CalcEventID(const char* eventType, const ConfigObject::Ptr& object, double eventTime = 0, NotificationType nt = NotificationType(0));
@@ -205,10 +243,12 @@ private:
 	static void PersistEnvironmentId();
 
 	Timer::Ptr m_StatsTimer;
+	Timer::Ptr m_StateUpdatesTimer;
 	WorkQueue m_WorkQueue{0, 1, LogNotice};
 
 	std::future<void> m_HistoryThread;
-	Bulker<RedisConnection::Query> m_HistoryBulker {4096, std::chrono::milliseconds(250)};
+	// Keeps up to 16 bulks in memory
+	HistorySpool m_HistorySpool {4096, std::chrono::milliseconds(250), 16 * 4096};
 
 	String m_PrefixConfigObject;
 	String m_PrefixConfigCheckSum;
@@ -216,12 +256,28 @@ private:
 	bool m_ConfigDumpInProgress;
 	bool m_ConfigDumpDone;
 
+	// State updates coalesced by UpdateState() until the next FlushStateUpdates()
+	struct {
+		std::mutex Mutex;
+		std::unordered_map<Checkable*, std::pair<Checkable::Ptr, int>> Checkables;
+		std::atomic<uint_fast64_t> Coalesced {0};
+	} m_PendingStateUpdates;
+
+	// How long the most recent config dump took per type, in seconds
+	struct {
+		std::mutex Mutex;
+		std::map<String, double> Durations;
+	} m_ConfigDumpDurations;
+
 	RedisConnection::Ptr m_Rcon;
 	// m_RconLocked containes a copy of the value in m_Rcon where all accesses are guarded by a mutex to allow safe
 	// concurrent access like from the icingadb check command. It's a copy to still allow fast access without additional
 	// syncronization to m_Rcon within the IcingaDB feature itself.
 	Locked<RedisConnection::Ptr> m_RconLocked;
 	std::unordered_map<ConfigType*, RedisConnection::Ptr> m_Rcons;
+	// With enable_connection_pool, heartbeats and history have their own connections not to queue up behind
+	// the state updates on m_Rcon. Otherwise, they're just m_Rcon.
+	RedisConnection::Ptr m_HeartbeatRcon, m_HistoryRcon;
 	std::atomic_size_t m_PendingRcons;
 
 	struct {
@@ -461,6 +461,24 @@ void IcingadbCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckR
 
 	perfdata->Add(new PerfdataValue("icinga2_redis_pending_queries", redis->GetPendingQueryCount(), false, "", Empty, Empty, 0));
 
+	{
+		Dictionary::Ptr latencies = redis->GetLatencyStats();
+		ObjectLock olock (latencies);
+
+		for (auto& kind : latencies) {
+			Dictionary::Ptr values = kind.second;
+			ObjectLock olock (values);
+
+			for (auto& kv : values) {
+				Dictionary::Ptr summary = kv.second;
+				String label = "icinga2_redis_" + kind.first + "_" + kv.first;
+
+				perfdata->Add(new PerfdataValue(label + "_p50", summary->Get("p50"), false, "seconds", Empty, Empty, 0));
+				perfdata->Add(new PerfdataValue(label + "_p99", summary->Get("p99"), false, "seconds", Empty, Empty, 0));
+			}
+		}
+	}
+
 	struct {
 		const char * Name;
 		int (RedisConnection::* Getter)(RingBuffer::SizeType span, RingBuffer::SizeType tv);
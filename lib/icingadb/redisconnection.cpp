@@ -17,6 +17,8 @@
 #include <boost/date_time/posix_time/posix_time_duration.hpp>
 #include <boost/utility/string_view.hpp>
 #include <boost/variant/get.hpp>
+#include <chrono>
+#include <cstdio>
 #include <exception>
 #include <future>
 #include <iterator>
@@ -30,6 +32,29 @@ namespace asio = boost::asio;
 
 boost::regex RedisConnection::m_ErrAuth ("\\AERR AUTH ");
 
+// Bounds of the batches of queries sent at once
+static constexpr size_t l_MaxWriteBatchSize = 512 * 1024;
+static constexpr std::chrono::milliseconds l_MaxWriteBatchLatency (10);
+
+// Names of the latency stats
+static const std::pair<RedisConnection::QueryPriority, const char*> l_QueryPriorityNames[] = {
+	{ RedisConnection::QueryPriority::Heartbeat, "heartbeat" },
+	{ RedisConnection::QueryPriority::RuntimeStateStream, "runtime_state_stream" },
+	{ RedisConnection::QueryPriority::Config, "config" },
+	{ RedisConnection::QueryPriority::RuntimeStateSync, "runtime_state_sync" },
+	{ RedisConnection::QueryPriority::History, "history" },
+	{ RedisConnection::QueryPriority::CheckResult, "check_result" },
+	{ RedisConnection::QueryPriority::SyncConnection, "sync_connection" }
+};
+
+static const std::pair<RedisConnection::CommandClass, const char*> l_CommandClassNames[] = {
+	{ RedisConnection::CommandClass::Hash, "hash" },
+	{ RedisConnection::CommandClass::Stream, "stream" },
+	{ RedisConnection::CommandClass::SortedSet, "sorted_set" },
+	{ RedisConnection::CommandClass::Transaction, "transaction" },
+	{ RedisConnection::CommandClass::Other, "other" }
+};
+
 RedisConnection::RedisConnection(const String& host, int port, const String& path, const String& password, int db,
 	bool useTls, bool insecure, const String& certPath, const String& keyPath, const String& caPath, const String& crlPath,
 	const String& tlsProtocolmin, const String& cipherList, double connectTimeout, DebugInfo di, const RedisConnection::Ptr& parent)
@@ -50,6 +75,10 @@ RedisConnection::RedisConnection(boost::asio::io_context& io, String host, int p
 	if (useTls && m_Path.IsEmpty()) {
 		UpdateTLSContext();
 	}
+
+	if (!m_Parent) {
+		m_Latencies.reset(new Latencies());
+	}
 }
 
 void RedisConnection::UpdateTLSContext()
@@ -306,6 +335,9 @@ void RedisConnection::Connect(asio::yield_context& yc)
 		while (!m_Queues.FutureResponseActions.empty()) {
 			IoEngine::YieldCurrentCoroutine(yc);
 		}
+
+		// The responses to these won't arrive over the new connection.
+		m_Queues.SentQueries = {};
 	});
 
 	for (;;) {
@@ -409,7 +441,7 @@ void RedisConnection::ReadLoop(asio::yield_context& yc)
 				case ResponseAction::Ignore:
 					try {
 						for (auto i (item.Amount); i; --i) {
-							ReadOne(yc);
+							ReadOne(yc, true);
 						}
 					} catch (const boost::coroutines::detail::forced_unwind&) {
 						throw;
@@ -497,11 +529,19 @@ void RedisConnection::WriteLoop(asio::yield_context& yc)
 			auto next (std::move(queue.second.front()));
 			queue.second.pop();
 
+			RecordQueueWait(queue.first, next.CTime);
 			WriteItem(yc, std::move(next));
 
 			goto WriteFirstOfHighestPrio;
 		}
 
+		if (!m_WriteBatch.Buffer.empty()) {
+			FlushWrites(WriteFlushReason::Idle, yc);
+
+			// More may have been queued meanwhile
+			goto WriteFirstOfHighestPrio;
+		}
+
 		m_QueuedWrites.Clear();
 	}
 }
@@ -663,6 +703,7 @@ void RedisConnection::WriteItem(boost::asio::yield_context& yc, RedisConnection:
 	}
 
 	if (next.Callback) {
+		FlushWrites(WriteFlushReason::Callback, yc);
 		next.Callback(yc);
 	}
 
@@ -672,37 +713,117 @@ void RedisConnection::WriteItem(boost::asio::yield_context& yc, RedisConnection:
 /**
  * Receive the response to a Redis query
  *
- * @return The response
+ * @param discard Skip the response without parsing it, e.g. if it has been fired and forgotten
+ *
+ * @return The response (nothing if discarded)
  */
-RedisConnection::Reply RedisConnection::ReadOne(boost::asio::yield_context& yc)
+RedisConnection::Reply RedisConnection::ReadOne(boost::asio::yield_context& yc, bool discard)
 {
+	std::pair<std::chrono::steady_clock::time_point, CommandClass> sent;
+	bool measure = !m_Queues.SentQueries.empty();
+
+	if (measure) {
+		sent = m_Queues.SentQueries.front();
+		m_Queues.SentQueries.pop();
+	}
+
+	Reply reply;
+
 	if (m_Path.IsEmpty()) {
 		if (m_TLSContext) {
-			return ReadOne(m_TlsConn, yc);
+			reply = ReadOne(m_TlsConn, yc, discard);
 		} else {
-			return ReadOne(m_TcpConn, yc);
+			reply = ReadOne(m_TcpConn, yc, discard);
 		}
 	} else {
-		return ReadOne(m_UnixConn, yc);
+		reply = ReadOne(m_UnixConn, yc, discard);
+	}
+
+	if (measure) {
+		GetLatencies().RoundTrip[(size_t)sent.second].Record(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - sent.first
+		).count());
 	}
+
+	return reply;
 }
 
 /**
- * Send query
+ * Queue query for sending it along with the ones before and after it in one batch
+ *
+ * The responses to pipelined queries arrive in order anyway, so the caller may already expect them.
+ * A failed send of the batch just drops the connection which in turn fails those expectations.
  *
  * @param query Redis query
  */
 void RedisConnection::WriteOne(RedisConnection::Query& query, asio::yield_context& yc)
 {
-	if (m_Path.IsEmpty()) {
-		if (m_TLSContext) {
-			WriteOne(m_TlsConn, query, yc);
+	if (m_Path.IsEmpty() ? (m_TLSContext ? !m_TlsConn : !m_TcpConn) : !m_UnixConn) {
+		throw RedisDisconnected();
+	}
+
+	if (m_WriteBatch.Buffer.empty()) {
+		m_WriteBatch.Since = std::chrono::steady_clock::now();
+	}
+
+	SerializeRESP(m_WriteBatch.Buffer, query);
+	++m_WriteBatch.Queries;
+	m_Queues.SentQueries.emplace(std::chrono::steady_clock::now(), GetCommandClass(query));
+
+	if (m_WriteBatch.Buffer.size() >= l_MaxWriteBatchSize) {
+		FlushWrites(WriteFlushReason::Size, yc);
+	} else if (std::chrono::steady_clock::now() - m_WriteBatch.Since >= l_MaxWriteBatchLatency) {
+		FlushWrites(WriteFlushReason::Latency, yc);
+	}
+}
+
+/**
+ * Send all queries queued by WriteOne() with as few syscalls as possible
+ *
+ * @param reason Why now
+ */
+void RedisConnection::FlushWrites(WriteFlushReason reason, asio::yield_context& yc)
+{
+	if (m_WriteBatch.Buffer.empty()) {
+		return;
+	}
+
+	Defer clear ([this]() {
+		if (m_WriteBatch.Buffer.capacity() > l_MaxWriteBatchSize * 2u) {
+			// Don't keep the memory of a huge query forever
+			std::string().swap(m_WriteBatch.Buffer);
 		} else {
-			WriteOne(m_TcpConn, query, yc);
+			m_WriteBatch.Buffer.clear();
 		}
-	} else {
-		WriteOne(m_UnixConn, query, yc);
+
+		m_WriteBatch.Queries = 0;
+	});
+
+	try {
+		if (m_Path.IsEmpty()) {
+			if (m_TLSContext) {
+				FlushWrites(m_TlsConn, yc);
+			} else {
+				FlushWrites(m_TcpConn, yc);
+			}
+		} else {
+			FlushWrites(m_UnixConn, yc);
+		}
+	} catch (const boost::coroutines::detail::forced_unwind&) {
+		throw;
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "IcingaDB")
+			<< "Error during sending " << m_WriteBatch.Queries << " queries: " << ex.what();
+
+		return;
+	} catch (...) {
+		Log(LogCritical, "IcingaDB")
+			<< "Error during sending " << m_WriteBatch.Queries << " queries";
+
+		return;
 	}
+
+	RecordWriteBatch(m_WriteBatch.Queries, m_WriteBatch.Buffer.size(), reason);
 }
 
 /**
@@ -749,6 +870,22 @@ void RedisConnection::DecreasePendingQueries(int count)
 	}
 }
 
+void RedisConnection::RecordWriteBatch(size_t queries, size_t bytes, RedisConnection::WriteFlushReason reason)
+{
+	if (m_Parent) {
+		auto parent (m_Parent);
+
+		asio::post(parent->m_Strand, [parent, queries, bytes, reason]() {
+			parent->RecordWriteBatch(queries, bytes, reason);
+		});
+	} else {
+		++m_WriteBatches;
+		m_WriteBatchQueries += queries;
+		m_WriteBatchBytes += bytes;
+		++m_WriteFlushes[(size_t)reason];
+	}
+}
+
 void RedisConnection::RecordAffected(RedisConnection::QueryAffects affected, double when)
 {
 	if (m_Parent) {
@@ -771,3 +908,104 @@ void RedisConnection::RecordAffected(RedisConnection::QueryAffects affected, dou
 		}
 	}
 }
+
+void RedisConnection::RecordQueueWait(RedisConnection::QueryPriority priority, double since)
+{
+	auto wait ((Utility::GetTime() - since) * 1000000.0);
+
+	GetLatencies().QueueWait[GetQueueWaitIndex(priority)].Record(wait > 0 ? (Histogram::ValueType)wait : 0);
+}
+
+/**
+ * @return The kind of a Redis query, as used to tell round trip times apart
+ */
+RedisConnection::CommandClass RedisConnection::GetCommandClass(const Query& query)
+{
+	if (query.empty() || query[0].IsEmpty()) {
+		return CommandClass::Other;
+	}
+
+	auto& command (query[0]);
+
+	switch (command[0]) {
+		case 'H':
+		case 'h':
+			return CommandClass::Hash;
+		case 'X':
+		case 'x':
+			return CommandClass::Stream;
+		case 'Z':
+		case 'z':
+			return CommandClass::SortedSet;
+	}
+
+	if (command == "MULTI" || command == "EXEC") {
+		return CommandClass::Transaction;
+	}
+
+	return CommandClass::Other;
+}
+
+size_t RedisConnection::GetQueueWaitIndex(RedisConnection::QueryPriority priority)
+{
+	return priority == QueryPriority::SyncConnection ? (size_t)QueryPriority::CheckResult + 1u : (size_t)priority;
+}
+
+/**
+ * @return Queue wait times per query priority and round trip times per command class, in seconds
+ */
+Dictionary::Ptr RedisConnection::GetLatencyStats()
+{
+	auto& latencies (GetLatencies());
+
+	auto summarize ([](const Histogram& histogram) -> Dictionary::Ptr {
+		return new Dictionary({
+			{ "count", histogram.GetCount() },
+			{ "mean", histogram.GetMean() / 1000000.0 },
+			{ "p50", histogram.GetPercentile(50) / 1000000.0 },
+			{ "p90", histogram.GetPercentile(90) / 1000000.0 },
+			{ "p99", histogram.GetPercentile(99) / 1000000.0 },
+			{ "max", histogram.GetMax() / 1000000.0 }
+		});
+	});
+
+	Dictionary::Ptr queueWait = new Dictionary();
+
+	for (auto& priority : l_QueryPriorityNames) {
+		queueWait->Set(priority.second, summarize(latencies.QueueWait[GetQueueWaitIndex(priority.first)]));
+	}
+
+	Dictionary::Ptr roundTrip = new Dictionary();
+
+	for (auto& commandClass : l_CommandClassNames) {
+		roundTrip->Set(commandClass.second, summarize(latencies.RoundTrip[(size_t)commandClass.first]));
+	}
+
+	return new Dictionary({
+		{ "queue_wait", queueWait },
+		{ "round_trip", roundTrip }
+	});
+}
+
+/**
+ * Serialize a Redis protocol value
+ *
+ * @param buffer Receives the value
+ * @param query Redis protocol value
+ */
+void RedisConnection::SerializeRESP(std::string& buffer, const Query& query)
+{
+	auto appendLength ([&buffer](char type, size_t length) {
+		char header[24];
+
+		buffer.append(header, snprintf(header, sizeof(header), "%c%zu\r\n", type, length));
+	});
+
+	appendLength('*', query.size());
+
+	for (auto& arg : query) {
+		appendLength('$', arg.GetLength());
+		buffer.append(arg.CStr(), arg.GetLength());
+		buffer.append("\r\n", 2);
+	}
+}
@@ -6,6 +6,8 @@
 #include "base/array.hpp"
 #include "base/atomic.hpp"
 #include "base/convert.hpp"
+#include "base/dictionary.hpp"
+#include "base/histogram.hpp"
 #include "base/io-engine.hpp"
 #include "base/object.hpp"
 #include "base/ringbuffer.hpp"
@@ -28,6 +30,9 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
 #include <boost/utility/string_view.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -38,6 +43,7 @@
 #include <queue>
 #include <set>
 #include <stdexcept>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -136,6 +142,57 @@ namespace icinga
 			return m_WrittenHistory.UpdateAndGetValues(tv, span);
 		}
 
+		/**
+		 * Why queries buffered for sending have been written to Redis.
+		 *
+		 * @ingroup icingadb
+		 */
+		enum class WriteFlushReason : unsigned char
+		{
+			Size, // the batch grew too large
+			Latency, // the first query of the batch waited too long
+			Idle, // there's nothing more to send for now
+			Callback, // a callback expects all previous queries to be sent
+			Count
+		};
+
+		inline uint_fast64_t GetWriteBatches()
+		{
+			return m_WriteBatches.load();
+		}
+
+		inline uint_fast64_t GetWriteBatchQueries()
+		{
+			return m_WriteBatchQueries.load();
+		}
+
+		inline uint_fast64_t GetWriteBatchBytes()
+		{
+			return m_WriteBatchBytes.load();
+		}
+
+		inline uint_fast64_t GetWriteFlushes(WriteFlushReason reason)
+		{
+			return m_WriteFlushes[(size_t)reason].load();
+		}
+
+		/**
+		 * Kinds of Redis commands, by the data structure they operate on.
+		 *
+		 * @ingroup icingadb
+		 */
+		enum class CommandClass : unsigned char
+		{
+			Hash, // H*
+			Stream, // X*
+			SortedSet, // Z*
+			Transaction, // MULTI, EXEC
+			Other,
+			Count
+		};
+
+		Dictionary::Ptr GetLatencyStats();
+
 	private:
 		/**
 		 * What to do with the responses to Redis queries.
@@ -188,12 +245,23 @@ namespace icinga
 		template<class AsyncReadStream>
 		static Value ReadRESP(AsyncReadStream& stream, boost::asio::yield_context& yc);
 
+		template<class AsyncReadStream>
+		static void DiscardRESP(AsyncReadStream& stream, boost::asio::yield_context& yc);
+
 		template<class AsyncReadStream>
 		static std::vector<char> ReadLine(AsyncReadStream& stream, boost::asio::yield_context& yc, size_t hint = 0);
 
+		template<class AsyncReadStream>
+		static void SkipLine(AsyncReadStream& stream, boost::asio::yield_context& yc);
+
+		template<class AsyncReadStream>
+		static intmax_t ReadInt(AsyncReadStream& stream, boost::asio::yield_context& yc);
+
 		template<class AsyncWriteStream>
 		static void WriteRESP(AsyncWriteStream& stream, const Query& query, boost::asio::yield_context& yc);
 
+		static void SerializeRESP(std::string& buffer, const Query& query);
+
 		static boost::regex m_ErrAuth;
 
 		RedisConnection(boost::asio::io_context& io, String host, int port, String path, String password,
@@ -205,18 +273,25 @@ namespace icinga
 		void WriteLoop(boost::asio::yield_context& yc);
 		void LogStats(boost::asio::yield_context& yc);
 		void WriteItem(boost::asio::yield_context& yc, WriteQueueItem item);
-		Reply ReadOne(boost::asio::yield_context& yc);
+		Reply ReadOne(boost::asio::yield_context& yc, bool discard = false);
 		void WriteOne(Query& query, boost::asio::yield_context& yc);
 
 		template<class StreamPtr>
-		Reply ReadOne(StreamPtr& stream, boost::asio::yield_context& yc);
+		Reply ReadOne(StreamPtr& stream, boost::asio::yield_context& yc, bool discard);
+
+		void FlushWrites(WriteFlushReason reason, boost::asio::yield_context& yc);
 
 		template<class StreamPtr>
-		void WriteOne(StreamPtr& stream, Query& query, boost::asio::yield_context& yc);
+		void FlushWrites(StreamPtr& stream, boost::asio::yield_context& yc);
 
 		void IncreasePendingQueries(int count);
 		void DecreasePendingQueries(int count);
 		void RecordAffected(QueryAffects affected, double when);
+		void RecordWriteBatch(size_t queries, size_t bytes, WriteFlushReason reason);
+		void RecordQueueWait(QueryPriority priority, double since);
+
+		static CommandClass GetCommandClass(const Query& query);
+		static size_t GetQueueWaitIndex(QueryPriority priority);
 
 		template<class StreamPtr>
 		void Handshake(StreamPtr& stream, boost::asio::yield_context& yc);
@@ -255,6 +330,8 @@ namespace icinga
 			std::queue<std::promise<Replies>> RepliesPromises;
 			// Metadata about all of the above
 			std::queue<FutureResponseAction> FutureResponseActions;
+			// When and what has been sent, one per response to be received
+			std::queue<std::pair<std::chrono::steady_clock::time_point, CommandClass>> SentQueries;
 		} m_Queues;
 
 		// Kinds of queries not to actually send yet
@@ -263,6 +340,13 @@ namespace icinga
 		// Indicate that there's something to send/receive
 		AsioConditionVariable m_QueuedWrites, m_QueuedReads;
 
+		// Queries serialized by WriteOne(), but not yet written by FlushWrites()
+		struct {
+			std::string Buffer;
+			size_t Queries = 0;
+			std::chrono::steady_clock::time_point Since;
+		} m_WriteBatch;
+
 		std::function<void(boost::asio::yield_context& yc)> m_ConnectedCallback;
 
 		// Stats
@@ -272,8 +356,26 @@ namespace icinga
 		RingBuffer m_WrittenState{15 * 60};
 		RingBuffer m_WrittenHistory{15 * 60};
 		int m_PendingQueries{0};
+		Atomic<uint_fast64_t> m_WriteBatches{0}, m_WriteBatchQueries{0}, m_WriteBatchBytes{0};
+		std::array<Atomic<uint_fast64_t>, (size_t)WriteFlushReason::Count> m_WriteFlushes{{0, 0, 0, 0}};
+
+		// Latencies in microseconds. Only connections without a parent have them, the others record into the parent's.
+		struct Latencies
+		{
+			// Indexed by GetQueueWaitIndex()
+			std::array<Histogram, (size_t)QueryPriority::CheckResult + 2u> QueueWait;
+			std::array<Histogram, (size_t)CommandClass::Count> RoundTrip;
+		};
+
+		std::unique_ptr<Latencies> m_Latencies;
+
 		boost::asio::deadline_timer m_LogStatsTimer;
 		Ptr m_Parent;
+
+		inline Latencies& GetLatencies()
+		{
+			return m_Parent ? m_Parent->GetLatencies() : *m_Latencies;
+		}
 	};
 
 /**
@@ -372,11 +474,12 @@ private:
  * Read a Redis server response from stream
  *
  * @param stream Redis server connection
+ * @param discard Skip the response without parsing it into a Value
  *
- * @return The response
+ * @return The response (nothing if discarded)
  */
 template<class StreamPtr>
-RedisConnection::Reply RedisConnection::ReadOne(StreamPtr& stream, boost::asio::yield_context& yc)
+RedisConnection::Reply RedisConnection::ReadOne(StreamPtr& stream, boost::asio::yield_context& yc, bool discard)
 {
 	namespace asio = boost::asio;
 
@@ -387,6 +490,11 @@ RedisConnection::Reply RedisConnection::ReadOne(StreamPtr& stream, boost::asio::
 	auto strm (stream);
 
 	try {
+		if (discard) {
+			DiscardRESP(*strm, yc);
+			return Empty;
+		}
+
 		return ReadRESP(*strm, yc);
 	} catch (const boost::coroutines::detail::forced_unwind&) {
 		throw;
@@ -407,13 +515,12 @@ RedisConnection::Reply RedisConnection::ReadOne(StreamPtr& stream, boost::asio::
 }
 
 /**
- * Write a Redis query to stream
+ * Write all buffered queries to stream at once
  *
  * @param stream Redis server connection
- * @param query Redis query
  */
 template<class StreamPtr>
-void RedisConnection::WriteOne(StreamPtr& stream, RedisConnection::Query& query, boost::asio::yield_context& yc)
+void RedisConnection::FlushWrites(StreamPtr& stream, boost::asio::yield_context& yc)
 {
 	namespace asio = boost::asio;
 
@@ -424,8 +531,9 @@ void RedisConnection::WriteOne(StreamPtr& stream, RedisConnection::Query& query,
 	auto strm (stream);
 
 	try {
-		WriteRESP(*strm, query, yc);
-		strm->async_flush(yc);
+		// The buffered stream would forward the batch in chunks of its own (small) buffer size.
+		// Its write buffer is always empty here as everything else written to it is flushed immediately.
+		asio::async_write(strm->next_layer(), asio::buffer(m_WriteBatch.Buffer), yc);
 	} catch (const boost::coroutines::detail::forced_unwind&) {
 		throw;
 	} catch (...) {
@@ -551,54 +659,32 @@ Value RedisConnection::ReadRESP(AsyncReadStream& stream, boost::asio::yield_cont
 				return new RedisError(String(buf.begin(), buf.end()));
 			}
 		case ':':
-			{
-				auto buf (ReadLine(stream, yc, 21));
-				intmax_t i = 0;
-
-				try {
-					i = boost::lexical_cast<intmax_t>(boost::string_view(buf.data(), buf.size()));
-				} catch (...) {
-					throw BadRedisInt(std::move(buf));
-				}
-
-				return (double)i;
-			}
+			return (double)ReadInt(stream, yc);
 		case '$':
 			{
-				auto buf (ReadLine(stream, yc, 21));
-				intmax_t i = 0;
-
-				try {
-					i = boost::lexical_cast<intmax_t>(boost::string_view(buf.data(), buf.size()));
-				} catch (...) {
-					throw BadRedisInt(std::move(buf));
-				}
+				intmax_t i = ReadInt(stream, yc);
 
 				if (i < 0) {
 					return Value();
 				}
 
-				buf.clear();
-				buf.insert(buf.end(), i, 0);
-				asio::async_read(stream, asio::mutable_buffer(buf.data(), buf.size()), yc);
+				// Read the payload right into the final string, not to copy large ones.
+				std::string buf (i, 0);
+
+				if (i) {
+					asio::async_read(stream, asio::mutable_buffer(&buf[0], buf.size()), yc);
+				}
 
 				{
 					char crlf[2];
 					asio::async_read(stream, asio::mutable_buffer(crlf, 2), yc);
 				}
 
-				return String(buf.begin(), buf.end());
+				return String(std::move(buf));
 			}
 		case '*':
 			{
-				auto buf (ReadLine(stream, yc, 21));
-				intmax_t i = 0;
-
-				try {
-					i = boost::lexical_cast<intmax_t>(boost::string_view(buf.data(), buf.size()));
-				} catch (...) {
-					throw BadRedisInt(std::move(buf));
-				}
+				intmax_t i = ReadInt(stream, yc);
 
 				if (i < 0) {
 					return Empty;
@@ -619,6 +705,63 @@ Value RedisConnection::ReadRESP(AsyncReadStream& stream, boost::asio::yield_cont
 	}
 }
 
+/**
+ * Read a Redis protocol value from stream and throw it away without allocating memory
+ *
+ * @param stream Redis server connection
+ */
+template<class AsyncReadStream>
+void RedisConnection::DiscardRESP(AsyncReadStream& stream, boost::asio::yield_context& yc)
+{
+	namespace asio = boost::asio;
+
+	// Arrays just add their elements to the values still to be read.
+	for (intmax_t pending = 1; pending; --pending) {
+		char type = 0;
+		asio::async_read(stream, asio::mutable_buffer(&type, 1), yc);
+
+		switch (type) {
+			case '+':
+			case '-':
+				SkipLine(stream, yc);
+				break;
+			case ':':
+				ReadInt(stream, yc);
+				break;
+			case '$':
+				{
+					intmax_t i = ReadInt(stream, yc);
+
+					if (i < 0) {
+						break;
+					}
+
+					char buf[512];
+
+					// Including \r\n
+					for (i += 2; i;) {
+						auto chunk (std::min<intmax_t>(i, sizeof(buf)));
+
+						asio::async_read(stream, asio::mutable_buffer(buf, chunk), yc);
+						i -= chunk;
+					}
+				}
+				break;
+			case '*':
+				{
+					intmax_t i = ReadInt(stream, yc);
+
+					if (i > 0) {
+						pending += i;
+					}
+				}
+				break;
+			default:
+				throw BadRedisType(type);
+		}
+	}
+}
+
 /**
  * Read from stream until \r\n
  *
@@ -650,6 +793,65 @@ std::vector<char> RedisConnection::ReadLine(AsyncReadStream& stream, boost::asio
 	}
 }
 
+/**
+ * Like ReadLine(), but throw the data away
+ *
+ * @param stream Redis server connection
+ */
+template<class AsyncReadStream>
+void RedisConnection::SkipLine(AsyncReadStream& stream, boost::asio::yield_context& yc)
+{
+	namespace asio = boost::asio;
+
+	char next = 0;
+	asio::mutable_buffer buf (&next, 1);
+
+	do {
+		asio::async_read(stream, buf, yc);
+	} while (next != '\r');
+
+	asio::async_read(stream, buf, yc);
+}
+
+/**
+ * Read an integer terminated by \r\n from stream without allocating memory
+ *
+ * @param stream Redis server connection
+ *
+ * @return The integer
+ */
+template<class AsyncReadStream>
+intmax_t RedisConnection::ReadInt(AsyncReadStream& stream, boost::asio::yield_context& yc)
+{
+	namespace asio = boost::asio;
+
+	// Long enough for every 64-bit integer, longer ones aren't valid anyway
+	char line[21];
+	size_t length = 0;
+
+	for (;;) {
+		char next = 0;
+		asio::async_read(stream, asio::mutable_buffer(&next, 1), yc);
+
+		if (next == '\r') {
+			asio::async_read(stream, asio::mutable_buffer(&next, 1), yc);
+			break;
+		}
+
+		if (length == sizeof(line)) {
+			throw BadRedisInt(std::vector<char>(line, line + length));
+		}
+
+		line[length++] = next;
+	}
+
+	try {
+		return boost::lexical_cast<intmax_t>(boost::string_view(line, length));
+	} catch (...) {
+		throw BadRedisInt(std::vector<char>(line, line + length));
+	}
+}
+
 /**
  * Write a Redis protocol value to stream
  *
@@ -661,16 +863,10 @@ void RedisConnection::WriteRESP(AsyncWriteStream& stream, const Query& query, bo
 {
 	namespace asio = boost::asio;
 
-	asio::streambuf writeBuffer;
-	std::ostream msg(&writeBuffer);
-
-	msg << "*" << query.size() << "\r\n";
-
-	for (auto& arg : query) {
-		msg << "$" << arg.GetLength() << "\r\n" << arg << "\r\n";
-	}
+	std::string msg;
+	SerializeRESP(msg, query);
 
-	asio::async_write(stream, writeBuffer, yc);
+	asio::async_write(stream, asio::buffer(msg), yc);
 }
 
 }
@@ -28,13 +28,17 @@ public:
 
 	virtual void Apply(const Table::Ptr& table, const Value& row, AggregatorState **state) = 0;
 	virtual double GetResultAndFreeState(AggregatorState *state) const = 0;
+
+	/**
+	 * Adds the rows aggregated into other (e.g. by another thread) to state and frees other.
+	 */
+	virtual void MergeAndFreeState(AggregatorState **state, AggregatorState *other) const = 0;
 	void SetFilter(const Filter::Ptr& filter);
+	Filter::Ptr GetFilter() const;
 
 protected:
 	Aggregator() = default;
 
-	Filter::Ptr GetFilter() const;
-
 private:
 	Filter::Ptr m_Filter;
 };
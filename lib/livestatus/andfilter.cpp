@@ -13,3 +13,9 @@ bool AndFilter::Apply(const Table::Ptr& table, const Value& row)
 
 	return true;
 }
+
+void AndFilter::CollectEqualities(std::map<String, String>& equalities) const
+{
+	for (const Filter::Ptr& filter : m_Filters)
+		filter->CollectEqualities(equalities);
+}
@@ -19,6 +19,7 @@ public:
 	DECLARE_PTR_TYPEDEFS(AndFilter);
 
 	bool Apply(const Table::Ptr& table, const Value& row) override;
+	void CollectEqualities(std::map<String, String>& equalities) const override;
 };
 
 }
@@ -5,6 +5,7 @@
 #include "base/array.hpp"
 #include "base/objectlock.hpp"
 #include "base/logger.hpp"
+#include "base/regexcache.hpp"
 #include <boost/regex.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
@@ -14,11 +15,45 @@ AttributeFilter::AttributeFilter(String column, String op, String operand)
 	: m_Column(std::move(column)), m_Operator(std::move(op)), m_Operand(std::move(operand))
 { }
 
-bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
+const String& AttributeFilter::GetColumn() const
+{
+	return m_Column;
+}
+
+const String& AttributeFilter::GetOperator() const
+{
+	return m_Operator;
+}
+
+const String& AttributeFilter::GetOperand() const
+{
+	return m_Operand;
+}
+
+double AttributeFilter::GetCost() const
 {
-	Column column = table->GetColumn(m_Column);
+	if (m_Operator == "~" || m_Operator == "~~")
+		return 10;
 
-	Value value = column.ExtractValue(row);
+	if (m_Operator == "=~")
+		return 3;
+
+	/* Equality is the most selective one. */
+	if (m_Operator == "=")
+		return 1;
+
+	return 2;
+}
+
+void AttributeFilter::CollectEqualities(std::map<String, String>& equalities) const
+{
+	if (m_Operator == "=")
+		equalities.emplace(m_Column, m_Operand);
+}
+
+bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
+{
+	Value value = table->GetColumnValue(m_Column, row);
 
 	if (value.IsObjectType<Array>()) {
 		Array::Ptr array = value;
@@ -47,10 +82,10 @@ bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 		} else if (m_Operator == "~") {
 			bool ret;
 			try {
-				boost::regex expr(m_Operand.GetData());
+				RegexCache::Ptr expr = RegexCache::Get(m_Operand);
 				String operand = value;
 				boost::smatch what;
-				ret = boost::regex_search(operand.GetData(), what, expr);
+				ret = boost::regex_search(operand.GetData(), what, *expr);
 			} catch (boost::exception&) {
 				Log(LogWarning, "AttributeFilter")
 					<< "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
@@ -77,10 +112,10 @@ bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
 		} else if (m_Operator == "~~") {
 			bool ret;
 			try {
-				boost::regex expr(m_Operand.GetData(), boost::regex::icase);
+				RegexCache::Ptr expr = RegexCache::Get(m_Operand, boost::regex::icase);
 				String operand = value;
 				boost::smatch what;
-				ret = boost::regex_search(operand.GetData(), what, expr);
+				ret = boost::regex_search(operand.GetData(), what, *expr);
 			} catch (boost::exception&) {
 				Log(LogWarning, "AttributeFilter")
 					<< "Regex '" << m_Operand << " " << m_Operator << " " << value << "' error.";
@@ -21,6 +21,12 @@ public:
 	AttributeFilter(String column, String op, String operand);
 
 	bool Apply(const Table::Ptr& table, const Value& row) override;
+	double GetCost() const override;
+	void CollectEqualities(std::map<String, String>& equalities) const override;
+
+	const String& GetColumn() const;
+	const String& GetOperator() const;
+	const String& GetOperand() const;
 
 protected:
 	String m_Column;
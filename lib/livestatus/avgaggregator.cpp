@@ -36,3 +36,17 @@ double AvgAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void AvgAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	AvgAggregatorState *pstate = EnsureState(state);
+	auto *pother = static_cast<AvgAggregatorState *>(other);
+
+	pstate->Avg += pother->Avg;
+	pstate->AvgCount += pother->AvgCount;
+
+	delete pother;
+}
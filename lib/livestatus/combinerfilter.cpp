@@ -1,6 +1,7 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "livestatus/combinerfilter.hpp"
+#include <algorithm>
 
 using namespace icinga;
 
@@ -8,3 +9,29 @@ void CombinerFilter::AddSubFilter(const Filter::Ptr& filter)
 {
 	m_Filters.push_back(filter);
 }
+
+const std::vector<Filter::Ptr>& CombinerFilter::GetSubFilters() const
+{
+	return m_Filters;
+}
+
+double CombinerFilter::GetCost() const
+{
+	double cost = 0;
+
+	for (const Filter::Ptr& filter : m_Filters)
+		cost += filter->GetCost();
+
+	return cost;
+}
+
+void CombinerFilter::Optimize()
+{
+	for (const Filter::Ptr& filter : m_Filters)
+		filter->Optimize();
+
+	/* And/Or don't depend on the order, so evaluate the cheap and selective sub filters first. */
+	std::stable_sort(m_Filters.begin(), m_Filters.end(), [](const Filter::Ptr& a, const Filter::Ptr& b) {
+		return a->GetCost() < b->GetCost();
+	});
+}
@@ -19,6 +19,10 @@ public:
 	DECLARE_PTR_TYPEDEFS(CombinerFilter);
 
 	void AddSubFilter(const Filter::Ptr& filter);
+	const std::vector<Filter::Ptr>& GetSubFilters() const;
+
+	double GetCost() const override;
+	void Optimize() override;
 
 protected:
 	std::vector<Filter::Ptr> m_Filters;
@@ -0,0 +1,11 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "livestatus/filter.hpp"
+
+using namespace icinga;
+
+void Filter::Optimize()
+{ }
+
+void Filter::CollectEqualities(std::map<String, String>&) const
+{ }
@@ -5,6 +5,7 @@
 
 #include "livestatus/i2-livestatus.hpp"
 #include "livestatus/table.hpp"
+#include <map>
 
 namespace icinga
 {
@@ -19,6 +20,21 @@ public:
 
 	virtual bool Apply(const Table::Ptr& table, const Value& row) = 0;
 
+	/**
+	 * Relative cost of Apply(), e.g. regular expressions are expensive.
+	 */
+	virtual double GetCost() const = 0;
+
+	/**
+	 * Reorders sub filters so that And/Or evaluate cheap ones first.
+	 */
+	virtual void Optimize();
+
+	/**
+	 * Collects the "column = value" conditions every matching row must satisfy.
+	 */
+	virtual void CollectEqualities(std::map<String, String>& equalities) const;
+
 protected:
 	Filter() = default;
 };
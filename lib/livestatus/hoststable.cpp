@@ -186,6 +186,21 @@ void HostsTable::FetchRows(const AddRowFunction& addRowFn)
 	}
 }
 
+bool HostsTable::FetchRowsByKeys(const std::map<String, String>& keys, const AddRowFunction& addRowFn)
+{
+	auto name (keys.find("name"));
+
+	if (GetGroupByType() != LivestatusGroupByNone || name == keys.end())
+		return false;
+
+	Host::Ptr host = Host::GetByName(name->second);
+
+	if (host)
+		addRowFn(host, LivestatusGroupByNone, Empty);
+
+	return true;
+}
+
 Object::Ptr HostsTable::HostGroupAccessor(const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
 {
 	/* return the current group by value set from within FetchRows()
@@ -496,7 +511,6 @@ Value HostsTable::AcknowledgementTypeAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	ObjectLock olock(host);
 	return host->GetAcknowledgement();
 }
 
@@ -647,7 +661,6 @@ Value HostsTable::AcknowledgedAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	ObjectLock olock(host);
 	return host->IsAcknowledged();
 }
 
@@ -36,3 +36,17 @@ double InvAvgAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void InvAvgAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	InvAvgAggregatorState *pstate = EnsureState(state);
+	auto *pother = static_cast<InvAvgAggregatorState *>(other);
+
+	pstate->InvAvg += pother->InvAvg;
+	pstate->InvAvgCount += pother->InvAvgCount;
+
+	delete pother;
+}
@@ -35,3 +35,16 @@ double InvSumAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void InvSumAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	InvSumAggregatorState *pstate = EnsureState(state);
+	auto *pother = static_cast<InvSumAggregatorState *>(other);
+
+	pstate->InvSum += pother->InvSum;
+
+	delete pother;
+}
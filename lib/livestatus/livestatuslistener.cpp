@@ -2,27 +2,92 @@
 
 #include "livestatus/livestatuslistener.hpp"
 #include "livestatus/livestatuslistener-ti.cpp"
+#include "livestatus/statehisttimeline.hpp"
+#include "base/atomic.hpp"
 #include "base/utility.hpp"
 #include "base/perfdatavalue.hpp"
 #include "base/objectlock.hpp"
 #include "base/configtype.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
-#include "base/tcpsocket.hpp"
-#include "base/unixsocket.hpp"
-#include "base/networkstream.hpp"
+#include "base/defer.hpp"
 #include "base/application.hpp"
 #include "base/function.hpp"
 #include "base/statsfunction.hpp"
 #include "base/convert.hpp"
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/asio/buffers_iterator.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <climits>
+#include <istream>
+
+#ifndef _WIN32
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif /* _WIN32 */
 
 using namespace icinga;
 
 REGISTER_TYPE(LivestatusListener);
 
-static int l_ClientsConnected = 0;
-static int l_Connections = 0;
-static std::mutex l_ComponentMutex;
+/**
+ * Writes a query's response to the client from within its coroutine.
+ */
+template<class Socket>
+class LivestatusResponseStream final : public Stream
+{
+public:
+	DECLARE_PTR_TYPEDEFS(LivestatusResponseStream);
+
+	LivestatusResponseStream(Socket& socket, boost::asio::yield_context yc)
+		: m_Socket(socket), m_Yield(yc)
+	{ }
+
+	size_t Read(void *, size_t) override
+	{
+		BOOST_THROW_EXCEPTION(std::runtime_error("Livestatus response streams are write-only."));
+	}
+
+	void Write(const void *buffer, size_t count) override
+	{
+		if (m_Failed)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Cannot write to Livestatus client."));
+
+		boost::system::error_code ec;
+
+		{
+			/* don't hold a CPU-bound slot while waiting for the client */
+			IoBoundWorkSlot dontLockTheIoThread (m_Yield);
+
+			boost::asio::async_write(m_Socket, boost::asio::buffer(buffer, count), m_Yield[ec]);
+		}
+
+		if (ec) {
+			m_Failed = true;
+
+			Log(LogCritical, "LivestatusListener")
+				<< "Cannot write query response to socket: " << ec.message();
+
+			BOOST_THROW_EXCEPTION(std::runtime_error("Cannot write to Livestatus client."));
+		}
+	}
+
+	bool IsEof() const override
+	{
+		return m_Failed;
+	}
+
+private:
+	Socket& m_Socket;
+	boost::asio::yield_context m_Yield;
+	bool m_Failed{false};
+};
+
+static Atomic<int> l_ClientsConnected (0);
+static Atomic<int> l_Connections (0);
 
 REGISTER_STATSFUNCTION(LivestatusListener, &LivestatusListener::StatsFunc);
 
@@ -46,36 +111,75 @@ void LivestatusListener::StatsFunc(const Dictionary::Ptr& status, const Array::P
  */
 void LivestatusListener::Start(bool runtimeCreated)
 {
+	namespace asio = boost::asio;
+
 	ObjectImpl<LivestatusListener>::Start(runtimeCreated);
 
 	Log(LogInformation, "LivestatusListener")
 		<< "'" << GetName() << "' started.";
 
+	StateHistTimeline::Start();
+
+	auto& io (IoEngine::Get().GetIoContext());
+	LivestatusListener::Ptr keepAlive (this);
+
+	m_Strand = Shared<asio::io_context::strand>::Make(io);
+
 	if (GetSocketType() == "tcp") {
-		TcpSocket::Ptr socket = new TcpSocket();
+		auto acceptor (Shared<asio::ip::tcp::acceptor>::Make(io));
 
 		try {
-			socket->Bind(GetBindHost(), GetBindPort(), AF_UNSPEC);
-		} catch (std::exception&) {
+			asio::ip::tcp::resolver resolver (io);
+			asio::ip::tcp::resolver::query query (GetBindHost(), GetBindPort(), asio::ip::tcp::resolver::query::passive);
+
+			auto result (resolver.resolve(query));
+			auto current (result.begin());
+
+			for (;;) {
+				try {
+					acceptor->open(current->endpoint().protocol());
+					acceptor->set_option(asio::socket_base::reuse_address(true));
+					acceptor->bind(current->endpoint());
+
+					break;
+				} catch (const std::exception&) {
+					if (++current == result.end()) {
+						throw;
+					}
+
+					if (acceptor->is_open()) {
+						acceptor->close();
+					}
+				}
+			}
+
+			acceptor->listen(INT_MAX);
+		} catch (const std::exception&) {
 			Log(LogCritical, "LivestatusListener")
 				<< "Cannot bind TCP socket on host '" << GetBindHost() << "' port '" << GetBindPort() << "'.";
 			return;
 		}
 
-		m_Listener = socket;
+		m_TcpAcceptor = acceptor;
 
-		m_Thread = std::thread([this]() { ServerThreadProc(); });
+		IoEngine::SpawnCoroutine(*m_Strand, [this, keepAlive, acceptor](asio::yield_context yc) {
+			ListenerCoroutineProc<asio::ip::tcp::acceptor>(yc, acceptor);
+		});
 
 		Log(LogInformation, "LivestatusListener")
 			<< "Created TCP socket listening on host '" << GetBindHost() << "' port '" << GetBindPort() << "'.";
 	}
 	else if (GetSocketType() == "unix") {
 #ifndef _WIN32
-		UnixSocket::Ptr socket = new UnixSocket();
+		auto acceptor (Shared<asio::local::stream_protocol::acceptor>::Make(io));
 
 		try {
-			socket->Bind(GetSocketPath());
-		} catch (std::exception&) {
+			unlink(GetSocketPath().CStr());
+
+			acceptor->open();
+			acceptor->bind(asio::local::stream_protocol::endpoint(GetSocketPath().GetData()));
+			acceptor->listen(INT_MAX);
+		} catch (const std::exception&) {
 			Log(LogCritical, "LivestatusListener")
 				<< "Cannot bind UNIX socket to '" << GetSocketPath() << "'.";
 			return;
@@ -90,9 +194,11 @@ void LivestatusListener::Start(bool runtimeCreated)
 			return;
 		}
 
-		m_Listener = socket;
+		m_UnixAcceptor = acceptor;
 
-		m_Thread = std::thread([this]() { ServerThreadProc(); });
+		IoEngine::SpawnCoroutine(*m_Strand, [this, keepAlive, acceptor](asio::yield_context yc) {
+			ListenerCoroutineProc<asio::local::stream_protocol::acceptor>(yc, acceptor);
+		});
 
 		Log(LogInformation, "LivestatusListener")
 			<< "Created UNIX socket in '" << GetSocketPath() << "'.";
@@ -111,97 +217,141 @@ void LivestatusListener::Stop(bool runtimeRemoved)
 	Log(LogInformation, "LivestatusListener")
 		<< "'" << GetName() << "' stopped.";
 
-	m_Listener->Close();
+	if (!m_Strand)
+		return;
+
+	/* The acceptors are only used on m_Strand. Closing them stops the listener coroutines. */
+	boost::asio::post(*m_Strand, [this]() {
+		boost::system::error_code ec;
 
-	if (m_Thread.joinable())
-		m_Thread.join();
+		if (m_TcpAcceptor)
+			m_TcpAcceptor->close(ec);
+
+#ifndef _WIN32
+		if (m_UnixAcceptor)
+			m_UnixAcceptor->close(ec);
+#endif /* _WIN32 */
+	});
 }
 
 int LivestatusListener::GetClientsConnected()
 {
-	std::unique_lock<std::mutex> lock(l_ComponentMutex);
-
-	return l_ClientsConnected;
+	return l_ClientsConnected.load();
 }
 
 int LivestatusListener::GetConnections()
 {
-	std::unique_lock<std::mutex> lock(l_ComponentMutex);
-
-	return l_Connections;
+	return l_Connections.load();
 }
 
-void LivestatusListener::ServerThreadProc()
+/**
+ * Accepts clients until the acceptor gets closed by Stop() (on m_Strand).
+ */
+template<class Acceptor>
+void LivestatusListener::ListenerCoroutineProc(boost::asio::yield_context yc, const typename Shared<Acceptor>::Ptr& acceptor)
 {
-	m_Listener->Listen();
+	namespace asio = boost::asio;
 
-	try {
-		for (;;) {
-			timeval tv = { 0, 500000 };
+	typedef typename Acceptor::protocol_type::socket Socket;
 
-			if (m_Listener->Poll(true, false, &tv)) {
-				Socket::Ptr client = m_Listener->Accept();
-				Log(LogNotice, "LivestatusListener", "Client connected");
-				Utility::QueueAsyncCallback([this, client]() { ClientHandler(client); }, LowLatencyScheduler);
-			}
+	auto& io (IoEngine::Get().GetIoContext());
 
-			if (!IsActive())
-				break;
+	for (;;) {
+		auto client (Shared<Socket>::Make(io));
+		boost::system::error_code ec;
+
+		acceptor->async_accept(*client, yc[ec]);
+
+		if (!acceptor->is_open() || !IsActive())
+			break;
+
+		if (ec) {
+			Log(LogCritical, "LivestatusListener")
+				<< "Cannot accept new connection: " << ec.message();
+			continue;
 		}
-	} catch (std::exception&) {
-		Log(LogCritical, "LivestatusListener", "Cannot accept new connection.");
-	}
 
-	m_Listener->Close();
+		Log(LogNotice, "LivestatusListener", "Client connected");
+
+		auto strand (Shared<asio::io_context::strand>::Make(io));
+		LivestatusListener::Ptr keepAlive (this);
+
+		IoEngine::SpawnCoroutine(*strand, [this, keepAlive, strand, client](asio::yield_context yc) {
+			ClientCoroutineProc<Socket>(yc, client);
+		});
+	}
 }
 
-void LivestatusListener::ClientHandler(const Socket::Ptr& client)
+/**
+ * Reads queries (terminated by an empty line or EOF) and streams their responses.
+ *
+ * Idle clients only cost their coroutine, the queries themselves are executed as CpuBoundWork.
+ */
+template<class Socket>
+void LivestatusListener::ClientCoroutineProc(boost::asio::yield_context yc, const typename Shared<Socket>::Ptr& client)
 {
-	{
-		std::unique_lock<std::mutex> lock(l_ComponentMutex);
-		l_ClientsConnected++;
-		l_Connections++;
-	}
+	namespace asio = boost::asio;
 
-	Stream::Ptr stream = new NetworkStream(client);
+	l_ClientsConnected.fetch_add(1);
+	l_Connections.fetch_add(1);
 
-	StreamReadContext context;
+	Defer disconnected ([]() { l_ClientsConnected.fetch_sub(1); });
 
-	for (;;) {
-		String line;
+	asio::streambuf buf;
+	bool eof = false;
 
+	while (!eof) {
 		std::vector<String> lines;
 
 		for (;;) {
-			StreamReadStatus srs = stream->ReadLine(&line, context);
+			boost::system::error_code ec;
+			String line;
+
+			asio::async_read_until(*client, buf, '\n', yc[ec]);
+
+			if (ec) {
+				/* Like Stream::ReadLine(), the data before EOF is the last line. */
+				eof = true;
+
+				line = String(asio::buffers_begin(buf.data()), asio::buffers_end(buf.data()));
+				buf.consume(buf.size());
+			} else {
+				std::string data;
+				std::istream stream (&buf);
 
-			if (srs == StatusEof)
+				std::getline(stream, data);
+				line = std::move(data);
+			}
+
+			boost::algorithm::trim_right(line);
+
+			if (line.IsEmpty())
 				break;
 
-			if (srs != StatusNewItem)
-				continue;
+			lines.emplace_back(std::move(line));
 
-			if (line.GetLength() > 0)
-				lines.push_back(line);
-			else
+			if (eof)
 				break;
 		}
 
 		if (lines.empty())
 			break;
 
-		LivestatusQuery::Ptr query = new LivestatusQuery(lines, GetCompatLogPath());
-		if (!query->Execute(stream))
+		/* The response is written in chunks while the query is being executed. */
+		typename LivestatusResponseStream<Socket>::Ptr response = new LivestatusResponseStream<Socket>(*client, yc);
+		CpuBoundWork handleQuery (yc);
+
+		LivestatusQuery::Ptr query = new LivestatusQuery(lines, GetCompatLogPath(), GetStatsSnapshotMaxAge(), GetQueryCacheTtl());
+
+		if (!query->Execute(response) || response->IsEof())
 			break;
 	}
 
-	{
-		std::unique_lock<std::mutex> lock(l_ComponentMutex);
-		l_ClientsConnected--;
-	}
+	boost::system::error_code ec;
+	client->shutdown(Socket::shutdown_both, ec);
+	client->close(ec);
 }
 
-
 void LivestatusListener::ValidateSocketType(const Lazy<String>& lvalue, const ValidationUtils& utils)
 {
 	ObjectImpl<LivestatusListener>::ValidateSocketType(lvalue, utils);
@@ -13,44 +13,145 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
 #include <fstream>
+#include <mutex>
 
 using namespace icinga;
 
+/* Every this many lines a log file's index remembers where the line starts. */
+static const int l_LogFileCheckpointInterval = 1000;
+
+static std::mutex l_LogFilesMutex;
+static std::map<String, LivestatusLogUtility::LogFileInfo> l_LogFiles;
+
+/**
+ * Extracts the timestamp of a log line: [123456789]
+ */
+static bool GetLogLineTime(const std::string& line, time_t& ts)
+{
+	if (line.size() < 12 || line[0] != '[' || line[11] != ']')
+		return false;
+
+	ts = atoi(line.c_str() + 1);
+	return true;
+}
+
 void LivestatusLogUtility::CreateLogIndex(const String& path, std::map<time_t, String>& index)
 {
 	Utility::Glob(path + "/icinga.log", [&index](const String& newPath) { CreateLogIndexFileHandler(newPath, index); }, GlobFile);
 	Utility::Glob(path + "/archives/*.log", [&index](const String& newPath) { CreateLogIndexFileHandler(newPath, index); }, GlobFile);
 }
 
+/**
+ * Adds the log file to the index. Its first timestamp and checkpoints are cached until it gets modified,
+ * so that (immutable) archives are only read once.
+ */
 void LivestatusLogUtility::CreateLogIndexFileHandler(const String& path, std::map<time_t, String>& index)
 {
+	boost::system::error_code ec;
+	auto mtime (boost::filesystem::last_write_time(path.GetData(), ec));
+
+	if (ec)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not stat log file: " + path));
+
+	auto size (boost::filesystem::file_size(path.GetData(), ec));
+
+	if (ec)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not stat log file: " + path));
+
+	{
+		std::unique_lock<std::mutex> lock (l_LogFilesMutex);
+		auto cached (l_LogFiles.find(path));
+
+		if (cached != l_LogFiles.end() && cached->second.MTime == mtime && cached->second.Size == size) {
+			if (cached->second.Valid)
+				index[cached->second.Start] = path;
+
+			return;
+		}
+	}
+
 	std::ifstream stream;
 	stream.open(path.CStr(), std::ifstream::in);
 
 	if (!stream)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open log file: " + path));
 
+	LogFileInfo info;
+	info.MTime = mtime;
+	info.Size = size;
+
 	/* read the first bytes to get the timestamp: [123456789] */
 	char buffer[12];
 
 	stream.read(buffer, 12);
 
-	if (buffer[0] != '[' || buffer[11] != ']') {
-		/* this can happen for directories too, silently ignore them */
-		return;
-	}
+	/* this can happen for directories too, silently ignore them */
+	info.Valid = stream && buffer[0] == '[' && buffer[11] == ']';
+
+	if (info.Valid) {
+		/* extract timestamp */
+		buffer[11] = 0;
+		info.Start = atoi(buffer+1);
 
-	/* extract timestamp */
-	buffer[11] = 0;
-	time_t ts_start = atoi(buffer+1);
+		Log(LogDebug, "LivestatusLogUtility")
+			<< "Indexing log file: '" << path << "' with timestamp start: '" << info.Start << "'.";
+
+		index[info.Start] = path;
+	}
 
 	stream.close();
 
-	Log(LogDebug, "LivestatusLogUtility")
-		<< "Indexing log file: '" << path << "' with timestamp start: '" << ts_start << "'.";
+	std::unique_lock<std::mutex> lock (l_LogFilesMutex);
+	l_LogFiles[path] = std::move(info);
+}
+
+/**
+ * Returns checkpoints (line offsets by time) of an indexed log file, scanning it on first use.
+ */
+std::vector<LivestatusLogUtility::LogFileCheckpoint> LivestatusLogUtility::GetLogFileCheckpoints(const String& path)
+{
+	{
+		std::unique_lock<std::mutex> lock (l_LogFilesMutex);
+		auto cached (l_LogFiles.find(path));
+
+		if (cached != l_LogFiles.end() && cached->second.Checkpointed)
+			return cached->second.Checkpoints;
+	}
+
+	std::vector<LogFileCheckpoint> checkpoints;
+	std::ifstream fp;
+	fp.exceptions(std::ifstream::badbit);
+	fp.open(path.CStr(), std::ifstream::in);
+
+	int lineno = 0;
+
+	while (fp.good()) {
+		std::streamoff offset = fp.tellg();
+		std::string line;
+		std::getline(fp, line);
+
+		if (line.empty())
+			continue;
+
+		time_t ts;
+
+		if (lineno % l_LogFileCheckpointInterval == 0 && GetLogLineTime(line, ts))
+			checkpoints.emplace_back(LogFileCheckpoint{ts, offset, lineno});
+
+		lineno++;
+	}
 
-	index[ts_start] = path;
+	std::unique_lock<std::mutex> lock (l_LogFilesMutex);
+	auto cached (l_LogFiles.find(path));
+
+	if (cached != l_LogFiles.end()) {
+		cached->second.Checkpoints = checkpoints;
+		cached->second.Checkpointed = true;
+	}
+
+	return checkpoints;
 }
 
 void LivestatusLogUtility::CreateLogCache(std::map<time_t, String> index, HistoryTable *table,
@@ -60,20 +161,33 @@ void LivestatusLogUtility::CreateLogCache(std::map<time_t, String> index, Histor
 
 	/* m_LogFileIndex map tells which log files are involved ordered by their start timestamp */
 	unsigned long line_count = 0;
-	for (const auto& kv : index) {
-		unsigned int ts = kv.first;
+	for (auto kv (index.begin()); kv != index.end(); ++kv) {
+		time_t ts = kv->first;
+		auto next (kv);
+		++next;
 
-		/* skip log files not in range (performance optimization) */
-		if (ts < from || ts > until)
+		/* skip log files not in range (performance optimization), a file ends where the next one starts */
+		if (ts > until || (next != index.end() && next->first <= from))
 			continue;
 
-		String log_file = index[ts];
+		String log_file = kv->second;
 		int lineno = 0;
 
 		std::ifstream fp;
 		fp.exceptions(std::ifstream::badbit);
 		fp.open(log_file.CStr(), std::ifstream::in);
 
+		/* The file started before the time range, seek to the last checkpoint before it. */
+		if (ts < from) {
+			for (auto& checkpoint : GetLogFileCheckpoints(log_file)) {
+				if (checkpoint.Time >= from)
+					break;
+
+				fp.seekg(checkpoint.Offset);
+				lineno = checkpoint.LineNo;
+			}
+		}
+
 		while (fp.good()) {
 			std::string line;
 			std::getline(fp, line);
@@ -81,6 +195,14 @@ void LivestatusLogUtility::CreateLogCache(std::map<time_t, String> index, Histor
 			if (line.empty())
 				continue; /* Ignore empty lines */
 
+			time_t lineTime;
+
+			/* Between the checkpoint and the time range */
+			if (GetLogLineTime(line, lineTime) && lineTime < from) {
+				lineno++;
+				continue;
+			}
+
 			Dictionary::Ptr log_entry_attrs = LivestatusLogUtility::GetAttributes(line);
 
 			/* no attributes available - invalid log line */
@@ -4,6 +4,10 @@
 #define LIVESTATUSLOGUTILITY_H
 
 #include "livestatus/historytable.hpp"
+#include <cstdint>
+#include <ctime>
+#include <ios>
+#include <vector>
 
 using namespace icinga;
 
@@ -46,6 +50,23 @@ enum LogEntryClass {
 class LivestatusLogUtility
 {
 public:
+	struct LogFileCheckpoint
+	{
+		time_t Time;
+		std::streamoff Offset;
+		int LineNo;
+	};
+
+	struct LogFileInfo
+	{
+		std::time_t MTime{0};
+		uintmax_t Size{0};
+		bool Valid{false};
+		time_t Start{0};
+		bool Checkpointed{false};
+		std::vector<LogFileCheckpoint> Checkpoints;
+	};
+
 	static void CreateLogIndex(const String& path, std::map<time_t, String>& index);
 	static void CreateLogIndexFileHandler(const String& path, std::map<time_t, String>& index);
 	static void CreateLogCache(std::map<time_t, String> index, HistoryTable *table, time_t from, time_t until, const AddRowFunction& addRowFn);
@@ -53,6 +74,8 @@ public:
 
 private:
 	LivestatusLogUtility();
+
+	static std::vector<LogFileCheckpoint> GetLogFileCheckpoints(const String& path);
 };
 
 }
@@ -13,7 +13,10 @@
 #include "livestatus/negatefilter.hpp"
 #include "livestatus/orfilter.hpp"
 #include "livestatus/andfilter.hpp"
+#include "livestatus/statssnapshot.hpp"
+#include "icinga/checkable.hpp"
 #include "icinga/externalcommandprocessor.hpp"
+#include "base/atomic.hpp"
 #include "base/debug.hpp"
 #include "base/convert.hpp"
 #include "base/objectlock.hpp"
@@ -26,15 +29,50 @@
 #include "base/initialize.hpp"
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
+#include <mutex>
+#include <unordered_map>
 
 using namespace icinga;
 
-static int l_ExternalCommands = 0;
-static std::mutex l_QueryMutex;
+static Atomic<int> l_ExternalCommands (0);
 
-LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String& compat_log_path)
+/* Bumped on every check result, invalidates all cached results. */
+static Atomic<uint_fast64_t> l_StateEpoch (0);
+
+struct LivestatusCachedResult
+{
+	double Time;
+	uint_fast64_t Epoch;
+	std::vector<String> Chunks;
+};
+
+static std::mutex l_ResultCacheMutex;
+static std::unordered_map<String, LivestatusCachedResult> l_ResultCache;
+
+/* Larger results (e.g. all columns of all services) aren't worth keeping. */
+static const size_t l_MaxCachedResultLength = 1024 * 1024;
+static const size_t l_MaxCachedResults = 1000;
+
+INITIALIZE_ONCE([]() {
+	Checkable::OnNewCheckResult.connect("Livestatus", [](const Checkable::Ptr&, const CheckResult::Ptr&, const MessageOrigin::Ptr&) {
+		l_StateEpoch.fetch_add(1);
+	});
+
+	Checkable::OnStateChange.connect([](const Checkable::Ptr&, const CheckResult::Ptr&, StateType, const MessageOrigin::Ptr&) {
+		l_StateEpoch.fetch_add(1);
+	});
+});
+
+/**
+ * @param statsSnapshotMaxAge Seconds hosts/services Stats: queries may reuse a snapshot of the most
+ *                            counted columns (0 = take one per query), see StatsSnapshot
+ * @param resultCacheTtl Seconds the results of identical status GET queries may be served from a cache
+ *                       as long as no check result arrives in between (0 = disabled)
+ */
+LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String& compat_log_path, double statsSnapshotMaxAge, double resultCacheTtl)
 	: m_KeepAlive(false), m_OutputFormat("csv"), m_ColumnHeaders(true), m_Limit(-1), m_ErrorCode(0),
-	m_LogTimeFrom(0), m_LogTimeUntil(static_cast<long>(Utility::GetTime()))
+	m_LogTimeFrom(0), m_LogTimeUntil(static_cast<long>(Utility::GetTime())), m_StatsSnapshotMaxAge(statsSnapshotMaxAge),
+	m_ResultCacheTtl(resultCacheTtl)
 {
 	if (lines.size() == 0) {
 		m_Verb = "ERROR";
@@ -46,6 +84,12 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 	String msg;
 	for (const String& line : lines) {
 		msg += line + "\n";
+
+		/* Framing and connection handling don't change the result. */
+		String header = line.SubStr(0, line.FindFirstOf(":"));
+
+		if (header != "ResponseHeader" && header != "KeepAlive")
+			m_CacheKey += line.Trim() + "\n";
 	}
 	Log(LogDebug, "LivestatusQuery", msg);
 
@@ -255,14 +299,21 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 	}
 
 	m_Filter = top_filter;
+	m_Filter->Optimize();
+
+	for (const Aggregator::Ptr& aggregator : aggregators) {
+		Filter::Ptr filter = aggregator->GetFilter();
+
+		if (filter)
+			filter->Optimize();
+	}
+
 	m_Aggregators.swap(aggregators);
 }
 
 int LivestatusQuery::GetExternalCommands()
 {
-	std::unique_lock<std::mutex> lock(l_QueryMutex);
-
-	return l_ExternalCommands;
+	return l_ExternalCommands.load();
 }
 
 Filter::Ptr LivestatusQuery::ParseFilter(const String& params, unsigned long& from, unsigned long& until)
@@ -448,6 +499,46 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 		return;
 	}
 
+	/* Only the status tables, their rows change with check results. */
+	m_CaptureResult = m_ResultCacheTtl > 0 && (m_Table == "hosts" || m_Table == "services" || m_Table == "hostsbygroup"
+		|| m_Table == "servicesbygroup" || m_Table == "servicesbyhostgroup");
+
+	if (m_CaptureResult) {
+		std::vector<String> chunks;
+
+		if (GetCachedResult(chunks)) {
+			SendResponse(stream, LivestatusErrorOK, chunks);
+			return;
+		}
+	}
+
+	std::vector<double> counts;
+
+	if (m_Columns.empty() && m_Limit == -1 && StatsSnapshot::Count(table, m_Filter, m_Aggregators, m_StatsSnapshotMaxAge, counts)) {
+		std::ostringstream result;
+		std::vector<String> chunks;
+		bool first_row = true;
+		BeginResultSet(result);
+
+		if (m_ColumnHeaders) {
+			ArrayData header;
+
+			for (size_t i = 1; i <= counts.size(); i++) {
+				header.push_back("stats_" + Convert::ToString(i));
+			}
+
+			AppendResultRow(result, new Array(std::move(header)), first_row);
+		}
+
+		AppendResultRow(result, Array::FromVector(counts), first_row);
+		EndResultSet(result);
+		FlushResult(stream, result, chunks, true);
+
+		SendResponse(stream, LivestatusErrorOK, chunks);
+		StoreCachedResult();
+		return;
+	}
+
 	std::vector<LivestatusRowValue> objects = table->FilterRows(m_Filter, m_Limit);
 	std::vector<String> columns;
 
@@ -457,6 +548,7 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 		columns = table->GetColumnNames();
 
 	std::ostringstream result;
+	std::vector<String> chunks;
 	bool first_row = true;
 	BeginResultSet(result);
 
@@ -489,33 +581,64 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 			}
 
 			AppendResultRow(result, new Array(std::move(row)), first_row);
+			FlushResult(stream, result, chunks, false);
 		}
 	} else {
-		std::map<std::vector<Value>, std::vector<AggregatorState *> > allStats;
+		typedef std::map<std::vector<Value>, std::vector<AggregatorState *> > StatsMap;
 
-		/* add aggregated stats */
-		for (const LivestatusRowValue& object : objects) {
-			std::vector<Value> statsKey;
+		std::vector<Column> keyColumns;
 
-			for (const String& columnName : m_Columns) {
-				Column column = table->GetColumn(columnName);
-				statsKey.emplace_back(column.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
-			}
+		for (const String& columnName : m_Columns)
+			keyColumns.emplace_back(table->GetColumn(columnName));
+
+		/* add aggregated stats, large tables in parallel */
+		size_t partitions = Table::GetPartitions(objects.size());
+		std::vector<StatsMap> partitionStats (partitions);
+
+		Table::RunPartitioned(partitions, [this, &table, &objects, &keyColumns, &partitionStats, partitions](size_t partition) {
+			auto& allStats (partitionStats[partition]);
+			size_t begin = objects.size() * partition / partitions;
+			size_t end = objects.size() * (partition + 1) / partitions;
+
+			for (size_t i = begin; i < end; i++) {
+				const LivestatusRowValue& object = objects[i];
+				std::vector<Value> statsKey;
 
-			auto it = allStats.find(statsKey);
+				for (const Column& column : keyColumns)
+					statsKey.emplace_back(column.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
 
-			if (it == allStats.end()) {
-				std::vector<AggregatorState *> newStats(m_Aggregators.size(), nullptr);
-				it = allStats.insert(std::make_pair(statsKey, newStats)).first;
+				auto it = allStats.find(statsKey);
+
+				if (it == allStats.end()) {
+					std::vector<AggregatorState *> newStats(m_Aggregators.size(), nullptr);
+					it = allStats.insert(std::make_pair(statsKey, newStats)).first;
+				}
+
+				auto& stats = it->second;
+
+				int index = 0;
+
+				for (const Aggregator::Ptr& aggregator : m_Aggregators) {
+					aggregator->Apply(table, object.Row, &stats[index]);
+					index++;
+				}
 			}
+		});
 
-			auto& stats = it->second;
+		/* Merged in the partitions' order, so the (floating point) results don't depend on the scheduling. */
+		StatsMap allStats (std::move(partitionStats[0]));
 
-			int index = 0;
+		for (size_t partition = 1; partition < partitions; partition++) {
+			for (auto& kv : partitionStats[partition]) {
+				auto it = allStats.find(kv.first);
 
-			for (const Aggregator::Ptr& aggregator : m_Aggregators) {
-				aggregator->Apply(table, object.Row, &stats[index]);
-				index++;
+				if (it == allStats.end()) {
+					allStats.emplace(kv.first, std::move(kv.second));
+					continue;
+				}
+
+				for (size_t i = 0; i < m_Aggregators.size(); i++)
+					m_Aggregators[i]->MergeAndFreeState(&it->second[i], kv.second[i]);
 			}
 		}
 
@@ -549,6 +672,7 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 				row.push_back(m_Aggregators[i]->GetResultAndFreeState(stats[i]));
 
 			AppendResultRow(result, new Array(std::move(row)), first_row);
+			FlushResult(stream, result, chunks, false);
 		}
 
 		/* add a bogus zero value if aggregated is empty*/
@@ -566,17 +690,15 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 	}
 
 	EndResultSet(result);
+	FlushResult(stream, result, chunks, true);
 
-	SendResponse(stream, LivestatusErrorOK, result.str());
+	SendResponse(stream, LivestatusErrorOK, chunks);
+	StoreCachedResult();
 }
 
 void LivestatusQuery::ExecuteCommandHelper(const Stream::Ptr& stream)
 {
-	{
-		std::unique_lock<std::mutex> lock(l_QueryMutex);
-
-		l_ExternalCommands++;
-	}
+	l_ExternalCommands.fetch_add(1);
 
 	Log(LogNotice, "LivestatusQuery")
 		<< "Executing command: " << m_Command;
@@ -591,26 +713,123 @@ void LivestatusQuery::ExecuteErrorHelper(const Stream::Ptr& stream)
 	SendResponse(stream, m_ErrorCode, m_ErrorMessage);
 }
 
-void LivestatusQuery::SendResponse(const Stream::Ptr& stream, int code, const String& data)
+/**
+ * Looks up the result of an identical query which was executed less than m_ResultCacheTtl
+ * seconds ago and no check result arrived since.
+ */
+bool LivestatusQuery::GetCachedResult(std::vector<String>& chunks)
 {
+	/* Before executing the query, so check results arriving meanwhile invalidate its result. */
+	m_CacheEpoch = l_StateEpoch.load();
+
+	std::unique_lock<std::mutex> lock (l_ResultCacheMutex);
+	auto cached (l_ResultCache.find(m_CacheKey));
+
+	if (cached == l_ResultCache.end())
+		return false;
+
+	if (cached->second.Epoch != m_CacheEpoch || Utility::GetTime() - cached->second.Time > m_ResultCacheTtl) {
+		l_ResultCache.erase(cached);
+		return false;
+	}
+
+	chunks = cached->second.Chunks;
+	return true;
+}
+
+void LivestatusQuery::StoreCachedResult()
+{
+	if (!m_CaptureResult || l_StateEpoch.load() != m_CacheEpoch)
+		return;
+
+	double now = Utility::GetTime();
+	std::unique_lock<std::mutex> lock (l_ResultCacheMutex);
+
+	if (l_ResultCache.size() >= l_MaxCachedResults) {
+		for (auto it (l_ResultCache.begin()); it != l_ResultCache.end();) {
+			if (it->second.Epoch != m_CacheEpoch || now - it->second.Time > m_ResultCacheTtl)
+				it = l_ResultCache.erase(it);
+			else
+				++it;
+		}
+
+		if (l_ResultCache.size() >= l_MaxCachedResults)
+			l_ResultCache.clear();
+	}
+
+	l_ResultCache[m_CacheKey] = LivestatusCachedResult{ now, m_CacheEpoch, std::move(m_CapturedChunks) };
+}
+
+/**
+ * Moves the formatted rows into chunks of about 64 KiB. Without a fixed16 header the
+ * length doesn't have to be known up front, so the chunks are written to the client
+ * right away instead of keeping the whole result in memory.
+ */
+void LivestatusQuery::FlushResult(const Stream::Ptr& stream, std::ostringstream& result, std::vector<String>& chunks, bool force)
+{
+	if (!force && result.tellp() < 64 * 1024)
+		return;
+
+	chunks.emplace_back(result.str());
+	result.str("");
+
+	if (m_CaptureResult) {
+		m_CapturedLength += chunks.back().GetLength();
+
+		if (m_CapturedLength > l_MaxCachedResultLength) {
+			m_CaptureResult = false;
+			m_CapturedChunks.clear();
+		} else {
+			m_CapturedChunks.push_back(chunks.back());
+		}
+	}
+
 	if (m_ResponseHeader == "fixed16")
-		PrintFixed16(stream, code, data);
+		return;
+
+	try {
+		for (const String& chunk : chunks)
+			stream->Write(chunk.CStr(), chunk.GetLength());
+	} catch (const std::exception&) {
+		Log(LogCritical, "LivestatusQuery", "Cannot write query response to socket.");
+		throw;
+	}
+
+	chunks.clear();
+}
+
+void LivestatusQuery::SendResponse(const Stream::Ptr& stream, int code, const String& data)
+{
+	SendResponse(stream, code, std::vector<String>({ data }));
+}
+
+void LivestatusQuery::SendResponse(const Stream::Ptr& stream, int code, const std::vector<String>& chunks)
+{
+	if (m_ResponseHeader == "fixed16") {
+		size_t length = 0;
+
+		for (const String& chunk : chunks)
+			length += chunk.GetLength();
+
+		PrintFixed16(stream, code, length);
+	}
 
 	if (m_ResponseHeader == "fixed16" || code == LivestatusErrorOK) {
 		try {
-			stream->Write(data.CStr(), data.GetLength());
+			for (const String& chunk : chunks)
+				stream->Write(chunk.CStr(), chunk.GetLength());
 		} catch (const std::exception&) {
 			Log(LogCritical, "LivestatusQuery", "Cannot write query response to socket.");
 		}
 	}
 }
 
-void LivestatusQuery::PrintFixed16(const Stream::Ptr& stream, int code, const String& data)
+void LivestatusQuery::PrintFixed16(const Stream::Ptr& stream, int code, size_t length)
 {
 	ASSERT(code >= 100 && code <= 999);
 
 	String sCode = Convert::ToString(code);
-	String sLength = Convert::ToString(static_cast<long>(data.GetLength()));
+	String sLength = Convert::ToString(static_cast<long>(length));
 
 	String header = sCode + String(16 - 3 - sLength.GetLength() - 1, ' ') + sLength + m_Separators[0];
 
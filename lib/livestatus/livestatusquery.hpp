@@ -9,7 +9,9 @@
 #include "base/array.hpp"
 #include "base/stream.hpp"
 #include "base/scriptframe.hpp"
+#include <cstdint>
 #include <deque>
+#include <sstream>
 
 using namespace icinga;
 
@@ -31,7 +33,7 @@ class LivestatusQuery final : public Object
 public:
 	DECLARE_PTR_TYPEDEFS(LivestatusQuery);
 
-	LivestatusQuery(const std::vector<String>& lines, const String& compat_log_path);
+	LivestatusQuery(const std::vector<String>& lines, const String& compat_log_path, double statsSnapshotMaxAge = 0, double resultCacheTtl = 0);
 
 	bool Execute(const Stream::Ptr& stream);
 
@@ -67,6 +69,15 @@ private:
 	unsigned long m_LogTimeFrom;
 	unsigned long m_LogTimeUntil;
 	String m_CompatLogPath;
+	double m_StatsSnapshotMaxAge;
+
+	/* Result cache for repeated GET queries, see GetCachedResult(). */
+	double m_ResultCacheTtl;
+	String m_CacheKey;
+	uint_fast64_t m_CacheEpoch{0};
+	bool m_CaptureResult{false};
+	size_t m_CapturedLength{0};
+	std::vector<String> m_CapturedChunks;
 
 	void BeginResultSet(std::ostream& fp) const;
 	void EndResultSet(std::ostream& fp) const;
@@ -79,8 +90,12 @@ private:
 	void ExecuteCommandHelper(const Stream::Ptr& stream);
 	void ExecuteErrorHelper(const Stream::Ptr& stream);
 
+	bool GetCachedResult(std::vector<String>& chunks);
+	void StoreCachedResult();
+	void FlushResult(const Stream::Ptr& stream, std::ostringstream& result, std::vector<String>& chunks, bool force);
 	void SendResponse(const Stream::Ptr& stream, int code, const String& data);
-	void PrintFixed16(const Stream::Ptr& stream, int code, const String& data);
+	void SendResponse(const Stream::Ptr& stream, int code, const std::vector<String>& chunks);
+	void PrintFixed16(const Stream::Ptr& stream, int code, size_t length);
 
 	static Filter::Ptr ParseFilter(const String& params, unsigned long& from, unsigned long& until);
 };
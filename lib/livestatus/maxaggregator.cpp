@@ -36,3 +36,17 @@ double MaxAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void MaxAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	MaxAggregatorState *pstate = EnsureState(state);
+	auto *pother = static_cast<MaxAggregatorState *>(other);
+
+	if (pother->Max > pstate->Max)
+		pstate->Max = pother->Max;
+
+	delete pother;
+}
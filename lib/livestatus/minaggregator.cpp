@@ -43,3 +43,17 @@ double MinAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void MinAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	MinAggregatorState *pstate = EnsureState(state);
+	auto *pother = static_cast<MinAggregatorState *>(other);
+
+	if (pother->Min < pstate->Min)
+		pstate->Min = pother->Min;
+
+	delete pother;
+}
@@ -12,3 +12,18 @@ bool NegateFilter::Apply(const Table::Ptr& table, const Value& row)
 {
 	return !m_Inner->Apply(table, row);
 }
+
+Filter::Ptr NegateFilter::GetInner() const
+{
+	return m_Inner;
+}
+
+double NegateFilter::GetCost() const
+{
+	return m_Inner->GetCost();
+}
+
+void NegateFilter::Optimize()
+{
+	m_Inner->Optimize();
+}
@@ -21,6 +21,10 @@ public:
 	NegateFilter(Filter::Ptr inner);
 
 	bool Apply(const Table::Ptr& table, const Value& row) override;
+	double GetCost() const override;
+	void Optimize() override;
+
+	Filter::Ptr GetInner() const;
 
 private:
 	Filter::Ptr m_Inner;
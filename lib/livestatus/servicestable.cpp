@@ -164,9 +164,7 @@ void ServicesTable::FetchRows(const AddRowFunction& addRowFn)
 		}
 	} else if (GetGroupByType() == LivestatusGroupByHostGroup) {
 		for (const HostGroup::Ptr& hg : ConfigType::GetObjectsByType<HostGroup>()) {
-			ObjectLock ylock(hg);
 			for (const Host::Ptr& host : hg->GetMembers()) {
-				ObjectLock ylock(host);
 				for (const Service::Ptr& service : host->GetServices()) {
 					/* the caller must know which groupby type and value are set for this row */
 					if (!addRowFn(service, LivestatusGroupByHostGroup, hg))
@@ -182,6 +180,37 @@ void ServicesTable::FetchRows(const AddRowFunction& addRowFn)
 	}
 }
 
+bool ServicesTable::FetchRowsByKeys(const std::map<String, String>& keys, const AddRowFunction& addRowFn)
+{
+	auto hostName (keys.find("host_name"));
+
+	if (GetGroupByType() != LivestatusGroupByNone || hostName == keys.end())
+		return false;
+
+	Host::Ptr host = Host::GetByName(hostName->second);
+
+	if (!host)
+		return true;
+
+	auto description (keys.find("description"));
+
+	if (description != keys.end()) {
+		Service::Ptr service = host->GetServiceByShortName(description->second);
+
+		if (service)
+			addRowFn(service, LivestatusGroupByNone, Empty);
+
+		return true;
+	}
+
+	for (const Service::Ptr& service : host->GetServices()) {
+		if (!addRowFn(service, LivestatusGroupByNone, Empty))
+			break;
+	}
+
+	return true;
+}
+
 Object::Ptr ServicesTable::HostAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor)
 {
 	Value service;
@@ -548,7 +577,6 @@ Value ServicesTable::AcknowledgedAccessor(const Value& row)
 	if (!service)
 		return Empty;
 
-	ObjectLock olock(service);
 	return service->IsAcknowledged();
 }
 
@@ -559,7 +587,6 @@ Value ServicesTable::AcknowledgementTypeAccessor(const Value& row)
 	if (!service)
 		return Empty;
 
-	ObjectLock olock(service);
 	return service->GetAcknowledgement();
 }
 
@@ -2,6 +2,7 @@
 
 #include "livestatus/statehisttable.hpp"
 #include "livestatus/livestatuslogutility.hpp"
+#include "livestatus/statehisttimeline.hpp"
 #include "livestatus/hoststable.hpp"
 #include "livestatus/servicestable.hpp"
 #include "livestatus/contactstable.hpp"
@@ -240,14 +241,24 @@ String StateHistTable::GetPrefix() const
 
 void StateHistTable::FetchRows(const AddRowFunction& addRowFn)
 {
-	Log(LogDebug, "StateHistTable")
-		<< "Pre-selecting log file from " << m_TimeFrom << " until " << m_TimeUntil;
+	int lineno = 0;
 
-	/* create log file index */
-	LivestatusLogUtility::CreateLogIndex(m_CompatLogPath, m_LogFileIndex);
+	/* Ranges since the listener was started don't need the log files. */
+	bool replayed = StateHistTimeline::Replay(m_TimeFrom, m_TimeUntil, [this, &lineno, &addRowFn](const Dictionary::Ptr& log_entry_attrs) {
+		UpdateLogEntries(log_entry_attrs, lineno, lineno, addRowFn);
+		lineno++;
+	});
+
+	if (!replayed) {
+		Log(LogDebug, "StateHistTable")
+			<< "Pre-selecting log file from " << m_TimeFrom << " until " << m_TimeUntil;
 
-	/* generate log cache */
-	LivestatusLogUtility::CreateLogCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn);
+		/* create log file index */
+		LivestatusLogUtility::CreateLogIndex(m_CompatLogPath, m_LogFileIndex);
+
+		/* generate log cache */
+		LivestatusLogUtility::CreateLogCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn);
+	}
 
 	Checkable::Ptr checkable;
 
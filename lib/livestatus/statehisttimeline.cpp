@@ -0,0 +1,236 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "livestatus/statehisttimeline.hpp"
+#include "livestatus/livestatuslogutility.hpp"
+#include "icinga/compatutility.hpp"
+#include "icinga/downtime.hpp"
+#include "icinga/host.hpp"
+#include "icinga/service.hpp"
+#include "base/configtype.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <iterator>
+
+using namespace icinga;
+
+std::mutex StateHistTimeline::m_Mutex;
+std::map<String, StateHistTimeline::Timeline> StateHistTimeline::m_Timelines;
+time_t StateHistTimeline::m_CoveredSince = 0;
+
+/* Bounds the memory of checkables which keep flapping. */
+static const size_t l_MaxEventsPerTimeline = 100000;
+
+/**
+ * Records the current states and starts recording transitions. Subsequent calls do nothing.
+ */
+void StateHistTimeline::Start()
+{
+	static std::once_flag once;
+
+	std::call_once(once, []() {
+		Checkable::OnStateChange.connect([](const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, StateType, const MessageOrigin::Ptr&) {
+			AddStateEvent(checkable, false, CompatUtility::GetCheckResultOutput(cr));
+		});
+
+		Downtime::OnDowntimeTriggered.connect([](const Downtime::Ptr& downtime) {
+			AddAlertEvent(downtime->GetCheckable(), "DOWNTIME ALERT", "STARTED", "Checkable has entered a period of scheduled downtime.");
+		});
+
+		Downtime::OnDowntimeRemoved.connect([](const Downtime::Ptr& downtime) {
+			if (downtime->GetWasCancelled())
+				AddAlertEvent(downtime->GetCheckable(), "DOWNTIME ALERT", "CANCELLED", "Scheduled downtime for service has been cancelled.");
+			else
+				AddAlertEvent(downtime->GetCheckable(), "DOWNTIME ALERT", "STOPPED", "Checkable has exited from a period of scheduled downtime.");
+		});
+
+		Checkable::OnFlappingChanged.connect([](const Checkable::Ptr& checkable, const Value&) {
+			if (checkable->IsFlapping())
+				AddAlertEvent(checkable, "FLAPPING ALERT", "STARTED", "Checkable appears to have started flapping.");
+			else
+				AddAlertEvent(checkable, "FLAPPING ALERT", "STOPPED", "Checkable appears to have stopped flapping.");
+		});
+
+		for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>())
+			AddStateEvent(host, true, CompatUtility::GetCheckResultOutput(host->GetLastCheckResult()));
+
+		for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>())
+			AddStateEvent(service, true, CompatUtility::GetCheckResultOutput(service->GetLastCheckResult()));
+
+		std::unique_lock<std::mutex> lock (m_Mutex);
+		m_CoveredSince = Utility::GetTime();
+	});
+}
+
+/**
+ * Passes the transitions between from and until to callback, as LivestatusLogUtility::GetAttributes()
+ * would return them for the log lines. Every checkable starts with a current state entry at from.
+ *
+ * @return Whether the timelines cover the range, otherwise the log files have to be parsed
+ */
+bool StateHistTimeline::Replay(time_t from, time_t until, const std::function<void (const Dictionary::Ptr&)>& callback)
+{
+	std::vector<Dictionary::Ptr> entries;
+
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		if (!m_CoveredSince || from < m_CoveredSince)
+			return false;
+
+		for (auto& kv : m_Timelines) {
+			auto& timeline (kv.second);
+			auto& events (timeline.Events);
+
+			auto begin (std::lower_bound(events.begin(), events.end(), from, [](const Event& event, time_t time) {
+				return event.Time < time;
+			}));
+
+			/* The state at the beginning of the range, like a CURRENT STATE line after a log rotation. */
+			for (auto it (begin); it != events.begin();) {
+				--it;
+
+				if (IsStateEvent(it->LogType)) {
+					entries.emplace_back(EventToAttributes(timeline, *it, from, timeline.ServiceDescription.IsEmpty()
+						? LogEntryTypeHostCurrentState : LogEntryTypeServiceCurrentState));
+					break;
+				}
+			}
+
+			for (auto it (begin); it != events.end() && it->Time <= until; ++it)
+				entries.emplace_back(EventToAttributes(timeline, *it, it->Time, it->LogType));
+		}
+	}
+
+	for (const Dictionary::Ptr& entry : entries)
+		callback(entry);
+
+	return true;
+}
+
+void StateHistTimeline::AddEvent(const Checkable::Ptr& checkable, Event event)
+{
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	std::unique_lock<std::mutex> lock (m_Mutex);
+	auto& timeline (m_Timelines[checkable->GetName()]);
+
+	if (timeline.Events.empty()) {
+		timeline.HostName = host->GetName();
+
+		if (service)
+			timeline.ServiceDescription = service->GetShortName();
+	}
+
+	auto& events (timeline.Events);
+
+	if (events.size() >= l_MaxEventsPerTimeline) {
+		auto end (events.begin() + events.size() / 10);
+		auto lastState (std::find_if(std::reverse_iterator<decltype(end)>(end), events.rend(), [](const Event& event) {
+			return IsStateEvent(event.LogType);
+		}));
+
+		/* Older ranges aren't covered anymore, but keep the state at the beginning of the remaining ones. */
+		m_CoveredSince = std::max(m_CoveredSince, (end - 1)->Time + 1);
+
+		if (lastState != events.rend()) {
+			Event state = *lastState;
+
+			events.erase(events.begin(), end);
+			events.insert(events.begin(), std::move(state));
+		} else {
+			events.erase(events.begin(), end);
+		}
+	}
+
+	events.emplace_back(std::move(event));
+}
+
+void StateHistTimeline::AddStateEvent(const Checkable::Ptr& checkable, bool initial, const String& output)
+{
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	Event event;
+	event.Time = Utility::GetTime();
+
+	String attempt = Convert::ToString(checkable->GetCheckAttempt());
+
+	if (service) {
+		event.LogType = initial ? LogEntryTypeServiceInitialState : LogEntryTypeServiceAlert;
+		event.State = service->GetState();
+		event.StateType = Service::StateTypeToString(service->GetStateType());
+		event.Message = String(initial ? "INITIAL SERVICE STATE: " : "SERVICE ALERT: ") + host->GetName() + ";" + service->GetShortName()
+			+ ";" + Service::StateToString(service->GetState()) + ";" + event.StateType + ";" + attempt + ";" + output;
+	} else {
+		event.LogType = initial ? LogEntryTypeHostInitialState : LogEntryTypeHostAlert;
+		event.State = host->GetState();
+		event.StateType = Host::StateTypeToString(host->GetStateType());
+		event.Message = String(initial ? "INITIAL HOST STATE: " : "HOST ALERT: ") + host->GetName()
+			+ ";" + Host::StateToString(host->GetState()) + ";" + event.StateType + ";" + attempt + ";" + output;
+	}
+
+	AddEvent(checkable, std::move(event));
+}
+
+/**
+ * @param alert "DOWNTIME ALERT" or "FLAPPING ALERT"
+ */
+void StateHistTimeline::AddAlertEvent(const Checkable::Ptr& checkable, const String& alert, const String& stateType, const String& comment)
+{
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	bool downtime = alert == "DOWNTIME ALERT";
+
+	Event event;
+	event.Time = Utility::GetTime();
+	event.State = 0;
+	event.StateType = stateType;
+
+	if (service) {
+		event.LogType = downtime ? LogEntryTypeServiceDowntimeAlert : LogEntryTypeServiceFlapping;
+		event.Message = "SERVICE " + alert + ": " + host->GetName() + ";" + service->GetShortName() + ";" + stateType + "; " + comment;
+	} else {
+		event.LogType = downtime ? LogEntryTypeHostDowntimeAlert : LogEntryTypeHostFlapping;
+		event.Message = "HOST " + alert + ": " + host->GetName() + ";" + stateType + "; " + comment;
+	}
+
+	AddEvent(checkable, std::move(event));
+}
+
+Dictionary::Ptr StateHistTimeline::EventToAttributes(const Timeline& timeline, const Event& event, time_t time, int logType)
+{
+	Dictionary::Ptr attrs = new Dictionary({
+		{ "time", static_cast<double>(time) },
+		{ "host_name", timeline.HostName },
+		{ "state", event.State },
+		{ "state_type", event.StateType },
+		{ "log_type", logType },
+		{ "message", "[" + Convert::ToString(static_cast<long>(time)) + "] " + event.Message }
+	});
+
+	if (!timeline.ServiceDescription.IsEmpty())
+		attrs->Set("service_description", timeline.ServiceDescription);
+
+	return attrs;
+}
+
+bool StateHistTimeline::IsStateEvent(int logType)
+{
+	switch (logType) {
+		case LogEntryTypeHostAlert:
+		case LogEntryTypeHostInitialState:
+		case LogEntryTypeHostCurrentState:
+		case LogEntryTypeServiceAlert:
+		case LogEntryTypeServiceInitialState:
+		case LogEntryTypeServiceCurrentState:
+			return true;
+		default:
+			return false;
+	}
+}
@@ -0,0 +1,64 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef STATEHISTTIMELINE_H
+#define STATEHISTTIMELINE_H
+
+#include "livestatus/i2-livestatus.hpp"
+#include "icinga/checkable.hpp"
+#include "base/dictionary.hpp"
+#include <ctime>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * Per-checkable state, downtime and flapping transitions recorded since the Livestatus
+ * listener was started. Statehist queries within that range replay them instead of
+ * parsing the compat log files.
+ *
+ * @ingroup livestatus
+ */
+class StateHistTimeline
+{
+public:
+	static void Start();
+
+	static bool Replay(time_t from, time_t until, const std::function<void (const Dictionary::Ptr&)>& callback);
+
+private:
+	struct Event
+	{
+		time_t Time;
+		int LogType;
+		int State;
+		String StateType;
+		String Message;
+	};
+
+	struct Timeline
+	{
+		String HostName;
+		String ServiceDescription;
+		std::vector<Event> Events;
+	};
+
+	static std::mutex m_Mutex;
+	static std::map<String, Timeline> m_Timelines;
+	static time_t m_CoveredSince;
+
+	StateHistTimeline();
+
+	static void AddEvent(const Checkable::Ptr& checkable, Event event);
+	static void AddStateEvent(const Checkable::Ptr& checkable, bool initial, const String& output);
+	static void AddAlertEvent(const Checkable::Ptr& checkable, const String& alert, const String& stateType, const String& comment);
+	static Dictionary::Ptr EventToAttributes(const Timeline& timeline, const Event& event, time_t time, int logType);
+	static bool IsStateEvent(int logType);
+};
+
+}
+
+#endif /* STATEHISTTIMELINE_H */
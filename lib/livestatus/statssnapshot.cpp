@@ -0,0 +1,264 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "livestatus/statssnapshot.hpp"
+#include "livestatus/andfilter.hpp"
+#include "livestatus/attributefilter.hpp"
+#include "livestatus/countaggregator.hpp"
+#include "livestatus/negatefilter.hpp"
+#include "livestatus/orfilter.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace icinga;
+
+std::mutex StatsSnapshot::m_SnapshotsMutex;
+std::map<String, StatsSnapshot::Ptr> StatsSnapshot::m_Snapshots;
+
+const std::vector<String>& StatsSnapshot::GetColumnNames()
+{
+	static const std::vector<String> columns ({
+		"state", "has_been_checked", "acknowledged", "scheduled_downtime_depth", "last_check"
+	});
+
+	return columns;
+}
+
+/**
+ * Counts the rows matching filter and each Stats: line, if they only compare snapshot columns with numbers.
+ *
+ * @param maxAge Seconds a snapshot may be reused by other queries (0 = take a new one)
+ * @param counts The aggregators' results
+ *
+ * @return Whether the query could be answered, otherwise it has to be executed row by row
+ */
+bool StatsSnapshot::Count(const Table::Ptr& table, const Filter::Ptr& filter, const std::deque<Aggregator::Ptr>& aggregators,
+	double maxAge, std::vector<double>& counts)
+{
+	auto name (table->GetName());
+
+	if ((name != "hosts" && name != "services") || table->GetGroupByType() != LivestatusGroupByNone || aggregators.empty())
+		return false;
+
+	Predicate rowFilter;
+	std::vector<Predicate> stats (aggregators.size());
+
+	if (!Compile(table, filter, rowFilter))
+		return false;
+
+	for (size_t i = 0; i < aggregators.size(); i++) {
+		if (!dynamic_pointer_cast<CountAggregator>(aggregators[i]) || !Compile(table, aggregators[i]->GetFilter(), stats[i]))
+			return false;
+	}
+
+	auto snapshot (Get(table, maxAge));
+
+	if (!snapshot->IsValid(rowFilter))
+		return false;
+
+	for (auto& predicate : stats) {
+		if (!snapshot->IsValid(predicate))
+			return false;
+	}
+
+	counts.assign(stats.size(), 0);
+
+	for (size_t row = 0; row < snapshot->m_Rows; row++) {
+		if (!rowFilter.Evaluate(*snapshot, row))
+			continue;
+
+		for (size_t i = 0; i < stats.size(); i++) {
+			if (stats[i].Evaluate(*snapshot, row))
+				counts[i]++;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Translates an And/Or/Negate tree of attribute filters on the snapshot columns with numeric operands.
+ */
+bool StatsSnapshot::Compile(const Table::Ptr& table, const Filter::Ptr& filter, Predicate& predicate)
+{
+	if (!filter)
+		return false;
+
+	auto combiner (dynamic_pointer_cast<CombinerFilter>(filter));
+
+	if (combiner) {
+		if (dynamic_pointer_cast<AndFilter>(filter))
+			predicate.Kind = Predicate::And;
+		else if (dynamic_pointer_cast<OrFilter>(filter))
+			predicate.Kind = Predicate::Or;
+		else
+			return false;
+
+		for (auto& subFilter : combiner->GetSubFilters()) {
+			predicate.Children.emplace_back();
+
+			if (!Compile(table, subFilter, predicate.Children.back()))
+				return false;
+		}
+
+		return true;
+	}
+
+	auto negate (dynamic_pointer_cast<NegateFilter>(filter));
+
+	if (negate) {
+		predicate.Kind = Predicate::Not;
+		predicate.Children.emplace_back();
+
+		return Compile(table, negate->GetInner(), predicate.Children.back());
+	}
+
+	auto attribute (dynamic_pointer_cast<AttributeFilter>(filter));
+
+	if (!attribute)
+		return false;
+
+	/* Like Table::GetColumn() */
+	String column = attribute->GetColumn();
+	String prefix = table->GetPrefix() + "_";
+
+	if (column.Find(prefix) == 0)
+		column = column.SubStr(prefix.GetLength());
+
+	auto& columns (GetColumnNames());
+	auto pos (std::find(columns.begin(), columns.end(), column));
+
+	if (pos == columns.end())
+		return false;
+
+	auto& op (attribute->GetOperator());
+
+	if (op != "=" && op != "<" && op != ">" && op != "<=" && op != ">=")
+		return false;
+
+	try {
+		predicate.Operand = Convert::ToDouble(attribute->GetOperand());
+	} catch (const std::exception&) {
+		return false;
+	}
+
+	predicate.Kind = Predicate::Compare;
+	predicate.Column = pos - columns.begin();
+	predicate.Operator = op;
+
+	return true;
+}
+
+/**
+ * Whether the predicate's comparisons behave like AttributeFilter's for all values of its columns.
+ */
+bool StatsSnapshot::IsValid(const Predicate& predicate) const
+{
+	if (predicate.Kind == Predicate::Compare) {
+		auto& column (m_Columns[predicate.Column]);
+
+		return predicate.Operator == "=" ? column.NumbersOrBooleans : column.Numbers;
+	}
+
+	for (auto& child : predicate.Children) {
+		if (!IsValid(child))
+			return false;
+	}
+
+	return true;
+}
+
+bool StatsSnapshot::Predicate::Evaluate(const StatsSnapshot& snapshot, size_t row) const
+{
+	switch (Kind) {
+		case Compare: {
+			double value = snapshot.m_Columns[Column].Values[row];
+
+			if (Operator == "=")
+				return value == Operand;
+			else if (Operator == "<")
+				return value < Operand;
+			else if (Operator == ">")
+				return value > Operand;
+			else if (Operator == "<=")
+				return value <= Operand;
+			else
+				return value >= Operand;
+		}
+		case And:
+			for (auto& child : Children) {
+				if (!child.Evaluate(snapshot, row))
+					return false;
+			}
+
+			return true;
+		case Or:
+			/* Like OrFilter */
+			if (Children.empty())
+				return true;
+
+			for (auto& child : Children) {
+				if (child.Evaluate(snapshot, row))
+					return true;
+			}
+
+			return false;
+		default:
+			return !Children[0].Evaluate(snapshot, row);
+	}
+}
+
+StatsSnapshot::Ptr StatsSnapshot::Get(const Table::Ptr& table, double maxAge)
+{
+	auto name (table->GetName());
+	double now = Utility::GetTime();
+
+	if (maxAge > 0) {
+		std::unique_lock<std::mutex> lock (m_SnapshotsMutex);
+		auto cached (m_Snapshots.find(name));
+
+		if (cached != m_Snapshots.end() && now - cached->second->m_Time <= maxAge)
+			return cached->second;
+	}
+
+	StatsSnapshot::Ptr snapshot = new StatsSnapshot();
+	std::vector<Column> columns;
+
+	snapshot->m_Time = now;
+	snapshot->m_Columns.resize(GetColumnNames().size());
+
+	for (auto& column : GetColumnNames())
+		columns.emplace_back(table->GetColumn(column));
+
+	for (auto& row : table->FilterRows(nullptr)) {
+		for (size_t i = 0; i < columns.size(); i++) {
+			auto& data (snapshot->m_Columns[i]);
+			Value value = columns[i].ExtractValue(row.Row, row.GroupByType, row.GroupByObject);
+
+			switch (value.GetType()) {
+				case ValueNumber:
+					break;
+				case ValueBoolean:
+					data.Numbers = false;
+					break;
+				default:
+					data.Numbers = false;
+					data.NumbersOrBooleans = false;
+					data.Values.emplace_back(0);
+					continue;
+			}
+
+			data.Values.emplace_back(value);
+		}
+
+		snapshot->m_Rows++;
+	}
+
+	if (maxAge > 0) {
+		std::unique_lock<std::mutex> lock (m_SnapshotsMutex);
+		m_Snapshots[name] = snapshot;
+	}
+
+	return snapshot;
+}
@@ -0,0 +1,69 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef STATSSNAPSHOT_H
+#define STATSSNAPSHOT_H
+
+#include "livestatus/table.hpp"
+#include "livestatus/filter.hpp"
+#include "livestatus/aggregator.hpp"
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace icinga;
+
+namespace icinga
+{
+
+/**
+ * The frequently counted (e.g. by dashboards) host and service columns as plain arrays.
+ * Stats: queries only filtering by them are counted over the arrays instead of calling
+ * the column accessors for every row and Stats: line.
+ *
+ * @ingroup livestatus
+ */
+class StatsSnapshot final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(StatsSnapshot);
+
+	static bool Count(const Table::Ptr& table, const Filter::Ptr& filter, const std::deque<Aggregator::Ptr>& aggregators,
+		double maxAge, std::vector<double>& counts);
+
+private:
+	struct ColumnData
+	{
+		std::vector<double> Values;
+		bool Numbers{true}; /**< Only ValueNumber, otherwise the comparison operators need the accessors */
+		bool NumbersOrBooleans{true};
+	};
+
+	struct Predicate
+	{
+		enum { Compare, And, Or, Not } Kind;
+		size_t Column;
+		String Operator;
+		double Operand;
+		std::vector<Predicate> Children;
+
+		bool Evaluate(const StatsSnapshot& snapshot, size_t row) const;
+	};
+
+	double m_Time;
+	size_t m_Rows{0};
+	std::vector<ColumnData> m_Columns;
+
+	static std::mutex m_SnapshotsMutex;
+	static std::map<String, StatsSnapshot::Ptr> m_Snapshots;
+
+	static const std::vector<String>& GetColumnNames();
+	static bool Compile(const Table::Ptr& table, const Filter::Ptr& filter, Predicate& predicate);
+	static StatsSnapshot::Ptr Get(const Table::Ptr& table, double maxAge);
+
+	bool IsValid(const Predicate& predicate) const;
+};
+
+}
+
+#endif /* STATSSNAPSHOT_H */
@@ -38,3 +38,18 @@ double StdAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void StdAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	StdAggregatorState *pstate = EnsureState(state);
+	auto *pother = static_cast<StdAggregatorState *>(other);
+
+	pstate->StdSum += pother->StdSum;
+	pstate->StdQSum += pother->StdQSum;
+	pstate->StdCount += pother->StdCount;
+
+	delete pother;
+}
@@ -35,3 +35,16 @@ double SumAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void SumAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	SumAggregatorState *pstate = EnsureState(state);
+	auto *pother = static_cast<SumAggregatorState *>(other);
+
+	pstate->Sum += pother->Sum;
+
+	delete pother;
+}
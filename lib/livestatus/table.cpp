@@ -18,13 +18,38 @@
 #include "livestatus/statehisttable.hpp"
 #include "livestatus/filter.hpp"
 #include "base/array.hpp"
+#include "base/atomic.hpp"
+#include "base/configuration.hpp"
 #include "base/dictionary.hpp"
+#include "base/utility.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
 
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+
 using namespace icinga;
 
+/**
+ * Filters often test the same column more than once per row (e.g. "state = 1" Or "state = 2").
+ * Rows of one table may be filtered by several threads, so every thread has its own memo.
+ */
+struct ColumnValueMemo
+{
+	uint_fast64_t Table{0};
+	std::map<String, Column> Columns;
+	Object::Ptr Row;
+	std::vector<std::pair<String, Value> > Values;
+};
+
+static thread_local ColumnValueMemo l_ColumnValueMemo;
+static Atomic<uint_fast64_t> l_NextTableId (1);
+
 Table::Table(LivestatusGroupByType type)
-	: m_GroupByType(type), m_GroupByObject(Empty)
+	: m_GroupByType(type), m_GroupByObject(Empty), m_Id(l_NextTableId.fetch_add(1))
 { }
 
 Table::Ptr Table::GetByName(const String& name, const String& compat_log_path, const unsigned long& from, const unsigned long& until)
@@ -95,6 +120,132 @@ Column Table::GetColumn(const String& name) const
 	return it->second;
 }
 
+/**
+ * Extracts a column's value like GetColumn().ExtractValue(), but remembers the values of the last row.
+ */
+Value Table::GetColumnValue(const String& name, const Value& row)
+{
+	auto& memo (l_ColumnValueMemo);
+
+	if (memo.Table != m_Id) {
+		ResetColumnValueMemo();
+		memo.Table = m_Id;
+	}
+
+	Object::Ptr object;
+
+	if (row.IsObject())
+		object = row;
+
+	if (object) {
+		if (object != memo.Row) {
+			memo.Row = object;
+			memo.Values.clear();
+		} else {
+			for (auto& kv : memo.Values) {
+				if (kv.first == name)
+					return kv.second;
+			}
+		}
+	}
+
+	auto it = memo.Columns.find(name);
+
+	if (it == memo.Columns.end())
+		it = memo.Columns.emplace(name, GetColumn(name)).first;
+
+	Value value = it->second.ExtractValue(row);
+
+	if (object)
+		memo.Values.emplace_back(name, value);
+
+	return value;
+}
+
+/**
+ * Drops the current thread's memo, so it doesn't keep the last row alive.
+ */
+void Table::ResetColumnValueMemo()
+{
+	auto& memo (l_ColumnValueMemo);
+
+	memo.Table = 0;
+	memo.Columns.clear();
+	memo.Row = nullptr;
+	memo.Values.clear();
+}
+
+/**
+ * Returns into how many partitions rows should be split to be processed in parallel.
+ * Small tables aren't worth the synchronization.
+ */
+size_t Table::GetPartitions(size_t rows)
+{
+	if (rows < 10000)
+		return 1;
+
+	return std::max<size_t>(1, std::min<size_t>(Configuration::Concurrency, rows / 5000));
+}
+
+/**
+ * Calls func for every partition in [0, partitions), in parallel on the thread pool.
+ *
+ * The calling thread works on the partitions as well and waits for the others to finish, so
+ * this doesn't depend on free workers. The first exception is rethrown.
+ */
+void Table::RunPartitioned(size_t partitions, const std::function<void (size_t)>& func)
+{
+	struct PartitionedRun
+	{
+		Atomic<size_t> Next{0};
+		std::mutex Mutex;
+		std::condition_variable CV;
+		size_t Done{0};
+		std::exception_ptr Error;
+	};
+
+	auto run (std::make_shared<PartitionedRun>());
+
+	/* func is only called for partitions which aren't done yet, so the reference stays valid. */
+	auto work ([run, partitions, &func]() {
+		for (;;) {
+			size_t partition = run->Next.fetch_add(1);
+
+			if (partition >= partitions)
+				break;
+
+			std::exception_ptr error;
+
+			try {
+				func(partition);
+			} catch (...) {
+				error = std::current_exception();
+			}
+
+			ResetColumnValueMemo();
+
+			std::unique_lock<std::mutex> lock (run->Mutex);
+
+			if (error && !run->Error)
+				run->Error = error;
+
+			if (++run->Done == partitions)
+				run->CV.notify_all();
+		}
+	});
+
+	for (size_t i = 1; i < partitions; i++)
+		Utility::QueueAsyncCallback(work);
+
+	work();
+
+	std::unique_lock<std::mutex> lock (run->Mutex);
+	run->CV.wait(lock, [&run, partitions]() { return run->Done == partitions; });
+
+	if (run->Error)
+		std::rethrow_exception(run->Error);
+}
+
 std::vector<String> Table::GetColumnNames() const
 {
 	std::vector<String> names;
@@ -110,13 +261,77 @@ std::vector<LivestatusRowValue> Table::FilterRows(const Filter::Ptr& filter, int
 {
 	std::vector<LivestatusRowValue> rs;
 
-	FetchRows([this, filter, limit, &rs](const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject) {
+	AddRowFunction addRowFn = [this, filter, limit, &rs](const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject) {
 		return FilteredAddRow(rs, filter, limit, row, groupByType, groupByObject);
+	};
+
+	if (filter) {
+		std::map<String, String> equalities, keys;
+		String prefix = GetPrefix() + "_";
+
+		filter->CollectEqualities(equalities);
+
+		for (auto& kv : equalities) {
+			String column = kv.first;
+
+			if (column.Find(prefix) == 0)
+				column = column.SubStr(prefix.GetLength());
+
+			keys.emplace(std::move(column), kv.second);
+		}
+
+		/* The rows are still filtered, the keys only narrow down which ones are fetched. */
+		if (!keys.empty() && FetchRowsByKeys(keys, addRowFn)) {
+			ResetColumnValueMemo();
+			return rs;
+		}
+	}
+
+	if (!filter || limit != -1) {
+		FetchRows(addRowFn);
+		ResetColumnValueMemo();
+		return rs;
+	}
+
+	/* Fetching the rows is cheap compared to filtering them, large tables are filtered in parallel. */
+	std::vector<LivestatusRowValue> rows;
+
+	FetchRows([&rows](const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject) {
+		rows.emplace_back(LivestatusRowValue{row, groupByType, groupByObject});
+		return true;
 	});
 
+	size_t partitions = GetPartitions(rows.size());
+	std::vector<std::vector<LivestatusRowValue> > results (partitions);
+	Table::Ptr self (this);
+
+	RunPartitioned(partitions, [&self, &filter, &rows, &results, partitions](size_t partition) {
+		size_t begin = rows.size() * partition / partitions;
+		size_t end = rows.size() * (partition + 1) / partitions;
+
+		for (size_t i = begin; i < end; i++) {
+			if (filter->Apply(self, rows[i].Row))
+				results[partition].emplace_back(std::move(rows[i]));
+		}
+	});
+
+	/* in the order FetchRows() returned them */
+	for (auto& result : results)
+		std::move(result.begin(), result.end(), std::back_inserter(rs));
+
 	return rs;
 }
 
+/**
+ * Fetches only the rows which may match the "column = value" keys (without prefix), e.g. by looking up the object by name.
+ *
+ * @return Whether the table supports any of the keys, otherwise FetchRows() is used
+ */
+bool Table::FetchRowsByKeys(const std::map<String, String>&, const AddRowFunction&)
+{
+	return false;
+}
+
 bool Table::FilteredAddRow(std::vector<LivestatusRowValue>& rs, const Filter::Ptr& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
 {
 	if (limit != -1 && static_cast<int>(rs.size()) == limit)
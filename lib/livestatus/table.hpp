@@ -7,6 +7,8 @@
 #include "base/object.hpp"
 #include "base/dictionary.hpp"
 #include "base/array.hpp"
+#include <cstdint>
+#include <functional>
 #include <vector>
 
 namespace icinga
@@ -42,14 +44,19 @@ public:
 
 	void AddColumn(const String& name, const Column& column);
 	Column GetColumn(const String& name) const;
+	Value GetColumnValue(const String& name, const Value& row);
 	std::vector<String> GetColumnNames() const;
 
 	LivestatusGroupByType GetGroupByType() const;
 
+	static size_t GetPartitions(size_t rows);
+	static void RunPartitioned(size_t partitions, const std::function<void (size_t)>& func);
+
 protected:
 	Table(LivestatusGroupByType type = LivestatusGroupByNone);
 
 	virtual void FetchRows(const AddRowFunction& addRowFn) = 0;
+	virtual bool FetchRowsByKeys(const std::map<String, String>& keys, const AddRowFunction& addRowFn);
 
 	static Value ZeroAccessor(const Value&);
 	static Value OneAccessor(const Value&);
@@ -62,6 +69,9 @@ protected:
 
 private:
 	std::map<String, Column> m_Columns;
+	uint_fast64_t m_Id;
+
+	static void ResetColumnValueMemo();
 
 	bool FilteredAddRow(std::vector<LivestatusRowValue>& rs, const intrusive_ptr<Filter>& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject);
 };
@@ -0,0 +1,296 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef _WIN32
+
+#include "methods/checkworker.hpp"
+#include "base/array.hpp"
+#include "base/convert.hpp"
+#include "base/exception.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/date_time/posix_time/posix_time_duration.hpp>
+#include <istream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace icinga;
+
+std::mutex CheckWorker::m_InstancesMutex;
+std::map<String, CheckWorker::Ptr> CheckWorker::m_Instances;
+
+CheckWorker::CheckWorker(const String& executable)
+	: m_Executable(executable), m_Strand(IoEngine::Get().GetIoContext()), m_QueuedWrites(IoEngine::Get().GetIoContext())
+{
+}
+
+/**
+ * @param executable The worker program, there's one (lazily started) process per executable
+ */
+CheckWorker::Ptr CheckWorker::GetInstance(const String& executable)
+{
+	std::unique_lock<std::mutex> lock (m_InstancesMutex);
+	auto& instance (m_Instances[executable]);
+
+	if (!instance) {
+		instance = new CheckWorker(executable);
+	}
+
+	return instance;
+}
+
+/**
+ * Lets the worker run a check and calls back with its result (an UNKNOWN one if the worker fails).
+ *
+ * @param arguments The resolved command line
+ * @param env Additional environment variables
+ * @param timeout Seconds after which to give up on the check (0 = never)
+ */
+void CheckWorker::Execute(const Process::Arguments& arguments, const Dictionary::Ptr& env, int timeout,
+	const std::function<void(const ProcessResult&)>& callback)
+{
+	Ptr keepAlive (this);
+
+	boost::asio::post(m_Strand, [this, keepAlive, arguments, env, timeout, callback]() {
+		auto id (++m_LastId);
+
+		m_Pending.emplace(id, PendingCheck{callback, Utility::GetTime(), nullptr});
+
+		if (!m_Socket) {
+			try {
+				Start();
+			} catch (const std::exception& ex) {
+				Finish(id, 3, "Can't start check worker '" + m_Executable + "': " + DiagnosticInformation(ex, false));
+				return;
+			}
+		}
+
+		if (timeout > 0) {
+			m_Pending[id].Timeout = new Timeout(m_Strand.context(), m_Strand, boost::posix_time::seconds(timeout),
+				[this, keepAlive, id](boost::asio::yield_context) {
+					Finish(id, 3, "<Timeout exceeded.>");
+				}
+			);
+		}
+
+		Dictionary::Ptr request = new Dictionary({
+			{ "id", id },
+			{ "arguments", Array::FromVector(arguments) },
+			{ "env", env ? env : new Dictionary() },
+			{ "timeout", timeout }
+		});
+
+		m_Writes.emplace_back(JsonEncode(request) + "\n");
+		m_QueuedWrites.Set();
+	});
+}
+
+/**
+ * Spawns the worker process with one end of a new socket pair as its stdin (on m_Strand).
+ */
+void CheckWorker::Start()
+{
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("socketpair")
+			<< boost::errinfo_errno(errno));
+	}
+
+	Utility::SetCloExec(fds[0]);
+	Utility::SetCloExec(fds[1]);
+
+	auto socket (Shared<Socket>::Make(m_Strand.context()));
+
+	try {
+		socket->assign(boost::asio::local::stream_protocol(), fds[0]);
+	} catch (...) {
+		close(fds[0]);
+		close(fds[1]);
+		throw;
+	}
+
+	Process::Ptr process = new Process(Process::Arguments{m_Executable});
+	Ptr keepAlive (this);
+
+	process->SetTimeout(0);
+	process->SetAdjustPriority(true);
+	process->SetStdin(fds[1]);
+
+	try {
+		process->Run([this, keepAlive, socket](const ProcessResult& pr) {
+			Log(pr.ExitStatus ? LogWarning : LogNotice, "CheckWorker")
+				<< "Check worker '" << m_Executable << "' (PID: " << pr.PID << ") terminated with exit code "
+				<< pr.ExitStatus << ", output: " << pr.Output;
+
+			boost::asio::post(m_Strand, [this, keepAlive, socket, pr]() {
+				if (m_Socket == socket) {
+					Reset("terminated with exit code " + Convert::ToString(pr.ExitStatus));
+				}
+			});
+		});
+	} catch (...) {
+		close(fds[1]);
+		throw;
+	}
+
+	close(fds[1]);
+
+	m_Socket = socket;
+	m_PID = process->GetPID();
+
+	Log(LogInformation, "CheckWorker")
+		<< "Started check worker '" << m_Executable << "' (PID: " << m_PID << ").";
+
+	IoEngine::SpawnCoroutine(m_Strand, [this, keepAlive, socket](boost::asio::yield_context yc) { ReadLoop(socket, yc); });
+	IoEngine::SpawnCoroutine(m_Strand, [this, keepAlive, socket](boost::asio::yield_context yc) { WriteLoop(socket, yc); });
+}
+
+/**
+ * Dispatches the worker's responses until socket gets replaced (on m_Strand).
+ */
+void CheckWorker::ReadLoop(const Shared<Socket>::Ptr& socket, boost::asio::yield_context yc)
+{
+	boost::asio::streambuf buf;
+
+	for (;;) {
+		boost::system::error_code ec;
+
+		boost::asio::async_read_until(*socket, buf, '\n', yc[ec]);
+
+		if (m_Socket != socket) {
+			return;
+		}
+
+		if (ec) {
+			Reset("closed the connection: " + ec.message());
+			return;
+		}
+
+		std::string line;
+		std::istream stream (&buf);
+
+		std::getline(stream, line);
+
+		uint_fast64_t id;
+		long exitStatus;
+		String output;
+
+		try {
+			Dictionary::Ptr response = JsonDecode(line);
+
+			if (!response) {
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Response must be a JSON object"));
+			}
+
+			id = Convert::ToLong(response->Get("id"));
+			exitStatus = Convert::ToLong(response->Get("exit_status"));
+			output = response->Get("output");
+		} catch (const std::exception& ex) {
+			Reset("sent an invalid response: " + DiagnosticInformation(ex, false));
+			return;
+		}
+
+		Finish(id, exitStatus, output);
+	}
+}
+
+/**
+ * Sends the queued requests until socket gets replaced (on m_Strand).
+ */
+void CheckWorker::WriteLoop(const Shared<Socket>::Ptr& socket, boost::asio::yield_context yc)
+{
+	for (;;) {
+		m_QueuedWrites.Wait(yc);
+
+		while (!m_Writes.empty()) {
+			if (m_Socket != socket) {
+				return;
+			}
+
+			auto request (std::move(m_Writes.front()));
+			boost::system::error_code ec;
+
+			m_Writes.pop_front();
+			boost::asio::async_write(*socket, boost::asio::buffer(request.CStr(), request.GetLength()), yc[ec]);
+
+			if (m_Socket != socket) {
+				return;
+			}
+
+			if (ec) {
+				Reset("closed the connection: " + ec.message());
+				return;
+			}
+		}
+
+		if (m_Socket != socket) {
+			return;
+		}
+
+		m_QueuedWrites.Clear();
+	}
+}
+
+/**
+ * Calls the pending check's callback back with the given result, if not already done (on m_Strand).
+ */
+void CheckWorker::Finish(uint_fast64_t id, long exitStatus, const String& output)
+{
+	auto pending (m_Pending.find(id));
+
+	if (pending == m_Pending.end()) {
+		return;
+	}
+
+	if (pending->second.Timeout) {
+		pending->second.Timeout->Cancel();
+	}
+
+	ProcessResult pr;
+	pr.PID = m_PID;
+	pr.ExecutionStart = pending->second.ExecutionStart;
+	pr.ExecutionEnd = Utility::GetTime();
+	pr.ExitStatus = exitStatus;
+	pr.Output = output;
+
+	auto callback (std::move(pending->second.Callback));
+
+	m_Pending.erase(pending);
+
+	Utility::QueueAsyncCallback([callback, pr]() { callback(pr); });
+}
+
+/**
+ * Disconnects from the worker and fails all pending checks, the next one starts a new worker (on m_Strand).
+ */
+void CheckWorker::Reset(const String& reason)
+{
+	Log(LogWarning, "CheckWorker")
+		<< "Check worker '" << m_Executable << "' (PID: " << m_PID << ") " << reason;
+
+	if (m_Socket) {
+		boost::system::error_code ec;
+
+		// The worker reads EOF and exits (if still alive).
+		m_Socket->close(ec);
+		m_Socket = nullptr;
+	}
+
+	m_Writes.clear();
+	m_QueuedWrites.Set();
+
+	while (!m_Pending.empty()) {
+		Finish(m_Pending.begin()->first, 3, "Check worker '" + m_Executable + "' " + reason);
+	}
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,84 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef CHECKWORKER_H
+#define CHECKWORKER_H
+
+#ifndef _WIN32
+
+#include "methods/i2-methods.hpp"
+#include "base/dictionary.hpp"
+#include "base/io-engine.hpp"
+#include "base/process.hpp"
+#include "base/shared.hpp"
+#include "base/shared-object.hpp"
+#include "base/string.hpp"
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/spawn.hpp>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+
+namespace icinga
+{
+
+/**
+ * A persistent process running many checks. Its stdin is a UNIX socket carrying one JSON object per line:
+ *
+ * Requests: {"id":1,"arguments":["check_ping","-H","localhost"],"env":{"FOO":"bar"},"timeout":60}
+ * Responses (written back to stdin, in any order): {"id":1,"exit_status":0,"output":"PING OK | rta=0.1ms"}
+ *
+ * The worker shall exit once it reads EOF. Its stdout and stderr are logged after it exited.
+ *
+ * @ingroup methods
+ */
+class CheckWorker final : public SharedObject
+{
+public:
+	DECLARE_PTR_TYPEDEFS(CheckWorker);
+
+	static CheckWorker::Ptr GetInstance(const String& executable);
+
+	void Execute(const Process::Arguments& arguments, const Dictionary::Ptr& env, int timeout,
+		const std::function<void(const ProcessResult&)>& callback);
+
+private:
+	typedef boost::asio::local::stream_protocol::socket Socket;
+
+	struct PendingCheck
+	{
+		std::function<void(const ProcessResult&)> Callback;
+		double ExecutionStart;
+		Timeout::Ptr Timeout;
+	};
+
+	CheckWorker(const String& executable);
+
+	void Start();
+	void ReadLoop(const Shared<Socket>::Ptr& socket, boost::asio::yield_context yc);
+	void WriteLoop(const Shared<Socket>::Ptr& socket, boost::asio::yield_context yc);
+	void Finish(uint_fast64_t id, long exitStatus, const String& output);
+	void Reset(const String& reason);
+
+	static std::mutex m_InstancesMutex;
+	static std::map<String, CheckWorker::Ptr> m_Instances;
+
+	String m_Executable;
+	boost::asio::io_context::strand m_Strand;
+
+	// Everything below is only accessed on m_Strand.
+	Shared<Socket>::Ptr m_Socket;
+	pid_t m_PID = -1;
+	uint_fast64_t m_LastId = 0;
+	std::map<uint_fast64_t, PendingCheck> m_Pending;
+	std::deque<String> m_Writes;
+	AsioConditionVariable m_QueuedWrites;
+};
+
+}
+
+#endif /* _WIN32 */
+
+#endif /* CHECKWORKER_H */
@@ -13,7 +13,13 @@
 #include "base/utility.hpp"
 #include "base/function.hpp"
 #include "base/configtype.hpp"
+#include "base/perfdatavalue.hpp"
 #include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/replace.hpp>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
 
 using namespace icinga;
 
@@ -73,6 +79,13 @@ void ClusterCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRe
 		state = ServiceOK;
 	}
 
+	Dictionary::Ptr jsonRpc = status->Get("json_rpc");
+	Dictionary::Ptr messagesByMethod = jsonRpc->Get("messages_by_method");
+	String topMethods = FormatTopMethods(messagesByMethod);
+
+	if (!topMethods.IsEmpty())
+		output += "\nMost bytes sent and received by JSON-RPC method: " + topMethods;
+
 	if (Checkable::ExecuteCommandProcessFinishedHandler) {
 		double now = Utility::GetTime();
 		ProcessResult pr;
@@ -86,6 +99,7 @@ void ClusterCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRe
 	} else {
 		/* use feature stats perfdata */
 		std::pair<Dictionary::Ptr, Array::Ptr> feature_stats = CIB::GetFeatureStats();
+		AddMethodPerfdata(feature_stats.second, messagesByMethod);
 		cr->SetPerformanceData(feature_stats.second);
 
 		cr->SetCommand(commandName);
@@ -115,3 +129,47 @@ String ClusterCheckTask::FormatArray(const Array::Ptr& arr)
 
 	return str;
 }
+
+/**
+ * Formats the five JSON-RPC methods with the most bytes sent and received, e.g. "event::CheckResult (1234 B), ...".
+ */
+String ClusterCheckTask::FormatTopMethods(const Dictionary::Ptr& messagesByMethod)
+{
+	std::vector<std::pair<double, String>> methods;
+
+	{
+		ObjectLock olock(messagesByMethod);
+		for (const Dictionary::Pair& kv : messagesByMethod) {
+			Dictionary::Ptr counters = kv.second;
+			methods.emplace_back(counters->Get("bytes_sent") + counters->Get("bytes_received"), kv.first);
+		}
+	}
+
+	std::sort(methods.begin(), methods.end(), std::greater<std::pair<double, String>>());
+
+	std::vector<String> top;
+
+	for (size_t i = 0; i < methods.size() && i < 5; i++)
+		top.emplace_back(methods[i].second + " (" + Convert::ToString(methods[i].first) + " B)");
+
+	return boost::algorithm::join(top, ", ");
+}
+
+/**
+ * Adds the messages and bytes per JSON-RPC method as counters, e.g. "json_rpc_event_CheckResult_bytes_sent".
+ */
+void ClusterCheckTask::AddMethodPerfdata(const Array::Ptr& perfdata, const Dictionary::Ptr& messagesByMethod)
+{
+	ObjectLock olock(messagesByMethod);
+	for (const Dictionary::Pair& kv : messagesByMethod) {
+		Dictionary::Ptr counters = kv.second;
+		String prefix = "json_rpc_" + kv.first + "_";
+
+		boost::algorithm::replace_all(prefix, "::", "_");
+
+		perfdata->Add(new PerfdataValue(prefix + "messages_sent", counters->Get("messages_sent"), true));
+		perfdata->Add(new PerfdataValue(prefix + "bytes_sent", counters->Get("bytes_sent"), true, "B"));
+		perfdata->Add(new PerfdataValue(prefix + "messages_received", counters->Get("messages_received"), true));
+		perfdata->Add(new PerfdataValue(prefix + "bytes_received", counters->Get("bytes_received"), true, "B"));
+	}
+}
@@ -22,6 +22,8 @@ public:
 private:
 	ClusterCheckTask();
 	static String FormatArray(const Array::Ptr& arr);
+	static String FormatTopMethods(const Dictionary::Ptr& messagesByMethod);
+	static void AddMethodPerfdata(const Array::Ptr& perfdata, const Dictionary::Ptr& messagesByMethod);
 };
 
 }
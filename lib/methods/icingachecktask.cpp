@@ -10,10 +10,13 @@
 #include "remote/apilistener.hpp"
 #include "base/application.hpp"
 #include "base/objectlock.hpp"
+#include "base/objectpool.hpp"
 #include "base/utility.hpp"
 #include "base/perfdatavalue.hpp"
+#include "base/signalprofiler.hpp"
 #include "base/function.hpp"
 #include "base/configtype.hpp"
+#include <boost/algorithm/string/replace.hpp>
 
 using namespace icinga;
 
@@ -78,8 +81,35 @@ void IcingaCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRes
 	perfdata->Add(new PerfdataValue("passive_service_checks_15min", CIB::GetPassiveServiceChecksStatistics(60 * 15)));
 
 	perfdata->Add(new PerfdataValue("current_pending_callbacks", Application::GetTP().GetPending()));
+	perfdata->Add(new PerfdataValue("stolen_callbacks", Application::GetTP().GetSteals(), true));
 	perfdata->Add(new PerfdataValue("current_concurrent_checks", Checkable::CurrentConcurrentChecks.load()));
 	perfdata->Add(new PerfdataValue("remote_check_queue", ClusterEvents::GetCheckRequestQueueSize()));
+	perfdata->Add(new PerfdataValue("object_pool_allocations", ObjectPool::GetAllocations(), true));
+	perfdata->Add(new PerfdataValue("object_pool_hits", ObjectPool::GetHits(), true));
+	perfdata->Add(new PerfdataValue("object_pool_cached_bytes", ObjectPool::GetCachedBytes(), false, "bytes"));
+
+	if (SignalProfiler::IsEnabled()) {
+		Dictionary::Ptr signals = SignalProfiler::GetStats();
+		ObjectLock olock (signals);
+
+		for (const Dictionary::Pair& signal : signals) {
+			Dictionary::Ptr owners = signal.second;
+			ObjectLock ownersLock (owners);
+
+			for (const Dictionary::Pair& owner : owners) {
+				Dictionary::Ptr stats = owner.second;
+
+				/* E.g. signal_Checkable_OnNewCheckResult_CompatLogger_cpu_time */
+				String prefix = "signal_" + signal.first + "_" + owner.first + "_";
+				boost::algorithm::replace_all(prefix, "::", "_");
+
+				perfdata->Add(new PerfdataValue(prefix + "calls", stats->Get("calls"), true));
+				perfdata->Add(new PerfdataValue(prefix + "calls_per_second", stats->Get("calls_per_second")));
+				perfdata->Add(new PerfdataValue(prefix + "wall_time", stats->Get("wall_time"), true, "seconds"));
+				perfdata->Add(new PerfdataValue(prefix + "cpu_time", stats->Get("cpu_time"), true, "seconds"));
+			}
+		}
+	}
 
 	CheckableCheckStatistics scs = CIB::CalculateServiceCheckStats();
 
@@ -27,7 +27,10 @@
 #include <boost/beast/http.hpp>
 #include <boost/system/system_error.hpp>
 #include <exception>
+#include <mutex>
 #include <set>
+#include <unordered_map>
+#include <vector>
 
 using namespace icinga;
 
@@ -82,21 +85,83 @@ static void ReportIfwCheckResult(
 	ReportIfwCheckResult(checkable, cmdLine, cr, output, start, end);
 }
 
-static const char* GetUnderstandableError(const std::exception& ex)
+static bool IsCancelled(const std::exception& ex)
 {
 	auto se (dynamic_cast<const boost::system::system_error*>(&ex));
 
-	if (se && se->code() == boost::asio::error::operation_aborted) {
+	return se && se->code() == boost::asio::error::operation_aborted;
+}
+
+static const char* GetUnderstandableError(const std::exception& ex)
+{
+	if (IsCancelled(ex)) {
 		return "Timeout exceeded";
 	}
 
 	return ex.what();
 }
 
+/**
+ * An established connection to an IfW API, kept for the next check with the same endpoint and TLS parameters.
+ */
+struct IfwIdleConnection
+{
+	Shared<AsioTlsStream>::Ptr Conn;
+	double Since;
+};
+
+/* In seconds */
+static const double l_IfwIdleTimeout = 10;
+static const size_t l_IfwMaxIdleConnections = 8;
+
+static std::mutex l_IfwIdleConnectionsMutex;
+static std::unordered_map<String, std::vector<IfwIdleConnection>> l_IfwIdleConnections; // the newest ones last
+
+/**
+ * @return The most recently used idle connection for the pool key or nullptr
+ */
+static Shared<AsioTlsStream>::Ptr TakeIdleIfwConnection(const String& poolKey)
+{
+	std::unique_lock<std::mutex> lock (l_IfwIdleConnectionsMutex);
+
+	auto pool (l_IfwIdleConnections.find(poolKey));
+
+	if (pool == l_IfwIdleConnections.end())
+		return nullptr;
+
+	Shared<AsioTlsStream>::Ptr conn;
+
+	/* If the newest one was idle for too long, so were the others. */
+	if (Utility::GetTime() - pool->second.back().Since < l_IfwIdleTimeout) {
+		conn = std::move(pool->second.back().Conn);
+		pool->second.pop_back();
+	} else {
+		pool->second.clear();
+	}
+
+	if (pool->second.empty())
+		l_IfwIdleConnections.erase(pool);
+
+	return conn;
+}
+
+static void KeepIdleIfwConnection(const String& poolKey, Shared<AsioTlsStream>::Ptr conn)
+{
+	double now = Utility::GetTime();
+	std::unique_lock<std::mutex> lock (l_IfwIdleConnectionsMutex);
+	auto& pool (l_IfwIdleConnections[poolKey]);
+
+	while (!pool.empty() && (pool.size() >= l_IfwMaxIdleConnections || now - pool.front().Since >= l_IfwIdleTimeout))
+		pool.erase(pool.begin());
+
+	pool.push_back({std::move(conn), now});
+}
+
 static void DoIfwNetIo(
 	boost::asio::yield_context yc, const Checkable::Ptr& checkable, const Array::Ptr& cmdLine,
 	const CheckResult::Ptr& cr, const String& psCommand, const String& psHost, const String& san, const String& psPort,
-	AsioTlsStream& conn, boost::beast::http::request<boost::beast::http::string_body>& req, double start
+	Shared<AsioTlsStream>::Ptr& conn, boost::asio::ssl::context& ctx, const String& poolKey,
+	boost::beast::http::request<boost::beast::http::string_body>& req, double start
 )
 {
 	namespace http = boost::beast::http;
@@ -104,77 +169,99 @@ static void DoIfwNetIo(
 	boost::beast::flat_buffer buf;
 	http::response<http::string_body> resp;
 
-	try {
-		Connect(conn.lowest_layer(), psHost, psPort, yc);
-	} catch (const std::exception& ex) {
-		ReportIfwCheckResult(
-			yc, checkable, cmdLine, cr,
-			"Can't connect to IfW API on host '" + psHost + "' port '" + psPort + "': " + GetUnderstandableError(ex),
-			start
-		);
-		return;
-	}
+	conn = TakeIdleIfwConnection(poolKey);
 
-	auto& sslConn (conn.next_layer());
+	/* A kept connection may have been closed by the IfW API meanwhile, then it's retried with a new one. */
+	for (bool reused = (bool)conn;; reused = false) {
+		if (!reused) {
+			conn = Shared<AsioTlsStream>::Make(IoEngine::Get().GetIoContext(), ctx, san);
 
-	try {
-		sslConn.async_handshake(conn.next_layer().client, yc);
-	} catch (const std::exception& ex) {
-		ReportIfwCheckResult(
-			yc, checkable, cmdLine, cr,
-			"TLS handshake with IfW API on host '" + psHost + "' (SNI: '" + san
-				+ "') port '" + psPort + "' failed: " + GetUnderstandableError(ex),
-			start
-		);
-		return;
-	}
+			try {
+				Connect(conn->lowest_layer(), psHost, psPort, yc);
+			} catch (const std::exception& ex) {
+				ReportIfwCheckResult(
+					yc, checkable, cmdLine, cr,
+					"Can't connect to IfW API on host '" + psHost + "' port '" + psPort + "': " + GetUnderstandableError(ex),
+					start
+				);
+				return;
+			}
+
+			auto& sslConn (conn->next_layer());
+
+			try {
+				sslConn.async_handshake(conn->next_layer().client, yc);
+			} catch (const std::exception& ex) {
+				ReportIfwCheckResult(
+					yc, checkable, cmdLine, cr,
+					"TLS handshake with IfW API on host '" + psHost + "' (SNI: '" + san
+						+ "') port '" + psPort + "' failed: " + GetUnderstandableError(ex),
+					start
+				);
+				return;
+			}
+
+			if (!sslConn.IsVerifyOK()) {
+				auto cert (sslConn.GetPeerCertificate());
+				Value cn;
+
+				try {
+					cn = GetCertificateCN(cert);
+				} catch (const std::exception&) {
+				}
 
-	if (!sslConn.IsVerifyOK()) {
-		auto cert (sslConn.GetPeerCertificate());
-		Value cn;
+				ReportIfwCheckResult(
+					yc, checkable, cmdLine, cr,
+					"Certificate validation failed for IfW API on host '" + psHost + "' (SNI: '" + san + "'; CN: "
+						+ (cn.IsString() ? "'" + cn + "'" : "N/A") + ") port '" + psPort + "': " + sslConn.GetVerifyError(),
+					start
+				);
+				return;
+			}
+		}
 
 		try {
-			cn = GetCertificateCN(cert);
-		} catch (const std::exception&) {
+			http::async_write(*conn, req, yc);
+			conn->async_flush(yc);
+		} catch (const std::exception& ex) {
+			if (reused && !IsCancelled(ex))
+				continue;
+
+			ReportIfwCheckResult(
+				yc, checkable, cmdLine, cr,
+				"Can't send HTTP request to IfW API on host '" + psHost + "' port '" + psPort + "': " + GetUnderstandableError(ex),
+				start
+			);
+			return;
 		}
 
-		ReportIfwCheckResult(
-			yc, checkable, cmdLine, cr,
-			"Certificate validation failed for IfW API on host '" + psHost + "' (SNI: '" + san + "'; CN: "
-				+ (cn.IsString() ? "'" + cn + "'" : "N/A") + ") port '" + psPort + "': " + sslConn.GetVerifyError(),
-			start
-		);
-		return;
-	}
+		try {
+			http::async_read(*conn, buf, resp, yc);
+		} catch (const std::exception& ex) {
+			if (reused && !IsCancelled(ex)) {
+				buf.clear();
+				resp = {};
+				continue;
+			}
 
-	try {
-		http::async_write(conn, req, yc);
-		conn.async_flush(yc);
-	} catch (const std::exception& ex) {
-		ReportIfwCheckResult(
-			yc, checkable, cmdLine, cr,
-			"Can't send HTTP request to IfW API on host '" + psHost + "' port '" + psPort + "': " + GetUnderstandableError(ex),
-			start
-		);
-		return;
-	}
+			ReportIfwCheckResult(
+				yc, checkable, cmdLine, cr,
+				"Can't read HTTP response from IfW API on host '" + psHost + "' port '" + psPort + "': " + GetUnderstandableError(ex),
+				start
+			);
+			return;
+		}
 
-	try {
-		http::async_read(conn, buf, resp, yc);
-	} catch (const std::exception& ex) {
-		ReportIfwCheckResult(
-			yc, checkable, cmdLine, cr,
-			"Can't read HTTP response from IfW API on host '" + psHost + "' port '" + psPort + "': " + GetUnderstandableError(ex),
-			start
-		);
-		return;
+		break;
 	}
 
 	double end = Utility::GetTime();
 
-	{
+	if (resp.keep_alive()) {
+		KeepIdleIfwConnection(poolKey, conn);
+	} else {
 		boost::system::error_code ec;
-		sslConn.async_shutdown(yc[ec]);
+		conn->next_layer().async_shutdown(yc[ec]);
 	}
 
 	CpuBoundWork cbw (yc);
@@ -507,25 +594,30 @@ void IfwApiCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRes
 		return;
 	}
 
-	auto conn (Shared<AsioTlsStream>::Make(io, *ctx, expectedSan));
+	/* Connections are only reused for the same endpoint and TLS parameters. */
+	String poolKey = psHost + "\n" + psPort + "\n" + expectedSan + "\n" + cert + "\n" + key + "\n" + ca + "\n" + crl;
 
 	IoEngine::SpawnCoroutine(
 		*strand,
-		[strand, checkable, cmdLine, cr, psCommand, psHost, expectedSan, psPort, conn, req, start, checkTimeout](asio::yield_context yc) {
+		[strand, checkable, cmdLine, cr, psCommand, psHost, expectedSan, psPort, ctx, poolKey, req, start, checkTimeout](asio::yield_context yc) {
+			Shared<AsioTlsStream>::Ptr conn;
+
 			Timeout::Ptr timeout = new Timeout(strand->context(), *strand, boost::posix_time::microseconds(int64_t(checkTimeout * 1e6)),
 				[&conn, &checkable](boost::asio::yield_context yc) {
 					Log(LogNotice, "IfwApiCheckTask")
 						<< "Timeout while checking " << checkable->GetReflectionType()->GetName()
 						<< " '" << checkable->GetName() << "', cancelling attempt";
 
-					boost::system::error_code ec;
-					conn->lowest_layer().cancel(ec);
+					if (conn) {
+						boost::system::error_code ec;
+						conn->lowest_layer().cancel(ec);
+					}
 				}
 			);
 
 			Defer cancelTimeout ([&timeout]() { timeout->Cancel(); });
 
-			DoIfwNetIo(yc, checkable, cmdLine, cr, psCommand, psHost, expectedSan, psPort, *conn, *req, start);
+			DoIfwNetIo(yc, checkable, cmdLine, cr, psCommand, psHost, expectedSan, psPort, conn, *ctx, poolKey, *req, start);
 		}
 	);
 }
@@ -0,0 +1,685 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "methods/netchecktask.hpp"
+#include "icinga/checkcommand.hpp"
+#include "icinga/macroprocessor.hpp"
+#include "icinga/pluginutility.hpp"
+#include "base/application.hpp"
+#include "base/array.hpp"
+#include "base/convert.hpp"
+#include "base/defer.hpp"
+#include "base/function.hpp"
+#include "base/io-engine.hpp"
+#include "base/logger.hpp"
+#include "base/objectlock.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/shared.hpp"
+#include "base/tcpsocket.hpp"
+#include "base/tlsstream.hpp"
+#include "base/tlsutility.hpp"
+#include "base/utility.hpp"
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/system/system_error.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <openssl/asn1.h>
+#include <openssl/x509.h>
+#include <sstream>
+#include <vector>
+#ifdef __linux__
+#	include <sys/socket.h>
+#	include <netinet/in.h>
+#endif /* __linux__ */
+
+using namespace icinga;
+
+REGISTER_FUNCTION_NONCONST(Internal, NetCheck, &NetCheckTask::ScriptFunc, "checkable:cr:resolvedMacros:useResolvedMacros");
+
+namespace
+{
+
+/**
+ * The resolved parameters of one check and where its result goes to
+ */
+struct NetCheck
+{
+	Checkable::Ptr Target;
+	CheckResult::Ptr Result;
+	Value CommandLine;
+	String Protocol;
+	String Address;
+	String Port;
+	String Hostname;
+	Value Warning;
+	Value Critical;
+	Value CertificateWarning;
+	Value CertificateCritical;
+	bool HttpTls;
+	String HttpUri;
+	unsigned IcmpPackets;
+	Value IcmpLossWarning;
+	Value IcmpLossCritical;
+	double Timeout;
+	double Start;
+};
+
+struct NetCheckOutcome
+{
+	ServiceState State;
+	String Output;
+	Array::Ptr Perfdata;
+};
+
+}
+
+static std::mutex l_SslContextMutex;
+static Shared<boost::asio::ssl::context>::Ptr l_SslContext;
+static std::atomic<uint16_t> l_IcmpIdentifier (0);
+
+static void ReportNetCheckResult(const NetCheck& check, const NetCheckOutcome& outcome)
+{
+	double end = Utility::GetTime();
+
+	if (Checkable::ExecuteCommandProcessFinishedHandler) {
+		ProcessResult pr;
+		pr.PID = -1;
+		pr.Output = outcome.Output;
+		pr.ExecutionStart = check.Start;
+		pr.ExecutionEnd = end;
+		pr.ExitStatus = outcome.State;
+
+		if (outcome.Perfdata) {
+			ObjectLock oLock (outcome.Perfdata);
+
+			pr.Output += " |";
+
+			for (PerfdataValue::Ptr pv : outcome.Perfdata) {
+				pr.Output += " " + pv->Format();
+			}
+		}
+
+		Checkable::ExecuteCommandProcessFinishedHandler(check.CommandLine, pr);
+	} else {
+		auto& cr (check.Result);
+
+		cr->SetOutput(outcome.Output);
+		cr->SetPerformanceData(outcome.Perfdata);
+		cr->SetState(outcome.State);
+		cr->SetExitStatus(outcome.State);
+		cr->SetExecutionStart(check.Start);
+		cr->SetExecutionEnd(end);
+		cr->SetCommand(check.CommandLine);
+
+		check.Target->ProcessCheckResult(cr);
+	}
+}
+
+static const char* GetUnderstandableError(const std::exception& ex)
+{
+	auto se (dynamic_cast<const boost::system::system_error*>(&ex));
+
+	if (se && se->code() == boost::asio::error::operation_aborted) {
+		return "Timeout exceeded";
+	}
+
+	return ex.what();
+}
+
+static String FormatSeconds(double seconds)
+{
+	std::ostringstream buf;
+	buf << std::fixed << std::setprecision(3) << seconds;
+	return buf.str();
+}
+
+/**
+ * @return Whether value exceeds the critical or the warning threshold (if given)
+ */
+static ServiceState ApplyThresholds(double value, const Value& warning, const Value& critical)
+{
+	if (!critical.IsEmpty() && value > critical) {
+		return ServiceCritical;
+	}
+
+	if (!warning.IsEmpty() && value > warning) {
+		return ServiceWarning;
+	}
+
+	return ServiceOK;
+}
+
+static NetCheckOutcome MakeTimeOutcome(const NetCheck& check, const String& what, double time, ServiceState state = ServiceOK)
+{
+	state = std::max(state, ApplyThresholds(time, check.Warning, check.Critical));
+
+	return {
+		state,
+		check.Protocol.ToUpper() + " " + Service::StateToString(state) + " - " + what + " in " + FormatSeconds(time) + " second response time",
+		new Array({ new PerfdataValue("time", time, false, "seconds", check.Warning, check.Critical, 0) })
+	};
+}
+
+/**
+ * The CA store is loaded only once as it's pretty expensive to do so for every check.
+ */
+static Shared<boost::asio::ssl::context>::Ptr GetSslContext()
+{
+	std::unique_lock<std::mutex> lock (l_SslContextMutex);
+
+	if (!l_SslContext) {
+		l_SslContext = SetupSslContext(String(), String(), String(), String(), DEFAULT_TLS_CIPHERS, DEFAULT_TLS_PROTOCOLMIN, DebugInfo());
+	}
+
+	return l_SslContext;
+}
+
+static NetCheckOutcome CheckCertificate(const NetCheck& check, UnbufferedAsioTlsStream& tls)
+{
+	if (!tls.IsVerifyOK()) {
+		return {
+			ServiceCritical,
+			"Certificate validation failed for '" + check.Hostname + "': " + tls.GetVerifyError(),
+			new Array()
+		};
+	}
+
+	auto cert (tls.GetPeerCertificate());
+	int days = 0, seconds = 0;
+
+	if (!cert || !ASN1_TIME_diff(&days, &seconds, nullptr, X509_get_notAfter(cert.get()))) {
+		return { ServiceUnknown, "Can't determine the expiry date of the certificate of '" + check.Hostname + "'", new Array() };
+	}
+
+	double left = days + seconds / 86400.0;
+	ServiceState state = ServiceOK;
+
+	if (!check.CertificateCritical.IsEmpty() && left < check.CertificateCritical) {
+		state = ServiceCritical;
+	} else if (!check.CertificateWarning.IsEmpty() && left < check.CertificateWarning) {
+		state = ServiceWarning;
+	}
+
+	String cn;
+
+	try {
+		cn = GetCertificateCN(cert);
+	} catch (const std::exception&) {
+		cn = check.Hostname;
+	}
+
+	return {
+		state,
+		left < 0
+			? "Certificate '" + cn + "' expired " + Convert::ToString(-days) + " day(s) ago"
+			: "Certificate '" + cn + "' expires in " + Convert::ToString(days) + " day(s)",
+		new Array({ new PerfdataValue("certificate_expiry", left, false, "", check.CertificateWarning, check.CertificateCritical) })
+	};
+}
+
+static NetCheckOutcome DoTcpCheck(boost::asio::yield_context yc, const NetCheck& check, boost::asio::ip::tcp::socket& socket)
+{
+	Connect(socket, check.Address, check.Port, yc);
+
+	double time = Utility::GetTime() - check.Start;
+	boost::system::error_code ec;
+
+	socket.shutdown(socket.shutdown_both, ec);
+	socket.close(ec);
+
+	return MakeTimeOutcome(check, "Connected to " + check.Address + " port " + check.Port, time);
+}
+
+static NetCheckOutcome DoTlsHandshake(boost::asio::yield_context yc, const NetCheck& check, AsioTlsStream& stream)
+{
+	Connect(stream.lowest_layer(), check.Address, check.Port, yc);
+
+	auto& tls (stream.next_layer());
+
+	tls.async_handshake(tls.client, yc);
+
+	return CheckCertificate(check, tls);
+}
+
+static NetCheckOutcome DoTlsCheck(boost::asio::yield_context yc, const NetCheck& check, AsioTlsStream& stream)
+{
+	auto certificate (DoTlsHandshake(yc, check, stream));
+	double time = Utility::GetTime() - check.Start;
+
+	{
+		boost::system::error_code ec;
+		stream.next_layer().async_shutdown(yc[ec]);
+	}
+
+	auto outcome (MakeTimeOutcome(check, certificate.Output + ", handshake done", time, certificate.State));
+
+	certificate.Perfdata->CopyTo(outcome.Perfdata);
+
+	return outcome;
+}
+
+template<class Stream>
+static NetCheckOutcome DoHttpRequest(boost::asio::yield_context yc, const NetCheck& check, Stream& stream)
+{
+	namespace http = boost::beast::http;
+
+	static const auto userAgent ("Icinga/" + Application::GetAppVersion());
+
+	http::request<http::empty_body> req;
+
+	req.method(http::verb::get);
+	req.target(check.HttpUri.CStr());
+	req.set(http::field::host, check.Hostname);
+	req.set(http::field::user_agent, userAgent);
+	req.set(http::field::connection, "close");
+
+	http::async_write(stream, req, yc);
+	stream.async_flush(yc);
+
+	boost::beast::flat_buffer buf;
+	http::response<http::string_body> resp;
+
+	http::async_read(stream, buf, resp, yc);
+
+	double time = Utility::GetTime() - check.Start;
+	auto status (resp.result_int());
+	ServiceState state = status >= 500 ? ServiceCritical : status >= 400 ? ServiceWarning : ServiceOK;
+
+	std::ostringstream what;
+	what << "HTTP/" << resp.version() / 10 << "." << resp.version() % 10 << " " << status << " " << resp.reason()
+		<< " - " << resp.body().size() << " bytes";
+
+	auto outcome (MakeTimeOutcome(check, what.str(), time, state));
+
+	outcome.Perfdata->Add(new PerfdataValue("size", resp.body().size(), false, "bytes", Empty, Empty, 0));
+
+	return outcome;
+}
+
+static NetCheckOutcome DoHttpCheck(boost::asio::yield_context yc, const NetCheck& check, AsioTcpStream& stream)
+{
+	Connect(stream.lowest_layer(), check.Address, check.Port, yc);
+
+	auto outcome (DoHttpRequest(yc, check, stream));
+	boost::system::error_code ec;
+
+	stream.lowest_layer().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+
+	return outcome;
+}
+
+static NetCheckOutcome DoHttpsCheck(boost::asio::yield_context yc, const NetCheck& check, AsioTlsStream& stream)
+{
+	auto certificate (DoTlsHandshake(yc, check, stream));
+	auto outcome (DoHttpRequest(yc, check, stream));
+
+	{
+		boost::system::error_code ec;
+		stream.next_layer().async_shutdown(yc[ec]);
+	}
+
+	if (certificate.State > outcome.State) {
+		outcome.State = certificate.State;
+		outcome.Output = check.Protocol.ToUpper() + " " + Service::StateToString(outcome.State) + " - "
+			+ certificate.Output + "; " + outcome.Output;
+	}
+
+	certificate.Perfdata->CopyTo(outcome.Perfdata);
+
+	return outcome;
+}
+
+static uint16_t GetIcmpChecksum(const unsigned char* data, size_t length)
+{
+	uint_fast32_t sum = 0;
+
+	for (size_t i = 0; i + 1u < length; i += 2u) {
+		sum += (data[i] << 8u) | data[i + 1u];
+	}
+
+	if (length % 2u) {
+		sum += data[length - 1u] << 8u;
+	}
+
+	while (sum >> 16u) {
+		sum = (sum & 0xffffu) + (sum >> 16u);
+	}
+
+	return ~sum;
+}
+
+/**
+ * Opens a raw ICMP socket or (if not permitted) an unprivileged ICMP datagram socket as Linux allows.
+ *
+ * @return Whether the socket is a raw one (i.e. IPv4 replies come with their IP header and all other ICMP traffic)
+ */
+static bool OpenIcmpSocket(boost::asio::ip::icmp::socket& socket, const boost::asio::ip::icmp& protocol)
+{
+	boost::system::error_code ec;
+
+	socket.open(protocol, ec);
+
+	if (!ec) {
+		return true;
+	}
+
+#ifdef __linux__
+	if (ec == boost::asio::error::no_permission || ec == boost::asio::error::access_denied) {
+		int fd = ::socket(protocol.family(), SOCK_DGRAM | SOCK_CLOEXEC, protocol.protocol());
+
+		if (fd >= 0) {
+			socket.assign(protocol, fd, ec);
+
+			if (!ec) {
+				return false;
+			}
+
+			close(fd);
+		}
+	}
+#endif /* __linux__ */
+
+	throw boost::system::system_error(ec, "Can't open ICMP socket (raw sockets require the CAP_NET_RAW capability)");
+}
+
+static NetCheckOutcome DoIcmpCheck(boost::asio::yield_context yc, boost::asio::io_context::strand& strand,
+	const NetCheck& check, boost::asio::ip::icmp::socket& socket)
+{
+	namespace asio = boost::asio;
+	using asio::ip::icmp;
+
+	icmp::resolver resolver (IoEngine::Get().GetIoContext());
+	icmp::resolver::query query (check.Address, "");
+	auto target (resolver.async_resolve(query, yc).begin()->endpoint());
+	bool v6 = target.address().is_v6();
+	bool raw = OpenIcmpSocket(socket, v6 ? icmp::v6() : icmp::v4());
+	uint16_t id = l_IcmpIdentifier.fetch_add(1);
+	std::vector<double> rtts;
+	std::array<unsigned char, 1500> reply;
+
+	for (unsigned seq = 0; seq < check.IcmpPackets; ++seq) {
+		// Echo request: type, code, checksum, identifier, sequence number (as IPv6 likes to have some payload)
+		std::array<unsigned char, 16> request {};
+
+		request[0] = v6 ? 128 : 8;
+		request[4] = id >> 8u;
+		request[5] = id & 0xffu;
+		request[6] = seq >> 8u;
+		request[7] = seq & 0xffu;
+
+		if (!v6) {
+			auto checksum (GetIcmpChecksum(request.data(), request.size()));
+
+			request[2] = checksum >> 8u;
+			request[3] = checksum & 0xffu;
+		}
+
+		double sent = Utility::GetTime();
+
+		socket.async_send_to(asio::buffer(request), target, yc);
+
+		bool lost = false;
+
+		Timeout::Ptr timeout = new Timeout(strand.context(), strand, boost::posix_time::seconds(1),
+			[&socket, &lost](asio::yield_context) {
+				lost = true;
+
+				boost::system::error_code ec;
+				socket.cancel(ec);
+			}
+		);
+
+		Defer cancelTimeout ([&timeout]() { timeout->Cancel(); });
+
+		for (;;) {
+			icmp::endpoint sender;
+			boost::system::error_code ec;
+			auto length (socket.async_receive_from(asio::buffer(reply), sender, yc[ec]));
+
+			if (ec) {
+				if (lost) {
+					break;
+				}
+
+				throw boost::system::system_error(ec);
+			}
+
+			size_t offset = raw && !v6 && length ? (reply[0] & 0x0fu) * 4u : 0u;
+
+			if (length < offset + 8u || sender.address() != target.address() || reply[offset] != (v6 ? 129 : 0)) {
+				continue;
+			}
+
+			// Datagram sockets' identifiers are chosen by the kernel.
+			if (raw && (reply[offset + 4u] << 8u | reply[offset + 5u]) != id) {
+				continue;
+			}
+
+			if ((reply[offset + 6u] << 8u | reply[offset + 7u]) == seq) {
+				rtts.emplace_back(Utility::GetTime() - sent);
+				break;
+			}
+		}
+	}
+
+	double loss = 100.0 * (check.IcmpPackets - rtts.size()) / check.IcmpPackets;
+	auto perfdata (new Array());
+
+	if (rtts.empty()) {
+		perfdata->Add(new PerfdataValue("pl", loss, false, "percent", check.IcmpLossWarning, check.IcmpLossCritical, 0, 100));
+
+		return { ServiceCritical, "PING CRITICAL - Packet loss = 100%", perfdata };
+	}
+
+	double rta = 0;
+
+	for (auto rtt : rtts) {
+		rta += rtt;
+	}
+
+	rta /= rtts.size();
+
+	auto state (std::max(
+		ApplyThresholds(rta, check.Warning, check.Critical),
+		ApplyThresholds(loss, check.IcmpLossWarning, check.IcmpLossCritical)
+	));
+
+	std::ostringstream output;
+	output << "PING " << Service::StateToString(state) << " - Packet loss = " << loss << "%, RTA = "
+		<< std::fixed << std::setprecision(2) << rta * 1000.0 << " ms";
+
+	perfdata->Add(new PerfdataValue("rta", rta, false, "seconds", check.Warning, check.Critical, 0));
+	perfdata->Add(new PerfdataValue("pl", loss, false, "percent", check.IcmpLossWarning, check.IcmpLossCritical, 0, 100));
+
+	return { state, output.str(), perfdata };
+}
+
+/**
+ * Runs the check on a new strand and cancels all I/O on the stream once the check timeout is exceeded.
+ */
+template<class Stream, class DoCheck>
+static void SpawnNetCheck(const NetCheck& check, const typename Shared<Stream>::Ptr& stream, DoCheck doCheck)
+{
+	namespace asio = boost::asio;
+
+	auto strand (Shared<asio::io_context::strand>::Make(IoEngine::Get().GetIoContext()));
+
+	IoEngine::SpawnCoroutine(*strand, [strand, check, stream, doCheck](asio::yield_context yc) {
+		Timeout::Ptr timeout = new Timeout(strand->context(), *strand, boost::posix_time::microseconds(int64_t(check.Timeout * 1e6)),
+			[&stream, &check](asio::yield_context) {
+				Log(LogNotice, "NetCheckTask")
+					<< "Timeout while checking " << check.Target->GetReflectionType()->GetName()
+					<< " '" << check.Target->GetName() << "', cancelling attempt";
+
+				boost::system::error_code ec;
+				stream->lowest_layer().cancel(ec);
+			}
+		);
+
+		Defer cancelTimeout ([&timeout]() { timeout->Cancel(); });
+
+		NetCheckOutcome outcome;
+
+		try {
+			outcome = doCheck(yc, *strand, *stream);
+		} catch (const std::exception& ex) {
+			outcome = {
+				ServiceCritical,
+				check.Protocol.ToUpper() + " CRITICAL - Can't check '" + check.Address + "': " + GetUnderstandableError(ex),
+				nullptr
+			};
+		}
+
+		CpuBoundWork cbw (yc);
+
+		ReportNetCheckResult(check, outcome);
+	});
+}
+
+void NetCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr,
+	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros)
+{
+	namespace asio = boost::asio;
+
+	REQUIRE_NOT_NULL(checkable);
+	REQUIRE_NOT_NULL(cr);
+
+	CheckCommand::Ptr command = CheckCommand::ExecuteOverride ? CheckCommand::ExecuteOverride : checkable->GetCheckCommand();
+	auto lcr (checkable->GetLastCheckResult());
+
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	MacroProcessor::ResolverList resolvers;
+
+	if (MacroResolver::OverrideMacros)
+		resolvers.emplace_back("override", MacroResolver::OverrideMacros);
+
+	if (service)
+		resolvers.emplace_back("service", service);
+	resolvers.emplace_back("host", host);
+	resolvers.emplace_back("command", command);
+
+	auto resolveMacros ([&resolvers, &lcr, &resolvedMacros, useResolvedMacros](const char* macros) -> Value {
+		return MacroProcessor::ResolveMacros(
+			macros, resolvers, lcr, nullptr, MacroProcessor::EscapeCallback(), resolvedMacros, useResolvedMacros
+		);
+	});
+
+	NetCheck check;
+
+	check.Target = checkable;
+	check.Result = cr;
+	check.CommandLine = command->GetName();
+	check.Protocol = resolveMacros("$net_protocol$");
+	check.Address = resolveMacros("$net_address$");
+	check.Port = resolveMacros("$net_port$");
+	check.Hostname = resolveMacros("$net_hostname$");
+	check.Warning = resolveMacros("$net_warning$");
+	check.Critical = resolveMacros("$net_critical$");
+	check.CertificateWarning = resolveMacros("$net_certificate_warning$");
+	check.CertificateCritical = resolveMacros("$net_certificate_critical$");
+	check.HttpTls = resolveMacros("$net_http_ssl$").ToBool();
+	check.HttpUri = resolveMacros("$net_http_uri$");
+
+	Value icmpPackets = resolveMacros("$net_icmp_packets$");
+
+	check.IcmpLossWarning = resolveMacros("$net_icmp_loss_warning$");
+	check.IcmpLossCritical = resolveMacros("$net_icmp_loss_critical$");
+
+	check.Timeout = command->GetTimeout();
+
+	auto checkableTimeout (checkable->GetCheckTimeout());
+
+	if (!checkableTimeout.IsEmpty())
+		check.Timeout = checkableTimeout;
+
+	if (resolvedMacros && !useResolvedMacros)
+		return;
+
+	check.Start = Utility::GetTime();
+
+	try {
+		for (auto threshold : {
+			&check.Warning, &check.Critical, &check.CertificateWarning, &check.CertificateCritical,
+			&check.IcmpLossWarning, &check.IcmpLossCritical
+		}) {
+			if (!threshold->IsEmpty()) {
+				*threshold = Convert::ToDouble(*threshold);
+			}
+		}
+
+		check.IcmpPackets = icmpPackets.IsEmpty() ? 5 : std::max(1l, Convert::ToLong(icmpPackets));
+	} catch (const std::exception& ex) {
+		ReportNetCheckResult(check, { ServiceUnknown, String("Invalid threshold: ") + ex.what(), nullptr });
+		return;
+	}
+
+	if (check.Address.IsEmpty()) {
+		ReportNetCheckResult(check, { ServiceUnknown, "No address given ($net_address$).", nullptr });
+		return;
+	}
+
+	if (check.Hostname.IsEmpty()) {
+		check.Hostname = check.Address;
+	}
+
+	if (check.Port.IsEmpty()) {
+		if (check.Protocol == "http") {
+			check.Port = check.HttpTls ? "443" : "80";
+		} else if (check.Protocol == "tls") {
+			check.Port = "443";
+		}
+	}
+
+	if (check.HttpUri.IsEmpty()) {
+		check.HttpUri = "/";
+	}
+
+	auto& io (IoEngine::Get().GetIoContext());
+
+	try {
+		if (check.Protocol == "icmp") {
+			SpawnNetCheck<asio::ip::icmp::socket>(check, Shared<asio::ip::icmp::socket>::Make(io),
+				[check](asio::yield_context yc, asio::io_context::strand& strand, asio::ip::icmp::socket& socket) {
+					return DoIcmpCheck(yc, strand, check, socket);
+				}
+			);
+		} else if (check.Port.IsEmpty()) {
+			ReportNetCheckResult(check, { ServiceUnknown, "No port given ($net_port$).", nullptr });
+		} else if (check.Protocol == "tcp") {
+			SpawnNetCheck<asio::ip::tcp::socket>(check, Shared<asio::ip::tcp::socket>::Make(io),
+				[check](asio::yield_context yc, asio::io_context::strand&, asio::ip::tcp::socket& socket) {
+					return DoTcpCheck(yc, check, socket);
+				}
+			);
+		} else if (check.Protocol == "tls" || (check.Protocol == "http" && check.HttpTls)) {
+			auto ctx (GetSslContext());
+
+			SpawnNetCheck<AsioTlsStream>(check, Shared<AsioTlsStream>::Make(io, *ctx, check.Hostname),
+				[check, ctx](asio::yield_context yc, asio::io_context::strand&, AsioTlsStream& stream) {
+					return check.Protocol == "tls" ? DoTlsCheck(yc, check, stream) : DoHttpsCheck(yc, check, stream);
+				}
+			);
+		} else if (check.Protocol == "http") {
+			SpawnNetCheck<AsioTcpStream>(check, Shared<AsioTcpStream>::Make(io),
+				[check](asio::yield_context yc, asio::io_context::strand&, AsioTcpStream& stream) {
+					return DoHttpCheck(yc, check, stream);
+				}
+			);
+		} else {
+			ReportNetCheckResult(check, {
+				ServiceUnknown, "Unknown protocol '" + check.Protocol + "' ($net_protocol$), expected one of: icmp, tcp, tls, http", nullptr
+			});
+		}
+	} catch (const std::exception& ex) {
+		ReportNetCheckResult(check, { ServiceUnknown, DiagnosticInformation(ex, false), nullptr });
+	}
+}
@@ -0,0 +1,30 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef NETCHECKTASK_H
+#define NETCHECKTASK_H
+
+#include "methods/i2-methods.hpp"
+#include "icinga/service.hpp"
+#include "base/dictionary.hpp"
+
+namespace icinga
+{
+
+/**
+ * Executes TCP, TLS, HTTP(S) and ICMP checks on the I/O engine, without spawning any process.
+ *
+ * @ingroup methods
+ */
+class NetCheckTask
+{
+public:
+	static void ScriptFunc(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr,
+		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros);
+
+private:
+	NetCheckTask();
+};
+
+}
+
+#endif /* NETCHECKTASK_H */
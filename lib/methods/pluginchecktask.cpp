@@ -2,6 +2,8 @@
 
 #include "methods/pluginchecktask.hpp"
 #include "icinga/pluginutility.hpp"
+#include "icinga/cib.hpp"
+#include "icinga/icingaapplication.hpp"
 #include "icinga/checkcommand.hpp"
 #include "icinga/macroprocessor.hpp"
 #include "base/configtype.hpp"
@@ -47,8 +49,8 @@ void PluginCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRes
 	if (Checkable::ExecuteCommandProcessFinishedHandler) {
 		callback = Checkable::ExecuteCommandProcessFinishedHandler;
 	} else {
-		callback = [checkable, cr](const Value& commandLine, const ProcessResult& pr) {
-			ProcessFinishedHandler(checkable, cr, commandLine, pr);
+		callback = [checkable, cr, maxOutputLength = commandObj->GetMaxOutputLength()](const Value& commandLine, const ProcessResult& pr) {
+			ProcessFinishedHandler(checkable, cr, commandLine, pr, maxOutputLength);
 		};
 	}
 
@@ -61,7 +63,13 @@ void PluginCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckRes
 	}
 }
 
-void PluginCheckTask::ProcessFinishedHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const Value& commandLine, const ProcessResult& pr)
+/**
+ * Fills in the check result from the finished plugin and processes it.
+ *
+ * @param maxOutputLength The CheckCommand's max_output_length, 0 for no limit
+ */
+void PluginCheckTask::ProcessFinishedHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr,
+	const Value& commandLine, const ProcessResult& pr, int maxOutputLength)
 {
 	Checkable::CurrentConcurrentChecks.fetch_sub(1);
 	Checkable::DecreasePendingChecks();
@@ -77,13 +85,64 @@ void PluginCheckTask::ProcessFinishedHandler(const Checkable::Ptr& checkable, co
 	String output = pr.Output.Trim();
 
 	std::pair<String, String> co = PluginUtility::ParseCheckOutput(output);
+	RecordCheckStages(cr, pr);
+
 	cr->SetCommand(commandLine);
-	cr->SetOutput(co.first);
+	cr->SetOutput(PluginUtility::TruncateOutput(co.first, maxOutputLength));
 	cr->SetPerformanceData(PluginUtility::SplitPerfdata(co.second));
 	cr->SetState(PluginUtility::ExitStatusToState(pr.ExitStatus));
 	cr->SetExitStatus(pr.ExitStatus);
 	cr->SetExecutionStart(pr.ExecutionStart);
 	cr->SetExecutionEnd(pr.ExecutionEnd);
 
+	double processingStart = Utility::GetTime();
+
 	checkable->ProcessCheckResult(cr);
+
+	CIB::RecordCheckStage(CheckStage::Processing, Utility::GetTime() - processingStart);
+}
+
+/**
+ * Records the durations of the stages the process went through (and the ones before and after) in the CIB.
+ *
+ * @param cr The check result, still with the execution start set by Checkable::ExecuteCheck()
+ */
+void PluginCheckTask::RecordCheckStages(const CheckResult::Ptr& cr, const ProcessResult& pr)
+{
+	double now = Utility::GetTime();
+	Dictionary::Ptr stages;
+
+	if (IcingaApplication::GetInstance()->GetCheckStagesInVarsAfter())
+		stages = new Dictionary();
+
+	auto record ([&stages](CheckStage stage, double from, double to) {
+		if (from <= 0 || to < from)
+			return;
+
+		CIB::RecordCheckStage(stage, to - from);
+
+		if (stages)
+			stages->Set(CIB::GetCheckStageName(stage), to - from);
+	});
+
+	record(CheckStage::Prepare, cr->GetExecutionStart(), pr.ExecutionStart);
+
+	if (pr.SpawnHelperAcquired > 0) {
+		record(CheckStage::SpawnQueue, pr.ExecutionStart, pr.SpawnHelperAcquired);
+		record(CheckStage::Spawn, pr.SpawnHelperAcquired, pr.Spawned);
+	} else {
+		record(CheckStage::Spawn, pr.ExecutionStart, pr.Spawned);
+	}
+
+	if (pr.OutputClosed > 0) {
+		record(CheckStage::Plugin, pr.Spawned, pr.OutputClosed);
+		record(CheckStage::Reap, pr.OutputClosed, pr.ExecutionEnd);
+	} else {
+		record(CheckStage::Plugin, pr.Spawned, pr.ExecutionEnd);
+	}
+
+	record(CheckStage::CallbackQueue, pr.ExecutionEnd, now);
+
+	if (stages)
+		cr->SetVarsAfter(new Dictionary({ { "check_stages", stages } }));
 }
@@ -21,11 +21,13 @@ public:
 	static void ScriptFunc(const Checkable::Ptr& service, const CheckResult::Ptr& cr,
 		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros);
 
+	static void ProcessFinishedHandler(const Checkable::Ptr& service,
+		const CheckResult::Ptr& cr, const Value& commandLine, const ProcessResult& pr, int maxOutputLength = 0);
+
 private:
 	PluginCheckTask();
 
-	static void ProcessFinishedHandler(const Checkable::Ptr& service,
-		const CheckResult::Ptr& cr, const Value& commandLine, const ProcessResult& pr);
+	static void RecordCheckStages(const CheckResult::Ptr& cr, const ProcessResult& pr);
 };
 
 }
@@ -0,0 +1,73 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "methods/workerchecktask.hpp"
+#include "methods/checkworker.hpp"
+#include "methods/pluginchecktask.hpp"
+#include "icinga/pluginutility.hpp"
+#include "icinga/checkcommand.hpp"
+#include "icinga/macroprocessor.hpp"
+#include "base/function.hpp"
+#include "base/process.hpp"
+
+using namespace icinga;
+
+REGISTER_FUNCTION_NONCONST(Internal, WorkerCheck,  &WorkerCheckTask::ScriptFunc, "checkable:cr:resolvedMacros:useResolvedMacros");
+
+/**
+ * Like PluginCheckTask::ScriptFunc, but lets the worker process named by the command line's first argument run the check.
+ */
+void WorkerCheckTask::ScriptFunc(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr,
+	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros)
+{
+	REQUIRE_NOT_NULL(checkable);
+	REQUIRE_NOT_NULL(cr);
+
+	CheckCommand::Ptr commandObj = CheckCommand::ExecuteOverride ? CheckCommand::ExecuteOverride : checkable->GetCheckCommand();
+
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	MacroProcessor::ResolverList resolvers;
+
+	if (MacroResolver::OverrideMacros)
+		resolvers.emplace_back("override", MacroResolver::OverrideMacros);
+
+	if (service)
+		resolvers.emplace_back("service", service);
+	resolvers.emplace_back("host", host);
+	resolvers.emplace_back("command", commandObj);
+
+	int timeout = commandObj->GetTimeout();
+
+	if (!checkable->GetCheckTimeout().IsEmpty())
+		timeout = checkable->GetCheckTimeout();
+
+	std::function<void(const Value& commandLine, const ProcessResult&)> callback;
+
+	if (Checkable::ExecuteCommandProcessFinishedHandler) {
+		callback = Checkable::ExecuteCommandProcessFinishedHandler;
+	} else {
+		callback = [checkable, cr, maxOutputLength = commandObj->GetMaxOutputLength()](const Value& commandLine, const ProcessResult& pr) {
+			PluginCheckTask::ProcessFinishedHandler(checkable, cr, commandLine, pr, maxOutputLength);
+		};
+	}
+
+	PluginUtility::Executor executor;
+
+	/* Without UNIX sockets (Windows) the command runs as a plugin. */
+#ifndef _WIN32
+	executor = [](const Process::Arguments& arguments, const Dictionary::Ptr& env, int timeout,
+		const std::function<void(const ProcessResult&)>& callback) {
+		CheckWorker::GetInstance(arguments.at(0))->Execute(arguments, env, timeout, callback);
+	};
+#endif /* _WIN32 */
+
+	PluginUtility::ExecuteCommand(commandObj, checkable, checkable->GetLastCheckResult(),
+		resolvers, resolvedMacros, useResolvedMacros, timeout, callback, executor);
+
+	if (!resolvedMacros || useResolvedMacros) {
+		Checkable::CurrentConcurrentChecks.fetch_add(1);
+		Checkable::IncreasePendingChecks();
+	}
+}
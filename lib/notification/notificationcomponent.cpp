@@ -44,6 +44,26 @@ void NotificationComponent::Start(bool runtimeCreated)
 		SendNotificationsHandler(checkable, type, cr, author, text);
 	});
 
+	/* Everything NotificationTimerHandler() skips notifications for until it changes. */
+	for (auto changed : { &Notification::OnNextNotificationChanged, &Notification::OnIntervalChanged, &Notification::OnNoMoreNotificationsChanged,
+		&Notification::OnStashedNotificationsChanged, &Notification::OnSuppressedNotificationsChanged }) {
+		changed->connect([this](const Notification::Ptr& notification, const Value&) { UpdateSchedule(notification); });
+	}
+
+	for (auto changed : { &ConfigObject::OnActiveChanged, &ConfigObject::OnPausedChanged }) {
+		changed->connect([this](const ConfigObject::Ptr& object, const Value&) {
+			auto notification (dynamic_pointer_cast<Notification>(object));
+
+			if (notification)
+				UpdateSchedule(notification);
+		});
+	}
+
+	Checkable::OnEnableNotificationsChanged.connect([this](const Checkable::Ptr& checkable, const Value&) { UpdateSchedule(checkable); });
+	IcingaApplication::OnEnableNotificationsChanged.connect([this](const IcingaApplication::Ptr&, const Value&) { UpdateScheduleAll(); });
+
+	UpdateScheduleAll();
+
 	m_NotificationTimer = Timer::Create();
 	m_NotificationTimer->SetInterval(5);
 	m_NotificationTimer->OnTimerExpired.connect([this](const Timer * const&) { NotificationTimerHandler(); });
@@ -123,10 +143,66 @@ void FireSuppressedNotifications(const Notification::Ptr& notification)
 	}
 }
 
+/**
+ * Updates whether and when NotificationTimerHandler() has to look at the notification.
+ */
+void NotificationComponent::UpdateSchedule(const Notification::Ptr& notification)
+{
+	bool active = notification->IsActive();
+	bool pending = false;
+	bool reminders = false;
+	double nextNotification = notification->GetNextNotification();
+
+	if (active) {
+		auto stashedNotifications (notification->GetStashedNotifications());
+
+		pending = (stashedNotifications && stashedNotifications->GetLength()) || notification->GetSuppressedNotifications();
+
+		auto checkable (notification->GetCheckable());
+
+		reminders = !(notification->GetInterval() <= 0 && notification->GetNoMoreNotifications())
+			&& !(notification->IsPaused() && Endpoint::GetLocalEndpoint() && GetEnableHA())
+			&& IcingaApplication::GetInstance()->GetEnableNotifications()
+			&& checkable && checkable->GetEnableNotifications();
+	}
+
+	std::unique_lock<std::mutex> lock (m_ScheduleMutex);
+
+	if (pending)
+		m_Pending.insert(notification);
+	else
+		m_Pending.erase(notification);
+
+	auto& idx (m_Reminders.get<0>());
+	auto it (idx.find(notification));
+
+	if (!reminders) {
+		if (it != idx.end())
+			idx.erase(it);
+	} else if (it == idx.end()) {
+		idx.insert({ notification, nextNotification });
+	} else if (it->NextNotification != nextNotification) {
+		idx.modify(it, [nextNotification](NotificationScheduleInfo& info) { info.NextNotification = nextNotification; });
+	}
+}
+
+void NotificationComponent::UpdateSchedule(const Checkable::Ptr& checkable)
+{
+	for (const Notification::Ptr& notification : checkable->GetNotifications())
+		UpdateSchedule(notification);
+}
+
+void NotificationComponent::UpdateScheduleAll()
+{
+	for (const Notification::Ptr& notification : ConfigType::GetObjectsByType<Notification>())
+		UpdateSchedule(notification);
+}
+
 /**
  * Periodically sends notifications.
  *
- * @param - Event arguments for the timer.
+ * Only looks at notifications with stashed or suppressed notifications and at
+ * the ones due for a reminder notification, see UpdateSchedule().
  */
 void NotificationComponent::NotificationTimerHandler()
 {
@@ -135,129 +211,150 @@ void NotificationComponent::NotificationTimerHandler()
 	/* Function already checks whether 'api' feature is enabled. */
 	Endpoint::Ptr myEndpoint = Endpoint::GetLocalEndpoint();
 
-	for (const Notification::Ptr& notification : ConfigType::GetObjectsByType<Notification>()) {
-		if (!notification->IsActive())
-			continue;
+	std::set<Notification::Ptr> notifications;
 
-		String notificationName = notification->GetName();
-		bool updatedObjectAuthority = ApiListener::UpdatedObjectAuthority();
+	{
+		std::unique_lock<std::mutex> lock (m_ScheduleMutex);
 
-		/* Skip notification if paused, in a cluster setup & HA feature is enabled. */
-		if (notification->IsPaused()) {
-			if (updatedObjectAuthority) {
-				auto stashedNotifications (notification->GetStashedNotifications());
-				ObjectLock olock(stashedNotifications);
+		notifications = m_Pending;
 
-				if (stashedNotifications->GetLength()) {
-					Log(LogNotice, "NotificationComponent")
-						<< "Notification '" << notificationName << "': HA cluster active, this endpoint does not have the authority. Dropping all stashed notifications.";
+		auto& idx (m_Reminders.get<1>());
 
-					stashedNotifications->Clear();
-				}
-			}
+		for (auto it (idx.begin()); it != idx.end() && it->NextNotification <= now; ++it)
+			notifications.insert(it->Object);
+	}
+
+	for (const Notification::Ptr& notification : notifications) {
+		ProcessNotification(notification, now, myEndpoint);
 
-			if (myEndpoint && GetEnableHA()) {
+		/* Stashed notifications are sent or dropped without a change event. */
+		UpdateSchedule(notification);
+	}
+}
+
+void NotificationComponent::ProcessNotification(const Notification::Ptr& notification, double now, const Endpoint::Ptr& myEndpoint)
+{
+	if (!notification->IsActive())
+		return;
+
+	String notificationName = notification->GetName();
+	bool updatedObjectAuthority = ApiListener::UpdatedObjectAuthority();
+
+	/* Skip notification if paused, in a cluster setup & HA feature is enabled. */
+	if (notification->IsPaused()) {
+		if (updatedObjectAuthority) {
+			auto stashedNotifications (notification->GetStashedNotifications());
+			ObjectLock olock(stashedNotifications);
+
+			if (stashedNotifications->GetLength()) {
 				Log(LogNotice, "NotificationComponent")
-					<< "Reminder notification '" << notificationName << "': HA cluster active, this endpoint does not have the authority (paused=true). Skipping.";
-				continue;
+					<< "Notification '" << notificationName << "': HA cluster active, this endpoint does not have the authority. Dropping all stashed notifications.";
+
+				stashedNotifications->Clear();
 			}
 		}
 
-		Checkable::Ptr checkable = notification->GetCheckable();
+		if (myEndpoint && GetEnableHA()) {
+			Log(LogNotice, "NotificationComponent")
+				<< "Reminder notification '" << notificationName << "': HA cluster active, this endpoint does not have the authority (paused=true). Skipping.";
+			return;
+		}
+	}
+
+	Checkable::Ptr checkable = notification->GetCheckable();
+
+	if (!IcingaApplication::GetInstance()->GetEnableNotifications() || !checkable->GetEnableNotifications())
+		return;
 
-		if (!IcingaApplication::GetInstance()->GetEnableNotifications() || !checkable->GetEnableNotifications())
-			continue;
+	bool reachable = checkable->IsReachable(DependencyNotification);
 
-		bool reachable = checkable->IsReachable(DependencyNotification);
+	if (reachable) {
+		{
+			Array::Ptr unstashedNotifications = new Array();
 
-		if (reachable) {
 			{
-				Array::Ptr unstashedNotifications = new Array();
+				auto stashedNotifications (notification->GetStashedNotifications());
+				ObjectLock olock(stashedNotifications);
 
-				{
-					auto stashedNotifications (notification->GetStashedNotifications());
-					ObjectLock olock(stashedNotifications);
+				stashedNotifications->CopyTo(unstashedNotifications);
+				stashedNotifications->Clear();
+			}
 
-					stashedNotifications->CopyTo(unstashedNotifications);
-					stashedNotifications->Clear();
-				}
+			ObjectLock olock(unstashedNotifications);
 
-				ObjectLock olock(unstashedNotifications);
-
-				for (Dictionary::Ptr unstashedNotification : unstashedNotifications) {
-					if (!unstashedNotification)
-						continue;
-
-					try {
-						Log(LogNotice, "NotificationComponent")
-							<< "Attempting to send stashed notification '" << notificationName << "'.";
-
-						notification->BeginExecuteNotification(
-							(NotificationType)(int)unstashedNotification->Get("notification_type"),
-							(CheckResult::Ptr)unstashedNotification->Get("cr"),
-							(bool)unstashedNotification->Get("force"),
-							(bool)unstashedNotification->Get("reminder"),
-							(String)unstashedNotification->Get("author"),
-							(String)unstashedNotification->Get("text")
-						);
-					} catch (const std::exception& ex) {
-						Log(LogWarning, "NotificationComponent")
-							<< "Exception occurred during notification for object '"
-							<< notificationName << "': " << DiagnosticInformation(ex, false);
-					}
+			for (Dictionary::Ptr unstashedNotification : unstashedNotifications) {
+				if (!unstashedNotification)
+					continue;
+
+				try {
+					Log(LogNotice, "NotificationComponent")
+						<< "Attempting to send stashed notification '" << notificationName << "'.";
+
+					notification->BeginExecuteNotification(
+						(NotificationType)(int)unstashedNotification->Get("notification_type"),
+						(CheckResult::Ptr)unstashedNotification->Get("cr"),
+						(bool)unstashedNotification->Get("force"),
+						(bool)unstashedNotification->Get("reminder"),
+						(String)unstashedNotification->Get("author"),
+						(String)unstashedNotification->Get("text")
+					);
+				} catch (const std::exception& ex) {
+					Log(LogWarning, "NotificationComponent")
+						<< "Exception occurred during notification for object '"
+						<< notificationName << "': " << DiagnosticInformation(ex, false);
 				}
 			}
-
-			FireSuppressedNotifications(notification);
 		}
 
-		if (notification->GetInterval() <= 0 && notification->GetNoMoreNotifications()) {
-			Log(LogNotice, "NotificationComponent")
-				<< "Reminder notification '" << notificationName << "': Notification was sent out once and interval=0 disables reminder notifications.";
-			continue;
-		}
+		FireSuppressedNotifications(notification);
+	}
 
-		if (notification->GetNextNotification() > now)
-			continue;
+	if (notification->GetInterval() <= 0 && notification->GetNoMoreNotifications()) {
+		Log(LogNotice, "NotificationComponent")
+			<< "Reminder notification '" << notificationName << "': Notification was sent out once and interval=0 disables reminder notifications.";
+		return;
+	}
 
-		{
-			ObjectLock olock(notification);
-			notification->SetNextNotification(Utility::GetTime() + notification->GetInterval());
-		}
+	if (notification->GetNextNotification() > now)
+		return;
 
-		{
-			Host::Ptr host;
-			Service::Ptr service;
-			tie(host, service) = GetHostService(checkable);
+	{
+		ObjectLock olock(notification);
+		notification->SetNextNotification(Utility::GetTime() + notification->GetInterval());
+	}
 
-			ObjectLock olock(checkable);
+	{
+		Host::Ptr host;
+		Service::Ptr service;
+		tie(host, service) = GetHostService(checkable);
 
-			if (checkable->GetStateType() == StateTypeSoft)
-				continue;
+		ObjectLock olock(checkable);
 
-			/* Don't send reminder notifications for OK/Up states. */
-			if ((service && service->GetState() == ServiceOK) || (!service && host->GetState() == HostUp))
-				continue;
+		if (checkable->GetStateType() == StateTypeSoft)
+			return;
 
-			/* Don't send reminder notifications before initial ones. */
-			if (checkable->GetSuppressedNotifications() & NotificationProblem || notification->GetSuppressedNotifications() & NotificationProblem)
-				continue;
+		/* Don't send reminder notifications for OK/Up states. */
+		if ((service && service->GetState() == ServiceOK) || (!service && host->GetState() == HostUp))
+			return;
 
-			/* Skip in runtime filters. */
-			if (!reachable || checkable->IsInDowntime() || checkable->IsAcknowledged() || checkable->IsFlapping())
-				continue;
-		}
+		/* Don't send reminder notifications before initial ones. */
+		if (checkable->GetSuppressedNotifications() & NotificationProblem || notification->GetSuppressedNotifications() & NotificationProblem)
+			return;
 
-		try {
-			Log(LogNotice, "NotificationComponent")
-				<< "Attempting to send reminder notification '" << notificationName << "'.";
+		/* Skip in runtime filters. */
+		if (!reachable || checkable->IsInDowntime() || checkable->IsAcknowledged() || checkable->IsFlapping())
+			return;
+	}
 
-			notification->BeginExecuteNotification(NotificationProblem, checkable->GetLastCheckResult(), false, true);
-		} catch (const std::exception& ex) {
-			Log(LogWarning, "NotificationComponent")
-				<< "Exception occurred during notification for object '"
-				<< notificationName << "': " << DiagnosticInformation(ex, false);
-		}
+	try {
+		Log(LogNotice, "NotificationComponent")
+			<< "Attempting to send reminder notification '" << notificationName << "'.";
+
+		notification->BeginExecuteNotification(NotificationProblem, checkable->GetLastCheckResult(), false, true);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "NotificationComponent")
+			<< "Exception occurred during notification for object '"
+			<< notificationName << "': " << DiagnosticInformation(ex, false);
 	}
 }
 
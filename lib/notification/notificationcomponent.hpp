@@ -7,10 +7,24 @@
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/key_extractors.hpp>
+#include <mutex>
+#include <set>
 
 namespace icinga
 {
 
+/**
+ * @ingroup notification
+ */
+struct NotificationScheduleInfo
+{
+	Notification::Ptr Object;
+	double NextNotification;
+};
+
 /**
  * @ingroup notification
  */
@@ -20,6 +34,14 @@ public:
 	DECLARE_OBJECT(NotificationComponent);
 	DECLARE_OBJECTNAME(NotificationComponent);
 
+	typedef boost::multi_index_container<
+		NotificationScheduleInfo,
+		boost::multi_index::indexed_by<
+			boost::multi_index::ordered_unique<boost::multi_index::member<NotificationScheduleInfo, Notification::Ptr, &NotificationScheduleInfo::Object> >,
+			boost::multi_index::ordered_non_unique<boost::multi_index::member<NotificationScheduleInfo, double, &NotificationScheduleInfo::NextNotification> >
+		>
+	> NotificationSet;
+
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
 	void Start(bool runtimeCreated) override;
@@ -28,7 +50,16 @@ public:
 private:
 	Timer::Ptr m_NotificationTimer;
 
+	std::mutex m_ScheduleMutex;
+	NotificationSet m_Reminders; /**< Which may send reminder notifications, by next_notification */
+	std::set<Notification::Ptr> m_Pending; /**< With stashed or suppressed notifications, checked on every tick */
+
+	void UpdateSchedule(const Notification::Ptr& notification);
+	void UpdateSchedule(const Checkable::Ptr& checkable);
+	void UpdateScheduleAll();
+
 	void NotificationTimerHandler();
+	void ProcessNotification(const Notification::Ptr& notification, double now, const Endpoint::Ptr& myEndpoint);
 	void SendNotificationsHandler(const Checkable::Ptr& checkable, NotificationType type,
 		const CheckResult::Ptr& cr, const String& author, const String& text);
 };
@@ -0,0 +1,108 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "perfdata/datapointbuffer.hpp"
+#include <boost/algorithm/string/join.hpp>
+#include <boost/iostreams/close.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <utility>
+
+using namespace icinga;
+
+/**
+ * Only takes effect for data points added after the next Take().
+ */
+void DataPointBuffer::SetCompression(bool gzip)
+{
+	m_Gzip = gzip;
+}
+
+bool DataPointBuffer::IsCompressed() const
+{
+	return m_Gzip;
+}
+
+/**
+ * Only takes effect for data points added after the next Take().
+ *
+ * @param prefix Written before the first data point
+ * @param separator Written between the data points
+ * @param suffix Written after the last data point
+ */
+void DataPointBuffer::SetFraming(const String& prefix, const String& separator, const String& suffix)
+{
+	m_Prefix = prefix;
+	m_Separator = separator;
+	m_Suffix = suffix;
+}
+
+void DataPointBuffer::Add(const String& dataPoint)
+{
+	if (m_Count == 0 && m_Gzip) {
+		m_Compressor.reset(new boost::iostreams::filtering_ostream());
+		m_Compressor->push(boost::iostreams::gzip_compressor());
+		m_Compressor->push(boost::iostreams::back_inserter(m_Compressed));
+
+		*m_Compressor << m_Prefix;
+	}
+
+	if (m_Compressor) {
+		if (m_Count)
+			*m_Compressor << m_Separator;
+
+		*m_Compressor << dataPoint;
+	} else {
+		m_DataPoints.emplace_back(dataPoint);
+	}
+
+	m_Count++;
+}
+
+size_t DataPointBuffer::GetCount() const
+{
+	return m_Count;
+}
+
+/**
+ * Clears the buffer.
+ *
+ * @return The request body
+ */
+String DataPointBuffer::Take(bool trailingNewline)
+{
+	String body;
+
+	if (m_Compressor) {
+		*m_Compressor << m_Suffix;
+
+		if (trailingNewline)
+			*m_Compressor << '\n';
+
+		/* Writes the gzip trailer. */
+		boost::iostreams::close(*m_Compressor);
+		m_Compressor.reset();
+
+		body = String(std::move(m_Compressed));
+		m_Compressed.clear();
+	} else {
+		body = m_Prefix + boost::algorithm::join(m_DataPoints, m_Separator.GetData()) + m_Suffix;
+		m_DataPoints.clear();
+
+		if (trailingNewline)
+			body += "\n";
+	}
+
+	m_Count = 0;
+
+	return body;
+}
+
+/**
+ * Whether the body starts with the gzip magic bytes, which uncompressed data points never do.
+ */
+bool DataPointBuffer::IsGzip(const String& body)
+{
+	auto& data (body.GetData());
+
+	return data.size() >= 2u && data[0] == '\x1f' && data[1] == '\x8b';
+}
@@ -0,0 +1,50 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef DATAPOINTBUFFER_H
+#define DATAPOINTBUFFER_H
+
+#include "base/string.hpp"
+#include <boost/iostreams/filtering_stream.hpp>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * Newline-separated data points for an HTTP request body. They're gzip-compressed
+ * while being added if compression is enabled, so that flushing only finishes the stream.
+ * Other separators and an envelope around the data points can be set with SetFraming().
+ *
+ * @ingroup perfdata
+ */
+class DataPointBuffer final
+{
+public:
+	void SetCompression(bool gzip);
+	bool IsCompressed() const;
+	void SetFraming(const String& prefix, const String& separator, const String& suffix);
+
+	void Add(const String& dataPoint);
+	size_t GetCount() const;
+
+	String Take(bool trailingNewline = false);
+
+	static bool IsGzip(const String& body);
+
+private:
+	bool m_Gzip{false};
+	String m_Prefix;
+	String m_Separator{"\n"};
+	String m_Suffix;
+	std::vector<String> m_DataPoints;
+	std::string m_Compressed;
+	std::unique_ptr<boost::iostreams::filtering_ostream> m_Compressor;
+	std::atomic_size_t m_Count{0}; /**< Also read by the stats functions */
+};
+
+}
+
+#endif /* DATAPOINTBUFFER_H */
@@ -18,6 +18,7 @@
 #include "base/perfdatavalue.hpp"
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
+#include "base/timestampformatter.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/asio/ssl/context.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
@@ -45,6 +46,7 @@ void ElasticsearchWriter::OnConfigLoaded()
 	ObjectImpl<ElasticsearchWriter>::OnConfigLoaded();
 
 	m_WorkQueue.SetName("ElasticsearchWriter, " + GetName());
+	m_DataBuffer.SetCompression(GetCompression() == "gzip");
 
 	if (!GetEnableHa()) {
 		Log(LogDebug, "ElasticsearchWriter")
@@ -63,14 +65,24 @@ void ElasticsearchWriter::StatsFunc(const Dictionary::Ptr& status, const Array::
 	for (const ElasticsearchWriter::Ptr& elasticsearchwriter : ConfigType::GetObjectsByType<ElasticsearchWriter>()) {
 		size_t workQueueItems = elasticsearchwriter->m_WorkQueue.GetLength();
 		double workQueueItemRate = elasticsearchwriter->m_WorkQueue.GetTaskCount(60) / 60.0;
+		double connections = elasticsearchwriter->m_Connections.load();
+		double reusedConnections = elasticsearchwriter->m_ReusedConnections.load();
 
-		nodes.emplace_back(elasticsearchwriter->GetName(), new Dictionary({
+		Dictionary::Ptr stats = new Dictionary({
 			{ "work_queue_items", workQueueItems },
-			{ "work_queue_item_rate", workQueueItemRate }
-		}));
+			{ "work_queue_item_rate", workQueueItemRate },
+			{ "connections", connections },
+			{ "reused_connections", reusedConnections }
+		});
 
 		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_work_queue_items", workQueueItems));
 		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_connections", connections));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_reused_connections", reusedConnections));
+
+		elasticsearchwriter->m_Stats.Report(stats, perfdata, "elasticsearchwriter_" + elasticsearchwriter->GetName());
+
+		nodes.emplace_back(elasticsearchwriter->GetName(), stats);
 	}
 
 	status->Set("elasticsearchwriter", new Dictionary(std::move(nodes)));
@@ -95,7 +107,7 @@ void ElasticsearchWriter::Resume()
 	m_FlushTimer->Reschedule(0);
 
 	/* Register for new metrics. */
-	m_HandleCheckResults = Checkable::OnNewCheckResult.connect([this](const Checkable::Ptr& checkable,
+	m_HandleCheckResults = Checkable::OnNewCheckResult.connect(GetReflectionType()->GetName().GetData(), [this](const Checkable::Ptr& checkable,
 		const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
 		CheckResultHandler(checkable, cr);
 	});
@@ -123,6 +135,7 @@ void ElasticsearchWriter::Pause()
 	{
 		std::unique_lock<std::mutex> lock (m_DataBufferMutex);
 		Flush();
+		Disconnect();
 	}
 
 	Log(LogInformation, "ElasticsearchWriter")
@@ -402,12 +415,14 @@ void ElasticsearchWriter::Enqueue(const Checkable::Ptr& checkable, const String&
 	Log(LogDebug, "ElasticsearchWriter")
 		<< "Checkable '" << checkable->GetName() << "' adds to metric list: '" << fieldsBody << "'.";
 
-	m_DataBuffer.emplace_back(indexBody + fieldsBody);
+	m_DataBuffer.Add(indexBody + fieldsBody);
+	m_Stats.AddFormatted();
+	m_Stats.MarkBuffered();
 
 	/* Flush if we've buffered too much to prevent excessive memory use. */
-	if (static_cast<int>(m_DataBuffer.size()) >= GetFlushThreshold()) {
+	if (static_cast<int>(m_DataBuffer.GetCount()) >= GetFlushThreshold()) {
 		Log(LogDebug, "ElasticsearchWriter")
-			<< "Data buffer overflow writing " << m_DataBuffer.size() << " data points";
+			<< "Data buffer overflow writing " << m_DataBuffer.GetCount() << " data points";
 		Flush();
 	}
 }
@@ -420,9 +435,9 @@ void ElasticsearchWriter::FlushTimeout()
 	std::unique_lock<std::mutex> lock(m_DataBufferMutex);
 
 	/* Flush if there are any data available. */
-	if (m_DataBuffer.size() > 0) {
+	if (m_DataBuffer.GetCount() > 0) {
 		Log(LogDebug, "ElasticsearchWriter")
-			<< "Timer expired writing " << m_DataBuffer.size() << " data points";
+			<< "Timer expired writing " << m_DataBuffer.GetCount() << " data points";
 		Flush();
 	}
 }
@@ -430,24 +445,24 @@ void ElasticsearchWriter::FlushTimeout()
 void ElasticsearchWriter::Flush()
 {
 	/* Flush can be called from 1) Timeout 2) Threshold 3) on shutdown/reload. */
-	if (m_DataBuffer.empty())
+	if (!m_DataBuffer.GetCount())
 		return;
 
 	/* Ensure you hold a lock against m_DataBuffer so that things
 	 * don't go missing after creating the body and clearing the buffer.
-	 */
-	String body = boost::algorithm::join(m_DataBuffer, "\n");
-	m_DataBuffer.clear();
-
-	/* Elasticsearch 6.x requires a new line. This is compatible to 5.x.
+	 *
+	 * Elasticsearch 6.x requires a new line. This is compatible to 5.x.
 	 * Tested with 6.0.0 and 5.6.4.
 	 */
-	body += "\n";
+	size_t dataPoints = m_DataBuffer.GetCount();
+	String body = m_DataBuffer.Take(true);
+
+	m_Stats.MarkUnbuffered();
 
-	SendRequest(body);
+	SendRequest(body, dataPoints);
 }
 
-void ElasticsearchWriter::SendRequest(const String& body)
+void ElasticsearchWriter::SendRequest(const String& body, size_t dataPoints)
 {
 	namespace beast = boost::beast;
 	namespace http = beast::http;
@@ -463,30 +478,17 @@ void ElasticsearchWriter::SendRequest(const String& body)
 	/* Specify the index path. Best practice is a daily rotation.
 	 * Example: http://localhost:9200/icinga2-2017.09.11?pretty=1
 	 */
-	path.emplace_back(GetIndex() + "-" + Utility::FormatDateTime("%Y.%m.%d", Utility::GetTime()));
+	static TimestampFormatter indexFormatter ("%Y.%m.%d");
+
+	path.emplace_back(GetIndex() + "-" + indexFormatter.Format(Utility::GetTime()));
 
 	/* Use the bulk message format. */
 	path.emplace_back("_bulk");
 
 	url->SetPath(path);
 
-	OptionalTlsStream stream;
-
-	try {
-		stream = Connect();
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Flush failed, cannot connect to Elasticsearch: " << DiagnosticInformation(ex, false);
-		return;
-	}
-
-	Defer s ([&stream]() {
-		if (stream.first) {
-			stream.first->next_layer().shutdown();
-		}
-	});
-
-	http::request<http::string_body> request (http::verb::post, std::string(url->Format(true)), 10);
+	/* HTTP/1.1 to keep the connection alive for the next bulk. */
+	http::request<http::string_body> request (http::verb::post, std::string(url->Format(true)), 11);
 
 	request.set(http::field::user_agent, "Icinga/" + Application::GetAppVersion());
 	request.set(http::field::host, url->GetHost() + ":" + url->GetPort());
@@ -500,6 +502,9 @@ void ElasticsearchWriter::SendRequest(const String& body)
 	 */
 	request.set(http::field::content_type, "application/x-ndjson");
 
+	if (m_DataBuffer.IsCompressed())
+		request.set(http::field::content_encoding, "gzip");
+
 	/* Send authentication if configured. */
 	String username = GetUsername();
 	String password = GetPassword();
@@ -515,38 +520,57 @@ void ElasticsearchWriter::SendRequest(const String& body)
 		<< "Sending " << request.method_string() << " request" << ((!username.IsEmpty() && !password.IsEmpty()) ? " with basic auth" : "" )
 		<< " to '" << url->Format() << "'.";
 
-	try {
-		if (stream.first) {
-			http::write(*stream.first, request);
-			stream.first->flush();
+	http::response<http::string_body> response;
+	double start = Utility::GetTime();
+
+	for (;;) {
+		bool reused = m_Stream.first || m_Stream.second;
+
+		if (reused) {
+			m_ReusedConnections++;
 		} else {
-			http::write(*stream.second, request);
-			stream.second->flush();
+			try {
+				m_Stream = Connect();
+			} catch (const std::exception& ex) {
+				Log(LogWarning, "ElasticsearchWriter")
+					<< "Flush failed, cannot connect to Elasticsearch: " << DiagnosticInformation(ex, false);
+				m_Stats.AddError();
+				return;
+			}
+
+			m_Connections++;
 		}
-	} catch (const std::exception&) {
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Cannot write to HTTP API on host '" << GetHost() << "' port '" << GetPort() << "'.";
-		throw;
-	}
 
-	http::parser<false, http::string_body> parser;
-	beast::flat_buffer buf;
+		try {
+			response = PerformRequest(request);
+			break;
+		} catch (const std::exception& ex) {
+			Disconnect();
+
+			/* Elasticsearch or a load balancer may have closed the idle connection meanwhile. */
+			if (reused) {
+				Log(LogNotice, "ElasticsearchWriter")
+					<< "Kept-alive connection to host '" << GetHost() << "' port '" << GetPort() << "' failed, reconnecting: "
+					<< DiagnosticInformation(ex, false);
+				m_Stats.AddRetry();
+				continue;
+			}
 
-	try {
-		if (stream.first) {
-			http::read(*stream.first, buf, parser);
-		} else {
-			http::read(*stream.second, buf, parser);
+			Log(LogWarning, "ElasticsearchWriter")
+				<< "HTTP request to host '" << GetHost() << "' port '" << GetPort() << "' failed: " << DiagnosticInformation(ex, false);
+			m_Stats.AddError();
+			throw;
 		}
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Failed to parse HTTP response from host '" << GetHost() << "' port '" << GetPort() << "': " << DiagnosticInformation(ex, false);
-		throw;
 	}
 
-	auto& response (parser.get());
+	m_Stats.AddFlush(dataPoints, body.GetLength(), Utility::GetTime() - start);
+
+	if (!response.keep_alive())
+		Disconnect();
 
 	if (response.result_int() > 299) {
+		m_Stats.AddError();
+
 		if (response.result() == http::status::unauthorized) {
 			/* More verbose error logging with Elasticsearch is hidden behind a proxy. */
 			if (!username.IsEmpty() && !password.IsEmpty()) {
@@ -653,6 +677,49 @@ OptionalTlsStream ElasticsearchWriter::Connect()
 	return stream;
 }
 
+void ElasticsearchWriter::Disconnect()
+{
+	boost::system::error_code ec;
+
+	if (m_Stream.first) {
+		m_Stream.first->next_layer().shutdown(ec);
+		m_Stream.first->lowest_layer().close(ec);
+	} else if (m_Stream.second) {
+		m_Stream.second->lowest_layer().close(ec);
+	}
+
+	m_Stream = OptionalTlsStream();
+}
+
+/**
+ * Sends the request over m_Stream and reads the response.
+ */
+boost::beast::http::response<boost::beast::http::string_body> ElasticsearchWriter::PerformRequest(
+	boost::beast::http::request<boost::beast::http::string_body>& request)
+{
+	namespace beast = boost::beast;
+	namespace http = beast::http;
+
+	if (m_Stream.first) {
+		http::write(*m_Stream.first, request);
+		m_Stream.first->flush();
+	} else {
+		http::write(*m_Stream.second, request);
+		m_Stream.second->flush();
+	}
+
+	http::parser<false, http::string_body> parser;
+	beast::flat_buffer buf;
+
+	if (m_Stream.first) {
+		http::read(*m_Stream.first, buf, parser);
+	} else {
+		http::read(*m_Stream.second, buf, parser);
+	}
+
+	return parser.release();
+}
+
 void ElasticsearchWriter::AssertOnWorkQueue()
 {
 	ASSERT(m_WorkQueue.IsWorkerThread());
@@ -666,6 +733,14 @@ void ElasticsearchWriter::ExceptionHandler(boost::exception_ptr exp)
 		<< "Exception during Elasticsearch operation: " << DiagnosticInformation(std::move(exp));
 }
 
+void ElasticsearchWriter::ValidateCompression(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ElasticsearchWriter>::ValidateCompression(lvalue, utils);
+
+	if (!lvalue().IsEmpty() && lvalue() != "gzip")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "compression" }, "Value must be empty or 'gzip'."));
+}
+
 String ElasticsearchWriter::FormatTimestamp(double ts)
 {
 	/* The date format must match the default dynamic date detection
@@ -679,7 +754,7 @@ String ElasticsearchWriter::FormatTimestamp(double ts)
 	 * https://www.elastic.co/guide/en/elasticsearch/reference/current/mapping-date-format.html
 	 * https://www.elastic.co/guide/en/elasticsearch/reference/current/date.html
 	 */
-	auto milliSeconds = static_cast<int>((ts - static_cast<int>(ts)) * 1000);
+	static TimestampFormatter formatter ("%Y-%m-%dT%H:%M:%S.%3f%z");
 
-	return Utility::FormatDateTime("%Y-%m-%dT%H:%M:%S", ts) + "." + Convert::ToString(milliSeconds) + Utility::FormatDateTime("%z", ts);
+	return formatter.Format(ts);
 }
@@ -4,11 +4,16 @@
 #define ELASTICSEARCHWRITER_H
 
 #include "perfdata/elasticsearchwriter-ti.hpp"
+#include "perfdata/datapointbuffer.hpp"
+#include "perfdata/writerstats.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/workqueue.hpp"
 #include "base/timer.hpp"
 #include "base/tlsstream.hpp"
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <atomic>
 
 namespace icinga
 {
@@ -23,6 +28,8 @@ public:
 
 	static String FormatTimestamp(double ts);
 
+	void ValidateCompression(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+
 protected:
 	void OnConfigLoaded() override;
 	void Resume() override;
@@ -31,10 +38,15 @@ protected:
 private:
 	String m_EventPrefix;
 	WorkQueue m_WorkQueue{10000000, 1};
-	boost::signals2::connection m_HandleCheckResults, m_HandleStateChanges, m_HandleNotifications;
+	SignalConnection m_HandleCheckResults, m_HandleStateChanges;
+	boost::signals2::connection m_HandleNotifications;
 	Timer::Ptr m_FlushTimer;
-	std::vector<String> m_DataBuffer;
+	DataPointBuffer m_DataBuffer;
 	std::mutex m_DataBufferMutex;
+	OptionalTlsStream m_Stream; /**< Kept alive across bulks, protected by m_DataBufferMutex */
+	std::atomic<uint_fast64_t> m_Connections{0};
+	std::atomic<uint_fast64_t> m_ReusedConnections{0};
+	WriterStats m_Stats;
 
 	void AddCheckResult(const Dictionary::Ptr& fields, const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 
@@ -53,11 +65,14 @@ private:
 		const Dictionary::Ptr& fields, double ts);
 
 	OptionalTlsStream Connect();
+	void Disconnect();
+	boost::beast::http::response<boost::beast::http::string_body> PerformRequest(
+		boost::beast::http::request<boost::beast::http::string_body>& request);
 	void AssertOnWorkQueue();
 	void ExceptionHandler(boost::exception_ptr exp);
 	void FlushTimeout();
 	void Flush();
-	void SendRequest(const String& body);
+	void SendRequest(const String& body, size_t dataPoints);
 };
 
 }
@@ -21,6 +21,12 @@
 #include "base/json.hpp"
 #include "base/statsfunction.hpp"
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/iostreams/close.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <algorithm>
+#include <array>
 #include <utility>
 #include "base/io-engine.hpp"
 #include <boost/asio/write.hpp>
@@ -34,6 +40,10 @@ REGISTER_TYPE(GelfWriter);
 
 REGISTER_STATSFUNCTION(GelfWriter, &GelfWriter::StatsFunc);
 
+/* The chunk size Graylog recommends for GELF UDP across networks (up to 128 chunks per message). */
+static const size_t l_GelfChunkSize = 1420;
+static const size_t l_GelfMaxChunks = 128;
+
 void GelfWriter::OnConfigLoaded()
 {
 	ObjectImpl<GelfWriter>::OnConfigLoaded();
@@ -58,15 +68,19 @@ void GelfWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perf
 		size_t workQueueItems = gelfwriter->m_WorkQueue.GetLength();
 		double workQueueItemRate = gelfwriter->m_WorkQueue.GetTaskCount(60) / 60.0;
 
-		nodes.emplace_back(gelfwriter->GetName(), new Dictionary({
+		Dictionary::Ptr stats = new Dictionary({
 			{ "work_queue_items", workQueueItems },
 			{ "work_queue_item_rate", workQueueItemRate },
 			{ "connected", gelfwriter->GetConnected() },
 			{ "source", gelfwriter->GetSource() }
-		}));
+		});
 
 		perfdata->Add(new PerfdataValue("gelfwriter_" + gelfwriter->GetName() + "_work_queue_items", workQueueItems));
 		perfdata->Add(new PerfdataValue("gelfwriter_" + gelfwriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+
+		gelfwriter->m_Stats.Report(stats, perfdata, "gelfwriter_" + gelfwriter->GetName());
+
+		nodes.emplace_back(gelfwriter->GetName(), stats);
 	}
 
 	status->Set("gelfwriter", new Dictionary(std::move(nodes)));
@@ -89,8 +103,16 @@ void GelfWriter::Resume()
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
 
+	/* Timer for writing the TCP batch */
+	m_FlushTimer = Timer::Create();
+	m_FlushTimer->SetInterval(GetFlushInterval());
+	m_FlushTimer->OnTimerExpired.connect([this](const Timer * const&) {
+		m_WorkQueue.Enqueue([this]() { Flush(); }, PriorityNormal);
+	});
+	m_FlushTimer->Start();
+
 	/* Register event handlers. */
-	m_HandleCheckResults = Checkable::OnNewCheckResult.connect([this](const Checkable::Ptr& checkable,
+	m_HandleCheckResults = Checkable::OnNewCheckResult.connect(GetReflectionType()->GetName().GetData(), [this](const Checkable::Ptr& checkable,
 		const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
 		CheckResultHandler(checkable, cr);
 	});
@@ -113,6 +135,7 @@ void GelfWriter::Pause()
 	m_HandleStateChanges.disconnect();
 
 	m_ReconnectTimer->Stop(true);
+	m_FlushTimer->Stop(true);
 
 	m_WorkQueue.Enqueue([this]() {
 		try {
@@ -123,7 +146,10 @@ void GelfWriter::Pause()
 		}
 	}, PriorityImmediate);
 
-	m_WorkQueue.Enqueue([this]() { DisconnectInternal(); }, PriorityLow);
+	m_WorkQueue.Enqueue([this]() {
+		Flush();
+		DisconnectInternal();
+	}, PriorityLow);
 	m_WorkQueue.Join();
 
 	Log(LogInformation, "GelfWriter")
@@ -168,6 +194,27 @@ void GelfWriter::ReconnectInternal()
 	if (GetConnected())
 		return;
 
+	if (GetTransport() == "udp") {
+		namespace ip = boost::asio::ip;
+
+		/* Connectionless, just resolve the address once. */
+		ip::udp::resolver resolver (IoEngine::Get().GetIoContext());
+		ip::udp::resolver::query query (GetHost(), GetPort());
+
+		try {
+			m_UdpEndpoint = *resolver.resolve(query);
+			m_UdpSocket = Shared<ip::udp::socket>::Make(IoEngine::Get().GetIoContext());
+			m_UdpSocket->open(m_UdpEndpoint.protocol());
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "GelfWriter")
+				<< "Can't resolve Graylog Gelf UDP input on host '" << GetHost() << "' port '" << GetPort() << ".'";
+			throw;
+		}
+
+		SetConnected(true);
+		return;
+	}
+
 	Log(LogNotice, "GelfWriter")
 		<< "Reconnecting to Graylog Gelf on host '" << GetHost() << "' port '" << GetPort() << "'.";
 
@@ -242,10 +289,19 @@ void GelfWriter::Disconnect()
 
 void GelfWriter::DisconnectInternal()
 {
+	/* Not sent anymore, like everything while disconnected. */
+	m_Buffer.clear();
+	m_BufferedMessages = 0;
+	m_Stats.MarkUnbuffered();
+
 	if (!GetConnected())
 		return;
 
-	if (m_Stream.first) {
+	if (m_UdpSocket) {
+		boost::system::error_code ec;
+		m_UdpSocket->close(ec);
+		m_UdpSocket = nullptr;
+	} else if (m_Stream.first) {
 		boost::system::error_code ec;
 		m_Stream.first->next_layer().shutdown(ec);
 
@@ -506,30 +562,165 @@ String GelfWriter::ComposeGelfMessage(const Dictionary::Ptr& fields, const Strin
 
 void GelfWriter::SendLogMessage(const Checkable::Ptr& checkable, const String& gelfMessage)
 {
-	std::ostringstream msgbuf;
-	msgbuf << gelfMessage;
-	msgbuf << '\0';
+	if (!GetConnected())
+		return;
 
-	String log = msgbuf.str();
+	Log(LogDebug, "GelfWriter")
+		<< "Checkable '" << checkable->GetName() << "' sending message '" << gelfMessage << "'.";
 
-	if (!GetConnected())
+	m_Stats.AddFormatted();
+
+	if (m_UdpSocket) {
+		SendUdpMessage(gelfMessage);
 		return;
+	}
 
-	try {
-		Log(LogDebug, "GelfWriter")
-			<< "Checkable '" << checkable->GetName() << "' sending message '" << log << "'.";
+	/* Null-terminated messages for the GELF TCP input. */
+	m_Buffer.append(gelfMessage.GetData());
+	m_Buffer.push_back('\0');
+	m_BufferedMessages++;
+	m_Stats.MarkBuffered();
+
+	if (m_BufferedMessages >= GetFlushThreshold())
+		Flush();
+}
+
+/**
+ * Writes the batched messages to the TCP stream at once.
+ *
+ * Called inside the WQ.
+ */
+void GelfWriter::Flush()
+{
+	AssertOnWorkQueue();
+
+	if (m_Buffer.empty())
+		return;
+
+	std::string buffer;
+	size_t messages = m_BufferedMessages;
+	buffer.swap(m_Buffer);
+	m_BufferedMessages = 0;
+	m_Stats.MarkUnbuffered();
+
+	if (!GetConnected() || m_UdpSocket)
+		return;
+
+	double start = Utility::GetTime();
 
+	try {
 		if (m_Stream.first) {
-			boost::asio::write(*m_Stream.first, boost::asio::buffer(msgbuf.str()));
+			boost::asio::write(*m_Stream.first, boost::asio::buffer(buffer));
 			m_Stream.first->flush();
 		} else {
-			boost::asio::write(*m_Stream.second, boost::asio::buffer(msgbuf.str()));
+			boost::asio::write(*m_Stream.second, boost::asio::buffer(buffer));
 			m_Stream.second->flush();
 		}
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "GelfWriter")
 			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
 
-		throw ex;
+		m_Stats.AddError();
+		throw;
 	}
+
+	m_Stats.AddFlush(messages, buffer.size(), Utility::GetTime() - start);
+}
+
+/**
+ * Sends a message as one GELF UDP datagram, or as chunks if it's too large.
+ *
+ * Fire and forget, errors are only logged.
+ */
+void GelfWriter::SendUdpMessage(const String& gelfMessage)
+{
+	std::string payload;
+
+	if (GetCompression() == "gzip") {
+		boost::iostreams::filtering_ostream compressor;
+		compressor.push(boost::iostreams::gzip_compressor());
+		compressor.push(boost::iostreams::back_inserter(payload));
+		compressor << gelfMessage;
+		boost::iostreams::close(compressor);
+	} else {
+		payload = gelfMessage.GetData();
+	}
+
+	boost::system::error_code ec;
+	double start = Utility::GetTime();
+
+	if (payload.size() <= l_GelfChunkSize) {
+		m_UdpSocket->send_to(boost::asio::buffer(payload), m_UdpEndpoint, 0, ec);
+	} else {
+		size_t chunks = (payload.size() + l_GelfChunkSize - 1) / l_GelfChunkSize;
+
+		if (chunks > l_GelfMaxChunks) {
+			Log(LogWarning, "GelfWriter")
+				<< "Dropping GELF message of " << payload.size() << " bytes, it exceeds " << l_GelfMaxChunks << " UDP chunks.";
+			m_Stats.AddError();
+			return;
+		}
+
+		/* Chunk header: magic bytes, message ID, sequence number and count. */
+		char header[12] = { '\x1e', '\x0f' };
+		uint_fast64_t id = ++m_UdpMessageId;
+
+		for (int i = 0; i < 8; i++)
+			header[2 + i] = static_cast<char>(id >> (8 * i));
+
+		header[11] = static_cast<char>(chunks);
+
+		for (size_t i = 0; i < chunks && !ec; i++) {
+			header[10] = static_cast<char>(i);
+
+			std::array<boost::asio::const_buffer, 2> datagram {{
+				boost::asio::buffer(header),
+				boost::asio::buffer(payload.data() + i * l_GelfChunkSize, std::min(l_GelfChunkSize, payload.size() - i * l_GelfChunkSize))
+			}};
+
+			m_UdpSocket->send_to(datagram, m_UdpEndpoint, 0, ec);
+		}
+	}
+
+	if (ec) {
+		Log(LogDebug, "GelfWriter")
+			<< "Cannot send UDP datagram to host '" << GetHost() << "' port '" << GetPort() << "': " << ec.message();
+
+		m_Stats.AddError();
+		return;
+	}
+
+	/* Every datagram is a flush of its own. */
+	m_Stats.AddFlush(1, payload.size(), Utility::GetTime() - start);
+}
+
+void GelfWriter::Validate(int types, const ValidationUtils& utils)
+{
+	ObjectImpl<GelfWriter>::Validate(types, utils);
+
+	if (!(types & FAConfig))
+		return;
+
+	if (GetTransport() == "udp" && GetEnableTls())
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "enable_tls" }, "TLS is only supported with transport 'tcp'."));
+
+	/* The GELF TCP input doesn't support compression. */
+	if (GetTransport() == "tcp" && !GetCompression().IsEmpty())
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "compression" }, "Compression is only supported with transport 'udp'."));
+}
+
+void GelfWriter::ValidateTransport(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<GelfWriter>::ValidateTransport(lvalue, utils);
+
+	if (lvalue() != "tcp" && lvalue() != "udp")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "transport" }, "Value must be 'tcp' or 'udp'."));
+}
+
+void GelfWriter::ValidateCompression(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<GelfWriter>::ValidateCompression(lvalue, utils);
+
+	if (!lvalue().IsEmpty() && lvalue() != "gzip")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "compression" }, "Value must be empty or 'gzip'."));
 }
@@ -4,12 +4,16 @@
 #define GELFWRITER_H
 
 #include "perfdata/gelfwriter-ti.hpp"
+#include "perfdata/writerstats.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
+#include <boost/asio/ip/udp.hpp>
+#include <cstdint>
 #include <fstream>
+#include <string>
 
 namespace icinga
 {
@@ -27,6 +31,10 @@ public:
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
+	void Validate(int types, const ValidationUtils& utils) override;
+	void ValidateTransport(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+	void ValidateCompression(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+
 protected:
 	void OnConfigLoaded() override;
 	void Resume() override;
@@ -34,10 +42,20 @@ protected:
 
 private:
 	OptionalTlsStream m_Stream;
+	Shared<boost::asio::ip::udp::socket>::Ptr m_UdpSocket;
+	boost::asio::ip::udp::endpoint m_UdpEndpoint;
+	uint_fast64_t m_UdpMessageId{0};
 	WorkQueue m_WorkQueue{10000000, 1};
 
-	boost::signals2::connection m_HandleCheckResults, m_HandleNotifications, m_HandleStateChanges;
+	/* TCP only, messages not written yet (null-terminated), only accessed on m_WorkQueue */
+	std::string m_Buffer;
+	int m_BufferedMessages{0};
+	WriterStats m_Stats;
+
+	SignalConnection m_HandleCheckResults, m_HandleStateChanges;
+	boost::signals2::connection m_HandleNotifications;
 	Timer::Ptr m_ReconnectTimer;
+	Timer::Ptr m_FlushTimer;
 
 	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 	void CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
@@ -52,6 +70,8 @@ private:
 
 	String ComposeGelfMessage(const Dictionary::Ptr& fields, const String& source, double ts);
 	void SendLogMessage(const Checkable::Ptr& checkable, const String& gelfMessage);
+	void SendUdpMessage(const String& gelfMessage);
+	void Flush();
 
 	void ReconnectTimerHandler();
 
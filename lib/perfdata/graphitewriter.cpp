@@ -14,12 +14,14 @@
 #include "base/utility.hpp"
 #include "base/perfdatavalue.hpp"
 #include "base/application.hpp"
+#include "base/configuration.hpp"
 #include "base/stream.hpp"
 #include "base/networkstream.hpp"
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <stdexcept>
 #include <utility>
 
 using namespace icinga;
@@ -37,6 +39,10 @@ void GraphiteWriter::OnConfigLoaded()
 
 	m_WorkQueue.SetName("GraphiteWriter, " + GetName());
 
+	if (GetEnableSpool()) {
+		m_Spool.reset(new PerfdataSpool(GetSpoolMaxSize() * 1024.0 * 1024.0, GetSpoolReplayRate() * 1024.0));
+	}
+
 	if (!GetEnableHa()) {
 		Log(LogDebug, "GraphiteWriter")
 			<< "HA functionality disabled. Won't pause connection: " << GetName();
@@ -61,14 +67,29 @@ void GraphiteWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&
 		size_t workQueueItems = graphitewriter->m_WorkQueue.GetLength();
 		double workQueueItemRate = graphitewriter->m_WorkQueue.GetTaskCount(60) / 60.0;
 
-		nodes.emplace_back(graphitewriter->GetName(), new Dictionary({
+		double spoolRecords = 0;
+		double spoolBytes = 0;
+
+		if (graphitewriter->m_Spool) {
+			spoolRecords = graphitewriter->m_Spool->GetRecords();
+			spoolBytes = graphitewriter->m_Spool->GetBytes();
+		}
+
+		Dictionary::Ptr stats = new Dictionary({
 			{ "work_queue_items", workQueueItems },
 			{ "work_queue_item_rate", workQueueItemRate },
-			{ "connected", graphitewriter->GetConnected() }
-		}));
+			{ "connected", graphitewriter->GetConnected() },
+			{ "spool_records", spoolRecords },
+			{ "spool_bytes", spoolBytes }
+		});
 
 		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_work_queue_items", workQueueItems));
 		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_spool_bytes", spoolBytes));
+
+		graphitewriter->m_Stats.Report(stats, perfdata, "graphitewriter_" + graphitewriter->GetName());
+
+		nodes.emplace_back(graphitewriter->GetName(), stats);
 	}
 
 	status->Set("graphitewriter", new Dictionary(std::move(nodes)));
@@ -87,6 +108,24 @@ void GraphiteWriter::Resume()
 	/* Register exception handler for WQ tasks. */
 	m_WorkQueue.SetExceptionCallback([this](boost::exception_ptr exp) { ExceptionHandler(std::move(exp)); });
 
+	m_HostPrefixCacheable = TemplateCache::IsCacheable(GetHostNameTemplate());
+	m_ServicePrefixCacheable = TemplateCache::IsCacheable(GetServiceNameTemplate());
+
+	if (m_Spool) {
+		String dir = Configuration::DataDir + "/perfdata-spool/graphitewriter-" + GetName();
+		std::unique_lock<std::mutex> lock(m_StreamMutex);
+
+		try {
+			m_Spool->Open(dir);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "GraphiteWriter")
+				<< "Can't open spool '" << dir << "', metrics will be lost while Graphite is unreachable: "
+				<< DiagnosticInformation(ex, false);
+
+			m_Spool.reset();
+		}
+	}
+
 	/* Timer for reconnecting */
 	m_ReconnectTimer = Timer::Create();
 	m_ReconnectTimer->SetInterval(10);
@@ -95,9 +134,8 @@ void GraphiteWriter::Resume()
 	m_ReconnectTimer->Reschedule(0);
 
 	/* Register event handlers. */
-	m_HandleCheckResults = Checkable::OnNewCheckResult.connect([this](const Checkable::Ptr& checkable,
-		const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
-		CheckResultHandler(checkable, cr);
+	m_HandleCheckResults = Checkable::OnNewCheckResults.connect(GetReflectionType()->GetName().GetData(), [this](const std::vector<Checkable::NewCheckResult>& batch) {
+		CheckResultsHandler(batch);
 	});
 }
 
@@ -112,14 +150,33 @@ void GraphiteWriter::Pause()
 	try {
 		ReconnectInternal();
 	} catch (const std::exception&) {
-		Log(LogInformation, "GraphiteWriter")
-			<< "'" << GetName() << "' paused. Unable to connect, not flushing buffers. Data may be lost on reload.";
+		/* The pending metrics go to the spool instead. */
+		if (!m_Spool) {
+			Log(LogInformation, "GraphiteWriter")
+				<< "'" << GetName() << "' paused. Unable to connect, not flushing buffers. Data may be lost on reload.";
 
-		ObjectImpl<GraphiteWriter>::Pause();
-		return;
+			ObjectImpl<GraphiteWriter>::Pause();
+			return;
+		}
 	}
 
 	m_WorkQueue.Join();
+
+	MetricStream::Ptr stream;
+
+	{
+		std::unique_lock<std::mutex> lock(m_StreamMutex);
+
+		if (GetConnected())
+			stream = m_Stream;
+	}
+
+	/* Without the lock, a failing stream needs it to spool the rest. */
+	if (stream && !stream->Flush(10)) {
+		Log(LogWarning, "GraphiteWriter")
+			<< "'" << GetName() << "' couldn't send all pending metrics to Graphite within 10 seconds.";
+	}
+
 	DisconnectInternal();
 
 	Log(LogInformation, "GraphiteWriter")
@@ -150,11 +207,7 @@ void GraphiteWriter::ExceptionHandler(boost::exception_ptr exp)
 	Log(LogDebug, "GraphiteWriter")
 		<< "Exception during Graphite operation: " << DiagnosticInformation(std::move(exp));
 
-	if (GetConnected()) {
-		m_Stream->close();
-
-		SetConnected(false);
-	}
+	DisconnectInternal();
 }
 
 /**
@@ -191,10 +244,18 @@ void GraphiteWriter::ReconnectInternal()
 	Log(LogNotice, "GraphiteWriter")
 		<< "Reconnecting to Graphite on host '" << GetHost() << "' port '" << GetPort() << "'.";
 
-	m_Stream = Shared<AsioTcpStream>::Make(IoEngine::Get().GetIoContext());
+	MetricStream::Ptr stream = new MetricStream([this](std::string metrics) {
+		Log(LogCritical, "GraphiteWriter")
+			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+
+		std::unique_lock<std::mutex> lock(m_StreamMutex);
+
+		SetConnected(false);
+		SpoolMetrics(metrics);
+	}, &m_Stats);
 
 	try {
-		icinga::Connect(m_Stream->lowest_layer(), GetHost(), GetPort());
+		stream->Connect(GetHost(), GetPort());
 	} catch (const std::exception& ex) {
 		Log(LogWarning, "GraphiteWriter")
 			<< "Can't connect to Graphite on host '" << GetHost() << "' port '" << GetPort() << ".'";
@@ -204,7 +265,12 @@ void GraphiteWriter::ReconnectInternal()
 		throw;
 	}
 
-	SetConnected(true);
+	{
+		std::unique_lock<std::mutex> lock(m_StreamMutex);
+
+		m_Stream = std::move(stream);
+		SetConnected(true);
+	}
 
 	Log(LogInformation, "GraphiteWriter")
 		<< "Finished reconnecting to Graphite in " << std::setw(2) << Utility::GetTime() - startTime << " second(s).";
@@ -242,40 +308,50 @@ void GraphiteWriter::Disconnect()
  */
 void GraphiteWriter::DisconnectInternal()
 {
+	std::unique_lock<std::mutex> lock(m_StreamMutex);
+
 	if (!GetConnected())
 		return;
 
-	m_Stream->close();
+	m_Stream->Disconnect();
 
 	SetConnected(false);
 }
 
 /**
- * Check result event handler, checks whether feature is not paused in HA setups.
+ * Check results event handler, sends the metrics of a whole batch at once
  *
- * @param checkable Host/Service object
- * @param cr Check result including performance data
+ * @param batch New check results of (possibly) many checkables
  */
-void GraphiteWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void GraphiteWriter::CheckResultsHandler(const std::vector<Checkable::NewCheckResult>& batch)
 {
 	if (IsPaused())
 		return;
 
-	m_WorkQueue.Enqueue([this, checkable, cr]() { CheckResultHandlerInternal(checkable, cr); });
+	m_WorkQueue.Enqueue([this, batch]() {
+		AssertOnWorkQueue();
+
+		std::ostringstream metrics;
+
+		for (auto& ncr : batch) {
+			CheckResultHandlerInternal(ncr.Target, ncr.Result, metrics);
+		}
+
+		SendMetrics(metrics.str());
+	});
 }
 
 /**
- * Check result event handler, prepares metadata and perfdata values and calls Send*()
+ * Check result event handler, prepares metadata and perfdata values and calls Add*()
  *
  * Called inside the WQ.
  *
  * @param checkable Host/Service object
  * @param cr Check result including performance data
+ * @param metrics Buffer to add the metrics to
  */
-void GraphiteWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void GraphiteWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, std::ostringstream& metrics)
 {
-	AssertOnWorkQueue();
-
 	CONTEXT("Processing check result for '" << checkable->GetName() << "'");
 
 	/* TODO: Deal with missing connection here. Needs refactoring
@@ -289,22 +365,24 @@ void GraphiteWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable,
 	Service::Ptr service;
 	tie(host, service) = GetHostService(checkable);
 
-	MacroProcessor::ResolverList resolvers;
-	if (service)
-		resolvers.emplace_back("service", service);
-	resolvers.emplace_back("host", host);
+	auto resolvePrefix ([this, &host, &service, &cr]() -> Value {
+		MacroProcessor::ResolverList resolvers;
+		if (service)
+			resolvers.emplace_back("service", service);
+		resolvers.emplace_back("host", host);
+
+		return MacroProcessor::ResolveMacros(service ? GetServiceNameTemplate() : GetHostNameTemplate(), resolvers, cr, nullptr,
+			[](const Value& value) -> Value {
+				return EscapeMacroMetric(value);
+			});
+	});
 
 	String prefix;
 
-	if (service) {
-		prefix = MacroProcessor::ResolveMacros(GetServiceNameTemplate(), resolvers, cr, nullptr, [](const Value& value) -> Value {
-			return EscapeMacroMetric(value);
-		});
-	} else {
-		prefix = MacroProcessor::ResolveMacros(GetHostNameTemplate(), resolvers, cr, nullptr, [](const Value& value) -> Value {
-			return EscapeMacroMetric(value);
-		});
-	}
+	if (service ? m_ServicePrefixCacheable : m_HostPrefixCacheable)
+		prefix = m_PrefixCache.Get(checkable, resolvePrefix);
+	else
+		prefix = resolvePrefix();
 
 	String prefixPerfdata = prefix + ".perfdata";
 	String prefixMetadata = prefix + ".metadata";
@@ -313,33 +391,34 @@ void GraphiteWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable,
 
 	if (GetEnableSendMetadata()) {
 		if (service) {
-			SendMetric(checkable, prefixMetadata, "state", service->GetState(), ts);
+			AddMetric(metrics, checkable, prefixMetadata, "state", service->GetState(), ts);
 		} else {
-			SendMetric(checkable, prefixMetadata, "state", host->GetState(), ts);
+			AddMetric(metrics, checkable, prefixMetadata, "state", host->GetState(), ts);
 		}
 
-		SendMetric(checkable, prefixMetadata, "current_attempt", checkable->GetCheckAttempt(), ts);
-		SendMetric(checkable, prefixMetadata, "max_check_attempts", checkable->GetMaxCheckAttempts(), ts);
-		SendMetric(checkable, prefixMetadata, "state_type", checkable->GetStateType(), ts);
-		SendMetric(checkable, prefixMetadata, "reachable", checkable->IsReachable(), ts);
-		SendMetric(checkable, prefixMetadata, "downtime_depth", checkable->GetDowntimeDepth(), ts);
-		SendMetric(checkable, prefixMetadata, "acknowledgement", checkable->GetAcknowledgement(), ts);
-		SendMetric(checkable, prefixMetadata, "latency", cr->CalculateLatency(), ts);
-		SendMetric(checkable, prefixMetadata, "execution_time", cr->CalculateExecutionTime(), ts);
+		AddMetric(metrics, checkable, prefixMetadata, "current_attempt", checkable->GetCheckAttempt(), ts);
+		AddMetric(metrics, checkable, prefixMetadata, "max_check_attempts", checkable->GetMaxCheckAttempts(), ts);
+		AddMetric(metrics, checkable, prefixMetadata, "state_type", checkable->GetStateType(), ts);
+		AddMetric(metrics, checkable, prefixMetadata, "reachable", checkable->IsReachable(), ts);
+		AddMetric(metrics, checkable, prefixMetadata, "downtime_depth", checkable->GetDowntimeDepth(), ts);
+		AddMetric(metrics, checkable, prefixMetadata, "acknowledgement", checkable->GetAcknowledgement(), ts);
+		AddMetric(metrics, checkable, prefixMetadata, "latency", cr->CalculateLatency(), ts);
+		AddMetric(metrics, checkable, prefixMetadata, "execution_time", cr->CalculateExecutionTime(), ts);
 	}
 
-	SendPerfdata(checkable, prefixPerfdata, cr, ts);
+	AddPerfdata(metrics, checkable, prefixPerfdata, cr, ts);
 }
 
 /**
- * Parse performance data from check result and call SendMetric()
+ * Parse performance data from check result and call AddMetric()
  *
+ * @param metrics Buffer to add the metrics to
  * @param checkable Host/service object
  * @param prefix Metric prefix string
  * @param cr Check result including performance data
  * @param ts Timestamp when the check result was created
  */
-void GraphiteWriter::SendPerfdata(const Checkable::Ptr& checkable, const String& prefix, const CheckResult::Ptr& cr, double ts)
+void GraphiteWriter::AddPerfdata(std::ostringstream& metrics, const Checkable::Ptr& checkable, const String& prefix, const CheckResult::Ptr& cr, double ts)
 {
 	Array::Ptr perfdata = cr->GetPerformanceData();
 
@@ -350,52 +429,47 @@ void GraphiteWriter::SendPerfdata(const Checkable::Ptr& checkable, const String&
 
 	ObjectLock olock(perfdata);
 	for (const Value& val : perfdata) {
-		PerfdataValue::Ptr pdv;
-
-		if (val.IsObjectType<PerfdataValue>())
-			pdv = val;
-		else {
-			try {
-				pdv = PerfdataValue::Parse(val);
-			} catch (const std::exception&) {
-				Log(LogWarning, "GraphiteWriter")
-					<< "Ignoring invalid perfdata for checkable '"
-					<< checkable->GetName() << "' and command '"
-					<< checkCommand->GetName() << "' with value: " << val;
-				continue;
-			}
+		PerfdataValue::Fields pdv;
+
+		try {
+			PerfdataValue::ParseFields(val, pdv);
+		} catch (const std::exception&) {
+			Log(LogWarning, "GraphiteWriter")
+				<< "Ignoring invalid perfdata for checkable '"
+				<< checkable->GetName() << "' and command '"
+				<< checkCommand->GetName() << "' with value: " << val;
+			continue;
 		}
 
-		String escapedKey = EscapeMetricLabel(pdv->GetLabel());
+		String escapedKey = EscapeMetricLabel(pdv.Label);
 
-		SendMetric(checkable, prefix, escapedKey + ".value", pdv->GetValue(), ts);
+		AddMetric(metrics, checkable, prefix, escapedKey + ".value", pdv.Value, ts);
 
 		if (GetEnableSendThresholds()) {
-			if (!pdv->GetCrit().IsEmpty())
-				SendMetric(checkable, prefix, escapedKey + ".crit", pdv->GetCrit(), ts);
-			if (!pdv->GetWarn().IsEmpty())
-				SendMetric(checkable, prefix, escapedKey + ".warn", pdv->GetWarn(), ts);
-			if (!pdv->GetMin().IsEmpty())
-				SendMetric(checkable, prefix, escapedKey + ".min", pdv->GetMin(), ts);
-			if (!pdv->GetMax().IsEmpty())
-				SendMetric(checkable, prefix, escapedKey + ".max", pdv->GetMax(), ts);
+			if (!pdv.Crit.IsEmpty())
+				AddMetric(metrics, checkable, prefix, escapedKey + ".crit", pdv.Crit, ts);
+			if (!pdv.Warn.IsEmpty())
+				AddMetric(metrics, checkable, prefix, escapedKey + ".warn", pdv.Warn, ts);
+			if (!pdv.Min.IsEmpty())
+				AddMetric(metrics, checkable, prefix, escapedKey + ".min", pdv.Min, ts);
+			if (!pdv.Max.IsEmpty())
+				AddMetric(metrics, checkable, prefix, escapedKey + ".max", pdv.Max, ts);
 		}
 	}
 }
 
 /**
- * Computes metric data and sends to Graphite
+ * Computes metric data and adds it to the buffer
  *
+ * @param metrics Buffer to add the metric to
  * @param checkable Host/service object
  * @param prefix Computed metric prefix string
  * @param name Metric name
  * @param value Metric value
  * @param ts Timestamp when the check result was created
  */
-void GraphiteWriter::SendMetric(const Checkable::Ptr& checkable, const String& prefix, const String& name, double value, double ts)
+void GraphiteWriter::AddMetric(std::ostringstream& metrics, const Checkable::Ptr& checkable, const String& prefix, const String& name, double value, double ts)
 {
-	namespace asio = boost::asio;
-
 	std::ostringstream msgbuf;
 	msgbuf << prefix << "." << name << " " << Convert::ToString(value) << " " << static_cast<long>(ts);
 
@@ -403,21 +477,69 @@ void GraphiteWriter::SendMetric(const Checkable::Ptr& checkable, const String& p
 		<< "Checkable '" << checkable->GetName() << "' adds to metric list: '" << msgbuf.str() << "'.";
 
 	// do not send \n to debug log
-	msgbuf << "\n";
+	metrics << msgbuf.str() << "\n";
+
+	m_Stats.AddFormatted();
+}
+
+/**
+ * Sends metrics to Graphite with a single write
+ *
+ * @param metrics Newline-terminated metric lines
+ */
+void GraphiteWriter::SendMetrics(const std::string& metrics)
+{
+	if (metrics.empty())
+		return;
 
 	std::unique_lock<std::mutex> lock(m_StreamMutex);
 
-	if (!GetConnected())
+	/* Only buffered, the stream writes it on the I/O engine. */
+	if (!GetConnected() || !m_Stream->Write(metrics)) {
+		SpoolMetrics(metrics);
+		return;
+	}
+
+	ReplaySpool();
+}
+
+/**
+ * Writes metrics to the spool, if enabled, to send them once Graphite is reachable again
+ *
+ * m_StreamMutex must be locked.
+ *
+ * @param metrics Newline-terminated metric lines
+ */
+void GraphiteWriter::SpoolMetrics(const std::string& metrics)
+{
+	if (!m_Spool)
 		return;
 
 	try {
-		asio::write(*m_Stream, asio::buffer(msgbuf.str()));
-		m_Stream->flush();
+		m_Spool->Append(metrics);
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "GraphiteWriter")
-			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+			<< "Can't spool metrics, they're lost: " << DiagnosticInformation(ex, false);
+	}
+}
+
+/**
+ * Sends spooled metrics as far as the replay rate allows
+ *
+ * m_StreamMutex must be locked.
+ */
+void GraphiteWriter::ReplaySpool()
+{
+	if (!m_Spool || !m_Spool->GetRecords())
+		return;
 
-		throw ex;
+	try {
+		m_Spool->Replay([this](const String& metrics) {
+			if (!m_Stream->Write(metrics.GetData()))
+				BOOST_THROW_EXCEPTION(std::runtime_error("Write buffer is full"));
+		});
+	} catch (const std::exception&) {
+		/* The rest is replayed with the next metrics. */
 	}
 }
 
@@ -4,13 +4,19 @@
 #define GRAPHITEWRITER_H
 
 #include "perfdata/graphitewriter-ti.hpp"
+#include "perfdata/metricstream.hpp"
+#include "perfdata/perfdataspool.hpp"
+#include "perfdata/templatecache.hpp"
+#include "perfdata/writerstats.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
-#include "base/tcpsocket.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
 #include <fstream>
+#include <memory>
 #include <mutex>
+#include <sstream>
+#include <vector>
 
 namespace icinga
 {
@@ -37,17 +43,25 @@ protected:
 	void Pause() override;
 
 private:
-	Shared<AsioTcpStream>::Ptr m_Stream;
+	MetricStream::Ptr m_Stream; /**< Protected by m_StreamMutex */
 	std::mutex m_StreamMutex;
 	WorkQueue m_WorkQueue{10000000, 1};
+	std::unique_ptr<PerfdataSpool> m_Spool; /**< If enable_spool, protected by m_StreamMutex */
+	TemplateCache m_PrefixCache;
+	WriterStats m_Stats;
+	bool m_HostPrefixCacheable{false};
+	bool m_ServicePrefixCacheable{false};
 
-	boost::signals2::connection m_HandleCheckResults;
+	SignalConnection m_HandleCheckResults;
 	Timer::Ptr m_ReconnectTimer;
 
-	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
-	void CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
-	void SendMetric(const Checkable::Ptr& checkable, const String& prefix, const String& name, double value, double ts);
-	void SendPerfdata(const Checkable::Ptr& checkable, const String& prefix, const CheckResult::Ptr& cr, double ts);
+	void CheckResultsHandler(const std::vector<Checkable::NewCheckResult>& batch);
+	void CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, std::ostringstream& metrics);
+	void AddMetric(std::ostringstream& metrics, const Checkable::Ptr& checkable, const String& prefix, const String& name, double value, double ts);
+	void AddPerfdata(std::ostringstream& metrics, const Checkable::Ptr& checkable, const String& prefix, const CheckResult::Ptr& cr, double ts);
+	void SendMetrics(const std::string& metrics);
+	void SpoolMetrics(const std::string& metrics);
+	void ReplaySpool();
 	static String EscapeMetric(const String& str);
 	static String EscapeMetricLabel(const String& str);
 	static Value EscapeMacroMetric(const Value& value);
@@ -8,6 +8,7 @@
 #include "icinga/icingaapplication.hpp"
 #include "icinga/checkcommand.hpp"
 #include "base/application.hpp"
+#include "base/configuration.hpp"
 #include "base/defer.hpp"
 #include "base/io-engine.hpp"
 #include "base/tcpsocket.hpp"
@@ -38,6 +39,7 @@
 #include <boost/regex.hpp>
 #include <boost/scoped_array.hpp>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <utility>
 
@@ -67,7 +69,23 @@ void InfluxdbCommonWriter::OnConfigLoaded()
 {
 	ObjectImpl<InfluxdbCommonWriter>::OnConfigLoaded();
 
-	m_WorkQueue.SetName(GetReflectionType()->GetName() + ", " + GetName());
+	int workerThreads = GetWorkerThreads();
+
+	for (int i = 0; i < workerThreads; i++) {
+		m_Workers.emplace_back(new Worker());
+
+		String name = GetReflectionType()->GetName() + ", " + GetName();
+
+		if (workerThreads > 1)
+			name += ", worker " + Convert::ToString(i + 1);
+
+		m_Workers.back()->Queue.SetName(name);
+		m_Workers.back()->DataBuffer.SetCompression(GetCompression() == "gzip");
+
+		if (GetEnableSpool()) {
+			m_Workers.back()->Spool.reset(new PerfdataSpool(GetSpoolMaxSize() * 1024.0 * 1024.0, GetSpoolReplayRate() * 1024.0));
+		}
+	}
 
 	if (!GetEnableHa()) {
 		Log(LogDebug, GetReflectionType()->GetName())
@@ -86,10 +104,37 @@ void InfluxdbCommonWriter::Resume()
 	Log(LogInformation, GetReflectionType()->GetName())
 		<< "'" << GetName() << "' resumed.";
 
+	m_HostTemplateCacheable = TemplateCache::IsCacheable(GetHostTemplate());
+	m_ServiceTemplateCacheable = TemplateCache::IsCacheable(GetServiceTemplate());
+
 	/* Register exception handler for WQ tasks. */
-	m_WorkQueue.SetExceptionCallback([this](boost::exception_ptr exp) { ExceptionHandler(std::move(exp)); });
+	for (auto& worker : m_Workers) {
+		worker->Queue.SetExceptionCallback([this, &worker](boost::exception_ptr exp) { ExceptionHandler(*worker, std::move(exp)); });
+	}
+
+	for (size_t i = 0; i < m_Workers.size(); i++) {
+		auto& spool (m_Workers[i]->Spool);
+
+		if (!spool)
+			continue;
+
+		String dir = Configuration::DataDir + "/perfdata-spool/" + GetReflectionType()->GetName().ToLower() + "-" + GetName();
+
+		if (m_Workers.size() > 1)
+			dir += "-" + Convert::ToString(i + 1);
+
+		try {
+			spool->Open(dir);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, GetReflectionType()->GetName())
+				<< "Can't open spool '" << dir << "', data points will be lost while InfluxDB is unreachable: "
+				<< DiagnosticInformation(ex, false);
+
+			spool.reset();
+		}
+	}
 
-	/* Setup timer for periodically flushing m_DataBuffer */
+	/* Setup timer for periodically flushing the data buffers */
 	m_FlushTimer = Timer::Create();
 	m_FlushTimer->SetInterval(GetFlushInterval());
 	m_FlushTimer->OnTimerExpired.connect([this](const Timer * const&) { FlushTimeout(); });
@@ -97,7 +142,7 @@ void InfluxdbCommonWriter::Resume()
 	m_FlushTimer->Reschedule(0);
 
 	/* Register for new metrics. */
-	m_HandleCheckResults = Checkable::OnNewCheckResult.connect([this](const Checkable::Ptr& checkable,
+	m_HandleCheckResults = Checkable::OnNewCheckResult.connect(GetReflectionType()->GetName().GetData(), [this](const Checkable::Ptr& checkable,
 		const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
 		CheckResultHandler(checkable, cr);
 	});
@@ -113,10 +158,18 @@ void InfluxdbCommonWriter::Pause()
 		<< "Processing pending tasks and flushing data buffers.";
 
 	m_FlushTimer->Stop(true);
-	m_WorkQueue.Enqueue([this]() { FlushWQ(); }, PriorityLow);
 
-	/* Wait for the flush to complete, implicitly waits for all WQ tasks enqueued prior to pausing. */
-	m_WorkQueue.Join();
+	for (auto& worker : m_Workers) {
+		worker->Queue.Enqueue([this, &worker]() {
+			FlushWQ(*worker);
+			Disconnect(*worker);
+		}, PriorityLow);
+	}
+
+	/* Wait for the flushes to complete, implicitly waits for all WQ tasks enqueued prior to pausing. */
+	for (auto& worker : m_Workers) {
+		worker->Queue.Join();
+	}
 
 	Log(LogInformation, GetReflectionType()->GetName())
 		<< "'" << GetName() << "' paused.";
@@ -124,19 +177,30 @@ void InfluxdbCommonWriter::Pause()
 	ObjectImpl<InfluxdbCommonWriter>::Pause();
 }
 
-void InfluxdbCommonWriter::AssertOnWorkQueue()
+void InfluxdbCommonWriter::AssertOnWorkQueue(Worker& worker)
 {
-	ASSERT(m_WorkQueue.IsWorkerThread());
+	ASSERT(worker.Queue.IsWorkerThread());
 }
 
-void InfluxdbCommonWriter::ExceptionHandler(boost::exception_ptr exp)
+/**
+ * The worker of the checkable's data points, so that each series is written in order.
+ */
+InfluxdbCommonWriter::Worker& InfluxdbCommonWriter::GetWorker(const Checkable::Ptr& checkable)
+{
+	if (m_Workers.size() == 1)
+		return *m_Workers[0];
+
+	return *m_Workers[std::hash<String>()(checkable->GetName()) % m_Workers.size()];
+}
+
+void InfluxdbCommonWriter::ExceptionHandler(Worker& worker, boost::exception_ptr exp)
 {
 	Log(LogCritical, GetReflectionType()->GetName(), "Exception during InfluxDB operation: Verify that your backend is operational!");
 
 	Log(LogDebug, GetReflectionType()->GetName())
 		<< "Exception during InfluxDB operation: " << DiagnosticInformation(std::move(exp));
 
-	//TODO: Close the connection, if we keep it open.
+	Disconnect(worker);
 }
 
 OptionalTlsStream InfluxdbCommonWriter::Connect()
@@ -199,17 +263,65 @@ OptionalTlsStream InfluxdbCommonWriter::Connect()
 	return stream;
 }
 
+void InfluxdbCommonWriter::Disconnect(Worker& worker)
+{
+	auto& stream (worker.Stream);
+	boost::system::error_code ec;
+
+	if (stream.first) {
+		stream.first->next_layer().shutdown(ec);
+		stream.first->lowest_layer().close(ec);
+	} else if (stream.second) {
+		stream.second->lowest_layer().close(ec);
+	}
+
+	stream = OptionalTlsStream();
+}
+
+/**
+ * Sends the request over the worker's connection and reads the response.
+ */
+boost::beast::http::response<boost::beast::http::string_body> InfluxdbCommonWriter::PerformRequest(Worker& worker,
+	boost::beast::http::request<boost::beast::http::string_body>& request)
+{
+	auto& stream (worker.Stream);
+
+	namespace beast = boost::beast;
+	namespace http = beast::http;
+
+	if (stream.first) {
+		http::write(*stream.first, request);
+		stream.first->flush();
+	} else {
+		http::write(*stream.second, request);
+		stream.second->flush();
+	}
+
+	http::parser<false, http::string_body> parser;
+	beast::flat_buffer buf;
+
+	if (stream.first) {
+		http::read(*stream.first, buf, parser);
+	} else {
+		http::read(*stream.second, buf, parser);
+	}
+
+	return parser.release();
+}
+
 void InfluxdbCommonWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
 {
 	if (IsPaused())
 		return;
 
-	m_WorkQueue.Enqueue([this, checkable, cr]() { CheckResultHandlerWQ(checkable, cr); }, PriorityLow);
+	auto& worker (GetWorker(checkable));
+
+	worker.Queue.Enqueue([this, &worker, checkable, cr]() { CheckResultHandlerWQ(worker, checkable, cr); }, PriorityLow);
 }
 
-void InfluxdbCommonWriter::CheckResultHandlerWQ(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void InfluxdbCommonWriter::CheckResultHandlerWQ(Worker& worker, const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
 {
-	AssertOnWorkQueue();
+	AssertOnWorkQueue(worker);
 
 	CONTEXT("Processing check result for '" << checkable->GetName() << "'");
 
@@ -220,37 +332,16 @@ void InfluxdbCommonWriter::CheckResultHandlerWQ(const Checkable::Ptr& checkable,
 	Service::Ptr service;
 	tie(host, service) = GetHostService(checkable);
 
-	MacroProcessor::ResolverList resolvers;
-	if (service)
-		resolvers.emplace_back("service", service);
-	resolvers.emplace_back("host", host);
-
-	String prefix;
-
 	double ts = cr->GetExecutionEnd();
 
-	// Clone the template and perform an in-place macro expansion of measurement and tag values
-	Dictionary::Ptr tmpl_clean = service ? GetServiceTemplate() : GetHostTemplate();
-	Dictionary::Ptr tmpl = static_pointer_cast<Dictionary>(tmpl_clean->ShallowClone());
-	tmpl->Set("measurement", MacroProcessor::ResolveMacros(tmpl->Get("measurement"), resolvers, cr));
-
-	Dictionary::Ptr tagsClean = tmpl->Get("tags");
-	if (tagsClean) {
-		Dictionary::Ptr tags = new Dictionary();
-
-		{
-			ObjectLock olock(tagsClean);
-			for (const Dictionary::Pair& pair : tagsClean) {
-				String missing_macro;
-				Value value = MacroProcessor::ResolveMacros(pair.second, resolvers, cr, &missing_macro);
+	String series;
 
-				if (missing_macro.IsEmpty()) {
-					tags->Set(pair.first, value);
-				}
-			}
-		}
-
-		tmpl->Set("tags", tags);
+	if (service ? m_ServiceTemplateCacheable : m_HostTemplateCacheable) {
+		series = m_SeriesCache.Get(checkable, [this, &host, &service, &cr]() -> Value {
+			return FormatSeries(host, service, cr);
+		});
+	} else {
+		series = FormatSeries(host, service, cr);
 	}
 
 	CheckCommand::Ptr checkCommand = checkable->GetCheckCommand();
@@ -260,40 +351,36 @@ void InfluxdbCommonWriter::CheckResultHandlerWQ(const Checkable::Ptr& checkable,
 	if (perfdata) {
 		ObjectLock olock(perfdata);
 		for (const Value& val : perfdata) {
-			PerfdataValue::Ptr pdv;
-
-			if (val.IsObjectType<PerfdataValue>())
-				pdv = val;
-			else {
-				try {
-					pdv = PerfdataValue::Parse(val);
-				} catch (const std::exception&) {
-					Log(LogWarning, GetReflectionType()->GetName())
-						<< "Ignoring invalid perfdata for checkable '"
-						<< checkable->GetName() << "' and command '"
-						<< checkCommand->GetName() << "' with value: " << val;
-					continue;
-				}
+			PerfdataValue::Fields pdv;
+
+			try {
+				PerfdataValue::ParseFields(val, pdv);
+			} catch (const std::exception&) {
+				Log(LogWarning, GetReflectionType()->GetName())
+					<< "Ignoring invalid perfdata for checkable '"
+					<< checkable->GetName() << "' and command '"
+					<< checkCommand->GetName() << "' with value: " << val;
+				continue;
 			}
 
 			Dictionary::Ptr fields = new Dictionary();
-			fields->Set("value", pdv->GetValue());
+			fields->Set("value", pdv.Value);
 
 			if (GetEnableSendThresholds()) {
-				if (!pdv->GetCrit().IsEmpty())
-					fields->Set("crit", pdv->GetCrit());
-				if (!pdv->GetWarn().IsEmpty())
-					fields->Set("warn", pdv->GetWarn());
-				if (!pdv->GetMin().IsEmpty())
-					fields->Set("min", pdv->GetMin());
-				if (!pdv->GetMax().IsEmpty())
-					fields->Set("max", pdv->GetMax());
+				if (!pdv.Crit.IsEmpty())
+					fields->Set("crit", pdv.Crit);
+				if (!pdv.Warn.IsEmpty())
+					fields->Set("warn", pdv.Warn);
+				if (!pdv.Min.IsEmpty())
+					fields->Set("min", pdv.Min);
+				if (!pdv.Max.IsEmpty())
+					fields->Set("max", pdv.Max);
 			}
-			if (!pdv->GetUnit().IsEmpty()) {
-				fields->Set("unit", pdv->GetUnit());
+			if (!pdv.Unit.IsEmpty()) {
+				fields->Set("unit", pdv.Unit);
 			}
 
-			SendMetric(checkable, tmpl, pdv->GetLabel(), fields, ts);
+			SendMetric(worker, checkable, series, pdv.Label, fields, ts);
 		}
 	}
 
@@ -318,7 +405,7 @@ void InfluxdbCommonWriter::CheckResultHandlerWQ(const Checkable::Ptr& checkable,
 		fields->Set("latency", cr->CalculateLatency());
 		fields->Set("execution_time", cr->CalculateExecutionTime());
 
-		SendMetric(checkable, tmpl, Empty, fields, ts);
+		SendMetric(worker, checkable, series, Empty, fields, ts);
 	}
 }
 
@@ -361,23 +448,45 @@ String InfluxdbCommonWriter::EscapeValue(const Value& value)
 	return value;
 }
 
-void InfluxdbCommonWriter::SendMetric(const Checkable::Ptr& checkable, const Dictionary::Ptr& tmpl,
-	const String& label, const Dictionary::Ptr& fields, double ts)
+/**
+ * Resolves the macros of the host/service template.
+ *
+ * @return The escaped measurement and tags
+ */
+String InfluxdbCommonWriter::FormatSeries(const Host::Ptr& host, const Service::Ptr& service, const CheckResult::Ptr& cr)
 {
+	MacroProcessor::ResolverList resolvers;
+	if (service)
+		resolvers.emplace_back("service", service);
+	resolvers.emplace_back("host", host);
+
+	Dictionary::Ptr tmpl = service ? GetServiceTemplate() : GetHostTemplate();
 	std::ostringstream msgbuf;
-	msgbuf << EscapeKeyOrTagValue(tmpl->Get("measurement"));
+	msgbuf << EscapeKeyOrTagValue(MacroProcessor::ResolveMacros(tmpl->Get("measurement"), resolvers, cr));
 
 	Dictionary::Ptr tags = tmpl->Get("tags");
 	if (tags) {
 		ObjectLock olock(tags);
 		for (const Dictionary::Pair& pair : tags) {
+			String missing_macro;
+			Value value = MacroProcessor::ResolveMacros(pair.second, resolvers, cr, &missing_macro);
+
 			// Empty macro expansion, no tag
-			if (!pair.second.IsEmpty()) {
-				msgbuf << "," << EscapeKeyOrTagValue(pair.first) << "=" << EscapeKeyOrTagValue(pair.second);
+			if (missing_macro.IsEmpty() && !value.IsEmpty()) {
+				msgbuf << "," << EscapeKeyOrTagValue(pair.first) << "=" << EscapeKeyOrTagValue(value);
 			}
 		}
 	}
 
+	return msgbuf.str();
+}
+
+void InfluxdbCommonWriter::SendMetric(Worker& worker, const Checkable::Ptr& checkable, const String& series,
+	const String& label, const Dictionary::Ptr& fields, double ts)
+{
+	std::ostringstream msgbuf;
+	msgbuf << series;
+
 	// Label may be empty in the case of metadata
 	if (!label.IsEmpty())
 		msgbuf << ",metric=" << EscapeKeyOrTagValue(label);
@@ -404,16 +513,17 @@ void InfluxdbCommonWriter::SendMetric(const Checkable::Ptr& checkable, const Dic
 		<< "Checkable '" << checkable->GetName() << "' adds to metric list:'" << msgbuf.str() << "'.";
 
 	// Buffer the data point
-	m_DataBuffer.emplace_back(msgbuf.str());
-	m_DataBufferSize = m_DataBuffer.size();
+	worker.DataBuffer.Add(msgbuf.str());
+	m_Stats.AddFormatted();
+	m_Stats.MarkBuffered();
 
 	// Flush if we've buffered too much to prevent excessive memory use
-	if (static_cast<int>(m_DataBuffer.size()) >= GetFlushThreshold()) {
+	if (static_cast<int>(worker.DataBuffer.GetCount()) >= GetFlushThreshold()) {
 		Log(LogDebug, GetReflectionType()->GetName())
-			<< "Data buffer overflow writing " << m_DataBuffer.size() << " data points";
+			<< "Data buffer overflow writing " << worker.DataBuffer.GetCount() << " data points";
 
 		try {
-			FlushWQ();
+			FlushWQ(worker);
 		} catch (...) {
 			/* Do nothing. */
 		}
@@ -422,85 +532,150 @@ void InfluxdbCommonWriter::SendMetric(const Checkable::Ptr& checkable, const Dic
 
 void InfluxdbCommonWriter::FlushTimeout()
 {
-	m_WorkQueue.Enqueue([this]() { FlushTimeoutWQ(); }, PriorityHigh);
+	for (auto& worker : m_Workers) {
+		worker->Queue.Enqueue([this, &worker]() { FlushTimeoutWQ(*worker); }, PriorityHigh);
+	}
 }
 
-void InfluxdbCommonWriter::FlushTimeoutWQ()
+void InfluxdbCommonWriter::FlushTimeoutWQ(Worker& worker)
 {
-	AssertOnWorkQueue();
+	AssertOnWorkQueue(worker);
 
 	Log(LogDebug, GetReflectionType()->GetName())
-		<< "Timer expired writing " << m_DataBuffer.size() << " data points";
+		<< "Timer expired writing " << worker.DataBuffer.GetCount() << " data points";
 
-	FlushWQ();
+	FlushWQ(worker);
 }
 
-void InfluxdbCommonWriter::FlushWQ()
+void InfluxdbCommonWriter::FlushWQ(Worker& worker)
 {
-	AssertOnWorkQueue();
-
-	namespace beast = boost::beast;
-	namespace http = beast::http;
+	AssertOnWorkQueue(worker);
 
 	/* Flush can be called from 1) Timeout 2) Threshold 3) on shutdown/reload. */
-	if (m_DataBuffer.empty())
+	if (!worker.DataBuffer.GetCount()) {
+		ReplaySpool(worker);
 		return;
+	}
 
 	Log(LogDebug, GetReflectionType()->GetName())
 		<< "Flushing data buffer to InfluxDB.";
 
-	String body = boost::algorithm::join(m_DataBuffer, "\n");
-	m_DataBuffer.clear();
-	m_DataBufferSize = 0;
+	size_t dataPoints = worker.DataBuffer.GetCount();
+	String body = worker.DataBuffer.Take();
+	bool sent;
 
-	OptionalTlsStream stream;
+	m_Stats.MarkUnbuffered();
 
 	try {
-		stream = Connect();
-	} catch (const std::exception& ex) {
-		Log(LogWarning, GetReflectionType()->GetName())
-			<< "Flush failed, cannot connect to InfluxDB: " << DiagnosticInformation(ex, false);
-		return;
+		sent = SendBody(worker, body, dataPoints);
+	} catch (const std::exception&) {
+		SpoolBody(worker, body);
+		throw;
 	}
 
-	Defer s ([&stream]() {
-		if (stream.first) {
-			stream.first->next_layer().shutdown();
-		}
-	});
+	if (sent) {
+		ReplaySpool(worker);
+	} else {
+		SpoolBody(worker, body);
+	}
+}
 
-	auto request (AssembleRequest(std::move(body)));
+/**
+ * Writes the body to the spool, if enabled, to send it once InfluxDB is reachable again.
+ */
+void InfluxdbCommonWriter::SpoolBody(Worker& worker, const String& body)
+{
+	if (!worker.Spool)
+		return;
 
 	try {
-		if (stream.first) {
-			http::write(*stream.first, request);
-			stream.first->flush();
-		} else {
-			http::write(*stream.second, request);
-			stream.second->flush();
-		}
+		worker.Spool->Append(body);
 	} catch (const std::exception& ex) {
-		Log(LogWarning, GetReflectionType()->GetName())
-			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
-		throw;
+		Log(LogCritical, GetReflectionType()->GetName())
+			<< "Can't spool data points, they're lost: " << DiagnosticInformation(ex, false);
 	}
+}
 
-	http::parser<false, http::string_body> parser;
-	beast::flat_buffer buf;
+/**
+ * Sends spooled bodies as far as the replay rate allows.
+ */
+void InfluxdbCommonWriter::ReplaySpool(Worker& worker)
+{
+	if (!worker.Spool || !worker.Spool->GetRecords())
+		return;
 
 	try {
-		if (stream.first) {
-			http::read(*stream.first, buf, parser);
-		} else {
-			http::read(*stream.second, buf, parser);
-		}
+		worker.Spool->Replay([this, &worker](const String& body) {
+			if (!SendBody(worker, body))
+				BOOST_THROW_EXCEPTION(std::runtime_error("InfluxDB is unreachable"));
+		});
 	} catch (const std::exception& ex) {
 		Log(LogWarning, GetReflectionType()->GetName())
-			<< "Failed to parse HTTP response from host '" << GetHost() << "' port '" << GetPort() << "': " << DiagnosticInformation(ex);
-		throw;
+			<< "Replaying spooled data points failed, retrying with the next flush: " << DiagnosticInformation(ex, false);
+	}
+}
+
+/**
+ * Sends the data points and logs errors InfluxDB responded with.
+ *
+ * @param dataPoints The number of data points in the body for the stats, 0 if unknown (spooled)
+ *
+ * @return Whether InfluxDB could be reached and didn't respond with a server error
+ */
+bool InfluxdbCommonWriter::SendBody(Worker& worker, String body)
+{
+	namespace beast = boost::beast;
+	namespace http = beast::http;
+
+	size_t bytes = body.GetLength();
+	auto request (AssembleRequest(std::move(body)));
+	http::response<http::string_body> response;
+	double start = Utility::GetTime();
+
+	for (;;) {
+		bool reused = worker.Stream.first || worker.Stream.second;
+
+		if (reused) {
+			m_ReusedConnections++;
+		} else {
+			try {
+				worker.Stream = Connect();
+			} catch (const std::exception& ex) {
+				Log(LogWarning, GetReflectionType()->GetName())
+					<< "Flush failed, cannot connect to InfluxDB: " << DiagnosticInformation(ex, false);
+				m_Stats.AddError();
+				return false;
+			}
+
+			m_Connections++;
+		}
+
+		try {
+			response = PerformRequest(worker, request);
+			break;
+		} catch (const std::exception& ex) {
+			Disconnect(worker);
+
+			/* InfluxDB or a load balancer may have closed the idle connection meanwhile. */
+			if (reused) {
+				Log(LogNotice, GetReflectionType()->GetName())
+					<< "Kept-alive connection to host '" << GetHost() << "' port '" << GetPort() << "' failed, reconnecting: "
+					<< DiagnosticInformation(ex, false);
+				m_Stats.AddRetry();
+				continue;
+			}
+
+			Log(LogWarning, GetReflectionType()->GetName())
+				<< "HTTP request to host '" << GetHost() << "' port '" << GetPort() << "' failed: " << DiagnosticInformation(ex);
+			m_Stats.AddError();
+			throw;
+		}
 	}
 
-	auto& response (parser.get());
+	m_Stats.AddFlush(dataPoints, bytes, Utility::GetTime() - start);
+
+	if (!response.keep_alive())
+		Disconnect(worker);
 
 	if (response.result() != http::status::no_content) {
 		Log(LogWarning, GetReflectionType()->GetName())
@@ -510,25 +685,30 @@ void InfluxdbCommonWriter::FlushWQ()
 		if (contentType != "application/json") {
 			Log(LogWarning, GetReflectionType()->GetName())
 				<< "Unexpected Content-Type: " << contentType;
-			return;
-		}
+		} else {
+			Dictionary::Ptr jsonResponse;
+			auto& body (response.body());
 
-		Dictionary::Ptr jsonResponse;
-		auto& body (response.body());
+			try {
+				jsonResponse = JsonDecode(body);
 
-		try {
-			jsonResponse = JsonDecode(body);
-		} catch (...) {
-			Log(LogWarning, GetReflectionType()->GetName())
-				<< "Unable to parse JSON response:\n" << body;
-			return;
-		}
+				String error = jsonResponse->Get("error");
 
-		String error = jsonResponse->Get("error");
+				Log(LogCritical, GetReflectionType()->GetName())
+					<< "InfluxDB error message:\n" << error;
+			} catch (...) {
+				Log(LogWarning, GetReflectionType()->GetName())
+					<< "Unable to parse JSON response:\n" << body;
+			}
+		}
+	}
 
-		Log(LogCritical, GetReflectionType()->GetName())
-			<< "InfluxDB error message:\n" << error;
+	if (response.result_int() >= 500) {
+		m_Stats.AddError();
+		return false;
 	}
+
+	return true;
 }
 
 boost::beast::http::request<boost::beast::http::string_body> InfluxdbCommonWriter::AssembleBaseRequest(String body)
@@ -536,10 +716,16 @@ boost::beast::http::request<boost::beast::http::string_body> InfluxdbCommonWrite
 	namespace http = boost::beast::http;
 
 	auto url (AssembleUrl());
-	http::request<http::string_body> request (http::verb::post, std::string(url->Format(true)), 10);
+	/* HTTP/1.1 to keep the connection alive for the next flush. */
+	http::request<http::string_body> request (http::verb::post, std::string(url->Format(true)), 11);
 
 	request.set(http::field::user_agent, "Icinga/" + Application::GetAppVersion());
 	request.set(http::field::host, url->GetHost() + ":" + url->GetPort());
+
+	/* Spooled bodies may have been compressed before compression was disabled, or the other way around. */
+	if (DataPointBuffer::IsGzip(body))
+		request.set(http::field::content_encoding, "gzip");
+
 	request.body() = std::move(body);
 	request.content_length(request.body().size());
 
@@ -558,6 +744,22 @@ Url::Ptr InfluxdbCommonWriter::AssembleBaseUrl()
 	return url;
 }
 
+void InfluxdbCommonWriter::ValidateCompression(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<InfluxdbCommonWriter>::ValidateCompression(lvalue, utils);
+
+	if (!lvalue().IsEmpty() && lvalue() != "gzip")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "compression" }, "Value must be empty or 'gzip'."));
+}
+
+void InfluxdbCommonWriter::ValidateWorkerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<InfluxdbCommonWriter>::ValidateWorkerThreads(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "worker_threads" }, "Value must be at least 1."));
+}
+
 void InfluxdbCommonWriter::ValidateHostTemplate(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils)
 {
 	ObjectImpl<InfluxdbCommonWriter>::ValidateHostTemplate(lvalue, utils);
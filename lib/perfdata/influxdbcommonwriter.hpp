@@ -4,6 +4,10 @@
 #define INFLUXDBCOMMONWRITER_H
 
 #include "perfdata/influxdbcommonwriter-ti.hpp"
+#include "perfdata/datapointbuffer.hpp"
+#include "perfdata/perfdataspool.hpp"
+#include "perfdata/templatecache.hpp"
+#include "perfdata/writerstats.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/perfdatavalue.hpp"
@@ -16,6 +20,8 @@
 #include <boost/beast/http/string_body.hpp>
 #include <atomic>
 #include <fstream>
+#include <memory>
+#include <vector>
 
 namespace icinga
 {
@@ -33,6 +39,8 @@ public:
 	template<class InfluxWriter>
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
+	void ValidateCompression(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+	void ValidateWorkerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
 	void ValidateHostTemplate(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils) override;
 	void ValidateServiceTemplate(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils) override;
 
@@ -47,28 +55,53 @@ protected:
 	virtual Url::Ptr AssembleUrl() = 0;
 
 private:
-	boost::signals2::connection m_HandleCheckResults;
+	/**
+	 * Formats the data points of a share of the checkables and sends them over its own connection.
+	 * Everything but the queue is only accessed on the queue.
+	 */
+	struct Worker
+	{
+		WorkQueue Queue{10000000, 1};
+		DataPointBuffer DataBuffer;
+		OptionalTlsStream Stream; /**< Kept alive across flushes */
+		std::unique_ptr<PerfdataSpool> Spool; /**< If enable_spool */
+	};
+
+	SignalConnection m_HandleCheckResults;
 	Timer::Ptr m_FlushTimer;
-	WorkQueue m_WorkQueue{10000000, 1};
-	std::vector<String> m_DataBuffer;
-	std::atomic_size_t m_DataBufferSize{0};
+	std::vector<std::unique_ptr<Worker>> m_Workers;
+	std::atomic<uint_fast64_t> m_Connections{0};
+	std::atomic<uint_fast64_t> m_ReusedConnections{0};
+	TemplateCache m_SeriesCache;
+	WriterStats m_Stats; /**< Shared by all workers */
+	bool m_HostTemplateCacheable{false};
+	bool m_ServiceTemplateCacheable{false};
+
+	Worker& GetWorker(const Checkable::Ptr& checkable);
 
 	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
-	void CheckResultHandlerWQ(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
-	void SendMetric(const Checkable::Ptr& checkable, const Dictionary::Ptr& tmpl,
+	void CheckResultHandlerWQ(Worker& worker, const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	String FormatSeries(const Host::Ptr& host, const Service::Ptr& service, const CheckResult::Ptr& cr);
+	void SendMetric(Worker& worker, const Checkable::Ptr& checkable, const String& series,
 		const String& label, const Dictionary::Ptr& fields, double ts);
 	void FlushTimeout();
-	void FlushTimeoutWQ();
-	void FlushWQ();
+	void FlushTimeoutWQ(Worker& worker);
+	void FlushWQ(Worker& worker);
+	bool SendBody(Worker& worker, String body, size_t dataPoints = 0);
+	void SpoolBody(Worker& worker, const String& body);
+	void ReplaySpool(Worker& worker);
 
 	static String EscapeKeyOrTagValue(const String& str);
 	static String EscapeValue(const Value& value);
 
 	OptionalTlsStream Connect();
+	void Disconnect(Worker& worker);
+	boost::beast::http::response<boost::beast::http::string_body> PerformRequest(Worker& worker,
+		boost::beast::http::request<boost::beast::http::string_body>& request);
 
-	void AssertOnWorkQueue();
+	void AssertOnWorkQueue(Worker& worker);
 
-	void ExceptionHandler(boost::exception_ptr exp);
+	void ExceptionHandler(Worker& worker, boost::exception_ptr exp);
 };
 
 template<class InfluxWriter>
@@ -78,19 +111,46 @@ void InfluxdbCommonWriter::StatsFunc(const Dictionary::Ptr& status, const Array:
 	auto typeName (InfluxWriter::TypeInstance->GetName().ToLower());
 
 	for (const typename InfluxWriter::Ptr& influxwriter : ConfigType::GetObjectsByType<InfluxWriter>()) {
-		size_t workQueueItems = influxwriter->m_WorkQueue.GetLength();
-		double workQueueItemRate = influxwriter->m_WorkQueue.GetTaskCount(60) / 60.0;
-		size_t dataBufferItems = influxwriter->m_DataBufferSize;
-
-		nodes.emplace_back(influxwriter->GetName(), new Dictionary({
+		size_t workQueueItems = 0;
+		double workQueueItemRate = 0;
+		size_t dataBufferItems = 0;
+		double spoolRecords = 0;
+		double spoolBytes = 0;
+
+		for (auto& worker : influxwriter->m_Workers) {
+			workQueueItems += worker->Queue.GetLength();
+			workQueueItemRate += worker->Queue.GetTaskCount(60) / 60.0;
+			dataBufferItems += worker->DataBuffer.GetCount();
+
+			if (worker->Spool) {
+				spoolRecords += worker->Spool->GetRecords();
+				spoolBytes += worker->Spool->GetBytes();
+			}
+		}
+
+		double connections = influxwriter->m_Connections.load();
+		double reusedConnections = influxwriter->m_ReusedConnections.load();
+
+		Dictionary::Ptr stats = new Dictionary({
 			{ "work_queue_items", workQueueItems },
 			{ "work_queue_item_rate", workQueueItemRate },
-			{ "data_buffer_items", dataBufferItems }
-		}));
+			{ "data_buffer_items", dataBufferItems },
+			{ "connections", connections },
+			{ "reused_connections", reusedConnections },
+			{ "spool_records", spoolRecords },
+			{ "spool_bytes", spoolBytes }
+		});
 
 		perfdata->Add(new PerfdataValue(typeName + "_" + influxwriter->GetName() + "_work_queue_items", workQueueItems));
 		perfdata->Add(new PerfdataValue(typeName + "_" + influxwriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
 		perfdata->Add(new PerfdataValue(typeName + "_" + influxwriter->GetName() + "_data_queue_items", dataBufferItems));
+		perfdata->Add(new PerfdataValue(typeName + "_" + influxwriter->GetName() + "_connections", connections));
+		perfdata->Add(new PerfdataValue(typeName + "_" + influxwriter->GetName() + "_reused_connections", reusedConnections));
+		perfdata->Add(new PerfdataValue(typeName + "_" + influxwriter->GetName() + "_spool_bytes", spoolBytes));
+
+		influxwriter->m_Stats.Report(stats, perfdata, typeName + "_" + influxwriter->GetName());
+
+		nodes.emplace_back(influxwriter->GetName(), stats);
 	}
 
 	status->Set(typeName, new Dictionary(std::move(nodes)));
@@ -0,0 +1,207 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "perfdata/metricstream.hpp"
+#include "base/defer.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/tcpsocket.hpp"
+#include "base/utility.hpp"
+#include <boost/asio/write.hpp>
+#include <boost/date_time/posix_time/posix_time_duration.hpp>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+using namespace icinga;
+
+/**
+ * @param onFailure See FailureHandler
+ * @param stats Records the writes, if given. Must outlive the stream.
+ * @param writeTimeout Seconds a single write may take
+ * @param maxBufferBytes Size limit of the data not written yet, see Write()
+ */
+MetricStream::MetricStream(FailureHandler onFailure, WriterStats* stats, double writeTimeout, size_t maxBufferBytes)
+	: m_Strand(IoEngine::Get().GetIoContext()), m_Queued(IoEngine::Get().GetIoContext()),
+	m_OnFailure(std::move(onFailure)), m_Stats(stats), m_WriteTimeout(writeTimeout), m_MaxBufferBytes(maxBufferBytes)
+{
+}
+
+/**
+ * Connects (blocking) and starts writing the buffer
+ *
+ * Throws on failure. Must be called only once.
+ */
+void MetricStream::Connect(const String& host, const String& port)
+{
+	m_Stream = Shared<AsioTcpStream>::Make(IoEngine::Get().GetIoContext());
+
+	icinga::Connect(m_Stream->lowest_layer(), host, port);
+
+	m_Connected.store(true);
+
+	Ptr keepAlive (this);
+
+	IoEngine::SpawnCoroutine(m_Strand, [this, keepAlive](boost::asio::yield_context yc) { WriteLoop(yc); });
+}
+
+/**
+ * Appends data to be written without waiting for the backend
+ *
+ * @return Whether the data was accepted, false if not connected or the buffer is full
+ */
+bool MetricStream::Write(const std::string& data)
+{
+	bool wasEmpty;
+
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		if (!m_Connected.load() || m_Buffer.size() + data.size() > m_MaxBufferBytes)
+			return false;
+
+		wasEmpty = m_Buffer.empty();
+		m_Buffer.append(data);
+	}
+
+	if (m_Stats)
+		m_Stats->MarkBuffered();
+
+	/* Otherwise the writer hasn't picked up the buffer yet and will take this data with it. */
+	if (wasEmpty) {
+		Ptr keepAlive (this);
+
+		m_Strand.post([this, keepAlive]() { m_Queued.Set(); });
+	}
+
+	return true;
+}
+
+/**
+ * Waits until everything written so far has been sent
+ *
+ * @param timeout Seconds to wait at most
+ *
+ * @return Whether everything has been sent
+ */
+bool MetricStream::Flush(double timeout)
+{
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	m_CV.wait_for(lock, std::chrono::duration<double>(timeout), [this]() {
+		return !m_Connected.load() || (m_Buffer.empty() && !m_Writing);
+	});
+
+	return m_Connected.load() && m_Buffer.empty() && !m_Writing;
+}
+
+/**
+ * Closes the connection, discarding what hasn't been sent yet
+ */
+void MetricStream::Disconnect()
+{
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		if (!m_Connected.exchange(false))
+			return;
+
+		m_Buffer.clear();
+	}
+
+	m_CV.notify_all();
+
+	Ptr keepAlive (this);
+
+	m_Strand.post([this, keepAlive]() {
+		boost::system::error_code ec;
+		m_Stream->lowest_layer().close(ec);
+
+		m_Queued.Set();
+	});
+}
+
+void MetricStream::WriteLoop(boost::asio::yield_context yc)
+{
+	namespace asio = boost::asio;
+
+	for (;;) {
+		m_Queued.Wait(yc);
+		m_Queued.Clear();
+
+		std::string data;
+
+		{
+			std::unique_lock<std::mutex> lock (m_Mutex);
+
+			if (!m_Connected.load())
+				return;
+
+			data.swap(m_Buffer);
+			m_Writing = !data.empty();
+		}
+
+		if (data.empty())
+			continue;
+
+		if (m_Stats)
+			m_Stats->MarkUnbuffered();
+
+		double start = Utility::GetTime();
+
+		try {
+			Ptr keepAlive (this);
+
+			Timeout::Ptr timeout = new Timeout(m_Strand.context(), m_Strand, boost::posix_time::microseconds(int64_t(m_WriteTimeout * 1e6)),
+				[this, keepAlive](asio::yield_context) {
+					boost::system::error_code ec;
+					m_Stream->lowest_layer().cancel(ec);
+				}
+			);
+
+			Defer cancelTimeout ([&timeout]() { timeout->Cancel(); });
+
+			asio::async_write(*m_Stream, asio::buffer(data), yc);
+			m_Stream->async_flush(yc);
+		} catch (const std::exception& ex) {
+			Log(LogDebug, "MetricStream")
+				<< "Error while writing metrics: " << DiagnosticInformation(ex);
+
+			if (m_Stats)
+				m_Stats->AddError();
+
+			bool wasConnected;
+
+			{
+				std::unique_lock<std::mutex> lock (m_Mutex);
+
+				wasConnected = m_Connected.exchange(false);
+				m_Writing = false;
+				data.append(m_Buffer);
+				m_Buffer.clear();
+			}
+
+			m_CV.notify_all();
+
+			boost::system::error_code ec;
+			m_Stream->lowest_layer().close(ec);
+
+			/* Not after Disconnect(), the caller doesn't want the data anymore. */
+			if (wasConnected && m_OnFailure)
+				m_OnFailure(std::move(data));
+
+			return;
+		}
+
+		/* One metric per line */
+		if (m_Stats)
+			m_Stats->AddFlush(std::count(data.begin(), data.end(), '\n'), data.size(), Utility::GetTime() - start);
+
+		{
+			std::unique_lock<std::mutex> lock (m_Mutex);
+
+			m_Writing = false;
+		}
+
+		m_CV.notify_all();
+	}
+}
@@ -0,0 +1,76 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef METRICSTREAM_H
+#define METRICSTREAM_H
+
+#include "perfdata/writerstats.hpp"
+#include "base/io-engine.hpp"
+#include "base/shared-object.hpp"
+#include "base/string.hpp"
+#include "base/tlsstream.hpp"
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/spawn.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace icinga
+{
+
+/**
+ * A TCP connection to a line based metric backend (Graphite, OpenTSDB).
+ *
+ * Write() only appends to a buffer which a coroutine on the I/O engine writes to the socket.
+ * Everything buffered while a write is in progress goes out with the next one, so a slow
+ * backend results in fewer, larger writes instead of blocking the writer's work queue.
+ * A write taking longer than the write timeout closes the connection.
+ *
+ * @ingroup perfdata
+ */
+class MetricStream final : public SharedObject
+{
+public:
+	DECLARE_PTR_TYPEDEFS(MetricStream);
+
+	/**
+	 * Called on the I/O engine (once) after the connection failed, with the data which may not have been sent.
+	 */
+	typedef std::function<void(std::string)> FailureHandler;
+
+	MetricStream(FailureHandler onFailure, WriterStats* stats = nullptr, double writeTimeout = 10,
+		size_t maxBufferBytes = 32 * 1024 * 1024);
+
+	void Connect(const String& host, const String& port);
+	bool Write(const std::string& data);
+	bool Flush(double timeout);
+	void Disconnect();
+
+	inline bool IsConnected() const noexcept
+	{
+		return m_Connected.load();
+	}
+
+private:
+	boost::asio::io_context::strand m_Strand;
+	Shared<AsioTcpStream>::Ptr m_Stream;
+	AsioConditionVariable m_Queued;
+	FailureHandler m_OnFailure;
+	WriterStats* m_Stats;
+	double m_WriteTimeout;
+	size_t m_MaxBufferBytes;
+	std::atomic<bool> m_Connected{false};
+
+	std::mutex m_Mutex;
+	std::condition_variable m_CV;
+	std::string m_Buffer; /**< Protected by m_Mutex */
+	bool m_Writing{false}; /**< Protected by m_Mutex */
+
+	void WriteLoop(boost::asio::yield_context yc);
+};
+
+}
+
+#endif /* METRICSTREAM_H */
@@ -21,6 +21,7 @@
 #include "base/statsfunction.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <utility>
 
 using namespace icinga;
 
@@ -49,15 +50,20 @@ void OpenTsdbWriter::OnConfigLoaded()
  * Feature stats interface
  *
  * @param status Key value pairs for feature stats
+ * @param perfdata Array of PerfdataValue objects
  */
-void OpenTsdbWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+void OpenTsdbWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
 	for (const OpenTsdbWriter::Ptr& opentsdbwriter : ConfigType::GetObjectsByType<OpenTsdbWriter>()) {
-		nodes.emplace_back(opentsdbwriter->GetName(), new Dictionary({
+		Dictionary::Ptr stats = new Dictionary({
 			{ "connected", opentsdbwriter->GetConnected() }
-		}));
+		});
+
+		opentsdbwriter->m_Stats.Report(stats, perfdata, "opentsdbwriter_" + opentsdbwriter->GetName());
+
+		nodes.emplace_back(opentsdbwriter->GetName(), stats);
 	}
 
 	status->Set("opentsdbwriter", new Dictionary(std::move(nodes)));
@@ -81,7 +87,7 @@ void OpenTsdbWriter::Resume()
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
 
-	m_HandleCheckResults = Service::OnNewCheckResult.connect([this](const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
+	m_HandleCheckResults = Service::OnNewCheckResult.connect(GetReflectionType()->GetName().GetData(), [this](const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
 		CheckResultHandler(checkable, cr);
 	});
 }
@@ -94,11 +100,27 @@ void OpenTsdbWriter::Pause()
 	m_HandleCheckResults.disconnect();
 	m_ReconnectTimer->Stop(true);
 
+	MetricStream::Ptr stream;
+
+	{
+		ObjectLock olock(this);
+
+		if (GetConnected())
+			stream = m_Stream;
+	}
+
+	if (stream) {
+		if (!stream->Flush(10)) {
+			Log(LogWarning, "OpenTsdbWriter")
+				<< "'" << GetName() << "' couldn't send all pending metrics to OpenTSDB within 10 seconds.";
+		}
+
+		stream->Disconnect();
+	}
+
 	Log(LogInformation, "OpentsdbWriter")
 		<< "'" << GetName() << "' paused.";
 
-	m_Stream->close();
-
 	SetConnected(false);
 
 	ObjectImpl<OpenTsdbWriter>::Pause();
@@ -127,10 +149,15 @@ void OpenTsdbWriter::ReconnectTimerHandler()
 	 * We're using telnet as input method. Future PRs may change this into using the HTTP API.
 	 * http://opentsdb.net/docs/build/html/user_guide/writing/index.html#telnet
 	 */
-	m_Stream = Shared<AsioTcpStream>::Make(IoEngine::Get().GetIoContext());
+	MetricStream::Ptr stream = new MetricStream([this](std::string) {
+		Log(LogCritical, "OpenTsdbWriter")
+			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+
+		SetConnected(false);
+	}, &m_Stats);
 
 	try {
-		icinga::Connect(m_Stream->lowest_layer(), GetHost(), GetPort());
+		stream->Connect(GetHost(), GetPort());
 	} catch (const std::exception& ex) {
 		Log(LogWarning, "OpenTsdbWriter")
 			<< "Can't connect to OpenTSDB on host '" << GetHost() << "' port '" << GetPort() << "'.";
@@ -140,7 +167,12 @@ void OpenTsdbWriter::ReconnectTimerHandler()
 		return;
 	}
 
-	SetConnected(true);
+	{
+		ObjectLock olock(this);
+
+		m_Stream = std::move(stream);
+		SetConnected(true);
+	}
 
 	Log(LogInformation, "OpenTsdbWriter")
 		<< "Finished reconnecting to OpenTSDB in " << std::setw(2) << Utility::GetTime() - startTime << " second(s).";
@@ -387,20 +419,22 @@ void OpenTsdbWriter::SendMetric(const Checkable::Ptr& checkable, const String& m
 	msgbuf << "\n";
 	String put = msgbuf.str();
 
+	m_Stats.AddFormatted();
+
 	ObjectLock olock(this);
 
 	if (!GetConnected())
 		return;
 
-	try {
-		Log(LogDebug, "OpenTsdbWriter")
-			<< "Checkable '" << checkable->GetName() << "' sending message '" << put << "'.";
+	Log(LogDebug, "OpenTsdbWriter")
+		<< "Checkable '" << checkable->GetName() << "' sending message '" << put << "'.";
+
+	/* Only buffered, the stream writes it on the I/O engine together with the other pending metrics. */
+	if (!m_Stream->Write(put.GetData())) {
+		m_Stats.AddError();
 
-		boost::asio::write(*m_Stream, boost::asio::buffer(msgbuf.str()));
-		m_Stream->flush();
-	} catch (const std::exception& ex) {
 		Log(LogCritical, "OpenTsdbWriter")
-			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "': Write buffer is full.";
 	}
 }
 
@@ -4,9 +4,10 @@
 #define OPENTSDBWRITER_H
 
 #include "perfdata/opentsdbwriter-ti.hpp"
+#include "perfdata/metricstream.hpp"
+#include "perfdata/writerstats.hpp"
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
-#include "base/tcpsocket.hpp"
 #include "base/timer.hpp"
 #include <fstream>
 
@@ -35,9 +36,10 @@ protected:
 	void Pause() override;
 
 private:
-	Shared<AsioTcpStream>::Ptr m_Stream;
+	MetricStream::Ptr m_Stream; /**< Protected by the object lock */
+	WriterStats m_Stats;
 
-	boost::signals2::connection m_HandleCheckResults;
+	SignalConnection m_HandleCheckResults;
 	Timer::Ptr m_ReconnectTimer;
 
 	Dictionary::Ptr m_ServiceConfigTemplate;
@@ -0,0 +1,621 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "perfdata/otlpmetricswriter.hpp"
+#include "perfdata/otlpmetricswriter-ti.cpp"
+#include "icinga/service.hpp"
+#include "icinga/macroprocessor.hpp"
+#include "icinga/icingaapplication.hpp"
+#include "icinga/checkcommand.hpp"
+#include "base/application.hpp"
+#include "base/base64.hpp"
+#include "base/configtype.hpp"
+#include "base/convert.hpp"
+#include "base/exception.hpp"
+#include "base/io-engine.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/objectlock.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/statsfunction.hpp"
+#include "base/tcpsocket.hpp"
+#include "base/tlsutility.hpp"
+#include "base/utility.hpp"
+#include <boost/algorithm/string/join.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/field.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/status.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/verb.hpp>
+#include <boost/beast/http/write.hpp>
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace icinga;
+
+REGISTER_TYPE(OtlpMetricsWriter);
+
+REGISTER_STATSFUNCTION(OtlpMetricsWriter, &OtlpMetricsWriter::StatsFunc);
+
+void OtlpMetricsWriter::OnConfigLoaded()
+{
+	ObjectImpl<OtlpMetricsWriter>::OnConfigLoaded();
+
+	m_WorkQueue.SetName("OtlpMetricsWriter, " + GetName());
+	m_DataBuffer.SetCompression(GetCompression() == "gzip");
+
+	if (!GetEnableHa()) {
+		Log(LogDebug, "OtlpMetricsWriter")
+			<< "HA functionality disabled. Won't pause connection: " << GetName();
+
+		SetHAMode(HARunEverywhere);
+	} else {
+		SetHAMode(HARunOnce);
+	}
+}
+
+void OtlpMetricsWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	DictionaryData nodes;
+
+	for (const OtlpMetricsWriter::Ptr& otlpmetricswriter : ConfigType::GetObjectsByType<OtlpMetricsWriter>()) {
+		size_t workQueueItems = otlpmetricswriter->m_WorkQueue.GetLength();
+		double workQueueItemRate = otlpmetricswriter->m_WorkQueue.GetTaskCount(60) / 60.0;
+		size_t dataBufferItems = otlpmetricswriter->m_DataBuffer.GetCount();
+		double connections = otlpmetricswriter->m_Connections.load();
+		double reusedConnections = otlpmetricswriter->m_ReusedConnections.load();
+
+		Dictionary::Ptr stats = new Dictionary({
+			{ "work_queue_items", workQueueItems },
+			{ "work_queue_item_rate", workQueueItemRate },
+			{ "data_buffer_items", dataBufferItems },
+			{ "connections", connections },
+			{ "reused_connections", reusedConnections }
+		});
+
+		perfdata->Add(new PerfdataValue("otlpmetricswriter_" + otlpmetricswriter->GetName() + "_work_queue_items", workQueueItems));
+		perfdata->Add(new PerfdataValue("otlpmetricswriter_" + otlpmetricswriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+		perfdata->Add(new PerfdataValue("otlpmetricswriter_" + otlpmetricswriter->GetName() + "_data_queue_items", dataBufferItems));
+		perfdata->Add(new PerfdataValue("otlpmetricswriter_" + otlpmetricswriter->GetName() + "_connections", connections));
+		perfdata->Add(new PerfdataValue("otlpmetricswriter_" + otlpmetricswriter->GetName() + "_reused_connections", reusedConnections));
+
+		otlpmetricswriter->m_Stats.Report(stats, perfdata, "otlpmetricswriter_" + otlpmetricswriter->GetName());
+
+		nodes.emplace_back(otlpmetricswriter->GetName(), stats);
+	}
+
+	status->Set("otlpmetricswriter", new Dictionary(std::move(nodes)));
+}
+
+void OtlpMetricsWriter::Resume()
+{
+	ObjectImpl<OtlpMetricsWriter>::Resume();
+
+	Log(LogInformation, "OtlpMetricsWriter")
+		<< "'" << GetName() << "' resumed.";
+
+	m_WorkQueue.SetExceptionCallback([this](boost::exception_ptr exp) { ExceptionHandler(std::move(exp)); });
+
+	{
+		std::unique_lock<std::mutex> lock (m_DataBufferMutex);
+
+		/* All data points of a request share one resource and scope. */
+		m_DataBuffer.SetFraming(GetResourceEnvelope(), ",", "]}]}]}");
+	}
+
+	/* Setup timer for periodically flushing m_DataBuffer */
+	m_FlushTimer = Timer::Create();
+	m_FlushTimer->SetInterval(GetFlushInterval());
+	m_FlushTimer->OnTimerExpired.connect([this](const Timer * const&) { FlushTimeout(); });
+	m_FlushTimer->Start();
+	m_FlushTimer->Reschedule(0);
+
+	/* Register for new metrics. */
+	m_HandleCheckResults = Checkable::OnNewCheckResult.connect(GetReflectionType()->GetName().GetData(), [this](const Checkable::Ptr& checkable,
+		const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
+		CheckResultHandler(checkable, cr);
+	});
+}
+
+/* Pause is equivalent to Stop, but with HA capabilities to resume at runtime. */
+void OtlpMetricsWriter::Pause()
+{
+	m_HandleCheckResults.disconnect();
+
+	m_FlushTimer->Stop(true);
+	m_WorkQueue.Join();
+
+	{
+		std::unique_lock<std::mutex> lock (m_DataBufferMutex);
+		Flush();
+		Disconnect();
+	}
+
+	Log(LogInformation, "OtlpMetricsWriter")
+		<< "'" << GetName() << "' paused.";
+
+	ObjectImpl<OtlpMetricsWriter>::Pause();
+}
+
+/**
+ * The beginning of an ExportMetricsServiceRequest up to the metrics array.
+ */
+String OtlpMetricsWriter::GetResourceEnvelope()
+{
+	String nodeName = IcingaApplication::GetInstance()->GetNodeName();
+
+	String resource = "{\"attributes\":[" + FormatAttribute("service.name", "icinga2") + ","
+		+ FormatAttribute("service.instance.id", nodeName) + ","
+		+ FormatAttribute("service.version", Application::GetAppVersion()) + "]}";
+
+	String scope = JsonEncode(new Dictionary({
+		{ "name", "icinga2" },
+		{ "version", Application::GetAppVersion() }
+	}));
+
+	return "{\"resourceMetrics\":[{\"resource\":" + resource + ",\"scopeMetrics\":[{\"scope\":" + scope + ",\"metrics\":[";
+}
+
+/**
+ * @return A KeyValue with a string value, JSON encoded
+ */
+String OtlpMetricsWriter::FormatAttribute(const String& key, const Value& value)
+{
+	return JsonEncode(new Dictionary({
+		{ "key", key },
+		{ "value", new Dictionary({
+			{ "stringValue", Convert::ToString(value) }
+		}) }
+	}));
+}
+
+void OtlpMetricsWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+{
+	if (IsPaused())
+		return;
+
+	m_WorkQueue.Enqueue([this, checkable, cr]() { CheckResultHandlerWQ(checkable, cr); }, PriorityLow);
+}
+
+void OtlpMetricsWriter::CheckResultHandlerWQ(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+{
+	AssertOnWorkQueue();
+
+	CONTEXT("OtlpMetricsWriter processing check result for '" << checkable->GetName() << "'");
+
+	if (!IcingaApplication::GetInstance()->GetEnablePerfdata() || !checkable->GetEnablePerfdata())
+		return;
+
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	MacroProcessor::ResolverList resolvers;
+	if (service)
+		resolvers.emplace_back("service", service);
+	resolvers.emplace_back("host", host);
+
+	/* The attributes are shared by all data points of this check result, so they're encoded once. */
+	std::vector<String> attributes;
+	Dictionary::Ptr attributesTemplate = service ? GetServiceAttributes() : GetHostAttributes();
+
+	{
+		ObjectLock olock(attributesTemplate);
+		for (const Dictionary::Pair& pair : attributesTemplate) {
+			String missingMacro;
+			Value value = MacroProcessor::ResolveMacros(pair.second, resolvers, cr, &missingMacro);
+
+			// Empty macro expansion, no attribute
+			if (missingMacro.IsEmpty() && !value.IsEmpty())
+				attributes.emplace_back(FormatAttribute(pair.first, value));
+		}
+	}
+
+	auto formatAttributes ([&attributes](const String& label) -> String {
+		std::vector<String> all (attributes);
+
+		// Label may be empty in the case of metadata
+		if (!label.IsEmpty())
+			all.emplace_back(FormatAttribute("label", label));
+
+		return "[" + boost::algorithm::join(all, ",") + "]";
+	});
+
+	double ts = cr->GetExecutionEnd();
+
+	CheckCommand::Ptr checkCommand = checkable->GetCheckCommand();
+
+	Array::Ptr perfdata = cr->GetPerformanceData();
+
+	if (perfdata) {
+		ObjectLock olock(perfdata);
+		for (const Value& val : perfdata) {
+			PerfdataValue::Fields pdv;
+
+			try {
+				PerfdataValue::ParseFields(val, pdv);
+			} catch (const std::exception&) {
+				Log(LogWarning, "OtlpMetricsWriter")
+					<< "Ignoring invalid perfdata for checkable '"
+					<< checkable->GetName() << "' and command '"
+					<< checkCommand->GetName() << "' with value: " << val;
+				continue;
+			}
+
+			String pdvAttributes = formatAttributes(pdv.Label);
+
+			AddGauge("icinga2.perfdata", pdv.Unit, pdvAttributes, pdv.Value, ts);
+
+			if (GetEnableSendThresholds()) {
+				if (!pdv.Crit.IsEmpty())
+					AddGauge("icinga2.perfdata.crit", pdv.Unit, pdvAttributes, pdv.Crit, ts);
+				if (!pdv.Warn.IsEmpty())
+					AddGauge("icinga2.perfdata.warn", pdv.Unit, pdvAttributes, pdv.Warn, ts);
+				if (!pdv.Min.IsEmpty())
+					AddGauge("icinga2.perfdata.min", pdv.Unit, pdvAttributes, pdv.Min, ts);
+				if (!pdv.Max.IsEmpty())
+					AddGauge("icinga2.perfdata.max", pdv.Unit, pdvAttributes, pdv.Max, ts);
+			}
+		}
+	}
+
+	if (GetEnableSendMetadata()) {
+		String metaAttributes = formatAttributes(String());
+
+		if (service)
+			AddGauge("icinga2.state", "", metaAttributes, service->GetState(), ts);
+		else
+			AddGauge("icinga2.state", "", metaAttributes, host->GetState(), ts);
+
+		AddGauge("icinga2.current_attempt", "", metaAttributes, checkable->GetCheckAttempt(), ts);
+		AddGauge("icinga2.max_check_attempts", "", metaAttributes, checkable->GetMaxCheckAttempts(), ts);
+		AddGauge("icinga2.state_type", "", metaAttributes, checkable->GetStateType(), ts);
+		AddGauge("icinga2.reachable", "", metaAttributes, checkable->IsReachable(), ts);
+		AddGauge("icinga2.downtime_depth", "", metaAttributes, checkable->GetDowntimeDepth(), ts);
+		AddGauge("icinga2.acknowledgement", "", metaAttributes, checkable->GetAcknowledgement(), ts);
+		AddGauge("icinga2.latency", "seconds", metaAttributes, cr->CalculateLatency(), ts);
+		AddGauge("icinga2.execution_time", "seconds", metaAttributes, cr->CalculateExecutionTime(), ts);
+	}
+}
+
+/**
+ * Buffers a gauge with a single data point, flushes if the buffer is full
+ *
+ * @param name Metric name
+ * @param unit Unit as normalized by PerfdataValue, may be empty
+ * @param attributes JSON encoded KeyValue array
+ * @param value Value of the data point, not sent if not finite
+ * @param ts Timestamp of the data point
+ */
+void OtlpMetricsWriter::AddGauge(const String& name, const String& unit, const String& attributes, double value, double ts)
+{
+	if (!std::isfinite(value))
+		return;
+
+	/* The UCUM units OTLP receivers (e.g. Prometheus) translate. */
+	String otlpUnit;
+
+	if (unit == "seconds")
+		otlpUnit = "s";
+	else if (unit == "bytes")
+		otlpUnit = "By";
+	else if (unit == "bits")
+		otlpUnit = "bit";
+	else if (unit == "percent")
+		otlpUnit = "%";
+	else
+		otlpUnit = unit;
+
+	std::ostringstream msgbuf;
+
+	/* The nanoseconds are a 64-bit integer, i.e. a string in the JSON encoding. */
+	msgbuf << "{\"name\":" << JsonEncode(name) << ",\"unit\":" << JsonEncode(otlpUnit)
+		<< ",\"gauge\":{\"dataPoints\":[{\"attributes\":" << attributes
+		<< ",\"timeUnixNano\":\"" << static_cast<uint_fast64_t>(ts * 1e9)
+		<< "\",\"asDouble\":" << JsonEncode(value) << "}]}}";
+
+	String dataPoint = msgbuf.str();
+
+	Log(LogDebug, "OtlpMetricsWriter")
+		<< "Adds to data point list: '" << dataPoint << "'.";
+
+	std::unique_lock<std::mutex> lock(m_DataBufferMutex);
+
+	m_DataBuffer.Add(dataPoint);
+	m_Stats.AddFormatted();
+	m_Stats.MarkBuffered();
+
+	/* Flush if we've buffered too much to prevent excessive memory use. */
+	if (static_cast<int>(m_DataBuffer.GetCount()) >= GetFlushThreshold()) {
+		Log(LogDebug, "OtlpMetricsWriter")
+			<< "Data buffer overflow writing " << m_DataBuffer.GetCount() << " data points";
+		Flush();
+	}
+}
+
+void OtlpMetricsWriter::FlushTimeout()
+{
+	std::unique_lock<std::mutex> lock(m_DataBufferMutex);
+
+	if (m_DataBuffer.GetCount() > 0) {
+		Log(LogDebug, "OtlpMetricsWriter")
+			<< "Timer expired writing " << m_DataBuffer.GetCount() << " data points";
+		Flush();
+	}
+}
+
+/**
+ * Sends the buffered data points as one request.
+ *
+ * m_DataBufferMutex must be locked.
+ */
+void OtlpMetricsWriter::Flush()
+{
+	if (!m_DataBuffer.GetCount())
+		return;
+
+	size_t dataPoints = m_DataBuffer.GetCount();
+	String body = m_DataBuffer.Take();
+
+	m_Stats.MarkUnbuffered();
+
+	SendRequest(body, dataPoints);
+}
+
+void OtlpMetricsWriter::SendRequest(const String& body, size_t dataPoints)
+{
+	namespace beast = boost::beast;
+	namespace http = beast::http;
+
+	http::request<http::string_body> request (http::verb::post, std::string(GetPath()), 11);
+
+	request.set(http::field::user_agent, "Icinga/" + Application::GetAppVersion());
+	request.set(http::field::host, GetHost() + ":" + GetPort());
+	request.set(http::field::accept, "application/json");
+	request.set(http::field::content_type, "application/json");
+
+	if (m_DataBuffer.IsCompressed())
+		request.set(http::field::content_encoding, "gzip");
+
+	String username = GetUsername();
+	String password = GetPassword();
+
+	if (!username.IsEmpty() && !password.IsEmpty())
+		request.set(http::field::authorization, "Basic " + Base64::Encode(username + ":" + password));
+
+	request.body() = body;
+	request.content_length(request.body().size());
+
+	Log(LogDebug, "OtlpMetricsWriter")
+		<< "Sending " << request.method_string() << " request" << ((!username.IsEmpty() && !password.IsEmpty()) ? " with basic auth" : "" )
+		<< " to '" << GetHost() << ":" << GetPort() << GetPath() << "'.";
+
+	http::response<http::string_body> response;
+	double start = Utility::GetTime();
+
+	for (;;) {
+		bool reused = m_Stream.first || m_Stream.second;
+
+		if (reused) {
+			m_ReusedConnections++;
+		} else {
+			try {
+				m_Stream = Connect();
+			} catch (const std::exception& ex) {
+				Log(LogWarning, "OtlpMetricsWriter")
+					<< "Flush failed, cannot connect to OTLP receiver: " << DiagnosticInformation(ex, false);
+				m_Stats.AddError();
+				return;
+			}
+
+			m_Connections++;
+		}
+
+		try {
+			response = PerformRequest(request);
+			break;
+		} catch (const std::exception& ex) {
+			Disconnect();
+
+			/* The receiver or a load balancer may have closed the idle connection meanwhile. */
+			if (reused) {
+				Log(LogNotice, "OtlpMetricsWriter")
+					<< "Kept-alive connection to host '" << GetHost() << "' port '" << GetPort() << "' failed, reconnecting: "
+					<< DiagnosticInformation(ex, false);
+				m_Stats.AddRetry();
+				continue;
+			}
+
+			Log(LogWarning, "OtlpMetricsWriter")
+				<< "HTTP request to host '" << GetHost() << "' port '" << GetPort() << "' failed: " << DiagnosticInformation(ex, false);
+			m_Stats.AddError();
+			throw;
+		}
+	}
+
+	m_Stats.AddFlush(dataPoints, body.GetLength(), Utility::GetTime() - start);
+
+	if (!response.keep_alive())
+		Disconnect();
+
+	if (response.result_int() > 299) {
+		m_Stats.AddError();
+
+		if (response.result() == http::status::unauthorized) {
+			if (!username.IsEmpty() && !password.IsEmpty()) {
+				Log(LogCritical, "OtlpMetricsWriter")
+					<< "401 Unauthorized. Please ensure that the user '" << username
+					<< "' is able to authenticate against the OTLP receiver.";
+			} else {
+				Log(LogCritical, "OtlpMetricsWriter")
+					<< "401 Unauthorized. The OTLP receiver requires authentication but no username/password has been configured.";
+			}
+
+			return;
+		}
+
+		std::ostringstream msgbuf;
+		msgbuf << "Unexpected response code " << response.result_int() << " from '"
+			<< GetHost() << ":" << GetPort() << GetPath() << "'";
+
+#ifdef I2_DEBUG
+		msgbuf << "; Response body: '" << response.body() << "'";
+#endif /* I2_DEBUG */
+
+		Log(LogCritical, "OtlpMetricsWriter")
+			<< msgbuf.str();
+	}
+}
+
+OptionalTlsStream OtlpMetricsWriter::Connect()
+{
+	Log(LogNotice, "OtlpMetricsWriter")
+		<< "Connecting to OTLP receiver on host '" << GetHost() << "' port '" << GetPort() << "'.";
+
+	OptionalTlsStream stream;
+	bool tls = GetEnableTls();
+
+	if (tls) {
+		Shared<boost::asio::ssl::context>::Ptr sslContext;
+
+		try {
+			sslContext = MakeAsioSslContext(GetCertPath(), GetKeyPath(), GetCaPath());
+		} catch (const std::exception&) {
+			Log(LogWarning, "OtlpMetricsWriter")
+				<< "Unable to create SSL context.";
+			throw;
+		}
+
+		stream.first = Shared<AsioTlsStream>::Make(IoEngine::Get().GetIoContext(), *sslContext, GetHost());
+	} else {
+		stream.second = Shared<AsioTcpStream>::Make(IoEngine::Get().GetIoContext());
+	}
+
+	try {
+		icinga::Connect(tls ? stream.first->lowest_layer() : stream.second->lowest_layer(), GetHost(), GetPort());
+	} catch (const std::exception&) {
+		Log(LogWarning, "OtlpMetricsWriter")
+			<< "Can't connect to OTLP receiver on host '" << GetHost() << "' port '" << GetPort() << "'.";
+		throw;
+	}
+
+	if (tls) {
+		auto& tlsStream (stream.first->next_layer());
+
+		try {
+			tlsStream.handshake(tlsStream.client);
+		} catch (const std::exception&) {
+			Log(LogWarning, "OtlpMetricsWriter")
+				<< "TLS handshake with host '" << GetHost() << "' on port " << GetPort() << " failed.";
+			throw;
+		}
+
+		if (!GetInsecureNoverify()) {
+			if (!tlsStream.GetPeerCertificate()) {
+				BOOST_THROW_EXCEPTION(std::runtime_error("OTLP receiver didn't present any TLS certificate."));
+			}
+
+			if (!tlsStream.IsVerifyOK()) {
+				BOOST_THROW_EXCEPTION(std::runtime_error(
+					"TLS certificate validation failed: " + std::string(tlsStream.GetVerifyError())
+				));
+			}
+		}
+	}
+
+	return stream;
+}
+
+void OtlpMetricsWriter::Disconnect()
+{
+	boost::system::error_code ec;
+
+	if (m_Stream.first) {
+		m_Stream.first->next_layer().shutdown(ec);
+		m_Stream.first->lowest_layer().close(ec);
+	} else if (m_Stream.second) {
+		m_Stream.second->lowest_layer().close(ec);
+	}
+
+	m_Stream = OptionalTlsStream();
+}
+
+/**
+ * Sends the request over m_Stream and reads the response.
+ */
+boost::beast::http::response<boost::beast::http::string_body> OtlpMetricsWriter::PerformRequest(
+	boost::beast::http::request<boost::beast::http::string_body>& request)
+{
+	namespace beast = boost::beast;
+	namespace http = beast::http;
+
+	if (m_Stream.first) {
+		http::write(*m_Stream.first, request);
+		m_Stream.first->flush();
+	} else {
+		http::write(*m_Stream.second, request);
+		m_Stream.second->flush();
+	}
+
+	http::parser<false, http::string_body> parser;
+	beast::flat_buffer buf;
+
+	if (m_Stream.first) {
+		http::read(*m_Stream.first, buf, parser);
+	} else {
+		http::read(*m_Stream.second, buf, parser);
+	}
+
+	return parser.release();
+}
+
+void OtlpMetricsWriter::AssertOnWorkQueue()
+{
+	ASSERT(m_WorkQueue.IsWorkerThread());
+}
+
+void OtlpMetricsWriter::ExceptionHandler(boost::exception_ptr exp)
+{
+	Log(LogCritical, "OtlpMetricsWriter", "Exception during OTLP operation: Verify that your backend is operational!");
+
+	Log(LogDebug, "OtlpMetricsWriter")
+		<< "Exception during OTLP operation: " << DiagnosticInformation(std::move(exp));
+}
+
+void OtlpMetricsWriter::ValidateHostAttributes(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<OtlpMetricsWriter>::ValidateHostAttributes(lvalue, utils);
+
+	ObjectLock olock(lvalue());
+	for (const Dictionary::Pair& pair : lvalue()) {
+		if (!MacroProcessor::ValidateMacroString(pair.second))
+			BOOST_THROW_EXCEPTION(ValidationError(this, { "host_attributes", pair.first }, "Closing $ not found in macro format string '" + pair.second));
+	}
+}
+
+void OtlpMetricsWriter::ValidateServiceAttributes(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<OtlpMetricsWriter>::ValidateServiceAttributes(lvalue, utils);
+
+	ObjectLock olock(lvalue());
+	for (const Dictionary::Pair& pair : lvalue()) {
+		if (!MacroProcessor::ValidateMacroString(pair.second))
+			BOOST_THROW_EXCEPTION(ValidationError(this, { "service_attributes", pair.first }, "Closing $ not found in macro format string '" + pair.second));
+	}
+}
+
+void OtlpMetricsWriter::ValidateCompression(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<OtlpMetricsWriter>::ValidateCompression(lvalue, utils);
+
+	if (!lvalue().IsEmpty() && lvalue() != "gzip")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "compression" }, "Value must be empty or 'gzip'."));
+}
@@ -0,0 +1,76 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef OTLPMETRICSWRITER_H
+#define OTLPMETRICSWRITER_H
+
+#include "perfdata/otlpmetricswriter-ti.hpp"
+#include "perfdata/datapointbuffer.hpp"
+#include "perfdata/writerstats.hpp"
+#include "icinga/service.hpp"
+#include "base/configobject.hpp"
+#include "base/workqueue.hpp"
+#include "base/timer.hpp"
+#include "base/tlsstream.hpp"
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <atomic>
+#include <mutex>
+
+namespace icinga
+{
+
+/**
+ * Sends performance data as gauges to an OpenTelemetry collector or any other
+ * OTLP/HTTP receiver, e.g. Prometheus or Mimir, in the OTLP JSON encoding.
+ *
+ * @ingroup perfdata
+ */
+class OtlpMetricsWriter final : public ObjectImpl<OtlpMetricsWriter>
+{
+public:
+	DECLARE_OBJECT(OtlpMetricsWriter);
+	DECLARE_OBJECTNAME(OtlpMetricsWriter);
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+	void ValidateHostAttributes(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils) override;
+	void ValidateServiceAttributes(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils) override;
+	void ValidateCompression(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+
+protected:
+	void OnConfigLoaded() override;
+	void Resume() override;
+	void Pause() override;
+
+private:
+	WorkQueue m_WorkQueue{10000000, 1};
+	SignalConnection m_HandleCheckResults;
+	Timer::Ptr m_FlushTimer;
+	DataPointBuffer m_DataBuffer;
+	std::mutex m_DataBufferMutex;
+	OptionalTlsStream m_Stream; /**< Kept alive across requests, protected by m_DataBufferMutex */
+	std::atomic<uint_fast64_t> m_Connections{0};
+	std::atomic<uint_fast64_t> m_ReusedConnections{0};
+	WriterStats m_Stats;
+
+	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	void CheckResultHandlerWQ(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	void AddGauge(const String& name, const String& unit, const String& attributes, double value, double ts);
+
+	static String FormatAttribute(const String& key, const Value& value);
+	static String GetResourceEnvelope();
+
+	OptionalTlsStream Connect();
+	void Disconnect();
+	boost::beast::http::response<boost::beast::http::string_body> PerformRequest(
+		boost::beast::http::request<boost::beast::http::string_body>& request);
+	void AssertOnWorkQueue();
+	void ExceptionHandler(boost::exception_ptr exp);
+	void FlushTimeout();
+	void Flush();
+	void SendRequest(const String& body, size_t dataPoints);
+};
+
+}
+
+#endif /* OTLPMETRICSWRITER_H */
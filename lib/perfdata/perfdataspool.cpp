@@ -0,0 +1,216 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "perfdata/perfdataspool.hpp"
+#include "base/convert.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace icinga;
+
+/**
+ * @param maxBytes Size limit of all segments
+ * @param replayRate Bytes per second to replay
+ * @param segmentBytes Size after which a new segment is started
+ */
+PerfdataSpool::PerfdataSpool(uint_fast64_t maxBytes, double replayRate, uint_fast64_t segmentBytes)
+	: m_MaxBytes(maxBytes), m_ReplayRate(replayRate), m_SegmentBytes(segmentBytes)
+{
+}
+
+/**
+ * Start spooling to segment files in dir and pick up the ones left over there
+ *
+ * @param dir Directory for the segment files, created if necessary
+ */
+void PerfdataSpool::Open(const String& dir)
+{
+	if (!m_Dir.IsEmpty())
+		return;
+
+	std::vector<uint_fast64_t> ids;
+
+	Utility::MkDirP(dir, 0700);
+	m_Dir = dir;
+
+	Utility::Glob(m_Dir + "/*.seg", [&ids](const String& path) {
+		String name = Utility::BaseName(path);
+
+		try {
+			ids.emplace_back(boost::lexical_cast<uint_fast64_t>(name.SubStr(0, name.GetLength() - 4u)));
+		} catch (const boost::bad_lexical_cast&) {
+			Log(LogWarning, "PerfdataSpool")
+				<< "Ignoring unexpected file '" << path << "' in perfdata spool.";
+		}
+	}, GlobFile);
+
+	std::sort(ids.begin(), ids.end());
+
+	for (auto id : ids) {
+		Segment segment {id, 0, 0};
+		std::ifstream reader (GetSegmentPath(id).CStr(), std::ios::binary);
+		uint32_t length;
+
+		// Only the lengths are read to count the records, the remainder is skipped.
+		while (reader.read((char*)&length, sizeof(length)) && reader.seekg(length, std::ios::cur)) {
+			++segment.Records;
+			segment.Bytes += sizeof(length) + length;
+		}
+
+		m_Segments.emplace_back(segment);
+		m_Records += segment.Records;
+		m_Bytes += segment.Bytes;
+		m_NextSegmentId = id + 1u;
+	}
+
+	if (!m_Segments.empty()) {
+		Log(LogInformation, "PerfdataSpool")
+			<< "Replaying " << m_Records.load() << " records spooled to '" << m_Dir << "' before.";
+	}
+}
+
+/**
+ * Append a record to the newest segment, dropping the oldest segments beyond the size limit
+ *
+ * @param record Request body or metric batch
+ */
+void PerfdataSpool::Append(const String& record)
+{
+	if (!m_Writer.is_open()) {
+		Segment segment {m_NextSegmentId, 0, 0};
+		String path = GetSegmentPath(segment.Id);
+
+		m_Writer.open(path.CStr(), std::ios::binary | std::ios::trunc);
+
+		if (!m_Writer) {
+			m_Writer.close();
+			BOOST_THROW_EXCEPTION(std::runtime_error("Can't open '" + path + "' for writing"));
+		}
+
+		++m_NextSegmentId;
+		m_Segments.emplace_back(segment);
+	}
+
+	auto& segment (m_Segments.back());
+	uint32_t length = record.GetLength();
+	uint_fast64_t bytes = sizeof(length) + length;
+
+	m_Writer.write((const char*)&length, sizeof(length));
+	m_Writer.write(record.CStr(), length);
+	m_Writer.flush();
+
+	if (!m_Writer) {
+		BOOST_THROW_EXCEPTION(std::runtime_error("Can't write to '" + GetSegmentPath(segment.Id) + "'"));
+	}
+
+	++segment.Records;
+	segment.Bytes += bytes;
+	++m_Records;
+	m_Bytes += bytes;
+
+	if (segment.Bytes >= m_SegmentBytes) {
+		m_Writer.close();
+	}
+
+	if (m_Bytes.load() > m_MaxBytes && m_Segments.size() > 1u) {
+		uint_fast64_t records = m_Records.load();
+
+		while (m_Bytes.load() > m_MaxBytes && m_Segments.size() > 1u) {
+			RemoveFront();
+		}
+
+		Log(LogWarning, "PerfdataSpool")
+			<< "Perfdata spool '" << m_Dir << "' is full, dropped the oldest " << (records - m_Records.load()) << " records.";
+	}
+}
+
+/**
+ * Send the oldest records as long as the replay rate allows
+ *
+ * Exceptions thrown by send stop the replay, the failed record is sent again next time.
+ *
+ * @param send Sends one record
+ */
+void PerfdataSpool::Replay(const std::function<void(const String&)>& send)
+{
+	double now = Utility::GetTime();
+
+	// Allows bursts of up to one second's worth.
+	m_ReplayBudget = std::min(m_ReplayRate, m_ReplayBudget + (now - m_LastReplay) * m_ReplayRate);
+	m_LastReplay = now;
+
+	while (m_ReplayBudget > 0 && !m_Segments.empty()) {
+		auto& segment (m_Segments.front());
+
+		if (m_Segments.size() == 1u) {
+			m_Writer.close();
+		}
+
+		if (!m_Reader.is_open()) {
+			m_Reader.open(GetSegmentPath(segment.Id).CStr(), std::ios::binary);
+		}
+
+		auto pos (m_Reader.tellg());
+		uint32_t length;
+
+		if (!m_Reader.read((char*)&length, sizeof(length))) {
+			RemoveFront();
+			continue;
+		}
+
+		std::string record (length, '\0');
+
+		if (length && !m_Reader.read(&record[0], length)) {
+			Log(LogWarning, "PerfdataSpool")
+				<< "Discarding truncated record at the end of '" << GetSegmentPath(segment.Id) << "'.";
+
+			RemoveFront();
+			continue;
+		}
+
+		try {
+			send(record);
+		} catch (...) {
+			m_Reader.seekg(pos);
+			throw;
+		}
+
+		uint_fast64_t bytes = sizeof(length) + length;
+
+		--segment.Records;
+		segment.Bytes -= bytes;
+		--m_Records;
+		m_Bytes -= bytes;
+		m_ReplayBudget -= bytes;
+	}
+}
+
+/**
+ * Delete the oldest segment, no matter whether it was replayed completely
+ */
+void PerfdataSpool::RemoveFront()
+{
+	auto& segment (m_Segments.front());
+
+	m_Reader.close();
+
+	if (m_Segments.size() == 1u) {
+		m_Writer.close();
+	}
+
+	Utility::Remove(GetSegmentPath(segment.Id));
+
+	m_Records -= segment.Records;
+	m_Bytes -= segment.Bytes;
+
+	m_Segments.pop_front();
+}
+
+String PerfdataSpool::GetSegmentPath(uint_fast64_t id) const
+{
+	return m_Dir + "/" + Convert::ToString(id) + ".seg";
+}
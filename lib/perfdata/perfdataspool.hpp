@@ -0,0 +1,78 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef PERFDATASPOOL_H
+#define PERFDATASPOOL_H
+
+#include "base/string.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+
+namespace icinga
+{
+
+/**
+ * Segment files on disk for the requests (or metric batches) a perfdata writer couldn't send
+ * while its backend was unreachable. The oldest segments are dropped once the spool exceeds
+ * its size limit, so that neither the disk nor the writer's memory fill up.
+ *
+ * Records are replayed oldest first, rate-limited, and only removed once they were sent.
+ * Segments left over on disk are replayed after the next start.
+ *
+ * Not thread-safe, to be used by a single work queue. Only the counters may be read concurrently.
+ *
+ * @ingroup perfdata
+ */
+class PerfdataSpool
+{
+public:
+	PerfdataSpool(uint_fast64_t maxBytes, double replayRate, uint_fast64_t segmentBytes = 1024 * 1024);
+
+	void Open(const String& dir);
+	void Append(const String& record);
+	void Replay(const std::function<void(const String&)>& send);
+
+	inline uint_fast64_t GetRecords() const noexcept
+	{
+		return m_Records.load();
+	}
+
+	inline uint_fast64_t GetBytes() const noexcept
+	{
+		return m_Bytes.load();
+	}
+
+private:
+	struct Segment
+	{
+		uint_fast64_t Id;
+		uint_fast64_t Records;
+		uint_fast64_t Bytes;
+	};
+
+	String GetSegmentPath(uint_fast64_t id) const;
+	void RemoveFront();
+
+	const uint_fast64_t m_MaxBytes;
+	const double m_ReplayRate;
+	const uint_fast64_t m_SegmentBytes;
+
+	String m_Dir;
+	// Oldest first, the last one is the one m_Writer appends to (if open), the first one the one m_Reader reads
+	std::deque<Segment> m_Segments;
+	std::ofstream m_Writer;
+	std::ifstream m_Reader;
+	uint_fast64_t m_NextSegmentId = 0;
+
+	double m_ReplayBudget = 0;
+	double m_LastReplay = 0;
+
+	std::atomic<uint_fast64_t> m_Records {0};
+	std::atomic<uint_fast64_t> m_Bytes {0};
+};
+
+}
+
+#endif /* PERFDATASPOOL_H */
@@ -14,6 +14,7 @@
 #include "base/exception.hpp"
 #include "base/application.hpp"
 #include "base/statsfunction.hpp"
+#include <utility>
 
 using namespace icinga;
 
@@ -21,10 +22,15 @@ REGISTER_TYPE(PerfdataWriter);
 
 REGISTER_STATSFUNCTION(PerfdataWriter, &PerfdataWriter::StatsFunc);
 
+/* Buffered lines of a file type beyond which they're written before the next rotation. */
+static const size_t l_WriteThreshold = 1024 * 1024;
+
 void PerfdataWriter::OnConfigLoaded()
 {
 	ObjectImpl<PerfdataWriter>::OnConfigLoaded();
 
+	m_WorkQueue.SetName("PerfdataWriter, " + GetName());
+
 	if (!GetEnableHa()) {
 		Log(LogDebug, "PerfdataWriter")
 			<< "HA functionality disabled. Won't pause connection: " << GetName();
@@ -40,7 +46,9 @@ void PerfdataWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
 	DictionaryData nodes;
 
 	for (const PerfdataWriter::Ptr& perfdatawriter : ConfigType::GetObjectsByType<PerfdataWriter>()) {
-		nodes.emplace_back(perfdatawriter->GetName(), 1); //add more stats
+		nodes.emplace_back(perfdatawriter->GetName(), new Dictionary({
+			{ "work_queue_items", perfdatawriter->m_WorkQueue.GetLength() }
+		}));
 	}
 
 	status->Set("perfdatawriter", new Dictionary(std::move(nodes)));
@@ -53,7 +61,14 @@ void PerfdataWriter::Resume()
 	Log(LogInformation, "PerfdataWriter")
 		<< "'" << GetName() << "' resumed.";
 
-	m_HandleCheckResults = Checkable::OnNewCheckResult.connect([this](const Checkable::Ptr& checkable,
+	m_WorkQueue.SetExceptionCallback([this](boost::exception_ptr exp) { ExceptionHandler(std::move(exp)); });
+
+	m_WorkQueue.Enqueue([this]() {
+		RotateFile(m_ServiceOutputFile, GetServiceTempPath(), GetServicePerfdataPath());
+		RotateFile(m_HostOutputFile, GetHostTempPath(), GetHostPerfdataPath());
+	}, PriorityImmediate);
+
+	m_HandleCheckResults = Checkable::OnNewCheckResult.connect(GetReflectionType()->GetName().GetData(), [this](const Checkable::Ptr& checkable,
 		const CheckResult::Ptr& cr, const MessageOrigin::Ptr&) {
 		CheckResultHandler(checkable, cr);
 	});
@@ -62,9 +77,6 @@ void PerfdataWriter::Resume()
 	m_RotationTimer->OnTimerExpired.connect([this](const Timer * const&) { RotationTimerHandler(); });
 	m_RotationTimer->SetInterval(GetRotationInterval());
 	m_RotationTimer->Start();
-
-	RotateFile(m_ServiceOutputFile, GetServiceTempPath(), GetServicePerfdataPath());
-	RotateFile(m_HostOutputFile, GetHostTempPath(), GetHostPerfdataPath());
 }
 
 void PerfdataWriter::Pause()
@@ -78,7 +90,8 @@ void PerfdataWriter::Pause()
 #endif /* I2_DEBUG */
 
 	/* Force a rotation closing the file stream. */
-	RotateAllFiles();
+	m_WorkQueue.Enqueue([this]() { RotateAllFiles(); }, PriorityLow);
+	m_WorkQueue.Join();
 
 	Log(LogInformation, "PerfdataWriter")
 		<< "'" << GetName() << "' paused.";
@@ -117,38 +130,80 @@ void PerfdataWriter::CheckResultHandler(const Checkable::Ptr& checkable, const C
 		resolvers.emplace_back("service", service);
 	resolvers.emplace_back("host", host);
 
-	if (service) {
-		String line = MacroProcessor::ResolveMacros(GetServiceFormatTemplate(), resolvers, cr, nullptr, &PerfdataWriter::EscapeMacroMetric);
+	String line = MacroProcessor::ResolveMacros(service ? GetServiceFormatTemplate() : GetHostFormatTemplate(),
+		resolvers, cr, nullptr, &PerfdataWriter::EscapeMacroMetric);
 
-		{
-			std::unique_lock<std::mutex> lock(m_StreamMutex);
+	bool write = false;
 
-			if (!m_ServiceOutputFile.good())
-				return;
+	{
+		std::unique_lock<std::mutex> lock(m_BufferMutex);
+		std::string& buffer (service ? m_ServiceBuffer : m_HostBuffer);
 
-			m_ServiceOutputFile << line << "\n";
+		buffer.append(line.GetData());
+		buffer.push_back('\n');
+
+		if (buffer.size() >= l_WriteThreshold && !m_WritePending) {
+			m_WritePending = true;
+			write = true;
 		}
-	} else {
-		String line = MacroProcessor::ResolveMacros(GetHostFormatTemplate(), resolvers, cr, nullptr, &PerfdataWriter::EscapeMacroMetric);
+	}
 
-		{
-			std::unique_lock<std::mutex> lock(m_StreamMutex);
+	/* The files are written and rotated on the work queue, not while check results wait for them. */
+	if (write)
+		m_WorkQueue.Enqueue([this]() { WriteBuffers(); });
+}
 
-			if (!m_HostOutputFile.good())
-				return;
+void PerfdataWriter::AssertOnWorkQueue()
+{
+	ASSERT(m_WorkQueue.IsWorkerThread());
+}
 
-			m_HostOutputFile << line << "\n";
-		}
+void PerfdataWriter::ExceptionHandler(boost::exception_ptr exp)
+{
+	Log(LogCritical, "PerfdataWriter")
+		<< "Exception while writing perfdata files: " << DiagnosticInformation(exp, false);
+
+	Log(LogDebug, "PerfdataWriter")
+		<< "Exception while writing perfdata files: " << DiagnosticInformation(exp, true);
+}
+
+/**
+ * Swaps the buffers the check result handlers append to with the (empty) write buffers
+ * and writes the lines to the files.
+ *
+ * Called inside the WQ.
+ */
+void PerfdataWriter::WriteBuffers()
+{
+	AssertOnWorkQueue();
+
+	{
+		std::unique_lock<std::mutex> lock(m_BufferMutex);
+
+		m_ServiceBuffer.swap(m_ServiceWriteBuffer);
+		m_HostBuffer.swap(m_HostWriteBuffer);
+		m_WritePending = false;
 	}
+
+	/* The lines are lost if the file couldn't be opened, like before buffering. */
+	if (!m_ServiceWriteBuffer.empty() && m_ServiceOutputFile.good())
+		m_ServiceOutputFile.write(m_ServiceWriteBuffer.data(), m_ServiceWriteBuffer.size());
+
+	if (!m_HostWriteBuffer.empty() && m_HostOutputFile.good())
+		m_HostOutputFile.write(m_HostWriteBuffer.data(), m_HostWriteBuffer.size());
+
+	/* Keeps their capacity for the next swap. */
+	m_ServiceWriteBuffer.clear();
+	m_HostWriteBuffer.clear();
 }
 
 void PerfdataWriter::RotateFile(std::ofstream& output, const String& temp_path, const String& perfdata_path)
 {
+	AssertOnWorkQueue();
+
 	Log(LogDebug, "PerfdataWriter")
 		<< "Rotating perfdata files.";
 
-	std::unique_lock<std::mutex> lock(m_StreamMutex);
-
 	if (output.good()) {
 		output.close();
 
@@ -175,11 +230,16 @@ void PerfdataWriter::RotationTimerHandler()
 	if (IsPaused())
 		return;
 
-	RotateAllFiles();
+	m_WorkQueue.Enqueue([this]() { RotateAllFiles(); });
 }
 
+/**
+ * Called inside the WQ.
+ */
 void PerfdataWriter::RotateAllFiles()
 {
+	WriteBuffers();
+
 	RotateFile(m_ServiceOutputFile, GetServiceTempPath(), GetServicePerfdataPath());
 	RotateFile(m_HostOutputFile, GetHostTempPath(), GetHostPerfdataPath());
 }
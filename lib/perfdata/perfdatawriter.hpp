@@ -7,7 +7,10 @@
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
+#include "base/workqueue.hpp"
 #include <fstream>
+#include <mutex>
+#include <string>
 
 namespace icinga
 {
@@ -34,18 +37,31 @@ protected:
 	void Pause() override;
 
 private:
-	boost::signals2::connection m_HandleCheckResults;
+	SignalConnection m_HandleCheckResults;
 	Timer::Ptr m_RotationTimer;
+	WorkQueue m_WorkQueue{10000000, 1};
+
+	/* The files and the buffers being written to them are only accessed on m_WorkQueue. */
 	std::ofstream m_ServiceOutputFile;
 	std::ofstream m_HostOutputFile;
-	std::mutex m_StreamMutex;
+	std::string m_ServiceWriteBuffer;
+	std::string m_HostWriteBuffer;
+
+	/* The check result handlers only append to these. */
+	std::mutex m_BufferMutex;
+	std::string m_ServiceBuffer;
+	std::string m_HostBuffer;
+	bool m_WritePending{false};
 
 	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 	static Value EscapeMacroMetric(const Value& value);
 
 	void RotationTimerHandler();
+	void WriteBuffers();
 	void RotateAllFiles();
 	void RotateFile(std::ofstream& output, const String& temp_path, const String& perfdata_path);
+	void AssertOnWorkQueue();
+	void ExceptionHandler(boost::exception_ptr exp);
 };
 
 }
@@ -0,0 +1,133 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "perfdata/templatecache.hpp"
+#include "icinga/customvarobject.hpp"
+#include "icinga/host.hpp"
+#include "icinga/service.hpp"
+#include "base/array.hpp"
+#include "base/dictionary.hpp"
+#include "base/initialize.hpp"
+#include "base/objectlock.hpp"
+
+using namespace icinga;
+
+std::atomic<uint_fast64_t> TemplateCache::m_CurrentEpoch (1);
+
+INITIALIZE_ONCE([]() {
+	CustomVarObject::OnVarsChanged.connect([](const CustomVarObject::Ptr&, const Value&) { TemplateCache::Invalidate(); });
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr&, const Value&) { TemplateCache::Invalidate(); });
+	Host::OnDisplayNameChanged.connect([](const Host::Ptr&, const Value&) { TemplateCache::Invalidate(); });
+	Service::OnDisplayNameChanged.connect([](const Service::Ptr&, const Value&) { TemplateCache::Invalidate(); });
+	Checkable::OnCheckCommandRawChanged.connect([](const Checkable::Ptr&, const Value&) { TemplateCache::Invalidate(); });
+});
+
+/**
+ * Whether all macros in the template (a string or a dictionary/array of them) are of the cacheable kind.
+ */
+bool TemplateCache::IsCacheable(const Value& tmpl)
+{
+	if (tmpl.IsObjectType<Dictionary>()) {
+		Dictionary::Ptr dict = tmpl;
+		ObjectLock olock (dict);
+
+		for (auto& kv : dict) {
+			if (!IsCacheable(kv.second))
+				return false;
+		}
+
+		return true;
+	}
+
+	if (tmpl.IsObjectType<Array>()) {
+		Array::Ptr arr = tmpl;
+		ObjectLock olock (arr);
+
+		for (auto& item : arr) {
+			if (!IsCacheable(item))
+				return false;
+		}
+
+		return true;
+	}
+
+	if (tmpl.IsObject())
+		return false;
+
+	if (!tmpl.IsString())
+		return true;
+
+	String str = tmpl;
+	size_t offset = 0;
+
+	for (;;) {
+		size_t start = str.FindFirstOf("$", offset);
+
+		if (start == String::NPos)
+			return true;
+
+		size_t end = str.FindFirstOf("$", start + 1);
+
+		if (end == String::NPos)
+			return false;
+
+		/* $$ is an escaped $ */
+		if (end > start + 1 && !IsCacheableMacro(str.SubStr(start + 1, end - start - 1)))
+			return false;
+
+		offset = end + 1;
+	}
+}
+
+bool TemplateCache::IsCacheableMacro(const String& macro)
+{
+	String attr;
+
+	if (macro.Find("host.") == 0)
+		attr = macro.SubStr(5);
+	else if (macro.Find("service.") == 0)
+		attr = macro.SubStr(8);
+	else
+		return false;
+
+	return attr == "name" || attr == "display_name" || attr == "check_command" || attr.Find("vars.") == 0;
+}
+
+void TemplateCache::Invalidate()
+{
+	m_CurrentEpoch.fetch_add(1);
+}
+
+/**
+ * @param resolve Resolves the template, called if there's no valid cached result
+ *
+ * @return The (possibly cached) result of resolve, which must not be modified
+ */
+Value TemplateCache::Get(const Checkable::Ptr& checkable, const std::function<Value ()>& resolve)
+{
+	uint_fast64_t epoch = m_CurrentEpoch.load();
+	String name = checkable->GetName();
+
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+
+		if (m_Epoch != epoch) {
+			m_Entries.clear();
+			m_Epoch = epoch;
+		} else {
+			auto entry (m_Entries.find(checkable.get()));
+
+			if (entry != m_Entries.end() && entry->second.Name == name)
+				return entry->second.Result;
+		}
+	}
+
+	Value result = resolve();
+
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	// Something may have changed while resolving.
+	if (m_Epoch == epoch && m_CurrentEpoch.load() == epoch)
+		m_Entries[checkable.get()] = Entry{name, result};
+
+	return result;
+}
@@ -0,0 +1,52 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef TEMPLATECACHE_H
+#define TEMPLATECACHE_H
+
+#include "icinga/checkable.hpp"
+#include "base/value.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+namespace icinga
+{
+
+/**
+ * The resolved (and escaped) metric name/tag templates of a writer per checkable.
+ *
+ * Only templates whose macros don't change with check results qualify, i.e. the names,
+ * display names, check commands and custom variables of hosts and services. The cache is
+ * invalidated whenever one of these changes anywhere or any object is (de)activated.
+ *
+ * @ingroup perfdata
+ */
+class TemplateCache final
+{
+public:
+	static bool IsCacheable(const Value& tmpl);
+	static void Invalidate();
+
+	Value Get(const Checkable::Ptr& checkable, const std::function<Value ()>& resolve);
+
+private:
+	struct Entry
+	{
+		String Name; /**< Tells a new checkable at the same address apart */
+		Value Result;
+	};
+
+	std::mutex m_Mutex;
+	std::unordered_map<const Checkable*, Entry> m_Entries;
+	uint_fast64_t m_Epoch{0};
+
+	static std::atomic<uint_fast64_t> m_CurrentEpoch;
+
+	static bool IsCacheableMacro(const String& macro);
+};
+
+}
+
+#endif /* TEMPLATECACHE_H */
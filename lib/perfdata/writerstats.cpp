@@ -0,0 +1,137 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "perfdata/writerstats.hpp"
+#include "base/convert.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/utility.hpp"
+#include <utility>
+
+using namespace icinga;
+
+const std::array<double, 8> WriterStats::m_BucketBounds {{ 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10 }};
+
+WriterStats::WriterStats()
+	: m_Formatted(60), m_BytesSent(60)
+{
+	for (auto& bucket : m_Buckets)
+		bucket.store(0);
+}
+
+/**
+ * Counts metrics (or events) formatted to be sent.
+ */
+void WriterStats::AddFormatted(int metrics)
+{
+	m_Formatted.InsertValue(Utility::GetTime(), metrics);
+}
+
+/**
+ * Something has been added to the buffer, starts the age if it was empty.
+ */
+void WriterStats::MarkBuffered()
+{
+	double expected = 0;
+
+	m_OldestBuffered.compare_exchange_strong(expected, Utility::GetTime());
+}
+
+/**
+ * The buffer has been taken for sending.
+ */
+void WriterStats::MarkUnbuffered()
+{
+	m_OldestBuffered.store(0);
+}
+
+/**
+ * Records a successful flush (request or write).
+ *
+ * @param metrics Metrics (or events) sent
+ * @param bytes Bytes sent (as is, i.e. compressed)
+ * @param duration Seconds the flush took
+ */
+void WriterStats::AddFlush(size_t metrics, size_t bytes, double duration)
+{
+	m_BytesSent.InsertValue(Utility::GetTime(), bytes);
+
+	m_Flushes++;
+	m_FlushedMetrics += metrics;
+	m_LastFlushDuration.store(duration);
+
+	size_t bucket = 0;
+
+	while (bucket < m_BucketBounds.size() && duration > m_BucketBounds[bucket])
+		bucket++;
+
+	m_Buckets[bucket]++;
+}
+
+/**
+ * Counts a failed flush, with the data lost or spooled.
+ */
+void WriterStats::AddError()
+{
+	m_Errors++;
+}
+
+/**
+ * Counts a flush retried, e.g. after a kept-alive connection was closed.
+ */
+void WriterStats::AddRetry()
+{
+	m_Retries++;
+}
+
+/**
+ * Adds the counters to a writer's stats and perfdata.
+ *
+ * @param stats The writer's entry in the StatsFunc status
+ * @param perfdata The StatsFunc perfdata
+ * @param perfdataPrefix e.g. "graphitewriter_" + name
+ */
+void WriterStats::Report(const Dictionary::Ptr& stats, const Array::Ptr& perfdata, const String& perfdataPrefix)
+{
+	double now = Utility::GetTime();
+	double formattedRate = m_Formatted.UpdateAndGetValues(now, 60) / 60.0;
+	double bytesSentRate = m_BytesSent.UpdateAndGetValues(now, 60) / 60.0;
+	double flushes = m_Flushes.load();
+	double flushBatchSize = flushes ? m_FlushedMetrics.load() / flushes : 0;
+	double errors = m_Errors.load();
+	double retries = m_Retries.load();
+	double lastFlushDuration = m_LastFlushDuration.load();
+	double oldestBuffered = m_OldestBuffered.load();
+	double oldestBufferedAge = oldestBuffered ? now - oldestBuffered : 0;
+
+	stats->Set("metrics_formatted_rate", formattedRate);
+	stats->Set("bytes_sent_rate", bytesSentRate);
+	stats->Set("flushes", flushes);
+	stats->Set("flush_batch_size_avg", flushBatchSize);
+	stats->Set("last_flush_duration", lastFlushDuration);
+	stats->Set("errors", errors);
+	stats->Set("retries", retries);
+	stats->Set("oldest_buffered_age", oldestBufferedAge);
+
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_metrics_formatted_rate", formattedRate));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_bytes_sent_rate", bytesSentRate));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_flushes", flushes, true));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_flush_batch_size_avg", flushBatchSize));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_last_flush_duration", lastFlushDuration));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_errors", errors, true));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_retries", retries, true));
+	perfdata->Add(new PerfdataValue(perfdataPrefix + "_oldest_buffered_age", oldestBufferedAge));
+
+	/* Cumulative like Prometheus histograms, "le" = less than or equal. */
+	DictionaryData buckets;
+	double count = 0;
+
+	for (size_t i = 0; i < m_Buckets.size(); i++) {
+		count += m_Buckets[i].load();
+
+		String bound = i < m_BucketBounds.size() ? Convert::ToString(m_BucketBounds[i]) : "inf";
+
+		buckets.emplace_back("le_" + bound, count);
+		perfdata->Add(new PerfdataValue(perfdataPrefix + "_flush_duration_le_" + bound, count, true));
+	}
+
+	stats->Set("flush_duration_buckets", new Dictionary(std::move(buckets)));
+}
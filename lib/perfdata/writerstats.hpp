@@ -0,0 +1,56 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef WRITERSTATS_H
+#define WRITERSTATS_H
+
+#include "base/array.hpp"
+#include "base/dictionary.hpp"
+#include "base/ringbuffer.hpp"
+#include "base/string.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace icinga
+{
+
+/**
+ * Throughput and latency counters of a perfdata writer, for its StatsFunc.
+ *
+ * All methods may be called concurrently, e.g. by multiple workers of a writer.
+ *
+ * @ingroup perfdata
+ */
+class WriterStats final
+{
+public:
+	WriterStats();
+
+	void AddFormatted(int metrics = 1);
+	void MarkBuffered();
+	void MarkUnbuffered();
+	void AddFlush(size_t metrics, size_t bytes, double duration);
+	void AddError();
+	void AddRetry();
+
+	void Report(const Dictionary::Ptr& stats, const Array::Ptr& perfdata, const String& perfdataPrefix);
+
+private:
+	/* Upper bounds (seconds) of the flush duration histogram buckets, without the +Inf one. */
+	static const std::array<double, 8> m_BucketBounds;
+
+	RingBuffer m_Formatted;
+	RingBuffer m_BytesSent;
+	std::atomic<uint_fast64_t> m_Flushes{0};
+	std::atomic<uint_fast64_t> m_FlushedMetrics{0};
+	std::atomic<uint_fast64_t> m_Errors{0};
+	std::atomic<uint_fast64_t> m_Retries{0};
+	std::atomic<double> m_LastFlushDuration{0};
+	std::atomic<double> m_OldestBuffered{0}; /**< 0 if nothing is buffered */
+	std::array<std::atomic<uint_fast64_t>, 9> m_Buckets;
+};
+
+}
+
+#endif /* WRITERSTATS_H */
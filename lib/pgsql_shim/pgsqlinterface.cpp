@@ -26,6 +26,16 @@ struct PgsqlInterfaceImpl final : public PgsqlInterface
 		return PQerrorMessage(conn);
 	}
 
+	int enterPipelineMode(PGconn *conn) const override
+	{
+#ifdef LIBPQ_HAS_PIPELINING
+		return PQenterPipelineMode(conn);
+#else /* LIBPQ_HAS_PIPELINING */
+		(void)conn;
+		return 0;
+#endif /* LIBPQ_HAS_PIPELINING */
+	}
+
 	size_t escapeStringConn(PGconn *conn, char *to, const char *from, size_t length, int *error) const override
 	{
 		return PQescapeStringConn(conn, to, from, length, error);
@@ -36,11 +46,38 @@ struct PgsqlInterfaceImpl final : public PgsqlInterface
 		return PQexec(conn, query);
 	}
 
+	PGresult *execParams(PGconn *conn, const char *command, int nParams, const Oid *paramTypes,
+		const char * const *paramValues, const int *paramLengths, const int *paramFormats, int resultFormat) const override
+	{
+		return PQexecParams(conn, command, nParams, paramTypes, paramValues, paramLengths, paramFormats, resultFormat);
+	}
+
+	PGresult *execPrepared(PGconn *conn, const char *stmtName, int nParams, const char * const *paramValues,
+		const int *paramLengths, const int *paramFormats, int resultFormat) const override
+	{
+		return PQexecPrepared(conn, stmtName, nParams, paramValues, paramLengths, paramFormats, resultFormat);
+	}
+
+	int exitPipelineMode(PGconn *conn) const override
+	{
+#ifdef LIBPQ_HAS_PIPELINING
+		return PQexitPipelineMode(conn);
+#else /* LIBPQ_HAS_PIPELINING */
+		(void)conn;
+		return 0;
+#endif /* LIBPQ_HAS_PIPELINING */
+	}
+
 	void finish(PGconn *conn) const override
 	{
 		PQfinish(conn);
 	}
 
+	int flush(PGconn *conn) const override
+	{
+		return PQflush(conn);
+	}
+
 	char *fname(const PGresult *res, int field_num) const override
 	{
 		return PQfname(res, field_num);
@@ -51,6 +88,11 @@ struct PgsqlInterfaceImpl final : public PgsqlInterface
 		return PQgetisnull(res, tup_num, field_num);
 	}
 
+	PGresult *getResult(PGconn *conn) const override
+	{
+		return PQgetResult(conn);
+	}
+
 	char *getvalue(const PGresult *res, int tup_num, int field_num) const override
 	{
 		return PQgetvalue(res, tup_num, field_num);
@@ -71,6 +113,21 @@ struct PgsqlInterfaceImpl final : public PgsqlInterface
 		return PQntuples(res);
 	}
 
+	int pipelineSync(PGconn *conn) const override
+	{
+#ifdef LIBPQ_HAS_PIPELINING
+		return PQpipelineSync(conn);
+#else /* LIBPQ_HAS_PIPELINING */
+		(void)conn;
+		return 0;
+#endif /* LIBPQ_HAS_PIPELINING */
+	}
+
+	PGresult *prepare(PGconn *conn, const char *stmtName, const char *query, int nParams, const Oid *paramTypes) const override
+	{
+		return PQprepare(conn, stmtName, query, nParams, paramTypes);
+	}
+
 	char *resultErrorMessage(const PGresult *res) const override
 	{
 		return PQresultErrorMessage(res);
@@ -81,6 +138,23 @@ struct PgsqlInterfaceImpl final : public PgsqlInterface
 		return PQresultStatus(res);
 	}
 
+	int sendPrepare(PGconn *conn, const char *stmtName, const char *query, int nParams, const Oid *paramTypes) const override
+	{
+		return PQsendPrepare(conn, stmtName, query, nParams, paramTypes);
+	}
+
+	int sendQueryParams(PGconn *conn, const char *command, int nParams, const Oid *paramTypes,
+		const char * const *paramValues, const int *paramLengths, const int *paramFormats, int resultFormat) const override
+	{
+		return PQsendQueryParams(conn, command, nParams, paramTypes, paramValues, paramLengths, paramFormats, resultFormat);
+	}
+
+	int sendQueryPrepared(PGconn *conn, const char *stmtName, int nParams, const char * const *paramValues,
+		const int *paramLengths, const int *paramFormats, int resultFormat) const override
+	{
+		return PQsendQueryPrepared(conn, stmtName, nParams, paramValues, paramLengths, paramFormats, resultFormat);
+	}
+
 	int serverVersion(const PGconn *conn) const override
 	{
 		return PQserverVersion(conn);
@@ -4,9 +4,16 @@
 #include "remote/httputility.hpp"
 #include "remote/filterutility.hpp"
 #include "remote/apiaction.hpp"
+#include "remote/relaybatch.hpp"
+#include "base/configuration.hpp"
 #include "base/defer.hpp"
 #include "base/exception.hpp"
+#include "base/io-engine.hpp"
 #include "base/logger.hpp"
+#include "base/objectlock.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <set>
 
 using namespace icinga;
@@ -15,32 +22,26 @@ thread_local ApiUser::Ptr ActionsHandler::AuthenticatedApiUser;
 
 REGISTER_URLHANDLER("/v1/actions", ActionsHandler);
 
-bool ActionsHandler::HandleRequest(
-	AsioTlsStream& stream,
-	const ApiUser::Ptr& user,
-	boost::beast::http::request<boost::beast::http::string_body>& request,
-	const Url::Ptr& url,
-	boost::beast::http::response<boost::beast::http::string_body>& response,
-	const Dictionary::Ptr& params,
-	boost::asio::yield_context& yc,
-	HttpServerConnection& server
-)
+/**
+ * Runs an action on each of the objects it's supposed to be run on.
+ *
+ * @param actionName The name of the action.
+ * @param params The action's parameters including the object filter.
+ * @param user The authenticated API user.
+ * @param verbose Whether to add diagnostic information to failures.
+ * @param results The results per object.
+ * @param error An error message if the action couldn't be run at all.
+ * @param diagnosticInformation Details on the error.
+ * @returns The response status code.
+ */
+int ActionsHandler::RunAction(const String& actionName, const Dictionary::Ptr& params, const ApiUser::Ptr& user,
+	bool verbose, ArrayData& results, String& error, String& diagnosticInformation)
 {
-	namespace http = boost::beast::http;
-
-	if (url->GetPath().size() != 3)
-		return false;
-
-	if (request.method() != http::verb::post)
-		return false;
-
-	String actionName = url->GetPath()[2];
-
 	ApiAction::Ptr action = ApiAction::GetByName(actionName);
 
 	if (!action) {
-		HttpUtility::SendJsonError(response, params, 404, "Action '" + actionName + "' does not exist.");
-		return true;
+		error = "Action '" + actionName + "' does not exist.";
+		return 404;
 	}
 
 	QueryDescription qd;
@@ -57,36 +58,30 @@ bool ActionsHandler::HandleRequest(
 		try {
 			objs = FilterUtility::GetFilterTargets(qd, params, user);
 		} catch (const std::exception& ex) {
-			HttpUtility::SendJsonError(response, params, 404,
-				"No objects found.",
-				DiagnosticInformation(ex));
-			return true;
+			error = "No objects found.";
+			diagnosticInformation = DiagnosticInformation(ex);
+			return 404;
 		}
 
 		if (objs.empty()) {
-			HttpUtility::SendJsonError(response, params, 404,
-				"No objects found.");
-			return true;
+			error = "No objects found.";
+			return 404;
 		}
 	} else {
 		FilterUtility::CheckPermission(user, permission);
 		objs.emplace_back(nullptr);
 	}
 
-	ArrayData results;
-
 	Log(LogNotice, "ApiActionHandler")
 		<< "Running action " << actionName;
 
-	bool verbose = false;
-
 	ActionsHandler::AuthenticatedApiUser = user;
 	Defer a ([]() {
 		ActionsHandler::AuthenticatedApiUser = nullptr;
 	});
 
-	if (params)
-		verbose = HttpUtility::GetLastParameter(params, "verbose");
+	/* E.g. acknowledging thousands of problems results in a few cluster messages only. */
+	RelayBatch batch;
 
 	for (const ConfigObject::Ptr& obj : objs) {
 		try {
@@ -105,6 +100,14 @@ bool ActionsHandler::HandleRequest(
 		}
 	}
 
+	return GetStatusCode(results);
+}
+
+/**
+ * Returns the common status code of several results, 500 if they differ.
+ */
+int ActionsHandler::GetStatusCode(const ArrayData& results)
+{
 	int statusCode = 500;
 	std::set<int> okStatusCodes, nonOkStatusCodes;
 
@@ -133,6 +136,169 @@ bool ActionsHandler::HandleRequest(
 		statusCode = 200;
 	}
 
+	return statusCode;
+}
+
+/**
+ * Runs one action of a bulk request.
+ */
+Dictionary::Ptr ActionsHandler::RunBulkAction(const Value& item, const ApiUser::Ptr& user, bool verbose)
+{
+	if (!item.IsObjectType<Dictionary>()) {
+		return new Dictionary({
+			{ "code", 400 },
+			{ "status", "Actions must be dictionaries." }
+		});
+	}
+
+	Dictionary::Ptr params = item;
+	String actionName = params->Get("action");
+
+	ArrayData results;
+	String error, diagnosticInformation;
+	int statusCode;
+
+	/* Don't tell missing permissions from missing objects, see HttpHandler::ProcessRequest(). */
+	try {
+		statusCode = RunAction(actionName, params, user, verbose, results, error, diagnosticInformation);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ApiActionHandler")
+			<< "Error while running action " << actionName << ": " << ex.what();
+
+		statusCode = 404;
+		error = "Action '" + actionName + "' does not exist or no objects found.";
+	}
+
+	Dictionary::Ptr result = new Dictionary({
+		{ "action", actionName },
+		{ "code", statusCode }
+	});
+
+	if (error.IsEmpty()) {
+		result->Set("results", new Array(std::move(results)));
+	} else {
+		result->Set("status", error);
+
+		if (verbose && !diagnosticInformation.IsEmpty())
+			result->Set("diagnostic_information", diagnosticInformation);
+	}
+
+	return result;
+}
+
+/**
+ * Runs the actions of a bulk request, each action by one of up to
+ * Configuration::Concurrency coroutines. The calling coroutine runs
+ * actions as well and waits for the others, but not for the ones which
+ * haven't got a CPU slot before all actions have been started.
+ */
+ArrayData ActionsHandler::RunBulkActions(const Array::Ptr& actions, const ApiUser::Ptr& user, bool verbose,
+	boost::asio::yield_context& yc)
+{
+	struct BulkState
+	{
+		std::vector<Value> Actions;
+		std::vector<Value> Results;
+		std::atomic<size_t> Next { 0 };
+		std::atomic<size_t> Running { 0 };
+	};
+
+	auto state (std::make_shared<BulkState>());
+
+	{
+		ObjectLock olock(actions);
+		state->Actions.assign(actions->Begin(), actions->End());
+	}
+
+	state->Results.resize(state->Actions.size());
+
+	auto work ([](const std::shared_ptr<BulkState>& bulk, const ApiUser::Ptr& user, bool verbose) {
+		bulk->Running.fetch_add(1);
+
+		Defer done ([&bulk]() {
+			bulk->Running.fetch_sub(1);
+		});
+
+		for (;;) {
+			size_t i = bulk->Next.fetch_add(1);
+
+			if (i >= bulk->Actions.size())
+				break;
+
+			bulk->Results[i] = RunBulkAction(bulk->Actions[i], user, verbose);
+		}
+	});
+
+	size_t workers = std::min<size_t>(state->Actions.size(), Configuration::Concurrency);
+
+	for (size_t i = 1; i < workers; i++) {
+		IoEngine::SpawnCoroutine(IoEngine::Get().GetIoContext(), [state, user, verbose, work](boost::asio::yield_context yc) {
+			CpuBoundWork runActions (yc);
+
+			work(state, user, verbose);
+		});
+	}
+
+	/* The caller already holds a CPU slot. */
+	work(state, user, verbose);
+
+	while (state->Running.load()) {
+		IoEngine::YieldCurrentCoroutine(yc);
+	}
+
+	return ArrayData(state->Results.begin(), state->Results.end());
+}
+
+bool ActionsHandler::HandleRequest(
+	AsioTlsStream& stream,
+	const ApiUser::Ptr& user,
+	boost::beast::http::request<boost::beast::http::string_body>& request,
+	const Url::Ptr& url,
+	boost::beast::http::response<boost::beast::http::string_body>& response,
+	const Dictionary::Ptr& params,
+	boost::asio::yield_context& yc,
+	HttpServerConnection& server
+)
+{
+	namespace http = boost::beast::http;
+
+	if (url->GetPath().size() != 2 && url->GetPath().size() != 3)
+		return false;
+
+	if (request.method() != http::verb::post)
+		return false;
+
+	bool verbose = false;
+
+	if (params)
+		verbose = HttpUtility::GetLastParameter(params, "verbose");
+
+	ArrayData results;
+	int statusCode;
+
+	if (url->GetPath().size() == 2) {
+		Value actions = params ? params->Get("actions") : Empty;
+
+		if (!actions.IsObjectType<Array>()) {
+			HttpUtility::SendJsonError(response, params, 400, "Parameter 'actions' must be an array.");
+			return true;
+		}
+
+		results = RunBulkActions(actions, user, verbose, yc);
+
+		statusCode = results.empty() ? 200 : GetStatusCode(results);
+	} else {
+		String actionName = url->GetPath()[2];
+		String error, diagnosticInformation;
+
+		statusCode = RunAction(actionName, params, user, verbose, results, error, diagnosticInformation);
+
+		if (!error.IsEmpty()) {
+			HttpUtility::SendJsonError(response, params, statusCode, error, diagnosticInformation);
+			return true;
+		}
+	}
+
 	response.result(statusCode);
 
 	Dictionary::Ptr result = new Dictionary({
@@ -25,6 +25,14 @@ public:
 		boost::asio::yield_context& yc,
 		HttpServerConnection& server
 	) override;
+
+private:
+	static int RunAction(const String& actionName, const Dictionary::Ptr& params, const ApiUser::Ptr& user,
+		bool verbose, ArrayData& results, String& error, String& diagnosticInformation);
+	static int GetStatusCode(const ArrayData& results);
+	static Dictionary::Ptr RunBulkAction(const Value& item, const ApiUser::Ptr& user, bool verbose);
+	static ArrayData RunBulkActions(const Array::Ptr& actions, const ApiUser::Ptr& user, bool verbose,
+		boost::asio::yield_context& yc);
 };
 
 }
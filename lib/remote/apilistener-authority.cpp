@@ -3,8 +3,12 @@
 #include "remote/zone.hpp"
 #include "remote/apilistener.hpp"
 #include "base/configtype.hpp"
+#include "base/configuration.hpp"
 #include "base/utility.hpp"
 #include "base/convert.hpp"
+#include "base/taskgroup.hpp"
+#include <utility>
+#include <vector>
 
 using namespace icinga;
 
@@ -59,6 +63,9 @@ void ApiListener::UpdateObjectAuthority()
 		if (!dtype)
 			continue;
 
+		/* Only pause/resume the objects whose authority actually changes, that's what takes time. */
+		std::vector<std::pair<ConfigObject::Ptr, bool>> changed;
+
 		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
 			if (!object->IsActive() || object->GetHAMode() != HARunOnce)
 				continue;
@@ -68,7 +75,10 @@ void ApiListener::UpdateObjectAuthority()
 			if (!my_zone)
 				authority = true;
 			else
-				authority = endpoints[Utility::SDBM(object->GetName()) % endpoints.size()] == my_endpoint;
+				authority = endpoints[object->GetNameHash() % endpoints.size()] == my_endpoint;
+
+			if (authority == !object->IsPaused())
+				continue;
 
 #ifdef I2_DEBUG
 // 			//Enable on demand, causes heavy logging on each run.
@@ -76,7 +86,26 @@ void ApiListener::UpdateObjectAuthority()
 //				<< "Setting authority '" << Convert::ToString(authority) << "' for object '" << object->GetName() << "' of type '" << object->GetReflectionType()->GetName() << "'.";
 #endif /* I2_DEBUG */
 
-			object->SetAuthority(authority);
+			changed.emplace_back(object, authority);
+		}
+
+		if (changed.size() == 1u) {
+			changed[0].first->SetAuthority(changed[0].second);
+		} else if (!changed.empty()) {
+			/* One type after another, like before, but the objects of a type in parallel. */
+			TaskGroup upq ("ApiListener::UpdateObjectAuthority");
+
+			upq.ParallelFor(changed, [](const std::pair<ConfigObject::Ptr, bool>& object) {
+				object.first->SetAuthority(object.second);
+			});
+
+			upq.Join();
+
+			if (upq.HasExceptions())
+				upq.ReportExceptions("ApiListener");
+
+			Log(LogInformation, "ApiListener")
+				<< "Changed the authority for " << changed.size() << " objects of type '" << type->GetName() << "'.";
 		}
 	}
 
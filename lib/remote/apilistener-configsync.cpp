@@ -9,18 +9,101 @@
 #include "base/convert.hpp"
 #include "base/defer.hpp"
 #include "config/vmops.hpp"
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 
 using namespace icinga;
 
 REGISTER_APIFUNCTION(UpdateObject, config, &ApiListener::ConfigUpdateObjectAPIHandler);
 REGISTER_APIFUNCTION(DeleteObject, config, &ApiListener::ConfigDeleteObjectAPIHandler);
+REGISTER_APIFUNCTION(UpdateObjects, config, &ApiListener::ConfigUpdateObjectsAPIHandler);
+REGISTER_APIFUNCTION(RuntimeObjectManifest, config, &ApiListener::RuntimeObjectManifestAPIHandler);
+REGISTER_APIFUNCTION(RequestRuntimeObjects, config, &ApiListener::RequestRuntimeObjectsAPIHandler);
+
+/**
+ * Object versions per config::RuntimeObjectManifest and objects per config::UpdateObjects message.
+ */
+static constexpr size_t l_MaxManifestSize = 10000;
+static constexpr size_t l_MaxUpdateObjectsSize = 1000;
+
+/**
+ * How long the initial sync waits for the replies to its config::RuntimeObjectManifest messages
+ * before it falls back to sending all objects.
+ */
+static constexpr std::chrono::seconds l_ManifestReplyTimeout (60);
 
 INITIALIZE_ONCE([]() {
 	ConfigObject::OnActiveChanged.connect(&ApiListener::ConfigUpdateObjectHandler);
 	ConfigObject::OnVersionChanged.connect(&ApiListener::ConfigUpdateObjectHandler);
 });
 
+/**
+ * Applies a config::UpdateObject message's modified and original attributes to an existing object.
+ *
+ * @param sender Who sent the update, for the log messages
+ */
+static void UpdateRuntimeObject(const ConfigObject::Ptr& object, const Dictionary::Ptr& params,
+	const MessageOrigin::Ptr& origin, bool newObject, const String& sender)
+{
+	double objVersion = params->Get("version");
+
+	/* update object attributes if version was changed or if this is a new object */
+	if (newObject || objVersion <= object->GetVersion()) {
+		Log(LogNotice, "ApiListener")
+			<< "Discarding config update" << sender
+			<< " for object '" << object->GetName()
+			<< "': Object version " << std::fixed << object->GetVersion()
+			<< " is more recent than the received version " << std::fixed << objVersion << ".";
+
+		return;
+	}
+
+	Log(LogNotice, "ApiListener")
+		<< "Processing config update" << sender
+		<< " for object '" << object->GetName()
+		<< "': Object version " << object->GetVersion()
+		<< " is older than the received version " << objVersion << ".";
+
+	Dictionary::Ptr modified_attributes = params->Get("modified_attributes");
+
+	if (modified_attributes) {
+		ObjectLock olock(modified_attributes);
+		for (const Dictionary::Pair& kv : modified_attributes) {
+			/* update all modified attributes
+			 * but do not update the object version yet.
+			 * This triggers cluster events otherwise.
+			 */
+			object->ModifyAttribute(kv.first, kv.second, false);
+		}
+	}
+
+	/* check whether original attributes changed and restore them locally */
+	Array::Ptr newOriginalAttributes = params->Get("original_attributes");
+	Dictionary::Ptr objOriginalAttributes = object->GetOriginalAttributes();
+
+	if (newOriginalAttributes && objOriginalAttributes) {
+		std::vector<String> restoreAttrs;
+
+		{
+			ObjectLock xlock(objOriginalAttributes);
+			for (const Dictionary::Pair& kv : objOriginalAttributes) {
+				/* original attribute was removed, restore it */
+				if (!newOriginalAttributes->Contains(kv.first))
+					restoreAttrs.push_back(kv.first);
+			}
+		}
+
+		for (const String& key : restoreAttrs) {
+			/* do not update the object version yet. */
+			object->RestoreAttribute(key, false);
+		}
+	}
+
+	/* keep the object version in sync with the sender */
+	object->SetVersion(objVersion, false, origin);
+}
+
 void ApiListener::ConfigUpdateObjectHandler(const ConfigObject::Ptr& object, const Value& cookie)
 {
 	ApiListener::Ptr listener = ApiListener::GetInstance();
@@ -28,6 +111,10 @@ void ApiListener::ConfigUpdateObjectHandler(const ConfigObject::Ptr& object, con
 	if (!listener)
 		return;
 
+	/* Synced by ConfigObjectUtility::CreateObjects() in batches after the activation */
+	if (object->GetExtension("ConfigObjectSyncDeferred"))
+		return;
+
 	if (object->IsActive()) {
 		/* Sync object config */
 		listener->UpdateConfigObject(object, cookie);
@@ -154,62 +241,289 @@ Value ApiListener::ConfigUpdateObjectAPIHandler(const MessageOrigin::Ptr& origin
 	if (!object)
 		return Empty;
 
-	/* update object attributes if version was changed or if this is a new object */
-	if (newObject || objVersion <= object->GetVersion()) {
+	UpdateRuntimeObject(object, params, origin, newObject, " from '" + identity + "' (endpoint: '" + endpoint->GetName()
+		+ "', zone: '" + endpointZone->GetName() + "')");
+
+	return Empty;
+}
+
+/**
+ * Like the checks of ConfigUpdateObjectAPIHandler() which don't depend on the object.
+ *
+ * @return The sending endpoint, nullptr if the message has to be discarded
+ */
+static Endpoint::Ptr GetRuntimeObjectsSender(const MessageOrigin::Ptr& origin, const String& message)
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener)
+		return nullptr;
+
+	Endpoint::Ptr endpoint = origin->FromClient->GetEndpoint();
+
+	String identity = origin->FromClient->GetIdentity();
+
+	if (!endpoint) {
 		Log(LogNotice, "ApiListener")
-			<< "Discarding config update"
+			<< "Discarding '" << message << "' message from '" << identity << "': Invalid endpoint origin (client not allowed).";
+		return nullptr;
+	}
+
+	Zone::Ptr endpointZone = endpoint->GetZone();
+
+	if (!Zone::GetLocalZone()->IsChildOf(endpointZone)) {
+		Log(LogNotice, "ApiListener")
+			<< "Discarding '" << message << "' message"
 			<< " from '" << identity << "' (endpoint: '" << endpoint->GetName() << "', zone: '" << endpointZone->GetName() << "')"
-			<< " for object '" << object->GetName()
-			<< "': Object version " << std::fixed << object->GetVersion()
-			<< " is more recent than the received version " << std::fixed << objVersion << ".";
+			<< ". Sender is in a child zone.";
+		return nullptr;
+	}
+
+	if (!listener->GetAcceptConfig()) {
+		Log(LogWarning, "ApiListener")
+			<< "Ignoring '" << message << "' message"
+			<< " from '" << identity << "' (endpoint: '" << endpoint->GetName() << "', zone: '" << endpointZone->GetName() << "')"
+			<< ". '" << listener->GetName() << "' does not accept config.";
+		return nullptr;
+	}
+
+	return endpoint;
+}
+
+/**
+ * Processes many config::UpdateObject messages' params at once, the objects we asked for during the initial sync.
+ * All new objects are created in one go, instead of committing and activating them one by one.
+ */
+Value ApiListener::ConfigUpdateObjectsAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	Endpoint::Ptr endpoint = GetRuntimeObjectsSender(origin, "config update objects");
+
+	if (!endpoint)
+		return Empty;
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+	Array::Ptr objects = params->Get("objects");
 
+	if (!objects)
 		return Empty;
+
+	struct Update
+	{
+		Type::Ptr ObjectType;
+		ConfigType *Ctype;
+		String Name;
+		Dictionary::Ptr Params;
+		bool NewObject;
+	};
+
+	std::vector<Update> updates;
+
+	{
+		ObjectLock olock(objects);
+
+		for (Dictionary::Ptr objParams : objects) {
+			if (!objParams)
+				continue;
+
+			String objType = objParams->Get("type");
+			String objZone = objParams->Get("zone");
+			Type::Ptr ptype = Type::GetByName(objType);
+			auto *ctype = dynamic_cast<ConfigType *>(ptype.get());
+
+			if (!ctype) {
+				Log(LogCritical, "ApiListener")
+					<< "Config type '" << objType << "' does not exist.";
+				continue;
+			}
+
+			if (!objZone.IsEmpty() && !Zone::GetByName(objZone)) {
+				Log(LogNotice, "ApiListener")
+					<< "Discarding config update for object '" << objParams->Get("name") << "' of type '" << objType
+					<< "'. Objects zone '" << objZone << "' isn't known locally.";
+				continue;
+			}
+
+			updates.emplace_back(Update{ptype, ctype, objParams->Get("name"), objParams, false});
+		}
 	}
 
-	Log(LogNotice, "ApiListener")
-		<< "Processing config update"
-		<< " from '" << identity << "' (endpoint: '" << endpoint->GetName() << "', zone: '" << endpointZone->GetName() << "')"
-		<< " for object '" << object->GetName()
-		<< "': Object version " << object->GetVersion()
-		<< " is older than the received version " << objVersion << ".";
+	/* Always lock in the same order, another endpoint of the sender's zone may send the same objects. */
+	std::sort(updates.begin(), updates.end(), [](const Update& lhs, const Update& rhs) {
+		return lhs.ObjectType.get() < rhs.ObjectType.get() || (lhs.ObjectType == rhs.ObjectType && lhs.Name < rhs.Name);
+	});
 
-	Dictionary::Ptr modified_attributes = params->Get("modified_attributes");
+	updates.erase(std::unique(updates.begin(), updates.end(), [](const Update& lhs, const Update& rhs) {
+		return lhs.ObjectType == rhs.ObjectType && lhs.Name == rhs.Name;
+	}), updates.end());
 
-	if (modified_attributes) {
-		ObjectLock olock(modified_attributes);
-		for (const Dictionary::Pair& kv : modified_attributes) {
-			/* update all modified attributes
-			 * but do not update the object version yet.
-			 * This triggers cluster events otherwise.
-			 */
-			object->ModifyAttribute(kv.first, kv.second, false);
+	for (auto& update : updates)
+		listener->m_ObjectConfigChangeLock.Lock(update.ObjectType, update.Name);
+
+	Defer unlockAndNotify([&listener, &updates]{
+		for (auto& update : updates)
+			listener->m_ObjectConfigChangeLock.Unlock(update.ObjectType, update.Name);
+	});
+
+	std::vector<NewConfigObject> newObjects;
+
+	for (auto& update : updates) {
+		String config = update.Params->Get("config");
+
+		if (!update.Ctype->GetObject(update.Name) && !config.IsEmpty()) {
+			update.NewObject = true;
+			newObjects.emplace_back(NewConfigObject{update.ObjectType, update.Name, config});
 		}
 	}
 
-	/* check whether original attributes changed and restore them locally */
-	Array::Ptr newOriginalAttributes = params->Get("original_attributes");
-	Dictionary::Ptr objOriginalAttributes = object->GetOriginalAttributes();
+	Array::Ptr errors = new Array();
 
-	if (newOriginalAttributes && objOriginalAttributes) {
-		std::vector<String> restoreAttrs;
+	/*
+	 * IMPORTANT: Pass the origin to prevent cluster sync loops.
+	 */
+	if (!ConfigObjectUtility::CreateObjects(newObjects, errors, nullptr, origin)) {
+		Log(LogWarning, "ApiListener")
+			<< "Could not create " << newObjects.size() << " objects at once, creating them one by one.";
 
-		{
-			ObjectLock xlock(objOriginalAttributes);
-			for (const Dictionary::Pair& kv : objOriginalAttributes) {
-				/* original attribute was removed, restore it */
-				if (!newOriginalAttributes->Contains(kv.first))
-					restoreAttrs.push_back(kv.first);
+		for (auto& object : newObjects) {
+			errors = new Array();
+
+			if (!ConfigObjectUtility::CreateObject(object.ObjectType, object.Name, object.Config, errors, nullptr, origin)) {
+				Log(LogCritical, "ApiListener")
+					<< "Could not create object '" << object.Name << "':";
+
+				ObjectLock olock(errors);
+				for (const String& error : errors) {
+					Log(LogCritical, "ApiListener", error);
+				}
 			}
 		}
+	}
 
-		for (const String& key : restoreAttrs) {
-			/* do not update the object version yet. */
-			object->RestoreAttribute(key, false);
+	String sender = " from '" + origin->FromClient->GetIdentity() + "' (endpoint: '" + endpoint->GetName()
+		+ "', zone: '" + endpoint->GetZone()->GetName() + "')";
+
+	for (auto& update : updates) {
+		ConfigObject::Ptr object = update.Ctype->GetObject(update.Name);
+
+		if (!object)
+			continue;
+
+		if (update.NewObject) {
+			/* object was created, update its version */
+			object->SetVersion(update.Params->Get("version"), false, origin);
+			continue;
+		}
+
+		UpdateRuntimeObject(object, update.Params, origin, false, sender);
+	}
+
+	Log(LogInformation, "ApiListener")
+		<< "Processed " << updates.size() << " runtime object updates" << sender << ", " << newObjects.size() << " new.";
+
+	return Empty;
+}
+
+/**
+ * Replies to a config::RuntimeObjectManifest with the objects which are missing here or older than the sender's ones.
+ * The others would be discarded by ConfigUpdateObjectAPIHandler() anyway.
+ */
+Value ApiListener::RuntimeObjectManifestAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	Dictionary::Ptr requested = new Dictionary();
+	size_t total = 0, missing = 0;
+
+	/* Reply in any case, the sender waits for it. */
+	Defer reply ([&origin, &requested]() {
+		origin->FromClient->SendMessage(new Dictionary({
+			{ "jsonrpc", "2.0" },
+			{ "method", "config::RequestRuntimeObjects" },
+			{ "params", new Dictionary({ { "objects", requested } }) }
+		}));
+	});
+
+	if (!GetRuntimeObjectsSender(origin, "config runtime object manifest"))
+		return Empty;
+
+	Dictionary::Ptr manifest = params->Get("objects");
+
+	if (!manifest)
+		return Empty;
+
+	ObjectLock olock(manifest);
+
+	for (const Dictionary::Pair& kv : manifest) {
+		auto *ctype = dynamic_cast<ConfigType *>(Type::GetByName(kv.first).get());
+		Dictionary::Ptr versions = kv.second;
+
+		if (!ctype || !versions)
+			continue;
+
+		ArrayData names;
+		ObjectLock vlock(versions);
+
+		for (const Dictionary::Pair& version : versions) {
+			ConfigObject::Ptr object = ctype->GetObject(version.first);
+
+			total++;
+
+			if (!object || object->GetVersion() < (double)version.second) {
+				names.emplace_back(version.first);
+				missing++;
+			}
 		}
+
+		if (!names.empty())
+			requested->Set(kv.first, new Array(std::move(names)));
 	}
 
-	/* keep the object version in sync with the sender */
-	object->SetVersion(objVersion, false, origin);
+	Log(LogInformation, "ApiListener")
+		<< "Requesting " << missing << " of " << total << " runtime objects from endpoint '"
+		<< origin->FromClient->GetEndpoint()->GetName() << "'.";
+
+	return Empty;
+}
+
+/**
+ * Collects the objects an endpoint asked for for SendRuntimeConfigObjects().
+ */
+Value ApiListener::RequestRuntimeObjectsAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener)
+		return Empty;
+
+	Dictionary::Ptr objects = params->Get("objects");
+
+	{
+		std::unique_lock<std::mutex> lock (listener->m_RuntimeObjectRequestsMutex);
+		auto request (listener->m_RuntimeObjectRequests.find(origin->FromClient));
+
+		/* Not asked for */
+		if (request == listener->m_RuntimeObjectRequests.end() || !request->second.PendingManifests)
+			return Empty;
+
+		if (objects) {
+			ObjectLock olock(objects);
+
+			for (const Dictionary::Pair& kv : objects) {
+				Type::Ptr type = Type::GetByName(kv.first);
+				Array::Ptr names = kv.second;
+
+				if (!type || !names)
+					continue;
+
+				ObjectLock nlock(names);
+
+				for (const String& name : names)
+					request->second.Objects.emplace_back(type, name);
+			}
+		}
+
+		request->second.PendingManifests--;
+	}
+
+	listener->m_RuntimeObjectRequestsCV.notify_all();
 
 	return Empty;
 }
@@ -314,33 +628,18 @@ Value ApiListener::ConfigDeleteObjectAPIHandler(const MessageOrigin::Ptr& origin
 	return Empty;
 }
 
-void ApiListener::UpdateConfigObject(const ConfigObject::Ptr& object, const MessageOrigin::Ptr& origin,
-	const JsonRpcConnection::Ptr& client)
+/**
+ * Serializes an object for config::UpdateObject(s) messages.
+ *
+ * @return nullptr if the object isn't synced at all
+ */
+static Dictionary::Ptr GetUpdateObjectParams(const ConfigObject::Ptr& object)
 {
-	/* only send objects to zones which have access to the object */
-	if (client) {
-		Zone::Ptr target_zone = client->GetEndpoint()->GetZone();
-
-		if (target_zone && !target_zone->CanAccessObject(object)) {
-			Log(LogDebug, "ApiListener")
-				<< "Not sending 'update config' message to unauthorized zone '" << target_zone->GetName() << "'"
-				<< " for object: '" << object->GetName() << "'.";
-
-			return;
-		}
-	}
-
 	if (object->GetPackage() != "_api" && object->GetVersion() == 0)
-		return;
+		return nullptr;
 
 	Dictionary::Ptr params = new Dictionary();
 
-	Dictionary::Ptr message = new Dictionary({
-		{ "jsonrpc", "2.0" },
-		{ "method", "config::UpdateObject" },
-		{ "params", params }
-	});
-
 	params->Set("name", object->GetName());
 	params->Set("type", object->GetReflectionType()->GetName());
 	params->Set("version", object->GetVersion());
@@ -353,7 +652,7 @@ void ApiListener::UpdateConfigObject(const ConfigObject::Ptr& object, const Mess
 	if (object->GetPackage() == "_api") {
 		std::ifstream fp(ConfigObjectUtility::GetExistingObjectConfigPath(object).CStr(), std::ifstream::binary);
 		if (!fp)
-			return;
+			return nullptr;
 
 		String content((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
 		params->Set("config", content);
@@ -384,6 +683,36 @@ void ApiListener::UpdateConfigObject(const ConfigObject::Ptr& object, const Mess
 	/* only send the original attribute keys */
 	params->Set("original_attributes", new Array(std::move(newOriginalAttributes)));
 
+	return params;
+}
+
+void ApiListener::UpdateConfigObject(const ConfigObject::Ptr& object, const MessageOrigin::Ptr& origin,
+	const JsonRpcConnection::Ptr& client)
+{
+	/* only send objects to zones which have access to the object */
+	if (client) {
+		Zone::Ptr target_zone = client->GetEndpoint()->GetZone();
+
+		if (target_zone && !target_zone->CanAccessObject(object)) {
+			Log(LogDebug, "ApiListener")
+				<< "Not sending 'update config' message to unauthorized zone '" << target_zone->GetName() << "'"
+				<< " for object: '" << object->GetName() << "'.";
+
+			return;
+		}
+	}
+
+	Dictionary::Ptr params = GetUpdateObjectParams(object);
+
+	if (!params)
+		return;
+
+	Dictionary::Ptr message = new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "config::UpdateObject" },
+		{ "params", params }
+	});
+
 #ifdef I2_DEBUG
 	Log(LogDebug, "ApiListener")
 		<< "Sent update for object '" << object->GetName() << "': " << JsonEncode(params);
@@ -462,6 +791,8 @@ void ApiListener::SendRuntimeConfigObjects(const JsonRpcConnection::Ptr& aclient
 	Log(LogInformation, "ApiListener")
 		<< "Syncing runtime objects to endpoint '" << endpoint->GetName() << "'.";
 
+	std::vector<ConfigObject::Ptr> objects;
+
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
 		auto *dtype = dynamic_cast<ConfigType *>(type.get());
 
@@ -473,13 +804,161 @@ void ApiListener::SendRuntimeConfigObjects(const JsonRpcConnection::Ptr& aclient
 			if (!azone->CanAccessObject(object))
 				continue;
 
-			/* send the config object to the connected client */
-			UpdateConfigObject(object, nullptr, aclient);
+			/* like UpdateConfigObject() */
+			if (object->GetPackage() != "_api" && object->GetVersion() == 0)
+				continue;
+
+			objects.emplace_back(object);
 		}
 	}
 
+	std::vector<ConfigObject::Ptr> requested;
+
+	if (!(endpoint->GetCapabilities() & (uint_fast64_t)ApiCapabilities::RuntimeObjectManifests)
+		|| !RequestRuntimeConfigObjects(aclient, objects, requested)) {
+		/* send the config objects to the connected client */
+		for (auto& object : objects)
+			UpdateConfigObject(object, nullptr, aclient);
+
+		Log(LogInformation, "ApiListener")
+			<< "Finished syncing runtime objects to endpoint '" << endpoint->GetName() << "'.";
+
+		return;
+	}
+
+	ArrayData batch;
+
+	auto flush ([&aclient, &batch]() {
+		if (batch.empty())
+			return;
+
+		aclient->SendMessage(new Dictionary({
+			{ "jsonrpc", "2.0" },
+			{ "method", "config::UpdateObjects" },
+			{ "params", new Dictionary({ { "objects", new Array(std::move(batch)) } }) }
+		}));
+
+		batch.clear();
+	});
+
+	for (auto& object : requested) {
+		Dictionary::Ptr params = GetUpdateObjectParams(object);
+
+		if (!params)
+			continue;
+
+		batch.emplace_back(params);
+
+		if (batch.size() >= l_MaxUpdateObjectsSize)
+			flush();
+	}
+
+	flush();
+
 	Log(LogInformation, "ApiListener")
-		<< "Finished syncing runtime objects to endpoint '" << endpoint->GetName() << "'.";
+		<< "Finished syncing runtime objects to endpoint '" << endpoint->GetName() << "', "
+		<< requested.size() << " of " << objects.size() << " objects were out of date.";
+}
+
+/**
+ * Sends the versions of the objects, so the endpoint doesn't have to process all of them again, and waits for its reply.
+ *
+ * @param requested The objects the endpoint doesn't have or has an older version of
+ *
+ * @return Whether the endpoint replied in time, otherwise all objects have to be sent
+ */
+bool ApiListener::RequestRuntimeConfigObjects(const JsonRpcConnection::Ptr& aclient,
+	const std::vector<ConfigObject::Ptr>& objects, std::vector<ConfigObject::Ptr>& requested)
+{
+	Endpoint::Ptr endpoint = aclient->GetEndpoint();
+	std::vector<Dictionary::Ptr> manifests;
+	size_t count = 0;
+
+	for (auto& object : objects) {
+		if (manifests.empty() || count >= l_MaxManifestSize) {
+			manifests.emplace_back(new Dictionary());
+			count = 0;
+		}
+
+		String type = object->GetReflectionType()->GetName();
+		Dictionary::Ptr versions = manifests.back()->Get(type);
+
+		if (!versions) {
+			versions = new Dictionary();
+			manifests.back()->Set(type, versions);
+		}
+
+		versions->Set(object->GetName(), object->GetVersion());
+		count++;
+	}
+
+	if (manifests.empty())
+		return true;
+
+	{
+		std::unique_lock<std::mutex> lock (m_RuntimeObjectRequestsMutex);
+		m_RuntimeObjectRequests[aclient] = RuntimeObjectRequest{manifests.size(), {}};
+	}
+
+	Defer removeRequest ([this, &aclient]() {
+		std::unique_lock<std::mutex> lock (m_RuntimeObjectRequestsMutex);
+		m_RuntimeObjectRequests.erase(aclient);
+	});
+
+	for (auto& manifest : manifests) {
+		aclient->SendMessage(new Dictionary({
+			{ "jsonrpc", "2.0" },
+			{ "method", "config::RuntimeObjectManifest" },
+			{ "params", new Dictionary({ { "objects", manifest } }) }
+		}));
+	}
+
+	auto deadline (std::chrono::steady_clock::now() + l_ManifestReplyTimeout);
+	std::vector<std::pair<Type::Ptr, String>> names;
+
+	{
+		std::unique_lock<std::mutex> lock (m_RuntimeObjectRequestsMutex);
+		auto& request (m_RuntimeObjectRequests[aclient]);
+
+		while (request.PendingManifests) {
+			/* Check every second whether the connection is still there. */
+			m_RuntimeObjectRequestsCV.wait_for(lock, std::chrono::seconds(1));
+
+			if (!request.PendingManifests)
+				break;
+
+			if (!endpoint->GetClients().count(aclient)) {
+				Log(LogNotice, "ApiListener")
+					<< "Endpoint '" << endpoint->GetName() << "' disconnected while syncing runtime objects.";
+
+				return true;
+			}
+
+			if (std::chrono::steady_clock::now() >= deadline) {
+				Log(LogWarning, "ApiListener")
+					<< "Endpoint '" << endpoint->GetName() << "' didn't reply to the runtime object versions in time, sending all objects.";
+
+				return false;
+			}
+		}
+
+		names = std::move(request.Objects);
+	}
+
+	for (auto& name : names) {
+		auto *ctype = dynamic_cast<ConfigType *>(name.first.get());
+
+		if (!ctype)
+			continue;
+
+		ConfigObject::Ptr object = ctype->GetObject(name.second);
+
+		/* Only send what the endpoint may see, like UpdateConfigObject() */
+		if (object && endpoint->GetZone()->CanAccessObject(object))
+			requested.emplace_back(object);
+	}
+
+	return true;
 }
 
 /**
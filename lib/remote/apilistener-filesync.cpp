@@ -9,11 +9,17 @@
 #include "base/logger.hpp"
 #include "base/convert.hpp"
 #include "base/application.hpp"
+#include "base/configuration.hpp"
 #include "base/exception.hpp"
 #include "base/shared.hpp"
 #include "base/utility.hpp"
+#include "base/taskgroup.hpp"
+#include <boost/exception_ptr.hpp>
+#include <algorithm>
+#include <ctime>
 #include <fstream>
 #include <iomanip>
+#include <sys/stat.h>
 #include <thread>
 
 using namespace icinga;
@@ -21,6 +27,8 @@ using namespace icinga;
 REGISTER_APIFUNCTION(Update, config, &ApiListener::ConfigUpdateHandler);
 
 std::mutex ApiListener::m_ConfigSyncStageLock;
+std::mutex ApiListener::m_ConfigFileCacheMutex;
+std::unordered_map<String, std::unordered_map<String, ApiListener::ConfigFileCacheEntry::Ptr>> ApiListener::m_ConfigFileCache;
 
 /**
  * Entrypoint for updating all authoritative configs from /etc/zones.d, packages, etc.
@@ -228,7 +236,7 @@ void ApiListener::SendConfigUpdate(const JsonRpcConnection::Ptr& aclient)
 		}) }
 	});
 
-	aclient->SendMessage(message);
+	aclient->SendMessage(message, JsonRpcPriorityControl);
 }
 
 static bool CompareTimestampsConfigChange(const Dictionary::Ptr& productionConfig, const Dictionary::Ptr& receivedConfig,
@@ -789,6 +797,9 @@ bool ApiListener::CheckConfigChange(const ConfigDirInformation& oldConfig, const
 /**
  * Load the given config dir and read their file content into the config structure.
  *
+ * Files which didn't change since the last call for the same directory are taken
+ * from the config file cache, the others are read and checksummed in parallel.
+ *
  * @param dir Path to the config directory.
  * @returns ConfigDirInformation structure.
  */
@@ -799,72 +810,167 @@ ConfigDirInformation ApiListener::LoadConfigDir(const String& dir)
 	config.UpdateV2 = new Dictionary();
 	config.Checksums = new Dictionary();
 
-	Utility::GlobRecursive(dir, "*", [&config, dir](const String& file) { ConfigGlobHandler(config, dir, file); }, GlobFile);
+	std::vector<String> files;
+
+	Utility::GlobRecursive(dir, "*", [&files](const String& file) {
+		// Avoid loading the authoritative marker for syncs at all cost.
+		if (Utility::BaseName(file) != ".authoritative")
+			files.emplace_back(file);
+	}, GlobFile);
+
+	std::unordered_map<String, ConfigFileCacheEntry::Ptr> cache;
+
+	{
+		std::unique_lock<std::mutex> lock (m_ConfigFileCacheMutex);
+
+		auto it (m_ConfigFileCache.find(dir));
+
+		if (it != m_ConfigFileCache.end())
+			cache = it->second;
+	}
+
+	std::vector<ConfigFileCacheEntry::Ptr> entries (files.size());
+	std::vector<size_t> misses;
+
+	for (size_t i = 0; i < files.size(); i++) {
+		auto it (cache.find(files[i]));
+
+		if (it != cache.end() && it->second->IsUpToDate(files[i]))
+			entries[i] = it->second;
+		else
+			misses.emplace_back(i);
+	}
+
+	if (misses.size() > 1u) {
+		TaskGroup upq ("ApiListener, LoadConfigDir");
+
+		upq.ParallelFor(misses, [&files, &entries](size_t i) {
+			entries[i] = ReadConfigFile(files[i]);
+		});
+
+		upq.Join();
+
+		if (upq.HasExceptions())
+			boost::rethrow_exception(upq.GetExceptions().front());
+	} else if (!misses.empty()) {
+		entries[misses.front()] = ReadConfigFile(files[misses.front()]);
+	}
+
+	std::unordered_map<String, ConfigFileCacheEntry::Ptr> newCache;
+
+	for (size_t i = 0; i < files.size(); i++) {
+		const String& file = files[i];
+		auto& entry (entries[i]);
+
+		if (!entry)
+			continue;
+
+		newCache.emplace(file, entry);
+
+		Log(LogNotice, "ApiListener")
+			<< "Creating config update for file '" << file << "'.";
+
+		String relativePath = file.SubStr(dir.GetLength());
+
+		/*
+		 * 'update' messages contain conf files. 'update_v2' syncs everything else (.timestamp).
+		 *
+		 * **Keep this intact to stay compatible with older clients.**
+		 */
+		if (Utility::Match("*.conf", file)) {
+			config.UpdateV1->Set(relativePath, entry->Content);
+		} else {
+			/*
+			 * Ensure that only valid UTF8 content is being read for the cluster config sync.
+			 * Binary files are not supported when wrapped into JSON encoded messages.
+			 * Rationale: https://github.com/Icinga/icinga2/issues/7382
+			 */
+			if (!entry->ValidUTF8) {
+				Log(LogCritical, "ApiListener")
+					<< "Ignoring file '" << file << "' for cluster config sync: Does not contain valid UTF8. Binary files are not supported.";
+				continue;
+			}
+
+			config.UpdateV2->Set(relativePath, entry->Content);
+		}
+
+		/* Calculate a checksum for each file (and a global one later).
+		 *
+		 * IMPORTANT: Ignore the .authoritative file above, this must not be synced.
+		 * */
+		config.Checksums->Set(relativePath, entry->Checksum);
+	}
+
+	{
+		std::unique_lock<std::mutex> lock (m_ConfigFileCacheMutex);
+
+		m_ConfigFileCache[dir] = std::move(newCache);
+	}
+
 	return config;
 }
 
 /**
- * Read the given file and store it in the config information structure.
- * Callback function for Glob().
+ * Read the given file and checksum its content for the config file cache.
  *
- * @param config Reference to the config information object.
- * @param path File path.
  * @param file Full file name.
+ * @returns The cache entry or nullptr if the file couldn't be read.
  */
-void ApiListener::ConfigGlobHandler(ConfigDirInformation& config, const String& path, const String& file)
+ApiListener::ConfigFileCacheEntry::Ptr ApiListener::ReadConfigFile(const String& file)
 {
-	// Avoid loading the authoritative marker for syncs at all cost.
-	if (Utility::BaseName(file) == ".authoritative")
-		return;
-
 	CONTEXT("Creating config update for file '" << file << "'");
 
-	Log(LogNotice, "ApiListener")
-		<< "Creating config update for file '" << file << "'.";
+	auto entry (std::make_shared<ConfigFileCacheEntry>());
+
+	// Taken before reading to notice changes during (and right after) the read, see IsUpToDate().
+	entry->CachedAt = time(nullptr);
+
+	struct stat statbuf;
+
+	if (stat(file.CStr(), &statbuf) < 0)
+		return nullptr;
+
+	entry->Mtime = statbuf.st_mtime;
+	entry->Size = statbuf.st_size;
 
 	std::ifstream fp(file.CStr(), std::ifstream::binary);
 	if (!fp)
-		return;
+		return nullptr;
 
 	String content((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
 
-	Dictionary::Ptr update;
-	String relativePath = file.SubStr(path.GetLength());
-
-	/*
-	 * 'update' messages contain conf files. 'update_v2' syncs everything else (.timestamp).
-	 *
-	 * **Keep this intact to stay compatible with older clients.**
-	 */
 	String sanitizedContent = Utility::ValidateUTF8(content);
 
-	if (Utility::Match("*.conf", file)) {
-		update = config.UpdateV1;
+	entry->ValidUTF8 = content == sanitizedContent;
+	entry->Checksum = GetChecksum(content);
 
-		// Configuration files should be automatically sanitized with UTF8.
-		update->Set(relativePath, sanitizedContent);
-	} else {
-		update = config.UpdateV2;
+	// Configuration files should be automatically sanitized with UTF8.
+	entry->Content = Utility::Match("*.conf", file) ? std::move(sanitizedContent) : std::move(content);
 
-		/*
-		 * Ensure that only valid UTF8 content is being read for the cluster config sync.
-		 * Binary files are not supported when wrapped into JSON encoded messages.
-		 * Rationale: https://github.com/Icinga/icinga2/issues/7382
-		 */
-		if (content != sanitizedContent) {
-			Log(LogCritical, "ApiListener")
-				<< "Ignoring file '" << file << "' for cluster config sync: Does not contain valid UTF8. Binary files are not supported.";
-			return;
-		}
+	return entry;
+}
 
-		update->Set(relativePath, content);
-	}
+/**
+ * Check whether the cached content of the given file is still the current one.
+ *
+ * The modification time has only a resolution of seconds on some platforms.
+ * So entries of files modified within the second they were read are never
+ * considered up to date, another modification within that second wouldn't be noticed.
+ *
+ * @param file Full file name.
+ * @returns Whether the entry can be used instead of reading the file.
+ */
+bool ApiListener::ConfigFileCacheEntry::IsUpToDate(const String& file) const
+{
+	if (Mtime >= CachedAt)
+		return false;
 
-	/* Calculate a checksum for each file (and a global one later).
-	 *
-	 * IMPORTANT: Ignore the .authoritative file above, this must not be synced.
-	 * */
-	config.Checksums->Set(relativePath, GetChecksum(content));
+	struct stat statbuf;
+
+	if (stat(file.CStr(), &statbuf) < 0)
+		return false;
+
+	return statbuf.st_mtime == Mtime && statbuf.st_size == Size;
 }
 
 /**
@@ -6,8 +6,11 @@
 #include "remote/endpoint.hpp"
 #include "remote/jsonrpc.hpp"
 #include "remote/apifunction.hpp"
+#include "remote/duplicatemessagefilter.hpp"
 #include "remote/configpackageutility.hpp"
 #include "remote/configobjectutility.hpp"
+#include "remote/eventqueue.hpp"
+#include "remote/relaybatch.hpp"
 #include "base/atomic-file.hpp"
 #include "base/convert.hpp"
 #include "base/defer.hpp"
@@ -34,6 +37,8 @@
 #include <boost/regex.hpp>
 #include <boost/system/error_code.hpp>
 #include <boost/thread/locks.hpp>
+#include <algorithm>
+#include <array>
 #include <climits>
 #include <cstdint>
 #include <fstream>
@@ -209,6 +214,8 @@ void ApiListener::UpdateSSLContext()
 {
 	auto ctx (SetupSslContext(GetDefaultCertPath(), GetDefaultKeyPath(), GetDefaultCaPath(), GetCrlPath(), GetCipherList(), GetTlsProtocolmin(), GetDebugInfo()));
 
+	SetSessionResumptionToSSLContext(ctx, GetTlsSessionResumption(), GetTlsSessionTickets(), GetTlsSessionTimeout());
+
 	{
 		boost::unique_lock<decltype(m_SSLContextMutex)> lock (m_SSLContextMutex);
 
@@ -498,8 +505,6 @@ void ApiListener::ListenerCoroutineProc(boost::asio::yield_context yc, const Sha
 {
 	namespace asio = boost::asio;
 
-	auto& io (IoEngine::Get().GetIoContext());
-
 	time_t lastModified = -1;
 	const String crlPath = GetCrlPath();
 
@@ -509,6 +514,8 @@ void ApiListener::ListenerCoroutineProc(boost::asio::yield_context yc, const Sha
 
 	for (;;) {
 		try {
+			/* Everything of the new connection runs on its own io_context. */
+			auto& io (IoEngine::Get().GetConnectionIoContext());
 			asio::ip::tcp::socket socket (io);
 
 			server->async_accept(socket.lowest_layer(), yc);
@@ -569,7 +576,7 @@ void ApiListener::AddConnection(const Endpoint::Ptr& endpoint)
 		return;
 	}
 
-	auto& io (IoEngine::Get().GetIoContext());
+	auto& io (IoEngine::Get().GetConnectionIoContext());
 	auto strand (Shared<asio::io_context::strand>::Make(io));
 
 	IoEngine::SpawnCoroutine(*strand, [this, strand, endpoint, &io](asio::yield_context yc) {
@@ -645,6 +652,9 @@ static const auto l_AppVersionInt (([]() -> unsigned long {
 
 static const auto l_MyCapabilities (
 	(uint_fast64_t)ApiCapabilities::ExecuteArbitraryCommand | (uint_fast64_t)ApiCapabilities::IfwApiCheckCommand
+	| (uint_fast64_t)ApiCapabilities::BinaryMessages | (uint_fast64_t)ApiCapabilities::EventBatches
+	| (uint_fast64_t)ApiCapabilities::RuntimeObjectManifests | (uint_fast64_t)ApiCapabilities::ScheduledChecks
+	| (uint_fast64_t)ApiCapabilities::CompressedMessages
 );
 
 /**
@@ -712,6 +722,8 @@ void ApiListener::NewClientHandlerInternal(
 		return;
 	}
 
+	(SSL_session_reused(sslConn.native_handle()) ? m_ResumedTlsHandshakes : m_FullTlsHandshakes).fetch_add(1);
+
 	bool willBeShutDown = false;
 
 	Defer shutDownIfNeeded ([&sslConn, &willBeShutDown, &yc]() {
@@ -849,7 +861,7 @@ void ApiListener::NewClientHandlerInternal(
 			return;
 		}
 
-		JsonRpcConnection::Ptr aclient = new JsonRpcConnection(identity, verify_ok, client, role);
+		JsonRpcConnection::Ptr aclient = new JsonRpcConnection(identity, verify_ok, client, role, strand->context());
 
 		if (endpoint) {
 			endpoint->AddClient(aclient);
@@ -873,7 +885,7 @@ void ApiListener::NewClientHandlerInternal(
 	} else {
 		Log(LogNotice, "ApiListener", "New HTTP client");
 
-		HttpServerConnection::Ptr aclient = new HttpServerConnection(identity, verify_ok, client);
+		HttpServerConnection::Ptr aclient = new HttpServerConnection(identity, verify_ok, client, strand->context());
 		AddHttpClient(aclient);
 		aclient->Start();
 
@@ -994,6 +1006,7 @@ void ApiListener::ApiTimerHandler()
 			Log(LogNotice, "ApiListener")
 				<< "Removing old log file: " << path;
 			(void)unlink(path.CStr());
+			(void)unlink((path + ".idx").CStr());
 		}
 	}
 
@@ -1023,7 +1036,7 @@ void ApiListener::ApiTimerHandler()
 
 		for (const JsonRpcConnection::Ptr& client : endpoint->GetClients()) {
 			if (client->GetTimestamp() == maxTs) {
-				client->SendMessage(lmessage);
+				client->SendMessage(lmessage, JsonRpcPriorityControl);
 			} else {
 				client->Disconnect();
 			}
@@ -1141,19 +1154,29 @@ void ApiListener::RelayMessage(const MessageOrigin::Ptr& origin,
 	if (!IsActive())
 		return;
 
+	if (RelayBatch::Add(origin, secobj, message, log))
+		return;
+
 	m_RelayQueue.Enqueue([this, origin, secobj, message, log]() { SyncRelayMessage(origin, secobj, message, log); }, PriorityNormal, true);
 }
 
-void ApiListener::PersistMessage(const Dictionary::Ptr& message, const ConfigObject::Ptr& secobj)
-{
-	double ts = message->Get("ts");
-
-	ASSERT(ts != 0);
+/**
+ * Every that many messages, the replay log's index gets an entry.
+ */
+static constexpr size_t l_LogIndexInterval = 1000;
 
+/**
+ * Encodes a message for the replay log, see ReplayLog().
+ *
+ * @return The JSON to be written as a netstring
+ */
+String ApiListener::MakeReplayLogEntry(EncodedMessage& message, const ConfigObject::Ptr& secobj)
+{
 	Dictionary::Ptr pmessage = new Dictionary();
-	pmessage->Set("timestamp", ts);
+	pmessage->Set("timestamp", message.GetMessage()->Get("ts"));
 
-	pmessage->Set("message", JsonEncode(message));
+	pmessage->Set("message", *message.Get(false));
+	pmessage->Set("method", message.GetMessage()->Get("method"));
 
 	if (secobj) {
 		Dictionary::Ptr secname = new Dictionary();
@@ -1162,9 +1185,26 @@ void ApiListener::PersistMessage(const Dictionary::Ptr& message, const ConfigObj
 		pmessage->Set("secobj", secname);
 	}
 
+	return JsonEncode(pmessage);
+}
+
+void ApiListener::PersistMessage(EncodedMessage& message, const ConfigObject::Ptr& secobj)
+{
+	double ts = message.GetMessage()->Get("ts");
+
+	ASSERT(ts != 0);
+
+	String entry = MakeReplayLogEntry(message, secobj);
+
 	std::unique_lock<std::mutex> lock(m_LogLock);
 	if (m_LogFile) {
-		NetString::WriteStringToStream(m_LogFile, JsonEncode(pmessage));
+		if (m_LogMessageCount % l_LogIndexInterval == 0) {
+			/* All messages before this offset are not newer than the last one written. */
+			std::ofstream index ((GetApiDir() + "log/current.idx").CStr(), std::ofstream::out | std::ofstream::app);
+			index << std::fixed << GetLogMessageTimestamp() << " " << m_LogFileOffset << "\n";
+		}
+
+		m_LogFileOffset += NetString::WriteStringToStream(m_LogFile, entry);
 		m_LogMessageCount++;
 		SetLogMessageTimestamp(ts);
 
@@ -1177,12 +1217,19 @@ void ApiListener::PersistMessage(const Dictionary::Ptr& message, const ConfigObj
 }
 
 void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message)
+{
+	EncodedMessage encoded (message);
+
+	SyncSendMessage(endpoint, encoded);
+}
+
+void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, EncodedMessage& message)
 {
 	ObjectLock olock(endpoint);
 
 	if (!endpoint->GetSyncing()) {
 		Log(LogNotice, "ApiListener")
-			<< "Sending message '" << message->Get("method") << "' to '" << endpoint->GetName() << "'";
+			<< "Sending message '" << message.GetMessage()->Get("method") << "' to '" << endpoint->GetName() << "'";
 
 		double maxTs = 0;
 
@@ -1195,7 +1242,7 @@ void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionar
 			if (client->GetTimestamp() != maxTs)
 				continue;
 
-			client->SendMessage(message);
+			client->SendRawMessage(message.Get(client->GetBinaryMessages()), JsonRpcPriorityState, message.GetMessage()->Get("method"));
 		}
 	}
 }
@@ -1211,7 +1258,7 @@ void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionar
  * @return true if the message has been relayed to all relevant endpoints,
  *         false if it hasn't and must be persisted in the replay log
  */
-bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrigin::Ptr& origin, const Dictionary::Ptr& message, const Endpoint::Ptr& currentZoneMaster)
+bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrigin::Ptr& origin, EncodedMessage& message, const Endpoint::Ptr& currentZoneMaster)
 {
 	ASSERT(targetZone);
 
@@ -1314,7 +1361,7 @@ bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrig
 	}
 
 	if (!skippedEndpoints.empty()) {
-		double ts = message->Get("ts");
+		double ts = message.GetMessage()->Get("ts");
 
 		for (const Endpoint::Ptr& skippedEndpoint : skippedEndpoints)
 			skippedEndpoint->SetLocalLogPosition(ts);
@@ -1349,15 +1396,18 @@ void ApiListener::SyncRelayMessage(const MessageOrigin::Ptr& origin,
 
 	Endpoint::Ptr master = GetMaster();
 
-	bool need_log = !RelayMessageOne(target_zone, origin, message, master);
+	/* From here on the message is encoded at most once per encoding, regardless of the number of endpoints. */
+	EncodedMessage encoded (message);
+
+	bool need_log = !RelayMessageOne(target_zone, origin, encoded, master);
 
 	for (const Zone::Ptr& zone : target_zone->GetAllParentsRaw()) {
-		if (!RelayMessageOne(zone, origin, message, master))
+		if (!RelayMessageOne(zone, origin, encoded, master))
 			need_log = true;
 	}
 
 	if (log && need_log)
-		PersistMessage(message, secobj);
+		PersistMessage(encoded, secobj);
 }
 
 /* must hold m_LogLock */
@@ -1375,6 +1425,15 @@ void ApiListener::OpenLogFile()
 		return;
 	}
 
+	fp->seekp(0, std::fstream::end);
+
+	std::streamoff offset = fp->tellp();
+	m_LogFileOffset = offset > 0 ? offset : 0;
+
+	/* An index without the messages it refers to would make ReplayLog() skip new ones. */
+	if (m_LogFileOffset == 0)
+		(void)unlink((path + ".idx").CStr());
+
 	m_LogFile = new StdioStream(fp.release(), true);
 	SetLogMessageTimestamp(Utility::GetTime());
 }
@@ -1406,6 +1465,9 @@ void ApiListener::RotateLogFile()
 		try {
 			Utility::RenameFile(oldpath, newpath);
 
+			if (Utility::PathExists(oldpath + ".idx"))
+				Utility::RenameFile(oldpath + ".idx", newpath + ".idx");
+
 			// We're rotating the current log file, so reset the log message counter as well.
 			m_LogMessageCount = 0;
 		} catch (const std::exception& ex) {
@@ -1434,6 +1496,32 @@ void ApiListener::LogGlobHandler(std::vector<int>& files, const String& file)
 	files.push_back(ts);
 }
 
+/**
+ * Looks up where to start reading a replay log file from in its index.
+ *
+ * @param file The replay log file
+ * @param ts Only messages newer than this timestamp are needed
+ *
+ * @return An offset before the first message newer than ts
+ */
+std::streamoff ApiListener::FindLogOffset(const String& file, double ts)
+{
+	std::ifstream index ((file + ".idx").CStr());
+	std::streamoff offset = 0;
+	double entryTs;
+	std::streamoff entryOffset;
+
+	/* The entries are sorted, a truncated last entry is just not read. */
+	while (index >> entryTs >> entryOffset) {
+		if (entryTs > ts)
+			break;
+
+		offset = entryOffset;
+	}
+
+	return offset;
+}
+
 void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 {
 	Endpoint::Ptr endpoint = client->GetEndpoint();
@@ -1497,6 +1585,25 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 			auto *fp = new std::fstream(file.second.CStr(), std::fstream::in | std::fstream::binary);
 			StdioStream::Ptr logStream = new StdioStream(fp, true);
 
+			std::streamoff offset = FindLogOffset(file.second, peer_ts);
+
+			if (offset > 0) {
+				fp->seekg(0, std::fstream::end);
+
+				std::streamoff size = fp->tellg();
+
+				if (size >= offset) {
+					Log(LogNotice, "ApiListener")
+						<< "Seeking to offset " << offset << " in log: " << file.second;
+
+					fp->seekg(offset);
+				} else {
+					fp->seekg(0);
+				}
+			}
+
+			int fileCount = 0;
+
 			String message;
 			StreamReadContext src;
 			while (true) {
@@ -1536,8 +1643,9 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 				}
 
 				try  {
-					client->SendRawMessage(pmessage->Get("message"));
+					client->SendRawMessage(pmessage->Get("message"), JsonRpcPriorityBulk, pmessage->Get("method"));
 					count++;
+					fileCount++;
 				} catch (const std::exception& ex) {
 					Log(LogWarning, "ApiListener")
 						<< "Error while replaying log for endpoint '" << endpoint->GetName() << "': " << DiagnosticInformation(ex, false);
@@ -1561,11 +1669,15 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 						}) }
 					});
 
-					client->SendMessage(lmessage);
+					/* Must not overtake the messages replayed so far. */
+					client->SendMessage(lmessage, JsonRpcPriorityBulk);
 				}
 			}
 
 			logStream->Close();
+
+			m_ReplayedMessages.fetch_add(fileCount);
+			m_ReplayedMessagesStats.InsertValue(Utility::GetTime(), fileCount);
 		}
 
 		if (count > 0) {
@@ -1680,12 +1792,110 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 	/* connection stats */
 	size_t jsonRpcAnonymousClients = GetAnonymousClients().size();
 	size_t httpClients = GetHttpClients().size();
+	double eventsDropped = EventsInbox::GetDroppedEvents();
 	size_t syncQueueItems = m_SyncQueue.GetLength();
 	size_t relayQueueItems = m_RelayQueue.GetLength();
 	double workQueueItemRate = JsonRpcConnection::GetWorkQueueRate();
 	double syncQueueItemRate = m_SyncQueue.GetTaskCount(60) / 60.0;
 	double relayQueueItemRate = m_RelayQueue.GetTaskCount(60) / 60.0;
 
+	/* replay log stats */
+	double replayedMessages = m_ReplayedMessages.load();
+	double duplicateMessages = DuplicateMessageFilter::GetDuplicates();
+	double fullTlsHandshakes = m_FullTlsHandshakes.load();
+	double resumedTlsHandshakes = m_ResumedTlsHandshakes.load();
+	Dictionary::Ptr tlsConnections = new Dictionary();
+
+	/* messages and bytes per JSON-RPC method, of all endpoints and per endpoint */
+	Dictionary::Ptr messagesByMethod = new Dictionary();
+	Dictionary::Ptr messagesByEndpoints = new Dictionary();
+
+	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
+		Dictionary::Ptr methods = endpoint->GetMessagesByMethod();
+
+		if (methods->GetLength() == 0)
+			continue;
+
+		messagesByEndpoints->Set(endpoint->GetName(), methods);
+
+		ObjectLock olock(methods);
+		for (const Dictionary::Pair& kv : methods) {
+			Dictionary::Ptr counters = kv.second;
+			Dictionary::Ptr sum = messagesByMethod->Get(kv.first);
+
+			if (!sum) {
+				messagesByMethod->Set(kv.first, counters->ShallowClone());
+				continue;
+			}
+
+			ObjectLock clock(counters);
+			for (const Dictionary::Pair& counter : counters) {
+				sum->Set(counter.first, sum->Get(counter.first) + counter.second);
+			}
+		}
+	}
+
+	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
+		ArrayData connections;
+
+		for (const JsonRpcConnection::Ptr& client : endpoint->GetClients()) {
+			connections.emplace_back(client->GetTlsStatus());
+		}
+
+		if (!connections.empty()) {
+			tlsConnections->Set(endpoint->GetName(), new Array(std::move(connections)));
+		}
+	}
+	double replayRate = m_ReplayedMessagesStats.UpdateAndGetValues(Utility::GetTime(), 60) / 60.0;
+	double syncingEndpoints = 0;
+	double replayBacklog = 0;
+
+	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
+		if (endpoint->GetConnected() && endpoint->GetSyncing()) {
+			syncingEndpoints++;
+			replayBacklog = std::max(replayBacklog, Utility::GetTime() - endpoint->GetLocalLogPosition());
+		}
+	}
+
+	/* outgoing message queue stats, per priority class of all connections */
+	std::array<size_t, JsonRpcPriorityCount> outgoingMessages {}, outgoingBytes {}, outgoingMaxBytes {};
+
+	auto addOutgoingQueues ([&outgoingMessages, &outgoingBytes, &outgoingMaxBytes](const JsonRpcConnection::Ptr& client) {
+		for (int i = 0; i < JsonRpcPriorityCount; i++) {
+			auto priority (static_cast<JsonRpcPriority>(i));
+			size_t bytes = client->GetOutgoingBytes(priority);
+
+			outgoingMessages[i] += client->GetOutgoingMessages(priority);
+			outgoingBytes[i] += bytes;
+			outgoingMaxBytes[i] = std::max(outgoingMaxBytes[i], bytes);
+		}
+	});
+
+	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
+		for (const JsonRpcConnection::Ptr& client : endpoint->GetClients()) {
+			addOutgoingQueues(client);
+		}
+	}
+
+	for (const JsonRpcConnection::Ptr& client : GetAnonymousClients()) {
+		addOutgoingQueues(client);
+	}
+
+	Dictionary::Ptr outgoingQueues = new Dictionary();
+
+	for (int i = 0; i < JsonRpcPriorityCount; i++) {
+		String priority = JsonRpcConnection::PriorityToString(static_cast<JsonRpcPriority>(i));
+
+		outgoingQueues->Set(priority, new Dictionary({
+			{ "messages", outgoingMessages[i] },
+			{ "bytes", outgoingBytes[i] },
+			{ "max_connection_bytes", outgoingMaxBytes[i] }
+		}));
+
+		perfdata->Set("num_json_rpc_outgoing_" + priority + "_messages", outgoingMessages[i]);
+		perfdata->Set("json_rpc_outgoing_" + priority + "_bytes", outgoingBytes[i]);
+	}
+
 	Dictionary::Ptr status = new Dictionary({
 		{ "identity", GetIdentity() },
 		{ "num_endpoints", allEndpoints },
@@ -1696,17 +1906,36 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 
 		{ "zones", connectedZones },
 
+		{ "io_contexts", IoEngine::Get().GetIoContextsStatus() },
+
+		{ "tls", new Dictionary({
+			{ "full_handshakes", fullTlsHandshakes },
+			{ "resumed_handshakes", resumedTlsHandshakes },
+			{ "connections", tlsConnections }
+		}) },
+
 		{ "json_rpc", new Dictionary({
 			{ "anonymous_clients", jsonRpcAnonymousClients },
 			{ "sync_queue_items", syncQueueItems },
 			{ "relay_queue_items", relayQueueItems },
 			{ "work_queue_item_rate", workQueueItemRate },
 			{ "sync_queue_item_rate", syncQueueItemRate },
-			{ "relay_queue_item_rate", relayQueueItemRate }
+			{ "relay_queue_item_rate", relayQueueItemRate },
+			{ "replayed_messages", replayedMessages },
+			{ "replay_rate", replayRate },
+			{ "replaying_endpoints", syncingEndpoints },
+			{ "replay_backlog", replayBacklog },
+			{ "outgoing_queues", outgoingQueues },
+			{ "duplicate_messages", duplicateMessages },
+			{ "duplicate_messages_by_endpoints", DuplicateMessageFilter::GetStatus() },
+			{ "messages_by_method", messagesByMethod },
+			{ "messages_by_method_by_endpoints", messagesByEndpoints }
 		}) },
 
 		{ "http", new Dictionary({
-			{ "clients", httpClients }
+			{ "clients", httpClients },
+			{ "events_dropped", eventsDropped },
+			{ "event_filters", EventsInbox::GetFilterStats() }
 		}) }
 	});
 
@@ -1717,6 +1946,7 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 
 	perfdata->Set("num_json_rpc_anonymous_clients", jsonRpcAnonymousClients);
 	perfdata->Set("num_http_clients", httpClients);
+	perfdata->Set("num_http_events_dropped", eventsDropped);
 	perfdata->Set("num_json_rpc_sync_queue_items", syncQueueItems);
 	perfdata->Set("num_json_rpc_relay_queue_items", relayQueueItems);
 
@@ -1724,6 +1954,15 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 	perfdata->Set("num_json_rpc_sync_queue_item_rate", syncQueueItemRate);
 	perfdata->Set("num_json_rpc_relay_queue_item_rate", relayQueueItemRate);
 
+	perfdata->Set("num_json_rpc_replayed_messages", replayedMessages);
+	perfdata->Set("num_json_rpc_replay_rate", replayRate);
+	perfdata->Set("num_json_rpc_replaying_endpoints", syncingEndpoints);
+	perfdata->Set("json_rpc_replay_backlog", replayBacklog);
+	perfdata->Set("num_json_rpc_duplicate_messages", duplicateMessages);
+
+	perfdata->Set("num_tls_full_handshakes", fullTlsHandshakes);
+	perfdata->Set("num_tls_resumed_handshakes", resumedTlsHandshakes);
+
 	return std::make_pair(status, perfdata);
 }
 
@@ -1790,6 +2029,10 @@ Value ApiListener::HelloAPIHandler(const MessageOrigin::Ptr& origin, const Dicti
 		auto client (origin->FromClient);
 
 		if (client) {
+			if ((uint_fast64_t)(double)params->Get("capabilities") & (uint_fast64_t)ApiCapabilities::BinaryMessages) {
+				client->EnableBinaryMessages();
+			}
+
 			auto endpoint (client->GetEndpoint());
 
 			if (endpoint) {
@@ -1798,6 +2041,11 @@ Value ApiListener::HelloAPIHandler(const MessageOrigin::Ptr& origin, const Dicti
 				endpoint->SetIcingaVersion(nodeVersion);
 				endpoint->SetCapabilities((double)params->Get("capabilities"));
 
+				if ((uint_fast64_t)(double)params->Get("capabilities") & (uint_fast64_t)ApiCapabilities::CompressedMessages
+					&& endpoint->GetCompressionLevel() > 0) {
+					client->EnableCompression(endpoint->GetCompressionLevel());
+				}
+
 				if (nodeVersion == 0u) {
 					nodeVersion = 21200;
 				}
@@ -1928,6 +2176,14 @@ void ApiListener::ValidateTlsHandshakeTimeout(const Lazy<double>& lvalue, const
 		BOOST_THROW_EXCEPTION(ValidationError(this, { "tls_handshake_timeout" }, "Value must be greater than 0."));
 }
 
+void ApiListener::ValidateTlsSessionTimeout(const Lazy<double>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ApiListener>::ValidateTlsSessionTimeout(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "tls_session_timeout" }, "Value must be at least 1s."));
+}
+
 bool ApiListener::IsHACluster()
 {
 	Zone::Ptr zone = Zone::GetLocalZone();
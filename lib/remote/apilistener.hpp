@@ -4,12 +4,14 @@
 #define APILISTENER_H
 
 #include "remote/apilistener-ti.hpp"
+#include "remote/jsonrpc.hpp"
 #include "remote/jsonrpcconnection.hpp"
 #include "remote/httpserverconnection.hpp"
 #include "remote/endpoint.hpp"
 #include "remote/messageorigin.hpp"
 #include "base/configobject.hpp"
 #include "base/process.hpp"
+#include "base/ringbuffer.hpp"
 #include "base/shared.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
@@ -17,14 +19,22 @@
 #include "base/tlsstream.hpp"
 #include "base/threadpool.hpp"
 #include <atomic>
+#include <condition_variable>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/spawn.hpp>
 #include <boost/asio/ssl/context.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <set>
+#include <sys/types.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace icinga
 {
@@ -69,6 +79,11 @@ enum class ApiCapabilities : uint_fast64_t
 {
 	ExecuteArbitraryCommand = 1u << 0u,
 	IfwApiCheckCommand = 1u << 1u,
+	BinaryMessages = 1u << 2u,
+	EventBatches = 1u << 3u,
+	RuntimeObjectManifests = 1u << 4u,
+	ScheduledChecks = 1u << 5u,
+	CompressedMessages = 1u << 6u,
 };
 
 /**
@@ -145,6 +160,9 @@ public:
 	static void ConfigUpdateObjectHandler(const ConfigObject::Ptr& object, const Value& cookie);
 	static Value ConfigUpdateObjectAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 	static Value ConfigDeleteObjectAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value ConfigUpdateObjectsAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value RuntimeObjectManifestAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value RequestRuntimeObjectsAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 
 	/* API config packages */
 	void SetActivePackageStage(const String& package, const String& stage);
@@ -158,6 +176,8 @@ public:
 	static bool IsHACluster();
 	static String GetFromZoneName(const Zone::Ptr& fromZone);
 
+	static String MakeReplayLogEntry(EncodedMessage& message, const ConfigObject::Ptr& secobj);
+
 	static String GetDefaultCertPath();
 	static String GetDefaultKeyPath();
 	static String GetDefaultCaPath();
@@ -179,6 +199,7 @@ protected:
 
 	void ValidateTlsProtocolmin(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
 	void ValidateTlsHandshakeTimeout(const Lazy<double>& lvalue, const ValidationUtils& utils) override;
+	void ValidateTlsSessionTimeout(const Lazy<double>& lvalue, const ValidationUtils& utils) override;
 
 private:
 	Shared<boost::asio::ssl::context>::Ptr m_SSLContext;
@@ -225,15 +246,23 @@ private:
 	std::mutex m_LogLock;
 	Stream::Ptr m_LogFile;
 	size_t m_LogMessageCount{0};
+	uint_fast64_t m_LogFileOffset{0};
+
+	std::atomic<uint_fast64_t> m_ReplayedMessages{0};
+	std::atomic<uint_fast64_t> m_FullTlsHandshakes{0};
+	std::atomic<uint_fast64_t> m_ResumedTlsHandshakes{0};
+	RingBuffer m_ReplayedMessagesStats{15 * 60};
 
-	bool RelayMessageOne(const Zone::Ptr& zone, const MessageOrigin::Ptr& origin, const Dictionary::Ptr& message, const Endpoint::Ptr& currentZoneMaster);
+	void SyncSendMessage(const Endpoint::Ptr& endpoint, EncodedMessage& message);
+	bool RelayMessageOne(const Zone::Ptr& zone, const MessageOrigin::Ptr& origin, EncodedMessage& message, const Endpoint::Ptr& currentZoneMaster);
 	void SyncRelayMessage(const MessageOrigin::Ptr& origin, const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
-	void PersistMessage(const Dictionary::Ptr& message, const ConfigObject::Ptr& secobj);
+	void PersistMessage(EncodedMessage& message, const ConfigObject::Ptr& secobj);
 
 	void OpenLogFile();
 	void RotateLogFile();
 	void CloseLogFile();
 	static void LogGlobHandler(std::vector<int>& files, const String& file);
+	static std::streamoff FindLogOffset(const String& file, double ts);
 	void ReplayLog(const JsonRpcConnection::Ptr& client);
 
 	static void CopyCertificateFile(const String& oldCertPath, const String& newCertPath);
@@ -244,6 +273,26 @@ private:
 	/* filesync */
 	static std::mutex m_ConfigSyncStageLock;
 
+	/**
+	 * A config sync file's content and checksum, reused until the file changes.
+	 */
+	struct ConfigFileCacheEntry
+	{
+		typedef std::shared_ptr<const ConfigFileCacheEntry> Ptr;
+
+		time_t CachedAt;
+		time_t Mtime;
+		off_t Size;
+		String Content;
+		String Checksum;
+		bool ValidUTF8;
+
+		bool IsUpToDate(const String& file) const;
+	};
+
+	static std::mutex m_ConfigFileCacheMutex;
+	static std::unordered_map<String, std::unordered_map<String, ConfigFileCacheEntry::Ptr>> m_ConfigFileCache;
+
 	void SyncLocalZoneDirs() const;
 	void SyncLocalZoneDir(const Zone::Ptr& zone) const;
 	void RenewOwnCert();
@@ -254,7 +303,7 @@ private:
 	static Dictionary::Ptr MergeConfigUpdate(const ConfigDirInformation& config);
 
 	static ConfigDirInformation LoadConfigDir(const String& dir);
-	static void ConfigGlobHandler(ConfigDirInformation& config, const String& path, const String& file);
+	static ConfigFileCacheEntry::Ptr ReadConfigFile(const String& file);
 
 	static void TryActivateZonesStage(const std::vector<String>& relativePaths);
 
@@ -270,6 +319,8 @@ private:
 	void DeleteConfigObject(const ConfigObject::Ptr& object, const MessageOrigin::Ptr& origin,
 		const JsonRpcConnection::Ptr& client = nullptr);
 	void SendRuntimeConfigObjects(const JsonRpcConnection::Ptr& aclient);
+	bool RequestRuntimeConfigObjects(const JsonRpcConnection::Ptr& aclient, const std::vector<ConfigObject::Ptr>& objects,
+		std::vector<ConfigObject::Ptr>& requested);
 
 	void SyncClient(const JsonRpcConnection::Ptr& aclient, const Endpoint::Ptr& endpoint, bool needSync);
 
@@ -280,6 +331,17 @@ private:
 	/* ensures that at most one create/update/delete is being processed per object at each time */
 	mutable ObjectNameMutex m_ObjectConfigChangeLock;
 
+	/* the objects an endpoint asked for in reply to our config::RuntimeObjectManifest messages */
+	struct RuntimeObjectRequest
+	{
+		size_t PendingManifests;
+		std::vector<std::pair<Type::Ptr, String>> Objects;
+	};
+
+	std::mutex m_RuntimeObjectRequestsMutex;
+	std::condition_variable m_RuntimeObjectRequestsCV;
+	std::map<JsonRpcConnection::Ptr, RuntimeObjectRequest> m_RuntimeObjectRequests;
+
 	void UpdateActivePackageStagesCache();
 };
 
@@ -2,26 +2,125 @@
 
 #include "remote/apiuser.hpp"
 #include "remote/apiuser-ti.cpp"
+#include "config/bytecode.hpp"
 #include "base/configtype.hpp"
 #include "base/base64.hpp"
+#include "base/initialize.hpp"
+#include "base/objectlock.hpp"
 #include "base/tlsutility.hpp"
 #include "base/utility.hpp"
+#include <mutex>
+#include <unordered_map>
 
 using namespace icinga;
 
 REGISTER_TYPE(ApiUser);
 
-ApiUser::Ptr ApiUser::GetByClientCN(const String& cn)
+/* The active API users by client_cn */
+static std::mutex l_ClientCNsMutex;
+static std::unordered_map<String, ApiUser::Ptr> l_ClientCNs;
+
+/**
+ * A verified Authorization header. Failures are cached, too, so that repeating a wrong password doesn't cost more.
+ */
+struct CachedAuthHeader
+{
+	ApiUser::Ptr User;
+	double Expires;
+};
+
+/* In seconds */
+static const double l_AuthHeaderTtl = 10;
+
+static LruCache<String, std::shared_ptr<const CachedAuthHeader>> l_AuthHeaders (4096);
+
+INITIALIZE_ONCE([]() {
+	ApiUser::OnPermissionsChanged.connect([](const ApiUser::Ptr& user, const Value&) { user->InvalidatePermissionChecks(); });
+
+	ApiUser::OnPasswordChanged.connect([](const ApiUser::Ptr&, const Value&) { l_AuthHeaders.Clear(); });
+
+	ApiUser::OnClientCNChanged.connect([](const ApiUser::Ptr& user, const Value&) {
+		if (user->IsActive())
+			user->UpdateClientCNIndex();
+	});
+});
+
+void ApiUser::Start(bool runtimeCreated)
 {
-	for (const ApiUser::Ptr& user : ConfigType::GetObjectsByType<ApiUser>()) {
-		if (user->GetClientCN() == cn)
-			return user;
+	ObjectImpl<ApiUser>::Start(runtimeCreated);
+
+	UpdateClientCNIndex();
+	l_AuthHeaders.Clear();
+}
+
+void ApiUser::Stop(bool runtimeRemoved)
+{
+	ObjectImpl<ApiUser>::Stop(runtimeRemoved);
+
+	UpdateClientCNIndex();
+	l_AuthHeaders.Clear();
+}
+
+/**
+ * (Re-)adds this user to the client_cn index if it's active, removes it otherwise.
+ */
+void ApiUser::UpdateClientCNIndex()
+{
+	String cn = GetClientCN();
+	bool active = IsActive();
+
+	std::unique_lock<std::mutex> lock (l_ClientCNsMutex);
+
+	for (auto it (l_ClientCNs.begin()); it != l_ClientCNs.end();) {
+		if (it->second == this && (!active || it->first != cn)) {
+			String oldCN = it->first;
+			it = l_ClientCNs.erase(it);
+
+			/* Several users may share a client_cn, another one takes over. */
+			for (const ApiUser::Ptr& user : ConfigType::GetObjectsByType<ApiUser>()) {
+				if (user != this && user->IsActive() && user->GetClientCN() == oldCN) {
+					l_ClientCNs.emplace(oldCN, user);
+					break;
+				}
+			}
+		} else {
+			++it;
+		}
 	}
 
-	return nullptr;
+	if (active && !cn.IsEmpty())
+		l_ClientCNs.emplace(cn, this);
+}
+
+ApiUser::Ptr ApiUser::GetByClientCN(const String& cn)
+{
+	std::unique_lock<std::mutex> lock (l_ClientCNsMutex);
+
+	auto it (l_ClientCNs.find(cn));
+
+	if (it == l_ClientCNs.end())
+		return nullptr;
+
+	return it->second;
 }
 
 ApiUser::Ptr ApiUser::GetByAuthHeader(const String& auth_header)
+{
+	double now = Utility::GetTime();
+
+	for (;;) {
+		auto cached (l_AuthHeaders.Get(auth_header, [&auth_header, now]() {
+			return std::make_shared<const CachedAuthHeader>(CachedAuthHeader{VerifyAuthHeader(auth_header), now + l_AuthHeaderTtl});
+		}));
+
+		if (cached->Expires >= now)
+			return cached->User;
+
+		l_AuthHeaders.Remove(auth_header);
+	}
+}
+
+ApiUser::Ptr ApiUser::VerifyAuthHeader(const String& auth_header)
 {
 	String::SizeType pos = auth_header.FindFirstOf(" ");
 	String username, password;
@@ -52,3 +151,62 @@ ApiUser::Ptr ApiUser::GetByAuthHeader(const String& auth_header)
 
 	return user;
 }
+
+/**
+ * Returns what FilterUtility::HasPermission() needs to know about the permissions for the required one.
+ *
+ * @param requiredPermission The lower case permission
+ */
+std::shared_ptr<const ApiUser::PermissionCheck> ApiUser::GetPermissionCheck(const String& requiredPermission)
+{
+	return m_PermissionChecks.Get(requiredPermission, [this, &requiredPermission]() {
+		return std::make_shared<const PermissionCheck>(ComputePermissionCheck(requiredPermission));
+	});
+}
+
+void ApiUser::InvalidatePermissionChecks()
+{
+	m_PermissionChecks.Clear();
+}
+
+ApiUser::PermissionCheck ApiUser::ComputePermissionCheck(const String& requiredPermission) const
+{
+	bool foundPermission = false;
+	std::unique_ptr<Expression> permissionFilter;
+
+	Array::Ptr permissions = GetPermissions();
+	if (permissions) {
+		ObjectLock olock(permissions);
+		for (const Value& item : permissions) {
+			String permission;
+			Function::Ptr filter;
+			if (item.IsObjectType<Dictionary>()) {
+				Dictionary::Ptr dict = item;
+				permission = dict->Get("permission");
+				filter = dict->Get("filter");
+			} else
+				permission = item;
+
+			permission = permission.ToLower();
+
+			if (!Utility::Match(permission, requiredPermission))
+				continue;
+
+			foundPermission = true;
+
+			if (filter) {
+				std::vector<std::unique_ptr<Expression> > args;
+				args.emplace_back(new GetScopeExpression(ScopeThis));
+				std::unique_ptr<Expression> indexer{new IndexerExpression(std::unique_ptr<Expression>(MakeLiteral(filter)), std::unique_ptr<Expression>(MakeLiteral("call")))};
+				FunctionCallExpression *fexpr = new FunctionCallExpression(std::move(indexer), std::move(args));
+
+				if (!permissionFilter)
+					permissionFilter.reset(fexpr);
+				else
+					permissionFilter = std::make_unique<LogicalOrExpression>(std::move(permissionFilter), std::unique_ptr<Expression>(fexpr));
+			}
+		}
+	}
+
+	return { foundPermission, BytecodeExpression::Compile(std::move(permissionFilter)).release() };
+}
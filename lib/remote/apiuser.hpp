@@ -5,6 +5,9 @@
 
 #include "remote/i2-remote.hpp"
 #include "remote/apiuser-ti.hpp"
+#include "config/expression.hpp"
+#include "base/lrucache.hpp"
+#include <memory>
 
 namespace icinga
 {
@@ -18,8 +21,34 @@ public:
 	DECLARE_OBJECT(ApiUser);
 	DECLARE_OBJECTNAME(ApiUser);
 
+	/**
+	 * Whether any of the permissions matches a required one and the filters of the matching ones (if any)
+	 * combined into one compiled expression.
+	 */
+	struct PermissionCheck
+	{
+		bool Found;
+		Expression::Ptr Filter;
+	};
+
 	static ApiUser::Ptr GetByClientCN(const String& cn);
 	static ApiUser::Ptr GetByAuthHeader(const String& auth_header);
+
+	std::shared_ptr<const PermissionCheck> GetPermissionCheck(const String& requiredPermission);
+	void InvalidatePermissionChecks();
+
+protected:
+	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
+
+private:
+	/* By required permission, these are computed once instead of for every request. */
+	LruCache<String, std::shared_ptr<const PermissionCheck>> m_PermissionChecks {256};
+
+	PermissionCheck ComputePermissionCheck(const String& requiredPermission) const;
+
+	void UpdateClientCNIndex();
+	static ApiUser::Ptr VerifyAuthHeader(const String& auth_header);
 };
 
 }
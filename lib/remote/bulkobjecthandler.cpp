@@ -0,0 +1,398 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/bulkobjecthandler.hpp"
+#include "remote/configobjectslock.hpp"
+#include "remote/configobjectutility.hpp"
+#include "remote/httputility.hpp"
+#include "remote/filterutility.hpp"
+#include "remote/relaybatch.hpp"
+#include "remote/zone.hpp"
+#include "base/configtype.hpp"
+#include "base/exception.hpp"
+#include "base/objectlock.hpp"
+#include "base/scriptframe.hpp"
+#include "config/expression.hpp"
+#include <map>
+#include <memory>
+
+using namespace icinga;
+
+REGISTER_URLHANDLER("/v1/objects/bulk", BulkObjectHandler);
+
+namespace {
+
+/**
+ * Resolves the type of a bulk request entry and checks the user's permission for it once per type.
+ */
+class BulkPermissions
+{
+public:
+	BulkPermissions(const ApiUser::Ptr& user, const String& operation)
+		: m_User(user), m_Operation(operation), m_FrameNS(new Namespace()), m_Frame(false, m_FrameNS)
+	{ }
+
+	/**
+	 * @return The type, if the user may apply the operation to objects of it at all
+	 */
+	Type::Ptr GetType(const Dictionary::Ptr& entry, String& error)
+	{
+		Type::Ptr type = Type::GetByName(entry->Get("type"));
+
+		if (!type || !ConfigObject::TypeInstance->IsAssignableFrom(type)) {
+			error = "Invalid type specified.";
+			return nullptr;
+		}
+
+		auto it (m_Filters.find(type.get()));
+
+		if (it == m_Filters.end()) {
+			std::unique_ptr<Expression> filter;
+			bool permitted = FilterUtility::HasPermission(m_User, "objects/" + m_Operation + "/" + type->GetName(), &filter);
+
+			it = m_Filters.emplace(type.get(), std::make_pair(permitted, std::move(filter))).first;
+		}
+
+		if (!it->second.first) {
+			error = "Missing permission 'objects/" + m_Operation + "/" + type->GetName() + "'.";
+			return nullptr;
+		}
+
+		return type;
+	}
+
+	/**
+	 * @return Whether the permission filter of the type (see GetType()) allows the object
+	 */
+	bool CanAccess(const ConfigObject::Ptr& object)
+	{
+		auto& filter (m_Filters.at(object->GetReflectionType().get()).second);
+
+		return FilterUtility::EvaluateFilter(m_Frame, filter.get(), object);
+	}
+
+private:
+	ApiUser::Ptr m_User;
+	String m_Operation;
+	Namespace::Ptr m_FrameNS;
+	ScriptFrame m_Frame;
+	std::map<Type *, std::pair<bool, std::unique_ptr<Expression>>> m_Filters;
+};
+
+}
+
+static Dictionary::Ptr BulkResult(const String& operation, const Dictionary::Ptr& entry, int code, const String& status,
+	const Array::Ptr& errors = nullptr)
+{
+	Dictionary::Ptr result = new Dictionary({
+		{ "operation", operation },
+		{ "type", entry->Get("type") },
+		{ "name", entry->Get("name") },
+		{ "code", code },
+		{ "status", status }
+	});
+
+	if (errors)
+		result->Set("errors", errors);
+
+	return result;
+}
+
+static Array::Ptr GetEntries(const Dictionary::Ptr& params, const String& operation)
+{
+	Value entries = params->Get(operation);
+
+	if (entries.IsEmpty())
+		return new Array();
+
+	if (!entries.IsObjectType<Array>())
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid type for '" + operation + "' attribute specified. Array type is required."));
+
+	Array::Ptr result = entries;
+	ObjectLock olock(result);
+
+	for (const Value& entry : result) {
+		if (!entry.IsObjectType<Dictionary>())
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid '" + operation + "' entry specified. Dictionary type is required."));
+	}
+
+	return result;
+}
+
+/**
+ * Returns the attributes of an object to create like CreateObjectHandler does, i.e. in the local zone by default.
+ *
+ * @throws std::invalid_argument if the entry's attributes have an invalid type
+ */
+Dictionary::Ptr BulkObjectHandler::GetCreateAttrs(const Dictionary::Ptr& entry, const Zone::Ptr& localZone)
+{
+	Value attrsVal = entry->Get("attrs");
+
+	if (!attrsVal.IsEmpty() && !attrsVal.IsObjectType<Dictionary>())
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid type for 'attrs' specified. Dictionary type is required."));
+
+	Dictionary::Ptr attrs = attrsVal;
+	attrs = attrs ? attrs->ShallowClone() : new Dictionary();
+
+	if (localZone && !attrs->Contains("zone"))
+		attrs->Set("zone", localZone->GetName());
+
+	Value groups = attrs->Get("groups");
+
+	if (!groups.IsEmpty()) {
+		if (!groups.IsObjectType<Array>())
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid type for 'groups' attribute specified. Array type is required."));
+
+		attrs->Set("groups", static_cast<Array::Ptr>(groups)->Unique());
+	}
+
+	return attrs;
+}
+
+/**
+ * Deletes, then creates and then modifies many objects in one request.
+ * All new objects are compiled and activated at once (or none of them) and the cluster gets their config in batches.
+ */
+bool BulkObjectHandler::HandleRequest(
+	AsioTlsStream& stream,
+	const ApiUser::Ptr& user,
+	boost::beast::http::request<boost::beast::http::string_body>& request,
+	const Url::Ptr& url,
+	boost::beast::http::response<boost::beast::http::string_body>& response,
+	const Dictionary::Ptr& params,
+	boost::asio::yield_context& yc,
+	HttpServerConnection& server
+)
+{
+	namespace http = boost::beast::http;
+
+	if (url->GetPath().size() != 3)
+		return false;
+
+	if (request.method() != http::verb::post)
+		return false;
+
+	Array::Ptr deletions, creations, modifications;
+
+	try {
+		deletions = GetEntries(params, "delete");
+		creations = GetEntries(params, "create");
+		modifications = GetEntries(params, "modify");
+	} catch (const std::exception& ex) {
+		HttpUtility::SendJsonError(response, params, 400, ex.what());
+		return true;
+	}
+
+	bool cascade = HttpUtility::GetLastParameter(params, "cascade");
+	bool verbose = HttpUtility::GetLastParameter(params, "verbose");
+	bool ignoreOnError = HttpUtility::GetLastParameter(params, "ignore_on_error");
+
+	ConfigObjectsSharedLock lock (std::try_to_lock);
+
+	if (!lock) {
+		HttpUtility::SendJsonError(response, params, 503, "Icinga is reloading");
+		return true;
+	}
+
+	/* Relays the config::DeleteObject and config::UpdateObject messages of the deletions and modifications in batches */
+	RelayBatch batch;
+
+	ArrayData results;
+	bool success = true;
+
+	auto getObject ([](const Type::Ptr& type, const Dictionary::Ptr& entry) -> ConfigObject::Ptr {
+		auto *ctype = dynamic_cast<ConfigType *>(type.get());
+
+		return ctype ? ctype->GetObject(entry->Get("name")) : nullptr;
+	});
+
+	{
+		BulkPermissions permissions (user, "delete");
+		ObjectLock olock(deletions);
+
+		for (const Dictionary::Ptr& entry : deletions) {
+			String error;
+			Type::Ptr type = permissions.GetType(entry, error);
+
+			if (!type) {
+				results.emplace_back(BulkResult("delete", entry, 403, error));
+				success = false;
+				continue;
+			}
+
+			ConfigObject::Ptr object = getObject(type, entry);
+
+			if (!object || !permissions.CanAccess(object)) {
+				results.emplace_back(BulkResult("delete", entry, 404, "No objects found."));
+				success = false;
+				continue;
+			}
+
+			Array::Ptr errors = new Array();
+			Array::Ptr diagnosticInformation = new Array();
+
+			if (ConfigObjectUtility::DeleteObject(object, cascade, errors, diagnosticInformation)) {
+				results.emplace_back(BulkResult("delete", entry, 200, "Object was deleted."));
+			} else {
+				Dictionary::Ptr result = BulkResult("delete", entry, 500, "Object could not be deleted.", errors);
+
+				if (verbose)
+					result->Set("diagnostic_information", diagnosticInformation);
+
+				results.emplace_back(std::move(result));
+				success = false;
+			}
+		}
+	}
+
+	{
+		BulkPermissions permissions (user, "create");
+		std::vector<NewConfigObject> newObjects;
+		std::vector<Dictionary::Ptr> newEntries;
+		Zone::Ptr localZone = Zone::GetLocalZone();
+		ObjectLock olock(creations);
+
+		for (const Dictionary::Ptr& entry : creations) {
+			String error;
+			Type::Ptr type = permissions.GetType(entry, error);
+
+			if (!type) {
+				results.emplace_back(BulkResult("create", entry, 403, error));
+				success = false;
+				continue;
+			}
+
+			Dictionary::Ptr attrs;
+
+			try {
+				attrs = GetCreateAttrs(entry, localZone);
+			} catch (const std::exception& ex) {
+				results.emplace_back(BulkResult("create", entry, 400, ex.what()));
+				success = false;
+				continue;
+			}
+
+			try {
+				newObjects.push_back({ type, entry->Get("name"),
+					ConfigObjectUtility::CreateObjectConfig(type, entry->Get("name"), ignoreOnError, entry->Get("templates"), attrs) });
+				newEntries.push_back(entry);
+			} catch (const std::exception& ex) {
+				Dictionary::Ptr result = BulkResult("create", entry, 500, "Object could not be created.",
+					new Array({ DiagnosticInformation(ex, false) }));
+
+				if (verbose)
+					result->Set("diagnostic_information", new Array({ DiagnosticInformation(ex) }));
+
+				results.emplace_back(std::move(result));
+				success = false;
+			}
+		}
+
+		Array::Ptr errors = new Array();
+		Array::Ptr diagnosticInformation = new Array();
+
+		if (ConfigObjectUtility::CreateObjects(newObjects, errors, diagnosticInformation)) {
+			for (size_t i = 0; i < newObjects.size(); i++) {
+				auto& entry (newEntries[i]);
+
+				if (getObject(newObjects[i].ObjectType, entry))
+					results.emplace_back(BulkResult("create", entry, 200, "Object was created"));
+				else
+					results.emplace_back(BulkResult("create", entry, 200, "Object was not created but 'ignore_on_error' was set to true"));
+			}
+		} else {
+			/* The whole batch failed and the errors may concern any of its objects. */
+			for (auto& entry : newEntries) {
+				Dictionary::Ptr result = BulkResult("create", entry, 500, "Object could not be created.", errors);
+
+				if (verbose)
+					result->Set("diagnostic_information", diagnosticInformation);
+
+				results.emplace_back(std::move(result));
+			}
+
+			success = false;
+		}
+	}
+
+	{
+		BulkPermissions permissions (user, "modify");
+		ObjectLock olock(modifications);
+
+		for (const Dictionary::Ptr& entry : modifications) {
+			String error;
+			Type::Ptr type = permissions.GetType(entry, error);
+
+			if (!type) {
+				results.emplace_back(BulkResult("modify", entry, 403, error));
+				success = false;
+				continue;
+			}
+
+			ConfigObject::Ptr object = getObject(type, entry);
+
+			if (!object || !permissions.CanAccess(object)) {
+				results.emplace_back(BulkResult("modify", entry, 404, "No objects found."));
+				success = false;
+				continue;
+			}
+
+			Value attrsVal = entry->Get("attrs");
+			Value restoreAttrsVal = entry->Get("restore_attrs");
+
+			if ((!attrsVal.IsEmpty() && !attrsVal.IsObjectType<Dictionary>()) || (!restoreAttrsVal.IsEmpty() && !restoreAttrsVal.IsObjectType<Array>())) {
+				results.emplace_back(BulkResult("modify", entry, 400, "Invalid type for 'attrs' (Dictionary) or 'restore_attrs' (Array) specified."));
+				success = false;
+				continue;
+			}
+
+			Dictionary::Ptr attrs = attrsVal;
+			Array::Ptr restoreAttrs = restoreAttrsVal;
+			String key;
+
+			/* Like ModifyObjectHandler */
+			try {
+				if (restoreAttrs) {
+					ObjectLock oLock (restoreAttrs);
+
+					for (auto& attr : restoreAttrs) {
+						key = attr;
+						object->RestoreAttribute(key);
+					}
+				}
+
+				if (attrs) {
+					ObjectLock oLock (attrs);
+
+					for (const Dictionary::Pair& kv : attrs) {
+						key = kv.first;
+						object->ModifyAttribute(kv.first, kv.second);
+					}
+				}
+			} catch (const std::exception& ex) {
+				Dictionary::Ptr result = BulkResult("modify", entry, 500, "Attribute '" + key + "' could not be set: " + DiagnosticInformation(ex, false));
+
+				if (verbose)
+					result->Set("diagnostic_information", DiagnosticInformation(ex));
+
+				results.emplace_back(std::move(result));
+				success = false;
+				continue;
+			}
+
+			results.emplace_back(BulkResult("modify", entry, 200, "Attributes updated."));
+		}
+	}
+
+	Dictionary::Ptr result = new Dictionary({
+		{ "results", new Array(std::move(results)) }
+	});
+
+	if (!success)
+		response.result(http::status::internal_server_error);
+	else
+		response.result(http::status::ok);
+
+	HttpUtility::SendJsonBody(response, params, result);
+
+	return true;
+}
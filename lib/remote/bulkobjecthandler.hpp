@@ -0,0 +1,33 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef BULKOBJECTHANDLER_H
+#define BULKOBJECTHANDLER_H
+
+#include "remote/httphandler.hpp"
+#include "remote/zone.hpp"
+
+namespace icinga
+{
+
+class BulkObjectHandler final : public HttpHandler
+{
+public:
+	DECLARE_PTR_TYPEDEFS(BulkObjectHandler);
+
+	bool HandleRequest(
+		AsioTlsStream& stream,
+		const ApiUser::Ptr& user,
+		boost::beast::http::request<boost::beast::http::string_body>& request,
+		const Url::Ptr& url,
+		boost::beast::http::response<boost::beast::http::string_body>& response,
+		const Dictionary::Ptr& params,
+		boost::asio::yield_context& yc,
+		HttpServerConnection& server
+	) override;
+
+	static Dictionary::Ptr GetCreateAttrs(const Dictionary::Ptr& entry, const Zone::Ptr& localZone);
+};
+
+}
+
+#endif /* BULKOBJECTHANDLER_H */
@@ -0,0 +1,474 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/configdeltautility.hpp"
+#include "remote/configobjectutility.hpp"
+#include "remote/apilistener.hpp"
+#include "config/configcompiler.hpp"
+#include "config/configcompilercontext.hpp"
+#include "base/configtype.hpp"
+#include "base/exception.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/netstring.hpp"
+#include "base/objectlock.hpp"
+#include "base/stdiostream.hpp"
+#include "base/tlsutility.hpp"
+#include "base/utility.hpp"
+#include <boost/algorithm/string/join.hpp>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+
+using namespace icinga;
+
+/**
+ * Reads all items of an objects file.
+ *
+ * @param path The objects file
+ * @return The items
+ */
+std::vector<Dictionary::Ptr> ConfigDeltaUtility::ReadObjectsFile(const String& path)
+{
+	std::fstream fp;
+	fp.open(path.CStr(), std::ios_base::in);
+
+	if (!fp)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Cannot open objects file '" + path + "'."));
+
+	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+	std::vector<Dictionary::Ptr> items;
+	String message;
+	StreamReadContext src;
+
+	for (;;) {
+		StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+		if (srs == StatusEof)
+			break;
+
+		if (srs != StatusNewItem)
+			continue;
+
+		items.emplace_back(JsonDecode(message));
+	}
+
+	sfp->Close();
+
+	return items;
+}
+
+/**
+ * Computes the content hash of an item. The source location is left out,
+ * so moving an object definition around doesn't count as a change.
+ *
+ * @param item The item as read from the objects file
+ * @return SHA256 of the item's properties
+ */
+String ConfigDeltaUtility::GetObjectHash(const Dictionary::Ptr& item)
+{
+	Dictionary::Ptr properties = item->Get("properties");
+
+	if (!properties)
+		return SHA256(String());
+
+	properties = properties->ShallowClone();
+	properties->Remove("source_location");
+
+	return SHA256(JsonEncode(properties));
+}
+
+/**
+ * Compares two object dumps by type, name and content hash.
+ *
+ * @param oldItems The items of the running configuration
+ * @param newItems The items of the new configuration
+ * @return The differences
+ */
+ConfigDelta ConfigDeltaUtility::ComputeDelta(const std::vector<Dictionary::Ptr>& oldItems, const std::vector<Dictionary::Ptr>& newItems)
+{
+	std::map<std::pair<String, String>, Dictionary::Ptr> oldByName;
+
+	for (const Dictionary::Ptr& item : oldItems)
+		oldByName.emplace(std::make_pair(item->Get("type"), item->Get("name")), item);
+
+	ConfigDelta delta;
+
+	for (const Dictionary::Ptr& item : newItems) {
+		auto it = oldByName.find(std::make_pair(item->Get("type"), item->Get("name")));
+
+		if (it == oldByName.end()) {
+			delta.Created.push_back(item);
+			continue;
+		}
+
+		if (GetObjectHash(it->second) != GetObjectHash(item))
+			delta.Modified.emplace_back(it->second, item);
+
+		oldByName.erase(it);
+	}
+
+	for (auto& kv : oldByName)
+		delta.Deleted.push_back(kv.second);
+
+	return delta;
+}
+
+/**
+ * Determines the top-level attributes which differ between two versions of an item.
+ *
+ * @param oldItem The item of the running configuration
+ * @param newItem The item of the new configuration
+ * @return The names of the changed attributes
+ */
+std::vector<String> ConfigDeltaUtility::GetChangedAttributes(const Dictionary::Ptr& oldItem, const Dictionary::Ptr& newItem)
+{
+	Dictionary::Ptr oldProperties = oldItem->Get("properties");
+	Dictionary::Ptr newProperties = newItem->Get("properties");
+
+	std::set<String> keys;
+
+	for (const Dictionary::Ptr& properties : { oldProperties, newProperties }) {
+		if (!properties)
+			continue;
+
+		ObjectLock olock(properties);
+
+		for (const Dictionary::Pair& kv : properties)
+			keys.insert(kv.first);
+	}
+
+	keys.erase("source_location");
+
+	std::vector<String> changed;
+
+	for (const String& key : keys) {
+		Value oldValue = oldProperties ? oldProperties->Get(key) : Empty;
+		Value newValue = newProperties ? newProperties->Get(key) : Empty;
+
+		if (JsonEncode(oldValue) != JsonEncode(newValue))
+			changed.push_back(key);
+	}
+
+	return changed;
+}
+
+/**
+ * Loggers, the application object and features (activation priority -50 and
+ * below or 50 and above) only read their configuration when they're started.
+ */
+bool ConfigDeltaUtility::CanReloadType(const Type::Ptr& type)
+{
+	int priority = type->GetActivationPriority();
+
+	return priority > -50 && priority < 50;
+}
+
+/**
+ * Functions can neither be compared nor recreated from an objects file.
+ */
+bool ConfigDeltaUtility::ContainsFunction(const Value& value)
+{
+	if (value.IsObjectType<Dictionary>()) {
+		Dictionary::Ptr dict = value;
+
+		if (dict->Get("type") == "Function")
+			return true;
+
+		ObjectLock olock(dict);
+
+		for (const Dictionary::Pair& kv : dict) {
+			if (ContainsFunction(kv.second))
+				return true;
+		}
+	} else if (value.IsObjectType<Array>()) {
+		Array::Ptr arr = value;
+		ObjectLock olock(arr);
+
+		for (const Value& item : arr) {
+			if (ContainsFunction(item))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Applies a delta to the running objects using the same code paths as the
+ * objects API. Objects owned by the `_api` package are left alone. Nothing is
+ * changed if a part of the delta is known not to be applicable at runtime,
+ * e.g. because it touches a feature or an attribute which can't be modified.
+ *
+ * @param delta The differences to apply
+ * @param errors Receives the reasons in case of failure
+ * @return Whether the delta was applied; if not, a full reload is required
+ */
+bool ConfigDeltaUtility::ApplyDelta(const ConfigDelta& delta, const Array::Ptr& errors)
+{
+	struct Modification
+	{
+		ConfigObject::Ptr Object;
+		Dictionary::Ptr Properties;
+		std::vector<String> Attributes;
+	};
+
+	std::vector<ConfigObject::Ptr> deletions;
+	std::vector<Modification> modifications;
+	std::vector<Dictionary::Ptr> creations;
+
+	auto getObject = [](const Dictionary::Ptr& item, Type::Ptr& type) -> ConfigObject::Ptr {
+		type = Type::GetByName(item->Get("type"));
+
+		auto *ctype = dynamic_cast<ConfigType *>(type.get());
+
+		if (!ctype)
+			return nullptr;
+
+		return ctype->GetObject(item->Get("name"));
+	};
+
+	auto getPackage = [](const Dictionary::Ptr& item) -> String {
+		Dictionary::Ptr properties = item->Get("properties");
+		return properties ? properties->Get("package") : Empty;
+	};
+
+	auto checkItem = [&errors](const Dictionary::Ptr& item, const Type::Ptr& type) {
+		String description = "Object '" + item->Get("name") + "' of type '" + item->Get("type") + "'";
+
+		if (!type) {
+			errors->Add(description + " has an unknown type.");
+			return false;
+		}
+
+		if (!CanReloadType(type)) {
+			errors->Add(description + " is only read at startup.");
+			return false;
+		}
+
+		if (ContainsFunction(item->Get("properties"))) {
+			errors->Add(description + " contains functions.");
+			return false;
+		}
+
+		return true;
+	};
+
+	for (const Dictionary::Ptr& item : delta.Deleted) {
+		Type::Ptr type;
+		ConfigObject::Ptr object = getObject(item, type);
+
+		if (!object || object->GetPackage() == "_api")
+			continue;
+
+		if (!CanReloadType(type)) {
+			errors->Add("Object '" + object->GetName() + "' of type '" + type->GetName() + "' is only read at startup.");
+			return false;
+		}
+
+		deletions.push_back(object);
+	}
+
+	for (auto& kv : delta.Modified) {
+		const Dictionary::Ptr& item = kv.second;
+
+		if (getPackage(item) == "_api")
+			continue;
+
+		Type::Ptr type;
+		ConfigObject::Ptr object = getObject(item, type);
+
+		if (!checkItem(item, type))
+			return false;
+
+		if (!object) {
+			creations.push_back(item);
+			continue;
+		}
+
+		Modification modification { object, item->Get("properties"), {} };
+
+		for (const String& attr : GetChangedAttributes(kv.first, item)) {
+			/* The list of imported templates is informational only. */
+			if (attr == "templates")
+				continue;
+
+			int fid = type->GetFieldId(attr);
+
+			if (fid < 0 || (type->GetFieldInfo(fid).Attributes & FANoUserModify)) {
+				errors->Add("Attribute '" + attr + "' of object '" + object->GetName() + "' of type '"
+					+ type->GetName() + "' can't be modified at runtime.");
+				return false;
+			}
+
+			modification.Attributes.push_back(attr);
+		}
+
+		if (!modification.Attributes.empty())
+			modifications.emplace_back(std::move(modification));
+	}
+
+	for (const Dictionary::Ptr& item : delta.Created) {
+		if (getPackage(item) == "_api")
+			continue;
+
+		Type::Ptr type;
+		ConfigObject::Ptr object = getObject(item, type);
+
+		if (!checkItem(item, type))
+			return false;
+
+		if (object) {
+			errors->Add("Object '" + object->GetName() + "' of type '" + type->GetName() + "' already exists.");
+			return false;
+		}
+
+		creations.push_back(item);
+	}
+
+	try {
+		for (const ConfigObject::Ptr& object : deletions) {
+			/* Skip objects which were already removed together with the objects they depend on. */
+			if (!object->IsActive())
+				continue;
+
+			if (!ConfigObjectUtility::DeleteObjectHelper(object, true, errors, nullptr))
+				return false;
+		}
+
+		for (const Modification& modification : modifications) {
+			const ConfigObject::Ptr& object = modification.Object;
+
+			for (const String& attr : modification.Attributes) {
+				Value value = modification.Properties->Get(attr);
+				Dictionary::Ptr originalAttributes = object->GetOriginalAttributes();
+
+				/* Keep modifications made through the API, but restore them to the new value. */
+				if (originalAttributes && originalAttributes->Contains(attr)) {
+					originalAttributes->Set(attr, value);
+					continue;
+				}
+
+				object->ModifyAttribute(attr, value, false);
+
+				/* This is the configured value now rather than a runtime modification. */
+				originalAttributes = object->GetOriginalAttributes();
+
+				if (originalAttributes)
+					originalAttributes->Remove(attr);
+			}
+
+			Log(LogInformation, "ConfigDeltaUtility")
+				<< "Modified attribute(s) '" << boost::algorithm::join(modification.Attributes, "', '")
+				<< "' of object '" << object->GetName() << "' of type '" << object->GetReflectionType()->GetName() << "'.";
+		}
+
+		if (!creations.empty()) {
+			std::vector<std::unique_ptr<Expression>> expressions;
+
+			for (const Dictionary::Ptr& item : creations) {
+				Type::Ptr type = Type::GetByName(item->Get("type"));
+				Dictionary::Ptr attrs = Dictionary::Ptr(item->Get("properties"))->ShallowClone();
+
+				for (const char *key : { "__name", "name", "source_location", "type" })
+					attrs->Remove(key);
+
+				String config = ConfigObjectUtility::CreateObjectConfig(type, item->Get("name"), false, nullptr, attrs);
+
+				String path = "<delta reload>";
+				Array::Ptr debugInfo = item->Get("debug_info");
+
+				if (debugInfo && debugInfo->GetLength() > 0)
+					path = debugInfo->Get(0);
+
+				expressions.emplace_back(ConfigCompiler::CompileText(path, config));
+			}
+
+			if (!ConfigObjectUtility::CommitObjects(expressions, "delta reload", errors, nullptr, Empty))
+				return false;
+
+			ApiListener::UpdateObjectAuthority();
+
+			Log(LogInformation, "ConfigDeltaUtility")
+				<< "Created and activated " << creations.size() << " object(s).";
+		}
+	} catch (const std::exception& ex) {
+		errors->Add(DiagnosticInformation(ex, false));
+		return false;
+	}
+
+	return true;
+}
+
+static String ReadFileContents(const String& path)
+{
+	std::ifstream fp(path.CStr(), std::ios_base::in | std::ios_base::binary);
+
+	if (!fp)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Cannot open file '" + path + "'."));
+
+	return String(std::istreambuf_iterator<char>(fp), std::istreambuf_iterator<char>());
+}
+
+/**
+ * Reloads only the objects which differ between the objects file of the
+ * running configuration and the one of a freshly validated configuration.
+ * On success the new files replace the old ones.
+ *
+ * @param objectsPath The objects file of the running configuration
+ * @param newObjectsPath The objects file of the new configuration
+ * @param varsPath The variables file of the running configuration
+ * @param newVarsPath The variables file of the new configuration
+ * @return Whether the objects were reloaded; if not, a full reload is required
+ */
+bool ConfigDeltaUtility::ReloadObjects(const String& objectsPath, const String& newObjectsPath,
+	const String& varsPath, const String& newVarsPath)
+{
+	double start = Utility::GetTime();
+
+	ConfigDelta delta;
+
+	try {
+		if (ReadFileContents(varsPath) != ReadFileContents(newVarsPath)) {
+			Log(LogInformation, "ConfigDeltaUtility", "Global variables changed, a full reload is required.");
+			return false;
+		}
+
+		delta = ComputeDelta(ReadObjectsFile(objectsPath), ReadObjectsFile(newObjectsPath));
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "ConfigDeltaUtility")
+			<< "Cannot compare the configurations: " << DiagnosticInformation(ex, false);
+		return false;
+	}
+
+	Log(LogInformation, "ConfigDeltaUtility")
+		<< "Reloading objects: " << delta.Created.size() << " created, " << delta.Modified.size()
+		<< " modified and " << delta.Deleted.size() << " deleted.";
+
+	Array::Ptr errors = new Array();
+
+	if (!ApplyDelta(delta, errors)) {
+		ObjectLock olock(errors);
+
+		for (const Value& error : errors) {
+			Log(LogWarning, "ConfigDeltaUtility")
+				<< "Cannot reload objects: " << error;
+		}
+
+		return false;
+	}
+
+	String newIndexPath = ConfigCompilerContext::GetObjectsIndexPath(newObjectsPath);
+
+	if (Utility::PathExists(newIndexPath))
+		Utility::RenameFile(newIndexPath, ConfigCompilerContext::GetObjectsIndexPath(objectsPath));
+
+	Utility::RenameFile(newObjectsPath, objectsPath);
+	Utility::RenameFile(newVarsPath, varsPath);
+
+	Log(LogInformation, "ConfigDeltaUtility")
+		<< "Finished reloading objects in " << Utility::GetTime() - start << "s.";
+
+	return true;
+}
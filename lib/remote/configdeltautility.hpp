@@ -0,0 +1,52 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef CONFIGDELTAUTILITY_H
+#define CONFIGDELTAUTILITY_H
+
+#include "remote/i2-remote.hpp"
+#include "base/array.hpp"
+#include "base/dictionary.hpp"
+#include "base/type.hpp"
+#include <utility>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * The differences between two object dumps as written by `--dump-objects`.
+ *
+ * @ingroup remote
+ */
+struct ConfigDelta
+{
+	std::vector<Dictionary::Ptr> Created; /**< Items of the new dump without a counterpart. */
+	std::vector<std::pair<Dictionary::Ptr, Dictionary::Ptr>> Modified; /**< Old and new items with different properties. */
+	std::vector<Dictionary::Ptr> Deleted; /**< Items of the old dump without a counterpart. */
+};
+
+/**
+ * Helper functions for reloading only the objects which changed.
+ *
+ * @ingroup remote
+ */
+class ConfigDeltaUtility
+{
+public:
+	static std::vector<Dictionary::Ptr> ReadObjectsFile(const String& path);
+	static String GetObjectHash(const Dictionary::Ptr& item);
+	static ConfigDelta ComputeDelta(const std::vector<Dictionary::Ptr>& oldItems, const std::vector<Dictionary::Ptr>& newItems);
+	static std::vector<String> GetChangedAttributes(const Dictionary::Ptr& oldItem, const Dictionary::Ptr& newItem);
+
+	static bool ApplyDelta(const ConfigDelta& delta, const Array::Ptr& errors);
+	static bool ReloadObjects(const String& objectsPath, const String& newObjectsPath,
+		const String& varsPath, const String& newVarsPath);
+
+private:
+	static bool CanReloadType(const Type::Ptr& type);
+	static bool ContainsFunction(const Value& value);
+};
+
+}
+
+#endif /* CONFIGDELTAUTILITY_H */
@@ -3,10 +3,13 @@
 #include "remote/configobjectutility.hpp"
 #include "remote/configpackageutility.hpp"
 #include "remote/apilistener.hpp"
+#include "remote/relaybatch.hpp"
 #include "config/configcompiler.hpp"
 #include "config/configitem.hpp"
 #include "base/atomic-file.hpp"
 #include "base/configwriter.hpp"
+#include "base/convert.hpp"
+#include "base/defer.hpp"
 #include "base/exception.hpp"
 #include "base/dependencygraph.hpp"
 #include "base/tlsutility.hpp"
@@ -15,6 +18,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/system/error_code.hpp>
 #include <fstream>
+#include <set>
 #include <utility>
 
 using namespace icinga;
@@ -145,10 +149,12 @@ String ConfigObjectUtility::CreateObjectConfig(const Type::Ptr& type, const Stri
 	Dictionary::Ptr allAttrs = new Dictionary();
 
 	if (attrs) {
-		attrs->CopyTo(allAttrs);
+		/* Check and write the same attributes, even if the caller modifies them meanwhile. */
+		Dictionary::Ptr attrsSnapshot = attrs->Snapshot();
 
-		ObjectLock olock(attrs);
-		for (const Dictionary::Pair& kv : attrs) {
+		attrsSnapshot->CopyTo(allAttrs);
+
+		for (const Dictionary::Pair& kv : attrsSnapshot) {
 			int fid = type->GetFieldId(kv.first.SubStr(0, kv.first.FindFirstOf(".")));
 
 			if (fid < 0)
@@ -216,57 +222,11 @@ bool ConfigObjectUtility::CreateObject(const Type::Ptr& type, const String& full
 	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText(path, config, String(), "_api");
 
 	try {
-		ActivationScope ascope;
-
-		ScriptFrame frame(true);
-		expr->Evaluate(frame);
-		expr.reset();
-
-		WorkQueue upq;
-		upq.SetName("ConfigObjectUtility::CreateObject");
-
-		std::vector<ConfigItem::Ptr> newItems;
-
-		/*
-		 * Disable logging for object creation, but do so ourselves later on.
-		 * Duplicate the error handling for better logging and debugging here.
-		 */
-		if (!ConfigItem::CommitItems(ascope.GetContext(), upq, newItems, true)) {
-			if (errors) {
-				Log(LogNotice, "ConfigObjectUtility")
-					<< "Failed to commit config item '" << fullName << "'.";
-
-				for (const boost::exception_ptr& ex : upq.GetExceptions()) {
-					errors->Add(DiagnosticInformation(ex, false));
-
-					if (diagnosticInformation)
-						diagnosticInformation->Add(DiagnosticInformation(ex));
-				}
-			}
-
-			return false;
-		}
-
-		/*
-		 * Activate the config object.
-		 * uq, items, runtimeCreated, silent, withModAttrs, cookie
-		 * IMPORTANT: Forward the cookie aka origin in order to prevent sync loops in the same zone!
-		 */
-		if (!ConfigItem::ActivateItems(newItems, true, false, false, cookie)) {
-			if (errors) {
-				Log(LogNotice, "ConfigObjectUtility")
-					<< "Failed to activate config object '" << fullName << "'.";
-
-				for (const boost::exception_ptr& ex : upq.GetExceptions()) {
-					errors->Add(DiagnosticInformation(ex, false));
-
-					if (diagnosticInformation)
-						diagnosticInformation->Add(DiagnosticInformation(ex));
-				}
-			}
+		std::vector<std::unique_ptr<Expression>> expressions;
+		expressions.emplace_back(std::move(expr));
 
+		if (!CommitObjects(expressions, fullName, errors, diagnosticInformation, cookie))
 			return false;
-		}
 
 		/* if (type != Comment::TypeInstance && type != Downtime::TypeInstance)
 		 * Does not work since this would require libicinga, which has a dependency on libremote
@@ -303,6 +263,210 @@ bool ConfigObjectUtility::CreateObject(const Type::Ptr& type, const String& full
 	return true;
 }
 
+/**
+ * Creates many objects at once. Unlike CreateObject() for each of them, they're all compiled, committed
+ * (with the apply rules evaluated once) and activated together and relayed to the cluster in batches.
+ * Either all of them are created or none.
+ *
+ * @param objects The objects with their config as returned by CreateObjectConfig()
+ * @param errors Receives the error messages
+ * @param diagnosticInformation Receives the diagnostic information for the errors
+ * @param cookie Origin of the change to prevent sync loops
+ * @return Whether all objects were created (or ignored due to errors)
+ */
+bool ConfigObjectUtility::CreateObjects(const std::vector<NewConfigObject>& objects, const Array::Ptr& errors,
+	const Array::Ptr& diagnosticInformation, const Value& cookie)
+{
+	if (objects.empty())
+		return true;
+
+	CreateStorage();
+
+	std::vector<String> paths;
+	std::vector<std::unique_ptr<Expression>> expressions;
+	bool updateAuthority = false;
+
+	for (const NewConfigObject& object : objects) {
+		auto configType (dynamic_cast<ConfigType*>(object.ObjectType.get()));
+
+		if (configType && configType->GetObject(object.Name)) {
+			errors->Add("Object '" + object.Name + "' already exists.");
+			return false;
+		}
+
+		String path;
+
+		try {
+			path = ComputeNewObjectConfigPath(object.ObjectType, object.Name);
+		} catch (const std::exception& ex) {
+			errors->Add("Config package broken: " + DiagnosticInformation(ex, false));
+			return false;
+		}
+
+		/* Like CreateObject(), just without the file which is only written once the object has been activated. */
+		expressions.emplace_back(ConfigCompiler::CompileText(path, object.Config, String(), "_api"));
+		paths.emplace_back(std::move(path));
+
+		if (object.ObjectType->GetName() != "Comment" && object.ObjectType->GetName() != "Downtime")
+			updateAuthority = true;
+	}
+
+	std::vector<ConfigObject::Ptr> created;
+
+	try {
+		if (!CommitObjects(expressions, Convert::ToString(objects.size()) + " objects", errors, diagnosticInformation, cookie, &created))
+			return false;
+
+		if (updateAuthority)
+			ApiListener::UpdateObjectAuthority();
+	} catch (const std::exception& ex) {
+		if (errors)
+			errors->Add(DiagnosticInformation(ex, false));
+
+		if (diagnosticInformation)
+			diagnosticInformation->Add(DiagnosticInformation(ex));
+
+		return false;
+	}
+
+	std::set<String> dirs;
+	AtomicFileGroup files;
+
+	for (size_t i = 0; i < objects.size(); i++) {
+		auto *ctype = dynamic_cast<ConfigType *>(objects[i].ObjectType.get());
+
+		// Not created but ignored due to errors
+		if (!ctype || !ctype->GetObject(objects[i].Name))
+			continue;
+
+		String dir = Utility::DirName(paths[i]);
+
+		if (dirs.insert(dir).second)
+			Utility::MkDirP(dir, 0700);
+
+		try {
+			files.Add(paths[i], 0644, objects[i].Config);
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "ConfigObjectUtility")
+				<< "Cannot write config file of object '" << objects[i].Name << "', it won't survive a restart: "
+				<< DiagnosticInformation(ex, false);
+		}
+	}
+
+	/* One sync for all files instead of one per object */
+	try {
+		files.Commit();
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "ConfigObjectUtility")
+			<< "Cannot write the config files of " << files.GetLength() << " object(s), they won't survive a restart: "
+			<< DiagnosticInformation(ex, false);
+	}
+
+	{
+		/* One event::Batch per zone instead of one config::UpdateObject per object (if all endpoints support it) */
+		RelayBatch batch;
+
+		for (const ConfigObject::Ptr& object : created)
+			ApiListener::ConfigUpdateObjectHandler(object, cookie);
+	}
+
+	Log(LogInformation, "ConfigObjectUtility")
+		<< "Created and activated " << created.size() << " object(s).";
+
+	return true;
+}
+
+/**
+ * Evaluates the given config expressions, then commits and activates the
+ * resulting config items.
+ *
+ * @param expressions The expressions to evaluate
+ * @param name The name to use in log messages
+ * @param errors Receives the error messages
+ * @param diagnosticInformation Receives the diagnostic information for the errors
+ * @param cookie Origin of the change to prevent sync loops
+ * @param deferredSync If given, receives the new objects. Their activation isn't synced to the cluster, the caller has to.
+ * @return Whether all items were committed and activated
+ */
+bool ConfigObjectUtility::CommitObjects(std::vector<std::unique_ptr<Expression>>& expressions, const String& name,
+	const Array::Ptr& errors, const Array::Ptr& diagnosticInformation, const Value& cookie,
+	std::vector<ConfigObject::Ptr> *deferredSync)
+{
+	ActivationScope ascope;
+
+	for (auto& expr : expressions) {
+		ScriptFrame frame(true);
+		expr->Evaluate(frame);
+		expr.reset();
+	}
+
+	TaskGroup upq ("ConfigObjectUtility::CreateObject");
+
+	std::vector<ConfigItem::Ptr> newItems;
+
+	/*
+	 * Disable logging for object creation, but do so ourselves later on.
+	 * Duplicate the error handling for better logging and debugging here.
+	 */
+	if (!ConfigItem::CommitItems(ascope.GetContext(), upq, newItems, true)) {
+		if (errors) {
+			Log(LogNotice, "ConfigObjectUtility")
+				<< "Failed to commit config item '" << name << "'.";
+
+			for (const boost::exception_ptr& ex : upq.GetExceptions()) {
+				errors->Add(DiagnosticInformation(ex, false));
+
+				if (diagnosticInformation)
+					diagnosticInformation->Add(DiagnosticInformation(ex));
+			}
+		}
+
+		return false;
+	}
+
+	if (deferredSync) {
+		for (const ConfigItem::Ptr& item : newItems) {
+			ConfigObject::Ptr object = item->GetObject();
+
+			if (object) {
+				/* See ApiListener::ConfigUpdateObjectHandler() */
+				object->SetExtension("ConfigObjectSyncDeferred", true);
+				deferredSync->emplace_back(std::move(object));
+			}
+		}
+	}
+
+	Defer syncNormally ([deferredSync]() {
+		if (deferredSync) {
+			for (const ConfigObject::Ptr& object : *deferredSync)
+				object->SetExtension("ConfigObjectSyncDeferred", Empty);
+		}
+	});
+
+	/*
+	 * Activate the config object.
+	 * uq, items, runtimeCreated, silent, withModAttrs, cookie
+	 * IMPORTANT: Forward the cookie aka origin in order to prevent sync loops in the same zone!
+	 */
+	if (!ConfigItem::ActivateItems(newItems, true, false, false, cookie)) {
+		if (errors) {
+			Log(LogNotice, "ConfigObjectUtility")
+				<< "Failed to activate config object '" << name << "'.";
+
+			for (const boost::exception_ptr& ex : upq.GetExceptions()) {
+				errors->Add(DiagnosticInformation(ex, false));
+
+				if (diagnosticInformation)
+					diagnosticInformation->Add(DiagnosticInformation(ex));
+			}
+		}
+
+		return false;
+	}
+
+	return true;
+}
+
 bool ConfigObjectUtility::DeleteObjectHelper(const ConfigObject::Ptr& object, bool cascade,
 	const Array::Ptr& errors, const Array::Ptr& diagnosticInformation, const Value& cookie)
 {
@@ -8,10 +8,26 @@
 #include "base/configobject.hpp"
 #include "base/dictionary.hpp"
 #include "base/type.hpp"
+#include <memory>
+#include <vector>
 
 namespace icinga
 {
 
+class Expression;
+
+/**
+ * An object to be created by ConfigObjectUtility::CreateObjects()
+ *
+ * @ingroup remote
+ */
+struct NewConfigObject
+{
+	Type::Ptr ObjectType;
+	String Name;
+	String Config;
+};
+
 /**
  * Helper functions.
  *
@@ -33,11 +49,19 @@ public:
 	static bool CreateObject(const Type::Ptr& type, const String& fullName,
 		const String& config, const Array::Ptr& errors, const Array::Ptr& diagnosticInformation, const Value& cookie = Empty);
 
+	static bool CreateObjects(const std::vector<NewConfigObject>& objects, const Array::Ptr& errors,
+		const Array::Ptr& diagnosticInformation, const Value& cookie = Empty);
+
 	static bool DeleteObject(const ConfigObject::Ptr& object, bool cascade, const Array::Ptr& errors,
 		const Array::Ptr& diagnosticInformation, const Value& cookie = Empty);
 
 private:
+	friend class ConfigDeltaUtility;
+
 	static String EscapeName(const String& name);
+	static bool CommitObjects(std::vector<std::unique_ptr<Expression>>& expressions, const String& name,
+		const Array::Ptr& errors, const Array::Ptr& diagnosticInformation, const Value& cookie,
+		std::vector<ConfigObject::Ptr> *deferredSync = nullptr);
 	static bool DeleteObjectHelper(const ConfigObject::Ptr& object, bool cascade, const Array::Ptr& errors,
 		const Array::Ptr& diagnosticInformation, const Value& cookie = Empty);
 };
@@ -2,14 +2,21 @@
 
 #include "remote/configpackageutility.hpp"
 #include "remote/apilistener.hpp"
+#include "config/configcompiler.hpp"
+#include "config/configitem.hpp"
+#include "config/expression.hpp"
 #include "base/application.hpp"
 #include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/scriptframe.hpp"
 #include "base/utility.hpp"
+#include "base/taskgroup.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/regex.hpp>
 #include <algorithm>
 #include <cctype>
 #include <fstream>
+#include <sstream>
 
 using namespace icinga;
 
@@ -208,9 +215,33 @@ void ConfigPackageUtility::TryActivateStageCallback(const ProcessResult& pr, con
 	}
 }
 
+/**
+ * Validates a stage by spawning "icinga2 daemon --validate" or, if incremental,
+ * by compiling only the stage's files against the running config.
+ *
+ * The incremental validation replaces the objects of the package's active stage with the new stage's ones
+ * in a scratch ActivationContext, see ConfigItem::ValidateScratchItems(). It doesn't evaluate apply rules,
+ * so a stage which passes it is validated again by a separate process before it's activated. So are stages
+ * which contain anything but object and template definitions.
+ */
 void ConfigPackageUtility::AsyncTryActivateStage(const String& packageName, const String& stageName, bool activate, bool reload,
-	const Shared<Defer>::Ptr& resetPackageUpdates)
+	const Shared<Defer>::Ptr& resetPackageUpdates, bool incremental)
 {
+	if (incremental) {
+		Utility::QueueAsyncCallback([packageName, stageName, activate, reload, resetPackageUpdates]() {
+			ProcessResult pr;
+
+			if (!ValidateStageIncrementally(packageName, stageName, pr) || (activate && pr.ExitStatus == 0)) {
+				AsyncTryActivateStage(packageName, stageName, activate, reload, resetPackageUpdates);
+				return;
+			}
+
+			TryActivateStageCallback(pr, packageName, stageName, activate, reload, resetPackageUpdates);
+		});
+
+		return;
+	}
+
 	VERIFY(Application::GetArgC() >= 1);
 
 	// prepare arguments
@@ -240,6 +271,130 @@ void ConfigPackageUtility::AsyncTryActivateStage(const String& packageName, cons
 	});
 }
 
+/**
+ * Returns whether the compiled file only defines objects and templates. Evaluating these in the running
+ * process only registers their items, anything else could change the globals or take arbitrarily long.
+ */
+static bool IsDefinitionsOnly(const Expression *expression)
+{
+	/* Syntax errors are reported as such. */
+	if (dynamic_cast<const ThrowExpression *>(expression))
+		return true;
+
+	auto *statements (dynamic_cast<const DictExpression *>(expression));
+
+	if (!statements)
+		return false;
+
+	for (auto& statement : statements->GetExpressions()) {
+		auto *object (dynamic_cast<const ObjectExpression *>(statement.get()));
+
+		if (!object || !object->IsPlainDefinition())
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Validates a stage's files in the running process, see AsyncTryActivateStage().
+ *
+ * The items' bodies may only call functions which are safe for sandbox mode
+ * and are aborted after the reload timeout like the validation process.
+ *
+ * @param pr The result, like the one of "icinga2 daemon --validate"
+ * @return false if the stage has to be validated by a separate process
+ */
+bool ConfigPackageUtility::ValidateStageIncrementally(const String& packageName, const String& stageName, ProcessResult& pr)
+{
+	String stagePath = GetPackageDir() + "/" + packageName + "/" + stageName;
+	ActivationContext::Ptr context = new ActivationContext(packageName);
+	std::vector<IncludedFile> files;
+	std::vector<std::unique_ptr<Expression>> expressions;
+	std::vector<String> errors;
+
+	pr.PID = -1;
+	pr.ExecutionStart = Utility::GetTime();
+
+	double deadline = pr.ExecutionStart + Application::GetReloadTimeout();
+
+	Utility::GlobRecursive(stagePath + "/conf.d", "*.conf", [&files](const String& file) {
+		files.push_back({ file, "" });
+	}, GlobFile);
+
+	{
+		ActivationScope scope(context);
+
+		/* Like IncludeZoneDirRecursive(), only zones which are known by now */
+		Utility::Glob(stagePath + "/zones.d/*", [&files](const String& zonePath) {
+			String zoneName = Utility::BaseName(zonePath);
+
+			if (!ConfigItem::GetByTypeAndName(Type::GetByName("Zone"), zoneName))
+				return;
+
+			Utility::GlobRecursive(zonePath, "*.conf", [&files, &zoneName](const String& file) {
+				files.push_back({ file, zoneName });
+			}, GlobFile);
+		}, GlobDirectory);
+
+		for (auto& file : files) {
+			std::unique_ptr<Expression> expression;
+
+			try {
+				expression = ConfigCompiler::CompileFile(file.Path, file.Zone, packageName);
+			} catch (const std::exception& ex) {
+				errors.emplace_back(DiagnosticInformation(ex, false));
+				continue;
+			}
+
+			if (!IsDefinitionsOnly(expression.get())) {
+				Log(LogInformation, "ConfigPackageUtility")
+					<< "File '" << file.Path << "' of package '" << packageName << "' and stage '" << stageName
+					<< "' doesn't only define objects and templates, validating the stage with a separate process.";
+
+				return false;
+			}
+
+			expressions.emplace_back(std::move(expression));
+		}
+
+		for (auto& expression : expressions) {
+			try {
+				ScriptFrame frame(true);
+				frame.SafeCallsOnly = true;
+				frame.Deadline = deadline;
+				expression->Evaluate(frame);
+			} catch (const std::exception& ex) {
+				errors.emplace_back(DiagnosticInformation(ex, false));
+			}
+		}
+	}
+
+	if (errors.empty()) {
+		TaskGroup upq ("ConfigPackageUtility::ValidateStageIncrementally");
+
+		ConfigItem::ValidateScratchItems(context, upq, errors, deadline);
+	}
+
+	std::ostringstream output;
+
+	output << "Validated " << files.size() << " file(s) of stage '" << stageName << "' against the running configuration.\n";
+
+	for (auto& error : errors) {
+		output << "critical/config: " << error << "\n";
+	}
+
+	pr.ExecutionEnd = Utility::GetTime();
+	pr.ExitStatus = errors.empty() ? 0 : 1;
+	pr.Output = output.str();
+
+	Log(errors.empty() ? LogInformation : LogWarning, "ConfigPackageUtility")
+		<< "Incremental validation of package '" << packageName << "' and stage '" << stageName << "' finished with "
+		<< errors.size() << " error(s) in " << Utility::FormatDuration(pr.ExecutionEnd - pr.ExecutionStart) << ".";
+
+	return true;
+}
+
 void ConfigPackageUtility::DeleteStage(const String& packageName, const String& stageName)
 {
 	String path = GetPackageDir() + "/" + packageName + "/" + stageName;
@@ -40,7 +40,7 @@ public:
 	static void SetActiveStageToFile(const String& packageName, const String& stageName);
 	static void ActivateStage(const String& packageName, const String& stageName);
 	static void AsyncTryActivateStage(const String& packageName, const String& stageName, bool activate, bool reload,
-		const Shared<Defer>::Ptr& resetPackageUpdates);
+		const Shared<Defer>::Ptr& resetPackageUpdates, bool incremental = false);
 
 	static std::vector<std::pair<String, bool> > GetFiles(const String& packageName, const String& stageName);
 
@@ -64,6 +64,7 @@ private:
 
 	static void TryActivateStageCallback(const ProcessResult& pr, const String& packageName, const String& stageName, bool activate,
 		bool reload, const Shared<Defer>::Ptr& resetPackageUpdates);
+	static bool ValidateStageIncrementally(const String& packageName, const String& stageName, ProcessResult& pr);
 
 	static bool ValidateFreshName(const String& name);
 };
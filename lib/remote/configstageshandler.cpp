@@ -120,6 +120,11 @@ void ConfigStagesHandler::HandlePost(
 	if (params->Contains("activate"))
 		activate = HttpUtility::GetLastParameter(params, "activate");
 
+	String validation = "full";
+
+	if (params->Contains("validation"))
+		validation = HttpUtility::GetLastParameter(params, "validation");
+
 	Dictionary::Ptr files = params->Get("files");
 
 	String stageName;
@@ -131,6 +136,9 @@ void ConfigStagesHandler::HandlePost(
 		if (reload && !activate)
 			BOOST_THROW_EXCEPTION(std::invalid_argument("Parameter 'reload' must be false when 'activate' is false."));
 
+		if (validation != "full" && validation != "incremental")
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Parameter 'validation' must be 'full' or 'incremental'."));
+
 		if (m_RunningPackageUpdates.exchange(true)) {
 			return HttpUtility::SendJsonError(response, params, 423,
 				"Conflicting request, there is already an ongoing package update in progress. Please try it again later.");
@@ -143,7 +151,8 @@ void ConfigStagesHandler::HandlePost(
 		stageName = ConfigPackageUtility::CreateStage(packageName, files);
 
 		/* validate the config. on success, activate stage and reload */
-		ConfigPackageUtility::AsyncTryActivateStage(packageName, stageName, activate, reload, resetPackageUpdates);
+		ConfigPackageUtility::AsyncTryActivateStage(packageName, stageName, activate, reload, resetPackageUpdates,
+			validation == "incremental");
 	} catch (const std::exception& ex) {
 		return HttpUtility::SendJsonError(response, params, 500,
 			"Stage creation failed.",
@@ -1,5 +1,6 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
+#include "remote/apilistener.hpp"
 #include "remote/configobjectslock.hpp"
 #include "remote/consolehandler.hpp"
 #include "remote/httputility.hpp"
@@ -7,6 +8,8 @@
 #include "config/configcompiler.hpp"
 #include "base/configtype.hpp"
 #include "base/configwriter.hpp"
+#include "base/io-engine.hpp"
+#include "base/json.hpp"
 #include "base/scriptglobal.hpp"
 #include "base/logger.hpp"
 #include "base/serializer.hpp"
@@ -14,7 +17,12 @@
 #include "base/namespace.hpp"
 #include "base/initialize.hpp"
 #include "base/utility.hpp"
+#include <boost/asio/write.hpp>
+#include <boost/beast/http/chunk_encode.hpp>
+#include <boost/beast/http/serializer.hpp>
+#include <boost/beast/http/write.hpp>
 #include <boost/thread/once.hpp>
+#include <memory>
 #include <set>
 
 using namespace icinga;
@@ -26,6 +34,8 @@ static std::map<String, ApiScriptFrame> l_ApiScriptFrames;
 static Timer::Ptr l_FrameCleanupTimer;
 static std::mutex l_ApiScriptMutex;
 
+static const size_t l_ChunkSize = 64 * 1024;
+
 static void ScriptFrameCleanupHandler()
 {
 	std::unique_lock<std::mutex> lock(l_ApiScriptMutex);
@@ -55,6 +65,22 @@ static void EnsureFrameCleanupTimer()
 	});
 }
 
+/* Large array results of execute-script are streamed, see SendArrayResult(). */
+bool ConsoleHandler::IsStreaming(const boost::beast::http::request<boost::beast::http::string_body>& request) const
+{
+	if (request.method() != boost::beast::http::verb::post)
+		return false;
+
+	try {
+		Url::Ptr url = new Url(std::string(request.target()));
+		auto& path (url->GetPath());
+
+		return path.size() == 3 && path[2] == "execute-script";
+	} catch (const std::exception&) {
+		return false;
+	}
+}
+
 bool ConsoleHandler::HandleRequest(
 	AsioTlsStream& stream,
 	const ApiUser::Ptr& user,
@@ -97,7 +123,7 @@ bool ConsoleHandler::HandleRequest(
 	}
 
 	if (methodName == "execute-script")
-		return ExecuteScriptHelper(request, response, params, command, session, sandboxed);
+		return ExecuteScriptHelper(stream, request, response, params, command, session, sandboxed, yc, server);
 	else if (methodName == "auto-complete-script")
 		return AutocompleteScriptHelper(request, response, params, command, session, sandboxed);
 
@@ -105,9 +131,81 @@ bool ConsoleHandler::HandleRequest(
 	return true;
 }
 
-bool ConsoleHandler::ExecuteScriptHelper(boost::beast::http::request<boost::beast::http::string_body>& request,
+/**
+ * Sends the elements of an array result one at a time. As long as they fit into a single chunk they're sent as
+ * a regular response. Larger results switch to chunked transfer encoding like ObjectQueryHandler's, so that the
+ * JSON doesn't have to be kept in memory in addition to the array.
+ */
+static void SendArrayResult(AsioTlsStream& stream, boost::beast::http::response<boost::beast::http::string_body>& response,
+	const Dictionary::Ptr& params, const Array::Ptr& result, boost::asio::yield_context& yc, HttpServerConnection& server)
+{
+	namespace asio = boost::asio;
+	namespace http = boost::beast::http;
+
+	bool pretty = HttpUtility::GetLastParameter(params, "pretty");
+	/* Same keys and order as the Dictionary for the other results. */
+	String body = "{\"results\":[{\"code\":" + JsonEncode(200) + ",\"result\":[";
+	std::unique_ptr<http::response_serializer<http::string_body>> serializer;
+
+	auto writeChunk = [&stream, &response, &yc, &server, &body, &serializer]() {
+		if (!serializer) {
+			server.StartStreaming();
+
+			response.result(http::status::ok);
+			response.set(http::field::content_type, "application/json");
+			response.chunked(true);
+
+			serializer.reset(new http::response_serializer<http::string_body>(response));
+		}
+
+		IoBoundWorkSlot dontLockTheIoThread (yc);
+
+		if (!serializer->is_header_done()) {
+			http::async_write_header(stream, *serializer, yc);
+		}
+
+		asio::async_write(stream, http::make_chunk(asio::const_buffer(body.CStr(), body.GetLength())), yc);
+		stream.async_flush(yc);
+
+		body.Clear();
+	};
+
+	/* Not iterating under an ObjectLock, writeChunk() yields. */
+	for (Array::SizeType i = 0; i < result->GetLength(); i++) {
+		if (serializer && server.Disconnected())
+			return;
+
+		if (i > 0)
+			body += ",";
+
+		body += JsonEncode(Serialize(result->Get(i), 0), pretty);
+
+		if (body.GetLength() >= l_ChunkSize)
+			writeChunk();
+	}
+
+	body += "],\"status\":" + JsonEncode("Executed successfully.") + "}]}";
+
+	if (!serializer) {
+		response.result(http::status::ok);
+		response.set(http::field::content_type, "application/json");
+		response.body() = std::move(body);
+		response.content_length(response.body().size());
+		return;
+	}
+
+	writeChunk();
+
+	IoBoundWorkSlot dontLockTheIoThread (yc);
+
+	asio::async_write(stream, http::make_chunk_last(), yc);
+	stream.async_flush(yc);
+}
+
+bool ConsoleHandler::ExecuteScriptHelper(AsioTlsStream& stream, boost::beast::http::request<boost::beast::http::string_body>& request,
 	boost::beast::http::response<boost::beast::http::string_body>& response,
-	const Dictionary::Ptr& params, const String& command, const String& session, bool sandboxed)
+	const Dictionary::Ptr& params, const String& command, const String& session, bool sandboxed,
+	boost::asio::yield_context& yc, HttpServerConnection& server)
 {
 	namespace http = boost::beast::http;
 
@@ -139,13 +237,20 @@ bool ConsoleHandler::ExecuteScriptHelper(boost::beast::http::request<boost::beas
 		frame.Self = lsf.Locals;
 		frame.Sandboxed = sandboxed;
 
+		ApiListener::Ptr listener = ApiListener::GetInstance();
+
+		if (listener && listener->GetConsoleTimeout() > 0)
+			frame.Deadline = Utility::GetTime() + listener->GetConsoleTimeout();
+
 		exprResult = expr->Evaluate(frame);
 
-		resultInfo = new Dictionary({
-			{ "code", 200 },
-			{ "status", "Executed successfully." },
-			{ "result", Serialize(exprResult, 0) }
-		});
+		if (!exprResult.IsObjectType<Array>()) {
+			resultInfo = new Dictionary({
+				{ "code", 200 },
+				{ "status", "Executed successfully." },
+				{ "result", Serialize(exprResult, 0) }
+			});
+		}
 	} catch (const ScriptError& ex) {
 		DebugInfo di = ex.GetDebugInfo();
 
@@ -170,6 +275,11 @@ bool ConsoleHandler::ExecuteScriptHelper(boost::beast::http::request<boost::beas
 		});
 	}
 
+	if (!resultInfo) {
+		SendArrayResult(stream, response, params, exprResult, yc, server);
+		return true;
+	}
+
 	Dictionary::Ptr result = new Dictionary({
 		{ "results", new Array({ resultInfo }) }
 	});
@@ -33,12 +33,15 @@ public:
 		HttpServerConnection& server
 	) override;
 
+	bool IsStreaming(const boost::beast::http::request<boost::beast::http::string_body>& request) const override;
+
 	static std::vector<String> GetAutocompletionSuggestions(const String& word, ScriptFrame& frame);
 
 private:
-	static bool ExecuteScriptHelper(boost::beast::http::request<boost::beast::http::string_body>& request,
+	static bool ExecuteScriptHelper(AsioTlsStream& stream, boost::beast::http::request<boost::beast::http::string_body>& request,
 		boost::beast::http::response<boost::beast::http::string_body>& response,
-		const Dictionary::Ptr& params, const String& command, const String& session, bool sandboxed);
+		const Dictionary::Ptr& params, const String& command, const String& session, bool sandboxed,
+		boost::asio::yield_context& yc, HttpServerConnection& server);
 	static bool AutocompleteScriptHelper(boost::beast::http::request<boost::beast::http::string_body>& request,
 		boost::beast::http::response<boost::beast::http::string_body>& response,
 		const Dictionary::Ptr& params, const String& command, const String& session, bool sandboxed);
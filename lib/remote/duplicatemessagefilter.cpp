@@ -0,0 +1,157 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/duplicatemessagefilter.hpp"
+#include "base/array.hpp"
+#include "base/objectlock.hpp"
+#include <boost/functional/hash.hpp>
+
+using namespace icinga;
+
+/**
+ * How many messages are remembered. Duplicates arrive within milliseconds, so this covers a lot of time.
+ */
+static constexpr size_t l_RingSize = 16384;
+
+std::mutex DuplicateMessageFilter::m_Mutex;
+std::unordered_map<size_t, DuplicateMessageFilter::Message> DuplicateMessageFilter::m_Messages;
+std::vector<size_t> DuplicateMessageFilter::m_Ring;
+uint_fast64_t DuplicateMessageFilter::m_Received = 0;
+std::map<std::pair<String, String>, uint_fast64_t> DuplicateMessageFilter::m_Duplicates;
+uint_fast64_t DuplicateMessageFilter::m_TotalDuplicates = 0;
+
+static size_t HashValue(const Value& value)
+{
+	size_t hash = value.GetType();
+
+	switch (value.GetType()) {
+		case ValueNumber:
+			boost::hash_combine(hash, value.Get<double>());
+			break;
+		case ValueBoolean:
+			boost::hash_combine(hash, value.Get<bool>());
+			break;
+		case ValueString:
+			boost::hash_combine(hash, value.Get<String>().GetData());
+			break;
+		case ValueObject:
+			if (value.IsObjectType<Dictionary>()) {
+				Dictionary::Ptr dict = value;
+				ObjectLock olock(dict);
+
+				for (const Dictionary::Pair& kv : dict) {
+					boost::hash_combine(hash, kv.first.GetData());
+					boost::hash_combine(hash, HashValue(kv.second));
+				}
+			} else if (value.IsObjectType<Array>()) {
+				Array::Ptr arr = value;
+				ObjectLock olock(arr);
+
+				for (const Value& item : arr)
+					boost::hash_combine(hash, HashValue(item));
+			} else {
+				boost::hash_combine(hash, value.Get<Object::Ptr>().get());
+			}
+
+			break;
+		default:
+			break;
+	}
+
+	return hash;
+}
+
+/**
+ * Whether duplicates of the method are dropped. Heartbeats arrive identical from all endpoints
+ * and batches are checked message by message.
+ */
+bool DuplicateMessageFilter::IsFiltered(const String& method)
+{
+	return method.Find("event::") == 0 && method != "event::Heartbeat" && method != "event::Batch";
+}
+
+/**
+ * Remembers the message and tells whether another endpoint sent the same one recently.
+ *
+ * @return Whether the message has to be dropped
+ */
+bool DuplicateMessageFilter::IsDuplicate(const Endpoint::Ptr& from, const String& method, const Dictionary::Ptr& params)
+{
+	if (!from || !params || !IsFiltered(method))
+		return false;
+
+	size_t hash = HashValue(params);
+	boost::hash_combine(hash, method.GetData());
+
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	auto known (m_Messages.find(hash));
+
+	if (known != m_Messages.end() && known->second.From != from) {
+		m_Duplicates[{known->second.From->GetName(), from->GetName()}]++;
+		m_TotalDuplicates++;
+
+		return true;
+	}
+
+	if (m_Ring.size() < l_RingSize) {
+		m_Ring.emplace_back(hash);
+	} else {
+		auto& oldest (m_Ring[m_Received % l_RingSize]);
+		auto evicted (m_Messages.find(oldest));
+
+		/* Unless it has been received again since then */
+		if (evicted != m_Messages.end() && evicted->second.Number + l_RingSize <= m_Received)
+			m_Messages.erase(evicted);
+
+		oldest = hash;
+	}
+
+	m_Messages[hash] = Message{from, m_Received};
+	m_Received++;
+
+	return false;
+}
+
+/**
+ * @return The duplicates per endpoint which sent the message first and per endpoint which sent it again
+ */
+Dictionary::Ptr DuplicateMessageFilter::GetStatus()
+{
+	Dictionary::Ptr status = new Dictionary();
+
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	for (auto& duplicates : m_Duplicates) {
+		Dictionary::Ptr senders = status->Get(duplicates.first.first);
+
+		if (!senders) {
+			senders = new Dictionary();
+			status->Set(duplicates.first.first, senders);
+		}
+
+		senders->Set(duplicates.first.second, duplicates.second);
+	}
+
+	return status;
+}
+
+uint_fast64_t DuplicateMessageFilter::GetDuplicates()
+{
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	return m_TotalDuplicates;
+}
+
+/**
+ * Forgets all messages and counters, only used by the tests.
+ */
+void DuplicateMessageFilter::Reset()
+{
+	std::unique_lock<std::mutex> lock (m_Mutex);
+
+	m_Messages.clear();
+	m_Ring.clear();
+	m_Received = 0;
+	m_Duplicates.clear();
+	m_TotalDuplicates = 0;
+}
@@ -0,0 +1,57 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef DUPLICATEMESSAGEFILTER_H
+#define DUPLICATEMESSAGEFILTER_H
+
+#include "remote/i2-remote.hpp"
+#include "remote/endpoint.hpp"
+#include "base/dictionary.hpp"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * Remembers the last received event:: messages (by a hash of their method and params) and which endpoint sent them.
+ * The same message from another endpoint, e.g. a check result arriving via both masters of an HA zone,
+ * is a duplicate and must not be processed (nor relayed) again.
+ *
+ * The same message from the same endpoint isn't a duplicate, e.g. two identical acknowledgements.
+ *
+ * @ingroup remote
+ */
+class DuplicateMessageFilter
+{
+public:
+	static bool IsDuplicate(const Endpoint::Ptr& from, const String& method, const Dictionary::Ptr& params);
+
+	static Dictionary::Ptr GetStatus();
+	static uint_fast64_t GetDuplicates();
+
+	static void Reset();
+
+private:
+	struct Message
+	{
+		Endpoint::Ptr From;
+		uint_fast64_t Number;
+	};
+
+	static std::mutex m_Mutex;
+	static std::unordered_map<size_t, Message> m_Messages;
+	static std::vector<size_t> m_Ring;
+	static uint_fast64_t m_Received;
+	static std::map<std::pair<String, String>, uint_fast64_t> m_Duplicates;
+	static uint_fast64_t m_TotalDuplicates;
+
+	static bool IsFiltered(const String& method);
+};
+
+}
+
+#endif /* DUPLICATEMESSAGEFILTER_H */
@@ -101,20 +101,59 @@ Endpoint::Ptr Endpoint::GetLocalEndpoint()
 	return listener->GetLocalEndpoint();
 }
 
-void Endpoint::AddMessageSent(int bytes)
+void Endpoint::AddMessageSent(int bytes, const String& method)
 {
 	double time = Utility::GetTime();
 	m_MessagesSent.InsertValue(time, 1);
 	m_BytesSent.InsertValue(time, bytes);
 	SetLastMessageSent(time);
+
+	if (!method.IsEmpty()) {
+		std::unique_lock<std::mutex> lock (m_MessagesByMethodMutex);
+		auto& counters (m_MessagesByMethod[method]);
+
+		counters.MessagesSent++;
+		counters.BytesSent += bytes;
+	}
 }
 
-void Endpoint::AddMessageReceived(int bytes)
+void Endpoint::AddMessageReceived(int bytes, const String& method)
 {
 	double time = Utility::GetTime();
 	m_MessagesReceived.InsertValue(time, 1);
 	m_BytesReceived.InsertValue(time, bytes);
 	SetLastMessageReceived(time);
+
+	if (!method.IsEmpty()) {
+		std::unique_lock<std::mutex> lock (m_MessagesByMethodMutex);
+		auto& counters (m_MessagesByMethod[method]);
+
+		counters.MessagesReceived++;
+		counters.BytesReceived += bytes;
+	}
+}
+
+/**
+ * Returns the messages and bytes sent to and received from this endpoint since startup, per JSON-RPC method.
+ *
+ * @return { "event::CheckResult": { "messages_sent": ..., "bytes_sent": ..., "messages_received": ..., "bytes_received": ... } }
+ */
+Dictionary::Ptr Endpoint::GetMessagesByMethod() const
+{
+	DictionaryData methods;
+
+	std::unique_lock<std::mutex> lock (m_MessagesByMethodMutex);
+
+	for (auto& kv : m_MessagesByMethod) {
+		methods.emplace_back(kv.first, new Dictionary({
+			{ "messages_sent", static_cast<double>(kv.second.MessagesSent) },
+			{ "bytes_sent", static_cast<double>(kv.second.BytesSent) },
+			{ "messages_received", static_cast<double>(kv.second.MessagesReceived) },
+			{ "bytes_received", static_cast<double>(kv.second.BytesReceived) }
+		}));
+	}
+
+	return new Dictionary(std::move(methods));
 }
 
 double Endpoint::GetMessagesSentPerSecond() const
@@ -136,3 +175,32 @@ double Endpoint::GetBytesReceivedPerSecond() const
 {
 	return m_BytesReceived.CalculateRate(Utility::GetTime(), 60);
 }
+
+void Endpoint::AddCompressedMessage(size_t uncompressedBytes, size_t compressedBytes)
+{
+	m_UncompressedBytes.fetch_add(uncompressedBytes, std::memory_order_relaxed);
+	m_CompressedBytes.fetch_add(compressedBytes, std::memory_order_relaxed);
+}
+
+/**
+ * Returns how many times smaller the messages sent to this endpoint got by compression since startup.
+ *
+ * @return The ratio or 0 if nothing was compressed yet
+ */
+double Endpoint::GetCompressionRatio() const
+{
+	auto compressed (m_CompressedBytes.load(std::memory_order_relaxed));
+
+	if (!compressed)
+		return 0;
+
+	return static_cast<double>(m_UncompressedBytes.load(std::memory_order_relaxed)) / compressed;
+}
+
+void Endpoint::ValidateCompressionLevel(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<Endpoint>::ValidateCompressionLevel(lvalue, utils);
+
+	if (lvalue() < 0 || lvalue() > 9)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "compression_level" }, "Value must be between 0 and 9."));
+}
@@ -6,6 +6,9 @@
 #include "remote/i2-remote.hpp"
 #include "remote/endpoint-ti.hpp"
 #include "base/ringbuffer.hpp"
+#include <atomic>
+#include <cstdint>
+#include <map>
 #include <set>
 
 namespace icinga
@@ -40,8 +43,10 @@ public:
 
 	void SetCachedZone(const intrusive_ptr<Zone>& zone);
 
-	void AddMessageSent(int bytes);
-	void AddMessageReceived(int bytes);
+	void AddMessageSent(int bytes, const String& method = String());
+	void AddMessageReceived(int bytes, const String& method = String());
+
+	Dictionary::Ptr GetMessagesByMethod() const;
 
 	double GetMessagesSentPerSecond() const override;
 	double GetMessagesReceivedPerSecond() const override;
@@ -49,6 +54,11 @@ public:
 	double GetBytesSentPerSecond() const override;
 	double GetBytesReceivedPerSecond() const override;
 
+	void AddCompressedMessage(size_t uncompressedBytes, size_t compressedBytes);
+	double GetCompressionRatio() const override;
+
+	void ValidateCompressionLevel(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+
 protected:
 	void OnAllConfigLoaded() override;
 
@@ -57,10 +67,26 @@ private:
 	std::set<intrusive_ptr<JsonRpcConnection> > m_Clients;
 	intrusive_ptr<Zone> m_Zone;
 
-	mutable RingBuffer m_MessagesSent{60};
-	mutable RingBuffer m_MessagesReceived{60};
-	mutable RingBuffer m_BytesSent{60};
-	mutable RingBuffer m_BytesReceived{60};
+	mutable ShardedRingBuffer m_MessagesSent{60};
+	mutable ShardedRingBuffer m_MessagesReceived{60};
+	mutable ShardedRingBuffer m_BytesSent{60};
+	mutable ShardedRingBuffer m_BytesReceived{60};
+
+	/* Of the messages compressed for this endpoint since startup */
+	std::atomic<uint_fast64_t> m_UncompressedBytes{0};
+	std::atomic<uint_fast64_t> m_CompressedBytes{0};
+
+	struct MessageCounters
+	{
+		uint_fast64_t MessagesSent = 0;
+		uint_fast64_t BytesSent = 0;
+		uint_fast64_t MessagesReceived = 0;
+		uint_fast64_t BytesReceived = 0;
+	};
+
+	/* Totals since startup rather than RingBuffers, which would take too much memory per method. */
+	mutable std::mutex m_MessagesByMethodMutex;
+	std::map<String, MessageCounters> m_MessagesByMethod;
 };
 
 }
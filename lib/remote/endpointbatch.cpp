@@ -0,0 +1,113 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/endpointbatch.hpp"
+#include "remote/apilistener.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include <boost/thread/once.hpp>
+#include <utility>
+#include <vector>
+
+using namespace icinga;
+
+/**
+ * How long messages wait for others. The checker dispatches checks which are due at the same time
+ * within a few milliseconds, and the parent of a command endpoint waits for much longer than this.
+ */
+static constexpr double l_FlushInterval = 0.5;
+
+/**
+ * Like RelayBatch, so that a single event::Batch doesn't hold up the connection for too long.
+ */
+static constexpr size_t l_MaxBatchSize = 1000;
+
+std::mutex EndpointBatch::m_Mutex;
+std::map<Endpoint::Ptr, ArrayData> EndpointBatch::m_Messages;
+Timer::Ptr EndpointBatch::m_FlushTimer;
+
+/**
+ * Sends the message to the endpoint like ApiListener::SyncSendMessage(), but within the next flush interval
+ * together with the other messages for the same endpoint.
+ */
+void EndpointBatch::Send(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message)
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener)
+		return;
+
+	if (!(endpoint->GetCapabilities() & (uint_fast64_t)ApiCapabilities::EventBatches)) {
+		listener->SyncSendMessage(endpoint, message);
+		return;
+	}
+
+	static boost::once_flag once = BOOST_ONCE_INIT;
+
+	boost::call_once(once, []() {
+		m_FlushTimer = Timer::Create();
+		m_FlushTimer->SetInterval(l_FlushInterval);
+		m_FlushTimer->OnTimerExpired.connect([](const Timer * const&) { FlushAll(); });
+		m_FlushTimer->Start();
+	});
+
+	ArrayData full;
+
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+		auto& messages (m_Messages[endpoint]);
+
+		messages.emplace_back(message);
+
+		if (messages.size() >= l_MaxBatchSize)
+			std::swap(messages, full);
+	}
+
+	if (!full.empty())
+		Flush(endpoint, std::move(full));
+}
+
+void EndpointBatch::FlushAll()
+{
+	std::map<Endpoint::Ptr, ArrayData> pending;
+
+	{
+		std::unique_lock<std::mutex> lock (m_Mutex);
+		std::swap(pending, m_Messages);
+	}
+
+	for (auto& kv : pending) {
+		try {
+			Flush(kv.first, std::move(kv.second));
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "EndpointBatch")
+				<< "Error while sending batched messages to endpoint '" << kv.first->GetName() << "': "
+				<< DiagnosticInformation(ex, false);
+		}
+	}
+}
+
+void EndpointBatch::Flush(const Endpoint::Ptr& endpoint, ArrayData messages)
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener || messages.empty())
+		return;
+
+	if (messages.size() == 1u) {
+		listener->SyncSendMessage(endpoint, messages[0]);
+		return;
+	}
+
+	Log(LogNotice, "EndpointBatch")
+		<< "Sending " << messages.size() << " messages to endpoint '" << endpoint->GetName() << "' at once.";
+
+	Dictionary::Ptr message = new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "event::Batch" },
+		{ "params", new Dictionary({
+			{ "messages", new Array(std::move(messages)) }
+		}) }
+	});
+
+	listener->SyncSendMessage(endpoint, message);
+}
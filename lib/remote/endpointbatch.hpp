@@ -0,0 +1,42 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef ENDPOINTBATCH_H
+#define ENDPOINTBATCH_H
+
+#include "remote/i2-remote.hpp"
+#include "remote/endpoint.hpp"
+#include "base/array.hpp"
+#include "base/dictionary.hpp"
+#include "base/timer.hpp"
+#include <map>
+#include <mutex>
+
+namespace icinga
+{
+
+/**
+ * Collects the messages sent to a directly connected endpoint during a short window and sends them
+ * as one event::Batch message, e.g. the event::ExecuteCommand messages for the checks of an agent which
+ * are due at about the same time, and the event::CheckResult messages the agent replies with.
+ *
+ * Messages to endpoints which didn't announce ApiCapabilities::EventBatches are sent right away.
+ *
+ * @ingroup remote
+ */
+class EndpointBatch
+{
+public:
+	static void Send(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message);
+
+private:
+	static std::mutex m_Mutex;
+	static std::map<Endpoint::Ptr, ArrayData> m_Messages;
+	static Timer::Ptr m_FlushTimer;
+
+	static void FlushAll();
+	static void Flush(const Endpoint::Ptr& endpoint, ArrayData messages);
+};
+
+}
+
+#endif /* ENDPOINTBATCH_H */
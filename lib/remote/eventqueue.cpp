@@ -1,12 +1,16 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
+#include "config/bytecode.hpp"
 #include "config/configcompiler.hpp"
 #include "remote/eventqueue.hpp"
 #include "remote/filterutility.hpp"
+#include "base/defer.hpp"
 #include "base/io-engine.hpp"
+#include "base/json.hpp"
 #include "base/singleton.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
+#include <boost/algorithm/string/replace.hpp>
 #include <boost/asio/spawn.hpp>
 #include <boost/date_time/posix_time/posix_time_duration.hpp>
 #include <boost/date_time/posix_time/ptime.hpp>
@@ -146,12 +150,16 @@ EventQueueRegistry *EventQueueRegistry::GetInstance()
 }
 
 std::mutex EventsInbox::m_FiltersMutex;
-std::map<String, EventsInbox::Filter> EventsInbox::m_Filters ({{"", EventsInbox::Filter{1, Expression::Ptr()}}});
+std::map<String, EventsInbox::Filter> EventsInbox::m_Filters;
+std::atomic<uint_least64_t> EventsInbox::m_DroppedEvents (0);
+
+/* Events beyond this many bytes per inbox are dropped until the consumer catches up. */
+static const size_t l_MaxInboxSize = 16 * 1024 * 1024;
 
 EventsRouter EventsRouter::m_Instance;
 
 EventsInbox::EventsInbox(String filter, const String& filterSource)
-	: m_Timer(IoEngine::Get().GetIoContext())
+	: m_QueueSize(0), m_Dropped(0), m_Timer(IoEngine::Get().GetIoContext())
 {
 	std::unique_lock<std::mutex> lock (m_FiltersMutex);
 	m_Filter = m_Filters.find(filter);
@@ -159,14 +167,19 @@ EventsInbox::EventsInbox(String filter, const String& filterSource)
 	if (m_Filter == m_Filters.end()) {
 		lock.unlock();
 
-		auto expr (ConfigCompiler::CompileText(filterSource, filter));
+		std::unique_ptr<Expression> expr;
+
+		if (!filter.IsEmpty()) {
+			expr = BytecodeExpression::Compile(ConfigCompiler::CompileText(filterSource, filter));
+		}
 
 		lock.lock();
 
 		m_Filter = m_Filters.find(filter);
 
 		if (m_Filter == m_Filters.end()) {
-			m_Filter = m_Filters.emplace(std::move(filter), Filter{1, Expression::Ptr(expr.release())}).first;
+			m_Filter = m_Filters.emplace(std::piecewise_construct, std::forward_as_tuple(std::move(filter)),
+				std::forward_as_tuple(1, Expression::Ptr(expr.release()))).first;
 		} else {
 			++m_Filter->second.Refs;
 		}
@@ -184,20 +197,92 @@ EventsInbox::~EventsInbox()
 	}
 }
 
-const Expression::Ptr& EventsInbox::GetFilter()
+EventsInbox::Filter *EventsInbox::GetFilter()
+{
+	return &m_Filter->second;
+}
+
+EventsInbox::Filter::Filter(std::size_t refs, Expression::Ptr expr)
+	: Refs(refs), Expr(std::move(expr)), Evaluations(0), EvaluationTime(0)
 {
-	return m_Filter->second.Expr;
 }
 
-void EventsInbox::Push(Dictionary::Ptr event)
+/**
+ * Evaluates the filter for an event and accounts for the time it took.
+ *
+ * @param frame A frame in which the filter program may store variables.
+ * @param event The event.
+ * @returns Whether the event passes the filter.
+ */
+bool EventsInbox::Filter::Evaluate(ScriptFrame& frame, const Dictionary::Ptr& event)
+{
+	namespace ch = std::chrono;
+
+	if (!Expr) {
+		return true;
+	}
+
+	auto start (ch::steady_clock::now());
+
+	Defer accountTime ([this, start]() {
+		Evaluations.fetch_add(1, std::memory_order_relaxed);
+		EvaluationTime.fetch_add(ch::duration_cast<ch::nanoseconds>(ch::steady_clock::now() - start).count(), std::memory_order_relaxed);
+	});
+
+	return FilterUtility::EvaluateFilter(frame, Expr.get(), event, "event");
+}
+
+/**
+ * Returns the filters in use with their number of inboxes, evaluations and
+ * total evaluation time in seconds.
+ */
+Array::Ptr EventsInbox::GetFilterStats()
+{
+	ArrayData stats;
+	std::unique_lock<std::mutex> lock (m_FiltersMutex);
+
+	for (auto& filter : m_Filters) {
+		if (!filter.second.Expr) {
+			continue;
+		}
+
+		stats.emplace_back(new Dictionary({
+			{ "filter", filter.first },
+			{ "inboxes", filter.second.Refs },
+			{ "evaluations", filter.second.Evaluations.load() },
+			{ "evaluation_time", filter.second.EvaluationTime.load() / 1e9 }
+		}));
+	}
+
+	return new Array(std::move(stats));
+}
+
+/**
+ * Queues an encoded event. The event is dropped if the consumer lags too far behind.
+ *
+ * @param event The JSON-encoded event, shared by all inboxes it's pushed to.
+ */
+void EventsInbox::Push(const std::shared_ptr<String>& event)
 {
 	std::unique_lock<std::mutex> lock (m_Mutex);
 
-	m_Queue.emplace(std::move(event));
+	if (m_QueueSize + event->GetLength() > l_MaxInboxSize) {
+		if (!m_Dropped) {
+			Log(LogWarning, "EventsInbox")
+				<< "Event stream consumer is too slow, dropping events.";
+		}
+
+		m_Dropped++;
+		m_DroppedEvents.fetch_add(1);
+		return;
+	}
+
+	m_QueueSize += event->GetLength();
+	m_Queue.emplace(event);
 	m_Timer.expires_at(boost::posix_time::neg_infin);
 }
 
-Dictionary::Ptr EventsInbox::Shift(boost::asio::yield_context yc, double timeout)
+std::shared_ptr<String> EventsInbox::Shift(boost::asio::yield_context yc, double timeout)
 {
 	std::unique_lock<std::mutex> lock (m_Mutex, std::defer_lock);
 
@@ -231,9 +316,26 @@ Dictionary::Ptr EventsInbox::Shift(boost::asio::yield_context yc, double timeout
 
 	auto event (std::move(m_Queue.front()));
 	m_Queue.pop();
+	m_QueueSize -= event->GetLength();
+
+	if (m_Dropped && m_Queue.empty()) {
+		Log(LogWarning, "EventsInbox")
+			<< "Event stream consumer caught up, " << m_Dropped << " events have been dropped.";
+
+		m_Dropped = 0;
+	}
+
 	return event;
 }
 
+/**
+ * Returns the number of events dropped by all inboxes so far.
+ */
+uint_least64_t EventsInbox::GetDroppedEvents()
+{
+	return m_DroppedEvents.load();
+}
+
 EventsSubscriber::EventsSubscriber(std::set<EventType> types, String filter, const String& filterSource)
 	: m_Types(std::move(types)), m_Inbox(new EventsInbox(std::move(filter), filterSource))
 {
@@ -250,7 +352,7 @@ const EventsInbox::Ptr& EventsSubscriber::GetInbox()
 	return m_Inbox;
 }
 
-EventsFilter::EventsFilter(std::map<Expression::Ptr, std::set<EventsInbox::Ptr>> inboxes)
+EventsFilter::EventsFilter(std::map<EventsInbox::Filter*, std::set<EventsInbox::Ptr>> inboxes)
 	: m_Inboxes(std::move(inboxes))
 {
 }
@@ -262,13 +364,17 @@ EventsFilter::operator bool()
 
 void EventsFilter::Push(Dictionary::Ptr event)
 {
+	/* The event is encoded once for all inboxes. */
+	std::shared_ptr<String> encoded;
+
 	for (auto& perFilter : m_Inboxes) {
-		if (perFilter.first) {
-			ScriptFrame frame(true, new Namespace());
+		if (perFilter.first->Expr) {
+			/* Each filter gets its own frame, so that locals set by one aren't visible to the next one. */
+			ScriptFrame frame (true, new Namespace());
 			frame.Sandboxed = true;
 
 			try {
-				if (!FilterUtility::EvaluateFilter(frame, perFilter.first.get(), event, "event")) {
+				if (!perFilter.first->Evaluate(frame, event)) {
 					continue;
 				}
 			} catch (const std::exception& ex) {
@@ -278,8 +384,15 @@ void EventsFilter::Push(Dictionary::Ptr event)
 			}
 		}
 
+		if (!encoded) {
+			encoded = std::make_shared<String>(JsonEncode(event));
+
+			boost::algorithm::replace_all(*encoded, "\n", "");
+			*encoded += "\n";
+		}
+
 		for (auto& inbox : perFilter.second) {
-			inbox->Push(event);
+			inbox->Push(encoded);
 		}
 	}
 }
@@ -291,7 +404,7 @@ EventsRouter& EventsRouter::GetInstance()
 
 void EventsRouter::Subscribe(const std::set<EventType>& types, const EventsInbox::Ptr& inbox)
 {
-	const auto& filter (inbox->GetFilter());
+	auto filter (inbox->GetFilter());
 	std::unique_lock<std::mutex> lock (m_Mutex);
 
 	for (auto type : types) {
@@ -313,7 +426,7 @@ void EventsRouter::Subscribe(const std::set<EventType>& types, const EventsInbox
 
 void EventsRouter::Unsubscribe(const std::set<EventType>& types, const EventsInbox::Ptr& inbox)
 {
-	const auto& filter (inbox->GetFilter());
+	auto filter (inbox->GetFilter());
 	std::unique_lock<std::mutex> lock (m_Mutex);
 
 	for (auto type : types) {
@@ -5,15 +5,18 @@
 
 #include "remote/httphandler.hpp"
 #include "base/object.hpp"
+#include "base/scriptframe.hpp"
 #include "config/expression.hpp"
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/spawn.hpp>
+#include <atomic>
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <mutex>
 #include <set>
 #include <map>
+#include <memory>
 #include <deque>
 #include <queue>
 
@@ -91,6 +94,21 @@ class EventsInbox : public Object
 public:
 	DECLARE_PTR_TYPEDEFS(EventsInbox);
 
+	/**
+	 * A compiled filter, shared by all inboxes using the same filter.
+	 */
+	struct Filter
+	{
+		std::size_t Refs;
+		Expression::Ptr Expr;
+		std::atomic<uint_least64_t> Evaluations;
+		std::atomic<uint_least64_t> EvaluationTime;
+
+		Filter(std::size_t refs, Expression::Ptr expr);
+
+		bool Evaluate(ScriptFrame& frame, const Dictionary::Ptr& event);
+	};
+
 	EventsInbox(String filter, const String& filterSource);
 	EventsInbox(const EventsInbox&) = delete;
 	EventsInbox(EventsInbox&&) = delete;
@@ -98,24 +116,24 @@ public:
 	EventsInbox& operator=(EventsInbox&&) = delete;
 	~EventsInbox();
 
-	const Expression::Ptr& GetFilter();
+	Filter *GetFilter();
 
-	void Push(Dictionary::Ptr event);
-	Dictionary::Ptr Shift(boost::asio::yield_context yc, double timeout = 5);
+	void Push(const std::shared_ptr<String>& event);
+	std::shared_ptr<String> Shift(boost::asio::yield_context yc, double timeout = 5);
 
-private:
-	struct Filter
-	{
-		std::size_t Refs;
-		Expression::Ptr Expr;
-	};
+	static uint_least64_t GetDroppedEvents();
+	static Array::Ptr GetFilterStats();
 
+private:
 	static std::mutex m_FiltersMutex;
 	static std::map<String, Filter> m_Filters;
+	static std::atomic<uint_least64_t> m_DroppedEvents;
 
 	std::mutex m_Mutex;
 	decltype(m_Filters.begin()) m_Filter;
-	std::queue<Dictionary::Ptr> m_Queue;
+	std::queue<std::shared_ptr<String>> m_Queue;
+	size_t m_QueueSize;
+	uint_least64_t m_Dropped;
 	boost::asio::deadline_timer m_Timer;
 };
 
@@ -139,14 +157,14 @@ private:
 class EventsFilter
 {
 public:
-	EventsFilter(std::map<Expression::Ptr, std::set<EventsInbox::Ptr>> inboxes);
+	EventsFilter(std::map<EventsInbox::Filter*, std::set<EventsInbox::Ptr>> inboxes);
 
 	operator bool();
 
 	void Push(Dictionary::Ptr event);
 
 private:
-	std::map<Expression::Ptr, std::set<EventsInbox::Ptr>> m_Inboxes;
+	std::map<EventsInbox::Filter*, std::set<EventsInbox::Ptr>> m_Inboxes;
 };
 
 class EventsRouter
@@ -169,7 +187,7 @@ private:
 	~EventsRouter() = default;
 
 	std::mutex m_Mutex;
-	std::map<EventType, std::map<Expression::Ptr, std::set<EventsInbox::Ptr>>> m_Subscribers;
+	std::map<EventType, std::map<EventsInbox::Filter*, std::set<EventsInbox::Ptr>>> m_Subscribers;
 };
 
 }
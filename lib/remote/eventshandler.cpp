@@ -8,10 +8,8 @@
 #include "base/defer.hpp"
 #include "base/io-engine.hpp"
 #include "base/objectlock.hpp"
-#include "base/json.hpp"
 #include <boost/asio/buffer.hpp>
 #include <boost/asio/write.hpp>
-#include <boost/algorithm/string/replace.hpp>
 #include <map>
 #include <set>
 
@@ -39,6 +37,11 @@ const std::map<String, EventType> l_EventTypes ({
 
 const String l_ApiQuery ("<API query>");
 
+bool EventsHandler::IsStreaming(const boost::beast::http::request<boost::beast::http::string_body>& request) const
+{
+	return request.method() == boost::beast::http::verb::post;
+}
+
 bool EventsHandler::HandleRequest(
 	AsioTlsStream& stream,
 	const ApiUser::Ptr& user,
@@ -110,20 +113,14 @@ bool EventsHandler::HandleRequest(
 	http::async_write(stream, response, yc);
 	stream.async_flush(yc);
 
-	asio::const_buffer newLine ("\n", 1);
-
 	for (;;) {
 		auto event (subscriber.GetInbox()->Shift(yc));
 
 		if (event) {
-			String body = JsonEncode(event);
-
-			boost::algorithm::replace_all(body, "\n", "");
-
-			asio::const_buffer payload (body.CStr(), body.GetLength());
+			/* Already encoded by EventsFilter::Push(), including the trailing newline. */
+			asio::const_buffer payload (event->CStr(), event->GetLength());
 
 			asio::async_write(stream, payload, yc);
-			asio::async_write(stream, newLine, yc);
 			stream.async_flush(yc);
 		} else if (server.Disconnected()) {
 			return true;
@@ -24,6 +24,8 @@ public:
 		boost::asio::yield_context& yc,
 		HttpServerConnection& server
 	) override;
+
+	bool IsStreaming(const boost::beast::http::request<boost::beast::http::string_body>& request) const override;
 };
 
 }
@@ -0,0 +1,345 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/filterindex.hpp"
+#include "base/array.hpp"
+#include "base/exception.hpp"
+#include "base/objectlock.hpp"
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
+using namespace icinga;
+
+namespace icinga
+{
+
+/**
+ * A single attribute index.
+ *
+ * @ingroup remote
+ */
+struct FilterIndexData
+{
+	Type::Ptr TargetType;
+	int FieldID;
+	String FieldName;
+	String NavigationName;
+
+	std::mutex Mutex;
+	std::unordered_map<String, std::set<ConfigObject::Ptr>> Objects;
+	std::unordered_map<ConfigObject*, std::vector<String>> Keys;
+};
+
+}
+
+/* Indexes are only registered during initialization, the map itself isn't locked. */
+static std::unordered_map<Type*, std::vector<std::unique_ptr<FilterIndexData>>> l_FilterIndexes;
+
+/**
+ * Registers an index on the specified field.
+ *
+ * @param type The object type.
+ * @param field The indexed field.
+ * @param sourceFields Fields the indexed field's value is computed from.
+ * @param navigationName A navigation whose object's name is the field's value, e.g. "host" for "host_name".
+ */
+void FilterIndex::Register(const Type::Ptr& type, const String& field, const std::vector<String>& sourceFields,
+	const String& navigationName)
+{
+	int fid = type->GetFieldId(field);
+
+	if (fid < 0)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid field '" + field + "' for type '" + type->GetName() + "'."));
+
+	Field fieldInfo = type->GetFieldInfo(fid);
+
+	auto index (std::make_unique<FilterIndexData>());
+	index->TargetType = type;
+	index->FieldID = fid;
+	index->FieldName = fieldInfo.Name;
+	index->NavigationName = navigationName;
+
+	FilterIndexData *indexPtr = index.get();
+
+	auto handler ([indexPtr](const Object::Ptr& object, const Value&) {
+		ConfigObject::Ptr configObject = dynamic_pointer_cast<ConfigObject>(object);
+
+		if (configObject && indexPtr->TargetType->IsAssignableFrom(configObject->GetReflectionType()))
+			UpdateObject(*indexPtr, configObject);
+	});
+
+	std::set<String> handlerFields (sourceFields.begin(), sourceFields.end());
+	handlerFields.insert(field);
+
+	/* Objects enter and leave the index on (de-)activation. */
+	handlerFields.insert("active");
+
+	for (const String& handlerField : handlerFields) {
+		int handlerFid = type->GetFieldId(handlerField);
+
+		if (handlerFid < 0)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid field '" + handlerField + "' for type '" + type->GetName() + "'."));
+
+		type->RegisterAttributeHandler(handlerFid, handler);
+	}
+
+	l_FilterIndexes[type.get()].emplace_back(std::move(index));
+}
+
+/**
+ * Updates all indexes of the object's type. This is necessary for indexed
+ * fields whose values change without an attribute change notification.
+ *
+ * @param object The changed object.
+ */
+void FilterIndex::Update(const ConfigObject::Ptr& object)
+{
+	for (Type::Ptr type = object->GetReflectionType(); type; type = type->GetBaseType()) {
+		auto it (l_FilterIndexes.find(type.get()));
+
+		if (it == l_FilterIndexes.end())
+			continue;
+
+		for (auto& index : it->second) {
+			UpdateObject(*index, object);
+		}
+	}
+}
+
+void FilterIndex::UpdateObject(FilterIndexData& index, const ConfigObject::Ptr& object)
+{
+	bool active = object->IsActive();
+	std::vector<String> keys;
+
+	if (active) {
+		Value value = object->GetField(index.FieldID);
+		String key;
+
+		if (value.IsObjectType<Array>()) {
+			Array::Ptr arr = value;
+
+			ObjectLock olock(arr);
+			for (const Value& item : arr) {
+				if (GetIndexKey(item, true, key))
+					keys.emplace_back(std::move(key));
+			}
+		} else if (GetIndexKey(value, false, key)) {
+			keys.emplace_back(std::move(key));
+		}
+	}
+
+	std::unique_lock<std::mutex> lock (index.Mutex);
+
+	auto it (index.Keys.find(object.get()));
+
+	if (it != index.Keys.end()) {
+		if (active && it->second == keys)
+			return;
+
+		for (const String& oldKey : it->second) {
+			auto objects (index.Objects.find(oldKey));
+
+			if (objects != index.Objects.end()) {
+				objects->second.erase(object);
+
+				if (objects->second.empty())
+					index.Objects.erase(objects);
+			}
+		}
+
+		index.Keys.erase(it);
+	}
+
+	if (!active)
+		return;
+
+	for (const String& key : keys) {
+		index.Objects[key].insert(object);
+	}
+
+	index.Keys.emplace(object.get(), std::move(keys));
+}
+
+/**
+ * Builds the key objects are looked up by. Values which compare equal using
+ * the == operator get the same key, i.e. booleans are treated as numbers and
+ * null as an empty string.
+ *
+ * @param value The value.
+ * @param membership Whether the key is for an element of an array value.
+ * @param key The key.
+ * @returns Whether the value can be indexed.
+ */
+bool FilterIndex::GetIndexKey(const Value& value, bool membership, String& key)
+{
+	key = membership ? "i" : "=";
+
+	if (value.IsNumber() || value.IsBoolean()) {
+		double number = value;
+		char buf[sizeof(number)];
+
+		/* -0 == 0 */
+		if (number == 0)
+			number = 0;
+
+		memcpy(buf, &number, sizeof(buf));
+		key += "n";
+		key += String(buf, buf + sizeof(buf));
+		return true;
+	}
+
+	if (value.IsString() || value.IsEmpty()) {
+		key += "s";
+		key += static_cast<String>(value);
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Returns the index for an expression like $variableName$.$field$, or like
+ * $navigationName$.name for indexed object names.
+ */
+FilterIndexData *FilterIndex::GetIndex(const Type::Ptr& type, const String& variableName, Expression *exp, bool membership)
+{
+	auto ixr (dynamic_cast<IndexerExpression*>(exp));
+
+	if (!ixr)
+		return nullptr;
+
+	auto var (dynamic_cast<VariableExpression*>(ixr->GetOperand1().get()));
+	auto lit (dynamic_cast<LiteralExpression*>(ixr->GetOperand2().get()));
+
+	if (!var || !lit || !lit->GetValue().IsString())
+		return nullptr;
+
+	const String& attr = lit->GetValue().Get<String>();
+	bool self = var->GetVariable() == variableName || var->GetVariable() == "obj";
+
+	auto indexes (l_FilterIndexes.find(type.get()));
+
+	if (indexes == l_FilterIndexes.end())
+		return nullptr;
+
+	for (auto& index : indexes->second) {
+		if (self && index->FieldName == attr)
+			return index.get();
+
+		if (!membership && !self && attr == "name" && !index->NavigationName.IsEmpty() && index->NavigationName == var->GetVariable())
+			return index.get();
+	}
+
+	return nullptr;
+}
+
+/**
+ * Looks up the objects which may match a filter using the conjunctive equality
+ * and `in` parts of it, e.g. `service.state == 2 && "linux" in service.groups`.
+ * The filter still has to be evaluated for each candidate.
+ *
+ * @param type The type of the filtered objects.
+ * @param filter The parsed (not yet compiled) filter expression.
+ * @param variableName The name the filtered object is available as.
+ * @param constants The filter variables.
+ * @param candidates The objects which may match the filter.
+ * @returns Whether an index was used. If not, all objects have to be checked.
+ */
+bool FilterIndex::FindCandidates(const Type::Ptr& type, Expression *filter, const String& variableName,
+	const Dictionary::Ptr& constants, std::vector<ConfigObject::Ptr>& candidates)
+{
+	if (l_FilterIndexes.find(type.get()) == l_FilterIndexes.end())
+		return false;
+
+	String varName = variableName.IsEmpty() ? type->GetName().ToLower() : variableName;
+
+	auto getConst ([&constants, &varName](Expression *exp) -> const Value * {
+		auto lit (dynamic_cast<LiteralExpression*>(exp));
+
+		if (lit)
+			return &lit->GetValue();
+
+		auto var (dynamic_cast<VariableExpression*>(exp));
+
+		if (var && constants && var->GetVariable() != varName && var->GetVariable() != "obj")
+			return constants->GetRef(var->GetVariable());
+
+		return nullptr;
+	});
+
+	std::vector<Expression*> terms { filter };
+	FilterIndexData *bestIndex = nullptr;
+	String bestKey;
+	size_t bestCount = 0;
+
+	while (!terms.empty()) {
+		Expression *term = terms.back();
+		terms.pop_back();
+
+		auto land (dynamic_cast<LogicalAndExpression*>(term));
+
+		if (land) {
+			terms.push_back(land->GetOperand1().get());
+			terms.push_back(land->GetOperand2().get());
+			continue;
+		}
+
+		FilterIndexData *index = nullptr;
+		const Value *value = nullptr;
+		bool membership = false;
+
+		auto eq (dynamic_cast<EqualExpression*>(term));
+
+		if (eq) {
+			index = GetIndex(type, varName, eq->GetOperand1().get(), false);
+			value = getConst(eq->GetOperand2().get());
+
+			if (!index || !value) {
+				index = GetIndex(type, varName, eq->GetOperand2().get(), false);
+				value = getConst(eq->GetOperand1().get());
+			}
+		}
+
+		auto in (dynamic_cast<InExpression*>(term));
+
+		if (in) {
+			index = GetIndex(type, varName, in->GetOperand2().get(), true);
+			value = getConst(in->GetOperand1().get());
+			membership = true;
+		}
+
+		String key;
+
+		if (!index || !value || !GetIndexKey(*value, membership, key))
+			continue;
+
+		size_t count;
+
+		{
+			std::unique_lock<std::mutex> lock (index->Mutex);
+
+			auto objects (index->Objects.find(key));
+			count = objects == index->Objects.end() ? 0 : objects->second.size();
+		}
+
+		if (!bestIndex || count < bestCount) {
+			bestIndex = index;
+			bestKey = std::move(key);
+			bestCount = count;
+		}
+	}
+
+	if (!bestIndex)
+		return false;
+
+	std::unique_lock<std::mutex> lock (bestIndex->Mutex);
+
+	auto objects (bestIndex->Objects.find(bestKey));
+
+	if (objects != bestIndex->Objects.end())
+		candidates.insert(candidates.end(), objects->second.begin(), objects->second.end());
+
+	return true;
+}
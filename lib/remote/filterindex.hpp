@@ -0,0 +1,48 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef FILTERINDEX_H
+#define FILTERINDEX_H
+
+#include "remote/i2-remote.hpp"
+#include "config/expression.hpp"
+#include "base/configobject.hpp"
+#include "base/dictionary.hpp"
+#include "base/type.hpp"
+#include <vector>
+
+namespace icinga
+{
+
+struct FilterIndexData;
+
+/**
+ * In-memory indexes on frequently filtered attributes of active config objects.
+ *
+ * An index maps the values of one attribute to the objects having them. Array
+ * values are indexed by their elements to serve `"x" in obj.attr` as well.
+ * Indexes are kept up to date by the attribute change handlers of the indexed
+ * field and of the fields it's computed from.
+ *
+ * @ingroup remote
+ */
+class FilterIndex
+{
+public:
+	static void Register(const Type::Ptr& type, const String& field, const std::vector<String>& sourceFields = {},
+		const String& navigationName = String());
+	static void Update(const ConfigObject::Ptr& object);
+
+	static bool FindCandidates(const Type::Ptr& type, Expression *filter, const String& variableName,
+		const Dictionary::Ptr& constants, std::vector<ConfigObject::Ptr>& candidates);
+
+private:
+	FilterIndex();
+
+	static void UpdateObject(FilterIndexData& index, const ConfigObject::Ptr& object);
+	static FilterIndexData *GetIndex(const Type::Ptr& type, const String& variableName, Expression *exp, bool membership);
+	static bool GetIndexKey(const Value& value, bool membership, String& key);
+};
+
+}
+
+#endif /* FILTERINDEX_H */
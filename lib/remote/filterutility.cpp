@@ -1,14 +1,17 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "remote/filterutility.hpp"
+#include "remote/filterindex.hpp"
 #include "remote/httputility.hpp"
 #include "config/applyrule.hpp"
+#include "config/bytecode.hpp"
 #include "config/configcompiler.hpp"
 #include "config/expression.hpp"
 #include "base/namespace.hpp"
 #include "base/json.hpp"
 #include "base/configtype.hpp"
 #include "base/logger.hpp"
+#include "base/lrucache.hpp"
 #include "base/utility.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
 #include <memory>
@@ -68,6 +71,33 @@ String ConfigObjectTargetProvider::GetPluralName(const String& type) const
 	return Type::GetByName(type)->GetPluralName();
 }
 
+/**
+ * The filter of an API request as parsed, which is what the targeted lookups and the filter index look at,
+ * and compiled to bytecode, which is what is evaluated.
+ */
+struct CachedFilterExpression
+{
+	Expression::Ptr Parsed;
+	Expression::Ptr Compiled;
+};
+
+/* Clients tend to send the same few filters over and over again. They are compiled independently of
+ * the filter_vars, which only become variables of the frame they are evaluated in.
+ */
+static LruCache<String, std::shared_ptr<const CachedFilterExpression>> l_FilterCache (1024);
+
+static std::shared_ptr<const CachedFilterExpression> GetCachedFilter(const String& filter)
+{
+	return l_FilterCache.Get(filter, [&filter]() {
+		auto cached (std::make_shared<CachedFilterExpression>());
+
+		cached->Parsed = ConfigCompiler::CompileText("<API query>", filter).release();
+		cached->Compiled = BytecodeExpression::Compile(cached->Parsed);
+
+		return std::shared_ptr<const CachedFilterExpression>(std::move(cached));
+	});
+}
+
 bool FilterUtility::EvaluateFilter(ScriptFrame& frame, Expression *filter,
 	const Object::Ptr& target, const String& variableName)
 {
@@ -136,7 +166,8 @@ static void FilteredAddTarget(ScriptFrame& permissionFrame, Expression *permissi
  * @param permission The actual permission you want to check the user permission against
  * @param permissionFilter Expression pointer that is used as an output buffer for all the filter expressions of the
  *                         individual permissions of the given user to be evaluated. It's up to the caller to delete
- *                         this pointer when it's not needed any more.
+ *                         this pointer when it's not needed any more. The filters are compiled once per user and
+ *                         required permission, see ApiUser::GetPermissionCheck().
  *
  * @return bool
  */
@@ -148,49 +179,19 @@ bool FilterUtility::HasPermission(const ApiUser::Ptr& user, const String& permis
 	if (permission.IsEmpty())
 		return true;
 
-	bool foundPermission = false;
 	String requiredPermission = permission.ToLower();
+	auto check (user->GetPermissionCheck(requiredPermission));
 
-	Array::Ptr permissions = user->GetPermissions();
-	if (permissions) {
-		ObjectLock olock(permissions);
-		for (const Value& item : permissions) {
-			String permission;
-			Function::Ptr filter;
-			if (item.IsObjectType<Dictionary>()) {
-				Dictionary::Ptr dict = item;
-				permission = dict->Get("permission");
-				filter = dict->Get("filter");
-			} else
-				permission = item;
-
-			permission = permission.ToLower();
-
-			if (!Utility::Match(permission, requiredPermission))
-				continue;
-
-			foundPermission = true;
-
-			if (filter && permissionFilter) {
-				std::vector<std::unique_ptr<Expression> > args;
-				args.emplace_back(new GetScopeExpression(ScopeThis));
-				std::unique_ptr<Expression> indexer{new IndexerExpression(std::unique_ptr<Expression>(MakeLiteral(filter)), std::unique_ptr<Expression>(MakeLiteral("call")))};
-				FunctionCallExpression *fexpr = new FunctionCallExpression(std::move(indexer), std::move(args));
-
-				if (!*permissionFilter)
-					permissionFilter->reset(fexpr);
-				else
-					*permissionFilter = std::make_unique<LogicalOrExpression>(std::move(*permissionFilter), std::unique_ptr<Expression>(fexpr));
-			}
-		}
-	}
-
-	if (!foundPermission) {
+	if (!check->Found) {
 		Log(LogWarning, "FilterUtility")
 			<< "Missing permission: " << requiredPermission;
 	}
 
-	return foundPermission;
+	/* The compiled filter is shared with other requests. */
+	if (permissionFilter && check->Filter)
+		permissionFilter->reset(new OwnedExpression(check->Filter));
+
+	return check->Found;
 }
 
 void FilterUtility::CheckPermission(const ApiUser::Ptr& user, const String& permission, std::unique_ptr<Expression>* permissionFilter)
@@ -271,13 +272,14 @@ std::vector<Value> FilterUtility::GetFilterTargets(const QueryDescription& qd, c
 
 		if (query->Contains("filter")) {
 			String filter = HttpUtility::GetLastParameter(query, "filter");
-			std::unique_ptr<Expression> ufilter = ConfigCompiler::CompileText("<API query>", filter);
+			auto cachedFilter (GetCachedFilter(filter));
+			Expression *ufilter = cachedFilter->Parsed.get();
 			Dictionary::Ptr filter_vars = query->Get("filter_vars");
 			bool targeted = false;
 			std::vector<ConfigObject::Ptr> targets;
 
 			if (dynamic_cast<ConfigObjectTargetProvider*>(provider.get())) {
-				auto dict (dynamic_cast<DictExpression*>(ufilter.get()));
+				auto dict (dynamic_cast<DictExpression*>(ufilter));
 
 				if (dict) {
 					auto& subex (dict->GetExpressions());
@@ -307,8 +309,13 @@ std::vector<Value> FilterUtility::GetFilterTargets(const QueryDescription& qd, c
 								static const auto ctypeService (dynamic_cast<ConfigType*>(typeService.get()));
 								targeted = true;
 
+								/* Reused for all names, so that only the first ones need to allocate. */
+								std::string serviceName;
+
 								for (auto name : targetNames) {
-									auto target (ctypeService->GetObject(*name.first + "!" + *name.second));
+									serviceName.assign(name.first->GetData()).append(1, '!').append(name.second->GetData());
+
+									auto target (ctypeService->GetObject(std::string_view(serviceName)));
 
 									if (target) {
 										targets.emplace_back(target);
@@ -327,6 +334,21 @@ std::vector<Value> FilterUtility::GetFilterTargets(const QueryDescription& qd, c
 					}
 				}
 			} else {
+				std::vector<ConfigObject::Ptr> candidates;
+				bool indexed = false;
+
+				if (dynamic_cast<ConfigObjectTargetProvider*>(provider.get())) {
+					auto dict (dynamic_cast<DictExpression*>(ufilter));
+
+					if (dict && dict->GetExpressions().size() == 1u) {
+						indexed = FilterIndex::FindCandidates(Type::GetByName(type), dict->GetExpressions().at(0).get(),
+							variableName, filter_vars, candidates);
+					}
+				}
+
+				/* The targeted detection above looks at the parsed expression. */
+				ufilter = cachedFilter->Compiled.get();
+
 				if (filter_vars) {
 					ObjectLock olock (filter_vars);
 
@@ -335,9 +357,15 @@ std::vector<Value> FilterUtility::GetFilterTargets(const QueryDescription& qd, c
 					}
 				}
 
-				provider->FindTargets(type, [&permissionFrame, &permissionFilter, &frame, &ufilter, &result, variableName](const Object::Ptr& target) {
-					FilteredAddTarget(permissionFrame, permissionFilter.get(), frame, &*ufilter, result, variableName, target);
-				});
+				if (indexed) {
+					for (auto& target : candidates) {
+						FilteredAddTarget(permissionFrame, permissionFilter.get(), frame, ufilter, result, variableName, target);
+					}
+				} else {
+					provider->FindTargets(type, [&permissionFrame, &permissionFilter, &frame, ufilter, &result, variableName](const Object::Ptr& target) {
+						FilteredAddTarget(permissionFrame, permissionFilter.get(), frame, ufilter, result, variableName, target);
+					});
+				}
 			}
 		} else {
 			/* Ensure to pass a nullptr as filter expression.
@@ -3,15 +3,160 @@
 #include "base/logger.hpp"
 #include "remote/httphandler.hpp"
 #include "remote/httputility.hpp"
+#include "remote/apilistener.hpp"
+#include "base/configobject.hpp"
+#include "base/json.hpp"
 #include "base/singleton.hpp"
 #include "base/exception.hpp"
+#include "base/tlsutility.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/beast/http.hpp>
 
 using namespace icinga;
 
 Dictionary::Ptr HttpHandler::m_UrlTree;
 
+/**
+ * A response to a GET request for a cacheable handler.
+ *
+ * @ingroup remote
+ */
+struct CachedHttpResponse
+{
+	uint_least64_t ChangeCount;
+	double Expires;
+	String ETag;
+	String ContentType;
+	std::string Body;
+};
+
+static std::mutex l_ResponseCacheMutex;
+static std::unordered_map<String, CachedHttpResponse> l_ResponseCache;
+static size_t l_ResponseCacheBytes = 0;
+
+/* Upper bound for the size of all cached response bodies. */
+static const size_t l_ResponseCacheMaxBytes = 64 * 1024 * 1024;
+
+/**
+ * Removes entries from the response cache until there is enough space for a
+ * new entry. Expired and outdated entries go first, then those expiring next.
+ *
+ * The caller must hold l_ResponseCacheMutex.
+ */
+static void ShrinkResponseCache(size_t bytes)
+{
+	double now = Utility::GetTime();
+	uint_least64_t changeCount = ConfigObject::GetChangeCount();
+
+	for (auto it (l_ResponseCache.begin()); it != l_ResponseCache.end();) {
+		if (it->second.Expires <= now || it->second.ChangeCount != changeCount) {
+			l_ResponseCacheBytes -= it->second.Body.size();
+			it = l_ResponseCache.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	while (!l_ResponseCache.empty() && l_ResponseCacheBytes + bytes > l_ResponseCacheMaxBytes) {
+		auto next (std::min_element(l_ResponseCache.begin(), l_ResponseCache.end(), [](const auto& a, const auto& b) {
+			return a.second.Expires < b.second.Expires;
+		}));
+
+		l_ResponseCacheBytes -= next->second.Body.size();
+		l_ResponseCache.erase(next);
+	}
+}
+
+/**
+ * Sets the ETag header of a response and turns it into a
+ * 304 Not Modified if the client already has this version.
+ */
+static void SetETag(const boost::beast::http::request<boost::beast::http::string_body>& request,
+	boost::beast::http::response<boost::beast::http::string_body>& response, const String& etag)
+{
+	namespace http = boost::beast::http;
+
+	response.set(http::field::etag, etag);
+
+	std::vector<String> tags;
+	auto ifNoneMatchView (request[http::field::if_none_match]);
+	String ifNoneMatch (ifNoneMatchView.begin(), ifNoneMatchView.end());
+	boost::algorithm::split(tags, ifNoneMatch, boost::is_any_of(","));
+
+	for (String& tag : tags) {
+		boost::algorithm::trim(tag);
+
+		if (tag == "*" || tag == etag || tag == "W/" + etag) {
+			response.result(http::status::not_modified);
+			response.body().clear();
+			response.erase(http::field::content_type);
+			response.erase(http::field::content_length);
+			return;
+		}
+	}
+}
+
+/**
+ * Returns the number of seconds responses to this request may be cached for.
+ *
+ * @returns The cache TTL, 0 if the response must not be cached.
+ */
+double HttpHandler::GetResponseCacheTtl(const boost::beast::http::request<boost::beast::http::string_body>& request)
+{
+	if (request.method() != boost::beast::http::verb::get)
+		return 0;
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	return listener ? listener->GetHttpResponseCacheTtl() : 0;
+}
+
+/**
+ * Whether the GET responses of this handler can be cached until an object changes.
+ */
+bool HttpHandler::IsCacheable() const
+{
+	return false;
+}
+
+/**
+ * Whether this handler may write the response to the request to the stream
+ * itself. Such requests aren't processed concurrently with other requests
+ * of the same connection.
+ */
+bool HttpHandler::IsStreaming(const boost::beast::http::request<boost::beast::http::string_body>&) const
+{
+	return false;
+}
+
+/**
+ * Whether any of the handlers of the request's URL may stream the response.
+ */
+bool HttpHandler::IsStreamingRequest(const boost::beast::http::request<boost::beast::http::string_body>& request)
+{
+	Url::Ptr url;
+
+	try {
+		url = new Url(std::string(request.target()));
+	} catch (const std::exception&) {
+		/* ProcessRequest() reports the error. */
+		return false;
+	}
+
+	auto handlers (GetHandlers(url->GetPath()));
+
+	return std::any_of(handlers.begin(), handlers.end(), [&request](const HttpHandler::Ptr& handler) {
+		return handler->IsStreaming(request);
+	});
+}
+
 void HttpHandler::Register(const Url::Ptr& url, const HttpHandler::Ptr& handler)
 {
 	if (!m_UrlTree)
@@ -46,21 +191,14 @@ void HttpHandler::Register(const Url::Ptr& url, const HttpHandler::Ptr& handler)
 	handlers->Add(handler);
 }
 
-void HttpHandler::ProcessRequest(
-	AsioTlsStream& stream,
-	const ApiUser::Ptr& user,
-	boost::beast::http::request<boost::beast::http::string_body>& request,
-	boost::beast::http::response<boost::beast::http::string_body>& response,
-	boost::asio::yield_context& yc,
-	HttpServerConnection& server
-)
+/**
+ * Returns the handlers for a URL path, the most specific ones first.
+ */
+std::vector<HttpHandler::Ptr> HttpHandler::GetHandlers(const std::vector<String>& path)
 {
 	Dictionary::Ptr node = m_UrlTree;
 	std::vector<HttpHandler::Ptr> handlers;
 
-	Url::Ptr url = new Url(std::string(request.target()));
-	auto& path (url->GetPath());
-
 	for (std::vector<String>::size_type i = 0; i <= path.size(); i++) {
 		Array::Ptr current_handlers = node->Get("handlers");
 
@@ -89,6 +227,22 @@ void HttpHandler::ProcessRequest(
 
 	std::reverse(handlers.begin(), handlers.end());
 
+	return handlers;
+}
+
+void HttpHandler::ProcessRequest(
+	AsioTlsStream& stream,
+	const ApiUser::Ptr& user,
+	boost::beast::http::request<boost::beast::http::string_body>& request,
+	boost::beast::http::response<boost::beast::http::string_body>& response,
+	boost::asio::yield_context& yc,
+	HttpServerConnection& server
+)
+{
+	Url::Ptr url = new Url(std::string(request.target()));
+	auto& path (url->GetPath());
+	std::vector<HttpHandler::Ptr> handlers (GetHandlers(path));
+
 	Dictionary::Ptr params;
 
 	try {
@@ -98,6 +252,38 @@ void HttpHandler::ProcessRequest(
 		return;
 	}
 
+	/* Responses are cached by user, path and parameters, i.e. URL query and body. */
+	String cacheKey;
+	double cacheTtl = 0;
+	uint_least64_t changeCount = 0;
+
+	if (std::any_of(handlers.begin(), handlers.end(), [](const HttpHandler::Ptr& handler) { return handler->IsCacheable(); }))
+		cacheTtl = GetResponseCacheTtl(request);
+
+	if (cacheTtl > 0) {
+		cacheKey = (user ? user->GetName() : String()) + "\n" + boost::algorithm::join(path, "/") + "\n" + JsonEncode(params);
+		changeCount = ConfigObject::GetChangeCount();
+
+		std::unique_lock<std::mutex> lock (l_ResponseCacheMutex);
+
+		auto cached (l_ResponseCache.find(cacheKey));
+
+		if (cached != l_ResponseCache.end()) {
+			if (cached->second.ChangeCount == changeCount && cached->second.Expires > Utility::GetTime()) {
+				response.result(boost::beast::http::status::ok);
+				response.set(boost::beast::http::field::content_type, cached->second.ContentType);
+				response.body() = cached->second.Body;
+				response.content_length(response.body().size());
+
+				SetETag(request, response, cached->second.ETag);
+				return;
+			}
+
+			l_ResponseCacheBytes -= cached->second.Body.size();
+			l_ResponseCache.erase(cached);
+		}
+	}
+
 	bool processed = false;
 
 	/*
@@ -125,4 +311,34 @@ void HttpHandler::ProcessRequest(
 			"' could not be found or the request method is not valid for this path.");
 		return;
 	}
+
+	if (!cacheKey.IsEmpty() && response.result() == boost::beast::http::status::ok && !response.chunked()) {
+		String etag = "\"" + SHA1(response.body()) + "\"";
+		size_t size = response.body().size();
+
+		/* Don't cache what has changed while the response was being built. */
+		if (size <= l_ResponseCacheMaxBytes / 4 && changeCount == ConfigObject::GetChangeCount()) {
+			std::unique_lock<std::mutex> lock (l_ResponseCacheMutex);
+
+			auto cached (l_ResponseCache.find(cacheKey));
+
+			if (cached != l_ResponseCache.end()) {
+				l_ResponseCacheBytes -= cached->second.Body.size();
+				l_ResponseCache.erase(cached);
+			}
+
+			ShrinkResponseCache(size);
+
+			auto contentType (response[boost::beast::http::field::content_type]);
+
+			l_ResponseCache[cacheKey] = CachedHttpResponse{
+				changeCount, Utility::GetTime() + cacheTtl, etag,
+				String(contentType.begin(), contentType.end()), response.body()
+			};
+
+			l_ResponseCacheBytes += size;
+		}
+
+		SetETag(request, response, etag);
+	}
 }
@@ -37,7 +37,12 @@ public:
 		HttpServerConnection& server
 	) = 0;
 
+	virtual bool IsCacheable() const;
+	virtual bool IsStreaming(const boost::beast::http::request<boost::beast::http::string_body>& request) const;
+
 	static void Register(const Url::Ptr& url, const HttpHandler::Ptr& handler);
+	static double GetResponseCacheTtl(const boost::beast::http::request<boost::beast::http::string_body>& request);
+	static bool IsStreamingRequest(const boost::beast::http::request<boost::beast::http::string_body>& request);
 	static void ProcessRequest(
 		AsioTlsStream& stream,
 		const ApiUser::Ptr& user,
@@ -49,6 +54,8 @@ public:
 
 private:
 	static Dictionary::Ptr m_UrlTree;
+
+	static std::vector<HttpHandler::Ptr> GetHandlers(const std::vector<String>& path);
 };
 
 /**
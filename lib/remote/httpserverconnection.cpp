@@ -24,6 +24,7 @@
 #include <stdexcept>
 #include <boost/asio/error.hpp>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/asio/spawn.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
@@ -35,6 +36,40 @@ using namespace icinga;
 
 auto const l_ServerHeader ("Icinga/" + Application::GetAppVersion());
 
+/* Pipelined requests processed concurrently per connection. */
+static const size_t l_MaxPendingRequests = 64;
+
+namespace icinga
+{
+
+/**
+ * A request whose response hasn't been written yet.
+ *
+ * @ingroup remote
+ */
+struct HttpPendingRequest
+{
+	boost::beast::http::parser<true, boost::beast::http::string_body> Parser;
+	boost::beast::http::response<boost::beast::http::string_body> Response;
+	std::unique_ptr<Log> LogMessage;
+	std::chrono::steady_clock::time_point Start;
+	bool Done = false;
+};
+
+}
+
+static void LogResponse(HttpPendingRequest& pending)
+{
+	namespace ch = std::chrono;
+
+	if (pending.LogMessage) {
+		*pending.LogMessage << ", status: " << pending.Response.result() << ") took "
+			<< ch::duration_cast<ch::milliseconds>(ch::steady_clock::now() - pending.Start).count() << "ms.";
+
+		pending.LogMessage.reset();
+	}
+}
+
 HttpServerConnection::HttpServerConnection(const String& identity, bool authenticated, const Shared<AsioTlsStream>::Ptr& stream)
 	: HttpServerConnection(identity, authenticated, stream, IoEngine::Get().GetIoContext())
 {
@@ -42,7 +77,7 @@ HttpServerConnection::HttpServerConnection(const String& identity, bool authenti
 
 HttpServerConnection::HttpServerConnection(const String& identity, bool authenticated, const Shared<AsioTlsStream>::Ptr& stream, boost::asio::io_context& io)
 	: m_Stream(stream), m_Seen(Utility::GetTime()), m_IoStrand(io), m_ShuttingDown(false), m_HasStartedStreaming(false),
-	m_CheckLivenessTimer(io)
+	m_CheckLivenessTimer(io), m_ResponseReady(io), m_ResponseWritten(io)
 {
 	if (authenticated) {
 		m_ApiUser = ApiUser::GetByClientCN(identity);
@@ -65,6 +100,7 @@ void HttpServerConnection::Start()
 	HttpServerConnection::Ptr keepAlive (this);
 
 	IoEngine::SpawnCoroutine(m_IoStrand, [this, keepAlive](asio::yield_context yc) { ProcessMessages(yc); });
+	IoEngine::SpawnCoroutine(m_IoStrand, [this, keepAlive](asio::yield_context yc) { WriteResponses(yc); });
 	IoEngine::SpawnCoroutine(m_IoStrand, [this, keepAlive](asio::yield_context yc) { CheckLiveness(yc); });
 }
 
@@ -92,6 +128,8 @@ void HttpServerConnection::Disconnect()
 			boost::system::error_code ec;
 
 			m_CheckLivenessTimer.cancel();
+			m_ResponseReady.Set();
+			m_ResponseWritten.Set();
 
 			m_Stream->lowest_layer().cancel(ec);
 
@@ -190,11 +228,6 @@ bool EnsureValidHeaders(
 
 		response.set(http::field::connection, "close");
 
-		boost::system::error_code ec;
-
-		http::async_write(stream, response, yc[ec]);
-		stream.async_flush(yc[ec]);
-
 		return false;
 	}
 
@@ -224,10 +257,8 @@ void HandleExpect100(
 
 static inline
 bool HandleAccessControl(
-	AsioTlsStream& stream,
 	boost::beast::http::request<boost::beast::http::string_body>& request,
-	boost::beast::http::response<boost::beast::http::string_body>& response,
-	boost::asio::yield_context& yc
+	boost::beast::http::response<boost::beast::http::string_body>& response
 )
 {
 	namespace http = boost::beast::http;
@@ -257,11 +288,6 @@ bool HandleAccessControl(
 					response.content_length(response.body().size());
 					response.set(http::field::connection, "close");
 
-					boost::system::error_code ec;
-
-					http::async_write(stream, response, yc[ec]);
-					stream.async_flush(yc[ec]);
-
 					return false;
 				}
 			}
@@ -273,10 +299,8 @@ bool HandleAccessControl(
 
 static inline
 bool EnsureAcceptHeader(
-	AsioTlsStream& stream,
 	boost::beast::http::request<boost::beast::http::string_body>& request,
-	boost::beast::http::response<boost::beast::http::string_body>& response,
-	boost::asio::yield_context& yc
+	boost::beast::http::response<boost::beast::http::string_body>& response
 )
 {
 	namespace http = boost::beast::http;
@@ -288,11 +312,6 @@ bool EnsureAcceptHeader(
 		response.content_length(response.body().size());
 		response.set(http::field::connection, "close");
 
-		boost::system::error_code ec;
-
-		http::async_write(stream, response, yc[ec]);
-		stream.async_flush(yc[ec]);
-
 		return false;
 	}
 
@@ -301,11 +320,9 @@ bool EnsureAcceptHeader(
 
 static inline
 bool EnsureAuthenticatedUser(
-	AsioTlsStream& stream,
 	boost::beast::http::request<boost::beast::http::string_body>& request,
 	ApiUser::Ptr& authenticatedUser,
-	boost::beast::http::response<boost::beast::http::string_body>& response,
-	boost::asio::yield_context& yc
+	boost::beast::http::response<boost::beast::http::string_body>& response
 )
 {
 	namespace http = boost::beast::http;
@@ -329,11 +346,6 @@ bool EnsureAuthenticatedUser(
 			response.content_length(response.body().size());
 		}
 
-		boost::system::error_code ec;
-
-		http::async_write(stream, response, yc[ec]);
-		stream.async_flush(yc[ec]);
-
 		return false;
 	}
 
@@ -423,15 +435,31 @@ bool EnsureValidBody(
 
 		response.set(http::field::connection, "close");
 
-		http::async_write(stream, response, yc[ec]);
-		stream.async_flush(yc[ec]);
-
 		return false;
 	}
 
 	return true;
 }
 
+/**
+ * Whether requests with this method may be processed concurrently, see RFC 7231 section 4.2.1.
+ */
+static inline
+bool IsSafeMethod(boost::beast::http::verb method)
+{
+	namespace http = boost::beast::http;
+
+	switch (method) {
+		case http::verb::get:
+		case http::verb::head:
+		case http::verb::options:
+		case http::verb::trace:
+			return true;
+		default:
+			return false;
+	}
+}
+
 static inline
 bool ProcessRequest(
 	AsioTlsStream& stream,
@@ -486,6 +514,7 @@ bool ProcessRequest(
 
 void HttpServerConnection::ProcessMessages(boost::asio::yield_context yc)
 {
+	namespace asio = boost::asio;
 	namespace beast = boost::beast;
 	namespace http = beast::http;
 	namespace ch = std::chrono;
@@ -501,20 +530,31 @@ void HttpServerConnection::ProcessMessages(boost::asio::yield_context yc)
 		for (;;) {
 			m_Seen = Utility::GetTime();
 
-			http::parser<true, http::string_body> parser;
-			http::response<http::string_body> response;
+			auto pending (std::make_shared<HttpPendingRequest>());
+			auto& parser (pending->Parser);
+			auto& response (pending->Response);
 
 			parser.header_limit(1024 * 1024);
 			parser.body_limit(-1);
 
 			response.set(http::field::server, l_ServerHeader);
 
+			/* Error responses are written after the responses to the preceding requests. */
+			auto queueResponse ([this, &pending]() {
+				if (!m_ShuttingDown) {
+					pending->Done = true;
+					m_PendingRequests.emplace_back(pending);
+					m_ResponseReady.Set();
+				}
+			});
+
 			if (!EnsureValidHeaders(*m_Stream, buf, parser, response, m_ShuttingDown, yc)) {
+				queueResponse();
 				break;
 			}
 
 			m_Seen = Utility::GetTime();
-			auto start (ch::steady_clock::now());
+			pending->Start = ch::steady_clock::now();
 
 			auto& request (parser.get());
 
@@ -526,6 +566,10 @@ void HttpServerConnection::ProcessMessages(boost::asio::yield_context yc)
 				}
 			}
 
+			if (request[http::field::expect] == "100-continue") {
+				WaitForResponses(0, yc);
+			}
+
 			HandleExpect100(*m_Stream, request, yc);
 
 			auto authenticatedUser (m_ApiUser);
@@ -534,44 +578,98 @@ void HttpServerConnection::ProcessMessages(boost::asio::yield_context yc)
 				authenticatedUser = ApiUser::GetByAuthHeader(std::string(request[http::field::authorization]));
 			}
 
-			Log logMsg (LogInformation, "HttpServerConnection");
+			pending->LogMessage = std::make_unique<Log>(LogInformation, "HttpServerConnection");
 
-			logMsg << "Request " << request.method_string() << ' ' << request.target()
+			*pending->LogMessage << "Request " << request.method_string() << ' ' << request.target()
 				<< " (from " << m_PeerAddress
 				<< ", user: " << (authenticatedUser ? authenticatedUser->GetName() : "<unauthenticated>")
 				<< ", agent: " << request[http::field::user_agent]; //operator[] - Returns the value for a field, or "" if it does not exist.
 
-			Defer addRespCode ([&response, start, &logMsg]() {
-				logMsg << ", status: " << response.result() << ") took "
-					<< ch::duration_cast<ch::milliseconds>(ch::steady_clock::now() - start).count() << "ms.";
+			bool concurrent = false;
+
+			Defer addRespCode ([&pending, &concurrent]() {
+				/* Concurrently processed requests are logged once they're done. */
+				if (!concurrent) {
+					LogResponse(*pending);
+				}
 			});
 
-			if (!HandleAccessControl(*m_Stream, request, response, yc)) {
+			if (!HandleAccessControl(request, response)) {
+				queueResponse();
 				break;
 			}
 
-			if (!EnsureAcceptHeader(*m_Stream, request, response, yc)) {
+			if (!EnsureAcceptHeader(request, response)) {
+				queueResponse();
 				break;
 			}
 
-			if (!EnsureAuthenticatedUser(*m_Stream, request, authenticatedUser, response, yc)) {
+			if (!EnsureAuthenticatedUser(request, authenticatedUser, response)) {
+				queueResponse();
 				break;
 			}
 
 			if (!EnsureValidBody(*m_Stream, buf, parser, authenticatedUser, response, m_ShuttingDown, yc)) {
+				queueResponse();
 				break;
 			}
 
-			m_Seen = std::numeric_limits<decltype(m_Seen)>::max();
+			/* Read before a concurrently processed handler gets the request. */
+			bool keepAlive = request.version() == 11 && request[http::field::connection] != "close";
 
-			if (!ProcessRequest(*m_Stream, request, authenticatedUser, response, *this, m_HasStartedStreaming, yc)) {
-				break;
+			if (HttpHandler::IsStreamingRequest(request)) {
+				/* Streaming handlers write to the stream themselves. */
+				WaitForResponses(0, yc);
+
+				if (m_ShuttingDown) {
+					break;
+				}
+
+				m_Seen = std::numeric_limits<decltype(m_Seen)>::max();
+
+				if (!ProcessRequest(*m_Stream, request, authenticatedUser, response, *this, m_HasStartedStreaming, yc)) {
+					break;
+				}
+			} else if (!IsSafeMethod(request.method())) {
+				/* RFC 7230 only allows safe requests to be processed concurrently. A non-safe one
+				 * waits for the preceding requests and the following ones wait for it.
+				 */
+				WaitForResponses(0, yc);
+
+				if (m_ShuttingDown) {
+					break;
+				}
+
+				concurrent = true;
+				m_PendingRequests.emplace_back(pending);
+
+				ProcessPendingRequest(pending, authenticatedUser, yc);
+			} else {
+				/* Pipelined safe requests are processed concurrently on m_IoStrand
+				 * while their responses are written in order by WriteResponses().
+				 */
+				WaitForResponses(l_MaxPendingRequests - 1, yc);
+
+				if (m_ShuttingDown) {
+					break;
+				}
+
+				concurrent = true;
+				m_PendingRequests.emplace_back(pending);
+
+				HttpServerConnection::Ptr keepAliveConn (this);
+
+				IoEngine::SpawnCoroutine(m_IoStrand, [this, keepAliveConn, pending, authenticatedUser](asio::yield_context yc) {
+					ProcessPendingRequest(pending, authenticatedUser, yc);
+				});
 			}
 
-			if (request.version() != 11 || request[http::field::connection] == "close") {
+			if (!keepAlive) {
 				break;
 			}
 		}
+
+		WaitForResponses(0, yc);
 	} catch (const std::exception& ex) {
 		if (!m_ShuttingDown) {
 			Log(LogCritical, "HttpServerConnection")
@@ -582,6 +680,93 @@ void HttpServerConnection::ProcessMessages(boost::asio::yield_context yc)
 	Disconnect();
 }
 
+/**
+ * Processes a request on m_IoStrand, concurrently to the other safe requests of this connection.
+ * The response is written by WriteResponses().
+ */
+void HttpServerConnection::ProcessPendingRequest(const std::shared_ptr<HttpPendingRequest>& pending,
+	const ApiUser::Ptr& user, boost::asio::yield_context& yc)
+{
+	namespace http = boost::beast::http;
+
+	auto& response (pending->Response);
+
+	try {
+		CpuBoundWork handlingRequest (yc);
+
+		HttpHandler::ProcessRequest(*m_Stream, user, pending->Parser.get(), response, yc, *this);
+	} catch (const std::exception& ex) {
+		response = http::response<http::string_body>();
+		response.set(http::field::server, l_ServerHeader);
+
+		HttpUtility::SendJsonError(response, nullptr, 500, "Unhandled exception" , DiagnosticInformation(ex));
+	}
+
+	LogResponse(*pending);
+
+	HttpServerConnection::Ptr keepAlive (this);
+
+	boost::asio::post(m_IoStrand, [this, keepAlive, pending]() {
+		pending->Done = true;
+		m_ResponseReady.Set();
+	});
+}
+
+/**
+ * Waits until at most maxPending responses are yet to be written.
+ */
+void HttpServerConnection::WaitForResponses(size_t maxPending, boost::asio::yield_context& yc)
+{
+	while (m_PendingRequests.size() > maxPending && !m_ShuttingDown) {
+		m_ResponseWritten.Clear();
+		m_ResponseWritten.Wait(yc);
+	}
+}
+
+/**
+ * Writes the responses to the pending requests in the order of the requests.
+ */
+void HttpServerConnection::WriteResponses(boost::asio::yield_context yc)
+{
+	namespace http = boost::beast::http;
+
+	boost::system::error_code ec;
+
+	while (!m_ShuttingDown) {
+		if (m_PendingRequests.empty() || !m_PendingRequests.front()->Done) {
+			m_ResponseReady.Clear();
+			m_ResponseReady.Wait(yc);
+			continue;
+		}
+
+		http::async_write(*m_Stream, m_PendingRequests.front()->Response, yc[ec]);
+
+		if (ec) {
+			break;
+		}
+
+		/* Responses which are already done are flushed together. */
+		if (m_PendingRequests.size() < 2 || !m_PendingRequests[1]->Done) {
+			m_Stream->async_flush(yc[ec]);
+
+			if (ec) {
+				break;
+			}
+		}
+
+		m_PendingRequests.pop_front();
+		m_Seen = Utility::GetTime();
+		m_ResponseWritten.Set();
+	}
+
+	if (ec) {
+		Log(LogDebug, "HttpServerConnection")
+			<< "Error while writing response to HTTP client (from " << m_PeerAddress << "): " << ec.message();
+
+		Disconnect();
+	}
+}
+
 void HttpServerConnection::CheckLiveness(boost::asio::yield_context yc)
 {
 	boost::system::error_code ec;
@@ -594,7 +779,7 @@ void HttpServerConnection::CheckLiveness(boost::asio::yield_context yc)
 			break;
 		}
 
-		if (m_Seen < Utility::GetTime() - 10) {
+		if (m_PendingRequests.empty() && m_Seen < Utility::GetTime() - 10) {
 			Log(LogInformation, "HttpServerConnection")
 				<<  "No messages for HTTP connection have been received in the last 10 seconds.";
 
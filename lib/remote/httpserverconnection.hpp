@@ -4,8 +4,10 @@
 #define HTTPSERVERCONNECTION_H
 
 #include "remote/apiuser.hpp"
+#include "base/io-engine.hpp"
 #include "base/string.hpp"
 #include "base/tlsstream.hpp"
+#include <deque>
 #include <memory>
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/asio/io_context.hpp>
@@ -15,6 +17,8 @@
 namespace icinga
 {
 
+struct HttpPendingRequest;
+
 /**
  * An API client connection.
  *
@@ -26,6 +30,7 @@ public:
 	DECLARE_PTR_TYPEDEFS(HttpServerConnection);
 
 	HttpServerConnection(const String& identity, bool authenticated, const Shared<AsioTlsStream>::Ptr& stream);
+	HttpServerConnection(const String& identity, bool authenticated, const Shared<AsioTlsStream>::Ptr& stream, boost::asio::io_context& io);
 
 	void Start();
 	void Disconnect();
@@ -42,10 +47,14 @@ private:
 	bool m_ShuttingDown;
 	bool m_HasStartedStreaming;
 	boost::asio::deadline_timer m_CheckLivenessTimer;
-
-	HttpServerConnection(const String& identity, bool authenticated, const Shared<AsioTlsStream>::Ptr& stream, boost::asio::io_context& io);
+	std::deque<std::shared_ptr<HttpPendingRequest>> m_PendingRequests;
+	AsioConditionVariable m_ResponseReady;
+	AsioConditionVariable m_ResponseWritten;
 
 	void ProcessMessages(boost::asio::yield_context yc);
+	void ProcessPendingRequest(const std::shared_ptr<HttpPendingRequest>& pending, const ApiUser::Ptr& user, boost::asio::yield_context& yc);
+	void WaitForResponses(size_t maxPending, boost::asio::yield_context& yc);
+	void WriteResponses(boost::asio::yield_context yc);
 	void CheckLiveness(boost::asio::yield_context yc);
 };
 
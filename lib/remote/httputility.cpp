@@ -4,9 +4,8 @@
 #include "remote/url.hpp"
 #include "base/json.hpp"
 #include "base/logger.hpp"
-#include <map>
 #include <string>
-#include <vector>
+#include <unordered_map>
 #include <boost/beast/http.hpp>
 
 using namespace icinga;
@@ -25,13 +24,23 @@ Dictionary::Ptr HttpUtility::FetchRequestParameters(const Url::Ptr& url, const s
 	if (!result)
 		result = new Dictionary();
 
-	std::map<String, std::vector<String>> query;
-	for (const auto& kv : url->GetQuery()) {
-		query[kv.first].emplace_back(kv.second);
-	}
+	auto& query (url->GetQuery());
+
+	if (query.empty())
+		return result;
+
+	/* The values of a query parameter replace the body's ones, they're added to their array right away. */
+	std::unordered_map<String, Array::Ptr> arrays;
+
+	for (const auto& kv : query) {
+		auto& values (arrays[kv.first]);
+
+		if (!values) {
+			values = new Array();
+			result->Set(kv.first, values);
+		}
 
-	for (auto& kv : query) {
-		result->Set(kv.first, Array::FromVector(kv.second));
+		values->Add(kv.second);
 	}
 
 	return result;
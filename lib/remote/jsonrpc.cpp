@@ -3,6 +3,7 @@
 #include "remote/jsonrpc.hpp"
 #include "base/netstring.hpp"
 #include "base/json.hpp"
+#include "base/object-packer.hpp"
 #include "base/console.hpp"
 #include "base/scriptglobal.hpp"
 #include "base/convert.hpp"
@@ -88,7 +89,7 @@ size_t JsonRpc::SendMessage(const Shared<AsioTlsStream>::Ptr& stream, const Dict
 size_t JsonRpc::SendRawMessage(const Shared<AsioTlsStream>::Ptr& stream, const String& json, boost::asio::yield_context yc)
 {
 #ifdef I2_DEBUG
-	if (GetDebugJsonRpcCached())
+	if (GetDebugJsonRpcCached() && !IsBinaryMessage(json))
 		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << ">> " << json << ConsoleColorTag(Console_Normal) << "\n";
 #endif /* I2_DEBUG */
 
@@ -109,7 +110,7 @@ String JsonRpc::ReadMessage(const Shared<AsioTlsStream>::Ptr& stream, ssize_t ma
 	String jsonString = NetString::ReadStringFromStream(stream, maxMessageLength);
 
 #ifdef I2_DEBUG
-	if (GetDebugJsonRpcCached())
+	if (GetDebugJsonRpcCached() && !IsBinaryMessage(jsonString))
 		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << "<< " << jsonString << ConsoleColorTag(Console_Normal) << "\n";
 #endif /* I2_DEBUG */
 
@@ -130,23 +131,38 @@ String JsonRpc::ReadMessage(const Shared<AsioTlsStream>::Ptr& stream, boost::asi
 	String jsonString = NetString::ReadStringFromStream(stream, yc, maxMessageLength);
 
 #ifdef I2_DEBUG
-	if (GetDebugJsonRpcCached())
+	if (GetDebugJsonRpcCached() && !IsBinaryMessage(jsonString))
 		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << "<< " << jsonString << ConsoleColorTag(Console_Normal) << "\n";
 #endif /* I2_DEBUG */
 
 	return jsonString;
 }
 
+/**
+ * Encode message either as JSON or via PackObject()
+ *
+ * Only use the binary encoding for peers which announced ApiCapabilities::BinaryMessages.
+ *
+ * @param message Dictionary ptr
+ * @param binary Whether to use the binary encoding
+ *
+ * @return The encoded message
+ */
+String JsonRpc::EncodeMessage(const Dictionary::Ptr& message, bool binary)
+{
+	return binary ? PackObject(message) : JsonEncode(message);
+}
+
 /**
  * Decode message, enforce a Dictionary
  *
- * @param message JSON string
+ * @param message JSON string or binary message
  *
  * @return Dictionary ptr
  */
 Dictionary::Ptr JsonRpc::DecodeMessage(const String& message)
 {
-	Value value = JsonDecode(message);
+	Value value = IsBinaryMessage(message) ? UnpackObject(message) : JsonDecode(message);
 
 	if (!value.IsObjectType<Dictionary>()) {
 		BOOST_THROW_EXCEPTION(std::invalid_argument("JSON-RPC"
@@ -155,3 +171,44 @@ Dictionary::Ptr JsonRpc::DecodeMessage(const String& message)
 
 	return value;
 }
+
+/**
+ * Tell binary messages from JSON ones. The former start with PackObject()'s
+ * dictionary type tag which can't start a JSON document.
+ *
+ * @param message JSON string or binary message
+ *
+ * @return Whether the message is binary
+ */
+bool JsonRpc::IsBinaryMessage(const String& message)
+{
+	return !message.IsEmpty() && message[0] == '\6';
+}
+
+EncodedMessage::EncodedMessage(Dictionary::Ptr message)
+	: m_Message(std::move(message))
+{
+}
+
+const Dictionary::Ptr& EncodedMessage::GetMessage() const
+{
+	return m_Message;
+}
+
+/**
+ * Get the message in the requested encoding, encode it on first use
+ *
+ * @param binary Whether to use the binary encoding, see JsonRpc::EncodeMessage()
+ *
+ * @return The encoded message
+ */
+const std::shared_ptr<const String>& EncodedMessage::Get(bool binary)
+{
+	auto& encoded (m_Encoded[binary]);
+
+	if (!encoded) {
+		encoded = std::make_shared<const String>(JsonRpc::EncodeMessage(m_Message, binary));
+	}
+
+	return encoded;
+}
@@ -28,12 +28,35 @@ public:
 	static String ReadMessage(const Shared<AsioTlsStream>::Ptr& stream, ssize_t maxMessageLength = -1);
 	static String ReadMessage(const Shared<AsioTlsStream>::Ptr& stream, boost::asio::yield_context yc, ssize_t maxMessageLength = -1);
 
+	static String EncodeMessage(const Dictionary::Ptr& message, bool binary = false);
 	static Dictionary::Ptr DecodeMessage(const String& message);
+	static bool IsBinaryMessage(const String& message);
 
 private:
 	JsonRpc();
 };
 
+/**
+ * A message to be sent over several connections.
+ *
+ * Encodes the message at most once per encoding and shares the result between the connections.
+ * The message must not be changed once it has been encoded.
+ *
+ * @ingroup remote
+ */
+class EncodedMessage
+{
+public:
+	EncodedMessage(Dictionary::Ptr message);
+
+	const Dictionary::Ptr& GetMessage() const;
+	const std::shared_ptr<const String>& Get(bool binary);
+
+private:
+	Dictionary::Ptr m_Message;
+	std::shared_ptr<const String> m_Encoded[2];
+};
+
 }
 
 #endif /* JSONRPC_H */
@@ -0,0 +1,116 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/jsonrpccompression.hpp"
+#include "base/exception.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <zlib.h>
+
+using namespace icinga;
+
+/* Neither JSON nor JsonRpc::IsBinaryMessage() messages can start with it. */
+static const char l_CompressedMessageTag = '\x1f';
+
+JsonRpcDeflater::JsonRpcDeflater(int level)
+	: m_Stream(new z_stream())
+{
+	if (deflateInit(m_Stream.get(), level) != Z_OK)
+		BOOST_THROW_EXCEPTION(std::runtime_error("deflateInit() failed"));
+}
+
+JsonRpcDeflater::~JsonRpcDeflater()
+{
+	deflateEnd(m_Stream.get());
+}
+
+/**
+ * Compresses the next message of the stream.
+ *
+ * @param message A JSON or binary message
+ *
+ * @return The message for JsonRpcInflater::Inflate()
+ */
+String JsonRpcDeflater::Deflate(const String& message)
+{
+	std::string result (1, l_CompressedMessageTag);
+
+	m_Stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(message.CStr()));
+	m_Stream->avail_in = message.GetLength();
+
+	do {
+		auto offset (result.size());
+
+		/* Repetitive messages shrink a lot, so start small. */
+		result.resize(offset + std::max<size_t>(message.GetLength() / 4u, 256));
+
+		m_Stream->next_out = reinterpret_cast<Bytef*>(&result[offset]);
+		m_Stream->avail_out = result.size() - offset;
+
+		int rc = deflate(m_Stream.get(), Z_SYNC_FLUSH);
+
+		if (rc != Z_OK && rc != Z_BUF_ERROR)
+			BOOST_THROW_EXCEPTION(std::runtime_error("deflate() failed"));
+
+		result.resize(result.size() - m_Stream->avail_out);
+	} while (m_Stream->avail_out == 0);
+
+	return std::move(result);
+}
+
+JsonRpcInflater::JsonRpcInflater()
+	: m_Stream(new z_stream())
+{
+	if (inflateInit(m_Stream.get()) != Z_OK)
+		BOOST_THROW_EXCEPTION(std::runtime_error("inflateInit() failed"));
+}
+
+JsonRpcInflater::~JsonRpcInflater()
+{
+	inflateEnd(m_Stream.get());
+}
+
+/**
+ * Decompresses the next message of the stream.
+ *
+ * @param message A message from JsonRpcDeflater::Deflate()
+ * @param maxMessageLength The maximum length of the decompressed message, -1 for no limit
+ *
+ * @return The JSON or binary message
+ */
+String JsonRpcInflater::Inflate(const String& message, ssize_t maxMessageLength)
+{
+	if (!IsCompressedMessage(message))
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Message is not compressed"));
+
+	std::string result;
+
+	m_Stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(message.CStr() + 1));
+	m_Stream->avail_in = message.GetLength() - 1u;
+
+	do {
+		auto offset (result.size());
+
+		result.resize(offset + std::max<size_t>(message.GetLength() * 4u, 4096));
+
+		m_Stream->next_out = reinterpret_cast<Bytef*>(&result[offset]);
+		m_Stream->avail_out = result.size() - offset;
+
+		int rc = inflate(m_Stream.get(), Z_SYNC_FLUSH);
+
+		if (rc != Z_OK && rc != Z_BUF_ERROR)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid compressed message"));
+
+		result.resize(result.size() - m_Stream->avail_out);
+
+		if (maxMessageLength >= 0 && result.size() > (size_t)maxMessageLength)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Max data length exceeded: " + std::to_string(maxMessageLength / 1024) + " KB"));
+	} while (m_Stream->avail_out == 0);
+
+	return std::move(result);
+}
+
+bool JsonRpcInflater::IsCompressedMessage(const String& message)
+{
+	return !message.IsEmpty() && message[0] == l_CompressedMessageTag;
+}
@@ -0,0 +1,63 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef JSONRPCCOMPRESSION_H
+#define JSONRPCCOMPRESSION_H
+
+#include "remote/i2-remote.hpp"
+#include "base/string.hpp"
+#include <memory>
+
+struct z_stream_s;
+
+namespace icinga
+{
+
+/**
+ * Compresses all messages sent over one JSON-RPC connection as a single zlib stream.
+ *
+ * Every message is flushed on its own, so that the peer can process it right away, but later messages refer
+ * back to what's still in the sliding window, e.g. the method names, keys and object names they share.
+ * Only use it for peers which announced ApiCapabilities::CompressedMessages.
+ *
+ * @ingroup remote
+ */
+class JsonRpcDeflater
+{
+public:
+	JsonRpcDeflater(int level);
+	~JsonRpcDeflater();
+
+	JsonRpcDeflater(const JsonRpcDeflater&) = delete;
+	JsonRpcDeflater& operator=(const JsonRpcDeflater&) = delete;
+
+	String Deflate(const String& message);
+
+private:
+	std::unique_ptr<z_stream_s> m_Stream;
+};
+
+/**
+ * Decompresses the messages a JsonRpcDeflater compressed on the other end of a connection.
+ *
+ * @ingroup remote
+ */
+class JsonRpcInflater
+{
+public:
+	JsonRpcInflater();
+	~JsonRpcInflater();
+
+	JsonRpcInflater(const JsonRpcInflater&) = delete;
+	JsonRpcInflater& operator=(const JsonRpcInflater&) = delete;
+
+	String Inflate(const String& message, ssize_t maxMessageLength = -1);
+
+	static bool IsCompressedMessage(const String& message);
+
+private:
+	std::unique_ptr<z_stream_s> m_Stream;
+};
+
+}
+
+#endif /* JSONRPCCOMPRESSION_H */
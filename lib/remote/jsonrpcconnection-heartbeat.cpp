@@ -3,41 +3,126 @@
 #include "remote/jsonrpcconnection.hpp"
 #include "remote/messageorigin.hpp"
 #include "remote/apifunction.hpp"
+#include "remote/jsonrpc.hpp"
 #include "base/initialize.hpp"
 #include "base/configtype.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
-#include <boost/asio/spawn.hpp>
-#include <boost/date_time/posix_time/posix_time_duration.hpp>
-#include <boost/system/system_error.hpp>
+#include <array>
+#include <mutex>
+#include <set>
+#include <vector>
 
 using namespace icinga;
 
 REGISTER_APIFUNCTION(Heartbeat, event, &JsonRpcConnection::HeartbeatAPIHandler);
 
+/* Every connection is visited once per l_HeartbeatInterval seconds, one wheel slot per second. */
+static const size_t l_HeartbeatInterval = 20;
+
+static std::mutex l_HeartbeatWheelMutex;
+static std::array<std::set<JsonRpcConnection::Ptr>, l_HeartbeatInterval> l_HeartbeatWheel;
+static size_t l_HeartbeatWheelPosition = 0;
+static size_t l_HeartbeatNextSlot = 0;
+static Timer::Ptr l_HeartbeatTimer;
+
+/**
+ * Returns the encoded heartbeat, which is the same for all connections.
+ */
+static const std::shared_ptr<const String>& GetHeartbeatMessage(bool binary)
+{
+	static const Dictionary::Ptr heartbeat = new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "event::Heartbeat" },
+		{ "params", new Dictionary() }
+	});
+
+	static const auto json (std::make_shared<const String>(JsonRpc::EncodeMessage(heartbeat, false)));
+	static const auto encoded (std::make_shared<const String>(JsonRpc::EncodeMessage(heartbeat, true)));
+
+	return binary ? encoded : json;
+}
+
+/**
+ * Hands the connections of the current wheel slot over to their strands.
+ *
+ * Runs once per second for all connections instead of two timers per connection.
+ */
+void JsonRpcConnection::HeartbeatTimerHandler()
+{
+	std::vector<JsonRpcConnection::Ptr> connections;
+	double now = Utility::GetTime();
+
+	{
+		std::unique_lock<std::mutex> lock (l_HeartbeatWheelMutex);
+		auto& slot (l_HeartbeatWheel[l_HeartbeatWheelPosition]);
+
+		connections.assign(slot.begin(), slot.end());
+		l_HeartbeatWheelPosition = (l_HeartbeatWheelPosition + 1u) % l_HeartbeatWheel.size();
+	}
+
+	for (auto& connection : connections) {
+		connection->m_IoStrand.post([connection, now]() { connection->HandleHeartbeat(now); });
+	}
+}
+
 /**
- * We still send a heartbeat without timeout here
- * to keep the m_Seen variable up to date. This is to keep the
- * cluster connection alive when there isn't much going on.
+ * Adds an authenticated connection to the heartbeat wheel.
+ *
+ * The slots are assigned round-robin so that the connections established at startup don't all wake up together.
  */
+void JsonRpcConnection::RegisterHeartbeat()
+{
+	static std::once_flag timerStarted;
+
+	std::call_once(timerStarted, []() {
+		l_HeartbeatTimer = Timer::Create();
+		l_HeartbeatTimer->OnTimerExpired.connect([](const Timer * const&) { HeartbeatTimerHandler(); });
+		l_HeartbeatTimer->SetInterval(1);
+		l_HeartbeatTimer->Start();
+	});
+
+	std::unique_lock<std::mutex> lock (l_HeartbeatWheelMutex);
+
+	m_HeartbeatSlot = l_HeartbeatNextSlot;
+	l_HeartbeatNextSlot = (l_HeartbeatNextSlot + 1u) % l_HeartbeatWheel.size();
+
+	l_HeartbeatWheel[m_HeartbeatSlot].emplace(this);
+}
+
+void JsonRpcConnection::UnregisterHeartbeat()
+{
+	std::unique_lock<std::mutex> lock (l_HeartbeatWheelMutex);
 
-void JsonRpcConnection::HandleAndWriteHeartbeats(boost::asio::yield_context yc)
+	l_HeartbeatWheel[m_HeartbeatSlot].erase(this);
+}
+
+/**
+ * Checks whether the peer is still alive and sends it a heartbeat to keep its m_Seen up to date.
+ *
+ * The heartbeat is left out if we've written anything else during the last interval
+ * as the peer's liveness check only cares about receiving something.
+ *
+ * Must be called on m_IoStrand.
+ */
+void JsonRpcConnection::HandleHeartbeat(double now)
 {
-	boost::system::error_code ec;
-
-	for (;;) {
-		m_HeartbeatTimer.expires_from_now(boost::posix_time::seconds(20));
-		m_HeartbeatTimer.async_wait(yc[ec]);
-
-		if (m_ShuttingDown) {
-			break;
-		}
-		
-		SendMessageInternal(new Dictionary({
-			{ "jsonrpc", "2.0" },
-			{ "method", "event::Heartbeat" },
-			{ "params", new Dictionary() }
-		}));
+	if (m_ShuttingDown) {
+		/* In case Disconnect() has been called before Start(). */
+		UnregisterHeartbeat();
+		return;
+	}
+
+	if (m_Seen < now - 60 && (!m_Endpoint || !m_Endpoint->GetSyncing())) {
+		Log(LogInformation, "JsonRpcConnection")
+			<<  "No messages for identity '" << m_Identity << "' have been received in the last 60 seconds.";
+
+		Disconnect();
+		return;
+	}
+
+	if (m_LastWritten < now - l_HeartbeatInterval) {
+		EnqueueMessage(GetHeartbeatMessage(m_BinaryMessages.load()), JsonRpcPriorityControl, "event::Heartbeat");
 	}
 }
 
@@ -6,14 +6,21 @@
 #include "remote/jsonrpc.hpp"
 #include "base/atomic-file.hpp"
 #include "base/configtype.hpp"
+#include "base/configuration.hpp"
 #include "base/objectlock.hpp"
 #include "base/utility.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
 #include "base/convert.hpp"
+#include "base/workqueue.hpp"
 #include <boost/thread/once.hpp>
 #include <boost/regex.hpp>
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <openssl/asn1.h>
 #include <openssl/ssl.h>
 #include <openssl/x509.h>
@@ -25,6 +32,159 @@ REGISTER_APIFUNCTION(RequestCertificate, pki, &RequestCertificateHandler);
 static Value UpdateCertificateHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 REGISTER_APIFUNCTION(UpdateCertificate, pki, &UpdateCertificateHandler);
 
+/* Certificate requests which may wait for or be processed by the certificate request queue at once. */
+static const size_t l_MaxPendingCertificateRequests = 1000;
+static std::atomic<size_t> l_PendingCertificateRequests (0);
+
+struct PendingRequestFile
+{
+	Dictionary::Ptr Request;
+	MessageOrigin::Ptr Origin;
+};
+
+/* Certificate request files to be written by the next FlushCertificateRequests(), by path. */
+static std::mutex l_RequestFilesMutex;
+static std::map<String, PendingRequestFile> l_RequestFiles;
+
+/**
+ * The queue certificate requests are processed on. It uses only half of the cores, so that a lot of
+ * requests at once (e.g. from all agents after a CA renewal) don't stall the rest of the instance.
+ */
+static WorkQueue& GetCertificateRequestQueue()
+{
+	static std::once_flag queueCreated;
+	static std::unique_ptr<WorkQueue> queue;
+
+	std::call_once(queueCreated, []() {
+		queue.reset(new WorkQueue(0, std::max(Configuration::Concurrency / 2, 1), LogNotice));
+		queue->SetName("JsonRpcConnection, certificate requests");
+	});
+
+	return *queue;
+}
+
+/**
+ * Writes the certificate request files saved by SaveCertificateRequest() so far
+ * and relays the requests to the local zone and all parents.
+ */
+static void FlushCertificateRequests()
+{
+	std::map<String, PendingRequestFile> requests;
+
+	{
+		std::unique_lock<std::mutex> lock (l_RequestFilesMutex);
+		requests.swap(l_RequestFiles);
+	}
+
+	if (requests.empty())
+		return;
+
+	Utility::MkDirP(ApiListener::GetCertificateRequestsDir(), 0700);
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	for (auto& kv : requests) {
+		try {
+			Utility::SaveJsonFile(kv.first, 0600, kv.second.Request);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "JsonRpcConnection")
+				<< "Cannot save certificate request to '" << kv.first << "': " << DiagnosticInformation(ex, false);
+			continue;
+		}
+
+		if (listener) {
+			Dictionary::Ptr message = new Dictionary({
+				{ "jsonrpc", "2.0" },
+				{ "method", "pki::RequestCertificate" },
+				{ "params", kv.second.Request }
+			});
+
+			listener->RelayMessage(kv.second.Origin, Zone::GetLocalZone(), message, false);
+		}
+	}
+}
+
+/**
+ * Saves a delayed certificate request like JsonRpcConnection::SendCertificateRequest() expects it and sends it
+ * to the parent zone afterwards. The file is written together with the ones of the other requests which arrive
+ * in the meantime, repeated requests for the same certificate only once.
+ */
+static void SaveCertificateRequest(const String& path, const Dictionary::Ptr& request, const MessageOrigin::Ptr& origin)
+{
+	{
+		std::unique_lock<std::mutex> lock (l_RequestFilesMutex);
+
+		/* Otherwise a flush is already queued. */
+		bool flush = l_RequestFiles.empty();
+
+		l_RequestFiles[path] = PendingRequestFile{request, origin};
+
+		if (!flush)
+			return;
+	}
+
+	GetCertificateRequestQueue().Enqueue(&FlushCertificateRequests);
+}
+
+/**
+ * Processes a pki::RequestCertificate message on the certificate request queue and sends the reply, if requested.
+ *
+ * If l_MaxPendingCertificateRequests are already pending, the request is rejected right away. The agents
+ * will request their certificate again after reconnecting.
+ *
+ * @param id The ID of the JSON-RPC request, Empty if no reply was requested
+ */
+void JsonRpcConnection::InvokeCertificateRequest(const ApiFunction::Ptr& afunc, const MessageOrigin::Ptr& origin,
+	const Dictionary::Ptr& params, const Value& id)
+{
+	if (l_PendingCertificateRequests.fetch_add(1) >= l_MaxPendingCertificateRequests) {
+		l_PendingCertificateRequests.fetch_sub(1);
+
+		Log(LogNotice, "JsonRpcConnection")
+			<< "Too many pending certificate requests, rejecting the one from identity '" << m_Identity << "'.";
+
+		if (!id.IsEmpty()) {
+			SendMessage(new Dictionary({
+				{ "jsonrpc", "2.0" },
+				{ "id", id },
+				{ "result", new Dictionary({
+					{ "status_code", 1 },
+					{ "error", "Too many pending certificate requests. Please try again later." }
+				}) }
+			}));
+		}
+
+		if (!m_Endpoint)
+			Disconnect();
+
+		return;
+	}
+
+	Ptr keepAlive (this);
+
+	GetCertificateRequestQueue().Enqueue([this, keepAlive, afunc, origin, params, id]() {
+		Dictionary::Ptr resultMessage = new Dictionary();
+
+		try {
+			resultMessage->Set("result", afunc->Invoke(origin, params));
+		} catch (const std::exception& ex) {
+			String diagInfo = DiagnosticInformation(ex);
+			resultMessage->Set("error", diagInfo);
+			Log(LogWarning, "JsonRpcConnection")
+				<< "Error while processing message for identity '" << m_Identity << "'\n" << diagInfo;
+		}
+
+		l_PendingCertificateRequests.fetch_sub(1);
+
+		if (!id.IsEmpty()) {
+			resultMessage->Set("jsonrpc", "2.0");
+			resultMessage->Set("id", id);
+
+			SendMessage(resultMessage);
+		}
+	});
+}
+
 Value RequestCertificateHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
 {
 	String certText = params->Get("cert_request");
@@ -32,6 +192,10 @@ Value RequestCertificateHandler(const MessageOrigin::Ptr& origin, const Dictiona
 	std::shared_ptr<X509> cert;
 
 	Dictionary::Ptr result = new Dictionary();
+
+	/* Renegotiation is disabled (see SetupSslContext()), so the peer certificates
+	 * don't change while the request is processed on the certificate request queue.
+	 */
 	auto& tlsConn (origin->FromClient->GetStream()->next_layer());
 
 	/* Use the presented client certificate if not provided. */
@@ -265,8 +429,6 @@ Value RequestCertificateHandler(const MessageOrigin::Ptr& origin, const Dictiona
 
 delayed_request:
 	/* Send a delayed certificate signing request. */
-	Utility::MkDirP(requestDir, 0700);
-
 	Dictionary::Ptr request = new Dictionary({
 		{ "cert_request", CertificateToString(cert) },
 		{ "ticket", params->Get("ticket") }
@@ -276,9 +438,7 @@ delayed_request:
 		request->Set("requestor_ca", CertificateToString(requestorCA));
 	}
 
-	Utility::SaveJsonFile(requestPath, 0600, request);
-
-	JsonRpcConnection::SendCertificateRequest(nullptr, origin, requestPath);
+	SaveCertificateRequest(requestPath, request, origin);
 
 	result->Set("status_code", 2);
 	result->Set("error", "Certificate request for CN '" + cn + "' is pending. Waiting for approval from the parent Icinga instance.");
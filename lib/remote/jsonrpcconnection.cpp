@@ -3,7 +3,10 @@
 #include "remote/jsonrpcconnection.hpp"
 #include "remote/apilistener.hpp"
 #include "remote/apifunction.hpp"
+#include "remote/duplicatemessagefilter.hpp"
 #include "remote/jsonrpc.hpp"
+#include "base/configuration.hpp"
+#include "base/debug.hpp"
 #include "base/defer.hpp"
 #include "base/configtype.hpp"
 #include "base/io-engine.hpp"
@@ -14,8 +17,11 @@
 #include "base/exception.hpp"
 #include "base/convert.hpp"
 #include "base/tlsstream.hpp"
+#include <algorithm>
 #include <memory>
+#include <mutex>
 #include <utility>
+#include <vector>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/spawn.hpp>
 #include <boost/date_time/posix_time/posix_time_duration.hpp>
@@ -27,7 +33,10 @@ using namespace icinga;
 static Value SetLogPositionHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 REGISTER_APIFUNCTION(SetLogPosition, log, &SetLogPositionHandler);
 
-static RingBuffer l_TaskStats (15 * 60);
+static ShardedRingBuffer l_TaskStats (15 * 60);
+
+/* Messages of a connection which may be processed in parallel at once, see JsonRpcConnection::InvokeSerialized(). */
+static const size_t l_MaxSerializedMessages = 1000;
 
 JsonRpcConnection::JsonRpcConnection(const String& identity, bool authenticated,
 	const Shared<AsioTlsStream>::Ptr& stream, ConnectionRole role)
@@ -38,12 +47,23 @@ JsonRpcConnection::JsonRpcConnection(const String& identity, bool authenticated,
 JsonRpcConnection::JsonRpcConnection(const String& identity, bool authenticated,
 	const Shared<AsioTlsStream>::Ptr& stream, ConnectionRole role, boost::asio::io_context& io)
 	: m_Identity(identity), m_Authenticated(authenticated), m_Stream(stream), m_Role(role),
-	m_Timestamp(Utility::GetTime()), m_Seen(Utility::GetTime()), m_NextHeartbeat(0), m_IoStrand(io),
+	m_Timestamp(Utility::GetTime()), m_Seen(Utility::GetTime()), m_NextHeartbeat(0), m_LastWritten(0), m_HeartbeatSlot(0), m_IoStrand(io),
 	m_OutgoingMessagesQueued(io), m_WriterDone(io), m_ShuttingDown(false),
-	m_CheckLivenessTimer(io), m_HeartbeatTimer(io)
+	m_BinaryMessages(false), m_CompressionLevel(0), m_CheckLivenessTimer(io),
+	m_SerializedMessages(0), m_SerializedMessagesDone(io)
 {
 	if (authenticated)
 		m_Endpoint = Endpoint::GetByName(identity);
+
+	/* The handshake is done and the stream isn't used by any coroutine yet. */
+	SSL *ssl = stream->next_layer().native_handle();
+
+	m_TlsStatus = new Dictionary({
+		{ "role", role == RoleClient ? "client" : "server" },
+		{ "protocol", SSL_get_version(ssl) },
+		{ "cipher", SSL_get_cipher_name(ssl) },
+		{ "resumed", (bool)SSL_session_reused(ssl) }
+	});
 }
 
 void JsonRpcConnection::Start()
@@ -54,8 +74,13 @@ void JsonRpcConnection::Start()
 
 	IoEngine::SpawnCoroutine(m_IoStrand, [this, keepAlive](asio::yield_context yc) { HandleIncomingMessages(yc); });
 	IoEngine::SpawnCoroutine(m_IoStrand, [this, keepAlive](asio::yield_context yc) { WriteOutgoingMessages(yc); });
-	IoEngine::SpawnCoroutine(m_IoStrand, [this, keepAlive](asio::yield_context yc) { HandleAndWriteHeartbeats(yc); });
-	IoEngine::SpawnCoroutine(m_IoStrand, [this, keepAlive](asio::yield_context yc) { CheckLiveness(yc); });
+
+	/* The heartbeats and liveness checks of authenticated connections are done by a timer shared by all of them. */
+	if (m_Authenticated) {
+		RegisterHeartbeat();
+	} else {
+		IoEngine::SpawnCoroutine(m_IoStrand, [this, keepAlive](asio::yield_context yc) { CheckLiveness(yc); });
+	}
 }
 
 void JsonRpcConnection::HandleIncomingMessages(boost::asio::yield_context yc)
@@ -80,7 +105,19 @@ void JsonRpcConnection::HandleIncomingMessages(boost::asio::yield_context yc)
 		try {
 			CpuBoundWork handleMessage (yc);
 
-			MessageHandler(message);
+			if (JsonRpcInflater::IsCompressedMessage(message)) {
+				if (!m_Endpoint) {
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Compressed messages are only accepted from endpoints."));
+				}
+
+				if (!m_Inflater) {
+					m_Inflater.reset(new JsonRpcInflater());
+				}
+
+				message = m_Inflater->Inflate(message);
+			}
+
+			MessageHandler(message, yc);
 
 			l_TaskStats.InsertValue(Utility::GetTime(), 1);
 		} catch (const std::exception& ex) {
@@ -101,30 +138,83 @@ void JsonRpcConnection::WriteOutgoingMessages(boost::asio::yield_context yc)
 
 	do {
 		m_OutgoingMessagesQueued.Wait(yc);
+		m_OutgoingMessagesQueued.Clear();
 
-		auto queue (std::move(m_OutgoingMessagesQueue));
+		try {
+			bool written = false;
+
+			for (;;) {
+				/* Pick one message at a time so that a heartbeat queued while we were
+				 * writing a replay backlog overtakes the rest of that backlog. State and bulk
+				 * messages stay in FIFO order: the peer doesn't discard older check results,
+				 * so a replayed one must not arrive after a newer live one.
+				 */
+				auto queue (m_OutgoingMessagesQueues.begin());
+
+				if (queue->Messages.empty()) {
+					queue = m_OutgoingMessagesQueues.end();
+
+					for (auto other (m_OutgoingMessagesQueues.begin() + 1); other != m_OutgoingMessagesQueues.end(); ++other) {
+						if (!other->Messages.empty() && (queue == m_OutgoingMessagesQueues.end()
+							|| other->Messages.front().Sequence < queue->Messages.front().Sequence)) {
+							queue = other;
+						}
+					}
+				}
 
-		m_OutgoingMessagesQueue.clear();
-		m_OutgoingMessagesQueued.Clear();
+				if (queue == m_OutgoingMessagesQueues.end()) {
+					break;
+				}
 
-		if (!queue.empty()) {
-			try {
-				for (auto& message : queue) {
-					size_t bytesSent = JsonRpc::SendRawMessage(m_Stream, message, yc);
+				auto message (std::move(queue->Messages.front()));
+
+				queue->Messages.pop_front();
+				queue->Length.fetch_sub(1);
+				queue->Bytes.fetch_sub(message.Data->GetLength());
+
+				size_t bytesSent;
+				auto compressionLevel (m_CompressionLevel.load());
+
+				if (compressionLevel > 0) {
+					if (!m_Deflater) {
+						m_Deflater.reset(new JsonRpcDeflater(compressionLevel));
+					}
+
+					String compressed (m_Deflater->Deflate(*message.Data));
+
+					bytesSent = JsonRpc::SendRawMessage(m_Stream, compressed, yc);
 
 					if (m_Endpoint) {
-						m_Endpoint->AddMessageSent(bytesSent);
+						m_Endpoint->AddCompressedMessage(message.Data->GetLength(), compressed.GetLength());
 					}
+				} else {
+					bytesSent = JsonRpc::SendRawMessage(m_Stream, *message.Data, yc);
 				}
 
-				m_Stream->async_flush(yc);
-			} catch (const std::exception& ex) {
-				Log(m_ShuttingDown ? LogDebug : LogWarning, "JsonRpcConnection")
-					<< "Error while sending JSON-RPC message for identity '"
-					<< m_Identity << "'\n" << DiagnosticInformation(ex);
+				m_LastWritten = Utility::GetTime();
+
+				if (m_Endpoint) {
+					m_Endpoint->AddMessageSent(bytesSent, message.Method);
+				}
+
+				written = true;
 
-				break;
+				/* Don't let control messages sit in the stream's buffer until the next batch is written. */
+				if (queue == m_OutgoingMessagesQueues.begin()) {
+					m_Stream->async_flush(yc);
+					written = false;
+				}
 			}
+
+			if (written) {
+				m_Stream->async_flush(yc);
+			}
+		} catch (const std::exception& ex) {
+			Log(m_ShuttingDown ? LogDebug : LogWarning, "JsonRpcConnection")
+				<< "Error while sending JSON-RPC message for identity '"
+				<< m_Identity << "'\n" << DiagnosticInformation(ex);
+
+			break;
 		}
 	} while (!m_ShuttingDown);
 
@@ -156,31 +246,120 @@ Shared<AsioTlsStream>::Ptr JsonRpcConnection::GetStream() const
 	return m_Stream;
 }
 
+/**
+ * The TLS parameters negotiated by the handshake.
+ */
+Dictionary::Ptr JsonRpcConnection::GetTlsStatus() const
+{
+	return m_TlsStatus;
+}
+
 ConnectionRole JsonRpcConnection::GetRole() const
 {
 	return m_Role;
 }
 
-void JsonRpcConnection::SendMessage(const Dictionary::Ptr& message)
+void JsonRpcConnection::SendMessage(const Dictionary::Ptr& message, JsonRpcPriority priority)
 {
 	Ptr keepAlive (this);
 
-	m_IoStrand.post([this, keepAlive, message]() { SendMessageInternal(message); });
+	m_IoStrand.post([this, keepAlive, message, priority]() { SendMessageInternal(message, priority); });
+}
+
+void JsonRpcConnection::SendRawMessage(const String& message, JsonRpcPriority priority, const String& method)
+{
+	SendRawMessage(std::make_shared<const String>(message), priority, method);
 }
 
-void JsonRpcConnection::SendRawMessage(const String& message)
+/**
+ * Sends an already encoded message, which may be shared with other connections.
+ *
+ * @param message The message in the encoding this connection uses, see GetBinaryMessages()
+ * @param priority The outgoing queue to put the message in
+ * @param method The message's method for the endpoint's statistics
+ */
+void JsonRpcConnection::SendRawMessage(const std::shared_ptr<const String>& message, JsonRpcPriority priority,
+	const String& method)
 {
 	Ptr keepAlive (this);
 
-	m_IoStrand.post([this, keepAlive, message]() {
-		m_OutgoingMessagesQueue.emplace_back(message);
-		m_OutgoingMessagesQueued.Set();
-	});
+	m_IoStrand.post([this, keepAlive, message, priority, method]() { EnqueueMessage(message, priority, method); });
+}
+
+/**
+ * Returns the number of messages of the given class waiting to be written.
+ *
+ * Safe to call from any thread.
+ */
+size_t JsonRpcConnection::GetOutgoingMessages(JsonRpcPriority priority) const
+{
+	return m_OutgoingMessagesQueues[priority].Length.load();
+}
+
+/**
+ * Returns the size of all messages of the given class waiting to be written.
+ *
+ * Safe to call from any thread.
+ */
+size_t JsonRpcConnection::GetOutgoingBytes(JsonRpcPriority priority) const
+{
+	return m_OutgoingMessagesQueues[priority].Bytes.load();
+}
+
+String JsonRpcConnection::PriorityToString(JsonRpcPriority priority)
+{
+	switch (priority) {
+		case JsonRpcPriorityControl:
+			return "control";
+		case JsonRpcPriorityState:
+			return "state";
+		case JsonRpcPriorityBulk:
+			return "bulk";
+		default:
+			VERIFY(!"Invalid JSON-RPC message priority.");
+	}
+}
+
+/**
+ * Switches to the binary message encoding for all messages sent from now on.
+ * Only call this once the peer announced ApiCapabilities::BinaryMessages.
+ */
+void JsonRpcConnection::EnableBinaryMessages()
+{
+	m_BinaryMessages.store(true);
 }
 
-void JsonRpcConnection::SendMessageInternal(const Dictionary::Ptr& message)
+bool JsonRpcConnection::GetBinaryMessages() const
 {
-	m_OutgoingMessagesQueue.emplace_back(JsonEncode(message));
+	return m_BinaryMessages.load();
+}
+
+/**
+ * Compresses all messages written from now on with the given zlib level (1-9).
+ * Only call this once the peer announced ApiCapabilities::CompressedMessages.
+ */
+void JsonRpcConnection::EnableCompression(int level)
+{
+	m_CompressionLevel.store(level);
+}
+
+void JsonRpcConnection::SendMessageInternal(const Dictionary::Ptr& message, JsonRpcPriority priority)
+{
+	EnqueueMessage(std::make_shared<const String>(JsonRpc::EncodeMessage(message, m_BinaryMessages.load())), priority,
+		message->Get("method"));
+}
+
+/**
+ * Must be called on m_IoStrand.
+ */
+void JsonRpcConnection::EnqueueMessage(std::shared_ptr<const String> message, JsonRpcPriority priority, String method)
+{
+	auto& queue (m_OutgoingMessagesQueues[priority]);
+
+	queue.Length.fetch_add(1);
+	queue.Bytes.fetch_add(message->GetLength());
+	queue.Messages.emplace_back(OutgoingMessage{std::move(message), std::move(method), m_NextOutgoingSequence++});
+
 	m_OutgoingMessagesQueued.Set();
 }
 
@@ -194,6 +373,10 @@ void JsonRpcConnection::Disconnect()
 		if (!m_ShuttingDown) {
 			m_ShuttingDown = true;
 
+			if (m_Authenticated) {
+				UnregisterHeartbeat();
+			}
+
 			Log(LogWarning, "JsonRpcConnection")
 				<< "API client disconnected for identity '" << m_Identity << "'";
 
@@ -222,7 +405,6 @@ void JsonRpcConnection::Disconnect()
 			boost::system::error_code ec;
 
 			m_CheckLivenessTimer.cancel();
-			m_HeartbeatTimer.cancel();
 
 			m_Stream->lowest_layer().cancel(ec);
 
@@ -245,20 +427,31 @@ void JsonRpcConnection::Disconnect()
 	});
 }
 
-void JsonRpcConnection::MessageHandler(const String& jsonString)
+void JsonRpcConnection::MessageHandler(const String& jsonString, boost::asio::yield_context yc)
 {
 	Dictionary::Ptr message = JsonRpc::DecodeMessage(jsonString);
+	double ts = -1;
 
 	if (m_Endpoint && message->Contains("ts")) {
-		double ts = message->Get("ts");
+		ts = message->Get("ts");
 
 		/* ignore old messages */
-		if (ts < m_Endpoint->GetRemoteLogPosition())
+		if (ts < std::max(m_Endpoint->GetRemoteLogPosition(), m_ReceivedLogPosition))
 			return;
 
-		m_Endpoint->SetRemoteLogPosition(ts);
+		m_ReceivedLogPosition = ts;
 	}
 
+	bool serialized = false;
+
+	/* The remote log position is only advanced once this and all messages before it have been processed,
+	 * as the peer won't replay messages before it after a crash.
+	 */
+	Defer advanceLogPosition ([this, ts, &serialized]() {
+		if (ts >= 0 && !serialized)
+			QueueLogPosition(ts, true);
+	});
+
 	MessageOrigin::Ptr origin = new MessageOrigin();
 	origin->FromClient = this;
 
@@ -268,7 +461,7 @@ void JsonRpcConnection::MessageHandler(const String& jsonString)
 		else
 			origin->FromZone = Zone::GetByName(message->Get("originZone"));
 
-		m_Endpoint->AddMessageReceived(jsonString.GetLength());
+		m_Endpoint->AddMessageReceived(jsonString.GetLength(), message->Get("method"));
 	}
 
 	Value vmethod;
@@ -300,6 +493,33 @@ void JsonRpcConnection::MessageHandler(const String& jsonString)
 				<< "Call to non-existent function '" << method << "' from endpoint '" << m_Identity << "'.";
 		} else {
 			Dictionary::Ptr params = message->Get("params");
+
+			/* e.g. the same check result via both masters of the parent zone */
+			if (DuplicateMessageFilter::IsDuplicate(m_Endpoint, method, params)) {
+				Log(LogDebug, "JsonRpcConnection")
+					<< "Dropping duplicate '" << method << "' message from identity '" << m_Identity << "'.";
+				return;
+			}
+
+			/* Verifying tickets and signing certificates takes too long for the I/O threads. */
+			if (params && method == "pki::RequestCertificate") {
+				InvokeCertificateRequest(afunc, origin, params, message->Get("id"));
+				return;
+			}
+
+			String key = message->Contains("id") ? String() : GetSerializationKey(method, params);
+
+			if (!key.IsEmpty()) {
+				WaitForSerializedMessages(l_MaxSerializedMessages - 1u, yc);
+
+				serialized = true;
+				InvokeSerialized(key, afunc, origin, params, ts >= 0 ? QueueLogPosition(ts, false) : 0);
+				return;
+			}
+
+			/* Don't overtake the messages before this one which are still being processed. */
+			WaitForSerializedMessages(0, yc);
+
 			if (params)
 				resultMessage->Set("result", afunc->Invoke(origin, params));
 			else
@@ -321,6 +541,137 @@ void JsonRpcConnection::MessageHandler(const String& jsonString)
 	}
 }
 
+/**
+ * Returns the host a message is about, if it may be processed in parallel to the ones about other hosts.
+ * The messages about a host and its services are processed in order, so that e.g. the reachability of
+ * a service is calculated with the state of its host from the check result received before.
+ *
+ * @return The host name or an empty string if the message has to be processed in order with all others
+ */
+String JsonRpcConnection::GetSerializationKey(const String& method, const Dictionary::Ptr& params)
+{
+	if (!params || method.Find("event::") != 0 || method == "event::Heartbeat" || method == "event::Batch")
+		return String();
+
+	Value host = params->Get("host");
+
+	if (!host.IsString())
+		return String();
+
+	return host;
+}
+
+/**
+ * Invokes a function on the queue of its serialization key, so that messages about the same host are
+ * processed in the order they were received, while those about different hosts are processed in parallel.
+ *
+ * @param logPosition The message's entry from QueueLogPosition() or 0
+ */
+void JsonRpcConnection::InvokeSerialized(const String& key, const ApiFunction::Ptr& afunc,
+	const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params, uint_fast64_t logPosition)
+{
+	static std::once_flag queuesCreated;
+	static std::vector<std::unique_ptr<WorkQueue>> queues;
+
+	std::call_once(queuesCreated, []() {
+		for (int i = 0; i < std::max(Configuration::Concurrency, 1); i++) {
+			queues.emplace_back(new WorkQueue(0, 1, LogNotice));
+			queues.back()->SetName("JsonRpcConnection, #" + Convert::ToString(i));
+		}
+	});
+
+	Ptr keepAlive (this);
+
+	m_SerializedMessages.fetch_add(1);
+
+	queues[Utility::SDBM(key) % queues.size()]->Enqueue([this, keepAlive, afunc, origin, params, logPosition]() {
+		try {
+			afunc->Invoke(origin, params);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "JsonRpcConnection")
+				<< "Error while processing message for identity '" << m_Identity << "'\n" << DiagnosticInformation(ex);
+		}
+
+		auto pending (m_SerializedMessages.fetch_sub(1));
+
+		/* Wake up the reader only if it might wait for us, see WaitForSerializedMessages(). */
+		bool wakeUp = pending == 1u || pending == l_MaxSerializedMessages;
+
+		if (wakeUp || logPosition) {
+			m_IoStrand.post([this, keepAlive, wakeUp, logPosition]() {
+				if (logPosition)
+					FinishLogPosition(logPosition);
+
+				if (wakeUp)
+					m_SerializedMessagesDone.Set();
+			});
+		}
+	});
+}
+
+/**
+ * Adds the timestamp of a received message to the ones which advance the endpoint's remote log position
+ * in the order they were received once they are done.
+ *
+ * Must be called on m_IoStrand.
+ *
+ * @param done Whether the message has been processed already
+ * @return The id for FinishLogPosition()
+ */
+uint_fast64_t JsonRpcConnection::QueueLogPosition(double ts, bool done)
+{
+	m_PendingLogPositions.emplace_back(ts, false);
+
+	uint_fast64_t id = m_PendingLogPositionsBegin + m_PendingLogPositions.size() - 1u;
+
+	if (done)
+		FinishLogPosition(id);
+
+	return id;
+}
+
+/**
+ * Marks a message from QueueLogPosition() as processed.
+ *
+ * Must be called on m_IoStrand.
+ */
+void JsonRpcConnection::FinishLogPosition(uint_fast64_t id)
+{
+	m_PendingLogPositions.at(id - m_PendingLogPositionsBegin).second = true;
+
+	while (!m_PendingLogPositions.empty() && m_PendingLogPositions.front().second) {
+		if (m_Endpoint)
+			m_Endpoint->SetRemoteLogPosition(m_PendingLogPositions.front().first);
+
+		m_PendingLogPositions.pop_front();
+		m_PendingLogPositionsBegin++;
+	}
+}
+
+/**
+ * Waits until at most max messages of this connection are being processed by InvokeSerialized().
+ *
+ * Must be called on m_IoStrand.
+ */
+void JsonRpcConnection::WaitForSerializedMessages(size_t max, boost::asio::yield_context yc)
+{
+	if (m_SerializedMessages.load() <= max) {
+		return;
+	}
+
+	IoBoundWorkSlot dontLockTheIoThread (yc);
+
+	for (;;) {
+		m_SerializedMessagesDone.Clear();
+
+		if (m_SerializedMessages.load() <= max) {
+			break;
+		}
+
+		m_SerializedMessagesDone.Wait(yc);
+	}
+}
+
 Value SetLogPositionHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
 {
 	double log_position = params->Get("log_position");
@@ -337,47 +688,30 @@ Value SetLogPositionHandler(const MessageOrigin::Ptr& origin, const Dictionary::
 
 void JsonRpcConnection::CheckLiveness(boost::asio::yield_context yc)
 {
-	boost::system::error_code ec;
-
-	if (!m_Authenticated) {
-		/* Anonymous connections are normally only used for requesting a certificate and are closed after this request
-		 * is received. However, the request is only sent if the child has successfully verified the certificate of its
-		 * parent so that it is an authenticated connection from its perspective. In case this verification fails, both
-		 * ends view it as an anonymous connection and never actually use it but attempt a reconnect after 10 seconds
-		 * leaking the connection. Therefore close it after a timeout.
-		 */
-
-		m_CheckLivenessTimer.expires_from_now(boost::posix_time::seconds(10));
-		m_CheckLivenessTimer.async_wait(yc[ec]);
-
-		if (m_ShuttingDown) {
-			return;
-		}
+	/* Anonymous connections are normally only used for requesting a certificate and are closed after this request
+	 * is received. However, the request is only sent if the child has successfully verified the certificate of its
+	 * parent so that it is an authenticated connection from its perspective. In case this verification fails, both
+	 * ends view it as an anonymous connection and never actually use it but attempt a reconnect after 10 seconds
+	 * leaking the connection. Therefore close it after a timeout.
+	 *
+	 * Authenticated connections are checked by HandleHeartbeat().
+	 */
 
-		auto remote (m_Stream->lowest_layer().remote_endpoint());
+	boost::system::error_code ec;
 
-		Log(LogInformation, "JsonRpcConnection")
-			<< "Closing anonymous connection [" << remote.address() << "]:" << remote.port() << " after 10 seconds.";
+	m_CheckLivenessTimer.expires_from_now(boost::posix_time::seconds(10));
+	m_CheckLivenessTimer.async_wait(yc[ec]);
 
-		Disconnect();
-	} else {
-		for (;;) {
-			m_CheckLivenessTimer.expires_from_now(boost::posix_time::seconds(30));
-			m_CheckLivenessTimer.async_wait(yc[ec]);
+	if (m_ShuttingDown) {
+		return;
+	}
 
-			if (m_ShuttingDown) {
-				break;
-			}
+	auto remote (m_Stream->lowest_layer().remote_endpoint());
 
-			if (m_Seen < Utility::GetTime() - 60 && (!m_Endpoint || !m_Endpoint->GetSyncing())) {
-				Log(LogInformation, "JsonRpcConnection")
-					<<  "No messages for identity '" << m_Identity << "' have been received in the last 60 seconds.";
+	Log(LogInformation, "JsonRpcConnection")
+		<< "Closing anonymous connection [" << remote.address() << "]:" << remote.port() << " after 10 seconds.";
 
-				Disconnect();
-				break;
-			}
-		}
-	}
+	Disconnect();
 }
 
 double JsonRpcConnection::GetWorkQueueRate()
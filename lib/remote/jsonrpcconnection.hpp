@@ -5,12 +5,17 @@
 
 #include "remote/i2-remote.hpp"
 #include "remote/endpoint.hpp"
+#include "remote/jsonrpccompression.hpp"
 #include "base/io-engine.hpp"
 #include "base/tlsstream.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <memory>
-#include <vector>
+#include <utility>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/io_context_strand.hpp>
 #include <boost/asio/spawn.hpp>
@@ -30,7 +35,23 @@ enum ClientType
 	ClientHttp
 };
 
+/**
+ * Classes of outgoing JSON-RPC messages. Control messages overtake all others, the other classes are
+ * written in the order they were queued in relative to each other, so that a replayed message never
+ * arrives after a newer live one.
+ *
+ * @ingroup remote
+ */
+enum JsonRpcPriority
+{
+	JsonRpcPriorityControl, /**< Heartbeats, log positions and config updates which keep the connection alive */
+	JsonRpcPriorityState, /**< Live events and object updates */
+	JsonRpcPriorityBulk, /**< Replay log messages */
+	JsonRpcPriorityCount
+};
+
 class MessageOrigin;
+class ApiFunction;
 
 /**
  * An API client connection.
@@ -43,6 +64,7 @@ public:
 	DECLARE_PTR_TYPEDEFS(JsonRpcConnection);
 
 	JsonRpcConnection(const String& identity, bool authenticated, const Shared<AsioTlsStream>::Ptr& stream, ConnectionRole role);
+	JsonRpcConnection(const String& identity, bool authenticated, const Shared<AsioTlsStream>::Ptr& stream, ConnectionRole role, boost::asio::io_context& io);
 
 	void Start();
 
@@ -52,47 +74,100 @@ public:
 	Endpoint::Ptr GetEndpoint() const;
 	Shared<AsioTlsStream>::Ptr GetStream() const;
 	ConnectionRole GetRole() const;
+	Dictionary::Ptr GetTlsStatus() const;
 
 	void Disconnect();
 
-	void SendMessage(const Dictionary::Ptr& request);
-	void SendRawMessage(const String& request);
+	void SendMessage(const Dictionary::Ptr& request, JsonRpcPriority priority = JsonRpcPriorityState);
+	void SendRawMessage(const String& request, JsonRpcPriority priority = JsonRpcPriorityState, const String& method = String());
+	void SendRawMessage(const std::shared_ptr<const String>& request, JsonRpcPriority priority = JsonRpcPriorityState,
+		const String& method = String());
+
+	size_t GetOutgoingMessages(JsonRpcPriority priority) const;
+	size_t GetOutgoingBytes(JsonRpcPriority priority) const;
+
+	void EnableBinaryMessages();
+	bool GetBinaryMessages() const;
+
+	void EnableCompression(int level);
 
 	static Value HeartbeatAPIHandler(const intrusive_ptr<MessageOrigin>& origin, const Dictionary::Ptr& params);
 
 	static double GetWorkQueueRate();
+	static String PriorityToString(JsonRpcPriority priority);
 
 	static void SendCertificateRequest(const JsonRpcConnection::Ptr& aclient, const intrusive_ptr<MessageOrigin>& origin, const String& path);
 
 private:
+	struct OutgoingMessage
+	{
+		std::shared_ptr<const String> Data;
+		String Method; /**< For Endpoint::AddMessageSent() */
+		uint_fast64_t Sequence; /**< The order across the non-control queues */
+	};
+
+	struct OutgoingMessagesQueue
+	{
+		std::deque<OutgoingMessage> Messages;
+		std::atomic<size_t> Bytes {0};
+		std::atomic<size_t> Length {0};
+	};
+
 	String m_Identity;
 	bool m_Authenticated;
 	Endpoint::Ptr m_Endpoint;
 	Shared<AsioTlsStream>::Ptr m_Stream;
 	ConnectionRole m_Role;
+	Dictionary::Ptr m_TlsStatus;
 	double m_Timestamp;
 	double m_Seen;
 	double m_NextHeartbeat;
+	double m_LastWritten;
+	size_t m_HeartbeatSlot;
 	boost::asio::io_context::strand m_IoStrand;
-	std::vector<String> m_OutgoingMessagesQueue;
+	std::array<OutgoingMessagesQueue, JsonRpcPriorityCount> m_OutgoingMessagesQueues;
+	uint_fast64_t m_NextOutgoingSequence {0}; /**< Only used on m_IoStrand */
 	AsioConditionVariable m_OutgoingMessagesQueued;
 	AsioConditionVariable m_WriterDone;
 	bool m_ShuttingDown;
-	boost::asio::deadline_timer m_CheckLivenessTimer, m_HeartbeatTimer;
-
-	JsonRpcConnection(const String& identity, bool authenticated, const Shared<AsioTlsStream>::Ptr& stream, ConnectionRole role, boost::asio::io_context& io);
+	std::atomic<bool> m_BinaryMessages;
+	std::atomic<int> m_CompressionLevel;
+	std::unique_ptr<JsonRpcDeflater> m_Deflater; /**< Only used by WriteOutgoingMessages() */
+	std::unique_ptr<JsonRpcInflater> m_Inflater; /**< Only used by HandleIncomingMessages() */
+	boost::asio::deadline_timer m_CheckLivenessTimer;
+	std::atomic<size_t> m_SerializedMessages;
+	AsioConditionVariable m_SerializedMessagesDone;
+
+	/* Only used on m_IoStrand, see QueueLogPosition() */
+	double m_ReceivedLogPosition {0};
+	std::deque<std::pair<double, bool>> m_PendingLogPositions;
+	uint_fast64_t m_PendingLogPositionsBegin {1};
 
 	void HandleIncomingMessages(boost::asio::yield_context yc);
 	void WriteOutgoingMessages(boost::asio::yield_context yc);
-	void HandleAndWriteHeartbeats(boost::asio::yield_context yc);
 	void CheckLiveness(boost::asio::yield_context yc);
 
+	static void HeartbeatTimerHandler();
+	void RegisterHeartbeat();
+	void UnregisterHeartbeat();
+	void HandleHeartbeat(double now);
+
 	bool ProcessMessage();
-	void MessageHandler(const String& jsonString);
+	void MessageHandler(const String& jsonString, boost::asio::yield_context yc);
+
+	static String GetSerializationKey(const String& method, const Dictionary::Ptr& params);
+	void InvokeSerialized(const String& key, const intrusive_ptr<ApiFunction>& afunc, const intrusive_ptr<MessageOrigin>& origin,
+		const Dictionary::Ptr& params, uint_fast64_t logPosition);
+	void WaitForSerializedMessages(size_t max, boost::asio::yield_context yc);
+	uint_fast64_t QueueLogPosition(double ts, bool done);
+	void FinishLogPosition(uint_fast64_t id);
+	void InvokeCertificateRequest(const intrusive_ptr<ApiFunction>& afunc, const intrusive_ptr<MessageOrigin>& origin,
+		const Dictionary::Ptr& params, const Value& id);
 
 	void CertificateRequestResponseHandler(const Dictionary::Ptr& message);
 
-	void SendMessageInternal(const Dictionary::Ptr& request);
+	void SendMessageInternal(const Dictionary::Ptr& request, JsonRpcPriority priority = JsonRpcPriorityState);
+	void EnqueueMessage(std::shared_ptr<const String> message, JsonRpcPriority priority, String method);
 };
 
 }
@@ -5,6 +5,7 @@
 
 #include "remote/zone.hpp"
 #include "remote/jsonrpcconnection.hpp"
+#include "base/objectpool.hpp"
 
 namespace icinga
 {
@@ -16,6 +17,7 @@ class MessageOrigin final : public Object
 {
 public:
 	DECLARE_PTR_TYPEDEFS(MessageOrigin);
+	DECLARE_POOLED_ALLOCATION();
 
 	Zone::Ptr FromZone;
 	JsonRpcConnection::Ptr FromClient;
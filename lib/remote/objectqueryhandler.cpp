@@ -6,7 +6,15 @@
 #include "base/serializer.hpp"
 #include "base/dependencygraph.hpp"
 #include "base/configtype.hpp"
+#include "base/io-engine.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/http/chunk_encode.hpp>
+#include <boost/beast/http/serializer.hpp>
+#include <boost/beast/http/write.hpp>
+#include <memory>
 #include <set>
 #include <unordered_map>
 
@@ -14,11 +22,22 @@ using namespace icinga;
 
 REGISTER_URLHANDLER("/v1/objects", ObjectQueryHandler);
 
-Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& object,
+/* Encoded results are written out once they exceed this many bytes. */
+static const size_t l_ChunkSize = 64 * 1024;
+
+/**
+ * Resolves the attributes requested for objects of the specified type into field IDs.
+ *
+ * @param type The object type.
+ * @param attrPrefix The join prefix, e.g. "host".
+ * @param attrs The user-specified attributes, may be null.
+ * @param isJoin Whether the attributes are looked up for a joined object.
+ * @param allAttrs Whether all attributes are requested.
+ * @returns The user-visible fields to serialize.
+ */
+std::vector<ObjectQueryHandler::ProjectedField> ObjectQueryHandler::CompileAttrs(const Type::Ptr& type,
 	const String& attrPrefix, const Array::Ptr& attrs, bool isJoin, bool allAttrs)
 {
-	Type::Ptr type = object->GetReflectionType();
-
 	std::vector<int> fids;
 
 	if (isJoin && attrs) {
@@ -65,14 +84,12 @@ Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& obje
 		}
 	}
 
-	DictionaryData resultAttrs;
-	resultAttrs.reserve(fids.size());
+	std::vector<ProjectedField> fields;
+	fields.reserve(fids.size());
 
 	for (int fid : fids) {
 		Field field = type->GetFieldInfo(fid);
 
-		Value val = object->GetField(fid);
-
 		/* hide attributes which shouldn't be user-visible */
 		if (field.Attributes & FANoUserView)
 			continue;
@@ -81,13 +98,35 @@ Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& obje
 		if (field.Attributes & FANavigation && !(field.Attributes & (FAConfig | FAState)))
 			continue;
 
-		Value sval = Serialize(val, FAConfig | FAState);
-		resultAttrs.emplace_back(field.Name, sval);
+		fields.push_back({ fid, field.Name });
+	}
+
+	return fields;
+}
+
+Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& object, const std::vector<ProjectedField>& fields)
+{
+	DictionaryData resultAttrs;
+	resultAttrs.reserve(fields.size());
+
+	for (auto& field : fields) {
+		resultAttrs.emplace_back(field.Name, Serialize(object->GetField(field.ID), FAConfig | FAState));
 	}
 
 	return new Dictionary(std::move(resultAttrs));
 }
 
+bool ObjectQueryHandler::IsCacheable() const
+{
+	return true;
+}
+
+/* Cached responses have to be complete. */
+bool ObjectQueryHandler::IsStreaming(const boost::beast::http::request<boost::beast::http::string_body>& request) const
+{
+	return request.method() == boost::beast::http::verb::get && GetResponseCacheTtl(request) <= 0;
+}
+
 bool ObjectQueryHandler::HandleRequest(
 	AsioTlsStream& stream,
 	const ApiUser::Ptr& user,
@@ -99,6 +138,7 @@ bool ObjectQueryHandler::HandleRequest(
 	HttpServerConnection& server
 )
 {
+	namespace asio = boost::asio;
 	namespace http = boost::beast::http;
 
 	if (url->GetPath().size() < 3 || url->GetPath().size() > 4)
@@ -165,10 +205,20 @@ bool ObjectQueryHandler::HandleRequest(
 		return true;
 	}
 
-	ArrayData results;
-	results.reserve(objs.size());
-
-	std::set<String> joinAttrs;
+	/* Resolve the requested attributes and joins once per request. The
+	 * joined objects' attributes are cached as many objects usually share
+	 * the same joined object, e.g. services and their host.
+	 */
+	struct ProjectedJoin
+	{
+		int FieldID;
+		String Prefix;
+		std::unordered_map<Type*, std::vector<ProjectedField>> Fields;
+		std::unordered_map<Object*, Dictionary::Ptr> Results;
+	};
+
+	std::unordered_map<Type*, std::vector<ProjectedField>> attrFields;
+	std::vector<ProjectedJoin> joinPlans;
 	std::set<String> userJoinAttrs;
 
 	if (ujoins) {
@@ -178,22 +228,100 @@ bool ObjectQueryHandler::HandleRequest(
 		}
 	}
 
-	for (int fid = 0; fid < type->GetFieldCount(); fid++) {
-		Field field = type->GetFieldInfo(fid);
+	try {
+		attrFields.emplace(type.get(), CompileAttrs(type, String(), uattrs, false, false));
 
-		if (!(field.Attributes & FANavigation))
-			continue;
+		for (int fid = 0; fid < type->GetFieldCount(); fid++) {
+			Field field = type->GetFieldInfo(fid);
 
-		if (!allJoins && userJoinAttrs.find(field.NavigationName) == userJoinAttrs.end())
-			continue;
+			if (!(field.Attributes & FANavigation))
+				continue;
+
+			if (!allJoins && userJoinAttrs.find(field.NavigationName) == userJoinAttrs.end())
+				continue;
+
+			ProjectedJoin join;
+			join.FieldID = fid;
+			join.Prefix = field.NavigationName;
+
+			if (field.RefTypeName) {
+				Type::Ptr joinedType = Type::GetByName(field.RefTypeName);
 
-		joinAttrs.insert(field.Name);
+				if (joinedType)
+					join.Fields.emplace(joinedType.get(), CompileAttrs(joinedType, join.Prefix, ujoins, true, allJoins));
+			}
+
+			joinPlans.emplace_back(std::move(join));
+		}
+	} catch (const ScriptError& ex) {
+		HttpUtility::SendJsonError(response, params, 400, ex.what());
+		return true;
+	}
+
+	if (umetas) {
+		ObjectLock olock(umetas);
+		for (const String& meta : umetas) {
+			if (meta != "used_by" && meta != "location") {
+				HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for meta: " + meta);
+				return true;
+			}
+		}
 	}
 
 	std::unordered_map<Type*, std::pair<bool, std::unique_ptr<Expression>>> typePermissions;
 	std::unordered_map<Object*, bool> objectAccessAllowed;
 
+	/* The results are encoded one object at a time. As long as they fit into a
+	 * single chunk they're sent as a regular response. Larger results switch to
+	 * chunked transfer encoding so that memory usage is bounded by the chunk
+	 * size instead of the number of objects, unless the response is cached.
+	 */
+	bool pretty = HttpUtility::GetLastParameter(params, "pretty");
+
+	bool streamResults = IsStreaming(request);
+	String body = "{\"results\":[";
+	bool firstResult = true;
+	std::unique_ptr<http::response_serializer<http::string_body>> serializer;
+
+	auto sendError = [&response, &params, &serializer, &url](int code, const String& info) {
+		if (serializer) {
+			/* The status line was already sent, leave the chunked body incomplete
+			 * so that the client notices the error when the connection is closed.
+			 */
+			Log(LogWarning, "ObjectQueryHandler")
+				<< "Aborting streamed response for '" << url->Format() << "': " << info;
+		} else {
+			HttpUtility::SendJsonError(response, params, code, info);
+		}
+	};
+
+	auto writeChunk = [&stream, &response, &yc, &server, &body, &serializer]() {
+		if (!serializer) {
+			server.StartStreaming();
+
+			response.result(http::status::ok);
+			response.set(http::field::content_type, "application/json");
+			response.chunked(true);
+
+			serializer.reset(new http::response_serializer<http::string_body>(response));
+		}
+
+		IoBoundWorkSlot dontLockTheIoThread (yc);
+
+		if (!serializer->is_header_done()) {
+			http::async_write_header(stream, *serializer, yc);
+		}
+
+		asio::async_write(stream, http::make_chunk(asio::const_buffer(body.CStr(), body.GetLength())), yc);
+		stream.async_flush(yc);
+
+		body.Clear();
+	};
+
 	for (const ConfigObject::Ptr& obj : objs) {
+		if (serializer && server.Disconnected())
+			return true;
+
 		DictionaryData result1{
 			{ "name", obj->GetName() },
 			{ "type", obj->GetReflectionType()->GetName() }
@@ -222,9 +350,6 @@ bool ObjectQueryHandler::HandleRequest(
 					}
 				} else if (meta == "location") {
 					metaAttrs.emplace_back("location", obj->GetSourceLocation());
-				} else {
-					HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for meta: " + meta);
-					return true;
 				}
 			}
 		}
@@ -232,34 +357,37 @@ bool ObjectQueryHandler::HandleRequest(
 		result1.emplace_back("meta", new Dictionary(std::move(metaAttrs)));
 
 		try {
-			result1.emplace_back("attrs", SerializeObjectAttrs(obj, String(), uattrs, false, false));
+			Type::Ptr objType = obj->GetReflectionType();
+			auto fields (attrFields.find(objType.get()));
+
+			if (fields == attrFields.end())
+				fields = attrFields.emplace(objType.get(), CompileAttrs(objType, String(), uattrs, false, false)).first;
+
+			result1.emplace_back("attrs", SerializeObjectAttrs(obj, fields->second));
 		} catch (const ScriptError& ex) {
-			HttpUtility::SendJsonError(response, params, 400, ex.what());
+			sendError(400, ex.what());
 			return true;
 		}
 
 		DictionaryData joins;
 
-		for (const String& joinAttr : joinAttrs) {
-			Object::Ptr joinedObj;
-			int fid = type->GetFieldId(joinAttr);
+		for (auto& join : joinPlans) {
+			Object::Ptr joinedObj = obj->NavigateField(join.FieldID);
 
-			if (fid < 0) {
-				HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for join: " + joinAttr);
-				return true;
-			}
-
-			Field field = type->GetFieldInfo(fid);
+			if (!joinedObj)
+				continue;
 
-			if (!(field.Attributes & FANavigation)) {
-				HttpUtility::SendJsonError(response, params, 400, "Not a joinable field: " + joinAttr);
-				return true;
-			}
+			auto cached (join.Results.find(joinedObj.get()));
 
-			joinedObj = obj->NavigateField(fid);
+			if (cached != join.Results.end()) {
+				if (cached->second)
+					joins.emplace_back(join.Prefix, cached->second);
 
-			if (!joinedObj)
 				continue;
+			}
+
+			/* Remember denied objects as well, they're cached as null. */
+			Dictionary::Ptr& joinResult = join.Results[joinedObj.get()];
 
 			Type::Ptr reflectionType = joinedObj->GetReflectionType();
 			auto it = typePermissions.find(reflectionType.get());
@@ -304,27 +432,49 @@ bool ObjectQueryHandler::HandleRequest(
 				continue;
 			}
 
-			String prefix = field.NavigationName;
-
 			try {
-				joins.emplace_back(prefix, SerializeObjectAttrs(joinedObj, prefix, ujoins, true, allJoins));
+				auto fields (join.Fields.find(reflectionType.get()));
+
+				if (fields == join.Fields.end())
+					fields = join.Fields.emplace(reflectionType.get(), CompileAttrs(reflectionType, join.Prefix, ujoins, true, allJoins)).first;
+
+				joinResult = SerializeObjectAttrs(joinedObj, fields->second);
 			} catch (const ScriptError& ex) {
-				HttpUtility::SendJsonError(response, params, 400, ex.what());
+				sendError(400, ex.what());
 				return true;
 			}
+
+			joins.emplace_back(join.Prefix, joinResult);
 		}
 
 		result1.emplace_back("joins", new Dictionary(std::move(joins)));
 
-		results.push_back(new Dictionary(std::move(result1)));
+		if (!firstResult)
+			body += ",";
+
+		firstResult = false;
+		body += JsonEncode(new Dictionary(std::move(result1)), pretty);
+
+		if (streamResults && body.GetLength() >= l_ChunkSize)
+			writeChunk();
 	}
 
-	Dictionary::Ptr result = new Dictionary({
-		{ "results", new Array(std::move(results)) }
-	});
+	body += "]}";
+
+	if (!serializer) {
+		response.result(http::status::ok);
+		response.set(http::field::content_type, "application/json");
+		response.body() = std::move(body);
+		response.content_length(response.body().size());
+		return true;
+	}
+
+	writeChunk();
+
+	IoBoundWorkSlot dontLockTheIoThread (yc);
 
-	response.result(http::status::ok);
-	HttpUtility::SendJsonBody(response, params, result);
+	asio::async_write(stream, http::make_chunk_last(), yc);
+	stream.async_flush(yc);
 
 	return true;
 }
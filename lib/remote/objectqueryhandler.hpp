@@ -4,6 +4,7 @@
 #define OBJECTQUERYHANDLER_H
 
 #include "remote/httphandler.hpp"
+#include <vector>
 
 namespace icinga
 {
@@ -24,9 +25,19 @@ public:
 		HttpServerConnection& server
 	) override;
 
+	bool IsCacheable() const override;
+	bool IsStreaming(const boost::beast::http::request<boost::beast::http::string_body>& request) const override;
+
 private:
-	static Dictionary::Ptr SerializeObjectAttrs(const Object::Ptr& object, const String& attrPrefix,
+	struct ProjectedField
+	{
+		int ID;
+		String Name;
+	};
+
+	static std::vector<ProjectedField> CompileAttrs(const Type::Ptr& type, const String& attrPrefix,
 		const Array::Ptr& attrs, bool isJoin, bool allAttrs);
+	static Dictionary::Ptr SerializeObjectAttrs(const Object::Ptr& object, const std::vector<ProjectedField>& fields);
 };
 
 }
@@ -0,0 +1,213 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/relaybatch.hpp"
+#include "remote/apifunction.hpp"
+#include "remote/apilistener.hpp"
+#include "remote/duplicatemessagefilter.hpp"
+#include "remote/endpoint.hpp"
+#include "remote/jsonrpcconnection.hpp"
+#include "base/configtype.hpp"
+#include "base/defer.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/objectlock.hpp"
+
+using namespace icinga;
+
+REGISTER_APIFUNCTION(Batch, event, &RelayBatch::BatchAPIHandler);
+
+/**
+ * Messages per event::Batch, so that a single one doesn't hold up the connection for too long.
+ */
+static constexpr size_t l_MaxBatchSize = 1000;
+
+thread_local RelayBatch *RelayBatch::m_Current = nullptr;
+
+RelayBatch::RelayBatch()
+{
+	/* Nested batches just add to the outer one. */
+	if (!m_Current && PeersSupportBatches())
+		m_Current = this;
+}
+
+RelayBatch::~RelayBatch()
+{
+	if (m_Current != this)
+		return;
+
+	m_Current = nullptr;
+
+	for (auto& group : m_Groups) {
+		try {
+			Flush(group);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "RelayBatch")
+				<< "Error while relaying batched messages: " << DiagnosticInformation(ex, false);
+		}
+	}
+}
+
+/**
+ * Adds a message to the current thread's batch, if any.
+ *
+ * @return Whether the message has been added, otherwise it has to be relayed on its own
+ */
+bool RelayBatch::Add(const MessageOrigin::Ptr& origin, const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log)
+{
+	auto batch (m_Current);
+
+	if (!batch || !IsBatchable(message->Get("method")))
+		return false;
+
+	/* Like ApiListener::SyncRelayMessage() */
+	Zone::Ptr targetZone;
+
+	if (secobj) {
+		if (secobj->GetReflectionType() == Zone::TypeInstance)
+			targetZone = static_pointer_cast<Zone>(secobj);
+		else
+			targetZone = static_pointer_cast<Zone>(secobj->GetZone());
+	}
+
+	if (!targetZone)
+		targetZone = Zone::GetLocalZone();
+
+	bool isZone = secobj && secobj->GetReflectionType() == Zone::TypeInstance;
+
+	for (auto& group : batch->m_Groups) {
+		if (group.TargetZone != targetZone || group.Origin != origin
+			|| (group.SecObj && group.SecObj->GetReflectionType() == Zone::TypeInstance) != isZone)
+			continue;
+
+		/* Everything for one zone has to be relayed in order. */
+		if (group.Log != log || group.Messages.size() >= l_MaxBatchSize) {
+			batch->Flush(group);
+			group.Log = log;
+		}
+
+		if (!group.SecObj)
+			group.SecObj = secobj;
+
+		group.Messages.emplace_back(message);
+		return true;
+	}
+
+	batch->m_Groups.emplace_back(Group{targetZone, origin, secobj, log, ArrayData{message}});
+	return true;
+}
+
+/**
+ * Relays the group's messages collected so far.
+ */
+void RelayBatch::Flush(Group& group)
+{
+	ArrayData messages;
+	std::swap(messages, group.Messages);
+
+	if (messages.empty())
+		return;
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener)
+		return;
+
+	/* Don't let ApiListener::RelayMessage() add them to the batch again. */
+	auto current (m_Current);
+	m_Current = nullptr;
+
+	Defer restore ([current]() { m_Current = current; });
+
+	if (messages.size() == 1u) {
+		listener->RelayMessage(group.Origin, group.SecObj, messages[0], group.Log);
+		return;
+	}
+
+	Log(LogNotice, "RelayBatch")
+		<< "Relaying " << messages.size() << " messages to zone '" << group.TargetZone->GetName() << "' at once.";
+
+	Dictionary::Ptr message = new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "event::Batch" },
+		{ "params", new Dictionary({
+			{ "messages", new Array(std::move(messages)) }
+		}) }
+	});
+
+	listener->RelayMessage(group.Origin, group.SecObj, message, group.Log);
+}
+
+bool RelayBatch::PeersSupportBatches()
+{
+	if (!ApiListener::GetInstance())
+		return false;
+
+	auto localEndpoint (Endpoint::GetLocalEndpoint());
+
+	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
+		if (endpoint != localEndpoint && !(endpoint->GetCapabilities() & (uint_fast64_t)ApiCapabilities::EventBatches))
+			return false;
+	}
+
+	return true;
+}
+
+bool RelayBatch::IsBatchable(const String& method)
+{
+	return (method.Find("event::") == 0 && method != "event::Batch")
+		|| method == "config::UpdateObject" || method == "config::DeleteObject";
+}
+
+/**
+ * Processes the messages of an event::Batch one after another, as if they had been received on their own.
+ */
+Value RelayBatch::BatchAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	if (!origin->FromClient->GetEndpoint()) {
+		Log(LogNotice, "RelayBatch")
+			<< "Discarding 'batch' message from '" << origin->FromClient->GetIdentity() << "': Invalid endpoint origin (client not allowed).";
+		return Empty;
+	}
+
+	Array::Ptr messages = params->Get("messages");
+
+	if (!messages)
+		return Empty;
+
+	/* Whatever the messages relay further is batched again. */
+	RelayBatch batch;
+
+	ObjectLock olock(messages);
+	for (const Dictionary::Ptr& message : messages) {
+		String method = message->Get("method");
+
+		if (!IsBatchable(method)) {
+			Log(LogWarning, "RelayBatch")
+				<< "Discarding '" << method << "' message in batch from '" << origin->FromClient->GetIdentity() << "': Not allowed in batches.";
+			continue;
+		}
+
+		ApiFunction::Ptr afunc = ApiFunction::GetByName(method);
+
+		if (!afunc) {
+			Log(LogNotice, "RelayBatch")
+				<< "Call to non-existent function '" << method << "' in batch from '" << origin->FromClient->GetIdentity() << "'.";
+			continue;
+		}
+
+		Dictionary::Ptr messageParams = message->Get("params");
+
+		if (!messageParams || DuplicateMessageFilter::IsDuplicate(origin->FromClient->GetEndpoint(), method, messageParams))
+			continue;
+
+		try {
+			afunc->Invoke(origin, messageParams);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "RelayBatch")
+				<< "Error while processing '" << method << "' message in batch from '"
+				<< origin->FromClient->GetIdentity() << "'\n" << DiagnosticInformation(ex);
+		}
+	}
+
+	return Empty;
+}
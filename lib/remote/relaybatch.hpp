@@ -0,0 +1,62 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef RELAYBATCH_H
+#define RELAYBATCH_H
+
+#include "remote/i2-remote.hpp"
+#include "remote/messageorigin.hpp"
+#include "remote/zone.hpp"
+#include "base/array.hpp"
+#include "base/configobject.hpp"
+#include "base/dictionary.hpp"
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * While it exists, collects the event:: and config::(Update|Delete)Object messages ApiListener::RelayMessage()
+ * is called with in the current thread. They're relayed as one event::Batch message per target zone,
+ * at the latest when it's destroyed, e.g. after a bulk API action on thousands of objects.
+ *
+ * Does nothing unless all other endpoints announced ApiCapabilities::EventBatches.
+ *
+ * @ingroup remote
+ */
+class RelayBatch
+{
+public:
+	RelayBatch();
+	RelayBatch(const RelayBatch&) = delete;
+	RelayBatch(RelayBatch&&) = delete;
+	RelayBatch& operator=(const RelayBatch&) = delete;
+	RelayBatch& operator=(RelayBatch&&) = delete;
+	~RelayBatch();
+
+	static bool Add(const MessageOrigin::Ptr& origin, const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
+
+	static Value BatchAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+
+private:
+	struct Group
+	{
+		Zone::Ptr TargetZone;
+		MessageOrigin::Ptr Origin;
+		ConfigObject::Ptr SecObj;
+		bool Log;
+		ArrayData Messages;
+	};
+
+	static thread_local RelayBatch *m_Current;
+
+	std::vector<Group> m_Groups;
+
+	static bool PeersSupportBatches();
+	static bool IsBatchable(const String& method);
+
+	void Flush(Group& group);
+};
+
+}
+
+#endif /* RELAYBATCH_H */
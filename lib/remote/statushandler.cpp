@@ -68,6 +68,11 @@ public:
 	}
 };
 
+bool StatusHandler::IsCacheable() const
+{
+	return true;
+}
+
 bool StatusHandler::HandleRequest(
 	AsioTlsStream& stream,
 	const ApiUser::Ptr& user,
@@ -75,6 +75,11 @@ public:
 	}
 };
 
+bool TemplateQueryHandler::IsCacheable() const
+{
+	return true;
+}
+
 bool TemplateQueryHandler::HandleRequest(
 	AsioTlsStream& stream,
 	const ApiUser::Ptr& user,
@@ -46,6 +46,11 @@ public:
 	}
 };
 
+bool TypeQueryHandler::IsCacheable() const
+{
+	return true;
+}
+
 bool TypeQueryHandler::HandleRequest(
 	AsioTlsStream& stream,
 	const ApiUser::Ptr& user,
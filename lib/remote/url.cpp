@@ -6,6 +6,7 @@
 #include "remote/url.hpp"
 #include "remote/url-characters.hpp"
 #include <boost/tokenizer.hpp>
+#include <cstring>
 
 using namespace icinga;
 
@@ -305,40 +306,47 @@ bool Url::ParsePath(const String& path)
 
 bool Url::ParseQuery(const String& query)
 {
-	/* Tokenizer does not like String AT ALL */
 	const std::string& queryStr = query;
-	boost::char_separator<char> sep("&");
-	boost::tokenizer<boost::char_separator<char> > tokens(queryStr, sep);
 
-	for (const String& token : tokens) {
-		size_t pHelper = token.Find("=");
+	/* Splits the query in place, only the keys and values themselves are copied. */
+	for (std::string::size_type begin = 0; begin < queryStr.size();) {
+		auto end (queryStr.find('&', begin));
+
+		if (end == std::string::npos)
+			end = queryStr.size();
+
+		if (end == begin) {
+			// /?foo=bar&&bar=foo, empty parameters are skipped
+			begin++;
+			continue;
+		}
+
+		auto pHelper (queryStr.find('=', begin));
 
-		if (pHelper == 0)
+		if (pHelper == begin)
 			// /?foo=bar&=bar == invalid
 			return false;
 
-		String key = token.SubStr(0, pHelper);
-		String value = Empty;
+		if (pHelper > end)
+			pHelper = end;
 
-		if (pHelper != String::NPos && pHelper != token.GetLength() - 1)
-			value = token.SubStr(pHelper+1);
+		auto keyEnd (pHelper);
 
-		if (!ValidateToken(value, ACQUERY))
-			return false;
+		if (keyEnd - begin >= 2 && queryStr.compare(keyEnd - 2, 2, "[]") == 0)
+			keyEnd -= 2;
 
-		value = Utility::UnescapeString(value);
+		String key = queryStr.substr(begin, keyEnd - begin);
+		String value = pHelper < end ? queryStr.substr(pHelper + 1, end - pHelper - 1) : std::string();
 
-		pHelper = key.Find("[]");
+		begin = end + 1;
 
-		if (pHelper == 0 || (pHelper != String::NPos && pHelper != key.GetLength()-2))
+		if (key.IsEmpty() || key.Find("[]") != String::NPos)
 			return false;
 
-		key = key.SubStr(0, pHelper);
-
-		if (!ValidateToken(key, ACQUERY))
+		if (!ValidateToken(value, ACQUERY) || !ValidateToken(key, ACQUERY))
 			return false;
 
-		m_Query.emplace_back(Utility::UnescapeString(key), std::move(value));
+		m_Query.emplace_back(Utility::UnescapeString(key), Utility::UnescapeString(value));
 	}
 
 	return true;
@@ -351,10 +359,10 @@ bool Url::ParseFragment(const String& fragment)
 	return ValidateToken(fragment, ACFRAGMENT);
 }
 
-bool Url::ValidateToken(const String& token, const String& symbols)
+bool Url::ValidateToken(const String& token, const char *symbols)
 {
 	for (const char ch : token) {
-		if (symbols.FindFirstOf(ch) == String::NPos)
+		if (!ch || !strchr(symbols, ch))
 			return false;
 	}
 
@@ -71,7 +71,7 @@ private:
 	bool ParseQuery(const String& query);
 	bool ParseFragment(const String& fragment);
 
-	static bool ValidateToken(const String& token, const String& symbols);
+	static bool ValidateToken(const String& token, const char *symbols);
 };
 
 }
@@ -56,6 +56,11 @@ public:
 	}
 };
 
+bool VariableQueryHandler::IsCacheable() const
+{
+	return true;
+}
+
 bool VariableQueryHandler::HandleRequest(
 	AsioTlsStream& stream,
 	const ApiUser::Ptr& user,
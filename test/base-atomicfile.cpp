@@ -0,0 +1,110 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/atomic-file.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+#	include <sys/resource.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+
+static String ReadFile(const String& path)
+{
+	std::ifstream fp (path.CStr());
+
+	return String(std::istreambuf_iterator<char>(fp), std::istreambuf_iterator<char>());
+}
+
+BOOST_AUTO_TEST_SUITE(base_atomicfile)
+
+BOOST_AUTO_TEST_CASE(group)
+{
+	namespace fs = boost::filesystem;
+
+	String dir = (fs::temp_directory_path() / fs::unique_path("icinga2-atomicfile-%%%%-%%%%")).string();
+	fs::create_directories((dir + "/sub").GetData());
+
+	AtomicFile::Write(dir + "/0.conf", 0644, "old");
+
+	{
+		AtomicFileGroup files;
+
+		for (int i = 0; i < 10; i++)
+			files.Add(dir + (i % 2 ? "/sub/" : "/") + Convert::ToString(i) + ".conf", 0644, "new " + Convert::ToString(i));
+
+		BOOST_CHECK_EQUAL(files.GetLength(), 10);
+		BOOST_CHECK_EQUAL(ReadFile(dir + "/0.conf"), "old");
+
+		files.Commit();
+
+		BOOST_CHECK_EQUAL(files.GetLength(), 0);
+	}
+
+	for (int i = 0; i < 10; i++)
+		BOOST_CHECK_EQUAL(ReadFile(dir + (i % 2 ? "/sub/" : "/") + Convert::ToString(i) + ".conf"), "new " + Convert::ToString(i));
+
+	{
+		AtomicFileGroup files;
+		files.Add(dir + "/uncommitted.conf", 0644, "new");
+	}
+
+	BOOST_CHECK(!Utility::PathExists(dir + "/uncommitted.conf"));
+
+	/* No temporary files left behind */
+	BOOST_CHECK_EQUAL(std::distance(fs::directory_iterator(dir.GetData()), fs::directory_iterator()), 6);
+
+	boost::system::error_code ec;
+	fs::remove_all(dir.GetData(), ec);
+}
+
+BOOST_AUTO_TEST_CASE(group_file_descriptors)
+{
+	namespace fs = boost::filesystem;
+
+	String dir = (fs::temp_directory_path() / fs::unique_path("icinga2-atomicfile-%%%%-%%%%")).string();
+	fs::create_directories(dir.GetData());
+
+#ifndef _WIN32
+	struct rlimit limit;
+	BOOST_REQUIRE(getrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+	/* The group must not keep more files open than the limit allows. */
+	struct rlimit lowered = limit;
+	lowered.rlim_cur = 64;
+	BOOST_REQUIRE(setrlimit(RLIMIT_NOFILE, &lowered) == 0);
+#endif /* _WIN32 */
+
+	bool committed = false;
+
+	try {
+		AtomicFileGroup files;
+
+		for (int i = 0; i < 200; i++)
+			files.Add(dir + "/" + Convert::ToString(i) + ".conf", 0644, Convert::ToString(i));
+
+		files.Commit();
+		committed = true;
+	} catch (const std::exception& ex) {
+		BOOST_ERROR(ex.what());
+	}
+
+#ifndef _WIN32
+	BOOST_REQUIRE(setrlimit(RLIMIT_NOFILE, &limit) == 0);
+#endif /* _WIN32 */
+
+	BOOST_REQUIRE(committed);
+
+	for (int i = 0; i < 200; i++)
+		BOOST_CHECK_EQUAL(ReadFile(dir + "/" + Convert::ToString(i) + ".conf"), Convert::ToString(i));
+
+	boost::system::error_code ec;
+	fs::remove_all(dir.GetData(), ec);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,324 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "icinga/checkresult.hpp"
+#include "base/array.hpp"
+#include "base/convert.hpp"
+#include "base/dictionary.hpp"
+#include "base/fifo.hpp"
+#include "base/json.hpp"
+#include "base/netstring.hpp"
+#include "base/object-packer.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/serializer.hpp"
+#include "base/timer.hpp"
+#include "base/utility.hpp"
+#include "base/workqueue.hpp"
+#include "benchmark-utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <vector>
+
+using namespace icinga;
+
+/* Counts the heap allocations of this process, so that the benchmark can report them per operation. */
+static std::atomic<size_t> l_Allocations (0);
+
+void *operator new(std::size_t size)
+{
+	l_Allocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (void *ptr = std::malloc(size ? size : 1))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+/**
+ * Runs op ICINGA2_BASE_BENCHMARK_ITERATIONS (default: 10000) times, divided by scale if set,
+ * and reports the wall clock and CPU time as well as the allocations per operation.
+ *
+ * @return The number of operations executed
+ */
+static size_t RunBenchmark(const String& name, const std::function<void(size_t)>& op, size_t scale = 1)
+{
+	size_t iterations = std::max<size_t>(GetEnvCount("ICINGA2_BASE_BENCHMARK_ITERATIONS", 10000) / scale, 1);
+
+	size_t allocationsStart = l_Allocations.load(std::memory_order_relaxed);
+	double start = Utility::GetTime();
+	std::clock_t cpuStart = std::clock();
+
+	for (size_t i = 0; i < iterations; i++)
+		op(i);
+
+	double duration = Utility::GetTime() - start;
+	double cpu = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+	size_t allocations = l_Allocations.load(std::memory_order_relaxed) - allocationsStart;
+
+	std::cout << name << ": " << iterations << " operations, " << duration / iterations * 1000000000 << "ns wall and "
+		<< cpu / iterations * 1000000000 << "ns CPU per operation, "
+		<< static_cast<double>(allocations) / iterations << " allocations per operation\n";
+
+	return iterations;
+}
+
+/**
+ * An event::CheckResult message like ClusterEvents::MakeCheckResultMessage() creates it.
+ */
+static Dictionary::Ptr MakeCheckResultMessage()
+{
+	CheckResult::Ptr cr = new CheckResult();
+	double now = Utility::GetTime();
+
+	cr->SetState(ServiceWarning);
+	cr->SetOutput("DISK WARNING - free space: / 3326 MB (8% inode=88%);");
+	cr->SetCommand(new Array({ "/usr/lib/nagios/plugins/check_disk", "-w", "20%", "-c", "10%", "-p", "/" }));
+	cr->SetPerformanceData(new Array({
+		new PerfdataValue("/", 36787, false, "MB", 33237, 37392, 0, 41547),
+		new PerfdataValue("/boot", 85, false, "MB", 380, 427, 0, 475)
+	}));
+	cr->SetScheduleStart(now);
+	cr->SetScheduleEnd(now + 1);
+	cr->SetExecutionStart(now);
+	cr->SetExecutionEnd(now + 1);
+	cr->SetCheckSource("satellite-01.example.com");
+	cr->SetActive(true);
+
+	return new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "event::CheckResult" },
+		{ "params", new Dictionary({
+			{ "host", "web-01.example.com" },
+			{ "service", "disk /" },
+			{ "cr", Serialize(cr) }
+		}) }
+	});
+}
+
+BOOST_AUTO_TEST_SUITE(base_benchmark)
+
+BOOST_AUTO_TEST_CASE(dictionary)
+{
+	std::vector<String> keys;
+
+	for (int i = 0; i < 32; i++)
+		keys.emplace_back("key" + Convert::ToString(i));
+
+	Dictionary::Ptr dict = new Dictionary();
+
+	RunBenchmark("Dictionary set", [&dict, &keys](size_t i) {
+		dict->Set(keys[i % keys.size()], static_cast<double>(i));
+	});
+
+	BOOST_CHECK(dict->GetLength() == keys.size());
+
+	double sum = 0;
+
+	RunBenchmark("Dictionary get", [&dict, &keys, &sum](size_t i) {
+		sum += static_cast<double>(dict->Get(keys[i % keys.size()]));
+	});
+
+	size_t items = 0;
+
+	RunBenchmark("Dictionary iterate (32 keys)", [&dict, &items](size_t) {
+		ObjectLock olock (dict);
+
+		for (auto& kv : dict)
+			items += kv.second.IsNumber();
+	}, 10);
+
+	BOOST_CHECK(sum > 0 && items > 0);
+
+	RunBenchmark("Dictionary construct (8 keys)", [&keys](size_t i) {
+		Dictionary::Ptr d = new Dictionary({
+			{ keys[0], i }, { keys[1], "foo" }, { keys[2], true }, { keys[3], Empty },
+			{ keys[4], i }, { keys[5], "bar" }, { keys[6], false }, { keys[7], 4.2 }
+		});
+	});
+}
+
+BOOST_AUTO_TEST_CASE(value)
+{
+	double sum = 0;
+
+	RunBenchmark("Value number to String", [&sum](size_t i) {
+		Value v (static_cast<double>(i));
+		sum += static_cast<String>(v).GetLength();
+	});
+
+	RunBenchmark("Value String to number", [&sum](size_t i) {
+		Value v (i % 2 ? "1234.5" : "42");
+		sum += static_cast<double>(v);
+	});
+
+	RunBenchmark("Value to bool", [&sum](size_t i) {
+		Value v (i % 2 ? Value("foo") : Value(0));
+		sum += v.ToBool();
+	});
+
+	Dictionary::Ptr dict = new Dictionary();
+
+	RunBenchmark("Value copy object", [&dict, &sum](size_t) {
+		Value v (dict);
+		Value w (v);
+		sum += w.IsObject();
+	});
+
+	BOOST_CHECK(sum > 0);
+}
+
+BOOST_AUTO_TEST_CASE(json)
+{
+	Dictionary::Ptr message = MakeCheckResultMessage();
+	String encoded = JsonEncode(message);
+	size_t bytes = 0;
+
+	RunBenchmark("JsonEncode check result message", [&message, &bytes](size_t) {
+		bytes += JsonEncode(message).GetLength();
+	}, 10);
+
+	RunBenchmark("JsonDecode check result message", [&encoded, &bytes](size_t) {
+		Dictionary::Ptr decoded = JsonDecode(encoded);
+		bytes += decoded->GetLength();
+	}, 10);
+
+	String heartbeat = JsonEncode(new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "event::Heartbeat" },
+		{ "params", new Dictionary({ { "timeout", 120 } }) }
+	}));
+
+	RunBenchmark("JsonDecode heartbeat message", [&heartbeat, &bytes](size_t) {
+		Dictionary::Ptr decoded = JsonDecode(heartbeat);
+		bytes += decoded->GetLength();
+	});
+
+	BOOST_CHECK(bytes > 0);
+}
+
+BOOST_AUTO_TEST_CASE(pack_object)
+{
+	Dictionary::Ptr message = MakeCheckResultMessage();
+	size_t bytes = 0;
+
+	RunBenchmark("PackObject check result message", [&message, &bytes](size_t) {
+		bytes += PackObject(message).GetLength();
+	}, 10);
+
+	BOOST_CHECK(bytes > 0);
+}
+
+BOOST_AUTO_TEST_CASE(serialize)
+{
+	Dictionary::Ptr message = MakeCheckResultMessage();
+	Dictionary::Ptr params = message->Get("params");
+	CheckResult::Ptr cr = new CheckResult();
+
+	Deserialize(cr, params->Get("cr"), true);
+
+	size_t items = 0;
+
+	RunBenchmark("Serialize check result", [&cr, &items](size_t) {
+		Dictionary::Ptr serialized = Serialize(cr);
+		items += serialized->GetLength();
+	}, 10);
+
+	RunBenchmark("Deserialize check result", [&params, &items](size_t) {
+		CheckResult::Ptr result = new CheckResult();
+		Deserialize(result, params->Get("cr"), true);
+		items += result->GetState();
+	}, 10);
+
+	BOOST_CHECK(items > 0);
+}
+
+BOOST_AUTO_TEST_CASE(netstring)
+{
+	String message = JsonEncode(MakeCheckResultMessage());
+	FIFO::Ptr fifo = new FIFO();
+	StreamReadContext src;
+	size_t bytes = 0;
+
+	RunBenchmark("NetString write and read check result message", [&message, &fifo, &src, &bytes](size_t) {
+		NetString::WriteStringToStream(fifo, message);
+
+		String s;
+
+		if (NetString::ReadStringFromStream(fifo, &s, src) == StatusNewItem)
+			bytes += s.GetLength();
+	}, 10);
+
+	fifo->Close();
+
+	BOOST_CHECK(bytes > 0);
+}
+
+BOOST_AUTO_TEST_CASE(workqueue)
+{
+	WorkQueue wq (0, 1);
+	wq.SetName("Benchmark");
+
+	std::atomic<size_t> calls (0);
+
+	size_t iterations = RunBenchmark("WorkQueue enqueue (then join)", [&wq, &calls](size_t) {
+		wq.Enqueue([&calls]() { calls.fetch_add(1, std::memory_order_relaxed); });
+	});
+
+	wq.Join();
+
+	BOOST_CHECK(calls == iterations);
+
+	iterations = RunBenchmark("WorkQueue enqueue and join", [&wq, &calls](size_t) {
+		wq.Enqueue([&calls]() { calls.fetch_add(1, std::memory_order_relaxed); });
+		wq.Join();
+	}, 10);
+
+	BOOST_CHECK(calls > iterations);
+}
+
+BOOST_AUTO_TEST_CASE(timer)
+{
+	std::vector<Timer::Ptr> timers;
+
+	/* Some timers which never expire during the benchmark, so that the rescheduled one isn't alone. */
+	for (int i = 0; i < 1000; i++) {
+		Timer::Ptr t = Timer::Create();
+		t->SetInterval(3600 + i);
+		t->Start();
+		timers.emplace_back(std::move(t));
+	}
+
+	Timer::Ptr timer = Timer::Create();
+	timer->SetInterval(3600);
+	timer->Start();
+
+	double now = Utility::GetTime();
+
+	RunBenchmark("Timer reschedule (1000 other timers)", [&timer, now](size_t i) {
+		timer->Reschedule(now + 1800 + i % 3600);
+	});
+
+	BOOST_CHECK(timer->GetNext() > now);
+
+	timer->Stop(true);
+
+	for (auto& t : timers)
+		t->Stop(true);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
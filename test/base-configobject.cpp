@@ -0,0 +1,352 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "icinga/host.hpp"
+#include "base/application.hpp"
+#include "base/configobject.hpp"
+#include "base/configobjecttable.hpp"
+#include "base/configtype.hpp"
+#include "base/filelogger.hpp"
+#include "base/json.hpp"
+#include "base/netstring.hpp"
+#include "base/stdiostream.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+using namespace icinga;
+
+static FileLogger::Ptr RegisterLogger(const String& name, double version)
+{
+	FileLogger::Ptr logger = new FileLogger();
+	logger->SetName(name);
+	logger->SetVersion(version);
+	logger->Register();
+	return logger;
+}
+
+static FileLogger::Ptr RegisterActiveLogger(const String& name, double version)
+{
+	FileLogger::Ptr logger = RegisterLogger(name, version);
+
+	/* Only active objects are tracked, without starting the logger. */
+	logger->SetActive(true, true);
+
+	return logger;
+}
+
+static String GetTempPath()
+{
+	return (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("icinga2-state-%%%%-%%%%")).string();
+}
+
+BOOST_AUTO_TEST_SUITE(base_configobject)
+
+BOOST_AUTO_TEST_CASE(state_roundtrip)
+{
+	FileLogger::Ptr first = RegisterLogger("state-first", 42);
+	FileLogger::Ptr second = RegisterLogger("state-second", 23.5);
+	String path = GetTempPath();
+
+	ConfigObject::DumpObjects(path);
+
+	std::ifstream fp (path.CStr(), std::ios_base::binary);
+	char magic[7];
+	BOOST_REQUIRE(fp.read(magic, sizeof(magic)));
+	BOOST_CHECK(String(magic, magic + sizeof(magic)) == "I2STATE");
+	fp.close();
+
+	first->SetVersion(0);
+	second->SetVersion(0);
+
+	ConfigObject::RestoreObjects(path);
+
+	BOOST_CHECK_EQUAL(first->GetVersion(), 42);
+	BOOST_CHECK_EQUAL(second->GetVersion(), 23.5);
+
+	first->Unregister();
+	second->Unregister();
+	Utility::Remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(state_json_import)
+{
+	FileLogger::Ptr logger = RegisterLogger("state-json", 0);
+	String path = GetTempPath();
+
+	{
+		std::fstream fp (path.CStr(), std::ios_base::out | std::ios_base::trunc);
+		StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+		NetString::WriteStringToStream(sfp, JsonEncode(new Dictionary({
+			{ "type", "FileLogger" },
+			{ "name", "state-json" },
+			{ "update", new Dictionary({ { "type", "FileLogger" }, { "version", 7 } }) }
+		})));
+
+		NetString::WriteStringToStream(sfp, JsonEncode(new Dictionary({
+			{ "type", "FileLogger" },
+			{ "name", "state-missing" },
+			{ "update", new Dictionary({ { "type", "FileLogger" }, { "version", 8 } }) }
+		})));
+
+		sfp->Close();
+	}
+
+	ConfigObject::RestoreObjects(path);
+
+	BOOST_CHECK_EQUAL(logger->GetVersion(), 7);
+
+	logger->Unregister();
+	Utility::Remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(state_defaults)
+{
+	FileLogger::Ptr changed = RegisterLogger("state-defaults-changed", 42);
+	FileLogger::Ptr unchanged = RegisterLogger("state-defaults-unchanged", 0);
+	String path = GetTempPath();
+
+	ConfigObject::DumpObjects(path);
+
+	/* The default value isn't in the state file, but still restored. */
+	changed->SetVersion(0);
+	unchanged->SetVersion(7);
+
+	ConfigObject::RestoreObjects(path);
+
+	BOOST_CHECK_EQUAL(changed->GetVersion(), 42);
+	BOOST_CHECK_EQUAL(unchanged->GetVersion(), 0);
+
+	changed->Unregister();
+	unchanged->Unregister();
+	Utility::Remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(state_changing_defaults)
+{
+	double startTime = Application::GetStartTime();
+	Application::SetStartTime(1000);
+
+	Host::Ptr host = new Host();
+	host->SetName("state-changing-defaults");
+	host->Register();
+
+	String path = GetTempPath();
+
+	ConfigObject::DumpObjects(path);
+
+	/* After a restart the new objects' last state changes default to the new start time. */
+	host->Unregister();
+	Application::SetStartTime(2000);
+
+	host = new Host();
+	host->SetName("state-changing-defaults");
+	host->Register();
+
+	BOOST_REQUIRE_EQUAL(host->GetLastStateChange(), 2000);
+
+	ConfigObject::RestoreObjects(path);
+
+	BOOST_CHECK_EQUAL(host->GetLastStateChange(), 1000);
+	BOOST_CHECK_EQUAL(host->GetLastHardStateChange(), 1000);
+	BOOST_CHECK_EQUAL(host->GetPreviousStateChange(), 1000);
+
+	host->Unregister();
+	Application::SetStartTime(startTime);
+	Utility::Remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(state_truncated)
+{
+	FileLogger::Ptr logger = RegisterLogger("state-truncated", 1);
+	String path = GetTempPath();
+
+	ConfigObject::DumpObjects(path);
+
+	boost::filesystem::resize_file(path.GetData(), boost::filesystem::file_size(path.GetData()) - 1);
+
+	BOOST_CHECK_THROW(ConfigObject::RestoreObjects(path), std::runtime_error);
+
+	logger->Unregister();
+	Utility::Remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(state_journal)
+{
+	FileLogger::Ptr changed = RegisterActiveLogger("journal-changed", 1);
+	FileLogger::Ptr unchanged = RegisterActiveLogger("journal-unchanged", 1);
+	FileLogger::Ptr other = RegisterActiveLogger("journal-other", 1);
+	String path = GetTempPath();
+	String journalPath = ConfigObject::GetStateJournalPath(path);
+
+	ConfigObject::DumpObjects(path);
+
+	ConfigObject::DumpDirtyObjects(path);
+	BOOST_CHECK(!Utility::PathExists(journalPath));
+
+	changed->SetVersion(2);
+	ConfigObject::DumpDirtyObjects(path);
+	BOOST_CHECK(Utility::PathExists(journalPath));
+
+	changed->SetVersion(0);
+	unchanged->SetVersion(0);
+
+	ConfigObject::RestoreObjects(path);
+
+	BOOST_CHECK_EQUAL(changed->GetVersion(), 2);
+	BOOST_CHECK_EQUAL(unchanged->GetVersion(), 1);
+
+	ConfigObject::DumpObjects(path);
+	BOOST_CHECK(!Utility::PathExists(journalPath));
+
+	changed->Unregister();
+	unchanged->Unregister();
+	other->Unregister();
+	Utility::Remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(state_journal_truncated)
+{
+	FileLogger::Ptr changed = RegisterActiveLogger("journal-truncated-changed", 1);
+	FileLogger::Ptr unchanged = RegisterActiveLogger("journal-truncated-unchanged", 1);
+	FileLogger::Ptr other = RegisterActiveLogger("journal-truncated-other", 1);
+	String path = GetTempPath();
+	String journalPath = ConfigObject::GetStateJournalPath(path);
+
+	ConfigObject::DumpObjects(path);
+
+	changed->SetVersion(2);
+	ConfigObject::DumpDirtyObjects(path);
+
+	changed->SetVersion(3);
+	ConfigObject::DumpDirtyObjects(path);
+
+	boost::filesystem::resize_file(journalPath.GetData(), boost::filesystem::file_size(journalPath.GetData()) - 1);
+
+	changed->SetVersion(0);
+
+	/* Only the incomplete record is lost. */
+	ConfigObject::RestoreObjects(path);
+	BOOST_CHECK_EQUAL(changed->GetVersion(), 2);
+
+	/* The next dump replaces the damaged journal with a new state file. */
+	changed->SetVersion(4);
+	ConfigObject::DumpDirtyObjects(path);
+	BOOST_CHECK(!Utility::PathExists(journalPath));
+
+	changed->SetVersion(0);
+
+	ConfigObject::RestoreObjects(path);
+	BOOST_CHECK_EQUAL(changed->GetVersion(), 4);
+
+	changed->Unregister();
+	unchanged->Unregister();
+	other->Unregister();
+	Utility::Remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(state_journal_incremental)
+{
+	FileLogger::Ptr changed = RegisterActiveLogger("journal-incremental-changed", 1);
+	FileLogger::Ptr unchanged = RegisterActiveLogger("journal-incremental-unchanged", 1);
+	String path = GetTempPath();
+
+	ConfigObject::DumpObjects(path);
+
+	changed->SetVersion(2);
+	ConfigObject::DumpDirtyObjects(path);
+
+	ConfigObject::RestoreObjects(path);
+
+	changed->SetVersion(3);
+	ConfigObject::DumpDirtyObjects(path);
+
+	changed->SetVersion(0);
+	unchanged->SetVersion(0);
+
+	/* Only the record appended after the last restore is replayed. */
+	ConfigObject::RestoreObjects(path, FAState, true);
+	BOOST_CHECK_EQUAL(changed->GetVersion(), 3);
+	BOOST_CHECK_EQUAL(unchanged->GetVersion(), 0);
+
+	/* A new state file is restored completely. */
+	unchanged->SetVersion(1);
+	ConfigObject::DumpObjects(path);
+	unchanged->SetVersion(0);
+
+	ConfigObject::RestoreObjects(path, FAState, true);
+	BOOST_CHECK_EQUAL(unchanged->GetVersion(), 1);
+
+	changed->Unregister();
+	unchanged->Unregister();
+	Utility::Remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(name_lookup)
+{
+	FileLogger::Ptr logger = RegisterLogger("lookup-logger", 0);
+	auto *ctype = ConfigType::Get<FileLogger>();
+
+	BOOST_CHECK(ctype->GetObject("lookup-logger") == logger);
+
+	/* A part of a larger buffer, like a state file record. */
+	const char buffer[] = "xlookup-loggerx";
+	BOOST_CHECK(ctype->GetObject(std::string_view(buffer + 1, 13)) == logger);
+	BOOST_CHECK(!ctype->GetObject(std::string_view(buffer, 14)));
+
+	logger->Unregister();
+
+	BOOST_CHECK(!ctype->GetObject("lookup-logger"));
+}
+
+BOOST_AUTO_TEST_CASE(type_index)
+{
+	FileLogger::Ptr first = RegisterLogger("index-first", 0);
+	FileLogger::Ptr second = RegisterLogger("index-second", 0);
+
+	BOOST_CHECK(first->GetTypeIndex() != second->GetTypeIndex());
+	BOOST_CHECK(first->GetTypeIndex() < ConfigType::Get<FileLogger>()->GetTypeIndexCount());
+	BOOST_CHECK(second->GetTypeIndex() < ConfigType::Get<FileLogger>()->GetTypeIndexCount());
+
+	size_t index = first->GetTypeIndex();
+	first->Unregister();
+
+	BOOST_CHECK(first->GetTypeIndex() == static_cast<size_t>(-1));
+
+	/* Freed indexes are reused, so that they stay dense. */
+	FileLogger::Ptr third = RegisterLogger("index-third", 0);
+	BOOST_CHECK(third->GetTypeIndex() == index);
+
+	second->Unregister();
+	third->Unregister();
+}
+
+BOOST_AUTO_TEST_CASE(object_table)
+{
+	FileLogger::Ptr first = RegisterLogger("table-first", 0);
+	FileLogger::Ptr second = RegisterLogger("table-second", 0);
+
+	ConfigObjectTable<int> values (-1);
+	ConfigObjectTable<bool> flags;
+
+	BOOST_CHECK(values.Get(first.get()) == -1);
+
+	values[first.get()] = 42;
+	flags[second.get()] = true;
+
+	BOOST_CHECK(values.Get(first.get()) == 42);
+	BOOST_CHECK(values.Get(second.get()) == -1);
+	BOOST_CHECK(!flags.Get(first.get()));
+	BOOST_CHECK(flags.Get(second.get()));
+
+	values.Reset(first.get());
+	BOOST_CHECK(values.Get(first.get()) == -1);
+
+	first->Unregister();
+	second->Unregister();
+
+	BOOST_CHECK_THROW(values[first.get()], std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,48 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/deadlinequeue.hpp"
+#include "base/string.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_deadlinequeue)
+
+BOOST_AUTO_TEST_CASE(pop_due)
+{
+	DeadlineQueue<String> queue;
+
+	queue.Set("c", 30);
+	queue.Set("a", 10);
+	queue.Set("b", 20);
+	BOOST_CHECK_EQUAL(queue.GetLength(), 3);
+
+	BOOST_CHECK(queue.PopDue(10).empty());
+
+	std::vector<String> due = queue.PopDue(25);
+	BOOST_REQUIRE_EQUAL(due.size(), 2);
+	BOOST_CHECK(due[0] == "a");
+	BOOST_CHECK(due[1] == "b");
+	BOOST_CHECK_EQUAL(queue.GetLength(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(move_and_remove)
+{
+	DeadlineQueue<String> queue;
+
+	queue.Set("a", 10);
+	queue.Set("b", 20);
+	queue.Set("a", 30);
+	BOOST_CHECK_EQUAL(queue.GetLength(), 2);
+
+	std::vector<String> due = queue.PopDue(25);
+	BOOST_REQUIRE_EQUAL(due.size(), 1);
+	BOOST_CHECK(due[0] == "b");
+
+	queue.Remove("a");
+	queue.Remove("unknown");
+	BOOST_CHECK_EQUAL(queue.GetLength(), 0);
+	BOOST_CHECK(queue.PopDue(100).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,71 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/dependencygraph.hpp"
+#include "base/array.hpp"
+#include <BoostTestTargetConfig.h>
+#include <thread>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_dependencygraph)
+
+BOOST_AUTO_TEST_CASE(refcount)
+{
+	Array::Ptr parent1 = new Array();
+	Array::Ptr parent2 = new Array();
+	Array::Ptr child = new Array();
+
+	DependencyGraph::AddDependency(parent1.get(), child.get());
+	DependencyGraph::AddDependency(parent1.get(), child.get());
+	DependencyGraph::AddDependency(parent2.get(), child.get());
+
+	BOOST_CHECK_EQUAL(DependencyGraph::GetParents(child).size(), 2);
+	BOOST_CHECK(DependencyGraph::GetParents(parent1).empty());
+
+	DependencyGraph::RemoveDependency(parent1.get(), child.get());
+	DependencyGraph::RemoveDependency(parent2.get(), child.get());
+
+	auto parents (DependencyGraph::GetParents(child));
+	BOOST_REQUIRE_EQUAL(parents.size(), 1);
+	BOOST_CHECK(parents[0] == parent1);
+
+	/* Removing what doesn't exist is a no-op. */
+	DependencyGraph::RemoveDependency(parent2.get(), child.get());
+	DependencyGraph::RemoveDependency(parent1.get(), child.get());
+	DependencyGraph::RemoveDependency(parent1.get(), child.get());
+
+	BOOST_CHECK(DependencyGraph::GetParents(child).empty());
+}
+
+BOOST_AUTO_TEST_CASE(concurrent)
+{
+	Array::Ptr parent = new Array();
+	std::vector<Array::Ptr> children;
+
+	for (int i = 0; i < 1000; i++)
+		children.emplace_back(new Array());
+
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&parent, &children]() {
+			for (auto& child : children)
+				DependencyGraph::AddDependency(parent.get(), child.get());
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	for (auto& child : children) {
+		BOOST_CHECK_EQUAL(DependencyGraph::GetParents(child).size(), 1);
+
+		for (int t = 0; t < 4; t++)
+			DependencyGraph::RemoveDependency(parent.get(), child.get());
+
+		BOOST_CHECK(DependencyGraph::GetParents(child).empty());
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,8 @@
 
 #include "base/dictionary.hpp"
 #include "base/objectlock.hpp"
+#include "base/objectpool.hpp"
+#include "base/convert.hpp"
 #include "base/json.hpp"
 #include "base/string.hpp"
 #include "base/utility.hpp"
@@ -197,4 +199,95 @@ BOOST_AUTO_TEST_CASE(keys_ordered)
 	BOOST_CHECK(std::is_sorted(keys.begin(), keys.end()));
 }
 
+BOOST_AUTO_TEST_CASE(grow_shrink)
+{
+	Dictionary::Ptr dictionary = new Dictionary();
+
+	for (int i = 0; i < 40; i++) {
+		dictionary->Set("key" + Convert::ToString(39 - i), i);
+		BOOST_CHECK(dictionary->GetLength() == i + 1u);
+	}
+
+	for (int i = 0; i < 40; i++) {
+		BOOST_CHECK(dictionary->Get("key" + Convert::ToString(39 - i)) == i);
+	}
+
+	std::vector<String> keys = dictionary->GetKeys();
+	BOOST_CHECK(std::is_sorted(keys.begin(), keys.end()));
+
+	for (int i = 0; i < 40; i += 2) {
+		dictionary->Remove("key" + Convert::ToString(i));
+	}
+
+	BOOST_CHECK(dictionary->GetLength() == 20);
+	BOOST_CHECK(!dictionary->Contains("key0"));
+	BOOST_CHECK(dictionary->Contains("key1"));
+}
+
+BOOST_AUTO_TEST_CASE(duplicate_keys)
+{
+	Dictionary::Ptr dictionary = new Dictionary({ {"b", 1}, {"a", 2}, {"b", 3} });
+
+	BOOST_CHECK(dictionary->GetLength() == 2);
+	BOOST_CHECK(dictionary->Get("a") == 2);
+	BOOST_CHECK(dictionary->Get("b") == 1);
+
+	ObjectLock olock(dictionary);
+	auto it = dictionary->Begin();
+	BOOST_CHECK(it->first == "a");
+	++it;
+	BOOST_CHECK(it->first == "b");
+	dictionary->Remove(it);
+	BOOST_CHECK(dictionary->GetLength() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(pooled_allocation)
+{
+	void *first = nullptr;
+
+	{
+		Dictionary::Ptr dictionary = new Dictionary({ {"a", 1} });
+		first = dictionary.get();
+	}
+
+	auto hits = ObjectPool::GetHits();
+
+	Dictionary::Ptr dictionary = new Dictionary();
+
+	BOOST_CHECK(dictionary.get() == first);
+	BOOST_CHECK(ObjectPool::GetHits() == hits + 1);
+}
+
+BOOST_AUTO_TEST_CASE(freeze_snapshot)
+{
+	Dictionary::Ptr child = new Dictionary({ {"x", 1} });
+	Dictionary::Ptr dictionary = new Dictionary({ {"child", child}, {"y", 2} });
+
+	Dictionary::Ptr snapshot = dictionary->Snapshot();
+	BOOST_CHECK(snapshot != dictionary);
+	BOOST_CHECK(snapshot->IsFrozen());
+	BOOST_CHECK(!dictionary->IsFrozen());
+	BOOST_CHECK(snapshot->Snapshot() == snapshot);
+
+	dictionary->Set("y", 3);
+	BOOST_CHECK(snapshot->Get("y") == 2);
+	BOOST_CHECK_THROW(snapshot->Set("y", 3), std::invalid_argument);
+
+	/* iterating a frozen dictionary doesn't need the object lock */
+	size_t count = 0;
+	for (auto it = snapshot->Begin(); it != snapshot->End(); ++it)
+		count++;
+	BOOST_CHECK(count == 2);
+
+	/* clone() in the DSL still returns a deep copy which can be modified */
+	child->Freeze();
+	Dictionary::Ptr clone = dictionary->Clone();
+	BOOST_CHECK(!clone->IsFrozen());
+
+	Dictionary::Ptr clonedChild = clone->Get("child");
+	BOOST_CHECK(clonedChild != child);
+	BOOST_CHECK(!clonedChild->IsFrozen());
+	BOOST_CHECK(clonedChild->Get("x") == 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,68 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/histogram.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_histogram)
+
+BOOST_AUTO_TEST_CASE(empty)
+{
+	Histogram histogram;
+
+	BOOST_CHECK_EQUAL(histogram.GetCount(), 0u);
+	BOOST_CHECK_EQUAL(histogram.GetMax(), 0u);
+	BOOST_CHECK_EQUAL(histogram.GetMean(), 0);
+	BOOST_CHECK_EQUAL(histogram.GetPercentile(50), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(small)
+{
+	Histogram histogram;
+
+	for (Histogram::ValueType i = 0; i < 8; ++i) {
+		histogram.Record(i);
+	}
+
+	// Small values are counted exactly.
+	BOOST_CHECK_EQUAL(histogram.GetCount(), 8u);
+	BOOST_CHECK_EQUAL(histogram.GetMax(), 7u);
+	BOOST_CHECK_EQUAL(histogram.GetMean(), 3.5);
+	BOOST_CHECK_EQUAL(histogram.GetPercentile(0), 0u);
+	BOOST_CHECK_EQUAL(histogram.GetPercentile(50), 3u);
+	BOOST_CHECK_EQUAL(histogram.GetPercentile(100), 7u);
+}
+
+BOOST_AUTO_TEST_CASE(precision)
+{
+	Histogram histogram;
+
+	for (Histogram::ValueType i = 1; i <= 1000000; ++i) {
+		histogram.Record(i);
+	}
+
+	BOOST_CHECK_EQUAL(histogram.GetCount(), 1000000u);
+	BOOST_CHECK_EQUAL(histogram.GetMax(), 1000000u);
+
+	for (double percentile : {10.0, 50.0, 90.0, 99.0, 99.9}) {
+		auto exact (percentile * 10000);
+		auto value (histogram.GetPercentile(percentile));
+
+		BOOST_CHECK(value >= exact);
+		BOOST_CHECK(value <= exact * 1.125);
+	}
+
+	BOOST_CHECK_EQUAL(histogram.GetPercentile(100), 1000000u);
+}
+
+BOOST_AUTO_TEST_CASE(huge)
+{
+	Histogram histogram;
+
+	histogram.Record(-1);
+
+	BOOST_CHECK_EQUAL(histogram.GetPercentile(50), Histogram::ValueType(-1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,7 @@
 #include "base/objectlock.hpp"
 #include "base/json.hpp"
 #include <boost/algorithm/string/replace.hpp>
+#include <cmath>
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -51,6 +52,17 @@ BOOST_AUTO_TEST_CASE(encode)
 	BOOST_CHECK(JsonEncode(input, false) == output);
 }
 
+BOOST_AUTO_TEST_CASE(encode_strings_numbers)
+{
+	Array::Ptr input (new Array({
+		"\"\\/\b\f\n\r\t\x01\x7F", "0123456789abcdef\"0123456789abcdef\xF0\x9F\x98\x80\xC3",
+		0.0, -0.0, 0.1, -1.5e3, 1e22, -9007199254740993.0, 18446744073709551616.0, std::nan(""), INFINITY
+	}));
+
+	BOOST_CHECK(JsonEncode(input) == R"EOF(["\"\\/\b\f\n\r\t\u0001\u007f","0123456789abcdef\"0123456789abcdef\ud83d\ude00\ufffd",)EOF"
+		R"EOF(0,0,0.1,-1500,1e+22,-9007199254740992,1.8446744073709552e+19,null,null])EOF");
+}
+
 BOOST_AUTO_TEST_CASE(decode)
 {
 	String input (R"EOF({
@@ -100,11 +112,37 @@ BOOST_AUTO_TEST_CASE(decode)
 	BOOST_CHECK(uint.IsNumber() && uint.Get<double>() == 23.0);
 }
 
+BOOST_AUTO_TEST_CASE(decode_strings_numbers)
+{
+	auto strings ((Array::Ptr)JsonDecode(R"EOF(["\"\\\/\b\f\n\r\t", "\u00e4\ud83d\ude00", "0123456789abcdef\"0123456789abcdef"])EOF"));
+	BOOST_CHECK(strings->Get(0) == "\"\\/\b\f\n\r\t");
+	BOOST_CHECK(strings->Get(1) == "\xC3\xA4\xF0\x9F\x98\x80");
+	BOOST_CHECK(strings->Get(2) == "0123456789abcdef\"0123456789abcdef");
+
+	auto numbers ((Array::Ptr)JsonDecode("[0, -0, 0.1, -1.5e3, 1E-2, 9007199254740993, 123456789012345678901234]"));
+	BOOST_CHECK(numbers->Get(0) == 0.0);
+	BOOST_CHECK(numbers->Get(1) == 0.0 && !std::signbit(numbers->Get(1).Get<double>()));
+	BOOST_CHECK(numbers->Get(2) == 0.1);
+	BOOST_CHECK(numbers->Get(3) == -1500.0);
+	BOOST_CHECK(numbers->Get(4) == 0.01);
+	BOOST_CHECK(numbers->Get(5) == 9007199254740992.0);
+	BOOST_CHECK(numbers->Get(6) == 123456789012345678901234.0);
+
+	auto duplicates ((Dictionary::Ptr)JsonDecode(R"EOF({"a": 1, "b": 2, "a": 3})EOF"));
+	BOOST_CHECK(duplicates->GetLength() == 2u);
+	BOOST_CHECK(duplicates->Get("a") == 3);
+}
+
 BOOST_AUTO_TEST_CASE(invalid1)
 {
 	BOOST_CHECK_THROW(JsonDecode("\"1.7"), std::exception);
 	BOOST_CHECK_THROW(JsonDecode("{8: \"test\"}"), std::exception);
 	BOOST_CHECK_THROW(JsonDecode("{\"test\": \"test\""), std::exception);
+	BOOST_CHECK_THROW(JsonDecode("\"\\ud800\""), std::exception);
+	BOOST_CHECK_THROW(JsonDecode("\"LF\n\""), std::exception);
+	BOOST_CHECK_THROW(JsonDecode("[1,]"), std::exception);
+	BOOST_CHECK_THROW(JsonDecode("01"), std::exception);
+	BOOST_CHECK_THROW(JsonDecode("1e400"), std::exception);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
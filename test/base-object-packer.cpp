@@ -261,4 +261,62 @@ BOOST_AUTO_TEST_CASE(pack_object)
 	));
 }
 
+class StringSink : public PackObjectSink
+{
+public:
+	void Write(const char *data, size_t length) override
+	{
+		Pieces++;
+		Output.append(data, length);
+	}
+
+	std::string Output;
+	size_t Pieces = 0;
+};
+
+BOOST_AUTO_TEST_CASE(pack_sink)
+{
+	Dictionary::Ptr in = new Dictionary({
+		{"null", Empty},
+		{"true", true},
+		{"42.125", 42.125},
+		{"long", String(10000, 'x')},
+		{"[]", (Array::Ptr)new Array({ 1, "two", (Dictionary::Ptr)new Dictionary() })}
+	});
+
+	StringSink sink;
+	PackObject(in, sink);
+
+	BOOST_CHECK(String(sink.Output) == PackObject(in));
+	BOOST_CHECK(sink.Pieces > 1u);
+}
+
+BOOST_AUTO_TEST_CASE(unpack_roundtrip)
+{
+	Dictionary::Ptr in = new Dictionary({
+		{"null", Empty},
+		{"false", false},
+		{"true", true},
+		{"42.125", 42.125},
+		{"foobar", "foobar"},
+		{"[]", (Array::Ptr)new Array({ 1, "two", (Dictionary::Ptr)new Dictionary() })}
+	});
+
+	auto packed (PackObject(in));
+	Value out = UnpackObject(packed);
+
+	BOOST_CHECK(out.IsObjectType<Dictionary>());
+	BOOST_CHECK(PackObject(out) == packed);
+}
+
+BOOST_AUTO_TEST_CASE(unpack_invalid)
+{
+	auto packed (PackObject((Array::Ptr)new Array({ "foobar" })));
+
+	BOOST_CHECK_THROW(UnpackObject(packed.SubStr(0, packed.GetLength() - 1)), std::invalid_argument);
+	BOOST_CHECK_THROW(UnpackObject(packed + "x"), std::invalid_argument);
+	BOOST_CHECK_THROW(UnpackObject("\7"), std::invalid_argument);
+	BOOST_CHECK_THROW(UnpackObject(""), std::invalid_argument);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
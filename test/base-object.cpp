@@ -1,8 +1,12 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "base/object.hpp"
+#include "base/objectlock.hpp"
 #include "base/value.hpp"
 #include <BoostTestTargetConfig.h>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 using namespace icinga;
 
@@ -36,4 +40,32 @@ BOOST_AUTO_TEST_CASE(getself)
 	BOOST_CHECK(vobject.IsObjectType<TestObject>());
 }
 
+BOOST_AUTO_TEST_CASE(lock)
+{
+	TestObject::Ptr tobject = new TestObject();
+	int counter = 0;
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < 8; i++) {
+		threads.emplace_back([&tobject, &counter]() {
+			for (int j = 0; j < 10000; j++) {
+				ObjectLock outer (tobject);
+				ObjectLock inner (tobject);
+
+				counter++;
+
+				/* Long enough for the others to stop spinning and wait. */
+				if (j % 1000 == 0)
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	ObjectLock olock (tobject);
+	BOOST_CHECK_EQUAL(counter, 80000);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
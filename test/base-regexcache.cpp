@@ -0,0 +1,54 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/convert.hpp"
+#include "base/regexcache.hpp"
+#include "base/scriptutils.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_regexcache)
+
+BOOST_AUTO_TEST_CASE(get)
+{
+	RegexCache::Clear();
+
+	RegexCache::Ptr expr = RegexCache::Get("^db-.*-prod$");
+
+	BOOST_CHECK(expr == RegexCache::Get("^db-.*-prod$"));
+	BOOST_CHECK(expr != RegexCache::Get("^db-.*-prod$", boost::regex::icase));
+	BOOST_CHECK_EQUAL(RegexCache::GetSize(), 2);
+
+	BOOST_CHECK(boost::regex_search(std::string("db-01-prod"), *expr));
+	BOOST_CHECK(!boost::regex_search(std::string("DB-01-PROD"), *expr));
+	BOOST_CHECK(boost::regex_search(std::string("DB-01-PROD"), *RegexCache::Get("^db-.*-prod$", boost::regex::icase)));
+
+	BOOST_CHECK_THROW(RegexCache::Get("("), std::exception);
+	BOOST_CHECK_EQUAL(RegexCache::GetSize(), 2);
+
+	BOOST_CHECK(ScriptUtils::Regex({ "^db-.*-prod$", "db-01-prod" }));
+	BOOST_CHECK(!ScriptUtils::Regex({ "^db-.*-prod$", "web-01-prod" }));
+	BOOST_CHECK_EQUAL(RegexCache::GetSize(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(evict)
+{
+	RegexCache::Clear();
+
+	RegexCache::Ptr first = RegexCache::Get("^0$");
+	RegexCache::Ptr second = RegexCache::Get("^1$");
+
+	for (size_t i = 2; i < RegexCache::Capacity; i++)
+		RegexCache::Get("^" + Convert::ToString(i) + "$");
+
+	/* Mark the first one as recently used, so that the second one is dropped instead. */
+	BOOST_CHECK(first == RegexCache::Get("^0$"));
+
+	RegexCache::Get("^overflow$");
+	BOOST_CHECK_EQUAL(RegexCache::GetSize(), RegexCache::Capacity);
+
+	BOOST_CHECK(first == RegexCache::Get("^0$"));
+	BOOST_CHECK(second != RegexCache::Get("^1$"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
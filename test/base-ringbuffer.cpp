@@ -0,0 +1,39 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/ringbuffer.hpp"
+#include <BoostTestTargetConfig.h>
+#include <thread>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_ringbuffer)
+
+BOOST_AUTO_TEST_CASE(sharded)
+{
+	RingBuffer single (60);
+	ShardedRingBuffer sharded (60);
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < 8; i++) {
+		threads.emplace_back([&sharded]() {
+			for (int j = 0; j < 1000; j++)
+				sharded.InsertValue(100 + j / 100, 1);
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	for (int i = 0; i < 8; i++) {
+		for (int j = 0; j < 1000; j++)
+			single.InsertValue(100 + j / 100, 1);
+	}
+
+	BOOST_CHECK_EQUAL(sharded.GetLength(), 60);
+	BOOST_CHECK_EQUAL(sharded.UpdateAndGetValues(109, 60), 8000);
+	BOOST_CHECK_EQUAL(sharded.UpdateAndGetValues(110, 2), single.UpdateAndGetValues(110, 2));
+	BOOST_CHECK_EQUAL(sharded.CalculateRate(120, 60), single.CalculateRate(120, 60));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
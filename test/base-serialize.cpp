@@ -56,6 +56,26 @@ BOOST_AUTO_TEST_CASE(dictionary)
 	BOOST_CHECK(result->Get("k4") == "hello");
 }
 
+BOOST_AUTO_TEST_CASE(frozen)
+{
+	Array::Ptr array = new Array({ 1, "two" });
+	array->Freeze();
+
+	Dictionary::Ptr dict = new Dictionary({ { "array", array }, { "k1", 7 } });
+	dict->Freeze();
+
+	Dictionary::Ptr result = Deserialize(Serialize(dict));
+
+	BOOST_CHECK(!result->IsFrozen());
+	BOOST_CHECK(result->Get("k1") == 7);
+
+	Array::Ptr resultArray = result->Get("array");
+	BOOST_CHECK(resultArray != array);
+	BOOST_CHECK(!resultArray->IsFrozen());
+	BOOST_CHECK(resultArray->GetLength() == 2);
+	BOOST_CHECK(resultArray->Get(1) == "two");
+}
+
 BOOST_AUTO_TEST_CASE(object)
 {
 	PerfdataValue::Ptr pdv = new PerfdataValue("size", 100, true, "bytes");
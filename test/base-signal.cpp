@@ -0,0 +1,117 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/signal.hpp"
+#include "base/dictionary.hpp"
+#include <BoostTestTargetConfig.h>
+#include <set>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_signal)
+
+BOOST_AUTO_TEST_CASE(emit)
+{
+	Signal<void (int, std::set<int>)> signal;
+	int sum = 0;
+
+	BOOST_CHECK(signal.empty());
+
+	signal(1, {});
+
+	signal.connect([&sum](int value, std::set<int>) { sum += value; });
+	signal.connect([&sum](int value, std::set<int> values) { sum += value * values.size(); });
+
+	BOOST_CHECK(!signal.empty());
+	BOOST_CHECK(signal.num_slots() == 2);
+
+	signal(2, { 1, 2, 3 });
+
+	BOOST_CHECK(sum == 8);
+}
+
+BOOST_AUTO_TEST_CASE(disconnect)
+{
+	Signal<void (int)> signal;
+	int sum = 0;
+
+	SignalConnection first = signal.connect([&sum](int value) { sum += value; });
+	SignalConnection second = signal.connect([&sum](int value) { sum += value * 10; });
+
+	BOOST_CHECK(first.connected());
+
+	first.disconnect();
+
+	BOOST_CHECK(!first.connected());
+	BOOST_CHECK(signal.num_slots() == 1);
+
+	signal(1);
+
+	BOOST_CHECK(sum == 10);
+
+	signal.disconnect_all_slots();
+
+	BOOST_CHECK(!second.connected());
+	BOOST_CHECK(signal.empty());
+
+	signal(1);
+
+	BOOST_CHECK(sum == 10);
+
+	/* A default-constructed connection isn't connected to anything. */
+	SignalConnection none;
+	none.disconnect();
+
+	BOOST_CHECK(!none.connected());
+}
+
+BOOST_AUTO_TEST_CASE(connect_while_emitting)
+{
+	Signal<void ()> signal;
+	int calls = 0;
+
+	signal.connect([&signal, &calls]() {
+		calls++;
+		signal.connect([&calls]() { calls += 10; });
+	});
+
+	/* The slot connected by the first one is called from the next emission on. */
+	signal();
+
+	BOOST_CHECK(calls == 1);
+	BOOST_CHECK(signal.num_slots() == 2);
+
+	signal();
+
+	BOOST_CHECK(calls == 12);
+}
+
+BOOST_AUTO_TEST_CASE(profile)
+{
+	Signal<void (int)> signal ("base_signal::profile");
+	int sum = 0;
+
+	signal.connect("first", [&sum](int value) { sum += value; });
+	signal.connect("second", [&sum](int value) { sum += value * 10; });
+	signal.connect([&sum](int value) { sum += value * 100; });
+
+	signal(1);
+
+	SignalProfiler::SetEnabled(true);
+	signal(2);
+	signal(3);
+	SignalProfiler::SetEnabled(false);
+
+	BOOST_CHECK(sum == 666);
+
+	Dictionary::Ptr stats = SignalProfiler::GetStats()->Get("base_signal::profile");
+	BOOST_REQUIRE(stats);
+
+	for (const char *owner : { "first", "second", "other" }) {
+		Dictionary::Ptr ownerStats = stats->Get(owner);
+		BOOST_REQUIRE(ownerStats);
+		BOOST_CHECK(ownerStats->Get("calls") == 2);
+		BOOST_CHECK(ownerStats->Get("wall_time") >= 0);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
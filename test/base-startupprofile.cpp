@@ -0,0 +1,71 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/startupprofile.hpp"
+#include "base/objectlock.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static Dictionary::Ptr FindPhase(const Dictionary::Ptr& report, const String& name)
+{
+	Array::Ptr phases = report->Get("phases");
+	ObjectLock olock(phases);
+
+	for (const Dictionary::Ptr& phase : phases) {
+		if (phase->Get("name") == name)
+			return phase;
+	}
+
+	return nullptr;
+}
+
+BOOST_AUTO_TEST_SUITE(base_startupprofile)
+
+BOOST_AUTO_TEST_CASE(phases)
+{
+	StartupProfile::AddPhase("test.outer", 100, 110);
+	StartupProfile::AddPhase("test.inner", 101, 103, new Dictionary({ { "objects", 42 } }));
+
+	Dictionary::Ptr report = StartupProfile::GetReport();
+
+	Dictionary::Ptr outer = FindPhase(report, "test.outer");
+	Dictionary::Ptr inner = FindPhase(report, "test.inner");
+
+	BOOST_REQUIRE(outer);
+	BOOST_REQUIRE(inner);
+	BOOST_CHECK_EQUAL(outer->Get("duration"), 10);
+	BOOST_CHECK_EQUAL(inner->Get("duration"), 2);
+	BOOST_CHECK_EQUAL(inner->Get("objects"), 42);
+
+	/* Ordered by start, not by when they were added. */
+	Array::Ptr phases = report->Get("phases");
+	double previousStart = 0;
+
+	ObjectLock olock(phases);
+
+	for (const Dictionary::Ptr& phase : phases) {
+		BOOST_CHECK(phase->Get("start") >= previousStart);
+		previousStart = phase->Get("start");
+	}
+
+	BOOST_CHECK(report->Get("finished").IsEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(finish)
+{
+	{
+		StartupPhase phase ("test.scope");
+	}
+
+	StartupProfile::Finish();
+	StartupProfile::AddPhase("test.late", 100, 110);
+
+	Dictionary::Ptr report = StartupProfile::GetReport();
+
+	BOOST_CHECK(StartupProfile::IsFinished());
+	BOOST_CHECK(FindPhase(report, "test.scope"));
+	BOOST_CHECK(!FindPhase(report, "test.late"));
+	BOOST_CHECK(!report->Get("finished").IsEmpty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
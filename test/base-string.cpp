@@ -1,6 +1,7 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "base/string.hpp"
+#include "base/internedstring.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -101,4 +102,19 @@ BOOST_AUTO_TEST_CASE(find)
 	BOOST_CHECK(s.FindFirstOf("xl") == 2);
 }
 
+BOOST_AUTO_TEST_CASE(interned)
+{
+	InternedString a ("last_check_result");
+	InternedString b (String("last_") + "check_result");
+	InternedString c ("state");
+
+	BOOST_CHECK(a == b);
+	BOOST_CHECK(&a.GetString() == &b.GetString());
+	BOOST_CHECK(a != c);
+	BOOST_CHECK(a < c);
+	BOOST_CHECK(a.GetString() == "last_check_result");
+	BOOST_CHECK(InternedString() == InternedString(""));
+	BOOST_CHECK(InternedString::GetSymbolCount() >= 3);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
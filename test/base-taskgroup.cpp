@@ -0,0 +1,90 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/taskgroup.hpp"
+#include <BoostTestTargetConfig.h>
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_taskgroup)
+
+BOOST_AUTO_TEST_CASE(parallel_for)
+{
+	std::vector<int> items (10000);
+	std::iota(items.begin(), items.end(), 0);
+
+	std::atomic<long> sum (0);
+	TaskGroup group ("parallel_for");
+
+	group.ParallelFor(items, [&sum](int i) { sum += i; });
+	group.Join();
+
+	BOOST_CHECK_EQUAL(sum.load(), 9999L * 10000L / 2);
+	BOOST_CHECK(!group.HasExceptions());
+	BOOST_CHECK(group.GetTaskCount() > 0);
+}
+
+/* More nested groups waiting for each other than the thread pool has threads */
+BOOST_AUTO_TEST_CASE(nested)
+{
+	std::vector<int> outerItems (64), items (1000);
+	std::atomic<long> count (0);
+	TaskGroup outer ("nested");
+
+	outer.ParallelFor(outerItems, false, [&items, &count](int) {
+		TaskGroup inner ("nested:inner");
+
+		inner.ParallelFor(items, [&count](int) { count++; });
+		inner.Join();
+	});
+
+	outer.Join();
+
+	BOOST_CHECK_EQUAL(count.load(), 64L * 1000L);
+}
+
+BOOST_AUTO_TEST_CASE(exceptions)
+{
+	std::vector<int> items (100);
+	std::iota(items.begin(), items.end(), 0);
+
+	std::atomic<int> count (0);
+	TaskGroup group ("exceptions");
+
+	group.ParallelFor(items, [&count](int i) {
+		if (i % 10 == 0)
+			throw std::runtime_error("Test");
+
+		count++;
+	});
+
+	group.Join();
+
+	BOOST_CHECK_EQUAL(count.load(), 90);
+	BOOST_CHECK_EQUAL(group.GetExceptions().size(), 10);
+}
+
+BOOST_AUTO_TEST_CASE(cancel)
+{
+	std::atomic<int> count (0);
+	TaskGroup group ("cancel", 10);
+
+	for (int i = 0; i < 1000; i++)
+		group.Enqueue([&count]() { count++; });
+
+	group.Join();
+
+	BOOST_CHECK_EQUAL(count.load(), 1000);
+
+	group.Cancel();
+	group.Enqueue([&count]() { count++; });
+	group.Join();
+
+	BOOST_CHECK(group.IsCancelled());
+	BOOST_CHECK_EQUAL(count.load(), 1000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,52 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/threadpool.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <atomic>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_threadpool)
+
+BOOST_AUTO_TEST_CASE(post)
+{
+	std::atomic<int> calls (0);
+
+	ThreadPool tp;
+
+	for (int i = 0; i < 10000; i++) {
+		BOOST_CHECK(tp.Post([&calls]() { calls++; }, DefaultScheduler));
+	}
+
+	tp.Stop();
+
+	BOOST_CHECK(calls == 10000);
+	BOOST_CHECK(tp.GetPending() == 0);
+	BOOST_CHECK(!tp.Post([&calls]() { calls++; }, DefaultScheduler));
+}
+
+BOOST_AUTO_TEST_CASE(nested)
+{
+	std::atomic<int> calls (0);
+
+	ThreadPool tp;
+
+	for (int i = 0; i < 100; i++) {
+		tp.Post([&tp, &calls]() {
+			for (int j = 0; j < 100; j++) {
+				tp.Post([&calls]() { calls++; }, DefaultScheduler);
+			}
+		}, DefaultScheduler);
+	}
+
+	while (calls < 100 * 100) {
+		Utility::Sleep(0.01);
+	}
+
+	tp.Stop();
+
+	BOOST_CHECK(calls == 100 * 100);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,8 @@
 #include "base/utility.hpp"
 #include "base/application.hpp"
 #include <BoostTestTargetConfig.h>
+#include <atomic>
+#include <vector>
 
 using namespace icinga;
 
@@ -58,4 +60,42 @@ BOOST_AUTO_TEST_CASE(scope)
 	BOOST_CHECK(counter >= 4 && counter <= 6);
 }
 
+BOOST_AUTO_TEST_CASE(one_shot)
+{
+	std::atomic<int> calls (0);
+
+	Timer::Ptr timer = Timer::Create();
+	timer->OnTimerExpired.connect([&calls](const Timer * const&) { calls++; });
+	timer->Reschedule(Utility::GetTime() + 0.5);
+
+	timer->Start();
+	Utility::Sleep(0.2);
+	BOOST_CHECK(calls == 0);
+	Utility::Sleep(1);
+	timer->Stop(true);
+
+	BOOST_CHECK(calls == 1);
+}
+
+BOOST_AUTO_TEST_CASE(many)
+{
+	std::atomic<int> calls (0);
+	std::vector<Timer::Ptr> timers;
+
+	for (int i = 0; i < 1000; i++) {
+		Timer::Ptr timer = Timer::Create();
+		timer->OnTimerExpired.connect([&calls](const Timer * const&) { calls++; });
+		timer->SetInterval(i % 2 ? 1 : 3600);
+		timer->Start();
+		timers.emplace_back(std::move(timer));
+	}
+
+	Utility::Sleep(2.5);
+
+	for (auto& timer : timers)
+		timer->Stop(true);
+
+	BOOST_CHECK(calls >= 500 && calls <= 500 * 3);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
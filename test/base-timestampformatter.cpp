@@ -0,0 +1,36 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/timestampformatter.hpp"
+#include "base/utility.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_timestampformatter)
+
+BOOST_AUTO_TEST_CASE(strftime)
+{
+	TimestampFormatter formatter ("%Y-%m-%d %H:%M:%S %z");
+
+	for (double ts : { 0.0, 1500000000.5, 1500000000.75, 1500000001.0, 1500000000.0, 2000000000.25 })
+		BOOST_CHECK_EQUAL(formatter.Format(ts), Utility::FormatDateTime("%Y-%m-%d %H:%M:%S %z", ts));
+}
+
+BOOST_AUTO_TEST_CASE(fraction)
+{
+	TimestampFormatter millis ("%Y-%m-%dT%H:%M:%S.%f%z");
+	String prefix = Utility::FormatDateTime("%Y-%m-%dT%H:%M:%S", 1500000000);
+	String zone = Utility::FormatDateTime("%z", 1500000000);
+
+	BOOST_CHECK_EQUAL(millis.Format(1500000000.0625), prefix + ".062" + zone);
+	BOOST_CHECK_EQUAL(millis.Format(1500000000.125), prefix + ".125" + zone);
+	BOOST_CHECK_EQUAL(millis.Format(1500000000.0), prefix + ".000" + zone);
+
+	TimestampFormatter micros ("%S.%6f");
+	BOOST_CHECK_EQUAL(micros.Format(1500000000.25), "00.250000");
+
+	TimestampFormatter escaped ("%%f %1f");
+	BOOST_CHECK_EQUAL(escaped.Format(1500000000.75), "%f 7");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 #include "base/objectlock.hpp"
 #include "base/application.hpp"
 #include "base/type.hpp"
+#include "base/filelogger.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -44,4 +45,25 @@ BOOST_AUTO_TEST_CASE(instantiate)
 	BOOST_CHECK(p);
 }
 
+BOOST_AUTO_TEST_CASE(fieldid)
+{
+	Type::Ptr t = Type::GetByName("FileLogger");
+
+	BOOST_REQUIRE(t);
+
+	int count = t->GetFieldCount();
+
+	BOOST_CHECK(count > t->GetBaseType()->GetFieldCount());
+
+	for (int i = 0; i < count; i++)
+		BOOST_CHECK_EQUAL(t->GetFieldId(t->GetFieldInfo(i).Name), i);
+
+	BOOST_CHECK(String(t->GetFieldInfo(t->GetFieldId("path")).Name) == "path");
+	BOOST_CHECK_EQUAL(t->GetFieldId("__name"), Type::GetByName("ConfigObject")->GetFieldId("__name"));
+	BOOST_CHECK_EQUAL(t->GetFieldId("nonexistent"), -1);
+
+	BOOST_CHECK_THROW(t->GetFieldInfo(count), std::runtime_error);
+	BOOST_CHECK_THROW(t->GetFieldInfo(-1), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,7 +1,9 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
 #include "base/value.hpp"
+#include "base/array.hpp"
 #include <BoostTestTargetConfig.h>
+#include <typeinfo>
 
 using namespace icinga;
 
@@ -50,4 +52,44 @@ BOOST_AUTO_TEST_CASE(format)
 	BOOST_CHECK_MESSAGE(v == "3", "v should be '3' (is '" << v << "')");
 }
 
+BOOST_AUTO_TEST_CASE(copy_move)
+{
+	/* The payload and the type, i.e. 16 bytes on 64-bit platforms. */
+	struct ValueLayout
+	{
+		union {
+			double Number;
+			void *Pointer;
+		};
+
+		ValueType Type;
+	};
+
+	BOOST_CHECK(sizeof(Value) == sizeof(ValueLayout));
+
+	Value s = "a string which doesn't fit into std::string's inline buffer";
+	Value copy = s;
+
+	BOOST_CHECK(&copy.Get<String>() == &s.Get<String>());
+
+	copy = 42;
+	BOOST_CHECK(copy.Get<double>() == 42);
+	BOOST_CHECK(s == "a string which doesn't fit into std::string's inline buffer");
+	BOOST_CHECK_THROW(s.Get<double>(), std::bad_cast);
+
+	Array::Ptr array = new Array({ 1, s });
+	Value a = array;
+	Value moved = std::move(a);
+
+	BOOST_CHECK(a.GetType() == ValueEmpty);
+	BOOST_CHECK(moved.Get<Object::Ptr>() == array);
+
+	moved.Swap(s);
+	BOOST_CHECK(moved.IsString());
+	BOOST_CHECK(s.IsObjectType<Array>());
+
+	s = s;
+	BOOST_CHECK(s.IsObjectType<Array>());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,59 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "base/workqueue.hpp"
+#include <BoostTestTargetConfig.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_workqueue)
+
+BOOST_AUTO_TEST_CASE(order)
+{
+	WorkQueue wq (0, 1);
+	wq.SetName("Test");
+
+	std::vector<int> results;
+
+	for (int i = 0; i < 1000; i++) {
+		wq.Enqueue([&results, i]() { results.push_back(i); });
+	}
+
+	wq.Join();
+
+	BOOST_REQUIRE(results.size() == 1000);
+
+	for (int i = 0; i < 1000; i++) {
+		BOOST_CHECK(results[i] == i);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(producers)
+{
+	WorkQueue wq (100, 1);
+	wq.SetName("Test");
+
+	std::atomic<int> calls (0);
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < 4; i++) {
+		threads.emplace_back([&wq, &calls, i]() {
+			for (int j = 0; j < 10000; j++) {
+				wq.Enqueue([&calls]() { calls++; }, j % 2 ? PriorityHigh : PriorityLow);
+			}
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	wq.Join();
+
+	BOOST_CHECK(calls == 4 * 10000);
+	BOOST_CHECK(wq.GetLength() == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
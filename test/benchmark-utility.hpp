@@ -0,0 +1,33 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#ifndef BENCHMARK_UTILITY_H
+#define BENCHMARK_UTILITY_H
+
+#include "base/convert.hpp"
+#include <cstddef>
+#include <cstdlib>
+
+namespace icinga
+{
+
+/**
+ * Returns the size of a benchmark from the environment variable name, or defaultValue if it isn't set to a positive number.
+ *
+ * The defaults are kept small so that the benchmarks also run as quick smoke tests with the other tests,
+ * use the environment for real measurements (see "Benchmarks" in the development docs).
+ */
+inline size_t GetEnvCount(const char *name, size_t defaultValue)
+{
+	if (const char *env = getenv(name)) {
+		long count = Convert::ToLong(env);
+
+		if (count > 0)
+			return count;
+	}
+
+	return defaultValue;
+}
+
+}
+
+#endif /* BENCHMARK_UTILITY_H */
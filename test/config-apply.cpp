@@ -2,7 +2,9 @@
 
 #include "config/applyrule.hpp"
 #include "config/configcompiler.hpp"
+#include "config/objectrule.hpp"
 #include <BoostTestTargetConfig.h>
+#include <set>
 
 using namespace icinga;
 
@@ -77,6 +79,23 @@ static void GetTargetServicesHelper(
 	}
 }
 
+static std::set<String> GetIndexedRulesHelper(const String& host, const Array::Ptr& groups, const Dictionary::Ptr& vars)
+{
+	std::set<String> names;
+
+	for (auto& rule : ApplyRule::GetIndexedRules(Type::GetByName("Service"), Type::GetByName("Host"), host, groups, vars)) {
+		names.emplace(rule->GetName());
+	}
+
+	return names;
+}
+
+static void AddServiceRulesHelper(const String& config)
+{
+	ScriptFrame frame(true);
+	ConfigCompiler::CompileText("<test>", config)->Evaluate(frame);
+}
+
 BOOST_AUTO_TEST_SUITE(config_apply)
 
 BOOST_AUTO_TEST_CASE(gettargethosts_literal)
@@ -248,4 +267,56 @@ BOOST_AUTO_TEST_CASE(gettargetservices_noindexer_service)
 	GetTargetServicesHelper("host.name == \"foo\" && name == \"bar\"", nullptr, false);
 }
 
+BOOST_AUTO_TEST_CASE(getindexedrules)
+{
+	AddServiceRulesHelper(
+		"apply Service \"group\" { assign where \"linux\" in host.groups }\n"
+		"apply Service \"var\" { assign where host.vars.os == \"Linux\" && host.vars.cores > 1 }\n"
+		"apply Service \"prefix\" { assign where match(\"DB*\", host.name) || host.name == \"web1\" }\n"
+	);
+
+	BOOST_CHECK((GetIndexedRulesHelper("db2", new Array({ "linux" }), nullptr) == std::set<String>{ "group", "prefix" }));
+	BOOST_CHECK((GetIndexedRulesHelper("web1", nullptr, new Dictionary({ { "os", "Linux" } })) == std::set<String>{ "var", "prefix" }));
+	BOOST_CHECK(GetIndexedRulesHelper("web2", new Array({ "windows" }), new Dictionary({ { "os", "Windows" } })).empty());
+}
+
+BOOST_AUTO_TEST_CASE(getindexedrules_notindexable)
+{
+	AddServiceRulesHelper(
+		"apply Service \"negated\" { assign where !(\"linux\" in host.groups) }\n"
+		"apply Service \"empty\" { assign where host.vars.os == \"\" }\n"
+		"apply Service \"suffix\" { assign where match(\"*db\", host.name) }\n"
+		"apply Service \"partial\" { assign where \"linux\" in host.groups || host.vars.cores > 1 }\n"
+		"apply Service \"shadowed\" for (host in [ 1 ]) { assign where \"linux\" in host.groups }\n"
+	);
+
+	BOOST_CHECK(GetIndexedRulesHelper("db", new Array({ "linux" }), new Dictionary({ { "os", "" } })).empty());
+	BOOST_CHECK_EQUAL(ApplyRule::GetRules(Type::GetByName("Service"), Type::GetByName("Host")).size(), 5u);
+}
+
+BOOST_AUTO_TEST_CASE(evaluategrouprules)
+{
+	AddServiceRulesHelper(
+		"object HostGroup \"linux\" { assign where host.vars.os == \"Linux\" }\n"
+		"object HostGroup \"web\" { assign where match(\"web*\", host.name) }\n"
+		"object HostGroup \"cores\" { assign where host.vars.cores > 1 }\n"
+	);
+
+	auto evaluated ([](const String& host, const Dictionary::Ptr& vars) {
+		std::set<String> names;
+
+		ObjectRule::EvaluateGroupRules(Type::GetByName("HostGroup"), host, new Array(), vars, false,
+			[&names](const ConfigItem::Ptr& group) {
+				names.emplace(group->GetName());
+				return false;
+			});
+
+		return names;
+	});
+
+	BOOST_CHECK((evaluated("web1", nullptr) == std::set<String>{ "web", "cores" }));
+	BOOST_CHECK((evaluated("db1", new Dictionary({ { "os", "Linux" } })) == std::set<String>{ "linux", "cores" }));
+	BOOST_CHECK((evaluated("db1", nullptr) == std::set<String>{ "cores" }));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
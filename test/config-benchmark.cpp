@@ -0,0 +1,211 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "config/configcompiler.hpp"
+#include "config/configitem.hpp"
+#include "icinga/host.hpp"
+#include "icinga/service.hpp"
+#include "base/configtype.hpp"
+#include "base/configuration.hpp"
+#include "base/convert.hpp"
+#include "base/json.hpp"
+#include "base/startupprofile.hpp"
+#include "base/utility.hpp"
+#include "base/taskgroup.hpp"
+#include "benchmark-utility.hpp"
+#include "icingaapplication-fixture.hpp"
+#include <BoostTestTargetConfig.h>
+#include <boost/filesystem.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace icinga;
+
+/**
+ * Generates hosts importing a chain of templates and apply rules with the different predicate shapes
+ * ApplyRule::GetTargetHosts()/GetTargetServices() can or can't resolve without evaluating them for every host.
+ */
+static String GenerateConfig(size_t hosts, size_t rules, size_t depth)
+{
+	std::ostringstream config;
+
+	config << "object CheckCommand \"bench\" {\n"
+		<< "  command = [ \"/bin/true\" ]\n"
+		<< "}\n\n";
+
+	for (size_t i = 0; i < 10; i++)
+		config << "object HostGroup \"bench-group-" << i << "\" { }\n";
+
+	/* bench-template-0 imports bench-template-1 and so on. */
+	for (size_t i = depth; i-- > 0;) {
+		config << "\ntemplate Host \"bench-template-" << i << "\" {\n";
+
+		if (i + 1 < depth)
+			config << "  import \"bench-template-" << i + 1 << "\"\n";
+
+		config << "  vars.level" << i << " = " << i << "\n"
+			<< "  check_command = \"bench\"\n"
+			<< "}\n";
+	}
+
+	for (size_t i = 0; i < hosts; i++) {
+		config << "\nobject Host \"bench-" << i << "\" {\n";
+
+		if (depth)
+			config << "  import \"bench-template-0\"\n";
+		else
+			config << "  check_command = \"bench\"\n";
+
+		config << "  address = \"10.0." << i / 256 % 256 << "." << i % 256 << "\"\n"
+			<< "  groups = [ \"bench-group-" << i % 10 << "\" ]\n"
+			<< "  vars.os = \"" << (i % 3 ? "Linux" : "Windows") << "\"\n"
+			<< "  vars.disks = { \"/\" = { warn = \"20%\" }, \"/var\" = { warn = \"10%\" } }\n"
+			<< "}\n";
+	}
+
+	for (size_t i = 0; i < rules; i++) {
+		config << "\napply Service \"bench-" << i << "\" ";
+
+		switch (i % 6) {
+			case 0: /* looked up by name */
+				config << "{\n  assign where host.name == \"bench-" << i % std::max<size_t>(hosts, 1) << "\"\n";
+				break;
+			case 1:
+				config << "{\n  assign where \"bench-group-" << i % 10 << "\" in host.groups\n";
+				break;
+			case 2:
+				config << "{\n  assign where host.vars.os == \"Linux\"\n";
+				break;
+			case 3:
+				config << "{\n  assign where match(\"bench-" << i % 10 << "*\", host.name)\n";
+				break;
+			case 4:
+				config << "for (disk => cfg in host.vars.disks) {\n  vars += cfg\n  assign where host.vars.disks\n";
+				break;
+			default:
+				config << "{\n  assign where host.vars.os == \"Linux\" && \"bench-group-" << i % 10 << "\" in host.groups\n"
+					<< "  ignore where host.address == \"10.0.0.1\"\n";
+				break;
+		}
+
+		config << "  check_command = \"bench\"\n"
+			<< "}\n";
+	}
+
+	return config.str();
+}
+
+BOOST_AUTO_TEST_SUITE(config_benchmark)
+
+/**
+ * Times the startup phases for a generated config of ICINGA2_CONFIG_BENCHMARK_HOSTS (default: 200) hosts,
+ * ICINGA2_CONFIG_BENCHMARK_RULES (default: 12) apply rules and ICINGA2_CONFIG_BENCHMARK_TEMPLATE_DEPTH
+ * (default: 5) templates. The generated config is written to ICINGA2_CONFIG_BENCHMARK_OUTPUT if set, the results
+ * are printed as JSON or written to ICINGA2_CONFIG_BENCHMARK_RESULTS.
+ */
+BOOST_AUTO_TEST_CASE(generated)
+{
+	size_t hosts = GetEnvCount("ICINGA2_CONFIG_BENCHMARK_HOSTS", 200);
+	size_t rules = GetEnvCount("ICINGA2_CONFIG_BENCHMARK_RULES", 12);
+	size_t depth = GetEnvCount("ICINGA2_CONFIG_BENCHMARK_TEMPLATE_DEPTH", 5);
+
+	String config = GenerateConfig(hosts, rules, depth);
+
+	if (const char *output = getenv("ICINGA2_CONFIG_BENCHMARK_OUTPUT")) {
+		std::ofstream fp (output);
+		fp << config;
+	}
+
+	StartupProfile::Start();
+
+	double start = Utility::GetTime();
+	double compiled, evaluated, committed;
+	std::vector<ConfigItem::Ptr> newItems;
+	bool result;
+
+	{
+		ActivationScope ascope;
+
+		std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<config_benchmark>", config);
+		compiled = Utility::GetTime();
+
+		expr->Evaluate(*ScriptFrame::GetCurrentFrame());
+		evaluated = Utility::GetTime();
+
+		TaskGroup upq ("ConfigBenchmark");
+
+		result = ConfigItem::CommitItems(ascope.GetContext(), upq, newItems);
+		committed = Utility::GetTime();
+	}
+
+	BOOST_REQUIRE(result);
+
+	BOOST_REQUIRE(ConfigItem::ActivateItems(newItems));
+	double activated = Utility::GetTime();
+
+	String statePath = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("icinga2-state-%%%%-%%%%")).string();
+
+	ConfigObject::DumpObjects(statePath);
+	double dumped = Utility::GetTime();
+
+	ConfigObject::RestoreObjects(statePath);
+	double restored = Utility::GetTime();
+
+	boost::system::error_code ec;
+	boost::filesystem::remove(statePath.GetData(), ec);
+
+	StartupProfile::Finish();
+
+	Dictionary::Ptr profile = StartupProfile::GetReport();
+	double apply = 0;
+
+	{
+		Array::Ptr phases = profile->Get("phases");
+		ObjectLock olock (phases);
+
+		for (const Dictionary::Ptr& phase : phases) {
+			if (static_cast<String>(phase->Get("name")).Find("config.apply.") == 0)
+				apply += static_cast<double>(phase->Get("duration"));
+		}
+	}
+
+	size_t services = ConfigType::GetObjectsByType<Service>().size();
+
+	Dictionary::Ptr results = new Dictionary({
+		{ "parameters", new Dictionary({
+			{ "hosts", hosts },
+			{ "apply_rules", rules },
+			{ "template_depth", depth },
+			{ "concurrency", Configuration::Concurrency }
+		}) },
+		{ "objects", new Dictionary({
+			{ "items", newItems.size() },
+			{ "hosts", ConfigType::GetObjectsByType<Host>().size() },
+			{ "services", services }
+		}) },
+		{ "phases", new Dictionary({
+			{ "compile", compiled - start },
+			{ "evaluate", evaluated - compiled },
+			/* Including the apply rules */
+			{ "commit", committed - evaluated },
+			{ "apply", apply },
+			{ "activate", activated - committed },
+			{ "state_dump", dumped - activated },
+			{ "state_restore", restored - dumped }
+		}) },
+		{ "profile", profile }
+	});
+
+	if (const char *path = getenv("ICINGA2_CONFIG_BENCHMARK_RESULTS")) {
+		std::ofstream fp (path);
+		fp << JsonEncode(results, true);
+	} else {
+		std::cout << JsonEncode(results) << "\n";
+	}
+
+	BOOST_CHECK(ConfigType::GetObjectsByType<Host>().size() >= hosts);
+	BOOST_CHECK(rules == 0 || services > 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,243 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "config/configitem.hpp"
+#include "config/configcompiler.hpp"
+#include "config/expression.hpp"
+#include "base/configuration.hpp"
+#include "base/convert.hpp"
+#include "base/scriptframe.hpp"
+#include "icinga/host.hpp"
+#include "icinga/service.hpp"
+#include "icinga/timeperiod.hpp"
+#include "remote/zone.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static Zone::Ptr CreateZone(const String& name, const String& parent = String())
+{
+	Zone::Ptr zone = new Zone();
+	zone->SetName(name);
+	zone->SetParentRaw(parent);
+	return zone;
+}
+
+static std::vector<String> GetNames(const std::vector<ConfigObject::Ptr>& objects)
+{
+	std::vector<String> names;
+
+	for (const ConfigObject::Ptr& object : objects)
+		names.push_back(object->GetName());
+
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+BOOST_AUTO_TEST_SUITE(config_configitem)
+
+BOOST_AUTO_TEST_CASE(activationlevels)
+{
+	std::vector<ConfigObject::Ptr> zones {
+		CreateZone("agent1", "satellite"),
+		CreateZone("satellite", "master"),
+		CreateZone("master"),
+		CreateZone("agent2", "satellite"),
+		CreateZone("global"),
+		CreateZone("unknown-parent", "missing")
+	};
+
+	auto levels (ConfigItem::GetActivationLevels(Zone::TypeInstance, zones));
+
+	BOOST_REQUIRE_EQUAL(levels.size(), 3u);
+	BOOST_CHECK(GetNames(levels[0]) == std::vector<String>({ "global", "master", "unknown-parent" }));
+	BOOST_CHECK(GetNames(levels[1]) == std::vector<String>({ "satellite" }));
+	BOOST_CHECK(GetNames(levels[2]) == std::vector<String>({ "agent1", "agent2" }));
+}
+
+BOOST_AUTO_TEST_CASE(activationlevels_cycle)
+{
+	std::vector<ConfigObject::Ptr> periods;
+
+	for (auto& names : std::vector<std::pair<String, Array::Ptr>>{
+		{ "a", new Array({ "b" }) },
+		{ "b", new Array({ "a" }) },
+		{ "c", new Array({ "a" }) },
+		{ "d", new Array() }
+	}) {
+		TimePeriod::Ptr tp = new TimePeriod();
+		tp->SetName(names.first);
+		tp->SetExcludes(names.second);
+		periods.push_back(tp);
+	}
+
+	auto levels (ConfigItem::GetActivationLevels(TimePeriod::TypeInstance, periods));
+
+	BOOST_REQUIRE_EQUAL(levels.size(), 4u);
+	BOOST_CHECK(GetNames(levels[0]) == std::vector<String>({ "d" }));
+
+	for (size_t i = 1; i < levels.size(); i++)
+		BOOST_CHECK_EQUAL(levels[i].size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(activationlevels_noreferences)
+{
+	std::vector<ConfigObject::Ptr> zones { CreateZone("a"), CreateZone("b") };
+	std::vector<ConfigObject::Ptr> periods;
+
+	for (const String& name : { "a", "b", "c" }) {
+		TimePeriod::Ptr tp = new TimePeriod();
+		tp->SetName(name);
+		periods.push_back(tp);
+	}
+
+	auto levels (ConfigItem::GetActivationLevels(TimePeriod::TypeInstance, periods));
+
+	BOOST_REQUIRE_EQUAL(levels.size(), 1u);
+	BOOST_CHECK_EQUAL(levels[0].size(), 3u);
+
+	levels = ConfigItem::GetActivationLevels(Zone::TypeInstance, zones);
+
+	BOOST_REQUIRE_EQUAL(levels.size(), 1u);
+	BOOST_CHECK_EQUAL(levels[0].size(), 2u);
+}
+
+static std::vector<String> ValidateScratch(const String& config)
+{
+	ActivationContext::Ptr context = new ActivationContext("scratch-package");
+	std::vector<String> errors;
+
+	{
+		ActivationScope scope(context);
+		std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<scratch>", config, "", "scratch-package");
+		ScriptFrame frame(true);
+		expr->Evaluate(frame);
+	}
+
+	TaskGroup upq ("ValidateScratchItems");
+	ConfigItem::ValidateScratchItems(context, upq, errors);
+
+	return errors;
+}
+
+BOOST_AUTO_TEST_CASE(scratchitems)
+{
+	BOOST_CHECK(ValidateScratch(R"CONFIG(
+template Zone "scratch-template" { global = true }
+object Zone "scratch-parent" { import "scratch-template" }
+object Zone "scratch-child" { parent = "scratch-parent" }
+)CONFIG").empty());
+
+	BOOST_CHECK(!ConfigItem::GetByTypeAndName(Zone::TypeInstance, "scratch-parent"));
+	BOOST_CHECK(!ConfigItem::GetByTypeAndName(Zone::TypeInstance, "scratch-template"));
+
+	BOOST_CHECK_EQUAL(ValidateScratch(R"CONFIG(
+object Zone "scratch-orphan" { parent = "scratch-missing" }
+)CONFIG").size(), 1u);
+
+	/* The items are evaluated in the running process, exit() would terminate it. */
+	BOOST_CHECK_EQUAL(ValidateScratch(R"CONFIG(
+object Zone "scratch-exit" { global = exit(1) }
+)CONFIG").size(), 1u);
+}
+
+static bool IsPlainDefinition(const String& config)
+{
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<definition>", config);
+	auto *statements (dynamic_cast<DictExpression *>(expr.get()));
+
+	BOOST_REQUIRE(statements && statements->GetExpressions().size() == 1u);
+
+	auto *object (dynamic_cast<ObjectExpression *>(statements->GetExpressions()[0].get()));
+
+	return object && object->IsPlainDefinition();
+}
+
+BOOST_AUTO_TEST_CASE(plain_definitions)
+{
+	BOOST_CHECK(IsPlainDefinition("object Zone \"plain\" { global = true }"));
+	BOOST_CHECK(IsPlainDefinition("template Zone \"plain-template\" { }"));
+	BOOST_CHECK(!IsPlainDefinition("object Zone \"computed-\" + len(\"name\") { }"));
+	BOOST_CHECK(!IsPlainDefinition("const PlainConstant = 1"));
+	BOOST_CHECK(!IsPlainDefinition("globals.plain = 1"));
+}
+
+static bool CommitAndActivate(const String& config)
+{
+	std::vector<ConfigItem::Ptr> newItems;
+
+	{
+		ActivationScope scope;
+		std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<release>", config);
+		ScriptFrame frame(true);
+		expr->Evaluate(frame);
+
+		TaskGroup upq ("CommitItems");
+
+		if (!ConfigItem::CommitItems(scope.GetContext(), upq, newItems, true))
+			return false;
+	}
+
+	return ConfigItem::ActivateItems(newItems);
+}
+
+BOOST_AUTO_TEST_CASE(release_config)
+{
+	Configuration::ReleaseObjectConfig = true;
+
+	BOOST_CHECK(CommitAndActivate(R"CONFIG(
+template Zone "release-template" { global = true }
+object Zone "release-object" { import "release-template" }
+)CONFIG"));
+
+	BOOST_CHECK(ConfigItem::GetByTypeAndName(Zone::TypeInstance, "release-template")->GetExpression());
+	BOOST_CHECK(!ConfigItem::GetByTypeAndName(Zone::TypeInstance, "release-object")->GetExpression());
+	BOOST_CHECK(Zone::GetByName("release-object")->GetGlobal());
+
+	/* Templates can still be imported, released objects can't. */
+	BOOST_CHECK(CommitAndActivate(R"CONFIG(
+object Zone "release-later" { import "release-template" }
+)CONFIG"));
+	BOOST_CHECK(!CommitAndActivate(R"CONFIG(
+object Zone "release-importer" { import "release-object" }
+)CONFIG"));
+
+	Configuration::ReleaseObjectConfig = false;
+}
+
+BOOST_AUTO_TEST_CASE(deferred_registration)
+{
+	BOOST_CHECK(CommitAndActivate(R"CONFIG(
+object CheckCommand "deferred-command" { command = [ "true" ] }
+
+for (i in range(8)) {
+  object Host "deferred-" + i { check_command = "deferred-command" }
+}
+
+apply Service "deferred-" for (i in range(3)) {
+  check_command = "deferred-command"
+  assign where match("deferred-*", host.name)
+}
+)CONFIG"));
+
+	for (int i = 0; i < 8; i++) {
+		for (int j = 0; j < 3; j++)
+			BOOST_CHECK(Service::GetByNamePair("deferred-" + Convert::ToString(i), "deferred-" + Convert::ToString(j)));
+	}
+
+	/* Duplicates created by apply rules are still detected. */
+	BOOST_CHECK(!CommitAndActivate(R"CONFIG(
+object Host "deferred-duplicate" { check_command = "deferred-command" }
+
+apply Service "deferred-again" {
+  check_command = "deferred-command"
+  assign where host.name == "deferred-duplicate"
+}
+
+apply Service "deferred-again" {
+  check_command = "deferred-command"
+  assign where host.name == "deferred-duplicate"
+}
+)CONFIG"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,7 +1,13 @@
 /* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
 
+#include "config/bytecode.hpp"
 #include "config/configcompiler.hpp"
+#include "config/expressioncache.hpp"
+#include "base/configuration.hpp"
 #include "base/exception.hpp"
+#include "base/json.hpp"
+#include <boost/filesystem.hpp>
+#include <fstream>
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -243,4 +249,153 @@ BOOST_AUTO_TEST_CASE(advanced)
 	BOOST_CHECK(func->Invoke() == 3);
 }
 
+BOOST_AUTO_TEST_CASE(cache_roundtrip)
+{
+	ScriptFrame frame(true);
+
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>",
+		"var sum = 0\n"
+		"for (k => v in { a = 1, b = 2 }) { sum += v }\n"
+		"var add = function(x, y) { return x + y }\n"
+		"var s = \"\"\n"
+		"try { throw \"x\" } except { s = \"caught\" }\n"
+		"[ sum, add(3, 4), s, \"db1\" in [ \"db1\" ], !false && 7 % 4 == 3, { x = [ 1 ] }.x[0] ]");
+
+	std::unique_ptr<Expression> cached = ExpressionCache::Deserialize(ExpressionCache::Serialize(expr.get()));
+
+	Array::Ptr expected = expr->Evaluate(frame).GetValue();
+	Array::Ptr actual = cached->Evaluate(frame).GetValue();
+
+	BOOST_CHECK(expected->GetLength() == 6);
+	BOOST_CHECK(actual->GetLength() == expected->GetLength());
+
+	for (decltype(expected->GetLength()) i = 0; i < expected->GetLength(); i++)
+		BOOST_CHECK(actual->Get(i) == expected->Get(i));
+
+	expr = ConfigCompiler::CompileText("<test>", "\n\"x\" - 1");
+	cached = ExpressionCache::Deserialize(ExpressionCache::Serialize(expr.get()));
+
+	try {
+		cached->Evaluate(frame);
+		BOOST_CHECK(false);
+	} catch (const ScriptError& ex) {
+		BOOST_CHECK(ex.GetDebugInfo().Path == "<test>");
+		BOOST_CHECK(ex.GetDebugInfo().FirstLine == 2);
+	}
+
+	BOOST_CHECK_THROW(ExpressionCache::Deserialize(String("\x7f")), std::invalid_argument);
+	BOOST_CHECK_THROW(ExpressionCache::Deserialize(ExpressionCache::Serialize(expr.get()).SubStr(1)), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(cache_eviction)
+{
+	namespace fs = boost::filesystem;
+
+	String dir = (fs::temp_directory_path() / fs::unique_path("icinga2-configcache-%%%%-%%%%")).string();
+	String oldCacheDir = Configuration::CacheDir;
+
+	Configuration::CacheDir = dir;
+	fs::create_directories(ExpressionCache::GetCacheDir().GetData());
+
+	String configFile = dir + "/test.conf";
+	String staleEntry = ExpressionCache::GetCacheDir() + "/stale.cache";
+
+	std::ofstream(configFile.CStr()) << "var x = 1\n";
+	std::ofstream(staleEntry.CStr()) << "stale";
+
+	ConfigCompiler::CompileFile(configFile);
+
+	BOOST_CHECK(ExpressionCache::RemoveUnusedEntries() == 1);
+	BOOST_CHECK(!fs::exists(staleEntry.GetData()));
+
+	/* The entry of the compiled file is kept. */
+	size_t entries = 0;
+
+	for (fs::directory_iterator it (ExpressionCache::GetCacheDir().GetData()), end; it != end; ++it)
+		entries++;
+
+	BOOST_CHECK(entries == 1);
+	BOOST_CHECK(ExpressionCache::RemoveUnusedEntries() == 0);
+
+	Configuration::CacheDir = oldCacheDir;
+	fs::remove_all(dir.GetData());
+}
+
+BOOST_AUTO_TEST_CASE(bytecode)
+{
+	ScriptFrame frame(true);
+
+	frame.Locals->Set("host", new Dictionary({
+		{ "name", "web1" },
+		{ "groups", new Array({ "db", "web" }) },
+		{ "vars", new Dictionary({ { "os", "Linux" }, { "x", 3 } }) }
+	}));
+
+	std::vector<String> sources {
+		"host.vars.os == \"Linux\" && \"db\" in host.groups",
+		"host.name.contains(\"web\") || match(\"h*\", host.name)",
+		"host.vars.x > 3 ? host.vars.x - 1 : 2 * host.vars.x",
+		"[ host.name, len(host.groups), host.vars.x in [ 1, 2, 3 ], host.vars.missing !in host.groups ]",
+		"String(host.vars.x) + \"s\"",
+		"var y = 2\ny + host.vars.x",
+		"var f = function(v) { return v * host.vars.x }\nf(2) + f(host.vars.x)",
+		"host.vars.os in null || !host.vars.x"
+	};
+
+	for (const String& source : sources) {
+		std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>", source);
+		std::unique_ptr<Expression> compiled = BytecodeExpression::Compile(ConfigCompiler::CompileText("<test>", source));
+
+		BOOST_CHECK(dynamic_cast<BytecodeExpression *>(compiled.get()));
+		BOOST_CHECK_EQUAL(JsonEncode(compiled->Evaluate(frame).GetValue()), JsonEncode(expr->Evaluate(frame).GetValue()));
+	}
+
+	/* Constant expressions are folded completely. */
+	std::unique_ptr<Expression> compiled = BytecodeExpression::Compile(ConfigCompiler::CompileText("<test>", "(1 + 2) * 3 == 9 && \"a\" in [ \"a\", \"b\" ]"));
+	auto program (dynamic_cast<BytecodeExpression *>(compiled.get()));
+
+	BOOST_REQUIRE(program);
+	BOOST_CHECK(program->GetInstructionCount() == 0);
+	BOOST_CHECK(compiled->Evaluate(frame).GetValue() == true);
+
+	/* Errors still carry the debug info of the failing node. */
+	compiled = BytecodeExpression::Compile(ConfigCompiler::CompileText("<test>", "host.name\n&& host.vars.x in \"abc\""));
+
+	try {
+		compiled->Evaluate(frame);
+		BOOST_CHECK(false);
+	} catch (const ScriptError& ex) {
+		BOOST_CHECK(ex.GetDebugInfo().FirstLine == 2);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(locals_pool)
+{
+	Dictionary::Ptr captured;
+
+	{
+		ScriptFrame frame(true);
+		frame.Locals->Set("host", "a");
+		captured = frame.Locals;
+	}
+
+	/* Still referenced, so it must not be cleared and reused. */
+	BOOST_CHECK(captured->Get("host") == "a");
+
+	for (int i = 0; i < 2; i++) {
+		ScriptFrame frame(true);
+
+		BOOST_CHECK(frame.Locals != captured);
+		BOOST_CHECK(frame.Locals->GetLength() == 0);
+
+		frame.Locals->Set("host", "b");
+	}
+
+	ScriptFrame frame(true);
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>",
+		"var f = function(x) { var y = x; return locals }; var a = f(1); var b = f(2); [ a.y, b.y, a.x ]");
+
+	BOOST_CHECK(JsonEncode(expr->Evaluate(frame).GetValue()) == "[1,2,1]");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,275 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "db_ido/dbconnection.hpp"
+#include "icinga/host.hpp"
+#include "icinga/comment.hpp"
+#include "icinga/downtime.hpp"
+#include "icinga/notification.hpp"
+#include "config/configcompiler.hpp"
+#include "config/configitem.hpp"
+#include "base/convert.hpp"
+#include "base/utility.hpp"
+#include "benchmark-utility.hpp"
+#include "icingaapplication-fixture.hpp"
+#include <BoostTestTargetConfig.h>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <iostream>
+
+using namespace icinga;
+
+/**
+ * Executes nothing, but measures how many queries the IDO core produces and how long they wait in the queue.
+ */
+class BenchmarkDbConnection final : public DbConnection
+{
+public:
+	DECLARE_PTR_TYPEDEFS(BenchmarkDbConnection);
+
+	BenchmarkDbConnection()
+	{
+		m_QueryQueue.SetName("BenchmarkDbConnection");
+	}
+
+	const char * GetLatestSchemaVersion() const noexcept override
+	{
+		return "1.14.3";
+	}
+
+	const char * GetCompatSchemaVersion() const noexcept override
+	{
+		return "1.14.3";
+	}
+
+	int GetPendingQueryCount() const override
+	{
+		return m_QueryQueue.GetLength();
+	}
+
+	void StartBenchmark()
+	{
+		Start(false);
+	}
+
+	void Reset()
+	{
+		m_QueryQueue.Join();
+
+		Queries = 0;
+		Latency = 0;
+	}
+
+	void Drain()
+	{
+		m_QueryQueue.Join();
+	}
+
+	// Only accessed on m_QueryQueue (and after Drain()).
+	size_t Queries{0};
+	double Latency{0};
+
+protected:
+	void ExecuteQuery(const DbQuery& query) override
+	{
+		Enqueue(1, query.Priority);
+	}
+
+	void ExecuteMultipleQueries(const std::vector<DbQuery>& queries) override
+	{
+		if (!queries.empty())
+			Enqueue(queries.size(), queries[0].Priority);
+	}
+
+	void ActivateObject(const DbObject::Ptr&) override { }
+	void DeactivateObject(const DbObject::Ptr&) override { }
+	void FillIDCache(const DbType::Ptr&) override { }
+	void NewTransaction() override { }
+	void Disconnect() override { }
+
+private:
+	void Enqueue(size_t count, WorkQueuePriority priority)
+	{
+		double queued = Utility::GetTime();
+
+		m_QueryQueue.Enqueue([this, count, queued]() {
+			Queries += count;
+			Latency += (Utility::GetTime() - queued) * count;
+		}, priority);
+	}
+};
+
+struct DbIdoBenchmarkFixture
+{
+	DbIdoBenchmarkFixture()
+	{
+		// ensure IcingaApplication is initialized before we try to add config
+		IcingaApplicationFixture icinga;
+
+		BOOST_TEST_MESSAGE("Preparing config objects...");
+
+		ConfigItem::RunWithActivationContext(new Function("CreateTestObjects", CreateTestObjects));
+
+		Connection = new BenchmarkDbConnection();
+		Connection->StartBenchmark();
+	}
+
+	static void CreateTestObjects()
+	{
+		String config = R"CONFIG(
+object CheckCommand "dummy" {
+  command = "/bin/echo"
+}
+
+object NotificationCommand "dummy" {
+  command = "/bin/echo"
+}
+
+object User "benchmark" {
+}
+
+object Host "benchmark-01" {
+  address = "127.0.0.1"
+  check_command = "dummy"
+  enable_notifications = false
+  vars.os = "Linux"
+}
+
+object Comment "benchmark" {
+  host_name = "benchmark-01"
+  author = "icingaadmin"
+  text = "Benchmark"
+}
+
+object Downtime "benchmark" {
+  host_name = "benchmark-01"
+  author = "icingaadmin"
+  comment = "Benchmark"
+  start_time = 0
+  end_time = 1
+}
+
+object Notification "benchmark" {
+  host_name = "benchmark-01"
+  command = "dummy"
+  users = [ "benchmark" ]
+}
+)CONFIG";
+
+		std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<db_ido_benchmark>", config);
+		expr->Evaluate(*ScriptFrame::GetCurrentFrame());
+	}
+
+	static BenchmarkDbConnection::Ptr Connection;
+};
+
+BenchmarkDbConnection::Ptr DbIdoBenchmarkFixture::Connection;
+
+BOOST_GLOBAL_FIXTURE(DbIdoBenchmarkFixture);
+
+/**
+ * Runs the event generator ICINGA2_IDO_BENCHMARK_EVENTS (default: 1000) times and reports the throughput.
+ *
+ * @return The number of queries the events produced
+ */
+static size_t RunBenchmark(const String& name, const std::function<void(size_t)>& generateEvent)
+{
+	size_t events = GetEnvCount("ICINGA2_IDO_BENCHMARK_EVENTS", 1000);
+
+	auto& connection (DbIdoBenchmarkFixture::Connection);
+
+	connection->Reset();
+
+	double start = Utility::GetTime();
+	std::clock_t cpuStart = std::clock();
+
+	for (size_t i = 0; i < events; i++)
+		generateEvent(i);
+
+	connection->Drain();
+
+	double duration = Utility::GetTime() - start;
+	double cpu = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+	size_t queries = connection->Queries;
+
+	std::cout << name << ": " << events << " events, " << queries << " queries in " << duration << "s ("
+		<< (duration > 0 ? queries / duration : 0) << " queries/s, average queue latency "
+		<< (queries ? connection->Latency / queries * 1000 : 0) << "ms, CPU per event "
+		<< (events ? cpu / events * 1000000 : 0) << "us)\n";
+
+	return queries;
+}
+
+BOOST_AUTO_TEST_SUITE(db_ido_benchmark)
+
+BOOST_AUTO_TEST_CASE(check_results)
+{
+	Host::Ptr host = Host::GetByName("benchmark-01");
+	BOOST_REQUIRE(host);
+
+	size_t queries = RunBenchmark("Check results", [&host](size_t i) {
+		CheckResult::Ptr cr = new CheckResult();
+		double now = Utility::GetTime();
+
+		// Alternate the state for state history.
+		cr->SetState(i % 2 ? ServiceCritical : ServiceOK);
+		cr->SetOutput("Benchmark " + Convert::ToString(i));
+		cr->SetScheduleStart(now);
+		cr->SetScheduleEnd(now);
+		cr->SetExecutionStart(now);
+		cr->SetExecutionEnd(now);
+
+		host->ProcessCheckResult(cr);
+	});
+
+	BOOST_CHECK(queries > 0);
+}
+
+BOOST_AUTO_TEST_CASE(comments)
+{
+	Comment::Ptr comment = Comment::GetByName("benchmark-01!benchmark");
+	BOOST_REQUIRE(comment);
+
+	size_t queries = RunBenchmark("Comments", [&comment](size_t) {
+		Comment::OnCommentAdded(comment);
+		Comment::OnCommentRemoved(comment);
+	});
+
+	BOOST_CHECK(queries > 0);
+}
+
+BOOST_AUTO_TEST_CASE(downtimes)
+{
+	Downtime::Ptr downtime = Downtime::GetByName("benchmark-01!benchmark");
+	BOOST_REQUIRE(downtime);
+
+	size_t queries = RunBenchmark("Downtimes", [&downtime](size_t) {
+		Downtime::OnDowntimeAdded(downtime);
+		Downtime::OnDowntimeTriggered(downtime);
+		Downtime::OnDowntimeRemoved(downtime);
+	});
+
+	BOOST_CHECK(queries > 0);
+}
+
+BOOST_AUTO_TEST_CASE(notifications)
+{
+	Host::Ptr host = Host::GetByName("benchmark-01");
+	Notification::Ptr notification = Notification::GetByName("benchmark-01!benchmark");
+	User::Ptr user = User::GetByName("benchmark");
+	BOOST_REQUIRE(host && notification && user);
+
+	std::set<User::Ptr> users { user };
+
+	size_t queries = RunBenchmark("Notifications", [&host, &notification, &users](size_t i) {
+		CheckResult::Ptr cr = new CheckResult();
+		cr->SetState(ServiceCritical);
+		cr->SetOutput("Benchmark " + Convert::ToString(i));
+
+		Checkable::OnNotificationSentToAllUsers(notification, host, users, NotificationProblem, cr, "", "", nullptr);
+	});
+
+	BOOST_CHECK(queries > 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -245,4 +245,52 @@ BOOST_AUTO_TEST_CASE(host_flapping_docs_example)
 #endif
 }
 
+BOOST_AUTO_TEST_CASE(host_flapping_current_stable)
+{
+#ifndef I2_DEBUG
+	BOOST_WARN_MESSAGE(false, "This test can only be run in a debug build!");
+#else /* I2_DEBUG */
+	std::cout << "Running test with a stable host not notifying flapping_current changes...\n";
+
+	Host::Ptr host = new Host();
+	host->SetName("test");
+	host->SetEnableFlapping(true);
+	host->SetMaxCheckAttempts(5);
+	host->SetActive(true);
+
+	host->SetState(HostUp);
+	host->SetStateType(StateTypeHard);
+
+	Utility::SetTime(0);
+
+	// The first check result is a state change (from the default flapping_last_state)
+	host->ProcessCheckResult(MakeCheckResult(ServiceOK));
+
+	for (int i = 0; i < 20; i++)
+		host->ProcessCheckResult(MakeCheckResult(ServiceOK));
+
+	BOOST_CHECK(host->GetFlappingCurrent() == 0);
+
+	int changes = 0;
+
+	auto connection (Checkable::OnFlappingCurrentChanged.connect([&changes, &host](const Checkable::Ptr& checkable, const Value&) {
+		if (checkable == host)
+			changes++;
+	}));
+
+	for (int i = 0; i < 20; i++)
+		host->ProcessCheckResult(MakeCheckResult(ServiceOK));
+
+	BOOST_CHECK(changes == 0);
+
+	host->ProcessCheckResult(MakeCheckResult(ServiceCritical));
+
+	BOOST_CHECK(changes == 1);
+	BOOST_CHECK(host->GetFlappingCurrent() == 5.9);
+	BOOST_CHECK(!host->IsFlapping());
+
+	connection.disconnect();
+#endif /* I2_DEBUG */
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -98,4 +98,90 @@ BOOST_AUTO_TEST_CASE(multi_parent)
 	BOOST_CHECK(childHost->IsReachable() == false);
 }
 
+static Host::Ptr CreateActiveHost(ServiceState state)
+{
+	Host::Ptr host = new Host();
+	host->SetActive(true);
+	host->SetMaxCheckAttempts(1);
+	host->Activate();
+	host->SetAuthority(true);
+	host->SetStateRaw(state);
+	host->SetStateType(StateTypeHard);
+	host->SetLastCheckResult(new CheckResult());
+
+	return host;
+}
+
+static Dependency::Ptr CreateActiveDependency(const Host::Ptr& parent, const Host::Ptr& child)
+{
+	Dependency::Ptr dep = new Dependency();
+	dep->SetParent(parent);
+	dep->SetChild(child);
+	dep->SetStateFilter(StateFilterUp);
+	dep->SetActive(true);
+	dep->Activate();
+
+	child->AddDependency(dep);
+	parent->AddReverseDependency(dep);
+
+	return dep;
+}
+
+BOOST_AUTO_TEST_CASE(cached_reachability)
+{
+	/* grandparent -> parent -> child, the active objects' reachability is cached. */
+	Host::Ptr grandparentHost = CreateActiveHost(ServiceOK);
+	Host::Ptr parentHost = CreateActiveHost(ServiceOK);
+	Host::Ptr childHost = CreateActiveHost(ServiceOK);
+
+	CreateActiveDependency(grandparentHost, parentHost);
+	Dependency::Ptr dep = CreateActiveDependency(parentHost, childHost);
+
+	BOOST_CHECK(childHost->IsReachable() == true);
+	BOOST_CHECK(childHost->IsReachable() == true);
+
+	/* The change has to reach the child through the parent. */
+	grandparentHost->SetStateRaw(ServiceCritical);
+	BOOST_CHECK(parentHost->IsReachable() == false);
+	BOOST_CHECK(childHost->IsReachable() == false);
+
+	grandparentHost->SetStateRaw(ServiceOK);
+	BOOST_CHECK(childHost->IsReachable() == true);
+
+	/* The parent itself is UP, but the dependency doesn't accept that anymore. */
+	dep->SetStateFilter(StateFilterDown);
+
+	Dependency::Ptr failedDependency;
+	BOOST_CHECK(childHost->IsReachable(DependencyState, &failedDependency) == false);
+	BOOST_CHECK(failedDependency == dep);
+	BOOST_CHECK(childHost->IsReachable(DependencyState, &failedDependency) == false);
+	BOOST_CHECK(failedDependency == dep);
+}
+
+BOOST_AUTO_TEST_CASE(cached_redundancy_groups)
+{
+	Host::Ptr downHost = CreateActiveHost(ServiceCritical);
+	Host::Ptr upHost1 = CreateActiveHost(ServiceOK);
+	Host::Ptr upHost2 = CreateActiveHost(ServiceOK);
+	Host::Ptr childHost = CreateActiveHost(ServiceOK);
+
+	Dependency::Ptr downDep = CreateActiveDependency(downHost, childHost);
+	Dependency::Ptr upDep1 = CreateActiveDependency(upHost1, childHost);
+	CreateActiveDependency(upHost2, childHost);
+
+	downDep->SetRedundancyGroup("DNS");
+	upDep1->SetRedundancyGroup("DNS");
+	BOOST_CHECK(childHost->IsReachable() == true);
+
+	/* Moving the UP parent to another group leaves the DOWN one alone in its group. */
+	upDep1->SetRedundancyGroup("LDAP");
+
+	Dependency::Ptr failedDependency;
+	BOOST_CHECK(childHost->IsReachable(DependencyState, &failedDependency) == false);
+	BOOST_CHECK(failedDependency == downDep);
+
+	downDep->SetRedundancyGroup("LDAP");
+	BOOST_CHECK(childHost->IsReachable() == true);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -691,4 +691,64 @@ BOOST_AUTO_TEST_CASE(dst_isinside)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(segment_index)
+{
+	Function::Ptr update = new Function("LegacyTimePeriod", LegacyTimePeriod::ScriptFunc, {"tp", "begin", "end"});
+	Dictionary::Ptr ranges = new Dictionary({
+		{"2021-01-01", "08:00-10:00,12:00-14:00"},
+	});
+
+	// Fri 01 Jan 2021 00:00:00 UTC
+	double midnight = 1609459200;
+
+	TimePeriod::Ptr p = new TimePeriod();
+	p->SetUpdate(update, true);
+	p->SetRanges(ranges, true);
+
+	// The second update is served from the per-day cache and has to give the same result.
+	for (int i = 0; i < 2; i++) {
+		p->UpdateRegion(midnight, midnight + 24*60*60, true);
+
+		BOOST_CHECK_EQUAL(p->GetSegments()->GetLength(), 2);
+
+		BOOST_CHECK(!p->IsInside(midnight + 7*60*60));
+		BOOST_CHECK(!p->IsInside(midnight + 8*60*60));
+		BOOST_CHECK(p->IsInside(midnight + 9*60*60));
+		BOOST_CHECK(!p->IsInside(midnight + 10*60*60));
+		BOOST_CHECK(!p->IsInside(midnight + 11*60*60));
+		BOOST_CHECK(p->IsInside(midnight + 13*60*60));
+		BOOST_CHECK(!p->IsInside(midnight + 15*60*60));
+
+		BOOST_CHECK_EQUAL(p->FindNextTransition(midnight), midnight + 8*60*60);
+		BOOST_CHECK_EQUAL(p->FindNextTransition(midnight + 9*60*60), midnight + 10*60*60);
+		BOOST_CHECK_EQUAL(p->FindNextTransition(midnight + 10*60*60), midnight + 12*60*60);
+		BOOST_CHECK_EQUAL(p->FindNextTransition(midnight + 14*60*60), -1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(segments_state)
+{
+	TimePeriod::Ptr p = new TimePeriod();
+
+	// Segments restored from the state file are sorted and merged if they overlap or touch.
+	p->SetSegments(new Array({
+		new Dictionary({{"begin", 50}, {"end", 60}}),
+		new Dictionary({{"begin", 10}, {"end", 20}}),
+		new Dictionary({{"begin", 15}, {"end", 30}}),
+		new Dictionary({{"begin", 30}, {"end", 40}}),
+		new Dictionary({{"begin", 70}, {"end", 70}}),
+	}), true);
+
+	Array::Ptr segments = p->GetSegments();
+	BOOST_REQUIRE_EQUAL(segments->GetLength(), 2);
+
+	Dictionary::Ptr first = segments->Get(0);
+	BOOST_CHECK_EQUAL(first->Get("begin"), 10);
+	BOOST_CHECK_EQUAL(first->Get("end"), 40);
+
+	Dictionary::Ptr second = segments->Get(1);
+	BOOST_CHECK_EQUAL(second->Get("begin"), 50);
+	BOOST_CHECK_EQUAL(second->Get("end"), 60);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -47,4 +47,22 @@ BOOST_AUTO_TEST_CASE(simple)
 
 }
 
+BOOST_AUTO_TEST_CASE(cached)
+{
+	Dictionary::Ptr macros = new Dictionary({ { "test", "hello" } });
+
+	MacroProcessor::ResolverList resolvers;
+	resolvers.emplace_back("macros", macros);
+
+	/* the parsed format strings are cached, but the resolved values aren't */
+	BOOST_CHECK(MacroProcessor::ResolveMacros("say $test$ $$", resolvers) == "say hello $");
+
+	macros->Set("test", "world");
+	BOOST_CHECK(MacroProcessor::ResolveMacros("say $test$ $$", resolvers) == "say world $");
+
+	BOOST_CHECK(MacroProcessor::ResolveMacros("no macros", resolvers) == "no macros");
+	BOOST_CHECK_THROW(MacroProcessor::ResolveMacros("$test$ $test", resolvers), std::runtime_error);
+	BOOST_CHECK_THROW(MacroProcessor::ResolveMacros("$test$ $test", resolvers), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 #include "icinga/notificationcommand.hpp"
 #include "icinga/service.hpp"
 #include "icinga/user.hpp"
+#include "icinga/usergroup.hpp"
 #include <BoostTestTargetConfig.h>
 #include <iostream>
 
@@ -212,4 +213,38 @@ BOOST_AUTO_TEST_CASE(recovery_filter_duplicate)
 	helper.SendStateNotification(ServiceCritical, true);
 }
 
+BOOST_AUTO_TEST_CASE(recipients_cache)
+{
+	DuplicateDueToFilterHelper helper (~0, ~0);
+
+	UserGroup::Ptr ug = new UserGroup();
+	ug->SetName("admins", true);
+	ug->Register();
+
+	User::Ptr alice = new User();
+	alice->SetName("alice", true);
+	alice->SetTypeFilter(~0);
+	alice->SetStateFilter(~0);
+	alice->Register();
+
+	BOOST_CHECK_EQUAL(helper.n->GetRecipients()->size(), 1);
+
+	/* Not emitting the change signal would leave the cached list in place. */
+	helper.n->SetUserGroupsRaw(new Array({"admins"}), false);
+	BOOST_CHECK_EQUAL(helper.n->GetRecipients()->size(), 1);
+
+	ug->AddMember(alice);
+	BOOST_CHECK_EQUAL(helper.n->GetRecipients()->size(), 2);
+
+	helper.SendStateNotification(ServiceCritical, true);
+	BOOST_CHECK_EQUAL(helper.n->GetNotifiedProblemUsers()->GetLength(), 2);
+
+	ug->RemoveMember(alice);
+	BOOST_CHECK_EQUAL(helper.n->GetRecipients()->size(), 1);
+	BOOST_CHECK(helper.n->GetRecipients() == helper.n->GetRecipients());
+
+	ug->Unregister();
+	alice->Unregister();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
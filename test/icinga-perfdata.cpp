@@ -404,4 +404,37 @@ BOOST_AUTO_TEST_CASE(parse_edgecases)
 	BOOST_CHECK(pv->GetUnit() == "bytes");
 }
 
+BOOST_AUTO_TEST_CASE(fields)
+{
+	PerfdataValue::Fields fields;
+
+	PerfdataValue::ParseFields("'hello world'=1.5kB;1;2;0;U", fields);
+	BOOST_CHECK(fields.Label == "hello world");
+	BOOST_CHECK(fields.Value == 1500);
+	BOOST_CHECK(fields.Unit == "bytes");
+	BOOST_CHECK(fields.Warn == 1000);
+	BOOST_CHECK(fields.Crit == 2000);
+	BOOST_CHECK(fields.Min == 0);
+	BOOST_CHECK(fields.Max.IsEmpty());
+
+	PerfdataValue::ParseFields(new PerfdataValue("test", 42, false, "seconds"), fields);
+	BOOST_CHECK(fields.Label == "test");
+	BOOST_CHECK(fields.Value == 42);
+	BOOST_CHECK(fields.Unit == "seconds");
+	BOOST_CHECK(fields.Warn.IsEmpty());
+
+	BOOST_CHECK_THROW(PerfdataValue::ParseFields("test", fields), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(truncate_output)
+{
+	BOOST_CHECK(PluginUtility::TruncateOutput("OK - all fine", 0) == "OK - all fine");
+	BOOST_CHECK(PluginUtility::TruncateOutput("OK - all fine", 13) == "OK - all fine");
+	BOOST_CHECK(PluginUtility::TruncateOutput("OK - all fine", 4) == "OK -\n... (output truncated)");
+
+	/* "\xc3\xa4" is a two-byte character which must not be cut apart. */
+	BOOST_CHECK(PluginUtility::TruncateOutput("OK - \xc3\xa4", 6) == "OK - \n... (output truncated)");
+	BOOST_CHECK(PluginUtility::TruncateOutput("OK - \xc3\xa4 ok", 7) == "OK - \xc3\xa4\n... (output truncated)");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,331 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "livestatus/livestatusquery.hpp"
+#include "icinga/host.hpp"
+#include "icinga/service.hpp"
+#include "config/configcompiler.hpp"
+#include "config/configitem.hpp"
+#include "base/convert.hpp"
+#include "base/stdiostream.hpp"
+#include "base/utility.hpp"
+#include "benchmark-utility.hpp"
+#include "icingaapplication-fixture.hpp"
+#include <BoostTestTargetConfig.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <vector>
+
+using namespace icinga;
+
+/* Counts the heap allocations of this process, so that the benchmark can report them per query. */
+static std::atomic<size_t> l_Allocations (0);
+
+void *operator new(std::size_t size)
+{
+	l_Allocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (void *ptr = std::malloc(size ? size : 1))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+/**
+ * Adds ICINGA2_LIVESTATUS_BENCHMARK_HOSTS (default: 100) hosts with five services each to the objects
+ * of livestatus-fixture.cpp, gives them mixed states and writes a compat log for the log table.
+ */
+struct LivestatusBenchmarkFixture
+{
+	LivestatusBenchmarkFixture()
+	{
+		// ensure IcingaApplication is initialized before we try to add config
+		IcingaApplicationFixture icinga;
+
+		Hosts = GetEnvCount("ICINGA2_LIVESTATUS_BENCHMARK_HOSTS", 100);
+
+		BOOST_TEST_MESSAGE("Preparing " << Hosts << " benchmark hosts...");
+
+		ConfigItem::RunWithActivationContext(new Function("CreateBenchmarkObjects", CreateBenchmarkObjects));
+
+		ProcessCheckResults();
+		WriteCompatLog();
+	}
+
+	~LivestatusBenchmarkFixture()
+	{
+		boost::system::error_code ec;
+		boost::filesystem::remove_all(CompatLogPath.GetData(), ec);
+	}
+
+	static void CreateBenchmarkObjects()
+	{
+		std::ostringstream config;
+
+		config << R"CONFIG(
+object CheckCommand "benchmark" {
+  command = "/bin/echo"
+}
+
+template Service "benchmark" {
+  check_command = "benchmark"
+}
+
+apply Service "ping4" {
+  import "benchmark"
+  assign where host.vars.benchmark
+}
+
+apply Service "load" {
+  import "benchmark"
+  assign where host.vars.benchmark
+}
+
+apply Service "disk" {
+  import "benchmark"
+  assign where host.vars.benchmark
+}
+
+apply Service "http" {
+  import "benchmark"
+  assign where host.vars.benchmark
+}
+
+apply Service "ssh" {
+  import "benchmark"
+  assign where host.vars.benchmark
+}
+)CONFIG";
+
+		for (size_t i = 0; i < Hosts; i++) {
+			config << "object Host \"benchmark-" << i << "\" {\n"
+				<< "  address = \"127.0.0.1\"\n"
+				<< "  check_command = \"benchmark\"\n"
+				<< "  groups = [ \"benchmark-" << (i % 10) << "\" ]\n"
+				<< "  vars.benchmark = true\n"
+				<< "}\n";
+		}
+
+		for (size_t i = 0; i < std::min<size_t>(Hosts, 10); i++)
+			config << "object HostGroup \"benchmark-" << i << "\" { }\n";
+
+		std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<livestatus_benchmark>", config.str());
+		expr->Evaluate(*ScriptFrame::GetCurrentFrame());
+	}
+
+	static void ProcessCheckResults()
+	{
+		double now = Utility::GetTime();
+		size_t i = 0;
+
+		for (auto& service : ConfigType::GetObjectsByType<Service>()) {
+			if (service->GetCheckCommandRaw() != "benchmark")
+				continue;
+
+			CheckResult::Ptr cr = new CheckResult();
+
+			// Roughly 80% OK, the rest spread over the problem states.
+			cr->SetState(i % 5 ? ServiceOK : static_cast<ServiceState>(1 + i / 5 % 3));
+			cr->SetOutput("Benchmark " + Convert::ToString(i));
+			cr->SetScheduleStart(now);
+			cr->SetScheduleEnd(now);
+			cr->SetExecutionStart(now);
+			cr->SetExecutionEnd(now);
+
+			service->ProcessCheckResult(cr);
+			i++;
+		}
+	}
+
+	/**
+	 * Ten alerts per host within the last day.
+	 */
+	static void WriteCompatLog()
+	{
+		CompatLogPath = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("icinga2-livestatus-%%%%-%%%%")).string();
+		boost::filesystem::create_directories(CompatLogPath.GetData());
+
+		std::ofstream fp ((CompatLogPath + "/icinga.log").CStr());
+		time_t now = Utility::GetTime();
+		size_t lines = Hosts * 10;
+		static const char * const states[] = { "OK", "WARNING", "CRITICAL", "UNKNOWN" };
+
+		for (size_t i = 0; i < lines; i++) {
+			time_t ts = now - 86400 + 86400 * i / std::max<size_t>(lines, 1);
+
+			fp << "[" << ts << "] SERVICE ALERT: benchmark-" << (i % Hosts) << ";load;" << states[i % 4]
+				<< ";HARD;1;Benchmark " << i << "\n";
+		}
+	}
+
+	static size_t Hosts;
+	static String CompatLogPath;
+};
+
+size_t LivestatusBenchmarkFixture::Hosts;
+String LivestatusBenchmarkFixture::CompatLogPath;
+
+BOOST_GLOBAL_FIXTURE(LivestatusBenchmarkFixture);
+
+static std::vector<String> SplitQuery(const String& query)
+{
+	std::vector<String> lines;
+	std::istringstream stream (query);
+	std::string line;
+
+	while (std::getline(stream, line))
+		lines.emplace_back(line);
+
+	return lines;
+}
+
+/**
+ * Executes the query ICINGA2_LIVESTATUS_BENCHMARK_ITERATIONS (default: 10) times and reports the latency
+ * percentiles, allocations and response size.
+ *
+ * @return The size of the last response
+ */
+static size_t RunBenchmark(const String& name, const String& query)
+{
+	size_t iterations = std::max<size_t>(GetEnvCount("ICINGA2_LIVESTATUS_BENCHMARK_ITERATIONS", 10), 1);
+	std::vector<String> lines (SplitQuery(query));
+	std::vector<double> latencies;
+	size_t allocations = 0;
+	size_t size = 0;
+
+	latencies.reserve(iterations);
+
+	for (size_t i = 0; i < iterations; i++) {
+		LivestatusQuery::Ptr lquery = new LivestatusQuery(lines, LivestatusBenchmarkFixture::CompatLogPath);
+
+		std::stringstream stream;
+		StdioStream::Ptr sstream = new StdioStream(&stream, false);
+
+		size_t allocationsStart = l_Allocations.load(std::memory_order_relaxed);
+		double start = Utility::GetTime();
+
+		lquery->Execute(sstream);
+
+		latencies.push_back(Utility::GetTime() - start);
+		allocations += l_Allocations.load(std::memory_order_relaxed) - allocationsStart;
+		size = stream.str().size();
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+
+	auto percentile ([&latencies](double p) {
+		return latencies[std::min<size_t>(latencies.size() * p, latencies.size() - 1)] * 1000;
+	});
+
+	std::cout << name << ": " << iterations << " queries, p50 " << percentile(0.5) << "ms, p90 " << percentile(0.9)
+		<< "ms, p99 " << percentile(0.99) << "ms, max " << latencies.back() * 1000 << "ms, "
+		<< allocations / iterations << " allocations and " << size << " bytes per response\n";
+
+	return size;
+}
+
+BOOST_AUTO_TEST_SUITE(livestatus_benchmark)
+
+BOOST_AUTO_TEST_CASE(stats)
+{
+	/* Thruk's tactical overview */
+	BOOST_CHECK(RunBenchmark("Service totals", R"QUERY(GET services
+Stats: state = 0
+Stats: state = 1
+Stats: state = 2
+Stats: state = 3
+Stats: has_been_checked = 0
+Stats: state != 0
+Stats: acknowledged = 1
+StatsAnd: 2
+Stats: scheduled_downtime_depth > 0
+ResponseHeader: fixed16
+OutputFormat: json)QUERY") > 0);
+
+	BOOST_CHECK(RunBenchmark("Host totals", R"QUERY(GET hosts
+Stats: state = 0
+Stats: state = 1
+Stats: state = 2
+Stats: has_been_checked = 0
+Stats: scheduled_downtime_depth > 0
+ResponseHeader: fixed16
+OutputFormat: json)QUERY") > 0);
+
+	BOOST_CHECK(RunBenchmark("Service problems by host group", R"QUERY(GET servicesbyhostgroup
+Filter: hostgroup_name = benchmark-1
+Stats: state = 1
+Stats: state = 2
+Stats: state = 3
+ResponseHeader: fixed16
+OutputFormat: json)QUERY") > 0);
+}
+
+BOOST_AUTO_TEST_CASE(filter)
+{
+	/* NagVis object state */
+	BOOST_CHECK(RunBenchmark("Services of one host", R"QUERY(GET services
+Filter: host_name = benchmark-42
+Columns: host_name description state state_type plugin_output last_check acknowledged scheduled_downtime_depth
+ResponseHeader: fixed16
+OutputFormat: json)QUERY") > 0);
+
+	/* Thruk's problems view */
+	BOOST_CHECK(RunBenchmark("Unhandled service problems", R"QUERY(GET services
+Filter: state != 0
+Filter: acknowledged = 0
+Filter: scheduled_downtime_depth = 0
+Columns: host_name description state plugin_output last_state_change
+ResponseHeader: fixed16
+OutputFormat: json)QUERY") > 0);
+
+	BOOST_CHECK(RunBenchmark("Host search", R"QUERY(GET hosts
+Filter: name ~~ benchmark-1
+Filter: alias ~~ benchmark-1
+Or: 2
+Columns: name alias state
+ResponseHeader: fixed16
+OutputFormat: json)QUERY") > 0);
+}
+
+BOOST_AUTO_TEST_CASE(columns)
+{
+	BOOST_CHECK(RunBenchmark("All hosts", R"QUERY(GET hosts
+Columns: name alias address state state_type has_been_checked plugin_output last_check next_check acknowledged scheduled_downtime_depth num_services num_services_ok
+ResponseHeader: fixed16
+OutputFormat: json)QUERY") > 0);
+
+	BOOST_CHECK(RunBenchmark("All services", R"QUERY(GET services
+Columns: host_name description state state_type has_been_checked plugin_output perf_data last_check next_check acknowledged scheduled_downtime_depth
+ResponseHeader: fixed16
+OutputFormat: json)QUERY") > 0);
+}
+
+BOOST_AUTO_TEST_CASE(log)
+{
+	double since = Utility::GetTime() - 3600;
+
+	BOOST_CHECK(RunBenchmark("Alerts of the last hour", "GET log\nFilter: time >= " + Convert::ToString(static_cast<long>(since))
+		+ "\nFilter: class = 1\nColumns: time host_name service_description state plugin_output\n"
+		"ResponseHeader: fixed16\nOutputFormat: json") > 0);
+
+	BOOST_CHECK(RunBenchmark("Alerts of one host", "GET log\nFilter: time >= " + Convert::ToString(static_cast<long>(since - 82800))
+		+ "\nFilter: host_name = benchmark-42\nColumns: time type state plugin_output\n"
+		"ResponseHeader: fixed16\nOutputFormat: json") > 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
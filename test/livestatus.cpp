@@ -2,13 +2,17 @@
 
 #include "livestatus/livestatusquery.hpp"
 #include "base/application.hpp"
+#include "base/atomic.hpp"
 #include "base/stdiostream.hpp"
 #include "base/json.hpp"
 #include <BoostTestTargetConfig.h>
+#include <thread>
+#include <vector>
 
 using namespace icinga;
 
-String LivestatusQueryHelper(const std::vector<String>& lines)
+/* Boost.Test's logging isn't thread-safe, this one doesn't log. */
+static String ExecuteLivestatusQuery(const std::vector<String>& lines)
 {
 	LivestatusQuery::Ptr query = new LivestatusQuery(lines, "");
 
@@ -36,6 +40,13 @@ String LivestatusQueryHelper(const std::vector<String>& lines)
 			break;
 	}
 
+	return output;
+}
+
+String LivestatusQueryHelper(const std::vector<String>& lines)
+{
+	String output = ExecuteLivestatusQuery(lines);
+
 	BOOST_TEST_MESSAGE("Query Result: " + output);
 
 	return output;
@@ -102,6 +113,124 @@ BOOST_AUTO_TEST_CASE(services)
 
 	BOOST_TEST_MESSAGE("Done with testing livestatus services...");
 }
+
+BOOST_AUTO_TEST_CASE(stats_snapshot)
+{
+	BOOST_TEST_MESSAGE("Querying Livestatus stats...");
+
+	std::vector<String> lines ({
+		"GET hosts",
+		"Stats: state >= 0",
+		"Stats: acknowledged = 1",
+		"Stats: host_has_been_checked >= 0",
+		"OutputFormat: json"
+	});
+
+	/* counted over the snapshot */
+	Array::Ptr snapshotResult = JsonDecode(LivestatusQueryHelper(lines));
+
+	/* Limit: disables the snapshot */
+	lines.emplace_back("Limit: 100");
+	Array::Ptr result = JsonDecode(LivestatusQueryHelper(lines));
+
+	BOOST_CHECK_EQUAL(JsonEncode(snapshotResult), JsonEncode(result));
+
+	Array::Ptr row = snapshotResult->Get(0);
+	BOOST_CHECK_EQUAL(row->GetLength(), 3);
+	BOOST_CHECK_EQUAL(static_cast<double>(row->Get(0)), 2);
+	BOOST_CHECK_EQUAL(static_cast<double>(row->Get(1)), 0);
+	BOOST_CHECK_EQUAL(static_cast<double>(row->Get(2)), 2);
+}
+
+BOOST_AUTO_TEST_CASE(filter_lookup)
+{
+	BOOST_TEST_MESSAGE("Querying Livestatus by name...");
+
+	/* looked up by host (and service) name instead of scanning all objects */
+	Array::Ptr services = JsonDecode(LivestatusQueryHelper({
+		"GET services",
+		"Columns: host_name service_description",
+		"Filter: service_description ~ ^live",
+		"Filter: host_name = test-01",
+		"OutputFormat: json"
+	}));
+
+	BOOST_REQUIRE_EQUAL(services->GetLength(), 1);
+	Array::Ptr row = services->Get(0);
+	BOOST_CHECK_EQUAL(row->Get(0), "test-01");
+	BOOST_CHECK_EQUAL(row->Get(1), "livestatus");
+
+	Array::Ptr service = JsonDecode(LivestatusQueryHelper({
+		"GET services",
+		"Columns: host_name",
+		"Filter: host_name = test-02",
+		"Filter: service_description = livestatus",
+		"OutputFormat: json"
+	}));
+
+	BOOST_REQUIRE_EQUAL(service->GetLength(), 1);
+	row = service->Get(0);
+	BOOST_CHECK_EQUAL(row->Get(0), "test-02");
+
+	/* the remaining filters still apply */
+	Array::Ptr hosts = JsonDecode(LivestatusQueryHelper({
+		"GET hosts",
+		"Columns: host_name",
+		"Filter: host_name = test-01",
+		"Filter: address = 127.0.0.2",
+		"OutputFormat: json"
+	}));
+
+	BOOST_CHECK_EQUAL(hosts->GetLength(), 0);
+
+	Array::Ptr unknown = JsonDecode(LivestatusQueryHelper({
+		"GET services",
+		"Columns: host_name",
+		"Filter: host_name = test-03",
+		"OutputFormat: json"
+	}));
+
+	BOOST_CHECK_EQUAL(unknown->GetLength(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_queries)
+{
+	BOOST_TEST_MESSAGE("Querying Livestatus concurrently...");
+
+	std::vector<String> hostLines ({
+		"GET hosts",
+		"Columns: host_name address check_command",
+		"OutputFormat: json",
+		"\n"
+	});
+
+	std::vector<String> statsLines ({
+		"GET services",
+		"Stats: state = 0",
+		"Stats: state != 0",
+		"OutputFormat: json",
+		"\n"
+	});
+
+	String hosts = LivestatusQueryHelper(hostLines);
+	String stats = LivestatusQueryHelper(statsLines);
+	std::vector<std::thread> threads;
+	Atomic<int> mismatches (0);
+
+	for (int i = 0; i < 8; i++) {
+		threads.emplace_back([&]() {
+			for (int j = 0; j < 100; j++) {
+				if (ExecuteLivestatusQuery(hostLines) != hosts || ExecuteLivestatusQuery(statsLines) != stats)
+					mismatches.fetch_add(1);
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	BOOST_CHECK_EQUAL(mismatches.load(), 0);
+}
 //____________________________________________________________________________//
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,82 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/apiuser.hpp"
+#include "remote/filterutility.hpp"
+#include "base/base64.hpp"
+#include "base/function.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(remote_apiuser)
+
+BOOST_AUTO_TEST_CASE(permission_check)
+{
+	ApiUser::Ptr user = new ApiUser();
+
+	user->SetPermissions(new Array({
+		"objects/query/*",
+		new Dictionary({
+			{ "permission", "objects/modify/Host" },
+			{ "filter", new Function("", []() { return true; }) }
+		})
+	}), true);
+
+	auto check (user->GetPermissionCheck("objects/query/host"));
+	BOOST_CHECK(check->Found);
+	BOOST_CHECK(!check->Filter);
+	BOOST_CHECK(check == user->GetPermissionCheck("objects/query/host"));
+
+	check = user->GetPermissionCheck("objects/modify/host");
+	BOOST_CHECK(check->Found);
+	BOOST_CHECK(check->Filter);
+
+	std::unique_ptr<Expression> filter;
+	BOOST_CHECK(FilterUtility::HasPermission(user, "objects/modify/Host", &filter));
+	BOOST_CHECK(filter);
+	BOOST_CHECK(!FilterUtility::HasPermission(user, "objects/delete/Host", &filter));
+	BOOST_CHECK(!filter);
+
+	/* Changing the permissions drops what was computed from the old ones. */
+	user->SetPermissions(new Array({ "objects/delete/*" }), false);
+
+	BOOST_CHECK(!user->GetPermissionCheck("objects/query/host")->Found);
+	BOOST_CHECK(user->GetPermissionCheck("objects/delete/host")->Found);
+}
+
+BOOST_AUTO_TEST_CASE(authentication)
+{
+	ApiUser::Ptr user = new ApiUser();
+	user->SetName("apiuser-authentication");
+	user->SetClientCN("agent-01.example.com");
+	user->SetPassword("secret");
+	user->Register();
+
+	String header = "Basic " + Base64::Encode("apiuser-authentication:secret");
+
+	BOOST_CHECK(!ApiUser::GetByClientCN("agent-01.example.com"));
+
+	user->SetActive(true);
+	user->Activate();
+
+	BOOST_CHECK(ApiUser::GetByClientCN("agent-01.example.com") == user);
+	BOOST_CHECK(!ApiUser::GetByClientCN(""));
+	BOOST_CHECK(ApiUser::GetByAuthHeader(header) == user);
+	BOOST_CHECK(ApiUser::GetByAuthHeader(header) == user);
+	BOOST_CHECK(!ApiUser::GetByAuthHeader("Basic " + Base64::Encode("apiuser-authentication:wrong")));
+
+	/* Changes take effect right away, not only after the cached headers expired. */
+	user->SetPassword("changed");
+	BOOST_CHECK(!ApiUser::GetByAuthHeader(header));
+
+	user->SetClientCN("agent-02.example.com");
+	BOOST_CHECK(!ApiUser::GetByClientCN("agent-01.example.com"));
+	BOOST_CHECK(ApiUser::GetByClientCN("agent-02.example.com") == user);
+
+	user->Deactivate();
+	BOOST_CHECK(!ApiUser::GetByClientCN("agent-02.example.com"));
+
+	user->Unregister();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
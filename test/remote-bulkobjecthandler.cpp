@@ -0,0 +1,51 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/bulkobjecthandler.hpp"
+#include "base/array.hpp"
+#include "base/dictionary.hpp"
+#include "base/objectlock.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(remote_bulkobjecthandler)
+
+BOOST_AUTO_TEST_CASE(mixed_batch)
+{
+	Array::Ptr entries = new Array({
+		new Dictionary({ { "type", "Host" }, { "name", "valid1" }, { "attrs", new Dictionary({ { "groups", new Array({ "a", "a" }) } }) } }),
+		new Dictionary({ { "type", "Host" }, { "name", "invalid1" }, { "attrs", "no dictionary" } }),
+		new Dictionary({ { "type", "Host" }, { "name", "valid2" } }),
+		new Dictionary({ { "type", "Host" }, { "name", "invalid2" }, { "attrs", new Dictionary({ { "groups", "no array" } }) } }),
+		new Dictionary({ { "type", "Host" }, { "name", "valid3" }, { "attrs", new Dictionary({ { "address", "127.0.0.1" } }) } })
+	});
+
+	std::vector<String> valid, invalid;
+	ObjectLock olock(entries);
+
+	for (const Dictionary::Ptr& entry : entries) {
+		try {
+			Dictionary::Ptr attrs = BulkObjectHandler::GetCreateAttrs(entry, nullptr);
+
+			BOOST_CHECK(attrs);
+			BOOST_CHECK(!attrs->Contains("zone"));
+			valid.emplace_back(entry->Get("name"));
+		} catch (const std::invalid_argument&) {
+			invalid.emplace_back(entry->Get("name"));
+		}
+	}
+
+	BOOST_CHECK(valid == std::vector<String>({ "valid1", "valid2", "valid3" }));
+	BOOST_CHECK(invalid == std::vector<String>({ "invalid1", "invalid2" }));
+
+	olock.Unlock();
+
+	Dictionary::Ptr attrs = BulkObjectHandler::GetCreateAttrs(entries->Get(0), nullptr);
+	BOOST_CHECK(static_cast<Array::Ptr>(attrs->Get("groups"))->GetLength() == 1);
+
+	/* The entry's attributes are left as they are. */
+	Dictionary::Ptr entryAttrs = static_cast<Dictionary::Ptr>(entries->Get(0))->Get("attrs");
+	BOOST_CHECK(static_cast<Array::Ptr>(entryAttrs->Get("groups"))->GetLength() == 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
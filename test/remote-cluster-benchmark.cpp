@@ -0,0 +1,226 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/apilistener.hpp"
+#include "remote/jsonrpc.hpp"
+#include "base/convert.hpp"
+#include "base/histogram.hpp"
+#include "base/netstring.hpp"
+#include "base/networkstream.hpp"
+#include "base/socket.hpp"
+#include "base/stdiostream.hpp"
+#include "base/utility.hpp"
+#include "benchmark-utility.hpp"
+#include <BoostTestTargetConfig.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace icinga;
+
+/**
+ * Returns the number of messages to send, ICINGA2_CLUSTER_BENCHMARK_MESSAGES (default: 1000).
+ */
+static size_t GetMessageCount()
+{
+	return GetEnvCount("ICINGA2_CLUSTER_BENCHMARK_MESSAGES", 1000);
+}
+
+/**
+ * An event::CheckResult message like ClusterEvents::MakeCheckResultMessage() creates it.
+ */
+static Dictionary::Ptr MakeCheckResultMessage(size_t i)
+{
+	double now = Utility::GetTime();
+
+	return new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "event::CheckResult" },
+		{ "ts", now },
+		{ "params", new Dictionary({
+			{ "host", "host-" + Convert::ToString(i % 1000) },
+			{ "service", "disk /" },
+			{ "cr", new Dictionary({
+				{ "type", "CheckResult" },
+				{ "state", 1 },
+				{ "exit_status", 1 },
+				{ "output", "DISK WARNING - free space: / 3326 MB (8% inode=88%);" },
+				{ "performance_data", new Array({ "/=36787MB;33237;37392;0;41547", "/boot=85MB;380;427;0;475" }) },
+				{ "command", new Array({ "/usr/lib/nagios/plugins/check_disk", "-w", "20%", "-c", "10%", "-p", "/" }) },
+				{ "schedule_start", now - 1 },
+				{ "schedule_end", now },
+				{ "execution_start", now - 1 },
+				{ "execution_end", now },
+				{ "active", true },
+				{ "check_source", "satellite-01.example.com" },
+				{ "scheduling_source", "satellite-01.example.com" },
+				{ "ttl", 0 },
+				{ "vars_before", Empty },
+				{ "vars_after", Empty }
+			}) }
+		}) }
+	});
+}
+
+/**
+ * Sends ICINGA2_CLUSTER_BENCHMARK_MESSAGES (default: 1000) check results through a chain of
+ * ICINGA2_CLUSTER_BENCHMARK_ENDPOINTS (default: 4) endpoints connected with socket pairs. Like JsonRpcConnection
+ * and ApiListener::RelayMessage(), every endpoint decodes each message and encodes it again for the next one.
+ *
+ * @return The number of messages which arrived at the last endpoint
+ */
+static size_t RunRelayBenchmark(const String& name, bool binary)
+{
+	size_t messages = GetMessageCount();
+	size_t endpoints = std::max<size_t>(GetEnvCount("ICINGA2_CLUSTER_BENCHMARK_ENDPOINTS", 4), 1);
+
+	/* links[i] connects endpoint i-1 (the sender for i = 0) with endpoint i. */
+	std::vector<std::pair<Stream::Ptr, Stream::Ptr>> links;
+
+	for (size_t i = 0; i < endpoints; i++) {
+		SOCKET s[2];
+		Socket::SocketPair(s);
+
+		links.emplace_back(new NetworkStream(new Socket(s[0])), new NetworkStream(new Socket(s[1])));
+	}
+
+	Histogram latencies; // microseconds
+	size_t received = 0;
+	size_t bytes = 0;
+	std::vector<std::thread> threads;
+
+	for (size_t i = 0; i < endpoints; i++) {
+		threads.emplace_back([&links, &latencies, &received, i, endpoints, binary]() {
+			auto& in (links[i].second);
+			bool last = i + 1 == endpoints;
+			StreamReadContext src;
+
+			for (;;) {
+				String raw;
+
+				if (NetString::ReadStringFromStream(in, &raw, src, true) != StatusNewItem)
+					break;
+
+				Dictionary::Ptr message = JsonRpc::DecodeMessage(raw);
+
+				if (last) {
+					auto us ((Utility::GetTime() - static_cast<double>(message->Get("ts"))) * 1000000.0);
+					latencies.Record(us > 0 ? (Histogram::ValueType)us : 0);
+					received++;
+				} else {
+					EncodedMessage relayed (message);
+					NetString::WriteStringToStream(links[i + 1].first, *relayed.Get(binary));
+				}
+			}
+
+			in->Close();
+
+			if (!last)
+				links[i + 1].first->Close();
+		});
+	}
+
+	double start = Utility::GetTime();
+
+	for (size_t i = 0; i < messages; i++) {
+		EncodedMessage message (MakeCheckResultMessage(i));
+		auto& encoded (message.Get(binary));
+
+		bytes += encoded->GetLength();
+		NetString::WriteStringToStream(links[0].first, *encoded);
+	}
+
+	links[0].first->Close();
+
+	for (auto& thread : threads)
+		thread.join();
+
+	double duration = Utility::GetTime() - start;
+
+	std::cout << name << ": " << received << " messages of " << (messages ? bytes / messages : 0) << " bytes through "
+		<< endpoints << " endpoints in " << duration << "s (" << (duration > 0 ? received / duration : 0)
+		<< " messages/s), end-to-end latency p50 " << latencies.GetPercentile(50) / 1000.0 << "ms, p99 "
+		<< latencies.GetPercentile(99) / 1000.0 << "ms, per hop "
+		<< latencies.GetMean() / endpoints / 1000.0 << "ms on average\n";
+
+	return received;
+}
+
+BOOST_AUTO_TEST_SUITE(remote_cluster_benchmark)
+
+BOOST_AUTO_TEST_CASE(relay_json)
+{
+	BOOST_CHECK(RunRelayBenchmark("Relay (JSON)", false) == GetMessageCount());
+}
+
+BOOST_AUTO_TEST_CASE(relay_binary)
+{
+	BOOST_CHECK(RunRelayBenchmark("Relay (binary)", true) == GetMessageCount());
+}
+
+/**
+ * Writes ICINGA2_CLUSTER_BENCHMARK_MESSAGES check results to a replay log like ApiListener::PersistMessage()
+ * and reads them back like ApiListener::ReplayLog().
+ */
+BOOST_AUTO_TEST_CASE(replay_log)
+{
+	size_t messages = GetMessageCount();
+	String path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("icinga2-replay-%%%%-%%%%")).string();
+	size_t bytes = 0;
+
+	double start = Utility::GetTime();
+
+	{
+		StdioStream::Ptr logStream = new StdioStream(new std::fstream(path.CStr(), std::fstream::out | std::ofstream::app), true);
+
+		for (size_t i = 0; i < messages; i++) {
+			EncodedMessage message (MakeCheckResultMessage(i));
+			bytes += NetString::WriteStringToStream(logStream, ApiListener::MakeReplayLogEntry(message, nullptr));
+		}
+
+		logStream->Close();
+	}
+
+	double written = Utility::GetTime();
+	size_t replayed = 0;
+
+	{
+		StdioStream::Ptr logStream = new StdioStream(new std::fstream(path.CStr(), std::fstream::in | std::fstream::binary), true);
+		StreamReadContext src;
+		String message;
+
+		for (;;) {
+			StreamReadStatus srs = NetString::ReadStringFromStream(logStream, &message, src);
+
+			if (srs == StatusEof)
+				break;
+
+			if (srs != StatusNewItem)
+				continue;
+
+			Dictionary::Ptr pmessage = JsonDecode(message);
+
+			if (static_cast<double>(pmessage->Get("timestamp")) > 0)
+				replayed++;
+		}
+
+		logStream->Close();
+	}
+
+	double read = Utility::GetTime();
+
+	boost::system::error_code ec;
+	boost::filesystem::remove(path.GetData(), ec);
+
+	std::cout << "Replay log: wrote " << messages << " messages (" << bytes << " bytes) in " << written - start << "s ("
+		<< (written > start ? messages / (written - start) : 0) << " messages/s, "
+		<< (written > start ? bytes / (written - start) / 1048576 : 0) << " MiB/s), read them in " << read - written
+		<< "s (" << (read > written ? replayed / (read - written) : 0) << " messages/s)\n";
+
+	BOOST_CHECK(replayed == messages);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,159 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/configdeltautility.hpp"
+#include "icinga/user.hpp"
+#include "base/serializer.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static Dictionary::Ptr MakeItem(const String& type, const String& name, const Dictionary::Ptr& properties)
+{
+	return new Dictionary({
+		{ "type", type },
+		{ "name", name },
+		{ "properties", properties }
+	});
+}
+
+BOOST_AUTO_TEST_SUITE(remote_configdeltautility)
+
+BOOST_AUTO_TEST_CASE(hash)
+{
+	Dictionary::Ptr item = MakeItem("Host", "h1", new Dictionary({
+		{ "address", "127.0.0.1" },
+		{ "source_location", new Dictionary({ { "path", "hosts.conf" }, { "first_line", 1 } }) }
+	}));
+
+	Dictionary::Ptr moved = MakeItem("Host", "h1", new Dictionary({
+		{ "address", "127.0.0.1" },
+		{ "source_location", new Dictionary({ { "path", "hosts.conf" }, { "first_line", 42 } }) }
+	}));
+
+	Dictionary::Ptr changed = MakeItem("Host", "h1", new Dictionary({
+		{ "address", "127.0.0.2" },
+		{ "source_location", new Dictionary({ { "path", "hosts.conf" }, { "first_line", 1 } }) }
+	}));
+
+	BOOST_CHECK_EQUAL(ConfigDeltaUtility::GetObjectHash(item), ConfigDeltaUtility::GetObjectHash(moved));
+	BOOST_CHECK_NE(ConfigDeltaUtility::GetObjectHash(item), ConfigDeltaUtility::GetObjectHash(changed));
+}
+
+BOOST_AUTO_TEST_CASE(delta)
+{
+	std::vector<Dictionary::Ptr> oldItems {
+		MakeItem("Host", "unchanged", new Dictionary({ { "address", "127.0.0.1" } })),
+		MakeItem("Host", "modified", new Dictionary({ { "address", "127.0.0.1" }, { "notes", "old" } })),
+		MakeItem("Host", "deleted", new Dictionary({ { "address", "127.0.0.1" } })),
+		MakeItem("Service", "unchanged!ping", new Dictionary({ { "check_interval", 60 } }))
+	};
+
+	std::vector<Dictionary::Ptr> newItems {
+		MakeItem("Host", "created", new Dictionary({ { "address", "127.0.0.1" } })),
+		MakeItem("Host", "modified", new Dictionary({ { "address", "127.0.0.2" }, { "notes", "old" } })),
+		MakeItem("Service", "unchanged!ping", new Dictionary({ { "check_interval", 60 } })),
+		MakeItem("Host", "unchanged", new Dictionary({ { "address", "127.0.0.1" } })),
+		MakeItem("User", "deleted", new Dictionary())
+	};
+
+	ConfigDelta delta = ConfigDeltaUtility::ComputeDelta(oldItems, newItems);
+
+	BOOST_REQUIRE_EQUAL(delta.Created.size(), 2u);
+	BOOST_CHECK_EQUAL(delta.Created[0]->Get("name"), "created");
+	BOOST_CHECK_EQUAL(delta.Created[1]->Get("type"), "User");
+
+	BOOST_REQUIRE_EQUAL(delta.Modified.size(), 1u);
+	BOOST_CHECK_EQUAL(delta.Modified[0].first, oldItems[1]);
+	BOOST_CHECK_EQUAL(delta.Modified[0].second, newItems[1]);
+
+	BOOST_REQUIRE_EQUAL(delta.Deleted.size(), 1u);
+	BOOST_CHECK_EQUAL(delta.Deleted[0], oldItems[2]);
+
+	auto attrs (ConfigDeltaUtility::GetChangedAttributes(delta.Modified[0].first, delta.Modified[0].second));
+	BOOST_CHECK(attrs == std::vector<String>{ "address" });
+}
+
+BOOST_AUTO_TEST_CASE(changed_attributes)
+{
+	Dictionary::Ptr oldItem = MakeItem("Host", "h1", new Dictionary({
+		{ "vars", new Dictionary({ { "os", "Linux" } }) },
+		{ "groups", new Array({ "linux" }) },
+		{ "notes", "removed" },
+		{ "source_location", "old" }
+	}));
+
+	Dictionary::Ptr newItem = MakeItem("Host", "h1", new Dictionary({
+		{ "vars", new Dictionary({ { "os", "Windows" } }) },
+		{ "groups", new Array({ "linux" }) },
+		{ "notes_url", "added" },
+		{ "source_location", "new" }
+	}));
+
+	auto attrs (ConfigDeltaUtility::GetChangedAttributes(oldItem, newItem));
+	BOOST_CHECK(attrs == std::vector<String>({ "notes", "notes_url", "vars" }));
+}
+
+BOOST_AUTO_TEST_CASE(apply_refused)
+{
+	ConfigDelta logger;
+	logger.Created.push_back(MakeItem("FileLogger", "new-log", new Dictionary({ { "path", "/dev/null" } })));
+
+	Array::Ptr errors = new Array();
+	BOOST_CHECK(!ConfigDeltaUtility::ApplyDelta(logger, errors));
+	BOOST_CHECK_EQUAL(errors->GetLength(), 1u);
+
+	ConfigDelta function;
+	function.Created.push_back(MakeItem("User", "new-user", new Dictionary({
+		{ "vars", new Dictionary({ { "f", new Dictionary({ { "type", "Function" } }) } }) }
+	})));
+
+	errors = new Array();
+	BOOST_CHECK(!ConfigDeltaUtility::ApplyDelta(function, errors));
+	BOOST_CHECK_EQUAL(errors->GetLength(), 1u);
+
+	ConfigDelta gone;
+	gone.Deleted.push_back(MakeItem("User", "does-not-exist", new Dictionary()));
+
+	errors = new Array();
+	BOOST_CHECK(ConfigDeltaUtility::ApplyDelta(gone, errors));
+	BOOST_CHECK_EQUAL(errors->GetLength(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(apply)
+{
+	User::Ptr user = new User();
+	user->SetName("delta-user");
+	user->SetEmail("old@example.com");
+
+	Dictionary::Ptr oldItem = MakeItem("User", "delta-user", Serialize(user, FAConfig));
+
+	ConfigDelta created;
+	created.Created.push_back(oldItem);
+
+	Array::Ptr errors = new Array();
+	BOOST_REQUIRE(ConfigDeltaUtility::ApplyDelta(created, errors));
+
+	user = User::GetByName("delta-user");
+	BOOST_REQUIRE(user);
+	BOOST_CHECK(user->IsActive());
+	BOOST_CHECK_EQUAL(user->GetEmail(), "old@example.com");
+
+	Dictionary::Ptr properties = Dictionary::Ptr(oldItem->Get("properties"))->ShallowClone();
+	properties->Set("email", "new@example.com");
+
+	ConfigDelta modified;
+	modified.Modified.emplace_back(oldItem, MakeItem("User", "delta-user", properties));
+
+	BOOST_REQUIRE(ConfigDeltaUtility::ApplyDelta(modified, errors));
+	BOOST_CHECK_EQUAL(user->GetEmail(), "new@example.com");
+	BOOST_CHECK(!user->GetOriginalAttributes() || !user->GetOriginalAttributes()->Contains("email"));
+
+	ConfigDelta deleted;
+	deleted.Deleted.push_back(oldItem);
+
+	BOOST_REQUIRE(ConfigDeltaUtility::ApplyDelta(deleted, errors));
+	BOOST_CHECK(!User::GetByName("delta-user"));
+	BOOST_CHECK(!user->IsActive());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,95 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/duplicatemessagefilter.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static Endpoint::Ptr MakeEndpoint(const String& name)
+{
+	Endpoint::Ptr endpoint = new Endpoint();
+	endpoint->SetName(name);
+
+	return endpoint;
+}
+
+static Dictionary::Ptr MakeCheckResult(double executionStart)
+{
+	return new Dictionary({
+		{ "host", "example" },
+		{ "cr", new Dictionary({
+			{ "execution_start", executionStart },
+			{ "output", "OK" },
+			{ "performance_data", new Array({ "time=1s" }) }
+		}) }
+	});
+}
+
+BOOST_AUTO_TEST_SUITE(remote_duplicatemessagefilter)
+
+BOOST_AUTO_TEST_CASE(duplicates)
+{
+	DuplicateMessageFilter::Reset();
+
+	auto master1 (MakeEndpoint("master1"));
+	auto master2 (MakeEndpoint("master2"));
+
+	BOOST_CHECK(!DuplicateMessageFilter::IsDuplicate(master1, "event::CheckResult", MakeCheckResult(1)));
+
+	/* The same message via the other master */
+	BOOST_CHECK(DuplicateMessageFilter::IsDuplicate(master2, "event::CheckResult", MakeCheckResult(1)));
+
+	/* Not a duplicate if sent again by the same endpoint */
+	BOOST_CHECK(!DuplicateMessageFilter::IsDuplicate(master1, "event::CheckResult", MakeCheckResult(1)));
+
+	/* Different params or method */
+	BOOST_CHECK(!DuplicateMessageFilter::IsDuplicate(master2, "event::CheckResult", MakeCheckResult(2)));
+	BOOST_CHECK(!DuplicateMessageFilter::IsDuplicate(master2, "event::SetNextCheck", MakeCheckResult(1)));
+
+	BOOST_CHECK_EQUAL(DuplicateMessageFilter::GetDuplicates(), 1);
+
+	Dictionary::Ptr status = DuplicateMessageFilter::GetStatus();
+	Dictionary::Ptr fromMaster1 = status->Get("master1");
+
+	BOOST_REQUIRE(fromMaster1);
+	BOOST_CHECK(fromMaster1->Get("master2") == 1);
+}
+
+BOOST_AUTO_TEST_CASE(unfiltered)
+{
+	DuplicateMessageFilter::Reset();
+
+	auto master1 (MakeEndpoint("master1"));
+	auto master2 (MakeEndpoint("master2"));
+	Dictionary::Ptr heartbeat = new Dictionary({ { "timeout", 120 } });
+
+	/* All endpoints send the same heartbeats */
+	BOOST_CHECK(!DuplicateMessageFilter::IsDuplicate(master1, "event::Heartbeat", heartbeat));
+	BOOST_CHECK(!DuplicateMessageFilter::IsDuplicate(master2, "event::Heartbeat", heartbeat));
+
+	BOOST_CHECK(!DuplicateMessageFilter::IsDuplicate(master1, "config::UpdateObject", heartbeat));
+	BOOST_CHECK(!DuplicateMessageFilter::IsDuplicate(master2, "config::UpdateObject", heartbeat));
+
+	BOOST_CHECK_EQUAL(DuplicateMessageFilter::GetDuplicates(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(eviction)
+{
+	DuplicateMessageFilter::Reset();
+
+	auto master1 (MakeEndpoint("master1"));
+	auto master2 (MakeEndpoint("master2"));
+
+	BOOST_CHECK(!DuplicateMessageFilter::IsDuplicate(master1, "event::CheckResult", MakeCheckResult(0)));
+
+	for (int i = 1; i <= 20000; i++)
+		DuplicateMessageFilter::IsDuplicate(master1, "event::CheckResult", MakeCheckResult(i));
+
+	/* Too long ago */
+	BOOST_CHECK(!DuplicateMessageFilter::IsDuplicate(master2, "event::CheckResult", MakeCheckResult(0)));
+
+	/* Recent */
+	BOOST_CHECK(DuplicateMessageFilter::IsDuplicate(master2, "event::CheckResult", MakeCheckResult(20000)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
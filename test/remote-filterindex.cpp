@@ -0,0 +1,124 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/filterindex.hpp"
+#include "icinga/host.hpp"
+#include "icinga/service.hpp"
+#include "config/configcompiler.hpp"
+#include <BoostTestTargetConfig.h>
+#include <algorithm>
+
+using namespace icinga;
+
+static bool FindCandidates(const Type::Ptr& type, const String& filter, std::vector<ConfigObject::Ptr>& candidates,
+	const Dictionary::Ptr& constants = nullptr)
+{
+	std::unique_ptr<Expression> expr = ConfigCompiler::CompileText("<test>", filter);
+	auto dict (dynamic_cast<DictExpression*>(expr.get()));
+
+	BOOST_REQUIRE(dict && dict->GetExpressions().size() == 1u);
+
+	candidates.clear();
+	return FilterIndex::FindCandidates(type, dict->GetExpressions().at(0).get(), String(), constants, candidates);
+}
+
+static bool Contains(const std::vector<ConfigObject::Ptr>& candidates, const ConfigObject::Ptr& object)
+{
+	return std::find(candidates.begin(), candidates.end(), object) != candidates.end();
+}
+
+static Host::Ptr MakeHost(const String& name)
+{
+	Host::Ptr host = new Host();
+	host->SetName(name, true);
+	host->SetStateRaw(ServiceOK, true);
+	host->SetActive(true, true);
+	FilterIndex::Update(host);
+
+	return host;
+}
+
+static void Deactivate(const ConfigObject::Ptr& object)
+{
+	object->SetActive(false, true);
+	FilterIndex::Update(object);
+}
+
+BOOST_AUTO_TEST_SUITE(remote_filterindex)
+
+BOOST_AUTO_TEST_CASE(equality)
+{
+	Host::Ptr h1 = MakeHost("filterindex-h1");
+	Host::Ptr h2 = MakeHost("filterindex-h2");
+
+	std::vector<ConfigObject::Ptr> candidates;
+
+	/* Updated by the state_raw change handler. */
+	h1->SetStateRaw(ServiceCritical);
+
+	BOOST_CHECK(FindCandidates(Host::TypeInstance, "host.state == 1", candidates));
+	BOOST_CHECK(Contains(candidates, h1));
+	BOOST_CHECK(!Contains(candidates, h2));
+
+	BOOST_CHECK(FindCandidates(Host::TypeInstance, "0 == host.state && host.vars.x == 1", candidates));
+	BOOST_CHECK(!Contains(candidates, h1));
+	BOOST_CHECK(Contains(candidates, h2));
+
+	h1->SetAcknowledgementRaw(AcknowledgementNormal);
+
+	BOOST_CHECK(FindCandidates(Host::TypeInstance, "host.state == s && host.acknowledgement == 1", candidates,
+		new Dictionary({ { "s", 1 } })));
+	BOOST_CHECK(Contains(candidates, h1));
+	BOOST_CHECK(!Contains(candidates, h2));
+
+	/* Not a conjunction, all objects have to be checked. */
+	BOOST_CHECK(!FindCandidates(Host::TypeInstance, "host.state == 1 || host.acknowledgement == 1", candidates));
+	BOOST_CHECK(!FindCandidates(Host::TypeInstance, "host.state != 1", candidates));
+
+	Deactivate(h1);
+	Deactivate(h2);
+
+	BOOST_CHECK(FindCandidates(Host::TypeInstance, "host.state == 1", candidates));
+	BOOST_CHECK(!Contains(candidates, h1));
+}
+
+BOOST_AUTO_TEST_CASE(membership)
+{
+	Host::Ptr h1 = MakeHost("filterindex-h3");
+	Host::Ptr h2 = MakeHost("filterindex-h4");
+
+	h1->SetGroups(new Array({ "linux", "web" }), true);
+	FilterIndex::Update(h1);
+
+	std::vector<ConfigObject::Ptr> candidates;
+
+	BOOST_CHECK(FindCandidates(Host::TypeInstance, "\"web\" in host.groups", candidates));
+	BOOST_CHECK(Contains(candidates, h1));
+	BOOST_CHECK(!Contains(candidates, h2));
+
+	BOOST_CHECK(FindCandidates(Host::TypeInstance, "\"windows\" in host.groups", candidates));
+	BOOST_CHECK(candidates.empty());
+
+	Deactivate(h1);
+	Deactivate(h2);
+}
+
+BOOST_AUTO_TEST_CASE(navigation)
+{
+	Service::Ptr s1 = new Service();
+	s1->SetName("filterindex-h5!ping", true);
+	s1->SetHostName("filterindex-h5", true);
+	s1->SetActive(true, true);
+	FilterIndex::Update(s1);
+
+	std::vector<ConfigObject::Ptr> candidates;
+
+	BOOST_CHECK(FindCandidates(Service::TypeInstance, "host.name == \"filterindex-h5\"", candidates));
+	BOOST_CHECK(Contains(candidates, s1));
+
+	BOOST_CHECK(FindCandidates(Service::TypeInstance, "service.host_name == \"filterindex-h6\"", candidates));
+	BOOST_CHECK(!Contains(candidates, s1));
+
+	Deactivate(s1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,52 @@
+/* Icinga 2 | (c) 2012 Icinga GmbH | GPLv2+ */
+
+#include "remote/jsonrpccompression.hpp"
+#include "base/convert.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static String MakeMessage(int i)
+{
+	return "{\"jsonrpc\":\"2.0\",\"method\":\"event::CheckResult\",\"params\":{\"host\":\"host-" + Convert::ToString(i)
+		+ "\",\"service\":\"disk /\",\"cr\":{\"output\":\"DISK OK - free space: / 3326 MB (8% inode=88%);\"}}}";
+}
+
+BOOST_AUTO_TEST_SUITE(remote_jsonrpccompression)
+
+BOOST_AUTO_TEST_CASE(roundtrip)
+{
+	JsonRpcDeflater deflater (6);
+	JsonRpcInflater inflater;
+	size_t uncompressed = 0, compressed = 0;
+
+	for (int i = 0; i < 100; i++) {
+		String message (MakeMessage(i));
+		String deflated (deflater.Deflate(message));
+
+		BOOST_CHECK(JsonRpcInflater::IsCompressedMessage(deflated));
+		BOOST_CHECK(!JsonRpcInflater::IsCompressedMessage(message));
+		BOOST_CHECK_EQUAL(inflater.Inflate(deflated), message);
+
+		uncompressed += message.GetLength();
+		compressed += deflated.GetLength();
+	}
+
+	/* The later messages refer back to the earlier ones. */
+	BOOST_CHECK(compressed * 3 < uncompressed);
+
+	BOOST_CHECK_EQUAL(inflater.Inflate(deflater.Deflate("")), "");
+}
+
+BOOST_AUTO_TEST_CASE(invalid)
+{
+	JsonRpcDeflater deflater (1);
+	String deflated (deflater.Deflate(String(100000, 'a')));
+
+	BOOST_CHECK_THROW(JsonRpcInflater().Inflate(deflated, 1000), std::invalid_argument);
+	BOOST_CHECK_EQUAL(JsonRpcInflater().Inflate(deflated).GetLength(), 100000);
+
+	BOOST_CHECK_THROW(JsonRpcInflater().Inflate(String("\x1f") + "garbage"), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
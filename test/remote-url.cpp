@@ -82,6 +82,26 @@ BOOST_AUTO_TEST_CASE(parameters)
 	BOOST_CHECK(query[2].second == "bar");
 }
 
+BOOST_AUTO_TEST_CASE(parameters_special)
+{
+	Url::Ptr url = new Url("/?a=1&&b&c=&d=x=y&e%5B%5D=%2F&f[]=");
+
+	auto query (url->GetQuery());
+
+	BOOST_REQUIRE(query.size() == 6);
+
+	BOOST_CHECK(query[0] == std::make_pair(String("a"), String("1")));
+	BOOST_CHECK(query[1] == std::make_pair(String("b"), String()));
+	BOOST_CHECK(query[2] == std::make_pair(String("c"), String()));
+	BOOST_CHECK(query[3] == std::make_pair(String("d"), String("x=y")));
+	BOOST_CHECK(query[4] == std::make_pair(String("e[]"), String("/")));
+	BOOST_CHECK(query[5] == std::make_pair(String("f"), String()));
+
+	BOOST_CHECK_THROW(url = new Url("/?a[]b=1"), std::invalid_argument);
+	BOOST_CHECK_THROW(url = new Url("/?a[][]=1"), std::invalid_argument);
+	BOOST_CHECK_THROW(url = new Url("/?a=%2"), std::invalid_argument);
+}
+
 BOOST_AUTO_TEST_CASE(format)
 {
 	Url::Ptr url = new Url("http://foo.bar/baz/?hop=top&flop=sop#iLIKEtrains");
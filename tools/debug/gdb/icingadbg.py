@@ -13,18 +13,18 @@ class IcingaValuePrinter:
         self.val = val
 
     def to_string(self):
-        which = self.val['m_Value']['which_']
+        valueType = int(self.val['m_Type'])
 
-        if which == 0:
+        if valueType == 0:
             return 'Empty'
-        elif which == 1:
-            return self.val['m_Value']['storage_']['data_']['buf'].cast(gdb.lookup_type('double').pointer()).dereference()
-        elif which == 2:
-            return self.val['m_Value']['storage_']['data_']['buf'].cast(gdb.lookup_type('bool').pointer()).dereference()
-        elif which == 3:
-            return self.val['m_Value']['storage_']['data_']['buf'].cast(gdb.lookup_type('icinga::String').pointer()).dereference()
-        elif which == 4:
-            return self.val['m_Value']['storage_']['data_']['buf'].cast(gdb.lookup_type('icinga::Object').pointer()).dereference()
+        elif valueType == 1:
+            return self.val['m_Number']
+        elif valueType == 2:
+            return self.val['m_Boolean']
+        elif valueType == 3:
+            return self.val['m_String'].dereference()['Data']
+        elif valueType == 4:
+            return self.val['m_Object']['px'].dereference()
         else:
             return '<INVALID>'
 
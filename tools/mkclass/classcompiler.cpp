@@ -95,23 +95,6 @@ void ClassCompiler::HandleLibrary(const std::string& library, const ClassDebugIn
 	m_Library = library;
 }
 
-unsigned long ClassCompiler::SDBM(const std::string& str, size_t len = std::string::npos)
-{
-	unsigned long hash = 0;
-	size_t current = 0;
-
-	for (const char& ch : str) {
-		if (current >= len)
-			break;
-
-		hash = ch + (hash << 6) + (hash << 16) - hash;
-
-		current++;
-	}
-
-	return hash;
-}
-
 static int TypePreference(const std::string& type)
 {
 	if (type == "Value")
@@ -244,88 +227,29 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 	m_Header << "\t" << "int GetFieldId(const String& name) const override;" << std::endl;
 
 	m_Impl << "int TypeImpl<" << klass.Name << ">::GetFieldId(const String& name) const" << std::endl
-		<< "{" << std::endl;
-
-	if (!klass.Fields.empty()) {
-		m_Impl << "\t" << "int offset = ";
-
-		if (!klass.Parent.empty())
-			m_Impl << klass.Parent << "::TypeInstance->GetFieldCount()";
-		else
-			m_Impl << "0";
-
-		m_Impl << ";" << std::endl << std::endl;
-	}
-
-	std::map<int, std::vector<std::pair<int, std::string> > > jumptable;
-
-	int hlen = 0, collisions = 0;
-
-	do {
-		int num = 0;
-
-		hlen++;
-		jumptable.clear();
-		collisions = 0;
-
-		for (const Field& field : klass.Fields) {
-			auto hash = static_cast<int>(SDBM(field.Name, hlen));
-			jumptable[hash].emplace_back(num, field.Name);
-			num++;
-
-			if (jumptable[hash].size() > 1)
-				collisions++;
-		}
-	} while (collisions >= 5 && hlen < 8);
-
-	if (!klass.Fields.empty()) {
-		m_Impl << "\tswitch (static_cast<int>(Utility::SDBM(name, " << hlen << "))) {" << std::endl;
-
-		for (const auto& itj : jumptable) {
-			m_Impl << "\t\tcase " << itj.first << ":" << std::endl;
-
-			for (const auto& itf : itj.second) {
-				m_Impl << "\t\t\t" << "if (name == \"" << itf.second << "\")" << std::endl
-					<< "\t\t\t\t" << "return offset + " << itf.first << ";" << std::endl;
-			}
+		<< "{" << std::endl
+		<< "\t" << "return LookupFieldId(name);" << std::endl
+		<< "}" << std::endl << std::endl;
 
-			m_Impl << std::endl
-					<< "\t\t\tbreak;" << std::endl;
-		}
+	/* GetBaseFieldCount */
+	if (!klass.Parent.empty()) {
+		m_Header << "\t" << "static int GetBaseFieldCount();" << std::endl;
 
-		m_Impl << "\t}" << std::endl;
+		m_Impl << "int TypeImpl<" << klass.Name << ">::GetBaseFieldCount()" << std::endl
+			<< "{" << std::endl
+			<< "\t" << "static const int count = " << klass.Parent << "::TypeInstance->GetFieldCount();" << std::endl
+			<< "\t" << "return count;" << std::endl
+			<< "}" << std::endl << std::endl;
 	}
 
-	m_Impl << std::endl
-		<< "\t" << "return ";
-
-	if (!klass.Parent.empty())
-		m_Impl << klass.Parent << "::TypeInstance->GetFieldId(name)";
-	else
-		m_Impl << "-1";
-
-	m_Impl << ";" << std::endl
-		<< "}" << std::endl << std::endl;
-
 	/* GetFieldInfo */
 	m_Header << "\t" << "Field GetFieldInfo(int id) const override;" << std::endl;
 
 	m_Impl << "Field TypeImpl<" << klass.Name << ">::GetFieldInfo(int id) const" << std::endl
 		<< "{" << std::endl;
 
-	if (!klass.Parent.empty())
-		m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount();" << std::endl
-			<< "\t" << "if (real_id < 0) { return " << klass.Parent << "::TypeInstance->GetFieldInfo(id); }" << std::endl;
-
 	if (!klass.Fields.empty()) {
-		m_Impl << "\t" << "switch (";
-
-		if (!klass.Parent.empty())
-			m_Impl << "real_id";
-		else
-			m_Impl << "id";
-
-		m_Impl << ") {" << std::endl;
+		m_Impl << "\t" << "static constexpr Field fields[] = {" << std::endl;
 
 		size_t num = 0;
 		for (const Field& field : klass.Fields) {
@@ -338,21 +262,30 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 			else
 				nameref = "nullptr";
 
-			m_Impl << "\t\t" << "case " << num << ":" << std::endl
-					<< "\t\t\t" << "return {" << num << ", \"" << ftype << "\", \"" << field.Name << "\", \"" << (field.NavigationName.empty() ? field.Name : field.NavigationName) << "\", "  << nameref << ", " << field.Attributes << ", " << field.Type.ArrayRank << "};" << std::endl;
+			m_Impl << "\t\t" << "{" << num << ", \"" << ftype << "\", \"" << field.Name << "\", \"" << (field.NavigationName.empty() ? field.Name : field.NavigationName) << "\", "  << nameref << ", " << field.Attributes << ", " << field.Type.ArrayRank << "}," << std::endl;
 			num++;
 		}
 
-		m_Impl << "\t\t" << "default:" << std::endl
-				<< "\t\t";
+		m_Impl << "\t" << "};" << std::endl << std::endl;
 	}
 
-	m_Impl << "\t" << "throw std::runtime_error(\"Invalid field ID.\");" << std::endl;
+	if (!klass.Parent.empty())
+		m_Impl << "\t" << "int real_id = id - TypeImpl<" << klass.Name << ">::GetBaseFieldCount();" << std::endl
+			<< "\t" << "if (real_id < 0) { return " << klass.Parent << "::TypeInstance->GetFieldInfo(id); }" << std::endl;
+	else
+		m_Impl << "\t" << "int real_id = id;" << std::endl;
 
-	if (!klass.Fields.empty())
-		m_Impl << "\t" << "}" << std::endl;
+	if (!klass.Fields.empty()) {
+		m_Impl << "\t" << "if (";
 
-	m_Impl << "}" << std::endl << std::endl;
+		if (klass.Parent.empty())
+			m_Impl << "real_id >= 0 && ";
+
+		m_Impl << "real_id < " << klass.Fields.size() << ") { return fields[real_id]; }" << std::endl;
+	}
+
+	m_Impl << "\t" << "throw std::runtime_error(\"Invalid field ID.\");" << std::endl
+		<< "}" << std::endl << std::endl;
 
 	/* GetFieldCount */
 	m_Header << "\t" << "int GetFieldCount() const override;" << std::endl;
@@ -362,7 +295,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 		<< "\t" << "return " << klass.Fields.size();
 
 	if (!klass.Parent.empty())
-		m_Impl << " + " << klass.Parent << "::TypeInstance->GetFieldCount()";
+		m_Impl << " + TypeImpl<" << klass.Name << ">::GetBaseFieldCount()";
 
 	m_Impl << ";" << std::endl
 		<< "}" << std::endl << std::endl;
@@ -406,7 +339,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 		<< "{" << std::endl;
 
 	if (!klass.Parent.empty())
-		m_Impl << "\t" << "int real_id = fieldId - " << klass.Parent << "::TypeInstance->GetFieldCount(); " << std::endl
+		m_Impl << "\t" << "int real_id = fieldId - TypeImpl<" << klass.Name << ">::GetBaseFieldCount(); " << std::endl
 			<< "\t" << "if (real_id < 0) { " << klass.Parent << "::TypeInstance->RegisterAttributeHandler(fieldId, callback); return; }" << std::endl;
 
 	if (!klass.Fields.empty()) {
@@ -582,7 +515,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 			<< "{" << std::endl;
 
 		if (!klass.Parent.empty())
-			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount(); " << std::endl
+			m_Impl << "\t" << "int real_id = id - TypeImpl<" << klass.Name << ">::GetBaseFieldCount(); " << std::endl
 				<< "\t" << "if (real_id < 0) { " << klass.Parent << "::SetField(id, value, suppress_events, cookie); return; }" << std::endl;
 
 		m_Impl << "\t" << "switch (";
@@ -626,7 +559,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 			<< "{" << std::endl;
 
 		if (!klass.Parent.empty())
-			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount(); " << std::endl
+			m_Impl << "\t" << "int real_id = id - TypeImpl<" << klass.Name << ">::GetBaseFieldCount(); " << std::endl
 				<< "\t" << "if (real_id < 0) { return " << klass.Parent << "::GetField(id); }" << std::endl;
 
 		m_Impl << "\t" << "switch (";
@@ -659,7 +592,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 			<< "{" << std::endl;
 
 		if (!klass.Parent.empty())
-			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount(); " << std::endl
+			m_Impl << "\t" << "int real_id = id - TypeImpl<" << klass.Name << ">::GetBaseFieldCount(); " << std::endl
 				<< "\t" << "if (real_id < 0) { " << klass.Parent << "::ValidateField(id, lvalue, utils); return; }" << std::endl;
 
 		m_Impl << "\t" << "switch (";
@@ -703,7 +636,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 			<< "{" << std::endl;
 
 		if (!klass.Parent.empty())
-			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount(); " << std::endl
+			m_Impl << "\t" << "int real_id = id - TypeImpl<" << klass.Name << ">::GetBaseFieldCount(); " << std::endl
 				<< "\t" << "if (real_id < 0) { " << klass.Parent << "::NotifyField(id, cookie); return; }" << std::endl;
 
 		m_Impl << "\t" << "switch (";
@@ -737,7 +670,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 			<< "{" << std::endl;
 
 		if (!klass.Parent.empty())
-			m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount(); " << std::endl
+			m_Impl << "\t" << "int real_id = id - TypeImpl<" << klass.Name << ">::GetBaseFieldCount(); " << std::endl
 				<< "\t" << "if (real_id < 0) { return " << klass.Parent << "::NavigateField(id); }" << std::endl;
 
 		bool haveNavigationFields = false;
@@ -848,6 +781,9 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 				else
 					m_Impl << field.SetAccessor << std::endl << std::endl;
 
+				if (field.Attributes & FAState)
+					m_Impl << "\t" << "MarkStateDirty();" << std::endl;
+
 				if (field.Type.IsName || !field.TrackAccessor.empty()) {
 					if (field.Name != "active") {
 						m_Impl << "\t" << "if (!dobj || dobj->IsActive())" << std::endl
@@ -861,7 +797,7 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 					<< "\t\t" << "Notify" << field.GetFriendlyName() << "(cookie);" << std::endl;
 
 				if (field.Attributes & FASignalWithOldValue) {
-					m_Impl << "\t\t" << "if (!dobj || dobj->IsActive())" << std::endl
+					m_Impl << "\t\t" << "if (!On" << field.GetFriendlyName() << "ChangedWithOldValue.empty() && (!dobj || dobj->IsActive()))" << std::endl
 						   << "\t\t\t" << "On" << field.GetFriendlyName() << "ChangedWithOldValue(static_cast<" << klass.Name << " *>(this), oldValue, value);" << std::endl;
 				}
 
@@ -1016,7 +952,9 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 					<< "\t" << "virtual void Notify" << field.GetFriendlyName() << "(const Value& cookie = Empty);" << std::endl;
 
 			m_Impl << "void ObjectImpl<" << klass.Name << ">::Notify" << field.GetFriendlyName() << "(const Value& cookie)" << std::endl
-				<< "{" << std::endl;
+				<< "{" << std::endl
+				<< "\t" << "if (On" << field.GetFriendlyName() << "Changed.empty())" << std::endl
+				<< "\t\t" << "return;" << std::endl << std::endl;
 
 			if (field.Name != "active") {
 				m_Impl << "\t" << "auto *dobj = dynamic_cast<ConfigObject *>(this);" << std::endl
@@ -1052,28 +990,30 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 					<< "\t" << "virtual void Validate" << field.GetFriendlyName() << "(const Lazy<" << field.Type.GetRealType() << ">& lvalue, const ValidationUtils& utils);" << std::endl;
 		}
 
-		/* instance variables */
+		/* instance variables, the hot ones first so that they share as few cache lines as possible */
 		m_Header << "private:" << std::endl;
 
-		for (const Field& field : klass.Fields) {
-			if (field.Attributes & FANoStorage)
-				continue;
+		for (bool hot : { true, false }) {
+			for (const Field& field : klass.Fields) {
+				if (field.Attributes & FANoStorage || static_cast<bool>(field.Attributes & FAHot) != hot)
+					continue;
 
-			m_Header << "\tAtomicOrLocked<" << field.Type.GetRealType() << "> m_" << field.GetFriendlyName() << ";" << std::endl;
+				m_Header << "\tAtomicOrLocked<" << field.Type.GetRealType() << "> m_" << field.GetFriendlyName() << ";" << std::endl;
+			}
 		}
 		
 		/* signal */
 		m_Header << "public:" << std::endl;
 		
 		for (const Field& field : klass.Fields) {
-			m_Header << "\t" << "static boost::signals2::signal<void (const intrusive_ptr<" << klass.Name << ">&, const Value&)> On" << field.GetFriendlyName() << "Changed;" << std::endl;
-			m_Impl << std::endl << "boost::signals2::signal<void (const intrusive_ptr<" << klass.Name << ">&, const Value&)> ObjectImpl<" << klass.Name << ">::On" << field.GetFriendlyName() << "Changed;" << std::endl << std::endl;
+			m_Header << "\t" << "static Signal<void (const intrusive_ptr<" << klass.Name << ">&, const Value&)> On" << field.GetFriendlyName() << "Changed;" << std::endl;
+			m_Impl << std::endl << "Signal<void (const intrusive_ptr<" << klass.Name << ">&, const Value&)> ObjectImpl<" << klass.Name << ">::On" << field.GetFriendlyName() << "Changed;" << std::endl << std::endl;
 
 			if (field.Attributes & FASignalWithOldValue) {
-				m_Header << "\t" << "static boost::signals2::signal<void (const intrusive_ptr<" << klass.Name
+				m_Header << "\t" << "static Signal<void (const intrusive_ptr<" << klass.Name
 					<< ">&, const Value&, const Value&)> On" << field.GetFriendlyName() << "ChangedWithOldValue;"
 					<< std::endl;
-				m_Impl << std::endl << "boost::signals2::signal<void (const intrusive_ptr<" << klass.Name
+				m_Impl << std::endl << "Signal<void (const intrusive_ptr<" << klass.Name
 					<< ">&, const Value&, const Value&)> ObjectImpl<" << klass.Name << ">::On"
 					<< field.GetFriendlyName() << "ChangedWithOldValue;" << std::endl << std::endl;
 			}
@@ -1457,6 +1397,7 @@ void ClassCompiler::CompileStream(const std::string& path, std::istream& input,
 		<< "#include \"base/array.hpp\"" << std::endl
 		<< "#include \"base/atomic.hpp\"" << std::endl
 		<< "#include \"base/dictionary.hpp\"" << std::endl
+		<< "#include \"base/signal.hpp\"" << std::endl
 		<< "#include <boost/signals2.hpp>" << std::endl << std::endl;
 
 	oimpl << "#include \"base/exception.hpp\"" << std::endl
@@ -62,6 +62,7 @@ enum FieldAttribute
 	FASetVirtual = 16384,
 	FAActivationPriority = 32768,
 	FASignalWithOldValue = 65536,
+	FAHot = 131072,
 };
 
 struct FieldType
@@ -234,7 +235,6 @@ private:
 
 	std::map<std::pair<std::string, std::string>, Field> m_MissingValidators;
 
-	static unsigned long SDBM(const std::string& str, size_t len);
 	static std::string BaseName(const std::string& path);
 	static std::string FileNameToGuardName(const std::string& path);
 };
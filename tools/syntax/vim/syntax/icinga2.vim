@@ -59,7 +59,7 @@ syn keyword		icinga2ObjType		FileLogger GelfWriter GraphiteWriter Host HostGroup
 syn keyword		icinga2ObjType		IcingaApplication IdoMysqlConnection IdoPgsqlConnection
 syn keyword		icinga2ObjType		InfluxdbWriter Influxdb2Writer JournaldLogger
 syn keyword		icinga2ObjType		LivestatusListener Notification NotificationCommand
-syn keyword		icinga2ObjType		NotificationComponent OpenTsdbWriter PerfdataWriter
+syn keyword		icinga2ObjType		NotificationComponent OpenTsdbWriter OtlpMetricsWriter PerfdataWriter
 syn keyword		icinga2ObjType		ScheduledDowntime Service ServiceGroup SyslogLogger
 syn keyword		icinga2ObjType		TimePeriod User UserGroup WindowsEventLogLogger Zone
 